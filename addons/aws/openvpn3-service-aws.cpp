@@ -18,11 +18,18 @@
 //  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <exception>
 #include <set>
+#include <thread>
 #include <glib-unix.h>
 
 // Needs to be included before openvpn3-core library
@@ -51,6 +58,19 @@ using namespace openvpn;
 
 #define OPENVPN3_AWS_CONFIG "/etc/openvpn3/openvpn3-aws.json"
 #define OPENVPN3_AWS_CERTS "/etc/openvpn3/awscerts"
+
+// Route changes arriving within this window are applied as one batch
+#define OPENVPN3_AWS_ROUTE_BATCH_MS 250
+
+// How long the instance role credentials are reused before new ones
+// are retrieved.  The instance metadata service provides new
+// credentials well before the old ones expire.
+#define OPENVPN3_AWS_CREDS_LIFETIME_SECS 300
+
+// Number of routes removed in parallel when shutting down, and how
+// often a route removal is retried when the EC2 API is throttling
+#define OPENVPN3_AWS_TEARDOWN_PARALLEL 8
+#define OPENVPN3_AWS_THROTTLE_RETRIES 5
 static const std::string OpenVPN3DBus_interf_aws = "net.openvpn.v3.aws";
 static const std::string OpenVPN3DBus_path_aws = "/net/openvpn/v3/aws";
 
@@ -94,20 +114,24 @@ public:
         log_sender.LogInfo("Fetching credentials from role '"
                             + role_name + "'");
 
-        auto route_context = prepare_route_context(role_name);
-        AWS::Route::Info route_info { *route_context };
+        AWS::Route::Context& route_context = get_route_context();
+        AWS::Route::Info route_info { route_context };
         route_table_id = route_info.route_table_id;
         network_interface_id = route_info.network_interface_id;
-        AWS::Route::set_source_dest_check(*route_context,
+        AWS::Route::set_source_dest_check(route_context,
                                           network_interface_id, false);
 
-        log_sender.LogInfo("Running on instance " + route_context->instance_id()
+        log_sender.LogInfo("Running on instance " + route_context.instance_id()
                            + ", route table " + route_table_id);
 
         // We will act upon route changes caused by VPN sessions,
         // notifications which are sent by the net.openvpn.v3.netcfg service
         netcfgmgr.NotificationSubscribe(NetCfgChangeType::ROUTE_ADDED
                                         | NetCfgChangeType::ROUTE_REMOVED);
+
+        // The VPC route table is updated from a separate thread, to not
+        // block the main loop while waiting for the EC2 API
+        route_worker = std::thread([this]() { route_worker_loop(); });
     }
 
     ~AWSObject() override
@@ -116,28 +140,20 @@ public:
         // before we start cleaning up.
         netcfgmgr.NotificationUnsubscribe();
 
-        // Retrieve AWS credentials and remove routes we are responsible
-        // for from VPC
-        auto route_context = prepare_route_context(role_name);
-
-        for (auto vpcRoute : vpcRoutes)
+        // Stop the route worker; pending changes are not needed as all
+        // the routes we are responsible for are removed below
         {
-            try
-            {
-                AWS::Route::delete_route(*route_context,
-                                         route_table_id,
-                                         vpcRoute.first,
-                                         vpcRoute.second);
-
-                log_sender.LogInfo("Removed route " + vpcRoute.first);
-            }
-            catch (const std::exception& ex)
-            {
-                log_sender.LogError("Error removing route: " + std::string(ex.what()));
-            }
+            std::lock_guard<std::mutex> guard(route_mtx);
+            route_worker_stop = true;
+        }
+        route_cv.notify_all();
+        if (route_worker.joinable())
+        {
+            route_worker.join();
         }
 
-        vpcRoutes.clear();
+        // Remove routes we are responsible for from VPC
+        remove_all_routes();
     }
 
     /**
@@ -163,45 +179,16 @@ public:
             return;
         }
 
-        try
+        // Queue the change for the route worker.  If the same route
+        // changes more than once within the batch window, only the last
+        // change is kept.
+        const std::string cidr = ev.details["subnet"] + "/" + ev.details["prefix"];
+        const bool ipv6 =  ev.details["ip_version"] == "6";
         {
-            const std::string cidr = ev.details["subnet"] + "/" + ev.details["prefix"];
-            const bool ipv6 =  ev.details["ip_version"] == "6";
-            auto route_context = prepare_route_context(role_name);
-
-            if (ev.type == NetCfgChangeType::ROUTE_ADDED)
-            {
-                AWS::Route::replace_create_route(*route_context,
-                                                 route_table_id,
-                                                 cidr,
-                                                 AWS::Route::RouteTargetType::INSTANCE_ID,
-                                                 route_context->instance_id(),
-                                                 ipv6);
-
-                vpcRoutes.emplace(cidr, ipv6);
-
-                log_sender.LogInfo("Added route " + cidr);
-            }
-            else
-            {
-                AWS::Route::delete_route(*route_context,
-                                         route_table_id,
-                                         cidr,
-                                         ipv6);
-
-                auto it = vpcRoutes.find(VpcRoute(cidr, ipv6));
-                if (it != vpcRoutes.end())
-                {
-                    vpcRoutes.erase(it);
-                }
-
-                log_sender.LogInfo("Removed route " + cidr);
-            }
-        }
-        catch (const std::exception& ex)
-        {
-            log_sender.LogError("Error updating VPC routing: " + std::string(ex.what()));
+            std::lock_guard<std::mutex> guard(route_mtx);
+            pending_routes[VpcRoute(cidr, ipv6)] = (ev.type == NetCfgChangeType::ROUTE_ADDED);
         }
+        route_cv.notify_all();
     }
 
 
@@ -255,6 +242,233 @@ private:
     std::set<VpcRoute> vpcRoutes;
     LogSender log_sender;
 
+    AWS::PCQuery::Info route_info;
+    std::unique_ptr<AWS::Route::Context> route_ctx;
+    std::chrono::steady_clock::time_point route_ctx_expiry;
+
+    std::thread route_worker;
+    std::mutex route_mtx;
+    std::condition_variable route_cv;
+    std::map<VpcRoute, bool> pending_routes;  ///< true: add, false: remove
+    bool route_worker_stop = false;
+
+
+    /**
+     *  Runs in the route worker thread.  Waits for queued route changes,
+     *  collects further changes for OPENVPN3_AWS_ROUTE_BATCH_MS and
+     *  applies them as a single batch.
+     */
+    void route_worker_loop()
+    {
+        std::unique_lock<std::mutex> lock(route_mtx);
+        while (!route_worker_stop)
+        {
+            route_cv.wait(lock, [this]() {
+                return route_worker_stop || !pending_routes.empty();
+            });
+            if (route_worker_stop)
+            {
+                return;
+            }
+
+            // Give the netcfg service time to send the rest of the routes
+            route_cv.wait_for(lock,
+                              std::chrono::milliseconds(OPENVPN3_AWS_ROUTE_BATCH_MS),
+                              [this]() { return route_worker_stop; });
+            if (route_worker_stop)
+            {
+                return;
+            }
+
+            std::map<VpcRoute, bool> batch;
+            batch.swap(pending_routes);
+            lock.unlock();
+            apply_route_batch(batch);
+            lock.lock();
+        }
+    }
+
+
+    /**
+     *  Updates the VPC route table with a batch of route changes.  Changes
+     *  which would not modify vpcRoutes, like adding a route already added
+     *  or removing a route not added by us, are skipped.
+     *
+     * @param batch  std::map of routes to add (true) or remove (false)
+     */
+    void apply_route_batch(const std::map<VpcRoute, bool>& batch)
+    {
+        for (const auto& change : batch)
+        {
+            const VpcRoute& route = change.first;
+            const bool add = change.second;
+            if (add == (vpcRoutes.find(route) != vpcRoutes.end()))
+            {
+                continue;
+            }
+
+            try
+            {
+                AWS::Route::Context& route_context = get_route_context();
+                if (add)
+                {
+                    AWS::Route::replace_create_route(route_context,
+                                                     route_table_id,
+                                                     route.first,
+                                                     AWS::Route::RouteTargetType::INSTANCE_ID,
+                                                     route_context.instance_id(),
+                                                     route.second);
+                    vpcRoutes.insert(route);
+                    log_sender.LogInfo("Added route " + route.first);
+                }
+                else
+                {
+                    AWS::Route::delete_route(route_context,
+                                             route_table_id,
+                                             route.first,
+                                             route.second);
+                    vpcRoutes.erase(route);
+                    log_sender.LogInfo("Removed route " + route.first);
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                // The credentials may have been revoked; retrieve
+                // new ones for the next route change
+                route_ctx.reset();
+                log_sender.LogError("Error updating VPC routing: " + std::string(ex.what()));
+            }
+        }
+    }
+
+
+    /**
+     *  Retrieve the route context with the instance role credentials,
+     *  reusing the previous one until OPENVPN3_AWS_CREDS_LIFETIME_SECS
+     *  has passed.
+     *
+     * @return Returns a reference to the current AWS::Route::Context
+     */
+    AWS::Route::Context& get_route_context()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (!route_ctx || now >= route_ctx_expiry)
+        {
+            route_info = fetch_instance_info(role_name);
+            route_ctx = prepare_route_context(route_info);
+            route_ctx_expiry = now + std::chrono::seconds(OPENVPN3_AWS_CREDS_LIFETIME_SECS);
+        }
+        return *route_ctx;
+    }
+
+
+    /**
+     *  Removes all the routes in vpcRoutes from the VPC route table.
+     *  Up to OPENVPN3_AWS_TEARDOWN_PARALLEL routes are removed at the same
+     *  time, each worker thread using its own route context with the same
+     *  credentials.  Must only be called when the route worker has stopped.
+     */
+    void remove_all_routes()
+    {
+        if (vpcRoutes.empty())
+        {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+
+        try
+        {
+            (void) get_route_context();
+        }
+        catch (const std::exception& ex)
+        {
+            log_sender.LogError("Error removing routes: " + std::string(ex.what()));
+            return;
+        }
+
+        const std::vector<VpcRoute> routes(vpcRoutes.begin(), vpcRoutes.end());
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> removed{0};
+        std::vector<std::thread> workers;
+        size_t count = std::min<size_t>(OPENVPN3_AWS_TEARDOWN_PARALLEL,
+                                        routes.size());
+        for (size_t w = 0; w < count; ++w)
+        {
+            workers.emplace_back([&]() {
+                std::unique_ptr<AWS::Route::Context> ctx;
+                try
+                {
+                    ctx = prepare_route_context(route_info);
+                }
+                catch (const std::exception& ex)
+                {
+                    log_sender.LogError("Error removing routes: " + std::string(ex.what()));
+                    return;
+                }
+
+                size_t i;
+                while ((i = next++) < routes.size())
+                {
+                    if (delete_route_retry(*ctx, routes[i]))
+                    {
+                        ++removed;
+                    }
+                }
+            });
+        }
+        for (auto& w : workers)
+        {
+            w.join();
+        }
+        vpcRoutes.clear();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start);
+        std::stringstream msg;
+        msg << "Removed " << removed << " of " << routes.size()
+            << " routes in " << elapsed.count() << " ms";
+        log_sender.LogInfo(msg.str());
+    }
+
+
+    /**
+     *  Removes a single route from the VPC route table.  If the EC2 API
+     *  reports throttling, the removal is retried with an exponential
+     *  back-off, up to OPENVPN3_AWS_THROTTLE_RETRIES times.
+     *
+     * @param ctx    AWS::Route::Context to use for the EC2 API call
+     * @param route  VpcRoute to remove
+     * @return Returns true if the route was removed
+     */
+    bool delete_route_retry(AWS::Route::Context& ctx, const VpcRoute& route)
+    {
+        std::chrono::milliseconds backoff(200);
+        for (unsigned int attempt = 0; ; ++attempt)
+        {
+            try
+            {
+                AWS::Route::delete_route(ctx, route_table_id,
+                                         route.first, route.second);
+                log_sender.LogInfo("Removed route " + route.first);
+                return true;
+            }
+            catch (const std::exception& ex)
+            {
+                const std::string err(ex.what());
+                bool throttled = (err.find("RequestLimitExceeded") != std::string::npos
+                                  || err.find("Throttling") != std::string::npos);
+                if (!throttled || attempt >= OPENVPN3_AWS_THROTTLE_RETRIES)
+                {
+                    log_sender.LogError("Error removing route "
+                                        + route.first + ": " + err);
+                    return false;
+                }
+            }
+            std::this_thread::sleep_for(backoff);
+            backoff *= 2;
+        }
+    }
+
     std::string read_role_name(const std::string& config_file)
     {
         try
@@ -269,7 +483,14 @@ private:
         }
     }
 
-    std::unique_ptr<AWS::Route::Context> prepare_route_context(const std::string& role_name)
+    /**
+     *  Retrieve the instance details and the instance role credentials
+     *  from the instance metadata service
+     *
+     * @param role_name  std::string with the IAM role to use
+     * @return Returns AWS::PCQuery::Info with the details
+     */
+    AWS::PCQuery::Info fetch_instance_info(const std::string& role_name)
     {
         RandomAPI::Ptr rng(new SSLLib::RandomAPI(false));
         AWS::PCQuery::Info ii;
@@ -285,6 +506,20 @@ private:
             });
         }, nullptr, rng.get());
 
+        return ii;
+    }
+
+
+    /**
+     *  Prepare a route context for EC2 API calls.  Each thread calling
+     *  the EC2 API needs its own route context.
+     *
+     * @param ii  AWS::PCQuery::Info from fetch_instance_info()
+     * @return Returns a new AWS::Route::Context
+     */
+    std::unique_ptr<AWS::Route::Context> prepare_route_context(const AWS::PCQuery::Info& ii)
+    {
+        RandomAPI::Ptr rng(new SSLLib::RandomAPI(false));
         return std::unique_ptr<AWS::Route::Context>(new AWS::Route::Context(ii, ii.creds, rng, nullptr, 0));
     }
 };
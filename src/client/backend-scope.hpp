@@ -0,0 +1,281 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   backend-scope.hpp
+ *
+ * @brief  Runs each VPN client backend process in its own transient
+ *         systemd scope unit, with its own cgroup and resource control
+ *         settings
+ */
+
+#pragma once
+
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <gio/gio.h>
+#include <sys/types.h>
+
+#include "common/resource-control.hpp"
+
+
+namespace BackendScope
+{
+    /// Name prefix of the scope units of the client backend processes
+    static const std::string unit_prefix = "openvpn3-client-";
+
+
+    /**
+     * @return Returns the name of the scope unit of a backend process
+     */
+    static inline std::string UnitName(pid_t pid)
+    {
+        return unit_prefix + std::to_string(pid) + ".scope";
+    }
+
+
+    /**
+     *  Adds the ResourceControl settings which are set as systemd unit
+     *  properties to an a(sv) GVariantBuilder
+     */
+    static inline void AddProperties(GVariantBuilder *props,
+                                     const ResourceControl& rc)
+    {
+        const std::pair<const char *, uint64_t> values[] = {
+            {"CPUWeight", rc.GetCPUWeight()},
+            {"IOWeight", rc.GetIOWeight()},
+            {"MemoryHigh", rc.GetMemoryHigh()},
+            {"MemoryMax", rc.GetMemoryMax()}
+        };
+        for (const auto& v : values)
+        {
+            if (v.second > 0)
+            {
+                g_variant_builder_add(props, "(sv)", v.first,
+                                      g_variant_new_uint64(v.second));
+            }
+        }
+    }
+
+
+    /**
+     *  Called when a scope unit has been set up.  The error is empty
+     *  on success.
+     */
+    using StartCallback = std::function<void(const std::string& error)>;
+
+
+    namespace internal
+    {
+        struct StartRequest
+        {
+            pid_t pid;
+            std::string unit;
+            StartCallback done;
+            unsigned int checks = 0;
+        };
+
+
+        /**
+         *  systemd moves the process into the scope when the start job
+         *  runs, which may be just after the StartTransientUnit reply.
+         *  The process is held back until it is in the scope, so the
+         *  processes it starts end up there as well.
+         */
+        static inline bool in_scope(const StartRequest& req)
+        {
+            std::ifstream cg("/proc/" + std::to_string(req.pid) + "/cgroup");
+            std::string line;
+            while (std::getline(cg, line))
+            {
+                if (line.find("/" + req.unit) != std::string::npos)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+
+        static inline gboolean check_moved(gpointer req_ptr)
+        {
+            auto req = static_cast<StartRequest *>(req_ptr);
+            if (in_scope(*req))
+            {
+                req->done("");
+                delete req;
+                return G_SOURCE_REMOVE;
+            }
+            if (++req->checks >= 100)
+            {
+                req->done("Process was not moved to " + req->unit);
+                delete req;
+                return G_SOURCE_REMOVE;
+            }
+            return G_SOURCE_CONTINUE;
+        }
+
+
+        static inline void start_done(GObject *source, GAsyncResult *result,
+                                      gpointer req_ptr)
+        {
+            std::unique_ptr<StartRequest> req(static_cast<StartRequest *>(req_ptr));
+            GError *err = nullptr;
+            GVariant *res = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                          result, &err);
+            if (!res)
+            {
+                std::string msg(err ? err->message : "(unknown)");
+                if (err)
+                {
+                    g_error_free(err);
+                }
+                req->done("Could not start " + req->unit + ": " + msg);
+                return;
+            }
+            g_variant_unref(res);
+
+            if (in_scope(*req))
+            {
+                req->done("");
+                return;
+            }
+            g_timeout_add(10, check_moved, req.release());
+        }
+    } // namespace internal
+
+
+    /**
+     *  Starts a transient scope unit containing a process.  The call is
+     *  asynchronous; the callback is always called, also on errors.
+     *
+     *  Starting units requires the org.freedesktop.systemd1.manage-units
+     *  polkit permission when not running as root.
+     *
+     * @param conn  GDBusConnection to the system bus
+     * @param pid   Process to move into the new scope
+     * @param rc    ResourceControl settings of the scope
+     * @param done  StartCallback called when the process is in the scope
+     */
+    static inline void Start(GDBusConnection *conn, pid_t pid,
+                             const ResourceControl& rc, StartCallback done)
+    {
+        auto req = new internal::StartRequest{pid, UnitName(pid), std::move(done)};
+
+        GVariantBuilder *props = g_variant_builder_new(G_VARIANT_TYPE("a(sv)"));
+        GVariantBuilder *pids = g_variant_builder_new(G_VARIANT_TYPE("au"));
+        g_variant_builder_add(pids, "u", (guint32) pid);
+        g_variant_builder_add(props, "(sv)", "PIDs",
+                              g_variant_builder_end(pids));
+        g_variant_builder_unref(pids);
+        g_variant_builder_add(props, "(sv)", "Description",
+                              g_variant_new_string("OpenVPN 3 client backend"));
+        g_variant_builder_add(props, "(sv)", "CollectMode",
+                              g_variant_new_string("inactive-or-failed"));
+        AddProperties(props, rc);
+
+        g_dbus_connection_call(conn,
+                               "org.freedesktop.systemd1",
+                               "/org/freedesktop/systemd1",
+                               "org.freedesktop.systemd1.Manager",
+                               "StartTransientUnit",
+                               g_variant_new("(ssa(sv)a(sa(sv)))",
+                                             req->unit.c_str(), "fail",
+                                             props, nullptr),
+                               G_VARIANT_TYPE("(o)"),
+                               G_DBUS_CALL_FLAGS_NONE,
+                               -1, nullptr,
+                               internal::start_done, req);
+        g_variant_builder_unref(props);
+    }
+
+
+    /**
+     *  Changes the resource control settings of the scope the calling
+     *  process runs in.  Only scopes started by Start() are changed.
+     *  Throws ResourceControlException on errors.
+     *
+     * @param conn  GDBusConnection to the system bus
+     * @param rc    ResourceControl settings to set
+     *
+     * @return Returns the name of the scope unit which was changed
+     */
+    static inline std::string Update(GDBusConnection *conn,
+                                     const ResourceControl& rc)
+    {
+        auto call = [conn](const std::string& path, const std::string& intf,
+                           const std::string& method, GVariant *params,
+                           const GVariantType *ret_type) -> GVariant *
+                    {
+                        GError *err = nullptr;
+                        GVariant *r = g_dbus_connection_call_sync(conn,
+                                                                  "org.freedesktop.systemd1",
+                                                                  path.c_str(),
+                                                                  intf.c_str(),
+                                                                  method.c_str(),
+                                                                  params, ret_type,
+                                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                                  -1, nullptr, &err);
+                        if (!r)
+                        {
+                            std::string msg(err ? err->message : "(unknown)");
+                            if (err)
+                            {
+                                g_error_free(err);
+                            }
+                            throw ResourceControlException(method + " failed: " + msg);
+                        }
+                        return r;
+                    };
+
+        // systemd looks up the unit of the caller when the PID is 0
+        GVariant *r = call("/org/freedesktop/systemd1",
+                           "org.freedesktop.systemd1.Manager", "GetUnitByPID",
+                           g_variant_new("(u)", 0), G_VARIANT_TYPE("(o)"));
+        gchar *path = nullptr;
+        g_variant_get(r, "(o)", &path);
+        g_variant_unref(r);
+        std::string unit_path(path);
+        g_free(path);
+
+        r = call(unit_path, "org.freedesktop.DBus.Properties", "Get",
+                 g_variant_new("(ss)", "org.freedesktop.systemd1.Unit", "Id"),
+                 G_VARIANT_TYPE("(v)"));
+        GVariant *id = nullptr;
+        g_variant_get(r, "(v)", &id);
+        std::string unit(g_variant_get_string(id, nullptr));
+        g_variant_unref(id);
+        g_variant_unref(r);
+        if (0 != unit.compare(0, unit_prefix.size(), unit_prefix))
+        {
+            throw ResourceControlException("Not running in a backend scope unit ("
+                                           + unit + ")");
+        }
+
+        GVariantBuilder *props = g_variant_builder_new(G_VARIANT_TYPE("a(sv)"));
+        AddProperties(props, rc);
+        r = call(unit_path, "org.freedesktop.systemd1.Unit", "SetProperties",
+                 g_variant_new("(ba(sv))", TRUE, props), nullptr);
+        g_variant_builder_unref(props);
+        g_variant_unref(r);
+        return unit;
+    }
+} // namespace BackendScope
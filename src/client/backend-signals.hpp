@@ -26,10 +26,17 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <sstream>
 #include <openvpn/common/rc.hpp>
 
+#include "common/connect-timing.hpp"
+#include "client/status-coalescer.hpp"
+#include "dbus/peer-link.hpp"
 #include "log/dbus-log.hpp"
+#include "log/log-fd-sink.hpp"
 #include "log/logwriter.hpp"
 
 
@@ -40,14 +47,44 @@ class BackendSignals : public LogSender,
 public:
     typedef RCPtr<BackendSignals> Ptr;
     BackendSignals(GDBusConnection *conn, LogGroup lgroup,
-                   std::string session_token, LogWriter *logwr)
+                   std::string session_token, LogWriter *logwr,
+                   const std::string& objpath = OpenVPN3DBus_rootp_backends_session)
         : LogSender(conn, lgroup, OpenVPN3DBus_interf_backends,
-                    OpenVPN3DBus_rootp_backends_session, logwr),
+                    objpath, logwr),
           DBusConnectionCreds(conn),
           session_token(session_token)
     {
         SetLogLevel(default_log_level);
         configure_signal_targets();
+
+        // A restarted session manager has a new unique bus name; it
+        // takes over this session from the previous one
+        sessionmgr_watch = g_bus_watch_name_on_connection(conn,
+                                                          OpenVPN3DBus_name_sessions.c_str(),
+                                                          G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                          sessionmgr_appeared,
+                                                          nullptr,
+                                                          this, nullptr);
+    }
+
+    ~BackendSignals()
+    {
+        {
+            std::lock_guard<std::mutex> lg(status_mtx);
+            if (0 != status_flush_timer)
+            {
+                g_source_remove(status_flush_timer);
+                status_flush_timer = 0;
+            }
+        }
+        if (0 != sessionmgr_watch)
+        {
+            g_bus_unwatch_name(sessionmgr_watch);
+        }
+        if (delayed_shutdown && delayed_shutdown->joinable())
+        {
+            delayed_shutdown->detach();
+        }
     }
 
     void EnableBroadcast(bool brdcst) noexcept
@@ -66,6 +103,22 @@ public:
         set_object_path(session_path);
     }
 
+
+    /**
+     *  Sends the StatusChange, AttentionRequired and Statistics signals
+     *  over a private connection to the session manager instead of the
+     *  system bus, see DBusPeerLink.  If the link is closed, these
+     *  signals are sent over the system bus again.  Log signals are
+     *  always sent over the system bus, as they are for the log service.
+     *
+     * @param link  DBusPeerLink::Ptr to the session manager link, nullptr
+     *              to stop using it
+     */
+    void SetPeerLink(DBusPeerLink::Ptr link)
+    {
+        peer_link = std::move(link);
+    }
+
     const std::string GetLogIntrospection() override
     {
         return LogEvent::GetIntrospection("Log", true);
@@ -79,11 +132,124 @@ public:
      */
     void Log(const LogEvent& logev, bool duplicate_check = false, const std::string& target = "") final
     {
+        if (!LogEnabled(logev.category))
+        {
+            return;
+        }
+        if (logev.category >= LogCategory::ERROR)
+        {
+            FlightRecorderTrigger(LogCategory_str[(uint8_t) logev.category]
+                                  + " log event");
+        }
         LogEvent l(logev, session_token);
         LogSender::Log(l, duplicate_check, logger_busname);
     }
 
 
+    /**
+     *  Writes the log events of this session directly to a log sink
+     *  provided by the log service.  Only log events of the INFO
+     *  category and more severe are still sent as Log signals; the
+     *  more verbose ones are only written to the sink.
+     *
+     * @param sink  LogFdSink::Ptr to write to, nullptr to send all log
+     *              events as Log signals again
+     */
+    void SetDirectSink(LogFdSink::Ptr sink) noexcept
+    {
+        std::atomic_store(&direct_sink, sink);
+    }
+
+
+    /**
+     *  Enables the flight recorder mode.  The log history records all
+     *  log events regardless of the log level, without sending them.
+     *  In flight recorder mode, the recorded log events which were
+     *  hidden by the log level are sent to the log service when
+     *  something goes wrong, see FlightRecorderTrigger().  This gives
+     *  the details leading up to a failure without running the session
+     *  at a high log level.
+     *
+     * @param enable  bool, true to enable the flight recorder mode
+     */
+    void EnableFlightRecorder(bool enable) noexcept
+    {
+        flight_recorder = enable;
+    }
+
+
+    /**
+     *  Dumps the log history if the flight recorder mode is enabled.
+     *  This is called on errors, authentication failures and reconnect
+     *  loops.
+     *
+     * @param reason  std::string describing what triggered the dump
+     */
+    void FlightRecorderTrigger(const std::string& reason)
+    {
+        if (flight_recorder)
+        {
+            DumpLogHistory(reason);
+        }
+    }
+
+
+    /**
+     *  Sends the log events recorded since the previous dump which were
+     *  not sent as Log signals due to the log level.  They are sent to
+     *  the log service with their original log category, between two
+     *  informational log events marking the dump.
+     *
+     * @param reason  std::string describing why the log history is dumped
+     *
+     * @return Returns the number of recorded log events sent
+     */
+    size_t DumpLogHistory(const std::string& reason)
+    {
+        std::lock_guard<std::mutex> guard(dump_mtx);
+        std::vector<LogEvent> hidden;
+        for (auto& ev : GetLogHistorySince(dump_position))
+        {
+            if (!LogFilterAllow(ev))
+            {
+                hidden.push_back(std::move(ev));
+            }
+        }
+        if (hidden.empty())
+        {
+            return 0;
+        }
+
+        LogEvent start(log_group, LogCategory::INFO,
+                       "Flight recorder: " + std::to_string(hidden.size())
+                       + " log events leading up to " + reason);
+        send_log(LogEvent(start, session_token), logger_busname);
+        for (const auto& ev : hidden)
+        {
+            send_log(ev, logger_busname);
+        }
+        LogEvent end(log_group, LogCategory::INFO,
+                     "Flight recorder: end of recorded log events");
+        send_log(LogEvent(end, session_token), logger_busname);
+        return hidden.size();
+    }
+
+
+    /**
+     *  Sets the function called by LogFATAL() instead of stopping the
+     *  whole process.  This is used when a process hosts several VPN
+     *  sessions and only the failing session should be stopped.
+     *
+     *  The function is called from a separate thread.
+     *
+     * @param handler  std::function to call; nullptr restores the default
+     */
+    void SetFatalHandler(std::function<void()> handler)
+    {
+        fatal_handler = std::move(handler);
+    }
+
+
     /**
      * Sends a FATAL log messages and kills itself
      *
@@ -94,16 +260,42 @@ public:
         Log(LogEvent(log_group, LogCategory::FATAL, msg));
         // This is essentially a glib2 hack, to allow on going signals to
         // be properly sent before we shut down.
-        delayed_shutdown.reset(new std::thread([]()
+        std::function<void()> handler = fatal_handler;
+        delayed_shutdown.reset(new std::thread([handler]()
                 {
                     sleep(3);
+                    if (handler)
+                    {
+                        handler();
+                        return;
+                    }
                     kill(getpid(), SIGHUP);
                 }
         ));
     }
 
     /**
-     * Sends a StatusChange signal
+     *  Sends all StatusChange signals, instead of coalescing the
+     *  transient connecting and reconnecting states, see StatusCoalescer.
+     *
+     * @param enable  bool, true to send every status change
+     */
+    void SetStatusFullFidelity(const bool enable)
+    {
+        std::lock_guard<std::mutex> lg(status_mtx);
+        status_coalescer.SetFullFidelity(enable);
+    }
+
+
+    /**
+     * Sends a StatusChange signal.  The signal is only sent to the session
+     * manager, which emits it again from the session object for both the
+     * log service and the front-ends.
+     *
+     * Transient connecting and reconnecting states following each other
+     * quickly are coalesced, see StatusCoalescer.  A held back state is
+     * sent from the main loop when its window ends.  The status property
+     * is always updated.
      *
      * @param major  StatusMajor type of the status change
      * @param minor  StatusMinor type of the status change
@@ -112,11 +304,16 @@ public:
      */
     void StatusChange(const StatusMajor major, const StatusMinor minor, std::string msg)
     {
+        std::lock_guard<std::mutex> lg(status_mtx);
         status.major = major;
         status.minor = minor;
         status.message = msg;
-        SendTarget(sessionmgr_busname, "StatusChange", status.GetGVariantTuple());
-        SendTarget(logger_busname, "StatusChange", status.GetGVariantTuple());
+        send_status(status_coalescer.Add({major, minor, msg}));
+        if (status_coalescer.HasPending() && 0 == status_flush_timer)
+        {
+            status_flush_timer = g_timeout_add(status_coalescer.GetFlushDelay().count(),
+                                               status_flush_cb, this);
+        }
     }
 
     /**
@@ -143,9 +340,61 @@ public:
                       std::string msg)
     {
         GVariant *params = g_variant_new("(uus)", (guint) att_type, (guint) att_group, msg.c_str());
-        SendTarget(sessionmgr_busname, "AttentionRequired", params);
+        send_to_sessionmgr("AttentionRequired", params);
     }
 
+    /**
+     *  Sends a Statistics signal with a snapshot of all the connection
+     *  statistics counters, in the order given by the statistics_layout
+     *  property.
+     *
+     * @param layout_id  uint32_t identifying the counter layout used
+     * @param counters   GVariant 'at' array of all the counter values
+     */
+    void Statistics(const uint32_t layout_id, GVariant *counters)
+    {
+        send_to_sessionmgr("Statistics",
+                           g_variant_new("(u@at)", layout_id, counters));
+    }
+
+
+    /**
+     *  Sends a RemoteStatus signal with the outcome of a connection
+     *  attempt to a remote server.  The session manager shares this
+     *  with the other sessions, see SetRemoteBackoff.
+     *
+     * @param remote     std::string identifying the remote server
+     * @param reachable  bool, true if the connection was established
+     */
+    void RemoteStatus(const std::string& remote, bool reachable)
+    {
+        send_to_sessionmgr("RemoteStatus",
+                           g_variant_new("(sb)", remote.c_str(), reachable));
+    }
+
+
+    /**
+     *  Sends a SessionName signal with the session name given by the
+     *  server, so the session manager does not need to query it.
+     *
+     * @param name  std::string with the session name
+     */
+    void SessionName(const std::string& name)
+    {
+        send_to_sessionmgr("SessionName", g_variant_new("(s)", name.c_str()));
+    }
+
+
+    /**
+     *  Connect phase milestones of this session.  Recorded by the
+     *  backend client object, the VPN client and the tun builder.
+     */
+    ConnectTiming& Timing() noexcept
+    {
+        return timing;
+    }
+
+
     /**
      *  Retrieve the last status message processed
      *
@@ -167,13 +416,139 @@ private:
     bool broadcast = false;
     std::string session_token;
     std::string sessionmgr_busname = {};
+    std::mutex sessionmgr_busname_mtx;
+    guint sessionmgr_watch = 0;
     std::string logger_busname = {};
     StatusEvent status;
+    StatusCoalescer status_coalescer;
+    std::mutex status_mtx;
+    guint status_flush_timer = 0;
+    ConnectTiming timing;
     std::unique_ptr<std::thread> delayed_shutdown;
+    std::function<void()> fatal_handler = nullptr;
+    DBusPeerLink::Ptr peer_link = nullptr;
+    std::atomic<bool> flight_recorder{false};
+    std::mutex dump_mtx;
+    uint64_t dump_position = 0;
+    LogFdSink::Ptr direct_sink = nullptr;
+
+
+    void send_log(const LogEvent& logev, const std::string& target) override
+    {
+        LogFdSink::Ptr sink = std::atomic_load(&direct_sink);
+        if (!sink)
+        {
+            LogSender::send_log(logev, target);
+            return;
+        }
+
+        sink->Write(logev.category, logev.group, logev.message);
+        if (logev.category >= LogCategory::INFO)
+        {
+            LogSender::send_log(logev, target);
+        }
+        else if (logwr)
+        {
+            logwr->Write(logev);
+        }
+    }
+
+
+    /**
+     *  Sends a signal only meant for the session manager, preferably
+     *  over the peer link.  Takes the ownership of params.
+     */
+    void send_to_sessionmgr(const std::string& signame, GVariant *params)
+    {
+        if (!broadcast && peer_link && peer_link->IsOpen())
+        {
+            g_variant_ref_sink(params);
+            gboolean ret = g_dbus_connection_emit_signal(peer_link->GetConnection(),
+                                                         nullptr,
+                                                         get_object_path().c_str(),
+                                                         get_interface().c_str(),
+                                                         signame.c_str(),
+                                                         params,
+                                                         nullptr);
+            if (ret)
+            {
+                g_variant_unref(params);
+                return;
+            }
+            // The link went away; fall back to the system bus
+            peer_link.reset();
+            SendTarget(get_sessionmgr_busname(), signame, params);
+            g_variant_unref(params);
+            return;
+        }
+        SendTarget(get_sessionmgr_busname(), signame, params);
+    }
+
+
+    /**
+     *  Sends the StatusChange signals released by the StatusCoalescer.
+     *  The caller must hold status_mtx.
+     */
+    void send_status(const std::vector<StatusCoalescer::Status>& list)
+    {
+        for (const auto& st : list)
+        {
+            StatusEvent ev(st.major, st.minor, st.message);
+            send_to_sessionmgr("StatusChange", ev.GetGVariantTuple());
+        }
+    }
+
+
+    /**
+     *  Main loop callback sending a held back StatusChange signal
+     */
+    static gboolean status_flush_cb(gpointer this_ptr)
+    {
+        BackendSignals *self = static_cast<BackendSignals *>(this_ptr);
+        std::lock_guard<std::mutex> lg(self->status_mtx);
+        self->send_status(self->status_coalescer.Flush());
+        if (self->status_coalescer.HasPending())
+        {
+            // Not due yet; the window was extended
+            self->status_flush_timer = g_timeout_add(self->status_coalescer.GetFlushDelay().count(),
+                                                     status_flush_cb, this_ptr);
+        }
+        else
+        {
+            self->status_flush_timer = 0;
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+
+    std::string get_sessionmgr_busname()
+    {
+        std::lock_guard<std::mutex> lg(sessionmgr_busname_mtx);
+        return sessionmgr_busname;
+    }
+
+
+    /**
+     *  Called when the session manager bus name gets an owner, which
+     *  happens right away and again if the session manager restarts
+     */
+    static void sessionmgr_appeared(GDBusConnection *conn,
+                                    const gchar *name,
+                                    const gchar *name_owner,
+                                    gpointer this_ptr)
+    {
+        BackendSignals *self = static_cast<BackendSignals *>(this_ptr);
+        if (!self->broadcast)
+        {
+            std::lock_guard<std::mutex> lg(self->sessionmgr_busname_mtx);
+            self->sessionmgr_busname = name_owner;
+        }
+    }
 
 
     void configure_signal_targets()
     {
+        std::lock_guard<std::mutex> lg(sessionmgr_busname_mtx);
         if (!broadcast)
         {
             sessionmgr_busname = GetUniqueBusID(OpenVPN3DBus_name_sessions);
@@ -185,5 +560,8 @@ private:
             logger_busname = {};
         }
 
+        // Log signals only carry the log fields when they are sent to
+        // the log service alone
+        SendLogFields(!logger_busname.empty());
     }
 };
@@ -27,11 +27,26 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
 #include <openvpn/tun/builder/base.hpp>
 
 #include "netcfg/proxy-netcfg-device.hpp"
 #include "netcfg/proxy-netcfg-mgr.hpp"
+#include "netcfg/cpu-steering.hpp"
+#include "netcfg/queue-discipline.hpp"
+#include "common/numa-topology.hpp"
+#include "common/thread-scheduling.hpp"
 #include "backend-signals.hpp"
+#include "path-mtu.hpp"
+#include "path-quality.hpp"
+#include "statistics.hpp"
 
 using namespace openvpn;
 
@@ -67,6 +82,9 @@ public:
 
     ~NetCfgTunBuilder()
     {
+        stop_path_mtu_discovery();
+        stop_path_quality_probe();
+
         // Explicitly call cleanup
         try
         {
@@ -95,9 +113,20 @@ public:
 
     bool tun_builder_new() override
     {
+        devconfig = NetCfgProxy::DeviceConfig();
+        if (keep_device && device)
+        {
+            // The device kept by tun_builder_teardown() is reconfigured
+            // by tun_builder_establish().  Only the settings which
+            // changed are applied by the netcfg service.
+            keep_device = false;
+            signal->LogVerb2("Reusing virtual network device "
+                             + device->GetProxyPath());
+            return true;
+        }
+
         // Cleanup the old things
         tun_builder_teardown(true);
-        networks.clear();
 
         return create_device();
     }
@@ -105,11 +134,8 @@ public:
 
     bool tun_builder_set_remote_address(const std::string& address, bool ipv6) override
     {
-        if (!device)
-        {
-            throw NetCfgProxyException(__func__, "Lost link to device interface");
-        }
-        device->SetRemoteAddress(address, ipv6);
+        devconfig.remote_address = address;
+        devconfig.remote_ipv6 = ipv6;
         return true;
     }
 
@@ -120,47 +146,24 @@ public:
                                  bool ipv6,
                                  bool net30) override
     {
-        /* We ignore net30 and gateway here for now */
-        try
-        {
-            if (!device)
-            {
-                throw NetCfgProxyException(__func__, "Lost link to device interface");
-            }
-            device->AddIPAddress(address, (unsigned int)prefix_length, gateway, ipv6);
-            return true;
-        }
-        catch (NetCfgProxyException& e)
-        {
-            std::stringstream err;
-            err << "Error adding IP address " << address
-                << "/" << std::to_string(prefix_length)
-                << " to " << (device ? device->GetDeviceName() : "[unkown]")
-                << ": " << std::string(e.what());
-            signal->LogError(err.str());
-            return false;
-        }
+        /* We ignore net30 here for now */
+        devconfig.addresses.emplace_back(NetCfgProxy::IPAddress(address,
+                                                                (unsigned int) prefix_length,
+                                                                gateway, ipv6));
+        return true;
     }
 
 
     bool tun_builder_set_layer(int layer) override
     {
-        if (!device)
-        {
-            throw NetCfgProxyException(__func__, "Lost link to device interface");
-        }
-        device->SetLayer(layer);
+        devconfig.layer = layer;
         return true;
     }
 
 
     bool tun_builder_set_mtu(int mtu) override
     {
-        if (!device)
-        {
-            throw NetCfgProxyException(__func__, "Lost link to device interface");
-        }
-        device->SetMtu(mtu);
+        devconfig.mtu = mtu;
         return true;
     }
 
@@ -169,13 +172,6 @@ public:
                                 bool ipv6,
                                 unsigned int flags) override
     {
-        const std::vector<NetCfgProxy::Network> defaultRoutes;
-
-        if (!device)
-        {
-            throw NetCfgProxyException(__func__, "Lost link to device interface");
-        }
-
         /*
          * We add default routes and let the other side figure
          * out the details how to implement this
@@ -185,11 +181,11 @@ public:
 
         if (ipv4)
         {
-            device->SetRerouteGw(false, true);
+            devconfig.reroute_ipv4 = true;
         }
         if (ipv6)
         {
-            device->SetRerouteGw(true, true);
+            devconfig.reroute_ipv6 = true;
         }
         return true;
     }
@@ -203,7 +199,7 @@ public:
         /* We ignore metric */
         /* Instead calling the proxy for each network individually we collect them
          * to save context switching/rpc overhead */
-        networks.emplace_back(NetCfgProxy::Network(address, prefix_length, ipv6));
+        devconfig.networks.emplace_back(NetCfgProxy::Network(address, prefix_length, ipv6));
         return true;
     }
 
@@ -213,9 +209,9 @@ public:
                                    int metric,
                                    bool ipv6) override
     {
-        networks.emplace_back(NetCfgProxy::Network(address,
-                                                   (unsigned int) prefix_length,
-                                                   ipv6, true));
+        devconfig.networks.emplace_back(NetCfgProxy::Network(address,
+                                                             (unsigned int) prefix_length,
+                                                             ipv6, true));
         return true;
     }
 
@@ -226,13 +222,7 @@ public:
         {
             return true;
         }
-        if (!device)
-        {
-            throw NetCfgProxyException(__func__, "Lost link to device interface");
-        }
-
-        const std::vector<std::string> dnsserver{{address}};
-        device->AddDNS(dnsserver);
+        devconfig.dns_servers.push_back(address);
         return true;
     }
 
@@ -243,13 +233,7 @@ public:
         {
             return true;
         }
-        if (!device)
-        {
-            throw NetCfgProxyException(__func__, "Lost link to device interface");
-        }
-
-        const std::vector<std::string> dnsdomain{{domain}};
-        device->AddDNSSearch(dnsdomain);
+        devconfig.dns_search.push_back(domain);
         return true;
     }
 
@@ -261,14 +245,24 @@ public:
             throw NetCfgProxyException(__func__, "Lost link to device interface");
         }
 
-        // Set all routes in one go to avoid calling the function multiple
-        // times
-        device->AddNetworks(networks);
-
+        // All the collected settings are applied and the device is
+        // established in a single D-Bus call
+        devconfig.rps_cpus = cpu_steering.rps_cpus;
+        devconfig.xps_cpus = cpu_steering.xps_cpus;
+        devconfig.rps_flow_cnt = cpu_steering.rps_flow_cnt;
+        devconfig.qdisc = queueing.qdisc;
+        devconfig.qdisc_bandwidth = queueing.bandwidth;
+        devconfig.txqueuelen = queueing.txqueuelen;
         int ret = -1;
         try
         {
-            ret = device->Establish();
+            signal->Timing().Mark("netcfg_apply");
+            ret = device->ApplyConfiguration(devconfig);
+            signal->Timing().Mark("netcfg_established");
+            follow_device_steering();
+            follow_numa_node();
+            start_path_mtu_discovery();
+            start_path_quality_probe();
         }
         catch (const DBusProxyAccessDeniedException& excp)
         {
@@ -280,7 +274,7 @@ public:
             catch (...)
             {
             }
-            signal->LogFATAL("Access denied calling NetCfgDevice::Establish(): " +
+            signal->LogFATAL("Access denied calling NetCfgDevice::ApplyConfiguration(): " +
                                 std::string(excp.what()));
         }
         catch (const DBusException& excp)
@@ -293,7 +287,7 @@ public:
             catch (...)
             {
             }
-            signal->LogFATAL("Error calling NetCfgDevice::Establish(): " +
+            signal->LogFATAL("Error calling NetCfgDevice::ApplyConfiguration(): " +
                                 std::string(excp.what()));
         }
         return ret;
@@ -309,14 +303,30 @@ public:
 
     void tun_builder_teardown(bool disconnect) override
     {
+        stop_path_mtu_discovery();
+        stop_path_quality_probe();
+        keep_device = false;
         if (!device)
         {
             return;
         }
 
+        // On reconnects, the device may be kept for the next
+        // tun_builder_new() call.  DCO devices are always re-created,
+        // as the DCO state is tied to the peer of the old connection.
+        bool keep = (reuse_device && !disconnect);
 #ifdef ENABLE_OVPNDCO
-        dco.reset();
+        {
+            std::lock_guard<std::mutex> guard(dco_mtx);
+            keep = keep && !dco;
+            dco.reset();
+        }
 #endif
+        if (keep)
+        {
+            keep_device = true;
+            return;
+        }
 
         if (disconnect)
         {
@@ -365,6 +375,7 @@ public:
     {
         signal->LogVerb2("Session name: '" + name + "'");
         session_name = std::string(name);
+        signal->SessionName(session_name);
         return true;
     }
 
@@ -386,6 +397,12 @@ public:
         return (device ? device->GetDeviceName() : "");
     }
 
+
+    std::vector<std::string> netcfg_resolve_remote(const std::string& host)
+    {
+        return netcfgmgr.ResolveRemote(host);
+    }
+
 #ifdef ENABLE_OVPNDCO
     bool tun_builder_dco_available() override
     {
@@ -402,6 +419,7 @@ public:
 
         try
         {
+            std::lock_guard<std::mutex> guard(dco_mtx);
             if (!dco)
             {
                 dco.reset(device->EnableDCO(dev_name));
@@ -424,6 +442,7 @@ public:
         }
 
         dco->NewPeer(peer_id, transport_fd, sa, salen, vpn4, vpn6);
+        dco_keepalive_set = false;
     }
 
     void tun_builder_dco_new_key(unsigned int key_slot, const KoRekey::KeyConfig* kc) override
@@ -448,8 +467,9 @@ public:
             NetCfgProxyException(__func__, "Lost link to DCO device");
         }
 
-        device->AddNetworks(networks);
-        device->EstablishDCO();
+        device->ApplyConfigurationDCO(devconfig);
+        start_path_mtu_discovery();
+        start_path_quality_probe();
     }
 
     void tun_builder_dco_swap_keys(uint32_t peer_id) override
@@ -469,13 +489,130 @@ public:
             NetCfgProxyException(__func__, "Lost link to DCO device");
         }
 
+        // The kernel module runs the keep-alive on its own once it is
+        // programmed; repeating the same settings only costs a D-Bus
+        // and a netlink round trip
+        if (dco_keepalive_set
+            && dco_keepalive.peer_id == peer_id
+            && dco_keepalive.interval == keepalive_interval
+            && dco_keepalive.timeout == keepalive_timeout)
+        {
+            return;
+        }
         dco->SetPeer(peer_id, keepalive_interval, keepalive_timeout);
+        dco_keepalive = {peer_id, keepalive_interval, keepalive_timeout};
+        dco_keepalive_set = true;
+    }
+
+
+    /**
+     *  Retrieves the data channel counters kept by the ovpn-dco kernel
+     *  module.  With DCO, the data channel traffic never reaches the
+     *  OpenVPN 3 Core library, so these are not part of its statistics.
+     *
+     *  The names follow the Core library: DCO_BYTES_* and DCO_PACKETS_*
+     *  count the encrypted traffic to and from the remote server, while
+     *  DCO_TUN_*_IN counts traffic entering the tunnel and DCO_TUN_*_OUT
+     *  traffic leaving it.  The DCO_WORKER_* counters are the CPU usage
+     *  of the netcfg thread serving all the ovpn-dco devices.
+     *
+     * @return Returns ConnectionStats with the non-zero counters, empty
+     *         if DCO is not in use or the counters are not available
+     */
+    ConnectionStats GetDCOStats()
+    {
+        std::lock_guard<std::mutex> guard(dco_mtx);
+        if (!dco)
+        {
+            return ConnectionStats();
+        }
+
+        NetCfgProxy::DCOPeerStats sum;
+        try
+        {
+            for (const auto& p : dco->GetPeerStats())
+            {
+                sum.vpn_rx_bytes += p.vpn_rx_bytes;
+                sum.vpn_tx_bytes += p.vpn_tx_bytes;
+                sum.vpn_rx_packets += p.vpn_rx_packets;
+                sum.vpn_tx_packets += p.vpn_tx_packets;
+                sum.link_rx_bytes += p.link_rx_bytes;
+                sum.link_tx_bytes += p.link_tx_bytes;
+                sum.link_rx_packets += p.link_rx_packets;
+                sum.link_tx_packets += p.link_tx_packets;
+            }
+        }
+        catch (const std::exception& excp)
+        {
+            // Older kernel modules do not provide the counters; only
+            // report it once instead of on each statistics request
+            if (!dco_stats_failed)
+            {
+                signal->LogVerb2(std::string("DCO statistics not available: ")
+                                 + excp.what());
+                dco_stats_failed = true;
+            }
+            return ConnectionStats();
+        }
+
+        ConnectionStats stats;
+        auto add = [&stats](const char *key, const uint64_t value)
+                   {
+                       if (value > 0)
+                       {
+                           stats.push_back(ConnectionStatDetails(key, value));
+                       }
+                   };
+        add("DCO_BYTES_IN", sum.link_rx_bytes);
+        add("DCO_BYTES_OUT", sum.link_tx_bytes);
+        add("DCO_PACKETS_IN", sum.link_rx_packets);
+        add("DCO_PACKETS_OUT", sum.link_tx_packets);
+        add("DCO_TUN_BYTES_IN", sum.vpn_tx_bytes);
+        add("DCO_TUN_BYTES_OUT", sum.vpn_rx_bytes);
+        add("DCO_TUN_PACKETS_IN", sum.vpn_tx_packets);
+        add("DCO_TUN_PACKETS_OUT", sum.vpn_rx_packets);
+
+        // The netcfg thread serving the ovpn-dco devices is shared by
+        // all the tunnels using DCO
+        try
+        {
+            const auto keys = CpuUsage::GetStatsKeys("DCO_WORKER_");
+            const auto values = dco->GetWorkerUsage().GetStatsValues();
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                add(keys[i].c_str(), values[i]);
+            }
+        }
+        catch (const std::exception& excp)
+        {
+            if (!dco_worker_usage_failed)
+            {
+                signal->LogVerb2(std::string("DCO worker usage not available: ")
+                                 + excp.what());
+                dco_worker_usage_failed = true;
+            }
+        }
+        return stats;
     }
 #endif  // ENABLE_OVPNDCO
 
 protected:
     bool disabled_dns_config;
     std::string dns_scope = "global";
+    bool reuse_device = false;
+    bool path_mtu_discovery = false;
+    bool path_quality_probe = false;
+    PathQuality path_quality;
+    std::string bundle;
+    NetCfg::SteeringSettings cpu_steering;
+    bool follow_device_cpus = false;
+    std::string numa_node;          ///< NUMA node number, "auto" or empty
+    bool numa_pin_cpus = true;      ///< Pin to the CPUs of the NUMA node
+    NetCfg::QueueSettings queueing;
+
+    /// Socket being protected for the path MTU probes, not the
+    /// VPN transport
+    std::atomic<int> probe_socket{-1};
 
 
 private:
@@ -488,6 +625,7 @@ private:
         {
             std::string devpath = netcfgmgr.CreateVirtualInterface(session_token);
             device.reset(netcfgmgr.getVirtualInterface(devpath));
+            signal->Timing().Mark("netcfg_device_created");
             try
             {
                 device->SetProperty("dns_scope", dns_scope);
@@ -497,6 +635,18 @@ private:
                 signal->LogCritical("Failed changing DNS Scope: "
                                     + std::string(excp.GetRawError()));
             }
+            if (!bundle.empty())
+            {
+                try
+                {
+                    device->SetProperty("bundle", bundle);
+                }
+                catch(const DBusException& excp)
+                {
+                    signal->LogError("Failed setting the device bundle: "
+                                     + std::string(excp.GetRawError()));
+                }
+            }
             return true;
         }
         catch (NetCfgProxyException& e)
@@ -506,10 +656,339 @@ private:
         }
     }
 
-    std::vector<NetCfgProxy::Network> networks;
+    /**
+     *  Pins the calling thread, which runs the VPN client, to the CPUs
+     *  the netcfg service steers the traffic of the device to.  This
+     *  keeps the encryption and the packet processing of the device
+     *  on the same CPUs.
+     */
+    void follow_device_steering()
+    {
+        if (!follow_device_cpus)
+        {
+            return;
+        }
+        try
+        {
+            std::string cpus = device->GetSteeringCPUs();
+            if (cpus.empty())
+            {
+                signal->LogWarn("Core thread: the device has no CPU steering "
+                                "to follow");
+                return;
+            }
+            ThreadScheduling sched;
+            sched.SetCPUs(cpus);
+            for (const auto& err : sched.ApplyToCurrentThread())
+            {
+                signal->LogWarn("Core thread: " + err);
+            }
+            signal->LogVerb2("Core thread pinned to the device CPUs " + cpus);
+        }
+        catch (const DBusException& excp)
+        {
+            signal->LogError("Failed reading the device CPU steering: "
+                             + std::string(excp.GetRawError()));
+        }
+        catch (const ThreadSchedulingException& excp)
+        {
+            signal->LogError("Core thread: " + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Runs the calling thread, which runs the VPN client, on a NUMA
+     *  node and allocates its memory there.  With "auto", this is the
+     *  node of the interface the encrypted traffic leaves through, so
+     *  the packets do not cross the interconnect between the nodes.
+     */
+    void follow_numa_node()
+    {
+        if (numa_node.empty())
+        {
+            return;
+        }
+        try
+        {
+            int node = NumaTopology::ParseNode(numa_node);
+            if (node < 0)
+            {
+                std::string egress = device->GetEgressNumaNode();
+                if (egress.empty())
+                {
+                    signal->LogVerb2("Core thread: the egress interface "
+                                     "has no NUMA node");
+                    return;
+                }
+                node = NumaTopology::ParseNode(egress);
+            }
+
+            if (numa_pin_cpus)
+            {
+                std::set<unsigned int> cpus = NumaTopology().NodeCPUs(node);
+                if (cpus.empty())
+                {
+                    signal->LogWarn("Core thread: NUMA node "
+                                    + std::to_string(node) + " does not exist");
+                    return;
+                }
+                ThreadScheduling sched;
+                sched.SetCPUs(NetCfg::CpuSteering::CPUList(cpus));
+                for (const auto& err : sched.ApplyToCurrentThread())
+                {
+                    signal->LogWarn("Core thread: " + err);
+                }
+            }
+            std::string err = NumaTopology::PreferNode(node);
+            if (!err.empty())
+            {
+                signal->LogWarn("Core thread: " + err);
+            }
+            signal->LogVerb2("Core thread placed on NUMA node "
+                             + std::to_string(node));
+        }
+        catch (const DBusException& excp)
+        {
+            signal->LogError("Failed reading the egress NUMA node: "
+                             + std::string(excp.GetRawError()));
+        }
+        catch (const ThreadSchedulingException& excp)
+        {
+            signal->LogError("Core thread: " + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Starts discovering the path MTU to the server in a separate
+     *  thread, if enabled.  The tunnel MTU is adjusted right away and
+     *  checked again periodically until the device is torn down.
+     */
+    void start_path_mtu_discovery()
+    {
+        stop_path_mtu_discovery();
+        if (!path_mtu_discovery || devconfig.remote_address.empty())
+        {
+            return;
+        }
+
+        const std::string remote = devconfig.remote_address;
+        const bool ipv6 = devconfig.remote_ipv6;
+        const unsigned int max_mtu = (devconfig.mtu > 0 ? devconfig.mtu : 1500);
+        pmtu_stop = false;
+        pmtu_thread = std::thread([this, remote, ipv6, max_mtu]()
+                                  {
+                                      path_mtu_worker(remote, ipv6, max_mtu);
+                                  });
+    }
+
+
+    void stop_path_mtu_discovery()
+    {
+        if (!pmtu_thread.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(pmtu_mtx);
+            pmtu_stop = true;
+        }
+        pmtu_cv.notify_all();
+        pmtu_thread.join();
+    }
+
+
+    void path_mtu_worker(const std::string remote, const bool ipv6,
+                         const unsigned int max_mtu)
+    {
+        // How often the path MTU is checked again while connected
+        const std::chrono::minutes interval(10);
+
+        unsigned int applied_mtu = max_mtu;
+        std::unique_lock<std::mutex> lock(pmtu_mtx);
+        while (!pmtu_stop)
+        {
+            lock.unlock();
+            try
+            {
+                // The probes must take the same route as the VPN
+                // transport socket
+                unsigned int pmtu = PathMTU::Probe(remote, ipv6,
+                    [this, &remote, ipv6](int sd)
+                    {
+                        probe_socket = sd;
+                        bool ok = this->socket_protect(sd, remote, ipv6);
+                        probe_socket = -1;
+                        if (!ok)
+                        {
+                            throw PathMTUException("Could not protect the probe socket");
+                        }
+                    });
+                PathMTU::Result res = PathMTU::Calculate(pmtu, ipv6, max_mtu);
+                if (res.tun_mtu != applied_mtu)
+                {
+                    device->AdjustMTU(res.tun_mtu);
+                    applied_mtu = res.tun_mtu;
+                    signal->LogInfo("Path MTU to " + remote + " is "
+                                    + std::to_string(res.path_mtu)
+                                    + ", tunnel MTU set to "
+                                    + std::to_string(res.tun_mtu)
+                                    + " (TCP MSS "
+                                    + std::to_string(res.mssfix) + ")");
+                }
+                else
+                {
+                    signal->LogVerb2("Path MTU to " + remote + " is "
+                                     + std::to_string(res.path_mtu)
+                                     + ", tunnel MTU unchanged");
+                }
+            }
+            catch (const PathMTUException& excp)
+            {
+                signal->LogWarn("Path MTU discovery failed: "
+                                + std::string(excp.what()));
+            }
+            catch (const DBusException& excp)
+            {
+                signal->LogWarn("Adjusting the tunnel MTU failed: "
+                                + std::string(excp.GetRawError()));
+            }
+            catch (const std::exception& excp)
+            {
+                signal->LogWarn("Adjusting the tunnel MTU failed: "
+                                + std::string(excp.what()));
+            }
+            lock.lock();
+            pmtu_cv.wait_for(lock, interval, [this]() { return pmtu_stop; });
+        }
+    }
+
+
+    /**
+     *  Starts probing the round-trip time through the tunnel in a
+     *  separate thread, if enabled.  The probes are sent to the
+     *  gateway of the tunnel, preferring IPv4, and recorded in
+     *  path_quality until the device is torn down.
+     */
+    void start_path_quality_probe()
+    {
+        stop_path_quality_probe();
+        if (!path_quality_probe)
+        {
+            return;
+        }
+
+        std::string gateway;
+        bool ipv6 = false;
+        for (const auto& addr : devconfig.addresses)
+        {
+            if (!addr.gateway.empty() && (gateway.empty() || (ipv6 && !addr.ipv6)))
+            {
+                gateway = addr.gateway;
+                ipv6 = addr.ipv6;
+            }
+        }
+        if (gateway.empty())
+        {
+            signal->LogVerb1("No tunnel gateway; path quality is not measured");
+            return;
+        }
+
+        pq_stop = false;
+        pq_thread = std::thread([this, gateway, ipv6]()
+                                {
+                                    path_quality_worker(gateway, ipv6);
+                                });
+    }
+
+
+    void stop_path_quality_probe()
+    {
+        if (!pq_thread.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(pq_mtx);
+            pq_stop = true;
+        }
+        pq_cv.notify_all();
+        pq_thread.join();
+    }
+
+
+    void path_quality_worker(const std::string gateway, const bool ipv6)
+    {
+        // One probe per interval; a probe not answered within the
+        // interval counts as lost
+        const std::chrono::seconds interval(1);
+
+        std::unique_ptr<PingSocket> ping;
+        try
+        {
+            ping.reset(new PingSocket(gateway, ipv6));
+        }
+        catch (const PathQualityException& excp)
+        {
+            signal->LogWarn("Path quality probes to " + gateway
+                            + " disabled: " + std::string(excp.what()));
+            return;
+        }
+        signal->LogVerb2("Measuring the path quality via " + gateway);
+
+        std::unique_lock<std::mutex> lock(pq_mtx);
+        while (!pq_stop)
+        {
+            lock.unlock();
+            auto next = std::chrono::steady_clock::now() + interval;
+            try
+            {
+                std::chrono::microseconds rtt = ping->Probe(interval);
+                if (rtt.count() < 0)
+                {
+                    path_quality.AddLoss();
+                }
+                else
+                {
+                    path_quality.AddSample(rtt);
+                }
+            }
+            catch (const PathQualityException& excp)
+            {
+                path_quality.AddLoss();
+                signal->Debug("Path quality probe failed: "
+                              + std::string(excp.what()));
+            }
+            lock.lock();
+            pq_cv.wait_until(lock, next, [this]() { return pq_stop; });
+        }
+    }
+
+
+    NetCfgProxy::DeviceConfig devconfig;
     NetCfgProxy::Device::Ptr device;
+    bool keep_device = false;
+    std::thread pmtu_thread;
+    std::mutex pmtu_mtx;
+    std::condition_variable pmtu_cv;
+    bool pmtu_stop = false;
+    std::thread pq_thread;
+    std::mutex pq_mtx;
+    std::condition_variable pq_cv;
+    bool pq_stop = false;
 #ifdef ENABLE_OVPNDCO
     NetCfgProxy::DCO::Ptr dco;
+    std::mutex dco_mtx;  ///< Protects dco against GetDCOStats() callers
+    bool dco_stats_failed = false;
+    bool dco_worker_usage_failed = false;
+    struct
+    {
+        uint32_t peer_id;
+        int interval;
+        int timeout;
+    } dco_keepalive{};      ///< Keep-alive settings programmed into ovpn-dco
+    bool dco_keepalive_set = false;
 #endif
     NetCfgProxy::Manager netcfgmgr;
     BackendSignals *signal;
@@ -30,7 +30,13 @@
 #ifndef OPENVPN3_CORE_CLIENT
 #define OPENVPN3_CORE_CLIENT
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <map>
 #include <thread>
 #include <mutex>
 
@@ -50,7 +56,12 @@
 #include <openvpn/ssl/peerinfo.hpp>
 
 #include "common/core-extensions.hpp"
+#include "common/cpu-usage.hpp"
 #include "backend-signals.hpp"
+#include "heap-trimmer.hpp"
+#include "path-quality.hpp"
+#include "remote-race.hpp"
+#include "socket-buffers.hpp"
 #include "statistics.hpp"
 
 #include "core-client-netcfg.hpp"
@@ -87,9 +98,25 @@ public:
         return "";
     }
 
+    std::vector<std::string> netcfg_resolve_remote(const std::string&)
+    {
+        return {};
+    }
+
 protected:
     bool disabled_dns_config;
     std::string dns_scope = "global";
+    bool reuse_device = false;
+    bool path_mtu_discovery = false;
+    bool path_quality_probe = false;
+    PathQuality path_quality;
+    std::string bundle;
+    NetCfg::SteeringSettings cpu_steering;
+    bool follow_device_cpus = false;
+    std::string numa_node;
+    bool numa_pin_cpus = true;
+    NetCfg::QueueSettings queueing;
+    std::atomic<int> probe_socket{-1};
 
 private:
     std::string session_name;
@@ -143,6 +170,260 @@ public:
         disabled_dns_config = val;
     }
 
+    /**
+     *  Keep the virtual network device across reconnects, instead of
+     *  removing it and creating a new one.
+     *
+     * @param val  bool, true to keep the device
+     */
+    void set_reuse_device(bool val)
+    {
+        reuse_device = val;
+    }
+
+    /**
+     *  CPU steering of the virtual network device, overriding the
+     *  defaults of the netcfg service
+     *
+     * @param settings  NetCfg::SteeringSettings for the device
+     */
+    void set_cpu_steering(const NetCfg::SteeringSettings& settings)
+    {
+        cpu_steering = settings;
+    }
+
+    /**
+     *  Queueing discipline and transmit queue length of the virtual
+     *  network device, overriding the defaults of the netcfg service
+     *
+     * @param settings  NetCfg::QueueSettings for the device
+     */
+    void set_queueing(const NetCfg::QueueSettings& settings)
+    {
+        queueing = settings;
+    }
+
+    /**
+     *  Pin the VPN client thread to the CPUs the traffic of the virtual
+     *  network device is steered to, once it is established
+     *
+     * @param val  bool, true to follow the device CPUs
+     */
+    void set_follow_device_cpus(bool val)
+    {
+        follow_device_cpus = val;
+    }
+
+    /**
+     *  Run the VPN client thread on a NUMA node and allocate its memory
+     *  there, once the virtual network device is established
+     *
+     * @param node      std::string with a node number, "auto" for the
+     *                  node of the egress interface or empty to disable
+     * @param pin_cpus  bool, false to keep the CPU affinity and only
+     *                  set the memory policy
+     */
+    void set_numa_node(const std::string& node, bool pin_cpus)
+    {
+        numa_node = node;
+        numa_pin_cpus = pin_cpus;
+    }
+
+    /**
+     *  Discover the path MTU to the server when the virtual network
+     *  device has been established and periodically afterwards, and
+     *  adjust the MTU of the device to it.
+     *
+     * @param val  bool, true to enable path MTU discovery
+     */
+    void set_path_mtu_discovery(bool val)
+    {
+        path_mtu_discovery = val;
+    }
+
+    /**
+     *  Measure the round-trip time, jitter and loss through the tunnel
+     *  while connected, by sending ICMP echo requests to the tunnel
+     *  gateway.  The results are included in the statistics and
+     *  available via GetPathQuality().
+     *
+     * @param val  bool, true to enable the probes
+     */
+    void set_path_quality_probe(bool val)
+    {
+        path_quality_probe = val;
+    }
+
+    /**
+     *  Adapt the receive and send buffer sizes of the UDP transport
+     *  socket to the observed drops and buffer usage.  This is driven
+     *  by SampleSocketBuffers().
+     *
+     * @param enable  bool, true to enable the adaption
+     * @param limits  SocketBuffers::Limits for the buffer sizes
+     */
+    void set_socket_buffers(bool enable, const SocketBuffers::Limits& limits)
+    {
+        if (enable)
+        {
+            socket_buffers.Enable(limits);
+        }
+    }
+
+    /**
+     *  Enables trimming of the heap after the connection is
+     *  established and when the tunnel has been idle for a while.
+     *
+     * @param enable       bool, true to enable trimming
+     * @param idle_period  How long the tunnel must be idle before the
+     *                     heap is trimmed
+     */
+    void set_low_memory(bool enable, const std::chrono::seconds idle_period)
+    {
+        if (enable)
+        {
+            heap_trimmer.Enable(idle_period);
+        }
+    }
+
+    /**
+     *  Reports the CPU usage counters of a single thread instead of the
+     *  whole process.  Used when the process hosts several sessions,
+     *  each with its own Core library thread.
+     *
+     * @param tid  Thread ID of the Core library thread, 0 to report the
+     *             whole process
+     */
+    void set_cpu_usage_thread(const pid_t tid)
+    {
+        cpu_usage_tid.store(tid);
+    }
+
+    /**
+     *  Trims the heap if the tunnel has been idle for the idle period
+     *  given to set_low_memory().  Intended to be called once per
+     *  second.
+     *
+     * @return Returns true if the heap was trimmed
+     */
+    bool SampleHeap()
+    {
+        // Only the data channel counters of the Core library are
+        // considered; the heap is not touched by the traffic otherwise
+        return heap_trimmer.Sample(core_traffic());
+    }
+
+    /**
+     *  Samples the transport socket and adapts its buffers, if enabled
+     *  by set_socket_buffers().  Intended to be called once per second.
+     *
+     * @return Returns a description of the changes made, empty if none
+     */
+    std::string SampleSocketBuffers()
+    {
+        return socket_buffers.Sample();
+    }
+
+    /**
+     * @return Returns the PathQuality measured through the tunnel
+     */
+    const PathQuality& GetPathQuality() const
+    {
+        return path_quality;
+    }
+
+    /**
+     *  Make the virtual network device part of a bundle of parallel
+     *  sessions.  The routes of the devices in a bundle are shared as
+     *  multipath routes.
+     *
+     * @param name  std::string with the bundle name, empty for none
+     */
+    void set_bundle(const std::string& name)
+    {
+        bundle = name;
+    }
+
+    /**
+     *  Let the remote server for each connection attempt be picked by
+     *  racing the remotes of the profile, instead of the core library
+     *  trying them one at a time.
+     *
+     * @param race  RemoteRace::Ptr with the remotes to race; nullptr
+     *              disables racing
+     */
+    void set_remote_race(RemoteRace::Ptr race)
+    {
+        remote_race = race;
+    }
+
+    /**
+     *  Let the remote host names picked by the RemoteRace be resolved
+     *  by the netcfg service, which shares the results with all the
+     *  VPN sessions.  Only used with set_remote_race().
+     *
+     * @param enable  bool, true to resolve via netcfg
+     */
+    void set_shared_resolver(bool enable)
+    {
+        shared_resolver = enable;
+    }
+
+    /**
+     *  Report the outcome of each connection attempt to the session
+     *  manager and hold back remotes which are failing for all
+     *  sessions.  Only used with set_remote_race().
+     *
+     * @param enable  bool, true to share the remote backoff state
+     */
+    void set_shared_backoff(bool enable)
+    {
+        shared_backoff = enable;
+    }
+
+    /**
+     *  Replaces how long each remote should be held back, as provided
+     *  by the session manager.  A connection attempt waiting for a
+     *  remote is woken up, so a shortened backoff takes effect.
+     *
+     * @param delays  std::map with the delays, indexed by remote key
+     */
+    void set_remote_backoff(const std::map<std::string, std::chrono::milliseconds>& delays)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> guard(backoff_mtx);
+        remote_backoff.clear();
+        for (const auto& d : delays)
+        {
+            remote_backoff[d.first] = now + d.second;
+        }
+        backoff_cv.notify_all();
+    }
+
+    /**
+     *  Stops waiting for a remote which is held back, so a stop, pause
+     *  or restart request is not delayed by it
+     *
+     * @param stopping  bool, true if the client is being stopped; no
+     *                  further waits are done then
+     */
+    void interrupt_backoff_wait(bool stopping = false)
+    {
+        std::lock_guard<std::mutex> guard(backoff_mtx);
+        ++backoff_interrupts;
+        backoff_stopped = backoff_stopped || stopping;
+        backoff_cv.notify_all();
+    }
+
+    /**
+     * @return Returns the key identifying a remote in the backoff
+     *         state shared via the session manager
+     */
+    static std::string RemoteKey(const RaceRemote& r)
+    {
+        return r.host + ":" + r.port + "/" + r.proto;
+    }
+
     /**
      *  Do we have a dynamic challenge?
      *
@@ -200,26 +481,408 @@ public:
                 stats.push_back(s);
             }
         }
+#if defined(USE_TUN_BUILDER) && defined(ENABLE_OVPNDCO)
+        for (const auto& s : CLIENTBASECLASS::GetDCOStats())
+        {
+            stats.push_back(s);
+        }
+#endif
+        const auto& pq_keys = PathQuality::GetStatsKeys();
+        const auto pq_values = path_quality.GetStatsValues();
+        for (size_t i = 0; i < pq_keys.size(); ++i)
+        {
+            if (pq_values[i])
+            {
+                stats.push_back(ConnectionStatDetails(pq_keys[i],
+                                                      (long long) pq_values[i]));
+            }
+        }
+        const auto& sb_keys = SocketBuffers::GetStatsKeys();
+        const auto sb_values = socket_buffers.GetStatsValues();
+        for (size_t i = 0; i < sb_keys.size(); ++i)
+        {
+            if (sb_values[i])
+            {
+                stats.push_back(ConnectionStatDetails(sb_keys[i],
+                                                      (long long) sb_values[i]));
+            }
+        }
+        const auto& heap_keys = HeapTrimmer::GetStatsKeys();
+        const auto heap_values = heap_trimmer.GetStatsValues();
+        for (size_t i = 0; i < heap_keys.size(); ++i)
+        {
+            if (heap_values[i])
+            {
+                stats.push_back(ConnectionStatDetails(heap_keys[i],
+                                                      (long long) heap_values[i]));
+            }
+        }
+        const auto& cpu_keys = GetCPUStatsKeys();
+        const auto cpu_values = get_cpu_stats_values();
+        for (size_t i = 0; i < cpu_keys.size(); ++i)
+        {
+            if (cpu_values[i])
+            {
+                stats.push_back(ConnectionStatDetails(cpu_keys[i],
+                                                      (long long) cpu_values[i]));
+            }
+        }
         return stats;
     }
 
 
+    /**
+     *  Retrieve the names of the CPU usage counters of the process,
+     *  which are always the last counters of GetStatsLayout().
+     *
+     *  CPU_USEC_PER_GB is the user and system time per GiB passed
+     *  through the Core library, BYTES_IN and BYTES_OUT.  With DCO, the
+     *  data channel does not pass through this process; the CPU usage
+     *  of the netcfg thread handling the ovpn-dco devices is reported as
+     *  the DCO_WORKER_* counters instead.
+     *
+     * @return Returns a std::vector<std::string> with the counter names
+     */
+    static const std::vector<std::string>& GetCPUStatsKeys()
+    {
+        static const std::vector<std::string> keys = []()
+            {
+                std::vector<std::string> k = CpuUsage::GetStatsKeys();
+                k.push_back("CPU_USEC_PER_GB");
+                return k;
+            }();
+        return keys;
+    }
+
+
+    /**
+     *  Retrieve the names of all the statistics counters provided by
+     *  the OpenVPN 3 Core library, followed by the path quality, socket
+     *  buffer, heap and CPU usage counters, in the order used by
+     *  GetPackedStats().  This table does not change while the process
+     *  is running.
+     *
+     * @return Returns a std::vector<std::string> with all counter names
+     */
+    static std::vector<std::string> GetStatsLayout()
+    {
+        std::vector<std::string> layout;
+        const int n = stats_n();
+        const auto& pq_keys = PathQuality::GetStatsKeys();
+        const auto& sb_keys = SocketBuffers::GetStatsKeys();
+        const auto& heap_keys = HeapTrimmer::GetStatsKeys();
+        const auto& cpu_keys = GetCPUStatsKeys();
+        layout.reserve(n + pq_keys.size() + sb_keys.size() + heap_keys.size()
+                       + cpu_keys.size());
+        for (int i = 0; i < n; ++i)
+        {
+            layout.push_back(stats_name(i));
+        }
+        layout.insert(layout.end(), pq_keys.begin(), pq_keys.end());
+        layout.insert(layout.end(), sb_keys.begin(), sb_keys.end());
+        layout.insert(layout.end(), heap_keys.begin(), heap_keys.end());
+        layout.insert(layout.end(), cpu_keys.begin(), cpu_keys.end());
+        return layout;
+    }
+
+
+    /**
+     *  Retrieves all the connection statistics counters as a packed
+     *  array, in the order given by GetStatsLayout().  The values are
+     *  read into a buffer kept by this object, so no per-counter
+     *  allocations happens.
+     *
+     * @return Returns a new floating GVariant object as an 'at' array
+     */
+    GVariant * GetPackedStats()
+    {
+        std::lock_guard<std::mutex> guard(packed_stats_mtx);
+        const int n = stats_n();
+        const std::vector<uint64_t> pq_values = path_quality.GetStatsValues();
+        const std::vector<uint64_t> sb_values = socket_buffers.GetStatsValues();
+        const std::vector<uint64_t> heap_values = heap_trimmer.GetStatsValues();
+        const std::vector<uint64_t> cpu_values = get_cpu_stats_values();
+        const size_t size = n + pq_values.size() + sb_values.size()
+                            + heap_values.size() + cpu_values.size();
+        if (packed_stats.size() != size)
+        {
+            packed_stats.resize(size);
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            const long long value = stats_value(i);
+            packed_stats[i] = (value > 0 ? (guint64) value : 0);
+        }
+        auto next = std::copy(pq_values.begin(), pq_values.end(),
+                              packed_stats.begin() + n);
+        next = std::copy(sb_values.begin(), sb_values.end(), next);
+        next = std::copy(heap_values.begin(), heap_values.end(), next);
+        std::copy(cpu_values.begin(), cpu_values.end(), next);
+        return g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64,
+                                         packed_stats.data(),
+                                         packed_stats.size(),
+                                         sizeof(guint64));
+    }
+
+
 protected:
 
 
 private:
+    /**
+     * @return Returns the data channel traffic through the Core library,
+     *         BYTES_IN and BYTES_OUT together
+     */
+    uint64_t core_traffic() const
+    {
+        static const std::vector<int> traffic_idx = []()
+            {
+                std::vector<int> idx;
+                for (int i = 0; i < stats_n(); ++i)
+                {
+                    const std::string name = stats_name(i);
+                    if ("BYTES_IN" == name || "BYTES_OUT" == name)
+                    {
+                        idx.push_back(i);
+                    }
+                }
+                return idx;
+            }();
+
+        uint64_t traffic = 0;
+        for (const int i : traffic_idx)
+        {
+            traffic += (uint64_t) stats_value(i);
+        }
+        return traffic;
+    }
+
+
+    /**
+     * @return Returns the CPU usage counters of the process, or of the
+     *         Core library thread given to set_cpu_usage_thread(), in
+     *         the order of GetCPUStatsKeys()
+     */
+    std::vector<uint64_t> get_cpu_stats_values() const
+    {
+        const pid_t tid = cpu_usage_tid.load();
+        const CpuUsage usage = (0 != tid ? CpuUsage::Task(tid)
+                                         : CpuUsage::Process());
+        std::vector<uint64_t> values = usage.GetStatsValues();
+        values.push_back(usage.UsecPerGB(core_traffic()));
+        return values;
+    }
+
+
     std::string dc_cookie;
     unsigned long evntcount = 0;
     bool disabled_socket_protect_fd;
+    SocketBuffers socket_buffers;
+    HeapTrimmer heap_trimmer;
     BackendSignals *signal;
     RequiresQueue *userinputq;
     std::mutex event_mutex;
+    std::mutex packed_stats_mtx;
+    std::vector<guint64> packed_stats;
+    std::atomic<pid_t> cpu_usage_tid{0};  ///< See set_cpu_usage_thread()
     bool failed_signal_sent;
     StatusMinor run_status;
     bool initial_connection = true;
+    RemoteRace::Ptr remote_race;
+    bool shared_resolver = false;
+    unsigned int resolve_attempt = 0;
+    bool shared_backoff = false;
+    std::string attempt_remote;   ///< Remote of the current attempt, see shared_backoff
+    bool attempt_connected = false;
+    std::map<std::string, std::chrono::steady_clock::time_point> remote_backoff;
+    unsigned int backoff_interrupts = 0;
+    bool backoff_stopped = false;
+    std::mutex backoff_mtx;
+    std::condition_variable backoff_cv;
+    std::deque<std::chrono::steady_clock::time_point> reconnects;
+
+    bool remote_override_enabled() override
+    {
+        return nullptr != remote_race;
+    }
+
+
+    /**
+     *  Called by the core library before each connection attempt when
+     *  remote racing is enabled, to get the remote server to connect to
+     */
+    void remote_override(ClientAPI::RemoteOverride& ro) override
+    {
+        if (shared_backoff && !attempt_remote.empty() && !attempt_connected)
+        {
+            signal->RemoteStatus(attempt_remote, false);
+        }
+        attempt_connected = false;
+
+        RemoteRace::Selection sel = (shared_backoff ? next_remote_with_backoff()
+                                                    : remote_race->Next());
+        if (sel.index < 0)
+        {
+            ro.error = "No remote servers available";
+            return;
+        }
+        const RaceRemote& r = remote_race->GetRemotes()[sel.index];
+        attempt_remote = RemoteKey(r);
+        ro.host = r.host;
+        ro.port = r.port;
+        ro.proto = r.proto;
+        ro.ip = sel.address;
+        if (ro.ip.empty() && shared_resolver)
+        {
+            ro.ip = shared_resolve(r);
+            if (!ro.ip.empty())
+            {
+                signal->LogVerb2("Connecting to remote " + r.host + ":" + r.port
+                                 + " (" + r.proto + ") via " + ro.ip
+                                 + ", resolved by netcfg");
+                return;
+            }
+        }
+        signal->LogVerb2("Connecting to remote " + r.host + ":" + r.port
+                         + " (" + r.proto + ")"
+                         + (sel.address.empty() ? std::string(", no remote answered the probes")
+                                                : ", first to answer via " + sel.address));
+    }
+
+
+    /**
+     *  Picks the remote for the next connection attempt, skipping the
+     *  remotes the session manager holds back.  If all of them are held
+     *  back, this waits for the one available first.
+     *
+     * @return Returns the RemoteRace::Selection to use
+     */
+    RemoteRace::Selection next_remote_with_backoff()
+    {
+        using Clock = std::chrono::steady_clock;
+        const auto& remotes = remote_race->GetRemotes();
+
+        RemoteRace::Selection first;
+        Clock::time_point first_until;
+        for (size_t i = 0; i < remotes.size(); ++i)
+        {
+            RemoteRace::Selection sel = remote_race->Next();
+            if (sel.index < 0)
+            {
+                return sel;
+            }
+            Clock::time_point until = backoff_until(RemoteKey(remotes[sel.index]));
+            if (until <= Clock::now())
+            {
+                return sel;
+            }
+            if (first.index < 0 || until < first_until)
+            {
+                first = sel;
+                first_until = until;
+            }
+        }
+
+        const RaceRemote& r = remotes[first.index];
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(first_until - Clock::now());
+        signal->LogInfo("Remote " + r.host + ":" + r.port + " (" + r.proto + ")"
+                        + " is failing for other sessions, holding back for "
+                        + std::to_string(secs.count() + 1) + " seconds");
+
+        std::unique_lock<std::mutex> lock(backoff_mtx);
+        const unsigned int interrupts = backoff_interrupts;
+        const std::string key = RemoteKey(r);
+        backoff_cv.wait_until(lock, first_until,
+                              [this, interrupts, key]()
+                              {
+                                  auto it = remote_backoff.find(key);
+                                  return interrupts != backoff_interrupts
+                                         || backoff_stopped
+                                         || remote_backoff.end() == it
+                                         || it->second <= Clock::now();
+                              });
+        return first;
+    }
+
+
+    /**
+     * @return Returns until when a remote is held back; a past time
+     *         point if it is not
+     */
+    std::chrono::steady_clock::time_point backoff_until(const std::string& key)
+    {
+        std::lock_guard<std::mutex> guard(backoff_mtx);
+        auto it = remote_backoff.find(key);
+        return (remote_backoff.end() == it ? std::chrono::steady_clock::time_point()
+                                           : it->second);
+    }
+
+
+    /**
+     *  Resolves the host name of a remote via the netcfg service.  Each
+     *  call picks the next of the addresses matching the protocol of the
+     *  remote, as the core library only tries the given address.
+     *
+     * @param r  RaceRemote to resolve
+     *
+     * @return Returns the numeric address to connect to, or an empty
+     *         string to let the core library resolve the host name
+     */
+    std::string shared_resolve(const RaceRemote& r)
+    {
+        std::vector<std::string> addresses;
+        try
+        {
+            for (const auto& a : netcfg_resolve_remote(r.host))
+            {
+                bool ipv6 = (a.find(':') != std::string::npos);
+                if (AF_UNSPEC == r.family()
+                    || (ipv6 ? AF_INET6 : AF_INET) == r.family())
+                {
+                    addresses.push_back(a);
+                }
+            }
+        }
+        catch (const std::exception& excp)
+        {
+            signal->LogVerb2("Remote " + r.host + " not resolved by netcfg: "
+                             + std::string(excp.what()));
+        }
+        if (addresses.empty())
+        {
+            return "";
+        }
+        return addresses[resolve_attempt++ % addresses.size()];
+    }
+
+
+    /**
+     *  Triggers the flight recorder when the connection has been
+     *  restarted three times within two minutes
+     */
+    void check_reconnect_loop()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        reconnects.push_back(now);
+        while (now - reconnects.front() > std::chrono::minutes(2))
+        {
+            reconnects.pop_front();
+        }
+        if (reconnects.size() >= 3)
+        {
+            reconnects.clear();
+            signal->FlightRecorderTrigger("a reconnect loop");
+        }
+    }
+
 
     bool socket_protect(int socket, std::string remote, bool ipv6) override
     {
+        if (socket != probe_socket)
+        {
+            // A new transport socket for this connection attempt
+            socket_buffers.Attach(socket);
+        }
         if (disabled_socket_protect_fd)
         {
             socket = -1;
@@ -334,6 +997,7 @@ private:
         }
         else if ("GET_CONFIG" == ev.name)
         {
+            signal->Timing().Mark("core_get_config");
             signal->LogVerb2("Retrieving configuration from server", true);
         }
         else if ("TUN_SETUP_FAILED" == ev.name
@@ -357,6 +1021,7 @@ private:
         }
         else if ("WAIT" == ev.name)
         {
+            signal->Timing().Mark("core_server_wait");
             signal->LogVerb1("Waiting for server response", true);
         }
         else if ("WAIT_PROXY" == ev.name)
@@ -365,10 +1030,34 @@ private:
         }
         else if ("CONNECTED" == ev.name)
         {
-            signal->LogInfo("Connected: " + ev.info);
+            signal->Timing().Mark("connected");
+            signal->LogStructured(LogCategory::INFO, "Connected: " + ev.info,
+                                  connected_fields(ev));
+            if (remote_race)
+            {
+                remote_race->Connected();
+            }
+            if (shared_backoff && !attempt_remote.empty())
+            {
+                signal->RemoteStatus(attempt_remote, true);
+                attempt_connected = true;
+            }
             signal->StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTED);
             run_status = StatusMinor::CONN_CONNECTED;
             initial_connection = false;
+
+            // The connection set-up leaves most of its peak heap usage
+            // as free memory in the malloc arenas
+            uint64_t released = heap_trimmer.Trim();
+            if (released > 0)
+            {
+                LogFields f;
+                f.AddUInt("heap_released_bytes", released);
+                signal->LogStructured(LogCategory::VERB2,
+                                      "Returned " + std::to_string(released / 1024)
+                                      + " KiB of unused heap memory",
+                                      std::move(f));
+            }
         }
         else if ("RECONNECTING" == ev.name)
         {
@@ -379,15 +1068,18 @@ private:
                 signal->LogInfo("Reconnecting");
                 signal->StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RECONNECTING);
                 run_status = StatusMinor::CONN_RECONNECTING;
+                check_reconnect_loop();
             }
         }
         else if ("RESOLVE" == ev.name)
         {
+            signal->Timing().Mark("core_resolve");
             signal->LogVerb2("Resolving", true);
         }
         else if ("AUTH_FAILED" == ev.name)
         {
             signal->LogVerb1("Authentication failed");
+            signal->FlightRecorderTrigger("authentication failure");
             signal->StatusChange(StatusMajor::CONNECTION,
                                  StatusMinor::CONN_AUTH_FAILED,
                                  "Authentication failed");
@@ -396,7 +1088,9 @@ private:
         }
         else if ("CERT_VERIFY_FAIL" == ev.name)
         {
-            signal->LogCritical("Certificate verification failed:" + ev.info);
+            signal->LogStructured(LogCategory::CRIT,
+                                  "Certificate verification failed:" + ev.info,
+                                  event_fields(ev));
             signal->StatusChange(StatusMajor::CONNECTION,
                                  StatusMinor::CONN_FAILED,
                                  "Certificate verification failed");
@@ -405,7 +1099,10 @@ private:
         }
         else if ("TLS_VERSION_MIN" == ev.name)
         {
-            signal->LogCritical("TLS version is requested by server is too low:" + ev.info);
+            signal->LogStructured(LogCategory::CRIT,
+                                  "TLS version is requested by server is too low:"
+                                  + ev.info,
+                                  event_fields(ev));
             signal->StatusChange(StatusMajor::CONNECTION,
                                  StatusMinor::CONN_FAILED,
                                  "TLS version too low");
@@ -430,7 +1127,9 @@ private:
         }
         else if ("PROXY_ERROR" == ev.name)
         {
-            signal->LogCritical("Proxy connection error:" + ev.info);
+            signal->LogStructured(LogCategory::CRIT,
+                                  "Proxy connection error:" + ev.info,
+                                  event_fields(ev));
             signal->StatusChange(StatusMajor::CONNECTION,
                                  StatusMinor::CONN_FAILED,
                                  "Proxy connection error");
@@ -439,7 +1138,8 @@ private:
         }
         else if ("CLIENT_HALT" == ev.name)
         {
-            signal->LogCritical("Client Halt: " + ev.info);
+            signal->LogStructured(LogCategory::CRIT, "Client Halt: " + ev.info,
+                                  event_fields(ev));
             signal->StatusChange(StatusMajor::CONNECTION,
                                  StatusMinor::CONN_FAILED,
                                  "Client disconnected by server");
@@ -463,6 +1163,68 @@ private:
         }
     }
 
+    /**
+     *  Describes a core event as log fields, with the core event name
+     *  and for errors the reason given by the core library
+     *
+     * @param ev  The ClientAPI::Event object to describe
+     * @return Returns a LogFields object with the fields
+     */
+    static LogFields event_fields(const ClientAPI::Event& ev)
+    {
+        LogFields f;
+        f.AddString("core_event", ev.name);
+        if ((ev.error || ev.fatal) && !ev.info.empty())
+        {
+            f.AddString("reason", ev.info);
+        }
+        return f;
+    }
+
+
+    /**
+     *  Describes the established connection as log fields, so the
+     *  remote server and the VPN addresses can be found without
+     *  parsing the "Connected" log message
+     *
+     * @param ev  The CONNECTED ClientAPI::Event object
+     * @return Returns a LogFields object with the fields
+     */
+    LogFields connected_fields(const ClientAPI::Event& ev)
+    {
+        LogFields f = event_fields(ev);
+        ClientAPI::ConnectionInfo ci = connection_info();
+        if (!ci.defined)
+        {
+            return f;
+        }
+
+        const std::pair<const char *, const std::string *> strs[] = {
+            {"server_host", &ci.serverHost},
+            {"server_proto", &ci.serverProto},
+            {"server_ip", &ci.serverIp},
+            {"vpn_ip4", &ci.vpnIp4},
+            {"vpn_ip6", &ci.vpnIp6},
+            {"tun_name", &ci.tunName}
+        };
+        for (const auto& s : strs)
+        {
+            if (!s.second->empty())
+            {
+                f.AddString(s.first, *s.second);
+            }
+        }
+
+        char *end = nullptr;
+        unsigned long port = std::strtoul(ci.serverPort.c_str(), &end, 10);
+        if (!ci.serverPort.empty() && end && '\0' == *end && port <= 65535)
+        {
+            f.AddUInt("server_port", port);
+        }
+        return f;
+    }
+
+
     void open_url(std::string& url, const std::string& flags)
     {
         // We currently ignore the flags since we do not have an
@@ -486,7 +1248,10 @@ private:
     virtual void log(const ClientAPI::LogInfo& log) override
     {
         // Log events going via log() are to be considered debug information
-        signal->Debug(log.text);
+        if (signal->LogEnabled(LogCategory::DEBUG))
+        {
+            signal->Debug(log.text);
+        }
     }
 
 
@@ -0,0 +1,168 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   heap-trimmer.cpp
+ *
+ * @brief  Returns the unused heap memory of an idle VPN client process
+ *         to the kernel (implementation)
+ */
+
+#include <fstream>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "client/heap-trimmer.hpp"
+
+
+/**
+ *  Heap usage of the process, in bytes
+ */
+struct HeapUsage
+{
+    uint64_t in_use = 0;  ///< Allocated memory, including mmap()ed chunks
+    uint64_t free = 0;    ///< Free memory kept in the arenas
+    uint64_t total = 0;   ///< Memory obtained from the kernel
+};
+
+
+static HeapUsage get_heap_usage()
+{
+    HeapUsage u;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+#else
+    // The fields of mallinfo() wrap around at 4 GiB
+    struct mallinfo mi = mallinfo();
+#endif
+    u.in_use = (uint64_t) mi.uordblks + (uint64_t) mi.hblkhd;
+    u.free = (uint64_t) mi.fordblks;
+    u.total = (uint64_t) mi.arena + (uint64_t) mi.hblkhd;
+    return u;
+}
+
+
+bool HeapTrimmer::CapArenas(const int max)
+{
+    return 1 == mallopt(M_ARENA_MAX, max);
+}
+
+
+void HeapTrimmer::Enable(const std::chrono::seconds idle)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    enabled = true;
+    idle_period = idle;
+    last_change = Clock::now();
+    idle_trimmed = false;
+}
+
+
+bool HeapTrimmer::IsEnabled() const
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    return enabled;
+}
+
+
+bool HeapTrimmer::Sample(const uint64_t traffic, const Clock::time_point now)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    if (!enabled)
+    {
+        return false;
+    }
+    if (traffic != last_traffic)
+    {
+        last_traffic = traffic;
+        last_change = now;
+        idle_trimmed = false;
+        return false;
+    }
+    if (idle_trimmed || now - last_change < idle_period)
+    {
+        return false;
+    }
+    idle_trimmed = true;
+    trim_locked();
+    return true;
+}
+
+
+uint64_t HeapTrimmer::Trim()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    if (!enabled)
+    {
+        return 0;
+    }
+    return trim_locked();
+}
+
+
+const std::vector<std::string>& HeapTrimmer::GetStatsKeys()
+{
+    static const std::vector<std::string> keys = {
+        "HEAP_IN_USE",
+        "HEAP_FREE",
+        "HEAP_TOTAL",
+        "HEAP_TRIMS",
+        "HEAP_TRIMMED_BYTES"
+    };
+    return keys;
+}
+
+
+std::vector<uint64_t> HeapTrimmer::GetStatsValues() const
+{
+    HeapUsage u = get_heap_usage();
+    std::lock_guard<std::mutex> guard(mtx);
+    return {u.in_use, u.free, u.total, trims, trimmed_bytes};
+}
+
+
+/**
+ * @return Returns the resident set size of the process, in bytes
+ */
+static uint64_t get_rss()
+{
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    if (!(statm >> size >> resident))
+    {
+        return 0;
+    }
+    return resident * (uint64_t) sysconf(_SC_PAGESIZE);
+}
+
+
+uint64_t HeapTrimmer::trim_locked()
+{
+    // malloc_trim() also releases the free pages inside the arenas
+    // with MADV_DONTNEED, which mallinfo2() does not account for; the
+    // change of the resident set size covers both
+    uint64_t before = get_rss();
+    malloc_trim(0);
+    uint64_t after = get_rss();
+
+    uint64_t released = (before > after ? before - after : 0);
+    ++trims;
+    trimmed_bytes += released;
+    return released;
+}
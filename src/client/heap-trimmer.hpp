@@ -0,0 +1,139 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   heap-trimmer.hpp
+ *
+ * @brief  Returns the unused heap memory of an idle VPN client process
+ *         to the kernel (declaration)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/**
+ *  Keeps the heap of the VPN client process small while the tunnel is
+ *  idle, for the low-memory override.
+ *
+ *  Memory freed by the OpenVPN 3 Core library and GLib stays in the
+ *  malloc arenas, so the process keeps the peak heap size of the
+ *  connection set-up for the lifetime of the tunnel.  malloc_trim(3)
+ *  returns the free pages to the kernel.  The heap is trimmed right
+ *  after the connection is established and once each time the traffic
+ *  through the Core library has stopped for the idle period.  With DCO,
+ *  only control channel traffic passes through the Core library.
+ *
+ *  The heap usage as reported by mallinfo2(3) is always available via
+ *  GetStatsValues(), also when trimming is not enabled.
+ *
+ *  This class is thread-safe.
+ */
+class HeapTrimmer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Maximum number of malloc arenas with the low-memory override
+    static const int LowMemoryArenas = 2;
+
+
+    /**
+     *  Limits the number of malloc arenas of the process.  glibc
+     *  creates up to eight arenas per CPU core for the threads
+     *  allocating concurrently, each keeping its own free memory.  This
+     *  only affects arenas created after this call, so call it before
+     *  starting the VPN client thread.
+     *
+     * @param max  Maximum number of arenas
+     *
+     * @return Returns true on success
+     */
+    static bool CapArenas(const int max);
+
+
+    /**
+     *  Enables trimming
+     *
+     * @param idle_period  How long the traffic counters have to stay
+     *                     unchanged before the heap is trimmed
+     */
+    void Enable(const std::chrono::seconds idle_period);
+
+
+    /**
+     * @return Returns true if Enable() has been called
+     */
+    bool IsEnabled() const;
+
+
+    /**
+     *  Records the traffic counter of the connection and trims the heap
+     *  when it has not changed for the idle period.  The heap is only
+     *  trimmed once per idle period.  This is intended to be called
+     *  once per second.
+     *
+     * @param traffic  Any counter increasing with the traffic
+     * @param now      Current time
+     *
+     * @return Returns true if the heap was trimmed
+     */
+    bool Sample(const uint64_t traffic, const Clock::time_point now = Clock::now());
+
+
+    /**
+     *  Trims the heap right away, if enabled
+     *
+     * @return Returns the number of bytes returned to the kernel
+     */
+    uint64_t Trim();
+
+
+    /**
+     * @return Returns the names of the statistics counters provided by
+     *         GetStatsValues(), as appended to the connection statistics
+     */
+    static const std::vector<std::string>& GetStatsKeys();
+
+
+    /**
+     * @return Returns the statistics counters, in the order of
+     *         GetStatsKeys()
+     */
+    std::vector<uint64_t> GetStatsValues() const;
+
+
+private:
+    mutable std::mutex mtx;
+    bool enabled = false;
+    std::chrono::seconds idle_period{300};
+    uint64_t last_traffic = 0;
+    Clock::time_point last_change;
+    bool idle_trimmed = false;     ///< Trimmed during the current idle period
+
+    // Statistics
+    uint64_t trims = 0;
+    uint64_t trimmed_bytes = 0;
+
+    uint64_t trim_locked();
+};
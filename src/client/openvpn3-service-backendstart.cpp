@@ -30,17 +30,35 @@
  *         starts also runs with the appropriate privileges.
  */
 
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <functional>
 #include <iostream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <openvpn/common/rc.hpp>
 
 #include "config.h"
+#ifdef ENABLE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "common/cmdargparser.hpp"
+#include "common/resource-control.hpp"
+#include "common/startup-timing.hpp"
 #include "dbus/core.hpp"
 #include "dbus/connection-creds.hpp"
+#include "dbus/proxy.hpp"
 #include "log/dbus-log.hpp"
 #include "log/proxy-log.hpp"
+#include "common/platforminfo.hpp"
 #include "common/utils.hpp"
+#include "backend-scope.hpp"
 
 using namespace openvpn;
 
@@ -117,13 +135,13 @@ public:
         : DBusObject(objpath),
           BackendStarterSignals(dbuscon, objpath, log_level),
           dbuscon(dbuscon),
+          creds(dbuscon),
           client_args(client_args),
           client_envvars(client_envvars)
     {
         if (!signal_broadcast)
         {
-            DBusConnectionCreds credsprx(dbuscon);
-            AddTargetBusName(credsprx.GetUniqueBusID(OpenVPN3DBus_name_log));
+            AddTargetBusName(creds.GetUniqueBusID(OpenVPN3DBus_name_log));
         }
 
         std::stringstream introspection_xml;
@@ -132,7 +150,9 @@ public:
                           << "        <method name='StartClient'>"
                           << "          <arg type='s' name='token' direction='in'/>"
                           << "          <arg type='u' name='pid' direction='out'/>"
+                          << "          <arg type='a{sv}' name='timing' direction='out'/>"
                           << "        </method>"
+                          << "        <method name='RegisterStandby'/>"
                           << "        <property type='s' name='version' access='read'/>"
                           << GetLogIntrospection()
                           << "    </interface>"
@@ -145,10 +165,82 @@ public:
     ~BackendStarterObject()
     {
         LogInfo("Shutting down");
+        if (0 != pool_timer)
+        {
+            g_source_remove(pool_timer);
+        }
+        drain_client_pool();
         RemoveObject(dbuscon);
     }
 
 
+    /**
+     *  Enables the client pool.  The backend starter keeps up to
+     *  pool_size openvpn3-service-client processes in standby, already
+     *  connected to the D-Bus, which are handed a session token when
+     *  StartClient is called.  If no clients are started for
+     *  idle_timeout seconds, all the standby processes are stopped; the
+     *  pool is filled again on the next StartClient call.
+     *
+     *  With host_sessions above 1, each standby process hosts up to that
+     *  many VPN sessions.  A process stays in the pool until it has been
+     *  assigned all of them.
+     *
+     * @param size           Number of standby client processes to keep
+     * @param idle_timeout   Seconds without StartClient calls before the
+     *                       pool is drained
+     * @param host_sessions  Number of sessions each standby process can
+     *                       be assigned
+     */
+    void EnableClientPool(const unsigned int size,
+                          const unsigned int idle_timeout,
+                          const unsigned int host_sessions = 1)
+    {
+        pool_size = size;
+        pool_idle_timeout = idle_timeout;
+        pool_host_sessions = (host_sessions > 0 ? host_sessions : 1);
+        if (0 == pool_size)
+        {
+            return;
+        }
+
+        pool_active = true;
+        last_start = std::time(nullptr);
+        pool_timer = g_timeout_add_seconds(pool_check_interval,
+                                           [](gpointer data) -> gboolean
+                                           {
+                                               auto self = static_cast<BackendStarterObject *>(data);
+                                               self->check_client_pool();
+                                               return G_SOURCE_CONTINUE;
+                                           },
+                                           this);
+        LogVerb1("Client pool enabled, size: " + std::to_string(pool_size)
+                 + ", idle timeout: " + std::to_string(pool_idle_timeout)
+                 + " seconds, sessions per process: "
+                 + std::to_string(pool_host_sessions));
+        fill_client_pool();
+    }
+
+
+    /**
+     *  Runs each client process started in its own transient systemd
+     *  scope unit, with its own cgroup.  This keeps a busy client from
+     *  starving the others and lets the resource usage of each VPN
+     *  session be limited.  The client process applies the resource
+     *  control overrides of its configuration profile to the scope
+     *  itself.
+     *
+     * @param rc  ResourceControl settings for all the scopes
+     */
+    void EnableClientScopes(const ResourceControl& rc)
+    {
+        client_scopes = true;
+        scope_settings = rc;
+        LogVerb1("Client processes run in their own scope units, "
+                 "resource control: " + rc.str());
+    }
+
+
     /**
      *  Callback method called each time a method in the Backend Starter
      *  service is called over the D-Bus.
@@ -173,22 +265,50 @@ public:
     {
         if ("StartClient" == method_name)
         {
-            IdleCheck_UpdateTimestamp();
+            Clock::time_point t_start = Clock::now();
 
             // Retrieve the configuration path for the tunnel
             // from the request
             gchar *token = nullptr;
             g_variant_get (params, "(s)", &token);
-            pid_t backend_pid = start_backend_process(token);
-            if (-1 == backend_pid)
+            std::string session_token(token);
+            g_free(token);
+
+            if (pool_size > 0)
             {
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
-                                                              "Backend client process died");
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-                return;
+                last_start = std::time(nullptr);
+                pool_active = true;
+                if (!pool.empty())
+                {
+                    // The reply is sent once a standby process has
+                    // accepted the session, or a new client process
+                    // has been started if none of them could be used
+                    assign_standby_client(session_token,
+                                          [self=Ptr(this), invoc, session_token,
+                                           t_start](pid_t standby_pid)
+                                          {
+                                              if (-1 == standby_pid)
+                                              {
+                                                  self->start_new_client(invoc, session_token,
+                                                                         t_start);
+                                                  return;
+                                              }
+                                              StartTiming timing;
+                                              timing.standby = true;
+                                              timing.total_usec = elapsed_usec(t_start, Clock::now());
+                                              self->return_start_client(invoc, standby_pid, timing);
+
+                                              // Replace the standby process which was just used
+                                              self->fill_client_pool();
+                                          });
+                    return;
+                }
             }
-            g_dbus_method_invocation_return_value(invoc, g_variant_new("(u)", backend_pid));
+            start_new_client(invoc, session_token, t_start);
+        }
+        else if ("RegisterStandby" == method_name)
+        {
+            register_standby_client(sender, invoc);
         }
     };
 
@@ -218,7 +338,6 @@ public:
                                      const std::string property_name,
                                      GError **error)
     {
-        IdleCheck_UpdateTimestamp();
         GVariant *ret = nullptr;
 
         if ("version" == property_name)
@@ -268,20 +387,529 @@ public:
 
 
 private:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     *  Time spent on the various steps of a StartClient call, returned
+     *  to the caller together with the PID of the client process
+     */
+    struct StartTiming
+    {
+        bool standby = false;       ///< Session handed to a standby process
+        guint64 fork_usec = 0;      ///< Time used to fork the client
+        guint64 startup_usec = 0;   ///< Time until the client had daemonized
+        guint64 total_usec = 0;     ///< Total time used by StartClient
+    };
+
+
+    /**
+     *  Context of a started client process being waited for
+     */
+    struct ChildWatch
+    {
+        BackendStarterObject::Ptr self;
+        std::string token;
+        std::function<void(bool success)> done;
+    };
+
+
+    /**
+     *  A client process waiting in the client pool
+     */
+    struct StandbyClient
+    {
+        std::string busname;
+        pid_t pid;
+        unsigned int slots;    ///< Sessions which can still be assigned
+    };
+
+
+    /**
+     *  A standby client process which has not registered yet
+     */
+    struct StartingClient
+    {
+        pid_t pid;             ///< PID of the process started by fork()
+        std::time_t started;
+    };
+
     GDBusConnection *dbuscon;
+    DBusConnectionCreds creds;
     const std::vector<std::string> client_args;
     std::vector<std::string> client_envvars;
 
+    bool client_scopes = false;
+    ResourceControl scope_settings;
+
+    unsigned int pool_size = 0;
+    unsigned int pool_idle_timeout = 0;
+    unsigned int pool_host_sessions = 1;
+    bool pool_active = false;
+    std::time_t last_start = 0;
+    guint pool_timer = 0;
+    std::deque<StandbyClient> pool;
+
+    /// Standby processes which have not registered yet
+    std::deque<StartingClient> pool_starting;
+
+    /// Seconds between each client pool maintenance run
+    static const unsigned int pool_check_interval = 5;
+
+    /// Seconds a new standby process may use to register itself
+    static const unsigned int pool_start_timeout = 30;
+
+
+    /**
+     *  Starts new standby client processes until the pool is full.  Each
+     *  standby process holds an idle check reference, so the backend
+     *  starter does not exit while it has processes in the pool.
+     */
+    void fill_client_pool()
+    {
+        while (pool_active && pool.size() + pool_starting.size() < pool_size)
+        {
+            pid_t pid = start_backend_process(nullptr);
+            if (-1 == pid)
+            {
+                LogError("Failed to start a standby client process");
+                return;
+            }
+            pool_starting.push_back({pid, std::time(nullptr)});
+            IdleCheck_RefInc();
+
+            watch_backend_process(pid, "standby",
+                                  [self=Ptr(this), pid](bool success)
+                                  {
+                                      // The process will never register,
+                                      // make room for a new one
+                                      if (!success && self->forget_starting_client(pid))
+                                      {
+                                          self->IdleCheck_RefDec();
+                                      }
+                                  });
+        }
+    }
+
+
+    /**
+     *  Removes a standby client process from the list of processes
+     *  which have not registered yet.
+     *
+     *  The client process forks again after calling setsid(), so the
+     *  process registering itself is not the one started by fork() but
+     *  it runs in the session that process created.
+     *
+     * @param pid  PID of the process started by fork() or of the
+     *             process registering itself
+     *
+     * @return Returns true if the process was found and removed
+     */
+    bool forget_starting_client(const pid_t pid)
+    {
+        const pid_t sid = getsid(pid);
+        for (auto it = pool_starting.begin(); it != pool_starting.end(); ++it)
+        {
+            if (it->pid == pid || it->pid == sid)
+            {
+                pool_starting.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    static guint64 elapsed_usec(const Clock::time_point& from,
+                                const Clock::time_point& to)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+    }
+
+
+    /**
+     *  Starts a new client process for a session and sends the reply
+     *  to the StartClient method call once it is running
+     *
+     * @param invoc          GDBusMethodInvocation of the StartClient call
+     * @param session_token  std::string with the session token
+     * @param t_start        Clock::time_point when the request arrived
+     */
+    void start_new_client(GDBusMethodInvocation *invoc,
+                          const std::string& session_token,
+                          const Clock::time_point t_start)
+    {
+        pid_t backend_pid = start_backend_process(session_token.c_str());
+        Clock::time_point t_forked = Clock::now();
+        if (-1 == backend_pid)
+        {
+            return_start_error(invoc);
+            return;
+        }
+
+        // The reply is sent once the intermediate client process
+        // has exited, without blocking other StartClient calls
+        watch_backend_process(backend_pid, session_token,
+                              [self=Ptr(this), invoc, backend_pid,
+                               t_start, t_forked](bool success)
+                              {
+                                  if (!success)
+                                  {
+                                      self->return_start_error(invoc);
+                                      return;
+                                  }
+                                  Clock::time_point now = Clock::now();
+                                  StartTiming timing;
+                                  timing.fork_usec = elapsed_usec(t_start, t_forked);
+                                  timing.startup_usec = elapsed_usec(t_forked, now);
+                                  timing.total_usec = elapsed_usec(t_start, now);
+                                  self->return_start_client(invoc, backend_pid, timing);
+                              });
+
+        fill_client_pool();
+    }
+
+
+    /**
+     *  Sends the successful reply to a StartClient method call
+     *
+     * @param invoc   GDBusMethodInvocation of the StartClient call
+     * @param pid     PID of the started client process
+     * @param timing  StartTiming of this request
+     */
+    void return_start_client(GDBusMethodInvocation *invoc, const pid_t pid,
+                             const StartTiming& timing)
+    {
+        GVariantBuilder *tb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(tb, "{sv}", "standby",
+                              g_variant_new_boolean(timing.standby));
+        if (!timing.standby)
+        {
+            g_variant_builder_add(tb, "{sv}", "fork_usec",
+                                  g_variant_new_uint64(timing.fork_usec));
+            g_variant_builder_add(tb, "{sv}", "startup_usec",
+                                  g_variant_new_uint64(timing.startup_usec));
+        }
+        g_variant_builder_add(tb, "{sv}", "total_usec",
+                              g_variant_new_uint64(timing.total_usec));
+
+        LogVerb2("Client process pid " + std::to_string(pid) + " started in "
+                 + std::to_string(timing.total_usec) + " usec"
+                 + (timing.standby ? " (standby process)" : ""));
+        g_dbus_method_invocation_return_value(invoc,
+                                              g_variant_new("(ua{sv})",
+                                                            (guint32) pid, tb));
+        g_variant_builder_unref(tb);
+    }
+
+
+    /**
+     *  Sends the error reply to a StartClient method call
+     *
+     * @param invoc   GDBusMethodInvocation of the StartClient call
+     */
+    void return_start_error(GDBusMethodInvocation *invoc)
+    {
+        GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                      "Backend client process died");
+        g_dbus_method_invocation_return_gerror(invoc, err);
+        g_error_free(err);
+    }
+
+
+    /**
+     *  Reaps the intermediate client process asynchronously.  The
+     *  openvpn3-service-client process forks again and the first
+     *  process exits as soon as the daemonized process is running.
+     *
+     *  An idle check reference is held until the process has exited.
+     *
+     * @param pid    PID of the process to wait for
+     * @param token  Session token or description, used for logging
+     * @param done   Function called when the process has exited, with
+     *               a flag indicating if it exited successfully
+     */
+    void watch_backend_process(const pid_t pid, const std::string& token,
+                               std::function<void(bool success)> done)
+    {
+        IdleCheck_RefInc();
+        ChildWatch *cw = new ChildWatch{Ptr(this), token, std::move(done)};
+        g_child_watch_add_full(G_PRIORITY_DEFAULT, pid,
+                               [](GPid child_pid, gint status, gpointer data)
+                               {
+                                   auto cw = static_cast<ChildWatch *>(data);
+                                   bool success = WIFEXITED(status)
+                                                  && 0 == WEXITSTATUS(status);
+                                   if (!success)
+                                   {
+                                       std::stringstream msg;
+                                       msg << "Child process (" << cw->token
+                                           << ") - pid " << child_pid
+                                           << " failed to start as expected"
+                                           << " (exit code: "
+                                           << std::to_string(status) << ")";
+                                       cw->self->LogError(msg.str());
+                                   }
+                                   g_spawn_close_pid(child_pid);
+                                   cw->done(success);
+                                   cw->self->IdleCheck_RefDec();
+                               },
+                               cw,
+                               [](gpointer data)
+                               {
+                                   delete static_cast<ChildWatch *>(data);
+                               });
+    }
+
+
+    /**
+     *  Handles the RegisterStandby method, called by a standby client
+     *  process once it is ready to be assigned a session
+     *
+     * @param sender  std::string with the unique bus name of the caller
+     * @param invoc   GDBusMethodInvocation of the method call
+     */
+    void register_standby_client(const std::string& sender,
+                                 GDBusMethodInvocation *invoc)
+    {
+        try
+        {
+            // Only client processes started by this service, which runs
+            // as the same user, can join the pool
+            if (creds.GetUID(sender) != getuid())
+            {
+                throw DBusCredentialsException(creds.GetUID(sender),
+                                               "net.openvpn.v3.error.acl.denied",
+                                               "Access denied");
+            }
+
+            // ... and only those which are still expected to register
+            const pid_t pid = creds.GetPID(sender);
+            if (!forget_starting_client(pid))
+            {
+                throw DBusCredentialsException(creds.GetUID(sender),
+                                               "net.openvpn.v3.error.acl.denied",
+                                               "Not a standby client process started "
+                                               "by this service (pid "
+                                               + std::to_string(pid) + ")");
+            }
+
+            if (!pool_active || pool.size() >= pool_size)
+            {
+                IdleCheck_RefDec();
+                throw DBusCredentialsException(creds.GetUID(sender),
+                                               "net.openvpn.v3.error.backend",
+                                               "Client pool is full");
+            }
+
+            StandbyClient sc = {sender, pid, pool_host_sessions};
+            pool.push_back(sc);
+            g_dbus_method_invocation_return_value(invoc, NULL);
+            LogVerb2("Standby client process registered, pid "
+                     + std::to_string(sc.pid) + " (" + std::to_string(pool.size())
+                     + "/" + std::to_string(pool_size) + " in the pool)");
+        }
+        catch (DBusCredentialsException& excp)
+        {
+            LogWarn(excp.what());
+            excp.SetDBusError(invoc);
+        }
+    }
+
+
+    /**
+     *  Hands the session token to a standby client process from the pool.
+     *  The AssignSession call is done asynchronously; if a standby process
+     *  does not accept the session, the next one in the pool is tried.
+     *
+     * @param token  Session token for the new client
+     * @param done   Function called with the PID of the client process,
+     *               or -1 if no standby client process could be used.
+     */
+    void assign_standby_client(const std::string& token,
+                               std::function<void(pid_t pid)> done)
+    {
+        if (pool.empty())
+        {
+            done(-1);
+            return;
+        }
+
+        // A process hosting several sessions stays at the front of
+        // the pool until all its session slots are used
+        StandbyClient& sc = pool.front();
+        const StandbyClient used = sc;
+        if (--sc.slots == 0)
+        {
+            pool.pop_front();
+            IdleCheck_RefDec();
+        }
+
+        DBusProxyAsyncCall::Start(dbuscon, used.busname,
+                                  OpenVPN3DBus_rootp_backends_standby,
+                                  OpenVPN3DBus_interf_backends,
+                                  "AssignSession",
+                                  g_variant_new("(s)", token.c_str()),
+                                  [self=Ptr(this), token, used, done](DBusProxyAsyncCall& call)
+                                  {
+                                      guint32 pid = 0;
+                                      std::string errmsg;
+                                      try
+                                      {
+                                          GVariant *res = call.GetResult();
+                                          g_variant_get(res, "(u)", &pid);
+                                          g_variant_unref(res);
+                                      }
+                                      catch (const DBusException& excp)
+                                      {
+                                          errmsg = excp.GetRawError();
+                                      }
+                                      catch (const DBusProxyAccessDeniedException& excp)
+                                      {
+                                          errmsg = excp.what();
+                                      }
+
+                                      if (errmsg.empty())
+                                      {
+                                          self->LogVerb2("Session " + token
+                                                         + " assigned to standby client process, pid "
+                                                         + std::to_string(pid)
+                                                         + (self->pool_host_sessions > 1
+                                                            ? " (" + std::to_string(used.slots - 1)
+                                                              + " session slots left)"
+                                                            : ""));
+                                          done(pid);
+                                          return;
+                                      }
+
+                                      // The standby process may have exited
+                                      // meanwhile; try the next one
+                                      self->LogWarn("Could not use standby client process pid "
+                                                    + std::to_string(used.pid) + ": " + errmsg);
+                                      self->forget_standby_client(used.busname);
+                                      self->assign_standby_client(token, done);
+                                  });
+    }
+
+
+    /**
+     *  Removes a standby client process which could not be used from
+     *  the pool, if it is still there
+     *
+     * @param busname  std::string with the unique bus name of the process
+     */
+    void forget_standby_client(const std::string& busname)
+    {
+        for (auto it = pool.begin(); it != pool.end(); ++it)
+        {
+            if (it->busname == busname)
+            {
+                pool.erase(it);
+                IdleCheck_RefDec();
+                return;
+            }
+        }
+    }
+
+
+    /**
+     *  Stops all standby client processes in the pool
+     */
+    void drain_client_pool()
+    {
+        while (!pool.empty())
+        {
+            StandbyClient sc = pool.front();
+            pool.pop_front();
+            IdleCheck_RefDec();
+            try
+            {
+                DBusProxy standby(dbuscon, sc.busname,
+                                  OpenVPN3DBus_interf_backends,
+                                  OpenVPN3DBus_rootp_backends_standby);
+                GVariant *res = standby.Call("Shutdown");
+                if (res)
+                {
+                    g_variant_unref(res);
+                }
+            }
+            catch (const DBusException&)
+            {
+                // The process has already exited
+            }
+        }
+    }
+
+
+    /**
+     *  Periodic client pool maintenance.  Forgets standby processes
+     *  which did not register in time and drains the pool when no
+     *  clients have been started for a while.
+     */
+    void check_client_pool()
+    {
+        std::time_t now = std::time(nullptr);
+        while (!pool_starting.empty()
+               && now - pool_starting.front().started > (std::time_t) pool_start_timeout)
+        {
+            pool_starting.pop_front();
+            IdleCheck_RefDec();
+            LogWarn("Standby client process did not register in time");
+        }
+
+        if (pool_active && now - last_start >= (std::time_t) pool_idle_timeout)
+        {
+            LogVerb1("Client pool idle, stopping "
+                     + std::to_string(pool.size())
+                     + " standby client process(es)");
+            pool_active = false;
+            drain_client_pool();
+        }
+        else
+        {
+            fill_client_pool();
+        }
+    }
+
+
     /**
      * Forks out a child thread which starts the openvpn3-service-client
-     * process with the provided backend start token.
+     * process with the provided backend start token.  This does not wait
+     * for the child process; use watch_backend_process() to reap it.
      *
      * @param token  String containing the start token identifying the session
-     *               object this process is tied to.
+     *               object this process is tied to.  If nullptr, the
+     *               process is started in standby mode for the client
+     *               pool.
      * @return Returns the process ID (pid) of the child process.
      */
-    pid_t start_backend_process(char * token)
+    pid_t start_backend_process(const char * token)
     {
+        // Pass on the platform details, if already retrieved, so the
+        // client process does not need to look them up again.  This is
+        // prepared before fork(), as the child must not touch locks.
+        std::vector<std::string> envvars = client_envvars;
+        std::string platform;
+        if (PlatformInfo::TryGetCached(platform))
+        {
+            envvars.push_back("OPENVPN3_PLATFORM_INFO=" + platform);
+        }
+
+        std::vector<std::string> standby_args;
+        if (!token && pool_host_sessions > 1)
+        {
+            standby_args.push_back("--host-sessions");
+            standby_args.push_back(std::to_string(pool_host_sessions));
+        }
+
+        // With scope units, the child waits until it has been moved
+        // into its scope before it starts the client
+        int scope_wait[2] = {-1, -1};
+        if (client_scopes && 0 != pipe2(scope_wait, O_CLOEXEC))
+        {
+            LogWarn("Could not create the scope synchronisation pipe: "
+                    + std::string(strerror(errno)));
+        }
+
         pid_t backend_pid = fork();
         if (0 == backend_pid)
         {
@@ -293,14 +921,28 @@ private:
             //  to stdout, which will be picked up by other logs on the
             //  system
             //
-            char *args[client_args.size()+2];
+            if (scope_wait[0] >= 0)
+            {
+                close(scope_wait[1]);
+                char c;
+                while (read(scope_wait[0], &c, 1) < 0 && EINTR == errno)
+                {
+                }
+                close(scope_wait[0]);
+            }
+
+            char *args[client_args.size()+standby_args.size()+2];
             unsigned int i = 0;
 
             for (const auto& arg : client_args)
             {
                 args[i++] = (char *) strdup(arg.c_str());
             }
-            args[i++] = token;
+            for (const auto& arg : standby_args)
+            {
+                args[i++] = (char *) strdup(arg.c_str());
+            }
+            args[i++] = (token ? (char *) token : (char *) "--standby");
             args[i++] = nullptr;
 
 #ifdef OPENVPN_DEBUG
@@ -313,11 +955,11 @@ private:
 #endif
 
             char** env = {0};
-            if (client_envvars.size() > 0)
+            if (envvars.size() > 0)
             {
-                env = (char **) std::calloc(client_envvars.size(), sizeof(char *));
+                env = (char **) std::calloc(envvars.size() + 1, sizeof(char *));
                 unsigned int idx = 0;
-                for (const auto& ev : client_envvars)
+                for (const auto& ev : envvars)
                 {
                     env[idx] = (char *) ev.c_str();
                     ++idx;
@@ -335,36 +977,68 @@ private:
             // at all.  So if we come here, there must be an error.
             std::cerr << "** Error starting " << args[0] << ": "
                       << strerror(errno) << std::endl;
+            _exit(127);
         }
         else if( backend_pid > 0)
         {
             // Parent
+            if (scope_wait[0] >= 0)
+            {
+                close(scope_wait[0]);
+                start_client_scope(backend_pid, scope_wait[1]);
+            }
+
             std::stringstream cmdline;
             cmdline << "Command line used: ";
             for (auto const& c : client_args)
             {
                 cmdline << c << " ";
             }
-            cmdline << token;
+            cmdline << (token ? token : "--standby");
             LogVerb2(cmdline.str());
-
-            // Wait for the child process to exit, as the client process will fork again
-            int rc = -1;
-            int w = waitpid(backend_pid, &rc, 0);
-            if (-1 == w)
-            {
-                std::stringstream msg;
-                msg << "Child process ("  << token
-                    << ") - pid " << backend_pid
-                    << " failed to start as expected (exit code: "
-                    << std::to_string(rc) << ")";
-                LogError(msg.str());
-                return -1;
-            }
             return backend_pid;
         }
+        if (scope_wait[0] >= 0)
+        {
+            close(scope_wait[0]);
+            close(scope_wait[1]);
+        }
         throw std::runtime_error("Failed to fork() backend client process");
     }
+
+
+    /**
+     *  Moves a new client process into its own scope unit and lets it
+     *  continue once done.  If the scope could not be set up, the
+     *  process continues in the cgroup of this service.
+     *
+     * @param pid      PID of the new client process
+     * @param wait_fd  Write end of the pipe the client process waits on
+     */
+    void start_client_scope(const pid_t pid, int wait_fd)
+    {
+        BackendScope::Start(dbuscon, pid, scope_settings,
+                            [self=Ptr(this), pid, wait_fd](const std::string& error)
+                            {
+                                if (error.empty())
+                                {
+                                    self->LogVerb2("Client process pid "
+                                                   + std::to_string(pid)
+                                                   + " runs in "
+                                                   + BackendScope::UnitName(pid));
+                                }
+                                else
+                                {
+                                    self->LogWarn(error);
+                                }
+                                if (write(wait_fd, "", 1) < 0)
+                                {
+                                    // Closing the pipe lets the process
+                                    // continue as well
+                                }
+                                close(wait_fd);
+                            });
+    }
 };
 
 
@@ -413,6 +1087,46 @@ public:
     }
 
 
+    /**
+     *  Configures the client pool.  See
+     *  BackendStarterObject::EnableClientPool() for details.
+     *
+     * @param size          Number of standby client processes to keep
+     * @param idle_timeout  Seconds without new clients before the pool
+     *                      is drained
+     */
+    void SetClientPool(const unsigned int size, const unsigned int idle_timeout)
+    {
+        pool_size = size;
+        pool_idle_timeout = idle_timeout;
+    }
+
+
+    /**
+     *  Sets how many VPN sessions each client pool process may host.
+     *  See BackendStarterObject::EnableClientPool() for details.
+     *
+     * @param sessions  Number of sessions per client process
+     */
+    void SetClientHostSessions(const unsigned int sessions)
+    {
+        host_sessions = sessions;
+    }
+
+
+    /**
+     *  Runs the client processes in their own scope units.  See
+     *  BackendStarterObject::EnableClientScopes() for details.
+     *
+     * @param rc  ResourceControl settings of the scope units
+     */
+    void EnableClientScopes(const ResourceControl& rc)
+    {
+        client_scopes = true;
+        scope_settings = rc;
+    }
+
+
     /**
      *  This callback is called when the service was successfully registered
      *  on the D-Bus.
@@ -431,6 +1145,12 @@ public:
         {
             mainobj->IdleCheck_Register(idle_checker);
         }
+        if (client_scopes)
+        {
+            mainobj->EnableClientScopes(scope_settings);
+        }
+        mainobj->EnableClientPool(pool_size, pool_idle_timeout, host_sessions);
+        StartupTiming::Instance().Mark("client_pool_enabled");
     };
 
 
@@ -449,6 +1169,17 @@ public:
     };
 
 
+    /**
+     *  Logs the start-up timeline of the backend starter
+     *
+     * @param timeline  std::string with the StartupTiming summary
+     */
+    void callback_startup_complete(const std::string& timeline)
+    {
+        mainobj->LogInfo("Start-up completed: " + timeline);
+    }
+
+
     /**
      *  This is called each time the well-known bus name is removed from the
      *  D-Bus.  In our case, we just throw an exception and starts shutting
@@ -471,10 +1202,37 @@ private:
     ProcessSignalProducer::Ptr procsig;
     std::vector<std::string> client_args;
     std::vector<std::string> client_envvars;
+    unsigned int pool_size = 0;
+    unsigned int pool_idle_timeout = 60;
+    unsigned int host_sessions = 1;
+    bool client_scopes = false;
+    ResourceControl scope_settings;
 };
 
 
 
+#ifdef ENABLE_IO_URING
+/**
+ *  Checks if the kernel allows setting up an io_uring instance.  It
+ *  may be disabled via the kernel.io_uring_disabled sysctl or a
+ *  seccomp filter.
+ *
+ * @return Returns true if io_uring can be used
+ */
+static bool io_uring_available()
+{
+    struct io_uring_params params = {};
+    int fd = syscall(__NR_io_uring_setup, 1, &params);
+    if (fd < 0)
+    {
+        return false;
+    }
+    close(fd);
+    return true;
+}
+#endif
+
+
 int backend_starter(ParsedArgs::Ptr args)
 {
     std::cout << get_version(args->GetArgv0()) << std::endl;
@@ -504,7 +1262,31 @@ int backend_starter(ParsedArgs::Ptr args)
     else
 #endif
     {
-        client_args.push_back(std::string(LIBEXEC_PATH) + "/openvpn3-service-client");
+        std::string client = "/openvpn3-service-client";
+#ifdef ENABLE_IO_URING
+        std::string engine = (args->Present("client-io-engine")
+                              ? args->GetLastValue("client-io-engine")
+                              : "epoll");
+        if ("io_uring" == engine)
+        {
+            if (io_uring_available())
+            {
+                client += "-uring";
+            }
+            else
+            {
+                std::cerr << "io_uring is not available, "
+                          << "using the epoll client backend" << std::endl;
+            }
+        }
+        else if ("epoll" != engine)
+        {
+            throw CommandException("openvpn3-service-backendstart",
+                                   "Invalid --client-io-engine value: "
+                                   + engine);
+        }
+#endif
+        client_args.push_back(std::string(LIBEXEC_PATH) + client);
     }
 #ifdef OPENVPN_DEBUG
     if (args->Present("client-no-fork"))
@@ -539,6 +1321,26 @@ int backend_starter(ParsedArgs::Ptr args)
     {
         client_args.push_back("--signal-broadcast");
     }
+    if (args->Present("client-core-cpus"))
+    {
+        client_args.push_back("--core-cpus");
+        client_args.push_back(args->GetLastValue("client-core-cpus"));
+    }
+    if (args->Present("client-core-nice"))
+    {
+        client_args.push_back("--core-nice");
+        client_args.push_back(args->GetLastValue("client-core-nice"));
+    }
+    if (args->Present("client-core-sched"))
+    {
+        client_args.push_back("--core-sched");
+        client_args.push_back(args->GetLastValue("client-core-sched"));
+    }
+    if (args->Present("client-core-numa-node"))
+    {
+        client_args.push_back("--core-numa-node");
+        client_args.push_back(args->GetLastValue("client-core-numa-node"));
+    }
 
     unsigned int log_level = 3;
     if (args->Present("log-level"))
@@ -555,17 +1357,80 @@ int backend_starter(ParsedArgs::Ptr args)
     DBus dbus(G_BUS_TYPE_SYSTEM);
     dbus.Connect();
 
+    // Looked up once, in the background, and passed on to all the
+    // client processes started
+    PlatformInfo::StartLookup(dbus.GetConnection());
+
     bool signal_broadcast = args->Present("signal-broadcast");
     LogServiceProxy::Ptr logsrvprx = nullptr;
     if (!signal_broadcast)
     {
-        logsrvprx = LogServiceProxy::AttachInterface(dbus.GetConnection(),
-                                                     OpenVPN3DBus_interf_backends);
+        // Attached from the main loop, so our own bus name is not held
+        // back by the log service being activated
+        LogServiceProxy::AttachInterfaceDeferred(dbus.GetConnection(),
+                                                 {OpenVPN3DBus_interf_backends},
+                                                 logsrvprx);
     }
 
     BackendStarterDBus backstart(dbus.GetConnection(), client_args,
                                  log_level, signal_broadcast);
 
+    if (args->Present("client-pool-size"))
+    {
+        unsigned int pool_idle = 60;
+        if (args->Present("client-pool-idle-timeout"))
+        {
+            pool_idle = std::atoi(args->GetValue("client-pool-idle-timeout", 0).c_str());
+        }
+        backstart.SetClientPool(std::atoi(args->GetValue("client-pool-size", 0).c_str()),
+                                pool_idle);
+    }
+    if (args->Present("client-host-sessions"))
+    {
+        int hs = std::atoi(args->GetLastValue("client-host-sessions").c_str());
+        if (hs < 1 || hs > 1024)
+        {
+            throw CommandException("openvpn3-service-backendstart",
+                                   "Invalid --client-host-sessions value: "
+                                   + args->GetLastValue("client-host-sessions"));
+        }
+        backstart.SetClientHostSessions(hs);
+        if (hs > 1 && !args->Present("client-pool-size"))
+        {
+            // Hosted sessions are handed out via the client pool
+            backstart.SetClientPool(1, 60);
+        }
+    }
+
+    if (args->Present("client-scope"))
+    {
+        ResourceControl rc;
+        try
+        {
+            if (args->Present("client-cpu-weight"))
+            {
+                rc.SetCPUWeight(args->GetLastValue("client-cpu-weight"));
+            }
+            if (args->Present("client-io-weight"))
+            {
+                rc.SetIOWeight(args->GetLastValue("client-io-weight"));
+            }
+            if (args->Present("client-memory-high"))
+            {
+                rc.SetMemoryHigh(args->GetLastValue("client-memory-high"));
+            }
+            if (args->Present("client-memory-max"))
+            {
+                rc.SetMemoryMax(args->GetLastValue("client-memory-max"));
+            }
+        }
+        catch (const ResourceControlException& excp)
+        {
+            throw CommandException("openvpn3-service-backendstart", excp.what());
+        }
+        backstart.EnableClientScopes(rc);
+    }
+
     IdleCheck::Ptr idle_exit;
     if (idle_wait_sec > 0)
     {
@@ -610,7 +1475,6 @@ int backend_starter(ParsedArgs::Ptr args)
     if (idle_wait_sec > 0)
     {
         idle_exit->Disable();
-        idle_exit->Join();
     }
 
     return 0;
@@ -619,6 +1483,8 @@ int backend_starter(ParsedArgs::Ptr args)
 
 int main(int argc, char **argv)
 {
+    StartupTiming::Instance().Mark("main");
+
     SingleCommand cmd(argv[0], "OpenVPN 3 VPN Client starter",
                              backend_starter);
     cmd.AddVersionOption();
@@ -654,6 +1520,42 @@ int main(int argc, char **argv)
                   "Adds the --disable-protect argument to openvpn3-service-client");
     cmd.AddOption("client-signal-broadcast", 0,
                   "Debug option: Adds the --signal-broadcast argument to openvpn3-service-client");
+    cmd.AddOption("client-core-cpus", "CPU-LIST", true,
+                  "Adds the --core-cpus argument to openvpn3-service-client");
+    cmd.AddOption("client-core-nice", "NICE", true,
+                  "Adds the --core-nice argument to openvpn3-service-client");
+    cmd.AddOption("client-core-sched", "POLICY[:PRIO]", true,
+                  "Adds the --core-sched argument to openvpn3-service-client");
+    cmd.AddOption("client-core-numa-node", "NODE", true,
+                  "Adds the --core-numa-node argument to openvpn3-service-client");
+#ifdef ENABLE_IO_URING
+    cmd.AddOption("client-io-engine", "ENGINE", true,
+                  "I/O engine of the openvpn3-service-client data path: "
+                  "epoll (default) or io_uring");
+#endif
+    cmd.AddOption("client-pool-size", "COUNT", true,
+                  "Keep COUNT openvpn3-service-client processes started in advance "
+                  "(Default: 0, disabled)");
+    cmd.AddOption("client-pool-idle-timeout", "SECONDS", true,
+                  "Stop the pooled client processes when no clients have been "
+                  "started for this long (Default: 60 seconds)");
+    cmd.AddOption("client-host-sessions", "COUNT", true,
+                  "Let each pooled openvpn3-service-client process run up "
+                  "to COUNT VPN sessions (Default: 1)");
+    cmd.AddOption("client-scope", 0,
+                  "Run each openvpn3-service-client process in its own "
+                  "systemd scope unit");
+    cmd.AddOption("client-cpu-weight", "WEIGHT", true,
+                  "CPU weight of each client scope unit, 1-10000 "
+                  "(Default: systemd default, 100)");
+    cmd.AddOption("client-io-weight", "WEIGHT", true,
+                  "IO weight of each client scope unit, 1-10000 "
+                  "(Default: systemd default, 100)");
+    cmd.AddOption("client-memory-high", "SIZE", true,
+                  "Memory usage above which a client process is throttled, "
+                  "like 256M");
+    cmd.AddOption("client-memory-max", "SIZE", true,
+                  "Memory limit of each client process, like 512M");
 
     try
     {
@@ -34,8 +34,14 @@
  *         connection.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
+#include <map>
 #include <sstream>
+#include <unordered_map>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #define SHUTDOWN_NOTIF_PROCESS_NAME "openvpn3-service-client"
 #include "dbus/core.hpp"
@@ -45,14 +51,21 @@
 #include "common/requiresqueue.hpp"
 #include "common/utils.hpp"
 #include "common/cmdargparser.hpp"
+#include "common/numa-topology.hpp"
 #include "common/platforminfo.hpp"
+#include "common/resource-control.hpp"
+#include "common/startup-timing.hpp"
+#include "common/thread-scheduling.hpp"
 #include "configmgr/proxy-configmgr.hpp"
 #include "log/ansicolours.hpp"
 #include "log/dbus-log.hpp"
 #include "log/logwriter.hpp"
 #include "log/logwriters/implementations.hpp"
 #include "log/proxy-log.hpp"
+#include "backend-scope.hpp"
 #include "backend-signals.hpp"
+#include "remote-race.hpp"
+#include "stats-history.hpp"
 
 
 #define USE_TUN_BUILDER
@@ -60,6 +73,14 @@
 
 using namespace openvpn;
 
+/// Timer slack used with the power-save override; keep-alive and probe
+/// timers work on a scale of seconds, so this delay is not noticeable
+static const std::chrono::milliseconds power_save_timer_slack(50);
+
+/// How long a tunnel must be idle before the heap is trimmed with the
+/// low-memory override
+static const std::chrono::seconds low_memory_idle_period(300);
+
 #define THROW_CLIENTEXCEPTION(m) throw ClientException(m, __FILE__, __LINE__, __FUNCTION__)
 class ClientException : public DBusException
 {
@@ -105,7 +126,7 @@ public:
           DBusConnectionCreds(conn),
           dbusconn(conn),
           mainloop(nullptr),
-          signal(conn, LogGroup::CLIENT, session_token, logwr),
+          signal(conn, LogGroup::CLIENT, session_token, logwr, objpath),
           signal_broadcast(false),
           session_token(session_token),
           registered(false),
@@ -117,6 +138,10 @@ public:
     {
         signal.SetLogLevel(default_log_level);
 
+        // Keep the most recent log events, regardless of the log level,
+        // for late attaching log consumers.  See FetchLogHistory.
+        signal.EnableLogHistory(1024);
+
         std::stringstream introspection_xml;
         introspection_xml << "<node name='" << objpath << "'>"
                           << "    <interface name='" << OpenVPN3DBus_interf_backends << "'>"
@@ -130,6 +155,8 @@ public:
                           << "            <arg type='b' name='alive' direction='out'/>"
                           << "        </method>"
                           << "        <method name='Ready'/>"
+                          << "        <method name='PeerLinkOpen'/>"
+                          << "        <method name='PeerLinkActivate'/>"
                           << "        <method name='Connect'/>"
                           << "        <method name='Pause'>"
                           << "            <arg type='s' name='reason' direction='in'/>"
@@ -138,10 +165,44 @@ public:
                           << "        <method name='Restart'/>"
                           << "        <method name='Disconnect'/>"
                           << "        <method name='ForceShutdown'/>"
+                          << "        <method name='StatisticsInterval'>"
+                          << "            <arg type='u' name='interval_ms' direction='in'/>"
+                          << "        </method>"
+                          << "        <method name='FetchLogHistory'>"
+                          << "            <arg type='u' name='max_events' direction='in'/>"
+                          << "            <arg type='aa{sv}' name='events' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='GetStatsHistory'>"
+                          << "            <arg type='t' name='since' direction='in'/>"
+                          << "            <arg type='u' name='step' direction='in'/>"
+                          << "            <arg type='u' name='step' direction='out'/>"
+                          << "            <arg type='as' name='keys' direction='out'/>"
+                          << "            <arg type='at' name='timestamps' direction='out'/>"
+                          << "            <arg type='at' name='values' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='DumpLogHistory'>"
+                          << "            <arg type='u' name='events_sent' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchReconnectState'>"
+                          << "            <arg type='a{ss}' name='state' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='SetReconnectState'>"
+                          << "            <arg type='a{ss}' name='state' direction='in'/>"
+                          << "        </method>"
+                          << "        <method name='SetRemoteBackoff'>"
+                          << "            <arg type='a{su}' name='delays' direction='in'/>"
+                          << "        </method>"
+                          << "        <method name='SetBundle'>"
+                          << "            <arg type='s' name='bundle_id' direction='in'/>"
+                          << "            <arg type='u' name='index' direction='in'/>"
+                          << "            <arg type='u' name='size' direction='in'/>"
+                          << "        </method>"
                           << RequiresQueue::IntrospectionMethods("UserInputQueueGetTypeGroup",
                                                                  "UserInputQueueFetch",
                                                                  "UserInputQueueCheck",
                                                                  "UserInputProvide")
+                          << RequiresQueue::IntrospectionBatchMethods("UserInputQueueFetchAll",
+                                                                      "UserInputProvideResponses")
                           << "        <property name='log_level' type='u' access='readwrite'/>"
                           << "        <property name='session_path' type='s' access='read'/>"
                           << "        <property name='session_name' type='s' access='read'/>"
@@ -157,8 +218,23 @@ public:
                           << "            <arg type='s' name='busname' direction='out'/>"
                           << "            <arg type='s' name='token' direction='out'/>"
                           << "        </signal>"
+                          << "        <signal name='Statistics'>"
+                          << "            <arg type='u' name='layout_id' direction='out'/>"
+                          << "            <arg type='at' name='counters' direction='out'/>"
+                          << "        </signal>"
+                          << "        <signal name='RemoteStatus'>"
+                          << "            <arg type='s' name='remote' direction='out'/>"
+                          << "            <arg type='b' name='reachable' direction='out'/>"
+                          << "        </signal>"
+                          << "        <signal name='SessionName'>"
+                          << "            <arg type='s' name='session_name' direction='out'/>"
+                          << "        </signal>"
                           << "        <property type='a{sx}' name='statistics' access='read'/>"
+                          << "        <property type='(uas)' name='statistics_layout' access='read'/>"
+                          << "        <property type='at' name='statistics_packed' access='read'/>"
+                          << "        <property type='a{sv}' name='path_quality' access='read'/>"
                           << "        <property type='(uus)' name='status' access='read'/>"
+                          << "        <property type='a(st)' name='connect_timing' access='read'/>"
                           << "        <property type='b' name='dco' access='readwrite'/>"
                           << "        <property type='o' name='device_path' access='read'/>"
                           << "        <property type='s' name='device_name' access='read'/>"
@@ -172,6 +248,7 @@ public:
         // bus name needs to be sent back.
         signal.LogVerb1("Initializing VPN client session, token "
                         + session_token);
+        signal.Timing().Mark("backend_registration_request");
         signal.Send(OpenVPN3DBus_name_sessions,
                     OpenVPN3DBus_interf_backends,
                     "RegistrationRequest",
@@ -183,6 +260,11 @@ public:
 
     ~BackendClientObject()
     {
+        set_statistics_interval(0);
+        if (0 < history_timer)
+        {
+            g_source_remove(history_timer);
+        }
         if (client_thread && client_thread->joinable())
             client_thread->join();
     }
@@ -201,6 +283,24 @@ public:
     }
 
 
+    /**
+     *  Sets the function called when this session is done, instead of
+     *  stopping the main loop.  This is used when the process hosts
+     *  several sessions; the function must remove this object.
+     *
+     *  The function may be called from another thread than the main
+     *  loop, and while a D-Bus method call on this object is being
+     *  processed.
+     *
+     * @param done  std::function to call when the session is done
+     */
+    void SetSessionDoneCallback(std::function<void()> done)
+    {
+        session_done = done;
+        signal.SetFatalHandler(done);
+    }
+
+
     /**
      *  Broadcast all signals, instead of targeted signals.  This is
      *  disabled by default and must be enabled explicitly.  This is
@@ -216,6 +316,19 @@ public:
     }
 
 
+    /**
+     *  Sets the rate limit of the Log signals sent by this VPN session
+     *
+     * @param rate   Average number of log events per second.  0 disables
+     *               the rate limiting.
+     * @param burst  Number of log events allowed in a burst
+     */
+    void SetLogRateLimit(const unsigned int rate, const unsigned int burst)
+    {
+        signal.SetRateLimit(rate, burst);
+    }
+
+
     /**
      *  Sets the flag disabling the ProtectSocket method.  If this is
      *  set to true, any calls to socket_protect ends up as a NOOP with
@@ -231,6 +344,31 @@ public:
     }
 
 
+    /**
+     *  Sets the CPU affinity and scheduling settings of the thread
+     *  running the Core library client.  Configuration profile overrides
+     *  are applied on top of these settings.
+     *
+     * @param sched  ThreadScheduling with the service wide settings
+     */
+    void SetCoreThreadScheduling(const ThreadScheduling& sched)
+    {
+        core_thread_sched = sched;
+    }
+
+
+    /**
+     *  Sets the NUMA node the thread running the Core library client is
+     *  placed on.  The core-numa-node override replaces it.
+     *
+     * @param node  std::string with a node number, "auto" or empty
+     */
+    void SetCoreNumaNode(const std::string& node)
+    {
+        core_numa_node = node;
+    }
+
+
     /**
      *  Callback method which is called each time a D-Bus method call occurs
      *  on this BackendClientObject.
@@ -318,6 +456,7 @@ public:
 
                 if (registered)
                 {
+                    signal.Timing().Mark("backend_registered");
                     LogServiceProxy lgs(GetConnection());
                     lgs.AssignSession(sessionpath, OpenVPN3DBus_interf_backends);
 
@@ -325,6 +464,11 @@ public:
                     // Since the configuration may be set up for single-use
                     // only, we must keep this config as long as we're running
                     std::string config_name = fetch_configuration();
+                    signal.Timing().Mark("config_fetched");
+                    if (log_direct)
+                    {
+                        open_direct_log(lgs, sessionpath);
+                    }
                     g_dbus_method_invocation_return_value(invoc,
                                                           g_variant_new("(s)", config_name.c_str()));
 
@@ -352,6 +496,51 @@ public:
                 g_dbus_method_invocation_return_value(invoc, g_variant_new("(b)", (bool) true));
                 return;
             }
+            else if ("PeerLinkOpen" == method_name)
+            {
+                // The session manager passes one end of a socket pair,
+                // which is used for a private D-Bus connection between
+                // the session manager and this session.  The connection
+                // is set up in the background, the session manager waits
+                // for this object to appear on it.
+                int fd = GLibUtils::get_fd_from_invocation(invoc);
+                if (fd < 0)
+                {
+                    THROW_DBUSEXCEPTION("BackendServiceObject",
+                                        "No file descriptor provided");
+                }
+                BackendClientObject::Ptr self(this);
+                DBusPeerLink::Accept(fd,
+                                     [self, sender](DBusPeerLink::Ptr link,
+                                                    const std::string& error)
+                                     {
+                                         std::lock_guard<std::mutex> lg(self->guard);
+                                         if (!link)
+                                         {
+                                             self->signal.LogWarn("Could not set up the session manager link: "
+                                                                  + error);
+                                             return;
+                                         }
+                                         self->RegisterPeerObject(link->GetConnection(), sender);
+                                         self->peer_link = link;
+                                     });
+                g_dbus_method_invocation_return_value(invoc, NULL);
+                return;
+            }
+            else if ("PeerLinkActivate" == method_name)
+            {
+                // Called by the session manager over the peer link once
+                // it listens for signals on it
+                if (!peer_link || peer_link->GetConnection() != conn)
+                {
+                    THROW_DBUSEXCEPTION("BackendServiceObject",
+                                        "PeerLinkActivate must be called over the peer link");
+                }
+                signal.SetPeerLink(peer_link);
+                signal.Debug("Using the private session manager link");
+                g_dbus_method_invocation_return_value(invoc, NULL);
+                return;
+            }
             else if ("Ready" == method_name)
             {
                 // This method should just exit without any result if everything is okay.
@@ -401,6 +590,10 @@ public:
                     return;
                 }
                 signal.LogInfo("Starting connection");
+
+                // Only the latest connection attempt is of interest
+                signal.Timing().ResetAfter("config_fetched");
+                signal.Timing().Mark("connect_requested");
                 connect();
             }
             else if ("Disconnect" == method_name)
@@ -415,6 +608,7 @@ public:
 
                 signal.LogInfo("Stopping connection");
                 signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_DISCONNECTING);
+                vpnclient->interrupt_backoff_wait(true);
                 vpnclient->stop();
                 if (client_thread)
                 {
@@ -424,14 +618,7 @@ public:
 
                 // Shutting down our selves.
                 RemoveObject(dbusconn);
-                if (mainloop)
-                {
-                    g_main_loop_quit(mainloop);
-                }
-                else
-                {
-                    kill(getpid(), SIGTERM);
-                }
+                shutdown_session();
             }
             else if ("UserInputQueueGetTypeGroup"  == method_name)
             {
@@ -465,6 +652,21 @@ public:
                 }
                 return; // QueueFetch() have fed invoc with a result already
             }
+            else if ("UserInputQueueFetchAll"  == method_name)
+            {
+                // Retrieves all the RequiresQueue items the front-end
+                // still needs to satisfy, in a single reply
+
+                try
+                {
+                    userinputq.QueueFetchAll(invoc);
+                }
+                catch (RequiresQueueException& excp)
+                {
+                    excp.GenerateDBusError(invoc);
+                }
+                return; // QueueFetchAll() have fed invoc with a result already
+            }
             else if ("UserInputQueueCheck" == method_name)
             {
                 // Retrieve the RequiresSlot IDs for a specific
@@ -494,6 +696,34 @@ public:
                 }
                 userinputq.UpdateEntry(invoc, params);
             }
+            else if ("UserInputProvideResponses" == method_name)
+            {
+                // Updates several RequiresSlots in one call.  Either all
+                // the responses are accepted or none of them are.
+
+                if (!registered)
+                {
+                    THROW_DBUSEXCEPTION("BackendServiceObject", "Backend service is not initialized");
+                }
+
+                if (userinputq.QueueAllDone())
+                {
+                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.backend",
+                                                                  "Credentials not needed");
+                    g_dbus_method_invocation_return_gerror(invoc, err);
+                    g_error_free(err);
+                    return;
+                }
+                try
+                {
+                    userinputq.UpdateEntries(invoc, params);
+                }
+                catch (RequiresQueueException& excp)
+                {
+                    excp.GenerateDBusError(invoc);
+                }
+                return;
+            }
             else if ("Pause" == method_name)
             {
                 // Pauses and suspends an on-going and connected VPN tunnel.
@@ -521,6 +751,7 @@ public:
                 signal.LogInfo("Pausing connection");
                 signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_PAUSING,
                                     "Reason: " + reason);
+                vpnclient->interrupt_backoff_wait();
                 vpnclient->pause(reason);
                 paused = true;
                 signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_PAUSED);
@@ -561,6 +792,7 @@ public:
                 signal.LogInfo("Restarting connection");
                 signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RECONNECTING);
                 paused = false;
+                vpnclient->interrupt_backoff_wait();
                 vpnclient->reconnect(0);
             }
             else if ("ForceShutdown" == method_name)
@@ -577,13 +809,124 @@ public:
 
                 // Shutting down our selves.
                 RemoveObject(dbusconn);
-                if (mainloop)
+                shutdown_session();
+            }
+            else if ("StatisticsInterval" == method_name)
+            {
+                // Starts, changes or stops the periodic Statistics signal.
+                // The session manager sets this to the shortest interval
+                // requested by its subscribers; 0 disables it.
+                GLibUtils::checkParams(__func__, params, "(u)", 1);
+                set_statistics_interval(GLibUtils::ExtractValue<uint32_t>(params, 0));
+            }
+            else if ("FetchLogHistory" == method_name)
+            {
+                GLibUtils::checkParams(__func__, params, "(u)", 1);
+                uint32_t max_events = GLibUtils::ExtractValue<uint32_t>(params, 0);
+
+                GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("aa{sv}"));
+                for (auto& ev : signal.GetLogHistory(max_events))
                 {
-                    g_main_loop_quit(mainloop);
+                    ev.RemoveToken();
+                    g_variant_builder_add_value(b, ev.GetGVariantDict());
                 }
-                else
+                g_dbus_method_invocation_return_value(invoc,
+                                                      GLibUtils::wrapInTuple(b));
+                return;
+            }
+            else if ("GetStatsHistory" == method_name)
+            {
+                GLibUtils::checkParams(__func__, params, "(tu)", 2);
+                uint64_t since = GLibUtils::ExtractValue<uint64_t>(params, 0);
+                uint32_t step = GLibUtils::ExtractValue<uint32_t>(params, 1);
+
+                StatsHistory::Series series;
+                {
+                    std::lock_guard<std::mutex> lg(guard);
+                    series = stats_history.Get(since, step);
+                }
+                g_dbus_method_invocation_return_value(invoc,
+                    GLibUtils::MarshalTuple(series.step, StatsHistory::Keys(),
+                                            series.timestamps, series.values));
+                return;
+            }
+            else if ("DumpLogHistory" == method_name)
+            {
+                size_t sent = signal.DumpLogHistory("an explicit request");
+                g_dbus_method_invocation_return_value(invoc,
+                                                      g_variant_new("(u)", (uint32_t) sent));
+                return;
+            }
+            else if ("FetchReconnectState" == method_name)
+            {
+                GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a{ss}"));
+                for (const auto& kv : fetch_reconnect_state())
+                {
+                    g_variant_builder_add(b, "{ss}",
+                                          kv.first.c_str(), kv.second.c_str());
+                }
+                g_dbus_method_invocation_return_value(invoc,
+                                                      GLibUtils::wrapInTuple(b));
+                return;
+            }
+            else if ("SetReconnectState" == method_name)
+            {
+                GLibUtils::checkParams(__func__, params, "(a{ss})", 1);
+                std::map<std::string, std::string> state;
+                GVariantIter *it = nullptr;
+                g_variant_get(params, "(a{ss})", &it);
+                gchar *key = nullptr;
+                gchar *value = nullptr;
+                while (g_variant_iter_loop(it, "{ss}", &key, &value))
+                {
+                    state[key] = value;
+                }
+                g_variant_iter_free(it);
+                set_reconnect_state(std::move(state));
+            }
+            else if ("SetRemoteBackoff" == method_name)
+            {
+                GLibUtils::checkParams(__func__, params, "(a{su})", 1);
+                const auto now = std::chrono::steady_clock::now();
+                remote_backoff.clear();
+                GVariantIter *it = nullptr;
+                g_variant_get(params, "(a{su})", &it);
+                gchar *remote = nullptr;
+                guint32 delay_ms = 0;
+                while (g_variant_iter_loop(it, "{su}", &remote, &delay_ms))
+                {
+                    remote_backoff[remote] = now + std::chrono::milliseconds(delay_ms);
+                }
+                g_variant_iter_free(it);
+
+                if (!shared_backoff)
+                {
+                    shared_backoff = true;
+                    if (vpnclient)
+                    {
+                        setup_remote_race();
+                    }
+                }
+                apply_remote_backoff();
+            }
+            else if ("SetBundle" == method_name)
+            {
+                GLibUtils::checkParams(__func__, params, "(suu)", 3);
+                gchar *id = nullptr;
+                guint32 index = 0;
+                guint32 size = 0;
+                g_variant_get(params, "(suu)", &id, &index, &size);
+                bundle_id = std::string(id);
+                g_free(id);
+                bundle_index = index;
+                bundle_size = size;
+                signal.LogVerb2("Session " + std::to_string(index + 1)
+                                + " of " + std::to_string(size)
+                                + " in bundle " + bundle_id);
+                if (vpnclient)
                 {
-                    kill(getpid(), SIGTERM);
+                    vpnclient->set_bundle(bundle_id);
+                    setup_remote_race();
                 }
             }
             else
@@ -672,23 +1015,49 @@ public:
 
                 // Returns an array of a string (description) and an int64
                 // containing the statistics value.
-                GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a{sx}"));
-                if (vpnclient)
+                return GLibUtils::Marshal(vpnclient ? vpnclient->GetStats()
+                                                    : ConnectionStats());
+            }
+            else if ("statistics_layout" == property_name)
+            {
+                // The key table of the statistics_packed property.  This
+                // is static, so it is only built once.
+                static GVariant *layout = nullptr;
+                if (nullptr == layout)
                 {
-                    for (auto& sd : vpnclient->GetStats())
-                    {
-                        g_variant_builder_add (b, "{sx}",
-                                               sd.key.c_str(), sd.value);
-                    }
+                    layout = g_variant_ref_sink(GLibUtils::MarshalTuple(get_stats_layout_id(),
+                                                                        CoreVPNClient::GetStatsLayout()));
+                }
+                return g_variant_ref(layout);
+            }
+            else if ("statistics_packed" == property_name)
+            {
+                // All the statistics counters, in the order of the
+                // statistics_layout key table
+                if (!vpnclient)
+                {
+                    return GLibUtils::Marshal(std::vector<uint64_t>(CoreVPNClient::GetStatsLayout().size()));
+                }
+                return vpnclient->GetPackedStats();
+            }
+            else if ("path_quality" == property_name)
+            {
+                // Round-trip time histogram and summary of the probes
+                // through the tunnel, see the path-quality override
+                if (!vpnclient)
+                {
+                    return get_path_quality(PathQuality());
                 }
-                GVariant *ret = g_variant_builder_end(b);
-                g_variant_builder_unref(b);
-                return ret;
+                return get_path_quality(vpnclient->GetPathQuality());
             }
             else if ("status" == property_name)
             {
                 return signal.GetLastStatusChange();
             }
+            else if ("connect_timing" == property_name)
+            {
+                return signal.Timing().GetGVariant();
+            }
             else if ("device_name" == property_name)
             {
                 return g_variant_new_string((vpnclient ? vpnclient->netcfg_get_device_name().c_str() : ""));
@@ -787,6 +1156,71 @@ public:
 
 
 private:
+    /**
+     *  Subscription to the EgressChange signals the netcfg service sends
+     *  to this process
+     */
+    class EgressChangeSubscription : public DBusSignalSubscription
+    {
+    public:
+        using Callback = std::function<void(const std::string& reason)>;
+
+        EgressChangeSubscription(GDBusConnection *conn, Callback cb)
+            : DBusSignalSubscription(conn, OpenVPN3DBus_name_netcfg,
+                                     OpenVPN3DBus_interf_netcfg,
+                                     OpenVPN3DBus_rootp_netcfg,
+                                     "EgressChange"),
+              callback(cb)
+        {
+        }
+
+        void callback_signal_handler(GDBusConnection *connection,
+                                     const std::string sender_name,
+                                     const std::string obj_path,
+                                     const std::string interface_name,
+                                     const std::string signal_name,
+                                     GVariant *parameters) override
+        {
+            callback(GLibUtils::ExtractValue<std::string>(parameters, 0));
+        }
+
+    private:
+        Callback callback;
+    };
+
+    /**
+     *  Subscription to the PeerDeleted signals the netcfg service sends
+     *  to this process when the ovpn-dco kernel module removed the peer
+     */
+    class DcoPeerDeletedSubscription : public DBusSignalSubscription
+    {
+    public:
+        using Callback = std::function<void(const uint32_t peer_id,
+                                            const std::string& reason)>;
+
+        DcoPeerDeletedSubscription(GDBusConnection *conn, Callback cb)
+            : DBusSignalSubscription(conn, OpenVPN3DBus_name_netcfg,
+                                     OpenVPN3DBus_interf_netcfg,
+                                     "", "PeerDeleted"),
+              callback(cb)
+        {
+        }
+
+        void callback_signal_handler(GDBusConnection *connection,
+                                     const std::string sender_name,
+                                     const std::string obj_path,
+                                     const std::string interface_name,
+                                     const std::string signal_name,
+                                     GVariant *parameters) override
+        {
+            callback(GLibUtils::ExtractValue<uint32_t>(parameters, 0),
+                     GLibUtils::ExtractValue<std::string>(parameters, 1));
+        }
+
+    private:
+        Callback callback;
+    };
+
     GDBusConnection *dbusconn;
     GMainLoop *mainloop;
     BackendSignals signal;
@@ -798,14 +1232,72 @@ private:
     std::string configpath;
     CoreVPNClient::Ptr vpnclient;
     bool disabled_socket_protect;
+    ThreadScheduling core_thread_sched;
+    NetCfg::SteeringSettings cpu_steering;  ///< See the device-*-cpus overrides
+    NetCfg::QueueSettings queueing;         ///< See the device-qdisc overrides
+    bool core_follow_device = false;        ///< core-cpu-affinity set to "device"
+    std::string core_numa_node;             ///< See the core-numa-node override
+    ResourceControl resource_control;       ///< See the backend-*-weight overrides
     std::string dns_scope = "global";
     bool ignore_dns_cfg;
+    bool reuse_tun_device = false;
+    bool path_mtu_discovery = false;
+    bool path_quality_probe = false;
+    bool adaptive_socket_buffers = false;  ///< See adaptive-socket-buffers override
+    SocketBuffers::Limits socket_buffer_limits;
+    bool power_save = false;       ///< Coalesce timer wake-ups, see power-save override
+    bool low_memory = false;       ///< Keep the heap small, see low-memory override
+    bool failover_standby = false; ///< Keep a probed standby remote while connected
+    bool shared_resolver = false;  ///< Resolve remotes via netcfg, see shared-resolver override
+    bool shared_backoff = false;   ///< Remote backoff shared via the session manager, see SetRemoteBackoff
+    std::map<std::string, std::chrono::steady_clock::time_point> remote_backoff;
+    bool log_direct = false;       ///< Log to a log service provided fd, see log-direct override
+    std::string bundle_id;         ///< Bundle of parallel sessions, see SetBundle
+    unsigned int bundle_index = 0;
+    unsigned int bundle_size = 0;
+    unsigned int connect_race = 0; ///< Remotes to probe concurrently, 0 disables
+    std::unique_ptr<EgressChangeSubscription> egress_subscription;
+    std::unique_ptr<DcoPeerDeletedSubscription> dco_peer_subscription;
     std::unique_ptr<std::thread> client_thread;
+    guint stats_timer = 0;
+    GVariant *stats_last = nullptr;
+    guint history_timer = 0;
+    StatsHistory stats_history;    ///< Key counters of the last hour, see GetStatsHistory
     ClientAPI::Config vpnconfig;
+    std::string preparse_error;
+    bool profile_has_cert = false;
+    std::string profile_verb;
+    std::vector<RaceRemote> profile_remotes;
+    bool profile_race_capable = false; ///< Remote racing can be used with the profile
+    bool profile_udp_probe = false;    ///< UDP remotes of the profile can be probed
+    std::map<std::string, std::string> reconnect_state; ///< See SetReconnectState
     ClientAPI::EvalConfig cfgeval;
     ClientAPI::ProvideCreds creds;
     RequiresQueue userinputq;
     std::mutex guard;
+    std::function<void()> session_done = nullptr;
+    DBusPeerLink::Ptr peer_link = nullptr; ///< Private session manager link, see PeerLinkOpen
+
+
+    /**
+     *  Stops this session once it has been disconnected.  Unless the
+     *  process hosts several sessions, this stops the whole process.
+     */
+    void shutdown_session()
+    {
+        if (session_done)
+        {
+            session_done();
+        }
+        else if (mainloop)
+        {
+            g_main_loop_quit(mainloop);
+        }
+        else
+        {
+            kill(getpid(), SIGTERM);
+        }
+    }
 
 
     /**
@@ -836,68 +1328,282 @@ private:
 
 
     /**
-     *  This implements the POSIX thread running the CoreVPNClient session
+     *  Builds the path_quality property value
+     *
+     * @param pq  PathQuality with the recorded probes
+     *
+     * @return Returns a new floating GVariant 'a{sv}' dictionary
      */
-    void run_connection_thread()
+    static GVariant * get_path_quality(const PathQuality& pq)
     {
-        asio::detail::signal_blocker sigblock; // Block signals in client thread
+        PathQuality::Summary s = pq.GetSummary();
+        GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        for (const auto& v : std::vector<std::pair<const char *, uint64_t>>{
+                {"probes_answered", s.samples},
+                {"probes_lost", s.lost},
+                {"loss_ppm", s.loss_ppm},
+                {"rtt_min_us", s.min},
+                {"rtt_max_us", s.max},
+                {"rtt_mean_us", s.mean},
+                {"rtt_p50_us", s.p50},
+                {"rtt_p90_us", s.p90},
+                {"rtt_p99_us", s.p99},
+                {"jitter_us", s.jitter}})
+        {
+            g_variant_builder_add(b, "{sv}", v.first, g_variant_new_uint64(v.second));
+        }
+        g_variant_builder_add(b, "{sv}", "histogram",
+                              GLibUtils::Marshal(pq.GetHistogram()));
+        GVariant *ret = g_variant_builder_end(b);
+        g_variant_builder_unref(b);
+        return ret;
+    }
 
-        try
+
+    /**
+     *  Retrieve the layout ID of the statistics counter table.  The
+     *  table is static for the lifetime of this process.
+     *
+     * @return Returns the layout ID as reported by statistics_layout
+     */
+    static uint32_t get_stats_layout_id()
+    {
+        static const uint32_t layout_id =
+            ConnectionStatsLayoutID(CoreVPNClient::GetStatsLayout());
+        return layout_id;
+    }
+
+
+    /**
+     *  Starts, reschedules or stops the timer emitting the periodic
+     *  Statistics signal.
+     *
+     * @param interval_ms  Interval between each signal, in milliseconds.
+     *                     0 stops the timer.  Shorter intervals than
+     *                     100ms are raised to 100ms.  With the power-save
+     *                     override, intervals of a second or more are
+     *                     rounded to whole seconds.
+     */
+    void set_statistics_interval(unsigned int interval_ms)
+    {
+        if (0 < stats_timer)
         {
-            signal.Debug(std::string("[Connect] DCO flag: ") + (vpnconfig.dco ? "enabled" : "disabled"));
-            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTING, "");
-            ClientAPI::Status status = vpnclient->connect();
-            if (status.error)
-            {
-                std::stringstream msg;
-                msg << status.message;
-                if (!status.status.empty())
-                {
-                    msg << " {" << status.status << "}";
-                }
-                signal.LogError("Connection failed: " + status.message);
-                signal.Debug("Connection failed: " + msg.str());
-                signal.StatusChange(StatusMajor::CONNECTION,
-                                    StatusMinor::CONN_FAILED,
-                                    msg.str());
-            }
+            g_source_remove(stats_timer);
+            stats_timer = 0;
         }
-        catch (openvpn::Exception& excp)
+        if (stats_last)
         {
-            signal.LogFATAL(excp.what());
+            g_variant_unref(stats_last);
+            stats_last = nullptr;
         }
-   }
+        if (0 == interval_ms)
+        {
+            return;
+        }
+        if (power_save && interval_ms >= 1000)
+        {
+            // Whole second timers of all processes fire together, so the
+            // CPU is woken up once for all the backends
+            stats_timer = g_timeout_add_seconds((interval_ms + 500) / 1000,
+                                                stats_timer_cb, this);
+            return;
+        }
+        stats_timer = g_timeout_add((interval_ms < 100 ? 100 : interval_ms),
+                                    stats_timer_cb, this);
+    }
 
 
     /**
-     *  Starts a new POSIX thread which will run the
-     *  VPN client (CoreVPNClient)
+     *  Compares two packed statistics arrays, ignoring the CPU usage
+     *  counters at the end.  These change on every sample, as taking
+     *  the sample uses CPU time as well.
+     *
+     * @param prev  GVariant with the previous packed statistics
+     * @param cur   GVariant with the current packed statistics
+     *
+     * @return Returns true if any of the other counters changed
      */
-    void connect()
+    static bool stats_changed(GVariant *prev, GVariant *cur)
     {
-        try
+        gsize n_prev = 0;
+        gsize n_cur = 0;
+        const uint64_t *a = static_cast<const uint64_t *>(
+            g_variant_get_fixed_array(prev, &n_prev, sizeof(uint64_t)));
+        const uint64_t *b = static_cast<const uint64_t *>(
+            g_variant_get_fixed_array(cur, &n_cur, sizeof(uint64_t)));
+        if (n_prev != n_cur)
         {
-            if (!registered || !vpnclient)
-            {
-                THROW_DBUSEXCEPTION("BackendServiceObject",
-                                    "Session object not properly registered or not initialized");
-            }
+            return true;
+        }
+        const gsize n_cpu = CoreVPNClient::GetCPUStatsKeys().size();
+        const gsize n = (n_cur > n_cpu ? n_cur - n_cpu : 0);
+        return !std::equal(a, a + n, b);
+    }
 
-            // FIXME: Seems redundant with what is in call_
-            if (!userinputq.QueueAllDone())
-            {
-                THROW_DBUSEXCEPTION("BackendServiceObject",
-                                    "Required user input needs to be provided first");
-            }
 
-            bool provide_creds = false;
-            if (userinputq.QueueCount(ClientAttentionType::CREDENTIALS,
-                                      ClientAttentionGroup::USER_PASSWORD) > 0)
-            {
-                creds.username = userinputq.GetResponse(ClientAttentionType::CREDENTIALS,
-                                                        ClientAttentionGroup::USER_PASSWORD,
-                                                        "username");
-                if (userinputq.QueueCount(ClientAttentionType::CREDENTIALS,
+    /**
+     *  Timer callback emitting the Statistics signal.  Coalesces
+     *  updates, the signal is only sent when some counters changed since
+     *  the previous signal.
+     *
+     * @param this_ptr  Pointer to the BackendClientObject
+     *
+     * @return Always G_SOURCE_CONTINUE; the timer is only removed by
+     *         set_statistics_interval()
+     */
+    static gboolean stats_timer_cb(gpointer this_ptr)
+    {
+        BackendClientObject *self = static_cast<BackendClientObject *>(this_ptr);
+        std::lock_guard<std::mutex> lg(self->guard);
+
+        if (!self->vpnclient)
+        {
+            return G_SOURCE_CONTINUE;
+        }
+
+        GVariant *counters = g_variant_ref_sink(self->vpnclient->GetPackedStats());
+        if (self->stats_last && !stats_changed(self->stats_last, counters))
+        {
+            g_variant_unref(counters);
+            return G_SOURCE_CONTINUE;
+        }
+        self->signal.Statistics(get_stats_layout_id(), counters);
+        if (self->stats_last)
+        {
+            g_variant_unref(self->stats_last);
+        }
+        self->stats_last = counters;
+        return G_SOURCE_CONTINUE;
+    }
+
+
+    /**
+     *  Timer callback recording the key statistics counters in the
+     *  stats_history ring every second, see GetStatsHistory.
+     *
+     * @param this_ptr  Pointer to the BackendClientObject
+     *
+     * @return Always G_SOURCE_CONTINUE
+     */
+    static gboolean history_timer_cb(gpointer this_ptr)
+    {
+        BackendClientObject *self = static_cast<BackendClientObject *>(this_ptr);
+        std::lock_guard<std::mutex> lg(self->guard);
+
+        if (!self->vpnclient)
+        {
+            return G_SOURCE_CONTINUE;
+        }
+
+        GVariant *counters = g_variant_ref_sink(self->vpnclient->GetPackedStats());
+        gsize n = 0;
+        const uint64_t *values = static_cast<const uint64_t *>(
+            g_variant_get_fixed_array(counters, &n, sizeof(uint64_t)));
+        self->stats_history.Add(time(nullptr), values, n);
+        g_variant_unref(counters);
+
+        std::string changes = self->vpnclient->SampleSocketBuffers();
+        if (!changes.empty())
+        {
+            self->signal.LogVerb2("Transport socket: " + changes);
+        }
+        if (self->vpnclient->SampleHeap())
+        {
+            self->signal.LogVerb2("Tunnel idle, unused heap memory returned");
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+
+    /**
+     *  This implements the POSIX thread running the CoreVPNClient session
+     */
+    void run_connection_thread()
+    {
+        asio::detail::signal_blocker sigblock; // Block signals in client thread
+
+        // Only this thread is tuned; the D-Bus main loop thread
+        // keeps the process defaults
+        if (!core_thread_sched.empty())
+        {
+            for (const auto& err : core_thread_sched.ApplyToCurrentThread())
+            {
+                signal.LogWarn("Core thread: " + err);
+            }
+            signal.LogVerb2("Core thread scheduling: "
+                            + core_thread_sched.str());
+        }
+
+        // The sessions hosted by the same process share its CPU usage;
+        // each of them reports the one of its own Core library thread
+        if (session_done)
+        {
+            vpnclient->set_cpu_usage_thread((pid_t) syscall(SYS_gettid));
+        }
+
+        try
+        {
+            signal.Debug(std::string("[Connect] DCO flag: ") + (vpnconfig.dco ? "enabled" : "disabled"));
+#ifdef ASIO_DISABLE_EPOLL
+            if (!vpnconfig.dco)
+            {
+                signal.LogVerb2("Data path I/O engine: io_uring");
+            }
+#endif
+            signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTING, "");
+            signal.Timing().Mark("core_connect");
+            ClientAPI::Status status = vpnclient->connect();
+            if (status.error)
+            {
+                std::stringstream msg;
+                msg << status.message;
+                if (!status.status.empty())
+                {
+                    msg << " {" << status.status << "}";
+                }
+                signal.LogError("Connection failed: " + status.message);
+                signal.Debug("Connection failed: " + msg.str());
+                signal.StatusChange(StatusMajor::CONNECTION,
+                                    StatusMinor::CONN_FAILED,
+                                    msg.str());
+            }
+        }
+        catch (openvpn::Exception& excp)
+        {
+            signal.LogFATAL(excp.what());
+        }
+   }
+
+
+    /**
+     *  Starts a new POSIX thread which will run the
+     *  VPN client (CoreVPNClient)
+     */
+    void connect()
+    {
+        try
+        {
+            if (!registered || !vpnclient)
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject",
+                                    "Session object not properly registered or not initialized");
+            }
+
+            // FIXME: Seems redundant with what is in call_
+            if (!userinputq.QueueAllDone())
+            {
+                THROW_DBUSEXCEPTION("BackendServiceObject",
+                                    "Required user input needs to be provided first");
+            }
+
+            bool provide_creds = false;
+            if (userinputq.QueueCount(ClientAttentionType::CREDENTIALS,
+                                      ClientAttentionGroup::USER_PASSWORD) > 0)
+            {
+                creds.username = userinputq.GetResponse(ClientAttentionType::CREDENTIALS,
+                                                        ClientAttentionGroup::USER_PASSWORD,
+                                                        "username");
+                if (userinputq.QueueCount(ClientAttentionType::CREDENTIALS,
                                           ClientAttentionGroup::CHALLENGE_DYNAMIC) == 0)
                 {
                     creds.password = userinputq.GetResponse(ClientAttentionType::CREDENTIALS,
@@ -995,6 +1701,68 @@ private:
     }
 
 
+    /**
+     *  Called when the netcfg service has detected that the network path
+     *  to the VPN server changed, typically after a Wi-Fi roam or when
+     *  the default route moved to another interface.  Reconnects right
+     *  away, the same way as the Restart method, instead of waiting for
+     *  the keep-alive to time out on the stale path.
+     *
+     *  A connection attempt in progress is restarted as well.  This is
+     *  typical right after the system resumed from sleep, where the
+     *  first attempt can start before the network is up; it would
+     *  otherwise only be retried after the connection timeout.
+     *
+     * @param reason  std::string describing the change
+     */
+    void egress_change(const std::string& reason)
+    {
+        if (!registered || !vpnclient || paused)
+        {
+            return;
+        }
+        StatusMinor st = vpnclient->GetRunStatus();
+        if (StatusMinor::CONN_CONNECTED != st
+            && StatusMinor::CONN_CONNECTING != st
+            && StatusMinor::CONN_RECONNECTING != st)
+        {
+            return;
+        }
+        signal.LogInfo("Network change detected (" + reason + "), reconnecting");
+        signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RECONNECTING);
+        vpnclient->reconnect(0);
+    }
+
+
+    /**
+     *  Called when the ovpn-dco kernel module removed the peer of this
+     *  session on its own.  The kernel module runs the keep-alive with
+     *  DCO, so this is how an unreachable server is detected; the
+     *  session reconnects the same way as on a keep-alive timeout.
+     *
+     * @param peer_id  Peer ID of the removed peer
+     * @param reason   std::string with the deletion reason
+     */
+    void dco_peer_deleted(const uint32_t peer_id, const std::string& reason)
+    {
+        if (!registered || !vpnclient || paused)
+        {
+            return;
+        }
+        StatusMinor st = vpnclient->GetRunStatus();
+        if (StatusMinor::CONN_CONNECTED != st
+            && StatusMinor::CONN_CONNECTING != st)
+        {
+            return;
+        }
+        signal.LogInfo("Connection to server lost (DCO peer "
+                       + std::to_string(peer_id) + " " + reason
+                       + "), reconnecting");
+        signal.StatusChange(StatusMajor::CONNECTION, StatusMinor::CONN_RECONNECTING);
+        vpnclient->reconnect(0);
+    }
+
+
     /**
      *   Initializes a new CoreVPNClient object
      */
@@ -1011,6 +1779,58 @@ private:
                                           session_token));
         vpnclient->disable_socket_protect(disabled_socket_protect);
         vpnclient->disable_dns_config(ignore_dns_cfg);
+        if (failover_standby)
+        {
+            // Failing over to the standby remote must not tear down
+            // or re-create the virtual network device
+            vpnconfig.tunPersist = true;
+        }
+        vpnclient->set_reuse_device(reuse_tun_device || failover_standby);
+        vpnclient->set_path_mtu_discovery(path_mtu_discovery);
+        vpnclient->set_path_quality_probe(path_quality_probe);
+        // Idle socket buffers are shrunk by the adaption as well
+        vpnclient->set_socket_buffers(adaptive_socket_buffers || low_memory,
+                                      socket_buffer_limits);
+        vpnclient->set_low_memory(low_memory, low_memory_idle_period);
+        vpnclient->set_bundle(bundle_id);
+        vpnclient->set_cpu_steering(cpu_steering);
+        vpnclient->set_queueing(queueing);
+        vpnclient->set_follow_device_cpus(core_follow_device);
+
+        // An explicit CPU affinity takes precedence over the CPUs of
+        // the NUMA node; the memory is still allocated on the node
+        vpnclient->set_numa_node(core_numa_node,
+                                 !core_follow_device
+                                 && core_thread_sched.GetCPUs().empty());
+        setup_remote_race();
+
+        if (0 == history_timer)
+        {
+            stats_history.SetLayout(CoreVPNClient::GetStatsLayout());
+            history_timer = g_timeout_add_seconds(1, history_timer_cb, this);
+        }
+
+        // The netcfg service only watches the path to the server of
+        // backends which had their socket protected
+        if (!disabled_socket_protect && !egress_subscription)
+        {
+            egress_subscription.reset(new EgressChangeSubscription(dbusconn,
+                [this](const std::string& reason)
+                {
+                    egress_change(reason);
+                }));
+        }
+
+        // With DCO, the netcfg service reports an expired keep-alive
+        // timeout with a signal instead of through the DCO pipe
+        if (vpnconfig.dco && !dco_peer_subscription)
+        {
+            dco_peer_subscription.reset(new DcoPeerDeletedSubscription(dbusconn,
+                [this](const uint32_t peer_id, const std::string& reason)
+                {
+                    dco_peer_deleted(peer_id, reason);
+                }));
+        }
 
         if (userinputq.QueueCount(ClientAttentionType::CREDENTIALS,
                                   ClientAttentionGroup::PK_PASSPHRASE) > 0)
@@ -1020,26 +1840,10 @@ private:
                                                                   "pk_passphrase");
         }
 
-        // Parse the configuration profile to an OptionList to be able
-        // to extract certain values from the configuration directly
-        OptionList parsed_opts;
-        try
-        {
-            // Basic profile limits
-            OptionList::Limits limits("profile is too large",
-                                      ProfileParseLimits::MAX_PROFILE_SIZE,
-                                      ProfileParseLimits::OPT_OVERHEAD,
-                                      ProfileParseLimits::TERM_OVERHEAD,
-                                      ProfileParseLimits::MAX_LINE_SIZE,
-                                      ProfileParseLimits::MAX_DIRECTIVE_SIZE);
-
-            parsed_opts.parse_from_config(vpnconfig.content, &limits);
-            parsed_opts.update_map();
-        }
-        catch (const std::exception& excp)
+        if (!preparse_error.empty())
         {
             THROW_CLIENTEXCEPTION("Configuration pre-parsing failed: "
-                                  + std::string(excp.what()));
+                                  + preparse_error);
         }
 
         //
@@ -1049,14 +1853,10 @@ private:
         // certificates, but is intended to be set also if certificates is
         // expected to be provided by external PKI
         //
-        try
-        {
-            Option cert = parsed_opts.get("cert");
-        }
-        catch (...)
+        if (!profile_has_cert)
         {
-            // If this happens, the configuration profile does not
-            // contain a client certificate - so we disable it
+            // The configuration profile does not contain a client
+            // certificate - so we disable it
             vpnconfig.disableClientCert = true;
         }
 
@@ -1065,29 +1865,21 @@ private:
         // This check is handled here because the overrides are parsed before
         // this initialize_client() method is called.  We do not want the
         // configuration file to override the profile overrides.
-        if (!profile_log_level_override)
+        if (!profile_log_level_override && !profile_verb.empty())
         {
             try
             {
-                const char *verb = parsed_opts.get_c_str("verb", 1, 16);
-                if (verb)
+                unsigned int v = std::atoi(profile_verb.c_str());
+                if (v > 6)
                 {
-                    unsigned int v = std::atoi(verb);
-                    if (v > 6)
-                    {
-                        v = 6;
-                    }
-                    signal.SetLogLevel(v);
+                    v = 6;
                 }
+                signal.SetLogLevel(v);
             }
             catch (const LogException&)
             {
                 signal.LogCritical("Invalid --verb level in configuration profile");
             }
-            catch (...)
-            {
-                // If verb is not found, we use the default log level
-            }
         }
 
         //  Set a unique host/machine ID
@@ -1175,6 +1967,36 @@ private:
     }
 
 
+    /**
+     *  Retrieves a session log from the log service and writes the
+     *  verbose log events there instead of sending them over the bus.
+     *  If the log service does not provide session logs, all log events
+     *  are sent as Log signals as before.
+     *
+     * @param lgs       LogServiceProxy this session is assigned in
+     * @param sesspath  std::string with the session object path
+     */
+    void open_direct_log(const LogServiceProxy& lgs, const std::string& sesspath)
+    {
+        try
+        {
+            LogFdSink::Ptr sink = lgs.OpenSessionLog(sesspath,
+                                                     OpenVPN3DBus_interf_backends);
+            signal.SetDirectSink(sink);
+            signal.LogInfo("Logging directly to the "
+                            + LogFdSink::FormatName(sink->GetFormat())
+                            + " session log");
+        }
+        catch (const LogServiceProxyException& excp)
+        {
+            signal.LogWarn("Direct session logging is not available: "
+                           + std::string(excp.what())
+                           + (excp.debug_details().empty() ? ""
+                              : " (" + excp.debug_details() + ")"));
+        }
+    }
+
+
     /**
      *  Retrieves the VPN configuration profile from the configuration
      *  manager.
@@ -1214,11 +2036,13 @@ private:
             vpnconfig.content = pm.profile_content();
             vpnconfig.ssoMethods = "openurl,webauth";
             vpnconfig.dco = dco;
+            preparse_profile();
 
             try
             {
-                PlatformInfo platinfo(dbusconn);
-                vpnconfig.platformVersion = platinfo.str();
+                // Normally already provided by backendstart or looked up
+                // in the background since the process started
+                vpnconfig.platformVersion = PlatformInfo::GetCached(500);
             }
             catch(const std::exception &ex)
             {
@@ -1226,6 +2050,7 @@ private:
             }
 
             set_overrides(overrides);
+            apply_resource_control();
         }
         catch (std::exception& e)
         {
@@ -1236,165 +2061,936 @@ private:
         return config_name;
     }
 
-    void set_overrides(std::vector<OverrideValue> & overrides)
+    /**
+     *  Parses the configuration profile to an OptionList to extract the
+     *  values initialize_client() needs directly from the profile.  The
+     *  profile does not change once it has been fetched, so this is done
+     *  once from fetch_configuration() instead of on each (re)connect.
+     *
+     *  Parsing errors are kept in preparse_error and reported by
+     *  initialize_client().
+     */
+    void preparse_profile()
     {
-        for (const auto & override: overrides)
+        OptionList parsed_opts;
+        try
         {
-            bool valid_override = false;
-            if (override.override.key == "server-override")
-            {
-                vpnconfig.serverOverride = override.strValue;
-                valid_override = true;
-            }
-            else if (override.override.key == "port-override")
-            {
-                vpnconfig.portOverride = override.strValue;
-                valid_override = true;
-            }
-            else if (override.override.key == "proto-override")
-            {
-                vpnconfig.protoOverride = override.strValue;
-                valid_override = true;
-            }
-            else if (override.override.key == "ipv6")
-            {
-                vpnconfig.allowUnusedAddrFamilies = override.strValue;
-                valid_override = true;
-            }
-            else if (override.override.key == "log-level")
-            {
-                signal.SetLogLevel(std::atoi(override.strValue.c_str()));
-                profile_log_level_override = true;
-                valid_override = true;
-            }
-            else if (override.override.key == "dns-fallback-google")
-            {
-                vpnconfig.googleDnsFallback = override.boolValue;
-                valid_override = true;
-            }
-            else if (override.override.key == "dns-setup-disabled")
-            {
-                ignore_dns_cfg = override.boolValue;
-                valid_override = true;
-            }
-            else if (override.override.key == "dns-scope")
+            // Basic profile limits
+            OptionList::Limits limits("profile is too large",
+                                      ProfileParseLimits::MAX_PROFILE_SIZE,
+                                      ProfileParseLimits::OPT_OVERHEAD,
+                                      ProfileParseLimits::TERM_OVERHEAD,
+                                      ProfileParseLimits::MAX_LINE_SIZE,
+                                      ProfileParseLimits::MAX_DIRECTIVE_SIZE);
+
+            parsed_opts.parse_from_config(vpnconfig.content, &limits);
+            parsed_opts.update_map();
+        }
+        catch (const std::exception& excp)
+        {
+            preparse_error = std::string(excp.what());
+            return;
+        }
+
+        profile_has_cert = (nullptr != parsed_opts.get_ptr("cert"));
+        preparse_remotes(parsed_opts);
+        try
+        {
+            const char *verb = parsed_opts.get_c_str("verb", 1, 16);
+            profile_verb = (verb ? std::string(verb) : "");
+        }
+        catch (...)
+        {
+            // If verb is not found, we use the default log level
+        }
+    }
+
+
+    /**
+     *  Extracts the remote servers from the parsed configuration profile,
+     *  for the connect-race override.  Profiles with <connection> blocks
+     *  or a proxy cannot be raced, as the remotes alone do not describe
+     *  how to connect.
+     *
+     * @param parsed_opts  OptionList with the parsed profile
+     */
+    void preparse_remotes(const OptionList& parsed_opts)
+    {
+        profile_remotes.clear();
+        profile_race_capable = !(parsed_opts.exists("connection")
+                                 || parsed_opts.exists("http-proxy")
+                                 || parsed_opts.exists("socks-proxy"));
+        profile_udp_probe = !(parsed_opts.exists("tls-auth")
+                              || parsed_opts.exists("tls-crypt")
+                              || parsed_opts.exists("tls-crypt-v2"));
+
+        try
+        {
+            const Option *o = parsed_opts.get_ptr("port");
+            const std::string def_port = (o && o->size() > 1 ? o->get(1, 16) : "1194");
+            o = parsed_opts.get_ptr("proto");
+            const std::string def_proto = (o && o->size() > 1 ? o->get(1, 16) : "udp");
+
+            for (const auto& opt : parsed_opts)
             {
-                if ("global" == override.strValue
-                    || "tunnel" == override.strValue)
+                if (opt.size() < 2 || "remote" != opt.ref(0))
                 {
-                    dns_scope = override.strValue;
-                    valid_override = true;
+                    continue;
                 }
+                profile_remotes.emplace_back(opt.get(1, 256),
+                                             (opt.size() > 2 ? opt.get(2, 16) : def_port),
+                                             (opt.size() > 3 ? opt.get(3, 16) : def_proto));
             }
-            else if (override.override.key == "dns-sync-lookup")
+        }
+        catch (const std::exception&)
+        {
+            // Invalid remote entries are reported by the core library
+            // when connecting; just don't race them
+            profile_remotes.clear();
+            profile_race_capable = false;
+        }
+    }
+
+
+    /**
+     *  Sets up remote racing for the next connection, if enabled by the
+     *  connect-race or failover-standby overrides and possible with this
+     *  profile
+     */
+    void setup_remote_race()
+    {
+        // A remote known to work from the previous session is tried
+        // first, once, even if racing is disabled.  The sessions of a
+        // bundle start with different remotes instead, to spread them
+        // across the servers and uplinks.
+        int preferred = preferred_remote();
+        if (!bundle_id.empty() && !profile_remotes.empty())
+        {
+            preferred = (int) (bundle_index % profile_remotes.size());
+        }
+        reconnect_state.erase("remote_host");
+        reconnect_state.erase("remote_port");
+        reconnect_state.erase("remote_proto");
+
+        // With the shared resolver or backoff, the remote override is
+        // also used with a single remote, to let the netcfg service
+        // resolve it or the session manager hold it back
+        const bool racing = (profile_remotes.size() >= 2
+                             && (connect_race >= 2 || preferred >= 0 || failover_standby));
+        if ((!racing && !shared_resolver && !shared_backoff)
+            || profile_remotes.empty()
+            || !profile_race_capable
+            || !vpnconfig.serverOverride.empty()
+            || !vpnconfig.proxyHost.empty())
+        {
+            return;
+        }
+
+        std::vector<RaceRemote> remotes(profile_remotes);
+        for (auto& r : remotes)
+        {
+            if (!vpnconfig.portOverride.empty())
             {
-                vpnconfig.synchronousDnsLookup = override.boolValue;
-                valid_override = true;
+                r.port = vpnconfig.portOverride;
             }
-            else if (override.override.key == "auth-fail-retry")
+            if (!vpnconfig.protoOverride.empty())
             {
-                vpnconfig.retryOnAuthFailed = override.boolValue;
-                valid_override = true;
+                r.proto = vpnconfig.protoOverride;
             }
-            else if (override.override.key == "allow-compression")
+        }
+        unsigned int parallel = (!racing || connect_race < 2 ? 0 : connect_race);
+        auto race = std::make_shared<RemoteRace>(remotes, parallel,
+                                                 std::chrono::seconds(5),
+                                                 profile_udp_probe);
+        if (racing && preferred >= 0)
+        {
+            race->Prefer(preferred);
+            signal.LogVerb2((bundle_id.empty() ? "Trying the last working remote "
+                                               : "Trying the bundle remote ")
+                            + remotes[preferred].host + " first");
+        }
+        if (racing && failover_standby)
+        {
+            race->EnableStandby(std::chrono::seconds(10));
+            if (!profile_udp_probe)
             {
-                vpnconfig.compressionMode = override.strValue;
-                valid_override = true;
+                signal.LogWarn("Standby remotes using UDP cannot be probed "
+                               "with tls-auth or tls-crypt in use");
             }
-            else if (override.override.key == "enable-legacy-algorithms")
+        }
+        vpnclient->set_remote_race(race);
+        vpnclient->set_shared_resolver(shared_resolver);
+        vpnclient->set_shared_backoff(shared_backoff);
+        apply_remote_backoff();
+        if (parallel > 0)
+        {
+            signal.LogVerb2("Racing up to " + std::to_string(connect_race)
+                            + " remotes concurrently when connecting");
+        }
+    }
+
+
+    /**
+     *  Hands the remote backoff state provided by the session manager
+     *  via SetRemoteBackoff to the VPN client
+     */
+    void apply_remote_backoff()
+    {
+        if (!vpnclient || !shared_backoff)
+        {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        std::map<std::string, std::chrono::milliseconds> delays;
+        for (const auto& rb : remote_backoff)
+        {
+            if (rb.second > now)
             {
-                vpnconfig.enableNonPreferredDCAlgorithms = override.boolValue;
-                valid_override = true;
+                delays[rb.first] = std::chrono::duration_cast<std::chrono::milliseconds>(rb.second - now);
             }
-            else if (override.override.key == "tls-version-min")
+        }
+        vpnclient->set_remote_backoff(delays);
+    }
+
+
+    /**
+     *  Looks up the remote of the previous session, as provided via
+     *  SetReconnectState, in the remotes of the profile
+     *
+     * @return Returns the index of the remote in profile_remotes, or -1
+     *         if there is none or it is not part of the profile
+     */
+    int preferred_remote() const
+    {
+        auto host = reconnect_state.find("remote_host");
+        auto port = reconnect_state.find("remote_port");
+        if (reconnect_state.end() == host || reconnect_state.end() == port)
+        {
+            return -1;
+        }
+        auto proto = reconnect_state.find("remote_proto");
+
+        int match = -1;
+        for (size_t i = 0; i < profile_remotes.size(); ++i)
+        {
+            const RaceRemote& r = profile_remotes[i];
+            if (r.host != host->second || r.port != port->second)
             {
-                vpnconfig.tlsVersionMinOverride = override.strValue;
-                valid_override = true;
+                continue;
             }
-            else if (override.override.key == "tls-cert-profile")
+            if (reconnect_state.end() == proto
+                || 0 == r.proto.compare(0, proto->second.size(), proto->second))
             {
-                vpnconfig.tlsCertProfileOverride = override.strValue;
-                valid_override = true;
+                return (int) i;
             }
-            else if (override.override.key == "persist-tun")
+            if (match < 0)
             {
-                vpnconfig.tunPersist = override.boolValue;
-                valid_override = true;
+                match = (int) i;
             }
-            else if (override.override.key == "proxy-host")
+        }
+        return match;
+    }
+
+
+    /**
+     *  Collects what is needed to get the current connection back quickly
+     *  in a new backend process: the remote server in use and the
+     *  auth-token pushed by the server, if any.
+     *
+     * @return Returns the reconnect state, which is empty unless the
+     *         connection is established
+     */
+    std::map<std::string, std::string> fetch_reconnect_state()
+    {
+        std::map<std::string, std::string> state;
+        if (!vpnclient || StatusMinor::CONN_CONNECTED != vpnclient->GetRunStatus())
+        {
+            return state;
+        }
+
+        ClientAPI::ConnectionInfo ci = vpnclient->connection_info();
+        if (ci.defined && !ci.serverHost.empty())
+        {
+            std::string proto = ci.serverProto.substr(0, 3);
+            std::transform(proto.begin(), proto.end(), proto.begin(), ::tolower);
+            state["remote_host"] = ci.serverHost;
+            state["remote_port"] = ci.serverPort;
+            state["remote_proto"] = proto;
+        }
+
+        ClientAPI::SessionToken tok;
+        if (vpnclient->session_token(tok) && !tok.session_id.empty())
+        {
+            state["username"] = tok.username;
+            state["auth_token"] = tok.session_id;
+        }
+        return state;
+    }
+
+
+    /**
+     *  Takes over the reconnect state of a previous session of the same
+     *  profile.  An auth-token in it is used instead of asking the user
+     *  for the username and password, unless the profile uses a static
+     *  challenge which cannot be answered with the token.  The remote is
+     *  tried first by the next connection attempt.
+     *
+     * @param state  Reconnect state, as returned by FetchReconnectState
+     */
+    void set_reconnect_state(std::map<std::string, std::string> state)
+    {
+        reconnect_state = std::move(state);
+
+        auto user = reconnect_state.find("username");
+        auto token = reconnect_state.find("auth_token");
+        if (reconnect_state.end() != user && reconnect_state.end() != token
+            && userinputq.QueueCount(ClientAttentionType::CREDENTIALS,
+                                     ClientAttentionGroup::USER_PASSWORD) > 0
+            && userinputq.QueueCount(ClientAttentionType::CREDENTIALS,
+                                     ClientAttentionGroup::CHALLENGE_STATIC) == 0)
+        {
+            for (const auto& slot : userinputq.QueueFetchAll())
             {
-                vpnconfig.proxyHost = override.strValue;
-                valid_override = true;
+                if (ClientAttentionType::CREDENTIALS != slot.type
+                    || ClientAttentionGroup::USER_PASSWORD != slot.group
+                    || slot.provided)
+                {
+                    continue;
+                }
+                if ("username" == slot.name)
+                {
+                    userinputq.UpdateEntry(slot.type, slot.group, slot.id,
+                                           user->second);
+                }
+                else if ("password" == slot.name)
+                {
+                    userinputq.UpdateEntry(slot.type, slot.group, slot.id,
+                                           token->second);
+                }
             }
-            else if (override.override.key == "proxy-port")
+            signal.LogInfo("Reusing the auth-token of the previous session");
+        }
+        // The token is only good for this one attempt
+        reconnect_state.erase("username");
+        reconnect_state.erase("auth_token");
+
+        if (vpnclient)
+        {
+            setup_remote_race();
+        }
+    }
+
+
+    /**
+     *  Function applying a single configuration override.  Returns true
+     *  if the override value was accepted.
+     */
+    using OverrideHandler = bool (*)(BackendClientObject&, const OverrideValue&);
+
+
+    /**
+     *  Dispatch table with the handler of each configuration override,
+     *  indexed by the override key.  It is built once per process.
+     */
+    static const std::unordered_map<std::string, OverrideHandler>& override_handlers()
+    {
+        static const std::unordered_map<std::string, OverrideHandler> handlers = {
+            {"server-override",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.serverOverride = ov.strValue;
+                 return true;
+             }},
+            {"port-override",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.portOverride = ov.strValue;
+                 return true;
+             }},
+            {"proto-override",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.protoOverride = ov.strValue;
+                 return true;
+             }},
+            {"connect-race",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 int n = std::atoi(ov.strValue.c_str());
+                 if (n < 2 || n > 8)
+                 {
+                     return false;
+                 }
+                 c.connect_race = n;
+                 return true;
+             }},
+            {"ipv6",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.allowUnusedAddrFamilies = ov.strValue;
+                 return true;
+             }},
+            {"log-level",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.signal.SetLogLevel(std::atoi(ov.strValue.c_str()));
+                 c.profile_log_level_override = true;
+                 return true;
+             }},
+            {"dns-fallback-google",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.googleDnsFallback = ov.boolValue;
+                 return true;
+             }},
+            {"dns-setup-disabled",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.ignore_dns_cfg = ov.boolValue;
+                 return true;
+             }},
+            {"dns-scope",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 if ("global" != ov.strValue && "tunnel" != ov.strValue)
+                 {
+                     return false;
+                 }
+                 c.dns_scope = ov.strValue;
+                 return true;
+             }},
+            {"dns-sync-lookup",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.synchronousDnsLookup = ov.boolValue;
+                 return true;
+             }},
+            {"auth-fail-retry",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.retryOnAuthFailed = ov.boolValue;
+                 return true;
+             }},
+            {"allow-compression",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.compressionMode = ov.strValue;
+                 return true;
+             }},
+            {"enable-legacy-algorithms",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.enableNonPreferredDCAlgorithms = ov.boolValue;
+                 return true;
+             }},
+            {"tls-version-min",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.tlsVersionMinOverride = ov.strValue;
+                 return true;
+             }},
+            {"tls-cert-profile",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.tlsCertProfileOverride = ov.strValue;
+                 return true;
+             }},
+            {"persist-tun",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.tunPersist = ov.boolValue;
+                 return true;
+             }},
+            {"reuse-tun-device",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.reuse_tun_device = ov.boolValue;
+                 return true;
+             }},
+            {"path-mtu-discovery",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.path_mtu_discovery = ov.boolValue;
+                 return true;
+             }},
+            {"path-quality",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.path_quality_probe = ov.boolValue;
+                 return true;
+             }},
+            {"adaptive-socket-buffers",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.adaptive_socket_buffers = ov.boolValue;
+                 return true;
+             }},
+            {"socket-buffer-min",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 int size = std::atoi(ov.strValue.c_str());
+                 if (size < 4096)
+                 {
+                     return false;
+                 }
+                 c.socket_buffer_limits.min = size;
+                 return true;
+             }},
+            {"socket-buffer-max",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 int size = std::atoi(ov.strValue.c_str());
+                 if (size < 4096)
+                 {
+                     return false;
+                 }
+                 c.socket_buffer_limits.max = size;
+                 return true;
+             }},
+            {"failover-standby",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.failover_standby = ov.boolValue;
+                 return true;
+             }},
+            {"flight-recorder",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.signal.EnableFlightRecorder(ov.boolValue);
+                 return true;
+             }},
+            {"log-direct",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.log_direct = ov.boolValue;
+                 return true;
+             }},
+            {"shared-resolver",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.shared_resolver = ov.boolValue;
+                 return true;
+             }},
+            {"power-save",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.power_save = ov.boolValue;
+                 if (!c.power_save)
+                 {
+                     return true;
+                 }
+
+                 // Applied to the main thread running the GLib main loop
+                 // here and to the VPN client thread when it starts; the
+                 // threads started by these inherit it
+                 ThreadScheduling ovr;
+                 ovr.SetTimerSlack(power_save_timer_slack);
+                 c.core_thread_sched.Merge(ovr);
+                 for (const auto& err : ovr.ApplyToCurrentThread())
+                 {
+                     c.signal.LogWarn(err);
+                 }
+                 return true;
+             }},
+            {"low-memory",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.low_memory = ov.boolValue;
+                 if (!c.low_memory)
+                 {
+                     return true;
+                 }
+
+                 // Must happen before the VPN client thread starts
+                 // allocating memory, which would create its own arena
+                 if (!HeapTrimmer::CapArenas(HeapTrimmer::LowMemoryArenas))
+                 {
+                     c.signal.LogWarn("Could not limit the malloc arenas");
+                 }
+                 return true;
+             }},
+            {"status-full-fidelity",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.signal.SetStatusFullFidelity(ov.boolValue);
+                 return true;
+             }},
+            {"proxy-host",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.proxyHost = ov.strValue;
+                 return true;
+             }},
+            {"proxy-port",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.proxyPort = ov.strValue;
+                 return true;
+             }},
+            {"proxy-username",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.proxyUsername = ov.strValue;
+                 return true;
+             }},
+            {"proxy-password",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.proxyPassword = ov.strValue;
+                 return true;
+             }},
+            {"proxy-auth-cleartext",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.vpnconfig.proxyAllowCleartextAuth = ov.boolValue;
+                 return true;
+             }},
+            {"device-rps-cpus",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.cpu_steering.rps_cpus = ov.strValue;
+                 return true;
+             }},
+            {"device-xps-cpus",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.cpu_steering.xps_cpus = ov.strValue;
+                 return true;
+             }},
+            {"device-rps-flow-cnt",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 int cnt = std::atoi(ov.strValue.c_str());
+                 if (cnt < 1)
+                 {
+                     return false;
+                 }
+                 c.cpu_steering.rps_flow_cnt = cnt;
+                 return true;
+             }},
+            {"device-qdisc",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 if ("fq_codel" != ov.strValue && "cake" != ov.strValue)
+                 {
+                     return false;
+                 }
+                 c.queueing.qdisc = ov.strValue;
+                 return true;
+             }},
+            {"device-qdisc-bandwidth",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 int bw = std::atoi(ov.strValue.c_str());
+                 if (bw < 1)
+                 {
+                     return false;
+                 }
+                 c.queueing.bandwidth = bw;
+                 return true;
+             }},
+            {"device-txqueuelen",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 int qlen = std::atoi(ov.strValue.c_str());
+                 if (qlen < 1 || qlen > 100000)
+                 {
+                     return false;
+                 }
+                 c.queueing.txqueuelen = qlen;
+                 return true;
+             }},
+            {"core-cpu-affinity",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 if ("device" == ov.strValue)
+                 {
+                     // Applied when the device is established
+                     c.core_follow_device = true;
+                     return true;
+                 }
+                 ThreadScheduling ovr;
+                 ovr.SetCPUs(ov.strValue);
+                 c.core_thread_sched.Merge(ovr);
+                 return true;
+             }},
+            {"core-nice",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 ThreadScheduling ovr;
+                 ovr.SetNice(ov.strValue);
+                 c.core_thread_sched.Merge(ovr);
+                 return true;
+             }},
+            {"core-sched-policy",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 ThreadScheduling ovr;
+                 ovr.SetPolicy(ov.strValue);
+                 c.core_thread_sched.Merge(ovr);
+                 return true;
+             }},
+            {"core-numa-node",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 NumaTopology::ParseNode(ov.strValue);
+                 c.core_numa_node = ov.strValue;
+                 return true;
+             }},
+            {"backend-cpu-weight",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.resource_control.SetCPUWeight(ov.strValue);
+                 return true;
+             }},
+            {"backend-io-weight",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.resource_control.SetIOWeight(ov.strValue);
+                 return true;
+             }},
+            {"backend-memory-high",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.resource_control.SetMemoryHigh(ov.strValue);
+                 return true;
+             }},
+            {"backend-memory-max",
+             [](BackendClientObject& c, const OverrideValue& ov) -> bool
+             {
+                 c.resource_control.SetMemoryMax(ov.strValue);
+                 return true;
+             }}
+        };
+        return handlers;
+    }
+
+
+    /**
+     *  Applies the backend-* resource control overrides to the scope
+     *  unit openvpn3-service-backendstart started this process in.  With
+     *  several sessions hosted by one process, the last profile wins.
+     */
+    void apply_resource_control()
+    {
+        if (resource_control.empty())
+        {
+            return;
+        }
+        try
+        {
+            std::string unit = BackendScope::Update(dbusconn, resource_control);
+            signal.LogVerb1("Resource control of " + unit + " set to "
+                            + resource_control.str());
+        }
+        catch (const ResourceControlException& excp)
+        {
+            signal.LogWarn("Could not apply the resource control overrides: "
+                           + std::string(excp.what()));
+        }
+    }
+
+
+    void set_overrides(std::vector<OverrideValue> & overrides)
+    {
+        const auto& handlers = override_handlers();
+        for (const auto & override: overrides)
+        {
+            bool valid_override = false;
+            auto h = handlers.find(override.override.key);
+            if (handlers.end() != h)
             {
-                vpnconfig.proxyPort = override.strValue;
-                valid_override = true;
+                try
+                {
+                    valid_override = h->second(*this, override);
+                }
+                catch (const ThreadSchedulingException& excp)
+                {
+                    signal.LogError("Configuration override '"
+                                    + override.override.key + "': "
+                                    + excp.what());
+                }
+                catch (const ResourceControlException& excp)
+                {
+                    signal.LogError("Configuration override '"
+                                    + override.override.key + "': "
+                                    + excp.what());
+                }
             }
-            else if (override.override.key == "proxy-username")
+
+            // Add some logging to the overrides which got processed
+            if (valid_override)
             {
-                vpnconfig.proxyUsername = override.strValue;
-                valid_override = true;
+                std::stringstream msg;
+
+                msg << "Configuration override '"
+                    << override.override.key << "' ";
+
+                bool invalid = false;
+                switch (override.override.type)
+                {
+                case OverrideType::string:
+                    msg << "set to '" << override.strValue << "'";
+                    break;
+
+                case OverrideType::boolean:
+                    msg << "set to "
+                        << (override.boolValue ? "True" : "False");
+                    break;
+
+                case OverrideType::invalid:
+                    msg << "contains an invalid value";
+                    invalid = true;
+                    break;
+                }
+
+                if (!invalid)
+                {
+                    // Valid override values are logged as VERB1 messages
+                    signal.LogVerb1(msg.str());
+                }
+                else
+                {
+                    // Invalid override values are logged as errors
+                    signal.LogError(msg.str());
+                }
             }
-            else if (override.override.key == "proxy-password")
+            else
             {
-                vpnconfig.proxyPassword = override.strValue;
-                valid_override = true;
+                // If an override value exists which is not supported,
+                // the valid_override will typically be false.  Log this
+                // scenario slightly different
+                signal.LogError("Unsupported override: "
+                                + override.override.key);
             }
-            else if (override.override.key == "proxy-auth-cleartext")
+        }
+    }
+
+};
+
+
+
+/**
+ *  Object available while a client process started with --standby waits
+ *  in the openvpn3-service-backendstart client pool.  The process has
+ *  already connected to the D-Bus and acquired its bus name; it only
+ *  needs the session token to continue as a normal client process.
+ *
+ *  Only the backend starter service may call methods in this object.
+ */
+class BackendStandbyObject : public DBusObject,
+                             public DBusConnectionCreds,
+                             public RC<thread_safe_refcount>
+{
+public:
+    typedef RCPtr<BackendStandbyObject> Ptr;
+
+    /**
+     * @param conn       D-Bus connection this object is tied to
+     * @param assign_cb  Function called with the session token when
+     *                   the backend starter assigns this process to a
+     *                   session
+     * @param stop_cb    Function called when the backend starter
+     *                   no longer needs this process
+     */
+    BackendStandbyObject(GDBusConnection *conn,
+                         std::function<void(const std::string&)> assign_cb,
+                         std::function<void()> stop_cb)
+        : DBusObject(OpenVPN3DBus_rootp_backends_standby),
+          DBusConnectionCreds(conn),
+          assign_cb(assign_cb),
+          stop_cb(stop_cb)
+    {
+        std::stringstream introspection_xml;
+        introspection_xml << "<node name='" << OpenVPN3DBus_rootp_backends_standby << "'>"
+                          << "    <interface name='" << OpenVPN3DBus_interf_backends << "'>"
+                          << "        <method name='AssignSession'>"
+                          << "            <arg type='s' name='token' direction='in'/>"
+                          << "            <arg type='u' name='pid' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='Shutdown'/>"
+                          << "    </interface>"
+                          << "</node>";
+        ParseIntrospectionXML(introspection_xml);
+    }
+
+
+    void callback_method_call(GDBusConnection *conn,
+                              const std::string sender,
+                              const std::string obj_path,
+                              const std::string intf_name,
+                              const std::string method_name,
+                              GVariant *params,
+                              GDBusMethodInvocation *invoc)
+    {
+        try
+        {
+            if (GetUniqueBusID(OpenVPN3DBus_name_backends) != sender)
             {
-                vpnconfig.proxyAllowCleartextAuth = override.boolValue;
-                valid_override = true;
+                throw DBusCredentialsException(GetUID(sender),
+                                               "net.openvpn.v3.error.acl.denied",
+                                               "Caller is not the backend starter");
             }
 
-            // Add some logging to the overrides which got processed
-            if (valid_override)
+            if ("AssignSession" == method_name)
             {
-                std::stringstream msg;
-
-                msg << "Configuration override '"
-                    << override.override.key << "' ";
-
-                bool invalid = false;
-                switch (override.override.type)
-                {
-                case OverrideType::string:
-                    msg << "set to '" << override.strValue << "'";
-                    break;
-
-                case OverrideType::boolean:
-                    msg << "set to "
-                        << (override.boolValue ? "True" : "False");
-                    break;
-
-                case OverrideType::invalid:
-                    msg << "contains an invalid value";
-                    invalid = true;
-                    break;
-                }
-
-                if (!invalid)
-                {
-                    // Valid override values are logged as VERB1 messages
-                    signal.LogVerb1(msg.str());
-                }
-                else
+                gchar *token = nullptr;
+                g_variant_get(params, "(s)", &token);
+                std::string sesstoken(token ? token : "");
+                g_free(token);
+                if (sesstoken.empty())
                 {
-                    // Invalid override values are logged as errors
-                    signal.LogError(msg.str());
+                    g_dbus_method_invocation_return_dbus_error(invoc,
+                                                               "net.openvpn.v3.error.backend",
+                                                               "Invalid session token");
+                    return;
                 }
+                g_dbus_method_invocation_return_value(invoc,
+                                                      g_variant_new("(u)", getpid()));
+                assign_cb(sesstoken);
             }
-            else
+            else if ("Shutdown" == method_name)
             {
-                // If an override value exists which is not supported,
-                // the valid_override will typically be false.  Log this
-                // scenario slightly different
-                signal.LogError("Unsupported override: "
-                                + override.override.key);
+                g_dbus_method_invocation_return_value(invoc, NULL);
+                stop_cb();
             }
         }
+        catch (DBusCredentialsException& excp)
+        {
+            excp.SetDBusError(invoc);
+        }
+    }
+
+
+    GVariant * callback_get_property(GDBusConnection *conn,
+                                     const std::string sender,
+                                     const std::string obj_path,
+                                     const std::string intf_name,
+                                     const std::string property_name,
+                                     GError **error)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                    "Unknown property");
+        return nullptr;
+    }
+
+
+    GVariantBuilder * callback_set_property(GDBusConnection *conn,
+                                            const std::string sender,
+                                            const std::string obj_path,
+                                            const std::string intf_name,
+                                            const std::string property_name,
+                                            GVariant *value,
+                                            GError **error)
+    {
+        THROW_DBUSEXCEPTION("BackendStandbyObject",
+                            "set property not implemented");
     }
 
+
+private:
+    std::function<void(const std::string&)> assign_cb;
+    std::function<void()> stop_cb;
 };
 
 
@@ -1414,7 +3010,9 @@ public:
      *                   registered on the system or session bus.
      * @param sesstoken  String containing the session token provided via the
      *                   command line.  This is used when signalling back
-     *                   to the session manager.
+     *                   to the session manager.  If empty, the process
+     *                   waits in the backend starter client pool until
+     *                   it is assigned a session token.
      */
     BackendClientDBus(pid_t start_pid, GBusType bus_type,
                       std::string sesstoken, LogWriter *logwr)
@@ -1426,7 +3024,6 @@ public:
           session_token(sesstoken),
           logwr(logwr),
           procsig(nullptr),
-          be_obj(nullptr),
           disabled_socket_protect(false),
           signal(nullptr),
           signal_broadcast(false)
@@ -1437,12 +3034,21 @@ public:
     {
         try
         {
-            // If we do unicast (!broadcast), detach from the log serviceif (!signal_broadcast)
+            if (0 != backendstart_watch)
+            {
+                g_bus_unwatch_name(backendstart_watch);
+            }
+
+            // If we do unicast (!broadcast), detach from the log service
+            if (logservice)
             {
                 logservice->Detach(OpenVPN3DBus_interf_backends);
                 logservice->Detach(OpenVPN3DBus_interf_sessions);
             }
-            procsig->ProcessChange(StatusMinor::PROC_STOPPED);
+            if (procsig)
+            {
+                procsig->ProcessChange(StatusMinor::PROC_STOPPED);
+            }
         }
         catch (const std::exception& excp)
         {
@@ -1461,12 +3067,32 @@ public:
      */
     void SetMainLoop(GMainLoop *ml)
     {
-        if (be_obj)
+        mainloop = ml;
+        for (auto& sess : sessions)
         {
-            be_obj->SetMainLoop(ml);
+            sess.second->SetMainLoop(ml);
         }
     }
 
+
+    /**
+     *  Lets a process started in standby mode host several VPN sessions.
+     *  Each session gets its own BackendClientObject, object path and
+     *  Core library client thread, but they share this process, its
+     *  D-Bus connection and the log service attachment.
+     *
+     *  The process stays in the backend starter client pool until it
+     *  has been assigned max_sessions sessions, and exits when the last
+     *  of its sessions is done.
+     *
+     * @param max_sessions  Number of sessions this process may be
+     *                      assigned.  1 disables session hosting.
+     */
+    void SetHostSessions(const unsigned int max_sessions)
+    {
+        host_sessions = (max_sessions > 0 ? max_sessions : 1);
+    }
+
     /**
      *  Sets the default log level when the backend client starts.  This
      *  can later on be adjusted by modifying the log_level D-Bus object
@@ -1508,12 +3134,42 @@ public:
        disabled_socket_protect = val;
     }
 
+    /**
+     *  Sets the service wide CPU affinity and scheduling settings of the
+     *  Core library client thread
+     *
+     * @param sched  ThreadScheduling with the settings
+     */
+    void SetCoreThreadScheduling(const ThreadScheduling& sched)
+    {
+        core_thread_sched = sched;
+    }
+
+    /**
+     *  Sets the service wide NUMA node of the Core library client thread
+     *
+     * @param node  std::string with a node number, "auto" or empty
+     */
+    void SetCoreNumaNode(const std::string& node)
+    {
+        core_numa_node = node;
+    }
+
     /**
      *  This callback is called when the service was successfully registered
      *  on the D-Bus.
      */
     void callback_bus_acquired()
     {
+        const char *platform = getenv("OPENVPN3_PLATFORM_INFO");
+        if (platform && *platform)
+        {
+            PlatformInfo::SetCached(platform);
+        }
+        else
+        {
+            PlatformInfo::StartLookup(GetConnection());
+        }
 
         // If we do unicast (!broadcast), attach to the log service
         if (!signal_broadcast)
@@ -1533,30 +3189,12 @@ public:
             }
         }
 
-        // Create a new OpenVPN3 client session object
-        object_path = OpenVPN3DBus_rootp_backends_session;
-        be_obj.reset(new BackendClientObject(GetConnection(), GetBusName(),
-                                             object_path,
-                                             session_token,
-                                             default_log_level,
-                                             logwr));
-        be_obj->SetSignalBroadcast(signal_broadcast);
-        be_obj->DisableSocketProtect(disabled_socket_protect);
-        be_obj->RegisterObject(GetConnection());
-
-        // Setup a signal object of the backend
-        signal.reset(new BackendSignals(GetConnection(), LogGroup::BACKENDPROC,
-                                        session_token, logwr));
-        signal->EnableBroadcast(signal_broadcast);
-        signal->SetLogLevel(default_log_level);
-        signal->LogVerb2("Backend client process started as pid " + std::to_string(start_pid)
-                         + " daemonized as pid " + std::to_string(getpid()));
-        signal->Debug("BackendClientDBus registered on '" + GetBusName()
-                       + "': " + object_path);
-
-        procsig.reset(new ProcessSignalProducer(GetConnection(), OpenVPN3DBus_interf_backends,
-                                            object_path, "VPN-Client"));
-        procsig->ProcessChange(StatusMinor::PROC_STARTED);
+        if (session_token.empty())
+        {
+            start_standby();
+            return;
+        }
+        start_session(session_token);
     }
 
 
@@ -1575,6 +3213,23 @@ public:
     };
 
 
+    /**
+     *  Logs the start-up timeline of the backend client process.  A
+     *  process started for the client pool has no log destination
+     *  until it is assigned a session; its timeline is only available
+     *  via the net.openvpn.v3.debug interface.
+     *
+     * @param timeline  std::string with the StartupTiming summary
+     */
+    void callback_startup_complete(const std::string& timeline)
+    {
+        if (signal)
+        {
+            signal->LogVerb1("Start-up completed: " + timeline);
+        }
+    }
+
+
     /**
      *  This is called each time the well-known bus name is removed from the
      *  D-Bus.  In our case, we just throw an exception and starts shutting
@@ -1595,21 +3250,325 @@ private:
     unsigned int default_log_level = 3; // LogCategory::INFO messages
     pid_t start_pid;
     std::string session_token;
-    std::string object_path;
     LogWriter *logwr;
     ProcessSignalProducer::Ptr procsig;
-    BackendClientObject::Ptr be_obj;
+    std::map<std::string, BackendClientObject::Ptr> sessions;
+    unsigned int host_sessions = 1;
+    unsigned int assigned_sessions = 0;
+    unsigned int session_counter = 0;
+    unsigned int starting_sessions = 0;
+    BackendStandbyObject::Ptr standby_obj;
+    guint backendstart_watch = 0;
+    GMainLoop *mainloop = nullptr;
     bool disabled_socket_protect;
+    ThreadScheduling core_thread_sched;
+    std::string core_numa_node;
     BackendSignals::Ptr signal;
     bool signal_broadcast;
     LogServiceProxy::Ptr logservice;
+
+
+    /**
+     *  Registers this process in the backend starter client pool.  The
+     *  process stays in standby until the backend starter assigns it
+     *  a session token or the backend starter goes away.
+     */
+    void start_standby()
+    {
+        standby_obj.reset(new BackendStandbyObject(GetConnection(),
+                               [this](const std::string& token)
+                               {
+                                   assign_session(token);
+                               },
+                               [this]()
+                               {
+                                   run_idle([](BackendClientDBus *self,
+                                               const std::string&)
+                                            {
+                                                self->stop_standby();
+                                            });
+                               }));
+        standby_obj->RegisterObject(GetConnection());
+
+        // A standby process is of no use without the backend starter
+        backendstart_watch = g_bus_watch_name_on_connection(GetConnection(),
+                                      OpenVPN3DBus_name_backends.c_str(),
+                                      G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                      nullptr,
+                                      [](GDBusConnection *conn,
+                                         const gchar *name,
+                                         gpointer data)
+                                      {
+                                          auto self = static_cast<BackendClientDBus *>(data);
+                                          self->stop_standby();
+                                      },
+                                      this, nullptr);
+
+        try
+        {
+            DBusProxy backendstart(GetConnection(),
+                                   OpenVPN3DBus_name_backends,
+                                   OpenVPN3DBus_interf_backends,
+                                   OpenVPN3DBus_rootp_backends);
+            GVariant *res = backendstart.Call("RegisterStandby");
+            if (nullptr == res)
+            {
+                THROW_DBUSEXCEPTION("BackendClientDBus",
+                                    "No response from the backend starter");
+            }
+            g_variant_unref(res);
+        }
+        catch (const DBusException& excp)
+        {
+            // Throwing an exception here will not be caught/reported
+            std::cerr << "** ERROR ** Could not register in the backend "
+                      << "starter client pool: " << excp.GetRawError()
+                      << std::endl;
+            stop_mainloop();
+        }
+    }
+
+
+    /**
+     *  Runs a function from the main loop, with a string argument.
+     *  This is safe to call from any thread.
+     *
+     * @param func  Function to run
+     * @param arg   std::string passed to the function
+     */
+    void run_idle(void (*func)(BackendClientDBus *, const std::string&),
+                  const std::string& arg = "")
+    {
+        struct IdleTask
+        {
+            BackendClientDBus *self;
+            void (*func)(BackendClientDBus *, const std::string&);
+            std::string arg;
+        };
+        g_idle_add([](gpointer data) -> gboolean
+                   {
+                       std::unique_ptr<IdleTask> task(static_cast<IdleTask *>(data));
+                       task->func(task->self, task->arg);
+                       return G_SOURCE_REMOVE;
+                   },
+                   new IdleTask{this, func, arg});
+    }
+
+
+    /**
+     *  Called when the backend starter assigns a session token to this
+     *  standby process.  The session objects are set up from the main
+     *  loop, after the AssignSession call has returned.
+     *
+     *  Unless this process hosts several sessions, it leaves the client
+     *  pool with the first session.
+     *
+     * @param token  std::string with the session token
+     */
+    void assign_session(const std::string& token)
+    {
+        ++assigned_sessions;
+        ++starting_sessions;
+        if (1 == host_sessions)
+        {
+            session_token = token;
+        }
+        run_idle([](BackendClientDBus *self, const std::string& tok)
+                 {
+                     --self->starting_sessions;
+                     if (self->assigned_sessions >= self->host_sessions)
+                     {
+                         self->leave_standby();
+                     }
+                     try
+                     {
+                         self->start_session(tok);
+                     }
+                     catch (const std::exception& excp)
+                     {
+                         std::cerr << "** ERROR ** Failed to start the "
+                                   << "assigned session: " << excp.what()
+                                   << std::endl;
+                         if (self->sessions.empty() && !self->standby_obj)
+                         {
+                             self->stop_mainloop();
+                         }
+                     }
+                 },
+                 token);
+    }
+
+
+    /**
+     *  Removes this process from the client pool.  It will not be
+     *  assigned any more sessions.
+     */
+    void leave_standby()
+    {
+        if (0 != backendstart_watch)
+        {
+            g_bus_unwatch_name(backendstart_watch);
+            backendstart_watch = 0;
+        }
+        if (standby_obj)
+        {
+            standby_obj->RemoveObject(GetConnection());
+            standby_obj.reset();
+        }
+    }
+
+
+    /**
+     *  Called when the backend starter no longer needs this process in
+     *  the client pool.  The process exits, unless it is still hosting
+     *  sessions.
+     */
+    void stop_standby()
+    {
+        if (!standby_obj)
+        {
+            return;
+        }
+        leave_standby();
+        if (sessions.empty() && 0 == starting_sessions)
+        {
+            stop_mainloop();
+        }
+    }
+
+
+    void stop_mainloop()
+    {
+        if (mainloop)
+        {
+            g_main_loop_quit(mainloop);
+        }
+    }
+
+
+    /**
+     *  Creates the VPN client session object and tells the session
+     *  manager this process is ready, using the session token.
+     *
+     * @param token  std::string with the session token
+     */
+    void start_session(const std::string& token)
+    {
+        // Create a new OpenVPN3 client session object.  Each session
+        // hosted by this process gets its own object path.
+        std::string object_path = OpenVPN3DBus_rootp_backends_session;
+        if (host_sessions > 1)
+        {
+            object_path += "/" + std::to_string(++session_counter);
+        }
+        BackendClientObject::Ptr be_obj;
+        be_obj.reset(new BackendClientObject(GetConnection(), GetBusName(),
+                                             object_path,
+                                             token,
+                                             default_log_level,
+                                             logwr));
+        be_obj->SetSignalBroadcast(signal_broadcast);
+        be_obj->DisableSocketProtect(disabled_socket_protect);
+        be_obj->SetCoreThreadScheduling(core_thread_sched);
+        be_obj->SetCoreNumaNode(core_numa_node);
+        if (logservice)
+        {
+            try
+            {
+                be_obj->SetLogRateLimit(logservice->GetLogRateLimit(),
+                                        logservice->GetLogRateBurst());
+            }
+            catch (const DBusException&)
+            {
+                // Older log services do not provide a rate limit;
+                // continue without it
+            }
+        }
+        if (host_sessions > 1)
+        {
+            be_obj->SetSessionDoneCallback([this, object_path]()
+                                           {
+                                               run_idle(remove_session,
+                                                        object_path);
+                                           });
+        }
+        be_obj->RegisterObject(GetConnection());
+        if (mainloop)
+        {
+            be_obj->SetMainLoop(mainloop);
+        }
+        sessions[object_path] = be_obj;
+
+        if (!signal)
+        {
+            // Setup a signal object of the backend process.  When
+            // hosting several sessions, it is not tied to any of them.
+            signal.reset(new BackendSignals(GetConnection(), LogGroup::BACKENDPROC,
+                                            session_token, logwr));
+            signal->EnableBroadcast(signal_broadcast);
+            signal->SetLogLevel(default_log_level);
+            signal->LogVerb2("Backend client process started as pid " + std::to_string(start_pid)
+                             + " daemonized as pid " + std::to_string(getpid()));
+
+            procsig.reset(new ProcessSignalProducer(GetConnection(), OpenVPN3DBus_interf_backends,
+                                                    object_path, "VPN-Client"));
+            procsig->ProcessChange(StatusMinor::PROC_STARTED);
+        }
+        signal->Debug("BackendClientDBus registered on '" + GetBusName()
+                       + "': " + object_path);
+        if (host_sessions > 1)
+        {
+            signal->LogVerb2("Hosting session " + std::to_string(assigned_sessions)
+                             + " of " + std::to_string(host_sessions)
+                             + ", token " + token);
+        }
+    }
+
+
+    /**
+     *  Removes a hosted session which is done.  The process exits when
+     *  the last session is gone and it will not be assigned more.
+     *
+     * @param self  BackendClientDBus hosting the session
+     * @param path  std::string with the object path of the session
+     */
+    static void remove_session(BackendClientDBus *self, const std::string& path)
+    {
+        auto it = self->sessions.find(path);
+        if (self->sessions.end() == it)
+        {
+            return;
+        }
+        try
+        {
+            it->second->RemoveObject(self->GetConnection());
+        }
+        catch (const DBusException&)
+        {
+            // Already removed when the session was disconnected
+        }
+        self->sessions.erase(it);
+        if (self->signal)
+        {
+            self->signal->LogVerb2("Hosted session " + path + " removed, "
+                                   + std::to_string(self->sessions.size())
+                                   + " remaining");
+        }
+        if (self->sessions.empty() && !self->standby_obj)
+        {
+            self->stop_mainloop();
+        }
+    }
 };
 
 
 void start_client_thread(pid_t start_pid, const std::string argv0,
                         const std::string sesstoken,
                         bool disable_socket_protect,
+                        const ThreadScheduling& core_sched,
+                        const std::string& core_numa,
                         int log_level, bool signal_broadcast,
+                        unsigned int host_sessions,
                         LogWriter *logwr)
 {
     InitProcess::Init init;
@@ -1623,6 +3582,9 @@ void start_client_thread(pid_t start_pid, const std::string argv0,
     }
     backend_service.SetSignalBroadcast(signal_broadcast);
     backend_service.DisableSocketProtect(disable_socket_protect);
+    backend_service.SetCoreThreadScheduling(core_sched);
+    backend_service.SetCoreNumaNode(core_numa);
+    backend_service.SetHostSessions(host_sessions);
     backend_service.Setup();
 
     // Main loop
@@ -1640,7 +3602,13 @@ void start_client_thread(pid_t start_pid, const std::string argv0,
 int client_service(ParsedArgs::Ptr args)
 {
     auto extra = args->GetAllExtraArgs();
-    if (extra.size() != 1)
+    if (args->Present("standby") && extra.empty())
+    {
+        // Started by openvpn3-service-backendstart for its client pool;
+        // the session token is provided later on via the D-Bus
+        extra.push_back("");
+    }
+    else if (extra.size() != 1)
     {
         std::cout << "** ERROR ** Invalid usage: " << args->GetArgv0()
                   << " <session registration token>" << std::endl;
@@ -1700,6 +3668,53 @@ int client_service(ParsedArgs::Ptr args)
         log_level = std::atoi(args->GetValue("log-level", 0).c_str());
     }
 
+    unsigned int host_sessions = 1;
+    if (args->Present("host-sessions"))
+    {
+        if (!args->Present("standby"))
+        {
+            std::cerr << "** ERROR ** --host-sessions requires --standby"
+                      << std::endl;
+            return 2;
+        }
+        int hs = std::atoi(args->GetLastValue("host-sessions").c_str());
+        if (hs < 1 || hs > 1024)
+        {
+            std::cerr << "** ERROR ** Invalid --host-sessions value: "
+                      << args->GetLastValue("host-sessions") << std::endl;
+            return 2;
+        }
+        host_sessions = hs;
+    }
+
+    ThreadScheduling core_sched;
+    std::string core_numa;
+    try
+    {
+        if (args->Present("core-cpus"))
+        {
+            core_sched.SetCPUs(args->GetLastValue("core-cpus"));
+        }
+        if (args->Present("core-nice"))
+        {
+            core_sched.SetNice(args->GetLastValue("core-nice"));
+        }
+        if (args->Present("core-sched"))
+        {
+            core_sched.SetPolicy(args->GetLastValue("core-sched"));
+        }
+        if (args->Present("core-numa-node"))
+        {
+            core_numa = args->GetLastValue("core-numa-node");
+            NumaTopology::ParseNode(core_numa);
+        }
+    }
+    catch (const ThreadSchedulingException& excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
+
 #ifdef OPENVPN_DEBUG
     // When debugging, we might not want to do a fork.
     if (args->Present("no-fork"))
@@ -1708,8 +3723,9 @@ int client_service(ParsedArgs::Ptr args)
         {
             start_client_thread(getpid(), args->GetArgv0(), extra[0],
                                 args->Present("disable-protect-socket"),
-                                log_level, args->Present("signal-broadcast"),
-                                logwr.get());
+                                core_sched, core_numa, log_level,
+                                args->Present("signal-broadcast"),
+                                host_sessions, logwr.get());
             return 0;
         }
         catch (std::exception& excp)
@@ -1734,8 +3750,9 @@ int client_service(ParsedArgs::Ptr args)
         {
             start_client_thread(start_pid, args->GetArgv0(), extra[0],
                                 args->Present("disable-protect-socket"),
-                                log_level, args->Present("signal-broadcast"),
-                                logwr.get());
+                                core_sched, core_numa, log_level,
+                                args->Present("signal-broadcast"),
+                                host_sessions, logwr.get());
             return 0;
         }
         catch (std::exception& excp)
@@ -1759,6 +3776,8 @@ int client_service(ParsedArgs::Ptr args)
 
 int main(int argc, char **argv)
 {
+    StartupTiming::Instance().Mark("main");
+
     SingleCommand argparser(argv[0], "OpenVPN 3 VPN Client backend service",
                             client_service);
     argparser.AddVersionOption();
@@ -1773,6 +3792,23 @@ int main(int argc, char **argv)
     argparser.AddOption("disable-protect-socket", 0,
                         "Disable the socket protect call on the UDP/TCP socket. "
                         "This is needed on systems not supporting this feature");
+    argparser.AddOption("core-cpus", "CPU-LIST", true,
+                        "Pin the VPN client thread to these CPUs (e.g. 2 or 0-3,6)");
+    argparser.AddOption("core-nice", "NICE", true,
+                        "Nice value of the VPN client thread (-20 to 19)");
+    argparser.AddOption("core-sched", "POLICY[:PRIO]", true,
+                        "Scheduling policy of the VPN client thread: "
+                        "other, batch, idle, fifo or rr");
+    argparser.AddOption("core-numa-node", "NODE", true,
+                        "NUMA node of the VPN client thread, or 'auto' for "
+                        "the node of the interface the VPN traffic leaves "
+                        "through");
+    argparser.AddOption("standby", 0,
+                        "Start without a session token and wait in the "
+                        "openvpn3-service-backendstart client pool");
+    argparser.AddOption("host-sessions", "COUNT", true,
+                        "(Only with --standby) Run up to COUNT VPN sessions "
+                        "in this process (Default: 1)");
 #if OPENVPN_DEBUG
     argparser.AddOption("no-fork", 0,
                         "Debug option: Do not fork a child to be run in the background.");
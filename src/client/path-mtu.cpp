@@ -0,0 +1,222 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   path-mtu.cpp
+ *
+ * @brief  Discovers the path MTU to the remote server and the tunnel
+ *         MTU fitting into it (implementation)
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "client/path-mtu.hpp"
+
+
+const unsigned int PathMTU::DataChannelOverhead;
+const unsigned int PathMTU::MinTunnelMTU;
+
+
+/// The port the probes are sent to (discard)
+static const uint16_t probe_port = 9;
+
+
+/**
+ *  Retrieves the path MTU the kernel currently knows for the
+ *  destination of a connected socket
+ */
+static unsigned int current_mtu(int sd, bool ipv6)
+{
+    int mtu = 0;
+    socklen_t len = sizeof(mtu);
+    int r = (ipv6
+             ? ::getsockopt(sd, IPPROTO_IPV6, IPV6_MTU, &mtu, &len)
+             : ::getsockopt(sd, IPPROTO_IP, IP_MTU, &mtu, &len));
+    if (r < 0 || mtu <= 0)
+    {
+        throw PathMTUException(std::string("Could not retrieve the path MTU: ")
+                               + strerror(errno));
+    }
+    return (unsigned int) mtu;
+}
+
+
+/**
+ *  Opens a UDP socket connected to the remote, which only sends
+ *  packets with the Don't Fragment bit set
+ */
+static int open_probe_socket(const std::string& remote, bool ipv6,
+                             PathMTU::Protect& protect)
+{
+    struct sockaddr_storage sa = {};
+    socklen_t salen = 0;
+    if (ipv6)
+    {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &sa;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(probe_port);
+        if (1 != ::inet_pton(AF_INET6, remote.c_str(), &sin6->sin6_addr))
+        {
+            throw PathMTUException("Invalid IPv6 address '" + remote + "'");
+        }
+        salen = sizeof(*sin6);
+    }
+    else
+    {
+        struct sockaddr_in *sin = (struct sockaddr_in *) &sa;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(probe_port);
+        if (1 != ::inet_pton(AF_INET, remote.c_str(), &sin->sin_addr))
+        {
+            throw PathMTUException("Invalid IPv4 address '" + remote + "'");
+        }
+        salen = sizeof(*sin);
+    }
+
+    int sd = ::socket(ipv6 ? AF_INET6 : AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sd < 0)
+    {
+        throw PathMTUException(std::string("Could not open probe socket: ")
+                               + strerror(errno));
+    }
+
+    try
+    {
+        int pmtudisc = (ipv6 ? IPV6_PMTUDISC_DO : IP_PMTUDISC_DO);
+        int r = (ipv6
+                 ? ::setsockopt(sd, IPPROTO_IPV6, IPV6_MTU_DISCOVER,
+                                &pmtudisc, sizeof(pmtudisc))
+                 : ::setsockopt(sd, IPPROTO_IP, IP_MTU_DISCOVER,
+                                &pmtudisc, sizeof(pmtudisc)));
+        if (r < 0)
+        {
+            throw PathMTUException(std::string("Could not enable path MTU discovery: ")
+                                   + strerror(errno));
+        }
+
+        // Protecting the socket happens before connect(), as the
+        // route to the remote is looked up when connecting
+        if (protect)
+        {
+            protect(sd);
+        }
+
+        if (::connect(sd, (struct sockaddr *) &sa, salen) < 0)
+        {
+            throw PathMTUException("Could not connect probe socket to "
+                                   + remote + ": " + strerror(errno));
+        }
+    }
+    catch (...)
+    {
+        ::close(sd);
+        throw;
+    }
+    return sd;
+}
+
+
+unsigned int PathMTU::Probe(const std::string& remote, const bool ipv6,
+                            Protect protect,
+                            const std::chrono::milliseconds wait,
+                            const unsigned int rounds)
+{
+    int sd = open_probe_socket(remote, ipv6, protect);
+
+    const unsigned int headers = (ipv6 ? 40 : 20) + 8;
+    const size_t max_payload = 65535 - headers;
+    std::vector<char> payload;
+
+    unsigned int mtu = 0;
+    try
+    {
+        mtu = current_mtu(sd, ipv6);
+        for (unsigned int round = 0; round < rounds; ++round)
+        {
+            size_t len = (mtu > headers ? mtu - headers : 0);
+            if (len > max_payload)
+            {
+                len = max_payload;
+            }
+            payload.resize(len);
+
+            // A pending ICMP error of an earlier probe, like port
+            // unreachable, is reported instead of sending the probe
+            ssize_t r = -1;
+            for (int attempt = 0; attempt < 3 && r < 0; ++attempt)
+            {
+                r = ::send(sd, payload.data(), len, MSG_NOSIGNAL);
+                if (r < 0 && EINTR != errno && ECONNREFUSED != errno
+                    && EMSGSIZE != errno)
+                {
+                    throw PathMTUException(std::string("Sending probe failed: ")
+                                           + strerror(errno));
+                }
+                if (r < 0 && EMSGSIZE == errno)
+                {
+                    // The kernel already knows a smaller path MTU
+                    break;
+                }
+            }
+
+            std::this_thread::sleep_for(wait);
+            unsigned int now = current_mtu(sd, ipv6);
+            if (r >= 0 && now == mtu)
+            {
+                break;
+            }
+            mtu = now;
+        }
+    }
+    catch (...)
+    {
+        ::close(sd);
+        throw;
+    }
+    ::close(sd);
+    return mtu;
+}
+
+
+PathMTU::Result PathMTU::Calculate(const unsigned int path_mtu,
+                                   const bool ipv6,
+                                   const unsigned int max_tun_mtu)
+{
+    const unsigned int overhead = (ipv6 ? 40 : 20) + 8 + DataChannelOverhead;
+
+    Result ret;
+    ret.path_mtu = path_mtu;
+    ret.tun_mtu = (path_mtu > overhead + MinTunnelMTU
+                   ? path_mtu - overhead : MinTunnelMTU);
+    if (max_tun_mtu > 0 && ret.tun_mtu > max_tun_mtu)
+    {
+        ret.tun_mtu = max_tun_mtu;
+    }
+
+    // IPv4 and TCP headers without options
+    ret.mssfix = ret.tun_mtu - 40;
+    return ret;
+}
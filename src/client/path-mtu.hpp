@@ -0,0 +1,123 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   path-mtu.hpp
+ *
+ * @brief  Discovers the path MTU to the remote server and the tunnel
+ *         MTU fitting into it (declaration)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+
+class PathMTUException : public std::exception
+{
+public:
+    PathMTUException(const std::string& msg)
+        : message(msg)
+    {
+    }
+
+    const char* what() const noexcept
+    {
+        return message.c_str();
+    }
+
+private:
+    std::string message;
+};
+
+
+
+/**
+ *  Path MTU discovery towards the VPN server.
+ *
+ *  The probes are UDP packets with the Don't Fragment bit set, sent
+ *  to the server address.  Routers which cannot forward them respond
+ *  with ICMP "fragmentation needed" errors, which the kernel records
+ *  as the path MTU of the destination.  The probes are sent to the
+ *  discard port, so the VPN server does not need to handle them.
+ */
+class PathMTU
+{
+public:
+    /// Data channel overhead on top of the IP and UDP headers: opcode
+    /// and peer-id, packet id, compression framing and an AEAD tag,
+    /// rounded up to also cover CBC ciphers with HMAC-SHA256
+    static const unsigned int DataChannelOverhead = 80;
+
+    /// The tunnel MTU is never reduced below this value
+    static const unsigned int MinTunnelMTU = 576;
+
+    /**
+     *  The tunnel settings derived from a path MTU
+     */
+    struct Result
+    {
+        unsigned int path_mtu = 0;   ///< MTU of the path to the server
+        unsigned int tun_mtu = 0;    ///< MTU of the virtual network device
+        unsigned int mssfix = 0;     ///< TCP MSS of IPv4 connections
+    };
+
+
+    /**
+     *  Called with the probe socket before any probes are sent, to
+     *  route it the same way as the VPN transport socket
+     */
+    using Protect = std::function<void(int sd)>;
+
+
+    /**
+     *  Discovers the path MTU to a remote host.  This blocks until the
+     *  path MTU has not changed for one round of probes, at most for
+     *  rounds * wait.  Throws PathMTUException on errors.
+     *
+     * @param remote   std::string with the numeric address of the remote
+     * @param ipv6     Is the remote an IPv6 address
+     * @param protect  Protect function called with the probe socket,
+     *                 may be nullptr
+     * @param wait     How long to wait for ICMP errors after each probe
+     * @param rounds   Maximum number of probes to send
+     *
+     * @return Returns the path MTU
+     */
+    static unsigned int Probe(const std::string& remote, const bool ipv6,
+                              Protect protect = nullptr,
+                              const std::chrono::milliseconds wait = std::chrono::milliseconds(150),
+                              const unsigned int rounds = 6);
+
+
+    /**
+     *  Calculates the tunnel MTU and TCP MSS fitting into a path MTU
+     *
+     * @param path_mtu      The path MTU to the remote server
+     * @param ipv6          Is the VPN transport using IPv6
+     * @param max_tun_mtu   Upper limit of the tunnel MTU, usually the
+     *                      MTU requested by the server.  0 for no limit.
+     *
+     * @return Returns a Result with the tunnel settings
+     */
+    static Result Calculate(const unsigned int path_mtu, const bool ipv6,
+                            const unsigned int max_tun_mtu);
+};
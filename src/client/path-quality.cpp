@@ -0,0 +1,296 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   path-quality.cpp
+ *
+ * @brief  Round-trip time, jitter and loss of the path through the
+ *         tunnel (implementation)
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "client/path-quality.hpp"
+
+
+const size_t PathQuality::Buckets;
+
+
+void PathQuality::AddSample(const std::chrono::microseconds rtt)
+{
+    uint64_t us = (rtt.count() > 0 ? (uint64_t) rtt.count() : 0);
+
+    size_t bucket = 0;
+    for (uint64_t v = us; v > 1 && bucket < Buckets - 1; v >>= 1)
+    {
+        ++bucket;
+    }
+
+    std::lock_guard<std::mutex> lg(mtx);
+    ++histogram[bucket];
+    if (samples > 0)
+    {
+        double d = std::fabs((double) us - (double) last);
+        jitter += (d - jitter) / 16.0;
+    }
+    if (0 == samples || us < min)
+    {
+        min = us;
+    }
+    if (us > max)
+    {
+        max = us;
+    }
+    last = us;
+    sum += us;
+    ++samples;
+}
+
+
+void PathQuality::AddLoss()
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    ++lost;
+}
+
+
+void PathQuality::Reset()
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    std::fill(histogram.begin(), histogram.end(), 0);
+    samples = 0;
+    lost = 0;
+    sum = 0;
+    min = 0;
+    max = 0;
+    last = 0;
+    jitter = 0;
+}
+
+
+PathQuality::Summary PathQuality::GetSummary() const
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    Summary s;
+    s.samples = samples;
+    s.lost = lost;
+    s.min = min;
+    s.max = max;
+    s.mean = (samples > 0 ? sum / samples : 0);
+    s.p50 = percentile(50);
+    s.p90 = percentile(90);
+    s.p99 = percentile(99);
+    s.jitter = (uint64_t) jitter;
+    s.loss_ppm = (samples + lost > 0 ? lost * 1000000 / (samples + lost) : 0);
+    return s;
+}
+
+
+std::vector<uint64_t> PathQuality::GetHistogram() const
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    return histogram;
+}
+
+
+const std::vector<std::string>& PathQuality::GetStatsKeys()
+{
+    static const std::vector<std::string> keys = {
+        "PATH_RTT_P50_US",
+        "PATH_RTT_P90_US",
+        "PATH_RTT_P99_US",
+        "PATH_RTT_JITTER_US",
+        "PATH_PROBES_ANSWERED",
+        "PATH_PROBES_LOST"
+    };
+    return keys;
+}
+
+
+std::vector<uint64_t> PathQuality::GetStatsValues() const
+{
+    Summary s = GetSummary();
+    return {s.p50, s.p90, s.p99, s.jitter, s.samples, s.lost};
+}
+
+
+/**
+ *  Estimates a percentile from the histogram, interpolating linearly
+ *  inside the bucket it falls into, with each sample in the middle of
+ *  its share of the bucket.  The result is kept within the
+ *  observed minimum and maximum.  The caller must hold the mutex.
+ */
+uint64_t PathQuality::percentile(const unsigned int pct) const
+{
+    if (0 == samples)
+    {
+        return 0;
+    }
+
+    uint64_t target = (samples * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Buckets; ++i)
+    {
+        if (0 == histogram[i] || seen + histogram[i] < target)
+        {
+            seen += histogram[i];
+            continue;
+        }
+        uint64_t low = (0 == i ? 0 : (1ULL << i));
+        uint64_t high = (1ULL << (i + 1));
+        uint64_t ret = low + (high - low) * (2 * (target - seen) - 1)
+                             / (2 * histogram[i]);
+        if (ret < min)
+        {
+            ret = min;
+        }
+        if (ret > max)
+        {
+            ret = max;
+        }
+        return ret;
+    }
+    return max;
+}
+
+
+
+PingSocket::PingSocket(const std::string& address, const bool ipv6)
+    : ipv6(ipv6)
+{
+    struct sockaddr_storage sa = {};
+    socklen_t salen = 0;
+    if (ipv6)
+    {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &sa;
+        sin6->sin6_family = AF_INET6;
+        if (1 != ::inet_pton(AF_INET6, address.c_str(), &sin6->sin6_addr))
+        {
+            throw PathQualityException("Invalid IPv6 address '" + address + "'");
+        }
+        salen = sizeof(*sin6);
+    }
+    else
+    {
+        struct sockaddr_in *sin = (struct sockaddr_in *) &sa;
+        sin->sin_family = AF_INET;
+        if (1 != ::inet_pton(AF_INET, address.c_str(), &sin->sin_addr))
+        {
+            throw PathQualityException("Invalid IPv4 address '" + address + "'");
+        }
+        salen = sizeof(*sin);
+    }
+
+    sd = ::socket(ipv6 ? AF_INET6 : AF_INET, SOCK_DGRAM | SOCK_CLOEXEC,
+                  (ipv6 ? (int) IPPROTO_ICMPV6 : (int) IPPROTO_ICMP));
+    if (sd < 0)
+    {
+        throw PathQualityException(std::string("Could not open ICMP socket: ")
+                                   + strerror(errno));
+    }
+
+    // The kernel fills in the identifier and only delivers the replies
+    // to this socket's requests; connecting filters out other sources
+    if (::connect(sd, (struct sockaddr *) &sa, salen) < 0)
+    {
+        int err = errno;
+        ::close(sd);
+        throw PathQualityException("Could not connect ICMP socket to "
+                                   + address + ": " + strerror(err));
+    }
+}
+
+
+PingSocket::~PingSocket()
+{
+    if (sd >= 0)
+    {
+        ::close(sd);
+    }
+}
+
+
+std::chrono::microseconds PingSocket::Probe(const std::chrono::milliseconds timeout)
+{
+    const uint16_t seq = ++sequence;
+
+    // type, code, checksum, identifier, sequence; the kernel
+    // calculates the checksum and sets the identifier
+    uint8_t req[8 + 8] = {};
+    req[0] = (ipv6 ? ICMP6_ECHO_REQUEST : ICMP_ECHO);
+    uint16_t nseq = htons(seq);
+    memcpy(req + 6, &nseq, sizeof(nseq));
+
+    auto sent = std::chrono::steady_clock::now();
+    if (::send(sd, req, sizeof(req), MSG_NOSIGNAL) < 0)
+    {
+        throw PathQualityException(std::string("Sending ICMP echo request failed: ")
+                                   + strerror(errno));
+    }
+
+    const uint8_t reply_type = (ipv6 ? ICMP6_ECHO_REPLY : ICMP_ECHOREPLY);
+    auto deadline = sent + timeout;
+    while (true)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            return std::chrono::microseconds(-1);
+        }
+        int wait_ms = (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+
+        struct pollfd pfd = {sd, POLLIN, 0};
+        int r = ::poll(&pfd, 1, (wait_ms > 0 ? wait_ms : 1));
+        if (r < 0 && EINTR != errno)
+        {
+            throw PathQualityException(std::string("Waiting for ICMP echo reply failed: ")
+                                       + strerror(errno));
+        }
+        if (r <= 0)
+        {
+            continue;
+        }
+
+        uint8_t reply[64];
+        ssize_t len = ::recv(sd, reply, sizeof(reply), MSG_DONTWAIT);
+        auto received = std::chrono::steady_clock::now();
+        if (len < 8)
+        {
+            // Errors like host unreachable are reported here as well;
+            // these count as lost probes once the timeout passes
+            continue;
+        }
+        uint16_t rseq = 0;
+        memcpy(&rseq, reply + 6, sizeof(rseq));
+        if (reply_type == reply[0] && ntohs(rseq) == seq)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(received - sent);
+        }
+    }
+}
@@ -0,0 +1,194 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   path-quality.hpp
+ *
+ * @brief  Round-trip time, jitter and loss of the path through the
+ *         tunnel (declaration)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+class PathQualityException : public std::exception
+{
+public:
+    PathQualityException(const std::string& msg)
+        : message(msg)
+    {
+    }
+
+    const char* what() const noexcept
+    {
+        return message.c_str();
+    }
+
+private:
+    std::string message;
+};
+
+
+
+/**
+ *  Collects the round-trip times of the probes sent through the tunnel
+ *  in a histogram, together with the jitter and the number of probes
+ *  lost.  The histogram has one bucket per power of two microseconds,
+ *  so it stays small regardless of how long the session runs.
+ *
+ *  This class is thread-safe; the probes are recorded by a separate
+ *  thread while the statistics are read from the D-Bus handlers.
+ */
+class PathQuality
+{
+public:
+    /// Bucket i counts round-trip times of [2^i, 2^(i+1)) microseconds;
+    /// the last bucket also counts everything above
+    static const size_t Buckets = 24;
+
+    /**
+     *  A summary of all the recorded probes.  All times are in
+     *  microseconds.
+     */
+    struct Summary
+    {
+        uint64_t samples = 0;   ///< Probes answered
+        uint64_t lost = 0;      ///< Probes not answered in time
+        uint64_t min = 0;
+        uint64_t max = 0;
+        uint64_t mean = 0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t jitter = 0;    ///< Smoothed RTT variation, as in RFC 3550
+        uint64_t loss_ppm = 0;  ///< Lost probes per million sent
+    };
+
+
+    /**
+     *  Records the round-trip time of an answered probe
+     *
+     * @param rtt  Round-trip time of the probe
+     */
+    void AddSample(const std::chrono::microseconds rtt);
+
+
+    /**
+     *  Records a probe which was not answered in time
+     */
+    void AddLoss();
+
+
+    /**
+     *  Forgets all the recorded probes, used when the connection to a
+     *  new server has been established
+     */
+    void Reset();
+
+
+    /**
+     * @return Returns a Summary of all the recorded probes
+     */
+    Summary GetSummary() const;
+
+
+    /**
+     * @return Returns a std::vector with the Buckets histogram counters
+     */
+    std::vector<uint64_t> GetHistogram() const;
+
+
+    /**
+     * @return Returns the names of the statistics counters provided by
+     *         GetStatsValues(), as appended to the connection statistics
+     */
+    static const std::vector<std::string>& GetStatsKeys();
+
+
+    /**
+     * @return Returns the statistics counters, in the order of
+     *         GetStatsKeys()
+     */
+    std::vector<uint64_t> GetStatsValues() const;
+
+
+private:
+    mutable std::mutex mtx;
+    std::vector<uint64_t> histogram = std::vector<uint64_t>(Buckets);
+    uint64_t samples = 0;
+    uint64_t lost = 0;
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+    uint64_t last = 0;
+    double jitter = 0;
+
+    uint64_t percentile(const unsigned int pct) const;
+};
+
+
+
+/**
+ *  Sends ICMP echo requests to a host and measures the time until the
+ *  reply arrives.  This uses the unprivileged ICMP sockets of Linux,
+ *  which require the group of the process to be included in the
+ *  net.ipv4.ping_group_range sysctl; systemd allows all groups by
+ *  default.
+ */
+class PingSocket
+{
+public:
+    /**
+     *  Opens the ICMP socket.  Throws PathQualityException if the
+     *  address is invalid or the socket cannot be opened.
+     *
+     * @param address  std::string with the numeric address to probe
+     * @param ipv6     Is the address an IPv6 address
+     */
+    PingSocket(const std::string& address, const bool ipv6);
+    ~PingSocket();
+
+    PingSocket(const PingSocket&) = delete;
+    PingSocket& operator=(const PingSocket&) = delete;
+
+
+    /**
+     *  Sends one echo request and waits for its reply.  Replies to
+     *  earlier requests arriving late are ignored.  Throws
+     *  PathQualityException if the request cannot be sent.
+     *
+     * @param timeout  How long to wait for the reply
+     *
+     * @return Returns the round-trip time, or a negative duration if no
+     *         reply arrived in time
+     */
+    std::chrono::microseconds Probe(const std::chrono::milliseconds timeout);
+
+
+private:
+    int sd = -1;
+    bool ipv6 = false;
+    uint16_t sequence = 0;
+};
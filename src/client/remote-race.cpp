@@ -0,0 +1,438 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   remote-race.cpp
+ *
+ * @brief  Probes several remote servers of a configuration profile
+ *         concurrently and picks the first one answering (implementation)
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "client/remote-race.hpp"
+
+
+using Clock = std::chrono::steady_clock;
+
+
+int RaceRemote::family() const
+{
+    if (proto.find('4') != std::string::npos)
+    {
+        return AF_INET;
+    }
+    if (proto.find('6') != std::string::npos)
+    {
+        return AF_INET6;
+    }
+    return AF_UNSPEC;
+}
+
+
+/**
+ *  Waits for an event on a socket until the deadline
+ *
+ * @return Returns true if the event occurred
+ */
+static bool wait_socket(int sd, short events, const Clock::time_point& deadline)
+{
+    while (true)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - Clock::now()).count();
+        if (left <= 0)
+        {
+            return false;
+        }
+        struct pollfd pfd = {sd, events, 0};
+        int r = ::poll(&pfd, 1, (int) left);
+        if (r < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        return r > 0 && (pfd.revents & events);
+    }
+}
+
+
+/**
+ *  Probes a single resolved address of a remote
+ *
+ * @return Returns true if the remote answered before the deadline
+ */
+static bool probe_address(const struct addrinfo *ai, bool tcp,
+                          const Clock::time_point& deadline)
+{
+    int sd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      ai->ai_protocol);
+    if (sd < 0)
+    {
+        return false;
+    }
+
+    bool ret = false;
+    if (::connect(sd, ai->ai_addr, ai->ai_addrlen) < 0
+        && EINPROGRESS != errno)
+    {
+        ::close(sd);
+        return false;
+    }
+
+    if (tcp)
+    {
+        if (wait_socket(sd, POLLOUT, deadline))
+        {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            ret = (0 == ::getsockopt(sd, SOL_SOCKET, SO_ERROR, &err, &len)
+                   && 0 == err);
+        }
+    }
+    else
+    {
+        // P_CONTROL_HARD_RESET_CLIENT_V2 (opcode 7, key id 0), a random
+        // session id, an empty ACK array and message packet id 0.  A
+        // server not requiring --tls-auth/--tls-crypt responds with a
+        // P_CONTROL_HARD_RESET_SERVER_V2 packet.
+        unsigned char pkt[14] = {};
+        pkt[0] = (7 << 3);
+        std::random_device rd;
+        for (size_t i = 1; i < 9; ++i)
+        {
+            pkt[i] = (unsigned char) rd();
+        }
+        if (::send(sd, pkt, sizeof(pkt), MSG_NOSIGNAL) == (ssize_t) sizeof(pkt)
+            && wait_socket(sd, POLLIN, deadline))
+        {
+            unsigned char buf[64];
+            ret = ::recv(sd, buf, sizeof(buf), 0) > 0;
+        }
+    }
+    ::close(sd);
+    return ret;
+}
+
+
+/**
+ *  Resolves a remote and probes its addresses, one by one
+ *
+ * @param remote    RaceRemote to probe
+ * @param deadline  When to give up
+ * @param address   std::string where the numeric address answering
+ *                  is stored
+ *
+ * @return Returns true if the remote answered before the deadline
+ */
+static bool probe_remote(const RaceRemote& remote,
+                         const Clock::time_point& deadline,
+                         std::string& address)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = remote.family();
+    hints.ai_socktype = (remote.tcp() ? SOCK_STREAM : SOCK_DGRAM);
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    struct addrinfo *res = nullptr;
+    if (0 != ::getaddrinfo(remote.host.c_str(), remote.port.c_str(),
+                           &hints, &res))
+    {
+        return false;
+    }
+
+    bool ret = false;
+    for (struct addrinfo *ai = res; ai && Clock::now() < deadline; ai = ai->ai_next)
+    {
+        if (probe_address(ai, remote.tcp(), deadline))
+        {
+            char host[NI_MAXHOST];
+            if (0 == ::getnameinfo(ai->ai_addr, ai->ai_addrlen,
+                                   host, sizeof(host), nullptr, 0,
+                                   NI_NUMERICHOST))
+            {
+                address = host;
+            }
+            ret = true;
+            break;
+        }
+    }
+    ::freeaddrinfo(res);
+    return ret;
+}
+
+
+RemoteRace::RemoteRace(std::vector<RaceRemote> remotes_arg,
+                       unsigned int parallel,
+                       std::chrono::milliseconds timeout, bool udp_probe)
+    : remotes(std::move(remotes_arg)),
+      parallel(parallel),
+      timeout(timeout),
+      udp_probe(udp_probe)
+{
+}
+
+
+RemoteRace::~RemoteRace()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    (void) stop_standby();
+}
+
+
+RemoteRace::Selection RemoteRace::Next()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    Selection sel;
+    if (remotes.empty())
+    {
+        return sel;
+    }
+
+    if (last_connected && last >= 0)
+    {
+        last_connected = false;
+
+        // Fail over to the standby remote if there is one, otherwise
+        // try the server we were connected to first
+        sel = stop_standby();
+        if (sel.index >= 0)
+        {
+            offset = (sel.index + 1) % remotes.size();
+            last = sel.index;
+            return sel;
+        }
+        sel.index = last;
+        return sel;
+    }
+
+    const size_t count = remotes.size();
+    for (size_t tried = 0; parallel > 0 && tried < count; tried += parallel)
+    {
+        std::vector<size_t> idx;
+        std::vector<RaceRemote> candidates;
+        for (size_t i = 0; i < parallel && tried + i < count; ++i)
+        {
+            idx.push_back((offset + i) % count);
+            candidates.push_back(remotes[idx.back()]);
+        }
+
+        Selection won = Race(candidates, timeout, udp_probe);
+        if (won.index >= 0)
+        {
+            sel.index = (int) idx[won.index];
+            sel.address = won.address;
+            offset = (sel.index + 1) % count;
+            last = sel.index;
+            return sel;
+        }
+        offset = (offset + candidates.size()) % count;
+    }
+
+    // No remote answered, or racing is disabled; hand them out in the
+    // profile order and let the connection attempt decide
+    sel.index = (int) offset;
+    offset = (offset + 1) % count;
+    last = sel.index;
+    return sel;
+}
+
+
+void RemoteRace::Connected()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    last_connected = true;
+    start_standby();
+}
+
+
+void RemoteRace::EnableStandby(std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    standby_interval = interval;
+}
+
+
+RemoteRace::Selection RemoteRace::GetStandby()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    if (!standby)
+    {
+        return Selection();
+    }
+    std::lock_guard<std::mutex> sguard(standby->mtx);
+    return standby->standby;
+}
+
+
+void RemoteRace::Prefer(size_t index)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    if (index < remotes.size())
+    {
+        last = (int) index;
+        last_connected = true;
+        offset = (index + 1) % remotes.size();
+    }
+}
+
+
+/**
+ *  Starts probing for a standby remote, following the connected one.
+ *  Must be called with the mtx lock held.
+ */
+void RemoteRace::start_standby()
+{
+    (void) stop_standby();
+    if (standby_interval.count() <= 0 || last < 0 || remotes.size() < 2)
+    {
+        return;
+    }
+
+    // The remotes are probed in the profile order, starting after the
+    // connected one, one window at a time
+    std::vector<size_t> order;
+    for (size_t i = 1; i < remotes.size(); ++i)
+    {
+        order.push_back((last + i) % remotes.size());
+    }
+    const size_t window = (parallel > 0 ? parallel : 1);
+
+    standby = std::make_shared<StandbyState>();
+    std::shared_ptr<StandbyState> state = standby;
+    std::vector<RaceRemote> rmts = remotes;
+    const std::chrono::milliseconds tmo = timeout;
+    const std::chrono::milliseconds interval = standby_interval;
+    const bool udp = udp_probe;
+    std::thread([state, rmts, order, window, tmo, interval, udp]()
+                {
+                    std::unique_lock<std::mutex> lock(state->mtx);
+                    while (!state->stop)
+                    {
+                        lock.unlock();
+                        Selection found;
+                        for (size_t start = 0; start < order.size() && found.index < 0;
+                             start += window)
+                        {
+                            std::vector<RaceRemote> candidates;
+                            for (size_t i = start; i < start + window && i < order.size(); ++i)
+                            {
+                                candidates.push_back(rmts[order[i]]);
+                            }
+                            Selection won = Race(candidates, tmo, udp);
+                            if (won.index >= 0)
+                            {
+                                found.index = (int) order[start + won.index];
+                                found.address = won.address;
+                            }
+                        }
+                        lock.lock();
+                        state->standby = found;
+                        state->cv.wait_for(lock, interval,
+                                           [state]() { return state->stop; });
+                    }
+                }).detach();
+}
+
+
+/**
+ *  Stops probing for a standby remote.  Must be called with the mtx
+ *  lock held.
+ *
+ * @return Returns the last standby remote found
+ */
+RemoteRace::Selection RemoteRace::stop_standby()
+{
+    Selection ret;
+    if (!standby)
+    {
+        return ret;
+    }
+    {
+        std::lock_guard<std::mutex> guard(standby->mtx);
+        standby->stop = true;
+        ret = standby->standby;
+    }
+    standby->cv.notify_all();
+    standby.reset();
+    return ret;
+}
+
+
+RemoteRace::Selection RemoteRace::Race(const std::vector<RaceRemote>& candidates,
+                                       std::chrono::milliseconds timeout,
+                                       bool udp_probe)
+{
+    // The probe threads are detached, as a DNS lookup cannot be
+    // interrupted.  They only touch this shared state, which lives on
+    // until the last of them has completed.
+    struct State
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+        size_t pending = 0;
+        Selection winner;
+    };
+    auto state = std::make_shared<State>();
+    const Clock::time_point deadline = Clock::now() + timeout;
+
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (!candidates[i].tcp() && !udp_probe)
+        {
+            continue;
+        }
+        ++state->pending;
+        RaceRemote remote = candidates[i];
+        std::thread([state, remote, i, deadline]()
+                    {
+                        std::string address;
+                        bool ok = probe_remote(remote, deadline, address);
+
+                        std::lock_guard<std::mutex> guard(state->mtx);
+                        --state->pending;
+                        if (ok && state->winner.index < 0)
+                        {
+                            state->winner.index = (int) i;
+                            state->winner.address = address;
+                        }
+                        state->cv.notify_all();
+                    }).detach();
+    }
+
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cv.wait_until(lock, deadline,
+                         [state]()
+                         {
+                             return state->winner.index >= 0
+                                    || 0 == state->pending;
+                         });
+    return state->winner;
+}
@@ -0,0 +1,216 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   remote-race.hpp
+ *
+ * @brief  Probes several remote servers of a configuration profile
+ *         concurrently and picks the first one answering (declaration)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/**
+ *  A single remote server entry from a configuration profile
+ */
+struct RaceRemote
+{
+    RaceRemote(std::string host, std::string port, std::string proto)
+        : host(std::move(host)), port(std::move(port)), proto(std::move(proto))
+    {
+    }
+
+    /**
+     * @return Returns true if the remote uses a TCP based transport
+     */
+    bool tcp() const
+    {
+        return 0 == proto.compare(0, 3, "tcp");
+    }
+
+    /**
+     * @return Returns the address family restriction of the protocol,
+     *         AF_INET, AF_INET6 or AF_UNSPEC
+     */
+    int family() const;
+
+    std::string host;
+    std::string port;
+    std::string proto;
+};
+
+
+/**
+ *  Instead of trying the remote servers of a profile one at a time,
+ *  each failing one costing a full connection timeout, the RemoteRace
+ *  probes a window of remotes concurrently and hands out the first
+ *  remote which answered.
+ *
+ *  TCP remotes are probed by completing the TCP handshake.  UDP remotes
+ *  are probed by sending an OpenVPN client hard reset packet and waiting
+ *  for any reply.  Servers requiring --tls-auth or --tls-crypt silently
+ *  drop such packets, so UDP remotes are only probed when the profile
+ *  does not use these options.
+ */
+class RemoteRace
+{
+public:
+    using Ptr = std::shared_ptr<RemoteRace>;
+
+    /**
+     *  The remote to use for the next connection attempt
+     */
+    struct Selection
+    {
+        /// Index of the remote in the remote list, -1 if none
+        int index = -1;
+
+        /// Numeric address which answered the probe; empty if the
+        /// remote was not probed successfully
+        std::string address;
+    };
+
+    /**
+     * @param remotes    std::vector<RaceRemote> with all the remotes of
+     *                   the profile, in the profile order
+     * @param parallel   How many remotes to probe concurrently.  With 0,
+     *                   the remotes are not probed but handed out in the
+     *                   profile order, which is only useful together with
+     *                   Prefer().
+     * @param timeout    How long to wait for a window of remotes to answer
+     * @param udp_probe  Can UDP remotes be probed
+     */
+    RemoteRace(std::vector<RaceRemote> remotes, unsigned int parallel,
+               std::chrono::milliseconds timeout, bool udp_probe);
+    ~RemoteRace();
+
+
+    /**
+     *  Picks the remote for the next connection attempt.
+     *
+     *  After a successful connection, the standby remote is returned
+     *  if one has been found, see EnableStandby().  If not, the same
+     *  remote is returned once more, to reconnect to a known working
+     *  server first.  Otherwise
+     *  the following remotes are raced, window by window, until one
+     *  answers or all have been tried once.  If none answers, the remotes
+     *  are handed out one by one in the profile order.
+     *
+     *  This blocks for as long as the race runs.
+     *
+     * @return Returns a Selection with the remote to use
+     */
+    Selection Next();
+
+
+    /**
+     *  Tells the connection to the last remote returned by Next() was
+     *  established
+     */
+    void Connected();
+
+
+    /**
+     *  Keeps a standby remote ready while connected.  After Connected(),
+     *  the remotes following the connected one are probed in the
+     *  background, repeatedly, and the first one answering is kept as
+     *  the standby.  When the connection fails, Next() hands out the
+     *  standby with its already resolved address right away, without
+     *  racing or resolving anything.
+     *
+     * @param interval  How often the standby remote is probed again
+     */
+    void EnableStandby(std::chrono::milliseconds interval);
+
+
+    /**
+     * @return Returns the current standby remote; its index is -1 if
+     *         no standby remote has answered (yet)
+     */
+    Selection GetStandby();
+
+
+    /**
+     *  Makes the next Next() call return the given remote without
+     *  racing, as if the last connection to it had succeeded
+     *
+     * @param index  Index of the remote in the remote list
+     */
+    void Prefer(size_t index);
+
+
+    /**
+     * @return Returns the remote list
+     */
+    const std::vector<RaceRemote>& GetRemotes() const
+    {
+        return remotes;
+    }
+
+
+    /**
+     *  Probes the given remotes concurrently
+     *
+     * @param candidates  std::vector<RaceRemote> with the remotes to probe
+     * @param timeout     How long to wait for an answer
+     * @param udp_probe   Can UDP remotes be probed
+     *
+     * @return Returns a Selection with the index in candidates of the
+     *         first remote answering, or -1 if none answered in time
+     */
+    static Selection Race(const std::vector<RaceRemote>& candidates,
+                          std::chrono::milliseconds timeout, bool udp_probe);
+
+
+private:
+    /**
+     *  State of the standby probing thread.  The thread is detached, as
+     *  a DNS lookup cannot be interrupted, so the state is shared.
+     */
+    struct StandbyState
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stop = false;
+        Selection standby;
+    };
+
+    std::vector<RaceRemote> remotes;
+    const unsigned int parallel;
+    const std::chrono::milliseconds timeout;
+    const bool udp_probe;
+
+    std::mutex mtx;
+    size_t offset = 0;
+    int last = -1;
+    bool last_connected = false;
+    std::chrono::milliseconds standby_interval{0};
+    std::shared_ptr<StandbyState> standby;
+
+    void start_standby();
+    Selection stop_standby();
+};
@@ -0,0 +1,274 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   socket-buffers.cpp
+ *
+ * @brief  Adapts the buffer sizes of the UDP transport socket to the
+ *         observed receive drops and buffer usage (implementation)
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <linux/sock_diag.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "client/socket-buffers.hpp"
+
+
+void SocketBuffers::Enable(const Limits& l)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    enabled = true;
+    limits = l;
+    limits.max = std::max(limits.min, limits.max);
+    rcv_capped = false;
+    snd_capped = false;
+}
+
+
+bool SocketBuffers::IsEnabled() const
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    return enabled;
+}
+
+
+void SocketBuffers::Attach(const int sd)
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    fd = -1;
+    rcv_idle = 0;
+    snd_idle = 0;
+    rcv_capped = false;
+    snd_capped = false;
+
+    int type = 0;
+    socklen_t len = sizeof(type);
+    struct stat st = {};
+    if (sd < 0
+        || getsockopt(sd, SOL_SOCKET, SO_TYPE, &type, &len) < 0
+        || SOCK_DGRAM != type
+        || fstat(sd, &st) < 0)
+    {
+        return;
+    }
+
+    uint32_t meminfo[SK_MEMINFO_VARS] = {};
+    len = sizeof(meminfo);
+    if (getsockopt(sd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) < 0)
+    {
+        // Kernels older than 4.12 cannot report the drops
+        return;
+    }
+    fd = sd;
+    dev = st.st_dev;
+    ino = st.st_ino;
+    last_drops = meminfo[SK_MEMINFO_DROPS];
+    rcvbuf = meminfo[SK_MEMINFO_RCVBUF];
+    sndbuf = meminfo[SK_MEMINFO_SNDBUF];
+}
+
+
+std::string SocketBuffers::Sample()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    if (!enabled || fd < 0)
+    {
+        return "";
+    }
+    if (!same_socket())
+    {
+        // The core library has closed the socket
+        fd = -1;
+        return "";
+    }
+
+    uint32_t meminfo[SK_MEMINFO_VARS] = {};
+    socklen_t len = sizeof(meminfo);
+    if (getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) < 0)
+    {
+        return "";
+    }
+    rcvbuf = meminfo[SK_MEMINFO_RCVBUF];
+    sndbuf = meminfo[SK_MEMINFO_SNDBUF];
+    uint32_t new_drops = meminfo[SK_MEMINFO_DROPS] - last_drops;
+    last_drops = meminfo[SK_MEMINFO_DROPS];
+    drops += new_drops;
+
+    std::stringstream log;
+    if (new_drops > 0)
+    {
+        rcv_idle = 0;
+        if (!rcv_capped && rcvbuf < limits.max)
+        {
+            unsigned int size = resize(SO_RCVBUF, NextSize(rcvbuf, true, limits));
+            if (size > rcvbuf)
+            {
+                log << "receive buffer " << rcvbuf << " -> " << size
+                    << " bytes after " << new_drops << " drops";
+                rcvbuf = size;
+                ++grown;
+            }
+            else
+            {
+                log << "receive buffer kept at " << rcvbuf
+                    << " bytes by net.core.rmem_max, " << new_drops
+                    << " drops";
+                rcv_capped = true;
+            }
+        }
+    }
+    else if (meminfo[SK_MEMINFO_RMEM_ALLOC] < rcvbuf / 4)
+    {
+        if (++rcv_idle >= ShrinkAfter && rcvbuf > limits.min)
+        {
+            unsigned int size = resize(SO_RCVBUF, NextSize(rcvbuf, false, limits));
+            if (size < rcvbuf)
+            {
+                log << "receive buffer " << rcvbuf << " -> " << size
+                    << " bytes, mostly unused";
+                rcvbuf = size;
+                ++shrunk;
+                rcv_capped = false;
+            }
+            rcv_idle = 0;
+        }
+    }
+    else
+    {
+        rcv_idle = 0;
+    }
+
+    if (meminfo[SK_MEMINFO_WMEM_ALLOC] >= sndbuf / 4 * 3)
+    {
+        snd_idle = 0;
+        if (!snd_capped && sndbuf < limits.max)
+        {
+            unsigned int size = resize(SO_SNDBUF, NextSize(sndbuf, true, limits));
+            log << (log.tellp() > 0 ? ", " : "");
+            if (size > sndbuf)
+            {
+                log << "send buffer " << sndbuf << " -> " << size
+                    << " bytes, nearly full";
+                sndbuf = size;
+                ++grown;
+            }
+            else
+            {
+                log << "send buffer kept at " << sndbuf
+                    << " bytes by net.core.wmem_max";
+                snd_capped = true;
+            }
+        }
+    }
+    else if (meminfo[SK_MEMINFO_WMEM_ALLOC] < sndbuf / 4)
+    {
+        if (++snd_idle >= ShrinkAfter && sndbuf > limits.min)
+        {
+            unsigned int size = resize(SO_SNDBUF, NextSize(sndbuf, false, limits));
+            if (size < sndbuf)
+            {
+                log << (log.tellp() > 0 ? ", " : "")
+                    << "send buffer " << sndbuf << " -> " << size
+                    << " bytes, mostly unused";
+                sndbuf = size;
+                ++shrunk;
+                snd_capped = false;
+            }
+            snd_idle = 0;
+        }
+    }
+    else
+    {
+        snd_idle = 0;
+    }
+    return log.str();
+}
+
+
+const std::vector<std::string>& SocketBuffers::GetStatsKeys()
+{
+    static const std::vector<std::string> keys = {
+        "TRANSPORT_RCVBUF",
+        "TRANSPORT_SNDBUF",
+        "TRANSPORT_RX_DROPS",
+        "TRANSPORT_BUF_GROWN",
+        "TRANSPORT_BUF_SHRUNK"
+    };
+    return keys;
+}
+
+
+std::vector<uint64_t> SocketBuffers::GetStatsValues() const
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    if (!enabled)
+    {
+        return std::vector<uint64_t>(GetStatsKeys().size());
+    }
+    return {rcvbuf, sndbuf, drops, grown, shrunk};
+}
+
+
+unsigned int SocketBuffers::NextSize(const unsigned int current,
+                                     const bool grow,
+                                     const Limits& limits)
+{
+    if (grow)
+    {
+        uint64_t size = std::max((uint64_t) current * 2, (uint64_t) limits.min);
+        return std::max(current, (unsigned int) std::min(size, (uint64_t) limits.max));
+    }
+    return std::max(current / 2, std::min(current, limits.min));
+}
+
+
+/**
+ *  Checks that the file descriptor still refers to the watched
+ *  socket.  The caller must hold the mutex.
+ */
+bool SocketBuffers::same_socket() const
+{
+    struct stat st = {};
+    return (0 == fstat(fd, &st) && S_ISSOCK(st.st_mode)
+            && st.st_dev == dev && st.st_ino == ino);
+}
+
+
+/**
+ *  Requests a new buffer size.  The kernel doubles the requested
+ *  value, so half of the wanted size is requested.  The caller must
+ *  hold the mutex.
+ *
+ * @return Returns the buffer size reported by the kernel afterwards
+ */
+unsigned int SocketBuffers::resize(const int opt, const unsigned int size)
+{
+    int req = size / 2;
+    (void) setsockopt(fd, SOL_SOCKET, opt, &req, sizeof(req));
+
+    int actual = 0;
+    socklen_t len = sizeof(actual);
+    if (getsockopt(fd, SOL_SOCKET, opt, &actual, &len) < 0)
+    {
+        return 0;
+    }
+    return actual;
+}
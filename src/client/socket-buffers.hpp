@@ -0,0 +1,162 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   socket-buffers.hpp
+ *
+ * @brief  Adapts the buffer sizes of the UDP transport socket to the
+ *         observed receive drops and buffer usage (declaration)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+
+/**
+ *  Watches the UDP transport socket of the VPN connection and adapts
+ *  its SO_RCVBUF and SO_SNDBUF sizes within configured limits.
+ *
+ *  The socket is sampled periodically with SO_MEMINFO, which reports
+ *  the buffer sizes, the memory currently queued and the number of
+ *  packets dropped because the receive buffer was full.  The receive
+ *  buffer is doubled when new drops are seen and the send buffer when
+ *  it is found mostly full.  Buffers which have stayed mostly empty
+ *  for a while are halved again, so idle sessions do not keep large
+ *  buffers around.
+ *
+ *  The kernel limits SO_RCVBUF and SO_SNDBUF to the net.core.rmem_max
+ *  and net.core.wmem_max sysctls; the buffers do not grow beyond them.
+ *
+ *  The OpenVPN 3 Core library owns the socket and may close it at any
+ *  time.  The socket is identified by its inode as well, so a reused
+ *  file descriptor is never touched.
+ *
+ *  This class is thread-safe.
+ */
+class SocketBuffers
+{
+public:
+    /**
+     *  Limits of the buffer sizes, in bytes, as reported by the kernel.
+     *  The kernel reports twice the size requested by setsockopt(),
+     *  which includes its bookkeeping overhead.
+     */
+    struct Limits
+    {
+        unsigned int min = 64 * 1024;
+        unsigned int max = 4 * 1024 * 1024;
+    };
+
+
+    /**
+     *  Enables the buffer adaption and sets its limits.  The changes
+     *  apply from the next Sample() call.  A maximum below the minimum
+     *  is raised to the minimum.
+     *
+     * @param limits  Limits for both the receive and send buffer
+     */
+    void Enable(const Limits& limits);
+
+
+    /**
+     * @return Returns true if Enable() has been called
+     */
+    bool IsEnabled() const;
+
+
+    /**
+     *  Starts watching a new transport socket, replacing the previous
+     *  one.  Only UDP sockets are watched; for others, this just stops
+     *  watching the previous socket.
+     *
+     * @param fd  File descriptor of the transport socket
+     */
+    void Attach(const int fd);
+
+
+    /**
+     *  Samples the socket and adapts its buffers.  This is intended to
+     *  be called once per second.
+     *
+     * @return Returns a description of the changes made, for logging.
+     *         Empty if nothing was changed.
+     */
+    std::string Sample();
+
+
+    /**
+     * @return Returns the names of the statistics counters provided by
+     *         GetStatsValues(), as appended to the connection statistics
+     */
+    static const std::vector<std::string>& GetStatsKeys();
+
+
+    /**
+     * @return Returns the statistics counters, in the order of
+     *         GetStatsKeys()
+     */
+    std::vector<uint64_t> GetStatsValues() const;
+
+
+    /**
+     *  Calculates the next buffer size
+     *
+     * @param current  Current buffer size, as reported by the kernel
+     * @param grow     Double the buffer if true, otherwise halve it
+     * @param limits   Limits to keep the new size within
+     *
+     * @return Returns the new buffer size
+     */
+    static unsigned int NextSize(const unsigned int current, const bool grow,
+                                 const Limits& limits);
+
+
+    /// Samples a buffer has to stay below a quarter full before shrinking
+    static const unsigned int ShrinkAfter = 60;
+
+
+private:
+    mutable std::mutex mtx;
+    bool enabled = false;
+    Limits limits;
+    int fd = -1;
+    dev_t dev = 0;
+    ino_t ino = 0;
+
+    uint32_t last_drops = 0;
+    unsigned int rcv_idle = 0;     ///< Samples the receive buffer was mostly empty
+    unsigned int snd_idle = 0;     ///< Samples the send buffer was mostly empty
+    bool rcv_capped = false;       ///< Growing failed due to net.core.rmem_max
+    bool snd_capped = false;       ///< Growing failed due to net.core.wmem_max
+
+    // Statistics
+    uint64_t rcvbuf = 0;
+    uint64_t sndbuf = 0;
+    uint64_t drops = 0;            ///< Receive drops of all watched sockets
+    uint64_t grown = 0;
+    uint64_t shrunk = 0;
+
+    bool same_socket() const;
+    unsigned int resize(const int opt, const unsigned int size);
+};
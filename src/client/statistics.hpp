@@ -25,6 +25,12 @@
 
 #ifndef OPENVPN3_DBUS_CLIENT_STATISTICS
 #define OPENVPN3_DBUS_CLIENT_STATISTICS
+
+#include <string>
+#include <vector>
+
+#include "dbus/glibutils.hpp"
+
 /**
  *  Used to deliver connection statistics for the tunnel to the
  *  user front end.  The full result will be provided as an
@@ -51,4 +57,62 @@ struct ConnectionStatDetails
  */
 typedef std::vector<ConnectionStatDetails> ConnectionStats;
 
+
+/**
+ *  Calculates the identifier of a packed statistics key table.  The
+ *  identifier is a 32-bit FNV-1a hash of all the key names, which gives
+ *  the same identifier for identical tables across sessions and
+ *  processes.  Front-ends can use this to only retrieve the key table
+ *  when it has changed.
+ *
+ * @param keys  std::vector<std::string> of all the statistics keys
+ * @return Returns the identifier of the key table
+ */
+inline uint32_t ConnectionStatsLayoutID(const std::vector<std::string>& keys)
+{
+    uint32_t hash = 2166136261u;
+    for (const auto& k : keys)
+    {
+        // Include the terminating NUL to separate the keys
+        for (size_t i = 0; i <= k.size(); ++i)
+        {
+            hash ^= (uint8_t) k.c_str()[i];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+
+/**
+ *  ConnectionStatDetails are sent over D-Bus as a dictionary entry,
+ *  which makes ConnectionStats a D-Bus a{sx} dictionary
+ */
+namespace GLibUtils
+{
+    template<> struct DBusType<ConnectionStatDetails>
+    {
+        static const char* Signature()
+        {
+            return "{sx}";
+        }
+
+        static GVariant* Create(const ConnectionStatDetails& sd)
+        {
+            return g_variant_new_dict_entry(g_variant_new_string(sd.key.c_str()),
+                                            g_variant_new_int64(sd.value));
+        }
+
+        static ConnectionStatDetails Extract(GVariant *v)
+        {
+            gchar *key = nullptr;
+            gint64 value = 0;
+            g_variant_get(v, "{sx}", &key, &value);
+            ConnectionStatDetails ret(std::string(key), value);
+            g_free(key);
+            return ret;
+        }
+    };
+}
+
 #endif // OPENVPN3_DBUS_CLIENT_STATISTICS
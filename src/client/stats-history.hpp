@@ -0,0 +1,247 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   stats-history.hpp
+ *
+ * @brief  Time series of the key connection statistics counters of a
+ *         VPN session
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ *  Keeps samples of a few key statistics counters in a fixed size ring
+ *  buffer, one sample per second for the last hour by default.  The
+ *  counters are cumulative, so rates are found from the difference
+ *  between two samples.
+ *
+ *  The counters are picked from the packed statistics counters of the
+ *  VPN client, see SetLayout().
+ *
+ *  Not thread-safe.
+ */
+class StatsHistory
+{
+public:
+    /// Number of counters in each sample
+    static const size_t N_KEYS = 6;
+
+    /**
+     *  A time series returned by Get()
+     */
+    struct Series
+    {
+        uint32_t step = 1;                ///< Seconds between samples, at most
+        std::vector<uint64_t> timestamps; ///< Unix time of each sample
+        std::vector<uint64_t> values;     ///< N_KEYS counters per timestamp
+    };
+
+
+    /**
+     * @param capacity  Number of samples to keep
+     */
+    StatsHistory(size_t capacity = 3600)
+        : ring(capacity)
+    {
+    }
+
+
+    /**
+     * @return Returns the names of the counters in each sample.  ERRORS
+     *         is the sum of all the error counters.
+     */
+    static const std::vector<std::string>& Keys()
+    {
+        static const std::vector<std::string> keys = {
+            "BYTES_IN", "BYTES_OUT", "PACKETS_IN", "PACKETS_OUT",
+            "ERRORS", "RECONNECTS"
+        };
+        return keys;
+    }
+
+
+    /**
+     *  Sets the layout of the packed statistics counters passed to
+     *  Add().  Clears the history if it changes.
+     *
+     * @param layout  std::vector<std::string> with the counter names
+     */
+    void SetLayout(const std::vector<std::string>& layout)
+    {
+        if (layout == current_layout)
+        {
+            return;
+        }
+        current_layout = layout;
+        pick.clear();
+        for (size_t i = 0; i < layout.size(); ++i)
+        {
+            const std::string& name = layout[i];
+            if ("BYTES_IN" == name)
+            {
+                pick.push_back({i, 0});
+            }
+            else if ("BYTES_OUT" == name)
+            {
+                pick.push_back({i, 1});
+            }
+            else if ("PACKETS_IN" == name)
+            {
+                pick.push_back({i, 2});
+            }
+            else if ("PACKETS_OUT" == name)
+            {
+                pick.push_back({i, 3});
+            }
+            else if ("N_RECONNECT" == name)
+            {
+                pick.push_back({i, 5});
+            }
+            else if (std::string::npos != name.find("ERROR"))
+            {
+                pick.push_back({i, 4});
+            }
+        }
+        count = 0;
+        head = 0;
+    }
+
+
+    /**
+     *  Records a sample.  A sample with the same timestamp as the
+     *  previous one replaces it.
+     *
+     * @param timestamp  Unix time of the sample
+     * @param values     Packed statistics counters, in the order given
+     *                   to SetLayout()
+     * @param n          Number of values
+     */
+    void Add(uint64_t timestamp, const uint64_t *values, size_t n)
+    {
+        if (ring.empty())
+        {
+            return;
+        }
+
+        Sample s;
+        s.timestamp = timestamp;
+        s.values.fill(0);
+        for (const auto& p : pick)
+        {
+            if (p.from < n)
+            {
+                s.values[p.to] += values[p.from];
+            }
+        }
+
+        if (count > 0 && newest().timestamp == timestamp)
+        {
+            newest() = s;
+            return;
+        }
+        ring[head] = s;
+        head = (head + 1) % ring.size();
+        if (count < ring.size())
+        {
+            ++count;
+        }
+    }
+
+
+    /**
+     *  Retrieves the samples newer than a given time.  With a step
+     *  larger than one second, only the last sample within each step
+     *  is returned.
+     *
+     * @param since  Unix time; only samples taken after it are returned.
+     *               0 returns the complete history.
+     * @param step   Seconds between the returned samples
+     *
+     * @return Returns the Series
+     */
+    Series Get(uint64_t since, uint32_t step) const
+    {
+        Series ret;
+        ret.step = (step > 0 ? step : 1);
+        uint64_t last_bucket = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Sample& s = ring[(head + ring.size() - count + i) % ring.size()];
+            if (s.timestamp <= since)
+            {
+                continue;
+            }
+            const uint64_t bucket = s.timestamp / ret.step;
+            if (!ret.timestamps.empty() && bucket == last_bucket)
+            {
+                ret.timestamps.back() = s.timestamp;
+                std::copy(s.values.begin(), s.values.end(),
+                          ret.values.end() - N_KEYS);
+                continue;
+            }
+            last_bucket = bucket;
+            ret.timestamps.push_back(s.timestamp);
+            ret.values.insert(ret.values.end(), s.values.begin(), s.values.end());
+        }
+        return ret;
+    }
+
+
+    /**
+     * @return Returns the number of samples kept
+     */
+    size_t size() const noexcept
+    {
+        return count;
+    }
+
+
+private:
+    struct Sample
+    {
+        uint64_t timestamp = 0;
+        std::array<uint64_t, N_KEYS> values;
+    };
+
+    struct Pick
+    {
+        size_t from;  ///< Index in the packed statistics counters
+        size_t to;    ///< Index in Sample::values
+    };
+
+    std::vector<Sample> ring;
+    size_t head = 0;
+    size_t count = 0;
+    std::vector<std::string> current_layout;
+    std::vector<Pick> pick;
+
+
+    Sample& newest()
+    {
+        return ring[(head + ring.size() - 1) % ring.size()];
+    }
+};
@@ -0,0 +1,211 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   status-coalescer.hpp
+ *
+ * @brief  Coalesces the transient connection status changes of a VPN
+ *         backend client
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dbus/constants.hpp"
+
+
+/**
+ *  Decides which status changes of a VPN session are sent as
+ *  StatusChange signals right away and which are held back.
+ *
+ *  While connecting and reconnecting, the OpenVPN 3 Core library can
+ *  go through the connecting and reconnecting states many times within
+ *  a short time, and each status change is sent by the backend and
+ *  again by the session manager.  Transient states are therefore only
+ *  sent once per window; a transient state reported within the window
+ *  of the previous one is held back and sent when the window ends,
+ *  unless a later state replaced it.  All other states, like connected,
+ *  disconnected and the failures, are always sent right away, and a
+ *  held back transient state is dropped in favour of them.  The last
+ *  state reported is thus always sent.
+ *
+ *  This class is not thread-safe.
+ */
+class StatusCoalescer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Status
+    {
+        StatusMajor major = StatusMajor::UNSET;
+        StatusMinor minor = StatusMinor::UNSET;
+        std::string message;
+
+        bool operator==(const Status& other) const
+        {
+            return major == other.major && minor == other.minor
+                   && message == other.message;
+        }
+    };
+
+
+    /**
+     * @param window  Minimum time between two transient states being sent
+     */
+    StatusCoalescer(const std::chrono::milliseconds window = std::chrono::milliseconds(250))
+        : window(window)
+    {
+    }
+
+
+    /**
+     *  Sends all states right away when enabled
+     *
+     * @param enable  bool, true disables the coalescing
+     */
+    void SetFullFidelity(const bool enable)
+    {
+        full_fidelity = enable;
+    }
+
+
+    /**
+     * @param minor  StatusMinor to check
+     *
+     * @return Returns true if the state may be held back
+     */
+    static bool IsTransient(const StatusMinor minor)
+    {
+        return StatusMinor::CONN_CONNECTING == minor
+               || StatusMinor::CONN_RECONNECTING == minor
+               || StatusMinor::CONN_RESUMING == minor;
+    }
+
+
+    /**
+     *  Report a new state
+     *
+     * @param st   The new Status
+     * @param now  Current time
+     *
+     * @return Returns the states to send now, in order; empty if the
+     *         new state is held back
+     */
+    std::vector<Status> Add(const Status& st, const Clock::time_point now = Clock::now())
+    {
+        if (full_fidelity || !IsTransient(st.minor))
+        {
+            if (has_pending)
+            {
+                has_pending = false;
+                ++coalesced;
+            }
+            window_end = (IsTransient(st.minor) ? now + window : Clock::time_point());
+            last_sent = st;
+            return {st};
+        }
+
+        if (now >= window_end && !has_pending)
+        {
+            window_end = now + window;
+            last_sent = st;
+            return {st};
+        }
+
+        if (has_pending)
+        {
+            ++coalesced;
+        }
+        pending = st;
+        has_pending = true;
+        return {};
+    }
+
+
+    /**
+     *  Sends a held back state when its window has ended
+     *
+     * @param now  Current time
+     *
+     * @return Returns the states to send now; empty if there are none
+     */
+    std::vector<Status> Flush(const Clock::time_point now = Clock::now())
+    {
+        if (!has_pending || now < window_end)
+        {
+            return {};
+        }
+        has_pending = false;
+        if (pending == last_sent)
+        {
+            // Back in the state the subscribers already know about
+            ++coalesced;
+            return {};
+        }
+        window_end = now + window;
+        last_sent = pending;
+        return {pending};
+    }
+
+
+    /**
+     * @return Returns true if a state is held back
+     */
+    bool HasPending() const
+    {
+        return has_pending;
+    }
+
+
+    /**
+     * @return Returns the time until the held back state is due
+     */
+    std::chrono::milliseconds GetFlushDelay(const Clock::time_point now = Clock::now()) const
+    {
+        if (now >= window_end)
+        {
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::duration_cast<std::chrono::milliseconds>(window_end - now)
+               + std::chrono::milliseconds(1);
+    }
+
+
+    /**
+     * @return Returns the number of states which were not sent
+     */
+    uint64_t GetCoalesced() const
+    {
+        return coalesced;
+    }
+
+
+private:
+    const std::chrono::milliseconds window;
+    bool full_fidelity = false;
+    Clock::time_point window_end;
+    Status last_sent;
+    Status pending;
+    bool has_pending = false;
+    uint64_t coalesced = 0;
+};
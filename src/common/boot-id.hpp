@@ -0,0 +1,47 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   boot-id.hpp
+ *
+ * @brief  Identifies the current boot of the host
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+
+
+/**
+ *  State recorded by a service to be picked up again after a restart is
+ *  only valid until the host reboots; process IDs, bus names and network
+ *  devices are not the same afterwards.  Such state is tagged with the
+ *  boot ID, which the kernel generates randomly at each boot.
+ *
+ * @return Returns the boot ID provided by the kernel.  Empty if not
+ *         available.
+ */
+inline std::string get_boot_id()
+{
+    std::ifstream f("/proc/sys/kernel/random/boot_id");
+    std::string id;
+    std::getline(f, id);
+    return id;
+}
@@ -85,6 +85,9 @@ Commands::ShellCompletion::ShellCompletion()
               "List all available options for a specific command");
     AddOption("arg-helper", "OPTION", true,
               "Used together with --list-options, lists value hint to an option");
+    AddOption("generate-data",
+              "Generate static command and option completion data for the "
+              "bash completion script");
 }
 
 /**
@@ -133,6 +136,12 @@ int Commands::ShellCompletion::RunCommand(const std::string arg0, unsigned int i
                                    "--arg-helper requires --list-options");
         }
 
+        if (args->Present("generate-data"))
+        {
+            generate_data(simple_basename(arg0));
+            return 0;
+        }
+
         if (args->Present("list-commands"))
         {
             list_commands();
@@ -203,6 +212,42 @@ void Commands::ShellCompletion::list_options(const std::string cmd)
 }
 
 
+/**
+ *  Generate bash associative array assignments with all the commands
+ *  and their options.  The bash completion script uses this data instead
+ *  of running --list-commands and --list-options on each completion.
+ *
+ * @param prog  std::string with the program name the data is valid for
+ */
+void Commands::ShellCompletion::generate_data(const std::string prog)
+{
+    std::stringstream cmds;
+    std::stringstream opts;
+    for (auto const& c : commands->GetAllCommandObjects())
+    {
+        if (c->GetCommand() == GetCommand())
+        {
+            // Skip myself
+            continue;
+        }
+        cmds << (cmds.tellp() > 0 ? " " : "") << c->GetCommand();
+
+        std::string optlist = c->GetOptionsList();
+        opts << "_openvpn3_completion_options[" << prog << ":"
+             << c->GetCommand() << "]=\"" << optlist << "\"" << std::endl;
+        if (!c->GetAliasCommand().empty())
+        {
+            opts << "_openvpn3_completion_options[" << prog << ":"
+                 << c->GetAliasCommand() << "]=\"" << optlist << "\""
+                 << std::endl;
+        }
+    }
+    std::cout << "_openvpn3_completion_commands[" << prog << "]=\""
+              << cmds.str() << "\"" << std::endl
+              << opts.str();
+}
+
+
 void Commands::ShellCompletion::call_arg_helper(const std::string cmd, const std::string option)
 {
     for (auto const& c : commands->GetAllCommandObjects())
@@ -989,6 +989,17 @@ private:
          */
         void list_options(const std::string cmd);
 
+        /**
+         *  Generate static completion data for all commands and their
+         *  options, as bash associative array assignments.  This is used
+         *  at build time to generate the bash completion script.  The
+         *  result is written straight to stdout.
+         *
+         * @param prog  std::string containing the program name the data
+         *              is generated for
+         */
+        void generate_data(const std::string prog);
+
         /**
          *  The argument helper callback function generates a list of possible
          *  values to use for a specific option in a specific command.
@@ -26,11 +26,13 @@
 
 #include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "common/configfileparser.hpp"
+#include "common/json-io.hpp"
 
 #ifdef OPENVPN_DEBUG
 #include <iostream>
@@ -132,15 +134,11 @@ void File::Load(const std::string& cfgfile)
     }
 
     // Read the configuration file
-    std::string line;
-    std::stringstream buf;
-    while (std::getline(cfgs, line))
-    {
-        buf << line << std::endl;
-    }
+    std::string content((std::istreambuf_iterator<char>(cfgs)),
+                        std::istreambuf_iterator<char>());
 
     // Don't try to parse an empty file
-    if (0 == buf.tellp())
+    if (content.empty())
     {
         return;
     }
@@ -149,9 +147,14 @@ void File::Load(const std::string& cfgfile)
     Json::Value jcfg;
     try
     {
-        buf >> jcfg;
+        jcfg = JsonIO::Parse(content);
         Parse(jcfg);
     }
+    catch (const JsonIOException& excp)
+    {
+        throw ConfigFileException(fname, "Error parsing file:"
+                                  + std::string(excp.what()));
+    }
     catch (const Json::Exception& excp)
     {
         throw ConfigFileException(fname, "Error parsing file:"
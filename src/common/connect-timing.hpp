@@ -0,0 +1,225 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   connect-timing.hpp
+ *
+ * @brief  Records when a VPN session passes the various phases of
+ *         establishing a tunnel
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+
+
+/**
+ *  Ordered list of connect phase milestones with CLOCK_MONOTONIC
+ *  timestamps in microseconds.  The monotonic clock is system wide,
+ *  so milestones recorded by different processes can be merged and
+ *  compared directly.
+ *
+ *  Only the first time a phase is reached is recorded; reconnects do
+ *  not move the milestones unless ResetAfter() removes them.  All methods are
+ *  thread-safe.
+ */
+class ConnectTiming
+{
+public:
+    using Milestone = std::pair<std::string, uint64_t>;
+
+
+    /**
+     *  Current CLOCK_MONOTONIC time in microseconds
+     */
+    static uint64_t Now() noexcept
+    {
+        struct timespec ts = {};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+
+    /**
+     *  Record a phase milestone, if the phase has not been reached before
+     *
+     * @param phase  std::string with the phase name
+     * @param ts     Monotonic timestamp in microseconds; 0 for now
+     */
+    void Mark(const std::string& phase, const uint64_t ts = 0)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        for (const auto& m : milestones)
+        {
+            if (m.first == phase)
+            {
+                return;
+            }
+        }
+        milestones.emplace_back(phase, (ts ? ts : Now()));
+    }
+
+
+    /**
+     *  Check if a phase milestone has been recorded
+     */
+    bool Reached(const std::string& phase) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        for (const auto& m : milestones)
+        {
+            if (m.first == phase)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    /**
+     *  Removes all milestones recorded after a phase, keeping the phase
+     *  itself and everything before it.  Used when a connection attempt
+     *  is restarted.
+     */
+    void ResetAfter(const std::string& phase)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        for (auto it = milestones.begin(); it != milestones.end(); ++it)
+        {
+            if (it->first == phase)
+            {
+                milestones.erase(it + 1, milestones.end());
+                return;
+            }
+        }
+    }
+
+
+    /**
+     *  Add the milestones from a GVariant produced by GetGVariant().
+     *  Milestones are kept sorted by their timestamps.
+     */
+    void Merge(GVariant *timing)
+    {
+        if (!timing || !g_variant_is_of_type(timing, G_VARIANT_TYPE("a(st)")))
+        {
+            return;
+        }
+        GVariantIter iter;
+        g_variant_iter_init(&iter, timing);
+        const gchar *phase = nullptr;
+        guint64 ts = 0;
+        while (g_variant_iter_next(&iter, "(&st)", &phase, &ts))
+        {
+            Mark(phase, ts);
+        }
+
+        std::lock_guard<std::mutex> guard(mtx);
+        std::stable_sort(milestones.begin(), milestones.end(),
+                         [](const Milestone& a, const Milestone& b)
+                         {
+                             return a.second < b.second;
+                         });
+    }
+
+
+    /**
+     *  Retrieve all milestones as a GVariant a(st) array of
+     *  (phase, monotonic timestamp in microseconds)
+     */
+    GVariant * GetGVariant() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        GVariantBuilder bld;
+        g_variant_builder_init(&bld, G_VARIANT_TYPE("a(st)"));
+        for (const auto& m : milestones)
+        {
+            g_variant_builder_add(&bld, "(st)", m.first.c_str(),
+                                  (guint64) m.second);
+        }
+        return g_variant_builder_end(&bld);
+    }
+
+
+    /**
+     *  Retrieve the milestones as offsets from the first milestone.
+     *
+     * @return Returns a GVariant a{st} dictionary of phase name and
+     *         microseconds since the first milestone
+     */
+    GVariant * GetRelativeGVariant() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        GVariantBuilder bld;
+        g_variant_builder_init(&bld, G_VARIANT_TYPE("a{st}"));
+        for (const auto& m : milestones)
+        {
+            g_variant_builder_add(&bld, "{st}", m.first.c_str(),
+                                  (guint64) (m.second - milestones[0].second));
+        }
+        return g_variant_builder_end(&bld);
+    }
+
+
+    /**
+     *  Summary suitable for a log line: each phase with the milliseconds
+     *  spent since the previous milestone, followed by the total.
+     */
+    std::string str() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        std::stringstream r;
+        r.setf(std::ios::fixed);
+        r.precision(1);
+        uint64_t prev = (milestones.empty() ? 0 : milestones[0].second);
+        for (const auto& m : milestones)
+        {
+            r << m.first << "=+" << ((m.second - prev) / 1000.0) << "ms ";
+            prev = m.second;
+        }
+        r << "total="
+          << (milestones.empty() ? 0.0
+                                 : (milestones.back().second
+                                    - milestones[0].second) / 1000.0)
+          << "ms";
+        return r.str();
+    }
+
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return milestones.empty();
+    }
+
+
+private:
+    mutable std::mutex mtx;
+    std::vector<Milestone> milestones;
+};
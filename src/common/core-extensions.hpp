@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <json/json.h>
 #include <openvpn/client/cliconstants.hpp>
@@ -26,52 +28,113 @@
 #include <openvpn/options/merge.hpp>
 
 namespace openvpn {
-    inline bool optparser_inline_file(std::string optname)
+    /**
+     *  FNV-1a hash of an option name.  Being constexpr, it is also used
+     *  to compute the hashes of the known option names at compile time.
+     */
+    constexpr uint32_t optname_hash(const char *name, uint32_t h = 2166136261u)
     {
-        return ((optname == "ca")
-                || (optname == "key")
-                || (optname == "extra-certs")
-                || (optname == "cert")
-                || (optname == "auth-user-pass")
-                || (optname == "http-proxy-user-pass")
-                || (optname == "dh")
-                || (optname == "pkcs12")
-                || (optname == "tls-auth")
-                || (optname == "tls-crypt")
-                || (optname == "tls-crypt-v2")) ? true : false;
+        return ('\0' == *name)
+               ? h
+               : optname_hash(name + 1,
+                              (h ^ static_cast<unsigned char>(*name)) * 16777619u);
     }
 
-    inline bool option_req_array(const std::string& optname)
+
+    /// Option carries the content of a file, which can be inlined
+    constexpr unsigned int OPTCLASS_INLINE_FILE = 0x01;
+
+    /// Option may be present several times in a profile
+    constexpr unsigned int OPTCLASS_MULTIPLE = 0x02;
+
+
+    /**
+     *  Classifies an option name, with a single hash computation and
+     *  at most one string comparison.  The hashes of the known names are
+     *  computed at compile time; any hash collision between them is
+     *  caught by the compiler as a duplicate case value.
+     *
+     * @param optname  std::string with the option name
+     *
+     * @return Returns a bitmask of OPTCLASS_* flags, 0 for other options
+     */
+    inline unsigned int option_classify(const std::string& optname)
+    {
+        const char *n = optname.c_str();
+        switch (optname_hash(n))
+        {
+        case optname_hash("ca"):
+            return ("ca" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("key"):
+            return ("key" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("extra-certs"):
+            return ("extra-certs" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("cert"):
+            return ("cert" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("auth-user-pass"):
+            return ("auth-user-pass" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("http-proxy-user-pass"):
+            return ("http-proxy-user-pass" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("dh"):
+            return ("dh" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("pkcs12"):
+            return ("pkcs12" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("tls-auth"):
+            return ("tls-auth" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("tls-crypt"):
+            return ("tls-crypt" == optname) ? OPTCLASS_INLINE_FILE : 0;
+        case optname_hash("tls-crypt-v2"):
+            return ("tls-crypt-v2" == optname) ? OPTCLASS_INLINE_FILE : 0;
+
+        case optname_hash("peer-fingerprint"):
+            return ("peer-fingerprint" == optname) ? OPTCLASS_MULTIPLE : 0;
+        case optname_hash("pull-filter"):
+            return ("pull-filter" == optname) ? OPTCLASS_MULTIPLE : 0;
+        case optname_hash("remote"):
+            return ("remote" == optname) ? OPTCLASS_MULTIPLE : 0;
+        case optname_hash("route"):
+            return ("route" == optname) ? OPTCLASS_MULTIPLE : 0;
+        case optname_hash("route-ipv6"):
+            return ("route-ipv6" == optname) ? OPTCLASS_MULTIPLE : 0;
+
+        default:
+            return 0;
+        }
+    }
+
+
+    inline bool optparser_inline_file(const std::string& optname)
     {
-        return (("peer-fingerprint" == optname)
-                || ("pull-filter" == optname)
-                || ("remote" == optname)
-                || ("route" == optname)
-                || ("route-ipv6" == optname)
-               ) ? true : false;
+        return (option_classify(optname) & OPTCLASS_INLINE_FILE) != 0;
     }
 
-    inline std::string optparser_mkline(std::string optname, std::string optvalue)
+    inline bool option_req_array(const std::string& optname)
     {
-        bool inlined_file = optparser_inline_file(optname);
-        std::stringstream ret;
+        return (option_classify(optname) & OPTCLASS_MULTIPLE) != 0;
+    }
 
-        if (inlined_file && !optvalue.empty())
+    inline std::string optparser_mkline(const std::string& optname,
+                                        const std::string& optvalue)
+    {
+        std::string ret;
+        if (optparser_inline_file(optname) && !optvalue.empty())
         {
-            ret << "<" << optname << ">" << std::endl
-                << optvalue;
+            // <optname>\n  optvalue  [\n]  </optname>\n
+            ret.reserve(2 * optname.size() + optvalue.size() + 7);
+            ret.append("<").append(optname).append(">\n");
+            ret.append(optvalue);
             if ('\n' != optvalue.back())
             {
-                ret << std::endl;
+                ret.push_back('\n');
             }
-            ret << "</" << optname << ">"
-                << std::endl;
+            ret.append("</").append(optname).append(">\n");
         }
         else
         {
-            ret << optname << " " << optvalue << std::endl;
+            ret.reserve(optname.size() + optvalue.size() + 2);
+            ret.append(optname).append(" ").append(optvalue).append("\n");
         }
-        return ret.str();
+        return ret;
     }
 
     /**
@@ -147,10 +210,11 @@ namespace openvpn {
             // std::vector<Option>, which is why we access the std::vector
             // via *this.
             for(const auto& element : *this) {
-                std::string optname(element.ref(0));
+                const std::string& optname = element.ref(0);
+                const unsigned int optclass = option_classify(optname);
 
                 Json::Value optval{};
-                if (optparser_inline_file(optname))
+                if (optclass & OPTCLASS_INLINE_FILE)
                 {
                     // Inlined files needs to be rendered via the
                     // Option::render() method.  We remove the option name
@@ -172,7 +236,7 @@ namespace openvpn {
                     }
                 }
 
-                if (!option_req_array(optname))
+                if (!(optclass & OPTCLASS_MULTIPLE))
                 {
                     // For options only expected to be used once, they get
                     // the value array directly.  This is format 3a) as
@@ -268,8 +332,6 @@ namespace openvpn {
 
         std::string string_export()
         {
-            std::stringstream cfgstr;
-
             // FIXME: Hackish workaround for OpenVPN Access Server
             //        configured to do web authentication.  This is
             //        only needed until OpenVPN 3 Core library gets
@@ -279,7 +341,7 @@ namespace openvpn {
             //        The list of options here are more to be considered
             //        wildcard matches
             //
-            std::vector<std::string> ignore_as_options = {
+            static const char *ignore_as_options[] = {
                 "CLI_PREF_",
                 "WSHOST",
                 "WEB_CA",
@@ -287,24 +349,39 @@ namespace openvpn {
             };
 
             // These options will be prefixed with "setenv opt"
-            std::vector<std::string> rewrite_as_options = {
+            static const char *rewrite_as_options[] = {
                 "USERNAME",
                 "PROFILE"
             };
 
+            // Reserve the output buffer up front.  Each option value is
+            // at least as long as in the result, plus some extra space
+            // for separators, quoting and inline file tags.
+            size_t estimate = 0;
+            for (const auto& element : *this)
+            {
+                for (size_t i = 0; i < element.size(); ++i)
+                {
+                    estimate += element.ref(i).size() + 3;
+                }
+                estimate += 8;
+            }
+            std::string cfgstr;
+            cfgstr.reserve(estimate + estimate / 8);
+
             // Iterate all the std::vector<Option> objects
             // OptionListJSON inherits OptionList which again inherits
             // std::vector<Option>, which is why we access the std::vector
             // via *this.
             for(const auto& element : *this)
             {
-                std::string optname = element.ref(0);
+                const std::string& optname = element.ref(0);
 
                 // FIXME: Access Server hack
                 bool as_skip = false;
-                for (const auto &chk : ignore_as_options)
+                for (const char *chk : ignore_as_options)
                 {
-                    if (optname.find(chk) == 0)
+                    if (optname.compare(0, strlen(chk), chk) == 0)
                     {
                         as_skip = true;
                         break;
@@ -316,9 +393,9 @@ namespace openvpn {
                 }
 
                 bool setenv_rewrite = false;
-                for (const auto &chk : rewrite_as_options)
+                for (const char *chk : rewrite_as_options)
                 {
-                    if (optname.find(chk) == 0)
+                    if (optname.compare(0, strlen(chk), chk) == 0)
                     {
                         setenv_rewrite = true;
                         break;
@@ -329,22 +406,25 @@ namespace openvpn {
                 // multiple lines.  Just retrieve the raw data directly here.
                 if (optparser_inline_file(optname) && element.size() > 1)
                 {
-                    cfgstr << optparser_mkline(optname, element.ref(1)) << std::endl;
+                    cfgstr.append(optparser_mkline(optname, element.ref(1)));
+                    cfgstr.push_back('\n');
                 }
                 else if (setenv_rewrite)
                 {
-                    cfgstr << "setenv opt " << element.escape(false) << std::endl;
+                    cfgstr.append("setenv opt ").append(element.escape(false));
+                    cfgstr.push_back('\n');
                 }
                 else
                 {
                     // For everything else, we use the Option::escape() method
                     // to render the output we need for the string export of the
                     // profile.
-                    cfgstr << element.escape(false) << std::endl;
+                    cfgstr.append(element.escape(false));
+                    cfgstr.push_back('\n');
                 }
             }
 
-            return cfgstr.str();
+            return cfgstr;
         }
 
     private:
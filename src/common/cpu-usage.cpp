@@ -0,0 +1,219 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   cpu-usage.cpp
+ *
+ * @brief  CPU time and scheduling counters of a process or a thread
+ *         (implementation)
+ */
+
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "cpu-usage.hpp"
+
+
+static uint64_t timeval_usec(const struct timeval& tv)
+{
+    return (uint64_t) tv.tv_sec * 1000000 + (uint64_t) tv.tv_usec;
+}
+
+
+static CpuUsage from_rusage(const int who)
+{
+    CpuUsage u;
+    struct rusage ru = {};
+    if (0 == getrusage(who, &ru))
+    {
+        u.user_usec = timeval_usec(ru.ru_utime);
+        u.system_usec = timeval_usec(ru.ru_stime);
+        u.voluntary_ctxsw = (uint64_t) ru.ru_nvcsw;
+        u.involuntary_ctxsw = (uint64_t) ru.ru_nivcsw;
+    }
+    return u;
+}
+
+
+static uint64_t read_runqueue_wait(const std::string& path)
+{
+    std::ifstream f(path);
+    std::string line;
+    std::getline(f, line);
+    return CpuUsage::ParseRunqueueWait(line);
+}
+
+
+CpuUsage CpuUsage::Process()
+{
+    CpuUsage u = from_rusage(RUSAGE_SELF);
+
+    DIR *tasks = opendir("/proc/self/task");
+    if (nullptr == tasks)
+    {
+        return u;
+    }
+    struct dirent *entry = nullptr;
+    while (nullptr != (entry = readdir(tasks)))
+    {
+        if ('.' == entry->d_name[0])
+        {
+            continue;
+        }
+        u.runqueue_wait_usec += read_runqueue_wait(std::string("/proc/self/task/")
+                                                   + entry->d_name
+                                                   + "/schedstat");
+    }
+    closedir(tasks);
+    return u;
+}
+
+
+CpuUsage CpuUsage::Thread()
+{
+    CpuUsage u = from_rusage(RUSAGE_THREAD);
+    u.runqueue_wait_usec = read_runqueue_wait("/proc/thread-self/schedstat");
+    return u;
+}
+
+
+CpuUsage CpuUsage::Task(const pid_t tid)
+{
+    CpuUsage u;
+    const std::string dir = "/proc/self/task/" + std::to_string(tid) + "/";
+
+    std::ifstream stat(dir + "stat");
+    std::string line;
+    if (!std::getline(stat, line)
+        || !ParseTaskStat(line, sysconf(_SC_CLK_TCK), u))
+    {
+        return CpuUsage();
+    }
+
+    std::ifstream status(dir + "status");
+    std::stringstream contents;
+    contents << status.rdbuf();
+    ParseTaskStatus(contents.str(), u);
+
+    u.runqueue_wait_usec = read_runqueue_wait(dir + "schedstat");
+    return u;
+}
+
+
+bool CpuUsage::ParseTaskStat(const std::string& stat, const long clk_tck,
+                             CpuUsage& u)
+{
+    // The command name may contain spaces and parentheses; the fields
+    // are counted from the last ')'
+    const auto end_comm = stat.rfind(')');
+    if (std::string::npos == end_comm || clk_tck <= 0)
+    {
+        return false;
+    }
+    std::istringstream s(stat.substr(end_comm + 1));
+    std::string field;
+    for (int i = 3; i < 14; ++i)
+    {
+        if (!(s >> field))
+        {
+            return false;
+        }
+    }
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    if (!(s >> utime >> stime))
+    {
+        return false;
+    }
+    u.user_usec = utime * 1000000 / (uint64_t) clk_tck;
+    u.system_usec = stime * 1000000 / (uint64_t) clk_tck;
+    return true;
+}
+
+
+void CpuUsage::ParseTaskStatus(const std::string& status, CpuUsage& u)
+{
+    std::istringstream s(status);
+    std::string line;
+    while (std::getline(s, line))
+    {
+        std::istringstream l(line);
+        std::string key;
+        uint64_t value = 0;
+        if (!(l >> key >> value))
+        {
+            continue;
+        }
+        if ("voluntary_ctxt_switches:" == key)
+        {
+            u.voluntary_ctxsw = value;
+        }
+        else if ("nonvoluntary_ctxt_switches:" == key)
+        {
+            u.involuntary_ctxsw = value;
+        }
+    }
+}
+
+
+uint64_t CpuUsage::ParseRunqueueWait(const std::string& schedstat)
+{
+    std::istringstream s(schedstat);
+    uint64_t run_nsec = 0;
+    uint64_t wait_nsec = 0;
+    if (!(s >> run_nsec >> wait_nsec))
+    {
+        return 0;
+    }
+    return wait_nsec / 1000;
+}
+
+
+uint64_t CpuUsage::UsecPerGB(const uint64_t bytes) const
+{
+    if (0 == bytes)
+    {
+        return 0;
+    }
+    // Calculated in floating point, the product easily overflows
+    return (uint64_t) ((double) (user_usec + system_usec)
+                       * (1024.0 * 1024.0 * 1024.0) / (double) bytes);
+}
+
+
+std::vector<std::string> CpuUsage::GetStatsKeys(const std::string& prefix)
+{
+    return {
+        prefix + "CPU_USER_USEC",
+        prefix + "CPU_SYSTEM_USEC",
+        prefix + "CPU_CTXSW_VOLUNTARY",
+        prefix + "CPU_CTXSW_INVOLUNTARY",
+        prefix + "CPU_RUNQ_WAIT_USEC"
+    };
+}
+
+
+std::vector<uint64_t> CpuUsage::GetStatsValues() const
+{
+    return {user_usec, system_usec, voluntary_ctxsw, involuntary_ctxsw,
+            runqueue_wait_usec};
+}
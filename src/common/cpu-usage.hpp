@@ -0,0 +1,141 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   cpu-usage.hpp
+ *
+ * @brief  CPU time and scheduling counters of a process or a thread
+ *         (declaration)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+
+/**
+ *  CPU time used by a process or a thread and how it was scheduled.
+ *  The times and context switches come from getrusage(2), the run-queue
+ *  latency from the schedstat files in /proc, which are only available
+ *  with CONFIG_SCHEDSTATS and otherwise reported as 0.
+ */
+struct CpuUsage
+{
+    uint64_t user_usec = 0;           ///< CPU time in user space
+    uint64_t system_usec = 0;         ///< CPU time in the kernel
+    uint64_t voluntary_ctxsw = 0;     ///< Waits for I/O, locks or timers
+    uint64_t involuntary_ctxsw = 0;   ///< Preempted by other tasks
+    uint64_t runqueue_wait_usec = 0;  ///< Time runnable, waiting for a CPU
+
+
+    /**
+     *  Sample the counters of the calling process.  The run-queue
+     *  latency only covers the threads still running.
+     *
+     * @return Returns a CpuUsage with the counters
+     */
+    static CpuUsage Process();
+
+
+    /**
+     *  Sample the counters of the calling thread
+     *
+     * @return Returns a CpuUsage with the counters
+     */
+    static CpuUsage Thread();
+
+
+    /**
+     *  Sample the counters of another thread of the calling process,
+     *  via /proc/self/task.  The CPU times have the resolution of the
+     *  kernel clock tick.
+     *
+     * @param tid  Thread ID, as returned by gettid(2), of the thread
+     *
+     * @return Returns a CpuUsage with the counters, all 0 if the thread
+     *         has exited
+     */
+    static CpuUsage Task(const pid_t tid);
+
+
+    /**
+     *  Parse the user and system time from a /proc stat file
+     *
+     * @param stat     std::string with the contents of the file
+     * @param clk_tck  Clock ticks per second the times are counted in
+     * @param u        CpuUsage to update
+     *
+     * @return Returns true if the times could be parsed
+     */
+    static bool ParseTaskStat(const std::string& stat, const long clk_tck,
+                              CpuUsage& u);
+
+
+    /**
+     *  Parse the context switches from a /proc status file
+     *
+     * @param status  std::string with the contents of the file
+     * @param u       CpuUsage to update
+     */
+    static void ParseTaskStatus(const std::string& status, CpuUsage& u);
+
+
+    /**
+     *  Parse the run-queue latency from a /proc schedstat file
+     *
+     * @param schedstat  std::string with the contents of the file; the
+     *                   time on the CPU, the time waiting on a run-queue,
+     *                   both in nanoseconds, and the number of timeslices
+     *
+     * @return Returns the run-queue latency in microseconds, 0 if the
+     *         contents could not be parsed
+     */
+    static uint64_t ParseRunqueueWait(const std::string& schedstat);
+
+
+    /**
+     *  Calculate the CPU time used per GiB of traffic
+     *
+     * @param bytes  Traffic handled while using this CPU time
+     *
+     * @return Returns the user and system time per GiB in microseconds,
+     *         0 if there has been no traffic
+     */
+    uint64_t UsecPerGB(const uint64_t bytes) const;
+
+
+    /**
+     *  Retrieve the names of the counters as used in the connection
+     *  statistics, in the order of GetStatsValues()
+     *
+     * @param prefix  std::string to put in front of all the names
+     *
+     * @return Returns a std::vector<std::string> with the counter names
+     */
+    static std::vector<std::string> GetStatsKeys(const std::string& prefix = "");
+
+
+    /**
+     * @return Returns the counters, in the order of GetStatsKeys()
+     */
+    std::vector<uint64_t> GetStatsValues() const;
+};
@@ -0,0 +1,160 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   idset.hpp
+ *
+ * @brief  Set of numeric ids (uids, gids) used by access control lists
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+
+/**
+ *  A set of numeric ids which keeps the order the ids were added in.
+ *
+ *  Most access control lists only hold a few ids, which are found
+ *  faster by scanning the list than by hashing.  Once the list grows
+ *  beyond SmallLimit ids, a hash set is kept as well, so look-ups in
+ *  large lists do not depend on the number of ids.
+ */
+template <typename T>
+class IdSet
+{
+public:
+    /// Lists up to this size are only searched linearly
+    static const size_t SmallLimit = 8;
+
+
+    /**
+     *  Adds an id to the set
+     *
+     * @param id  Id to add
+     * @return Returns false if the id was already present
+     */
+    bool Add(const T id)
+    {
+        if (Contains(id))
+        {
+            return false;
+        }
+        ids.push_back(id);
+        if (!hashed.empty())
+        {
+            hashed.insert(id);
+        }
+        else if (ids.size() > SmallLimit)
+        {
+            hashed.insert(ids.begin(), ids.end());
+        }
+        return true;
+    }
+
+
+    /**
+     *  Removes an id from the set
+     *
+     * @param id  Id to remove
+     * @return Returns false if the id was not present
+     */
+    bool Remove(const T id)
+    {
+        auto it = std::find(ids.begin(), ids.end(), id);
+        if (ids.end() == it)
+        {
+            return false;
+        }
+        ids.erase(it);
+        if (ids.size() > SmallLimit)
+        {
+            hashed.erase(id);
+        }
+        else
+        {
+            hashed.clear();
+        }
+        return true;
+    }
+
+
+    /**
+     *  Checks if an id is in the set
+     *
+     * @param id  Id to look for
+     * @return Returns true if the id is present
+     */
+    bool Contains(const T id) const
+    {
+        if (hashed.empty())
+        {
+            return std::find(ids.begin(), ids.end(), id) != ids.end();
+        }
+        return hashed.count(id) > 0;
+    }
+
+
+    /**
+     *  Checks if any of the given ids is in the set
+     *
+     * @param candidates  std::vector of the ids to look for
+     * @return Returns true if at least one of the ids is present
+     */
+    bool ContainsAny(const std::vector<T>& candidates) const
+    {
+        for (const auto& c : candidates)
+        {
+            if (Contains(c))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    /**
+     * @return Returns a std::vector with all the ids, in the order they
+     *         were added
+     */
+    const std::vector<T>& List() const noexcept
+    {
+        return ids;
+    }
+
+
+    size_t size() const noexcept
+    {
+        return ids.size();
+    }
+
+
+    bool empty() const noexcept
+    {
+        return ids.empty();
+    }
+
+
+private:
+    std::vector<T> ids;
+    std::unordered_set<T> hashed;
+};
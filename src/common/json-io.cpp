@@ -0,0 +1,942 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+/**
+ * @file   json-io.cpp
+ *
+ * @brief  Fast reading and writing of JSON documents into and from
+ *         jsoncpp Json::Value objects (implementation)
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "common/json-io.hpp"
+
+
+namespace
+{
+    /**
+     *  Find the next '"' or '\\' in a JSON string
+     *
+     * @return Returns a pointer to the character found, or end
+     */
+    inline const char *scan_string(const char *p, const char *end)
+    {
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i bslash = _mm_set1_epi8('\\');
+        while (end - p >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                      _mm_cmpeq_epi8(chunk, bslash)));
+            if (0 != mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && '"' != *p && '\\' != *p)
+        {
+            ++p;
+        }
+        return p;
+    }
+
+
+    /**
+     *  Recursive descent JSON parser filling a Json::Value tree.  It
+     *  accepts the same syntax as the default jsoncpp reader settings,
+     *  except for a few lenient corner cases jsoncpp accepts; those
+     *  documents are rejected and parsed by jsoncpp instead.
+     */
+    class FastReader
+    {
+    public:
+        FastReader(const char *begin, const char *end)
+            : p(begin), end(end)
+        {
+        }
+
+
+        /**
+         * @return Returns false if the document was not accepted
+         */
+        bool Parse(Json::Value& root)
+        {
+            return value(root) && skip_ws() && p == end;
+        }
+
+
+    private:
+        /// Same nesting limit as the jsoncpp reader
+        static const unsigned int max_depth = 1000;
+
+        const char *p;
+        const char *end;
+        unsigned int depth = 0;
+        std::string scratch;
+        std::string key;
+
+
+        /**
+         *  Skips whitespace and comments
+         *
+         * @return Returns false on an unterminated comment
+         */
+        bool skip_ws()
+        {
+            while (p < end)
+            {
+                char c = *p;
+                if (' ' == c || '\n' == c || '\t' == c || '\r' == c)
+                {
+                    ++p;
+                }
+                else if ('/' == c && p + 1 < end && '/' == p[1])
+                {
+                    p += 2;
+                    while (p < end && '\n' != *p)
+                    {
+                        ++p;
+                    }
+                }
+                else if ('/' == c && p + 1 < end && '*' == p[1])
+                {
+                    const char *e = p + 2;
+                    while (e + 1 < end && !('*' == e[0] && '/' == e[1]))
+                    {
+                        ++e;
+                    }
+                    if (e + 1 >= end)
+                    {
+                        return false;
+                    }
+                    p = e + 2;
+                }
+                else
+                {
+                    break;
+                }
+            }
+            return true;
+        }
+
+
+        bool value(Json::Value& out)
+        {
+            if (!skip_ws() || p >= end)
+            {
+                return false;
+            }
+            switch (*p)
+            {
+            case '{':
+                return object(out);
+
+            case '[':
+                return array(out);
+
+            case '"':
+                {
+                    const char *b = nullptr;
+                    const char *e = nullptr;
+                    if (!string(b, e))
+                    {
+                        return false;
+                    }
+                    out = Json::Value(b, e);
+                    return true;
+                }
+
+            case 't':
+                if (!literal("true", 4))
+                {
+                    return false;
+                }
+                out = true;
+                return true;
+
+            case 'f':
+                if (!literal("false", 5))
+                {
+                    return false;
+                }
+                out = false;
+                return true;
+
+            case 'n':
+                if (!literal("null", 4))
+                {
+                    return false;
+                }
+                out = Json::Value();
+                return true;
+
+            default:
+                return number(out);
+            }
+        }
+
+
+        bool object(Json::Value& out)
+        {
+            if (++depth > max_depth)
+            {
+                return false;
+            }
+            ++p;
+            out = Json::Value(Json::objectValue);
+            if (!skip_ws() || p >= end)
+            {
+                return false;
+            }
+            if ('}' != *p)
+            {
+                while (true)
+                {
+                    if (!skip_ws() || p >= end || '"' != *p)
+                    {
+                        return false;
+                    }
+                    const char *b = nullptr;
+                    const char *e = nullptr;
+                    if (!string(b, e))
+                    {
+                        return false;
+                    }
+                    key.assign(b, e);
+                    if (!skip_ws() || p >= end || ':' != *p)
+                    {
+                        return false;
+                    }
+                    ++p;
+                    if (!value(out[key]) || !skip_ws() || p >= end)
+                    {
+                        return false;
+                    }
+                    if ('}' == *p)
+                    {
+                        break;
+                    }
+                    if (',' != *p)
+                    {
+                        return false;
+                    }
+                    ++p;
+                    // jsoncpp accepts a trailing comma
+                    if (!skip_ws() || p >= end)
+                    {
+                        return false;
+                    }
+                    if ('}' == *p)
+                    {
+                        break;
+                    }
+                }
+            }
+            ++p;
+            --depth;
+            return true;
+        }
+
+
+        bool array(Json::Value& out)
+        {
+            if (++depth > max_depth)
+            {
+                return false;
+            }
+            ++p;
+            out = Json::Value(Json::arrayValue);
+            if (!skip_ws() || p >= end)
+            {
+                return false;
+            }
+            if (']' != *p)
+            {
+                Json::ArrayIndex idx = 0;
+                while (true)
+                {
+                    if (!value(out[idx++]) || !skip_ws() || p >= end)
+                    {
+                        return false;
+                    }
+                    if (']' == *p)
+                    {
+                        break;
+                    }
+                    if (',' != *p)
+                    {
+                        return false;
+                    }
+                    ++p;
+                    // jsoncpp accepts a trailing comma
+                    if (!skip_ws() || p >= end)
+                    {
+                        return false;
+                    }
+                    if (']' == *p)
+                    {
+                        break;
+                    }
+                }
+            }
+            ++p;
+            --depth;
+            return true;
+        }
+
+
+        /**
+         *  Parses a string.  Strings without escape sequences are
+         *  returned as a range of the input; others are decoded into
+         *  the scratch buffer.
+         *
+         * @param b  Receives the start of the decoded string
+         * @param e  Receives the end of the decoded string
+         */
+        bool string(const char *& b, const char *& e)
+        {
+            ++p;
+            const char *start = p;
+            const char *q = scan_string(p, end);
+            if (q >= end)
+            {
+                return false;
+            }
+            if ('"' == *q)
+            {
+                b = start;
+                e = q;
+                p = q + 1;
+                return true;
+            }
+
+            scratch.assign(start, q);
+            p = q;
+            while (true)
+            {
+                if (p >= end)
+                {
+                    return false;
+                }
+                if ('"' == *p)
+                {
+                    ++p;
+                    break;
+                }
+                if ('\\' == *p)
+                {
+                    if (!escape())
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+                q = scan_string(p, end);
+                scratch.append(p, q);
+                p = q;
+            }
+            b = scratch.data();
+            e = b + scratch.size();
+            return true;
+        }
+
+
+        bool hex4(unsigned int& cp)
+        {
+            if (end - p < 4)
+            {
+                return false;
+            }
+            cp = 0;
+            for (int i = 0; i < 4; ++i, ++p)
+            {
+                char c = *p;
+                cp <<= 4;
+                if (c >= '0' && c <= '9')
+                {
+                    cp |= c - '0';
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    cp |= c - 'a' + 10;
+                }
+                else if (c >= 'A' && c <= 'F')
+                {
+                    cp |= c - 'A' + 10;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+
+        /**
+         *  Decodes an escape sequence into the scratch buffer
+         */
+        bool escape()
+        {
+            ++p;
+            if (p >= end)
+            {
+                return false;
+            }
+            char c = *p++;
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                scratch += c;
+                return true;
+            case 'b':
+                scratch += '\b';
+                return true;
+            case 'f':
+                scratch += '\f';
+                return true;
+            case 'n':
+                scratch += '\n';
+                return true;
+            case 'r':
+                scratch += '\r';
+                return true;
+            case 't':
+                scratch += '\t';
+                return true;
+            case 'u':
+                break;
+            default:
+                return false;
+            }
+
+            unsigned int cp = 0;
+            if (!hex4(cp) || (cp >= 0xDC00 && cp <= 0xDFFF))
+            {
+                return false;
+            }
+            if (cp >= 0xD800 && cp <= 0xDBFF)
+            {
+                unsigned int low = 0;
+                if (end - p < 2 || '\\' != p[0] || 'u' != p[1])
+                {
+                    return false;
+                }
+                p += 2;
+                if (!hex4(low) || low < 0xDC00 || low > 0xDFFF)
+                {
+                    return false;
+                }
+                cp = 0x10000 + ((cp & 0x3FF) << 10) + (low & 0x3FF);
+            }
+
+            if (cp < 0x80)
+            {
+                scratch += (char) cp;
+            }
+            else if (cp < 0x800)
+            {
+                scratch += (char) (0xC0 | (cp >> 6));
+                scratch += (char) (0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                scratch += (char) (0xE0 | (cp >> 12));
+                scratch += (char) (0x80 | ((cp >> 6) & 0x3F));
+                scratch += (char) (0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                scratch += (char) (0xF0 | (cp >> 18));
+                scratch += (char) (0x80 | ((cp >> 12) & 0x3F));
+                scratch += (char) (0x80 | ((cp >> 6) & 0x3F));
+                scratch += (char) (0x80 | (cp & 0x3F));
+            }
+            return true;
+        }
+
+
+        bool literal(const char *word, const size_t len)
+        {
+            if ((size_t) (end - p) < len || 0 != memcmp(p, word, len))
+            {
+                return false;
+            }
+            p += len;
+            return true;
+        }
+
+
+        bool digits()
+        {
+            const char *start = p;
+            while (p < end && *p >= '0' && *p <= '9')
+            {
+                ++p;
+            }
+            return p > start;
+        }
+
+
+        /**
+         *  Parses a number.  Like jsoncpp, integers are stored as
+         *  Json::Int64 if they fit, otherwise as Json::UInt64, and
+         *  anything else as a double.
+         */
+        bool number(Json::Value& out)
+        {
+            const char *start = p;
+            bool negative = ('-' == *p);
+            if (negative)
+            {
+                ++p;
+            }
+            if (p < end && '0' == *p)
+            {
+                ++p;
+            }
+            else if (!digits())
+            {
+                return false;
+            }
+
+            bool integer = true;
+            if (p < end && '.' == *p)
+            {
+                integer = false;
+                ++p;
+                if (!digits())
+                {
+                    return false;
+                }
+            }
+            if (p < end && ('e' == *p || 'E' == *p))
+            {
+                integer = false;
+                ++p;
+                if (p < end && ('+' == *p || '-' == *p))
+                {
+                    ++p;
+                }
+                if (!digits())
+                {
+                    return false;
+                }
+            }
+
+            if (integer)
+            {
+                uint64_t v = 0;
+                bool overflow = false;
+                for (const char *d = start + (negative ? 1 : 0); d < p; ++d)
+                {
+                    unsigned int digit = *d - '0';
+                    if (v > (UINT64_MAX - digit) / 10)
+                    {
+                        overflow = true;
+                        break;
+                    }
+                    v = v * 10 + digit;
+                }
+                if (!overflow && !negative)
+                {
+                    if (v <= (uint64_t) INT64_MAX)
+                    {
+                        out = Json::Value((Json::Int64) v);
+                    }
+                    else
+                    {
+                        out = Json::Value((Json::UInt64) v);
+                    }
+                    return true;
+                }
+                if (!overflow && v <= (uint64_t) INT64_MAX + 1)
+                {
+                    out = Json::Value((Json::Int64) (0 - v));
+                    return true;
+                }
+            }
+
+            // Numbers out of the range of a double are rejected, like
+            // jsoncpp does; they could not be written back either
+            std::string num(start, p);
+            double d = strtod(num.c_str(), nullptr);
+            if (std::isinf(d))
+            {
+                return false;
+            }
+            out = Json::Value(d);
+            return true;
+        }
+    };
+
+
+
+    /**
+     *  Decodes the UTF-8 sequence starting at s the same way as jsoncpp
+     *  does, including the replacement of invalid sequences.  s is left
+     *  at the last byte of the sequence.
+     */
+    unsigned int utf8_codepoint(const char *& s, const char *e)
+    {
+        static const unsigned int replacement = 0xFFFD;
+        const unsigned char *u = reinterpret_cast<const unsigned char *>(s);
+        unsigned int first = u[0];
+        unsigned int cp;
+        if (first < 0x80)
+        {
+            return first;
+        }
+        if (first < 0xE0)
+        {
+            if (e - s < 2)
+            {
+                return replacement;
+            }
+            cp = ((first & 0x1F) << 6) | (u[1] & 0x3F);
+            s += 1;
+            return (cp < 0x80 ? replacement : cp);
+        }
+        if (first < 0xF0)
+        {
+            if (e - s < 3)
+            {
+                return replacement;
+            }
+            cp = ((first & 0x0F) << 12) | ((u[1] & 0x3F) << 6) | (u[2] & 0x3F);
+            s += 2;
+            if (cp >= 0xD800 && cp <= 0xDFFF)
+            {
+                return replacement;
+            }
+            return (cp < 0x800 ? replacement : cp);
+        }
+        if (first < 0xF8)
+        {
+            if (e - s < 4)
+            {
+                return replacement;
+            }
+            cp = ((first & 0x07) << 18) | ((u[1] & 0x3F) << 12)
+                 | ((u[2] & 0x3F) << 6) | (u[3] & 0x3F);
+            s += 3;
+            return (cp < 0x10000 ? replacement : cp);
+        }
+        return replacement;
+    }
+
+
+    void write_hex16(std::string& out, const unsigned int v)
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        out += "\\u";
+        out += hex[(v >> 12) & 0xF];
+        out += hex[(v >> 8) & 0xF];
+        out += hex[(v >> 4) & 0xF];
+        out += hex[v & 0xF];
+    }
+
+
+    /**
+     *  Writes a quoted string the same way as the jsoncpp writer with
+     *  its default settings does; anything outside printable ASCII is
+     *  written as \uXXXX escapes, using surrogate pairs where needed.
+     */
+    void write_string(std::string& out, const char *s, const char *e)
+    {
+        out += '"';
+        const char *run = s;
+        for (const char *c = s; c < e; ++c)
+        {
+            unsigned char ch = *c;
+            if ('"' != ch && '\\' != ch && ch >= 0x20 && ch < 0x80)
+            {
+                continue;
+            }
+            out.append(run, c);
+            switch (ch)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\b':
+                out += "\\b";
+                break;
+            case '\f':
+                out += "\\f";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                {
+                    unsigned int cp = utf8_codepoint(c, e);
+                    if (cp < 0x10000)
+                    {
+                        write_hex16(out, cp);
+                    }
+                    else
+                    {
+                        cp -= 0x10000;
+                        write_hex16(out, 0xD800 + ((cp >> 10) & 0x3FF));
+                        write_hex16(out, 0xDC00 + (cp & 0x3FF));
+                    }
+                }
+                break;
+            }
+            run = c + 1;
+        }
+        out.append(run, e);
+        out += '"';
+    }
+
+
+    /**
+     *  Writes a double the same way as jsoncpp does
+     */
+    void write_double(std::string& out, const double v)
+    {
+        if (std::isnan(v))
+        {
+            out += "null";
+            return;
+        }
+        if (std::isinf(v))
+        {
+            out += (v < 0 ? "-1e+9999" : "1e+9999");
+            return;
+        }
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%.17g", v);
+        out.append(buf, len);
+        if (nullptr == strpbrk(buf, ".eE"))
+        {
+            out += ".0";
+        }
+    }
+
+
+    void write_compact(std::string& out, const Json::Value& v)
+    {
+        switch (v.type())
+        {
+        case Json::nullValue:
+            out += "null";
+            break;
+
+        case Json::intValue:
+            out += std::to_string(v.asLargestInt());
+            break;
+
+        case Json::uintValue:
+            out += std::to_string(v.asLargestUInt());
+            break;
+
+        case Json::realValue:
+            write_double(out, v.asDouble());
+            break;
+
+        case Json::stringValue:
+            {
+                const char *b = nullptr;
+                const char *e = nullptr;
+                v.getString(&b, &e);
+                write_string(out, b, e);
+            }
+            break;
+
+        case Json::booleanValue:
+            out += (v.asBool() ? "true" : "false");
+            break;
+
+        case Json::arrayValue:
+            {
+                out += '[';
+                Json::ArrayIndex size = v.size();
+                for (Json::ArrayIndex i = 0; i < size; ++i)
+                {
+                    if (i > 0)
+                    {
+                        out += ',';
+                    }
+                    write_compact(out, v[i]);
+                }
+                out += ']';
+            }
+            break;
+
+        case Json::objectValue:
+            {
+                out += '{';
+                bool first = true;
+                for (auto it = v.begin(); it != v.end(); ++it)
+                {
+                    if (!first)
+                    {
+                        out += ',';
+                    }
+                    first = false;
+                    const char *ke = nullptr;
+                    const char *kb = it.memberName(&ke);
+                    write_string(out, kb, ke);
+                    out += ':';
+                    write_compact(out, *it);
+                }
+                out += '}';
+            }
+            break;
+        }
+    }
+}
+
+
+
+namespace JsonIO
+{
+    Json::Value Parse(const char *data, const size_t len)
+    {
+        Json::Value ret;
+        FastReader fast(data, data + len);
+        if (fast.Parse(ret))
+        {
+            return ret;
+        }
+
+        // Not accepted by the fast reader; let jsoncpp parse it, which
+        // also provides the error message on invalid documents
+        static thread_local std::unique_ptr<Json::CharReader> reader;
+        if (!reader)
+        {
+            Json::CharReaderBuilder bld;
+            bld["collectComments"] = false;
+            reader.reset(bld.newCharReader());
+        }
+        ret = Json::Value();
+        std::string errors;
+        if (!reader->parse(data, data + len, &ret, &errors))
+        {
+            throw JsonIOException(errors);
+        }
+        return ret;
+    }
+
+
+    Json::Value Parse(const std::string& data)
+    {
+        return Parse(data.data(), data.size());
+    }
+
+
+    Json::Value LoadFile(const std::string& fname)
+    {
+        int fd = open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw JsonIOException("Could not open " + fname + ": "
+                                  + strerror(errno));
+        }
+
+        std::string content;
+        struct stat st;
+        if (0 == fstat(fd, &st) && st.st_size > 0)
+        {
+            // One byte more, so the end of the file is found without
+            // growing the buffer
+            content.resize(st.st_size + 1);
+        }
+        size_t len = 0;
+        while (true)
+        {
+            if (len == content.size())
+            {
+                // The file grew, or its size is not known
+                content.resize(len + 65536);
+            }
+            ssize_t r = read(fd, &content[len], content.size() - len);
+            if (r < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            if (r < 0)
+            {
+                int err = errno;
+                close(fd);
+                throw JsonIOException("Could not read " + fname + ": "
+                                      + strerror(err));
+            }
+            if (0 == r)
+            {
+                break;
+            }
+            len += r;
+        }
+        close(fd);
+        return Parse(content.data(), len);
+    }
+
+
+    std::string Write(const Json::Value& value, const bool compact)
+    {
+        if (compact)
+        {
+            std::string out;
+            write_compact(out, value);
+            return out;
+        }
+
+        static thread_local std::unique_ptr<Json::StreamWriter> writer;
+        if (!writer)
+        {
+            Json::StreamWriterBuilder bld;
+            writer.reset(bld.newStreamWriter());
+        }
+        std::ostringstream out;
+        writer->write(value, &out);
+        return out.str();
+    }
+}
@@ -0,0 +1,105 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+/**
+ * @file   json-io.hpp
+ *
+ * @brief  Fast reading and writing of JSON documents into and from
+ *         jsoncpp Json::Value objects
+ *
+ *  jsoncpp parses documents character by character through a generic
+ *  reader, which dominates the load time of large persistent
+ *  configuration stores.  The reader here builds the Json::Value tree
+ *  directly, scans string contents 16 bytes at a time where SSE2 is
+ *  available and only copies strings containing escape sequences.  Any
+ *  document it does not accept is handed to the jsoncpp reader, so the
+ *  accepted syntax and the error messages are the same as before.
+ */
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include <json/json.h>
+
+
+class JsonIOException : public std::runtime_error
+{
+public:
+    JsonIOException(const std::string& err)
+        : std::runtime_error(err)
+    {
+    }
+};
+
+
+namespace JsonIO
+{
+    /**
+     *  Parse a JSON document
+     *
+     * @param data  Pointer to the start of the document
+     * @param len   Length of the document
+     *
+     * @return Returns the parsed Json::Value
+     *
+     * @throws JsonIOException if the document cannot be parsed
+     */
+    Json::Value Parse(const char *data, const size_t len);
+
+
+    /**
+     *  Parse a JSON document
+     *
+     * @param data  std::string with the document
+     *
+     * @return Returns the parsed Json::Value
+     *
+     * @throws JsonIOException if the document cannot be parsed
+     */
+    Json::Value Parse(const std::string& data);
+
+
+    /**
+     *  Read and parse a JSON file.  The file is read with as few read
+     *  calls as possible, without going through a stream buffer.
+     *
+     * @param fname  std::string with the file name
+     *
+     * @return Returns the parsed Json::Value
+     *
+     * @throws JsonIOException if the file cannot be read or parsed
+     */
+    Json::Value LoadFile(const std::string& fname);
+
+
+    /**
+     *  Generate the text representation of a JSON value
+     *
+     * @param value    Json::Value to write
+     * @param compact  If true, the document is written without any
+     *                 whitespace or comments by the fast writer.
+     *                 Otherwise it is indented for human readers by
+     *                 jsoncpp.  Both write non-ASCII characters as
+     *                 \uXXXX escapes, like the jsoncpp defaults.
+     *
+     * @return Returns a std::string with the JSON document
+     */
+    std::string Write(const Json::Value& value, const bool compact = false);
+}
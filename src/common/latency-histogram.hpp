@@ -0,0 +1,158 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   latency-histogram.hpp
+ *
+ * @brief  Latency histogram with atomic counters
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ *  Latency histogram with fixed bucket bounds.  The counters are
+ *  updated atomically, so latencies can be recorded from several
+ *  threads while the histogram is read from another one.
+ */
+class LatencyHistogram
+{
+public:
+    /**
+     * @param bounds  Upper bounds of the buckets in microseconds, in
+     *                increasing order.  A latency is counted in the
+     *                first bucket whose bound it does not exceed.  The
+     *                histogram has one more bucket than bounds, counting
+     *                all latencies above the last bound.
+     */
+    explicit LatencyHistogram(const std::vector<uint64_t>& bounds)
+        : bounds(bounds), buckets(bounds.size() + 1)
+    {
+        Reset();
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+
+    /**
+     *  Count a new latency measurement
+     *
+     * @param usec  Measured latency in microseconds
+     */
+    void Record(const uint64_t usec) noexcept
+    {
+        const size_t idx = std::lower_bound(bounds.begin(), bounds.end(), usec)
+                           - bounds.begin();
+        buckets[idx].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        total_usec.fetch_add(usec, std::memory_order_relaxed);
+
+        uint64_t prev = max_usec.load(std::memory_order_relaxed);
+        while (usec > prev
+               && !max_usec.compare_exchange_weak(prev, usec,
+                                                  std::memory_order_relaxed))
+        {
+        }
+    }
+
+
+    /**
+     *  Count a new latency measurement
+     *
+     * @param latency  Measured latency
+     */
+    void Add(const std::chrono::steady_clock::duration latency) noexcept
+    {
+        Record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    }
+
+
+    /**
+     *  Clear all the counters
+     */
+    void Reset() noexcept
+    {
+        for (auto& b : buckets)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+        total_usec.store(0, std::memory_order_relaxed);
+        max_usec.store(0, std::memory_order_relaxed);
+    }
+
+
+    /**
+     * @return Returns a std::vector with the number of measurements in
+     *         each bucket
+     */
+    std::vector<uint64_t> Get() const
+    {
+        std::vector<uint64_t> ret;
+        ret.reserve(buckets.size());
+        for (const auto& b : buckets)
+        {
+            ret.push_back(b.load(std::memory_order_relaxed));
+        }
+        return ret;
+    }
+
+
+    /**
+     * @return Returns the number of measurements
+     */
+    uint64_t GetCount() const noexcept
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+
+    /**
+     * @return Returns the sum of all the measured latencies, in
+     *         microseconds
+     */
+    uint64_t GetTotalUsec() const noexcept
+    {
+        return total_usec.load(std::memory_order_relaxed);
+    }
+
+
+    /**
+     * @return Returns the longest measured latency, in microseconds
+     */
+    uint64_t GetMaxUsec() const noexcept
+    {
+        return max_usec.load(std::memory_order_relaxed);
+    }
+
+
+private:
+    const std::vector<uint64_t> bounds;
+    std::vector<std::atomic<uint64_t>> buckets;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_usec{0};
+    std::atomic<uint64_t> max_usec{0};
+};
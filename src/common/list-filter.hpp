@@ -0,0 +1,220 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   list-filter.hpp
+ *
+ * @brief  Filtering and pagination of the object listings of the
+ *         configuration and session managers
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+
+/**
+ *  Selects the objects to return from a filtered listing method, like
+ *  FetchConfigsFiltered or FetchSessionsFiltered.
+ *
+ *  The listing is ordered by D-Bus object path.  A page of up to
+ *  `limit` matching objects is returned together with a continuation
+ *  cursor, which is the object path of the last object returned.  The
+ *  next page starts after that path, so objects added or removed
+ *  between the calls do not make the pages overlap or skip objects
+ *  which existed during the whole listing.
+ */
+class ListFilter
+{
+public:
+    /**
+     *  The properties of an object the filter is matched against
+     */
+    struct Item
+    {
+        std::string path;               ///< D-Bus object path
+        uid_t owner = 0;
+        std::string name;               ///< Configuration profile name
+        unsigned int status_major = 0;  ///< StatusMajor, 0 if not known
+        bool dco = false;
+    };
+
+    /**
+     *  A page of the listing
+     */
+    struct Page
+    {
+        std::vector<std::string> paths; ///< Object paths, in order
+        std::string next;               ///< Cursor of the next page,
+                                        ///< empty on the last page
+    };
+
+
+    /// Largest page size; larger limits and 0 are lowered to this
+    static const unsigned int MaxLimit = 1000;
+
+    bool owner_set = false;
+    uid_t owner = 0;
+    std::string name_prefix;
+    bool status_set = false;
+    unsigned int status_major = 0;
+    bool dco_set = false;
+    bool dco = false;
+    std::string cursor;                 ///< Object path to continue after
+    unsigned int limit = MaxLimit;
+
+
+    /**
+     *  Sets a filter criteria by name, as given in the filter
+     *  dictionary of the D-Bus methods.  Throws std::invalid_argument
+     *  on unknown criteria.
+     *
+     * @param key    std::string with the name of the criteria; one of
+     *               "owner", "name_prefix", "status_major" or "dco"
+     * @param value  std::string with the value.  Numbers are given in
+     *               decimal, booleans as "true" or "false".
+     */
+    void Set(const std::string& key, const std::string& value)
+    {
+        if ("owner" == key)
+        {
+            owner = parse_number(key, value);
+            owner_set = true;
+        }
+        else if ("name_prefix" == key)
+        {
+            name_prefix = value;
+        }
+        else if ("status_major" == key)
+        {
+            status_major = parse_number(key, value);
+            status_set = true;
+        }
+        else if ("dco" == key)
+        {
+            if ("true" != value && "false" != value)
+            {
+                throw std::invalid_argument("Invalid value for filter 'dco': "
+                                            + value);
+            }
+            dco = ("true" == value);
+            dco_set = true;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown filter: " + key);
+        }
+    }
+
+
+    /**
+     *  Sets the page size
+     *
+     * @param l  Maximum number of objects per page.  0 and values above
+     *           MaxLimit select MaxLimit.
+     */
+    void SetLimit(const unsigned int l)
+    {
+        if (0 == l || l > MaxLimit)
+        {
+            limit = MaxLimit;
+        }
+        else
+        {
+            limit = l;
+        }
+    }
+
+
+    /**
+     * @return Returns true if the item matches all the filter criteria
+     *         and comes after the cursor
+     */
+    bool Match(const Item& item) const
+    {
+        if (!cursor.empty() && item.path <= cursor)
+        {
+            return false;
+        }
+        if (owner_set && item.owner != owner)
+        {
+            return false;
+        }
+        if (!name_prefix.empty()
+            && 0 != item.name.compare(0, name_prefix.size(), name_prefix))
+        {
+            return false;
+        }
+        if (status_set && item.status_major != status_major)
+        {
+            return false;
+        }
+        if (dco_set && item.dco != dco)
+        {
+            return false;
+        }
+        return true;
+    }
+
+
+    /**
+     *  Builds the page to return from the matching object paths
+     *
+     * @param paths  std::vector of the paths of the objects which
+     *               passed Match() and the access checks, in any order
+     *
+     * @return Returns the Page with the first `limit` paths
+     */
+    Page Select(std::vector<std::string> paths) const
+    {
+        Page page;
+        if (paths.size() > limit)
+        {
+            std::partial_sort(paths.begin(), paths.begin() + limit, paths.end());
+            paths.resize(limit);
+            page.next = paths.back();
+        }
+        else
+        {
+            std::sort(paths.begin(), paths.end());
+        }
+        page.paths = std::move(paths);
+        return page;
+    }
+
+
+private:
+    static unsigned long parse_number(const std::string& key,
+                                      const std::string& value)
+    {
+        if (value.empty()
+            || value.find_first_not_of("0123456789") != std::string::npos
+            || value.size() > 10)
+        {
+            throw std::invalid_argument("Invalid value for filter '"
+                                        + key + "': " + value);
+        }
+        return std::stoul(value);
+    }
+};
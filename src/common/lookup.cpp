@@ -28,6 +28,9 @@
 #include <string>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <unistd.h>
 #include <sys/types.h>
 #include <pwd.h>
@@ -66,6 +69,169 @@ static inline char* alloc_sysconf_buffer(int name, size_t* retlen)
 }
 
 
+/**
+ *  Cache of the uid <-> username and group membership lookups.  With NSS
+ *  backends like SSSD or LDAP each getpw*_r() call may take a long time,
+ *  while the same few accounts are looked up over and over again.  Failed
+ *  lookups are cached too, but only for a few seconds.
+ */
+class LookupCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static LookupCache& Instance()
+    {
+        static LookupCache cache;
+        return cache;
+    }
+
+
+    void SetTTL(const unsigned int sec)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        ttl = std::chrono::seconds(sec);
+        usernames.clear();
+        uids.clear();
+        groups.clear();
+    }
+
+
+    void Flush()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        usernames.clear();
+        uids.clear();
+        groups.clear();
+    }
+
+
+    bool GetUsername(const uid_t uid, std::string& name, bool& found)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = usernames.find(uid);
+        if (usernames.end() == it || Clock::now() >= it->second.expires)
+        {
+            return false;
+        }
+        name = it->second.value;
+        found = it->second.found;
+        return true;
+    }
+
+
+    bool GetUID(const std::string& name, uid_t& uid, bool& found)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = uids.find(name);
+        if (uids.end() == it || Clock::now() >= it->second.expires)
+        {
+            return false;
+        }
+        uid = it->second.value;
+        found = it->second.found;
+        return true;
+    }
+
+
+    void AddUser(const uid_t uid, const std::string& name)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (0 == ttl.count())
+        {
+            return;
+        }
+        Clock::time_point exp = Clock::now() + ttl;
+        usernames[uid] = {name, true, exp};
+        uids[name] = {uid, true, exp};
+    }
+
+
+    void AddUnknownUID(const uid_t uid, const std::string& fallback)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (0 == ttl.count())
+        {
+            return;
+        }
+        usernames[uid] = {fallback, false, Clock::now() + negative_ttl()};
+    }
+
+
+    void AddUnknownUsername(const std::string& name)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (0 == ttl.count())
+        {
+            return;
+        }
+        uids[name] = {0, false, Clock::now() + negative_ttl()};
+    }
+
+
+    bool GetGroups(const uid_t uid, std::vector<gid_t>& gids)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = groups.find(uid);
+        if (groups.end() == it || Clock::now() >= it->second.expires)
+        {
+            return false;
+        }
+        gids = it->second.value;
+        return true;
+    }
+
+
+    void AddGroups(const uid_t uid, const std::vector<gid_t>& gids,
+                   const bool found)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (0 == ttl.count())
+        {
+            return;
+        }
+        groups[uid] = {gids, found,
+                       Clock::now() + (found ? ttl : negative_ttl())};
+    }
+
+
+private:
+    template <typename T>
+    struct Entry
+    {
+        T value;
+        bool found;
+        Clock::time_point expires;
+    };
+
+    std::mutex mtx;
+    std::chrono::seconds ttl{LOOKUP_CACHE_DEFAULT_TTL};
+    std::map<uid_t, Entry<std::string>> usernames;
+    std::map<std::string, Entry<uid_t>> uids;
+    std::map<uid_t, Entry<std::vector<gid_t>>> groups;
+
+    LookupCache() = default;
+
+    std::chrono::seconds negative_ttl() const
+    {
+        return std::min(ttl, std::chrono::seconds(5));
+    }
+};
+
+
+void lookup_cache_set_ttl(const unsigned int ttl)
+{
+    LookupCache::Instance().SetTTL(ttl);
+}
+
+
+void lookup_cache_flush()
+{
+    LookupCache::Instance().Flush();
+}
+
+
+
 /**
  *  Looks up the uid of a user account to extract its username
  *
@@ -75,6 +241,13 @@ static inline char* alloc_sysconf_buffer(int name, size_t* retlen)
  */
 std::string lookup_username(uid_t uid)
 {
+    std::string cached;
+    bool found = false;
+    if (LookupCache::Instance().GetUsername(uid, cached, found))
+    {
+        return cached;
+    }
+
     struct passwd pwrec;
     struct passwd *result = nullptr;
     size_t buflen = 0;
@@ -85,10 +258,12 @@ std::string lookup_username(uid_t uid)
     if ( (0 == r) && (NULL != result))
     {
         ret = std::string(pwrec.pw_name);
+        LookupCache::Instance().AddUser(uid, ret);
     }
     else
     {
         ret = "(" + std::to_string(uid) + ")";
+        LookupCache::Instance().AddUnknownUID(uid, ret);
     }
     free(buf);
     return ret;
@@ -104,6 +279,17 @@ std::string lookup_username(uid_t uid)
  */
 uid_t lookup_uid(std::string username)
 {
+    uid_t cached = 0;
+    bool found = false;
+    if (LookupCache::Instance().GetUID(username, cached, found))
+    {
+        if (!found)
+        {
+            throw LookupException("User '" + username + "' not found");
+        }
+        return cached;
+    }
+
     struct passwd pwrec;
     struct passwd *result = nullptr;
     size_t buflen = 0;
@@ -113,12 +299,13 @@ uid_t lookup_uid(std::string username)
     int r = getpwnam_r(username.c_str(), &pwrec, buf, buflen, &result);
     if ( (0 == r) && (NULL != result))
     {
-
         ret = result->pw_uid;
+        LookupCache::Instance().AddUser(ret, username);
     }
     else
     {
         free(buf);
+        LookupCache::Instance().AddUnknownUsername(username);
         throw LookupException("User '" + username + "' not found");
     }
     free(buf);
@@ -180,3 +367,103 @@ gid_t lookup_gid(const std::string& groupname)
     free(buf);
     return ret;
 }
+
+
+/**
+ *  Looks up the group name of a gid
+ *
+ * @param gid   gid_t to use for the query
+ * @return      Returns a std::string containing the group name on success,
+ *              otherwise the gid is returned as a string, encapsulated by ().
+ */
+std::string lookup_groupname(gid_t gid)
+{
+    struct group grprec;
+    struct group *result = nullptr;
+    size_t buflen = 0;
+    char *buf = alloc_sysconf_buffer(_SC_GETGR_R_SIZE_MAX, &buflen);
+
+    std::string ret;
+    int r = getgrgid_r(gid, &grprec, buf, buflen, &result);
+    if ( (0 == r) && (NULL != result))
+    {
+        ret = std::string(grprec.gr_name);
+    }
+    else
+    {
+        ret = "(" + std::to_string(gid) + ")";
+    }
+    free(buf);
+    return ret;
+}
+
+
+/**
+ *  Returns the gid_t value of the input, whether the input string is a
+ *  numeric value (gid) or a group name which goes through a gid lookup.
+ *
+ * @param input  std::string containing a group name or a gid
+ *
+ * @return Returns a gid_t representation of the group name or gid.
+ * @throws LookupException if the group is not found
+ */
+gid_t get_groupid(const std::string& input)
+{
+    if (!input.empty() && isanum_string(input))
+    {
+        return std::stoi(input);
+    }
+    return lookup_gid(input);
+}
+
+
+/**
+ *  Looks up all the groups a user is a member of, both the primary
+ *  group and the supplementary groups.  The result is cached like
+ *  lookup_username(), so group membership changes are picked up once
+ *  the cached result expires.
+ *
+ * @param uid  uid_t of the user account
+ * @return Returns a sorted std::vector with the gid_t of each group.  If
+ *         the user account does not exist, the list is empty.
+ */
+std::vector<gid_t> lookup_user_groups(uid_t uid)
+{
+    std::vector<gid_t> ret;
+    if (LookupCache::Instance().GetGroups(uid, ret))
+    {
+        return ret;
+    }
+
+    struct passwd pwrec;
+    struct passwd *result = nullptr;
+    size_t buflen = 0;
+    char *buf = alloc_sysconf_buffer(_SC_GETPW_R_SIZE_MAX, &buflen);
+
+    int r = getpwuid_r(uid, &pwrec, buf, buflen, &result);
+    if ( (0 != r) || (NULL == result))
+    {
+        free(buf);
+        LookupCache::Instance().AddGroups(uid, ret, false);
+        return ret;
+    }
+
+    int ngroups = 32;
+    ret.resize(ngroups);
+    while (getgrouplist(pwrec.pw_name, pwrec.pw_gid, ret.data(), &ngroups) < 0)
+    {
+        // ngroups has been updated with the number of groups needed
+        if ((size_t) ngroups <= ret.size())
+        {
+            ngroups = ret.size() * 2;
+        }
+        ret.resize(ngroups);
+    }
+    ret.resize(ngroups);
+    free(buf);
+
+    std::sort(ret.begin(), ret.end());
+    ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+    LookupCache::Instance().AddGroups(uid, ret, true);
+    return ret;
+}
@@ -29,6 +29,15 @@
 
 #include <unistd.h>
 #include <exception>
+#include <string>
+#include <vector>
+
+
+/**
+ *  Default number of seconds results from lookup_username(), lookup_uid()
+ *  and lookup_user_groups() are cached
+ */
+#define LOOKUP_CACHE_DEFAULT_TTL 300
 
 class LookupException : public std::exception
 {
@@ -62,7 +71,24 @@ private:
 };
 
 
+/**
+ *  Change how long lookup_username(), lookup_uid() and lookup_user_groups()
+ *  results are cached.  This also flushes the cache.
+ *
+ * @param ttl  Number of seconds to keep a result; 0 disables the cache
+ */
+void lookup_cache_set_ttl(const unsigned int ttl);
+
+/**
+ *  Removes all cached lookup_username(), lookup_uid() and
+ *  lookup_user_groups() results
+ */
+void lookup_cache_flush();
+
 std::string lookup_username(uid_t uid);
 uid_t lookup_uid(std::string username);
 uid_t get_userid(const std::string input);
 gid_t lookup_gid(const std::string& groupname);
+std::string lookup_groupname(gid_t gid);
+gid_t get_groupid(const std::string& input);
+std::vector<gid_t> lookup_user_groups(uid_t uid);
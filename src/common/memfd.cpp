@@ -0,0 +1,203 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   memfd.cpp
+ *
+ * @brief  Helpers for passing larger data blobs between processes
+ *         via sealed memfd file descriptors (implementation)
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <streambuf>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common/memfd.hpp"
+
+
+namespace MemFD
+{
+
+/**
+ *  Minimal std::streambuf writing its output to a file descriptor
+ */
+class FDStreamBuf : public std::streambuf
+{
+public:
+    FDStreamBuf(int fd)
+        : fd(fd)
+    {
+        setp(buffer, buffer + sizeof(buffer));
+    }
+
+    ~FDStreamBuf()
+    {
+        sync();
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        if (!flush_buffer())
+        {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override
+    {
+        return flush_buffer() ? 0 : -1;
+    }
+
+private:
+    int fd;
+    char buffer[65536];
+
+    bool flush_buffer()
+    {
+        const char *p = pbase();
+        while (p < pptr())
+        {
+            ssize_t r = ::write(fd, p, pptr() - p);
+            if (r < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                return false;
+            }
+            p += r;
+        }
+        setp(buffer, buffer + sizeof(buffer));
+        return true;
+    }
+};
+
+
+int CreateSealed(const std::string& name, Writer writer)
+{
+    int fd = ::memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        throw MemFDException("Could not create memfd: "
+                             + std::string(strerror(errno)));
+    }
+
+    try
+    {
+        {
+            FDStreamBuf buf(fd);
+            std::ostream os(&buf);
+            writer(os);
+            os.flush();
+            if (!os.good())
+            {
+                throw MemFDException("Could not write to memfd: "
+                                     + std::string(strerror(errno)));
+            }
+        }
+
+        if (::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+                                     | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+        {
+            throw MemFDException("Could not seal memfd: "
+                                 + std::string(strerror(errno)));
+        }
+        if (::lseek(fd, 0, SEEK_SET) < 0)
+        {
+            throw MemFDException("Could not rewind memfd: "
+                                 + std::string(strerror(errno)));
+        }
+    }
+    catch (...)
+    {
+        ::close(fd);
+        throw;
+    }
+    return fd;
+}
+
+
+int CreateSealed(const std::string& name, const std::string& data)
+{
+    return CreateSealed(name, [&data](std::ostream& os)
+                              {
+                                  os.write(data.data(), data.size());
+                              });
+}
+
+
+std::string ReadSealed(int fd, size_t max_size)
+{
+    const int required = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+    int seals = ::fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & required) != required)
+    {
+        throw MemFDException("File descriptor is not a sealed memfd");
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+    {
+        throw MemFDException("Could not retrieve memfd size: "
+                             + std::string(strerror(errno)));
+    }
+    if ((size_t) st.st_size > max_size)
+    {
+        throw MemFDException("Data size exceeds the limit of "
+                             + std::to_string(max_size) + " bytes");
+    }
+
+    // The seals guarantee the size stays the same, so the content
+    // can be read straight into a buffer of the final size
+    std::string ret(st.st_size, '\0');
+    size_t pos = 0;
+    while (pos < ret.size())
+    {
+        ssize_t r = ::pread(fd, &ret[pos], ret.size() - pos, pos);
+        if (r < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            throw MemFDException("Could not read memfd: "
+                                 + std::string(strerror(errno)));
+        }
+        if (0 == r)
+        {
+            throw MemFDException("Unexpected end of memfd data");
+        }
+        pos += r;
+    }
+    return ret;
+}
+
+} // namespace MemFD
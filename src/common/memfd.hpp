@@ -0,0 +1,94 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   memfd.hpp
+ *
+ * @brief  Helpers for passing larger data blobs between processes
+ *         via sealed memfd file descriptors
+ */
+
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+
+class MemFDException : public std::runtime_error
+{
+public:
+    MemFDException(const std::string& err)
+        : std::runtime_error(err)
+    {
+    }
+};
+
+
+namespace MemFD
+{
+    using Writer = std::function<void(std::ostream&)>;
+
+    /**
+     *  Creates a new memfd, lets the writer function fill it via an
+     *  std::ostream writing directly into the file descriptor, and
+     *  seals it against any further changes.
+     *
+     * @param name    std::string with the name of the memfd, only used
+     *                for debugging purposes
+     * @param writer  Writer function producing the content
+     *
+     * @return Returns a file descriptor positioned at the start of the
+     *         sealed content.  The caller is responsible for closing it.
+     *
+     * @throws MemFDException on errors
+     */
+    int CreateSealed(const std::string& name, Writer writer);
+
+
+    /**
+     *  Creates a sealed memfd with the content of a string
+     *
+     * @param name  std::string with the name of the memfd
+     * @param data  std::string with the content
+     *
+     * @return Returns the file descriptor.  The caller is responsible for
+     *         closing it.
+     *
+     * @throws MemFDException on errors
+     */
+    int CreateSealed(const std::string& name, const std::string& data);
+
+
+    /**
+     *  Reads the complete content of a sealed memfd.  The file descriptor
+     *  must be sealed against writing and resizing, which ensures the
+     *  size cannot change and that reading it will never block.
+     *
+     * @param fd        File descriptor to read from.  It is not closed.
+     * @param max_size  Largest size accepted, in bytes
+     *
+     * @return Returns a std::string with the content
+     *
+     * @throws MemFDException if the file descriptor is not a sealed memfd,
+     *         if the content is larger than max_size or on read errors
+     */
+    std::string ReadSealed(int fd, size_t max_size);
+} // namespace MemFD
@@ -0,0 +1,141 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   mpsc-queue.hpp
+ *
+ * @brief  Lock-free multiple producer, single consumer queue
+ */
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+
+/**
+ *  Lock-free queue where any number of threads can add items while a
+ *  single thread takes them out again.
+ *
+ *  Producers push items onto an atomic singly linked list.  The consumer
+ *  takes the complete list in one operation and reverses it, which gives
+ *  the items in the order they were pushed.  Neither side ever blocks
+ *  the other.
+ *
+ * @tparam T  Type of the queued items; must be movable
+ */
+template <typename T>
+class MPSCQueue
+{
+public:
+    MPSCQueue() = default;
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    ~MPSCQueue()
+    {
+        Node *n = head.exchange(nullptr, std::memory_order_acquire);
+        while (n)
+        {
+            Node *next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+
+    /**
+     *  Add an item to the queue.  Safe to call from any thread.
+     *
+     * @param item  Item to add
+     *
+     * @return Returns true if the queue was empty before this item was
+     *         added.  This can be used to wake up the consumer only once
+     *         per batch of items.
+     */
+    bool Push(T item)
+    {
+        Node *n = new Node(std::move(item));
+        Node *prev = head.load(std::memory_order_relaxed);
+        do
+        {
+            n->next = prev;
+        } while (!head.compare_exchange_weak(prev, n,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+        return nullptr == prev;
+    }
+
+
+    /**
+     *  Take all the queued items out of the queue.  Must only be called
+     *  from the consumer thread.
+     *
+     * @return Returns a std::vector with the items, oldest first
+     */
+    std::vector<T> PopAll()
+    {
+        Node *n = head.exchange(nullptr, std::memory_order_acquire);
+
+        // Reverse the list, to get the items in the order they were added
+        Node *rev = nullptr;
+        size_t count = 0;
+        while (n)
+        {
+            Node *next = n->next;
+            n->next = rev;
+            rev = n;
+            n = next;
+            ++count;
+        }
+
+        std::vector<T> ret;
+        ret.reserve(count);
+        while (rev)
+        {
+            Node *next = rev->next;
+            ret.push_back(std::move(rev->item));
+            delete rev;
+            rev = next;
+        }
+        return ret;
+    }
+
+
+    bool empty() const noexcept
+    {
+        return nullptr == head.load(std::memory_order_relaxed);
+    }
+
+
+private:
+    struct Node
+    {
+        Node(T&& i)
+            : item(std::move(i))
+        {
+        }
+
+        T item;
+        Node *next = nullptr;
+    };
+
+    std::atomic<Node *> head{nullptr};
+};
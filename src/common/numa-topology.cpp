@@ -0,0 +1,122 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   numa-topology.cpp
+ *
+ * @brief  NUMA nodes of the system and of network devices, and the
+ *         memory policy of a thread
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "numa-topology.hpp"
+#include "thread-scheduling.hpp"
+
+
+static std::string read_line(const std::string& path)
+{
+    std::ifstream f(path);
+    std::string line;
+    std::getline(f, line);
+    return line;
+}
+
+
+static std::set<unsigned int> parse_list(const std::string& list)
+{
+    if (list.empty())
+    {
+        return {};
+    }
+    ThreadScheduling sched;
+    sched.SetCPUs(list);
+    return sched.GetCPUs();
+}
+
+
+NumaTopology::NumaTopology(const std::string& root)
+    : root(root)
+{
+}
+
+
+std::set<unsigned int> NumaTopology::Nodes() const
+{
+    return parse_list(read_line(root + "/sys/devices/system/node/online"));
+}
+
+
+int NumaTopology::DeviceNode(const std::string& netdev) const
+{
+    std::string node = read_line(root + "/sys/class/net/" + netdev
+                                 + "/device/numa_node");
+    if (node.empty() || node.find_first_not_of("0123456789") != std::string::npos
+        || node.size() > 4)
+    {
+        // Also covers "-1", used for devices without a node
+        return -1;
+    }
+    return std::stoi(node);
+}
+
+
+std::set<unsigned int> NumaTopology::NodeCPUs(const unsigned int node) const
+{
+    return parse_list(read_line(root + "/sys/devices/system/node/node"
+                                + std::to_string(node) + "/cpulist"));
+}
+
+
+int NumaTopology::ParseNode(const std::string& node)
+{
+    if ("auto" == node)
+    {
+        return -1;
+    }
+    if (node.empty() || node.find_first_not_of("0123456789") != std::string::npos
+        || node.size() > 4)
+    {
+        throw ThreadSchedulingException("Invalid NUMA node: '" + node + "'");
+    }
+    return std::stoi(node);
+}
+
+
+std::string NumaTopology::PreferNode(const unsigned int node)
+{
+    const size_t bits = sizeof(unsigned long) * CHAR_BIT;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] = 1UL << (node % bits);
+
+    if (0 != syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(),
+                     mask.size() * bits + 1))
+    {
+        return "Could not prefer the memory of NUMA node "
+               + std::to_string(node) + ": " + std::string(strerror(errno));
+    }
+    return "";
+}
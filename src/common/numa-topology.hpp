@@ -0,0 +1,94 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   numa-topology.hpp
+ *
+ * @brief  NUMA nodes of the system and of network devices, and the
+ *         memory policy of a thread
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+
+
+/**
+ *  Looks up the NUMA topology via sysfs.  On systems without NUMA
+ *  support, there is a single node 0 or no nodes at all.
+ */
+class NumaTopology
+{
+public:
+    /**
+     * @param root  Prefix of the /sys paths, for testing
+     */
+    NumaTopology(const std::string& root = "");
+
+
+    /**
+     * @return Returns the online NUMA nodes; empty if the kernel has no
+     *         NUMA support
+     */
+    std::set<unsigned int> Nodes() const;
+
+
+    /**
+     *  Finds the NUMA node a network interface is attached to
+     *
+     * @param netdev  Name of the network interface
+     *
+     * @return Returns the node, or -1 if the device has no node, like
+     *         virtual devices and devices on single node systems
+     */
+    int DeviceNode(const std::string& netdev) const;
+
+
+    /**
+     * @param node  NUMA node number
+     *
+     * @return Returns the CPUs of a NUMA node; empty if the node does
+     *         not exist
+     */
+    std::set<unsigned int> NodeCPUs(const unsigned int node) const;
+
+
+    /**
+     *  Parses a NUMA node setting, which is either a node number or
+     *  "auto".  Throws ThreadSchedulingException if invalid.
+     *
+     * @return Returns the node, or -1 for "auto"
+     */
+    static int ParseNode(const std::string& node);
+
+
+    /**
+     *  Makes the kernel allocate the memory of the calling thread on a
+     *  NUMA node, as long as it has free memory
+     *
+     * @param node  NUMA node number
+     *
+     * @return Returns an error message; empty on success
+     */
+    static std::string PreferNode(const unsigned int node);
+
+
+private:
+    std::string root;
+};
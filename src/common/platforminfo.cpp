@@ -23,6 +23,11 @@
  * @brief  Provides an API for retrieving OS/platform details
  */
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "platforminfo.hpp"
 
 //
@@ -89,16 +94,139 @@ const std::string PlatformInfo::str() const
     // uname() fallback when D-Bus calls fails
     if (os_name.empty())
     {
-        struct utsname info = {};
-        if (uname(&info) < 0)
+        os_name = UnameStr();
+    }
+    return os_name;
+}
+
+
+const std::string PlatformInfo::UnameStr()
+{
+    struct utsname info = {};
+    if (uname(&info) < 0)
+    {
+        throw PlatformInfoException(
+            "Error retrieving platform information");
+    }
+
+    return std::string("generic:") + std::string(info.sysname) + "/"
+           + std::string(info.release) + "/" + std::string(info.version)
+           + "/" + std::string(info.machine);
+}
+
+
+
+//
+//  Process wide cache of the platform string
+//
+
+namespace {
+struct PlatformCache
+{
+    std::mutex mtx;
+    std::condition_variable ready_cv;
+    bool started = false;
+    bool finished = false;
+    bool ready = false;
+    std::string platform;
+};
+
+PlatformCache& platform_cache()
+{
+    static PlatformCache cache;
+    return cache;
+}
+} // anonymous namespace
+
+
+void PlatformInfo::StartLookup(GDBusConnection *con)
+{
+    PlatformCache& cache = platform_cache();
+    {
+        std::lock_guard<std::mutex> guard(cache.mtx);
+        if (cache.started)
         {
-            throw PlatformInfoException(
-                "Error retrieving platform information");
+            return;
         }
+        cache.started = true;
+    }
 
-        os_name = std::string("generic:") + std::string(info.sysname) + "/"
-                  + std::string(info.release) + "/" + std::string(info.version)
-                  + "/" + std::string(info.machine);
+    if (con)
+    {
+        g_object_ref(con);
     }
-    return os_name;
+    std::thread lookup([con]()
+    {
+        std::string result;
+        try
+        {
+            PlatformInfo plinfo(con);
+            result = plinfo.str();
+        }
+        catch (const std::exception&)
+        {
+            // Leave it empty; GetCached() falls back to uname()
+        }
+        if (con)
+        {
+            g_object_unref(con);
+        }
+
+        PlatformCache& c = platform_cache();
+        std::lock_guard<std::mutex> guard(c.mtx);
+        c.finished = true;
+        if (!c.ready && !result.empty())
+        {
+            c.platform = result;
+            c.ready = true;
+        }
+        c.ready_cv.notify_all();
+    });
+    lookup.detach();
+}
+
+
+void PlatformInfo::SetCached(const std::string& platform)
+{
+    PlatformCache& cache = platform_cache();
+    std::lock_guard<std::mutex> guard(cache.mtx);
+    cache.started = true;
+    cache.platform = platform;
+    cache.ready = true;
+    cache.ready_cv.notify_all();
+}
+
+
+bool PlatformInfo::TryGetCached(std::string& platform)
+{
+    PlatformCache& cache = platform_cache();
+    std::lock_guard<std::mutex> guard(cache.mtx);
+    if (cache.ready)
+    {
+        platform = cache.platform;
+    }
+    return cache.ready;
+}
+
+
+const std::string PlatformInfo::GetCached(const unsigned int timeout_ms)
+{
+    PlatformCache& cache = platform_cache();
+    {
+        std::unique_lock<std::mutex> lock(cache.mtx);
+        if (cache.started)
+        {
+            cache.ready_cv.wait_for(lock,
+                                    std::chrono::milliseconds(timeout_ms),
+                                    [&cache]()
+                                    {
+                                        return cache.ready || cache.finished;
+                                    });
+        }
+        if (cache.ready)
+        {
+            return cache.platform;
+        }
+    }
+    return UnameStr();
 }
@@ -26,6 +26,7 @@
 
 #include <sys/utsname.h>
 #include <exception>
+#include <string>
 
 #include "dbus/core.hpp"
 #include "dbus/proxy.hpp"
@@ -77,6 +78,58 @@ class PlatformInfo : public DBusProxy
      */
     const std::string str() const;
 
+
+    /**
+     *  Starts retrieving the platform string in a background thread.
+     *  The result is kept for the rest of the life time of the process
+     *  and is retrieved with GetCached().  Only the first call starts a
+     *  lookup; later calls do nothing.
+     *
+     *  This avoids blocking on the org.freedesktop.hostname1 service,
+     *  which may need to be activated first.
+     *
+     *  @param con  Pointer to a GDBusConnection to use for the lookup.
+     *              If nullptr, only the uname() details are used.
+     */
+    static void StartLookup(GDBusConnection *con);
+
+    /**
+     *  Provide the platform string from elsewhere, typically from the
+     *  process which started this process.  This makes StartLookup()
+     *  a no-op.
+     *
+     *  @param platform  std::string with the platform string
+     */
+    static void SetCached(const std::string& platform);
+
+    /**
+     *  Retrieve the platform string found by StartLookup() or provided
+     *  by SetCached(), without waiting
+     *
+     *  @param platform  std::string where the platform string is stored
+     *
+     *  @return Returns true if a platform string was available
+     */
+    static bool TryGetCached(std::string& platform);
+
+    /**
+     *  Retrieve the platform string found by StartLookup() or provided
+     *  by SetCached().  If it is not available within the timeout, the
+     *  uname() based platform string is returned instead.
+     *
+     *  @param timeout_ms  Milliseconds to wait for the lookup to complete
+     *
+     *  @return const std::string
+     */
+    static const std::string GetCached(const unsigned int timeout_ms);
+
+    /**
+     *  Return a generic platform string based on the uname() details
+     *
+     *  @return const std::string
+     */
+    static const std::string UnameStr();
+
     /**
      *  ostream << operator for stream printing the PlatformInfo string
      *
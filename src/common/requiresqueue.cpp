@@ -134,6 +134,20 @@ std::string RequiresQueue::IntrospectionMethods(const std::string& meth_qchktype
 }
 
 
+std::string RequiresQueue::IntrospectionBatchMethods(const std::string& meth_queuefetchall,
+                                                     const std::string& meth_provideresps)
+{
+    std::stringstream introspection;
+    introspection << "    <method name='" << meth_queuefetchall << "'>"
+                  << "      <arg type='a(uuussb)' name='slots' direction='out'/>"
+                  << "    </method>"
+                  << "    <method name='" << meth_provideresps << "'>"
+                  << "      <arg type='a(uuus)' name='responses' direction='in'/>"
+                  << "    </method>";
+    return introspection.str();
+}
+
+
 unsigned int RequiresQueue::RequireAdd(ClientAttentionType type,
                                        ClientAttentionGroup group,
                                        std::string name,
@@ -193,6 +207,39 @@ void RequiresQueue::QueueFetch(GDBusMethodInvocation *invocation,
 }
 
 
+std::vector<RequiresSlot> RequiresQueue::QueueFetchAll()
+{
+    std::vector<RequiresSlot> ret;
+    for (const auto& e : slots)
+    {
+        if (!e.provided)
+        {
+            ret.push_back(e);
+        }
+    }
+    return ret;
+}
+
+
+void RequiresQueue::QueueFetchAll(GDBusMethodInvocation *invocation)
+{
+    GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(uuussb)"));
+    for (const auto& e : QueueFetchAll())
+    {
+        g_variant_builder_add(bld, "(uuussb)",
+                              (unsigned int) e.type,
+                              (unsigned int) e.group,
+                              e.id,
+                              e.name.c_str(),
+                              e.user_description.c_str(),
+                              e.hidden_input);
+    }
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(a(uuussb))", bld));
+    g_variant_builder_unref(bld);
+}
+
+
 void RequiresQueue::UpdateEntry(ClientAttentionType type,
                                 ClientAttentionGroup group,
                                 unsigned int id, std::string newvalue)
@@ -253,6 +300,78 @@ void RequiresQueue::UpdateEntry(GDBusMethodInvocation *invocation,
 }
 
 
+void RequiresQueue::UpdateEntries(const std::vector<RequiresSlot>& responses)
+{
+    // Look up all the slots first, so nothing is modified if
+    // any of the responses is invalid
+    std::vector<RequiresSlot *> targets;
+    for (const auto& r : responses)
+    {
+        RequiresSlot *slot = nullptr;
+        for (auto& e : slots)
+        {
+            if (e.type == r.type && e.group == r.group && e.id == r.id)
+            {
+                slot = &e;
+                break;
+            }
+        }
+        if (!slot)
+        {
+            throw RequiresQueueException("net.openvpn.v3.invalid-input",
+                                         "No matching entry found in the request queue");
+        }
+        if (slot->provided
+            || std::find(targets.begin(), targets.end(), slot) != targets.end())
+        {
+            throw RequiresQueueException("net.openvpn.v3.error.input-already-provided",
+                                         "Request ID " + std::to_string(r.id)
+                                         + " has already been provided");
+        }
+        targets.push_back(slot);
+    }
+
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        targets[i]->value = responses[i].value;
+        targets[i]->provided = true;
+    }
+}
+
+
+void RequiresQueue::UpdateEntries(GDBusMethodInvocation *invocation,
+                                  GVariant *indata)
+{
+    GVariantIter *resps = nullptr;
+    g_variant_get(indata, "(a(uuus))", &resps);
+
+    std::vector<RequiresSlot> responses;
+    guint32 type = 0;
+    guint32 group = 0;
+    guint32 id = 0;
+    gchar *value = nullptr;
+    while (g_variant_iter_next(resps, "(uuus)", &type, &group, &id, &value))
+    {
+        RequiresSlot r;
+        r.type = (ClientAttentionType) type;
+        r.group = (ClientAttentionGroup) group;
+        r.id = id;
+        r.value = std::string(value);
+        g_free(value);
+        responses.push_back(r);
+    }
+    g_variant_iter_free(resps);
+
+    if (responses.empty())
+    {
+        throw RequiresQueueException("net.openvpn.v3.error.invalid-input",
+                                     "No responses provided");
+    }
+    UpdateEntries(responses);
+    g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+
 void RequiresQueue::ResetValue(ClientAttentionType type,
                                ClientAttentionGroup group, unsigned int id)
 {
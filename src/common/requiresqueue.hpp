@@ -137,6 +137,22 @@ public:
                                             const std::string& meth_queuechk,
                                             const std::string& meth_provideresp);
 
+    /**
+     * Returns a string containing a D-Bus introspection section for the
+     * batched RequiresQueue methods.  These allow a front-end to retrieve
+     * all unresolved requirements and to provide several responses in
+     * a single D-Bus call each.
+     *
+     * @param meth_queuefetchall  A string with the method name for fetching
+     *                            all unprocessed queued elements
+     * @param meth_provideresps   A string with the method name for providing
+     *                            several user responses at once
+     *
+     * @return  Returns a string with the <method/> tags of these methods
+     */
+    static std::string IntrospectionBatchMethods(const std::string& meth_queuefetchall,
+                                                 const std::string& meth_provideresps);
+
     /**
      * Adds a user request requirement to the queue.
      *
@@ -170,6 +186,25 @@ public:
     void QueueFetch(GDBusMethodInvocation *invocation, GVariant *parameters);
 
 
+    /**
+     *  Retrieve all requires slots which have not received any user
+     *  responses yet, regardless of their type and group.
+     *
+     * @return Returns a std::vector<RequiresSlot> of the unresolved slots,
+     *         in the order they were added.
+     */
+    std::vector<RequiresSlot> QueueFetchAll();
+
+
+    /**
+     *  D-Bus wrapper around @QueueFetchAll().  Returns all the unresolved
+     *  slots as an array of the same tuples QueueFetch() returns.
+     *
+     * @param invocation  Pointer to the current GDBusMethodInvocation object
+     */
+    void QueueFetchAll(GDBusMethodInvocation *invocation);
+
+
     /**
      *  Updates a RequiresSlot element via D-Bus.  This method is intended
      *  to be called by D-Bus method callback function where both the
@@ -211,6 +246,34 @@ public:
     void UpdateEntry(GDBusMethodInvocation *invocation, GVariant *indata);
 
 
+    /**
+     *  Updates several RequiresSlot elements at once.  All the responses
+     *  are checked before any of them is stored, so if one of them is
+     *  invalid none of the slots are modified.
+     *
+     *  If the update fails, it will throw a RequiresQueueException error
+     *  with the proper details.
+     *
+     *  @param responses  std::vector<RequiresSlot> with the type, group, id
+     *                    and value of each response
+     */
+    void UpdateEntries(const std::vector<RequiresSlot>& responses);
+
+
+    /**
+     *  D-Bus variant of UpdateEntries().  The GVariant object must contain
+     *  an array of (type, group, id, value) tuples - (a(uuus)).
+     *
+     *  On success it will return an empty and successful D-Bus response.
+     *
+     *  @params invocation The GDBus invocation object, which will contain the
+     *                     response on success.
+     *  @params indata     A GVariant object containing the input data from
+     *                     the D-Bus call
+     */
+    void UpdateEntries(GDBusMethodInvocation *invocation, GVariant *indata);
+
+
     /**
      * Resets the value and the provided flag of an item already provided
      * element
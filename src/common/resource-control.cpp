@@ -0,0 +1,157 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   resource-control.cpp
+ *
+ * @brief  CPU, IO and memory resource control settings of a process,
+ *         applied via the cgroup of its systemd scope unit
+ */
+
+#include <cstdint>
+#include <sstream>
+
+#include "resource-control.hpp"
+
+
+static uint64_t parse_weight(const std::string& str, const std::string& what)
+{
+    if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos
+        || str.size() > 5)
+    {
+        throw ResourceControlException("Invalid " + what + ": '" + str + "'");
+    }
+    uint64_t w = std::stoul(str);
+    if (w < 1 || w > 10000)
+    {
+        throw ResourceControlException(what + " must be between 1 and 10000");
+    }
+    return w;
+}
+
+
+uint64_t ResourceControl::ParseSize(const std::string& size)
+{
+    size_t digits = size.find_first_not_of("0123456789");
+    if (size.empty() || 0 == digits)
+    {
+        throw ResourceControlException("Invalid size: '" + size + "'");
+    }
+
+    unsigned int shift = 0;
+    if (std::string::npos != digits)
+    {
+        const std::string suffix = size.substr(digits);
+        if ("K" == suffix)
+        {
+            shift = 10;
+        }
+        else if ("M" == suffix)
+        {
+            shift = 20;
+        }
+        else if ("G" == suffix)
+        {
+            shift = 30;
+        }
+        else if ("T" == suffix)
+        {
+            shift = 40;
+        }
+        else
+        {
+            throw ResourceControlException("Invalid size: '" + size + "'");
+        }
+    }
+
+    const std::string num = size.substr(0, digits);
+    if (num.size() > 19)
+    {
+        throw ResourceControlException("Invalid size: '" + size + "'");
+    }
+    uint64_t val = std::stoull(num);
+    if (0 == val || val > (UINT64_MAX >> shift))
+    {
+        throw ResourceControlException("Invalid size: '" + size + "'");
+    }
+    return val << shift;
+}
+
+
+void ResourceControl::SetCPUWeight(const std::string& weight)
+{
+    cpu_weight = parse_weight(weight, "CPU weight");
+}
+
+
+void ResourceControl::SetIOWeight(const std::string& weight)
+{
+    io_weight = parse_weight(weight, "IO weight");
+}
+
+
+void ResourceControl::SetMemoryHigh(const std::string& size)
+{
+    memory_high = ParseSize(size);
+}
+
+
+void ResourceControl::SetMemoryMax(const std::string& size)
+{
+    memory_max = ParseSize(size);
+}
+
+
+void ResourceControl::Merge(const ResourceControl& other)
+{
+    for (auto field : {&ResourceControl::cpu_weight,
+                       &ResourceControl::io_weight,
+                       &ResourceControl::memory_high,
+                       &ResourceControl::memory_max})
+    {
+        if (other.*field > 0)
+        {
+            this->*field = other.*field;
+        }
+    }
+}
+
+
+bool ResourceControl::empty() const noexcept
+{
+    return 0 == cpu_weight && 0 == io_weight
+           && 0 == memory_high && 0 == memory_max;
+}
+
+
+std::string ResourceControl::str() const
+{
+    std::stringstream s;
+    auto add = [&s](const std::string& name, uint64_t value)
+               {
+                   if (value > 0)
+                   {
+                       s << (s.tellp() > 0 ? ", " : "") << name << "=" << value;
+                   }
+               };
+    add("CPUWeight", cpu_weight);
+    add("IOWeight", io_weight);
+    add("MemoryHigh", memory_high);
+    add("MemoryMax", memory_max);
+    return (s.tellp() > 0 ? s.str() : "defaults");
+}
@@ -0,0 +1,151 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   resource-control.hpp
+ *
+ * @brief  CPU, IO and memory resource control settings of a process,
+ *         applied via the cgroup of its systemd scope unit
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <string>
+
+
+class ResourceControlException : public std::exception
+{
+public:
+    ResourceControlException(const std::string& msg)
+        : message(msg)
+    {
+    }
+
+    const char* what() const noexcept
+    {
+        return message.c_str();
+    }
+
+private:
+    std::string message;
+};
+
+
+
+/**
+ *  Resource control settings, using the names and ranges of the
+ *  systemd resource control properties.  Only the settings which have
+ *  been set are applied; everything else keeps the systemd defaults.
+ */
+class ResourceControl
+{
+public:
+    ResourceControl() = default;
+
+    /**
+     *  Set the share of CPU time relative to other processes
+     *
+     * @param weight  std::string with a value between 1 and 10000;
+     *                the default weight is 100
+     *
+     * @throws ResourceControlException on invalid values
+     */
+    void SetCPUWeight(const std::string& weight);
+
+    /**
+     *  Set the share of block IO relative to other processes
+     *
+     * @param weight  std::string with a value between 1 and 10000;
+     *                the default weight is 100
+     *
+     * @throws ResourceControlException on invalid values
+     */
+    void SetIOWeight(const std::string& weight);
+
+    /**
+     *  Set the memory usage above which the processes are throttled
+     *  and their memory is reclaimed aggressively
+     *
+     * @param size  std::string with a size in bytes, optionally with a
+     *              K, M, G or T suffix
+     *
+     * @throws ResourceControlException on invalid values
+     */
+    void SetMemoryHigh(const std::string& size);
+
+    /**
+     *  Set the hard memory limit; the processes are killed by the
+     *  out-of-memory killer above it
+     *
+     * @param size  std::string with a size in bytes, optionally with a
+     *              K, M, G or T suffix
+     *
+     * @throws ResourceControlException on invalid values
+     */
+    void SetMemoryMax(const std::string& size);
+
+    /**
+     *  Take over all settings the other object has set, keeping the
+     *  settings of this object which are not set in the other object.
+     */
+    void Merge(const ResourceControl& other);
+
+    bool empty() const noexcept;
+
+    /**
+     *  Human readable summary of the settings, for log messages
+     */
+    std::string str() const;
+
+    uint64_t GetCPUWeight() const noexcept
+    {
+        return cpu_weight;
+    }
+
+    uint64_t GetIOWeight() const noexcept
+    {
+        return io_weight;
+    }
+
+    uint64_t GetMemoryHigh() const noexcept
+    {
+        return memory_high;
+    }
+
+    uint64_t GetMemoryMax() const noexcept
+    {
+        return memory_max;
+    }
+
+    /**
+     *  Parses a size like "512M" into bytes.  The suffixes are base 1024.
+     *
+     * @throws ResourceControlException on invalid values
+     */
+    static uint64_t ParseSize(const std::string& size);
+
+
+private:
+    // 0 is not a valid value for any of these and means not set
+    uint64_t cpu_weight = 0;
+    uint64_t io_weight = 0;
+    uint64_t memory_high = 0;
+    uint64_t memory_max = 0;
+};
@@ -0,0 +1,140 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   startup-timing.hpp
+ *
+ * @brief  Records when a service passes the phases of its start-up,
+ *         from process creation until the bus name is acquired
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "connect-timing.hpp"
+
+
+/**
+ *  Process wide start-up timeline.  The first milestone is the time
+ *  the kernel created the process, followed by the phases the service
+ *  marks while starting.  The DBus class marks the D-Bus related phases
+ *  and completes the timeline once the bus name has been acquired.
+ *
+ *  The timestamps use the same CLOCK_MONOTONIC microseconds as
+ *  ConnectTiming, so the timelines of different services can be
+ *  compared with each other.
+ */
+class StartupTiming : public ConnectTiming
+{
+public:
+    static StartupTiming& Instance()
+    {
+        static StartupTiming timing;
+        return timing;
+    }
+
+
+    /**
+     *  Marks the start-up as completed.  Only the first call counts.
+     *
+     * @return Returns true the first time it is called, which is when
+     *         the caller should log the timeline
+     */
+    bool Complete()
+    {
+        if (completed.exchange(true))
+        {
+            return false;
+        }
+        Mark("startup_complete");
+        return true;
+    }
+
+
+    /**
+     *  Retrieve the time the kernel created this process
+     *
+     * @param statfile  Path to the proc stat file to parse
+     *
+     * @return Returns a CLOCK_MONOTONIC timestamp in microseconds, or 0
+     *         if it could not be determined
+     */
+    static uint64_t ProcessStartTime(const std::string& statfile = "/proc/self/stat")
+    {
+        std::ifstream f(statfile);
+        std::string line;
+        if (!f || !std::getline(f, line))
+        {
+            return 0;
+        }
+
+        // The process name in field 2 may contain spaces and parentheses;
+        // the starttime is the 20th field after its closing parenthesis
+        size_t p = line.rfind(')');
+        if (std::string::npos == p)
+        {
+            return 0;
+        }
+        std::istringstream fields(line.substr(p + 1));
+        std::string field;
+        for (unsigned int i = 0; i < 19 && (fields >> field); ++i)
+        {
+        }
+        uint64_t ticks = 0;
+        long hz = sysconf(_SC_CLK_TCK);
+        if (!(fields >> ticks) || hz <= 0)
+        {
+            return 0;
+        }
+
+        // starttime counts from boot including suspended time, which
+        // CLOCK_BOOTTIME does as well; the difference to now is then
+        // applied to the monotonic clock
+        struct timespec bt = {};
+        clock_gettime(CLOCK_BOOTTIME, &bt);
+        uint64_t boot_now = (uint64_t) bt.tv_sec * 1000000 + bt.tv_nsec / 1000;
+        uint64_t started = ticks * 1000000 / hz;
+        uint64_t now = Now();
+        if (started > boot_now || (boot_now - started) >= now)
+        {
+            return 0;
+        }
+        return now - (boot_now - started);
+    }
+
+
+private:
+    std::atomic<bool> completed{false};
+
+    StartupTiming()
+    {
+        uint64_t ts = ProcessStartTime();
+        if (ts > 0)
+        {
+            Mark("process_start", ts);
+        }
+    }
+};
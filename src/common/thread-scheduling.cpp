@@ -0,0 +1,298 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   thread-scheduling.cpp
+ *
+ * @brief  CPU affinity and scheduling settings for a single thread
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "thread-scheduling.hpp"
+
+
+static unsigned int parse_uint(const std::string& str, const std::string& what)
+{
+    if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos
+        || str.size() > 5)
+    {
+        throw ThreadSchedulingException("Invalid " + what + ": '" + str + "'");
+    }
+    return std::stoul(str);
+}
+
+
+void ThreadScheduling::SetCPUs(const std::string& cpulist)
+{
+    std::set<unsigned int> result;
+    std::stringstream list(cpulist);
+    std::string range;
+    while (std::getline(list, range, ','))
+    {
+        size_t dash = range.find('-');
+        if (std::string::npos == dash)
+        {
+            result.insert(parse_uint(range, "CPU number"));
+            continue;
+        }
+        unsigned int first = parse_uint(range.substr(0, dash), "CPU number");
+        unsigned int last = parse_uint(range.substr(dash + 1), "CPU number");
+        if (first > last)
+        {
+            throw ThreadSchedulingException("Invalid CPU range: '"
+                                            + range + "'");
+        }
+        for (unsigned int c = first; c <= last; ++c)
+        {
+            result.insert(c);
+        }
+    }
+    if (result.empty())
+    {
+        throw ThreadSchedulingException("Empty CPU list");
+    }
+    if (*result.rbegin() >= CPU_SETSIZE)
+    {
+        throw ThreadSchedulingException("CPU number too large: "
+                                        + std::to_string(*result.rbegin()));
+    }
+    cpus = result;
+}
+
+
+void ThreadScheduling::SetNice(const std::string& value)
+{
+    bool negative = (!value.empty() && '-' == value[0]);
+    int n = (int) parse_uint(negative ? value.substr(1) : value, "nice value");
+    n = (negative ? -n : n);
+    if (n < -20 || n > 19)
+    {
+        throw ThreadSchedulingException("Nice value out of range: " + value);
+    }
+    nice = n;
+    nice_set = true;
+}
+
+
+void ThreadScheduling::SetPolicy(const std::string& value)
+{
+    std::string name = value;
+    int prio = 0;
+    size_t colon = value.find(':');
+    if (std::string::npos != colon)
+    {
+        name = value.substr(0, colon);
+        prio = (int) parse_uint(value.substr(colon + 1), "scheduling priority");
+    }
+
+    int pol = -1;
+    if ("other" == name)
+    {
+        pol = SCHED_OTHER;
+    }
+    else if ("batch" == name)
+    {
+        pol = SCHED_BATCH;
+    }
+    else if ("idle" == name)
+    {
+        pol = SCHED_IDLE;
+    }
+    else if ("fifo" == name)
+    {
+        pol = SCHED_FIFO;
+    }
+    else if ("rr" == name)
+    {
+        pol = SCHED_RR;
+    }
+    else
+    {
+        throw ThreadSchedulingException("Unknown scheduling policy: '"
+                                        + name + "'");
+    }
+
+    if (SCHED_FIFO == pol || SCHED_RR == pol)
+    {
+        prio = (0 == prio ? 1 : prio);
+        if (prio < sched_get_priority_min(pol)
+            || prio > sched_get_priority_max(pol))
+        {
+            throw ThreadSchedulingException("Scheduling priority out of range: "
+                                            + value);
+        }
+    }
+    else if (0 != prio)
+    {
+        throw ThreadSchedulingException("A priority can only be used with "
+                                        "the fifo and rr policies");
+    }
+
+    policy = pol;
+    policy_name = name;
+    priority = prio;
+}
+
+
+void ThreadScheduling::SetTimerSlack(const std::chrono::microseconds slack)
+{
+    if (slack.count() <= 0 || slack > std::chrono::seconds(10))
+    {
+        throw ThreadSchedulingException("Timer slack out of range: "
+                                        + std::to_string(slack.count())
+                                        + "us");
+    }
+    timer_slack = slack;
+}
+
+
+void ThreadScheduling::Merge(const ThreadScheduling& other)
+{
+    if (!other.cpus.empty())
+    {
+        cpus = other.cpus;
+    }
+    if (other.nice_set)
+    {
+        nice = other.nice;
+        nice_set = true;
+    }
+    if (other.policy >= 0)
+    {
+        policy = other.policy;
+        policy_name = other.policy_name;
+        priority = other.priority;
+    }
+    if (other.timer_slack.count() > 0)
+    {
+        timer_slack = other.timer_slack;
+    }
+}
+
+
+bool ThreadScheduling::empty() const noexcept
+{
+    return cpus.empty() && !nice_set && policy < 0
+           && 0 == timer_slack.count();
+}
+
+
+std::vector<std::string> ThreadScheduling::ApplyToCurrentThread() const
+{
+    std::vector<std::string> errors;
+
+    if (!cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (const auto& c : cpus)
+        {
+            CPU_SET(c, &set);
+        }
+        int r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (0 != r)
+        {
+            errors.push_back("Could not set CPU affinity: "
+                             + std::string(strerror(r)));
+        }
+    }
+
+    if (policy >= 0)
+    {
+        struct sched_param param = {};
+        param.sched_priority = priority;
+        int r = pthread_setschedparam(pthread_self(), policy, &param);
+        if (0 != r)
+        {
+            errors.push_back("Could not set scheduling policy: "
+                             + std::string(strerror(r)));
+        }
+    }
+
+    if (nice_set)
+    {
+        // On Linux the nice value is a per-thread attribute when
+        // addressed by the thread ID
+        pid_t tid = (pid_t) syscall(SYS_gettid);
+        if (0 != setpriority(PRIO_PROCESS, tid, nice))
+        {
+            errors.push_back("Could not set nice value: "
+                             + std::string(strerror(errno)));
+        }
+    }
+
+    if (timer_slack.count() > 0)
+    {
+        // The timer slack is per-thread and inherited by the threads
+        // created by this thread
+        unsigned long ns = (unsigned long) timer_slack.count() * 1000;
+        if (0 != prctl(PR_SET_TIMERSLACK, ns, 0, 0, 0))
+        {
+            errors.push_back("Could not set timer slack: "
+                             + std::string(strerror(errno)));
+        }
+    }
+    return errors;
+}
+
+
+std::string ThreadScheduling::str() const
+{
+    std::stringstream r;
+    if (!cpus.empty())
+    {
+        r << "cpus=";
+        bool first = true;
+        for (const auto& c : cpus)
+        {
+            r << (first ? "" : ",") << c;
+            first = false;
+        }
+        r << " ";
+    }
+    if (nice_set)
+    {
+        r << "nice=" << nice << " ";
+    }
+    if (policy >= 0)
+    {
+        r << "policy=" << policy_name;
+        if (priority > 0)
+        {
+            r << ":" << priority;
+        }
+        r << " ";
+    }
+    if (timer_slack.count() > 0)
+    {
+        r << "timer-slack=" << timer_slack.count() << "us ";
+    }
+    std::string ret = r.str();
+    return (ret.empty() ? "default" : ret.substr(0, ret.size() - 1));
+}
@@ -0,0 +1,140 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   thread-scheduling.hpp
+ *
+ * @brief  CPU affinity and scheduling settings for a single thread
+ */
+
+#pragma once
+
+#include <chrono>
+#include <exception>
+#include <set>
+#include <string>
+#include <vector>
+
+
+class ThreadSchedulingException : public std::exception
+{
+public:
+    ThreadSchedulingException(const std::string& msg)
+        : message(msg)
+    {
+    }
+
+    const char* what() const noexcept
+    {
+        return message.c_str();
+    }
+
+private:
+    std::string message;
+};
+
+
+
+/**
+ *  CPU affinity, nice value, scheduling policy and timer slack to apply
+ *  to a thread.
+ *  Only the settings which have been set are changed; everything else
+ *  is inherited from the thread creating it.
+ */
+class ThreadScheduling
+{
+public:
+    ThreadScheduling() = default;
+
+    /**
+     *  Set the CPUs the thread may run on
+     *
+     * @param cpulist  std::string with a CPU list, like "2" or "0-3,6"
+     *
+     * @throws ThreadSchedulingException on invalid CPU lists
+     */
+    void SetCPUs(const std::string& cpulist);
+
+    /**
+     *  Set the nice value of the thread
+     *
+     * @param nice  std::string with a value between -20 and 19
+     *
+     * @throws ThreadSchedulingException on invalid values
+     */
+    void SetNice(const std::string& nice);
+
+    /**
+     *  Set the scheduling policy of the thread
+     *
+     * @param policy  std::string with "other", "batch", "idle", "fifo"
+     *                or "rr", optionally followed by ":PRIORITY" for the
+     *                "fifo" and "rr" real-time policies (default 1)
+     *
+     * @throws ThreadSchedulingException on invalid values
+     */
+    void SetPolicy(const std::string& policy);
+
+    /**
+     *  Set the timer slack of the thread.  The kernel may delay the
+     *  expiry of the timeouts of the thread by up to this amount, to
+     *  group the wake-ups with those of other timers.
+     *
+     * @param slack  Timer slack, at most 10 seconds
+     *
+     * @throws ThreadSchedulingException on invalid values
+     */
+    void SetTimerSlack(const std::chrono::microseconds slack);
+
+    /**
+     *  Take over all settings the other object has set, keeping the
+     *  settings of this object which are not set in the other object.
+     */
+    void Merge(const ThreadScheduling& other);
+
+    bool empty() const noexcept;
+
+    /**
+     *  Apply the settings to the calling thread.  All settings are
+     *  attempted, even if some of them fail.
+     *
+     * @return Returns a list of error messages; empty on success
+     */
+    std::vector<std::string> ApplyToCurrentThread() const;
+
+    /**
+     *  Human readable summary of the settings, for log messages
+     */
+    std::string str() const;
+
+    const std::set<unsigned int>& GetCPUs() const noexcept
+    {
+        return cpus;
+    }
+
+
+private:
+    std::set<unsigned int> cpus;
+    bool nice_set = false;
+    int nice = 0;
+    int policy = -1;
+    std::string policy_name;
+    int priority = 0;
+    std::chrono::microseconds timer_slack{0};
+};
@@ -23,8 +23,53 @@
  * @brief  Simple functions for retriveving time/date related information
  */
 
-#include <sstream>
-#include <iomanip>
+#include <stdexcept>
+
+#include "timestamp.hpp"
+
+
+/**
+ *  Writes a zero padded decimal number into a fixed width field
+ *
+ * @param dst    char pointer to the first character of the field
+ * @param width  Number of characters in the field
+ * @param val    Value to write
+ */
+static inline void put_digits(char *dst, int width, unsigned long val)
+{
+    for (int i = width - 1; i >= 0; --i)
+    {
+        dst[i] = '0' + (val % 10);
+        val /= 10;
+    }
+}
+
+
+/**
+ *  Renders "YYYY-MM-DD HH:MM:SS" into the first 19 characters of dst
+ *
+ * @param dst  char pointer to a buffer with room for 19 characters
+ * @param t    time_t value to convert, using the local time zone
+ */
+static void render_datetime(char *dst, const time_t t)
+{
+    tm ltm = {};
+    localtime_r(&t, &ltm);
+
+    put_digits(dst, 4, 1900 + ltm.tm_year);
+    dst[4] = '-';
+    put_digits(dst + 5, 2, 1 + ltm.tm_mon);
+    dst[7] = '-';
+    put_digits(dst + 8, 2, ltm.tm_mday);
+    dst[10] = ' ';
+    put_digits(dst + 11, 2, ltm.tm_hour);
+    dst[13] = ':';
+    put_digits(dst + 14, 2, ltm.tm_min);
+    dst[16] = ':';
+    put_digits(dst + 17, 2, ltm.tm_sec);
+}
+
+static const size_t datetime_len = 19;
 
 
 /**
@@ -35,16 +80,112 @@
  */
 std::string GetTimestamp()
 {
-    time_t now = time(0);
-    tm *ltm = localtime(&now);
-
-    std::stringstream ret;
-    ret << 1900 + ltm->tm_year
-        << "-" << std::setw(2) << std::setfill('0') << 1 + ltm->tm_mon
-        << "-" << std::setw(2) << std::setfill('0') << ltm->tm_mday
-        << " " << std::setw(2) << std::setfill('0') << ltm->tm_hour
-        << ":" << std::setw(2) << std::setfill('0') << ltm->tm_min
-        << ":" << std::setw(2) << std::setfill('0') << ltm->tm_sec
-        << " ";
-    return ret.str();
+    return GetTimestamp(time(0));
+}
+
+
+/**
+ *  Get a timestamp of a specific date and time, in the same format
+ *  as GetTimestamp()
+ *
+ * @param t  time_t value to convert
+ *
+ * @return  Returns a string with the date and time
+ */
+std::string GetTimestamp(const time_t t)
+{
+    std::string ret(datetime_len + 1, ' ');
+    render_datetime(&ret[0], t);
+    return ret;
+}
+
+
+
+//
+//  TimestampFormatter - implementation
+//
+
+TimestampFormatter::TimestampFormatter(const Precision prec)
+{
+    SetPrecision(prec);
+}
+
+
+void TimestampFormatter::SetPrecision(const Precision prec)
+{
+    precision = prec;
+    switch (precision)
+    {
+    case Precision::SECONDS:
+        buffer.assign(datetime_len + 1, ' ');
+        break;
+    case Precision::MILLISECONDS:
+        buffer.assign(datetime_len + 5, ' ');
+        buffer[datetime_len] = '.';
+        break;
+    case Precision::MICROSECONDS:
+        buffer.assign(datetime_len + 8, ' ');
+        buffer[datetime_len] = '.';
+        break;
+    }
+    cached_second = -1;
+}
+
+
+TimestampFormatter::Precision TimestampFormatter::GetPrecision() const noexcept
+{
+    return precision;
+}
+
+
+const std::string& TimestampFormatter::Format(const std::chrono::system_clock::time_point& t)
+{
+    using namespace std::chrono;
+
+    auto usecs = duration_cast<microseconds>(t.time_since_epoch()).count();
+    time_t sec = usecs / 1000000;
+    long frac = usecs % 1000000;
+    if (frac < 0)
+    {
+        // Before the epoch; round towards the earlier second
+        --sec;
+        frac += 1000000;
+    }
+
+    if (sec != cached_second)
+    {
+        render_datetime(&buffer[0], sec);
+        cached_second = sec;
+    }
+
+    switch (precision)
+    {
+    case Precision::SECONDS:
+        break;
+    case Precision::MILLISECONDS:
+        put_digits(&buffer[datetime_len + 1], 3, frac / 1000);
+        break;
+    case Precision::MICROSECONDS:
+        put_digits(&buffer[datetime_len + 1], 6, frac);
+        break;
+    }
+    return buffer;
+}
+
+
+TimestampFormatter::Precision TimestampFormatter::ParsePrecision(const std::string& name)
+{
+    if ("s" == name)
+    {
+        return Precision::SECONDS;
+    }
+    else if ("ms" == name)
+    {
+        return Precision::MILLISECONDS;
+    }
+    else if ("us" == name)
+    {
+        return Precision::MICROSECONDS;
+    }
+    throw std::invalid_argument("Invalid timestamp precision: " + name);
 }
@@ -26,4 +26,67 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
 std::string GetTimestamp();
+std::string GetTimestamp(const time_t t);
+
+
+/**
+ *  Renders timestamps in the same format as GetTimestamp(), for callers
+ *  producing a lot of them, like the log writers.
+ *
+ *  The date and time part is only rebuilt when the second changes; all
+ *  other calls only copy in the sub-second part, if enabled.  This
+ *  avoids the localtime() call and any string stream formatting for
+ *  most of the log lines.
+ *
+ *  An object is not thread-safe; each writer needs its own.
+ */
+class TimestampFormatter
+{
+public:
+    enum class Precision : uint8_t
+    {
+        SECONDS,       /**< YYYY-MM-DD HH:MM:SS         */
+        MILLISECONDS,  /**< YYYY-MM-DD HH:MM:SS.mmm     */
+        MICROSECONDS   /**< YYYY-MM-DD HH:MM:SS.uuuuuu  */
+    };
+
+    TimestampFormatter(const Precision precision = Precision::SECONDS);
+
+    void SetPrecision(const Precision precision);
+    Precision GetPrecision() const noexcept;
+
+
+    /**
+     *  Get the timestamp for a specific point in time.  As with
+     *  GetTimestamp(), it ends with a space.
+     *
+     * @param t  std::chrono::system_clock::time_point to render
+     *
+     * @return Returns a reference to the rendered string.  It is valid
+     *         until the next call.
+     */
+    const std::string& Format(const std::chrono::system_clock::time_point& t);
+
+
+    /**
+     *  Converts a precision name to a Precision value
+     *
+     * @param name  std::string with "s", "ms" or "us"
+     *
+     * @return Returns the Precision.  Throws std::invalid_argument on
+     *         unknown values.
+     */
+    static Precision ParsePrecision(const std::string& name);
+
+
+private:
+    Precision precision;
+    time_t cached_second = -1;
+    std::string buffer;   ///< "YYYY-MM-DD HH:MM:SS" + sub-seconds + " "
+};
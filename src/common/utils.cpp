@@ -23,8 +23,12 @@
 #include <cstring>
 #include <stdexcept>
 #include <algorithm>
+#include <vector>
 
+#include <cerrno>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <grp.h>
 #include <pwd.h>
@@ -198,3 +202,78 @@ void set_console_echo(bool echo)
     }
     tcsetattr(STDIN_FILENO, TCSANOW, &console);
 }
+
+
+/**
+ *  Replaces the contents of a file, so that a crash at any point leaves
+ *  either the complete old or the complete new file behind.  The data
+ *  is written to a temporary file in the same directory, flushed to
+ *  disk and then renamed over the old file.
+ *
+ * @param fname    std::string with the file to write
+ * @param content  std::string with the new file content
+ * @param mode     File access mode of the new file
+ *
+ * @throws std::runtime_error on errors.  The old file is then untouched.
+ */
+void write_file_atomic(const std::string& fname, const std::string& content,
+                       const mode_t mode)
+{
+    std::string tmpname = fname + ".XXXXXX";
+    std::vector<char> tmpl(tmpname.begin(), tmpname.end());
+    tmpl.push_back('\0');
+
+    int fd = mkostemp(tmpl.data(), O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not create temporary file for "
+                                 + fname + ": " + strerror(errno));
+    }
+
+    const char *p = content.data();
+    size_t remain = content.size();
+    int err = 0;
+    if (0 != fchmod(fd, mode))
+    {
+        err = errno;
+    }
+    while (0 == err && remain > 0)
+    {
+        ssize_t r = write(fd, p, remain);
+        if (r < 0)
+        {
+            err = (EINTR == errno ? 0 : errno);
+            continue;
+        }
+        p += r;
+        remain -= r;
+    }
+    if (0 == err && 0 != fsync(fd))
+    {
+        err = errno;
+    }
+    if (0 != close(fd) && 0 == err)
+    {
+        err = errno;
+    }
+    if (0 == err && 0 != rename(tmpl.data(), fname.c_str()))
+    {
+        err = errno;
+    }
+    if (0 != err)
+    {
+        unlink(tmpl.data());
+        throw std::runtime_error("Could not write " + fname + ": "
+                                 + strerror(err));
+    }
+
+    // Make the rename itself durable
+    std::string dir = fname.substr(0, fname.rfind('/') + 1);
+    int dirfd = open((dir.empty() ? "." : dir.c_str()),
+                     O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd >= 0)
+    {
+        fsync(dirfd);
+        close(dirfd);
+    }
+}
@@ -25,6 +25,9 @@
 
 #pragma once
 
+#include <string>
+#include <sys/types.h>
+
 const char * package_version();
 
 void drop_root();
@@ -32,6 +35,8 @@ std::string get_version(std::string component);
 const std::string get_guiversion();
 int stop_handler(void *loop);
 void set_console_echo(bool echo);
+void write_file_atomic(const std::string& fname, const std::string& content,
+                       const mode_t mode = 0600);
 
 static inline std::string simple_basename(const std::string filename)
 {
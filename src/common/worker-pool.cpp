@@ -0,0 +1,174 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   worker-pool.cpp
+ *
+ * @brief  Implementation of WorkerPool
+ */
+
+#include <exception>
+
+#include "worker-pool.hpp"
+
+
+//
+//  WorkerPool::Strand
+//
+
+void WorkerPool::Strand::Post(Task task)
+{
+    if (pool.threads.empty())
+    {
+        pool.run_task(task);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lg(pool.mtx);
+    tasks.push_back(std::move(task));
+    ++pool.pending;
+    if (!scheduled)
+    {
+        scheduled = true;
+        pool.ready.push_back(shared_from_this());
+        pool.cv.notify_one();
+    }
+}
+
+
+size_t WorkerPool::Strand::GetPending() const
+{
+    std::lock_guard<std::mutex> lg(pool.mtx);
+    return tasks.size();
+}
+
+
+
+//
+//  WorkerPool
+//
+
+WorkerPool::WorkerPool(const unsigned int thread_count, ErrorHandler on_error)
+    : on_error(std::move(on_error))
+{
+    for (unsigned int i = 0; i < thread_count; i++)
+    {
+        threads.emplace_back(&WorkerPool::worker, this);
+    }
+}
+
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+}
+
+
+WorkerPool::Strand::Ptr WorkerPool::NewStrand()
+{
+    return std::make_shared<Strand>(*this);
+}
+
+
+void WorkerPool::Post(Task task)
+{
+    // A Strand of its own lets the operation run in parallel with
+    // any other one, in the order it was posted
+    NewStrand()->Post(std::move(task));
+}
+
+
+size_t WorkerPool::GetPending() const
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    return pending;
+}
+
+
+void WorkerPool::worker()
+{
+    std::unique_lock<std::mutex> lk(mtx);
+    while (true)
+    {
+        cv.wait(lk, [this]()
+                    {
+                        return stopping || !ready.empty();
+                    });
+        if (ready.empty())
+        {
+            // Only reached when stopping with nothing left to run
+            return;
+        }
+
+        // A Strand is only in the ready queue once, so no other
+        // thread will run an operation from it until it is re-queued
+        Strand::Ptr strand = ready.front();
+        ready.pop_front();
+        Task task = std::move(strand->tasks.front());
+        strand->tasks.pop_front();
+        --pending;
+
+        lk.unlock();
+        run_task(task);
+        lk.lock();
+
+        // Re-queue the Strand at the end, so a Strand with many queued
+        // operations does not starve the others
+        if (strand->tasks.empty())
+        {
+            strand->scheduled = false;
+        }
+        else
+        {
+            ready.push_back(strand);
+            cv.notify_one();
+        }
+    }
+}
+
+
+void WorkerPool::run_task(Task& task) const
+{
+    try
+    {
+        task();
+    }
+    catch (const std::exception& excp)
+    {
+        if (on_error)
+        {
+            on_error("Unhandled exception in worker thread: "
+                     + std::string(excp.what()));
+        }
+    }
+    catch (...)
+    {
+        if (on_error)
+        {
+            on_error("Unhandled unknown exception in worker thread");
+        }
+    }
+}
@@ -0,0 +1,175 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   worker-pool.hpp
+ *
+ * @brief  Thread pool running service operations outside of the GLib
+ *         main loop
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ *  Thread pool running operations of a service outside of the GLib
+ *  main loop.
+ *
+ *  Operations posted with Post() are started in the order they were
+ *  posted, by whichever worker thread is free.  Operations posted to
+ *  the same Strand are run one at a time, in the order they were
+ *  posted, while operations posted to different Strands may run in
+ *  parallel.
+ *
+ *  The operations must not touch any D-Bus objects owned by the main
+ *  loop; results are handed back to it by the operations themselves.
+ *
+ *  With no worker threads, operations are run directly by the caller
+ *  of Post().
+ */
+class WorkerPool
+{
+public:
+    using Ptr = std::shared_ptr<WorkerPool>;
+    using Task = std::function<void()>;
+
+    /**
+     *  Called with a description of an exception thrown by an
+     *  operation.  Called from the thread which ran the operation.
+     */
+    using ErrorHandler = std::function<void(const std::string&)>;
+
+
+    /**
+     *  Serialized queue of operations run by the WorkerPool.  The
+     *  WorkerPool must outlive all its Strand objects.
+     */
+    class Strand : public std::enable_shared_from_this<Strand>
+    {
+    public:
+        using Ptr = std::shared_ptr<Strand>;
+
+        Strand(WorkerPool& pool)
+            : pool(pool)
+        {
+        }
+
+        Strand(const Strand&) = delete;
+        Strand& operator=(const Strand&) = delete;
+
+
+        /**
+         *  Queue a new operation.  Exceptions thrown by the operation
+         *  are passed to the ErrorHandler of the pool and otherwise
+         *  ignored; the operation is expected to report errors to its
+         *  callers itself.
+         *
+         * @param task  Task to run
+         */
+        void Post(Task task);
+
+
+        /**
+         * @return Returns the number of operations queued on this Strand
+         *         which have not been started yet
+         */
+        size_t GetPending() const;
+
+
+    private:
+        friend class WorkerPool;
+
+        WorkerPool& pool;
+        std::deque<Task> tasks;
+        bool scheduled = false;
+    };
+
+
+    /**
+     *  Starts the worker threads
+     *
+     * @param threads   Number of worker threads to start
+     * @param on_error  ErrorHandler reporting exceptions thrown by the
+     *                  operations, typically to the log service.
+     *                  Without one, they are ignored.
+     */
+    WorkerPool(const unsigned int threads, ErrorHandler on_error = nullptr);
+
+    /**
+     *  Runs all queued operations to completion and stops the worker
+     *  threads
+     */
+    virtual ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+
+    /**
+     * @return Returns a new Strand::Ptr running its operations in this
+     *         pool
+     */
+    Strand::Ptr NewStrand();
+
+
+    /**
+     *  Queue a new operation, not ordered against any other operation.
+     *  Exceptions are handled as by Strand::Post().
+     *
+     * @param task  Task to run
+     */
+    void Post(Task task);
+
+
+    /**
+     * @return Returns the number of operations queued in this pool which
+     *         have not been started yet
+     */
+    size_t GetPending() const;
+
+
+    /**
+     * @return Returns the number of worker threads
+     */
+    unsigned int GetThreadCount() const noexcept
+    {
+        return threads.size();
+    }
+
+
+private:
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Strand::Ptr> ready;
+    size_t pending = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+    const ErrorHandler on_error;
+
+    void worker();
+    void run_task(Task& task) const;
+};
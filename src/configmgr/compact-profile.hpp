@@ -0,0 +1,144 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   compact-profile.hpp
+ *
+ * @brief  Memory efficient storage of a parsed configuration profile
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <openvpn/common/options.hpp>
+
+#include "common/core-extensions.hpp"
+#include "configmgr/profile-blobstore.hpp"
+
+
+/**
+ *  Stores the options of a configuration profile between the uses of it.
+ *
+ *  The values of inlined files (--ca, --cert, --tls-crypt, ...) are
+ *  kept in a ProfileBlobStore, shared with all other profiles carrying
+ *  the same data.  The remaining options are kept as plain strings.
+ *  A complete OptionListJSON is only rebuilt when the profile is
+ *  actually needed.
+ */
+class CompactProfile
+{
+public:
+    CompactProfile() = default;
+
+
+    /**
+     *  Takes a copy of the parsed options
+     *
+     * @param opts   OptionListJSON with the parsed configuration profile
+     * @param store  ProfileBlobStore::Ptr where to keep the inlined files
+     */
+    CompactProfile(const openvpn::OptionListJSON& opts,
+                   ProfileBlobStore::Ptr store)
+    {
+        entries.reserve(opts.size());
+        for (const auto& opt : opts)
+        {
+            Entry e;
+            if (openvpn::optparser_inline_file(opt.ref(0)) && 2 == opt.size())
+            {
+                e.args.push_back(opt.ref(0));
+                e.inlined = store->Intern(opt.ref(1));
+            }
+            else
+            {
+                for (size_t i = 0; i < opt.size(); i++)
+                {
+                    e.args.push_back(opt.ref(i));
+                }
+            }
+            entries.push_back(std::move(e));
+        }
+    }
+
+
+    /**
+     * @return Returns a new OptionListJSON with all the options of this
+     *         profile
+     */
+    openvpn::OptionListJSON Expand() const
+    {
+        openvpn::OptionListJSON ret;
+        ret.reserve(entries.size());
+        for (const auto& e : entries)
+        {
+            openvpn::Option opt;
+            for (const auto& a : e.args)
+            {
+                opt.push_back(a);
+            }
+            if (e.inlined)
+            {
+                opt.push_back(*e.inlined);
+            }
+            ret.push_back(std::move(opt));
+        }
+        ret.update_map();
+        return ret;
+    }
+
+
+    /**
+     * @return Returns the number of options in this profile
+     */
+    size_t size() const noexcept
+    {
+        return entries.size();
+    }
+
+
+    /**
+     * @return Returns the approximate number of bytes used by the options
+     *         of this profile, not counting the inlined files kept in the
+     *         ProfileBlobStore
+     */
+    size_t MemoryUsage() const noexcept
+    {
+        size_t ret = entries.capacity() * sizeof(Entry);
+        for (const auto& e : entries)
+        {
+            ret += e.args.capacity() * sizeof(std::string);
+            for (const auto& a : e.args)
+            {
+                ret += (a.capacity() > 15 ? a.capacity() + 1 : 0);
+            }
+        }
+        return ret;
+    }
+
+
+private:
+    struct Entry
+    {
+        std::vector<std::string> args;
+        ProfileBlobStore::Blob inlined;
+    };
+
+    std::vector<Entry> entries;
+};
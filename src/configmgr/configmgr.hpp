@@ -20,20 +20,37 @@
 #ifndef OPENVPN3_DBUS_CONFIGMGR_HPP
 #define OPENVPN3_DBUS_CONFIGMGR_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <functional>
+#include <iostream>
 #include <map>
+#include <set>
+#include <stdexcept>
 #include <ctime>
+#include <unordered_map>
+#include <unistd.h>
 
 #include <openvpn/log/logsimple.hpp>
 #include "common/cmdargparser-exceptions.hpp"
 #include "common/core-extensions.hpp"
+#include "common/json-io.hpp"
 #include "common/lookup.hpp"
+#include "common/memfd.hpp"
 #include "common/utils.hpp"
+#include "common/worker-pool.hpp"
+#include "configmgr/compact-profile.hpp"
 #include "configmgr/overrides.hpp"
 #include "dbus/core.hpp"
 #include "dbus/connection-creds.hpp"
 #include "dbus/exceptions.hpp"
+#include "dbus/list-filter-args.hpp"
+#include "dbus/object-manager.hpp"
+#include "dbus/object-subtree.hpp"
 #include "dbus/object-property.hpp"
+#include "dbus/path.hpp"
+#include "dbus/resource-usage.hpp"
 #include "log/ansicolours.hpp"
 #include "log/dbus-log.hpp"
 #include "log/logwriter.hpp"
@@ -195,38 +212,41 @@ public:
      * @param creator  An uid reference of the owner of this object.  This is
      *                 typically the uid of the front-end user importing this
      *                 VPN configuration profile.
-     * @param params   Pointer to a GLib2 GVariant object containing both
-     *                 meta data as well as the configuration profile itself
-     *                 to use when initializing this object
+     * @param state_dir  std::string with the directory of persistent
+     *                 configuration files
+     * @param cfgname  std::string with the name of the configuration
+     * @param profile  CompactProfile with the configuration profile, as
+     *                 parsed by ParseProfile()
+     * @param single_use  Should the configuration be removed after the
+     *                 first use
+     * @param persistent  Should the configuration be saved to disk
+     * @param blobstore  ProfileBlobStore::Ptr where large profile values
+     *                   shared with other configuration objects are kept
+     * @param persist_callback  Callback function called each time the
+     *                   persistent configuration file has been written
      */
     ConfigurationObject(GDBusConnection *dbuscon,
                         std::function<void()> remove_callback,
                         std::string objpath, unsigned int default_log_level,
                         LogWriter *logwr, bool signal_broadcast,
-                        uid_t creator, std::string state_dir, GVariant *params)
+                        uid_t creator, std::string state_dir,
+                        const std::string& cfgname, CompactProfile&& profile,
+                        bool single_use, bool persistent,
+                        ProfileBlobStore::Ptr blobstore,
+                        std::function<void()> persist_callback)
         : DBusObject(objpath),
           ConfigManagerSignals(dbuscon, objpath, default_log_level, logwr,
                                signal_broadcast),
           DBusCredentials(dbuscon, creator),
           remove_callback(remove_callback),
+          persist_callback(persist_callback),
+          name(cfgname),
           import_tstamp(std::time(nullptr)),
-          properties(this)
+          single_use(single_use),
+          properties(this),
+          blobstore(blobstore)
     {
-        GLibUtils::checkParams(__func__, params, "(ssbb)", 4);
-        name = GLibUtils::ExtractValue<std::string>(params, 0);
-        std::string cfgstr(GLibUtils::ExtractValue<std::string>(params, 1));
-        single_use = GLibUtils::ExtractValue<bool>(params, 2);
-        bool persistent = GLibUtils::ExtractValue<bool>(params, 3);
-
-        // Parse the options from the imported configuration
-        OptionList::Limits limits("profile is too large",
-                                  ProfileParseLimits::MAX_PROFILE_SIZE,
-                                  ProfileParseLimits::OPT_OVERHEAD,
-                                  ProfileParseLimits::TERM_OVERHEAD,
-                                  ProfileParseLimits::MAX_LINE_SIZE,
-                                  ProfileParseLimits::MAX_DIRECTIVE_SIZE);
-        options.parse_from_config(cfgstr, &limits);
-        options.parse_meta_from_config(cfgstr, "OVPN_ACCESS_SERVER", &limits);
+        set_options(std::move(profile));
         initialize_configuration(persistent);
 
         if (persistent && !state_dir.empty())
@@ -236,21 +256,47 @@ public:
             p << state_dir << "/" << simple_basename(objp) << ".json";
             persistent_file = std::string(p.str());
             update_persistent_file();
+            FlushPersistentFile();
         }
     }
 
+    /**
+     *  Constructor creating a ConfigurationObject from a persistent
+     *  configuration file
+     *
+     * @param dbuscon  D-Bus connection this object is tied to
+     * @param fname    std::string with the persistent configuration file
+     * @param profile  Json::Value with the contents of the file, as
+     *                 generated by Export().  If the "profile" member is
+     *                 missing, it is loaded from the file on first use.
+     * @param remove_callback  Callback function which must be called when
+     *                 destroying this configuration object.
+     * @param default_log_level  Unsigned integer defining the initial log level
+     * @param logwr    Pointer to LogWriter object; can be nullptr to disable
+     *                 file log.
+     * @param signal_broadcast Should signals be broadcasted (true) or
+     *                         targeted for the log service (false)
+     * @param blobstore  ProfileBlobStore::Ptr where large profile values
+     *                   shared with other configuration objects are kept
+     * @param persist_callback  Callback function called each time the
+     *                   persistent configuration file has been written
+     */
     ConfigurationObject(GDBusConnection *dbuscon,
                         const std::string& fname, Json::Value profile,
                         std::function<void()> remove_callback,
                         unsigned int default_log_level,
-                        LogWriter *logwr, bool signal_broadcast)
+                        LogWriter *logwr, bool signal_broadcast,
+                        ProfileBlobStore::Ptr blobstore,
+                        std::function<void()> persist_callback)
         : DBusObject(profile["object_path"].asString()),
           ConfigManagerSignals(dbuscon, profile["object_path"].asString(),
                                default_log_level, logwr, signal_broadcast),
           DBusCredentials(dbuscon, profile["owner"].asUInt64()),
           remove_callback(remove_callback),
+          persist_callback(persist_callback),
           properties(this),
-          persistent_file(fname)
+          persistent_file(fname),
+          blobstore(blobstore)
     {
         name = profile["name"].asString();
         import_tstamp = profile["import_timestamp"].asUInt64();
@@ -268,6 +314,10 @@ public:
         {
             GrantAccess(id.asUInt());
         }
+        for (const auto& id : profile["acl_groups"])
+        {
+            GrantGroupAccess(id.asUInt());
+        }
 
         for (const auto& ovkey : profile["overrides"].getMemberNames())
         {
@@ -286,20 +336,67 @@ public:
             }
         }
 
-        // Parse the options from the imported configuration
-        options.json_import(profile["profile"]);
+        // Parse the options from the imported configuration, unless
+        // it is to be loaded on first use
+        if (profile.isMember("profile"))
+        {
+            OptionListJSON opts;
+            opts.json_import(profile["profile"]);
+            set_options(CompactProfile(opts, blobstore));
+            profile.removeMember("profile");
+        }
+        else
+        {
+            options_loaded = false;
+        }
+        persisted_meta = profile;
 
         initialize_configuration(true);
     }
 
     ~ConfigurationObject()
     {
+        FlushPersistentFile();
         remove_callback();
         Debug("Configuration removed");
         IdleCheck_RefDec();
     };
 
 
+    /**
+     *  Adds the approximate memory use of this configuration profile to a
+     *  resource usage report.  Profiles of persistent configurations not
+     *  used since the service started or evicted by EvictProfile() are
+     *  not loaded and only count as configurations.
+     *
+     * @param report  DBusResourceUsage::Report to add to
+     */
+    void ReportResourceUsage(DBusResourceUsage::Report& report) const
+    {
+        uint64_t overrides = override_list.capacity() * sizeof(OverrideValue);
+        for (const auto& ov : override_list)
+        {
+            overrides += DBusResourceUsage::StringBytes(ov.strValue)
+                         - sizeof(std::string);
+        }
+        report.Add("configurations", 1,
+                   sizeof(*this) + DBusResourceUsage::StringBytes(name)
+                   + DBusResourceUsage::StringBytes(persistent_file));
+        report.Add("configurations_loaded", (options_loaded ? 1 : 0));
+        if (options_loaded)
+        {
+            report.Add("profile_options", options.size(), options.MemoryUsage());
+        }
+        if (!cached_text.empty() || !cached_json.empty())
+        {
+            report.Add("profile_renderings",
+                       (cached_text.empty() ? 0 : 1) + (cached_json.empty() ? 0 : 1),
+                       cached_text.capacity() + cached_json.capacity());
+        }
+        report.Add("overrides", override_list.size(), overrides);
+    }
+
+
     /**
      *  Retrieve the configuration name
      *
@@ -311,6 +408,313 @@ public:
     }
 
 
+    /**
+     *  Collects the properties matched by the FetchConfigsFiltered
+     *  method of the ConfigManagerObject
+     *
+     * @return Returns a ListFilter::Item for this configuration
+     */
+    ListFilter::Item GetListFilterItem() const
+    {
+        ListFilter::Item item;
+        item.path = GetObjectPath();
+        item.owner = GetOwnerUID();
+        item.name = name;
+        item.dco = dco;
+        return item;
+    }
+
+
+    /**
+     *  Collects the configuration details used when listing
+     *  configurations, used by the ConfigManagerObject
+     *  FetchAvailableConfigsDetailed method.  The configuration profile
+     *  itself is not included, so this does not require loading it.
+     *
+     * @return Returns a GVariant dictionary (a{sv}) with the configuration
+     *         details.  The keys match the configuration object property
+     *         names.
+     */
+    GVariant * GetConfigDetails() const
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(bld, "{sv}", "name",
+                              g_variant_new_string(name.c_str()));
+        g_variant_builder_add(bld, "{sv}", "owner",
+                              g_variant_new_uint32(GetOwnerUID()));
+        g_variant_builder_add(bld, "{sv}", "import_timestamp",
+                              g_variant_new_uint64(import_tstamp));
+        g_variant_builder_add(bld, "{sv}", "last_used_timestamp",
+                              g_variant_new_uint64(last_use_tstamp));
+        g_variant_builder_add(bld, "{sv}", "used_count",
+                              g_variant_new_uint32(used_count));
+        g_variant_builder_add(bld, "{sv}", "persistent",
+                              g_variant_new_boolean(!persistent_file.empty()));
+        g_variant_builder_add(bld, "{sv}", "single_use",
+                              g_variant_new_boolean(single_use));
+        g_variant_builder_add(bld, "{sv}", "readonly",
+                              g_variant_new_boolean(readonly));
+        g_variant_builder_add(bld, "{sv}", "locked_down",
+                              g_variant_new_boolean(locked_down));
+        g_variant_builder_add(bld, "{sv}", "public_access",
+                              g_variant_new_boolean(GetPublicAccess()));
+        g_variant_builder_add(bld, "{sv}", "valid",
+                              g_variant_new_boolean(valid));
+        g_variant_builder_add(bld, "{sv}", "dco",
+                              g_variant_new_boolean(dco));
+        GVariant *ret = g_variant_builder_end(bld);
+        g_variant_builder_unref(bld);
+        return ret;
+    }
+
+
+    /**
+     *  Sets the function called each time the configuration is renamed
+     *
+     * @param cb  Callback function, called with the old and the new
+     *            configuration name
+     */
+    void SetRenameCallback(std::function<void(const std::string&,
+                                              const std::string&)> cb)
+    {
+        rename_callback = cb;
+    }
+
+
+    /**
+     *  Transfers the ownership of this configuration object, and signals
+     *  the change of the owner property
+     *
+     * @param new_owner  uid_t of the new owner
+     */
+    void TransferOwnership(const uid_t new_owner)
+    {
+        DBusCredentials::TransferOwnership(new_owner);
+        properties.SetChanged("owner",
+                              [this]()
+                              {
+                                  return GetOwner();
+                              });
+    }
+
+
+    /**
+     *  Writes pending changes to the persistent configuration file right
+     *  away, instead of waiting for the deferred update.
+     */
+    void FlushPersistentFile()
+    {
+        if (0 != flush_timer)
+        {
+            g_source_remove(flush_timer);
+            flush_timer = 0;
+        }
+        if (!dirty)
+        {
+            return;
+        }
+        write_persistent_file();
+    }
+
+
+    /**
+     *  Drops the configuration profile from memory when it has not been
+     *  used for a while.  Only profiles of persistent configurations
+     *  without pending changes are evicted; get_options() loads them
+     *  from the persistent configuration file again on the next use.
+     *
+     * @param idle_before  The profile is evicted if it was last used
+     *                     before this time
+     *
+     * @return Returns true if the profile was evicted
+     */
+    bool EvictProfile(const std::time_t idle_before)
+    {
+        if (!options_loaded || persistent_file.empty() || dirty
+            || 0 != flush_timer || last_access >= idle_before)
+        {
+            return false;
+        }
+        set_options(CompactProfile());
+        options_loaded = false;
+        return true;
+    }
+
+
+    /**
+     *  Retrieve the persistent configuration file of this object
+     *
+     * @return Returns a std::string with the file name, empty if this
+     *         configuration is not persistent
+     */
+    std::string GetPersistentFile() const noexcept
+    {
+        return persistent_file;
+    }
+
+
+    /**
+     *  Parses an imported configuration profile.  This rejects invalid
+     *  profiles already at import time; only the compact copy of the
+     *  parsed options is kept.
+     *
+     *  This does not touch any D-Bus objects, so the configuration
+     *  manager runs it in its import worker threads.  Throws
+     *  openvpn::option_error on invalid profiles.
+     *
+     * @param cfgstr     std::string with the configuration profile
+     * @param blobstore  ProfileBlobStore::Ptr where to keep large values
+     *
+     * @return Returns the parsed CompactProfile to pass to the
+     *         constructor
+     */
+    static CompactProfile ParseProfile(const std::string& cfgstr,
+                                       ProfileBlobStore::Ptr blobstore)
+    {
+        OptionList::Limits limits("profile is too large",
+                                  ProfileParseLimits::MAX_PROFILE_SIZE,
+                                  ProfileParseLimits::OPT_OVERHEAD,
+                                  ProfileParseLimits::TERM_OVERHEAD,
+                                  ProfileParseLimits::MAX_LINE_SIZE,
+                                  ProfileParseLimits::MAX_DIRECTIVE_SIZE);
+        OptionListJSON opts;
+        opts.parse_from_config(cfgstr, &limits);
+        opts.parse_meta_from_config(cfgstr, "OVPN_ACCESS_SERVER", &limits);
+        return CompactProfile(opts, blobstore);
+    }
+
+
+    /**
+     *  Builds the configuration profile from options already parsed by
+     *  the importing client, as passed to the ImportParsedFD method.  The
+     *  options are not parsed again; they are only checked for being
+     *  something the profile parser could have produced, within the same
+     *  limits as ParseProfile() applies.
+     *
+     *  Like ParseProfile(), this is run in the import worker threads.
+     *
+     * @param data       std::string with a serialized GVariant of the
+     *                   type aas; an array of the option name and its
+     *                   arguments per option
+     * @param blobstore  ProfileBlobStore::Ptr where to keep large values
+     *
+     * @return Returns the CompactProfile to pass to the constructor
+     *
+     * @throws openvpn::option_error or std::invalid_argument on invalid
+     *         options
+     */
+    static CompactProfile ProfileFromOptions(const std::string& data,
+                                             ProfileBlobStore::Ptr blobstore)
+    {
+        OptionList::Limits limits("profile is too large",
+                                  ProfileParseLimits::MAX_PROFILE_SIZE,
+                                  ProfileParseLimits::OPT_OVERHEAD,
+                                  ProfileParseLimits::TERM_OVERHEAD,
+                                  ProfileParseLimits::MAX_LINE_SIZE,
+                                  ProfileParseLimits::MAX_DIRECTIVE_SIZE);
+
+        // The data is not trusted; GLib checks it when it is accessed
+        GVariant *optlist = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE("aas"),
+                                                                       data.data(), data.size(),
+                                                                       FALSE, nullptr, nullptr));
+        OptionListJSON opts;
+        try
+        {
+            GVariantIter iter;
+            g_variant_iter_init(&iter, optlist);
+            GVariant *optv = nullptr;
+            while ((optv = g_variant_iter_next_value(&iter)))
+            {
+                gsize len = 0;
+                const gchar **args = g_variant_get_strv(optv, &len);
+                Option opt;
+                for (gsize i = 0; i < len; ++i)
+                {
+                    opt.push_back(args[i]);
+                }
+                g_free(args);
+                g_variant_unref(optv);
+
+                validate_parsed_option(opt, limits);
+                opts.push_back(std::move(opt));
+            }
+        }
+        catch (...)
+        {
+            g_variant_unref(optlist);
+            throw;
+        }
+        g_variant_unref(optlist);
+        return CompactProfile(opts, blobstore);
+    }
+
+
+    /**
+     *  Parses and validates the overrides given together with a
+     *  configuration profile to the ImportBulk method of the
+     *  configuration manager.  This is done before the configuration
+     *  object is created, so an invalid override does not leave a
+     *  half-imported configuration behind.
+     *
+     * @param overrides  GVariant dictionary (a{sv}) of override keys
+     *                   and values
+     *
+     * @return Returns a std::vector of OverrideValue objects to pass to
+     *         ApplyImportSettings()
+     */
+    static std::vector<OverrideValue> ParseImportOverrides(GVariant *overrides)
+    {
+        GVariantIter *ovs = g_variant_iter_new(overrides);
+        std::vector<PendingOverride> set_list = extract_overrides(ovs);
+        g_variant_iter_free(ovs);
+        return build_overrides(set_list);
+    }
+
+
+    /**
+     *  Applies the overrides and access flags given together with the
+     *  configuration profile to the ImportBulk method
+     *
+     * @param overrides      std::vector of OverrideValue objects from
+     *                       ParseImportOverrides()
+     * @param public_access  Bool, grants all users access if true
+     * @param locked_down    Bool, sets the locked_down flag if true
+     */
+    void ApplyImportSettings(const std::vector<OverrideValue>& overrides,
+                             const bool public_access,
+                             const bool locked_down)
+    {
+        for (const auto& ov : overrides)
+        {
+            override_list.push_back(ov);
+        }
+        if (!overrides.empty())
+        {
+            properties.SetChanged("overrides");
+        }
+        if (public_access)
+        {
+            SetPublicAccess(true);
+        }
+        this->locked_down = locked_down;
+        update_persistent_file();
+    }
+
+
+    /**
+     *  Retrieve the settings last written to the persistent
+     *  configuration file, without the configuration profile itself.
+     *  This can be passed to the constructor as the profile argument, to
+     *  load the profile from the file on first use.
+     *
+     * @return Returns a Json::Value object with the settings
+     */
+    const Json::Value& GetPersistedMeta() const noexcept
+    {
+        return persisted_meta;
+    }
+
+
     /**
      *  Exports the configuration, including all the available settings
      *  specific to the Linux client.  The output format is JSON.
@@ -319,6 +723,20 @@ public:
      *         configuration profile
      */
     Json::Value Export() const
+    {
+        Json::Value ret = ExportMeta();
+        ret["profile"] = get_options().Expand().json_export();
+        return ret;
+    }
+
+
+    /**
+     *  Exports all the settings of this configuration, like Export(),
+     *  except the configuration profile itself.
+     *
+     * @return Returns a Json::Value object containing the settings
+     */
+    Json::Value ExportMeta() const
     {
         Json::Value ret;
 
@@ -333,7 +751,6 @@ public:
         ret["single_use"] = single_use;
         ret["used_count"] = used_count;
         ret["valid"] = valid;
-        ret["profile"] = options.json_export();
         ret["dco"] = dco;
 
         ret["public_access"] = GetPublicAccess();
@@ -341,6 +758,10 @@ public:
         {
             ret["acl"].append(e);
         }
+        for (const auto& e : GetGroupAccessList())
+        {
+            ret["acl_groups"].append(e);
+        }
         for (const auto& ov : override_list)
         {
             switch (ov.override.type)
@@ -386,7 +807,6 @@ public:
                               GVariant *params,
                               GDBusMethodInvocation *invoc)
     {
-        IdleCheck_UpdateTimestamp();
         if ("Fetch" == method_name)
         {
             try
@@ -403,56 +823,61 @@ public:
                     // owner
                     CheckOwnerAccess(sender, true);
                 }
+                std::string cfgstr;
+                try
+                {
+                    cfgstr = get_profile_text();
+                }
+                catch (const std::exception& excp)
+                {
+                    LogError(excp.what());
+                    g_dbus_method_invocation_return_dbus_error(invoc,
+                                                               "net.openvpn.v3.error.InvalidData",
+                                                               excp.what());
+                    return;
+                }
                 g_dbus_method_invocation_return_value(invoc,
                                                       g_variant_new("(s)",
-                                                                    options.string_export().c_str()));
-
-                // If the fetching user is openvpn (which
-                // openvpn3-service-client runs as), we consider this
-                // configuration to be "used".
-                //
-                // If we don't have an UID for some reason, don't remove
-                // anything.
-                //
+                                                                    cfgstr.c_str()));
+                mark_fetched(conn, sender);
+                return;
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                LogWarn(excp.what());
+                excp.SetDBusError(invoc);
+            }
+        }
+        else if ("FetchFD" == method_name)
+        {
+            try
+            {
+                if (!locked_down)
+                {
+                    CheckACL(sender, true);
+                }
+                else
+                {
+                    CheckOwnerAccess(sender, true);
+                }
                 try
                 {
-                    uid_t ovpn_uid;
-                    try
-                    {
-                        ovpn_uid = lookup_uid(OPENVPN_USERNAME);
-                    }
-                    catch (const LookupException& excp)
-                    {
-                        excp.SetDBusError(invoc);
-                        return;
-                    }
-
-                    if (GetUID(sender) == ovpn_uid)
-                    {
-                        // If this config is tagged as single-use only then we delete this
-                        // config from memory.
-                        if (single_use)
-                        {
-                            LogVerb2("Single-use configuration fetched");
-                            RemoveObject(conn);
-                            delete this;
-                            return;
-                        }
-                        used_count++;
-                        last_use_tstamp = std::time(nullptr);
-                        update_persistent_file();
-                    }
+                    int fd = MemFD::CreateSealed("openvpn3-profile",
+                                                 [this](std::ostream& os)
+                                                 {
+                                                     os << get_profile_text();
+                                                 });
+                    GLibUtils::return_value_with_fd(invoc, nullptr, fd);
                 }
-                catch (DBusException& excp)
+                catch (const std::exception& excp)
                 {
-                    std::string err(excp.what());
-                    if (err.find("NameHasNoOwner: Could not get UID of name") == std::string::npos)
-                    {
-                        // If the error is related to something else than
-                        // retriving the UID, re-throw the exception
-                        throw;
-                    }
+                    LogError(excp.what());
+                    g_dbus_method_invocation_return_dbus_error(invoc,
+                                                               "net.openvpn.v3.error.InvalidData",
+                                                               excp.what());
+                    return;
                 }
+                mark_fetched(conn, sender);
                 return;
             }
             catch (DBusCredentialsException& excp)
@@ -476,12 +901,23 @@ public:
                     CheckOwnerAccess(sender);
                 }
 
-                std::stringstream jsoncfg;
-                jsoncfg << options.json_export();
+                const std::string *jsoncfg = nullptr;
+                try
+                {
+                    jsoncfg = &get_profile_json();
+                }
+                catch (const std::exception& excp)
+                {
+                    LogError(excp.what());
+                    g_dbus_method_invocation_return_dbus_error(invoc,
+                                                               "net.openvpn.v3.error.InvalidData",
+                                                               excp.what());
+                    return;
+                }
 
                 g_dbus_method_invocation_return_value(invoc,
                                                       g_variant_new("(s)",
-                                                                    jsoncfg.str().c_str()));
+                                                                    jsoncfg->c_str()));
 
                 // Do not remove single-use object with this method.
                 // FetchJSON is only used by front-ends, never backends.  So
@@ -497,6 +933,46 @@ public:
                 excp.SetDBusError(invoc);
             }
         }
+        else if ("FetchJSONFD" == method_name)
+        {
+            try
+            {
+                if (!locked_down)
+                {
+                    CheckACL(sender);
+                }
+                else
+                {
+                    CheckOwnerAccess(sender);
+                }
+
+                // The JSON document is written straight into the memfd,
+                // without building it as a string first.  As with
+                // FetchJSON, single-use objects are not removed here.
+                try
+                {
+                    int fd = MemFD::CreateSealed("openvpn3-profile-json",
+                                                 [this](std::ostream& os)
+                                                 {
+                                                     os << get_profile_json();
+                                                 });
+                    GLibUtils::return_value_with_fd(invoc, nullptr, fd);
+                }
+                catch (const std::exception& excp)
+                {
+                    LogError(excp.what());
+                    g_dbus_method_invocation_return_dbus_error(invoc,
+                                                               "net.openvpn.v3.error.InvalidData",
+                                                               excp.what());
+                }
+                return;
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                LogWarn(excp.what());
+                excp.SetDBusError(invoc);
+            }
+        }
         else if ("SetOption" == method_name)
         {
             if (readonly)
@@ -550,6 +1026,7 @@ public:
                 g_free(key);
                 //g_variant_unref(val);
                 g_dbus_method_invocation_return_value(invoc, NULL);
+                properties.SetChanged("overrides");
                 update_persistent_file();
                 return;
             }
@@ -584,6 +1061,7 @@ public:
                                 + "' by UID " + std::to_string(GetUID(sender)));
 
                     g_dbus_method_invocation_return_value(invoc, NULL);
+                    properties.SetChanged("overrides");
                 }
                 else
                 {
@@ -664,15 +1142,148 @@ public:
                 excp.SetDBusError(invoc);
             }
         }
-        else if ("Seal" == method_name)
+        else if ("AccessGrantGroup" == method_name)
         {
+            if (readonly)
+            {
+                g_dbus_method_invocation_return_dbus_error (invoc,
+                                                            "net.openvpn.v3.error.ReadOnly",
+                                                            "Configuration is sealed and readonly");
+                return;
+            }
+
             try
             {
                 CheckOwnerAccess(sender);
 
-                if (valid) {
-                    readonly = true;
-                    g_dbus_method_invocation_return_value(invoc, NULL);
+                gid_t gid = -1;
+                g_variant_get(params, "(u)", &gid);
+                GrantGroupAccess(gid);
+                g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogInfo("Access granted to GID " + std::to_string(gid)
+                         + " by UID " + std::to_string(GetUID(sender)));
+                update_persistent_file();
+                return;
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                LogWarn(excp.what());
+                excp.SetDBusError(invoc);
+            }
+        }
+        else if ("AccessRevokeGroup" == method_name)
+        {
+            if (readonly)
+            {
+                g_dbus_method_invocation_return_dbus_error (invoc,
+                                                            "net.openvpn.v3.error.ReadOnly",
+                                                            "Configuration is sealed and readonly");
+                return;
+            }
+
+            try
+            {
+                CheckOwnerAccess(sender);
+
+                gid_t gid = -1;
+                g_variant_get(params, "(u)", &gid);
+                RevokeGroupAccess(gid);
+                g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogInfo("Access revoked for GID " + std::to_string(gid)
+                         + " by UID " + std::to_string(GetUID(sender)));
+                update_persistent_file();
+                return;
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                LogWarn(excp.what());
+                excp.SetDBusError(invoc);
+            }
+        }
+        else if ("ApplyChanges" == method_name)
+        {
+            if (readonly)
+            {
+                g_dbus_method_invocation_return_dbus_error (invoc,
+                                                            "net.openvpn.v3.error.ReadOnly",
+                                                            "Configuration is sealed and readonly");
+                return;
+            }
+
+            try
+            {
+                CheckOwnerAccess(sender);
+
+                GVariantIter *set_ovs = nullptr;
+                GVariantIter *unset_ovs = nullptr;
+                GVariantIter *grant_uids = nullptr;
+                GVariantIter *revoke_uids = nullptr;
+                g_variant_get(params, "(a{sv}asauau)",
+                              &set_ovs, &unset_ovs, &grant_uids, &revoke_uids);
+
+                // Only extract the values here; everything is validated
+                // by apply_changes() before anything is modified
+                std::vector<PendingOverride> set_list = extract_overrides(set_ovs);
+
+                gchar *key = nullptr;
+                std::vector<std::string> unset_list;
+                while (g_variant_iter_next(unset_ovs, "s", &key))
+                {
+                    unset_list.push_back(std::string(key));
+                    g_free(key);
+                }
+
+                std::vector<uid_t> grant_list;
+                std::vector<uid_t> revoke_list;
+                guint32 uid = 0;
+                while (g_variant_iter_next(grant_uids, "u", &uid))
+                {
+                    grant_list.push_back(uid);
+                }
+                while (g_variant_iter_next(revoke_uids, "u", &uid))
+                {
+                    revoke_list.push_back(uid);
+                }
+                g_variant_iter_free(set_ovs);
+                g_variant_iter_free(unset_ovs);
+                g_variant_iter_free(grant_uids);
+                g_variant_iter_free(revoke_uids);
+
+                apply_changes(set_list, unset_list, grant_list, revoke_list);
+                g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogInfo("Configuration changes applied by UID "
+                        + std::to_string(GetUID(sender)) + ": "
+                        + std::to_string(set_list.size()) + " override(s) set, "
+                        + std::to_string(unset_list.size()) + " unset, "
+                        + std::to_string(grant_list.size()) + " UID(s) granted, "
+                        + std::to_string(revoke_list.size()) + " revoked");
+                update_persistent_file();
+                return;
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                LogWarn(excp.what());
+                excp.SetDBusError(invoc);
+            }
+            catch (DBusException& excp)
+            {
+                LogWarn(excp.what());
+                excp.SetDBusError(invoc, "net.openvpn.v3.configmgr.error");
+            }
+        }
+        else if ("Seal" == method_name)
+        {
+            try
+            {
+                CheckOwnerAccess(sender);
+
+                if (valid) {
+                    readonly = true;
+                    g_dbus_method_invocation_return_value(invoc, NULL);
+                    properties.SetChanged("readonly");
                     update_persistent_file();
                 }
                 else
@@ -689,21 +1300,41 @@ public:
                 excp.SetDBusError(invoc);
             }
         }
+        else if ("Flush" == method_name)
+        {
+            try
+            {
+                CheckOwnerAccess(sender);
+                FlushPersistentFile();
+                g_dbus_method_invocation_return_value(invoc, NULL);
+                return;
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                LogWarn(excp.what());
+                excp.SetDBusError(invoc);
+            }
+        }
         else if ("Remove" == method_name)
         {
             try
             {
                 CheckOwnerAccess(sender);
-                std::string sender_name = lookup_username(GetUID(sender));
-                LogInfo("Configuration '" + name + "' was removed by "
-                        + sender_name);
+                if (LogEnabled(LogCategory::INFO))
+                {
+                    std::string sender_name = lookup_username(GetUID(sender));
+                    LogInfo("Configuration '" + name + "' was removed by "
+                            + sender_name);
+                }
                 RemoveObject(conn);
                 g_dbus_method_invocation_return_value(invoc, NULL);
 
                 // If this is a persistent config, remove it from
-                // the file system too
+                // the file system too.  Pending changes are dropped.
                 if (!persistent_file.empty())
                 {
+                    dirty = false;
+                    FlushPersistentFile();
                     unlink(persistent_file.c_str());
                     LogVerb2("Persistent configuration profile removed: '"
                              + persistent_file + "'");
@@ -746,8 +1377,6 @@ public:
                                      const std::string property_name,
                                      GError **error)
     {
-        IdleCheck_UpdateTimestamp();
-
         // Properties available for everyone
         if ("owner" == property_name)
         {
@@ -785,6 +1414,10 @@ public:
             {
                     ret = GLibUtils::GVariantFromVector(GetAccessList());
             }
+            else if ("acl_groups" == property_name)
+            {
+                ret = GLibUtils::GVariantFromVector(GetGroupAccessList());
+            }
             else if ("persistent" == property_name)
             {
                 ret = g_variant_new_boolean(!persistent_file.empty());
@@ -836,7 +1469,6 @@ public:
                                             GVariant *value,
                                             GError **error)
     {
-        IdleCheck_UpdateTimestamp();
         if (readonly)
         {
             throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_READ_ONLY,
@@ -852,8 +1484,13 @@ public:
             if (("name" == property_name) && conn)
             {
                 gsize len = 0;
+                std::string oldname = name;
                 name = std::string(g_variant_get_string(value, &len));
                 ret = build_set_property_response(property_name, name);
+                if (rename_callback && oldname != name)
+                {
+                    rename_callback(oldname, name);
+                }
             }
             else if (("locked_down" == property_name) && conn)
             {
@@ -992,16 +1629,212 @@ public:
     }
 
 
+    /**
+     *  Override value received by ApplyChanges or ImportBulk, not yet validated
+     */
+    struct PendingOverride
+    {
+        std::string key;
+        std::string type;
+        std::string strValue;
+        bool boolValue = false;
+    };
+
+    /**
+     *  Extracts the override keys and values of an a{sv} dictionary,
+     *  without validating them
+     *
+     * @param iter  GVariantIter pointing at the dictionary entries
+     *
+     * @return Returns a std::vector of PendingOverride values, to be
+     *         passed to apply_changes()
+     */
+    static std::vector<PendingOverride> extract_overrides(GVariantIter *iter)
+    {
+        std::vector<PendingOverride> ret;
+        gchar *key = nullptr;
+        GVariant *val = nullptr;
+        while (g_variant_iter_next(iter, "{sv}", &key, &val))
+        {
+            PendingOverride po;
+            po.key = std::string(key);
+            po.type = std::string(g_variant_get_type_string(val));
+            if ("s" == po.type)
+            {
+                po.strValue = std::string(g_variant_get_string(val, nullptr));
+            }
+            else if ("b" == po.type)
+            {
+                po.boolValue = g_variant_get_boolean(val);
+            }
+            ret.push_back(po);
+            g_free(key);
+            g_variant_unref(val);
+        }
+        return ret;
+    }
+
+
+    /**
+     *  Validates override values and turns them into OverrideValue
+     *  objects.  An exception is thrown on the first invalid value.
+     *
+     * @param set_list  std::vector of PendingOverride values to check
+     *
+     * @return Returns a std::vector of OverrideValue objects, in the same
+     *         order as set_list
+     */
+    static std::vector<OverrideValue> build_overrides(const std::vector<PendingOverride>& set_list)
+    {
+        std::vector<OverrideValue> ret;
+        std::set<std::string> keys;
+        for (const auto& po : set_list)
+        {
+            const ValidOverride& vo = GetConfigOverride(po.key);
+            if (!vo.valid())
+            {
+                THROW_DBUSEXCEPTION("ConfigurationObject",
+                                    "Invalid override key '" + po.key + "'");
+            }
+            if (!keys.insert(po.key).second)
+            {
+                THROW_DBUSEXCEPTION("ConfigurationObject",
+                                    "Override '" + po.key
+                                    + "' is set more than once");
+            }
+
+            if (OverrideType::string == vo.type && "s" == po.type)
+            {
+                ret.push_back(OverrideValue(vo, po.strValue));
+            }
+            else if (OverrideType::boolean == vo.type && "b" == po.type)
+            {
+                ret.push_back(OverrideValue(vo, po.boolValue));
+            }
+            else
+            {
+                THROW_DBUSEXCEPTION("ConfigurationObject",
+                                    "Unsupported data type for key '"
+                                    + po.key + "': " + po.type);
+            }
+        }
+        return ret;
+    }
+
+
+    /**
+     *  Applies a set of override and access control changes in one go.
+     *  All changes are validated first; if any of them is invalid an
+     *  exception is thrown and nothing is modified.
+     *
+     *  Overrides are unset before the new override values are set, and
+     *  access is revoked before new UIDs are granted access.
+     *
+     * @param set_list     std::vector of PendingOverride values to set
+     * @param unset_list   std::vector of override keys to unset
+     * @param grant_list   std::vector of UIDs to grant access
+     * @param revoke_list  std::vector of UIDs to revoke access from
+     */
+    void apply_changes(const std::vector<PendingOverride>& set_list,
+                       const std::vector<std::string>& unset_list,
+                       const std::vector<uid_t>& grant_list,
+                       const std::vector<uid_t>& revoke_list)
+    {
+        std::vector<OverrideValue> new_overrides = build_overrides(set_list);
+        std::set<std::string> keys;
+        for (const auto& ov : new_overrides)
+        {
+            keys.insert(ov.override.key);
+        }
+
+        for (const auto& key : unset_list)
+        {
+            if (!keys.insert(key).second)
+            {
+                THROW_DBUSEXCEPTION("ConfigurationObject",
+                                    "Override '" + key + "' is both set "
+                                    "and unset, or unset more than once");
+            }
+            bool found = false;
+            for (const auto& ov : override_list)
+            {
+                if (ov.override.key == key)
+                {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found)
+            {
+                THROW_DBUSEXCEPTION("ConfigurationObject",
+                                    "Override '" + key + "' has not been set");
+            }
+        }
+
+        std::vector<uid_t> acl = GetAccessList();
+        std::set<uid_t> uids;
+        for (const auto& uid : revoke_list)
+        {
+            if (!uids.insert(uid).second
+                || std::find(acl.begin(), acl.end(), uid) == acl.end())
+            {
+                throw DBusCredentialsException(GetOwnerUID(),
+                                               "net.openvpn.v3.error.acl.nogrant",
+                                               "UID " + std::to_string(uid)
+                                               + " is not listed in access list");
+            }
+        }
+        for (const auto& uid : grant_list)
+        {
+            if (!uids.insert(uid).second
+                || std::find(acl.begin(), acl.end(), uid) != acl.end())
+            {
+                throw DBusCredentialsException(GetOwnerUID(),
+                                               "net.openvpn.v3.error.acl.duplicate",
+                                               "UID " + std::to_string(uid)
+                                               + " already granted access");
+            }
+        }
+
+        // Everything is valid, nothing below this point can fail
+        for (const auto& key : unset_list)
+        {
+            (void) remove_override(key.c_str());
+        }
+        for (const auto& ov : new_overrides)
+        {
+            (void) remove_override(ov.override.key.c_str());
+            override_list.push_back(ov);
+        }
+        for (const auto& uid : revoke_list)
+        {
+            RevokeAccess(uid);
+        }
+        for (const auto& uid : grant_list)
+        {
+            GrantAccess(uid);
+        }
+
+        if (!set_list.empty() || !unset_list.empty())
+        {
+            properties.SetChanged("overrides");
+        }
+    }
+
+
     void initialize_configuration(const bool persistent)
     {
-        std::stringstream msg;
-        msg << "Parsed"
-            << (persistent ? " persistent" : "")
-            << (persistent && single_use ? "," : "")
-            << (single_use ? " single-use" : "")
-            << " configuration '" << name << "'"
-            << ", owner: " << lookup_username(GetOwnerUID());
-        LogInfo(msg.str());
+        if (LogEnabled(LogCategory::INFO))
+        {
+            std::stringstream msg;
+            msg << "Parsed"
+                << (persistent ? " persistent" : "")
+                << (persistent && single_use ? "," : "")
+                << (single_use ? " single-use" : "")
+                << " configuration '" << name << "'"
+                << ", owner: " << lookup_username(GetOwnerUID());
+            LogInfo(msg.str());
+        }
 
         // FIXME:  Validate the configuration file, ensure --ca/--key/--cert/--dh/--pkcs12
         //         contains files
@@ -1018,45 +1851,131 @@ public:
         properties.AddBinding(new PropertyType<decltype(override_list)>(this, "overrides", "read", true, override_list));
         properties.AddBinding(new PropertyType<bool>(this, "dco", "readwrite", true, dco));
 
-        std::string introsp_xml ="<node name='" + GetObjectPath() + "'>"
-            "    <interface name='net.openvpn.v3.configuration'>"
-            "        <method name='Fetch'>"
-            "            <arg direction='out' type='s' name='config'/>"
-            "        </method>"
-            "        <method name='FetchJSON'>"
-            "            <arg direction='out' type='s' name='config_json'/>"
-            "        </method>"
-            "        <method name='SetOption'>"
-            "            <arg direction='in' type='s' name='option'/>"
-            "            <arg direction='in' type='s' name='value'/>"
-            "        </method>"
-            "        <method name='SetOverride'>"
-            "            <arg direction='in' type='s' name='name'/>"
-            "            <arg direction='in' type='v' name='value'/>"
-            "        </method>"
-            "        <method name='UnsetOverride'>"
-            "            <arg direction='in' type='s' name='name'/>"
-            "        </method>"
-            "        <method name='AccessGrant'>"
-            "            <arg direction='in' type='u' name='uid'/>"
-            "        </method>"
-            "        <method name='AccessRevoke'>"
-            "            <arg direction='in' type='u' name='uid'/>"
-            "        </method>"
-            "        <method name='Seal'/>"
-            "        <method name='Remove'/>"
-            "        <property type='u' name='owner' access='read'/>"
-            "        <property type='au' name='acl' access='read'/>"
-            "        <property type='s' name='name' access='readwrite'/>"
-            "        <property type='b' name='public_access' access='readwrite'/>"
-            "        <property type='b' name='persistent' access='read'/>"
-            + properties.GetIntrospectionXML() +
-            "    </interface>"
-            "</node>";
-        ParseIntrospectionXML(introsp_xml);
+        // All configuration objects share the same parsed introspection
+        // document; only the first object generates and parses it
+        ParseIntrospectionXML("ConfigurationObject", [this]()
+            {
+                return std::string("<node>"
+                    "    <interface name='net.openvpn.v3.configuration'>"
+                    "        <method name='Fetch'>"
+                    "            <arg direction='out' type='s' name='config'/>"
+                    "        </method>"
+                    "        <method name='FetchJSON'>"
+                    "            <arg direction='out' type='s' name='config_json'/>"
+                    "        </method>"
+                    "        <method name='FetchFD'/>"
+                    "        <method name='FetchJSONFD'/>"
+                    "        <method name='SetOption'>"
+                    "            <arg direction='in' type='s' name='option'/>"
+                    "            <arg direction='in' type='s' name='value'/>"
+                    "        </method>"
+                    "        <method name='SetOverride'>"
+                    "            <arg direction='in' type='s' name='name'/>"
+                    "            <arg direction='in' type='v' name='value'/>"
+                    "        </method>"
+                    "        <method name='UnsetOverride'>"
+                    "            <arg direction='in' type='s' name='name'/>"
+                    "        </method>"
+                    "        <method name='AccessGrant'>"
+                    "            <arg direction='in' type='u' name='uid'/>"
+                    "        </method>"
+                    "        <method name='AccessRevoke'>"
+                    "            <arg direction='in' type='u' name='uid'/>"
+                    "        </method>"
+                    "        <method name='AccessGrantGroup'>"
+                    "            <arg direction='in' type='u' name='gid'/>"
+                    "        </method>"
+                    "        <method name='AccessRevokeGroup'>"
+                    "            <arg direction='in' type='u' name='gid'/>"
+                    "        </method>"
+                    "        <method name='ApplyChanges'>"
+                    "            <arg direction='in' type='a{sv}' name='set_overrides'/>"
+                    "            <arg direction='in' type='as' name='unset_overrides'/>"
+                    "            <arg direction='in' type='au' name='grant_uids'/>"
+                    "            <arg direction='in' type='au' name='revoke_uids'/>"
+                    "        </method>"
+                    "        <method name='Seal'/>"
+                    "        <method name='Remove'/>"
+                    "        <method name='Flush'/>"
+                    "        <property type='u' name='owner' access='read'/>"
+                    "        <property type='au' name='acl' access='read'/>"
+                    "        <property type='au' name='acl_groups' access='read'/>"
+                    "        <property type='s' name='name' access='readwrite'/>"
+                    "        <property type='b' name='public_access' access='readwrite'/>"
+                    "        <property type='b' name='persistent' access='read'/>")
+                    + properties.GetIntrospectionXML() +
+                    "    </interface>"
+                    "</node>";
+            });
     }
 
 
+    /**
+     *  Updates the usage counters after the configuration profile has
+     *  been fetched.  If the fetching user is openvpn (which
+     *  openvpn3-service-client runs as), the configuration is considered
+     *  "used" and a single-use configuration is removed.
+     *
+     *  If we don't have an UID for some reason, nothing is changed.
+     *
+     * @param conn    D-Bus connection the configuration object is on
+     * @param sender  std::string with the D-Bus bus name of the caller
+     *
+     * @return Returns true if this object was deleted.  The caller must
+     *         not access any members of it in that case.
+     */
+    bool mark_fetched(GDBusConnection *conn, const std::string& sender)
+    {
+        try
+        {
+            uid_t ovpn_uid;
+            try
+            {
+                ovpn_uid = lookup_uid(OPENVPN_USERNAME);
+            }
+            catch (const LookupException& excp)
+            {
+                LogError(excp.what());
+                return false;
+            }
+
+            if (GetUID(sender) == ovpn_uid)
+            {
+                // If this config is tagged as single-use only then we delete this
+                // config from memory.
+                if (single_use)
+                {
+                    LogVerb2("Single-use configuration fetched");
+                    RemoveObject(conn);
+                    delete this;
+                    return true;
+                }
+                used_count++;
+                last_use_tstamp = std::time(nullptr);
+                properties.SetChanged("used_count");
+                properties.SetChanged("last_used_timestamp");
+                update_persistent_file();
+            }
+        }
+        catch (DBusException& excp)
+        {
+            std::string err(excp.what());
+            if (err.find("NameHasNoOwner: Could not get UID of name") == std::string::npos)
+            {
+                // If the error is related to something else than
+                // retriving the UID, re-throw the exception
+                throw;
+            }
+        }
+        return false;
+    }
+
+
+    /**
+     *  Marks the persistent configuration file as outdated.  The file is
+     *  rewritten a little later, so several changes in a row only cause
+     *  a single update.
+     */
     void update_persistent_file()
     {
         if (persistent_file.empty())
@@ -1066,15 +1985,207 @@ public:
             return;
         }
 
-        std::ofstream state(persistent_file);
-        state << Export();
-        state.close();
+        dirty = true;
+        if (0 == flush_timer)
+        {
+            flush_timer = g_timeout_add_seconds(flush_delay,
+                                                [](gpointer data) -> gboolean
+                                                {
+                                                    auto self = static_cast<ConfigurationObject *>(data);
+                                                    self->flush_timer = 0;
+                                                    self->write_persistent_file();
+                                                    return G_SOURCE_REMOVE;
+                                                },
+                                                this);
+        }
+    }
+
+
+    /**
+     *  Writes the persistent configuration file.  The old file is kept
+     *  if the new one cannot be written completely.
+     */
+    void write_persistent_file()
+    {
+        try
+        {
+            Json::Value data = Export();
+            write_file_atomic(persistent_file, JsonIO::Write(data, true));
+
+            data.removeMember("profile");
+            persisted_meta = data;
+            dirty = false;
+        }
+        catch (const std::exception& excp)
+        {
+            // An unreadable profile is not overwritten
+            LogCritical("Could not update persistent config: "
+                        + std::string(excp.what()));
+            return;
+        }
         LogVerb2("Updated persistent config: " + persistent_file);
+        if (persist_callback)
+        {
+            persist_callback();
+        }
+    }
+
+
+    /**
+     *  Retrieve the configuration profile options, loading them from the
+     *  persistent configuration file on the first call if needed.
+     *
+     * @return Returns a const reference to the CompactProfile
+     *
+     * @throws DBusException if the profile cannot be loaded
+     */
+    const CompactProfile& get_options() const
+    {
+        last_access = std::time(nullptr);
+        if (options_loaded)
+        {
+            return options;
+        }
+
+        Json::Value data;
+        try
+        {
+            data = JsonIO::LoadFile(persistent_file);
+        }
+        catch (const std::exception& excp)
+        {
+            THROW_DBUSEXCEPTION("ConfigurationObject",
+                                "Could not load persistent configuration "
+                                + persistent_file + ": " + excp.what());
+        }
+        if (!data.isMember("profile")
+            || data["object_path"].asString() != GetObjectPath())
+        {
+            THROW_DBUSEXCEPTION("ConfigurationObject",
+                                "Could not load persistent configuration "
+                                + persistent_file);
+        }
+
+        OptionListJSON opts;
+        opts.json_import(data["profile"]);
+        set_options(CompactProfile(opts, blobstore));
+        options_loaded = true;
+        return options;
     }
 
 
 private:
+    /**
+     *  Checks an option of a profile parsed by the importing client, see
+     *  ProfileFromOptions().  The option name must be a single word and
+     *  only inlined files may span several lines.  The sizes are counted
+     *  against the limits the same way the profile parser does.
+     *
+     * @param opt     openvpn::Option to check
+     * @param limits  OptionList::Limits of the whole profile
+     *
+     * @throws openvpn::option_error or std::invalid_argument if the
+     *         option is not valid
+     */
+    static void validate_parsed_option(const Option& opt,
+                                       OptionList::Limits& limits)
+    {
+        if (0 == opt.size() || opt.ref(0).empty())
+        {
+            throw std::invalid_argument("Invalid configuration profile: "
+                                        "empty option");
+        }
+        const std::string& optname = opt.ref(0);
+        for (const char c : optname)
+        {
+            if (isspace((unsigned char) c) || iscntrl((unsigned char) c))
+            {
+                throw std::invalid_argument("Invalid configuration profile: "
+                                            "invalid option name");
+            }
+        }
+
+        bool inlined = openvpn::optparser_inline_file(optname);
+        if (inlined && 2 != opt.size())
+        {
+            throw std::invalid_argument("Invalid configuration profile: "
+                                        "invalid inline file " + optname);
+        }
+
+        limits.add_opt();
+        for (size_t i = 0; i < opt.size(); ++i)
+        {
+            const std::string& arg = opt.ref(i);
+            if (!inlined && std::string::npos != arg.find('\n'))
+            {
+                throw std::invalid_argument("Invalid configuration profile: "
+                                            "line break in option " + optname);
+            }
+            limits.add_string(arg);
+            limits.add_term();
+        }
+        limits.validate_directive(opt);
+    }
+
+
+    /**
+     *  Replaces the configuration profile options.  The cached
+     *  renderings of the previous options are dropped.
+     *
+     * @param opts  CompactProfile with the new options
+     */
+    void set_options(CompactProfile&& opts) const
+    {
+        options = std::move(opts);
+        cached_text.clear();
+        cached_text.shrink_to_fit();
+        cached_json.clear();
+        cached_json.shrink_to_fit();
+    }
+
+
+    /**
+     *  Retrieve the configuration profile as returned by the Fetch and
+     *  FetchFD methods.  The backends fetch the same profile on every
+     *  connect, so it is only rendered once until the options change.
+     *
+     * @return Returns a const reference to the rendered profile
+     *
+     * @throws DBusException if the profile cannot be loaded
+     */
+    const std::string& get_profile_text() const
+    {
+        last_access = std::time(nullptr);
+        if (cached_text.empty())
+        {
+            cached_text = get_options().Expand().string_export();
+        }
+        return cached_text;
+    }
+
+
+    /**
+     *  Retrieve the configuration profile as returned by the FetchJSON
+     *  and FetchJSONFD methods, rendered once like get_profile_text()
+     *
+     * @return Returns a const reference to the JSON document
+     *
+     * @throws DBusException if the profile cannot be loaded
+     */
+    const std::string& get_profile_json() const
+    {
+        last_access = std::time(nullptr);
+        if (cached_json.empty())
+        {
+            cached_json = JsonIO::Write(get_options().Expand().json_export());
+        }
+        return cached_json;
+    }
+
+
     std::function<void()> remove_callback;
+    std::function<void()> persist_callback;
+    std::function<void(const std::string&, const std::string&)> rename_callback;
     std::string name = {};
     std::time_t import_tstamp = {};
     std::time_t last_use_tstamp = {};
@@ -1087,7 +2198,18 @@ private:
     bool dco = false; // data channel offload
     PropertyCollection properties;
     std::string persistent_file = {};
-    OptionListJSON options = {};
+    bool dirty = false;
+    guint flush_timer = 0;
+    Json::Value persisted_meta = {};
+
+    /// Seconds to wait before writing changes to the persistent file
+    static const unsigned int flush_delay = 1;
+    ProfileBlobStore::Ptr blobstore;
+    mutable bool options_loaded = true;
+    mutable std::time_t last_access = {};  ///< Last use of the profile
+    mutable CompactProfile options = {};
+    mutable std::string cached_text = {};  ///< Profile rendered for Fetch
+    mutable std::string cached_json = {};  ///< Profile rendered for FetchJSON
     std::vector<OverrideValue> override_list = {};
 };
 
@@ -1122,16 +2244,24 @@ public:
      *                   file log.
      * @param signal_broadcast Should signals be broadcasted (true) or
      *                         targeted for the log service (false)
+     * @param import_threads  Number of threads parsing imported
+     *                        configuration profiles.  0 parses them in
+     *                        the main loop.
      *
      */
     ConfigManagerObject(GDBusConnection *dbusc, const std::string objpath,
                         unsigned int default_log_level, LogWriter *logwr,
-                        bool signal_broadcast)
+                        bool signal_broadcast, unsigned int import_threads)
         : DBusObject(objpath),
           ConfigManagerSignals(dbusc, objpath, default_log_level, logwr,
                                signal_broadcast),
           dbuscon(dbusc),
-          creds(dbusc)
+          creds(dbusc),
+          import_workers(std::make_shared<WorkerPool>(import_threads,
+                                                      [this](const std::string& err)
+                                                      {
+                                                          LogCritical(err);
+                                                      }))
     {
         std::stringstream introspection_xml;
         introspection_xml << "<node name='" + objpath + "'>"
@@ -1143,9 +2273,35 @@ public:
                           << "          <arg type='b' name='persistent' direction='in'/>"
                           << "          <arg type='o' name='config_path' direction='out'/>"
                           << "        </method>"
+                          << "        <method name='ImportFD'>"
+                          << "          <arg type='s' name='name' direction='in'/>"
+                          << "          <arg type='b' name='single_use' direction='in'/>"
+                          << "          <arg type='b' name='persistent' direction='in'/>"
+                          << "          <arg type='o' name='config_path' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='ImportParsedFD'>"
+                          << "          <arg type='s' name='name' direction='in'/>"
+                          << "          <arg type='b' name='single_use' direction='in'/>"
+                          << "          <arg type='b' name='persistent' direction='in'/>"
+                          << "          <arg type='o' name='config_path' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='ImportBulk'>"
+                          << "          <arg type='a(ssbba{sv}bb)' name='profiles' direction='in'/>"
+                          << "          <arg type='a(os)' name='results' direction='out'/>"
+                          << "        </method>"
                           << "        <method name='FetchAvailableConfigs'>"
                           << "          <arg type='ao' name='paths' direction='out'/>"
                           << "        </method>"
+                          << "        <method name='FetchAvailableConfigsDetailed'>"
+                          << "          <arg type='a{oa{sv}}' name='configs' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchConfigsFiltered'>"
+                          << "          <arg type='a{sv}' name='filter' direction='in'/>"
+                          << "          <arg type='s' name='cursor' direction='in'/>"
+                          << "          <arg type='u' name='limit' direction='in'/>"
+                          << "          <arg type='ao' name='paths' direction='out'/>"
+                          << "          <arg type='s' name='next_cursor' direction='out'/>"
+                          << "        </method>"
                           << "        <method name='LookupConfigName'>"
                           << "          <arg type='s' name='config_name' direction='in'/>"
                           << "          <arg type='ao' name='config_paths' direction='out'/>"
@@ -1155,21 +2311,98 @@ public:
                           << "           <arg type='u' name='new_owner_uid' direction='in'/>"
                           << "        </method>"
                           << "        <property type='s' name='version' access='read'/>"
+                          << "        <property type='t' name='change_counter' access='read'/>"
                           << GetLogIntrospection()
                           << "    </interface>"
                           << "</node>";
         ParseIntrospectionXML(introspection_xml);
 
+        objmgr.reset(new DBusObjectManager<ConfigurationObject>(
+                             dbusc, objpath, OpenVPN3DBus_interf_configuration,
+                             [this]()
+                             {
+                                 std::vector<ConfigurationObject *> ret;
+                                 ret.reserve(config_objects.size());
+                                 for (const auto& cfg : config_objects)
+                                 {
+                                     ret.push_back(cfg.second);
+                                 }
+                                 return ret;
+                             },
+                             signal_broadcast));
+
+        subtree.reset(new DBusObjectSubtree(
+                              objpath,
+                              [this](const std::string& path) -> DBusObject *
+                              {
+                                  auto cfg = config_objects.find(path);
+                                  return (config_objects.end() != cfg ? cfg->second : nullptr);
+                              },
+                              [this](const std::string& sender)
+                              {
+                                  std::vector<std::string> ret;
+                                  for (const auto& cfg : config_objects)
+                                  {
+                                      try
+                                      {
+                                          cfg.second->CheckACL(sender);
+                                      }
+                                      catch (const DBusCredentialsException&)
+                                      {
+                                          continue;
+                                      }
+                                      const std::string& path = cfg.first;
+                                      ret.push_back(path.substr(path.rfind('/') + 1));
+                                  }
+                                  return ret;
+                              }));
+        subtree->Register(dbusc);
+
         Debug("ConfigManagerObject registered on '" + OpenVPN3DBus_interf_configuration + "':" + objpath);
+
+        usage_reporter = DBusResourceUsage::Instance().AddReporter(
+            [this](DBusResourceUsage::Report& report)
+            {
+                for (const auto& cfg : config_objects)
+                {
+                    cfg.second->ReportResourceUsage(report);
+                }
+                report.Add("profile_blobs", blobstore->Size(),
+                           blobstore->MemoryUsage());
+                uint64_t index_bytes = 0;
+                for (const auto& n : name_index)
+                {
+                    index_bytes += DBusResourceUsage::StringBytes(n.first)
+                                   + DBusResourceUsage::StringBytes(n.second);
+                }
+                report.Add("config_name_index", name_index.size(), index_bytes);
+            });
     }
 
     ~ConfigManagerObject()
     {
+        DBusResourceUsage::Instance().RemoveReporter(usage_reporter);
+        if (0 != evict_timer)
+        {
+            g_source_remove(evict_timer);
+        }
+        FlushPersistentConfigs();
         LogVerb2("Shutting down");
         RemoveObject(dbuscon);
     }
 
 
+    /**
+     *  Retrieve the org.freedesktop.DBus.ObjectManager implementation
+     *  giving access to all the configuration objects.  It needs to be
+     *  registered on the D-Bus together with this object.
+     */
+    DBusObjectManager<ConfigurationObject>& GetObjectManager()
+    {
+        return *objmgr;
+    }
+
+
     /**
      *  Sets the directory where the configuration manager should store
      *  persistent configuration profiles.
@@ -1177,6 +2410,11 @@ public:
      *  When calling this function, all already saved configuration files
      *  will be imported and registered before continuing.
      *
+     *  The settings of all the persistent configurations are also kept in
+     *  an index file in this directory.  Configurations found unchanged in
+     *  the index are registered from it; their configuration profile is
+     *  only loaded when it is used.
+     *
      * @param stdir  std::string containing the file system directory for
      *               the persistent configuration profile storage
      */
@@ -1191,11 +2429,12 @@ public:
 
         // Load all the already saved persistent configurations before
         // continuing.
+        Json::Value index = load_index();
         for (const auto& fname : get_persistent_config_file_list(state_dir))
         {
             try
             {
-                import_persistent_configuration(fname);
+                import_persistent_configuration(fname, index);
             }
             catch (const openvpn::option_error& excp)
             {
@@ -1205,7 +2444,7 @@ public:
             catch (const DBusException& excp)
             {
                 std::string err(excp.what());
-                if (err.find("failed: An object is already exported for the interface") != std::string::npos)
+                if (err.find("Configuration object already registered") != std::string::npos)
                 {
                     LogCritical("Could not import persistent configuration: " + fname);
                 }
@@ -1220,6 +2459,60 @@ public:
                             + ": " + std::string(excp.what()));
             }
         }
+
+        // Pick up new and changed configuration files in the index
+        write_index();
+    }
+
+
+    /**
+     *  Sets how long the profiles of persistent configurations are kept
+     *  in memory after they were last used.  Evicted profiles are loaded
+     *  from their persistent configuration file again on the next use.
+     *
+     * @param seconds  Number of seconds; 0 keeps all loaded profiles in
+     *                 memory
+     */
+    void SetProfileCacheTime(const unsigned int seconds)
+    {
+        if (0 != evict_timer)
+        {
+            g_source_remove(evict_timer);
+            evict_timer = 0;
+        }
+        profile_cache_time = seconds;
+        if (0 == profile_cache_time)
+        {
+            return;
+        }
+        evict_timer = g_timeout_add_seconds(std::max(1u, profile_cache_time / 2),
+                                            [](gpointer data) -> gboolean
+                                            {
+                                                auto self = static_cast<ConfigManagerObject *>(data);
+                                                self->evict_idle_profiles();
+                                                return G_SOURCE_CONTINUE;
+                                            },
+                                            this);
+    }
+
+
+    /**
+     *  Writes all pending changes of the persistent configurations and
+     *  the persistent configuration index to disk.  This must be called
+     *  before the service stops.
+     */
+    void FlushPersistentConfigs()
+    {
+        for (const auto& item : config_objects)
+        {
+            item.second->FlushPersistentFile();
+        }
+        if (0 != index_timer)
+        {
+            g_source_remove(index_timer);
+            index_timer = 0;
+            write_index();
+        }
     }
 
 
@@ -1245,41 +2538,136 @@ public:
                               GVariant *params,
                               GDBusMethodInvocation *invoc)
     {
-        IdleCheck_UpdateTimestamp();
         if ("Import" == method_name)
         {
-            // Import the configuration
-            std::string cfgpath = generate_path_uuid(OpenVPN3DBus_rootp_configuration, 'x');
-            ConfigurationObject *cfgobj;
+            // Import the configuration; the reply is sent when the
+            // profile has been parsed
+            GLibUtils::checkParams(__func__, params, "(ssbb)", 4);
+            const gchar *name = nullptr;
+            const gchar *cfgstr = nullptr;
+            gboolean single_use = false;
+            gboolean persistent = false;
+            g_variant_get(params, "(&s&sbb)",
+                          &name, &cfgstr, &single_use, &persistent);
+            import_config(invoc, creds.GetUID(sender), name, cfgstr,
+                          single_use, persistent);
+        }
+        else if ("ImportFD" == method_name)
+        {
+            // Import the configuration from a sealed memfd passed
+            // together with the method call
+            GLibUtils::checkParams(__func__, params, "(sbb)", 3);
+            int fd = GLibUtils::get_fd_from_invocation(invoc);
+            if (fd < 0)
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.import",
+                                                              "No file descriptor provided");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
 
+            std::string cfgstr;
             try
             {
-                cfgobj = new ConfigurationObject(dbuscon,
-                                                 [self=Ptr(this), cfgpath]()
-                                                 {
-                                                    self->remove_config_object(cfgpath);
-                                                 },
-                                                 cfgpath,
-                                                 GetLogLevel(),
-                                                 GetLogWriterPtr(),
-                                                 GetSignalBroadcast(),
-                                                 creds.GetUID(sender),
-                                                 state_dir,
-                                                 params);
-
-                register_config_object(cfgobj, "created");
-                g_dbus_method_invocation_return_value(invoc, g_variant_new("(o)", cfgpath.c_str()));
+                cfgstr = MemFD::ReadSealed(fd, ProfileParseLimits::MAX_PROFILE_SIZE);
+                close(fd);
             }
-            catch (const openvpn::option_error& excp)
+            catch (const MemFDException& excp)
+            {
+                close(fd);
+                return_import_error(invoc, excp.what());
+                return;
+            }
+            import_config(invoc, creds.GetUID(sender),
+                          GLibUtils::ExtractValue<std::string>(params, 0),
+                          cfgstr,
+                          GLibUtils::ExtractValue<bool>(params, 1),
+                          GLibUtils::ExtractValue<bool>(params, 2));
+        }
+        else if ("ImportParsedFD" == method_name)
+        {
+            // Import a configuration profile already parsed by the
+            // caller, passed as its options in a sealed memfd
+            GLibUtils::checkParams(__func__, params, "(sbb)", 3);
+            int fd = GLibUtils::get_fd_from_invocation(invoc);
+            if (fd < 0)
             {
-                std::string em{"Invalid configuration profile: "};
-                em += std::string(excp.what());
                 GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.import",
-                                                              em.c_str());
+                                                              "No file descriptor provided");
                 g_dbus_method_invocation_return_gerror(invoc, err);
                 g_error_free(err);
                 return;
             }
+
+            std::string optdata;
+            try
+            {
+                // The serialized options carry some overhead per string
+                // on top of the profile text
+                optdata = MemFD::ReadSealed(fd, 2 * ProfileParseLimits::MAX_PROFILE_SIZE);
+                close(fd);
+            }
+            catch (const MemFDException& excp)
+            {
+                close(fd);
+                return_import_error(invoc, excp.what());
+                return;
+            }
+            import_profile(invoc, creds.GetUID(sender),
+                           GLibUtils::ExtractValue<std::string>(params, 0),
+                           GLibUtils::ExtractValue<bool>(params, 1),
+                           GLibUtils::ExtractValue<bool>(params, 2),
+                           [optdata](ProfileBlobStore::Ptr store)
+                           {
+                               return ConfigurationObject::ProfileFromOptions(optdata, store);
+                           });
+        }
+        else if ("ImportBulk" == method_name)
+        {
+            GLibUtils::checkParams(__func__, params, "(a(ssbba{sv}bb))", 1);
+            GVariantIter *profiles = nullptr;
+            g_variant_get(params, "(a(ssbba{sv}bb))", &profiles);
+
+            // Each profile is imported on its own; a profile failing
+            // does not stop the others from being imported
+            auto bulk = std::make_shared<BulkImport>();
+            GVariant *prof = nullptr;
+            while ((prof = g_variant_iter_next_value(profiles)))
+            {
+                const gchar *name = nullptr;
+                const gchar *cfgstr = nullptr;
+                gboolean single_use = false;
+                gboolean persistent = false;
+                GVariant *overrides = nullptr;
+                gboolean public_access = false;
+                gboolean locked_down = false;
+                g_variant_get(prof, "(&s&sbb@a{sv}bb)",
+                              &name, &cfgstr, &single_use, &persistent,
+                              &overrides, &public_access, &locked_down);
+
+                BulkImport::Item item;
+                item.name = name;
+                item.cfgstr = cfgstr;
+                item.single_use = single_use;
+                item.persistent = persistent;
+                item.public_access = public_access;
+                item.locked_down = locked_down;
+                try
+                {
+                    item.overrides = ConfigurationObject::ParseImportOverrides(overrides);
+                }
+                catch (const std::exception& excp)
+                {
+                    item.error = excp.what();
+                }
+                bulk->items.push_back(std::move(item));
+                g_variant_unref(overrides);
+                g_variant_unref(prof);
+            }
+            g_variant_iter_free(profiles);
+
+            import_bulk(invoc, creds.GetUID(sender), bulk);
         }
         else if ("FetchAvailableConfigs" == method_name)
         {
@@ -1310,7 +2698,76 @@ public:
 
             // Clean-up
             g_variant_builder_unref(bld);
-            g_variant_builder_unref(ret);
+            g_variant_builder_unref(ret);
+        }
+        else if ("FetchAvailableConfigsDetailed" == method_name)
+        {
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{oa{sv}}"));
+            for (auto& item : config_objects)
+            {
+                try
+                {
+                    // Only include configurations the caller has access to
+                    item.second->CheckACL(sender);
+                    g_variant_builder_add(bld, "{o@a{sv}}", item.first.c_str(),
+                                          item.second->GetConfigDetails());
+                }
+                catch (DBusCredentialsException& excp)
+                {
+                    // Ignore credentials exceptions.  It means the
+                    // caller does not have access this configuration object
+                }
+            }
+            g_dbus_method_invocation_return_value(invoc,
+                                                  GLibUtils::wrapInTuple(bld));
+        }
+        else if ("FetchConfigsFiltered" == method_name)
+        {
+            ListFilter filter;
+            try
+            {
+                filter = ParseListFilterArgs(params);
+                if (filter.status_set)
+                {
+                    throw std::invalid_argument("Configurations have no status_major");
+                }
+            }
+            catch (const std::invalid_argument& excp)
+            {
+                ReturnListFilterError(invoc, excp);
+                return;
+            }
+
+            // The filter is checked first; it is cheaper than the
+            // access check
+            std::vector<std::string> matches;
+            for (const auto& item : config_objects)
+            {
+                if (!filter.Match(item.second->GetListFilterItem()))
+                {
+                    continue;
+                }
+                try
+                {
+                    item.second->CheckACL(sender);
+                    matches.push_back(item.first);
+                }
+                catch (DBusCredentialsException& excp)
+                {
+                    // Ignore credentials exceptions.  It means the
+                    // caller does not have access this configuration object
+                }
+            }
+
+            ListFilter::Page page = filter.Select(std::move(matches));
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("ao"));
+            for (const auto& path : page.paths)
+            {
+                g_variant_builder_add(bld, "o", path.c_str());
+            }
+            g_dbus_method_invocation_return_value(invoc,
+                                                  g_variant_new("(aos)", bld, page.next.c_str()));
+            g_variant_builder_unref(bld);
         }
         else if ("LookupConfigName" == method_name)
         {
@@ -1330,24 +2787,27 @@ public:
 
             // Build up an array of object paths to available config objects
             GVariantBuilder *found_paths = g_variant_builder_new(G_VARIANT_TYPE("ao"));
-            for (const auto& item : config_objects)
+            auto range = name_index.equal_range(cfgname);
+            for (auto it = range.first; it != range.second; ++it)
             {
-                if (item.second->GetConfigName() == cfgname)
+                auto cfg = config_objects.find(it->second);
+                if (config_objects.end() == cfg)
+                {
+                    continue;
+                }
+                try
+                {
+                    // We check if the caller is allowed to access this
+                    // configuration object.  If not, an exception is thrown
+                    // and we will just ignore that exception and continue
+                    cfg->second->CheckACL(sender);
+                    g_variant_builder_add(found_paths,
+                                          "o", cfg->first.c_str());
+                }
+                catch (DBusCredentialsException& excp)
                 {
-                    try
-                    {
-                        // We check if the caller is allowed to access this
-                        // configuration object.  If not, an exception is thrown
-                        // and we will just ignore that exception and continue
-                        item.second->CheckACL(sender);
-                        g_variant_builder_add(found_paths,
-                                              "o", item.first.c_str());
-                    }
-                    catch (DBusCredentialsException& excp)
-                    {
-                        // Ignore credentials exceptions.  It means the
-                        // caller does not have access this configuration object
-                    }
+                    // Ignore credentials exceptions.  It means the
+                    // caller does not have access this configuration object
                 }
             }
             g_dbus_method_invocation_return_value(invoc, GLibUtils::wrapInTuple(found_paths));
@@ -1377,6 +2837,7 @@ public:
                 {
                     uid_t cur_owner = ci.second->GetOwnerUID();
                     ci.second->TransferOwnership(new_uid);
+                    ++change_counter;
                     g_dbus_method_invocation_return_value(invoc, NULL);
 
                     std::stringstream msg;
@@ -1421,13 +2882,16 @@ public:
                                      const std::string property_name,
                                      GError **error)
     {
-        IdleCheck_UpdateTimestamp();
         GVariant *ret = nullptr;
 
         if ("version" == property_name)
         {
             ret = g_variant_new_string(package_version());
         }
+        else if ("change_counter" == property_name)
+        {
+            ret = g_variant_new_uint64(change_counter);
+        }
         else
         {
             g_set_error (error,
@@ -1473,13 +2937,355 @@ private:
     GDBusConnection *dbuscon;
     DBusConnectionCreds creds;
     std::string state_dir;
-    std::map<std::string, ConfigurationObject *> config_objects;
+    ObjectPathAllocator cfgpaths{OpenVPN3DBus_rootp_configuration, 'x'};
+    std::unordered_map<std::string, ConfigurationObject *> config_objects;
+    std::unique_ptr<DBusObjectManager<ConfigurationObject>> objmgr;
+    std::unique_ptr<DBusObjectSubtree> subtree;
+
+    /// Configuration names to object paths, used by LookupConfigName
+    std::multimap<std::string, std::string> name_index;
+
+    /**
+     *  Changed each time a configuration object is added, removed,
+     *  renamed or changes owner.  Starts at the service start time, so
+     *  a restarted service does not repeat values of an earlier instance.
+     */
+    uint64_t change_counter = g_get_real_time();
+    ProfileBlobStore::Ptr blobstore = std::make_shared<ProfileBlobStore>();
+    guint index_timer = 0;
+    unsigned int profile_cache_time = 0;
+    guint evict_timer = 0;
+    DBusResourceUsage::ReporterId usage_reporter = 0;
+    WorkerPool::Ptr import_workers;
+
+    /// Version of the persistent configuration index file format
+    static const unsigned int index_version = 1;
+
+
+    /**
+     *  A configuration profile of an ImportBulk call, with its parse
+     *  result.  The profiles are parsed by the import workers in
+     *  parallel; each Item is only accessed by one of them.
+     */
+    struct BulkImport
+    {
+        struct Item
+        {
+            std::string name;
+            std::string cfgstr;
+            bool single_use = false;
+            bool persistent = false;
+            bool public_access = false;
+            bool locked_down = false;
+            std::vector<OverrideValue> overrides;
+            CompactProfile profile;
+            std::string error;    ///< Empty if the profile can be imported
+        };
+
+        std::vector<Item> items;
+        std::atomic<size_t> remaining{0};  ///< Items still being parsed
+    };
+
+
+    /**
+     *  Runs a function from the GLib main loop.  This is always deferred,
+     *  also when called from the main loop thread itself.
+     *
+     * @param func  Function to run
+     */
+    static void run_in_main_loop(std::function<void()> func)
+    {
+        g_idle_add_full(G_PRIORITY_DEFAULT,
+                        [](gpointer data) -> gboolean
+                        {
+                            try
+                            {
+                                (*static_cast<std::function<void()> *>(data))();
+                            }
+                            catch (const std::exception& excp)
+                            {
+                                std::cerr << "** ERROR ** " << excp.what()
+                                          << std::endl;
+                            }
+                            return G_SOURCE_REMOVE;
+                        },
+                        new std::function<void()>(std::move(func)),
+                        [](gpointer data)
+                        {
+                            delete static_cast<std::function<void()> *>(data);
+                        });
+    }
+
+
+    /**
+     *  Returns a net.openvpn.v3.error.import error to the caller of
+     *  an Import or ImportFD method call
+     *
+     * @param invoc  GDBusMethodInvocation to reply to
+     * @param msg    std::string with the error message
+     */
+    static void return_import_error(GDBusMethodInvocation *invoc,
+                                    const std::string& msg)
+    {
+        GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.import",
+                                                      msg.c_str());
+        g_dbus_method_invocation_return_gerror(invoc, err);
+        g_error_free(err);
+    }
+
+
+    /**
+     *  Parses a configuration profile in the import worker threads,
+     *  which may take a while for large profiles.  The configuration
+     *  object is then created and registered from the main loop, where
+     *  the Import or ImportFD method call is replied to.
+     *
+     * @param invoc       GDBusMethodInvocation to reply to
+     * @param owner       uid_t of the caller, who becomes the owner of
+     *                    the configuration
+     * @param name        std::string with the configuration name
+     * @param cfgstr      std::string with the configuration profile
+     * @param single_use  Remove the configuration after the first use
+     * @param persistent  Save the configuration to disk
+     */
+    void import_config(GDBusMethodInvocation *invoc, uid_t owner,
+                       const std::string& name, const std::string& cfgstr,
+                       bool single_use, bool persistent)
+    {
+        import_profile(invoc, owner, name, single_use, persistent,
+                       [cfgstr](ProfileBlobStore::Ptr store)
+                       {
+                           return ConfigurationObject::ParseProfile(cfgstr, store);
+                       });
+    }
+
+
+    /**
+     *  Builds a configuration profile in the import worker threads and
+     *  then creates and registers the configuration object from the main
+     *  loop, where the import method call is replied to.
+     *
+     * @param invoc       GDBusMethodInvocation to reply to
+     * @param owner       uid_t of the caller, who becomes the owner of
+     *                    the configuration
+     * @param name        std::string with the configuration name
+     * @param single_use  Remove the configuration after the first use
+     * @param persistent  Save the configuration to disk
+     * @param build       Function building the CompactProfile, run in
+     *                    an import worker thread
+     */
+    void import_profile(GDBusMethodInvocation *invoc, uid_t owner,
+                        const std::string& name,
+                        bool single_use, bool persistent,
+                        std::function<CompactProfile(ProfileBlobStore::Ptr)> build)
+    {
+        // Do not let the service exit while an import is in flight
+        IdleCheck_RefInc();
+        import_workers->Post([self=Ptr(this), invoc, owner, name, build,
+                              single_use, persistent, store=blobstore]()
+        {
+            auto profile = std::make_shared<CompactProfile>();
+            std::string error;
+            try
+            {
+                *profile = build(store);
+            }
+            catch (const openvpn::option_error& excp)
+            {
+                error = "Invalid configuration profile: " + std::string(excp.what());
+            }
+            catch (const std::exception& excp)
+            {
+                error = excp.what();
+            }
+
+            run_in_main_loop([self, invoc, owner, name, single_use,
+                              persistent, profile, error]()
+            {
+                self->IdleCheck_RefDec();
+                if (!error.empty())
+                {
+                    return_import_error(invoc, error);
+                    return;
+                }
+                try
+                {
+                    ConfigurationObject *cfgobj = self->create_config_object(owner, name,
+                                                                             std::move(*profile),
+                                                                             single_use,
+                                                                             persistent);
+                    self->register_config_object(cfgobj, "created");
+                    g_dbus_method_invocation_return_value(invoc,
+                                                          g_variant_new("(o)", cfgobj->GetObjectPath().c_str()));
+                }
+                catch (const std::exception& excp)
+                {
+                    return_import_error(invoc, excp.what());
+                }
+            });
+        });
+    }
+
+
+    /**
+     *  Parses the configuration profiles of an ImportBulk method call
+     *  in the import worker threads, in parallel.  When all of them
+     *  are done, the configuration objects are created and registered
+     *  from the main loop, in the order given by the caller, and the
+     *  method call is replied to.
+     *
+     * @param invoc  GDBusMethodInvocation to reply to
+     * @param owner  uid_t of the caller, who becomes the owner of the
+     *               configurations
+     * @param bulk   BulkImport with the profiles to import
+     */
+    void import_bulk(GDBusMethodInvocation *invoc, uid_t owner,
+                     std::shared_ptr<BulkImport> bulk)
+    {
+        IdleCheck_RefInc();
+        auto complete = [self=Ptr(this), invoc, owner, bulk]()
+        {
+            self->IdleCheck_RefDec();
+            self->complete_bulk_import(invoc, owner, *bulk);
+        };
+
+        std::vector<size_t> parse;
+        for (size_t i = 0; i < bulk->items.size(); ++i)
+        {
+            if (bulk->items[i].error.empty())
+            {
+                parse.push_back(i);
+            }
+        }
+        if (parse.empty())
+        {
+            run_in_main_loop(complete);
+            return;
+        }
+
+        bulk->remaining = parse.size();
+        for (const auto& i : parse)
+        {
+            import_workers->Post([bulk, i, complete, store=blobstore]()
+            {
+                BulkImport::Item& item = bulk->items[i];
+                try
+                {
+                    item.profile = ConfigurationObject::ParseProfile(item.cfgstr, store);
+                }
+                catch (const std::exception& excp)
+                {
+                    item.error = excp.what();
+                }
+                item.cfgstr.clear();
+                item.cfgstr.shrink_to_fit();
+
+                if (0 == --bulk->remaining)
+                {
+                    run_in_main_loop(complete);
+                }
+            });
+        }
+    }
+
+
+    /**
+     *  Creates and registers the configuration objects of a parsed
+     *  ImportBulk call and replies to it.  Runs in the main loop.
+     *
+     * @param invoc  GDBusMethodInvocation to reply to
+     * @param owner  uid_t of the owner of the configurations
+     * @param bulk   BulkImport with the parsed profiles
+     */
+    void complete_bulk_import(GDBusMethodInvocation *invoc, uid_t owner,
+                              BulkImport& bulk)
+    {
+        GVariantBuilder *res = g_variant_builder_new(G_VARIANT_TYPE("a(os)"));
+        unsigned int imported = 0;
+        unsigned int failed = 0;
+        for (auto& item : bulk.items)
+        {
+            try
+            {
+                if (!item.error.empty())
+                {
+                    throw std::runtime_error(item.error);
+                }
+                ConfigurationObject *cfgobj = create_config_object(owner, item.name,
+                                                                   std::move(item.profile),
+                                                                   item.single_use,
+                                                                   item.persistent);
+
+                cfgobj->ApplyImportSettings(item.overrides, item.public_access,
+                                            item.locked_down);
+                register_config_object(cfgobj, "created (bulk import)");
+                g_variant_builder_add(res, "(os)",
+                                      cfgobj->GetObjectPath().c_str(), "");
+                ++imported;
+            }
+            catch (const std::exception& excp)
+            {
+                std::string em{"Could not import '" + item.name + "': "};
+                em += std::string(excp.what());
+                LogWarn(em);
+                g_variant_builder_add(res, "(os)", "/", excp.what());
+                ++failed;
+            }
+        }
+
+        LogInfo("Bulk import by UID " + std::to_string(owner)
+                + ": " + std::to_string(imported) + " imported, "
+                + std::to_string(failed) + " failed");
+        g_dbus_method_invocation_return_value(invoc,
+                                              GLibUtils::wrapInTuple(res));
+    }
+
+
+    /**
+     *  Creates a new ConfigurationObject from a parsed configuration
+     *  profile.  The object is not registered on the D-Bus.
+     *
+     * @param owner       uid_t of the owner of the configuration
+     * @param name        std::string with the configuration name
+     * @param profile     CompactProfile from ConfigurationObject::ParseProfile()
+     * @param single_use  Remove the configuration after the first use
+     * @param persistent  Save the configuration to disk
+     *
+     * @return Returns a pointer to the new ConfigurationObject
+     */
+    ConfigurationObject * create_config_object(uid_t owner,
+                                               const std::string& name,
+                                               CompactProfile&& profile,
+                                               bool single_use,
+                                               bool persistent)
+    {
+        std::string cfgpath = cfgpaths.Allocate().path;
+        return new ConfigurationObject(dbuscon,
+                                       [self=Ptr(this), cfgpath]()
+                                       {
+                                           self->remove_config_object(cfgpath);
+                                       },
+                                       cfgpath,
+                                       GetLogLevel(),
+                                       GetLogWriterPtr(),
+                                       GetSignalBroadcast(),
+                                       owner,
+                                       state_dir,
+                                       name, std::move(profile),
+                                       single_use, persistent,
+                                       blobstore,
+                                       [self=Ptr(this)]()
+                                       {
+                                           self->schedule_index_update();
+                                       });
+    }
 
 
     /**
      *  Register a new configuration object on the D-Bus, with the
      *  idle-check reference counting, internal object tracking and
-     *  logging handled.
+     *  logging handled.  The object is served through the subtree
+     *  registration of the configuration manager.
      *
      * @param cfgobj    ConfigurationObject pointer to register
      * @param operation std::string used for logging, describing how it
@@ -1488,10 +3294,27 @@ private:
     void register_config_object(ConfigurationObject *cfgobj,
                                 const std::string& operation)
     {
+        const std::string cfgpath = cfgobj->GetObjectPath();
+        if (config_objects.count(cfgpath) > 0)
+        {
+            THROW_DBUSEXCEPTION("ConfigManagerObject",
+                                "Configuration object already registered: "
+                                + cfgpath);
+        }
         IdleCheck_RefInc();
         cfgobj->IdleCheck_Register(IdleCheck_Get());
-        cfgobj->RegisterObject(dbuscon);
-        config_objects[cfgobj->GetObjectPath()] = cfgobj;
+        cfgobj->RegisterSubtreeObject(dbuscon);
+        config_objects[cfgpath] = cfgobj;
+        objmgr->ObjectAdded(cfgobj);
+        name_index.emplace(cfgobj->GetConfigName(), cfgpath);
+        ++change_counter;
+        cfgobj->SetRenameCallback([self=Ptr(this), cfgpath](const std::string& oldname,
+                                                            const std::string& newname)
+                                  {
+                                      self->unindex_name(oldname, cfgpath);
+                                      self->name_index.emplace(newname, cfgpath);
+                                      ++self->change_counter;
+                                  });
 
         Debug("New configuration object " + operation + ": "
               + cfgobj->GetObjectPath()
@@ -1532,6 +3355,14 @@ private:
         std::vector<std::string> filelist;
         while (nullptr != (entry = readdir(dirfd)))
         {
+            // Only files and symbolic links are relevant, which most
+            // file systems report without a separate lstat() call
+            if (DT_UNKNOWN != entry->d_type
+                && DT_REG != entry->d_type && DT_LNK != entry->d_type)
+            {
+                continue;
+            }
+
             // Filter out filenames not relevant.  The expected format is:
             //    34eea818xe578x4356x924bx9fccbbeb92eb.json
             // which, for simplicity is checked as:
@@ -1545,6 +3376,11 @@ private:
 
             std::stringstream fullpath;
             fullpath <<  directory << "/" << fname;
+            if (DT_UNKNOWN != entry->d_type)
+            {
+                filelist.push_back(fullpath.str());
+                continue;
+            }
 
             // Filter out only files and symbolic links
             struct stat stbuf;
@@ -1588,17 +3424,34 @@ private:
      *  The file must be a JSON formatted text file based on the file
      *  format generated by @ConfigurationObject::Export()
      *
+     *  If the index has an entry for an unchanged file, the settings are
+     *  taken from the index and the file itself is not read.
+     *
      * @param fname  std::string with the filename to import
+     * @param index  Json::Value with the index loaded by load_index()
      */
-    void import_persistent_configuration(const std::string& fname)
+    void import_persistent_configuration(const std::string& fname,
+                                         const Json::Value& index)
     {
-        LogVerb1("Loading persistent configuration: " + fname);
-
-        // Load the JSON file and parse it
-        std::ifstream statefile(fname, std::ifstream::binary);
         Json::Value data;
-        statefile >> data;
-        statefile.close();
+        const Json::Value& entry = index[simple_basename(fname)];
+        struct stat st;
+        if (entry.isObject() && entry["meta"].isObject()
+            && 0 == stat(fname.c_str(), &st)
+            && entry["size"].asUInt64() == (uint64_t) st.st_size
+            && entry["mtime"].asInt64() == (int64_t) st.st_mtim.tv_sec
+            && entry["mtime_nsec"].asInt64() == (int64_t) st.st_mtim.tv_nsec)
+        {
+            LogVerb2("Loading indexed persistent configuration: " + fname);
+            data = entry["meta"];
+        }
+        else
+        {
+            LogVerb1("Loading persistent configuration: " + fname);
+
+            // Load the JSON file and parse it
+            data = JsonIO::LoadFile(fname);
+        }
 
         // Extract the configuration path and prepare the
         // remove callback function required to create the
@@ -1618,7 +3471,12 @@ private:
                                          remove_cb,
                                          GetLogLevel(),
                                          GetLogWriterPtr(),
-                                         GetSignalBroadcast());
+                                         GetSignalBroadcast(),
+                                         blobstore,
+                                         [self=Ptr(this)]()
+                                         {
+                                            self->schedule_index_update();
+                                         });
 
         // Register the configuration object in this D-Bus service
         register_config_object(cfgobj, "loaded");
@@ -1635,7 +3493,170 @@ private:
      */
     void remove_config_object(const std::string cfgpath)
     {
-        config_objects.erase(cfgpath);
+        auto cfg = config_objects.find(cfgpath);
+        if (config_objects.end() != cfg)
+        {
+            objmgr->ObjectRemoved(cfg->second);
+            unindex_name(cfg->second->GetConfigName(), cfgpath);
+            config_objects.erase(cfg);
+            ++change_counter;
+        }
+        schedule_index_update();
+    }
+
+
+    /**
+     *  Removes a configuration object from the name index
+     *
+     * @param cfgname  std::string with the configuration name it is
+     *                 indexed under
+     * @param cfgpath  std::string with the configuration object path
+     */
+    void unindex_name(const std::string& cfgname, const std::string& cfgpath)
+    {
+        auto range = name_index.equal_range(cfgname);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == cfgpath)
+            {
+                name_index.erase(it);
+                return;
+            }
+        }
+    }
+
+
+    /**
+     * @return Returns a std::string with the path to the persistent
+     *         configuration index file
+     */
+    std::string index_file() const
+    {
+        return state_dir + "/index.json";
+    }
+
+
+    /**
+     *  Loads the persistent configuration index file
+     *
+     * @return Returns a Json::Value object with an entry per file name.
+     *         Empty if the index is missing or not usable.
+     */
+    Json::Value load_index()
+    {
+        Json::Value index;
+        try
+        {
+            if (0 != access(index_file().c_str(), F_OK))
+            {
+                return Json::Value();
+            }
+            index = JsonIO::LoadFile(index_file());
+        }
+        catch (const std::exception& excp)
+        {
+            LogWarn("Ignoring invalid persistent configuration index: "
+                    + std::string(excp.what()));
+            return Json::Value();
+        }
+
+        if (index_version != index["version"].asUInt())
+        {
+            return Json::Value();
+        }
+        return index["configs"];
+    }
+
+
+    /**
+     *  Updates the persistent configuration index a little later, so
+     *  several changes only cause a single update
+     */
+    void schedule_index_update()
+    {
+        if (state_dir.empty() || 0 != index_timer)
+        {
+            return;
+        }
+        index_timer = g_timeout_add_seconds(1,
+                                            [](gpointer data) -> gboolean
+                                            {
+                                                auto self = static_cast<ConfigManagerObject *>(data);
+                                                self->index_timer = 0;
+                                                self->write_index();
+                                                return G_SOURCE_REMOVE;
+                                            },
+                                            this);
+    }
+
+
+    /**
+     *  Drops the profiles of the persistent configurations not used
+     *  within the profile cache time from memory, see
+     *  SetProfileCacheTime()
+     */
+    void evict_idle_profiles()
+    {
+        const std::time_t idle_before = std::time(nullptr) - profile_cache_time;
+        unsigned int evicted = 0;
+        for (const auto& cfg : config_objects)
+        {
+            if (cfg.second->EvictProfile(idle_before))
+            {
+                ++evicted;
+            }
+        }
+        if (evicted > 0)
+        {
+            LogVerb2("Evicted " + std::to_string(evicted)
+                     + " idle configuration profiles from memory");
+        }
+    }
+
+
+    /**
+     *  Writes the persistent configuration index file.  Each persistent
+     *  configuration gets an entry with the settings last written to its
+     *  file and the size and modification time of that file.
+     */
+    void write_index()
+    {
+        if (state_dir.empty())
+        {
+            return;
+        }
+
+        Json::Value index;
+        index["version"] = index_version;
+        index["configs"] = Json::Value(Json::objectValue);
+        for (const auto& item : config_objects)
+        {
+            const std::string fname = item.second->GetPersistentFile();
+            const Json::Value& meta = item.second->GetPersistedMeta();
+            struct stat st;
+            if (fname.empty() || !meta.isObject()
+                || 0 != stat(fname.c_str(), &st))
+            {
+                continue;
+            }
+
+            Json::Value entry;
+            entry["size"] = (Json::UInt64) st.st_size;
+            entry["mtime"] = (Json::Int64) st.st_mtim.tv_sec;
+            entry["mtime_nsec"] = (Json::Int64) st.st_mtim.tv_nsec;
+            entry["meta"] = meta;
+            index["configs"][simple_basename(fname)] = entry;
+        }
+
+        try
+        {
+            write_file_atomic(index_file(), JsonIO::Write(index, true));
+        }
+        catch (const std::exception& excp)
+        {
+            LogError("Could not update persistent configuration index: "
+                     + std::string(excp.what()));
+        }
     }
 };
 
@@ -1677,6 +3698,12 @@ public:
 
     ~ConfigManagerDBus()
     {
+        if (cfgmgr)
+        {
+            // The configuration objects keep the manager object alive,
+            // so it is not destroyed here
+            cfgmgr->FlushPersistentConfigs();
+        }
         procsig->ProcessChange(StatusMinor::PROC_STOPPED);
     }
 
@@ -1707,6 +3734,32 @@ public:
     }
 
 
+    /**
+     *  Sets the number of threads parsing imported configuration
+     *  profiles outside of the main loop.
+     *
+     * @param threads  Number of worker threads; 0 parses the profiles
+     *                 in the main loop
+     */
+    void SetImportThreads(unsigned int threads)
+    {
+        import_threads = threads;
+    }
+
+
+    /**
+     *  Sets how long the profiles of persistent configurations are kept
+     *  in memory after their last use, see
+     *  ConfigManagerObject::SetProfileCacheTime()
+     *
+     * @param seconds  Number of seconds; 0 keeps them in memory
+     */
+    void SetProfileCacheTime(unsigned int seconds)
+    {
+        profile_cache_time = seconds;
+    }
+
+
     /**
      *  This callback is called when the service was successfully registered
      *  on the D-Bus.
@@ -1715,14 +3768,17 @@ public:
     {
         cfgmgr.reset(new ConfigManagerObject(GetConnection(), GetRootPath(),
                                              default_log_level, logwr,
-                                             signal_broadcast));
+                                             signal_broadcast, import_threads));
         cfgmgr->RegisterObject(GetConnection());
+        cfgmgr->GetObjectManager().RegisterObject(GetConnection());
 
         if (!state_dir.empty())
         {
             try
             {
                 cfgmgr->SetStateDirectory(state_dir);
+                cfgmgr->SetProfileCacheTime(profile_cache_time);
+                StartupTiming::Instance().Mark("persistent_configs_loaded");
             }
             catch (const DBusException& excp)
             {
@@ -1761,6 +3817,17 @@ public:
     };
 
 
+    /**
+     *  Logs the start-up timeline of the configuration manager
+     *
+     * @param timeline  std::string with the StartupTiming summary
+     */
+    void callback_startup_complete(const std::string& timeline)
+    {
+        cfgmgr->LogInfo("Start-up completed: " + timeline);
+    }
+
+
     /**
      *  This is called each time the well-known bus name is removed from the
      *  D-Bus.  In our case, we just throw an exception and starts shutting
@@ -1781,6 +3848,8 @@ private:
     LogWriter *logwr = nullptr;
     bool signal_broadcast = true;
     std::string state_dir = "";
+    unsigned int import_threads = 2;
+    unsigned int profile_cache_time = 600;
     ConfigManagerObject::Ptr cfgmgr;
     ProcessSignalProducer::Ptr procsig;
 };
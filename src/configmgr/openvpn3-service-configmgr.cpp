@@ -26,6 +26,7 @@
 #include "log/dbus-log.hpp"
 #include "log/proxy-log.hpp"
 #include "common/cmdargparser.hpp"
+#include "common/startup-timing.hpp"
 #include "common/utils.hpp"
 
 using namespace openvpn;
@@ -86,8 +87,11 @@ static int config_manager(ParsedArgs::Ptr args)
     LogServiceProxy::Ptr logsrvprx = nullptr;
     if (!signal_broadcast)
     {
-        logsrvprx = LogServiceProxy::AttachInterface(dbus.GetConnection(),
-                                                     OpenVPN3DBus_interf_configuration);
+        // Attached from the main loop, so our own bus name is not held
+        // back by the log service being activated
+        LogServiceProxy::AttachInterfaceDeferred(dbus.GetConnection(),
+                                                 {OpenVPN3DBus_interf_configuration},
+                                                 logsrvprx);
     }
     unsigned int log_level = 3;
     if (args->Present("log-level"))
@@ -96,6 +100,16 @@ static int config_manager(ParsedArgs::Ptr args)
     }
     cfgmgr.SetLogLevel(log_level);
 
+    if (args->Present("import-threads"))
+    {
+        cfgmgr.SetImportThreads(std::atoi(args->GetValue("import-threads", 0).c_str()));
+    }
+
+    if (args->Present("profile-cache-time"))
+    {
+        cfgmgr.SetProfileCacheTime(std::atoi(args->GetValue("profile-cache-time", 0).c_str()));
+    }
+
     if (args->Present("state-dir"))
     {
         cfgmgr.SetStateDirectory(args->GetValue("state-dir", 0));
@@ -133,7 +147,6 @@ static int config_manager(ParsedArgs::Ptr args)
     if (idle_wait_min > 0)
     {
         idle_exit->Disable();
-        idle_exit->Join();
     }
 
     return 0;
@@ -142,6 +155,8 @@ static int config_manager(ParsedArgs::Ptr args)
 
 int main(int argc, char **argv)
 {
+    StartupTiming::Instance().Mark("main");
+
     SingleCommand argparser(argv[0], "OpenVPN 3 Configuration Manager",
                             config_manager);
     argparser.AddVersionOption();
@@ -158,6 +173,13 @@ int main(int argc, char **argv)
                         "0 disables it (Default: 3 minutes)");
     argparser.AddOption("state-dir", 0, "DIRECTORY", true,
                         "Directory where to save persistent data");
+    argparser.AddOption("import-threads", "THREADS", true,
+                        "Number of threads parsing imported configuration profiles. "
+                        "0 parses them in the main loop (Default: 2)");
+    argparser.AddOption("profile-cache-time", "SECONDS", true,
+                        "How long profiles of persistent configurations are kept "
+                        "in memory after their last use. "
+                        "0 keeps them (Default: 600 seconds)");
 
 
     try
@@ -23,25 +23,53 @@
  * @brief  Code needed to handle configuration overrides
  */
 
+#include <algorithm>
+#include <cctype>
 #include <string>
+#include <unordered_map>
 
 #include "overrides.hpp"
 
+
+/**
+ *  Index of configProfileOverrides, by the override key.  It is built
+ *  on the first lookup and used by all later lookups.
+ */
+static const std::unordered_map<std::string, const ValidOverride *>& override_index()
+{
+    static const std::unordered_map<std::string, const ValidOverride *> index =
+        []()
+        {
+            std::unordered_map<std::string, const ValidOverride *> idx;
+            for (const auto& vo : configProfileOverrides)
+            {
+                idx.emplace(vo.key, &vo);
+            }
+            return idx;
+        }();
+    return index;
+}
+
+
 const ValidOverride & GetConfigOverride(const std::string & key, bool ignoreCase)
 {
-    for (const auto& vo: configProfileOverrides)
+    const auto& index = override_index();
+    auto it = index.find(key);
+    if (index.end() != it)
     {
-        if (vo.key==key)
-        {
-           return vo;
-        }
+        return *it->second;
+    }
 
-        // This is appearently the best way to do a case insenstive
-        // comparision in C++
-        if (ignoreCase && std::equal(vo.key.begin(), vo.key.end(), key.begin(),
-            [](char a, char b) { return std::tolower(a) == std::tolower(b);} ))
+    if (ignoreCase)
+    {
+        // All override keys are in lower case
+        std::string lckey(key);
+        std::transform(lckey.begin(), lckey.end(), lckey.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        it = index.find(lckey);
+        if (index.end() != it)
         {
-            return vo;
+            return *it->second;
         }
     }
 
@@ -91,6 +91,10 @@ const ValidOverride configProfileOverrides[] = {
      "Overrides the protocol being used",
      [] {return std::string("tcp udp");}},
 
+    {"connect-race", OverrideType::string,
+     "Probe this many remote servers concurrently and connect to the first one answering",
+     [] {return std::string("2 3 4 5 6 7 8");}},
+
     {"ipv6", OverrideType::string,
      "Sets the IPv6 policy of the client",
      [] { return std::string("yes no default");}},
@@ -98,6 +102,45 @@ const ValidOverride configProfileOverrides[] = {
     {"persist-tun", OverrideType::boolean,
      "The tun interface should persist during reconnect"},
 
+    {"reuse-tun-device", OverrideType::boolean,
+     "Keep the virtual network device across reconnects, only applying changed settings"},
+
+    {"path-mtu-discovery", OverrideType::boolean,
+     "Discover the path MTU to the server and adjust the tunnel MTU to it"},
+
+    {"path-quality", OverrideType::boolean,
+     "Measure round-trip time, jitter and loss through the tunnel"},
+
+    {"adaptive-socket-buffers", OverrideType::boolean,
+     "Grow and shrink the UDP socket buffers based on the observed drops"},
+
+    {"socket-buffer-min", OverrideType::string,
+     "Smallest UDP socket buffer size in bytes, for adaptive-socket-buffers"},
+
+    {"socket-buffer-max", OverrideType::string,
+     "Largest UDP socket buffer size in bytes, for adaptive-socket-buffers"},
+
+    {"failover-standby", OverrideType::boolean,
+     "Keep an alternate remote probed while connected, for fast failover"},
+
+    {"flight-recorder", OverrideType::boolean,
+     "Send the log details hidden by the log level to the log service when errors occur"},
+
+    {"log-direct", OverrideType::boolean,
+     "Write verbose log events to a session log provided by the log service instead of the bus"},
+
+    {"shared-resolver", OverrideType::boolean,
+     "Resolve the remote host names via the netcfg service cache shared by all sessions"},
+
+    {"power-save", OverrideType::boolean,
+     "Coalesce timer wake-ups of the VPN client with other processes"},
+
+    {"low-memory", OverrideType::boolean,
+     "Return unused heap memory to the system while the tunnel is idle"},
+
+    {"status-full-fidelity", OverrideType::boolean,
+     "Send every connection status change instead of coalescing the transient ones"},
+
     {"log-level", OverrideType::string,
      "Override the configuration profile --verb setting",
      [] { return std::string("1 2 3 4 5 6");}},
@@ -147,7 +190,52 @@ const ValidOverride configProfileOverrides[] = {
      "HTTP Proxy password to use for authentication"},
 
     {"proxy-auth-cleartext", OverrideType::boolean,
-     "Allows clear text HTTP authentication"}
+     "Allows clear text HTTP authentication"},
+
+    {"device-rps-cpus", OverrideType::string,
+     "CPUs processing packets received on the VPN device (e.g. 0-3,6 or auto)"},
+
+    {"device-xps-cpus", OverrideType::string,
+     "CPUs mapped to the transmit queues of the VPN device (e.g. 0-3,6 or auto)"},
+
+    {"device-rps-flow-cnt", OverrideType::string,
+     "Receive Flow Steering table entries per queue of the VPN device"},
+
+    {"device-qdisc", OverrideType::string,
+     "Queueing discipline of the VPN device (fq_codel or cake)"},
+
+    {"device-qdisc-bandwidth", OverrideType::string,
+     "Upload bandwidth of the VPN connection in kbit/s, for the qdisc"},
+
+    {"device-txqueuelen", OverrideType::string,
+     "Transmit queue length of the VPN device"},
+
+    {"core-cpu-affinity", OverrideType::string,
+     "Pin the VPN client thread to these CPUs (e.g. 2 or 0-3,6), "
+     "or to the CPUs of the VPN device with 'device'"},
+
+    {"core-nice", OverrideType::string,
+     "Nice value of the VPN client thread (-20 to 19)"},
+
+    {"core-sched-policy", OverrideType::string,
+     "Scheduling policy of the VPN client thread, optionally with :PRIORITY",
+     [] {return std::string("other batch idle fifo rr");}},
+
+    {"core-numa-node", OverrideType::string,
+     "NUMA node of the VPN client thread, or 'auto' for the node of the "
+     "interface the VPN traffic leaves through"},
+
+    {"backend-cpu-weight", OverrideType::string,
+     "CPU weight of the VPN client process scope unit (1 to 10000)"},
+
+    {"backend-io-weight", OverrideType::string,
+     "IO weight of the VPN client process scope unit (1 to 10000)"},
+
+    {"backend-memory-high", OverrideType::string,
+     "Memory usage above which the VPN client process is throttled (e.g. 256M)"},
+
+    {"backend-memory-max", OverrideType::string,
+     "Memory limit of the VPN client process (e.g. 512M)"}
 };
 
 
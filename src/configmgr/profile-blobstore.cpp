@@ -0,0 +1,104 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   profile-blobstore.cpp
+ *
+ * @brief  Implementation of ProfileBlobStore
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "profile-blobstore.hpp"
+
+
+ProfileBlobStore::Blob ProfileBlobStore::Intern(const std::string& value)
+{
+    size_t key = std::hash<std::string>()(value);
+
+    std::lock_guard<std::mutex> guard(mtx);
+    auto range = blobs.equal_range(key);
+    for (auto it = range.first; it != range.second; )
+    {
+        Blob b = it->second.lock();
+        if (!b)
+        {
+            // Released by all its users
+            it = blobs.erase(it);
+            continue;
+        }
+        if (*b == value)
+        {
+            return b;
+        }
+        ++it;
+    }
+
+    Blob b = std::make_shared<const std::string>(value);
+    blobs.emplace(key, b);
+    if (blobs.size() >= cleanup_limit)
+    {
+        cleanup();
+    }
+    return b;
+}
+
+
+size_t ProfileBlobStore::Size()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    cleanup();
+    return blobs.size();
+}
+
+
+size_t ProfileBlobStore::MemoryUsage()
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    size_t ret = 0;
+    for (const auto& b : blobs)
+    {
+        Blob v = b.second.lock();
+        if (v)
+        {
+            ret += sizeof(std::string) + v->capacity();
+        }
+    }
+    return ret;
+}
+
+
+void ProfileBlobStore::cleanup()
+{
+    for (auto it = blobs.begin(); it != blobs.end(); )
+    {
+        if (it->second.expired())
+        {
+            it = blobs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Grow the limit along with the values in use, so the clean-up
+    // cost stays proportional to the number of insertions
+    cleanup_limit = std::max<size_t>(64, 2 * blobs.size());
+}
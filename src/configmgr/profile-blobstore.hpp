@@ -0,0 +1,88 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   profile-blobstore.hpp
+ *
+ * @brief  Content addressed storage of large configuration profile
+ *         values, shared by all configuration objects
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+/**
+ *  Keeps a single copy of identical configuration profile values, such
+ *  as inlined CA certificates and TLS keys.  Profiles imported from the
+ *  same source typically carry the same blocks, which are then only
+ *  stored once.
+ *
+ *  The values are immutable and owned by the configuration objects
+ *  using them; the store only keeps a weak reference.  A value is freed
+ *  when the last configuration object using it is removed.
+ */
+class ProfileBlobStore
+{
+public:
+    using Ptr = std::shared_ptr<ProfileBlobStore>;
+    using Blob = std::shared_ptr<const std::string>;
+
+    ProfileBlobStore() = default;
+    ProfileBlobStore(const ProfileBlobStore&) = delete;
+    ProfileBlobStore& operator=(const ProfileBlobStore&) = delete;
+
+
+    /**
+     *  Look up a value in the store, adding it if it is not present
+     *
+     * @param value  std::string with the value to store
+     *
+     * @return Returns a Blob with the stored value.  All callers storing
+     *         the same value get the same Blob.
+     */
+    Blob Intern(const std::string& value);
+
+
+    /**
+     * @return Returns the number of values currently in use
+     */
+    size_t Size();
+
+
+    /**
+     * @return Returns the approximate number of bytes used by the values
+     *         currently in use
+     */
+    size_t MemoryUsage();
+
+
+private:
+    std::mutex mtx;
+    std::unordered_multimap<size_t, std::weak_ptr<const std::string>> blobs;
+
+    /// Number of entries at which the next full clean-up is run
+    size_t cleanup_limit = 64;
+
+    void cleanup();
+};
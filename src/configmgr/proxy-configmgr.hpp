@@ -20,13 +20,108 @@
 #ifndef OPENVPN3_DBUS_PROXY_CONFIG_HPP
 #define OPENVPN3_DBUS_PROXY_CONFIG_HPP
 
+#include <map>
 #include <vector>
+#include <unistd.h>
+
+#include <openvpn/client/cliconstants.hpp>
+#include <openvpn/common/options.hpp>
 
 #include "dbus/core.hpp"
+#include "dbus/list-filter-args.hpp"
+#include "common/memfd.hpp"
 #include "configmgr/overrides.hpp"
 
 using namespace openvpn;
 
+
+/**
+ *  Configuration details as returned by the configuration manager's
+ *  FetchAvailableConfigsDetailed method.  Fields not provided by the
+ *  configuration manager are left empty or zero.
+ */
+struct ConfigurationDetails
+{
+    ConfigurationDetails(const std::string& p, GVariant *details)
+        : path(p)
+    {
+        GVariantIter iter;
+        g_variant_iter_init(&iter, details);
+        gchar *key = nullptr;
+        GVariant *value = nullptr;
+        while (g_variant_iter_next(&iter, "{sv}", &key, &value))
+        {
+            std::string k(key);
+            if ("name" == k)
+            {
+                name = std::string(g_variant_get_string(value, nullptr));
+            }
+            else if ("owner" == k)
+            {
+                owner = g_variant_get_uint32(value);
+            }
+            else if ("import_timestamp" == k)
+            {
+                import_timestamp = g_variant_get_uint64(value);
+            }
+            else if ("last_used_timestamp" == k)
+            {
+                last_used_timestamp = g_variant_get_uint64(value);
+            }
+            else if ("used_count" == k)
+            {
+                used_count = g_variant_get_uint32(value);
+            }
+            else if ("persistent" == k)
+            {
+                persistent = g_variant_get_boolean(value);
+            }
+            else if ("single_use" == k)
+            {
+                single_use = g_variant_get_boolean(value);
+            }
+            else if ("readonly" == k)
+            {
+                readonly = g_variant_get_boolean(value);
+            }
+            else if ("locked_down" == k)
+            {
+                locked_down = g_variant_get_boolean(value);
+            }
+            else if ("public_access" == k)
+            {
+                public_access = g_variant_get_boolean(value);
+            }
+            else if ("valid" == k)
+            {
+                valid = g_variant_get_boolean(value);
+            }
+            else if ("dco" == k)
+            {
+                dco = g_variant_get_boolean(value);
+            }
+            g_variant_unref(value);
+            g_free(key);
+        }
+    }
+
+    std::string path;
+    std::string name;
+    uid_t owner = 0;
+    uint64_t import_timestamp = 0;
+    uint64_t last_used_timestamp = 0;
+    unsigned int used_count = 0;
+    bool persistent = false;
+    bool single_use = false;
+    bool readonly = false;
+    bool locked_down = false;
+    bool public_access = false;
+    bool valid = false;
+    bool dco = false;
+};
+
+
+
 class OpenVPN3ConfigurationProxy : public DBusProxy {
 public:
     OpenVPN3ConfigurationProxy(GBusType bus_type, std::string object_path)
@@ -74,6 +169,56 @@ public:
     std::string Import(std::string name, std::string config_blob,
                        bool single_use, bool persistent)
     {
+        // The profile is passed via a sealed memfd when the configuration
+        // manager supports it, which avoids the bus message size limits
+        // for large profiles.  Older services only have the Import method.
+        if (fd_transfer)
+        {
+            try
+            {
+                int fd = MemFD::CreateSealed("openvpn3-import", config_blob);
+                GVariant *res = nullptr;
+                try
+                {
+                    res = CallSendFD("ImportFD",
+                                     g_variant_new("(sbb)",
+                                                   name.c_str(),
+                                                   single_use,
+                                                   persistent),
+                                     fd);
+                }
+                catch (...)
+                {
+                    close(fd);
+                    throw;
+                }
+                close(fd);
+                if (NULL == res)
+                {
+                    THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                        "Failed to import configuration");
+                }
+                gchar *buf = nullptr;
+                g_variant_get(res, "(o)", &buf);
+                std::string ret(buf);
+                g_variant_unref(res);
+                g_free(buf);
+                return ret;
+            }
+            catch (const DBusException& excp)
+            {
+                if (!unknown_method(excp))
+                {
+                    throw;
+                }
+                fd_transfer = false;
+            }
+            catch (const MemFDException&)
+            {
+                fd_transfer = false;
+            }
+        }
+
         GVariant *res = Call("Import",
                              g_variant_new("(ssbb)",
                                            name.c_str(),
@@ -96,6 +241,80 @@ public:
     }
 
 
+    /**
+     *  Imports a configuration profile already parsed by the caller.  The
+     *  parsed options are passed in a sealed memfd and the configuration
+     *  manager only validates them instead of parsing the profile again.
+     *  With older services, or options which cannot be passed this way,
+     *  the profile text is imported via Import() instead.
+     *
+     * @param name         std::string with the configuration name
+     * @param opts         openvpn::OptionList with the parsed profile,
+     *                     including the meta options
+     * @param config_blob  std::string with the profile text opts was
+     *                     parsed from
+     * @param single_use   Remove the configuration after the first use
+     * @param persistent   Save the configuration to disk
+     *
+     * @return Returns a std::string with the D-Bus object path of the
+     *         imported configuration
+     */
+    std::string ImportParsed(std::string name,
+                             const openvpn::OptionList& opts,
+                             const std::string& config_blob,
+                             bool single_use, bool persistent)
+    {
+        std::string data;
+        if (parsed_import && serialize_options(opts, data))
+        {
+            try
+            {
+                int fd = MemFD::CreateSealed("openvpn3-import-parsed", data);
+                GVariant *res = nullptr;
+                try
+                {
+                    res = CallSendFD("ImportParsedFD",
+                                     g_variant_new("(sbb)",
+                                                   name.c_str(),
+                                                   single_use,
+                                                   persistent),
+                                     fd);
+                }
+                catch (...)
+                {
+                    close(fd);
+                    throw;
+                }
+                close(fd);
+                if (NULL == res)
+                {
+                    THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                        "Failed to import configuration");
+                }
+                gchar *buf = nullptr;
+                g_variant_get(res, "(o)", &buf);
+                std::string ret(buf);
+                g_variant_unref(res);
+                g_free(buf);
+                return ret;
+            }
+            catch (const DBusException& excp)
+            {
+                if (!unknown_method(excp))
+                {
+                    throw;
+                }
+                parsed_import = false;
+            }
+            catch (const MemFDException&)
+            {
+                parsed_import = false;
+            }
+        }
+        return Import(name, config_blob, single_use, persistent);
+    }
+
+
     /**
      * Retrieves a string array of configuration paths which are available
      * to the calling user
@@ -127,6 +346,62 @@ public:
     }
 
 
+    /**
+     *  Retrieves one page of the configuration paths available to the
+     *  calling user which match a filter
+     *
+     * @param filter  ListFilter with the criteria, the cursor returned
+     *                with the previous page and the page size
+     *
+     * @return Returns a ListFilter::Page with the configuration paths;
+     *         its next member is empty on the last page
+     */
+    ListFilter::Page FetchConfigsFiltered(const ListFilter& filter)
+    {
+        GVariant *res = Call("FetchConfigsFiltered", BuildListFilterArgs(filter));
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to retrieve available configurations");
+        }
+        return ParseListFilterReply(res);
+    }
+
+
+    /**
+     *  Retrieve the details of all configurations available to the
+     *  calling user in a single call to the configuration manager
+     *
+     * @return  std::vector<ConfigurationDetails> of all available
+     *          configurations
+     */
+    std::vector<ConfigurationDetails> FetchAvailableConfigsDetailed()
+    {
+        GVariant *res = Call("FetchAvailableConfigsDetailed");
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to retrieve configuration details");
+        }
+
+        GVariantIter *configs = NULL;
+        g_variant_get(res, "(a{oa{sv}})", &configs);
+
+        std::vector<ConfigurationDetails> ret;
+        gchar *path = NULL;
+        GVariant *details = NULL;
+        while (g_variant_iter_next(configs, "{o@a{sv}}", &path, &details))
+        {
+            ret.push_back(ConfigurationDetails(path, details));
+            g_variant_unref(details);
+            g_free(path);
+        }
+        g_variant_unref(res);
+        g_variant_iter_free(configs);
+        return ret;
+    }
+
+
     /**
      *  Lookup the configuration paths for a given configuration name.
      *
@@ -164,6 +439,22 @@ public:
 
     std::string GetJSONConfig()
     {
+        if (fd_transfer)
+        {
+            try
+            {
+                return fetch_fd("FetchJSONFD");
+            }
+            catch (const DBusException& excp)
+            {
+                if (!unknown_method(excp))
+                {
+                    throw;
+                }
+                fd_transfer = false;
+            }
+        }
+
         GVariant *res = Call("FetchJSON");
         if (NULL == res)
         {
@@ -182,6 +473,22 @@ public:
 
     std::string GetConfig()
     {
+        if (fd_transfer)
+        {
+            try
+            {
+                return fetch_fd("FetchFD");
+            }
+            catch (const DBusException& excp)
+            {
+                if (!unknown_method(excp))
+                {
+                    throw;
+                }
+                fd_transfer = false;
+            }
+        }
+
         GVariant *res = Call("Fetch");
         if (NULL == res)
         {
@@ -208,6 +515,21 @@ public:
         g_variant_unref(res);
     }
 
+    /**
+     *  Writes pending changes of a persistent configuration to disk
+     *  right away
+     */
+    void Flush()
+    {
+        GVariant *res = Call("Flush");
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to flush the configuration");
+        }
+        g_variant_unref(res);
+    }
+
     void SetName(std::string name)
     {
         SetProperty("name", name);
@@ -336,6 +658,40 @@ public:
     }
 
 
+    /**
+     * Grant all members of a group access to this configuration profile
+     *
+     * @param gid  gid_t value of the group which will be granted access
+     */
+    void AccessGrantGroup(gid_t gid)
+    {
+        GVariant *res = Call("AccessGrantGroup", g_variant_new("(u)", gid));
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "AccessGrantGroup() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     * Revoke the access from a group for this configuration profile
+     *
+     * @param gid  gid_t value of the group which will get access revoked
+     */
+    void AccessRevokeGroup(gid_t gid)
+    {
+        GVariant *res = Call("AccessRevokeGroup", g_variant_new("(u)", gid));
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "AccessRevokeGroup() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
     /**
      *  Retrieve the owner UID of this configuration object
      *
@@ -492,6 +848,68 @@ public:
     }
 
 
+    /**
+     *  Applies several override and access control changes in a single
+     *  call.  Either all changes are applied or none of them.
+     *
+     * @param set_bool     std::map of boolean override keys and values to set
+     * @param set_str      std::map of string override keys and values to set
+     * @param unset        std::vector of override keys to unset
+     * @param grant        std::vector of UIDs to grant access
+     * @param revoke       std::vector of UIDs to revoke access from
+     */
+    void ApplyChanges(const std::map<std::string, bool>& set_bool,
+                      const std::map<std::string, std::string>& set_str,
+                      const std::vector<std::string>& unset,
+                      const std::vector<uid_t>& grant,
+                      const std::vector<uid_t>& revoke)
+    {
+        GVariantBuilder *ovs = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        for (const auto& ov : set_bool)
+        {
+            g_variant_builder_add(ovs, "{sv}", ov.first.c_str(),
+                                  g_variant_new_boolean(ov.second));
+        }
+        for (const auto& ov : set_str)
+        {
+            g_variant_builder_add(ovs, "{sv}", ov.first.c_str(),
+                                  g_variant_new_string(ov.second.c_str()));
+        }
+
+        GVariantBuilder *unset_b = g_variant_builder_new(G_VARIANT_TYPE("as"));
+        for (const auto& key : unset)
+        {
+            g_variant_builder_add(unset_b, "s", key.c_str());
+        }
+
+        GVariantBuilder *grant_b = g_variant_builder_new(G_VARIANT_TYPE("au"));
+        for (const auto& uid : grant)
+        {
+            g_variant_builder_add(grant_b, "u", uid);
+        }
+
+        GVariantBuilder *revoke_b = g_variant_builder_new(G_VARIANT_TYPE("au"));
+        for (const auto& uid : revoke)
+        {
+            g_variant_builder_add(revoke_b, "u", uid);
+        }
+
+        GVariant *res = Call("ApplyChanges",
+                             g_variant_new("(a{sv}asauau)",
+                                           ovs, unset_b, grant_b, revoke_b));
+        g_variant_builder_unref(ovs);
+        g_variant_builder_unref(unset_b);
+        g_variant_builder_unref(grant_b);
+        g_variant_builder_unref(revoke_b);
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "ApplyChanges() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
     /**
      *  Retrieve the complete access control list (acl) for this object.
      *  The acl is essentially just an array of user ids (uid)
@@ -521,6 +939,139 @@ public:
         g_variant_iter_free(acl);
         return ret;
     }
+
+
+    /**
+     *  Retrieve the group access control list for this object.  All
+     *  members of these groups are granted access.
+     *
+     * @return Returns an array of gid_t references for each group granted
+     *         access.
+     */
+    std::vector<gid_t> GetGroupAccessList()
+    {
+        GVariant *res = GetProperty("acl_groups");
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "GetGroupAccessList() call failed");
+        }
+        GVariantIter *acl = NULL;
+        g_variant_get(res, "au", &acl);
+
+        GVariant *gid = NULL;
+        std::vector<gid_t> ret;
+        while ((gid = g_variant_iter_next_value(acl)))
+        {
+            ret.push_back(g_variant_get_uint32(gid));
+            g_variant_unref(gid);
+        }
+        g_variant_unref(res);
+        g_variant_iter_free(acl);
+        return ret;
+    }
+
+
+private:
+    /// Use the memfd based methods for moving configuration profiles
+    bool fd_transfer = true;
+
+    /// Use the ImportParsedFD method for importing parsed profiles
+    bool parsed_import = true;
+
+    /// The expanded profile and its JSON representation are larger than
+    /// the imported profile; allow for that when reading it back
+    static const size_t fetch_size_factor = 4;
+
+
+    /**
+     *  Serializes parsed profile options for the ImportParsedFD method,
+     *  as a GVariant of the type aas with an array of the option name
+     *  and its arguments per option.
+     *
+     * @param opts  openvpn::OptionList with the options
+     * @param data  std::string receiving the serialized GVariant
+     *
+     * @return Returns false if an option is not valid UTF-8, which
+     *         GVariant strings require
+     */
+    static bool serialize_options(const openvpn::OptionList& opts,
+                                  std::string& data)
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("aas"));
+        for (const auto& opt : opts)
+        {
+            g_variant_builder_open(bld, G_VARIANT_TYPE("as"));
+            for (size_t i = 0; i < opt.size(); ++i)
+            {
+                const std::string& arg = opt.ref(i);
+                if (!g_utf8_validate(arg.data(), arg.size(), nullptr))
+                {
+                    g_variant_builder_unref(bld);
+                    return false;
+                }
+                g_variant_builder_add(bld, "s", arg.c_str());
+            }
+            g_variant_builder_close(bld);
+        }
+        GVariant *v = g_variant_ref_sink(g_variant_builder_end(bld));
+        g_variant_builder_unref(bld);
+        data.assign(static_cast<const char *>(g_variant_get_data(v)),
+                    g_variant_get_size(v));
+        g_variant_unref(v);
+        return true;
+    }
+
+
+    /**
+     *  Checks if a D-Bus call failed because the service does not
+     *  provide the called method; that is, an older service version.
+     */
+    static bool unknown_method(const DBusException& excp)
+    {
+        std::string err(excp.what());
+        return (err.find("Unknown method") != std::string::npos)
+               || (err.find("No such method") != std::string::npos);
+    }
+
+
+    /**
+     *  Calls a method returning the configuration profile in a sealed
+     *  memfd and reads the profile from it.
+     *
+     * @param method  std::string with the D-Bus method to call
+     *
+     * @return Returns a std::string with the configuration profile
+     */
+    std::string fetch_fd(const std::string& method)
+    {
+        int fd = -1;
+        GVariant *res = CallGetFD(method, fd);
+        if (res)
+        {
+            g_variant_unref(res);
+        }
+        if (fd < 0)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to retrieve configuration");
+        }
+
+        try
+        {
+            std::string ret = MemFD::ReadSealed(fd, ProfileParseLimits::MAX_PROFILE_SIZE
+                                                    * fetch_size_factor);
+            close(fd);
+            return ret;
+        }
+        catch (const MemFDException& excp)
+        {
+            close(fd);
+            THROW_DBUSEXCEPTION("OpenVPN3ConfigurationProxy",
+                                "Failed to retrieve configuration: "
+                                + std::string(excp.what()));
+        }
+    }
 };
 
 #endif // OPENVPN3_DBUS_PROXY_CONFIG_HPP
@@ -0,0 +1,269 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   connection-creds-cache.hpp
+ *
+ * @brief  Per D-Bus connection cache of the credentials of D-Bus callers
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+
+/**
+ *  Caches the credentials of D-Bus callers, shared by all
+ *  DBusConnectionCreds objects using the same D-Bus connection.
+ *
+ *  Only unique bus names (":1.42") are cached.  The D-Bus daemon never
+ *  reuses unique bus names, so the credentials of a unique bus name do
+ *  not change while it exists.  Entries are removed when the
+ *  NameOwnerChanged signal reports the bus name has disconnected.
+ */
+class DBusConnectionCredsCache
+{
+public:
+    typedef std::shared_ptr<DBusConnectionCredsCache> Ptr;
+
+    /**
+     *  Retrieve the credentials cache attached to a D-Bus connection.
+     *  It is created on the first call and lives as long as the
+     *  connection.
+     *
+     * @param conn  GDBusConnection the cache belongs to
+     * @return Returns a DBusConnectionCredsCache::Ptr to the cache
+     */
+    static Ptr Get(GDBusConnection *conn)
+    {
+        static std::mutex registry_mtx;
+        std::lock_guard<std::mutex> guard(registry_mtx);
+
+        Ptr *cache = static_cast<Ptr *>(g_object_get_data(G_OBJECT(conn),
+                                                          "openvpn3-creds-cache"));
+        if (cache)
+        {
+            return *cache;
+        }
+
+        Ptr ret(new DBusConnectionCredsCache());
+        g_object_set_data_full(G_OBJECT(conn), "openvpn3-creds-cache", new Ptr(ret),
+                               destroy_ptr);
+        g_dbus_connection_signal_subscribe(conn,
+                                           "org.freedesktop.DBus",
+                                           "org.freedesktop.DBus",
+                                           "NameOwnerChanged",
+                                           "/org/freedesktop/DBus",
+                                           nullptr,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           name_owner_changed,
+                                           new Ptr(ret),
+                                           destroy_ptr);
+        return ret;
+    }
+
+
+    bool GetUID(const std::string& busname, uid_t& uid) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = cache.find(busname);
+        if (cache.end() == it || !it->second.uid_set)
+        {
+            return false;
+        }
+        uid = it->second.uid;
+        return true;
+    }
+
+
+    bool GetPID(const std::string& busname, pid_t& pid) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = cache.find(busname);
+        if (cache.end() == it || !it->second.pid_set)
+        {
+            return false;
+        }
+        pid = it->second.pid;
+        return true;
+    }
+
+
+    /**
+     *  Retrieve the UID of a D-Bus caller, asking the D-Bus daemon only
+     *  if it is not cached yet.  For code which cannot use
+     *  DBusConnectionCreds, which also reports errors as exceptions.
+     *
+     * @param conn     GDBusConnection this cache belongs to
+     * @param busname  std::string with the bus name of the caller
+     * @param uid      uid_t to store the UID in
+     *
+     * @return Returns false if the UID could not be retrieved
+     */
+    bool LookupUID(GDBusConnection *conn, const std::string& busname,
+                   uid_t& uid)
+    {
+        if (GetUID(busname, uid))
+        {
+            return true;
+        }
+
+        GError *err = nullptr;
+        GVariant *r = g_dbus_connection_call_sync(conn,
+                                                  "org.freedesktop.DBus",
+                                                  "/org/freedesktop/DBus",
+                                                  "org.freedesktop.DBus",
+                                                  "GetConnectionUnixUser",
+                                                  g_variant_new("(s)", busname.c_str()),
+                                                  G_VARIANT_TYPE("(u)"),
+                                                  G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                  -1, nullptr, &err);
+        if (!r)
+        {
+            g_error_free(err);
+            return false;
+        }
+        guint32 res = 0;
+        g_variant_get(r, "(u)", &res);
+        g_variant_unref(r);
+        uid = (uid_t) res;
+        SetUID(busname, uid);
+        return true;
+    }
+
+
+    /**
+     *  Checks if a D-Bus caller runs as root or as the same user as
+     *  this process
+     *
+     * @param conn     GDBusConnection the call arrived on
+     * @param busname  std::string with the bus name of the caller
+     *
+     * @return Returns true if the caller is privileged, false if not or
+     *         if its credentials could not be retrieved
+     */
+    static bool IsPrivileged(GDBusConnection *conn, const std::string& busname)
+    {
+        if (!conn)
+        {
+            return false;
+        }
+        uid_t uid = 0;
+        if (!Get(conn)->LookupUID(conn, busname, uid))
+        {
+            return false;
+        }
+        return (0 == uid || geteuid() == uid);
+    }
+
+
+    void SetUID(const std::string& busname, const uid_t uid)
+    {
+        if (!cacheable(busname))
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(mtx);
+        Entry& e = cache[busname];
+        e.uid = uid;
+        e.uid_set = true;
+    }
+
+
+    void SetPID(const std::string& busname, const pid_t pid)
+    {
+        if (!cacheable(busname))
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(mtx);
+        Entry& e = cache[busname];
+        e.pid = pid;
+        e.pid_set = true;
+    }
+
+
+    void Invalidate(const std::string& busname)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        cache.erase(busname);
+    }
+
+
+private:
+    struct Entry
+    {
+        uid_t uid = 0;
+        pid_t pid = 0;
+        bool uid_set = false;
+        bool pid_set = false;
+    };
+
+    mutable std::mutex mtx;
+    std::map<std::string, Entry> cache;
+
+
+    DBusConnectionCredsCache() = default;
+
+
+    static bool cacheable(const std::string& busname)
+    {
+        return !busname.empty() && ':' == busname[0];
+    }
+
+
+    static void destroy_ptr(gpointer ptr)
+    {
+        delete static_cast<Ptr *>(ptr);
+    }
+
+
+    static void name_owner_changed(GDBusConnection *conn,
+                                   const gchar *sender,
+                                   const gchar *obj_path,
+                                   const gchar *intf_name,
+                                   const gchar *signal_name,
+                                   GVariant *params,
+                                   gpointer cache_ptr)
+    {
+        if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(sss)")))
+        {
+            return;
+        }
+        gchar *name = nullptr;
+        gchar *old_owner = nullptr;
+        gchar *new_owner = nullptr;
+        g_variant_get(params, "(sss)", &name, &old_owner, &new_owner);
+
+        // Unique bus names only have an owner until the client disconnects
+        if (new_owner && '\0' == *new_owner)
+        {
+            (*static_cast<Ptr *>(cache_ptr))->Invalidate(name);
+        }
+        g_free(name);
+        g_free(old_owner);
+        g_free(new_owner);
+    }
+};
@@ -28,13 +28,19 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <algorithm>
 #include <sys/types.h>
 
+#include "common/idset.hpp"
 #include "common/lookup.hpp"
+#include "connection-creds-cache.hpp"
 #include "proxy.hpp"
 
+
 /**
  *   Queries the D-Bus daemon for the credentials of a specific D-Bus
  *   bus name.  Each D-Bus client performing an operation on a D-Bus
@@ -57,6 +63,7 @@ public:
     {
         SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
         proxy = SetupProxy();
+        creds_cache = DBusConnectionCredsCache::Get(dbuscon);
     }
 
 
@@ -69,13 +76,19 @@ public:
      */
     uid_t GetUID(std::string busname) const
     {
+        uid_t ret;
+        if (creds_cache->GetUID(busname, ret))
+        {
+            return ret;
+        }
+
         try
         {
             GVariant *result = Call("GetConnectionUnixUser",
                                   g_variant_new("(s)", busname.c_str()));
-            uid_t ret;
             g_variant_get(result, "(u)", &ret);
             g_variant_unref(result);
+            creds_cache->SetUID(busname, ret);
             return ret;
         }
         catch (DBusException& excp)
@@ -96,13 +109,19 @@ public:
      */
     pid_t GetPID(std::string busname) const
     {
+        pid_t ret;
+        if (creds_cache->GetPID(busname, ret))
+        {
+            return ret;
+        }
+
         try
         {
             GVariant *result = Call("GetConnectionUnixProcessID",
                                   g_variant_new("(s)", busname.c_str()));
-            pid_t ret;
             g_variant_get(result, "(u)", &ret);
             g_variant_unref(result);
+            creds_cache->SetPID(busname, ret);
             return ret;
         }
         catch (DBusException& excp)
@@ -143,6 +162,10 @@ public:
                                 + busname + "': " + excp.GetRawError());
         }
     }
+
+
+private:
+    DBusConnectionCredsCache::Ptr creds_cache;
 };
 
 
@@ -242,9 +265,10 @@ private:
 
 /**
  *  Implements an access control list which contains user IDs (UID) of
- *  users allowed to get access.  If SetPublicAccess(true) is called,
- *  then the ACL check is skipped and everyone have access.  An owner
- *  will always have access, regardless of the ACL lists contents.
+ *  users and group IDs (GID) of groups allowed to get access.  If
+ *  SetPublicAccess(true) is called, then the ACL check is skipped and
+ *  everyone have access.  An owner will always have access, regardless
+ *  of the ACL lists contents.
  */
 class DBusCredentials : public DBusConnectionCreds
 {
@@ -330,7 +354,7 @@ public:
      */
     std::vector<uid_t> GetAccessList() const
     {
-        return acl_list;
+        return acl_list.List();
     }
 
     /**
@@ -340,17 +364,12 @@ public:
      */
     void GrantAccess(uid_t uid)
     {
-        for (auto& acl_uid : acl_list)
+        if (!acl_list.Add(uid))
         {
-            if (acl_uid == uid)
-            {
-                throw DBusCredentialsException(owner,
-                                               "net.openvpn.v3.error.acl.duplicate",
-                                               "UID already granted access");
-            }
+            throw DBusCredentialsException(owner,
+                                           "net.openvpn.v3.error.acl.duplicate",
+                                           "UID already granted access");
         }
-
-        acl_list.push_back(uid);
     }
 
 
@@ -361,18 +380,59 @@ public:
      */
     void RevokeAccess(uid_t uid)
     {
-        for (auto& acl_uid : acl_list)
+        if (!acl_list.Remove(uid))
         {
-            if (acl_uid == uid)
-            {
-                acl_list.erase(std::remove(acl_list.begin(), acl_list.end(), uid), acl_list.end());
-                return;
-            }
+            throw DBusCredentialsException(owner,
+                                           "net.openvpn.v3.error.acl.nogrant",
+                                           "UID is not listed in access list");
+        }
+    }
+
+
+    /**
+     *  Retrieve the ACL list of group IDs granted access.  All members
+     *  of these groups are granted access.
+     *
+     * @return  Returns a std::vector object containing an array of gid_t
+     */
+    std::vector<gid_t> GetGroupAccessList() const
+    {
+        return acl_groups.List();
+    }
+
+
+    /**
+     *  Adds a group ID (GID) to the access list.  The group membership
+     *  of a caller is looked up by lookup_user_groups(), which caches
+     *  the result.
+     *
+     * @param gid  gid_t containing the GID of the group granted access
+     */
+    void GrantGroupAccess(gid_t gid)
+    {
+        if (!acl_groups.Add(gid))
+        {
+            throw DBusCredentialsException(owner,
+                                           "net.openvpn.v3.error.acl.duplicate",
+                                           "GID already granted access");
         }
+    }
 
-        throw DBusCredentialsException(owner,
-                                       "net.openvpn.v3.error.acl.nogrant",
-                                       "UID is not listed in access list");
+
+    /**
+     *  Removes a group ID (GID) from the access list
+     *
+     * @param gid  gid_t containing the GID of the group getting access
+     *             revoked
+     */
+    void RevokeGroupAccess(gid_t gid)
+    {
+        if (!acl_groups.Remove(gid))
+        {
+            throw DBusCredentialsException(owner,
+                                           "net.openvpn.v3.error.acl.nogrant",
+                                           "GID is not listed in access list");
+        }
     }
 
 
@@ -440,10 +500,38 @@ public:
     }
 
 
+    /**
+     *  Checks if a user would pass CheckACL(), without a D-Bus caller.
+     *  Used when the access of a user must be evaluated up front, like
+     *  when publishing details to a user outside of a method call.
+     *
+     * @param uid  uid_t of the user to check
+     *
+     * @return Returns true if the user has access to the object
+     */
+    bool CheckUIDAccess(const uid_t uid) const
+    {
+        if (acl_public || uid == owner || acl_list.Contains(uid))
+        {
+            return true;
+        }
+        try
+        {
+            return !acl_groups.empty()
+                   && acl_groups.ContainsAny(lookup_user_groups(uid));
+        }
+        catch (const LookupException&)
+        {
+            return false;
+        }
+    }
+
+
 private:
     uid_t owner;
     bool acl_public;
-    std::vector<uid_t> acl_list;
+    IdSet<uid_t> acl_list;
+    IdSet<gid_t> acl_groups;
 
 
     /**
@@ -483,10 +571,7 @@ private:
                 return;
             }
 
-            uid_t ovpn_uid;
-            ovpn_uid = lookup_uid(OPENVPN_USERNAME);
-
-            if (allow_mngr && sender_uid == ovpn_uid)
+            if (allow_mngr && sender_uid == lookup_uid(OPENVPN_USERNAME))
             {
                 return;
             }
@@ -499,12 +584,14 @@ private:
                                                );
             }
 
-            for (auto& acl_uid : acl_list)
+            if (acl_list.Contains(sender_uid))
             {
-                if (acl_uid == sender_uid)
-                {
-                    return;
-                }
+                return;
+            }
+            if (!acl_groups.empty()
+                && acl_groups.ContainsAny(lookup_user_groups(sender_uid)))
+            {
+                return;
             }
             throw DBusCredentialsException(sender_uid,
                                            "net.openvpn.v3.error.acl.denied",
@@ -26,11 +26,15 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 
 #include <gio/gio.h>
 
+#include "common/startup-timing.hpp"
+#include "constants.hpp"
 #include "exceptions.hpp"
 #include "idlecheck.hpp"
+#include "method-stats.hpp"
 
 
 /**
@@ -131,6 +135,7 @@ public:
             THROW_DBUSEXCEPTION("DBus", errmsg);
         }
         connected = true;
+        StartupTiming::Instance().Mark("bus_connected");
     }
 
 
@@ -181,7 +186,12 @@ public:
             THROW_DBUSEXCEPTION("DBus", "Could not own bus name for " + busname);
         }
         setup_complete = true;
+
+        // Latency statistics of the D-Bus requests handled by this service
+        debug_iface.reset(new DBusDebugInterface(dbuscon, root_path,
+                                                 OpenVPN3DBus_interf_debug));
         callback_bus_acquired();
+        StartupTiming::Instance().Mark("objects_registered");
     }
 
 
@@ -323,6 +333,18 @@ public:
     }
 
 
+    /**
+     *  Called once after the bus name has been acquired for the first
+     *  time, which completes the start-up of the service.
+     *
+     * @param timeline  std::string with the StartupTiming summary, to be
+     *                  logged by the service
+     */
+    virtual void callback_startup_complete(const std::string& timeline)
+    {
+    }
+
+
     /**
      *  Called if the bus name could not be acquired.  Either this or @callback_bus_acquired
      *  will be called.
@@ -340,6 +362,8 @@ protected:
 
     void close_and_cleanup() noexcept
     {
+        debug_iface.reset();
+
         // If this object is based on an existing D-Bus connection,
         // don't disconnect.
         if (keep_connection)
@@ -379,6 +403,7 @@ private:
     std::string default_interface;
     GDBusConnection *dbuscon;
     guint busid = 0;
+    std::shared_ptr<DBusDebugInterface> debug_iface;
 
     /**
      *  C wrapper function for the GDBus g_bus_own_name_on_connection()
@@ -393,7 +418,13 @@ private:
     static void int_callback_name_acquired(GDBusConnection *conn, const gchar *name, gpointer this_ptr)
     {
         class DBus *obj = (class DBus *) this_ptr;
+        StartupTiming& timing = StartupTiming::Instance();
+        timing.Mark("bus_name_acquired");
         obj->callback_name_acquired(conn, name);
+        if (timing.Complete())
+        {
+            obj->callback_startup_complete(timing.str());
+        }
     }
 
 
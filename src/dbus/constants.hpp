@@ -59,6 +59,7 @@ const std::string OpenVPN3DBus_interf_backends_manager = OpenVPN3DBus_interf_bac
 const std::string OpenVPN3DBus_name_backends_be = "net.openvpn.v3.backends.be";
 const std::string OpenVPN3DBus_rootp_backends_session =  OpenVPN3DBus_rootp_backends + "/session";
 const std::string OpenVPN3DBus_rootp_backends_manager = OpenVPN3DBus_rootp_backends + "/manager";
+const std::string OpenVPN3DBus_rootp_backends_standby = OpenVPN3DBus_rootp_backends + "/standby";
 
 
 /* Network Configuration Service
@@ -70,6 +71,10 @@ const std::string OpenVPN3DBus_rootp_netcfg = "/net/openvpn/v3/netcfg";
 const std::string OpenVPN3DBus_interf_netcfg = "net.openvpn.v3.netcfg";
 
 
+/* Debug interface, provided on the root object path of all services */
+const std::string OpenVPN3DBus_interf_debug = "net.openvpn.v3.debug";
+
+
 /**
  *  Status - major codes
  *  These codes represents a type of master group
@@ -197,6 +197,19 @@ public:
     }
 
 
+    /**
+     *  Returns the error to a D-Bus Set call handled asynchronously,
+     *  see DBusObject::EnableAsyncPropertySet()
+     *
+     * @param invoc  GDBusMethodInvocation of the Set call
+     */
+    void SetDBusError(GDBusMethodInvocation *invoc)
+    {
+        g_dbus_method_invocation_return_error(invoc, errordomain, errorcode,
+                                              "%s", errorstr.c_str());
+    }
+
+
 private:
     GQuark errordomain;
     guint errorcode;
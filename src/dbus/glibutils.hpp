@@ -26,10 +26,14 @@
 
 #pragma once
 
+#include <map>
+#include <tuple>
 #include <vector>
 #include <string>
 #include <type_traits>
+#include <utility>
 
+#include <unistd.h>
 #include <gio/gunixfdlist.h>
 
 #include "exceptions.hpp"
@@ -380,6 +384,291 @@ namespace GLibUtils
     }
 
 
+    /*
+     *  Type driven GVariant marshalling
+     *
+     *  DBusType<T> maps a C++ type to its D-Bus type signature and knows
+     *  how to create and parse a GVariant object of that type.  Container
+     *  types (std::vector, std::map and std::tuple) are composed from the
+     *  DBusType of their elements, so the D-Bus signature always follows
+     *  the C++ type.  Values are created directly from their children,
+     *  without going via a GVariantBuilder.
+     *
+     *  Additional types can be supported by adding a DBusType
+     *  specialization providing Signature(), Create() and Extract().
+     */
+
+    // Declare template as prototype only so it cannot be used directly
+    template<typename T, typename Enable = void> struct DBusType;
+
+#define GLIBUTILS_DBUSTYPE_SCALAR(ctype, sig, gtype, newfunc, getfunc)  \
+    template<> struct DBusType<ctype>                                   \
+    {                                                                   \
+        static const char* Signature()                                  \
+        {                                                               \
+            return sig;                                                 \
+        }                                                               \
+        static GVariant* Create(const ctype value)                      \
+        {                                                               \
+            return newfunc((gtype) value);                              \
+        }                                                               \
+        static ctype Extract(GVariant *v)                               \
+        {                                                               \
+            return (ctype) getfunc(v);                                  \
+        }                                                               \
+    }
+
+    GLIBUTILS_DBUSTYPE_SCALAR(bool, "b", gboolean,
+                              g_variant_new_boolean, g_variant_get_boolean);
+    GLIBUTILS_DBUSTYPE_SCALAR(uint8_t, "y", guchar,
+                              g_variant_new_byte, g_variant_get_byte);
+    GLIBUTILS_DBUSTYPE_SCALAR(uint16_t, "q", guint16,
+                              g_variant_new_uint16, g_variant_get_uint16);
+    GLIBUTILS_DBUSTYPE_SCALAR(int16_t, "n", gint16,
+                              g_variant_new_int16, g_variant_get_int16);
+    GLIBUTILS_DBUSTYPE_SCALAR(uint32_t, "u", guint32,
+                              g_variant_new_uint32, g_variant_get_uint32);
+    GLIBUTILS_DBUSTYPE_SCALAR(int32_t, "i", gint32,
+                              g_variant_new_int32, g_variant_get_int32);
+    GLIBUTILS_DBUSTYPE_SCALAR(uint64_t, "t", guint64,
+                              g_variant_new_uint64, g_variant_get_uint64);
+    GLIBUTILS_DBUSTYPE_SCALAR(int64_t, "x", gint64,
+                              g_variant_new_int64, g_variant_get_int64);
+    GLIBUTILS_DBUSTYPE_SCALAR(double, "d", gdouble,
+                              g_variant_new_double, g_variant_get_double);
+#undef GLIBUTILS_DBUSTYPE_SCALAR
+
+    template<> struct DBusType<std::string>
+    {
+        static const char* Signature()
+        {
+            return "s";
+        }
+
+        static GVariant* Create(const std::string& value)
+        {
+            return g_variant_new_string(value.c_str());
+        }
+
+        static std::string Extract(GVariant *v)
+        {
+            return std::string(g_variant_get_string(v, nullptr));
+        }
+    };
+
+
+    template<typename T> struct DBusType<std::vector<T>>
+    {
+        static const char* Signature()
+        {
+            static const std::string sig = std::string("a")
+                                           + DBusType<T>::Signature();
+            return sig.c_str();
+        }
+
+        static GVariant* Create(const std::vector<T>& value)
+        {
+            std::vector<GVariant *> children;
+            children.reserve(value.size());
+            for (const auto& e : value)
+            {
+                children.push_back(DBusType<T>::Create(e));
+            }
+            return g_variant_new_array(G_VARIANT_TYPE(DBusType<T>::Signature()),
+                                       children.data(), children.size());
+        }
+
+        static std::vector<T> Extract(GVariant *v)
+        {
+            std::vector<T> ret;
+            ret.reserve(g_variant_n_children(v));
+            GVariantIter iter;
+            g_variant_iter_init(&iter, v);
+            GVariant *e = nullptr;
+            while ((e = g_variant_iter_next_value(&iter)))
+            {
+                ret.push_back(DBusType<T>::Extract(e));
+                g_variant_unref(e);
+            }
+            return ret;
+        }
+    };
+
+
+    template<typename K, typename V> struct DBusType<std::map<K, V>>
+    {
+        static const char* Signature()
+        {
+            static const std::string sig = std::string("a{")
+                                           + DBusType<K>::Signature()
+                                           + DBusType<V>::Signature() + "}";
+            return sig.c_str();
+        }
+
+        static GVariant* Create(const std::map<K, V>& value)
+        {
+            std::vector<GVariant *> children;
+            children.reserve(value.size());
+            for (const auto& e : value)
+            {
+                children.push_back(g_variant_new_dict_entry(DBusType<K>::Create(e.first),
+                                                            DBusType<V>::Create(e.second)));
+            }
+            // Skip the leading 'a' to get the dict entry type
+            return g_variant_new_array(G_VARIANT_TYPE(Signature() + 1),
+                                       children.data(), children.size());
+        }
+
+        static std::map<K, V> Extract(GVariant *v)
+        {
+            std::map<K, V> ret;
+            GVariantIter iter;
+            g_variant_iter_init(&iter, v);
+            GVariant *e = nullptr;
+            while ((e = g_variant_iter_next_value(&iter)))
+            {
+                GVariant *key = g_variant_get_child_value(e, 0);
+                GVariant *val = g_variant_get_child_value(e, 1);
+                ret[DBusType<K>::Extract(key)] = DBusType<V>::Extract(val);
+                g_variant_unref(key);
+                g_variant_unref(val);
+                g_variant_unref(e);
+            }
+            return ret;
+        }
+    };
+
+
+    /*
+     *  Helpers for expanding a std::tuple into its elements; this is
+     *  std::index_sequence which is not available in C++11
+     */
+    template<std::size_t... I> struct IndexSequence {};
+
+    template<std::size_t N, std::size_t... I>
+    struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+
+    template<std::size_t... I>
+    struct MakeIndexSequence<0, I...>
+    {
+        typedef IndexSequence<I...> type;
+    };
+
+
+    template<typename... Ts> struct DBusType<std::tuple<Ts...>>
+    {
+        static const char* Signature()
+        {
+            static const std::string sig = build_signature();
+            return sig.c_str();
+        }
+
+        static GVariant* Create(const std::tuple<Ts...>& value)
+        {
+            return create(value,
+                          typename MakeIndexSequence<sizeof...(Ts)>::type());
+        }
+
+        static std::tuple<Ts...> Extract(GVariant *v)
+        {
+            return extract(v, typename MakeIndexSequence<sizeof...(Ts)>::type());
+        }
+
+    private:
+        static std::string build_signature()
+        {
+            std::string sig = "(";
+            for (const char *s : {"", DBusType<Ts>::Signature()...})
+            {
+                sig += s;
+            }
+            return sig + ")";
+        }
+
+        template<std::size_t... I>
+        static GVariant* create(const std::tuple<Ts...>& value,
+                                IndexSequence<I...>)
+        {
+            GVariant *children[] = {nullptr, DBusType<Ts>::Create(std::get<I>(value))...};
+            return g_variant_new_tuple(children + 1, sizeof...(Ts));
+        }
+
+        template<typename T>
+        static T extract_child(GVariant *v, std::size_t idx)
+        {
+            GVariant *c = g_variant_get_child_value(v, idx);
+            T ret = DBusType<T>::Extract(c);
+            g_variant_unref(c);
+            return ret;
+        }
+
+        template<std::size_t... I>
+        static std::tuple<Ts...> extract(GVariant *v, IndexSequence<I...>)
+        {
+            return std::tuple<Ts...>(extract_child<Ts>(v, I)...);
+        }
+    };
+
+
+    /**
+     *  Retrieve the D-Bus type signature of a C++ type
+     *
+     * @return Returns a C string with the D-Bus type signature
+     */
+    template<typename T> inline const char* Signature()
+    {
+        return DBusType<T>::Signature();
+    }
+
+
+    /**
+     *  Creates a GVariant object from a C++ value, using the D-Bus
+     *  data type matching the C++ type
+     *
+     * @param value  Value to convert
+     * @return Returns a new floating GVariant object
+     */
+    template<typename T> inline GVariant* Marshal(const T& value)
+    {
+        return DBusType<T>::Create(value);
+    }
+
+
+    /**
+     *  Creates a D-Bus tuple from all the provided values.  This is
+     *  typically used to create the return value of a D-Bus method call.
+     *
+     * @param values  Values to put into the tuple
+     * @return Returns a new floating GVariant tuple object
+     */
+    template<typename... Ts> inline GVariant* MarshalTuple(const Ts&... values)
+    {
+        return DBusType<std::tuple<Ts...>>::Create(std::tuple<Ts...>(values...));
+    }
+
+
+    /**
+     *  Parses a GVariant object into the C++ type.  The type of the
+     *  GVariant object must match the D-Bus signature of the C++ type.
+     *
+     * @param v  GVariant object to parse
+     * @return Returns the parsed value
+     * @throws DBusException if the GVariant type does not match
+     */
+    template<typename T> inline T Unmarshal(GVariant *v)
+    {
+        if (nullptr == v
+            || !g_variant_is_of_type(v, G_VARIANT_TYPE(DBusType<T>::Signature())))
+        {
+            THROW_DBUSEXCEPTION("GLibUtils::Unmarshal",
+                                std::string("Incorrect data type: ")
+                                + (v ? g_variant_get_type_string(v) : "(null)")
+                                + ", expected " + DBusType<T>::Signature());
+        }
+        return DBusType<T>::Extract(v);
+    }
+
+
     /**
      * Unreferences an fd list. This is a helper function since the normal
      * g_unref_object does not fit the signature and there seem to be no
@@ -417,4 +706,35 @@ namespace GLibUtils
         return fd;
     }
 
+
+    /**
+     *  Returns the result of a D-Bus method call together with a file
+     *  descriptor, passed as auxiliary data to the caller.
+     *
+     * @param invoc   GDBusMethodInvocation to return the result to
+     * @param params  GVariant with the method result; may be nullptr
+     * @param fd      File descriptor to pass to the caller.  It is
+     *                closed by this function in all cases.
+     *
+     * @throws DBusException if the file descriptor could not be added
+     *         to the result.  No result has been returned in that case.
+     */
+    inline void return_value_with_fd(GDBusMethodInvocation *invoc,
+                                     GVariant *params, int fd)
+    {
+        GError *error = nullptr;
+        GUnixFDList *fdlist = g_unix_fd_list_new();
+        g_unix_fd_list_append(fdlist, fd, &error);
+        close(fd);
+        if (error)
+        {
+            g_error_free(error);
+            unref_fdlist(fdlist);
+            THROW_DBUSEXCEPTION("GLibUtils", "Could not prepare fd result");
+        }
+        g_dbus_method_invocation_return_value_with_unix_fd_list(invoc, params,
+                                                                fdlist);
+        unref_fdlist(fdlist);
+    }
+
 } // namespace GLibUtils
@@ -20,10 +20,8 @@
 #pragma once
 
 #include <iostream>
-#include <memory>
-#include <thread>
+#include <chrono>
 #include <mutex>
-#include <condition_variable>
 
 #include <glib-unix.h>
 
@@ -37,13 +35,22 @@ using namespace openvpn;
  *   runs idle for too long.  How long is too long is defined
  *   by the parameter given to the constructor.
  *
- *   The main program will need to call the UpdateTimestamp()
- *   method whenever it does something which should reset the
- *   IdleCheck timer.
+ *   Each DBusObject with a registered IdleCheck object calls the
+ *   UpdateTimestamp() method when dispatching D-Bus method calls and
+ *   property requests.  Other activity which should reset the IdleCheck
+ *   timer needs to call UpdateTimestamp() explicitly.
+ *
+ *   There is no separate thread polling the timestamp.  A single GLib
+ *   timeout source in the main loop is armed when the IdleCheck is
+ *   enabled.  When it fires, it re-arms itself for the remaining time if
+ *   there has been activity in the meantime.  Updating the timestamp
+ *   does not touch the timer, so busy services do not wake up more often
+ *   than an idle one.
  *
  *   It also implements a reference counting.  If the reference
  *   counter is higher than 0, it will not exit regardless of the
- *   idle timer.
+ *   idle timer, and the timer is not re-armed until the reference
+ *   counter drops to 0 again.
  *
  *   This class also setups up handling of SIGTERM and SIGINT
  *   signals, which will also ensure the program shuts down
@@ -53,6 +60,7 @@ class IdleCheck : public RC<thread_safe_refcount>
 {
 public:
     typedef RCPtr<IdleCheck> Ptr;
+    typedef std::chrono::steady_clock Clock;
 
     /**
      *  IdleCheck constructor
@@ -64,10 +72,10 @@ public:
     IdleCheck(GMainLoop *mainloop, std::chrono::duration<double> idle_time)
         : signal_caught(false),
           mainloop(mainloop),
-          idle_time(idle_time),
+          idle_time(std::chrono::duration_cast<Clock::duration>(idle_time)),
           enabled(false),
-          running(false),
-          refcount(0)
+          refcount(0),
+          timer_id(0)
     {
             g_unix_signal_add(SIGINT, _cb__idlechecker_sighandler,
                               (void *) this);
@@ -78,6 +86,12 @@ public:
     }
 
 
+    ~IdleCheck()
+    {
+        Disable();
+    }
+
+
     /**
      *   This resets the idle check timer.  This ensures
      *   the program will not exit until the next idle check,
@@ -85,48 +99,43 @@ public:
      */
     void UpdateTimestamp()
     {
-        last_operation = std::chrono::system_clock::now();
+        std::lock_guard<std::mutex> guard(timer_mtx);
+        last_operation = Clock::now();
     }
 
 
     /**
      *   This enables the IdleCheck
      *
-     *   The IdleCheck logic runs in a separate and
-     *   independent thread
+     *   This arms the idle timer in the default GLib main context
      */
     void Enable()
     {
-        if (running)
-        {
-            return;
-        }
-
+        std::lock_guard<std::mutex> guard(timer_mtx);
         if (enabled)
         {
             return;
         }
 
         enabled = true;
-        idle_checker.reset(new std::thread([self=Ptr(this)]()
-                           {
-                               self->_cb_idlechecker__loop();
-                           }));
+        arm_timer(idle_time);
     }
 
 
     /**
      *   Disables the IdleCheck
      *
-     *   This may also make the program exit if the
-     *   reference counter is 0.
+     *   This removes the idle timer; the program will not be stopped
+     *   by the IdleCheck until it is enabled again.
      */
     void Disable()
     {
+        std::lock_guard<std::mutex> guard(timer_mtx);
         enabled = false;
-        if (running)
+        if (0 != timer_id)
         {
-            exit_cv.notify_all();
+            g_source_remove(timer_id);
+            timer_id = 0;
         }
     }
 
@@ -138,6 +147,7 @@ public:
      */
     bool GetEnabled()
     {
+        std::lock_guard<std::mutex> guard(timer_mtx);
         return enabled;
     }
 
@@ -147,77 +157,28 @@ public:
      */
     void RefCountInc()
     {
+        std::lock_guard<std::mutex> guard(timer_mtx);
         refcount++;
     }
 
 
     /**
      *   Decreases the reference counter by 1
-     */
-    void RefCountDec()
-    {
-        refcount--;
-    }
-
-
-    /**
-     *   Calls the join() method on the IdleCheck thread.
      *
-     *   This is used during shutdown of the application,
-     *   to cleanly shutdown all running threads
+     *   When the counter reaches 0, the idle timer is armed again
+     *   for the remaining idle time.
      */
-    void Join()
-    {
-        idle_checker->join();
-    }
-
-
-    /**
-     *   Main IdleCheck loop.
-     *
-     *   This is the main loop of the thread performing the
-     *   IdleCheck logic
-     */
-    void _cb_idlechecker__loop()
+    void RefCountDec()
     {
-        running = true;
-        while (enabled)
+        std::lock_guard<std::mutex> guard(timer_mtx);
+        if (0 == refcount)
         {
-            // Wait until the timer completes or we get
-            // notification triggered by SIGINT/SIGTERM signals
-            std::unique_lock<std::mutex> exit_lock(exit_cv_mutex);
-            exit_cv.wait_for(exit_lock, idle_time,
-                             [self=Ptr(this)]
-                              {
-                                    // Do not re-trigger the timer
-                                    // if we have received a signal
-                                    return self->signal_caught;
-                              });
-
-            if (idle_time + last_operation < std::chrono::system_clock::now()
-                || signal_caught)
-            {
-#ifdef SHUTDOWN_NOTIF_PROCESS_NAME
-                if (0 == refcount && !signal_caught)
-                {
-                    // We timed out, start the main loop shutdown
-                    std::cout << SHUTDOWN_NOTIF_PROCESS_NAME
-                              << " starting idle shutdown "
-                              << "(pid: " << std::to_string(getpid()) << ")"
-                              << std::endl;
-                }
-#endif
-
-                // If receiving signals, we exit regardless
-                // of the reference counting state
-                if (0 == refcount || signal_caught)
-                {
-                    g_main_loop_quit(mainloop);
-                    enabled = false;
-                }
-            }
+            return;
+        }
+        if (0 == --refcount)
+        {
+            arm_timer(remaining_time());
         }
-        running = false;
     }
 
 
@@ -238,25 +199,105 @@ public:
         IdleCheck *self = (IdleCheck *)data;
         self->signal_caught = true;
         self->Disable();
+
+        // If receiving signals, we exit regardless
+        // of the reference counting state
+        g_main_loop_quit(self->mainloop);
         return G_SOURCE_CONTINUE;
     }
 
 
     // We make this public for simplicity.  Otherwise it would require
-    // both a setter and getter method as it is used by both the
-    // signal handler below and in the wait_for() lambda in the main
-    // IdleCheck loop.
+    // both a setter and getter method.
     bool signal_caught;  /**< Indicates if a signal has been received */
 
 
 private:
     GMainLoop *mainloop;
-    std::chrono::duration<double> idle_time;
+    Clock::duration idle_time;
     bool enabled;
-    bool running;
-    uint16_t refcount;
-    std::chrono::time_point<std::chrono::system_clock> last_operation;
-    std::unique_ptr<std::thread> idle_checker;
-    std::mutex exit_cv_mutex;
-    std::condition_variable exit_cv;
+    unsigned int refcount;
+    guint timer_id;
+    Clock::time_point last_operation;
+    std::mutex timer_mtx;
+
+
+    /**
+     *  Calculates how much is left of the idle time since the last
+     *  operation.  The caller must hold the timer_mtx lock.
+     *
+     * @return  Returns the remaining Clock::duration, never negative
+     */
+    Clock::duration remaining_time() const
+    {
+        Clock::duration idle = Clock::now() - last_operation;
+        return (idle < idle_time ? idle_time - idle : Clock::duration::zero());
+    }
+
+
+    /**
+     *  Arms the idle timer, unless it is already armed, the IdleCheck
+     *  is disabled or there are references preventing the idle exit.
+     *  The caller must hold the timer_mtx lock.
+     *
+     * @param timeout  How long until the timer should fire
+     */
+    void arm_timer(Clock::duration timeout)
+    {
+        if (!enabled || 0 < refcount || 0 != timer_id)
+        {
+            return;
+        }
+
+        // Second granularity lets GLib coalesce this wakeup with
+        // other timers in the process.  Round up, so the timer does
+        // not fire just before the idle time has passed.
+        guint sec = std::chrono::duration_cast<std::chrono::seconds>(timeout).count() + 1;
+        timer_id = g_timeout_add_seconds_full(G_PRIORITY_DEFAULT, sec,
+                                              _cb_idlechecker_timeout,
+                                              this, nullptr);
+    }
+
+
+    /**
+     *  Called by the GLib main loop when the idle timer fires.  If there
+     *  has been activity since the timer was armed, the timer is re-armed
+     *  for the remaining idle time.  Otherwise the main loop is stopped.
+     *
+     * @param data  Carries a pointer to this IdleCheck object
+     *
+     * @return Always G_SOURCE_REMOVE; a new timer source is armed when
+     *         needed
+     */
+    static gboolean _cb_idlechecker_timeout(gpointer data)
+    {
+        IdleCheck *self = (IdleCheck *) data;
+        {
+            std::lock_guard<std::mutex> guard(self->timer_mtx);
+            self->timer_id = 0;
+            if (!self->enabled || 0 < self->refcount)
+            {
+                // RefCountDec() or Enable() will re-arm the timer
+                return G_SOURCE_REMOVE;
+            }
+
+            Clock::duration remaining = self->remaining_time();
+            if (Clock::duration::zero() < remaining)
+            {
+                self->arm_timer(remaining);
+                return G_SOURCE_REMOVE;
+            }
+            self->enabled = false;
+        }
+
+#ifdef SHUTDOWN_NOTIF_PROCESS_NAME
+        // We timed out, start the main loop shutdown
+        std::cout << SHUTDOWN_NOTIF_PROCESS_NAME
+                  << " starting idle shutdown "
+                  << "(pid: " << std::to_string(getpid()) << ")"
+                  << std::endl;
+#endif
+        g_main_loop_quit(self->mainloop);
+        return G_SOURCE_REMOVE;
+    }
 };
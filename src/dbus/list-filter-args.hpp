@@ -0,0 +1,197 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   list-filter-args.hpp
+ *
+ * @brief  Converts between a ListFilter and the arguments and replies
+ *         of the filtered listing D-Bus methods
+ */
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include <glib.h>
+
+#include "common/list-filter.hpp"
+#include "dbus/glibutils.hpp"
+
+
+/**
+ *  D-Bus signature of the arguments of the filtered listing methods:
+ *  a filter dictionary, the cursor returned by the previous call (empty
+ *  for the first page) and the page size (0 for the largest one).
+ */
+static const char ListFilterArgsType[] = "(a{sv}su)";
+
+
+/**
+ *  Parses the arguments of a filtered listing method call.  The values
+ *  in the filter dictionary may be strings, unsigned integers or
+ *  booleans.  Throws std::invalid_argument on unknown filters or
+ *  invalid values.
+ *
+ * @param params  GVariant with the method arguments, ListFilterArgsType
+ *
+ * @return Returns the ListFilter
+ */
+inline ListFilter ParseListFilterArgs(GVariant *params)
+{
+    GLibUtils::checkParams(__func__, params, ListFilterArgsType, 3);
+
+    GVariantIter *dict = nullptr;
+    const gchar *cursor = nullptr;
+    guint32 limit = 0;
+    g_variant_get(params, "(a{sv}&su)", &dict, &cursor, &limit);
+
+    ListFilter filter;
+    filter.cursor = cursor;
+    filter.SetLimit(limit);
+
+    const gchar *key = nullptr;
+    GVariant *val = nullptr;
+    try
+    {
+        while (g_variant_iter_next(dict, "{&sv}", &key, &val))
+        {
+            std::string value;
+            if (g_variant_is_of_type(val, G_VARIANT_TYPE_STRING))
+            {
+                value = g_variant_get_string(val, nullptr);
+            }
+            else if (g_variant_is_of_type(val, G_VARIANT_TYPE_UINT32))
+            {
+                value = std::to_string(g_variant_get_uint32(val));
+            }
+            else if (g_variant_is_of_type(val, G_VARIANT_TYPE_BOOLEAN))
+            {
+                value = (g_variant_get_boolean(val) ? "true" : "false");
+            }
+            else
+            {
+                throw std::invalid_argument("Invalid data type for filter '"
+                                            + std::string(key) + "'");
+            }
+            g_variant_unref(val);
+            val = nullptr;
+            filter.Set(key, value);
+        }
+    }
+    catch (...)
+    {
+        if (val)
+        {
+            g_variant_unref(val);
+        }
+        g_variant_iter_free(dict);
+        throw;
+    }
+    g_variant_iter_free(dict);
+    return filter;
+}
+
+
+/**
+ *  Returns a net.openvpn.v3.error.filter error to the caller of a
+ *  filtered listing method
+ *
+ * @param invoc  GDBusMethodInvocation to reply to
+ * @param excp   The std::invalid_argument from ParseListFilterArgs()
+ */
+inline void ReturnListFilterError(GDBusMethodInvocation *invoc,
+                                  const std::invalid_argument& excp)
+{
+    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.filter",
+                                                  excp.what());
+    g_dbus_method_invocation_return_gerror(invoc, err);
+    g_error_free(err);
+}
+
+
+/**
+ *  Builds the arguments of a filtered listing method call, used by the
+ *  D-Bus proxies
+ *
+ * @param filter  ListFilter with the criteria, cursor and page size
+ *
+ * @return Returns a new floating GVariant of ListFilterArgsType
+ */
+inline GVariant * BuildListFilterArgs(const ListFilter& filter)
+{
+    GVariantBuilder *dict = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+    if (filter.owner_set)
+    {
+        g_variant_builder_add(dict, "{sv}", "owner",
+                              g_variant_new_uint32(filter.owner));
+    }
+    if (!filter.name_prefix.empty())
+    {
+        g_variant_builder_add(dict, "{sv}", "name_prefix",
+                              g_variant_new_string(filter.name_prefix.c_str()));
+    }
+    if (filter.status_set)
+    {
+        g_variant_builder_add(dict, "{sv}", "status_major",
+                              g_variant_new_uint32(filter.status_major));
+    }
+    if (filter.dco_set)
+    {
+        g_variant_builder_add(dict, "{sv}", "dco",
+                              g_variant_new_boolean(filter.dco));
+    }
+    GVariant *ret = g_variant_new("(a{sv}su)", dict, filter.cursor.c_str(),
+                                  filter.limit);
+    g_variant_builder_unref(dict);
+    return ret;
+}
+
+
+/**
+ *  Parses the reply of a filtered listing method call, used by the
+ *  D-Bus proxies.  The reply is a list of object paths or device names
+ *  and the cursor of the next page.
+ *
+ * @param res  GVariant with the reply, (aos) or (ass).  It is unreferenced.
+ *
+ * @return Returns the ListFilter::Page; the Page::paths member holds
+ *         the device names of the (ass) replies
+ */
+inline ListFilter::Page ParseListFilterReply(GVariant *res)
+{
+    GVariant *list = g_variant_get_child_value(res, 0);
+    GVariant *next = g_variant_get_child_value(res, 1);
+
+    ListFilter::Page page;
+    GVariantIter iter;
+    g_variant_iter_init(&iter, list);
+    GVariant *item = nullptr;
+    while ((item = g_variant_iter_next_value(&iter)))
+    {
+        page.paths.push_back(g_variant_get_string(item, nullptr));
+        g_variant_unref(item);
+    }
+    page.next = g_variant_get_string(next, nullptr);
+
+    g_variant_unref(next);
+    g_variant_unref(list);
+    g_variant_unref(res);
+    return page;
+}
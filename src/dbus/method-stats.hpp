@@ -0,0 +1,375 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   method-stats.hpp
+ *
+ * @brief  Latency histograms of the D-Bus method calls and property
+ *         requests handled by a service, and the net.openvpn.v3.debug
+ *         interface providing them, the resource usage and the start-up
+ *         timeline of the service
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gio/gio.h>
+
+#include "common/latency-histogram.hpp"
+#include "common/startup-timing.hpp"
+#include "connection-creds-cache.hpp"
+#include "resource-usage.hpp"
+
+
+/**
+ *  Process wide collection of latency histograms, one per D-Bus
+ *  interface, request kind and method or property name.
+ *
+ *  Histograms are created on their first use and are never removed, so
+ *  a Histogram pointer stays valid for the life time of the process.
+ *  Only creating a histogram takes a lock; recording a measurement only
+ *  updates atomic counters.
+ */
+class DBusMethodStats
+{
+public:
+    enum class Kind : unsigned int
+    {
+        METHOD = 0,
+        GET_PROPERTY,
+        SET_PROPERTY
+    };
+
+    /// Bucket i counts durations in [2^i, 2^(i+1)) microseconds; the
+    /// first bucket also holds durations below 1 microsecond and the
+    /// last one everything longer.
+    static const unsigned int BUCKETS = 24;
+
+    /// Latencies of one method or property
+    using Histogram = LatencyHistogram;
+
+
+    /**
+     * @return Returns the bucket bounds of the histograms, see BUCKETS
+     */
+    static const std::vector<uint64_t>& BucketBounds()
+    {
+        static const std::vector<uint64_t> bounds = []()
+            {
+                std::vector<uint64_t> b;
+                for (unsigned int i = 1; i < BUCKETS; ++i)
+                {
+                    b.push_back((uint64_t(1) << i) - 1);
+                }
+                return b;
+            }();
+        return bounds;
+    }
+
+
+    /**
+     *  Measures the time from its creation until it goes out of scope
+     *  and records it in a histogram
+     */
+    class Timer
+    {
+    public:
+        Timer(Histogram *h)
+            : hist(h), start(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~Timer()
+        {
+            if (hist)
+            {
+                auto d = std::chrono::steady_clock::now() - start;
+                hist->Record(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+            }
+        }
+
+    private:
+        Histogram *hist;
+        std::chrono::steady_clock::time_point start;
+    };
+
+
+    static DBusMethodStats& Instance()
+    {
+        static DBusMethodStats stats;
+        return stats;
+    }
+
+
+    /**
+     *  Retrieve the histogram of a method or property, creating it if
+     *  needed
+     *
+     * @param interface  std::string with the D-Bus interface
+     * @param kind       Kind of request
+     * @param member     std::string with the method or property name
+     *
+     * @return Returns a pointer to the Histogram
+     */
+    Histogram * Get(const std::string& interface, const Kind kind,
+                    const std::string& member)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto& h = histograms[std::make_tuple(interface, kind, member)];
+        if (!h)
+        {
+            h.reset(new Histogram(BucketBounds()));
+        }
+        return h.get();
+    }
+
+
+    /**
+     *  Retrieve all histograms
+     *
+     * @return Returns a GVariant array (a(ssstttat)) of
+     *         (interface, kind, member, count, total_usec, max_usec,
+     *         buckets) tuples
+     */
+    GVariant * GetVariant()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(ssstttat)"));
+        for (const auto& h : histograms)
+        {
+            GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("at"));
+            for (const auto& c : h.second->Get())
+            {
+                g_variant_builder_add(b, "t", (guint64) c);
+            }
+            g_variant_builder_add(bld, "(ssstttat)",
+                                  std::get<0>(h.first).c_str(),
+                                  KindStr(std::get<1>(h.first)),
+                                  std::get<2>(h.first).c_str(),
+                                  (guint64) h.second->GetCount(),
+                                  (guint64) h.second->GetTotalUsec(),
+                                  (guint64) h.second->GetMaxUsec(),
+                                  b);
+            g_variant_builder_unref(b);
+        }
+        GVariant *ret = g_variant_builder_end(bld);
+        g_variant_builder_unref(bld);
+        return ret;
+    }
+
+
+    void Reset()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        for (auto& h : histograms)
+        {
+            h.second->Reset();
+        }
+    }
+
+
+    static const char * KindStr(const Kind kind)
+    {
+        switch (kind)
+        {
+        case Kind::METHOD:
+            return "method";
+        case Kind::GET_PROPERTY:
+            return "get";
+        case Kind::SET_PROPERTY:
+            return "set";
+        }
+        return "";
+    }
+
+
+private:
+    using Key = std::tuple<std::string, Kind, std::string>;
+
+    std::mutex mtx;
+    std::map<Key, std::unique_ptr<Histogram>> histograms;
+
+    DBusMethodStats() = default;
+};
+
+
+
+/**
+ *  Provides the net.openvpn.v3.debug interface on a D-Bus object path.
+ *  It is registered next to the main interface of the root object of
+ *  each service.  Only root and the user the service runs as can
+ *  access it.
+ */
+class DBusDebugInterface
+{
+public:
+    DBusDebugInterface(GDBusConnection *conn, const std::string& path,
+                       const std::string& interface)
+        : dbuscon(conn)
+    {
+        const std::string xml =
+            "<node>"
+            "  <interface name='" + interface + "'>"
+            "    <method name='GetMethodStats'>"
+            "      <arg type='a(ssstttat)' name='stats' direction='out'/>"
+            "    </method>"
+            "    <method name='ResetMethodStats'/>"
+            "    <method name='GetResourceUsage'>"
+            "      <arg type='a(stt)' name='objects' direction='out'/>"
+            "      <arg type='a(st)' name='process' direction='out'/>"
+            "      <arg type='s' name='malloc_info' direction='out'/>"
+            "    </method>"
+            "    <property type='a(st)' name='startup_timing' access='read'/>"
+            "  </interface>"
+            "</node>";
+
+        GError *err = nullptr;
+        introspection = g_dbus_node_info_new_for_xml(xml.c_str(), &err);
+        if (!introspection)
+        {
+            g_error_free(err);
+            return;
+        }
+        object_id = g_dbus_connection_register_object(dbuscon, path.c_str(),
+                                                      introspection->interfaces[0],
+                                                      &vtable, this,
+                                                      nullptr, &err);
+        if (0 == object_id && err)
+        {
+            // The service works without it; it is only the debug interface
+            g_error_free(err);
+        }
+    }
+
+    ~DBusDebugInterface()
+    {
+        if (0 != object_id)
+        {
+            g_dbus_connection_unregister_object(dbuscon, object_id);
+        }
+        if (introspection)
+        {
+            g_dbus_node_info_unref(introspection);
+        }
+    }
+
+    DBusDebugInterface(const DBusDebugInterface&) = delete;
+    DBusDebugInterface& operator=(const DBusDebugInterface&) = delete;
+
+
+private:
+    GDBusConnection *dbuscon = nullptr;
+    GDBusNodeInfo *introspection = nullptr;
+    guint object_id = 0;
+
+    GDBusInterfaceVTable vtable = {
+        method_call,
+        get_property,
+        nullptr
+    };
+
+
+    /**
+     *  Only root and the user the service runs as may use this
+     *  interface; the UID comes from the credentials cache of the
+     *  connection
+     */
+    bool caller_allowed(const gchar *sender)
+    {
+        return DBusConnectionCredsCache::IsPrivileged(dbuscon, sender);
+    }
+
+
+    static void method_call(GDBusConnection *conn,
+                            const gchar *sender,
+                            const gchar *obj_path,
+                            const gchar *intf_name,
+                            const gchar *meth_name,
+                            GVariant *params,
+                            GDBusMethodInvocation *invoc,
+                            gpointer this_ptr)
+    {
+        DBusDebugInterface *self = static_cast<DBusDebugInterface *>(this_ptr);
+        if (!self->caller_allowed(sender))
+        {
+            g_dbus_method_invocation_return_dbus_error(invoc,
+                                                       "net.openvpn.v3.error.acl.denied",
+                                                       "Access denied");
+            return;
+        }
+
+        if (0 == g_strcmp0(meth_name, "GetMethodStats"))
+        {
+            GVariant *stats = DBusMethodStats::Instance().GetVariant();
+            g_dbus_method_invocation_return_value(invoc,
+                                                  g_variant_new_tuple(&stats, 1));
+        }
+        else if (0 == g_strcmp0(meth_name, "ResetMethodStats"))
+        {
+            DBusMethodStats::Instance().Reset();
+            g_dbus_method_invocation_return_value(invoc, nullptr);
+        }
+        else if (0 == g_strcmp0(meth_name, "GetResourceUsage"))
+        {
+            g_dbus_method_invocation_return_value(invoc,
+                                                  DBusResourceUsage::Instance().GetVariant());
+        }
+        else
+        {
+            g_dbus_method_invocation_return_error(invoc, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_UNKNOWN_METHOD,
+                                                  "Unknown method: %s",
+                                                  meth_name);
+        }
+    }
+
+
+    static GVariant * get_property(GDBusConnection *conn,
+                                   const gchar *sender,
+                                   const gchar *obj_path,
+                                   const gchar *intf_name,
+                                   const gchar *prop_name,
+                                   GError **error,
+                                   gpointer this_ptr)
+    {
+        DBusDebugInterface *self = static_cast<DBusDebugInterface *>(this_ptr);
+        if (!self->caller_allowed(sender))
+        {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
+                        "Access denied");
+            return nullptr;
+        }
+
+        if (0 == g_strcmp0(prop_name, "startup_timing"))
+        {
+            return StartupTiming::Instance().GetGVariant();
+        }
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                    "Unknown property: %s", prop_name);
+        return nullptr;
+    }
+};
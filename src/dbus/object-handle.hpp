@@ -0,0 +1,273 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   object-handle.hpp
+ *
+ * @brief  Lightweight client side handle to a single D-Bus object.  It
+ *         shares an existing GDBusConnection and calls the object directly,
+ *         without setting up any GDBusProxy objects.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "dbus/core.hpp"
+#include "dbus/glibutils.hpp"
+#include "dbus/proxy.hpp"
+
+
+/**
+ *  A DBusProxy sets up two GDBusProxy objects when it is created, each
+ *  costing round trips to the D-Bus daemon.  That is wasted for code which
+ *  only reads a few properties or calls a method or two on many objects.
+ *
+ *  DBusObjectHandle only keeps the destination, object path and interface
+ *  and issues each call with g_dbus_connection_call_sync() on a shared
+ *  connection.  Creating one does not cause any D-Bus traffic.  Errors
+ *  are reported the same way as with DBusProxy.
+ */
+class DBusObjectHandle
+{
+public:
+    /**
+     *  Prepare a handle to a D-Bus object
+     *
+     * @param conn         GDBusConnection to use for all calls.  A reference
+     *                     is held for the lifetime of the handle.
+     * @param destination  D-Bus service (bus name) of the object
+     * @param path         D-Bus object path
+     * @param interface    D-Bus interface of the methods and properties
+     */
+    DBusObjectHandle(GDBusConnection *conn,
+                     const std::string& destination,
+                     const std::string& path,
+                     const std::string& interface)
+        : conn(G_DBUS_CONNECTION(g_object_ref(conn))),
+          destination(destination),
+          path(path),
+          interface(interface)
+    {
+        if (!g_variant_is_object_path(path.c_str()))
+        {
+            g_object_unref(this->conn);
+            THROW_DBUSEXCEPTION("DBusObjectHandle", "Invalid D-Bus path");
+        }
+    }
+
+
+    DBusObjectHandle(const DBusObjectHandle& orig)
+        : conn(G_DBUS_CONNECTION(g_object_ref(orig.conn))),
+          destination(orig.destination),
+          path(orig.path),
+          interface(orig.interface)
+    {
+    }
+
+    DBusObjectHandle& operator=(const DBusObjectHandle&) = delete;
+
+
+    ~DBusObjectHandle()
+    {
+        g_object_unref(conn);
+    }
+
+
+    const std::string& GetPath() const noexcept
+    {
+        return path;
+    }
+
+
+    /**
+     *  Call a D-Bus method on the object
+     *
+     * @param method      std::string with the method name
+     * @param params      GVariant with the method arguments, may be nullptr.
+     *                    A floating reference is consumed.
+     * @param noresponse  If true, the call is sent without waiting for
+     *                    the response and nullptr is returned
+     *
+     * @return  Returns the GVariant response, which must be freed by the
+     *          caller with g_variant_unref()
+     */
+    GVariant* Call(const std::string& method, GVariant *params = nullptr,
+                   bool noresponse = false) const
+    {
+        return call(interface, method, params, noresponse);
+    }
+
+
+    /**
+     *  Retrieve a single property value of the object
+     *
+     * @param property  std::string with the property name
+     *
+     * @return  Returns a GVariant of the property value, which must be
+     *          freed by the caller with g_variant_unref()
+     */
+    GVariant* GetProperty(const std::string& property) const
+    {
+        GVariant *res = call("org.freedesktop.DBus.Properties", "Get",
+                             g_variant_new("(ss)", interface.c_str(),
+                                           property.c_str()));
+        GVariant *ret = nullptr;
+        g_variant_get(res, "(v)", &ret);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
+    /**
+     *  Retrieve a single property value of a specific type
+     *
+     * @param property  std::string with the property name
+     *
+     * @return  Returns the value as the requested C++ type.  If the
+     *          property is of a different D-Bus type, a DBusException
+     *          is thrown.
+     */
+    template<typename T>
+    T GetProperty(const std::string& property) const
+    {
+        GVariant *v = GetProperty(property);
+        return extract<T>(v, property);
+    }
+
+
+    /**
+     *  Retrieve all the properties of the object in a single call
+     *
+     * @return  Returns a GVariant dictionary (a{sv}) of all the properties,
+     *          which must be freed by the caller with g_variant_unref()
+     */
+    GVariant* GetAllProperties() const
+    {
+        GVariant *res = call("org.freedesktop.DBus.Properties", "GetAll",
+                             g_variant_new("(s)", interface.c_str()));
+        GVariant *ret = g_variant_get_child_value(res, 0);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
+    /**
+     *  Look up a property value in a dictionary returned by
+     *  GetAllProperties()
+     *
+     * @param props     GVariant dictionary (a{sv}) of properties
+     * @param property  std::string with the property name
+     *
+     * @return  Returns the value as the requested C++ type.  If the
+     *          property is missing or of a different D-Bus type, a
+     *          DBusException is thrown.
+     */
+    template<typename T>
+    static T LookupProperty(GVariant *props, const std::string& property)
+    {
+        GVariant *v = g_variant_lookup_value(props, property.c_str(), nullptr);
+        if (!v)
+        {
+            THROW_DBUSEXCEPTION("DBusObjectHandle",
+                                "Property '" + property + "' not found");
+        }
+        return extract<T>(v, property);
+    }
+
+
+    /**
+     *  Change a property value of the object
+     *
+     * @param property  std::string with the property name
+     * @param value     GVariant with the new value.  A floating reference
+     *                  is consumed.
+     */
+    void SetProperty(const std::string& property, GVariant *value) const
+    {
+        GVariant *res = call("org.freedesktop.DBus.Properties", "Set",
+                             g_variant_new("(ssv)", interface.c_str(),
+                                           property.c_str(), value));
+        g_variant_unref(res);
+    }
+
+
+private:
+    GDBusConnection *conn;
+    const std::string destination;
+    const std::string path;
+    const std::string interface;
+
+
+    GVariant* call(const std::string& intf, const std::string& method,
+                   GVariant *params, bool noresponse = false) const
+    {
+        if (noresponse)
+        {
+            g_dbus_connection_call(conn, destination.c_str(), path.c_str(),
+                                   intf.c_str(), method.c_str(), params,
+                                   nullptr, G_DBUS_CALL_FLAGS_NONE,
+                                   DBUS_PROXY_CALL_TIMEOUT,
+                                   nullptr, nullptr, nullptr);
+            return nullptr;
+        }
+
+        GError *error = nullptr;
+        GVariant *ret = g_dbus_connection_call_sync(conn,
+                                                    destination.c_str(),
+                                                    path.c_str(),
+                                                    intf.c_str(),
+                                                    method.c_str(),
+                                                    params,
+                                                    nullptr,
+                                                    G_DBUS_CALL_FLAGS_NONE,
+                                                    DBUS_PROXY_CALL_TIMEOUT,
+                                                    nullptr,
+                                                    &error);
+        if (!ret)
+        {
+            dbusproxy_throw_call_error(method, error);
+        }
+        return ret;
+    }
+
+
+    /**
+     *  Extracts a C++ value from a GVariant after checking its type.
+     *  The GVariant is unreferenced.
+     *
+     * @param v         GVariant holding the value
+     * @param property  std::string with the property name, for errors
+     */
+    template<typename T>
+    static T extract(GVariant *v, const std::string& property)
+    {
+        if (!g_variant_is_of_type(v, G_VARIANT_TYPE(GLibUtils::GetDBusDataType<T>())))
+        {
+            std::string type(g_variant_get_type_string(v));
+            g_variant_unref(v);
+            THROW_DBUSEXCEPTION("DBusObjectHandle",
+                                "Property '" + property + "' has unexpected "
+                                "type '" + type + "'");
+        }
+        T ret = GLibUtils::GetVariantValue<T>(v);
+        g_variant_unref(v);
+        return ret;
+    }
+};
@@ -0,0 +1,329 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   object-manager.hpp
+ *
+ * @brief  Implementation of the org.freedesktop.DBus.ObjectManager
+ *         interface for the manager objects, giving access to the
+ *         objects they manage and their properties in a single call
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gio/gio.h>
+
+#include "dbus/connection-creds.hpp"
+#include "dbus/exceptions.hpp"
+#include "dbus/object.hpp"
+
+
+/**
+ *  Provides the org.freedesktop.DBus.ObjectManager interface on the
+ *  object path of a manager object.  GetManagedObjects returns all the
+ *  child objects the caller has access to, with the values of all the
+ *  properties the caller may read.
+ *
+ *  A caller of GetManagedObjects is from then on sent the InterfacesAdded
+ *  and InterfacesRemoved signals about the child objects it has access
+ *  to, until it disconnects from the bus.  Together with the
+ *  PropertiesChanged signals of the child objects, this allows keeping
+ *  a complete copy of the objects without polling.  With signal
+ *  broadcast enabled, these signals are sent to everyone instead and
+ *  InterfacesAdded does not carry any property values.
+ *
+ *  The access check is the same as done when listing the child objects
+ *  via the methods of the manager objects; DBusCredentials::CheckACL().
+ *
+ * @tparam T  Class of the child objects, which must be both a DBusObject
+ *            and a DBusCredentials object
+ */
+template <class T>
+class DBusObjectManager : public DBusObject
+{
+public:
+    /**
+     *  Function returning all the child objects of the manager
+     */
+    using ObjectLister = std::function<std::vector<T *>()>;
+
+
+    /**
+     * @param conn          GDBusConnection the manager object is on
+     * @param mngr_path     std::string with the object path of the
+     *                      manager object
+     * @param child_interf  std::string with the D-Bus interface of the
+     *                      child objects
+     * @param lister        ObjectLister returning the child objects
+     * @param broadcast     If true, the signals are broadcast
+     * @param allow_mngr    Passed to DBusCredentials::CheckACL(); grants
+     *                      the openvpn user access to all child objects
+     */
+    DBusObjectManager(GDBusConnection *conn,
+                      const std::string& mngr_path,
+                      const std::string& child_interf,
+                      ObjectLister lister,
+                      const bool broadcast,
+                      const bool allow_mngr = false)
+        : DBusObject(mngr_path),
+          conn(conn),
+          child_interf(child_interf),
+          lister(std::move(lister)),
+          broadcast(broadcast),
+          allow_mngr(allow_mngr)
+    {
+        ParseIntrospectionXML("org.freedesktop.DBus.ObjectManager",
+                              []()
+                              {
+                                  return std::string(
+                                      "<node>"
+                                      "  <interface name='org.freedesktop.DBus.ObjectManager'>"
+                                      "    <method name='GetManagedObjects'>"
+                                      "      <arg type='a{oa{sa{sv}}}' name='objects' direction='out'/>"
+                                      "    </method>"
+                                      "    <signal name='InterfacesAdded'>"
+                                      "      <arg type='o' name='object_path'/>"
+                                      "      <arg type='a{sa{sv}}' name='interfaces_and_properties'/>"
+                                      "    </signal>"
+                                      "    <signal name='InterfacesRemoved'>"
+                                      "      <arg type='o' name='object_path'/>"
+                                      "      <arg type='as' name='interfaces'/>"
+                                      "    </signal>"
+                                      "  </interface>"
+                                      "</node>");
+                              });
+
+        RegisterMethod("GetManagedObjects",
+                       [this](const MethodCall& call)
+                       {
+                           method_get_managed_objects(call);
+                       });
+
+        // Building the complete list is costly with many child objects,
+        // it must not delay the calls setting up VPN sessions
+        SetLowPriorityMethod("GetManagedObjects");
+    }
+
+
+    ~DBusObjectManager()
+    {
+        for (const auto& s : subscribers)
+        {
+            g_bus_unwatch_name(s.second);
+        }
+        if (GetObjectConnection())
+        {
+            RemoveObject(GetObjectConnection());
+        }
+    }
+
+
+    /**
+     *  Sends the InterfacesAdded signal for a new child object.  Must be
+     *  called after the child object has been registered on the bus.
+     *
+     * @param obj  Pointer to the new child object
+     */
+    void ObjectAdded(T *obj)
+    {
+        if (broadcast)
+        {
+            GVariantBuilder intfs;
+            g_variant_builder_init(&intfs, G_VARIANT_TYPE("a{sa{sv}}"));
+            g_variant_builder_add(&intfs, "{s@a{sv}}", child_interf.c_str(),
+                                  g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+                                                      nullptr, 0));
+            emit(nullptr, "InterfacesAdded",
+                 g_variant_new("(oa{sa{sv}})",
+                               obj->GetObjectPath().c_str(), &intfs));
+            return;
+        }
+
+        for (const auto& s : subscribers)
+        {
+            if (!has_access(obj, s.first))
+            {
+                continue;
+            }
+            GVariantBuilder intfs;
+            g_variant_builder_init(&intfs, G_VARIANT_TYPE("a{sa{sv}}"));
+            g_variant_builder_add(&intfs, "{s@a{sv}}", child_interf.c_str(),
+                                  obj->GetAllProperties(s.first));
+            emit(s.first.c_str(), "InterfacesAdded",
+                 g_variant_new("(oa{sa{sv}})",
+                               obj->GetObjectPath().c_str(), &intfs));
+        }
+    }
+
+
+    /**
+     *  Sends the InterfacesRemoved signal for a child object being
+     *  removed.  The object may already be unregistered from the bus,
+     *  but its access control list must still be intact.
+     *
+     * @param obj  Pointer to the child object being removed
+     */
+    void ObjectRemoved(T *obj)
+    {
+        const std::string path = obj->GetObjectPath();
+        const gchar *intfs[] = {child_interf.c_str(), nullptr};
+        if (broadcast)
+        {
+            emit(nullptr, "InterfacesRemoved",
+                 g_variant_new("(o^as)", path.c_str(), intfs));
+            return;
+        }
+
+        for (const auto& s : subscribers)
+        {
+            if (has_access(obj, s.first))
+            {
+                emit(s.first.c_str(), "InterfacesRemoved",
+                     g_variant_new("(o^as)", path.c_str(), intfs));
+            }
+        }
+    }
+
+
+    GVariant * callback_get_property(GDBusConnection *conn,
+                                     const std::string sender,
+                                     const std::string obj_path,
+                                     const std::string intf_name,
+                                     const std::string property_name,
+                                     GError **error) override
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unknown property");
+        return NULL;
+    }
+
+
+    GVariantBuilder * callback_set_property(GDBusConnection *conn,
+                                            const std::string sender,
+                                            const std::string obj_path,
+                                            const std::string intf_name,
+                                            const std::string property_name,
+                                            GVariant *value,
+                                            GError **error) override
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unknown property");
+        return NULL;
+    }
+
+
+private:
+    GDBusConnection *conn = nullptr;
+    std::string child_interf;
+    ObjectLister lister;
+    bool broadcast = false;
+    bool allow_mngr = false;
+
+    /// Receivers of the InterfacesAdded/InterfacesRemoved signals and
+    /// the watch of their bus name, indexed by unique bus name
+    std::map<std::string, guint> subscribers;
+
+
+    bool has_access(T *obj, const std::string& sender) const
+    {
+        try
+        {
+            obj->CheckACL(sender, allow_mngr);
+            return true;
+        }
+        catch (const DBusCredentialsException&)
+        {
+            return false;
+        }
+        catch (const DBusException&)
+        {
+            // The caller is no longer on the bus
+            return false;
+        }
+    }
+
+
+    void emit(const gchar *destination, const gchar *signal_name,
+              GVariant *params)
+    {
+        GError *err = nullptr;
+        g_dbus_connection_emit_signal(conn, destination,
+                                      GetObjectPath().c_str(),
+                                      "org.freedesktop.DBus.ObjectManager",
+                                      signal_name, params, &err);
+        if (err)
+        {
+            // Not fatal; the client can call GetManagedObjects again
+            g_error_free(err);
+        }
+    }
+
+
+    void method_get_managed_objects(const MethodCall& call)
+    {
+        const std::string sender(call.sender ? call.sender : "");
+        GVariantBuilder objects;
+        g_variant_builder_init(&objects, G_VARIANT_TYPE("a{oa{sa{sv}}}"));
+        for (T *obj : lister())
+        {
+            if (!has_access(obj, sender))
+            {
+                continue;
+            }
+            GVariantBuilder intfs;
+            g_variant_builder_init(&intfs, G_VARIANT_TYPE("a{sa{sv}}"));
+            g_variant_builder_add(&intfs, "{s@a{sv}}", child_interf.c_str(),
+                                  obj->GetAllProperties(sender));
+            g_variant_builder_add(&objects, "{oa{sa{sv}}}",
+                                  obj->GetObjectPath().c_str(), &intfs);
+        }
+
+        if (!broadcast && !sender.empty()
+            && subscribers.find(sender) == subscribers.end())
+        {
+            subscribers[sender] = g_bus_watch_name_on_connection(
+                                        call.conn, sender.c_str(),
+                                        G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                        nullptr, subscriber_vanished,
+                                        this, nullptr);
+        }
+
+        g_dbus_method_invocation_return_value(call.invoc,
+                                              g_variant_new("(a{oa{sa{sv}}})",
+                                                            &objects));
+    }
+
+
+    static void subscriber_vanished(GDBusConnection *conn,
+                                    const gchar *name,
+                                    gpointer this_ptr)
+    {
+        DBusObjectManager *self = static_cast<DBusObjectManager *>(this_ptr);
+        auto it = self->subscribers.find(name);
+        if (self->subscribers.end() == it)
+        {
+            return;
+        }
+        g_bus_unwatch_name(it->second);
+        self->subscribers.erase(it);
+    }
+};
@@ -22,6 +22,10 @@
 
 #pragma once
 
+#include <functional>
+#include <map>
+#include <mutex>
+
 #include <openvpn/common/rc.hpp>
 
 #include "dbus/object.hpp"
@@ -233,13 +237,43 @@ private:
 
 
 
+/**
+ *  Collection of the D-Bus properties of a DBusObject which are bound to
+ *  C++ variables.
+ *
+ *  Besides handling D-Bus Get and Set requests, it tracks properties
+ *  changed by the object itself.  Such changes are flagged with
+ *  SetChanged() and all changes flagged in the same main loop iteration
+ *  are sent as a single org.freedesktop.DBus.Properties.PropertiesChanged
+ *  signal once the main loop is idle.  A property is only included in the
+ *  signal if its value differs from the value last sent or set via D-Bus.
+ */
 class PropertyCollection
 {
   public:
-    PropertyCollection(DBusObject *obj)
+    /**
+     *  Function returning the current value of a property which is not
+     *  bound to a variable, as a GVariant object.
+     */
+    using ValueGetter = std::function<GVariant *()>;
+
+    PropertyCollection(DBusObject *obj_arg)
+        : obj(obj_arg)
     {
     }
 
+    ~PropertyCollection()
+    {
+        if (0 != emit_idle)
+        {
+            g_source_remove(emit_idle);
+        }
+        for (auto& p : published)
+        {
+            g_variant_unref(p.second);
+        }
+    }
+
     void AddBinding(Property::Ptr prop)
     {
         properties.insert(std::pair<std::string, Property::Ptr>(prop->GetName(), prop));
@@ -285,9 +319,206 @@ class PropertyCollection
         if (prop == properties.end())
             return NULL;
 
-        return prop->second->SetValue(value);
+        GVariantBuilder *ret = prop->second->SetValue(value);
+
+        // The D-Bus Set call sends its own PropertiesChanged signal
+        update_published(property_name, prop->second->GetValue());
+        return ret;
+    }
+
+
+    /**
+     *  Store a new value in a bound variable, without touching the last
+     *  published value.  Used with SetPublished() by objects applying a
+     *  D-Bus Set call later on, outside of the main loop.
+     *
+     * @param property_name  std::string with the property name
+     * @param value          GVariant with the new value
+     */
+    void Assign(const std::string& property_name, GVariant *value)
+    {
+        auto prop = properties.find(property_name);
+        if (prop == properties.end())
+        {
+            return;
+        }
+        g_variant_builder_unref(prop->second->SetValue(value));
+    }
+
+
+    /**
+     *  Record the value sent by a D-Bus Set call as the last published
+     *  one, so it is not announced once more when it is applied.
+     *
+     * @param property_name  std::string with the property name
+     * @param value          GVariant with the new value
+     */
+    void SetPublished(const std::string& property_name, GVariant *value)
+    {
+        update_published(property_name, value);
+    }
+
+
+    /**
+     *  Flag a bound property as changed by the object itself.  The
+     *  PropertiesChanged signal is sent when the main loop is idle.
+     *
+     * @param property_name  std::string with the property name
+     */
+    void SetChanged(const std::string& property_name)
+    {
+        SetChanged(property_name, nullptr);
+    }
+
+
+    /**
+     *  Flag a property as changed by the object itself, where the value
+     *  is not bound to a variable in this collection.  The getter is
+     *  called when the PropertiesChanged signal is prepared.
+     *
+     * @param property_name  std::string with the property name
+     * @param getter         ValueGetter returning the current value.  If
+     *                       it returns NULL, the property is not included
+     *                       in the signal.
+     */
+    void SetChanged(const std::string& property_name, ValueGetter getter)
+    {
+        std::lock_guard<std::mutex> guard(change_mtx);
+        changed[property_name] = getter;
+        if (0 == emit_idle)
+        {
+            emit_idle = g_idle_add(emit_idle_cb, this);
+        }
+    }
+
+
+    /**
+     *  Send the PropertiesChanged signal for all properties flagged as
+     *  changed right away, instead of waiting for the main loop.
+     */
+    void EmitChanges()
+    {
+        std::map<std::string, ValueGetter> pending;
+        {
+            std::lock_guard<std::mutex> guard(change_mtx);
+            pending.swap(changed);
+            if (0 != emit_idle)
+            {
+                g_source_remove(emit_idle);
+                emit_idle = 0;
+            }
+        }
+        emit_changes(pending);
     }
 
+
   private:
+    DBusObject *obj = nullptr;
     std::map<std::string, Property::Ptr> properties;
+    std::mutex change_mtx;
+    std::map<std::string, ValueGetter> changed;
+    std::map<std::string, GVariant *> published;
+    guint emit_idle = 0;
+
+
+    /**
+     *  Replace the last known value of a property.  Takes ownership
+     *  of the value.
+     *
+     * @return Returns true if the value differs from the previous one
+     */
+    bool update_published(const std::string& property_name, GVariant *value)
+    {
+        g_variant_ref_sink(value);
+        auto p = published.find(property_name);
+        if (published.end() == p)
+        {
+            published[property_name] = value;
+            return true;
+        }
+        if (g_variant_equal(p->second, value))
+        {
+            g_variant_unref(value);
+            return false;
+        }
+        g_variant_unref(p->second);
+        p->second = value;
+        return true;
+    }
+
+
+    void emit_changes(const std::map<std::string, ValueGetter>& pending)
+    {
+        GDBusConnection *conn = obj->GetObjectConnection();
+        if (pending.empty() || !conn)
+        {
+            return;
+        }
+
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        unsigned int count = 0;
+        for (const auto& c : pending)
+        {
+            GVariant *value = nullptr;
+            if (c.second)
+            {
+                value = c.second();
+            }
+            else
+            {
+                auto prop = properties.find(c.first);
+                if (properties.end() != prop)
+                {
+                    value = prop->second->GetValue();
+                }
+            }
+            if (!value)
+            {
+                continue;
+            }
+            if (update_published(c.first, value))
+            {
+                g_variant_builder_add(bld, "{sv}", c.first.c_str(), value);
+                ++count;
+            }
+        }
+
+        if (0 == count)
+        {
+            g_variant_builder_unref(bld);
+            return;
+        }
+
+        GError *err = nullptr;
+        g_dbus_connection_emit_signal(conn,
+                                      NULL,
+                                      obj->GetObjectPath().c_str(),
+                                      "org.freedesktop.DBus.Properties",
+                                      "PropertiesChanged",
+                                      g_variant_new("(sa{sv}as)",
+                                                    obj->GetObjectInterface().c_str(),
+                                                    bld,
+                                                    NULL),
+                                      &err);
+        g_variant_builder_unref(bld);
+        if (err)
+        {
+            // Not fatal; clients can still retrieve the values
+            g_error_free(err);
+        }
+    }
+
+
+    static gboolean emit_idle_cb(gpointer this_ptr)
+    {
+        PropertyCollection *self = static_cast<PropertyCollection *>(this_ptr);
+        std::map<std::string, ValueGetter> pending;
+        {
+            std::lock_guard<std::mutex> guard(self->change_mtx);
+            pending.swap(self->changed);
+            self->emit_idle = 0;
+        }
+        self->emit_changes(pending);
+        return G_SOURCE_REMOVE;
+    }
 };
@@ -0,0 +1,333 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   object-subtree.hpp
+ *
+ * @brief  Serves the child objects of a manager object through a single
+ *         D-Bus subtree registration
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <gio/gio.h>
+
+#include "dbus/exceptions.hpp"
+#include "dbus/object.hpp"
+
+
+/**
+ *  Registers all the object paths directly below a root path with a
+ *  single g_dbus_connection_register_subtree() call.  The child objects
+ *  are marked as registered with DBusObject::RegisterSubtreeObject()
+ *  instead of each having their own object registration, which keeps
+ *  the registration cost and the memory use of the D-Bus connection
+ *  independent of the number of child objects.
+ *
+ *  The child object handling a call is looked up each time a call for
+ *  its object path arrives, so calls queued for an object removed in the
+ *  mean time get an UnknownObject error.
+ */
+class DBusObjectSubtree
+{
+public:
+    /**
+     *  Function returning the child object with the given object path,
+     *  nullptr if there is none
+     */
+    using Lookup = std::function<DBusObject *(const std::string& path)>;
+
+    /**
+     *  Function returning the node names of the child objects, which is
+     *  the last element of their object path, a bus name has access to
+     */
+    using Enumerate = std::function<std::vector<std::string>(const std::string& sender)>;
+
+
+    /**
+     * @param root_path  std::string with the object path the child
+     *                   objects are directly below
+     * @param lookup     Lookup function finding the child objects
+     * @param enumerate  Enumerate function listing the child objects in
+     *                   the introspection data of the root path
+     */
+    DBusObjectSubtree(const std::string& root_path, Lookup lookup,
+                      Enumerate enumerate)
+        : root_path(root_path),
+          lookup(std::move(lookup)),
+          enumerate(std::move(enumerate))
+    {
+    }
+
+    DBusObjectSubtree(const DBusObjectSubtree&) = delete;
+    DBusObjectSubtree& operator=(const DBusObjectSubtree&) = delete;
+
+
+    ~DBusObjectSubtree()
+    {
+        Unregister();
+    }
+
+
+    /**
+     *  Registers the subtree on a D-Bus connection
+     *
+     * @param dbuscon  GDBusConnection to register the subtree on
+     *
+     * @throws DBusException if the registration failed
+     */
+    void Register(GDBusConnection *dbuscon)
+    {
+        if (0 != subtree_id)
+        {
+            THROW_DBUSEXCEPTION("DBusObjectSubtree",
+                                "Subtree is already registered in D-Bus");
+        }
+
+        GError *error = nullptr;
+        subtree_id = g_dbus_connection_register_subtree(dbuscon,
+                                                        root_path.c_str(),
+                                                        subtree_vtable(),
+                                                        G_DBUS_SUBTREE_FLAGS_DISPATCH_TO_UNENUMERATED_NODES,
+                                                        this,
+                                                        nullptr,
+                                                        &error);
+        if (0 == subtree_id)
+        {
+            std::string err(error ? error->message : "(unknown)");
+            if (error)
+            {
+                g_error_free(error);
+            }
+            THROW_DBUSEXCEPTION("DBusObjectSubtree",
+                                "Register(" + root_path + ") failed: " + err);
+        }
+        conn = dbuscon;
+    }
+
+
+    /**
+     *  Removes the subtree registration, if registered
+     */
+    void Unregister()
+    {
+        if (0 != subtree_id)
+        {
+            g_dbus_connection_unregister_subtree(conn, subtree_id);
+            subtree_id = 0;
+            conn = nullptr;
+        }
+    }
+
+
+private:
+    std::string root_path;
+    Lookup lookup;
+    Enumerate enumerate;
+    GDBusConnection *conn = nullptr;
+    guint subtree_id = 0;
+
+
+    /**
+     *  Finds the child object of an object path, if it is still
+     *  registered
+     */
+    DBusObject *find_object(const gchar *obj_path) const
+    {
+        DBusObject *obj = lookup(obj_path);
+        return (obj && obj->GetObjectConnection() ? obj : nullptr);
+    }
+
+
+    static const GDBusSubtreeVTable * subtree_vtable()
+    {
+        static const GDBusSubtreeVTable vtable = {
+            subtree_enumerate,
+            subtree_introspect,
+            subtree_dispatch,
+            {}
+        };
+        return &vtable;
+    }
+
+
+    /**
+     *  Forwards the calls to the child objects, see subtree_dispatch()
+     */
+    static const GDBusInterfaceVTable * forward_vtable()
+    {
+        static const GDBusInterfaceVTable vtable = {
+            forward_method_call,
+            forward_get_property,
+            forward_set_property,
+            {}
+        };
+        return &vtable;
+    }
+
+
+    static gchar ** subtree_enumerate(GDBusConnection *conn,
+                                      const gchar *sender,
+                                      const gchar *obj_path,
+                                      gpointer this_ptr)
+    {
+        DBusObjectSubtree *self = static_cast<DBusObjectSubtree *>(this_ptr);
+
+        std::vector<std::string> nodes;
+        try
+        {
+            nodes = self->enumerate(sender ? sender : "");
+        }
+        catch (const std::exception&)
+        {
+            // Introspection of the root path just lists no child objects
+        }
+
+        gchar **ret = g_new0(gchar *, nodes.size() + 1);
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            ret[i] = g_strdup(nodes[i].c_str());
+        }
+        return ret;
+    }
+
+
+    static GDBusInterfaceInfo ** subtree_introspect(GDBusConnection *conn,
+                                                    const gchar *sender,
+                                                    const gchar *obj_path,
+                                                    const gchar *node,
+                                                    gpointer this_ptr)
+    {
+        if (nullptr == node)
+        {
+            // The root path is registered as an ordinary object
+            return nullptr;
+        }
+
+        DBusObjectSubtree *self = static_cast<DBusObjectSubtree *>(this_ptr);
+        DBusObject *obj = self->find_object((self->root_path + "/" + node).c_str());
+        if (nullptr == obj || nullptr == obj->GetInterfaceInfo())
+        {
+            return nullptr;
+        }
+
+        GDBusInterfaceInfo **ret = g_new0(GDBusInterfaceInfo *, 2);
+        ret[0] = g_dbus_interface_info_ref(obj->GetInterfaceInfo());
+        return ret;
+    }
+
+
+    static const GDBusInterfaceVTable * subtree_dispatch(GDBusConnection *conn,
+                                                         const gchar *sender,
+                                                         const gchar *obj_path,
+                                                         const gchar *intf_name,
+                                                         const gchar *node,
+                                                         gpointer *out_this_ptr,
+                                                         gpointer this_ptr)
+    {
+        if (nullptr == node)
+        {
+            return nullptr;
+        }
+
+        // The call is made later from an idle callback, so the object is
+        // looked up again when forwarding it instead of passing it on here
+        *out_this_ptr = this_ptr;
+        return forward_vtable();
+    }
+
+
+    static void forward_method_call(GDBusConnection *conn,
+                                    const gchar *sender,
+                                    const gchar *obj_path,
+                                    const gchar *intf_name,
+                                    const gchar *meth_name,
+                                    GVariant *params,
+                                    GDBusMethodInvocation *invoc,
+                                    gpointer this_ptr)
+    {
+        DBusObjectSubtree *self = static_cast<DBusObjectSubtree *>(this_ptr);
+        DBusObject *obj = self->find_object(obj_path);
+        if (nullptr == obj)
+        {
+            g_dbus_method_invocation_return_error(invoc, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_UNKNOWN_OBJECT,
+                                                  "No such object path '%s'",
+                                                  obj_path);
+            return;
+        }
+        DBusObject::GetInterfaceVTable()->method_call(conn, sender, obj_path,
+                                                      intf_name, meth_name,
+                                                      params, invoc, obj);
+    }
+
+
+    static GVariant * forward_get_property(GDBusConnection *conn,
+                                           const gchar *sender,
+                                           const gchar *obj_path,
+                                           const gchar *intf_name,
+                                           const gchar *property_name,
+                                           GError **error,
+                                           gpointer this_ptr)
+    {
+        DBusObjectSubtree *self = static_cast<DBusObjectSubtree *>(this_ptr);
+        DBusObject *obj = self->find_object(obj_path);
+        if (nullptr == obj)
+        {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                        "No such object path '%s'", obj_path);
+            return nullptr;
+        }
+        return DBusObject::GetInterfaceVTable()->get_property(conn, sender,
+                                                              obj_path,
+                                                              intf_name,
+                                                              property_name,
+                                                              error, obj);
+    }
+
+
+    static gboolean forward_set_property(GDBusConnection *conn,
+                                         const gchar *sender,
+                                         const gchar *obj_path,
+                                         const gchar *intf_name,
+                                         const gchar *property_name,
+                                         GVariant *value,
+                                         GError **error,
+                                         gpointer this_ptr)
+    {
+        DBusObjectSubtree *self = static_cast<DBusObjectSubtree *>(this_ptr);
+        DBusObject *obj = self->find_object(obj_path);
+        if (nullptr == obj)
+        {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                        "No such object path '%s'", obj_path);
+            return false;
+        }
+        return DBusObject::GetInterfaceVTable()->set_property(conn, sender,
+                                                              obj_path,
+                                                              intf_name,
+                                                              property_name,
+                                                              value, error,
+                                                              obj);
+    }
+};
@@ -19,7 +19,93 @@
 
 #pragma once
 
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "connection-creds-cache.hpp"
 #include "idlecheck.hpp"
+#include "method-stats.hpp"
+#include "request-throttle.hpp"
+
+
+/**
+ *  Process wide cache of parsed introspection documents.  All objects
+ *  of the same class provide the same D-Bus interface, so the document
+ *  only needs to be generated and parsed once per class.  Each object
+ *  takes its own reference on the shared GDBusNodeInfo; the cache keeps
+ *  one reference for the lifetime of the process.
+ */
+class DBusIntrospectionCache
+{
+public:
+    /**
+     *  Retrieve the parsed introspection document for a class of
+     *  objects, generating and parsing it if not already cached.
+     *  Throws DBusException if the document cannot be parsed.
+     *
+     * @param key        std::string with a key unique for the class
+     * @param generator  Function returning the introspection XML
+     *                   document, only called on the first look-up
+     *
+     * @return Returns a GDBusNodeInfo pointer with a new reference,
+     *         which must be released with g_dbus_node_info_unref()
+     */
+    static GDBusNodeInfo * Get(const std::string& key,
+                               const std::function<std::string()>& generator)
+    {
+        static std::mutex mtx;
+        static std::map<std::string, GDBusNodeInfo *> cache;
+
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = cache.find(key);
+        if (cache.end() != it)
+        {
+            return g_dbus_node_info_ref(it->second);
+        }
+
+        GDBusNodeInfo *info = Parse(generator());
+        cache[key] = info;
+        return g_dbus_node_info_ref(info);
+    }
+
+
+    /**
+     *  Parses an introspection XML document.  Throws DBusException
+     *  if the document cannot be parsed.
+     *
+     * @param xmlstr  std::string with the introspection XML document
+     *
+     * @return Returns a GDBusNodeInfo pointer, which must be released
+     *         with g_dbus_node_info_unref()
+     */
+    static GDBusNodeInfo * Parse(const std::string& xmlstr)
+    {
+        GError *error = nullptr;
+        GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(xmlstr.c_str(), &error);
+        if (NULL == info || NULL != error)
+        {
+            std::string msg(error ? error->message : "(unknown)");
+            if (error)
+            {
+                g_error_free(error);
+            }
+            if (info)
+            {
+                g_dbus_node_info_unref(info);
+            }
+            THROW_DBUSEXCEPTION("DBusObject", "Failed to parse introspection XML:" + msg);
+        }
+        return info;
+    }
+};
+
 
 /**
  *  DBusObject is the object which carries data, methods
@@ -49,6 +135,25 @@
 class DBusObject
 {
 public:
+    /**
+     *  Details about a D-Bus method call, passed to method handlers
+     *  registered via RegisterMethod().  The strings are owned by the
+     *  GDBus library and are only valid while the handler runs.
+     */
+    struct MethodCall
+    {
+        GDBusConnection *conn;
+        const gchar *sender;
+        const gchar *object_path;
+        const gchar *interface;
+        const gchar *method;
+        GVariant *params;
+        GDBusMethodInvocation *invoc;
+    };
+
+    typedef std::function<void(const MethodCall& call)> MethodHandler;
+
+
     DBusObject(std::string obj_path, std::string introspection_xml) :
         registered(false),
         object_path(obj_path),
@@ -71,6 +176,8 @@ public:
 
     virtual ~DBusObject()
     {
+        cancel_deferred_calls();
+        remove_peer_registrations();
         if (introspection)
         {
             g_dbus_node_info_unref(introspection);
@@ -94,6 +201,92 @@ public:
     }
 
 
+    /**
+     *  Retrieve the D-Bus connection this object is registered on
+     *
+     * @return Returns a GDBusConnection pointer, nullptr if the object
+     *         is not registered
+     */
+    GDBusConnection * GetObjectConnection() const
+    {
+        return (registered ? object_conn : nullptr);
+    }
+
+
+    /**
+     *  Retrieve the D-Bus interface name this object provides
+     *
+     * @return Returns a std::string with the interface name, empty if
+     *         no introspection document has been parsed
+     */
+    std::string GetObjectInterface() const
+    {
+        if (!introspection || !introspection->interfaces[0])
+        {
+            return "";
+        }
+        return std::string(introspection->interfaces[0]->name);
+    }
+
+
+    /**
+     *  Retrieve the values of all the readable properties of this object,
+     *  as seen by a D-Bus caller.  Properties the caller is not allowed
+     *  to read are left out.  Used for the GetManagedObjects method of
+     *  DBusObjectManager.
+     *
+     * @param sender  std::string with the bus name of the caller
+     *
+     * @return Returns a floating GVariant a{sv} dictionary, empty if the
+     *         object is not registered
+     */
+    GVariant * GetAllProperties(const std::string& sender)
+    {
+        GVariantBuilder bld;
+        g_variant_builder_init(&bld, G_VARIANT_TYPE("a{sv}"));
+        if (!registered || !introspection || !introspection->interfaces[0]
+            || !introspection->interfaces[0]->properties)
+        {
+            return g_variant_builder_end(&bld);
+        }
+
+        const std::string intf(introspection->interfaces[0]->name);
+        for (GDBusPropertyInfo **p = introspection->interfaces[0]->properties;
+             *p; ++p)
+        {
+            if (!((*p)->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE))
+            {
+                continue;
+            }
+
+            GError *err = nullptr;
+            GVariant *value = nullptr;
+            try
+            {
+                value = _dbus_get_property_internal(object_conn, sender,
+                                                    object_path, intf,
+                                                    (*p)->name, &err);
+            }
+            catch (const std::exception&)
+            {
+                // A property which cannot be read does not prevent
+                // reporting the other ones
+            }
+            if (err)
+            {
+                g_error_free(err);
+            }
+            if (value)
+            {
+                g_variant_ref_sink(value);
+                g_variant_builder_add(&bld, "{sv}", (*p)->name, value);
+                g_variant_unref(value);
+            }
+        }
+        return g_variant_builder_end(&bld);
+    }
+
+
     void RegisterObject(GDBusConnection *dbuscon)
     {
         if (registered)
@@ -109,7 +302,9 @@ public:
         object_id = g_dbus_connection_register_object(dbuscon,
                                                       object_path.c_str(),
                                                       introspection->interfaces[0],
-                                                      &dbusobj_interface_vtable,
+                                                      (async_set_property
+                                                       ? async_set_interface_vtable()
+                                                       : interface_vtable()),
                                                       this,
                                                       NULL, // destruct function
                                                       &error);
@@ -120,10 +315,100 @@ public:
             err << (error != NULL ? error->message : "(unknown)");
             THROW_DBUSEXCEPTION("DBusObject", err.str());
         }
+        object_conn = dbuscon;
         registered = true;
     }
 
 
+    /**
+     *  Marks this object as served through a DBusObjectSubtree
+     *  registration on the given connection instead of having its own
+     *  object registration.  The subtree dispatches calls for the object
+     *  path to this object as long as it remains registered.
+     *
+     * @param dbuscon  GDBusConnection the subtree is registered on
+     */
+    void RegisterSubtreeObject(GDBusConnection *dbuscon)
+    {
+        if (registered)
+        {
+            THROW_DBUSEXCEPTION("DBusObject", "Object is already registered in D-Bus");
+        }
+        if (nullptr == introspection)
+        {
+            THROW_DBUSEXCEPTION("DBusObject", "No introspection document parsed");
+        }
+        object_id = 0;
+        object_conn = dbuscon;
+        registered = true;
+    }
+
+
+    /**
+     * @return Returns the D-Bus interface description of this object,
+     *         nullptr if no introspection document has been parsed.  The
+     *         pointer is owned by the object.
+     */
+    GDBusInterfaceInfo * GetInterfaceInfo() const
+    {
+        return (introspection ? introspection->interfaces[0] : nullptr);
+    }
+
+
+    /**
+     * @return Returns the callback table D-Bus uses to call into objects,
+     *         with the object pointer as the user_data
+     */
+    static const GDBusInterfaceVTable * GetInterfaceVTable()
+    {
+        return interface_vtable();
+    }
+
+
+    /**
+     *  Makes this object available on a private peer-to-peer connection
+     *  as well, see DBusPeerLink.  Messages on such a connection have no
+     *  sender, so method calls and property requests received on it are
+     *  handled as if they were sent by the given bus name.  The object
+     *  must already be registered on the bus.
+     *
+     *  The registration is removed by RemoveObject().
+     *
+     * @param conn         GDBusConnection of the peer-to-peer connection
+     * @param peer_sender  std::string with the unique bus name of the
+     *                     peer process on the bus
+     */
+    void RegisterPeerObject(GDBusConnection *conn, const std::string& peer_sender)
+    {
+        if (!registered)
+        {
+            THROW_DBUSEXCEPTION("DBusObject", "Object have not been registered to D-Bus yet");
+        }
+
+        std::unique_ptr<PeerRegistration> reg(new PeerRegistration{this, peer_sender, conn, 0});
+        GError *error = nullptr;
+        reg->object_id = g_dbus_connection_register_object(conn,
+                                                           object_path.c_str(),
+                                                           introspection->interfaces[0],
+                                                           peer_interface_vtable(),
+                                                           reg.get(),
+                                                           nullptr,
+                                                           &error);
+        if (reg->object_id < 1)
+        {
+            std::string err(error ? error->message : "(unknown)");
+            if (error)
+            {
+                g_error_free(error);
+            }
+            THROW_DBUSEXCEPTION("DBusObject", "RegisterPeerObject(" + object_path
+                                + ") failed: " + err);
+        }
+        g_object_ref(conn);
+        peer_registrations.push_back(std::move(reg));
+    }
+
+
     /**
      *  Sets/registers an IdleChecker object for this DBusObject
      *
@@ -153,8 +438,13 @@ public:
                       << std::endl;
         }
 
-        // Remove the object from the D-Bus
-        g_dbus_connection_unregister_object(dbuscon, object_id);
+        // Remove the object from the D-Bus.  Objects served through a
+        // subtree registration have no registration of their own
+        if (object_id > 0)
+        {
+            g_dbus_connection_unregister_object(dbuscon, object_id);
+        }
+        remove_peer_registrations();
 
         // Allow the implementor to add more cleaning up
         callback_destructor();
@@ -166,7 +456,11 @@ public:
 
 
     /**
-     *  Called each time a D-Bus client calls an object method
+     *  Called each time a D-Bus client calls an object method which
+     *  does not have a handler registered via RegisterMethod().
+     *
+     *  The default implementation returns an UnknownMethod error
+     *  to the caller.
      */
     virtual void callback_method_call(GDBusConnection *conn,
                                       const std::string sender,
@@ -174,7 +468,13 @@ public:
                                       const std::string intf_name,
                                       const std::string meth_name,
                                       GVariant *params,
-                                      GDBusMethodInvocation *invoc) = 0;
+                                      GDBusMethodInvocation *invoc)
+    {
+        g_dbus_method_invocation_return_error(invoc, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method: %s",
+                                              meth_name.c_str());
+    }
 
 
     GVariant * _dbus_get_property_internal(GDBusConnection *conn,
@@ -304,6 +604,68 @@ public:
                                            GError **error) = 0;
 
 
+    /**
+     *  Called for each D-Bus Set call when EnableAsyncPropertySet() has
+     *  been used.  The implementation completes the call later on with
+     *  CompleteSetProperty() or DBusPropertyException::SetDBusError().
+     *  A DBusPropertyException thrown before it returns is sent to the
+     *  caller as well.  The default runs callback_set_property() right
+     *  away.
+     */
+    virtual void callback_set_property_async(GDBusConnection *conn,
+                                             const std::string sender,
+                                             const std::string obj_path,
+                                             const std::string intf_name,
+                                             const std::string property_name,
+                                             GVariant *value,
+                                             GDBusMethodInvocation *invoc)
+    {
+        GError *error = nullptr;
+        GVariantBuilder *ret = callback_set_property(conn, sender, obj_path,
+                                                     intf_name, property_name,
+                                                     value, &error);
+        if (error)
+        {
+            g_dbus_method_invocation_return_gerror(invoc, error);
+            g_error_free(error);
+            return;
+        }
+        CompleteSetProperty(invoc, intf_name, ret);
+    }
+
+
+    /**
+     *  Replies to a D-Bus Set call handled by callback_set_property_async()
+     *  and sends the PropertiesChanged signal for the change.
+     *
+     * @param invoc      GDBusMethodInvocation of the Set call
+     * @param intf_name  std::string with the interface of the property
+     * @param changed    GVariantBuilder with the changed properties, as
+     *                   returned by build_set_property_response().  It
+     *                   is released here.  May be nullptr.
+     */
+    void CompleteSetProperty(GDBusMethodInvocation *invoc,
+                             const std::string& intf_name,
+                             GVariantBuilder *changed)
+    {
+        if (changed)
+        {
+            g_dbus_connection_emit_signal(g_dbus_method_invocation_get_connection(invoc),
+                                          NULL,
+                                          object_path.c_str(),
+                                          "org.freedesktop.DBus.Properties",
+                                          "PropertiesChanged",
+                                          g_variant_new("(sa{sv}as)",
+                                                        intf_name.c_str(),
+                                                        changed,
+                                                        NULL),
+                                          NULL);
+            g_variant_builder_unref(changed);
+        }
+        g_dbus_method_invocation_return_value(invoc, NULL);
+    }
+
+
     /**
      *  Simple helper wrapper preparing the signal response needed by call_set_property()
      *  This prepares the response packet which is sent as a signal to D-Bus about which
@@ -432,6 +794,22 @@ public:
     virtual void callback_destructor () {}
 
 protected:
+    /**
+     *  Lets callback_set_property_async() handle the D-Bus Set calls of
+     *  this object, so they can be replied to once the change has been
+     *  applied outside of the main loop.  This must be called before
+     *  RegisterObject() and only applies to that registration.
+     */
+    void EnableAsyncPropertySet()
+    {
+        if (registered)
+        {
+            THROW_DBUSEXCEPTION("DBusObject", "Object is already registered in D-Bus");
+        }
+        async_set_property = true;
+    }
+
+
     /**
      *  Parses and processes the introspection XML document
      *  describing this object.  This is used when registering this object
@@ -447,12 +825,41 @@ protected:
                                 "Cannot modify the introspection document.");
         }
 
-        GError *error = nullptr;
-        introspection = g_dbus_node_info_new_for_xml(xmlstr.c_str(), &error);
-        if (NULL == introspection || NULL != error)
+        GDBusNodeInfo *info = DBusIntrospectionCache::Parse(xmlstr);
+        if (introspection)
         {
-            THROW_DBUSEXCEPTION("DBusObject", "Failed to parse introspection XML:" + std::string(error->message));
+            g_dbus_node_info_unref(introspection);
         }
+        introspection = info;
+    }
+
+
+    /**
+     *  Uses the introspection document shared by all objects of the
+     *  same class.  The document is only generated and parsed for the
+     *  first object; the following objects reuse the parsed document.
+     *  The document must therefore not depend on the object itself,
+     *  such as its object path.
+     *
+     *  @param cache_key  std::string unique for the class of objects,
+     *                    usually the D-Bus interface name
+     *  @param generator  Function returning the introspection XML document
+     */
+    void ParseIntrospectionXML(const std::string& cache_key,
+                               const std::function<std::string()>& generator)
+    {
+        if (registered)
+        {
+            THROW_DBUSEXCEPTION("DBusObject", "Object is already registered in D-Bus. "
+                                "Cannot modify the introspection document.");
+        }
+
+        GDBusNodeInfo *info = DBusIntrospectionCache::Get(cache_key, generator);
+        if (introspection)
+        {
+            g_dbus_node_info_unref(introspection);
+        }
+        introspection = info;
     }
 
 
@@ -469,9 +876,43 @@ protected:
     }
 
 
+    /**
+     *  Registers a handler for a D-Bus method in this object.  Method
+     *  calls with a registered handler are dispatched through a hash
+     *  table lookup instead of going via callback_method_call().
+     *
+     *  @param method_name  std::string with the D-Bus method name
+     *  @param handler      MethodHandler to call for this method
+     */
+    void RegisterMethod(const std::string& method_name,
+                        MethodHandler handler)
+    {
+        method_handlers[g_quark_from_string(method_name.c_str())] = handler;
+    }
+
+
+    /**
+     *  Marks a D-Bus method of this object as low priority.  Calls to
+     *  such methods are queued and handled when the main loop has no
+     *  other D-Bus calls or events with the default priority pending.
+     *  This is meant for listing and monitoring methods, so a busy
+     *  monitoring tool does not delay the calls setting up VPN
+     *  sessions.
+     *
+     *  @param method_name  std::string with the D-Bus method name
+     */
+    void SetLowPriorityMethod(const std::string& method_name)
+    {
+        low_priority_methods.insert(g_quark_from_string(method_name.c_str()));
+    }
+
+
     /**
      *  Updates the IdleCheck timer's timestamp to indicate this object have been accessed.
      *  If the IdleCheck object times out, the process is stopped.
+     *
+     *  This is done automatically for all D-Bus method calls and property
+     *  requests dispatched to this object.
      */
     void IdleCheck_UpdateTimestamp()
     {
@@ -512,19 +953,164 @@ protected:
 
 private:
     bool registered;
+    bool async_set_property = false;
     std::string object_path;
     guint object_id;
+    GDBusConnection *object_conn = nullptr;
     IdleCheck *idle_checker;
-    GDBusNodeInfo *introspection;
+    GDBusNodeInfo *introspection = nullptr;
+    std::unordered_map<GQuark, MethodHandler> method_handlers;
+
+    /**
+     *  Registration of this object on a peer-to-peer connection, see
+     *  RegisterPeerObject()
+     */
+    struct PeerRegistration
+    {
+        DBusObject *object;
+        std::string sender;
+        GDBusConnection *conn;
+        guint object_id;
+    };
+    std::vector<std::unique_ptr<PeerRegistration>> peer_registrations;
+    std::unordered_map<GQuark, DBusMethodStats::Histogram *> stats_cache[3];
 
     /**
-     *  Callback loook-up table for D-Bus
+     *  Low priority method call waiting in the queue, see
+     *  SetLowPriorityMethod().  The queue owns the invocation until
+     *  the call is dispatched.
      */
-    GDBusInterfaceVTable dbusobj_interface_vtable = {
-        dbusobject_callback_method_call,
-        dbusobject_callback_get_property,
-        dbusobject_callback_set_property
+    struct DeferredCall
+    {
+        std::string sender;
+        GDBusMethodInvocation *invoc;
     };
+    std::unordered_set<GQuark> low_priority_methods;
+    std::deque<DeferredCall> deferred_calls;
+    guint deferred_source = 0;
+
+
+    void defer_method_call(const gchar *sender, GDBusMethodInvocation *invoc)
+    {
+        deferred_calls.push_back({(sender ? sender : ""), invoc});
+        if (0 == deferred_source)
+        {
+            deferred_source = g_idle_add_full(G_PRIORITY_LOW,
+                                              dispatch_deferred_call,
+                                              this, nullptr);
+        }
+    }
+
+
+    /**
+     *  Handles one queued low priority call per main loop iteration,
+     *  so calls with a higher priority arriving meanwhile go first.
+     *  The method handler may delete the object, so it is not
+     *  accessed after the call has been dispatched.
+     */
+    static gboolean dispatch_deferred_call(gpointer this_ptr)
+    {
+        DBusObject *obj = static_cast<DBusObject *>(this_ptr);
+        DeferredCall call = std::move(obj->deferred_calls.front());
+        obj->deferred_calls.pop_front();
+        bool more = !obj->deferred_calls.empty();
+        if (!more)
+        {
+            obj->deferred_source = 0;
+        }
+
+        GDBusMethodInvocation *invoc = call.invoc;
+        dispatch_method_call(obj,
+                             g_dbus_method_invocation_get_connection(invoc),
+                             call.sender.c_str(),
+                             g_dbus_method_invocation_get_object_path(invoc),
+                             g_dbus_method_invocation_get_interface_name(invoc),
+                             g_dbus_method_invocation_get_method_name(invoc),
+                             g_dbus_method_invocation_get_parameters(invoc),
+                             invoc);
+        return (more ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE);
+    }
+
+
+    void cancel_deferred_calls()
+    {
+        if (deferred_source > 0)
+        {
+            g_source_remove(deferred_source);
+            deferred_source = 0;
+        }
+        for (auto& call : deferred_calls)
+        {
+            g_dbus_method_invocation_return_error(call.invoc, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_UNKNOWN_OBJECT,
+                                                  "Object was removed");
+        }
+        deferred_calls.clear();
+    }
+
+
+    /**
+     *  Retrieve the latency histogram for a method or property of this
+     *  object.  The histograms are cached per object, so the process
+     *  wide DBusMethodStats lock is only taken on the first request.
+     */
+    DBusMethodStats::Histogram * get_stats(const DBusMethodStats::Kind kind,
+                                           const gchar *intf_name,
+                                           const gchar *member)
+    {
+        auto& cache = stats_cache[static_cast<unsigned int>(kind)];
+        GQuark q = g_quark_from_string(member);
+        auto h = cache.find(q);
+        if (cache.end() != h)
+        {
+            return h->second;
+        }
+        DBusMethodStats::Histogram *hist = DBusMethodStats::Instance().Get(intf_name, kind, member);
+        cache[q] = hist;
+        return hist;
+    }
+
+    void remove_peer_registrations()
+    {
+        for (const auto& reg : peer_registrations)
+        {
+            g_dbus_connection_unregister_object(reg->conn, reg->object_id);
+            g_object_unref(reg->conn);
+        }
+        peer_registrations.clear();
+    }
+
+
+    /**
+     *  Callback loook-up table for D-Bus, shared by all objects
+     */
+    static const GDBusInterfaceVTable * interface_vtable()
+    {
+        static const GDBusInterfaceVTable vtable = {
+            dbusobject_callback_method_call,
+            dbusobject_callback_get_property,
+            dbusobject_callback_set_property,
+            {}
+        };
+        return &vtable;
+    }
+
+
+    /**
+     *  Callback look-up table used with EnableAsyncPropertySet().  Without
+     *  a set_property callback, GDBus validates D-Bus Set calls and
+     *  passes them on as org.freedesktop.DBus.Properties method calls.
+     */
+    static const GDBusInterfaceVTable * async_set_interface_vtable()
+    {
+        static const GDBusInterfaceVTable vtable = {
+            dbusobject_callback_method_call,
+            dbusobject_callback_get_property,
+            nullptr,
+            {}
+        };
+        return &vtable;
+    }
 
 
     static void dbusobject_callback_method_call(GDBusConnection *conn,
@@ -537,6 +1123,94 @@ private:
                                                  gpointer this_ptr)
     {
         class DBusObject *obj = (class DBusObject *) this_ptr;
+        obj->IdleCheck_UpdateTimestamp();
+
+        // Property changes are not throttled, like with the
+        // set_property callback
+        if (obj->async_set_property
+            && 0 == g_strcmp0(intf_name, "org.freedesktop.DBus.Properties")
+            && 0 == g_strcmp0(meth_name, "Set"))
+        {
+            dispatch_set_property(obj, conn, sender, obj_path, params, invoc);
+            return;
+        }
+
+        if (!admit_method_call(obj, sender, invoc))
+        {
+            return;
+        }
+
+        if (!obj->low_priority_methods.empty()
+            && obj->low_priority_methods.count(g_quark_try_string(meth_name)) > 0)
+        {
+            obj->defer_method_call(sender, invoc);
+            return;
+        }
+        dispatch_method_call(obj, conn, sender, obj_path, intf_name,
+                             meth_name, params, invoc);
+    }
+
+
+    static void dispatch_set_property(DBusObject *obj,
+                                      GDBusConnection *conn,
+                                      const gchar *sender,
+                                      const gchar *obj_path,
+                                      GVariant *params,
+                                      GDBusMethodInvocation *invoc)
+    {
+        const gchar *intf_name = nullptr;
+        const gchar *property_name = nullptr;
+        GVariant *value = nullptr;
+        g_variant_get(params, "(&s&sv)", &intf_name, &property_name, &value);
+
+        DBusMethodStats::Timer timer(obj->get_stats(DBusMethodStats::Kind::SET_PROPERTY,
+                                                    intf_name, property_name));
+        try
+        {
+            obj->callback_set_property_async(conn,
+                                             std::string(sender ? sender : ""),
+                                             std::string(obj_path),
+                                             std::string(intf_name),
+                                             std::string(property_name),
+                                             value, invoc);
+        }
+        catch (DBusPropertyException& err)
+        {
+            err.SetDBusError(invoc);
+        }
+        g_variant_unref(value);
+    }
+
+
+    static void dispatch_method_call(DBusObject *obj,
+                                     GDBusConnection *conn,
+                                     const gchar *sender,
+                                     const gchar *obj_path,
+                                     const gchar *intf_name,
+                                     const gchar *meth_name,
+                                     GVariant *params,
+                                     GDBusMethodInvocation *invoc)
+    {
+        // Methods replying asynchronously are only measured until
+        // the handler returns.  The object may be deleted by the
+        // handler, the timer does not access it.
+        DBusMethodStats::Timer timer(obj->get_stats(DBusMethodStats::Kind::METHOD,
+                                                    intf_name, meth_name));
+
+        // Method names are interned when registered, so a method without
+        // a quark cannot have a registered handler
+        GQuark meth_quark = g_quark_try_string(meth_name);
+        if (0 != meth_quark)
+        {
+            auto handler = obj->method_handlers.find(meth_quark);
+            if (obj->method_handlers.end() != handler)
+            {
+                const MethodCall call{conn, sender, obj_path, intf_name,
+                                      meth_name, params, invoc};
+                handler->second(call);
+                return;
+            }
+        }
         obj->callback_method_call(conn,
                                   std::string(sender),
                                   std::string(obj_path),
@@ -546,6 +1220,69 @@ private:
     }
 
 
+    /**
+     *  Checks the method call against the DBusRequestThrottle limits of
+     *  the sender.  Rejected calls are replied to with the
+     *  org.freedesktop.DBus.Error.LimitsExceeded error.  For admitted
+     *  calls, the throttle is told when the call has been replied to,
+     *  which is when the GDBusMethodInvocation is released.
+     *
+     * @return Returns true if the method call may be handled
+     */
+    static bool admit_method_call(DBusObject *obj, const gchar *sender,
+                                  GDBusMethodInvocation *invoc)
+    {
+        if (!sender)
+        {
+            return true;
+        }
+
+        DBusRequestThrottle& throttle = DBusRequestThrottle::Instance();
+        auto res = throttle.Admit(sender, [obj, sender]()
+                                  {
+                                      return sender_privileged(obj->GetObjectConnection(),
+                                                               sender);
+                                  });
+        switch (res)
+        {
+        case DBusRequestThrottle::Result::ALLOWED:
+            g_object_weak_ref(G_OBJECT(invoc), method_call_done, g_strdup(sender));
+            return true;
+
+        case DBusRequestThrottle::Result::RATE_LIMITED:
+            g_dbus_method_invocation_return_error(invoc, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                                  "Too many requests, try again later");
+            return false;
+
+        case DBusRequestThrottle::Result::TOO_MANY_PENDING:
+            g_dbus_method_invocation_return_error(invoc, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                                  "Too many requests waiting for a reply");
+            return false;
+        }
+        return true;
+    }
+
+
+    static void method_call_done(gpointer sender, GObject *invoc)
+    {
+        DBusRequestThrottle::Instance().Done(static_cast<const char *>(sender));
+        g_free(sender);
+    }
+
+
+    /**
+     *  Root and the user the service runs as are not limited by the
+     *  DBusRequestThrottle.  This is only looked up once per sender; the
+     *  UID comes from the credentials cache of the connection.
+     */
+    static bool sender_privileged(GDBusConnection *conn, const gchar *sender)
+    {
+        return DBusConnectionCredsCache::IsPrivileged(conn, sender);
+    }
+
+
     static GVariant * dbusobject_callback_get_property(GDBusConnection *conn,
                                                        const gchar *sender,
                                                        const gchar *obj_path,
@@ -555,6 +1292,9 @@ private:
                                                        gpointer this_ptr)
     {
         class DBusObject *obj = (class DBusObject *) this_ptr;
+        obj->IdleCheck_UpdateTimestamp();
+        DBusMethodStats::Timer timer(obj->get_stats(DBusMethodStats::Kind::GET_PROPERTY,
+                                                    intf_name, property_name));
         return obj->_dbus_get_property_internal(conn,
                                                 std::string(sender),
                                                 std::string(obj_path),
@@ -574,10 +1314,79 @@ private:
                                                      gpointer this_ptr)
     {
         class DBusObject *obj = (class DBusObject *) this_ptr;
+        obj->IdleCheck_UpdateTimestamp();
+        DBusMethodStats::Timer timer(obj->get_stats(DBusMethodStats::Kind::SET_PROPERTY,
+                                                    intf_name, property_name));
         return obj->_dbus_set_property_internal(conn, sender,
                                                 obj_path, intf_name,
                                                 property_name, value,
                                                 error);
     }
+
+
+    /**
+     *  Callback look-up table for registrations on peer-to-peer
+     *  connections.  These callbacks replace the missing sender with
+     *  the bus name of the peer and pass the request on.
+     */
+    static const GDBusInterfaceVTable * peer_interface_vtable()
+    {
+        static const GDBusInterfaceVTable vtable = {
+            peer_callback_method_call,
+            peer_callback_get_property,
+            peer_callback_set_property,
+            {}
+        };
+        return &vtable;
+    }
+
+
+    static void peer_callback_method_call(GDBusConnection *conn,
+                                          const gchar *sender,
+                                          const gchar *obj_path,
+                                          const gchar *intf_name,
+                                          const gchar *meth_name,
+                                          GVariant *params,
+                                          GDBusMethodInvocation *invoc,
+                                          gpointer reg_ptr)
+    {
+        PeerRegistration *reg = static_cast<PeerRegistration *>(reg_ptr);
+        dbusobject_callback_method_call(conn, reg->sender.c_str(), obj_path,
+                                        intf_name, meth_name, params, invoc,
+                                        reg->object);
+    }
+
+
+    static GVariant * peer_callback_get_property(GDBusConnection *conn,
+                                                 const gchar *sender,
+                                                 const gchar *obj_path,
+                                                 const gchar *intf_name,
+                                                 const gchar *property_name,
+                                                 GError **error,
+                                                 gpointer reg_ptr)
+    {
+        PeerRegistration *reg = static_cast<PeerRegistration *>(reg_ptr);
+        return dbusobject_callback_get_property(conn, reg->sender.c_str(),
+                                                obj_path, intf_name,
+                                                property_name, error,
+                                                reg->object);
+    }
+
+
+    static gboolean peer_callback_set_property(GDBusConnection *conn,
+                                               const gchar *sender,
+                                               const gchar *obj_path,
+                                               const gchar *intf_name,
+                                               const gchar *property_name,
+                                               GVariant *value,
+                                               GError **error,
+                                               gpointer reg_ptr)
+    {
+        PeerRegistration *reg = static_cast<PeerRegistration *>(reg_ptr);
+        return dbusobject_callback_set_property(conn, reg->sender.c_str(),
+                                                obj_path, intf_name,
+                                                property_name, value, error,
+                                                reg->object);
+    }
 };
 
@@ -21,6 +21,25 @@
 #include <string>
 #include <uuid/uuid.h>
 
+#include "path.hpp"
+
+
+/**
+ *  Append a 64-bit value as 16 lower-case hexadecimal digits
+ */
+static void append_hex64(std::string& str, uint64_t val)
+{
+    static const char digits[] = "0123456789abcdef";
+    char buf[16];
+    for (int i = 15; i >= 0; --i)
+    {
+        buf[i] = digits[val & 0xf];
+        val >>= 4;
+    }
+    str.append(buf, sizeof(buf));
+}
+
+
 std::string generate_path_uuid(std::string prefix, char delim)
 {
     uuid_t uuid;
@@ -32,3 +51,36 @@ std::string generate_path_uuid(std::string prefix, char delim)
 
     return (prefix == "" ? ret : prefix + "/" + ret);
 }
+
+
+ObjectPathAllocator::ObjectPathAllocator(const std::string& prefix,
+                                         const char delim)
+{
+    // The random part of a UUID is used as the instance tag
+    uuid_t uuid;
+    uuid_generate_random(uuid);
+    uint64_t tag = 0;
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        tag = (tag << 8) | uuid[i];
+    }
+
+    base.reserve(prefix.size() + 34);
+    if (!prefix.empty())
+    {
+        base = prefix + "/";
+    }
+    append_hex64(base, tag);
+    base.push_back(delim);
+}
+
+
+ObjectPathAllocator::ObjectPath ObjectPathAllocator::Allocate()
+{
+    ObjectPath ret;
+    ret.id = ++next_id;
+    ret.path.reserve(base.size() + 16);
+    ret.path = base;
+    append_hex64(ret.path, ret.id);
+    return ret;
+}
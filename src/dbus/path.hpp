@@ -19,6 +19,62 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 
 std::string generate_path_uuid(std::string prefix, char delim);
+
+
+/**
+ *  Allocates unique D-Bus object paths below a common prefix, without
+ *  generating a new UUID for each object.
+ *
+ *  Each allocator picks a random 64-bit instance tag when created.  The
+ *  object paths are built from this tag and a 64-bit sequence number, as
+ *  "${prefix}/${tag}${delim}${id}" with both numbers in hexadecimal.  The
+ *  instance tag ensures paths are not reused if the service is restarted.
+ *
+ *  The object paths are only unique; unlike generate_path_uuid() they are
+ *  predictable within a process.  Access control must never depend on the
+ *  object path being unknown to the caller.
+ */
+class ObjectPathAllocator
+{
+public:
+    /**
+     *  An allocated object path with the sequence number it was built from
+     */
+    struct ObjectPath
+    {
+        uint64_t id;
+        std::string path;
+    };
+
+
+    /**
+     * @param prefix  std::string with the D-Bus path the paths are
+     *                allocated below
+     * @param delim   char separating the instance tag and the sequence
+     *                number
+     */
+    ObjectPathAllocator(const std::string& prefix, const char delim);
+
+    ObjectPathAllocator(const ObjectPathAllocator&) = delete;
+    ObjectPathAllocator& operator=(const ObjectPathAllocator&) = delete;
+
+
+    /**
+     *  Allocate a new object path.  This method is thread-safe.
+     *
+     * @return Returns an ObjectPath with the sequence number and the
+     *         complete D-Bus object path
+     */
+    ObjectPath Allocate();
+
+
+private:
+    /// prefix, instance tag and delimiter; the leading part of all paths
+    std::string base;
+    std::atomic<uint64_t> next_id{0};
+};
@@ -0,0 +1,228 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   peer-link.hpp
+ *
+ * @brief  Private peer-to-peer D-Bus connections between two processes,
+ *         bypassing the D-Bus daemon
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <gio/gio.h>
+
+#include "dbus/exceptions.hpp"
+
+
+/**
+ *  A D-Bus connection over one end of a socket pair.  The other end is
+ *  passed to the peer process in a D-Bus method call on the system bus.
+ *  Only the two processes holding the socket pair can use the
+ *  connection, so the access control is done by the method call
+ *  handing over the socket.
+ *
+ *  There is no bus daemon on such a connection: messages carry no
+ *  sender, bus names cannot be used and signals are only delivered to
+ *  the peer.
+ */
+class DBusPeerLink
+{
+public:
+    using Ptr = std::shared_ptr<DBusPeerLink>;
+
+    /**
+     *  Called when a connection accepted by Accept() is ready or has
+     *  failed.  On failures, the link is empty and the error message set.
+     */
+    using AcceptCallback = std::function<void(Ptr link, const std::string& error)>;
+
+
+    ~DBusPeerLink()
+    {
+        g_dbus_connection_close(conn, nullptr, nullptr, nullptr);
+        g_object_unref(conn);
+    }
+
+
+    /**
+     *  Creates a connected socket pair.  Throws DBusException on errors.
+     *
+     * @param local   int receiving the file descriptor to keep
+     * @param remote  int receiving the file descriptor to pass to the
+     *                peer process
+     */
+    static void SocketPair(int& local, int& remote)
+    {
+        int sv[2] = {-1, -1};
+        if (0 != socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv))
+        {
+            THROW_DBUSEXCEPTION("DBusPeerLink",
+                                std::string("Could not create socket pair: ")
+                                + strerror(errno));
+        }
+        local = sv[0];
+        remote = sv[1];
+    }
+
+
+    /**
+     *  Sets up the client side of the connection.  This blocks until
+     *  the peer has accepted the connection with Accept().  Throws
+     *  DBusException on errors.
+     *
+     * @param fd  File descriptor of the socket.  This object takes the
+     *            ownership of it, also on errors.
+     *
+     * @return Returns a DBusPeerLink::Ptr to the established link
+     */
+    static Ptr Connect(const int fd)
+    {
+        GIOStream *stream = new_stream(fd);
+        GError *err = nullptr;
+        GDBusConnection *c = g_dbus_connection_new_sync(stream, nullptr,
+                                                        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                        nullptr, nullptr, &err);
+        g_object_unref(stream);
+        if (!c)
+        {
+            std::string msg(err ? err->message : "(unknown)");
+            if (err)
+            {
+                g_error_free(err);
+            }
+            THROW_DBUSEXCEPTION("DBusPeerLink",
+                                "Could not connect to peer: " + msg);
+        }
+        return Ptr(new DBusPeerLink(c));
+    }
+
+
+    /**
+     *  Sets up the server side of the connection.  The authentication
+     *  runs in the background; the callback is called from the main
+     *  loop once it has completed.  Throws DBusException if the socket
+     *  cannot be used.
+     *
+     * @param fd        File descriptor of the socket.  This object takes
+     *                  the ownership of it, also on errors.
+     * @param callback  AcceptCallback to call when done
+     */
+    static void Accept(const int fd, AcceptCallback callback)
+    {
+        GIOStream *stream = new_stream(fd);
+        gchar *guid = g_dbus_generate_guid();
+        g_dbus_connection_new(stream, guid,
+                              G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_SERVER,
+                              nullptr, nullptr, accept_done,
+                              new AcceptCallback(std::move(callback)));
+        g_free(guid);
+        g_object_unref(stream);
+    }
+
+
+    /**
+     * @return Returns the GDBusConnection of this link
+     */
+    GDBusConnection * GetConnection() const noexcept
+    {
+        return conn;
+    }
+
+
+    /**
+     * @return Returns true until the link has been closed, usually
+     *         because the peer has gone away
+     */
+    bool IsOpen() const noexcept
+    {
+        return !g_dbus_connection_is_closed(conn);
+    }
+
+
+private:
+    GDBusConnection *conn = nullptr;
+
+    DBusPeerLink(GDBusConnection *c)
+        : conn(c)
+    {
+    }
+
+
+    static GIOStream * new_stream(const int fd)
+    {
+        GError *err = nullptr;
+        GSocket *sock = g_socket_new_from_fd(fd, &err);
+        if (!sock)
+        {
+            close(fd);
+            std::string msg(err ? err->message : "(unknown)");
+            if (err)
+            {
+                g_error_free(err);
+            }
+            THROW_DBUSEXCEPTION("DBusPeerLink", "Invalid socket: " + msg);
+        }
+        GSocketConnection *sc = g_socket_connection_factory_create_connection(sock);
+        g_object_unref(sock);
+        return G_IO_STREAM(sc);
+    }
+
+
+    static void accept_done(GObject *source, GAsyncResult *res, gpointer cb_ptr)
+    {
+        std::unique_ptr<AcceptCallback> cb(static_cast<AcceptCallback *>(cb_ptr));
+
+        GError *err = nullptr;
+        GDBusConnection *c = g_dbus_connection_new_finish(res, &err);
+        Ptr link;
+        std::string msg;
+        if (c)
+        {
+            link.reset(new DBusPeerLink(c));
+        }
+        else
+        {
+            msg = (err ? err->message : "(unknown)");
+            if (err)
+            {
+                g_error_free(err);
+            }
+        }
+
+        try
+        {
+            (*cb)(link, msg);
+        }
+        catch (const std::exception& excp)
+        {
+            std::cerr << "** ERROR ** DBusPeerLink accept callback failed: "
+                      << excp.what() << std::endl;
+        }
+    }
+};
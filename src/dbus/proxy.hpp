@@ -20,7 +20,11 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 #include <gio/gunixfdlist.h>
 
 #ifdef HAVE_TINYXML
@@ -33,6 +37,7 @@ typedef std::shared_ptr<openvpn::Xml::Document> XmlDocPtr;
 
 
 #include "dbus/connection.hpp"
+#include "dbus/readiness.hpp"
 #include "glibutils.hpp"
 
 /// Default timeout for D-Bus calls.  Setting this to -1 uses the default
@@ -70,6 +75,290 @@ private:
 };
 
 
+/**
+ *  Translates a GError from a failed D-Bus method call into the
+ *  exception the DBusProxy callers expect.  Access denied errors are
+ *  thrown as DBusProxyAccessDeniedException, everything else as a
+ *  DBusException.  This function takes ownership of the GError object.
+ *
+ * @param method  std::string with the method name used in error messages
+ * @param error   GError pointer of the failed call, may be nullptr
+ */
+inline void dbusproxy_throw_call_error(const std::string& method,
+                                       GError *error)
+{
+    if (!error)
+    {
+        THROW_DBUSEXCEPTION("DBusProxy", "Unspecified error");
+    }
+
+    std::string dbuserr(error->message);
+    if ((dbuserr.find("GDBus.Error:org.freedesktop.DBus.Error.AccessDenied:") != std::string::npos)
+        || (dbuserr.find("GDBus.Error:net.openvpn.v3.error.acl.denied:") != std::string::npos))
+    {
+        g_error_free(error);
+        throw DBusProxyAccessDeniedException(method, dbuserr);
+    }
+
+    g_dbus_error_strip_remote_error(error);
+    std::stringstream errmsg;
+    errmsg << "Failed calling D-Bus method " << method << ": "
+           << error->message;
+    g_error_free(error);
+    THROW_DBUSEXCEPTION("DBusProxy", errmsg.str());
+}
+
+
+
+/**
+ *  Handle for an on-going asynchronous D-Bus method call, started by
+ *  DBusProxy::CallAsync(), DBusProxy::GetPropertyAsync() or
+ *  DBusProxyAsyncCall::Start().
+ *
+ *  The call is sent to the D-Bus daemon when the handle is created, which
+ *  allows a caller to start many calls before waiting for any of the
+ *  results.  The response is delivered via the thread-default GLib main
+ *  context active when the call was started.  If no main loop is running
+ *  in that context, Wait() and GetResult() will iterate it until the
+ *  response has arrived.
+ */
+class DBusProxyAsyncCall
+{
+public:
+    typedef std::shared_ptr<DBusProxyAsyncCall> Ptr;
+
+    /**
+     *  Callback function type called when the response has arrived.
+     *  It is called from the main context the call was started in.
+     */
+    typedef std::function<void(DBusProxyAsyncCall& call)> Callback;
+
+
+    ~DBusProxyAsyncCall()
+    {
+        if (result)
+        {
+            g_variant_unref(result);
+        }
+        if (error)
+        {
+            g_error_free(error);
+        }
+        if (context)
+        {
+            g_main_context_unref(context);
+        }
+    }
+
+
+    /**
+     *  Retrieve the D-Bus method this call is for.  For property
+     *  lookups, this is the property name.
+     *
+     * @return std::string with the method or property name
+     */
+    const std::string& GetMethod() const noexcept
+    {
+        return method;
+    }
+
+
+    /**
+     *  Starts a D-Bus method call directly on a connection, without a
+     *  DBusProxy.  This avoids the cost of setting up proxies when many
+     *  objects of a service are called only a few times each.
+     *
+     * @param conn         GDBusConnection to send the call on
+     * @param destination  std::string with the bus name of the service
+     * @param path         std::string with the object path to call
+     * @param interf       std::string with the interface of the method
+     * @param meth         std::string with the method name
+     * @param params       GVariant with the method arguments, may be
+     *                     nullptr
+     * @param callback     (optional) Callback called when the response
+     *                     has arrived
+     *
+     * @return Returns a DBusProxyAsyncCall::Ptr handle for the call
+     */
+    static Ptr Start(GDBusConnection *conn,
+                     const std::string& destination,
+                     const std::string& path,
+                     const std::string& interf,
+                     const std::string& meth,
+                     GVariant *params,
+                     Callback callback = nullptr)
+    {
+        Ptr call = create(meth, false, callback);
+        g_dbus_connection_call(conn, destination.c_str(), path.c_str(),
+                               interf.c_str(), meth.c_str(), params,
+                               nullptr,     // GVariantType of the reply
+                               G_DBUS_CALL_FLAGS_NONE,
+                               DBUS_PROXY_CALL_TIMEOUT,
+                               nullptr,     // GCancellable
+                               completion_handler,
+                               new Ptr(call));
+        return call;
+    }
+
+
+    /**
+     *  Check if a response has been received, without blocking
+     *
+     * @return Returns true if the D-Bus call has completed, regardless of
+     *         the result.
+     */
+    bool Completed()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return done;
+    }
+
+
+    /**
+     *  Wait until the response for this call has been received.  If the
+     *  main context used by this call is not owned by another thread, it
+     *  will be iterated here until the response arrives.
+     */
+    void Wait()
+    {
+        if (g_main_context_acquire(context))
+        {
+            while (!Completed())
+            {
+                g_main_context_iteration(context, TRUE);
+            }
+            g_main_context_release(context);
+            return;
+        }
+
+        // Another thread runs the main loop for this context; the
+        // response will be dispatched there.
+        std::unique_lock<std::mutex> lock(mtx);
+        done_cv.wait(lock, [this]{ return done; });
+    }
+
+
+    /**
+     *  Retrieve the result of the D-Bus call.  This will wait for the
+     *  call to complete if needed.  On failures, the same exceptions as
+     *  DBusProxy::Call() and DBusProxy::GetProperty() throw are thrown.
+     *
+     * @return Returns a GVariant object with the response, which the
+     *         caller must g_variant_unref() when done.  This can only be
+     *         retrieved once.
+     */
+    GVariant* GetResult()
+    {
+        Wait();
+        if (!result)
+        {
+            GError *err = error;
+            error = nullptr;
+            dbusproxy_throw_call_error(method, err);
+        }
+
+        GVariant *ret = result;
+        result = nullptr;
+        if (property_get)
+        {
+            GVariant *chld = g_variant_get_child_value(ret, 0);
+            GVariant *val = g_variant_get_variant(chld);
+            g_variant_unref(chld);
+            g_variant_unref(ret);
+            ret = val;
+        }
+        return ret;
+    }
+
+
+private:
+    friend class DBusProxy;
+
+    std::string method;
+    bool property_get;
+    Callback callback;
+    GMainContext *context = nullptr;
+    GVariant *result = nullptr;
+    GError *error = nullptr;
+    bool done = false;
+    std::mutex mtx;
+    std::condition_variable done_cv;
+
+
+    DBusProxyAsyncCall(const std::string& meth, bool propget, Callback cb)
+        : method(meth),
+          property_get(propget),
+          callback(cb),
+          context(g_main_context_ref_thread_default())
+    {
+    }
+
+
+    static Ptr create(const std::string& meth, bool propget, Callback cb)
+    {
+        return Ptr(new DBusProxyAsyncCall(meth, propget, cb));
+    }
+
+
+    /**
+     *  Starts the D-Bus call.  The handle is kept alive until the
+     *  completion callback has been called by GLib.
+     */
+    void start(GDBusProxy *prx, const char *meth, GVariant *params,
+               GDBusCallFlags flags, const Ptr& self)
+    {
+        g_dbus_proxy_call(prx, meth, params, flags,
+                          DBUS_PROXY_CALL_TIMEOUT,
+                          nullptr,     // GCancellable
+                          completion_handler,
+                          new Ptr(self));
+    }
+
+
+    static void completion_handler(GObject *source, GAsyncResult *res,
+                                   gpointer user_data)
+    {
+        Ptr *self = static_cast<Ptr *>(user_data);
+        DBusProxyAsyncCall *call = self->get();
+
+        GError *err = nullptr;
+        GVariant *ret = nullptr;
+        if (G_IS_DBUS_PROXY(source))
+        {
+            ret = g_dbus_proxy_call_finish(G_DBUS_PROXY(source), res, &err);
+        }
+        else
+        {
+            ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                res, &err);
+        }
+        {
+            std::lock_guard<std::mutex> guard(call->mtx);
+            call->result = ret;
+            call->error = err;
+            call->done = true;
+        }
+        call->done_cv.notify_all();
+
+        if (call->callback)
+        {
+            try
+            {
+                call->callback(*call);
+            }
+            catch (const std::exception& excp)
+            {
+                std::cerr << "** ERROR ** DBusProxyAsyncCall callback for '"
+                          << call->method << "' failed: " << excp.what()
+                          << std::endl;
+            }
+        }
+        delete self;
+    }
+};
+
+
+
 class DBusProxy : public DBus
 {
 public:
@@ -213,6 +502,8 @@ public:
 
     virtual ~DBusProxy()
     {
+        disable_property_cache();
+
         // If this object is using an existing connection;
         // don't trigger a disconnect.  This variable is
         // defined and set in the DBus class.
@@ -277,23 +568,46 @@ public:
     /**
      *  Some service expose a 'version' property in the main manager
      *  object.  This retrieves this but has a retry logic in case the
-     *  service did not start up quickly enough.
+     *  service did not start up quickly enough.  While the service has
+     *  not acquired its bus name, it waits for the NameOwnerChanged
+     *  signal instead of a fixed delay.
+     *
+     *  The version is only retrieved once per D-Bus connection and
+     *  service; it is cached until the owner of the bus name changes.
+     *  Since the NameOwnerChanged signal is only processed when the
+     *  main context of the calling thread is iterated, programs not
+     *  running a main loop keep the version for their whole lifetime.
      *
      * @return  Returns a string containing the version of the service
      *
      */
     std::string GetServiceVersion()
     {
+        ServiceCache& cache = service_cache();
+        {
+            std::lock_guard<std::mutex> guard(cache.mtx);
+            ServiceState& state = service_state(cache);
+            if (state.version_known)
+            {
+                return state.version;
+            }
+        }
+
+        DBusNameOwnerWaiter service_ready(GetConnection(), bus_name);
         int delay = 1;
         for (int attempts = 10; attempts > 0; --attempts)
         {
             try
             {
-                return GetStringProperty("version");
+                std::string version = GetStringProperty("version");
+                cache_service_version(version);
+                return version;
             }
             catch(DBusProxyAccessDeniedException& excp)
             {
-                return std::string(""); // Consider this an unknown version
+                // Consider this an unknown version
+                cache_service_version("");
+                return std::string("");
             }
             catch (DBusException& excp)
             {
@@ -302,10 +616,22 @@ public:
                 {
                     if ((err.find(": No such property 'version'") != std::string::npos))
                     {
-                        return std::string("");  // Consider this as an unknown version but not an error
+                        // Consider this as an unknown version but not an error
+                        cache_service_version("");
+                        return std::string("");
                     }
                 }
-                sleep(delay);
+                if (!service_ready.NameHasOwner())
+                {
+                    // Wakes up as soon as the service is on the bus
+                    (void) service_ready.Wait(delay * 1000);
+                }
+                else
+                {
+                    // The service is on the bus but has not yet
+                    // registered its objects; it should not take long
+                    usleep(delay * 50000);
+                }
                 ++delay;
             }
             catch (...)
@@ -324,10 +650,22 @@ public:
      *  the service bus name is registered.  If not, try to start the
      *  service.
      *
+     *  Once the service has been found, it is not checked again over
+     *  the same D-Bus connection until the owner of the bus name changes.
+     *
      *  Throws DBusException in case of errors.
      */
     void CheckServiceAvail()
     {
+        ServiceCache& cache = service_cache();
+        {
+            std::lock_guard<std::mutex> guard(cache.mtx);
+            if (service_state(cache).available)
+            {
+                return;
+            }
+        }
+
         GDBusProxy *proxy = SetupProxy("org.freedesktop.DBus",
                                        "org.freedesktop.DBus",
                                            "/");
@@ -353,6 +691,7 @@ public:
                     {
                         // When getting a clear evidence the service
                         // is already running, no need to bother more
+                        cache_service_avail();
                         return;
                     }
 
@@ -363,6 +702,7 @@ public:
                     //         with CheckObjectExists()?  Using Ping()
                     //         now for the initial testing
                     Ping();
+                    cache_service_avail();
                     return;
                 }
             }
@@ -417,13 +757,19 @@ public:
                 // Objects will normally have the
                 // org.freedesktop.DBus.Properties.GetAll() method available,
                 // so if this fails we presume the object does not exist.
-                GVariant *empty = dbus_proxy_call(property_proxy,
-                                                  "GetAll",
-                                                  g_variant_new("(s)", interface.c_str()),
-                                                  false, call_flags);
-                if (empty)
+                GVariant *all = dbus_proxy_call(property_proxy,
+                                                "GetAll",
+                                                g_variant_new("(s)", interface.c_str()),
+                                                false, call_flags);
+                if (all)
                 {
-                    g_variant_unref(empty);
+                    // The response is already here, so make use of it
+                    // if the property cache is enabled
+                    if (property_cache_enabled)
+                    {
+                        update_property_cache(all);
+                    }
+                    g_variant_unref(all);
                 }
                 return true;
             }
@@ -563,12 +909,87 @@ public:
                                call_flags);
     }
 
+    /**
+     *  Starts a D-Bus method call without waiting for the response.
+     *  This makes it possible to issue several calls before collecting
+     *  the results, which avoids paying a full round trip per call.
+     *
+     * @param method    std::string with the D-Bus method to call
+     * @param params    GVariant object with the method arguments, may
+     *                  be nullptr
+     * @param callback  (optional) DBusProxyAsyncCall::Callback called
+     *                  when the response has arrived.
+     *
+     * @return Returns a DBusProxyAsyncCall::Ptr handle for the call
+     */
+    DBusProxyAsyncCall::Ptr CallAsync(const std::string& method,
+                                      GVariant *params = nullptr,
+                                      DBusProxyAsyncCall::Callback callback = nullptr) const
+    {
+        if (method.empty())
+        {
+            THROW_DBUSEXCEPTION("DBusProxy", "Method cannot be empty");
+        }
+
+        // Ensure we still have a valid connection
+        (void) GetConnection();
+
+        auto call = DBusProxyAsyncCall::create(method, false, callback);
+        call->start(proxy, method.c_str(), params, call_flags, call);
+        return call;
+    }
+
+
+    /**
+     *  Asynchronous variant of GetProperty().  The result retrieved via
+     *  DBusProxyAsyncCall::GetResult() is the unwrapped property value.
+     *
+     * @param property  std::string with the property name to retrieve
+     * @param callback  (optional) DBusProxyAsyncCall::Callback called
+     *                  when the response has arrived.
+     *
+     * @return Returns a DBusProxyAsyncCall::Ptr handle for the call
+     */
+    DBusProxyAsyncCall::Ptr GetPropertyAsync(const std::string& property,
+                                             DBusProxyAsyncCall::Callback callback = nullptr) const
+    {
+        if (!property_proxy)
+        {
+            THROW_DBUSEXCEPTION("DBusProxy", "Property proxy incorrectly setup");
+        }
+        if (property.empty())
+        {
+            THROW_DBUSEXCEPTION("DBusProxy", "Property cannot be empty");
+        }
+
+        (void) GetConnection();
+
+        auto call = DBusProxyAsyncCall::create(property, true, callback);
+        call->start(property_proxy, "Get",
+                    g_variant_new("(ss)", interface.c_str(), property.c_str()),
+                    G_DBUS_CALL_FLAGS_NONE, call);
+        return call;
+    }
+
+
     GVariant * CallGetFD(std::string method, int& fd, bool noresponse = false) const
     {
         return dbus_proxy_call(proxy, method, NULL, noresponse,
                                call_flags, &fd);
     }
 
+
+    /**
+     * Variant of CallGetFD() for methods taking arguments.  The fd
+     * returned by the method is received as auxiliary data.
+     */
+    GVariant * CallGetFD(std::string method, GVariant *params, int& fd,
+                         bool noresponse = false) const
+    {
+        return dbus_proxy_call(proxy, method, params, noresponse,
+                               call_flags, &fd);
+    }
+
     /**
      * Will send an additional fd in addition to the normal function call.
      * This method will *not* take ownership of the fd. The caller needs
@@ -581,6 +1002,105 @@ public:
     }
 
 
+    /**
+     *  Enables a local cache of property values for this proxy.  When
+     *  enabled, GetProperty() and the typed Get*Property() methods will
+     *  first look for the value in the cache, which is populated by
+     *  GetAllProperties() and CheckObjectExists() as well as by
+     *  individual property lookups.
+     *
+     *  Cached values are updated or removed when the service sends a
+     *  org.freedesktop.DBus.Properties.PropertiesChanged signal for the
+     *  object.  This signal is only processed when the main context of
+     *  the calling thread is iterated.  Services do not necessarily send
+     *  this signal for every property which changes, so the cache should
+     *  only be used where short-lived values are acceptable, like when
+     *  collecting details for a single listing.
+     *
+     * @param enable  Boolean flag enabling or disabling the cache
+     */
+    void EnablePropertyCache(bool enable = true)
+    {
+        if (!enable)
+        {
+            disable_property_cache();
+            return;
+        }
+        if (property_cache_enabled)
+        {
+            return;
+        }
+
+        if (!property_proxy)
+        {
+            THROW_DBUSEXCEPTION("DBusProxy", "Property proxy incorrectly setup");
+        }
+        property_cache_subscr = g_dbus_connection_signal_subscribe(
+                                      GetConnection(),
+                                      g_dbus_proxy_get_name(property_proxy),
+                                      "org.freedesktop.DBus.Properties",
+                                      "PropertiesChanged",
+                                      g_dbus_proxy_get_object_path(property_proxy),
+                                      interface.c_str(),
+                                      G_DBUS_SIGNAL_FLAGS_NONE,
+                                      property_cache_changed_cb,
+                                      this,
+                                      nullptr);
+        property_cache_enabled = true;
+    }
+
+
+    /**
+     *  Removes all values from the property cache.  The next lookup of
+     *  each property will be sent to the service.
+     */
+    void InvalidatePropertyCache() const
+    {
+        std::lock_guard<std::mutex> guard(property_cache_mtx);
+        for (auto& v : property_cache)
+        {
+            g_variant_unref(v.second);
+        }
+        property_cache.clear();
+    }
+
+
+    /**
+     *  Retrieve all the properties of the proxied interface in a single
+     *  org.freedesktop.DBus.Properties.GetAll() call.  If the property
+     *  cache is enabled, it will be updated with the result.
+     *
+     *  Properties the caller does not have access to, or which the
+     *  service cannot provide currently, will not be present.
+     *
+     * @return Returns a GVariant dictionary (a{sv}) with all properties.
+     *         The caller must g_variant_unref() this object.
+     */
+    GVariant * GetAllProperties() const
+    {
+        if (!property_proxy)
+        {
+            THROW_DBUSEXCEPTION("DBusProxy", "Property proxy incorrectly setup");
+        }
+
+        GVariant *res = dbus_proxy_call(property_proxy, "GetAll",
+                                        g_variant_new("(s)", interface.c_str()),
+                                        false, call_flags);
+        if (!res)
+        {
+            THROW_DBUSEXCEPTION("DBusProxy",
+                                "Failed retrieving all property values");
+        }
+        if (property_cache_enabled)
+        {
+            update_property_cache(res);
+        }
+        GVariant *ret = g_variant_get_child_value(res, 0);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
     GVariant * GetProperty(std::string property) const
     {
         if (!property_proxy)
@@ -592,9 +1112,19 @@ public:
             THROW_DBUSEXCEPTION("DBusProxy", "Property cannot be empty");
         }
 
+        if (property_cache_enabled)
+        {
+            std::lock_guard<std::mutex> guard(property_cache_mtx);
+            auto cached = property_cache.find(property);
+            if (property_cache.end() != cached)
+            {
+                return g_variant_ref(cached->second);
+            }
+        }
+
         // Use the org.freedesktop.DBus.Properties.Get() method directly
-        // instead of going via a list of cached properties.  The cache
-        // might not be updated and we get the wrong values.
+        // instead of going via the GDBusProxy list of cached properties.
+        // That cache might not be updated and we get the wrong values.
 
         GError *error = NULL;
         GVariant *response = g_dbus_proxy_call_sync(property_proxy,
@@ -632,6 +1162,17 @@ public:
         GVariant* ret = g_variant_get_variant(chld);
         g_variant_unref(chld);
         g_variant_unref(response);
+
+        if (property_cache_enabled)
+        {
+            std::lock_guard<std::mutex> guard(property_cache_mtx);
+            auto& slot = property_cache[property];
+            if (slot)
+            {
+                g_variant_unref(slot);
+            }
+            slot = g_variant_ref(ret);
+        }
         return ret;
     }
 
@@ -739,16 +1280,49 @@ public:
     }
 
 
+    /**
+     *  Asynchronous variant of SetProperty().  Calls made on the same
+     *  DBusProxy are delivered to the service in the order they were
+     *  started, so a method call started right after this one will see
+     *  the new property value.
+     *
+     * @param property  std::string with the property name to modify
+     * @param value     GVariant object with the new value
+     * @param callback  (optional) DBusProxyAsyncCall::Callback called
+     *                  when the response has arrived.
+     *
+     * @return Returns a DBusProxyAsyncCall::Ptr handle for the call
+     */
+    DBusProxyAsyncCall::Ptr SetPropertyAsync(const std::string& property,
+                                             GVariant *value,
+                                             DBusProxyAsyncCall::Callback callback = nullptr) const
+    {
+        if (!property_proxy)
+        {
+            THROW_DBUSEXCEPTION("DBusProxy", "Property proxy incorrectly setup");
+        }
+        if (property.empty())
+        {
+            THROW_DBUSEXCEPTION("DBusProxy", "Property cannot be empty");
+        }
+
+        (void) GetConnection();
+
+        auto call = DBusProxyAsyncCall::create(property, false, callback);
+        call->start(property_proxy, "Set",
+                    g_variant_new("(ssv)", interface.c_str(),
+                                  property.c_str(), value),
+                    G_DBUS_CALL_FLAGS_NONE, call);
+        return call;
+    }
+
+
 protected:
     GDBusProxy *proxy;
     GDBusProxy *property_proxy;
 
     GDBusProxy * SetupProxy(std::string busn, std::string intf, std::string objp)
     {
-        if (busn.empty()) {
-            THROW_DBUSEXCEPTION("DBusProxy", "Bus name cannot be empty");
-        }
-
         if (intf.empty()) {
             THROW_DBUSEXCEPTION("DBusProxy", "Interface cannot be empty");
         }
@@ -767,6 +1341,13 @@ protected:
         // checks if a connection is already established
         Connect();
 
+        // Peer-to-peer connections have no bus daemon, and so neither
+        // a unique name for this end nor a bus name to send to
+        const bool peer_conn = (nullptr == g_dbus_connection_get_unique_name(GetConnection()));
+        if (busn.empty() && !peer_conn) {
+            THROW_DBUSEXCEPTION("DBusProxy", "Bus name cannot be empty");
+        }
+
         /*
           std::cout << "[DBusProxy::SetupProxy] bus_name=" << busn
                   << ", interface=" << intf
@@ -781,7 +1362,7 @@ protected:
         GDBusProxy *retprx = g_dbus_proxy_new_sync(GetConnection(),
                                                    G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
                                                    NULL,             // GDBusInterfaceInfo
-                                                   busn.c_str(),     // aka. destination
+                                                   (peer_conn ? nullptr : busn.c_str()),  // aka. destination
                                                    objp.c_str(),
                                                    intf.c_str(),
                                                    NULL,             // GCancellable
@@ -825,6 +1406,252 @@ private:
     GDBusCallFlags call_flags;
     bool proxy_init;
     bool property_proxy_init;
+    bool property_cache_enabled = false;
+    guint property_cache_subscr = 0;
+    mutable std::mutex property_cache_mtx;
+    mutable std::map<std::string, GVariant *> property_cache;
+
+    /**
+     *  What is known about a service on a specific D-Bus connection
+     */
+    struct ServiceState
+    {
+        bool available = false;     ///< CheckServiceAvail() succeeded
+        bool version_known = false; ///< GetServiceVersion() succeeded
+        std::string version;
+    };
+
+    /**
+     *  Results of CheckServiceAvail() and GetServiceVersion(), indexed
+     *  by the D-Bus connection and the bus name.  Shared by all proxies
+     *  in the process.
+     */
+    struct ServiceCache
+    {
+        std::mutex mtx;
+        std::map<std::pair<GDBusConnection *, std::string>, ServiceState> services;
+    };
+
+    static ServiceCache& service_cache()
+    {
+        static ServiceCache cache;
+        return cache;
+    }
+
+
+    /**
+     *  Looks up the cached state of the service of this proxy.  The
+     *  first lookup for a connection and bus name subscribes to the
+     *  NameOwnerChanged signal of the bus name, which resets the state
+     *  when the service restarts or goes away.  The first lookup for a
+     *  connection also drops all its states when the connection is
+     *  destroyed.
+     *
+     *  The caller must hold ServiceCache::mtx.
+     */
+    ServiceState& service_state(ServiceCache& cache)
+    {
+        GDBusConnection *conn = GetConnection();
+        auto key = std::make_pair(conn, bus_name);
+        auto it = cache.services.find(key);
+        if (cache.services.end() != it)
+        {
+            return it->second;
+        }
+
+        bool known_conn = false;
+        for (const auto& s : cache.services)
+        {
+            if (s.first.first == conn)
+            {
+                known_conn = true;
+                break;
+            }
+        }
+        if (!known_conn)
+        {
+            g_object_weak_ref(G_OBJECT(conn), service_cache_conn_gone_cb,
+                              nullptr);
+        }
+        g_dbus_connection_signal_subscribe(conn,
+                                           "org.freedesktop.DBus",
+                                           "org.freedesktop.DBus",
+                                           "NameOwnerChanged",
+                                           "/org/freedesktop/DBus",
+                                           bus_name.c_str(),
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           service_cache_owner_changed_cb,
+                                           nullptr,
+                                           nullptr);
+        return cache.services[key];
+    }
+
+
+    void cache_service_version(const std::string& version)
+    {
+        ServiceCache& cache = service_cache();
+        std::lock_guard<std::mutex> guard(cache.mtx);
+        ServiceState& state = service_state(cache);
+        state.version = version;
+        state.version_known = true;
+        state.available = true;
+    }
+
+
+    void cache_service_avail()
+    {
+        ServiceCache& cache = service_cache();
+        std::lock_guard<std::mutex> guard(cache.mtx);
+        service_state(cache).available = true;
+    }
+
+
+    static void service_cache_owner_changed_cb(GDBusConnection *conn,
+                                               const gchar *sender,
+                                               const gchar *obj_path,
+                                               const gchar *intf_name,
+                                               const gchar *signal_name,
+                                               GVariant *params,
+                                               gpointer user_data)
+    {
+        if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(sss)")))
+        {
+            return;
+        }
+        gchar *name = nullptr;
+        g_variant_get(params, "(sss)", &name, nullptr, nullptr);
+
+        ServiceCache& cache = service_cache();
+        std::lock_guard<std::mutex> guard(cache.mtx);
+        auto it = cache.services.find(std::make_pair(conn, std::string(name)));
+        if (cache.services.end() != it)
+        {
+            // Keep the entry, as it tracks the signal subscription
+            it->second = ServiceState();
+        }
+        g_free(name);
+    }
+
+
+    static void service_cache_conn_gone_cb(gpointer user_data,
+                                           GObject *conn)
+    {
+        ServiceCache& cache = service_cache();
+        std::lock_guard<std::mutex> guard(cache.mtx);
+        for (auto it = cache.services.begin(); it != cache.services.end(); )
+        {
+            if (it->first.first == (GDBusConnection *) conn)
+            {
+                it = cache.services.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+
+    /**
+     *  Stores all the values of a GetAll() response, in the (a{sv})
+     *  format, in the property cache.
+     */
+    void update_property_cache(GVariant *getall_resp) const
+    {
+        GVariant *dict = g_variant_get_child_value(getall_resp, 0);
+        GVariantIter iter;
+        g_variant_iter_init(&iter, dict);
+
+        std::lock_guard<std::mutex> guard(property_cache_mtx);
+        gchar *key = nullptr;
+        GVariant *value = nullptr;
+        while (g_variant_iter_next(&iter, "{sv}", &key, &value))
+        {
+            auto& slot = property_cache[key];
+            if (slot)
+            {
+                g_variant_unref(slot);
+            }
+            slot = value;  // The cache takes over the reference
+            g_free(key);
+        }
+        g_variant_unref(dict);
+    }
+
+
+    void disable_property_cache() noexcept
+    {
+        if (!property_cache_enabled)
+        {
+            return;
+        }
+        property_cache_enabled = false;
+
+        try
+        {
+            g_dbus_connection_signal_unsubscribe(GetConnection(),
+                                                 property_cache_subscr);
+        }
+        catch (const DBusException&)
+        {
+            // The connection is gone, so is the subscription
+        }
+        property_cache_subscr = 0;
+        InvalidatePropertyCache();
+    }
+
+
+    static void property_cache_changed_cb(GDBusConnection *conn,
+                                          const gchar *sender,
+                                          const gchar *obj_path,
+                                          const gchar *intf_name,
+                                          const gchar *signal_name,
+                                          GVariant *params,
+                                          gpointer this_ptr)
+    {
+        DBusProxy *self = static_cast<DBusProxy *>(this_ptr);
+        if (!g_variant_is_of_type(params, G_VARIANT_TYPE("(sa{sv}as)")))
+        {
+            return;
+        }
+
+        gchar *intf = nullptr;
+        GVariantIter *changed = nullptr;
+        GVariantIter *invalidated = nullptr;
+        g_variant_get(params, "(sa{sv}as)", &intf, &changed, &invalidated);
+
+        if (self->interface == intf)
+        {
+            std::lock_guard<std::mutex> guard(self->property_cache_mtx);
+            gchar *key = nullptr;
+            GVariant *value = nullptr;
+            while (g_variant_iter_next(changed, "{sv}", &key, &value))
+            {
+                auto& slot = self->property_cache[key];
+                if (slot)
+                {
+                    g_variant_unref(slot);
+                }
+                slot = value;
+                g_free(key);
+            }
+
+            gchar *inval = nullptr;
+            while (g_variant_iter_next(invalidated, "s", &inval))
+            {
+                auto it = self->property_cache.find(inval);
+                if (self->property_cache.end() != it)
+                {
+                    g_variant_unref(it->second);
+                    self->property_cache.erase(it);
+                }
+                g_free(inval);
+            }
+        }
+        g_free(intf);
+        g_variant_iter_free(changed);
+        g_variant_iter_free(invalidated);
+    }
 
     // Note we only implement single fd out/in for the fd API since that
     // is all we currently need and handling fd extraction here makes
@@ -897,26 +1724,9 @@ private:
                     GLibUtils::unref_fdlist(fdlist);
                 }
             }
-            if (!ret && !error)
-            {
-                THROW_DBUSEXCEPTION("DBusProxy", "Unspecified error");
-            }
-            else if (!ret && error)
+            if (!ret)
             {
-                std::string dbuserr(error->message);
-
-                if ((dbuserr.find("GDBus.Error:org.freedesktop.DBus.Error.AccessDenied:") != std::string::npos)
-                    || (dbuserr.find("GDBus.Error:net.openvpn.v3.error.acl.denied:") != std::string::npos))
-                {
-                    throw DBusProxyAccessDeniedException(method, dbuserr);
-                }
-
-                g_dbus_error_strip_remote_error(error);
-                std::stringstream errmsg;
-                errmsg << "Failed calling D-Bus method " << method << ": "
-                       << error->message;
-                g_error_free(error);
-                THROW_DBUSEXCEPTION("DBusProxy", errmsg.str());
+                dbusproxy_throw_call_error(method, error);
             }
             return ret;
         }
@@ -0,0 +1,324 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   readiness.hpp
+ *
+ * @brief  Helpers for blocking until a D-Bus peer reports it is ready,
+ *         driven by D-Bus signals instead of fixed sleep() intervals
+ */
+
+#pragma once
+
+#include <string>
+#include <functional>
+
+#include <gio/gio.h>
+
+#include "dbus/exceptions.hpp"
+
+
+/**
+ *  Waits for a specific D-Bus signal to arrive.
+ *
+ *  The signal subscription is set up in the constructor and is bound to
+ *  a private GMainContext.  Signals arriving before Wait() is called are
+ *  queued in this context, so the typical use is to create the waiter
+ *  first, then trigger the operation the peer should react on and
+ *  finally call Wait().  This avoids missing a signal sent before the
+ *  caller was ready to process it.
+ *
+ *  Since a private main context is used, this can safely be used from
+ *  callbacks running inside the main loop of a service.  The main loop
+ *  of the service will not be processed while waiting.
+ */
+class DBusSignalWaiter
+{
+public:
+    /**
+     *  Signal filter.  Called with the signal parameters for each signal
+     *  matching the subscription.  Must return true if this is the signal
+     *  being waited for.
+     */
+    typedef std::function<bool(GVariant *params)> Matcher;
+
+
+    /**
+     *  Prepares a new signal waiter.  Empty strings are treated as
+     *  wildcards.
+     *
+     * @param conn       GDBusConnection where the signal is expected
+     * @param sender     Bus name of the signal sender
+     * @param interf     D-Bus interface of the signal
+     * @param path       D-Bus object path of the signal sender
+     * @param signal     Name of the signal
+     * @param arg0       Only match signals where the first argument is
+     *                   this string
+     * @param matcher    Optional Matcher function doing further filtering
+     */
+    DBusSignalWaiter(GDBusConnection *conn,
+                     const std::string& sender,
+                     const std::string& interf,
+                     const std::string& path,
+                     const std::string& signal,
+                     const std::string& arg0 = "",
+                     Matcher matcher = nullptr)
+        : connection(conn),
+          match_func(matcher)
+    {
+        if (!G_IS_DBUS_CONNECTION(connection))
+        {
+            THROW_DBUSEXCEPTION("DBusSignalWaiter",
+                                "Invalid D-Bus connection");
+        }
+        g_object_ref(connection);
+
+        // Signal callbacks are dispatched to the thread-default main
+        // context active at subscription time
+        context = g_main_context_new();
+        g_main_context_push_thread_default(context);
+        subscr_id = g_dbus_connection_signal_subscribe(
+                                  connection,
+                                  (sender.empty() ? nullptr : sender.c_str()),
+                                  (interf.empty() ? nullptr : interf.c_str()),
+                                  (signal.empty() ? nullptr : signal.c_str()),
+                                  (path.empty() ? nullptr : path.c_str()),
+                                  (arg0.empty() ? nullptr : arg0.c_str()),
+                                  G_DBUS_SIGNAL_FLAGS_NONE,
+                                  signal_handler,
+                                  this,
+                                  nullptr);
+        g_main_context_pop_thread_default(context);
+    }
+
+
+    virtual ~DBusSignalWaiter()
+    {
+        g_dbus_connection_signal_unsubscribe(connection, subscr_id);
+
+        // Flush out any pending callbacks before the context goes away
+        while (g_main_context_iteration(context, FALSE))
+        {
+        }
+        g_main_context_unref(context);
+        g_object_unref(connection);
+    }
+
+
+    /**
+     *  Block until the expected signal has been received or the timeout
+     *  has been reached.  Once the signal has been seen, all later calls
+     *  will return true immediately.
+     *
+     * @param timeout_ms  Maximum time to wait, in milliseconds
+     *
+     * @return Returns true if the signal has been received, otherwise
+     *         false.
+     */
+    bool Wait(const unsigned int timeout_ms)
+    {
+        if (signalled)
+        {
+            return true;
+        }
+
+        bool timed_out = false;
+        GSource *timer = g_timeout_source_new(timeout_ms);
+        g_source_set_callback(timer, timeout_handler, &timed_out, nullptr);
+        g_source_attach(timer, context);
+
+        while (!signalled && !timed_out)
+        {
+            g_main_context_iteration(context, TRUE);
+        }
+
+        g_source_destroy(timer);
+        g_source_unref(timer);
+        return signalled;
+    }
+
+
+    /**
+     * @return Returns true if the expected signal has been received
+     */
+    bool Signalled() const noexcept
+    {
+        return signalled;
+    }
+
+
+protected:
+    GDBusConnection *connection = nullptr;
+
+    /**
+     *  Flag the wait as completed, without having received the signal.
+     *  Used by subclasses which can determine the outcome by other means.
+     */
+    void set_signalled() noexcept
+    {
+        signalled = true;
+    }
+
+
+private:
+    GMainContext *context = nullptr;
+    guint subscr_id = 0;
+    Matcher match_func;
+    bool signalled = false;
+
+
+    static void signal_handler(GDBusConnection *conn,
+                               const gchar *sender,
+                               const gchar *obj_path,
+                               const gchar *intf_name,
+                               const gchar *signal_name,
+                               GVariant *params,
+                               gpointer this_ptr)
+    {
+        DBusSignalWaiter *self = static_cast<DBusSignalWaiter *>(this_ptr);
+        if (self->signalled)
+        {
+            return;
+        }
+        if (!self->match_func || self->match_func(params))
+        {
+            self->signalled = true;
+        }
+    }
+
+
+    static gboolean timeout_handler(gpointer timed_out)
+    {
+        *static_cast<bool *>(timed_out) = true;
+        return G_SOURCE_REMOVE;
+    }
+};
+
+
+
+/**
+ *  Waits for a bus name to get an owner or for it to be released,
+ *  based on the org.freedesktop.DBus.NameOwnerChanged signal.
+ *
+ *  The current state of the bus name is checked when Wait() is called
+ *  the first time, so it will not block if the name already is in the
+ *  requested state.
+ */
+class DBusNameOwnerWaiter : public DBusSignalWaiter
+{
+public:
+    /**
+     * @param conn       GDBusConnection to use for the name lookups
+     * @param busname    Bus name to watch
+     * @param appear     If true, wait for the name to get an owner.
+     *                   Otherwise wait for the name to disappear.
+     */
+    DBusNameOwnerWaiter(GDBusConnection *conn,
+                        const std::string& busname,
+                        const bool appear = true)
+        : DBusSignalWaiter(conn,
+                           "org.freedesktop.DBus",
+                           "org.freedesktop.DBus",
+                           "/org/freedesktop/DBus",
+                           "NameOwnerChanged",
+                           busname,
+                           [appear](GVariant *params)
+                           {
+                               gchar *name = nullptr;
+                               gchar *old_owner = nullptr;
+                               gchar *new_owner = nullptr;
+                               g_variant_get(params, "(sss)",
+                                             &name, &old_owner, &new_owner);
+                               bool owned = (new_owner && *new_owner);
+                               g_free(name);
+                               g_free(old_owner);
+                               g_free(new_owner);
+                               return (appear == owned);
+                           }),
+          bus_name(busname),
+          wait_appear(appear)
+    {
+        if (bus_name.empty())
+        {
+            THROW_DBUSEXCEPTION("DBusNameOwnerWaiter",
+                                "Bus name cannot be empty");
+        }
+    }
+
+
+    /**
+     *  Block until the bus name is in the requested state or until the
+     *  timeout has been reached.
+     *
+     * @param timeout_ms  Maximum time to wait, in milliseconds
+     *
+     * @return Returns true if the bus name is in the requested state
+     */
+    bool Wait(const unsigned int timeout_ms)
+    {
+        if (!state_checked)
+        {
+            state_checked = true;
+            if (wait_appear == NameHasOwner())
+            {
+                set_signalled();
+            }
+        }
+        return DBusSignalWaiter::Wait(timeout_ms);
+    }
+
+
+    /**
+     *  Checks if the bus name currently has an owner
+     *
+     * @return Returns true if the bus name is owned by a process
+     */
+    bool NameHasOwner() const
+    {
+        GError *error = nullptr;
+        GVariant *r = g_dbus_connection_call_sync(connection,
+                                                  "org.freedesktop.DBus",
+                                                  "/org/freedesktop/DBus",
+                                                  "org.freedesktop.DBus",
+                                                  "NameHasOwner",
+                                                  g_variant_new("(s)", bus_name.c_str()),
+                                                  G_VARIANT_TYPE("(b)"),
+                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                  -1, nullptr, &error);
+        if (!r)
+        {
+            std::string err = "Failed looking up '" + bus_name + "': "
+                              + (error ? error->message : "Unknown error");
+            if (error)
+            {
+                g_error_free(error);
+            }
+            THROW_DBUSEXCEPTION("DBusNameOwnerWaiter", err);
+        }
+        gboolean owned = FALSE;
+        g_variant_get(r, "(b)", &owned);
+        g_variant_unref(r);
+        return owned;
+    }
+
+
+private:
+    const std::string bus_name;
+    const bool wait_appear;
+    bool state_checked = false;
+};
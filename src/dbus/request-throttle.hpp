@@ -0,0 +1,235 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   request-throttle.hpp
+ *
+ * @brief  Per-sender limits of the D-Bus method calls a service handles
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+/**
+ *  All D-Bus method calls of a service are handled in the same main loop,
+ *  so a single caller calling methods in a tight loop delays the calls of
+ *  everyone else.  The DBusRequestThrottle limits each sender with a
+ *  token bucket, allowing a burst of calls and then a steady rate, and
+ *  limits how many of its calls may wait for an asynchronous reply at
+ *  the same time.
+ *
+ *  Privileged senders, like root and the service users, are not limited.
+ *  Whether a sender is privileged is only checked the first time it
+ *  exceeds a limit, so well behaved callers do not cost a credentials
+ *  look-up.
+ *
+ *  All methods are thread-safe.
+ */
+class DBusRequestThrottle
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Result
+    {
+        ALLOWED,          ///< Call admitted; Done() must be called when replied
+        RATE_LIMITED,     ///< Sender exceeded its call rate
+        TOO_MANY_PENDING  ///< Sender has too many calls waiting for a reply
+    };
+
+
+    /**
+     * @param rate         Calls per second allowed per sender; 0
+     *                     disables the limits
+     * @param burst        Calls a sender may do at once before the rate
+     *                     limit applies
+     * @param max_pending  Calls per sender which may wait for a reply at
+     *                     the same time; 0 for no limit
+     */
+    DBusRequestThrottle(unsigned int rate = 200, unsigned int burst = 1000,
+                        unsigned int max_pending = 32)
+    {
+        Configure(rate, burst, max_pending);
+    }
+
+
+    /**
+     * @return Returns the DBusRequestThrottle used by the DBusObject
+     *         method call dispatcher of this process
+     */
+    static DBusRequestThrottle& Instance()
+    {
+        static DBusRequestThrottle instance;
+        return instance;
+    }
+
+
+    /**
+     *  Changes the limits, see the constructor
+     */
+    void Configure(unsigned int new_rate, unsigned int new_burst,
+                   unsigned int new_max_pending)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        rate = new_rate;
+        burst = std::max(new_burst, new_rate);
+        max_pending = new_max_pending;
+    }
+
+
+    /**
+     *  Checks if a method call may be handled
+     *
+     * @param sender      std::string with the unique bus name of the caller
+     * @param privileged  Function returning true if the sender is exempt
+     *                    from the limits; only called when a limit is hit
+     * @param now         Current time
+     *
+     * @return Returns the Result of the check
+     */
+    Result Admit(const std::string& sender,
+                 const std::function<bool()>& privileged,
+                 Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (senders.size() > sweep_size)
+        {
+            sweep(now);
+        }
+
+        Sender& s = senders[sender];
+        if (0 == s.pending && s.last.time_since_epoch().count() == 0)
+        {
+            s.tokens = burst;
+        }
+        else
+        {
+            double elapsed = std::chrono::duration<double>(now - s.last).count();
+            s.tokens = std::min<double>(burst, s.tokens + elapsed * rate);
+        }
+        s.last = now;
+
+        Result res = Result::ALLOWED;
+        if (rate > 0 && s.tokens < 1.0)
+        {
+            res = Result::RATE_LIMITED;
+        }
+        else if (rate > 0 && max_pending > 0 && s.pending >= max_pending)
+        {
+            res = Result::TOO_MANY_PENDING;
+        }
+
+        if (Result::ALLOWED != res)
+        {
+            if (Privilege::UNKNOWN == s.privilege)
+            {
+                s.privilege = (privileged() ? Privilege::YES : Privilege::NO);
+            }
+            if (Privilege::NO == s.privilege)
+            {
+                return res;
+            }
+        }
+        s.tokens = std::max(s.tokens - 1.0, 0.0);
+        ++s.pending;
+        return Result::ALLOWED;
+    }
+
+
+    /**
+     *  Tells a method call admitted by Admit() has been replied to
+     *
+     * @param sender  std::string with the unique bus name of the caller
+     */
+    void Done(const std::string& sender)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = senders.find(sender);
+        if (senders.end() != it && it->second.pending > 0)
+        {
+            --it->second.pending;
+        }
+    }
+
+
+    /**
+     * @return Returns the number of senders tracked
+     */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return senders.size();
+    }
+
+
+private:
+    enum class Privilege
+    {
+        UNKNOWN,
+        YES,
+        NO
+    };
+
+    struct Sender
+    {
+        double tokens = 0;
+        Clock::time_point last;
+        unsigned int pending = 0;
+        Privilege privilege = Privilege::UNKNOWN;
+    };
+
+    /// Senders are only swept when there are more than this
+    static const size_t sweep_size = 256;
+
+    mutable std::mutex mtx;
+    unsigned int rate = 0;
+    unsigned int burst = 0;
+    unsigned int max_pending = 0;
+    std::unordered_map<std::string, Sender> senders;
+
+
+    /**
+     *  Removes the senders without pending calls whose bucket has been
+     *  refilled; they are back to the state of a new sender.  Unique
+     *  bus names are never reused, so this also drops senders which
+     *  disconnected.
+     */
+    void sweep(Clock::time_point now)
+    {
+        const auto refill = std::chrono::duration<double>(rate > 0 ? (double) burst / rate
+                                                                   : 0.0);
+        for (auto it = senders.begin(); it != senders.end();)
+        {
+            if (0 == it->second.pending && now - it->second.last >= refill)
+            {
+                it = senders.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+};
@@ -63,17 +63,24 @@ public:
      *                                 QueueCheck method
      * @param method_providereponse    String containing the name of the
      *                                 QueueProvideResponse method
+     * @param method_queuefetchall     (optional) String containing the name
+     *                                 of the batched QueueFetchAll method
+     * @param method_provideresponses  (optional) String containing the name
+     *                                 of the batched ProvideResponses method
      *
      * The method names must match the defined introspection of the service
      * side.
      */
     DBusRequiresQueueProxy(GBusType bus_type, std::string destination , std::string interface, std::string objpath,
-                           std::string method_quechktypegroup, std::string method_queuefetch, std::string method_queuecheck, std::string method_providereponse)
+                           std::string method_quechktypegroup, std::string method_queuefetch, std::string method_queuecheck, std::string method_providereponse,
+                           std::string method_queuefetchall = "", std::string method_provideresponses = "")
         : DBusProxy(bus_type, destination, interface, objpath),
           method_quechktypegroup(method_quechktypegroup),
           method_queuefetch(method_queuefetch),
           method_queuecheck(method_queuecheck),
-          method_provideresponse(method_providereponse)
+          method_provideresponse(method_providereponse),
+          method_queuefetchall(method_queuefetchall),
+          method_provideresponses(method_provideresponses)
     {
     }
 
@@ -97,17 +104,24 @@ public:
      *                                 QueueCheck method
      * @param method_providereponse    String containing the name of the
      *                                 QueueProvideResponse method
+     * @param method_queuefetchall     (optional) String containing the name
+     *                                 of the batched QueueFetchAll method
+     * @param method_provideresponses  (optional) String containing the name
+     *                                 of the batched ProvideResponses method
      *
      * The method names must match the defined introspection of the service
      * side.
      */
     DBusRequiresQueueProxy(DBus & dbusobj, std::string destination , std::string interface, std::string objpath,
-                           std::string method_quechktypegroup, std::string method_queuefetch, std::string method_queuecheck, std::string method_providereponse)
+                           std::string method_quechktypegroup, std::string method_queuefetch, std::string method_queuecheck, std::string method_providereponse,
+                           std::string method_queuefetchall = "", std::string method_provideresponses = "")
         : DBusProxy(dbusobj.GetConnection(), destination, interface, objpath),
           method_quechktypegroup(method_quechktypegroup),
           method_queuefetch(method_queuefetch),
           method_queuecheck(method_queuecheck),
-          method_provideresponse(method_providereponse)
+          method_provideresponse(method_providereponse),
+          method_queuefetchall(method_queuefetchall),
+          method_provideresponses(method_provideresponses)
     {
     }
 
@@ -155,6 +169,49 @@ public:
     }
 
 
+    /**
+     *  C++ method used to retrieve all unresolved RequiresSlot records,
+     *  regardless of their type and group.  If the service implements
+     *  the batched QueueFetchAll method, this is done in a single D-Bus
+     *  call.  Otherwise it falls back to walking all the unresolved
+     *  types and groups.
+     *
+     * @return Returns a std::vector<RequiresSlot> of all unresolved slots
+     */
+    std::vector<struct RequiresSlot> QueueFetchAll()
+    {
+        std::vector<struct RequiresSlot> ret;
+        if (method_queuefetchall.empty())
+        {
+            for (auto& tg : QueueCheckTypeGroup())
+            {
+                QueueFetchAll(ret, std::get<0>(tg), std::get<1>(tg));
+            }
+            return ret;
+        }
+
+        GVariant *res = Call(method_queuefetchall);
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("DBusRequiresQueueProxy",
+                                "Failed during call to QueueFetchAll()");
+        }
+
+        GVariantIter *slots = NULL;
+        g_variant_get(res, "(a(uuussb))", &slots);
+
+        GVariant *e = NULL;
+        while ((e = g_variant_iter_next_value(slots)))
+        {
+            ret.push_back(deserialize(e));
+            g_variant_unref(e);
+        }
+        g_variant_iter_free(slots);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
     /**
      *  Retrieves a RequiresQueue::ClientAttTypeGroup tuple containing all
      *  unresolved ClientAttentionTypes and ClientAttentionGroups.
@@ -241,11 +298,53 @@ public:
     }
 
 
+    /**
+     *  Provides several front-end responses in one go.  If the service
+     *  implements the batched ProvideResponses method, all responses are
+     *  sent in a single D-Bus call and the service will reject all of them
+     *  if one is invalid.  Otherwise each response is sent individually.
+     *
+     * @param slots  std::vector<RequiresSlot> of the responses to provide
+     */
+    void ProvideResponses(std::vector<struct RequiresSlot>& slots)
+    {
+        if (method_provideresponses.empty())
+        {
+            for (auto& s : slots)
+            {
+                ProvideResponse(s);
+            }
+            return;
+        }
+
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(uuus)"));
+        for (const auto& s : slots)
+        {
+            g_variant_builder_add(bld, "(uuus)",
+                                  (unsigned int) s.type,
+                                  (unsigned int) s.group,
+                                  s.id,
+                                  s.value.c_str());
+        }
+        GVariant *res = Call(method_provideresponses,
+                             g_variant_new("(a(uuus))", bld));
+        g_variant_builder_unref(bld);
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("DBusRequiresQueueProxy",
+                                "Failed during call to ProvideResponses()");
+        }
+        g_variant_unref(res);
+    }
+
+
 private:
     std::string method_quechktypegroup;
     std::string method_queuefetch;
     std::string method_queuecheck;
     std::string method_provideresponse;
+    std::string method_queuefetchall;
+    std::string method_provideresponses;
 
 
     /**
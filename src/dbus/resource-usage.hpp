@@ -0,0 +1,313 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   resource-usage.hpp
+ *
+ * @brief  Object counts, approximate memory use and allocator statistics
+ *         of a service, provided by the net.openvpn.v3.debug interface
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <malloc.h>
+#include <gio/gio.h>
+
+
+/**
+ *  Process wide collection of resource usage reporters.
+ *
+ *  The objects managing the D-Bus objects of a service (configuration
+ *  profiles, sessions, loggers, network devices, ...) register a
+ *  Reporter, which adds the number of objects and their approximate
+ *  memory use to a Report when the resource usage is requested.  The
+ *  numbers are estimates, meant to spot objects piling up in long
+ *  running services.
+ *
+ *  The signal subscription counters are updated by DBusSignalSubscription
+ *  and DBusSignalRouter.
+ */
+class DBusResourceUsage
+{
+public:
+    /**
+     *  A single line of a resource usage report
+     */
+    struct Entry
+    {
+        std::string name;
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+
+    /**
+     *  Collects the entries added by all reporters.  Entries with the
+     *  same name are summed up, so each object of a kind can add itself.
+     */
+    class Report
+    {
+    public:
+        void Add(const std::string& name, const uint64_t count,
+                 const uint64_t bytes = 0)
+        {
+            auto it = index.find(name);
+            if (index.end() == it)
+            {
+                index[name] = entries.size();
+                entries.push_back(Entry{name, count, bytes});
+                return;
+            }
+            entries[it->second].count += count;
+            entries[it->second].bytes += bytes;
+        }
+
+        const std::vector<Entry>& Entries() const noexcept
+        {
+            return entries;
+        }
+
+    private:
+        std::vector<Entry> entries;
+        std::map<std::string, size_t> index;
+    };
+
+    using Reporter = std::function<void(Report&)>;
+    using ReporterId = unsigned int;
+
+
+    static DBusResourceUsage& Instance()
+    {
+        static DBusResourceUsage usage;
+        return usage;
+    }
+
+
+    /**
+     *  Registers a reporter.  It is called from the thread handling the
+     *  D-Bus method calls, so it may access the same data as the D-Bus
+     *  method handlers without extra locking.
+     *
+     * @param reporter  Reporter function adding entries to a Report
+     * @return Returns a ReporterId to be used with RemoveReporter()
+     */
+    ReporterId AddReporter(Reporter reporter)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        reporters[++last_id] = std::move(reporter);
+        return last_id;
+    }
+
+
+    void RemoveReporter(const ReporterId id)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        reporters.erase(id);
+    }
+
+
+    /**
+     *  Runs all reporters
+     *
+     * @return Returns a Report with the entries of all reporters
+     */
+    Report Collect()
+    {
+        Report ret;
+        std::lock_guard<std::mutex> guard(mtx);
+        for (const auto& r : reporters)
+        {
+            r.second(ret);
+        }
+        return ret;
+    }
+
+
+    static void SignalSubscribed() noexcept
+    {
+        Instance().signal_subscriptions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void SignalUnsubscribed() noexcept
+    {
+        Instance().signal_subscriptions.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void SignalHandlerAdded() noexcept
+    {
+        Instance().signal_handlers.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void SignalHandlerRemoved() noexcept
+    {
+        Instance().signal_handlers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+
+    /**
+     *  Retrieve the memory, allocator and file descriptor statistics of
+     *  this process, together with the signal subscription counters
+     *
+     * @return Returns a std::vector of (name, value) pairs.  Memory sizes
+     *         are in bytes.
+     */
+    std::vector<std::pair<std::string, uint64_t>> GetProcessStats() const
+    {
+        std::vector<std::pair<std::string, uint64_t>> ret;
+
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            // The Vm* values are in kB
+            static const std::vector<std::pair<std::string, uint64_t>> fields = {
+                {"VmSize", 1024}, {"VmRSS", 1024}, {"VmHWM", 1024}, {"Threads", 1}
+            };
+            for (const auto& f : fields)
+            {
+                if (0 == line.compare(0, f.first.size() + 1, f.first + ":"))
+                {
+                    uint64_t v = std::strtoull(line.c_str() + f.first.size() + 1,
+                                               nullptr, 10);
+                    ret.emplace_back(f.first, v * f.second);
+                }
+            }
+        }
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        struct mallinfo2 mi = mallinfo2();
+#elif defined(__GLIBC__)
+        struct mallinfo mi = mallinfo();
+#endif
+#if defined(__GLIBC__)
+        ret.emplace_back("malloc_arena", mi.arena);
+        ret.emplace_back("malloc_mmap", mi.hblkhd);
+        ret.emplace_back("malloc_in_use", mi.uordblks);
+        ret.emplace_back("malloc_free", mi.fordblks);
+        ret.emplace_back("malloc_releasable", mi.keepcost);
+#endif
+
+        uint64_t fds = 0;
+        DIR *dir = opendir("/proc/self/fd");
+        if (dir)
+        {
+            while (struct dirent *e = readdir(dir))
+            {
+                fds += ('.' != e->d_name[0] ? 1 : 0);
+            }
+            closedir(dir);
+            --fds;  // The descriptor used by opendir()
+        }
+        ret.emplace_back("open_fds", fds);
+
+        ret.emplace_back("signal_subscriptions",
+                         signal_subscriptions.load(std::memory_order_relaxed));
+        ret.emplace_back("signal_handlers",
+                         signal_handlers.load(std::memory_order_relaxed));
+        return ret;
+    }
+
+
+    /**
+     * @return Returns a std::string with the XML document malloc_info(3)
+     *         provides, empty if it is not available
+     */
+    static std::string GetMallocInfo()
+    {
+        std::string ret;
+#if defined(__GLIBC__)
+        char *buf = nullptr;
+        size_t len = 0;
+        FILE *f = open_memstream(&buf, &len);
+        if (!f)
+        {
+            return ret;
+        }
+        malloc_info(0, f);
+        fclose(f);
+        ret.assign(buf, len);
+        free(buf);
+#endif
+        return ret;
+    }
+
+
+    /**
+     *  Retrieve the complete resource usage of this process
+     *
+     * @return Returns a GVariant tuple (a(stt)a(st)s) with the
+     *         (name, count, bytes) entries of the reporters, the
+     *         (name, value) process statistics and the malloc_info(3)
+     *         XML document
+     */
+    GVariant * GetVariant()
+    {
+        Report report = Collect();
+        GVariantBuilder *objs = g_variant_builder_new(G_VARIANT_TYPE("a(stt)"));
+        for (const auto& e : report.Entries())
+        {
+            g_variant_builder_add(objs, "(stt)", e.name.c_str(),
+                                  (guint64) e.count, (guint64) e.bytes);
+        }
+        GVariantBuilder *proc = g_variant_builder_new(G_VARIANT_TYPE("a(st)"));
+        for (const auto& s : GetProcessStats())
+        {
+            g_variant_builder_add(proc, "(st)", s.first.c_str(),
+                                  (guint64) s.second);
+        }
+        GVariant *ret = g_variant_new("(a(stt)a(st)s)", objs, proc,
+                                      GetMallocInfo().c_str());
+        g_variant_builder_unref(objs);
+        g_variant_builder_unref(proc);
+        return ret;
+    }
+
+
+    /**
+     *  Approximate heap and object memory used by a std::string
+     */
+    static uint64_t StringBytes(const std::string& str) noexcept
+    {
+        return sizeof(std::string) + (str.capacity() > 15 ? str.capacity() + 1 : 0);
+    }
+
+
+private:
+    std::mutex mtx;
+    std::map<ReporterId, Reporter> reporters;
+    ReporterId last_id = 0;
+    std::atomic<int64_t> signal_subscriptions{0};
+    std::atomic<int64_t> signal_handlers{0};
+
+    DBusResourceUsage() = default;
+};
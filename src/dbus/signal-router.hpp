@@ -0,0 +1,328 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   signal-router.hpp
+ *
+ * @brief  Dispatches D-Bus signals to many handlers using a single
+ *         signal subscription per interface
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gio/gio.h>
+
+#include "dbus/exceptions.hpp"
+#include "dbus/resource-usage.hpp"
+
+
+/**
+ *  A D-Bus signal as delivered by DBusSignalRouter.  The strings are owned
+ *  by GDBus and are only valid while the handler runs.
+ */
+struct DBusSignalEvent
+{
+    GDBusConnection *connection;
+    const gchar *sender;
+    const gchar *object_path;
+    const gchar *interface;
+    const gchar *signal_name;
+    GVariant *params;
+};
+
+
+
+/**
+ *  Each DBusSignalSubscription installs its own match rule in the D-Bus
+ *  daemon, which also means a filter entry per subscription in the daemon.
+ *  For services tracking many objects of the same kind, like the session
+ *  manager does with VPN backend processes, this adds up.
+ *
+ *  DBusSignalRouter installs a single match rule per interface and
+ *  dispatches the signals to the registered handlers with a hash lookup on
+ *  the sender, object path and signal name.  There is one router per
+ *  D-Bus connection, retrieved with DBusSignalRouter::Get().
+ *
+ *  Since the match rule does not restrict the sender, handlers must be
+ *  registered with the unique bus name of the sender; well-known bus names
+ *  are not resolved.  An empty sender or object path matches any value.
+ */
+class DBusSignalRouter : public std::enable_shared_from_this<DBusSignalRouter>
+{
+public:
+    using Ptr = std::shared_ptr<DBusSignalRouter>;
+    using Handler = std::function<void(const DBusSignalEvent&)>;
+    using HandlerId = uint64_t;
+
+
+    /**
+     *  Retrieve the signal router of a D-Bus connection, creating it
+     *  if needed.  The router is removed when the last user releases it.
+     *
+     * @param conn  GDBusConnection the router operates on
+     * @return Returns a DBusSignalRouter::Ptr to the router
+     */
+    static Ptr Get(GDBusConnection *conn)
+    {
+        static std::mutex reg_mtx;
+        static std::map<GDBusConnection *, std::weak_ptr<DBusSignalRouter>> registry;
+
+        std::lock_guard<std::mutex> guard(reg_mtx);
+        Ptr r = registry[conn].lock();
+        if (!r)
+        {
+            r.reset(new DBusSignalRouter(conn));
+            registry[conn] = r;
+        }
+        return r;
+    }
+
+
+    ~DBusSignalRouter()
+    {
+        for (const auto& m : matches)
+        {
+            g_dbus_connection_signal_unsubscribe(conn, m.second.subscr_id);
+            DBusResourceUsage::SignalUnsubscribed();
+        }
+        for (size_t i = 0; i < handler_keys.size(); ++i)
+        {
+            DBusResourceUsage::SignalHandlerRemoved();
+        }
+        g_object_unref(conn);
+    }
+
+
+    /**
+     *  Register a signal handler
+     *
+     * @param interface    D-Bus interface of the signal
+     * @param sender       Unique bus name of the sender; empty for any
+     * @param path         D-Bus object path of the signal; empty for any
+     * @param signal_name  Signal name
+     * @param handler      Handler function to call for matching signals
+     *
+     * @return Returns a HandlerId to be used with RemoveHandler()
+     */
+    HandlerId AddHandler(const std::string& interface,
+                         const std::string& sender,
+                         const std::string& path,
+                         const std::string& signal_name,
+                         Handler handler)
+    {
+        if (interface.empty() || signal_name.empty())
+        {
+            THROW_DBUSEXCEPTION("DBusSignalRouter",
+                                "Interface and signal name are required");
+        }
+
+        std::lock_guard<std::mutex> guard(mtx);
+        Match& m = matches[interface];
+        if (0 == m.subscr_id)
+        {
+            m.subscr_id = g_dbus_connection_signal_subscribe(conn,
+                                                             nullptr,
+                                                             interface.c_str(),
+                                                             nullptr,
+                                                             nullptr,
+                                                             nullptr,
+                                                             G_DBUS_SIGNAL_FLAGS_NONE,
+                                                             dispatch_cb,
+                                                             this,
+                                                             nullptr);
+            if (0 == m.subscr_id)
+            {
+                matches.erase(interface);
+                THROW_DBUSEXCEPTION("DBusSignalRouter",
+                                    "Failed to subscribe to signals on "
+                                    + interface);
+            }
+            DBusResourceUsage::SignalSubscribed();
+        }
+        ++m.handlers;
+        DBusResourceUsage::SignalHandlerAdded();
+
+        HandlerId id = ++last_id;
+        std::string key = make_key(interface, sender, path, signal_name);
+        handlers[key].push_back(Entry{id, handler});
+        handler_keys[id] = std::make_pair(key, interface);
+        return id;
+    }
+
+
+    /**
+     *  Remove a signal handler.  Once this returns, the handler will not
+     *  be called again.
+     *
+     * @param id  HandlerId returned by AddHandler()
+     */
+    void RemoveHandler(const HandlerId id)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto hk = handler_keys.find(id);
+        if (handler_keys.end() == hk)
+        {
+            return;
+        }
+
+        auto h = handlers.find(hk->second.first);
+        if (handlers.end() != h)
+        {
+            auto& list = h->second;
+            for (auto it = list.begin(); it != list.end(); ++it)
+            {
+                if (it->id == id)
+                {
+                    list.erase(it);
+                    break;
+                }
+            }
+            if (list.empty())
+            {
+                handlers.erase(h);
+            }
+        }
+
+        // Remove the match rule once the last handler for the
+        // interface is gone
+        auto m = matches.find(hk->second.second);
+        if (matches.end() != m && 0 == --m->second.handlers)
+        {
+            g_dbus_connection_signal_unsubscribe(conn, m->second.subscr_id);
+            DBusResourceUsage::SignalUnsubscribed();
+            matches.erase(m);
+        }
+        handler_keys.erase(hk);
+        DBusResourceUsage::SignalHandlerRemoved();
+    }
+
+
+    GDBusConnection *GetConnection() const noexcept
+    {
+        return conn;
+    }
+
+
+private:
+    struct Match
+    {
+        guint subscr_id = 0;
+        unsigned int handlers = 0;
+    };
+
+    struct Entry
+    {
+        HandlerId id;
+        Handler handler;
+    };
+
+    GDBusConnection *conn = nullptr;
+    std::mutex mtx;
+    HandlerId last_id = 0;
+    std::unordered_map<std::string, Match> matches;
+    std::unordered_map<std::string, std::vector<Entry>> handlers;
+    std::unordered_map<HandlerId, std::pair<std::string, std::string>> handler_keys;
+
+
+    DBusSignalRouter(GDBusConnection *c)
+        : conn(c)
+    {
+        g_object_ref(conn);
+    }
+
+
+    static std::string make_key(const std::string& interface,
+                                const std::string& sender,
+                                const std::string& path,
+                                const std::string& signal_name)
+    {
+        std::string key;
+        key.reserve(interface.size() + sender.size() + path.size()
+                    + signal_name.size() + 3);
+        key.append(interface).push_back('\n');
+        key.append(sender).push_back('\n');
+        key.append(path).push_back('\n');
+        key.append(signal_name);
+        return key;
+    }
+
+
+    void dispatch(const DBusSignalEvent& ev)
+    {
+        // Collect the handlers first; a handler may add or remove
+        // handlers while being called
+        std::vector<Entry> targets;
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            const std::string senders[] = {ev.sender ? ev.sender : "", ""};
+            const std::string paths[] = {ev.object_path, ""};
+            for (const auto& s : senders)
+            {
+                for (const auto& p : paths)
+                {
+                    auto h = handlers.find(make_key(ev.interface, s, p,
+                                                    ev.signal_name));
+                    if (handlers.end() != h)
+                    {
+                        targets.insert(targets.end(),
+                                       h->second.begin(), h->second.end());
+                    }
+                }
+            }
+        }
+
+        for (const auto& t : targets)
+        {
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                if (handler_keys.end() == handler_keys.find(t.id))
+                {
+                    // Removed by an earlier handler
+                    continue;
+                }
+            }
+            t.handler(ev);
+        }
+    }
+
+
+    static void dispatch_cb(GDBusConnection *conn,
+                            const gchar *sender,
+                            const gchar *obj_path,
+                            const gchar *intf_name,
+                            const gchar *sign_name,
+                            GVariant *params,
+                            gpointer this_ptr)
+    {
+        // Keep the router alive even if a handler releases the last
+        // reference to it
+        Ptr self = static_cast<DBusSignalRouter *>(this_ptr)->shared_from_this();
+        self->dispatch(DBusSignalEvent{conn, sender, obj_path, intf_name,
+                                       sign_name, params});
+    }
+};
@@ -20,9 +20,11 @@
 #pragma once
 
 #include <map>
+#include <utility>
 #include <vector>
 
 #include "core.hpp"
+#include "resource-usage.hpp"
 
 // Several Glib2 functions used cannot use empty strings if the argument
 // to the function is to be ignored, it must be NULL.  Since we need this
@@ -125,14 +127,27 @@ public:
                                          GVariant *parameters) = 0;
 
 
-    void Subscribe(std::string busname, std::string objpath, std::string signal_name)
+    /**
+     *  Subscribe to a signal.  The match rule installed in the D-Bus daemon
+     *  is made as narrow as the arguments allow, so signals not matching
+     *  are dropped by the bus and never reach this process.
+     *
+     * @param busname      Sender bus name; empty matches any sender
+     * @param objpath      Object path; empty matches any object path
+     * @param signal_name  Signal name to subscribe to
+     * @param arg0         If not empty, only signals where the first
+     *                     argument is a string equal to this value are
+     *                     delivered
+     */
+    void Subscribe(std::string busname, std::string objpath,
+                   std::string signal_name, std::string arg0)
     {
         guint signal_id = g_dbus_connection_signal_subscribe(conn,
                                                        STRING_TO_CHARPTR(busname),
                                                        STRING_TO_CHARPTR(interface),
                                                        STRING_TO_CHARPTR(signal_name),
                                                        STRING_TO_CHARPTR(objpath),
-                                                       NULL,
+                                                       STRING_TO_CHARPTR(arg0),
                                                        G_DBUS_SIGNAL_FLAGS_NONE,
                                                        dbusobject_callback_signal_handler,
                                                        this,
@@ -144,11 +159,27 @@ public:
                 << object_path << "[" << interface << "]";
             THROW_DBUSEXCEPTION("DBusSignalSubscription", err.str());
         }
-        subscriptions[signal_name] = signal_id;
+
+        // Replace an existing subscription for the same path and signal
+        // instead of leaking it
+        guint& sub = subscriptions[SubscriptionKey(objpath, signal_name)];
+        if (sub > 0)
+        {
+            g_dbus_connection_signal_unsubscribe(conn, sub);
+            DBusResourceUsage::SignalUnsubscribed();
+        }
+        sub = signal_id;
+        DBusResourceUsage::SignalSubscribed();
         subscribed = true;
     }
 
 
+    void Subscribe(std::string busname, std::string objpath, std::string signal_name)
+    {
+        Subscribe(busname, objpath, signal_name, "");
+    }
+
+
     void Subscribe(std::string objpath, std::string signal_name)
     {
         Subscribe(bus_name, objpath, signal_name);
@@ -161,16 +192,24 @@ public:
     }
 
 
-    void Unsubscribe(std::string signal_name)
+    void Unsubscribe(std::string objpath, std::string signal_name)
     {
-        if (subscriptions[signal_name] > 0)
+        auto sub = subscriptions.find(SubscriptionKey(objpath, signal_name));
+        if (subscriptions.end() != sub && sub->second > 0)
         {
-            g_dbus_connection_signal_unsubscribe(conn, subscriptions[signal_name]);
-            subscriptions[signal_name] = 0;
+            g_dbus_connection_signal_unsubscribe(conn, sub->second);
+            DBusResourceUsage::SignalUnsubscribed();
+            sub->second = 0;
         }
     }
 
 
+    void Unsubscribe(std::string signal_name)
+    {
+        Unsubscribe(object_path, signal_name);
+    }
+
+
     std::string GetBusName()
     {
         return bus_name;
@@ -191,7 +230,8 @@ public:
 
     guint GetSignalId(std::string signal_name)
     {
-        return subscriptions[signal_name];
+        auto sub = subscriptions.find(SubscriptionKey(object_path, signal_name));
+        return (subscriptions.end() != sub ? sub->second : 0);
     }
 
 
@@ -210,8 +250,9 @@ public:
             if (sub.second > 0)
             {
                 g_dbus_connection_signal_unsubscribe(conn, sub.second);
+                DBusResourceUsage::SignalUnsubscribed();
             }
-            subscriptions[sub.first] = 0;
+            sub.second = 0;
         }
         subscribed = false;
     }
@@ -243,11 +284,14 @@ protected:
 
 
 private:
+    /** Subscriptions are tracked per object path and signal name */
+    using SubscriptionKey = std::pair<std::string, std::string>;
+
     GDBusConnection *conn;
     std::string bus_name;
     std::string interface;
     std::string object_path;
-    std::map<std::string, guint> subscriptions;
+    std::map<SubscriptionKey, guint> subscriptions;
     bool subscribed = false;
 };
 
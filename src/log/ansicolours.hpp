@@ -25,16 +25,32 @@
 
 #pragma once
 
+#include <array>
+
 #include "colourengine.hpp"
 
 /**
  *  Class implementing the ColourEngine to be used to make
- *  output to terminals colourful
+ *  output to terminals colourful.
+ *
+ *  The escape sequences for all log groups and categories are prepared
+ *  when the object is created, so looking up the colours of a log line
+ *  does not build any strings.
  */
 class ANSIColours : public ColourEngine
 {
 public:
-    ANSIColours() = default;
+    ANSIColours()
+    {
+        for (uint8_t g = 0; g < LogGroupCount; ++g)
+        {
+            group_colours[g] = make_group_colour((LogGroup) g);
+        }
+        for (uint8_t c = 0; c < category_colours.size(); ++c)
+        {
+            category_colours[c] = make_category_colour((LogCategory) c);
+        }
+    }
     ~ANSIColours() override = default;
 
     const std::string Set(Colour foreground, Colour background) override
@@ -144,14 +160,41 @@ public:
     }
 
 
-    const std::string Reset() override
+    const std::string& Reset() override
+    {
+        return reset;
+    }
+
+
+
+    const std::string& ColourByGroup(LogGroup grp) override
     {
-        return "\033[0m";
+        if ((uint8_t) grp >= group_colours.size())
+        {
+            return no_colour;
+        }
+        return group_colours[(uint8_t) grp];
     }
 
 
+    const std::string& ColourByCategory(LogCategory ctg) override
+    {
+        if ((uint8_t) ctg >= category_colours.size())
+        {
+            return no_colour;
+        }
+        return category_colours[(uint8_t) ctg];
+    }
+
+
+private:
+    const std::string reset = "\033[0m";
+    const std::string no_colour = "";
+    std::array<std::string, LogGroupCount> group_colours;
+    std::array<std::string, 9> category_colours;  // Size of LogCategory_str
+
 
-    const std::string ColourByGroup(LogGroup grp) override
+    std::string make_group_colour(LogGroup grp)
     {
         switch(grp)
         {
@@ -187,7 +230,7 @@ public:
     }
 
 
-    const std::string ColourByCategory(LogCategory ctg) override
+    std::string make_category_colour(LogCategory ctg)
     {
         switch(ctg)
         {
@@ -78,7 +78,7 @@ public:
      *
      * @return  Returns the string needed to reset the colour to default
      */
-    virtual const std::string Reset() = 0;
+    virtual const std::string& Reset() = 0;
 
 
     /**
@@ -107,25 +107,28 @@ public:
     }
 
     /**
-     *  Provides the colours to be used for a specific LogGroup type
+     *  Provides the colours to be used for a specific LogGroup type.
+     *  This is called for every log line written, so implementations
+     *  should return a prepared string and not build it on each call.
      *
      * @param grp  LogGroup of the colour scheme to retrieve
      *
      * @return  Returns a std::string to be used to set the colour
      *
      */
-    virtual const std::string ColourByGroup(LogGroup grp) = 0;
+    virtual const std::string& ColourByGroup(LogGroup grp) = 0;
 
 
     /**
-     *  Provides the colours to be used for a specific LogCategory type
+     *  Provides the colours to be used for a specific LogCategory type.
+     *  Like ColourByGroup(), this is called for every log line written.
      *
      * @param ctg  LogCategory of the colour scheme to retrieve
      *
      * @return  Returns a std::string to be used to set the colour
      *
      */
-    virtual const std::string ColourByCategory(LogCategory ctg) = 0;
+    virtual const std::string& ColourByCategory(LogCategory ctg) = 0;
 
 
     /**
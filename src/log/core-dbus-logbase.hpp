@@ -29,10 +29,13 @@
 
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #include <openvpn/log/logbase.hpp>
 
 #include "dbus/core.hpp"
+#include "common/mpsc-queue.hpp"
 #include "log/dbus-log.hpp"
 
 namespace openvpn {
@@ -45,6 +48,12 @@ namespace openvpn {
  *  Logging from the Core library is quite low-level and since
  *  the logging interface in the library does not define any log
  *  levels, these events will be handled as debug log messages.
+ *
+ *  The Core library logs from its own thread.  That thread only checks
+ *  an atomic flag and queues the message on a lock-free queue; the
+ *  Log signals are sent from the GLib main loop.  The queueing is
+ *  serialized with the destructor, so no flush is scheduled for an
+ *  object being destroyed.
  */
 class CoreDBusLogBase : public LogBase,
                         public LogSender
@@ -73,14 +82,81 @@ public:
         Debug("OpenVPN 3 Core library logging initialized");
     }
 
+    ~CoreDBusLogBase()
+    {
+        // The Core library may log until log_context is torn down;
+        // stop it from scheduling flushes before removing them
+        {
+            std::lock_guard<std::mutex> guard(producer_mtx);
+            shutting_down = true;
+        }
+        while (g_source_remove_by_user_data(this))
+        {
+        }
+        flush_queue();
+    }
+
+
+    /**
+     *  Sets the log level, and updates the flag the Core library thread
+     *  checks.
+     *
+     * @param loglev  unsigned int with the log level to use
+     */
+    void SetLogLevel(unsigned int loglev) override
+    {
+        LogSender::SetLogLevel(loglev);
+        core_log_enabled.store(LogEnabled(LogCategory::DEBUG),
+                               std::memory_order_relaxed);
+    }
+
+
     virtual void log(const std::string& str) override
     {
-        std::string l(str);
-        l.erase(l.find_last_not_of(" \n")+1); // rtrim
-        Debug("[Core] " + l);
+        // Don't prepare anything if the log event will be discarded
+        if (!core_log_enabled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        std::string l("[Core] ");
+        l.append(str, 0, str.find_last_not_of(" \n") + 1); // rtrim
+
+        // Only the first message of a batch schedules the flush
+        std::lock_guard<std::mutex> guard(producer_mtx);
+        if (shutting_down)
+        {
+            return;
+        }
+        if (queue.Push(std::move(l)))
+        {
+            g_idle_add(idle_flush, this);
+        }
     }
 
 private:
+    std::atomic<bool> core_log_enabled{false};
+    MPSCQueue<std::string> queue;
+    std::mutex producer_mtx;      ///< Guards shutting_down and the queueing
+    bool shutting_down = false;
+
+    // Declared last, so the Core library stops using this object
+    // before the members above are destroyed
     Log::Context log_context;
+
+
+    void flush_queue()
+    {
+        for (auto& msg : queue.PopAll())
+        {
+            Debug(std::move(msg));
+        }
+    }
+
+
+    static gboolean idle_flush(gpointer this_ptr)
+    {
+        static_cast<CoreDBusLogBase *>(this_ptr)->flush_queue();
+        return G_SOURCE_REMOVE;
+    }
 };
 } // namespace openvpn
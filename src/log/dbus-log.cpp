@@ -23,6 +23,8 @@
  * @brief  Implementation of the OpenVPN 3 Linux D-Bus logging based interface
  */
 
+#include <utility>
+
 #include "dbus-log.hpp"
 
 
@@ -33,6 +35,7 @@
 LogFilter::LogFilter(unsigned int loglvl) noexcept
         : log_level(loglvl)
 {
+    build_allow_map();
 }
 
 
@@ -43,6 +46,7 @@ void LogFilter::SetLogLevel(unsigned int loglev)
         THROW_LOGEXCEPTION("LogSender: Invalid log level");
     }
     log_level = loglev;
+    build_allow_map();
 }
 
 
@@ -54,41 +58,89 @@ unsigned int LogFilter::GetLogLevel() noexcept
 
 void LogFilter::AddPathFilter(const std::string& path)
 {
-    filter_paths.push_back(path);
-    std::sort(filter_paths.begin(), filter_paths.end());
+    filter_paths.insert(path);
+}
+
+
+void LogFilter::RemovePathFilter(const std::string& path)
+{
+    filter_paths.erase(path);
+}
+
+
+void LogFilter::AddExcludeFilter(const LogGroup group)
+{
+    uint8_t g = (uint8_t) group;
+    excluded_groups |= (1 << (g < LogGroupCount ? g : 0));
+    build_allow_map();
+}
+
+
+void LogFilter::RemoveExcludeFilter(const LogGroup group)
+{
+    uint8_t g = (uint8_t) group;
+    excluded_groups &= ~(1 << (g < LogGroupCount ? g : 0));
+    build_allow_map();
+}
+
+
+bool LogFilter::LogFilterAllow(const LogEvent& logev) const noexcept
+{
+    return LogFilterAllow(logev.group, logev.category);
+}
+
+
+bool LogFilter::LogFilterAllow(const LogGroup group,
+                               const LogCategory category) const noexcept
+{
+    uint8_t g = (uint8_t) group;
+    uint8_t c = (uint8_t) category;
+    return allow_map[g < LogGroupCount ? g : 0] & (1 << (c < 15 ? c : 15));
 }
 
 
-bool LogFilter::LogFilterAllow(const LogEvent& logev) noexcept
+bool LogFilter::LogFilterAllow(const LogCategory category) const noexcept
 {
-    switch(logev.category)
+    uint8_t c = (uint8_t) category;
+    return allowed_categories & (1 << (c < 15 ? c : 15));
+}
+
+
+void LogFilter::build_allow_map() noexcept
+{
+    // Everything not covered by the log level is always allowed, this
+    // includes LogCategory::UNDEFINED and unknown categories
+    allowed_categories = 0xffff;
+    const std::array<std::pair<LogCategory, unsigned int>, 6> min_level = {{
+        {LogCategory::DEBUG, 6},
+        {LogCategory::VERB2, 5},
+        {LogCategory::VERB1, 4},
+        {LogCategory::INFO, 3},
+        {LogCategory::WARN, 2},
+        {LogCategory::ERROR, 1}
+    }};
+    for (const auto& m : min_level)
     {
-    case LogCategory::DEBUG:
-        return log_level >= 6;
-    case LogCategory::VERB2:
-        return log_level >= 5;
-    case LogCategory::VERB1:
-        return log_level >= 4;
-    case LogCategory::INFO:
-        return log_level >= 3;
-    case LogCategory::WARN:
-        return log_level >= 2;
-    case LogCategory::ERROR:
-        return log_level >= 1;
-    default:
-        return true;
+        if (log_level < m.second)
+        {
+            allowed_categories &= ~(1 << (uint8_t) m.first);
+        }
+    }
+
+    for (uint8_t g = 0; g < LogGroupCount; ++g)
+    {
+        allow_map[g] = (excluded_groups & (1 << g) ? 0 : allowed_categories);
     }
 }
 
 
 bool LogFilter::AllowPath(const std::string& path) noexcept
 {
-    if (filter_paths.size() < 1)
+    if (filter_paths.empty())
     {
         return true;
     }
-    auto r = std::lower_bound(filter_paths.begin(), filter_paths.end(), path);
-    return r != filter_paths.end();
+    return filter_paths.end() != filter_paths.find(path);
 }
 
 
@@ -148,7 +200,7 @@ void LogSender::ProxyLog(const LogEvent& logev, const std::string& path)
         {
             return;
         }
-        Send("Log", logev.GetGVariantTuple());
+        Send("Log", logev.GetGVariantTuple(send_fields));
     }
 }
 
@@ -165,6 +217,11 @@ void LogSender::ProxyStatusChange(const StatusEvent& status, const std::string&
 void LogSender::Log(const LogEvent& logev, bool duplicate_check,
                     const std::string& target)
 {
+    if (log_history && !logev.empty())
+    {
+        log_history->Add(logev);
+    }
+
     // Don't log an empty messages or if log level filtering allows it
     // The filtering is done against the LogCategory of the message
     if (logev.empty() || !LogFilterAllow(logev))
@@ -182,72 +239,174 @@ void LogSender::Log(const LogEvent& logev, bool duplicate_check,
     }
     last_logevent = logev;
 
+    if (rate_limiter)
+    {
+        LogEvent notice;
+        bool allow = rate_limiter->Allow(logev, notice);
+        if (!notice.empty())
+        {
+            send_log(notice, target);
+        }
+        if (!allow)
+        {
+            return;
+        }
+    }
+    send_log(logev, target);
+}
+
+
+void LogSender::send_log(const LogEvent& logev, const std::string& target)
+{
     if( logwr )
     {
         logwr->Write(logev);
     }
 
-    SendTarget(target, "Log", logev.GetGVariantTuple());
+    SendTarget(target, "Log", logev.GetGVariantTuple(send_fields));
 }
 
 
 void LogSender::Debug(std::string msg, bool duplicate_check)
 {
-    Log(LogEvent(log_group, LogCategory::DEBUG, msg), duplicate_check);
+    if (!LogEnabled(LogCategory::DEBUG))
+    {
+        return;
+    }
+    Log(LogEvent(log_group, LogCategory::DEBUG, std::move(msg)), duplicate_check);
 }
 
 
 void LogSender::LogVerb2(std::string msg, bool duplicate_check)
 {
-    Log(LogEvent(log_group, LogCategory::VERB2, msg), duplicate_check);
+    if (!LogEnabled(LogCategory::VERB2))
+    {
+        return;
+    }
+    Log(LogEvent(log_group, LogCategory::VERB2, std::move(msg)), duplicate_check);
 }
 
 
 void LogSender::LogVerb1(std::string msg, bool duplicate_check)
 {
-    Log(LogEvent(log_group, LogCategory::VERB1, msg), duplicate_check);
+    if (!LogEnabled(LogCategory::VERB1))
+    {
+        return;
+    }
+    Log(LogEvent(log_group, LogCategory::VERB1, std::move(msg)), duplicate_check);
 }
 
 
 void LogSender::LogInfo(std::string msg, bool duplicate_check)
 {
-    Log(LogEvent(log_group, LogCategory::INFO, msg), duplicate_check);
+    if (!LogEnabled(LogCategory::INFO))
+    {
+        return;
+    }
+    Log(LogEvent(log_group, LogCategory::INFO, std::move(msg)), duplicate_check);
 }
 
 
 void LogSender::LogWarn(std::string msg, bool duplicate_check)
 {
-    Log(LogEvent(log_group, LogCategory::WARN, msg), duplicate_check);
+    if (!LogEnabled(LogCategory::WARN))
+    {
+        return;
+    }
+    Log(LogEvent(log_group, LogCategory::WARN, std::move(msg)), duplicate_check);
 }
 
 
 void LogSender::LogError(std::string msg)
 {
-    Log(LogEvent(log_group, LogCategory::ERROR, msg));
+    if (!LogEnabled(LogCategory::ERROR))
+    {
+        return;
+    }
+    Log(LogEvent(log_group, LogCategory::ERROR, std::move(msg)));
 }
 
 
 void LogSender::LogCritical(std::string msg)
 {
     // Critical log messages will always be sent
-    Log(LogEvent(log_group, LogCategory::CRIT, msg));
+    Log(LogEvent(log_group, LogCategory::CRIT, std::move(msg)));
 }
 
 
 void LogSender::LogFATAL(std::string msg)
 {
     // Fatal log messages will always be sent
-    Log(LogEvent(log_group, LogCategory::FATAL, msg));
+    Log(LogEvent(log_group, LogCategory::FATAL, std::move(msg)));
     // FIXME: throw something here, to start shutdown procedures
 }
 
 
+bool LogSender::LogEnabled(const LogCategory category) noexcept
+{
+    // The log history records log events regardless of the log level
+    return log_history || LogFilterAllow(category);
+}
+
+
+void LogSender::LogStructured(const LogCategory category, std::string msg,
+                              LogFields fields)
+{
+    LogEvent ev(log_group, category, std::move(msg));
+    ev.fields = std::move(fields);
+    Log(ev);
+}
+
+
 LogEvent LogSender::GetLastLogEvent() const
 {
     return LogEvent(last_logevent);
 }
 
 
+void LogSender::EnableLogHistory(const size_t size)
+{
+    log_history.reset(size > 0 ? new LogHistory(size) : nullptr);
+}
+
+
+std::vector<LogEvent> LogSender::GetLogHistory(const size_t max_events) const
+{
+    if (!log_history)
+    {
+        return {};
+    }
+    return log_history->GetLast(max_events);
+}
+
+
+std::vector<LogEvent> LogSender::GetLogHistorySince(uint64_t& position) const
+{
+    if (!log_history)
+    {
+        return {};
+    }
+    return log_history->GetSince(position);
+}
+
+
+void LogSender::SetRateLimit(const unsigned int rate, const unsigned int burst)
+{
+    if (0 == rate)
+    {
+        rate_limiter.reset();
+        return;
+    }
+    rate_limiter.reset(new LogRateLimiter(rate, burst));
+}
+
+
+void LogSender::SendLogFields(const bool enable) noexcept
+{
+    send_fields = enable;
+}
+
+
 LogWriter * LogSender::GetLogWriter()
 {
     return logwr;
@@ -268,6 +427,51 @@ LogConsumer::LogConsumer(GDBusConnection *dbuscon,
 }
 
 
+void LogConsumer::AddPathFilter(const std::string& path)
+{
+    LogFilter::AddPathFilter(path);
+    if (!GetObjectPath().empty())
+    {
+        // The subscription is already restricted to a single object path
+        return;
+    }
+
+    if (!path_filtered)
+    {
+        // Replace the subscription to Log signals from any object path
+        Unsubscribe("Log");
+        path_filtered = true;
+    }
+    Subscribe(path, "Log");
+}
+
+
+LogCategory LogConsumer::peek_log_category(GVariant *params) noexcept
+{
+    // Log signals are sent as (uus), (uuss) or (uussay) tuples, where
+    // the second element is the log category
+    if (nullptr == params
+        || !g_variant_is_of_type(params, G_VARIANT_TYPE_TUPLE)
+        || g_variant_n_children(params) < 3)
+    {
+        return LogCategory::UNDEFINED;
+    }
+
+    GVariant *c = g_variant_get_child_value(params, 1);
+    LogCategory ret = LogCategory::UNDEFINED;
+    if (g_variant_is_of_type(c, G_VARIANT_TYPE_UINT32))
+    {
+        guint32 v = g_variant_get_uint32(c);
+        if (v <= (guint32) LogCategory::FATAL)
+        {
+            ret = (LogCategory) v;
+        }
+    }
+    g_variant_unref(c);
+    return ret;
+}
+
+
 void LogConsumer::callback_signal_handler(GDBusConnection *connection,
                                           const std::string sender_name,
                                           const std::string obj_path,
@@ -22,12 +22,16 @@
 #include <fstream>
 #include <ctime>
 #include <exception>
+#include <array>
 #include <string>
+#include <unordered_set>
 
 #include "dbus/core.hpp"
 #include "client/statusevent.hpp"
 #include "log-helpers.hpp"
 #include "logevent.hpp"
+#include "loghistory.hpp"
+#include "lograte.hpp"
 #include "logwriter.hpp"
 
 
@@ -44,7 +48,7 @@ public:
      * @param log_level unsigned int of the default log level
      */
     LogFilter(unsigned int log_level_val) noexcept;
-    ~LogFilter() = default;
+    virtual ~LogFilter() = default;
 
     /**
      *  Sets the log level.  This filters which log messages will
@@ -60,7 +64,7 @@ public:
      *
      * @param loglev  unsigned int with the log level to use
      */
-    void SetLogLevel(unsigned int loglev);
+    virtual void SetLogLevel(unsigned int loglev);
 
     /**
      * Retrieves the log level in use
@@ -80,6 +84,33 @@ public:
     void AddPathFilter(const std::string& path);
 
 
+    /**
+     *  Removes a path from the path filtering.  Once the last path is
+     *  removed, the filter no longer restricts anything.
+     *
+     * @param path  std::string containing the D-Bus object path to remove
+     */
+    void RemovePathFilter(const std::string& path);
+
+
+    /**
+     *  Excludes all log events of a LogGroup, regardless of the log level.
+     *  Log groups not known to this version are treated as
+     *  LogGroup::UNDEFINED.
+     *
+     * @param group  LogGroup to exclude
+     */
+    void AddExcludeFilter(const LogGroup group);
+
+
+    /**
+     *  Removes a LogGroup exclusion added by AddExcludeFilter()
+     *
+     * @param group  LogGroup to no longer exclude
+     */
+    void RemoveExcludeFilter(const LogGroup group);
+
+
 protected:
     /**
      * Checks if the LogCategory matches a log level where
@@ -91,7 +122,32 @@ protected:
      * @return  Returns true if this LogEvent should be logged, based
      *          on the log category in the LogEvent object
      */
-    bool LogFilterAllow(const LogEvent& logev) noexcept;
+    bool LogFilterAllow(const LogEvent& logev) const noexcept;
+
+
+    /**
+     *  Checks if log events of a LogGroup and LogCategory should be
+     *  logged, considering both the log level and the excluded log
+     *  groups
+     *
+     * @param group     LogGroup to check
+     * @param category  LogCategory to check
+     *
+     * @return  Returns true if the log event should be logged
+     */
+    bool LogFilterAllow(const LogGroup group,
+                        const LogCategory category) const noexcept;
+
+
+    /**
+     * Checks if the LogCategory matches a log level where
+     * logging should happen.  Excluded log groups are not considered.
+     *
+     * @param category  LogCategory to check
+     *
+     * @return  Returns true if this LogCategory should be logged
+     */
+    bool LogFilterAllow(const LogCategory category) const noexcept;
 
 
     /**
@@ -106,7 +162,22 @@ protected:
 
 private:
     unsigned int log_level;
-    std::vector<std::string> filter_paths;
+    std::unordered_set<std::string> filter_paths;
+
+    /// Bit mask of the excluded log groups
+    uint16_t excluded_groups = 0;
+
+    /// Bit mask of the LogCategory values passing the log level
+    uint16_t allowed_categories = 0;
+
+    /**
+     *  Bit mask of the allowed LogCategory values for each LogGroup,
+     *  rebuilt whenever the log level or the excluded groups change.
+     *  Categories beyond LogCategory::FATAL use the last bit.
+     */
+    std::array<uint16_t, LogGroupCount> allow_map;
+
+    void build_allow_map() noexcept;
 };
 
 
@@ -124,8 +195,8 @@ public:
 
     void StatusChange(const StatusEvent& statusev);
 
-    void ProxyLog(const LogEvent& logev, const std::string& path = "");
-    void ProxyStatusChange(const StatusEvent& status, const std::string& path);
+    virtual void ProxyLog(const LogEvent& logev, const std::string& path = "");
+    virtual void ProxyStatusChange(const StatusEvent& status, const std::string& path);
 
     virtual void Log(const LogEvent& logev, bool duplicate_check = false,
                      const std::string& target ="");
@@ -137,16 +208,99 @@ public:
     virtual void LogError(std::string msg);
     virtual void LogCritical(std::string msg);
     virtual void LogFATAL(std::string msg);
+
+    /**
+     *  Sends a log event with log fields, see LogEvent::fields
+     *
+     * @param category  LogCategory of the log event
+     * @param msg       std::string with the log message
+     * @param fields    LogFields describing the log event
+     */
+    void LogStructured(const LogCategory category, std::string msg,
+                       LogFields fields);
+
     LogEvent GetLastLogEvent() const;
 
+    /**
+     *  Checks if a log event of a specific LogCategory would be processed
+     *  at all.  This can be used to avoid preparing log messages which
+     *  will be discarded anyway.
+     *
+     * @param category  LogCategory of the log event to check
+     *
+     * @return Returns true if a log event of this category is processed
+     */
+    bool LogEnabled(const LogCategory category) noexcept;
+
+    /**
+     *  Keep a history of the most recent log events.  All log events
+     *  are recorded, regardless of the current log level, so the history
+     *  can provide more details than what has been sent as Log signals.
+     *
+     * @param size  Number of log events to keep.  0 disables the history.
+     */
+    void EnableLogHistory(const size_t size);
+
+    /**
+     *  Retrieve the most recent log events from the log history,
+     *  oldest first.  Requires EnableLogHistory() to have been called.
+     *
+     * @param max_events  Maximum number of log events to return.  0
+     *                    returns the complete history.
+     *
+     * @return Returns a std::vector of LogEvent objects
+     */
+    std::vector<LogEvent> GetLogHistory(const size_t max_events) const;
+
+    /**
+     *  Retrieve the log events added to the log history after a previous
+     *  call, oldest first.  See LogHistory::GetSince().
+     *
+     * @param position  uint64_t with the position from the previous call,
+     *                  updated to the current position
+     *
+     * @return Returns a std::vector of LogEvent objects
+     */
+    std::vector<LogEvent> GetLogHistorySince(uint64_t& position) const;
+
+    /**
+     *  Limit the number of Log signals sent.  Identical log events sent
+     *  right after each other are collapsed into a single "repeated"
+     *  notice.  See LogRateLimiter for details.
+     *
+     * @param rate   Average number of log events per second.  0 disables
+     *               the rate limiting.
+     * @param burst  Number of log events allowed in a burst
+     */
+    void SetRateLimit(const unsigned int rate, const unsigned int burst);
+
+    /**
+     *  Send the log fields of log events, using the (uussay) Log signal.
+     *  Only enable this when the Log signals are sent to the log service
+     *  or the session manager, as other receivers expect the (uus) or
+     *  (uuss) Log signals.
+     *
+     * @param enable  bool, true to send the log fields
+     */
+    void SendLogFields(const bool enable) noexcept;
+
     LogWriter * GetLogWriter();
 
 protected:
     LogWriter *logwr = nullptr;
     LogGroup log_group;
 
+    /**
+     *  Writes a log event to the LogWriter and sends it as a Log signal,
+     *  without any filtering or rate limiting
+     */
+    virtual void send_log(const LogEvent& logev, const std::string& target);
+
 private:
     LogEvent last_logevent;
+    LogHistory::Ptr log_history = nullptr;
+    LogRateLimiter::Ptr rate_limiter = nullptr;
+    bool send_fields = false;
 };
 
 
@@ -166,6 +320,18 @@ public:
                                  const LogEvent& logev) = 0;
 
 
+    /**
+     *  Restricts the Log signals being consumed to a specific D-Bus
+     *  object path.  If the LogConsumer was set up to listen to any
+     *  object path, the wildcard subscription is replaced by one
+     *  subscription per allowed object path.  This lets the D-Bus daemon
+     *  drop Log signals from other objects before they are delivered.
+     *
+     * @param path  std::string containing the D-Bus object path to add
+     */
+    void AddPathFilter(const std::string& path);
+
+
     virtual void ProcessSignal(const std::string sender_name,
                                const std::string obj_path,
                                const std::string interface_name,
@@ -187,7 +353,8 @@ protected:
      *
      *  Default implementation passes the LogEvent to the ConsumeLogEvent()
      *  method if the log_level is high enough for the LogEvent (ie. not
-     *  filtered out)
+     *  filtered out).  The log category is checked before the complete
+     *  LogEvent is parsed, so filtered out Log signals are cheap.
      *
      */
     virtual void process_log_event(const std::string sender,
@@ -195,15 +362,36 @@ protected:
                                    const std::string obj_path,
                                    GVariant *params)
     {
+        if (!AllowPath(obj_path) || !LogFilterAllow(peek_log_category(params)))
+        {
+            return;
+        }
+
         // Pass the signal parameters to be parsed by LogEvent directly
         LogEvent logev(params);
-
         if (!LogFilterAllow(logev))
         {
             return;
         }
         ConsumeLogEvent(sender, interface_name, obj_path, logev);
     }
+
+
+    /**
+     *  Extract the log category of a Log signal without parsing the
+     *  complete signal.
+     *
+     * @param params  GVariant object containing the Log signal parameters
+     *
+     * @return Returns the LogCategory of the Log signal.  If it cannot be
+     *         extracted, LogCategory::UNDEFINED is returned, which is
+     *         never filtered out.
+     */
+    static LogCategory peek_log_category(GVariant *params) noexcept;
+
+
+private:
+    bool path_filtered = false;
 };
 
 
@@ -27,10 +27,12 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <string>
 
 #include "dbus-log.hpp"
+#include "log-compact.hpp"
 #include "sessionmgr/proxy-sessionmgr.hpp"
 
 template <typename C>
@@ -48,6 +50,12 @@ using LogFwdProcessor = std::shared_ptr<C>;
  *  The implementing class need to implement the @ConsumeLogEvent method
  *  as well as @ProcessSignal for handling StatusChange events.
  *
+ *  A LogForwardBase object can also receive the log events of many VPN
+ *  sessions at once, see @AddSession.  The log service forwards them all
+ *  through a single log proxy and the events are received through a
+ *  single set of signal subscriptions.  The obj_path argument passed on
+ *  to the implementation identifies the VPN session of each event.
+ *
  *  @tparam C   The class name of the class implementing LogForwardBase
  */
 template<typename C>
@@ -77,7 +85,62 @@ public:
      */
     const unsigned int GetLogLevel() const
     {
-        return session_proxy->GetUIntProperty("log_verbosity");
+        if (session_proxies.empty())
+        {
+            THROW_DBUSEXCEPTION("LogForwardBase", "No session attached");
+        }
+        return session_proxies.begin()->second->GetUIntProperty("log_verbosity");
+    }
+
+
+    /**
+     *  Start receiving the log events of one more VPN session.  This is
+     *  only available if the object was created without a session path.
+     *
+     * @param session_path  std::string with the D-Bus object path of the
+     *                      VPN session
+     */
+    void AddSession(const std::string& session_path)
+    {
+        if (!GetObjectPath().empty())
+        {
+            THROW_DBUSEXCEPTION("LogForwardBase",
+                                "Already tied to a single session");
+        }
+        if (session_proxies.find(session_path) != session_proxies.end())
+        {
+            return;
+        }
+        enable_forwarding(session_path);
+    }
+
+
+    /**
+     *  Stop receiving the log events of a VPN session added by
+     *  @AddSession
+     *
+     * @param session_path  std::string with the D-Bus object path of the
+     *                      VPN session
+     */
+    void RemoveSession(const std::string& session_path)
+    {
+        auto it = session_proxies.find(session_path);
+        if (session_proxies.end() == it)
+        {
+            return;
+        }
+        disable_forwarding(it->second);
+        session_proxies.erase(it);
+    }
+
+
+    /**
+     * @return Returns the number of VPN sessions log events are
+     *         received from
+     */
+    size_t GetSessionCount() const
+    {
+        return session_proxies.size();
     }
 
 
@@ -128,36 +191,144 @@ public:
 
 
 protected:
+    /**
+     *  Sets up the log forwarding for a VPN session.
+     *
+     * @param dbusc             DBus object with the connection to use
+     * @param interf            std::string with the D-Bus interface of the
+     *                          Log signals
+     * @param session_path      std::string with the D-Bus object path of
+     *                          the VPN session
+     * @param batch_max_events  If not 0, the log service will send the log
+     *                          events in LogBatch signals carrying up to this
+     *                          many log events each
+     * @param batch_interval    Maximum time in milliseconds the log service
+     *                          holds back batched log events
+     * @param compact           If true, ask for LogCompact signals.  If the
+     *                          session manager does not support it, the
+     *                          regular Log or LogBatch signals are used.
+     */
     LogForwardBase(DBus& dbusc,
                    const std::string& interf,
-                   const std::string& session_path)
-       : LogConsumer(dbusc.GetConnection(), interf, session_path, "")
+                   const std::string& session_path,
+                   const unsigned int batch_max_events = 0,
+                   const unsigned int batch_interval = 0,
+                   const bool compact = false)
+       : LogConsumer(dbusc.GetConnection(), interf, session_path, ""),
+         dbus(dbusc), batch_max_events(batch_max_events),
+         batch_interval(batch_interval), compact(compact)
     {
         Subscribe(session_path, "StatusChange");
-        session_proxy.reset(new OpenVPN3SessionProxy(dbusc, session_path));
-        session_proxy->LogForward(true);
+        enable_forwarding(session_path);
+    }
+
+
+    /**
+     *  Prepares receiving the log events of many VPN sessions, which are
+     *  added using @AddSession.  Only signals sent by the log service are
+     *  received.
+     *
+     *  See the constructor above for the arguments.
+     */
+    LogForwardBase(DBus& dbusc,
+                   const std::string& interf,
+                   const unsigned int batch_max_events,
+                   const unsigned int batch_interval,
+                   const bool compact)
+       : LogConsumer(dbusc.GetConnection(), interf, "", OpenVPN3DBus_name_log),
+         dbus(dbusc), batch_max_events(batch_max_events),
+         batch_interval(batch_interval), compact(compact)
+    {
+        Subscribe("StatusChange");
     }
 
+
     ~LogForwardBase()
     {
-        if (session_proxy && !session_closed)
+        for (const auto& it : session_proxies)
+        {
+            disable_forwarding(it.second);
+        }
+    }
+
+
+private:
+    DBus& dbus;
+    const unsigned int batch_max_events;
+    const unsigned int batch_interval;
+    const bool compact;
+    bool subscribed_batch = false;
+    bool subscribed_compact = false;
+    std::map<std::string, OpenVPN3SessionProxy::Ptr> session_proxies = {};
+
+
+    /**
+     *  Asks the session manager to forward the log events of a VPN
+     *  session, in the format requested when creating this object
+     */
+    void enable_forwarding(const std::string& session_path)
+    {
+        OpenVPN3SessionProxy::Ptr sessprx;
+        sessprx.reset(new OpenVPN3SessionProxy(dbus, session_path));
+        if (compact)
         {
             try
             {
-                session_proxy->LogForward(false);
+                subscribe_once(subscribed_compact, "LogCompact");
+                sessprx->LogForwardCompact(batch_max_events, batch_interval);
+                session_proxies[session_path] = sessprx;
+                return;
             }
             catch (const DBusException&)
             {
-                // Ignore errors related to disabling the log forwarding
-                // here.  The session might already be closed
+                // Older session manager; use the variant based signals
             }
         }
+        if (batch_max_events > 0)
+        {
+            subscribe_once(subscribed_batch, "LogBatch");
+            sessprx->LogForwardBatch(batch_max_events, batch_interval);
+        }
+        else
+        {
+            sessprx->LogForward(true);
+        }
+        session_proxies[session_path] = sessprx;
     }
 
 
-private:
-    OpenVPN3SessionProxy::Ptr session_proxy = {};
-    bool session_closed = false;
+    void disable_forwarding(OpenVPN3SessionProxy::Ptr sessprx)
+    {
+        try
+        {
+            sessprx->LogForward(false);
+        }
+        catch (const DBusException&)
+        {
+            // Ignore errors related to disabling the log forwarding
+            // here.  The session might already be closed
+        }
+    }
+
+
+    void subscribe_once(bool& subscribed, const std::string& signal_name)
+    {
+        if (!subscribed)
+        {
+            Subscribe(GetObjectPath(), signal_name);
+            subscribed = true;
+        }
+    }
+
+
+    /**
+     *  The session is closing, so there is no log forwarding left
+     *  to disable
+     */
+    void session_closed(const std::string& obj_path)
+    {
+        session_proxies.erase(obj_path.empty() ? GetObjectPath() : obj_path);
+    }
 
 
     void ProcessSignal(const std::string sender_name,
@@ -171,10 +342,20 @@ private:
             StatusEvent status(parameters);
             if (status.Check(StatusMajor::CONNECTION, StatusMinor::CONN_DISCONNECTED))
             {
-                session_closed = true;
+                session_closed(obj_path);
             }
             StatusChangeEvent(sender_name, obj_path, interface_name, status);
         }
+        else if ("LogBatch" == signal_name)
+        {
+            process_log_batch(sender_name, obj_path, interface_name,
+                              parameters);
+        }
+        else if ("LogCompact" == signal_name)
+        {
+            process_log_compact(sender_name, obj_path, interface_name,
+                                parameters);
+        }
         else
         {
             SignalHandler(sender_name, obj_path, interface_name, signal_name,
@@ -182,4 +363,96 @@ private:
         }
 
     }
+
+
+    /**
+     *  Unpacks a LogBatch signal and passes each log event to the
+     *  ConsumeLogEvent() method, in the order they were queued.
+     */
+    void process_log_batch(const std::string& sender_name,
+                           const std::string& obj_path,
+                           const std::string& interface_name,
+                           GVariant *parameters)
+    {
+        if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(a(uus))")))
+        {
+            return;
+        }
+
+        GVariantIter *events = nullptr;
+        g_variant_get(parameters, "(a(uus))", &events);
+        GVariant *ev = nullptr;
+        while (nullptr != (ev = g_variant_iter_next_value(events)))
+        {
+            LogEvent logev(ev);
+            g_variant_unref(ev);
+            if (LogFilterAllow(logev))
+            {
+                ConsumeLogEvent(sender_name, interface_name, obj_path, logev);
+            }
+        }
+        g_variant_iter_free(events);
+    }
+
+
+    /**
+     *  Decodes a LogCompact signal.  Log events are checked against the
+     *  log level before any strings are copied.  Status changes are
+     *  handled as StatusChange signals.
+     */
+    void process_log_compact(const std::string& sender_name,
+                             const std::string& obj_path,
+                             const std::string& interface_name,
+                             GVariant *parameters)
+    {
+        if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(ay)")))
+        {
+            return;
+        }
+
+        GVariant *events = g_variant_get_child_value(parameters, 0);
+        gsize len = 0;
+        const uint8_t *data = static_cast<const uint8_t *>(
+                g_variant_get_fixed_array(events, &len, sizeof(uint8_t)));
+
+        CompactEvent::Reader reader(data, len);
+        CompactEvent::Record rec;
+        while (reader.Next(rec))
+        {
+            if (CompactEvent::Type::STATUS == rec.type)
+            {
+                StatusEvent status((StatusMajor) rec.field1,
+                                   (StatusMinor) rec.field2,
+                                   rec.Message());
+                if (status.Check(StatusMajor::CONNECTION,
+                                 StatusMinor::CONN_DISCONNECTED))
+                {
+                    session_closed(obj_path);
+                }
+                StatusChangeEvent(sender_name, obj_path, interface_name,
+                                  status);
+                continue;
+            }
+
+            if (!LogFilterAllow((LogCategory) rec.field2))
+            {
+                continue;
+            }
+            LogEvent logev = (rec.token_len > 0
+                              ? LogEvent((LogGroup) rec.field1,
+                                         (LogCategory) rec.field2,
+                                         rec.Token(), rec.Message())
+                              : LogEvent((LogGroup) rec.field1,
+                                         (LogCategory) rec.field2,
+                                         rec.Message()));
+            if (rec.fields)
+            {
+                // Log fields which cannot be decoded are dropped; the
+                // message itself is still useful
+                logev.fields.Decode(rec.fields, rec.fields_len);
+            }
+            ConsumeLogEvent(sender_name, interface_name, obj_path, logev);
+        }
+        g_variant_unref(events);
+    }
 };
@@ -0,0 +1,177 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018 - 2022  OpenVPN, Inc. <sales@openvpn.net>
+//  Copyright (C) 2018 - 2022  David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+/**
+ * @file   ingest-shards.cpp
+ *
+ * @brief  Implementation of LogIngestShards
+ */
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+#include "log/log-helpers.hpp"
+#include "log/logwriters/async.hpp"
+#include "log/ingest-shards.hpp"
+
+
+/**
+ *  A function passed to a shard by LogIngestShards::Run()
+ */
+struct ShardCall
+{
+    std::function<void()> fn;
+    std::exception_ptr error = nullptr;
+    bool done = false;
+    std::mutex mtx;
+    std::condition_variable done_cv;
+};
+
+
+static gboolean shard_call_cb(gpointer data)
+{
+    ShardCall *call = static_cast<ShardCall *>(data);
+    try
+    {
+        call->fn();
+    }
+    catch (...)
+    {
+        call->error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lg(call->mtx);
+    call->done = true;
+    call->done_cv.notify_one();
+    return G_SOURCE_REMOVE;
+}
+
+
+static gboolean shard_quit_cb(gpointer loop)
+{
+    g_main_loop_quit(static_cast<GMainLoop *>(loop));
+    return G_SOURCE_REMOVE;
+}
+
+
+LogIngestShards::LogIngestShards(const unsigned int count, LogWriter *logwr)
+    : logwr(logwr)
+{
+    if (0 == count)
+    {
+        return;
+    }
+
+    AsyncLogWriter *async = dynamic_cast<AsyncLogWriter *>(logwr);
+    if (!async)
+    {
+        THROW_LOGEXCEPTION("Log ingest threads require the log queue");
+    }
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        std::unique_ptr<Shard> s(new Shard);
+        s->context = g_main_context_new();
+        s->loop = g_main_loop_new(s->context, FALSE);
+        s->writer = async->NewProducer();
+
+        Shard *sp = s.get();
+        s->thread = std::thread([sp]()
+                                {
+                                    // Signal subscriptions made on this
+                                    // thread are dispatched here
+                                    g_main_context_push_thread_default(sp->context);
+                                    g_main_loop_run(sp->loop);
+                                    g_main_context_pop_thread_default(sp->context);
+                                });
+        shards.push_back(std::move(s));
+    }
+}
+
+
+LogIngestShards::~LogIngestShards()
+{
+    for (auto& s : shards)
+    {
+        // Quitting from within the loop also works if the shard
+        // thread has not started running it yet
+        GSource *src = g_idle_source_new();
+        g_source_set_callback(src, shard_quit_cb, s->loop, nullptr);
+        g_source_attach(src, s->context);
+        g_source_unref(src);
+        if (s->thread.joinable())
+        {
+            s->thread.join();
+        }
+        g_main_loop_unref(s->loop);
+        g_main_context_unref(s->context);
+    }
+}
+
+
+unsigned int LogIngestShards::Select(const std::string& sender) const
+{
+    if (shards.empty())
+    {
+        return 0;
+    }
+    return std::hash<std::string>()(sender) % shards.size();
+}
+
+
+LogWriter *LogIngestShards::GetWriter(const unsigned int shard) const
+{
+    if (shards.empty())
+    {
+        return logwr;
+    }
+    return shards.at(shard)->writer.get();
+}
+
+
+void LogIngestShards::Run(const unsigned int shard, std::function<void()> fn)
+{
+    if (shards.empty()
+        || std::this_thread::get_id() == shards.at(shard)->thread.get_id())
+    {
+        fn();
+        return;
+    }
+
+    // An idle source is always dispatched by the shard thread;
+    // g_main_context_invoke() could run it here if the shard
+    // thread has not acquired its context yet
+    ShardCall call;
+    call.fn = std::move(fn);
+    GSource *src = g_idle_source_new();
+    g_source_set_callback(src, shard_call_cb, &call, nullptr);
+    g_source_attach(src, shards.at(shard)->context);
+    g_source_unref(src);
+
+    std::unique_lock<std::mutex> lk(call.mtx);
+    call.done_cv.wait(lk, [&call]()
+                          {
+                              return call.done;
+                          });
+    lk.unlock();
+    if (call.error)
+    {
+        std::rethrow_exception(call.error);
+    }
+}
@@ -0,0 +1,129 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2018 - 2022  OpenVPN, Inc. <sales@openvpn.net>
+//  Copyright (C) 2018 - 2022  David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+/**
+ * @file   ingest-shards.hpp
+ *
+ * @brief  Worker threads receiving and processing the Log signals of
+ *         the log senders outside of the main GLib main loop
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glib.h>
+
+#include "log/logwriter.hpp"
+
+
+/**
+ *  Spreads the log senders attached to the log service across a number
+ *  of worker threads, each running its own GMainContext.
+ *
+ *  Signal subscriptions made while running on a shard have their signals
+ *  dispatched by that shard, so the parsing, filtering, writing and
+ *  forwarding of the log events of a log sender happens there.  Each log
+ *  sender is always processed by the same shard, which keeps its log
+ *  events (and thus the log events of all its VPN sessions) in order.
+ *
+ *  Each shard writes to the log destination through its own producer of
+ *  the AsyncLogWriter, see AsyncLogWriter::NewProducer().
+ *
+ *  With no shards, everything is done directly on the calling thread.
+ */
+class LogIngestShards
+{
+public:
+    using Ptr = std::unique_ptr<LogIngestShards>;
+
+
+    /**
+     *  Starts the shard threads
+     *
+     * @param count  Number of shards.  With 0 no threads are started.
+     * @param logwr  LogWriter used by the log service.  With shards, this
+     *               must be an AsyncLogWriter.
+     */
+    LogIngestShards(const unsigned int count, LogWriter *logwr);
+
+    /**
+     *  Stops the shard threads.  Anything subscribed on a shard must
+     *  have been removed before.
+     */
+    ~LogIngestShards();
+
+    LogIngestShards(const LogIngestShards&) = delete;
+    LogIngestShards& operator=(const LogIngestShards&) = delete;
+
+
+    /**
+     * @return Returns the number of shards
+     */
+    unsigned int GetCount() const noexcept
+    {
+        return shards.size();
+    }
+
+
+    /**
+     *  Picks the shard processing a log sender
+     *
+     * @param sender  std::string with the unique bus name of the sender
+     *
+     * @return Returns the shard index to use
+     */
+    unsigned int Select(const std::string& sender) const;
+
+
+    /**
+     * @param shard  Shard index, see Select()
+     *
+     * @return Returns the LogWriter to use on this shard
+     */
+    LogWriter *GetWriter(const unsigned int shard) const;
+
+
+    /**
+     *  Runs a function on a shard and waits for it to complete.  This is
+     *  used to create and delete the objects processing the signals on
+     *  a shard and to change them.  Exceptions thrown are passed on to
+     *  the caller.
+     *
+     * @param shard  Shard index, see Select()
+     * @param fn     Function to run
+     */
+    void Run(const unsigned int shard, std::function<void()> fn);
+
+
+private:
+    struct Shard
+    {
+        GMainContext *context = nullptr;
+        GMainLoop *loop = nullptr;
+        LogWriter::Ptr writer;
+        std::thread thread;
+    };
+
+    LogWriter *logwr = nullptr;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
@@ -0,0 +1,343 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-archive.cpp
+ *
+ * @brief  Implementation of the log archive segment index and
+ *         LogArchiveReader
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log/log-helpers.hpp"
+#include "log/log-archive.hpp"
+
+
+//
+//  LogArchive::SegmentIndex  -  implementation
+//
+
+void LogArchive::SegmentIndex::Add(const uint64_t offset,
+                                   const uint64_t timestamp_us,
+                                   const std::string& token)
+{
+    if (0 == (records % TimeIndexInterval))
+    {
+        times.push_back({timestamp_us, offset});
+    }
+    tokens[token].push_back(offset);
+    ++records;
+}
+
+
+void LogArchive::SegmentIndex::Save(const std::string& fname) const
+{
+    // Write to a temporary file first, so readers never see a partially
+    // written index
+    std::string tmpname = fname + ".tmp";
+    std::ofstream idx(tmpname, std::ios::binary | std::ios::trunc);
+    if (!idx)
+    {
+        THROW_LOGEXCEPTION("Could not create log archive index " + tmpname);
+    }
+
+    uint32_t hdr[4] = {FormatVersion,
+                       (uint32_t) tokens.size(),
+                       (uint32_t) times.size(),
+                       0};
+    idx.write(IndexMagic, sizeof(IndexMagic));
+    idx.write((const char *) hdr, sizeof(hdr));
+    idx.write((const char *) &records, sizeof(records));
+    idx.write((const char *) times.data(),
+              times.size() * sizeof(TimeIndexEntry));
+    for (const auto& t : tokens)
+    {
+        uint32_t sizes[2] = {(uint32_t) t.first.size(),
+                             (uint32_t) t.second.size()};
+        idx.write((const char *) sizes, sizeof(sizes));
+        idx.write(t.first.data(), t.first.size());
+        idx.write((const char *) t.second.data(),
+                  t.second.size() * sizeof(uint64_t));
+    }
+    idx.close();
+    if (!idx || 0 != std::rename(tmpname.c_str(), fname.c_str()))
+    {
+        std::remove(tmpname.c_str());
+        THROW_LOGEXCEPTION("Could not write log archive index " + fname);
+    }
+}
+
+
+bool LogArchive::SegmentIndex::Load(const std::string& fname)
+{
+    std::ifstream idx(fname, std::ios::binary);
+    if (!idx)
+    {
+        return false;
+    }
+
+    char magic[sizeof(IndexMagic)] = {};
+    uint32_t hdr[4] = {};
+    idx.read(magic, sizeof(magic));
+    idx.read((char *) hdr, sizeof(hdr));
+    idx.read((char *) &records, sizeof(records));
+    if (!idx || 0 != memcmp(magic, IndexMagic, sizeof(magic))
+        || FormatVersion != hdr[0])
+    {
+        return false;
+    }
+
+    times.resize(hdr[2]);
+    idx.read((char *) times.data(), times.size() * sizeof(TimeIndexEntry));
+
+    tokens.clear();
+    for (uint32_t i = 0; i < hdr[1] && idx; i++)
+    {
+        uint32_t sizes[2] = {};
+        idx.read((char *) sizes, sizeof(sizes));
+        std::string token(sizes[0], '\0');
+        idx.read(&token[0], sizes[0]);
+        std::vector<uint64_t>& offsets = tokens[token];
+        offsets.resize(sizes[1]);
+        idx.read((char *) offsets.data(), sizes[1] * sizeof(uint64_t));
+    }
+    return (bool) idx;
+}
+
+
+std::string LogArchive::SegmentFilename(const std::string& directory,
+                                        const uint32_t segment,
+                                        const bool index)
+{
+    char fname[32] = {};
+    snprintf(fname, sizeof(fname), "segment-%08u.%s", segment,
+             (index ? "o3li" : "o3la"));
+    return directory + "/" + fname;
+}
+
+
+std::vector<uint32_t> LogArchive::ListSegments(const std::string& directory)
+{
+    std::vector<uint32_t> ret;
+    DIR *dir = opendir(directory.c_str());
+    if (nullptr == dir)
+    {
+        THROW_LOGEXCEPTION("Could not open log archive directory "
+                           + directory + ": " + strerror(errno));
+    }
+
+    struct dirent *de = nullptr;
+    while (nullptr != (de = readdir(dir)))
+    {
+        unsigned int segment = 0;
+        char ext[8] = {};
+        if (2 == sscanf(de->d_name, "segment-%8u.%4s", &segment, ext)
+            && 0 == strcmp(ext, "o3la"))
+        {
+            ret.push_back(segment);
+        }
+    }
+    closedir(dir);
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+
+
+//
+//  LogArchiveReader  -  implementation
+//
+
+LogArchiveReader::LogArchiveReader(const std::string& dir)
+    : directory(dir)
+{
+}
+
+
+size_t LogArchiveReader::Replay(const std::string& session_token,
+                                const uint64_t since_us,
+                                const uint64_t until_us,
+                                Callback callback) const
+{
+    size_t count = 0;
+    for (const auto& segment : LogArchive::ListSegments(directory))
+    {
+        count += replay_segment(segment, session_token,
+                                since_us, until_us, callback);
+    }
+    return count;
+}
+
+
+size_t LogArchiveReader::replay_segment(const uint32_t segment,
+                                        const std::string& session_token,
+                                        const uint64_t since_us,
+                                        const uint64_t until_us,
+                                        Callback& callback) const
+{
+    using namespace LogArchive;
+
+    // If an index is available, look up where to start and which
+    // records to read before touching the segment itself
+    SegmentIndex index;
+    bool indexed = index.Load(SegmentFilename(directory, segment, true));
+    const std::vector<uint64_t> *offsets = nullptr;
+    if (indexed && !session_token.empty())
+    {
+        auto it = index.tokens.find(session_token);
+        if (index.tokens.end() == it)
+        {
+            return 0;
+        }
+        offsets = &it->second;
+    }
+    if (indexed && !index.times.empty() && until_us > 0
+        && index.times.front().timestamp_us > until_us)
+    {
+        return 0;
+    }
+
+    std::string fname = SegmentFilename(directory, segment);
+    int fd = open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+    if (-1 == fd)
+    {
+        THROW_LOGEXCEPTION("Could not open log archive segment " + fname
+                           + ": " + strerror(errno));
+    }
+    struct stat st = {};
+    if (0 != fstat(fd, &st) || (size_t) st.st_size < sizeof(SegmentHeader))
+    {
+        close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == map)
+    {
+        THROW_LOGEXCEPTION("Could not map log archive segment " + fname
+                           + ": " + strerror(errno));
+    }
+    const char *data = static_cast<const char *>(map);
+
+    const SegmentHeader *hdr = reinterpret_cast<const SegmentHeader *>(data);
+    if (0 != memcmp(hdr->magic, SegmentMagic, sizeof(SegmentMagic))
+        || FormatVersion != hdr->version)
+    {
+        munmap(map, size);
+        return 0;
+    }
+
+    // Parses the record at a given offset.  Returns the length of the
+    // record, or 0 if there is no valid record at this offset.
+    size_t count = 0;
+    auto process = [&](const uint64_t offset) -> size_t
+        {
+            if (offset + sizeof(RecordHeader) > size)
+            {
+                return 0;
+            }
+            const RecordHeader *rec = reinterpret_cast<const RecordHeader *>(data + offset);
+            if (0 == rec->record_len
+                || offset + rec->record_len > size
+                || (uint64_t) sizeof(RecordHeader) + rec->token_len
+                   + rec->msg_len + rec->fields_len > rec->record_len)
+            {
+                return 0;
+            }
+            if (rec->timestamp_us < since_us
+                || (until_us > 0 && rec->timestamp_us > until_us))
+            {
+                return rec->record_len;
+            }
+
+            const char *token = data + offset + sizeof(RecordHeader);
+            if (!session_token.empty()
+                && (session_token.size() != rec->token_len
+                    || 0 != memcmp(token, session_token.data(), rec->token_len)))
+            {
+                return rec->record_len;
+            }
+
+            Entry e;
+            e.timestamp_us = rec->timestamp_us;
+            e.tag_hash = rec->tag_hash;
+            e.event = LogEvent((LogGroup) rec->group,
+                               (LogCategory) rec->category,
+                               std::string(token, rec->token_len),
+                               std::string(token + rec->token_len,
+                                           rec->msg_len));
+            if (rec->fields_len > 0)
+            {
+                // Records with log fields which cannot be decoded are
+                // still replayed, without the fields
+                e.event.fields.Decode(reinterpret_cast<const uint8_t *>(token)
+                                      + rec->token_len + rec->msg_len,
+                                      rec->fields_len);
+            }
+            callback(e);
+            ++count;
+            return rec->record_len;
+        };
+
+    if (offsets)
+    {
+        for (const auto& offset : *offsets)
+        {
+            process(offset);
+        }
+    }
+    else
+    {
+        uint64_t offset = hdr->header_size;
+        if (indexed && since_us > 0)
+        {
+            // Use the time index to skip records which are too old
+            for (const auto& t : index.times)
+            {
+                if (t.timestamp_us > since_us)
+                {
+                    break;
+                }
+                offset = t.offset;
+            }
+        }
+
+        size_t len = 0;
+        while (0 < (len = process(offset)))
+        {
+            offset += len;
+        }
+    }
+
+    munmap(map, size);
+    return count;
+}
@@ -0,0 +1,227 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-archive.hpp
+ *
+ * @brief  Definition of the binary log archive format, its segment index
+ *         and the LogArchiveReader used to replay archived log events
+ *
+ *  A log archive is a directory of segment files.  Each segment file
+ *  starts with a LogArchive::SegmentHeader followed by records, each
+ *  aligned to 8 bytes:
+ *
+ *     uint32_t  record length, including this header and padding
+ *     uint32_t  message length
+ *     uint64_t  timestamp, microseconds since the epoch
+ *     uint64_t  LogTag hash, 0 if not known
+ *     uint8_t   LogGroup
+ *     uint8_t   LogCategory
+ *     uint16_t  session token length
+ *     uint32_t  length of the encoded log fields, see LogFields
+ *     char[]    session token, followed by the message and the log fields
+ *
+ *  Segments are preallocated, so a record length of 0 marks the end of
+ *  the used part of a segment.  When a segment is completed, an index
+ *  file is written next to it.  The index contains the offsets of the
+ *  records per session token and a sparse time index.  Segments without
+ *  index files (the active segment or one left by a crashed log service)
+ *  are scanned instead.
+ *
+ *  All values are stored in host byte order; the archive is not meant
+ *  to be moved between hosts of a different endianness.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "log/logevent.hpp"
+
+
+namespace LogArchive
+{
+    const char SegmentMagic[8] = {'O', '3', 'L', 'O', 'G', 'A', 'R', 'C'};
+    const char IndexMagic[8] = {'O', '3', 'L', 'O', 'G', 'I', 'D', 'X'};
+    const uint32_t FormatVersion = 1;
+
+    /** A time index entry is added for every TimeIndexInterval record */
+    const uint32_t TimeIndexInterval = 64;
+
+    struct SegmentHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t created_us;
+        uint64_t reserved;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t record_len;
+        uint32_t msg_len;
+        uint64_t timestamp_us;
+        uint64_t tag_hash;
+        uint8_t group;
+        uint8_t category;
+        uint16_t token_len;
+        uint32_t fields_len;
+    };
+
+    struct TimeIndexEntry
+    {
+        uint64_t timestamp_us;
+        uint64_t offset;
+    };
+
+
+    /**
+     *  In-memory representation of the index of a single segment
+     */
+    struct SegmentIndex
+    {
+        /** Record offsets per session token */
+        std::map<std::string, std::vector<uint64_t>> tokens;
+
+        /** Offset of every TimeIndexInterval record */
+        std::vector<TimeIndexEntry> times;
+
+        /** Number of records in the segment */
+        uint64_t records = 0;
+
+
+        /**
+         *  Register a new record written to the segment
+         *
+         * @param offset        Offset of the record in the segment file
+         * @param timestamp_us  Timestamp of the record
+         * @param token         Session token of the record
+         */
+        void Add(const uint64_t offset, const uint64_t timestamp_us,
+                 const std::string& token);
+
+        /**
+         *  Write the index to a file
+         *
+         * @param fname  std::string with the file name of the index
+         */
+        void Save(const std::string& fname) const;
+
+        /**
+         *  Load an index from a file
+         *
+         * @param fname  std::string with the file name of the index
+         * @return Returns true if a valid index file was loaded
+         */
+        bool Load(const std::string& fname);
+    };
+
+
+    /**
+     *  Rounds a record length up to the record alignment
+     */
+    inline size_t AlignRecord(const size_t len)
+    {
+        return (len + 7) & ~((size_t) 7);
+    }
+
+
+    /**
+     *  Generate the file names used for a segment
+     *
+     * @param directory  Archive directory
+     * @param segment    Segment number
+     * @param index      If true, return the index file name
+     *
+     * @return Returns a std::string with the file name
+     */
+    std::string SegmentFilename(const std::string& directory,
+                                const uint32_t segment,
+                                const bool index = false);
+
+
+    /**
+     *  Retrieve the segment numbers found in an archive directory
+     *
+     * @param directory  Archive directory
+     * @return Returns a sorted std::vector of segment numbers
+     */
+    std::vector<uint32_t> ListSegments(const std::string& directory);
+}
+
+
+
+/**
+ *  Reads log events from a log archive written by ArchiveLogWriter
+ */
+class LogArchiveReader
+{
+public:
+    /**
+     *  A single archived log event
+     */
+    struct Entry
+    {
+        uint64_t timestamp_us;
+        uint64_t tag_hash;
+        LogEvent event;
+    };
+
+    using Callback = std::function<void(const Entry&)>;
+
+
+    /**
+     * @param directory  std::string with the path to the archive directory
+     */
+    LogArchiveReader(const std::string& directory);
+    ~LogArchiveReader() = default;
+
+
+    /**
+     *  Replay archived log events, ordered as they were written.
+     *
+     * @param session_token  Only replay log events for this session
+     *                       token.  If empty, all log events are replayed.
+     * @param since_us       Skip log events older than this timestamp,
+     *                       in microseconds since the epoch
+     * @param until_us       Skip log events newer than this timestamp.
+     *                       0 means no upper limit.
+     * @param callback       Callback function called for each log event
+     *
+     * @return Returns the number of log events replayed
+     */
+    size_t Replay(const std::string& session_token,
+                  const uint64_t since_us,
+                  const uint64_t until_us,
+                  Callback callback) const;
+
+
+private:
+    const std::string directory;
+
+    size_t replay_segment(const uint32_t segment,
+                          const std::string& session_token,
+                          const uint64_t since_us,
+                          const uint64_t until_us,
+                          Callback& callback) const;
+};
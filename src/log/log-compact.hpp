@@ -0,0 +1,313 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-compact.hpp
+ *
+ * @brief  Compact binary encoding of log and status events, used by the
+ *         LogCompact signal
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "logfields.hpp"
+
+
+/**
+ *  The LogCompact signal carries one or more log or status event records
+ *  in a single byte array (D-Bus type 'ay').  Each record is a fixed
+ *  20 byte header followed by two strings without NUL terminators:
+ *
+ *    offset  size  field
+ *         0     1  version, always 1
+ *         1     1  record type, see CompactEvent::Type
+ *         2     2  reserved, 0
+ *         4     4  LogGroup (LOG) or StatusMajor (STATUS)
+ *         8     4  LogCategory (LOG) or StatusMinor (STATUS)
+ *        12     4  length of the session token (always 0 for STATUS)
+ *        16     4  length of the message
+ *        20        session token, followed by the message
+ *
+ *  Log records with log fields (see LogFields) use version 2, where the
+ *  header is 24 bytes:
+ *
+ *        20     4  length of the encoded log fields
+ *        24        session token, message, followed by the log fields
+ *
+ *  Records without log fields are always written as version 1, so
+ *  receivers not knowing version 2 only fail on records they could not
+ *  use anyway.
+ *
+ *  All integers are little endian.  A receiver can inspect the header
+ *  fields before touching the strings, and the strings can be used in
+ *  place without copying them.
+ */
+namespace CompactEvent {
+
+enum class Type : uint8_t
+{
+    LOG = 1,
+    STATUS = 2
+};
+
+static const uint8_t VERSION = 1;
+static const uint8_t VERSION_FIELDS = 2;
+static const size_t HEADER_SIZE = 20;
+static const size_t HEADER_SIZE_FIELDS = 24;
+
+
+/**
+ *  A decoded record.  The string pointers point into the buffer the
+ *  record was read from and are not NUL terminated.
+ */
+struct Record
+{
+    Type type;
+    uint32_t field1;          ///< LogGroup or StatusMajor
+    uint32_t field2;          ///< LogCategory or StatusMinor
+    const char *token;
+    uint32_t token_len;
+    const char *message;
+    uint32_t message_len;
+    const uint8_t *fields;    ///< Encoded log fields, nullptr if none
+    uint32_t fields_len;
+
+    std::string Token() const
+    {
+        return std::string(token, token_len);
+    }
+
+    std::string Message() const
+    {
+        return std::string(message, message_len);
+    }
+};
+
+
+
+/**
+ *  Builds a buffer of one or more encoded records
+ */
+class Writer
+{
+public:
+    void AddLog(const uint32_t group, const uint32_t category,
+                const std::string& token, const std::string& message)
+    {
+        add(Type::LOG, group, category, token, message);
+    }
+
+
+    /**
+     *  Add a log record with log fields.  Without fields, this is the
+     *  same as the AddLog() call above.
+     */
+    void AddLog(const uint32_t group, const uint32_t category,
+                const std::string& token, const std::string& message,
+                const LogFields& fields)
+    {
+        if (fields.empty())
+        {
+            add(Type::LOG, group, category, token, message);
+            return;
+        }
+
+        size_t start = buffer.size();
+        buffer.resize(start + HEADER_SIZE_FIELDS);
+        buffer.insert(buffer.end(), token.begin(), token.end());
+        buffer.insert(buffer.end(), message.begin(), message.end());
+        fields.Encode(buffer);
+
+        uint8_t *hdr = buffer.data() + start;
+        hdr[0] = VERSION_FIELDS;
+        hdr[1] = (uint8_t) Type::LOG;
+        hdr[2] = 0;
+        hdr[3] = 0;
+        set_u32(hdr + 4, group);
+        set_u32(hdr + 8, category);
+        set_u32(hdr + 12, (uint32_t) token.size());
+        set_u32(hdr + 16, (uint32_t) message.size());
+        set_u32(hdr + 20, (uint32_t) (buffer.size() - start - HEADER_SIZE_FIELDS
+                                      - token.size() - message.size()));
+    }
+
+
+    void AddStatus(const uint32_t major, const uint32_t minor,
+                   const std::string& message)
+    {
+        add(Type::STATUS, major, minor, std::string(), message);
+    }
+
+
+    const std::vector<uint8_t>& GetBuffer() const noexcept
+    {
+        return buffer;
+    }
+
+
+    bool empty() const noexcept
+    {
+        return buffer.empty();
+    }
+
+
+    void clear() noexcept
+    {
+        buffer.clear();
+    }
+
+
+private:
+    std::vector<uint8_t> buffer;
+
+
+    void add(const Type type, const uint32_t f1, const uint32_t f2,
+             const std::string& token, const std::string& message)
+    {
+        buffer.reserve(buffer.size() + HEADER_SIZE
+                       + token.size() + message.size());
+        buffer.push_back(VERSION);
+        buffer.push_back((uint8_t) type);
+        buffer.push_back(0);
+        buffer.push_back(0);
+        put_u32(f1);
+        put_u32(f2);
+        put_u32((uint32_t) token.size());
+        put_u32((uint32_t) message.size());
+        buffer.insert(buffer.end(), token.begin(), token.end());
+        buffer.insert(buffer.end(), message.begin(), message.end());
+    }
+
+
+    void put_u32(const uint32_t v)
+    {
+        buffer.push_back(v & 0xff);
+        buffer.push_back((v >> 8) & 0xff);
+        buffer.push_back((v >> 16) & 0xff);
+        buffer.push_back((v >> 24) & 0xff);
+    }
+
+
+    static void set_u32(uint8_t *p, const uint32_t v) noexcept
+    {
+        p[0] = v & 0xff;
+        p[1] = (v >> 8) & 0xff;
+        p[2] = (v >> 16) & 0xff;
+        p[3] = (v >> 24) & 0xff;
+    }
+};
+
+
+
+/**
+ *  Iterates over the records in a buffer, without copying anything.
+ *  The buffer must be kept alive while the records are used.
+ */
+class Reader
+{
+public:
+    Reader(const uint8_t *data, const size_t len) noexcept
+        : data(data), len(len)
+    {
+    }
+
+
+    /**
+     *  Decode the next record
+     *
+     * @param rec  Record to fill in
+     *
+     * @return Returns false when there are no more records, or if the
+     *         next record is invalid.  Check Failed() to tell these apart.
+     */
+    bool Next(Record& rec) noexcept
+    {
+        if (failed || pos == len)
+        {
+            return false;
+        }
+        const bool with_fields = (len - pos >= HEADER_SIZE_FIELDS
+                                  && VERSION_FIELDS == data[pos]);
+        if (!with_fields
+            && (len - pos < HEADER_SIZE || VERSION != data[pos]))
+        {
+            failed = true;
+            return false;
+        }
+
+        const uint8_t t = data[pos + 1];
+        if ((uint8_t) Type::LOG != t
+            && ((uint8_t) Type::STATUS != t || with_fields))
+        {
+            failed = true;
+            return false;
+        }
+
+        const size_t hdrlen = (with_fields ? HEADER_SIZE_FIELDS : HEADER_SIZE);
+        const uint32_t tlen = get_u32(pos + 12);
+        const uint32_t mlen = get_u32(pos + 16);
+        const uint32_t flen = (with_fields ? get_u32(pos + 20) : 0);
+        if ((uint64_t) tlen + mlen + flen > len - pos - hdrlen)
+        {
+            failed = true;
+            return false;
+        }
+
+        rec.type = (Type) t;
+        rec.field1 = get_u32(pos + 4);
+        rec.field2 = get_u32(pos + 8);
+        rec.token = reinterpret_cast<const char *>(data + pos + hdrlen);
+        rec.token_len = tlen;
+        rec.message = rec.token + tlen;
+        rec.message_len = mlen;
+        rec.fields = (with_fields ? data + pos + hdrlen + tlen + mlen : nullptr);
+        rec.fields_len = flen;
+        pos += hdrlen + tlen + mlen + flen;
+        return true;
+    }
+
+
+    bool Failed() const noexcept
+    {
+        return failed;
+    }
+
+
+private:
+    const uint8_t *data;
+    size_t len;
+    size_t pos = 0;
+    bool failed = false;
+
+
+    uint32_t get_u32(const size_t offset) const noexcept
+    {
+        return (uint32_t) data[offset]
+               | ((uint32_t) data[offset + 1] << 8)
+               | ((uint32_t) data[offset + 2] << 16)
+               | ((uint32_t) data[offset + 3] << 24);
+    }
+};
+
+} // namespace CompactEvent
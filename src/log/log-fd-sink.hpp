@@ -0,0 +1,269 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-fd-sink.hpp
+ *
+ * @brief  Writes log events of a VPN session directly to a file
+ *         descriptor provided by the log service
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "log-helpers.hpp"
+
+
+/**
+ *  A per-session log sink.  The log service opens a log file or a
+ *  systemd-journald stream for the session and passes the file
+ *  descriptor to the VPN backend, which writes its log events straight
+ *  to it instead of sending them as Log signals over the bus.
+ *
+ *  Writes never wait for long; if the journald stream is congested,
+ *  log events are dropped and counted instead of holding back the VPN
+ *  client.
+ *
+ *  All methods are thread-safe.
+ */
+class LogFdSink
+{
+public:
+    using Ptr = std::shared_ptr<LogFdSink>;
+
+    enum class Format
+    {
+        TEXT,     ///< One line per event, prefixed by timestamp, group and category
+        JOURNAL   ///< systemd-journald stream with <priority> line prefixes
+    };
+
+
+    /**
+     * @param fd      File descriptor to write to; owned by the LogFdSink
+     * @param format  Format of the lines written
+     */
+    LogFdSink(int fd, Format format)
+        : fd(fd), format(format)
+    {
+        if (fd < 0)
+        {
+            throw std::invalid_argument("Invalid log sink file descriptor");
+        }
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0)
+        {
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+    }
+
+    ~LogFdSink()
+    {
+        close(fd);
+    }
+
+    LogFdSink(const LogFdSink&) = delete;
+    LogFdSink& operator=(const LogFdSink&) = delete;
+
+
+    /**
+     *  Parses the format name the log service reports with the file
+     *  descriptor
+     *
+     * @param name  std::string with "text" or "journal"
+     *
+     * @return Returns the Format
+     */
+    static Format ParseFormat(const std::string& name)
+    {
+        if ("journal" == name)
+        {
+            return Format::JOURNAL;
+        }
+        if ("text" == name)
+        {
+            return Format::TEXT;
+        }
+        throw std::invalid_argument("Unknown log sink format: " + name);
+    }
+
+
+    /**
+     * @param format  Format to name
+     *
+     * @return Returns the name of the format, see ParseFormat()
+     */
+    static std::string FormatName(Format format)
+    {
+        return (Format::JOURNAL == format ? "journal" : "text");
+    }
+
+
+    /**
+     *  Renders a log event into the lines written to the sink.  Each line
+     *  of a multi-line message gets its own prefix.
+     *
+     * @param format    Format to render
+     * @param category  LogCategory of the log event
+     * @param group     LogGroup of the log event
+     * @param message   std::string with the log message
+     * @param now       Timestamp used with Format::TEXT
+     *
+     * @return Returns the rendered lines, ending with a newline
+     */
+    static std::string Render(Format format, LogCategory category,
+                              LogGroup group, const std::string& message,
+                              time_t now)
+    {
+        std::string prefix;
+        if (Format::JOURNAL == format)
+        {
+            prefix = "<" + std::to_string(journal_priority(category)) + ">";
+        }
+        else
+        {
+            char ts[32] = {};
+            struct tm tm;
+            localtime_r(&now, &tm);
+            strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S ", &tm);
+            prefix = ts;
+        }
+        prefix += LogPrefix(group, category);
+
+        std::string ret;
+        ret.reserve(prefix.size() + message.size() + 1);
+        size_t pos = 0;
+        do
+        {
+            size_t eol = message.find('\n', pos);
+            ret += prefix;
+            ret.append(message, pos, (std::string::npos == eol ? std::string::npos
+                                                                : eol - pos));
+            ret += '\n';
+            pos = (std::string::npos == eol ? message.size() : eol + 1);
+        } while (pos < message.size());
+        return ret;
+    }
+
+
+    /**
+     *  Writes a log event to the sink
+     *
+     * @param category  LogCategory of the log event
+     * @param group     LogGroup of the log event
+     * @param message   std::string with the log message
+     *
+     * @return Returns true if the log event was written, false if it was
+     *         dropped
+     */
+    bool Write(LogCategory category, LogGroup group, const std::string& message)
+    {
+        std::string data = Render(format, category, group, message, time(nullptr));
+
+        std::lock_guard<std::mutex> guard(mtx);
+        size_t done = 0;
+        while (done < data.size())
+        {
+            ssize_t r = ::write(fd, data.data() + done, data.size() - done);
+            if (r > 0)
+            {
+                done += r;
+                continue;
+            }
+            if (r < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            if (r < 0 && (EAGAIN == errno || EWOULDBLOCK == errno))
+            {
+                // Nothing written yet: drop the whole event.  Otherwise
+                // the line must be completed, or the next one is garbled.
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                if (0 == done || poll(&pfd, 1, 100) <= 0)
+                {
+                    break;
+                }
+                continue;
+            }
+            break;
+        }
+        if (done < data.size())
+        {
+            ++dropped;
+            return false;
+        }
+        return true;
+    }
+
+
+    /**
+     * @return Returns the number of log events dropped
+     */
+    uint64_t Dropped() const noexcept
+    {
+        return dropped.load();
+    }
+
+
+    /**
+     * @return Returns the Format of this sink
+     */
+    Format GetFormat() const noexcept
+    {
+        return format;
+    }
+
+
+private:
+    const int fd;
+    const Format format;
+    std::mutex mtx;
+    std::atomic<uint64_t> dropped{0};
+
+
+    /**
+     * @return Returns the syslog(3) priority used for a LogCategory
+     */
+    static int journal_priority(LogCategory category)
+    {
+        switch (category)
+        {
+        case LogCategory::FATAL:
+        case LogCategory::CRIT:
+            return 2;   // LOG_CRIT
+        case LogCategory::ERROR:
+            return 3;   // LOG_ERR
+        case LogCategory::WARN:
+            return 4;   // LOG_WARNING
+        case LogCategory::INFO:
+            return 6;   // LOG_INFO
+        default:
+            return 7;   // LOG_DEBUG
+        }
+    }
+};
@@ -25,11 +25,15 @@
 
 #pragma once
 
+#include <chrono>
 #include <string>
+#include <utility>
+#include <vector>
 #include <gio/gio.h>
 
 #include "dbus/glibutils.hpp"
 #include "log-helpers.hpp"
+#include "logfields.hpp"
 
 
 /**
@@ -60,8 +64,9 @@ struct LogEvent
      * @param msg  std::string containing the log message to use.
      */
     LogEvent(const LogGroup grp, const LogCategory ctg,
-             const std::string& msg)
-        : group(grp), category(ctg), message(msg)
+             std::string msg)
+        : group(grp), category(ctg), message(std::move(msg)),
+          created(std::chrono::system_clock::now())
     {
         remove_trailing_nl();
         format = Format::NORMAL;
@@ -77,7 +82,8 @@ struct LogEvent
     LogEvent(const LogGroup grp, const LogCategory ctg,
              const std::string& session_token, const std::string& msg)
         : group(grp), category(ctg),
-          session_token(session_token), message(msg)
+          session_token(session_token), message(msg),
+          created(std::chrono::system_clock::now())
     {
         remove_trailing_nl();
         format = Format::SESSION_TOKEN;
@@ -86,7 +92,8 @@ struct LogEvent
 
     LogEvent(const LogEvent& logev, const std::string& session_token)
         : group(logev.group), category(logev.category),
-          session_token(session_token), message(logev.message)
+          session_token(session_token), message(logev.message),
+          fields(logev.fields), created(logev.created)
     {
         remove_trailing_nl();
         format = Format::SESSION_TOKEN;
@@ -97,7 +104,8 @@ struct LogEvent
      *  Initialize a LogEvent, based on a GVariant object containing
      *  a Log signal.  It supports both tuple based and dictonary based
      *  Log signals. See @parse_dict() and @parse_tuple for more
-     *  information.
+     *  information.  The (uussay) tuple also carries the log fields,
+     *  see GetGVariantTuple().
      *
      * @param logev  Pointer to a GVariant object containing the the Log event
      * @throws LogException on invalid input data
@@ -122,6 +130,10 @@ struct LogEvent
                 parse_tuple(logev, true);
                 format = Format::SESSION_TOKEN;
             }
+            else if ("(uussay)" == g_type)
+            {
+                parse_tuple_fields(logev);
+            }
             else
             {
                 THROW_LOGEXCEPTION("LogEvent: Invalid LogEvent data type");
@@ -161,11 +173,29 @@ struct LogEvent
      *  Create a GVariant object containing a tuple formatted object for
      *  a Log signal of the current LogEvent.
      *
+     *  Log events with fields can be sent as a (uussay) tuple, where the
+     *  byte array contains the fields as encoded by LogFields::Encode().
+     *  This is only understood by the log service and the session
+     *  manager, so it must be explicitly requested.
+     *
+     * @param with_fields  bool, use the (uussay) tuple if the log event
+     *                     has fields
+     *
      * @return  Returns a pointer to a GVariant object with the formatted
      *          data
      */
-    GVariant* GetGVariantTuple() const
+    GVariant* GetGVariantTuple(const bool with_fields = false) const
     {
+        if (with_fields && !fields.empty())
+        {
+            std::vector<uint8_t> buf = fields.Encode();
+            GVariant *ay = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                     buf.data(), buf.size(),
+                                                     sizeof(uint8_t));
+            return g_variant_new("(uuss@ay)", (guint32) group,
+                                 (guint32) category, session_token.c_str(),
+                                 message.c_str(), ay);
+        }
         if (Format::SESSION_TOKEN == format
             || (Format::AUTO == format && !session_token.empty()))
         {
@@ -201,6 +231,15 @@ struct LogEvent
         }
         g_variant_builder_add(b, "{sv}", "log_message",
                               g_variant_new_string(message.c_str()));
+        if (!fields.empty())
+        {
+            std::vector<uint8_t> buf = fields.Encode();
+            g_variant_builder_add(b, "{sv}", "log_fields",
+                                  g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                            buf.data(),
+                                                            buf.size(),
+                                                            sizeof(uint8_t)));
+        }
         GVariant *ret = g_variant_builder_end(b);
         g_variant_builder_unref(b);
         return ret;
@@ -244,7 +283,9 @@ struct LogEvent
         category = LogCategory::UNDEFINED;
         session_token.clear();
         message.clear();
+        fields.clear();
         format = Format::AUTO;
+        created = std::chrono::system_clock::now();
     }
 
 
@@ -305,8 +346,24 @@ struct LogEvent
     LogCategory category;
     std::string session_token;
     std::string message;
+
+    /**
+     *  Optional typed fields describing the log event.  They are not
+     *  considered when comparing log events, as the message is expected
+     *  to carry the same information in a readable form.
+     */
+    LogFields fields;
+
     Format format = Format::AUTO;
 
+    /**
+     *  When this LogEvent was created.  For events received over D-Bus
+     *  this is the time it was received.  Log writers use it for the
+     *  timestamp, so events which were queued before being written
+     *  still get the time they happened.
+     */
+    std::chrono::system_clock::time_point created;
+
 
 private:
     void remove_trailing_nl()
@@ -325,6 +382,8 @@ private:
      *     - (s) log_session_token  An optional session token string
      *     - (s) log_message        A string with the log message
      *
+     *  An optional (ay) log_fields value contains the encoded log fields.
+     *
      * @param logevent  Pointer to the GVariant object containig the
      *                  log event
      */
@@ -376,6 +435,14 @@ private:
             THROW_LOGEXCEPTION("Failed retrieving log event message text"
                                " (inconsistent length)");
         }
+
+        d = g_variant_lookup_value(logevent, "log_fields",
+                                   G_VARIANT_TYPE_BYTESTRING);
+        if (d)
+        {
+            decode_fields(d);
+            g_variant_unref(d);
+        }
     }
 
 
@@ -409,4 +476,45 @@ private:
             message = std::string(GLibUtils::ExtractValue<std::string>(logevent, 3));
         }
     }
+
+
+    /**
+     *  Parses a (uussay) log event, which carries the log fields in
+     *  addition to the session token.  An empty session token means the
+     *  log event is not related to a session.
+     *
+     * @param logevent  Pointer to the GVariant object containig the
+     *                  log event
+     */
+    void parse_tuple_fields(GVariant *logevent)
+    {
+        GLibUtils::checkParams(__func__, logevent, "(uussay)", 5);
+        group = (LogGroup) GLibUtils::ExtractValue<uint32_t>(logevent, 0);
+        category = (LogCategory) GLibUtils::ExtractValue<uint32_t>(logevent, 1);
+        session_token = GLibUtils::ExtractValue<std::string>(logevent, 2);
+        message = std::string(GLibUtils::ExtractValue<std::string>(logevent, 3));
+        format = (session_token.empty() ? Format::NORMAL : Format::SESSION_TOKEN);
+
+        GVariant *ay = g_variant_get_child_value(logevent, 4);
+        decode_fields(ay);
+        g_variant_unref(ay);
+    }
+
+
+    /**
+     *  Decodes the log fields of a received log event
+     *
+     * @param ay  Pointer to the (ay) GVariant object with the encoded fields
+     * @throws LogException on invalid log fields
+     */
+    void decode_fields(GVariant *ay)
+    {
+        gsize len = 0;
+        const uint8_t *data = static_cast<const uint8_t *>(
+                g_variant_get_fixed_array(ay, &len, sizeof(uint8_t)));
+        if (!fields.Decode(data, len))
+        {
+            THROW_LOGEXCEPTION("LogEvent: Invalid log fields");
+        }
+    }
 };
@@ -0,0 +1,428 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logfields.hpp
+ *
+ * @brief  Typed key/value fields carried by a LogEvent, next to its
+ *         preformatted message
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+
+class LogFieldsException : public std::exception
+{
+public:
+    LogFieldsException(const std::string& err) noexcept
+        : errormsg(err)
+    {
+    }
+
+    virtual ~LogFieldsException() noexcept = default;
+
+    virtual const char* what() const noexcept
+    {
+        return errormsg.c_str();
+    }
+
+private:
+    std::string errormsg;
+};
+
+
+
+/**
+ *  An ordered list of typed fields describing a log event, such as
+ *  byte counters, durations or a remote address.  The message of the
+ *  log event is still the human readable text; the fields let log
+ *  consumers index and aggregate the values without parsing it.
+ *
+ *  Field names are 1 to 32 characters of lower case letters, digits
+ *  and '_', starting with a letter.  This makes them valid both as
+ *  journald field names, where JournaldWriter upper cases them with an
+ *  O3_FIELD_ prefix, and as RFC 5424 structured data parameter names.
+ *
+ *  The fields are carried in a compact binary encoding, see Encode():
+ *
+ *    uint8_t   encoding version, always 1
+ *    then per field:
+ *      uint8_t   field type, see LogFields::Type
+ *      uint8_t   length of the field name
+ *      char[]    field name
+ *      INT, UINT and DOUBLE:  8 byte value
+ *      STRING:                uint32_t length, followed by the string
+ *
+ *  All integers are little endian.
+ */
+class LogFields
+{
+public:
+    enum class Type : uint8_t
+    {
+        STRING = 1,
+        INT = 2,
+        UINT = 3,
+        DOUBLE = 4
+    };
+
+    static const uint8_t VERSION = 1;
+    static const size_t MAX_NAME_LEN = 32;
+    static const size_t MAX_FIELDS = 64;
+
+
+    struct Field
+    {
+        std::string name;
+        Type type;
+        uint64_t num;         ///< Value of INT (two's complement), UINT and DOUBLE fields
+        std::string str;      ///< Value of STRING fields
+
+        int64_t GetInt() const noexcept
+        {
+            return (int64_t) num;
+        }
+
+        uint64_t GetUInt() const noexcept
+        {
+            return num;
+        }
+
+        double GetDouble() const noexcept
+        {
+            double d;
+            memcpy(&d, &num, sizeof(d));
+            return d;
+        }
+
+        /**
+         *  Render the value as text, as used by the journald and syslog
+         *  log writers
+         */
+        std::string GetValue() const
+        {
+            switch (type)
+            {
+            case Type::STRING:
+                return str;
+            case Type::INT:
+                return std::to_string(GetInt());
+            case Type::UINT:
+                return std::to_string(GetUInt());
+            case Type::DOUBLE:
+                {
+                    char buf[32];
+                    snprintf(buf, sizeof(buf), "%.15g", GetDouble());
+                    return std::string(buf);
+                }
+            }
+            return std::string();
+        }
+    };
+
+
+    void AddString(const std::string& name, const std::string& value)
+    {
+        add(name, Type::STRING, 0).str = value;
+    }
+
+
+    void AddInt(const std::string& name, const int64_t value)
+    {
+        add(name, Type::INT, (uint64_t) value);
+    }
+
+
+    void AddUInt(const std::string& name, const uint64_t value)
+    {
+        add(name, Type::UINT, value);
+    }
+
+
+    void AddDouble(const std::string& name, const double value)
+    {
+        uint64_t v;
+        memcpy(&v, &value, sizeof(v));
+        add(name, Type::DOUBLE, v);
+    }
+
+
+    /**
+     *  Look up a field by its name
+     *
+     * @return Returns a pointer to the field, nullptr if not found
+     */
+    const Field* Find(const std::string& name) const noexcept
+    {
+        for (const auto& f : fields)
+        {
+            if (f.name == name)
+            {
+                return &f;
+            }
+        }
+        return nullptr;
+    }
+
+
+    std::vector<Field>::const_iterator begin() const noexcept
+    {
+        return fields.begin();
+    }
+
+
+    std::vector<Field>::const_iterator end() const noexcept
+    {
+        return fields.end();
+    }
+
+
+    size_t size() const noexcept
+    {
+        return fields.size();
+    }
+
+
+    bool empty() const noexcept
+    {
+        return fields.empty();
+    }
+
+
+    void clear() noexcept
+    {
+        fields.clear();
+    }
+
+
+    /**
+     *  Append the encoded fields to a buffer
+     *
+     * @param buf  std::vector<uint8_t> to append to
+     */
+    void Encode(std::vector<uint8_t>& buf) const
+    {
+        buf.push_back((uint8_t) VERSION);
+        for (const auto& f : fields)
+        {
+            buf.push_back((uint8_t) f.type);
+            buf.push_back((uint8_t) f.name.size());
+            buf.insert(buf.end(), f.name.begin(), f.name.end());
+            if (Type::STRING == f.type)
+            {
+                put_u32(buf, (uint32_t) f.str.size());
+                buf.insert(buf.end(), f.str.begin(), f.str.end());
+            }
+            else
+            {
+                put_u32(buf, (uint32_t) (f.num & 0xffffffff));
+                put_u32(buf, (uint32_t) (f.num >> 32));
+            }
+        }
+    }
+
+
+    std::vector<uint8_t> Encode() const
+    {
+        std::vector<uint8_t> ret;
+        Encode(ret);
+        return ret;
+    }
+
+
+    /**
+     *  Replace the fields with the ones in an encoded buffer.  The
+     *  buffer is validated completely, as it is received from other
+     *  processes.
+     *
+     * @param data  Pointer to the encoded fields
+     * @param len   Length of the encoded fields
+     *
+     * @return Returns false if the buffer is invalid; the fields are
+     *         then left empty
+     */
+    bool Decode(const uint8_t *data, const size_t len)
+    {
+        fields.clear();
+        if (0 == len)
+        {
+            return true;
+        }
+        if (VERSION != data[0])
+        {
+            return false;
+        }
+
+        size_t pos = 1;
+        while (pos < len)
+        {
+            if (len - pos < 2 || fields.size() >= MAX_FIELDS)
+            {
+                fields.clear();
+                return false;
+            }
+            Field f;
+            f.type = (Type) data[pos];
+            size_t nlen = data[pos + 1];
+            pos += 2;
+            if (len - pos < nlen)
+            {
+                fields.clear();
+                return false;
+            }
+            f.name.assign(reinterpret_cast<const char *>(data + pos), nlen);
+            pos += nlen;
+            if (!ValidName(f.name) || nullptr != Find(f.name))
+            {
+                fields.clear();
+                return false;
+            }
+
+            switch (f.type)
+            {
+            case Type::STRING:
+                {
+                    if (len - pos < 4)
+                    {
+                        fields.clear();
+                        return false;
+                    }
+                    uint32_t slen = get_u32(data + pos);
+                    pos += 4;
+                    if (len - pos < slen)
+                    {
+                        fields.clear();
+                        return false;
+                    }
+                    f.num = 0;
+                    f.str.assign(reinterpret_cast<const char *>(data + pos), slen);
+                    pos += slen;
+                }
+                break;
+
+            case Type::INT:
+            case Type::UINT:
+            case Type::DOUBLE:
+                if (len - pos < 8)
+                {
+                    fields.clear();
+                    return false;
+                }
+                f.num = (uint64_t) get_u32(data + pos)
+                        | ((uint64_t) get_u32(data + pos + 4) << 32);
+                pos += 8;
+                break;
+
+            default:
+                fields.clear();
+                return false;
+            }
+            fields.push_back(std::move(f));
+        }
+        return true;
+    }
+
+
+    /**
+     *  Checks if a field name follows the naming rules
+     */
+    static bool ValidName(const std::string& name) noexcept
+    {
+        if (name.empty() || name.size() > MAX_NAME_LEN
+            || name[0] < 'a' || name[0] > 'z')
+        {
+            return false;
+        }
+        for (const char c : name)
+        {
+            if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || '_' == c))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    bool operator==(const LogFields& compare) const noexcept
+    {
+        if (fields.size() != compare.fields.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < fields.size(); ++i)
+        {
+            const Field& a = fields[i];
+            const Field& b = compare.fields[i];
+            if (a.name != b.name || a.type != b.type
+                || a.num != b.num || a.str != b.str)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+private:
+    std::vector<Field> fields;
+
+
+    Field& add(const std::string& name, const Type type, const uint64_t num)
+    {
+        if (!ValidName(name))
+        {
+            throw LogFieldsException("Invalid log field name: " + name);
+        }
+        if (nullptr != Find(name))
+        {
+            throw LogFieldsException("Duplicated log field: " + name);
+        }
+        if (fields.size() >= MAX_FIELDS)
+        {
+            throw LogFieldsException("Too many log fields");
+        }
+        fields.push_back({name, type, num, std::string()});
+        return fields.back();
+    }
+
+
+    static void put_u32(std::vector<uint8_t>& buf, const uint32_t v)
+    {
+        buf.push_back(v & 0xff);
+        buf.push_back((v >> 8) & 0xff);
+        buf.push_back((v >> 16) & 0xff);
+        buf.push_back((v >> 24) & 0xff);
+    }
+
+
+    static uint32_t get_u32(const uint8_t *p) noexcept
+    {
+        return (uint32_t) p[0]
+               | ((uint32_t) p[1] << 8)
+               | ((uint32_t) p[2] << 16)
+               | ((uint32_t) p[3] << 24);
+    }
+};
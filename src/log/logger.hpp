@@ -25,9 +25,13 @@
  * @brief  Main log handler class, handles all the Log signals being sent
  */
 
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
 
 #include "dbus-log.hpp"
+#include "logstats.hpp"
 #include "logtag.hpp"
 #include "logwriter.hpp"
 
@@ -43,6 +47,7 @@ public:
            const unsigned int log_level = 3)
         : LogConsumer(dbuscon, interf, "", busname),
           logwr(logwr),
+          ingest_logwr(logwr),
           log_tag(tag)
     {
         SetLogLevel(log_level);
@@ -51,12 +56,38 @@ public:
 
 
     /**
-     *  Adds a LogGroup to be excluded when consuming log events
-     * @param exclgrp LogGroup to exclude
+     *  Enables counting of the log events passing through this Logger
+     *  in a LogServiceStats object shared between several Logger objects
+     *
+     * @param st  LogServiceStats::Ptr to update
+     */
+    void SetServiceStats(LogServiceStats::Ptr st)
+    {
+        service_stats = st;
+    }
+
+
+    /**
+     *  Sets the LogWriter used for the log events received.  When the
+     *  signals are dispatched on another thread than the one adding and
+     *  removing log forwards, each thread needs its own LogWriter, see
+     *  LogIngestShards.
+     *
+     * @param wr  LogWriter to use for the received log events
      */
-    void AddExcludeFilter(LogGroup exclgrp)
+    void SetIngestWriter(LogWriter *wr)
     {
-        exclude_loggroup.push_back(exclgrp);
+        ingest_logwr = wr;
+    }
+
+
+    /**
+     * @return Returns the LogEventCounter with all log events received
+     *         from this log sender
+     */
+    LogEventCounter& GetEventCounter()
+    {
+        return received;
     }
 
 
@@ -74,7 +105,10 @@ public:
         {
             THROW_DBUSEXCEPTION("Logger", "No LogID set in LogSender object");
         }
-        log_forwards[logid] = prx;
+        {
+            std::lock_guard<std::mutex> lg(forwards_mtx);
+            log_forwards[logid] = prx;
+        }
         logwr->Write(LogGroup::LOGGER, LogCategory::DEBUG,
                      "[Logger] Log forward added for " + logid);
     }
@@ -87,8 +121,12 @@ public:
      */
     void RemoveLogForward(const std::string logid)
     {
-        log_forwards[logid] = nullptr;
-        log_forwards.erase(logid);
+        {
+            // Once this returns, the log forwarder is no longer in use
+            std::lock_guard<std::mutex> lg(forwards_mtx);
+            log_forwards[logid] = nullptr;
+            log_forwards.erase(logid);
+        }
         logwr->Write(LogGroup::LOGGER, LogCategory::DEBUG,
                      "[Logger] Log forward removed for " + logid);
     }
@@ -99,30 +137,40 @@ public:
                          const std::string object_path,
                          const LogEvent& logev) override
     {
-        for (const auto& e : exclude_loggroup)
+        received.Add();
+        if (service_stats)
         {
-            if (e == logev.group)
-            {
-                return;  // Don't do anything if this LogGroup is filtered
-            }
+            ++service_stats->received;
         }
 
         // Prepend log lines with the log tag
-        logwr->AddLogTag("logtag", log_tag);
+        ingest_logwr->AddLogTag("logtag", log_tag);
 
         // Add the meta information
-        logwr->AddMeta("sender", sender);
-        logwr->AddMeta("interface", interface);
-        logwr->AddMeta("object_path", object_path);
+        ingest_logwr->AddMeta("sender", sender);
+        ingest_logwr->AddMeta("interface", interface);
+        ingest_logwr->AddMeta("object_path", object_path);
         if (!logev.session_token.empty())
         {
-            logwr->AddMeta("session-token", logev.session_token);
+            ingest_logwr->AddMeta("session-token", logev.session_token);
         }
 
         // And write the real log line
-        logwr->Write(logev);
+        if (service_stats)
+        {
+            auto start = std::chrono::steady_clock::now();
+            ingest_logwr->Write(logev);
+            service_stats->write_latency.Add(std::chrono::steady_clock::now()
+                                             - start);
+            ++service_stats->written;
+        }
+        else
+        {
+            ingest_logwr->Write(logev);
+        }
 
         // If there are any log forwarders attached, do the forwarding
+        std::lock_guard<std::mutex> lg(forwards_mtx);
         if (log_forwards.size() > 0)
         {
             LogEvent proxy_event(logev);
@@ -149,6 +197,13 @@ public:
             // Fail-safe: Only care about StatusChange signals
             return;
         }
+        if (!session_status.empty() && OpenVPN3DBus_interf_sessions != interface_name)
+        {
+            // The session manager is the source of status changes
+            // for this session; don't forward them twice
+            return;
+        }
+        std::lock_guard<std::mutex> lg(forwards_mtx);
         for (const auto& lfwd : log_forwards)
         {
             StatusEvent status(parameters);
@@ -157,9 +212,81 @@ public:
     }
 
 
+    /**
+     *  Forward the StatusChange signals the session manager emits for
+     *  a VPN session, instead of the ones sent by the VPN client
+     *  process itself.  The VPN client only sends its status changes
+     *  to the session manager, which emits them once for all the
+     *  consumers.
+     *
+     *  A VPN client process hosting several sessions adds one source
+     *  per session.
+     *
+     * @param sessionmgr_busname  std::string with the unique bus name of
+     *                            the session manager
+     * @param session_path        std::string with the D-Bus path of the
+     *                            session object
+     */
+    void SetSessionStatusSource(const std::string& sessionmgr_busname,
+                                const std::string& session_path)
+    {
+        session_status[session_path].reset(new SessionStatusSubscription(
+                                 GetConnection(), sessionmgr_busname,
+                                 session_path,
+                                 [this](const std::string& sender,
+                                        const std::string& path,
+                                        GVariant *params)
+                                 {
+                                     ProcessSignal(sender, path,
+                                                   OpenVPN3DBus_interf_sessions,
+                                                   "StatusChange", params);
+                                 }));
+    }
+
+
 private:
+    /**
+     *  Subscription to the StatusChange signals of a single session
+     *  object in the session manager
+     */
+    class SessionStatusSubscription : public DBusSignalSubscription
+    {
+    public:
+        typedef std::function<void(const std::string& sender,
+                                   const std::string& path,
+                                   GVariant *params)> Callback;
+
+        SessionStatusSubscription(GDBusConnection *conn,
+                                  const std::string& busname,
+                                  const std::string& session_path,
+                                  Callback cb)
+            : DBusSignalSubscription(conn, busname,
+                                     OpenVPN3DBus_interf_sessions,
+                                     session_path, "StatusChange"),
+              callback(cb)
+        {
+        }
+
+        void callback_signal_handler(GDBusConnection *connection,
+                                     const std::string sender_name,
+                                     const std::string obj_path,
+                                     const std::string interface_name,
+                                     const std::string signal_name,
+                                     GVariant *parameters) override
+        {
+            callback(sender_name, obj_path, parameters);
+        }
+
+    private:
+        Callback callback;
+    };
+
     LogWriter *logwr;
+    LogWriter *ingest_logwr;
     LogTag::Ptr log_tag;
-    std::vector<LogGroup> exclude_loggroup;
+    std::mutex forwards_mtx;
     std::map<std::string, LogSender*> log_forwards = {};
+    LogServiceStats::Ptr service_stats = nullptr;
+    LogEventCounter received;
+    std::map<std::string, std::unique_ptr<SessionStatusSubscription>> session_status;
 };
@@ -0,0 +1,148 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   loghistory.hpp
+ *
+ * @brief  Fixed size ring buffer keeping the most recent log events
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "logevent.hpp"
+
+
+/**
+ *  Keeps the most recent LogEvent objects in a fixed size ring buffer.
+ *
+ *  Adding log events does not take any locks; each slot is replaced
+ *  atomically, so log events can be added from different threads while
+ *  the history is being read.  A reader racing with writers may see a
+ *  slot which has just been replaced by a newer log event.
+ */
+class LogHistory
+{
+public:
+    using Ptr = std::shared_ptr<LogHistory>;
+
+    /**
+     * @param size  Number of log events to keep
+     */
+    LogHistory(const size_t size)
+        : slots(size)
+    {
+    }
+
+
+    /**
+     *  Add a new log event to the history, replacing the oldest one if
+     *  the history is full
+     *
+     * @param logev  LogEvent to add
+     */
+    void Add(const LogEvent& logev)
+    {
+        if (slots.empty())
+        {
+            return;
+        }
+        std::shared_ptr<const LogEvent> ev = std::make_shared<LogEvent>(logev);
+        uint64_t idx = head.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_store(&slots[idx % slots.size()], ev);
+    }
+
+
+    /**
+     *  Retrieve the most recent log events, oldest first
+     *
+     * @param max_events  Maximum number of log events to return.  0
+     *                    returns the complete history.
+     *
+     * @return Returns a std::vector of LogEvent objects
+     */
+    std::vector<LogEvent> GetLast(size_t max_events) const
+    {
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t count = std::min<uint64_t>(end, slots.size());
+        if (max_events > 0 && max_events < count)
+        {
+            count = max_events;
+        }
+
+        std::vector<LogEvent> ret;
+        ret.reserve(count);
+        for (uint64_t i = end - count; i < end; i++)
+        {
+            std::shared_ptr<const LogEvent> ev = std::atomic_load(&slots[i % slots.size()]);
+            if (ev)
+            {
+                ret.push_back(*ev);
+            }
+        }
+        return ret;
+    }
+
+
+    /**
+     *  Retrieve the log events added after a previous call, oldest
+     *  first.  Log events which have been replaced in the mean time are
+     *  lost.
+     *
+     * @param position  uint64_t with the position returned by the previous
+     *                  call, 0 for the first call.  Updated to the current
+     *                  position.
+     *
+     * @return Returns a std::vector of LogEvent objects
+     */
+    std::vector<LogEvent> GetSince(uint64_t& position) const
+    {
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t start = std::max<uint64_t>(position, end - std::min<uint64_t>(end, slots.size()));
+        position = end;
+
+        std::vector<LogEvent> ret;
+        for (uint64_t i = start; i < end; i++)
+        {
+            std::shared_ptr<const LogEvent> ev = std::atomic_load(&slots[i % slots.size()]);
+            if (ev)
+            {
+                ret.push_back(*ev);
+            }
+        }
+        return ret;
+    }
+
+
+    /**
+     * @return Returns the number of log events this history can keep
+     */
+    size_t Capacity() const noexcept
+    {
+        return slots.size();
+    }
+
+
+private:
+    std::vector<std::shared_ptr<const LogEvent>> slots;
+    std::atomic<uint64_t> head{0};
+};
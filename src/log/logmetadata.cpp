@@ -26,44 +26,114 @@
 #include <algorithm>
 #include <fstream>
 #include <exception>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "logmetadata.hpp"
 #include "logtag.hpp"
 
 
+//
+//  Meta data label interning
+//
+
+struct InternedLabel
+{
+    InternedLabel(const std::string& l)
+        : label(l), upcase(l)
+    {
+        std::transform(upcase.begin(), upcase.end(), upcase.begin(),
+                       [](unsigned char c){ return std::toupper(c); });
+    }
+
+    const std::string label;
+    std::string upcase;
+};
+
+
+/**
+ *  Look up the interned version of a meta data label, adding it if this
+ *  label has not been seen before.  Interned labels are never released;
+ *  the set of labels in use is small and fixed.
+ *
+ * @param l  std::string of the label to look up
+ * @return Returns a reference to the InternedLabel object
+ */
+static const InternedLabel& intern_label(const std::string& l)
+{
+    static std::mutex intern_mtx;
+    static std::unordered_map<std::string, InternedLabel> labels;
+
+    std::lock_guard<std::mutex> lg(intern_mtx);
+    auto it = labels.find(l);
+    if (labels.end() == it)
+    {
+        it = labels.emplace(l, InternedLabel(l)).first;
+    }
+    return it->second;
+}
+
+
 //
 //  LogMetaDataValue  -  implementation
 //
 
 LogMetaDataValue::LogMetaDataValue(const std::string& l, const std::string& v,
                                    bool s)
-    : label(l), str_value(v), logtag(nullptr), skip(s)
+    : label(intern_label(l).label), str_value(v), logtag(nullptr), skip(s),
+      label_upcase(intern_label(l).upcase)
 {
     type = Type::LOGMETA_STRING;
+    render();
 }
 
 
 LogMetaDataValue::LogMetaDataValue(const std::string& l, const LogTag::Ptr v,
                                    bool s)
-    : label(l), str_value(""), logtag(v), skip(s)
+    : label(intern_label(l).label), str_value(""), logtag(v), skip(s),
+      label_upcase(intern_label(l).upcase)
 {
     type = Type::LOGMETA_LOGTAG;
+    render();
 }
 
 
-const std::string LogMetaDataValue::GetValue(const bool logtag_encaps) const
+const std::string& LogMetaDataValue::GetValue(const bool logtag_encaps) const
 {
+    static const std::string invalid_logtag("[INVALID-LOGTAG]");
+
     switch(type)
     {
     case Type::LOGMETA_STRING:
         return str_value;
 
     case Type::LOGMETA_LOGTAG:
-        return (logtag ? logtag->str(logtag_encaps) : "[INVALID-LOGTAG]");
+        return (logtag ? logtag->str(logtag_encaps) : invalid_logtag);
+    }
+    return str_value;
+}
+
+
+const std::string& LogMetaDataValue::GetRecord(const bool upcase_label,
+                                               const bool logtag_encaps) const
+{
+    return records[record_index(upcase_label,
+                                (Type::LOGMETA_LOGTAG == type
+                                 && logtag_encaps))];
+}
+
+
+void LogMetaDataValue::render()
+{
+    records[record_index(false, false)] = label + "=" + GetValue(false);
+    records[record_index(true, false)] = label_upcase + "=" + GetValue(false);
+    if (Type::LOGMETA_LOGTAG == type)
+    {
+        records[record_index(false, true)] = label + "=" + GetValue(true);
+        records[record_index(true, true)] = label_upcase + "=" + GetValue(true);
     }
-    return "";
 }
 
 
@@ -92,22 +162,10 @@ LogMetaData::Records LogMetaData::GetMetaDataRecords(const bool upcase_label,
                                         const bool logtag_encaps) const
 {
     Records ret;
+    ret.reserve(metadata.size());
     for (const auto& mdc : metadata)
     {
-        std::string label = mdc->label;
-        if (upcase_label)
-        {
-            std::transform(label.begin(), label.end(), label.begin(),
-                           [](unsigned char c){ return std::toupper(c); });
-        }
-        if (LogMetaDataValue::Type::LOGMETA_LOGTAG == mdc->type)
-        {
-            ret.push_back(label + "=" + mdc->GetValue(logtag_encaps));
-        }
-        else
-        {
-            ret.push_back(label + "=" + mdc->GetValue());
-        }
+        ret.push_back(mdc->GetRecord(upcase_label, logtag_encaps));
     }
     return ret;
 }
@@ -35,7 +35,11 @@
 /**
  *  The LogMetaDataValue is a container for a single labelled meta data value.
  *
- *  The value can be either a std::string or a LogTag object
+ *  The value can be either a std::string or a LogTag object.
+ *
+ *  The labels are interned, as only a handful of different labels are in
+ *  use.  The "label=value" records are rendered once, when the object is
+ *  created, since the same value is often written by several log writers.
  */
 struct LogMetaDataValue
 {
@@ -82,23 +86,56 @@ struct LogMetaDataValue
      *
      * @return  Returns a std::string of this objects value
      */
-    const std::string GetValue(const bool logtag_encaps=true) const;
+    const std::string& GetValue(const bool logtag_encaps=true) const;
+
+    /**
+     *  Retrieve the pre-rendered "label=value" record of this meta data
+     *
+     * @param upcase_label   bool flag to get the record with an upper case
+     *                       label
+     * @param logtag_encaps  If this object carries a LogTag value, setting
+     *                       this to true will encapsulate the tag hash value
+     *                       with "{tag:......}"
+     *
+     * @return Returns a const reference to the record, valid as long as
+     *         this object exists.
+     */
+    const std::string& GetRecord(const bool upcase_label,
+                                 const bool logtag_encaps=true) const;
 
-    friend std::ostream& operator<<(std::ostream& os, const LogMetaDataValue mdv)
+    friend std::ostream& operator<<(std::ostream& os, const LogMetaDataValue& mdv)
     {
         if (mdv.skip)
         {
             return os;
         }
         bool encaps = (mdv.logtag ? mdv.logtag->encaps : true);
-        return os << mdv.label << "=" << mdv.GetValue(encaps);
+        return os << mdv.GetRecord(false, encaps);
     }
 
     Type type;
-    std::string label;
+    const std::string& label;
     const std::string str_value;
     const LogTag::Ptr logtag;
     bool skip;
+
+private:
+    const std::string& label_upcase;
+
+    /**
+     *  Pre-rendered records, indexed by record_index().  Records for
+     *  std::string values do not depend on the LogTag encapsulation, so
+     *  only the first two are used for those.
+     */
+    std::string records[4];
+
+    static size_t record_index(const bool upcase_label,
+                               const bool logtag_encaps)
+    {
+        return (upcase_label ? 2 : 0) + (logtag_encaps ? 1 : 0);
+    }
+
+    void render();
 };
 
 
@@ -172,6 +209,24 @@ public:
     Records GetMetaDataRecords(const bool upcase_label=false,
                                const bool logtag_encaps=true) const;
 
+    /**
+     *  Iterate over the collected LogMetaDataValue objects, in the order
+     *  they were added.  This gives direct access to the values without
+     *  building new strings, for log writers sensitive to the overhead
+     *  of GetMetaDataRecords().
+     */
+    using const_iterator = std::vector<LogMetaDataValue::Ptr>::const_iterator;
+    const_iterator begin() const
+    {
+        return metadata.begin();
+    }
+
+    const_iterator end() const
+    {
+        return metadata.end();
+    }
+
+
     /**
      *  Retrieve how many meta data values has been collected
      */
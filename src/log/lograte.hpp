@@ -0,0 +1,136 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   lograte.hpp
+ *
+ * @brief  Token bucket rate limiter collapsing repeated log events
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "logevent.hpp"
+
+
+/**
+ *  Limits the number of log events being sent, using a token bucket.
+ *
+ *  The bucket holds up to @burst tokens and is refilled with @rate tokens
+ *  per second.  Each log event sent consumes one token; log events
+ *  arriving when the bucket is empty are suppressed.  Log events
+ *  identical to the previously sent one are not sent at all, but
+ *  counted and reported as "Last message repeated N times" once a
+ *  different log event arrives.
+ *
+ *  Critical and fatal log events are never suppressed.
+ */
+class LogRateLimiter
+{
+public:
+    using Ptr = std::unique_ptr<LogRateLimiter>;
+
+    /**
+     * @param rate   Number of log events per second allowed on average
+     * @param burst  Number of log events allowed in a burst
+     */
+    LogRateLimiter(const unsigned int rate, const unsigned int burst)
+        : rate(rate), burst(std::max(rate, burst)), tokens(this->burst),
+          last_refill(std::chrono::steady_clock::now())
+    {
+    }
+
+
+    /**
+     *  Check if a log event may be sent.
+     *
+     * @param logev   LogEvent about to be sent
+     * @param notice  LogEvent which is set if a summary of repeated or
+     *                suppressed log events must be sent before @logev.
+     *                If nothing needs to be reported, it is left empty.
+     *
+     * @return Returns true if @logev should be sent
+     */
+    bool Allow(const LogEvent& logev, LogEvent& notice)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        if (!last.empty() && logev == last)
+        {
+            ++repeated;
+            return false;
+        }
+        if (repeated > 0)
+        {
+            notice = LogEvent(last.group, last.category, last.session_token,
+                              "Last message repeated "
+                              + std::to_string(repeated) + " times");
+            repeated = 0;
+        }
+
+        refill();
+        if (tokens < 1.0
+            && LogCategory::CRIT != logev.category
+            && LogCategory::FATAL != logev.category)
+        {
+            ++suppressed;
+            return false;
+        }
+        tokens = std::max(0.0, tokens - 1.0);
+
+        if (suppressed > 0)
+        {
+            std::string msg = std::to_string(suppressed)
+                              + " log events suppressed by rate limit";
+            if (!notice.empty())
+            {
+                msg = notice.message + "; " + msg;
+            }
+            notice = LogEvent(logev.group, LogCategory::WARN,
+                              logev.session_token, msg);
+            suppressed = 0;
+        }
+        last = logev;
+        return true;
+    }
+
+
+private:
+    const double rate;
+    const double burst;
+    double tokens;
+    std::chrono::steady_clock::time_point last_refill;
+    LogEvent last = {};
+    unsigned int repeated = 0;
+    unsigned int suppressed = 0;
+    std::mutex mtx;
+
+
+    void refill()
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - last_refill;
+        last_refill = now;
+        tokens = std::min(burst, tokens + elapsed.count() * rate);
+    }
+};
@@ -0,0 +1,163 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logstats.hpp
+ *
+ * @brief  Counters and latency histograms for the log service
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/latency-histogram.hpp"
+
+
+/**
+ *  Latency histogram with fixed, logarithmic bucket bounds, used for
+ *  the log service statistics
+ */
+class LogLatencyHistogram : public LatencyHistogram
+{
+public:
+    LogLatencyHistogram()
+        : LatencyHistogram(BucketBounds())
+    {
+    }
+
+
+    /**
+     *  Retrieve the upper bounds of the histogram buckets, in
+     *  microseconds.  The histogram has one more bucket than bounds,
+     *  counting all latencies above the last bound.
+     *
+     * @return Returns a std::vector with the bucket bounds
+     */
+    static const std::vector<uint64_t>& BucketBounds()
+    {
+        static const std::vector<uint64_t> bounds = {
+            10, 100, 1000, 10000, 100000, 1000000
+        };
+        return bounds;
+    }
+};
+
+
+
+/**
+ *  Counts events and calculates the event rate.  The rate is the
+ *  average number of events per second in the last completed
+ *  measurement window.
+ *
+ *  Events may be counted on another thread than the one reading the
+ *  counters, see LogIngestShards.
+ */
+class LogEventCounter
+{
+public:
+    /**
+     * @param window  Length of the measurement window used for the
+     *                event rate
+     */
+    LogEventCounter(const std::chrono::steady_clock::duration window
+                        = std::chrono::seconds(10))
+        : window(window), window_start(std::chrono::steady_clock::now())
+    {
+    }
+
+
+    /**
+     *  Count a new event
+     */
+    void Add()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        update_window(std::chrono::steady_clock::now());
+        ++count;
+        ++window_count;
+    }
+
+
+    /**
+     * @return Returns the total number of events counted
+     */
+    uint64_t GetCount()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return count;
+    }
+
+
+    /**
+     * @return Returns the number of events per second in the last
+     *         completed measurement window
+     */
+    double GetRate()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        update_window(std::chrono::steady_clock::now());
+        return rate;
+    }
+
+
+private:
+    const std::chrono::steady_clock::duration window;
+    std::mutex mtx;
+    std::chrono::steady_clock::time_point window_start;
+    uint64_t count = 0;
+    uint64_t window_count = 0;
+    double rate = 0.0;
+
+
+    void update_window(const std::chrono::steady_clock::time_point now)
+    {
+        std::chrono::duration<double> elapsed = now - window_start;
+        if (now - window_start < window)
+        {
+            return;
+        }
+        rate = window_count / elapsed.count();
+        window_count = 0;
+        window_start = now;
+    }
+};
+
+
+
+/**
+ *  Statistics for all log events passing through the log service
+ */
+struct LogServiceStats
+{
+    using Ptr = std::shared_ptr<LogServiceStats>;
+
+    /// Log events received from all attached log senders
+    std::atomic<uint64_t> received{0};
+
+    /// Log events passed on to the LogWriter
+    std::atomic<uint64_t> written{0};
+
+    /// Time spent in the LogWriter Write() call per log event
+    LogLatencyHistogram write_latency;
+};
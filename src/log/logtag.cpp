@@ -23,7 +23,10 @@
  * @brief  Implementation of the LogTag class
  */
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
+
 #include "logtag.hpp"
 
 //
@@ -38,12 +41,14 @@ LogTag::LogTag(std::string sender, std::string interface, const bool default_enc
     // Create a hash of the tag, used as an index
     std::hash<std::string> hashfunc;
     hash = hashfunc(tag);
+    render();
 }
 
 
 LogTag::LogTag()
     : tag(), hash(0), encaps(true)
 {
+    render();
 }
 
 
@@ -52,6 +57,43 @@ LogTag::LogTag(const LogTag& cp)
     tag = cp.tag;
     hash = cp.hash;
     encaps = cp.encaps;
+    hash_str = cp.hash_str;
+    hash_encaps = cp.hash_encaps;
+}
+
+
+LogTag::Ptr LogTag::create(const std::string &sender,
+                           const std::string &interface,
+                           const bool default_encaps)
+{
+    static std::mutex intern_mtx;
+    static std::unordered_map<std::string, std::weak_ptr<LogTag>> interned;
+
+    std::string key = std::string(default_encaps ? "E" : "N")
+                      + sender + "/" + interface;
+
+    std::lock_guard<std::mutex> lg(intern_mtx);
+    auto it = interned.find(key);
+    if (interned.end() != it)
+    {
+        LogTag::Ptr r = it->second.lock();
+        if (r)
+        {
+            return r;
+        }
+    }
+
+    // Clean up entries for LogTags no longer in use, to avoid growing
+    // this table for each new log sender
+    for (auto i = interned.begin(); i != interned.end();)
+    {
+        i = (i->second.expired() ? interned.erase(i) : std::next(i));
+    }
+
+    LogTag::Ptr r;
+    r.reset(new LogTag(sender, interface, default_encaps));
+    interned[key] = r;
+    return r;
 }
 
 LogTag::~LogTag()
@@ -61,21 +103,20 @@ LogTag::~LogTag()
     encaps = true;
 }
 
-const std::string LogTag::str() const
+const std::string& LogTag::str() const
 {
     return LogTag::str(encaps);
 }
 
 
-const std::string LogTag::str(const bool override) const
+const std::string& LogTag::str(const bool override) const
 {
-    if (override)
-    {
-        return std::string("{tag:") + std::string(std::to_string(hash))
-               + std::string("}");
-    }
-    else
-    {
-        return std::string(std::to_string(hash));
-    }
+    return (override ? hash_encaps : hash_str);
+}
+
+
+void LogTag::render()
+{
+    hash_str = std::to_string(hash);
+    hash_encaps = std::string("{tag:") + hash_str + "}";
 }
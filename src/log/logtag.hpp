@@ -59,14 +59,21 @@ struct LogTag
         return r;
     }
 
+    /**
+     *  Retrieve a LogTag object for a sender and interface.  LogTag objects
+     *  are interned; as long as a LogTag object for the same sender,
+     *  interface and encapsulation setting is in use, that object is
+     *  returned instead of creating and hashing a new one.
+     *
+     * @param sender     std::string of the D-Bus unique bus name (1:xxxx)
+     * @param interface  std::string of the D-Bus interface sending events
+     * @param default_encaps  Default encapsulation setting for str()
+     *
+     * @return Returns a LogTag::Ptr to the shared LogTag object
+     */
     static LogTag::Ptr create(const std::string &sender,
                               const std::string &interface,
-                              const bool default_encaps=true)
-    {
-        LogTag::Ptr r;
-        r.reset(new LogTag(sender, interface, default_encaps));
-        return r;
-    }
+                              const bool default_encaps=true);
 
 
     /**
@@ -82,9 +89,10 @@ struct LogTag
      *                   tag hash.
      *
      * @return  Returns a std::string containing the tag this sender and
-     *          interface will use
+     *          interface will use.  The string is rendered when the
+     *          LogTag is created.
      */
-     virtual const std::string str(const bool override) const;
+     virtual const std::string& str(const bool override) const;
 
      /**
       *  This is the same as the @str(const bool) variant, just that it will
@@ -93,7 +101,7 @@ struct LogTag
      * @return  Returns a std::string containing the tag this sender and
      *          interface will use
       */
-     const std::string str() const;
+     const std::string& str() const;
 
     /**
      *  Write a formatted tag string via iostreams
@@ -113,4 +121,10 @@ struct LogTag
     std::string tag{};    /**<  Contains the string used for the hash generation */
     size_t hash{};        /**<  Contains the hash value for this LogTag */
     bool encaps = true;   /**<  Encapsulate the hash value in "{tag:...}" */
+
+private:
+    std::string hash_str{};    /**<  Pre-rendered hash value */
+    std::string hash_encaps{}; /**<  Pre-rendered "{tag:...}" string */
+
+    void render();
 };
@@ -28,10 +28,12 @@
 
 #include <syslog.h>
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "common/timestamp.hpp"
 #include "logevent.hpp"
 #include "logtag.hpp"
 #include "logmetadata.hpp"
@@ -75,6 +77,32 @@ public:
     }
 
 
+    /**
+     *  Sets how precise the timestamps are.  When used together with
+     *  AsyncLogWriter, this must be set on the backend LogWriter before
+     *  it is passed to the AsyncLogWriter.
+     *
+     * @param prec  TimestampFormatter::Precision to use
+     */
+    void SetTimestampPrecision(const TimestampFormatter::Precision prec)
+    {
+        tsformat.SetPrecision(prec);
+    }
+
+
+    /**
+     *  Sets the time the log data passed to the next Write() call was
+     *  created.  Without this, the time of the Write() call is used.
+     *  Write(const LogEvent&) sets this from the LogEvent itself.
+     *
+     * @param t  std::chrono::system_clock::time_point of the log data
+     */
+    void SetEventTime(const std::chrono::system_clock::time_point& t)
+    {
+        event_time = t;
+    }
+
+
     /**
      *  Turns on/off logging meta data
      *
@@ -103,6 +131,83 @@ public:
     }
 
 
+    /**
+     *  Turns on/off flushing the log destination after each log line.
+     *  When disabled, Flush() must be called to ensure all written log
+     *  data has reached the destination.
+     *
+     * @param af  Boolean to enable (true) or disable (false) automatic
+     *            flushing
+     */
+    void EnableAutoFlush(const bool af)
+    {
+        autoflush = af;
+    }
+
+    bool AutoFlushEnabled() const noexcept
+    {
+        return autoflush;
+    }
+
+
+    /**
+     *  Flushes any buffered log data to the log destination.  Log writers
+     *  not doing any buffering do not need to implement this.
+     */
+    virtual void Flush()
+    {
+    }
+
+
+    /**
+     *  Reopens the log destination, typically after it has been rotated
+     *  by an external tool.  Log writers not writing to files do not
+     *  need to implement this.
+     */
+    virtual void Reopen()
+    {
+    }
+
+
+    /**
+     *  Retrieve the number of log events waiting to be written.  Only
+     *  log writers queuing log events need to implement this.
+     *
+     * @return Returns the number of queued log events
+     */
+    virtual size_t GetQueueDepth()
+    {
+        return 0;
+    }
+
+
+    /**
+     *  Retrieve the number of log events discarded by this log writer
+     *  since it was created.
+     *
+     * @return Returns the number of dropped log events
+     */
+    virtual size_t GetDroppedCount()
+    {
+        return 0;
+    }
+
+
+    /**
+     *  Retrieve the histogram of the time log events spent waiting
+     *  in a queue until they were written.  The buckets are described
+     *  by LogLatencyHistogram::BucketBounds().
+     *
+     * @return Returns a std::vector with the number of log events in each
+     *         bucket.  Log writers not queuing log events return an
+     *         empty vector.
+     */
+    virtual std::vector<uint64_t> GetQueueLatency()
+    {
+        return {};
+    }
+
+
     /**
      *  Writes log data to the destination buffer
      *
@@ -165,7 +270,9 @@ public:
      */
     virtual void Write(const LogEvent& logev)
     {
+        event_time = logev.created;
         Write(logev.group, logev.category, logev.message);
+        event_time = {};
     }
 
 
@@ -233,4 +340,24 @@ protected:
     bool prepend_prefix = true;
     std::string prepend_label;
     bool prepend_meta = false;
+    bool autoflush = true;
+    TimestampFormatter tsformat;
+    std::chrono::system_clock::time_point event_time = {};
+
+
+    /**
+     *  Renders the timestamp of the log data being written; the time
+     *  set by SetEventTime() or, if not set, the current time.
+     *
+     * @return Returns a reference to the rendered timestamp, valid until
+     *         the next call.
+     */
+    const std::string& get_timestamp()
+    {
+        if (std::chrono::system_clock::time_point() == event_time)
+        {
+            return tsformat.Format(std::chrono::system_clock::now());
+        }
+        return tsformat.Format(event_time);
+    }
 };
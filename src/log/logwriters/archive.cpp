@@ -0,0 +1,268 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   archive.cpp
+ *
+ * @brief  Implementation of ArchiveLogWriter
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log/logwriter.hpp"
+#include "log/log-helpers.hpp"
+#include "log/logwriters/archive.hpp"
+
+
+ArchiveLogWriter::ArchiveLogWriter(const std::string& dir,
+                                   const size_t segsize,
+                                   const unsigned int maxseg)
+    : LogWriter(), directory(dir), segment_size(segsize),
+      max_segments(maxseg)
+{
+    if (segment_size < 65536)
+    {
+        THROW_LOGEXCEPTION("Log archive segment size must be at least 64 KiB");
+    }
+    if (0 != mkdir(directory.c_str(), 0750) && EEXIST != errno)
+    {
+        THROW_LOGEXCEPTION("Could not create log archive directory "
+                           + directory + ": " + strerror(errno));
+    }
+
+    std::vector<uint32_t> segments = LogArchive::ListSegments(directory);
+    open_segment(segments.empty() ? 0 : segments.back() + 1);
+}
+
+
+ArchiveLogWriter::~ArchiveLogWriter()
+{
+    try
+    {
+        close_segment();
+    }
+    catch (const LogException& excp)
+    {
+        std::cerr << "ArchiveLogWriter: " << excp.what() << std::endl;
+    }
+}
+
+
+const std::string ArchiveLogWriter::GetLogWriterInfo() const
+{
+    return std::string("archive:") + directory;
+}
+
+
+bool ArchiveLogWriter::TimestampEnabled()
+{
+    return true;
+}
+
+
+void ArchiveLogWriter::Write(const std::string& data,
+                             const std::string& colour_init,
+                             const std::string& colour_reset)
+{
+    ArchiveLogWriter::Write(LogEvent(LogGroup::UNDEFINED, LogCategory::INFO,
+                                     data));
+}
+
+
+void ArchiveLogWriter::Write(const LogGroup grp, const LogCategory ctg,
+                             const std::string& data,
+                             const std::string& colour_init,
+                             const std::string& colour_reset)
+{
+    ArchiveLogWriter::Write(LogEvent(grp, ctg, data));
+}
+
+
+void ArchiveLogWriter::Write(const LogEvent& event)
+{
+    using namespace LogArchive;
+
+    uint64_t tag_hash = 0;
+    for (const auto& mdv : metadata)
+    {
+        if (LogMetaDataValue::Type::LOGMETA_LOGTAG == mdv->type && mdv->logtag)
+        {
+            tag_hash = mdv->logtag->hash;
+            break;
+        }
+    }
+    prepend_label.clear();
+    metadata.clear();
+
+    size_t token_len = std::min(event.session_token.size(), (size_t) UINT16_MAX);
+    size_t msg_len = event.message.size();
+
+    fields_buf.clear();
+    if (!event.fields.empty())
+    {
+        event.fields.Encode(fields_buf);
+    }
+
+    // Messages not fitting into an empty segment are truncated, and
+    // their log fields are left out
+    size_t max_payload = segment_size - sizeof(SegmentHeader)
+                         - sizeof(RecordHeader) - token_len;
+    if (msg_len + fields_buf.size() > max_payload)
+    {
+        fields_buf.clear();
+        msg_len = std::min(msg_len, max_payload & ~((size_t) 7));
+    }
+    size_t fields_len = fields_buf.size();
+
+    size_t record_len = AlignRecord(sizeof(RecordHeader) + token_len + msg_len
+                                    + fields_len);
+    if (write_offset + record_len > segment_size)
+    {
+        close_segment();
+        open_segment(segment + 1);
+    }
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    RecordHeader *rec = reinterpret_cast<RecordHeader *>(map + write_offset);
+    rec->msg_len = msg_len;
+    rec->timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    rec->tag_hash = tag_hash;
+    rec->group = (uint8_t) event.group;
+    rec->category = (uint8_t) event.category;
+    rec->token_len = token_len;
+    rec->fields_len = fields_len;
+
+    char *payload = map + write_offset + sizeof(RecordHeader);
+    memcpy(payload, event.session_token.data(), token_len);
+    memcpy(payload + token_len, event.message.data(), msg_len);
+    if (fields_len > 0)
+    {
+        memcpy(payload + token_len + msg_len, fields_buf.data(), fields_len);
+    }
+
+    // The record length is set last; a reader scanning the active
+    // segment stops at the first record without a length
+    rec->record_len = record_len;
+
+    index.Add(write_offset, rec->timestamp_us, event.session_token.substr(0, token_len));
+    write_offset += record_len;
+}
+
+
+void ArchiveLogWriter::Flush()
+{
+    if (map)
+    {
+        msync(map, write_offset, MS_ASYNC);
+    }
+}
+
+
+void ArchiveLogWriter::open_segment(const uint32_t segnum)
+{
+    std::string fname = LogArchive::SegmentFilename(directory, segnum);
+    int fd = open(fname.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0640);
+    if (-1 == fd)
+    {
+        THROW_LOGEXCEPTION("Could not create log archive segment " + fname
+                           + ": " + strerror(errno));
+    }
+    if (0 != ftruncate(fd, segment_size))
+    {
+        std::string err(strerror(errno));
+        close(fd);
+        unlink(fname.c_str());
+        THROW_LOGEXCEPTION("Could not allocate log archive segment " + fname
+                           + ": " + err);
+    }
+    void *m = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == m)
+    {
+        std::string err(strerror(errno));
+        unlink(fname.c_str());
+        THROW_LOGEXCEPTION("Could not map log archive segment " + fname
+                           + ": " + err);
+    }
+
+    map = static_cast<char *>(m);
+    segment = segnum;
+    index = LogArchive::SegmentIndex();
+
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    LogArchive::SegmentHeader *hdr = reinterpret_cast<LogArchive::SegmentHeader *>(map);
+    memcpy(hdr->magic, LogArchive::SegmentMagic, sizeof(hdr->magic));
+    hdr->version = LogArchive::FormatVersion;
+    hdr->header_size = sizeof(LogArchive::SegmentHeader);
+    hdr->created_us = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    hdr->reserved = 0;
+    write_offset = sizeof(LogArchive::SegmentHeader);
+
+    remove_old_segments();
+}
+
+
+void ArchiveLogWriter::close_segment()
+{
+    if (!map)
+    {
+        return;
+    }
+
+    msync(map, write_offset, MS_SYNC);
+    munmap(map, segment_size);
+    map = nullptr;
+
+    // Release the preallocated space not used by this segment
+    std::string fname = LogArchive::SegmentFilename(directory, segment);
+    if (0 != truncate(fname.c_str(), write_offset))
+    {
+        THROW_LOGEXCEPTION("Could not truncate log archive segment " + fname
+                           + ": " + strerror(errno));
+    }
+    index.Save(LogArchive::SegmentFilename(directory, segment, true));
+}
+
+
+void ArchiveLogWriter::remove_old_segments()
+{
+    if (0 == max_segments)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> segments = LogArchive::ListSegments(directory);
+    for (size_t i = 0; i + max_segments < segments.size(); i++)
+    {
+        unlink(LogArchive::SegmentFilename(directory, segments[i], true).c_str());
+        unlink(LogArchive::SegmentFilename(directory, segments[i]).c_str());
+    }
+}
@@ -0,0 +1,100 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   archive.hpp
+ *
+ * @brief  Declaration of the ArchiveLogWriter implementation of LogWriter
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "log/logwriter.hpp"
+#include "log/log-archive.hpp"
+
+
+/**
+ *  LogWriter implementation appending log events to a binary log archive.
+ *  See log/log-archive.hpp for details about the format.
+ *
+ *  The active segment file is preallocated and memory mapped.  When it
+ *  is full, the segment is truncated to the used size, its index is
+ *  written and a new segment is started.
+ */
+class ArchiveLogWriter : public LogWriter
+{
+public:
+    /**
+     *  Initialize the ArchiveLogWriter.  A new segment is always started,
+     *  existing segments in the archive directory are kept.
+     *
+     * @param directory     std::string with the archive directory
+     * @param segment_size  Size of each segment file, in bytes
+     * @param max_segments  Maximum number of segments to keep in the archive
+     *                      directory.  The oldest segments are removed
+     *                      when starting a new one.  0 keeps all segments.
+     */
+    ArchiveLogWriter(const std::string& directory,
+                     const size_t segment_size,
+                     const unsigned int max_segments = 0);
+    virtual ~ArchiveLogWriter();
+
+    const std::string GetLogWriterInfo() const override;
+
+    /**
+     *  All archived log events carry a timestamp, regardless of the
+     *  timestamp flag.
+     *
+     * @return Will always return true.
+     */
+    bool TimestampEnabled() override;
+
+    void Write(const std::string& data,
+               const std::string& colour_init = "",
+               const std::string& colour_reset = "") override;
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data,
+               const std::string& colour_init,
+               const std::string& colour_reset) override;
+    void Write(const LogEvent& event) override;
+
+    void Flush() override;
+
+
+private:
+    const std::string directory;
+    const size_t segment_size;
+    const unsigned int max_segments;
+
+    uint32_t segment = 0;
+    char *map = nullptr;
+    size_t write_offset = 0;
+    LogArchive::SegmentIndex index;
+
+    /// Encoded log fields of the record being written, reused between records
+    std::vector<uint8_t> fields_buf;
+
+
+    void open_segment(const uint32_t segnum);
+    void close_segment();
+    void remove_old_segments();
+};
@@ -0,0 +1,485 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   async.cpp
+ *
+ * @brief  Implementation of AsyncLogWriter
+ */
+
+#include <string>
+
+#include "../logwriter.hpp"
+#include "async.hpp"
+
+
+/**
+ *  Maximum number of queue entries processed per batch.  The queue lock
+ *  is not held while a batch is written.
+ */
+static const size_t max_batch_size = 256;
+
+
+AsyncLogWriter::AsyncLogWriter(LogWriter::Ptr backend_writer,
+                               const size_t queue_size,
+                               const std::chrono::milliseconds flush_intv,
+                               const OverflowPolicy overflow_policy)
+    : LogWriter(), backend(std::move(backend_writer)),
+      flush_interval(flush_intv), overflow(overflow_policy)
+{
+    if (!backend)
+    {
+        THROW_LOGEXCEPTION("AsyncLogWriter: Missing backend LogWriter");
+    }
+    if (0 == queue_size)
+    {
+        THROW_LOGEXCEPTION("AsyncLogWriter: Queue size cannot be 0");
+    }
+
+    // Take over the settings of the backend.  The backend settings are
+    // updated from each queue entry by the writer thread, so from now
+    // on only the writer thread may touch the backend.
+    timestamp = backend->TimestampEnabled();
+    log_meta = backend->LogMetaEnabled();
+    prepend_prefix = backend->MessagePrependEnabled();
+
+    // Some writers report timestamps as always enabled, regardless of
+    // the timestamp flag (journald, syslog).  Preserve that.
+    backend->EnableTimestamp(false);
+    backend_timestamp_forced = backend->TimestampEnabled();
+
+    backend->EnableAutoFlush(false);
+    ring.resize(queue_size);
+    writer_thread = std::thread([this]()
+                                {
+                                    writer_loop();
+                                });
+}
+
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    {
+        std::lock_guard<std::mutex> lg(queue_mtx);
+        running = false;
+    }
+    queue_cv.notify_all();
+    space_cv.notify_all();
+    if (writer_thread.joinable())
+    {
+        writer_thread.join();
+    }
+}
+
+
+const std::string AsyncLogWriter::GetLogWriterInfo() const
+{
+    return backend->GetLogWriterInfo() + " (async)";
+}
+
+
+bool AsyncLogWriter::TimestampEnabled()
+{
+    return backend_timestamp_forced || timestamp;
+}
+
+
+/**
+ *  LogWriter front-end with its own meta data, queuing its log events
+ *  in the AsyncLogWriter which created it
+ */
+class AsyncLogWriter::Producer : public LogWriter
+{
+public:
+    Producer(AsyncLogWriter& parent)
+        : parent(parent)
+    {
+    }
+
+    const std::string GetLogWriterInfo() const override
+    {
+        return parent.GetLogWriterInfo();
+    }
+
+    bool TimestampEnabled() override
+    {
+        return parent.TimestampEnabled();
+    }
+
+    void Write(const std::string& data,
+               const std::string& colour_init = "",
+               const std::string& colour_reset = "") override
+    {
+        enqueue(data_entry(data, colour_init, colour_reset));
+    }
+
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data,
+               const std::string& colour_init,
+               const std::string& colour_reset) override
+    {
+        enqueue(group_entry(grp, ctg, data, colour_init, colour_reset));
+    }
+
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data) override
+    {
+        enqueue(group_entry(grp, ctg, data));
+    }
+
+    void Write(const LogEvent& logev) override
+    {
+        enqueue(event_entry(logev));
+    }
+
+    void Flush() override
+    {
+        parent.Flush();
+    }
+
+    size_t GetDroppedCount() override
+    {
+        return parent.GetDroppedCount();
+    }
+
+    size_t GetQueueDepth() override
+    {
+        return parent.GetQueueDepth();
+    }
+
+    std::vector<uint64_t> GetQueueLatency() override
+    {
+        return parent.GetQueueLatency();
+    }
+
+private:
+    AsyncLogWriter& parent;
+
+    void enqueue(QueueEntry&& entry)
+    {
+        // Only this producer's own meta data is used
+        entry.metadata = metadata;
+        entry.prepend_label = prepend_label;
+        entry.prepend_meta = prepend_meta;
+        metadata.clear();
+        prepend_label.clear();
+
+        std::unique_lock<std::mutex> lk(parent.queue_mtx);
+        parent.enqueue_locked(lk, std::move(entry));
+    }
+};
+
+
+void AsyncLogWriter::Write(const std::string& data,
+                           const std::string& colour_init,
+                           const std::string& colour_reset)
+{
+    enqueue(data_entry(data, colour_init, colour_reset));
+}
+
+
+void AsyncLogWriter::Write(const LogGroup grp, const LogCategory ctg,
+                           const std::string& data,
+                           const std::string& colour_init,
+                           const std::string& colour_reset)
+{
+    enqueue(group_entry(grp, ctg, data, colour_init, colour_reset));
+}
+
+
+void AsyncLogWriter::Write(const LogGroup grp, const LogCategory ctg,
+                           const std::string& data)
+{
+    enqueue(group_entry(grp, ctg, data));
+}
+
+
+void AsyncLogWriter::Write(const LogEvent& logev)
+{
+    enqueue(event_entry(logev));
+}
+
+
+LogWriter::Ptr AsyncLogWriter::NewProducer()
+{
+    return LogWriter::Ptr(new Producer(*this));
+}
+
+
+void AsyncLogWriter::Flush()
+{
+    std::unique_lock<std::mutex> lk(queue_mtx);
+    idle_cv.wait(lk, [this]()
+                     {
+                         return (0 == ring_count && !busy) || !running;
+                     });
+}
+
+
+void AsyncLogWriter::Reopen()
+{
+    backend->Reopen();
+}
+
+
+size_t AsyncLogWriter::GetDroppedCount()
+{
+    std::lock_guard<std::mutex> lg(queue_mtx);
+    return dropped;
+}
+
+
+size_t AsyncLogWriter::GetQueueDepth()
+{
+    std::lock_guard<std::mutex> lg(queue_mtx);
+    return ring_count;
+}
+
+
+std::vector<uint64_t> AsyncLogWriter::GetQueueLatency()
+{
+    return queue_latency.Get();
+}
+
+
+AsyncLogWriter::OverflowPolicy AsyncLogWriter::ParseOverflowPolicy(const std::string& policy)
+{
+    if ("drop" == policy)
+    {
+        return OverflowPolicy::DROP;
+    }
+    else if ("block" == policy)
+    {
+        return OverflowPolicy::BLOCK;
+    }
+    THROW_LOGEXCEPTION("Invalid log queue overflow policy: " + policy);
+}
+
+
+AsyncLogWriter::QueueEntry AsyncLogWriter::data_entry(const std::string& data,
+                                                      const std::string& colour_init,
+                                                      const std::string& colour_reset)
+{
+    QueueEntry e;
+    e.type = WriteType::DATA;
+    e.data = data;
+    e.colour_init = colour_init;
+    e.colour_reset = colour_reset;
+    return e;
+}
+
+
+AsyncLogWriter::QueueEntry AsyncLogWriter::group_entry(const LogGroup grp,
+                                                       const LogCategory ctg,
+                                                       const std::string& data,
+                                                       const std::string& colour_init,
+                                                       const std::string& colour_reset)
+{
+    QueueEntry e;
+    e.type = WriteType::GROUP_CATEGORY_COLOUR;
+    e.group = grp;
+    e.category = ctg;
+    e.data = data;
+    e.colour_init = colour_init;
+    e.colour_reset = colour_reset;
+    return e;
+}
+
+
+AsyncLogWriter::QueueEntry AsyncLogWriter::group_entry(const LogGroup grp,
+                                                       const LogCategory ctg,
+                                                       const std::string& data)
+{
+    QueueEntry e;
+    e.type = WriteType::GROUP_CATEGORY;
+    e.group = grp;
+    e.category = ctg;
+    e.data = data;
+    return e;
+}
+
+
+AsyncLogWriter::QueueEntry AsyncLogWriter::event_entry(const LogEvent& logev)
+{
+    QueueEntry e;
+    e.type = WriteType::LOGEVENT;
+    e.event = logev;
+    return e;
+}
+
+
+void AsyncLogWriter::enqueue(QueueEntry&& entry)
+{
+    // Write() may be called from several threads, so the writer state
+    // is captured under the queue lock as well
+    std::unique_lock<std::mutex> lk(queue_mtx);
+
+    // Capture the meta data the Write() call would have used, and reset
+    // it the same way the other LogWriter implementations do
+    entry.metadata = metadata;
+    entry.prepend_label = prepend_label;
+    entry.prepend_meta = prepend_meta;
+    metadata.clear();
+    prepend_label.clear();
+
+    enqueue_locked(lk, std::move(entry));
+}
+
+
+void AsyncLogWriter::enqueue_locked(std::unique_lock<std::mutex>& lk,
+                                    QueueEntry&& entry)
+{
+    entry.timestamp = timestamp;
+    entry.log_meta = log_meta;
+    entry.prepend_prefix = prepend_prefix;
+    entry.queued = std::chrono::steady_clock::now();
+    if (WriteType::LOGEVENT != entry.type)
+    {
+        entry.created = std::chrono::system_clock::now();
+    }
+
+    if (ring.size() == ring_count)
+    {
+        if (OverflowPolicy::DROP == overflow)
+        {
+            ++dropped;
+            return;
+        }
+        space_cv.wait(lk, [this]()
+                          {
+                              return ring_count < ring.size() || !running;
+                          });
+        if (!running)
+        {
+            return;
+        }
+    }
+    ring[(ring_head + ring_count) % ring.size()] = std::move(entry);
+    ++ring_count;
+    lk.unlock();
+    queue_cv.notify_one();
+}
+
+
+void AsyncLogWriter::writer_loop()
+{
+    std::vector<QueueEntry> batch;
+    batch.reserve(max_batch_size);
+    auto last_flush = std::chrono::steady_clock::now();
+    bool need_flush = false;
+
+    std::unique_lock<std::mutex> lk(queue_mtx);
+    while (running || ring_count > 0)
+    {
+        if (0 == ring_count)
+        {
+            if (need_flush)
+            {
+                lk.unlock();
+                backend->Flush();
+                lk.lock();
+                need_flush = false;
+                last_flush = std::chrono::steady_clock::now();
+            }
+            busy = false;
+            idle_cv.notify_all();
+            queue_cv.wait(lk, [this]()
+                              {
+                                  return ring_count > 0 || !running;
+                              });
+            continue;
+        }
+
+        // Move a batch out of the ring buffer, so new log events can
+        // be queued while the batch is written
+        busy = true;
+        while (ring_count > 0 && batch.size() < max_batch_size)
+        {
+            batch.push_back(std::move(ring[ring_head]));
+            ring_head = (ring_head + 1) % ring.size();
+            --ring_count;
+        }
+        size_t new_drops = dropped - dropped_reported;
+        dropped_reported = dropped;
+        lk.unlock();
+        space_cv.notify_all();
+
+        if (new_drops > 0)
+        {
+            backend->Write(LogEvent(LogGroup::LOGGER, LogCategory::WARN,
+                                    std::to_string(new_drops)
+                                    + " log events dropped, log queue full"));
+        }
+        for (auto& entry : batch)
+        {
+            write_entry(entry);
+        }
+        batch.clear();
+        need_flush = true;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_flush >= flush_interval)
+        {
+            backend->Flush();
+            need_flush = false;
+            last_flush = now;
+        }
+        lk.lock();
+    }
+    if (need_flush)
+    {
+        backend->Flush();
+    }
+    busy = false;
+    idle_cv.notify_all();
+}
+
+
+void AsyncLogWriter::write_entry(QueueEntry& entry)
+{
+    backend->EnableTimestamp(entry.timestamp);
+    backend->EnableLogMeta(entry.log_meta);
+    backend->EnableMessagePrepend(entry.prepend_prefix);
+    backend->AddMetaCopy(entry.metadata);
+    backend->PrependMeta(entry.prepend_label, entry.prepend_meta);
+    if (WriteType::LOGEVENT != entry.type)
+    {
+        backend->SetEventTime(entry.created);
+    }
+
+    switch (entry.type)
+    {
+    case WriteType::DATA:
+        backend->Write(entry.data, entry.colour_init, entry.colour_reset);
+        break;
+
+    case WriteType::GROUP_CATEGORY_COLOUR:
+        backend->Write(entry.group, entry.category, entry.data,
+                       entry.colour_init, entry.colour_reset);
+        break;
+
+    case WriteType::GROUP_CATEGORY:
+        backend->Write(entry.group, entry.category, entry.data);
+        break;
+
+    case WriteType::LOGEVENT:
+        backend->Write(entry.event);
+        break;
+    }
+    queue_latency.Add(std::chrono::steady_clock::now() - entry.queued);
+}
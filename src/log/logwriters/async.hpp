@@ -0,0 +1,221 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   async.hpp
+ *
+ * @brief  Declaration of AsyncLogWriter, a LogWriter passing all log
+ *         events to another LogWriter via a queue and a writer thread
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "log/logstats.hpp"
+#include "log/logwriter.hpp"
+
+
+/**
+ *  LogWriter implementation queuing all log events in a bounded ring
+ *  buffer.  A dedicated writer thread drains the queue in batches to
+ *  the real LogWriter, so the caller never waits for the log
+ *  destination.
+ *
+ *  The meta data and the writer settings active when a log event is
+ *  written are queued with it.  Timestamps are added by the real
+ *  LogWriter when the event is processed by the writer thread, but
+ *  carry the time the log event was created or queued.
+ */
+class AsyncLogWriter : public LogWriter
+{
+public:
+    /**
+     *  What to do when a new log event arrives and the queue is full
+     */
+    enum class OverflowPolicy
+    {
+        DROP,    /**< Discard the new log event */
+        BLOCK    /**< Wait until the writer thread has made room */
+    };
+
+
+    /**
+     *  Initialize the AsyncLogWriter and start the writer thread
+     *
+     * @param backend         The LogWriter doing the real log writing.
+     *                        This object takes the ownership of it.
+     * @param queue_size      Maximum number of queued log events
+     * @param flush_interval  How often the backend is flushed while log
+     *                        events are processed.  0 flushes after each
+     *                        batch.  The backend is always flushed once
+     *                        the queue is empty.
+     * @param overflow        OverflowPolicy to use when the queue is full
+     */
+    AsyncLogWriter(LogWriter::Ptr backend,
+                   const size_t queue_size,
+                   const std::chrono::milliseconds flush_interval,
+                   const OverflowPolicy overflow);
+    virtual ~AsyncLogWriter();
+
+    const std::string GetLogWriterInfo() const override;
+    bool TimestampEnabled() override;
+
+    void Write(const std::string& data,
+               const std::string& colour_init = "",
+               const std::string& colour_reset = "") override;
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data,
+               const std::string& colour_init,
+               const std::string& colour_reset) override;
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data) override;
+    void Write(const LogEvent& logev) override;
+
+
+    /**
+     *  Blocks until all queued log events have been written and the
+     *  backend has been flushed.
+     */
+    void Flush() override;
+
+
+    /**
+     *  Passes the request on to the backend.  The backend must handle
+     *  Reopen() calls from other threads than the writer thread.
+     */
+    void Reopen() override;
+
+
+    /**
+     *  Retrieve the number of log events discarded due to a full queue
+     *  since this object was created.
+     *
+     * @return Returns the number of dropped log events
+     */
+    size_t GetDroppedCount() override;
+
+    size_t GetQueueDepth() override;
+
+    /**
+     *  Retrieve the histogram of the time from a log event was queued
+     *  until the backend has written it.
+     *
+     * @return Returns a std::vector with the number of log events in each
+     *         LogLatencyHistogram bucket
+     */
+    std::vector<uint64_t> GetQueueLatency() override;
+
+
+    /**
+     *  Creates a LogWriter queuing its log events in this AsyncLogWriter.
+     *  The meta data added to it is kept apart from the meta data of this
+     *  object and of other producers, so each thread writing log events
+     *  with meta data can use its own producer.  The timestamp, meta data
+     *  and message prefix settings of this object are used.
+     *
+     *  The producers must be deleted before this object.
+     *
+     * @return Returns a LogWriter::Ptr to the new producer
+     */
+    LogWriter::Ptr NewProducer();
+
+
+    /**
+     *  Converts a string to an OverflowPolicy value.
+     *
+     * @param policy  std::string containing "drop" or "block"
+     * @return Returns the OverflowPolicy.  Throws LogException on
+     *         unknown values.
+     */
+    static OverflowPolicy ParseOverflowPolicy(const std::string& policy);
+
+
+private:
+    /**
+     *  Which of the Write() methods of the backend to call
+     */
+    enum class WriteType
+    {
+        DATA,
+        GROUP_CATEGORY_COLOUR,
+        GROUP_CATEGORY,
+        LOGEVENT
+    };
+
+    struct QueueEntry
+    {
+        WriteType type = WriteType::DATA;
+        LogGroup group = LogGroup::UNDEFINED;
+        LogCategory category = LogCategory::UNDEFINED;
+        std::string data = {};
+        LogEvent event = {};
+        std::string colour_init = {};
+        std::string colour_reset = {};
+        LogMetaData metadata = {};
+        std::string prepend_label = {};
+        bool prepend_meta = false;
+        bool timestamp = false;
+        bool log_meta = false;
+        bool prepend_prefix = false;
+        std::chrono::steady_clock::time_point queued = {};
+        std::chrono::system_clock::time_point created = {};
+    };
+
+    class Producer;
+
+    LogWriter::Ptr backend;
+    bool backend_timestamp_forced = false;
+    const std::chrono::milliseconds flush_interval;
+    const OverflowPolicy overflow;
+
+    std::mutex queue_mtx;
+    std::condition_variable queue_cv;   ///< Signals new queue entries
+    std::condition_variable space_cv;   ///< Signals room in the queue
+    std::condition_variable idle_cv;    ///< Signals all entries written
+    std::vector<QueueEntry> ring;
+    size_t ring_head = 0;
+    size_t ring_count = 0;
+    size_t dropped = 0;
+    size_t dropped_reported = 0;
+    bool busy = false;
+    bool running = true;
+    LogLatencyHistogram queue_latency;
+    std::thread writer_thread;
+
+
+    static QueueEntry data_entry(const std::string& data,
+                                 const std::string& colour_init,
+                                 const std::string& colour_reset);
+    static QueueEntry group_entry(const LogGroup grp, const LogCategory ctg,
+                                  const std::string& data,
+                                  const std::string& colour_init,
+                                  const std::string& colour_reset);
+    static QueueEntry group_entry(const LogGroup grp, const LogCategory ctg,
+                                  const std::string& data);
+    static QueueEntry event_entry(const LogEvent& logev);
+
+    void enqueue(QueueEntry&& entry);
+    void enqueue_locked(std::unique_lock<std::mutex>& lk, QueueEntry&& entry);
+    void writer_loop();
+    void write_entry(QueueEntry& entry);
+};
@@ -0,0 +1,465 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   file.cpp
+ *
+ * @brief  Implementation of FileLogBuffer and FileLogWriter
+ */
+
+#include "config.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "log/logwriter.hpp"
+#include "log/log-helpers.hpp"
+#include "log/logwriters/file.hpp"
+
+
+//
+//  FileLogBuffer - implementation
+//
+
+FileLogBuffer::FileLogBuffer(const std::string& fname, const size_t buffer_size)
+    : std::streambuf(), filename(fname), buffer(buffer_size > 0 ? buffer_size : 1)
+{
+    setp(buffer.data(), buffer.data() + buffer.size());
+    Reopen();
+}
+
+
+FileLogBuffer::~FileLogBuffer()
+{
+    write_out();
+    if (-1 != fd)
+    {
+        close(fd);
+    }
+}
+
+
+void FileLogBuffer::Reopen()
+{
+    write_out();
+
+    int newfd = open(filename.c_str(),
+                     O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0640);
+    if (-1 == newfd)
+    {
+        THROW_LOGEXCEPTION("Could not open log file " + filename
+                           + ": " + strerror(errno));
+    }
+    struct stat st = {};
+    if (0 != fstat(newfd, &st))
+    {
+        std::string err(strerror(errno));
+        close(newfd);
+        THROW_LOGEXCEPTION("Could not open log file " + filename
+                           + ": " + err);
+    }
+
+    if (-1 != fd)
+    {
+        close(fd);
+    }
+    fd = newfd;
+    file_size = st.st_size;
+    opened = std::chrono::system_clock::now();
+    write_error = false;
+}
+
+
+uint64_t FileLogBuffer::GetFileSize() const noexcept
+{
+    return file_size + GetPending();
+}
+
+
+std::chrono::system_clock::time_point FileLogBuffer::GetOpenTime() const noexcept
+{
+    return opened;
+}
+
+
+size_t FileLogBuffer::GetPending() const noexcept
+{
+    return pptr() - pbase();
+}
+
+
+FileLogBuffer::int_type FileLogBuffer::overflow(int_type ch)
+{
+    write_out();
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        return traits_type::not_eof(ch);
+    }
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+    return ch;
+}
+
+
+int FileLogBuffer::sync()
+{
+    return write_out() ? 0 : -1;
+}
+
+
+/**
+ *  Writes the buffered data to the log file.  On errors the buffered
+ *  data is discarded, so a full disk does not stop the logging; the
+ *  first error is reported on stderr.
+ *
+ * @return Returns false if the data could not be written
+ */
+bool FileLogBuffer::write_out()
+{
+    const char *p = pbase();
+    size_t left = pptr() - pbase();
+    bool ret = true;
+    while (left > 0)
+    {
+        ssize_t r = ::write(fd, p, left);
+        if (r < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if (!write_error)
+            {
+                std::cerr << "FileLogWriter: Could not write to " << filename
+                          << ": " << strerror(errno) << std::endl;
+                write_error = true;
+            }
+            ret = false;
+            break;
+        }
+        p += r;
+        left -= r;
+        file_size += r;
+    }
+    setp(buffer.data(), buffer.data() + buffer.size());
+    return ret;
+}
+
+
+
+//
+//  FileLogWriter - implementation
+//
+
+#ifdef HAVE_LZ4
+/**
+ *  Compresses a file into a LZ4 frame file.  Throws LogException
+ *  on errors.
+ *
+ * @param src  std::string with the file to compress
+ * @param dst  std::string with the compressed file to create
+ */
+static void compress_file(const std::string& src, const std::string& dst)
+{
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (-1 == in)
+    {
+        THROW_LOGEXCEPTION("Could not open " + src + ": " + strerror(errno));
+    }
+    int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (-1 == out)
+    {
+        std::string err(strerror(errno));
+        close(in);
+        THROW_LOGEXCEPTION("Could not create " + dst + ": " + err);
+    }
+
+    LZ4F_compressionContext_t ctx = nullptr;
+    LZ4F_createCompressionContext(&ctx, LZ4F_VERSION);
+
+    const size_t chunk = 65536;
+    std::vector<char> inbuf(chunk);
+    std::vector<char> outbuf(LZ4F_compressBound(chunk, nullptr));
+    std::string err;
+
+    auto write_all = [out, &err](const char *p, size_t len)
+                     {
+                         while (len > 0)
+                         {
+                             ssize_t r = ::write(out, p, len);
+                             if (r < 0 && EINTR == errno)
+                             {
+                                 continue;
+                             }
+                             if (r < 0)
+                             {
+                                 err = strerror(errno);
+                                 return false;
+                             }
+                             p += r;
+                             len -= r;
+                         }
+                         return true;
+                     };
+
+    size_t n = LZ4F_compressBegin(ctx, outbuf.data(), outbuf.size(), nullptr);
+    bool ok = !LZ4F_isError(n) && write_all(outbuf.data(), n);
+    while (ok)
+    {
+        ssize_t r = ::read(in, inbuf.data(), inbuf.size());
+        if (r < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (r < 0)
+        {
+            err = strerror(errno);
+            ok = false;
+            break;
+        }
+        if (0 == r)
+        {
+            break;
+        }
+        n = LZ4F_compressUpdate(ctx, outbuf.data(), outbuf.size(),
+                                inbuf.data(), r, nullptr);
+        ok = !LZ4F_isError(n) && write_all(outbuf.data(), n);
+    }
+    if (ok)
+    {
+        n = LZ4F_compressEnd(ctx, outbuf.data(), outbuf.size(), nullptr);
+        ok = !LZ4F_isError(n) && write_all(outbuf.data(), n);
+    }
+    if (!ok && err.empty())
+    {
+        err = LZ4F_getErrorName(n);
+    }
+    LZ4F_freeCompressionContext(ctx);
+    close(in);
+
+    if (0 != close(out) && ok)
+    {
+        err = strerror(errno);
+        ok = false;
+    }
+    if (!ok)
+    {
+        unlink(dst.c_str());
+        THROW_LOGEXCEPTION("Could not compress " + src + ": " + err);
+    }
+}
+#endif
+
+
+FileLogWriter::FileLogWriter(const std::string& fname,
+                             const Rotation& rot,
+                             const size_t buffer_size,
+                             const std::chrono::milliseconds flush_intv,
+                             ColourEngine *ce)
+    : FileLogStream(fname, buffer_size),
+      ColourStreamWriter(filestream, ce),
+      filename(fname), rotation(rot), flush_interval(flush_intv)
+{
+#ifndef HAVE_LZ4
+    if (rotation.compress)
+    {
+        THROW_LOGEXCEPTION("Compressing rotated log files is not supported");
+    }
+#endif
+}
+
+
+FileLogWriter::~FileLogWriter()
+{
+    filestream.flush();
+}
+
+
+const std::string FileLogWriter::GetLogWriterInfo() const
+{
+    return std::string("file:") + filename;
+}
+
+
+void FileLogWriter::write_line(const std::string& colour_init,
+                               const std::string& prefix,
+                               const std::string& data_colour,
+                               const std::string& data,
+                               const std::string& colour_reset)
+{
+    check_reopen();
+
+    // Rotate before writing, so a log line is never split across files
+    // and a rotation happens even if the size limit was reached by the
+    // previous line.
+    check_rotate();
+
+    const bool was_empty = (0 == filebuf.GetPending());
+    StreamLogWriter::write_line(colour_init, prefix, data_colour,
+                                data, colour_reset);
+
+    if (0 == filebuf.GetPending())
+    {
+        // Written out by auto-flush or by a full buffer
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (was_empty)
+    {
+        buffered_since = now;
+    }
+    else if (now - buffered_since >= flush_interval)
+    {
+        filestream.flush();
+    }
+}
+
+
+void FileLogWriter::Flush()
+{
+    check_reopen();
+    filestream.flush();
+}
+
+
+void FileLogWriter::Reopen()
+{
+    reopen_requested = true;
+}
+
+
+void FileLogWriter::Rotate()
+{
+    filestream.flush();
+
+    if (0 == rotation.keep)
+    {
+        unlink(filename.c_str());
+        filebuf.Reopen();
+        return;
+    }
+
+    // Make room for FILE.1 by shifting all rotated files one index
+    // up.  Both the compressed and uncompressed names are handled, in
+    // case the compression setting has been changed.
+    for (bool compressed : {false, true})
+    {
+        unlink(RotatedFilename(filename, rotation.keep, compressed).c_str());
+        for (unsigned int i = rotation.keep; i > 1; --i)
+        {
+            rename(RotatedFilename(filename, i - 1, compressed).c_str(),
+                   RotatedFilename(filename, i, compressed).c_str());
+        }
+    }
+
+    std::string rotated = RotatedFilename(filename, 1, false);
+    if (0 != rename(filename.c_str(), rotated.c_str()))
+    {
+        THROW_LOGEXCEPTION("Could not rotate log file " + filename
+                           + ": " + strerror(errno));
+    }
+    filebuf.Reopen();
+
+#ifdef HAVE_LZ4
+    if (rotation.compress)
+    {
+        // The rotation itself succeeded, so a failed compression only
+        // leaves the rotated file uncompressed
+        try
+        {
+            compress_file(rotated, RotatedFilename(filename, 1, true));
+            unlink(rotated.c_str());
+        }
+        catch (const LogException& excp)
+        {
+            std::cerr << "FileLogWriter: " << excp.what() << std::endl;
+        }
+    }
+#endif
+}
+
+
+std::string FileLogWriter::RotatedFilename(const std::string& fname,
+                                           const unsigned int index,
+                                           const bool compress)
+{
+    return fname + "." + std::to_string(index) + (compress ? ".lz4" : "");
+}
+
+
+void FileLogWriter::check_reopen()
+{
+    if (!reopen_requested.exchange(false))
+    {
+        return;
+    }
+    try
+    {
+        filebuf.Reopen();
+        rotate_error = false;
+    }
+    catch (const LogException& excp)
+    {
+        std::cerr << "FileLogWriter: " << excp.what() << std::endl;
+    }
+}
+
+
+void FileLogWriter::check_rotate()
+{
+    // Empty log files are not rotated, and after a failed rotation
+    // no new attempts are made until the log file is reopened
+    const uint64_t size = filebuf.GetFileSize();
+    if (0 == size || rotate_error)
+    {
+        return;
+    }
+
+    bool rotate = (rotation.max_size > 0 && size >= rotation.max_size);
+    if (!rotate && rotation.max_age.count() > 0)
+    {
+        rotate = (std::chrono::system_clock::now() - filebuf.GetOpenTime()
+                  >= rotation.max_age);
+    }
+    if (!rotate)
+    {
+        return;
+    }
+    try
+    {
+        Rotate();
+    }
+    catch (const LogException& excp)
+    {
+        std::cerr << "FileLogWriter: " << excp.what() << std::endl;
+        rotate_error = true;
+    }
+}
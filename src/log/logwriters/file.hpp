@@ -0,0 +1,232 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   file.hpp
+ *
+ * @brief  LogWriter writing to a plain text log file, with buffering
+ *         and log file rotation
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "log/logwriter.hpp"
+#include "log/colourengine.hpp"
+#include "log/logwriters/streamwriter.hpp"
+
+
+/**
+ *  std::streambuf collecting the log data in a fixed size buffer, which
+ *  is written to a file descriptor opened with O_APPEND when it is full
+ *  or when the stream is flushed.
+ */
+class FileLogBuffer : public std::streambuf
+{
+public:
+    /**
+     *  Opens the log file.  Throws LogException on errors.
+     *
+     * @param filename     std::string with the log file name
+     * @param buffer_size  Size of the buffer, in bytes
+     */
+    FileLogBuffer(const std::string& filename, const size_t buffer_size);
+    virtual ~FileLogBuffer();
+
+    FileLogBuffer(const FileLogBuffer&) = delete;
+    FileLogBuffer& operator=(const FileLogBuffer&) = delete;
+
+
+    /**
+     *  Writes the buffered data to the log file and opens the log file
+     *  again.  Used when the log file has been moved away.  Throws
+     *  LogException if the file could not be opened; the previous
+     *  file stays in use then.
+     */
+    void Reopen();
+
+
+    /**
+     * @return Returns the size of the log file, including buffered data
+     */
+    uint64_t GetFileSize() const noexcept;
+
+
+    /**
+     * @return Returns when the current log file was opened
+     */
+    std::chrono::system_clock::time_point GetOpenTime() const noexcept;
+
+
+    /**
+     * @return Returns the number of bytes waiting in the buffer
+     */
+    size_t GetPending() const noexcept;
+
+
+protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+
+private:
+    const std::string filename;
+    std::vector<char> buffer;
+    int fd = -1;
+    uint64_t file_size = 0;
+    std::chrono::system_clock::time_point opened = {};
+    bool write_error = false;
+
+    bool write_out();
+};
+
+
+/**
+ *  Provides the stream for FileLogWriter.  It is a base class of
+ *  FileLogWriter, so the stream is created before and destroyed after
+ *  the StreamLogWriter using it.
+ */
+struct FileLogStream
+{
+    FileLogStream(const std::string& filename, const size_t buffer_size)
+        : filebuf(filename, buffer_size), filestream(&filebuf)
+    {
+    }
+
+    FileLogBuffer filebuf;
+    std::ostream filestream;
+};
+
+
+/**
+ *  LogWriter implementation writing to a log file.
+ *
+ *  The log lines are formatted like the StreamLogWriter does it, but are
+ *  collected in a buffer.  The buffer is written to the log file when
+ *  it is full, when the oldest buffered data is older than the flush
+ *  interval or when Flush() is called.  With auto-flush enabled, the
+ *  buffer is written after each log line.
+ *
+ *  The log file can be rotated by size and by age.  The current log file
+ *  is then renamed to FILE.1, the previous FILE.1 to FILE.2 and so on,
+ *  removing the oldest.  Rotated files can be compressed, which adds
+ *  a .lz4 suffix to them.
+ *
+ *  Reopen() makes the log writer open the log file again before the
+ *  next write, to be used after an external tool has rotated the log
+ *  file.
+ */
+class FileLogWriter : private FileLogStream, public ColourStreamWriter
+{
+public:
+    /**
+     *  Log file rotation settings
+     */
+    struct Rotation
+    {
+        uint64_t max_size = 0;                 ///< Rotate at this file size, 0 disables
+        std::chrono::seconds max_age{0};       ///< Rotate files this old, 0 disables
+        unsigned int keep = 5;                 ///< Rotated files to keep
+        bool compress = false;                 ///< Compress rotated files
+    };
+
+
+    /**
+     *  Initialize the FileLogWriter.  The log file is created if needed,
+     *  log data is appended to an existing file.  Throws LogException
+     *  on errors.
+     *
+     * @param filename        std::string with the log file name
+     * @param rotation        Rotation settings
+     * @param buffer_size     Size of the log buffer, in bytes
+     * @param flush_interval  Longest time log data stays in the buffer
+     * @param ce              ColourEngine to colour the log lines with,
+     *                        nullptr writes plain text
+     */
+    FileLogWriter(const std::string& filename,
+                  const Rotation& rotation,
+                  const size_t buffer_size = 65536,
+                  const std::chrono::milliseconds flush_interval = std::chrono::milliseconds(1000),
+                  ColourEngine *ce = nullptr);
+    virtual ~FileLogWriter();
+
+    const std::string GetLogWriterInfo() const override;
+
+    using ColourStreamWriter::Write;
+
+    void Flush() override;
+
+
+    /**
+     *  Makes the log file to be opened again before the next log line is
+     *  written.  This may be called from any thread.
+     */
+    void Reopen() override;
+
+
+    /**
+     *  Rotates the log file right away
+     */
+    void Rotate();
+
+
+    /**
+     *  Finds the file name a rotated log file gets
+     *
+     * @param filename  std::string with the log file name
+     * @param index     Rotation index, 1 being the newest rotated file
+     * @param compress  Whether the rotated file is compressed
+     *
+     * @return Returns the file name of the rotated log file
+     */
+    static std::string RotatedFilename(const std::string& filename,
+                                       const unsigned int index,
+                                       const bool compress);
+
+
+protected:
+    /**
+     *  Checks if the log file needs to be reopened or rotated before the
+     *  log line is written, and writes out the buffer if it has held
+     *  data for longer than the flush interval
+     */
+    void write_line(const std::string& colour_init,
+                    const std::string& prefix,
+                    const std::string& data_colour,
+                    const std::string& data,
+                    const std::string& colour_reset) override;
+
+
+private:
+    const std::string filename;
+    const Rotation rotation;
+    const std::chrono::milliseconds flush_interval;
+    std::chrono::steady_clock::time_point buffered_since = {};
+    std::atomic<bool> reopen_requested{false};
+    bool rotate_error = false;
+
+    void check_reopen();
+    void check_rotate();
+};
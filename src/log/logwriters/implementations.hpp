@@ -26,6 +26,10 @@
 
 #pragma once
 
+#include "archive.hpp"
+#include "async.hpp"
+#include "file.hpp"
+#include "multi.hpp"
 #include "journald.hpp"
 #include "streamwriter.hpp"
 #include "syslog.hpp"
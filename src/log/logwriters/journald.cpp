@@ -29,7 +29,9 @@
 
 #include <sys/uio.h>
 #include <ctype.h>
+#include <cstring>
 #include <string>
+#include <vector>
 
 #define SD_JOURNAL_SUPPRESS_LOCATION
 #include <systemd/sd-journal.h>
@@ -71,57 +73,158 @@ void JournaldWriter::Write(const LogGroup grp, const LogCategory ctg,
     JournaldWriter::Write(LogEvent(grp, ctg, data));
 }
 
+/**
+ *  Per-thread buffers used when preparing the journald fields.  The
+ *  strings and vectors are reused between log events, so once they have
+ *  grown to fit the typical log event no further memory allocations
+ *  are needed.
+ */
+struct JournaldArena
+{
+    std::vector<std::string> fields;
+    std::vector<struct iovec> iov;
+
+    /**
+     *  Retrieve an empty field buffer for the next journald field
+     *
+     * @param idx  Index of the field, incremented by this call
+     * @return Returns a reference to the cleared field buffer
+     */
+    std::string& next_field(size_t& idx)
+    {
+        if (fields.size() <= idx)
+        {
+            fields.resize(idx + 1);
+        }
+        std::string& f = fields[idx++];
+        f.clear();
+        return f;
+    }
+};
+
+static thread_local JournaldArena arena;
+
+
+/**
+ *  The O3_LOG_GROUP and O3_LOG_CATEGORY fields only have a few possible
+ *  values; these are rendered only once.
+ */
+static const std::vector<std::string> journald_group_fields = []()
+    {
+        std::vector<std::string> r;
+        for (const auto& g : LogGroup_str)
+        {
+            r.push_back("O3_LOG_GROUP=" + g);
+        }
+        return r;
+    }();
+
+static const std::vector<std::string> journald_category_fields = []()
+    {
+        std::vector<std::string> r;
+        for (const auto& c : LogCategory_str)
+        {
+            r.push_back("O3_LOG_CATEGORY=" + c);
+        }
+        return r;
+    }();
+
+
 void JournaldWriter::Write(const LogEvent& event)
 {
-    // We need extra elements for O3_SESSION_TOKEN,
-    // O3_LOG_GROUP, O3_LOG_CATEGORY, MESSAGE and
-    // the NULL termination
-    struct iovec *l = (struct iovec *) calloc(sizeof(struct iovec)+2,
-                                              metadata.size()+6);
-    size_t i = 0;
-    for (const auto& mdr : metadata.GetMetaDataRecords(true, false))
+    // First prepare all the fields which needs to be rendered.  The
+    // iovec array can only point at these strings once all fields are
+    // in place, as the fields vector might be resized in the mean time.
+    size_t nflds = 0;
+    for (const auto& mdv : metadata)
     {
-        std::string md = std::string("O3_") + mdr;
-        l[i++] = {(char *) strdup(md.c_str()), md.length()};
+        std::string& f = arena.next_field(nflds);
+        f += "O3_";
+        f += mdv->GetRecord(true, false);
     }
 
-    std::string st("O3_SESSION_TOKEN=");
     if (!event.session_token.empty())
     {
-        st += event.session_token;
-        l[i++] = {(char *) strdup(st.c_str()), st.length()};
+        std::string& f = arena.next_field(nflds);
+        f += "O3_SESSION_TOKEN=";
+        f += event.session_token;
+    }
+
+    // Log fields are added as O3_FIELD_<NAME>=<value>; the field names
+    // are already restricted to what journald accepts
+    for (const auto& fld : event.fields)
+    {
+        std::string& f = arena.next_field(nflds);
+        f += "O3_FIELD_";
+        for (const char c : fld.name)
+        {
+            f += (char) toupper(c);
+        }
+        f += '=';
+        f += fld.GetValue();
     }
 
-    std::string lg("O3_LOG_GROUP=" + event.GetLogGroupStr());
-    l[i++] = {(char *) strdup(lg.c_str()), lg.length()};
+    const std::string *grp = nullptr;
+    if ((uint8_t) event.group < journald_group_fields.size())
+    {
+        grp = &journald_group_fields[(uint8_t) event.group];
+    }
+    else
+    {
+        std::string& f = arena.next_field(nflds);
+        f += "O3_LOG_GROUP=";
+        f += event.GetLogGroupStr();
+    }
 
-    std::string lc("O3_LOG_CATEGORY=" + event.GetLogCategoryStr());
-    l[i++] = {(char *) strdup(lc.c_str()), lc.length()};
+    const std::string *ctg = nullptr;
+    if ((uint8_t) event.category < journald_category_fields.size())
+    {
+        ctg = &journald_category_fields[(uint8_t) event.category];
+    }
+    else
+    {
+        std::string& f = arena.next_field(nflds);
+        f += "O3_LOG_CATEGORY=";
+        f += event.GetLogCategoryStr();
+    }
 
-    std::string m("MESSAGE=");
+    std::string& m = arena.next_field(nflds);
+    m += "MESSAGE=";
     if (prepend_prefix && prepend_meta)
     {
-        m += metadata.GetMetaValue(prepend_label, true);
+        for (const auto& mdv : metadata)
+        {
+            if (prepend_label == mdv->label)
+            {
+                m += mdv->GetValue(true);
+                m += " ";
+                break;
+            }
+        }
     }
-
     m += event.message;
-    l[i++] = {(char *) strdup(m.c_str()), m.length()};
-    l[i] = {NULL};
 
-    int r = sd_journal_sendv(l, i);
-    if (0 != r)
+    // Point the iovec array directly at the field data
+    arena.iov.clear();
+    for (size_t i = 0; i < nflds; i++)
+    {
+        arena.iov.push_back({(void *) arena.fields[i].data(),
+                             arena.fields[i].length()});
+    }
+    if (grp)
+    {
+        arena.iov.push_back({(void *) grp->data(), grp->length()});
+    }
+    if (ctg)
     {
-        std::cout << "ERROR: " << strerror(errno) << std::endl;
+        arena.iov.push_back({(void *) ctg->data(), ctg->length()});
     }
 
-    // struct iovec is a C interface; need to clean up manually
-    for (size_t j = 0; j < i; j++)
+    int r = sd_journal_sendv(arena.iov.data(), arena.iov.size());
+    if (0 != r)
     {
-        free(l[j].iov_base);
-        l[j].iov_base = 0;
-        l[j].iov_len = 0;
+        std::cout << "ERROR: " << strerror(-r) << std::endl;
     }
-    free(l);
 
     prepend_label.clear();
     metadata.clear();
@@ -0,0 +1,342 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   multi.cpp
+ *
+ * @brief  Implementation of MultiLogWriter and its log writer list parser
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "log/logwriter.hpp"
+#include "log/log-helpers.hpp"
+#include "log/logwriters/multi.hpp"
+
+
+//
+//  LogWriterFilter - implementation
+//
+
+bool LogWriterFilter::Allow(const LogGroup grp, const LogCategory ctg) const noexcept
+{
+    // Log events without a group are written by the log service itself
+    if (!groups.empty() && LogGroup::UNDEFINED != grp
+        && std::find(groups.begin(), groups.end(), grp) == groups.end())
+    {
+        return false;
+    }
+
+    switch (ctg)
+    {
+    case LogCategory::DEBUG:
+        return log_level >= 6;
+    case LogCategory::VERB2:
+        return log_level >= 5;
+    case LogCategory::VERB1:
+        return log_level >= 4;
+    case LogCategory::INFO:
+        return log_level >= 3;
+    case LogCategory::WARN:
+        return log_level >= 2;
+    case LogCategory::ERROR:
+        return log_level >= 1;
+    default:
+        return true;
+    }
+}
+
+
+
+//
+//  LogWriterSpec - implementation
+//
+
+static const std::vector<std::string> group_names = {
+    "undefined",
+    "masterproc",
+    "configmgr",
+    "sessionmgr",
+    "backendstart",
+    "logger",
+    "backendproc",
+    "client",
+    "netcfg",
+    "extservice"
+};
+
+
+std::string LogWriterSpec::GroupName(const LogGroup grp)
+{
+    return group_names.at((size_t) grp);
+}
+
+
+/**
+ *  Splits a string on a separator, removing white space around each
+ *  element and skipping empty elements
+ */
+static std::vector<std::string> split(const std::string& str, const char sep)
+{
+    std::vector<std::string> ret;
+    size_t start = 0;
+    while (start <= str.size())
+    {
+        size_t end = str.find(sep, start);
+        if (std::string::npos == end)
+        {
+            end = str.size();
+        }
+        std::string elm = str.substr(start, end - start);
+        size_t first = elm.find_first_not_of(" \t");
+        if (std::string::npos != first)
+        {
+            size_t last = elm.find_last_not_of(" \t");
+            ret.push_back(elm.substr(first, last - first + 1));
+        }
+        start = end + 1;
+    }
+    return ret;
+}
+
+
+std::vector<LogWriterSpec> LogWriterSpec::ParseList(const std::string& list)
+{
+    std::vector<LogWriterSpec> ret;
+    for (const auto& entry : split(list, ';'))
+    {
+        std::vector<std::string> fields = split(entry, ',');
+        if (fields.empty())
+        {
+            THROW_LOGEXCEPTION("Invalid log writer list entry '" + entry + "'");
+        }
+        LogWriterSpec spec;
+
+        const std::string& dest = fields[0];
+        size_t colon = dest.find(':');
+        spec.method = dest.substr(0, colon);
+        if (std::string::npos != colon)
+        {
+            spec.target = dest.substr(colon + 1);
+        }
+
+        if ("file" == spec.method || "archive" == spec.method)
+        {
+            if (spec.target.empty())
+            {
+                THROW_LOGEXCEPTION("Log writer '" + spec.method
+                                   + "' requires a file or directory");
+            }
+        }
+        else if ("journald" == spec.method || "syslog" == spec.method
+                 || "stdout" == spec.method)
+        {
+            if (!spec.target.empty())
+            {
+                THROW_LOGEXCEPTION("Log writer '" + spec.method
+                                   + "' does not take an argument");
+            }
+        }
+        else
+        {
+            THROW_LOGEXCEPTION("Unknown log writer '" + spec.method + "'");
+        }
+
+        for (size_t i = 1; i < fields.size(); ++i)
+        {
+            size_t eq = fields[i].find('=');
+            std::string key = fields[i].substr(0, eq);
+            std::string value = (std::string::npos == eq
+                                 ? "" : fields[i].substr(eq + 1));
+            if ("level" == key)
+            {
+                char *end = nullptr;
+                long lvl = std::strtol(value.c_str(), &end, 10);
+                if (value.empty() || '\0' != *end || lvl < 0 || lvl > 6)
+                {
+                    THROW_LOGEXCEPTION("Invalid log level '" + value
+                                       + "' for log writer '"
+                                       + spec.method + "'");
+                }
+                spec.filter.log_level = (unsigned int) lvl;
+            }
+            else if ("groups" == key)
+            {
+                for (const auto& g : split(value, '+'))
+                {
+                    auto it = std::find(group_names.begin() + 1,
+                                        group_names.end(), g);
+                    if (group_names.end() == it)
+                    {
+                        THROW_LOGEXCEPTION("Unknown log group '" + g
+                                           + "' for log writer '"
+                                           + spec.method + "'");
+                    }
+                    spec.filter.groups.push_back((LogGroup) (it - group_names.begin()));
+                }
+            }
+            else
+            {
+                THROW_LOGEXCEPTION("Unknown log writer option '" + key + "'");
+            }
+        }
+        ret.push_back(spec);
+    }
+
+    if (ret.empty())
+    {
+        THROW_LOGEXCEPTION("Empty log writer list");
+    }
+    return ret;
+}
+
+
+
+//
+//  MultiLogWriter - implementation
+//
+
+void MultiLogWriter::AddWriter(LogWriter::Ptr writer,
+                               const LogWriterFilter& filter)
+{
+    destinations.push_back({std::move(writer), filter});
+}
+
+
+size_t MultiLogWriter::size() const noexcept
+{
+    return destinations.size();
+}
+
+
+const std::string MultiLogWriter::GetLogWriterInfo() const
+{
+    std::string ret;
+    for (const auto& d : destinations)
+    {
+        ret += (ret.empty() ? "" : ", ") + d.writer->GetLogWriterInfo();
+    }
+    return "multi: " + ret;
+}
+
+
+void MultiLogWriter::Write(const std::string& data,
+                           const std::string& colour_init,
+                           const std::string& colour_reset)
+{
+    write_all(LogGroup::UNDEFINED, LogCategory::INFO,
+              [&](LogWriter *w)
+              {
+                  w->Write(data, colour_init, colour_reset);
+              });
+}
+
+
+void MultiLogWriter::Write(const LogGroup grp, const LogCategory ctg,
+                           const std::string& data,
+                           const std::string& colour_init,
+                           const std::string& colour_reset)
+{
+    write_all(grp, ctg,
+              [&](LogWriter *w)
+              {
+                  w->Write(grp, ctg, data, colour_init, colour_reset);
+              });
+}
+
+
+void MultiLogWriter::Write(const LogGroup grp, const LogCategory ctg,
+                           const std::string& data)
+{
+    write_all(grp, ctg,
+              [&](LogWriter *w)
+              {
+                  w->Write(grp, ctg, data);
+              });
+}
+
+
+void MultiLogWriter::Write(const LogEvent& logev)
+{
+    write_all(logev.group, logev.category,
+              [&](LogWriter *w)
+              {
+                  w->Write(logev);
+              });
+}
+
+
+void MultiLogWriter::Flush()
+{
+    for (auto& d : destinations)
+    {
+        d.writer->Flush();
+    }
+}
+
+
+void MultiLogWriter::Reopen()
+{
+    for (auto& d : destinations)
+    {
+        d.writer->Reopen();
+    }
+}
+
+
+template <typename F>
+void MultiLogWriter::write_all(const LogGroup grp, const LogCategory ctg,
+                               F&& write)
+{
+    const bool apply = (timestamp != applied_timestamp
+                        || log_meta != applied_log_meta
+                        || prepend_prefix != applied_prepend_prefix);
+
+    for (auto& d : destinations)
+    {
+        if (apply)
+        {
+            d.writer->EnableTimestamp(timestamp);
+            d.writer->EnableLogMeta(log_meta);
+            d.writer->EnableMessagePrepend(prepend_prefix);
+        }
+        if (!d.filter.Allow(grp, ctg))
+        {
+            continue;
+        }
+        d.writer->AddMetaCopy(metadata);
+        d.writer->PrependMeta(prepend_label, prepend_meta);
+        if (std::chrono::system_clock::time_point() != event_time)
+        {
+            d.writer->SetEventTime(event_time);
+        }
+        write(d.writer.get());
+    }
+
+    applied_timestamp = timestamp;
+    applied_log_meta = log_meta;
+    applied_prepend_prefix = prepend_prefix;
+    metadata.clear();
+    prepend_label.clear();
+    prepend_meta = false;
+    event_time = {};
+}
@@ -0,0 +1,161 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   multi.hpp
+ *
+ * @brief  LogWriter passing log events on to several other LogWriters,
+ *         each with its own filter
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "log/logwriter.hpp"
+
+
+/**
+ *  Decides which log events a LogWriter in a MultiLogWriter receives
+ */
+struct LogWriterFilter
+{
+    /// Log level, using the same scale as the log service log level
+    unsigned int log_level = 6;
+
+    /// Log groups to write, an empty list allows all
+    std::vector<LogGroup> groups = {};
+
+    /**
+     *  Checks if a log event passes this filter
+     *
+     * @param grp  LogGroup of the log event
+     * @param ctg  LogCategory of the log event
+     * @return Returns true if the log event should be written
+     */
+    bool Allow(const LogGroup grp, const LogCategory ctg) const noexcept;
+};
+
+
+/**
+ *  Parsed description of a single log destination in a log writer list
+ */
+struct LogWriterSpec
+{
+    std::string method;     ///< journald, syslog, file, archive or stdout
+    std::string target;     ///< File name or directory, if the method needs it
+    LogWriterFilter filter;
+
+
+    /**
+     *  Parses a list of log destinations.  The entries are separated by
+     *  semicolons and look like
+     *
+     *      METHOD[:TARGET][,level=LEVEL][,groups=GROUP[+GROUP...]]
+     *
+     *  where METHOD is one of journald, syslog, file:FILE, archive:DIR
+     *  or stdout, and GROUP one of the names returned by GroupName().
+     *  Throws LogException on errors.
+     *
+     * @param list  std::string with the log writer list
+     * @return Returns a std::vector with a LogWriterSpec per entry
+     */
+    static std::vector<LogWriterSpec> ParseList(const std::string& list);
+
+
+    /**
+     *  Retrieve the name of a LogGroup used in log writer lists
+     *
+     * @param grp  LogGroup to look up
+     * @return Returns a std::string with the lower case group name
+     */
+    static std::string GroupName(const LogGroup grp);
+};
+
+
+/**
+ *  LogWriter implementation writing each log event to several LogWriters.
+ *
+ *  Each log event is passed by reference to all the LogWriters its
+ *  filter allows, together with a copy of the meta data; the meta data
+ *  values themselves are shared, not copied.  Used behind an
+ *  AsyncLogWriter, a log event is queued only once for all of them.
+ *
+ *  The timestamp, meta data and message prefix settings are passed on
+ *  to all the LogWriters when they are changed on this object.  Until
+ *  then, each LogWriter keeps the settings it was added with.
+ */
+class MultiLogWriter : public LogWriter
+{
+public:
+    MultiLogWriter() = default;
+    virtual ~MultiLogWriter() = default;
+
+
+    /**
+     *  Adds a log destination
+     *
+     * @param writer  LogWriter::Ptr to the LogWriter.  This object takes
+     *                the ownership of it.
+     * @param filter  LogWriterFilter to use for this LogWriter
+     */
+    void AddWriter(LogWriter::Ptr writer, const LogWriterFilter& filter);
+
+
+    /**
+     * @return Returns the number of log destinations added
+     */
+    size_t size() const noexcept;
+
+
+    const std::string GetLogWriterInfo() const override;
+
+    void Write(const std::string& data,
+               const std::string& colour_init = "",
+               const std::string& colour_reset = "") override;
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data,
+               const std::string& colour_init,
+               const std::string& colour_reset) override;
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data) override;
+    void Write(const LogEvent& logev) override;
+
+    void Flush() override;
+    void Reopen() override;
+
+
+private:
+    struct Destination
+    {
+        LogWriter::Ptr writer;
+        LogWriterFilter filter;
+    };
+
+    std::vector<Destination> destinations;
+
+    /// The settings last passed on to the log destinations
+    bool applied_timestamp = true;
+    bool applied_log_meta = true;
+    bool applied_prepend_prefix = true;
+
+    template <typename F>
+    void write_all(const LogGroup grp, const LogCategory ctg, F&& write);
+};
@@ -24,12 +24,48 @@
  */
 
 #include <string>
+#include <vector>
 
-#include "common/timestamp.hpp"
 #include "../logwriter.hpp"
 #include "streamwriter.hpp"
 
 
+/**
+ *  Looks up the LogPrefix() string of a LogGroup and LogCategory.  The
+ *  prefixes of all valid combinations are only created once.
+ *
+ * @param grp  LogGroup of the log line
+ * @param ctg  LogCategory of the log line
+ * @param buf  std::string used for the prefix of an invalid combination
+ * @return Returns a reference to the prefix string
+ */
+static const std::string& log_prefix(const LogGroup grp,
+                                     const LogCategory ctg,
+                                     std::string& buf)
+{
+    static const size_t ctg_count = LogCategory_str.size();
+    static const std::vector<std::string> prefixes = []()
+        {
+            std::vector<std::string> ret;
+            for (uint8_t g = 0; g < LogGroupCount; ++g)
+            {
+                for (uint8_t c = 0; c < ctg_count; ++c)
+                {
+                    ret.push_back(LogPrefix((LogGroup) g, (LogCategory) c));
+                }
+            }
+            return ret;
+        }();
+
+    if ((uint8_t) grp >= LogGroupCount || (uint8_t) ctg >= ctg_count)
+    {
+        buf = LogPrefix(grp, ctg);
+        return buf;
+    }
+    return prefixes[(uint8_t) grp * ctg_count + (uint8_t) ctg];
+}
+
+
 //
 //  StreamLogWriter - implementation
 //
@@ -56,27 +92,63 @@ void StreamLogWriter::Write(const std::string& data,
                             const std::string& colour_init,
                             const std::string& colour_reset)
 {
+    static const std::string none;
+    write_line(colour_init, none, none, data, colour_reset);
+}
+
+
+void StreamLogWriter::Write(const LogGroup grp, const LogCategory ctg,
+                            const std::string& data,
+                            const std::string& colour_init,
+                            const std::string& colour_reset)
+{
+    static const std::string none;
+    std::string buf;
+    write_line(colour_init, log_prefix(grp, ctg, buf), none,
+               data, colour_reset);
+}
+
+
+void StreamLogWriter::Flush()
+{
+    dest.flush();
+}
+
+
+void StreamLogWriter::write_line(const std::string& colour_init,
+                                 const std::string& prefix,
+                                 const std::string& data_colour,
+                                 const std::string& data,
+                                 const std::string& colour_reset)
+{
+    static const std::string no_tstamp;
+    const std::string& tstamp = (timestamp ? get_timestamp() : no_tstamp);
     if (log_meta && !metadata.empty())
     {
-        dest << (timestamp ? GetTimestamp() : "") << " "
+        dest << tstamp << " "
              << colour_init;
         if (prepend_meta)
         {
              dest << metadata.GetMetaValue(prepend_label);
         }
         dest << metadata << colour_reset
-             << std::endl;
+             << "\n";
         prepend_meta = false;
     }
-    dest << (timestamp ? GetTimestamp() : "") << " "
+    dest << tstamp << " "
          << colour_init;
     if (!prepend_label.empty())
     {
         dest << metadata.GetMetaValue(prepend_label);
     }
-    dest << data << colour_reset << std::endl;
+    dest << prefix << data_colour << data << colour_reset << "\n";
+    if (autoflush)
+    {
+        dest.flush();
+    }
     prepend_label.clear();
     metadata.clear();
+    event_time = {};
 }
 
 
@@ -97,27 +169,33 @@ void ColourStreamWriter::Write(const LogGroup grp,
                                const LogCategory ctg,
                                const std::string& data)
 {
+    static const std::string none;
+    if (!colours)
+    {
+        StreamLogWriter::Write(grp, ctg, data, none, none);
+        return;
+    }
+
+    std::string buf;
     switch (colours->GetColourMode())
     {
     case ColourEngine::ColourMode::BY_CATEGORY:
-        LogWriter::Write(grp, ctg, data,
-                         colours->ColourByCategory(ctg),
-                         colours->Reset());
+        write_line(colours->ColourByCategory(ctg), log_prefix(grp, ctg, buf),
+                   none, data, colours->Reset());
         return;
 
     case ColourEngine::ColourMode::BY_GROUP:
         {
-            std::string grpcol = colours->ColourByGroup(grp);
+            const std::string& grpcol = colours->ColourByGroup(grp);
             // Highlights parts of the log event which are higher than LogCategory::INFO
-            std::string ctgcol = (LogCategory::INFO < ctg ? colours->ColourByCategory(ctg) : grpcol);
-            LogWriter::Write(grp, ctg, grpcol + data,
-                             ctgcol,
-                             colours->Reset());
+            const std::string& ctgcol = (LogCategory::INFO < ctg ? colours->ColourByCategory(ctg) : grpcol);
+            write_line(ctgcol, log_prefix(grp, ctg, buf),
+                       grpcol, data, colours->Reset());
         }
         break;
 
     default:
-        LogWriter::Write(grp, ctg, data);
+        StreamLogWriter::Write(grp, ctg, data, none, none);
         return;
     }
 }
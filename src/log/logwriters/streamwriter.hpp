@@ -66,8 +66,44 @@ public:
                const std::string& colour_init = "",
                const std::string& colour_reset = "") override;
 
+    /**
+     *  Writes log data prefixed with the LogGroup and LogCategory.  The
+     *  prefix is written to the stream in front of the log data instead
+     *  of being joined with it first.
+     */
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data,
+               const std::string& colour_init,
+               const std::string& colour_reset) override;
+
+    /*
+     *  The remaining Write() methods are the generic LogWriter ones
+     */
+    using LogWriter::Write;
+
+    void Flush() override;
+
 protected:
     std::ostream& dest;
+
+    /**
+     *  Writes a single log line, with the meta data line in front of it
+     *  if enabled.  All Write() methods end up here.  The parts are
+     *  written to the stream one by one, in the order of the arguments.
+     *
+     * @param colour_init  std::string setting the colour of the line
+     * @param prefix       std::string with the log group and category
+     *                     prefix, may be empty
+     * @param data_colour  std::string setting the colour of the log data
+     *                     after the prefix, may be empty
+     * @param data         std::string with the log data
+     * @param colour_reset std::string resetting the colour selection
+     */
+    virtual void write_line(const std::string& colour_init,
+                            const std::string& prefix,
+                            const std::string& data_colour,
+                            const std::string& data,
+                            const std::string& colour_reset);
 };
 
 
@@ -84,7 +120,8 @@ public:
      *
      * @param dst  std::ostream to be used as the log destination
      * @param ce    ColourEngine object which provides knows how to
-     *              do the proper colouring.
+     *              do the proper colouring.  If nullptr, no colours
+     *              are used.
      */
     ColourStreamWriter(std::ostream& dst, ColourEngine *ce);
     virtual ~ColourStreamWriter() = default;
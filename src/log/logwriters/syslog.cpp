@@ -23,11 +23,21 @@
  * @brief  Implementation of SyslogWriter
  */
 
+#include <cerrno>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "../logwriter.hpp"
+#include "multi.hpp"
 #include "syslog.hpp"
 
 //
@@ -119,3 +129,461 @@ void SyslogWriter::Write(const LogGroup grp, const LogCategory ctg,
 
 
 
+
+
+
+//
+//  SyslogSocketWriter - implementation
+//
+
+/**
+ *  Replaces characters not allowed in the RFC 5424 header fields and
+ *  structured data parameter names, and limits the length
+ *
+ * @param str     std::string to sanitize
+ * @param maxlen  Maximum length of the field
+ * @param extra   Characters not allowed in addition to spaces and
+ *                non-printable characters
+ * @return Returns the sanitized std::string, "-" if it is empty
+ */
+static std::string sanitize_field(const std::string& str, const size_t maxlen,
+                                  const char *extra = "")
+{
+    std::string ret = str.substr(0, maxlen);
+    for (auto& c : ret)
+    {
+        if (c < 33 || c > 126 || nullptr != strchr(extra, c))
+        {
+            c = '_';
+        }
+    }
+    return (ret.empty() ? "-" : ret);
+}
+
+
+/**
+ *  Sanitizes an SD-ID, adding a suffix to its name part.  When the
+ *  SD-ID would be longer than 32 characters, the name is truncated
+ *  before the suffix is added, so "name@pen" keeps both the suffix and
+ *  its "@pen" part.
+ *
+ * @param sdid    std::string with the SD-ID, "name@pen" or just "name"
+ * @param suffix  std::string to add to the name part
+ * @return Returns the sanitized SD-ID
+ */
+static std::string sanitize_sd_id(const std::string& sdid,
+                                  const std::string& suffix = "")
+{
+    const size_t maxlen = 32;
+    size_t at = sdid.find('@');
+    std::string name = sdid.substr(0, at);
+    const std::string pen = (std::string::npos == at ? "" : sdid.substr(at));
+    if (pen.size() + suffix.size() < maxlen)
+    {
+        name = name.substr(0, maxlen - pen.size() - suffix.size());
+    }
+    return sanitize_field(name + suffix + pen, maxlen, "=]\"");
+}
+
+
+/**
+ *  Derives the SD-ID of the log fields element from the SD-ID of the
+ *  meta data element, "name@pen" becomes "name-fields@pen"
+ */
+static std::string fields_sd_id(const std::string& sdid)
+{
+    return sanitize_sd_id(sdid, "-fields");
+}
+
+
+/**
+ *  Appends a structured data parameter, escaping the value
+ */
+static void append_sd_param(std::string& msg, const std::string& name,
+                            const std::string& value)
+{
+    msg += ' ';
+    msg += name;
+    msg += "=\"";
+    for (const char c : value)
+    {
+        if ('"' == c || '\\' == c || ']' == c)
+        {
+            msg += '\\';
+        }
+        msg += c;
+    }
+    msg += "\"";
+}
+
+
+SyslogSocketWriter::SyslogSocketWriter(const std::string& prgname,
+                                       const int log_facility,
+                                       const std::string& tgt,
+                                       const unsigned int batch,
+                                       const std::string& sdid)
+    : LogWriter(), target(tgt), facility(log_facility),
+      batch_size(batch > 0 ? batch : 1),
+      sd_id(sanitize_sd_id(sdid)),
+      sd_id_fields(fields_sd_id(sdid))
+{
+    char host[256] = {};
+    if (0 != gethostname(host, sizeof(host) - 1))
+    {
+        host[0] = '\0';
+    }
+    std::string appname = prgname.substr(prgname.rfind('/') + 1);
+    header_tail = " " + sanitize_field(host, 255)
+                  + " " + sanitize_field(appname, 48)
+                  + " " + std::to_string(getpid()) + " ";
+
+    pending.resize(batch_size);
+    connect_socket();
+}
+
+
+SyslogSocketWriter::~SyslogSocketWriter()
+{
+    send_pending();
+    if (-1 != sockfd)
+    {
+        close(sockfd);
+    }
+}
+
+
+const std::string SyslogSocketWriter::GetLogWriterInfo() const
+{
+    return std::string("syslog:") + target;
+}
+
+
+bool SyslogSocketWriter::TimestampEnabled()
+{
+    return true;
+}
+
+
+void SyslogSocketWriter::Write(const std::string& data,
+                               const std::string& colour_init,
+                               const std::string& colour_reset)
+{
+    format_message(LOG_INFO, LogGroup::UNDEFINED, data);
+}
+
+
+void SyslogSocketWriter::Write(const LogGroup grp, const LogCategory ctg,
+                               const std::string& data,
+                               const std::string& colour_init,
+                               const std::string& colour_reset)
+{
+    format_message(SyslogWriter::logcatg2syslog(ctg), grp, data);
+}
+
+
+void SyslogSocketWriter::Write(const LogEvent& logev)
+{
+    event_time = logev.created;
+    format_message(SyslogWriter::logcatg2syslog(logev.category), logev.group,
+                   logev.message, &logev.fields);
+}
+
+
+void SyslogSocketWriter::Flush()
+{
+    send_pending();
+}
+
+
+void SyslogSocketWriter::Reopen()
+{
+    send_pending();
+    try
+    {
+        connect_socket();
+        send_error = false;
+    }
+    catch (const SyslogException& excp)
+    {
+        std::cerr << "SyslogSocketWriter: " << excp.what() << std::endl;
+    }
+}
+
+
+/**
+ *  Opens and connects the socket to the destination, replacing the
+ *  current socket only when this succeeds.  Throws SyslogException on
+ *  errors.
+ */
+void SyslogSocketWriter::connect_socket()
+{
+    int fd = -1;
+    if ('/' == target[0])
+    {
+        struct sockaddr_un addr = {};
+        if (target.size() >= sizeof(addr.sun_path))
+        {
+            throw SyslogException("Syslog socket path too long: " + target);
+        }
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, target.c_str(), sizeof(addr.sun_path) - 1);
+
+        fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (-1 == fd
+            || 0 != connect(fd, (struct sockaddr *) &addr, sizeof(addr)))
+        {
+            std::string err(strerror(errno));
+            if (-1 != fd)
+            {
+                close(fd);
+            }
+            throw SyslogException("Could not connect to " + target + ": " + err);
+        }
+    }
+    else
+    {
+        // HOST[:PORT], where an IPv6 address HOST must be in brackets
+        std::string host = target;
+        std::string port = "514";
+        size_t colon = target.rfind(':');
+        if ('[' == target[0])
+        {
+            size_t end = target.find(']');
+            if (std::string::npos == end)
+            {
+                throw SyslogException("Invalid syslog server: " + target);
+            }
+            host = target.substr(1, end - 1);
+            if (end + 1 < target.size() && ':' == target[end + 1])
+            {
+                port = target.substr(end + 2);
+            }
+        }
+        else if (std::string::npos != colon
+                 && target.find(':') == colon)
+        {
+            host = target.substr(0, colon);
+            port = target.substr(colon + 1);
+        }
+
+        struct addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        struct addrinfo *res = nullptr;
+        int r = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+        if (0 != r)
+        {
+            throw SyslogException("Could not resolve syslog server "
+                                  + target + ": " + gai_strerror(r));
+        }
+        std::string err = "no address found";
+        for (struct addrinfo *ai = res; ai; ai = ai->ai_next)
+        {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                        ai->ai_protocol);
+            if (-1 != fd && 0 == connect(fd, ai->ai_addr, ai->ai_addrlen))
+            {
+                break;
+            }
+            err = strerror(errno);
+            if (-1 != fd)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(res);
+        if (-1 == fd)
+        {
+            throw SyslogException("Could not connect to syslog server "
+                                  + target + ": " + err);
+        }
+    }
+
+    if (-1 != sockfd)
+    {
+        close(sockfd);
+    }
+    sockfd = fd;
+}
+
+
+/**
+ *  Formats a log event as a RFC 5424 message and adds it to the
+ *  pending messages, sending them if the batch is full or auto-flush
+ *  is enabled
+ *
+ * @param severity  Syslog severity of the message
+ * @param grp       LogGroup of the log event, sent as the MSGID
+ * @param data      std::string with the log message
+ * @param fields    LogFields of the log event, sent as structured data.
+ *                  May be nullptr.
+ */
+void SyslogSocketWriter::format_message(const int severity, const LogGroup grp,
+                                        const std::string& data,
+                                        const LogFields *fields)
+{
+    std::string& msg = pending[pending_count];
+    msg.clear();
+
+    // <PRI>VERSION TIMESTAMP, the time in UTC with microseconds
+    auto t = (std::chrono::system_clock::time_point() != event_time
+              ? event_time : std::chrono::system_clock::now());
+    time_t secs = std::chrono::system_clock::to_time_t(t);
+    long usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+        t - std::chrono::system_clock::from_time_t(secs)).count();
+    if (usecs < 0)
+    {
+        --secs;
+        usecs += 1000000;
+    }
+    struct tm tm = {};
+    gmtime_r(&secs, &tm);
+    char tstamp[64];
+    snprintf(tstamp, sizeof(tstamp), ">1 %04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec, usecs);
+    msg += '<';
+    msg += std::to_string((facility & LOG_FACMASK) | (severity & LOG_PRIMASK));
+    msg += tstamp;
+
+    // HOSTNAME APP-NAME PROCID MSGID
+    msg += header_tail;
+    if (LogGroup::UNDEFINED != grp && (uint8_t) grp < LogGroupCount)
+    {
+        msg += LogWriterSpec::GroupName(grp);
+    }
+    else
+    {
+        msg += "-";
+    }
+
+    // STRUCTURED-DATA, with the meta data as parameters
+    bool sd = false;
+    if (log_meta)
+    {
+        for (const auto& mdv : metadata)
+        {
+            if (mdv->skip)
+            {
+                continue;
+            }
+            if (!sd)
+            {
+                msg += " [";
+                msg += sd_id;
+            }
+            append_sd_param(msg, sanitize_field(mdv->label, 32, "=]\""),
+                            mdv->GetValue(false));
+            sd = true;
+        }
+    }
+    if (fields && !fields->empty())
+    {
+        // The field names are already valid PARAM-NAMEs
+        msg += (sd ? "][" : " [");
+        msg += sd_id_fields;
+        for (const auto& f : *fields)
+        {
+            append_sd_param(msg, f.name, f.GetValue());
+        }
+        sd = true;
+    }
+    msg += (sd ? "] " : " - ");
+
+    if (!prepend_label.empty())
+    {
+        msg += metadata.GetMetaValue(prepend_label);
+    }
+    msg += data;
+
+    prepend_label.clear();
+    prepend_meta = false;
+    metadata.clear();
+    event_time = {};
+
+    if (++pending_count >= batch_size || autoflush)
+    {
+        send_pending();
+    }
+}
+
+
+/**
+ *  Sends all the pending messages, one datagram each.  Messages which
+ *  cannot be sent are discarded, so an unavailable syslog service does
+ *  not stop the logging; the first error is reported on stderr.
+ */
+void SyslogSocketWriter::send_pending()
+{
+    if (0 == pending_count)
+    {
+        return;
+    }
+
+    std::vector<struct iovec> iov(pending_count);
+    std::vector<struct mmsghdr> msgs(pending_count);
+    for (size_t i = 0; i < pending_count; ++i)
+    {
+        iov[i].iov_base = (void *) pending[i].data();
+        iov[i].iov_len = pending[i].size();
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t sent = 0;
+    bool reconnected = false;
+    while (sent < pending_count)
+    {
+        int r = sendmmsg(sockfd, msgs.data() + sent,
+                         pending_count - sent, MSG_NOSIGNAL);
+        if (r > 0)
+        {
+            sent += r;
+            continue;
+        }
+        if (r < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        int err = errno;
+
+        if (EMSGSIZE == err)
+        {
+            // Only this message is too large for a datagram
+            report_error(err);
+            ++sent;
+            continue;
+        }
+
+        // The local syslog service may have been restarted, which
+        // replaces its socket
+        if (!reconnected && (ECONNREFUSED == err || ENOTCONN == err))
+        {
+            reconnected = true;
+            try
+            {
+                connect_socket();
+                continue;
+            }
+            catch (const SyslogException&)
+            {
+            }
+        }
+        report_error(err);
+        break;
+    }
+    pending_count = 0;
+}
+
+
+void SyslogSocketWriter::report_error(const int err)
+{
+    if (!send_error)
+    {
+        std::cerr << "SyslogSocketWriter: Could not send to " << target
+                  << ": " << strerror(err) << std::endl;
+        send_error = true;
+    }
+}
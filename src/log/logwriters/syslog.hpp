@@ -28,6 +28,9 @@
 #include <syslog.h>
 #include <string.h>
 
+#include <string>
+#include <vector>
+
 #include "log/logwriter.hpp"
 #include "log/log-helpers.hpp"
 
@@ -141,8 +144,6 @@ public:
                        const std::string& colour_init,
                        const std::string& colour_reset) override;
 
-private:
-    char *progname = nullptr;
 
     /**
      *  Simple conversion between LogCategory and a corresponding
@@ -179,6 +180,114 @@ private:
             return LOG_INFO;
         }
     }
+
+private:
+    char *progname = nullptr;
+};
+
+
+
+/**
+ *  LogWriter sending RFC 5424 formatted syslog messages directly to a
+ *  syslog socket, without going through syslog(3).
+ *
+ *  The destination is either a local datagram socket, such as /dev/log,
+ *  or a remote syslog server receiving messages over UDP.  The socket is
+ *  kept open for the lifetime of the object.  The log group is sent as
+ *  the MSGID and the meta data as structured data, so the log receiver
+ *  does not need to parse the message text to filter on them.
+ *
+ *  When auto-flush is disabled, as done by the AsyncLogWriter, the
+ *  messages are collected and sent in batches with sendmmsg(2), one
+ *  datagram per message, when the batch is full or on Flush().
+ */
+class SyslogSocketWriter : public LogWriter
+{
+public:
+    /**
+     *  Initialize the SyslogSocketWriter.  Throws SyslogException if the
+     *  destination cannot be resolved or connected to.
+     *
+     * @param prgname       std::string with the program name, used as the
+     *                      APP-NAME of the messages
+     * @param log_facility  Syslog facility to use for log messages
+     * @param target        std::string with the destination.  A path
+     *                      starting with '/' is a local datagram socket,
+     *                      otherwise it is HOST[:PORT] of a syslog server
+     *                      listening on UDP.  The default port is 514.
+     * @param batch_size    Maximum number of messages sent in one
+     *                      sendmmsg(2) call
+     * @param sd_id         std::string with the SD-ID of the structured
+     *                      data element carrying the meta data.  The
+     *                      default uses the private enterprise number
+     *                      RFC 5612 reserves for documentation; log
+     *                      pipelines wanting a registered one should set
+     *                      their own.  The log fields of a log event are
+     *                      sent in a second element, where "-fields" is
+     *                      added to the name part of this SD-ID.  The
+     *                      name part is truncated if needed, so both
+     *                      SD-IDs fit in 32 characters.
+     */
+    SyslogSocketWriter(const std::string& prgname,
+                       const int log_facility = LOG_DAEMON,
+                       const std::string& target = "/dev/log",
+                       const unsigned int batch_size = 64,
+                       const std::string& sd_id = "openvpn3@32473");
+    virtual ~SyslogSocketWriter();
+
+    const std::string GetLogWriterInfo() const override;
+
+    /**
+     *  The messages always carry a timestamp, so this returns true
+     *  like SyslogWriter::TimestampEnabled() does.
+     */
+    bool TimestampEnabled() override;
+
+    void Write(const std::string& data,
+               const std::string& colour_init = "",
+               const std::string& colour_reset = "") override;
+
+    void Write(const LogGroup grp, const LogCategory ctg,
+               const std::string& data,
+               const std::string& colour_init,
+               const std::string& colour_reset) override;
+
+    /**
+     *  Writes a LogEvent, adding its log fields as structured data
+     */
+    void Write(const LogEvent& logev) override;
+
+    using LogWriter::Write;
+
+    void Flush() override;
+
+    /**
+     *  Connects the socket again, for example after the local syslog
+     *  service has been restarted.  Pending messages are sent first.
+     */
+    void Reopen() override;
+
+
+private:
+    const std::string target;
+    const int facility;
+    const size_t batch_size;
+    const std::string sd_id;
+    const std::string sd_id_fields;
+    std::string header_tail;      ///< " HOSTNAME APP-NAME PROCID "
+    int sockfd = -1;
+    bool send_error = false;
+
+    /// Formatted messages; the strings are reused between batches
+    std::vector<std::string> pending;
+    size_t pending_count = 0;
+
+    void connect_socket();
+    void format_message(const int severity, const LogGroup grp,
+                        const std::string& data,
+                        const LogFields *fields = nullptr);
+    void send_pending();
+    void report_error(const int err);
 };
 
 
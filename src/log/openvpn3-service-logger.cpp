@@ -21,12 +21,14 @@
 #include <iomanip>
 #include <sstream>
 #include <exception>
+#include <stdexcept>
 
 #define SHUTDOWN_NOTIF_PROCESS_NAME "openvpn3-service-logger"
 #include "dbus/core.hpp"
 #include "dbus-log.hpp"
 #include "common/utils.hpp"
 #include "common/cmdargparser.hpp"
+#include "common/startup-timing.hpp"
 #include "logger.hpp"
 #include "logtag.hpp"
 #include "logwriter.hpp"
@@ -49,13 +51,144 @@ struct LogStringTag : public LogTag
     }
     ~LogStringTag() = default;
 
-    const std::string str(const bool override) const override
+    const std::string& str(const bool override) const override
     {
         return tag;
     }
 };
 
 
+/**
+ *  Signal handler for SIGHUP, reopening the log destination
+ *
+ * @param data  Pointer to the LogWriter in use
+ * @return Returns G_SOURCE_CONTINUE to keep handling the signal
+ */
+static gboolean reopen_handler(gpointer data)
+{
+    static_cast<LogWriter *>(data)->Reopen();
+    return G_SOURCE_CONTINUE;
+}
+
+
+/**
+ *  Creates the LogWriter for a single log destination
+ *
+ * @param args     ParsedArgs::Ptr with the options of the log destinations
+ * @param method   std::string with the log method; journald, syslog, file,
+ *                 archive or stdout
+ * @param target   std::string with the log file or archive directory for
+ *                 the file and archive methods
+ * @param colours  ColourEngine used by the file and stdout methods, nullptr
+ *                 to not use colours
+ *
+ * @return Returns a LogWriter::Ptr to the new LogWriter.  Throws
+ *         LogException or SyslogException on errors.
+ */
+static LogWriter::Ptr create_logwriter(ParsedArgs::Ptr args,
+                                       const std::string& method,
+                                       const std::string& target,
+                                       ColourEngine *colours)
+{
+    LogWriter::Ptr logwr = nullptr;
+    if ("journald" == method)
+    {
+#if HAVE_SYSTEMD
+        logwr.reset(new JournaldWriter());
+        logwr->EnableMessagePrepend(!args->Present("no-logtag-prefix"));
+#else
+        THROW_LOGEXCEPTION("systemd-journald support is not available");
+#endif // HAVE_SYSTEMD
+    }
+    else if ("archive" == method)
+    {
+        size_t segment_size = 64;
+        if (args->Present("log-archive-segment-size"))
+        {
+            segment_size = std::atoi(args->GetValue("log-archive-segment-size", 0).c_str());
+        }
+        unsigned int max_segments = 0;
+        if (args->Present("log-archive-max-segments"))
+        {
+            max_segments = std::atoi(args->GetValue("log-archive-max-segments", 0).c_str());
+        }
+        logwr.reset(new ArchiveLogWriter(target,
+                                         segment_size * 1024 * 1024,
+                                         max_segments));
+    }
+    else if ("file" == method)
+    {
+        FileLogWriter::Rotation rotation;
+        if (args->Present("log-file-max-size"))
+        {
+            rotation.max_size = std::atoll(args->GetValue("log-file-max-size", 0).c_str())
+                                * 1024 * 1024;
+        }
+        if (args->Present("log-file-max-age"))
+        {
+            rotation.max_age = std::chrono::hours(std::atoi(args->GetValue("log-file-max-age", 0).c_str()));
+        }
+        if (args->Present("log-file-keep"))
+        {
+            rotation.keep = std::atoi(args->GetValue("log-file-keep", 0).c_str());
+        }
+        rotation.compress = args->Present("log-file-compress");
+
+        size_t buffer_size = 64;
+        if (args->Present("log-file-buffer"))
+        {
+            buffer_size = std::atoi(args->GetValue("log-file-buffer", 0).c_str());
+        }
+        unsigned int flush_intv = 1000;
+        if (args->Present("log-flush-interval"))
+        {
+            flush_intv = std::atoi(args->GetValue("log-flush-interval", 0).c_str());
+        }
+        logwr.reset(new FileLogWriter(target, rotation, buffer_size * 1024,
+                                      std::chrono::milliseconds(flush_intv),
+                                      colours));
+    }
+    else if ("syslog" == method)
+    {
+        int facility = LOG_DAEMON;
+        if (args->Present("syslog-facility"))
+        {
+            facility = SyslogWriter::ConvertLogFacility(args->GetValue("syslog-facility", 0));
+        }
+        if (args->Present("syslog-target"))
+        {
+            logwr.reset(new SyslogSocketWriter(args->GetArgv0(), facility,
+                                               args->GetValue("syslog-target", 0)));
+        }
+        else
+        {
+            logwr.reset(new SyslogWriter(args->GetArgv0(), facility));
+        }
+    }
+    else if (colours)
+    {
+        logwr.reset(new ColourStreamWriter(std::cout, colours));
+    }
+    else
+    {
+        logwr.reset(new StreamLogWriter(std::cout));
+    }
+
+    if (args->Present("timestamp-precision"))
+    {
+        try
+        {
+            logwr->SetTimestampPrecision(TimestampFormatter::ParsePrecision(args->GetValue("timestamp-precision", 0)));
+        }
+        catch (const std::invalid_argument& excp)
+        {
+            THROW_LOGEXCEPTION(excp.what());
+        }
+    }
+    return logwr;
+}
+
+
 static int logger(ParsedArgs::Ptr args)
 {
     int ret = 0;
@@ -124,12 +257,13 @@ static int logger(ParsedArgs::Ptr args)
             throw CommandException("openvpn3-service-logger", e.str());
         }
         args->ImportConfigFile(cfgfile);
+        StartupTiming::Instance().Mark("config_loaded");
     }
 
     try
     {
-        args->CheckExclusiveOptions({{"syslog", "journald", "log-file"},
-                                     {"syslog", "journald", "colour"}});
+        args->CheckExclusiveOptions({{"syslog", "journald", "log-file", "log-archive", "log-writers"},
+                                     {"syslog", "journald", "colour", "log-archive"}});
     }
     catch (const ExclusiveOptionError& excp)
     {
@@ -146,64 +280,103 @@ static int logger(ParsedArgs::Ptr args)
     Logger::Ptr config_subscr = nullptr;
     LogService::Ptr logsrv = nullptr;
 
-    // Open a log destination
-    std::ofstream logfs;
-    std::streambuf * logstream;
-    bool do_console_info = true;
-    if (args->Present("log-file"))
-    {
-        logfs.open(args->GetValue("log-file", 0), std::ios_base::app);
-        logstream = logfs.rdbuf();
-    }
-    else
-    {
-        logstream = std::cout.rdbuf();
-        do_console_info = false;
-    }
-    std::ostream logfile(logstream);
-
     // Prepare the appropriate log writer
     LogWriter::Ptr logwr = nullptr;
     ColourEngine::Ptr colourengine = nullptr;
-#if HAVE_SYSTEMD
-    if (args->Present("journald"))
+    if (args->Present("colour"))
     {
-        do_console_info = true;
-        logwr.reset(new JournaldWriter());
-        logwr->EnableMessagePrepend(!args->Present("no-logtag-prefix"));
+        colourengine.reset(new ANSIColours());
     }
-    else
-#endif // HAVE_SYSTEMD
-    if (args->Present("syslog"))
-     {
-        do_console_info = true;
-        int facility = LOG_DAEMON;
-        if (args->Present("syslog-facility"))
+
+    // Log to the console unless another log destination is given
+    bool do_console_info = true;
+    try
+    {
+        if (args->Present("log-writers"))
+        {
+            MultiLogWriter *multi = new MultiLogWriter();
+            logwr.reset(multi);
+            for (const auto& spec : LogWriterSpec::ParseList(args->GetValue("log-writers", 0)))
+            {
+                multi->AddWriter(create_logwriter(args, spec.method,
+                                                  spec.target,
+                                                  colourengine.get()),
+                                 spec.filter);
+            }
+        }
+        else
         {
-            try {
-                std::string f = args->GetValue("syslog-facility", 0);
-                facility = SyslogWriter::ConvertLogFacility(f);
+            std::string method = "stdout";
+            std::string target;
+            if (args->Present("journald"))
+            {
+                method = "journald";
             }
-            catch (SyslogException& excp)
+            else if (args->Present("log-archive"))
             {
-                throw CommandException("openvpn3-service-logger",
-                                       excp.what());
+                method = "archive";
+                target = args->GetValue("log-archive", 0);
             }
+            else if (args->Present("log-file"))
+            {
+                method = "file";
+                target = args->GetValue("log-file", 0);
+            }
+            else if (args->Present("syslog"))
+            {
+                method = "syslog";
+            }
+            do_console_info = ("stdout" != method);
+            logwr = create_logwriter(args, method, target, colourengine.get());
         }
-        logwr.reset(new SyslogWriter(args->GetArgv0(), facility));
-     }
-     else if (args->Present("colour"))
+    }
+    catch (const LogException& excp)
+    {
+        throw CommandException("openvpn3-service-logger",
+                               excp.what());
+    }
+    catch (const SyslogException& excp)
+    {
+        throw CommandException("openvpn3-service-logger",
+                               excp.what());
+    }
+
+     logwr->EnableTimestamp(args->Present("timestamp"));
+     logwr->EnableLogMeta(args->Present("service-log-dbus-details"));
+
+     // Unless disabled, let a separate writer thread do the writing to
+     // the log destination.  A slow log destination or a very chatty log
+     // sender will then not block the processing of D-Bus requests.
+     int log_queue_size = 4096;
+     if (args->Present("log-queue-size"))
      {
-         colourengine.reset(new ANSIColours());
-         logwr.reset(new ColourStreamWriter(logfile,
-                                            colourengine.get()));
+         log_queue_size = std::atoi(args->GetValue("log-queue-size", 0).c_str());
      }
-     else
+     if (log_queue_size > 0)
      {
-         logwr.reset(new StreamLogWriter(logfile));
+         unsigned int flush_intv = 1000;
+         if (args->Present("log-flush-interval"))
+         {
+             flush_intv = std::atoi(args->GetValue("log-flush-interval", 0).c_str());
+         }
+         AsyncLogWriter::OverflowPolicy overflow = AsyncLogWriter::OverflowPolicy::DROP;
+         if (args->Present("log-queue-overflow"))
+         {
+             try
+             {
+                 overflow = AsyncLogWriter::ParseOverflowPolicy(args->GetValue("log-queue-overflow", 0));
+             }
+             catch (const LogException& excp)
+             {
+                 throw CommandException("openvpn3-service-logger",
+                                        excp.what());
+             }
+         }
+         logwr.reset(new AsyncLogWriter(std::move(logwr),
+                                        static_cast<size_t>(log_queue_size),
+                                        std::chrono::milliseconds(flush_intv),
+                                        overflow));
      }
-     logwr->EnableTimestamp(args->Present("timestamp"));
-     logwr->EnableLogMeta(args->Present("service-log-dbus-details"));
 
      // Enable automatic shutdown if the logger is
      // idling for 10 minute or more.  By idling, it means
@@ -230,6 +403,9 @@ static int logger(ParsedArgs::Ptr args)
         // Prepare the GLib GMainLoop
         GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
 
+        // Let log rotation tools make the log file to be reopened
+        g_unix_signal_add(SIGHUP, reopen_handler, logwr.get());
+
         if (args->Present("service"))
         {
             //  openvpn3-logger-service runs as a D-Bus log service
@@ -247,6 +423,38 @@ static int logger(ParsedArgs::Ptr args)
             {
                 logsrv->SetConfigFile(cfgfile);
             }
+            if (args->Present("log-rate-limit"))
+            {
+                int rate = std::atoi(args->GetValue("log-rate-limit", 0).c_str());
+                int burst = rate;
+                if (args->Present("log-rate-burst"))
+                {
+                    burst = std::atoi(args->GetValue("log-rate-burst", 0).c_str());
+                }
+                logsrv->SetLogRateLimit((rate > 0 ? rate : 0),
+                                        (burst > 0 ? burst : 0));
+            }
+            if (args->Present("session-logs"))
+            {
+                logsrv->SetSessionLogs(args->GetValue("session-logs", 0));
+            }
+            if (args->Present("ingest-threads"))
+            {
+                int threads = std::atoi(args->GetValue("ingest-threads", 0).c_str());
+                if (threads < 0 || threads > 64)
+                {
+                    throw CommandException("openvpn3-service-logger",
+                                           "Invalid argument to --ingest-threads: "
+                                           + args->GetValue("ingest-threads", 0));
+                }
+                if (threads > 0 && log_queue_size <= 0)
+                {
+                    throw CommandException("openvpn3-service-logger",
+                                           "--ingest-threads requires the log "
+                                           "queue, see --log-queue-size");
+                }
+                logsrv->SetIngestThreads(threads);
+            }
 
             if (idle_wait_min > 0)
             {
@@ -353,11 +561,10 @@ static int logger(ParsedArgs::Ptr args)
         procsig.ProcessChange(StatusMinor::PROC_STOPPED);
         g_main_loop_unref(main_loop);
 
-        // If the idle check is running, wait for it to complete
+        // If the idle check is running, remove its timer
         if (idle_wait_min > 0)
         {
             idle_exit->Disable();
-            idle_exit->Join();
         }
 
         ret = 0;
@@ -372,6 +579,8 @@ static int logger(ParsedArgs::Ptr args)
 
 int main(int argc, char **argv)
 {
+    StartupTiming::Instance().Mark("main");
+
     // This program does not require root privileges,
     // so if used - drop those privileges
     drop_root();
@@ -380,6 +589,9 @@ int main(int argc, char **argv)
     argparser.AddVersionOption();
     argparser.AddOption("timestamp", 0,
                         "Print timestamps on each log entry");
+    argparser.AddOption("timestamp-precision", 0, "s|ms|us", true,
+                        "Add milliseconds (ms) or microseconds (us) to "
+                        "timestamps (Default: s)");
     argparser.AddOption("colour", 0,
                         "Use colours to categorize log events");
     argparser.AddOption("config-manager", 0,
@@ -402,10 +614,44 @@ int main(int argc, char **argv)
                         "Send all log events to syslog");
     argparser.AddOption("syslog-facility", 0, "FACILITY", true,
                         "Use a specific syslog facility (Default: LOG_DAEMON)");
+    argparser.AddOption("syslog-target", 0, "TARGET", true,
+                        "Send RFC 5424 messages directly to a local socket "
+                        "path or a HOST[:PORT] over UDP");
     argparser.AddOption("log-file", 0, "FILE", true,
                         "Log events to file");
+    argparser.AddOption("log-file-buffer", 0, "KB", true,
+                        "Size of the log file write buffer (Default: 64)");
+    argparser.AddOption("log-file-max-size", 0, "MB", true,
+                        "Rotate the log file when it reaches this size. "
+                        "0 disables it (Default: 0)");
+    argparser.AddOption("log-file-max-age", 0, "HOURS", true,
+                        "Rotate the log file when it has been in use this "
+                        "long. 0 disables it (Default: 0)");
+    argparser.AddOption("log-file-keep", 0, "COUNT", true,
+                        "Number of rotated log files to keep (Default: 5)");
+    argparser.AddOption("log-file-compress", 0,
+                        "Compress rotated log files with LZ4");
+    argparser.AddOption("log-writers", 0, "LIST", true,
+                        "Log events to several log destinations, each with "
+                        "its own filter.  See the man page for the format");
+    argparser.AddOption("log-archive", 0, "DIRECTORY", true,
+                        "Log events to a binary log archive in DIRECTORY");
+    argparser.AddOption("log-archive-segment-size", 0, "MB", true,
+                        "Size of each log archive segment file (Default: 64)");
+    argparser.AddOption("log-archive-max-segments", 0, "COUNT", true,
+                        "Maximum number of log archive segment files to keep. "
+                        "0 keeps all (Default: 0)");
     argparser.AddOption("service", 0,
                         "Run as a background D-Bus service");
+#if HAVE_SYSTEMD
+    argparser.AddOption("session-logs", 0, "DIRECTORY|journald", true,
+                        "Let VPN sessions log directly to a file per session "
+                        "in DIRECTORY or to systemd-journald (--service only)");
+#else
+    argparser.AddOption("session-logs", 0, "DIRECTORY", true,
+                        "Let VPN sessions log directly to a file per session "
+                        "in DIRECTORY (--service only)");
+#endif // HAVE_SYSTEMD
     argparser.AddOption("service-log-dbus-details", 0,
                         "(Only with --service) Include D-Bus sender, path and method references in logs");
     argparser.AddOption("idle-exit", 0, "MINUTES", true,
@@ -414,6 +660,29 @@ int main(int argc, char **argv)
     argparser.AddOption("state-dir", 0, "DIRECTORY", true,
                         "(Only with --service) Directory where to save the "
                         "service log settings");
+    argparser.AddOption("log-queue-size", 0, "EVENTS", true,
+                        "Number of log events which can be queued for the "
+                        "log writer thread. 0 writes log events directly "
+                        "(Default: 4096)");
+    argparser.AddOption("log-flush-interval", 0, "MSECS", true,
+                        "How often to flush the log destination while busy "
+                        "writing queued log events (Default: 1000)");
+    argparser.AddOption("log-queue-overflow", 0, "drop|block", true,
+                        "What to do with new log events when the log queue "
+                        "is full (Default: drop)");
+    argparser.AddOption("ingest-threads", 0, "THREADS", true,
+                        "(Only with --service) Number of threads receiving "
+                        "and processing the log events of the VPN sessions "
+                        "and services. 0 processes them in the main thread "
+                        "(Default: 0)");
+    argparser.AddOption("log-rate-limit", 0, "EVENTS", true,
+                        "(Only with --service) Average number of log events "
+                        "per second each VPN session may send. 0 disables "
+                        "it (Default: 0)");
+    argparser.AddOption("log-rate-burst", 0, "EVENTS", true,
+                        "(Only with --service) Number of log events a VPN "
+                        "session may send in a burst (Default: same as "
+                        "--log-rate-limit)");
 
     try
     {
@@ -26,11 +26,17 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <iostream>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 #include "dbus/core.hpp"
 #include "dbus/proxy.hpp"
+#include "dbus/object-handle.hpp"
 #include "dbus/glibutils.hpp"
+#include "log/log-fd-sink.hpp"
 
 /**
  *  Basic exception class for LogServiceProxy related errors
@@ -91,16 +97,43 @@ struct LogSubscriberEntry
 typedef std::vector<LogSubscriberEntry> LogSubscribers;
 
 
-class LogProxy : protected DBusProxy
+struct LogSenderStatsEntry
+{
+    LogSenderStatsEntry(std::string tag,
+                        std::string busname,
+                        std::string interface,
+                        uint64_t events,
+                        double rate)
+        : tag(tag), busname(busname), interface(interface),
+          events(events), rate(rate)
+    {
+    }
+
+    std::string tag;
+    std::string busname;
+    std::string interface;
+    uint64_t events;   ///< Log events received from this sender
+    double rate;       ///< Recent log events per second
+};
+
+typedef std::vector<LogSenderStatsEntry> LogSenderStats;
+
+
+/**
+ *  Client side access to a log proxy object in the log service.  One is
+ *  created per forwarded session, so this uses a DBusObjectHandle instead
+ *  of setting up a full DBusProxy.
+ */
+class LogProxy
 {
 public:
     using Ptr = std::shared_ptr<LogProxy>;
 
     LogProxy(GDBusConnection* conn, const std::string& path)
-        : DBusProxy(conn,
-                    OpenVPN3DBus_name_log,
-                    OpenVPN3DBus_interf_log,
-                    path)
+        : handle(conn,
+                 OpenVPN3DBus_name_log,
+                 path,
+                 OpenVPN3DBus_interf_log)
     {
     }
 
@@ -109,38 +142,101 @@ public:
 
     const std::string GetPath() const
     {
-        return GetProxyPath();
+        return handle.GetPath();
     }
 
 
     const unsigned int GetLogLevel() const
     {
-        return GetUIntProperty("log_level");
+        return handle.GetProperty<uint32_t>("log_level");
     }
 
 
     void SetLogLevel(const unsigned int loglev)
     {
-        SetProperty("log_level", loglev);
+        handle.SetProperty("log_level", g_variant_new_uint32(loglev));
+    }
+
+
+    /**
+     *  Enable or disable batched forwarding.  Batched log events are sent
+     *  in a single LogBatch signal instead of one Log signal each.
+     *
+     * @param max_events   Send the queued log events when this many have
+     *                     been queued.  0 disables batching.
+     * @param interval_ms  Send the queued log events at the latest after
+     *                     this many milliseconds
+     */
+    void SetBatching(const unsigned int max_events,
+                     const unsigned int interval_ms)
+    {
+        GVariant *res = handle.Call("SetBatching",
+                                    g_variant_new("(uu)", max_events, interval_ms));
+        if (nullptr == res)
+        {
+            throw LogServiceProxyException("SetBatching call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     *  Enable or disable the compact format.  Log events and status
+     *  changes are then sent as LogCompact signals, see log-compact.hpp.
+     *
+     * @param enable  Boolean flag enabling the compact format
+     */
+    void SetCompactFormat(const bool enable)
+    {
+        GVariant *res = handle.Call("SetCompactFormat",
+                                    g_variant_new("(b)", enable));
+        if (nullptr == res)
+        {
+            throw LogServiceProxyException("SetCompactFormat call failed");
+        }
+        g_variant_unref(res);
     }
 
 
     const std::string GetSessionPath() const
     {
-        return GetStringProperty("session_path");
+        return handle.GetProperty<std::string>("session_path");
     }
 
 
     const std::string GetLogTarget() const
     {
-        return GetStringProperty("target");
+        return handle.GetProperty<std::string>("target");
     }
 
 
     void Remove()
     {
-        (void) Call("Remove", true);
+        (void) handle.Call("Remove", nullptr, true);
+    }
+
+
+    /**
+     *  Stop forwarding the events of a single VPN session.  The log
+     *  service removes the proxy once no VPN sessions are left.
+     *
+     * @param session_path  std::string with the D-Bus object path of the
+     *                      VPN session
+     */
+    void RemoveSession(const std::string& session_path)
+    {
+        GVariant *res = handle.Call("RemoveSession",
+                                    g_variant_new("(o)", session_path.c_str()));
+        if (nullptr == res)
+        {
+            throw LogServiceProxyException("RemoveSession call failed");
+        }
+        g_variant_unref(res);
     }
+
+
+private:
+    DBusObjectHandle handle;
 };
 
 
@@ -210,6 +306,63 @@ public:
         return lgs;
     }
 
+
+    /**
+     *  Connects and attaches to the Log service from the main loop, once
+     *  the main loop is idle.  Services use this to claim their own bus
+     *  name and answer the first requests without waiting for the log
+     *  service to be activated.
+     *
+     *  If attaching fails, an error is written to stderr and the service
+     *  continues without the log service.
+     *
+     * @param conn        GDBusConnection* to the D-Bus system bus
+     * @param interfaces  D-Bus interfaces the log service will log from
+     *                    this process
+     * @param dest        LogServiceProxy::Ptr which is set when attached.
+     *                    It must remain valid until the main loop has
+     *                    stopped.
+     */
+    static void AttachInterfaceDeferred(GDBusConnection *conn,
+                                        const std::vector<std::string>& interfaces,
+                                        LogServiceProxy::Ptr& dest)
+    {
+        struct Deferred
+        {
+            GDBusConnection *conn;
+            std::vector<std::string> interfaces;
+            LogServiceProxy::Ptr& dest;
+        };
+
+        g_idle_add_full(G_PRIORITY_DEFAULT_IDLE,
+                        [](gpointer data) -> gboolean
+                        {
+                            Deferred *d = static_cast<Deferred *>(data);
+                            try
+                            {
+                                LogServiceProxy::Ptr lgs;
+                                lgs = AttachInterface(d->conn, d->interfaces[0]);
+                                for (size_t i = 1; i < d->interfaces.size(); i++)
+                                {
+                                    lgs->Attach(d->interfaces[i]);
+                                }
+                                d->dest = lgs;
+                            }
+                            catch (const std::exception& excp)
+                            {
+                                std::cerr << "** ERROR ** " << excp.what()
+                                          << std::endl;
+                            }
+                            return G_SOURCE_REMOVE;
+                        },
+                        new Deferred{conn, interfaces, dest},
+                        [](gpointer data)
+                        {
+                            delete static_cast<Deferred *>(data);
+                        });
+    }
+
+
     /**
      *  Attach this D-Bus connection to the log service.  By doing this
      *  all Log signals sent from this client will be caught by the log
@@ -242,6 +395,58 @@ public:
     }
 
 
+    /**
+     *  Retrieves a file descriptor the VPN client process can write
+     *  the log events of its session to, bypassing the D-Bus.  The
+     *  session must first be assigned via AssignSession().
+     *
+     * @param sesspath  std::string with the session object path
+     * @param interf    std::string with the D-Bus interface attached
+     *
+     * @return Returns a LogFdSink::Ptr writing to the session log.
+     *         Throws LogServiceProxyException if the log service has no
+     *         session logs enabled.
+     */
+    LogFdSink::Ptr OpenSessionLog(const std::string& sesspath,
+                                  const std::string& interf) const
+    {
+        int fd = -1;
+        GVariant *res = nullptr;
+        try
+        {
+            res = CallGetFD("OpenSessionLog",
+                            g_variant_new("(os)", sesspath.c_str(),
+                                          interf.c_str()),
+                            fd);
+        }
+        catch (const DBusException& excp)
+        {
+            throw LogServiceProxyException("OpenSessionLog failed",
+                                           excp.GetRawError());
+        }
+        if (nullptr == res || fd < 0)
+        {
+            if (res)
+            {
+                g_variant_unref(res);
+            }
+            throw LogServiceProxyException("OpenSessionLog failed");
+        }
+
+        std::string format = GLibUtils::ExtractValue<std::string>(res, 0);
+        g_variant_unref(res);
+        try
+        {
+            return std::make_shared<LogFdSink>(fd, LogFdSink::ParseFormat(format));
+        }
+        catch (const std::invalid_argument& excp)
+        {
+            close(fd);
+            throw LogServiceProxyException("OpenSessionLog failed", excp.what());
+        }
+    }
+
+
     LogProxy::Ptr ProxyLogEvents(const std::string& target,
                                const std::string& session_path) const
     {
@@ -317,6 +522,29 @@ public:
     }
 
 
+    /**
+     *  Retrieve the log rate limit VPN sessions should use
+     *
+     * @return  Returns the average number of log events per second.  0
+     *          means rate limiting is disabled.
+     */
+    unsigned int GetLogRateLimit()
+    {
+        return GetUIntProperty("log_rate_limit");
+    }
+
+
+    /**
+     *  Retrieve the number of log events a VPN session may send in a burst
+     *
+     * @return  Returns the number of log events
+     */
+    unsigned int GetLogRateBurst()
+    {
+        return GetUIntProperty("log_rate_burst");
+    }
+
+
     /**
      *  Modifies the log level the log service will use for filtering out
      *  log messages.
@@ -438,7 +666,125 @@ public:
         return list;
     }
 
+
+    /**
+     * @return Returns the number of log events received from all
+     *         attached log senders since the log service started
+     */
+    uint64_t GetEventsReceived()
+    {
+        return GetUInt64Property("events_received");
+    }
+
+
+    /**
+     * @return Returns the number of log events passed on to the log writer
+     */
+    uint64_t GetEventsWritten()
+    {
+        return GetUInt64Property("events_written");
+    }
+
+
+    /**
+     * @return Returns the number of log events discarded by the log writer
+     */
+    uint64_t GetEventsDropped()
+    {
+        return GetUInt64Property("events_dropped");
+    }
+
+
+    /**
+     * @return Returns the number of log events waiting in the log queue
+     */
+    unsigned int GetQueueDepth()
+    {
+        return GetUIntProperty("queue_depth");
+    }
+
+
+    /**
+     * @return Returns the upper bounds, in microseconds, of the buckets
+     *         used by GetWriteLatency() and GetQueueLatency()
+     */
+    std::vector<uint64_t> GetLatencyBuckets()
+    {
+        return get_uint64_array_property("latency_buckets");
+    }
+
+
+    /**
+     * @return Returns the histogram of the time spent writing each
+     *         log event
+     */
+    std::vector<uint64_t> GetWriteLatency()
+    {
+        return get_uint64_array_property("write_latency");
+    }
+
+
+    /**
+     * @return Returns the histogram of the time log events spent in the
+     *         log queue.  Empty if the log writer does not queue log events.
+     */
+    std::vector<uint64_t> GetQueueLatency()
+    {
+        return get_uint64_array_property("queue_latency");
+    }
+
+
+    /**
+     * @return Returns a LogSenderStats list with the number of log events
+     *         received from each attached log sender
+     */
+    LogSenderStats GetSenderStats()
+    {
+        typedef std::tuple<std::string, std::string, std::string,
+                           uint64_t, double> SenderStatsTuple;
+
+        GVariant *res = GetProperty("sender_stats");
+        std::vector<SenderStatsTuple> raw;
+        try
+        {
+            raw = GLibUtils::Unmarshal<std::vector<SenderStatsTuple>>(res);
+        }
+        catch (...)
+        {
+            g_variant_unref(res);
+            throw;
+        }
+        g_variant_unref(res);
+
+        LogSenderStats ret;
+        for (const auto& e : raw)
+        {
+            ret.push_back(LogSenderStatsEntry(std::get<0>(e), std::get<1>(e),
+                                              std::get<2>(e), std::get<3>(e),
+                                              std::get<4>(e)));
+        }
+        return ret;
+    }
+
 private:
+    std::vector<uint64_t> get_uint64_array_property(const std::string& prop)
+    {
+        GVariant *res = GetProperty(prop);
+        std::vector<uint64_t> ret;
+        try
+        {
+            ret = GLibUtils::Unmarshal<std::vector<uint64_t>>(res);
+        }
+        catch (...)
+        {
+            g_variant_unref(res);
+            throw;
+        }
+        g_variant_unref(res);
+        return ret;
+    }
+
+
     static bool logsubscribers_sort(const LogSubscriberEntry& lhs,
                                     const LogSubscriberEntry& rhs)
     {
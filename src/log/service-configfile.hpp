@@ -64,10 +64,42 @@ protected:
             OptionMapEntry{"syslog-facility", "syslog_facility",
                            "Syslog facility",
                            OptionValueType::String},
+            OptionMapEntry{"syslog-target", "syslog_target",
+                           "Syslog socket or server for RFC 5424 messages",
+                           OptionValueType::String},
             OptionMapEntry{"log-file", "log_file",
                            "log_method_group",
                            "Log file",
                            OptionValueType::String},
+            OptionMapEntry{"log-file-buffer", "log_file_buffer",
+                           "Log file write buffer size (KB)",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-file-max-size", "log_file_max_size",
+                           "Log file rotation size (MB)",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-file-max-age", "log_file_max_age",
+                           "Log file rotation age (hours)",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-file-keep", "log_file_keep",
+                           "Rotated log files to keep",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-file-compress", "log_file_compress",
+                           "Compress rotated log files",
+                           OptionValueType::Present},
+            OptionMapEntry{"log-writers", "log_writers",
+                           "log_method_group",
+                           "Log destinations with filters",
+                           OptionValueType::String},
+            OptionMapEntry{"log-archive", "log_archive",
+                           "log_method_group",
+                           "Log archive directory",
+                           OptionValueType::String},
+            OptionMapEntry{"log-archive-segment-size", "log_archive_segment_size",
+                           "Log archive segment size (MB)",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-archive-max-segments", "log_archive_max_segments",
+                           "Log archive segments to keep",
+                           OptionValueType::Int},
             OptionMapEntry{"colour", "log_file_colour",
                            "Colour log lines in log file",
                            OptionValueType::Present},
@@ -80,11 +112,32 @@ protected:
             OptionMapEntry{"timestamp", "timestamp",
                            "Add timestamp log file",
                            OptionValueType::Present},
+            OptionMapEntry{"timestamp-precision", "timestamp_precision",
+                           "Timestamp precision",
+                           OptionValueType::String},
             OptionMapEntry{"no-logtag-prefix", "no_logtag_prefix",
                            "Disable LogTag prefixes (systemd-journald)",
                            OptionValueType::Present},
             OptionMapEntry{"idle-exit", "idle_exit",
                            "Idle exit timer (minutes)", OptionValueType::Int},
+            OptionMapEntry{"log-queue-size", "log_queue_size",
+                           "Log writer queue size (events)",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-flush-interval", "log_flush_interval",
+                           "Log writer flush interval (milliseconds)",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-queue-overflow", "log_queue_overflow",
+                           "Log writer queue overflow policy",
+                           OptionValueType::String},
+            OptionMapEntry{"ingest-threads", "ingest_threads",
+                           "Log ingest threads",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-rate-limit", "log_rate_limit",
+                           "VPN session log rate limit (events/sec)",
+                           OptionValueType::Int},
+            OptionMapEntry{"log-rate-burst", "log_rate_burst",
+                           "VPN session log rate limit burst (events)",
+                           OptionValueType::Int},
 
             };
     }
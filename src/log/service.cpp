@@ -23,10 +23,21 @@
  * @brief  D-Bus service for log management
  */
 
+#include "config.h"
+
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <string>
 #include <functional>
+#include <tuple>
+#include <fcntl.h>
+#include <unistd.h>
 #include <json/json.h>
+#ifdef HAVE_SYSTEMD
+#include <syslog.h>
+#include <systemd/sd-journal.h>
+#endif
 
 #include "common/utils.hpp"
 #include "dbus/core.hpp"
@@ -42,26 +53,315 @@
 using namespace openvpn;
 
 
+//
+//  LogFanout class implementation
+//
+std::string LogFanout::Settings::Key(const std::string& session_path) const
+{
+    std::stringstream key;
+    key << session_path << ":" << log_level << ":" << batch_max_events
+        << ":" << batch_interval << ":" << (compact ? "c" : "v");
+    return key.str();
+}
+
+
+LogFanout::LogFanout(GDBusConnection *dbc,
+                     const std::string& session_path,
+                     const std::string& src_interf,
+                     const Settings& settings)
+    : LogSender(dbc, LogGroup::UNDEFINED, src_interf, session_path, nullptr),
+      session_path(session_path), src_interface(src_interf),
+      settings(settings)
+{
+    SetLogLevel(settings.log_level);
+    AddPathFilter(session_path);
+    batch.reserve(settings.batch_max_events);
+}
+
+
+LogFanout::~LogFanout()
+{
+    // Anything still queued is sent to the remaining receivers
+    std::lock_guard<std::mutex> lg(mtx);
+    flush_batch();
+}
+
+
+void LogFanout::AddTarget(const std::string& target)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    if (1 == ++targets[target])
+    {
+        destinations.push_back(target);
+    }
+}
+
+
+bool LogFanout::RemoveTarget(const std::string& target)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    auto it = targets.find(target);
+    if (targets.end() == it)
+    {
+        return targets.empty();
+    }
+    if (0 == --it->second)
+    {
+        // The receiver might not be interested in anything queued
+        // for the others, but it asked for it when it was queued
+        flush_batch();
+        targets.erase(it);
+        destinations.erase(std::remove(destinations.begin(),
+                                       destinations.end(), target),
+                           destinations.end());
+    }
+    return targets.empty();
+}
+
+
+void LogFanout::ProxyLog(const LogEvent& logev, const std::string& path)
+{
+    // Same filtering as LogSender::ProxyLog()
+    if (logev.empty() || !LogFilterAllow(logev)
+        || (!path.empty() && !AllowPath(path)))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lg(mtx);
+    if (0 == settings.batch_max_events && !settings.compact)
+    {
+        send("Log", logev.GetGVariantTuple());
+        return;
+    }
+
+    batch.push_back(logev);
+    if (0 == settings.batch_max_events
+        || batch.size() >= settings.batch_max_events)
+    {
+        // Compact format without batching, or a full batch
+        flush_batch();
+    }
+    else if (0 == batch_timer)
+    {
+        batch_timer = g_timeout_add(settings.batch_interval,
+                                    batch_timer_cb, this);
+    }
+}
+
+
+void LogFanout::ProxyStatusChange(const StatusEvent& status,
+                                  const std::string& path)
+{
+    if (status.empty() || !AllowPath(path))
+    {
+        return;
+    }
+
+    // Log events queued are sent before the status change
+    std::lock_guard<std::mutex> lg(mtx);
+    flush_batch();
+
+    if (!settings.compact)
+    {
+        send("StatusChange", status.GetGVariantTuple());
+        return;
+    }
+
+    CompactEvent::Writer w;
+    w.AddStatus((uint32_t) status.major, (uint32_t) status.minor,
+                status.message);
+    const std::vector<uint8_t>& buf = w.GetBuffer();
+    GVariant *ay = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                             buf.data(), buf.size(),
+                                             sizeof(uint8_t));
+    send("LogCompact", g_variant_new_tuple(&ay, 1));
+}
+
+
+void LogFanout::ReportResourceUsage(DBusResourceUsage::Report& report) const
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    uint64_t target_bytes = 0;
+    for (const auto& t : targets)
+    {
+        target_bytes += DBusResourceUsage::StringBytes(t.first);
+    }
+    report.Add("log_fanout_targets", targets.size(), target_bytes);
+
+    uint64_t batch_bytes = batch.capacity() * sizeof(LogEvent);
+    for (const auto& ev : batch)
+    {
+        batch_bytes += DBusResourceUsage::StringBytes(ev.message)
+                       - sizeof(std::string);
+    }
+    report.Add("log_batch_events", batch.size(), batch_bytes);
+}
+
+
+void LogFanout::flush_batch()
+{
+    if (batch_timer > 0)
+    {
+        g_source_remove(batch_timer);
+        batch_timer = 0;
+    }
+    if (batch.empty())
+    {
+        return;
+    }
+
+    if (settings.compact)
+    {
+        CompactEvent::Writer w;
+        for (const auto& ev : batch)
+        {
+            w.AddLog((uint32_t) ev.group, (uint32_t) ev.category,
+                     ev.session_token, ev.message, ev.fields);
+        }
+        batch.clear();
+
+        const std::vector<uint8_t>& buf = w.GetBuffer();
+        GVariant *ay = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                 buf.data(), buf.size(),
+                                                 sizeof(uint8_t));
+        send("LogCompact", g_variant_new_tuple(&ay, 1));
+        return;
+    }
+
+    GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a(uus)"));
+    for (const auto& ev : batch)
+    {
+        g_variant_builder_add(b, "(uus)",
+                              (guint32) ev.group, (guint32) ev.category,
+                              ev.message.c_str());
+    }
+    batch.clear();
+
+    send("LogBatch", GLibUtils::wrapInTuple(b));
+}
+
+
+void LogFanout::send(const std::string& signal_name, GVariant *params) const
+{
+    // The signal is built once and sent to each receiver
+    Send(destinations, src_interface, session_path, signal_name, params);
+}
+
+
+gboolean LogFanout::batch_timer_cb(gpointer this_ptr)
+{
+    LogFanout *obj = static_cast<LogFanout *>(this_ptr);
+    std::lock_guard<std::mutex> lg(obj->mtx);
+    if (g_source_get_id(g_main_current_source()) != obj->batch_timer)
+    {
+        // The batch was flushed from another thread while this timer
+        // was about to fire
+        return G_SOURCE_REMOVE;
+    }
+
+    // The timer source is removed when returning G_SOURCE_REMOVE, so
+    // flush_batch() must not remove it as well
+    obj->batch_timer = 0;
+    obj->flush_batch();
+    return G_SOURCE_REMOVE;
+}
+
+
+
+//
+//  LogFanoutRegistry class implementation
+//
+LogFanoutRegistry::LogFanoutRegistry(GDBusConnection *dbc,
+                                     const std::string& src_interf,
+                                     LoggerLookup lookup)
+    : dbuscon(dbc), src_interface(src_interf), logger_lookup(lookup)
+{
+}
+
+
+void LogFanoutRegistry::Join(const std::string& target,
+                             const std::string& session_path,
+                             const LogFanout::Settings& settings)
+{
+    std::string key = settings.Key(session_path);
+    auto it = fanouts.find(key);
+    if (fanouts.end() == it)
+    {
+        LogFanout::Ptr fo = std::make_shared<LogFanout>(dbuscon,
+                                                        session_path,
+                                                        src_interface,
+                                                        settings);
+        Logger::Ptr logger = logger_lookup(session_path);
+        if (logger)
+        {
+            logger->AddLogForward(fo.get(), key);
+        }
+        it = fanouts.insert(std::make_pair(key, fo)).first;
+    }
+    it->second->AddTarget(target);
+}
+
+
+void LogFanoutRegistry::Leave(const std::string& target,
+                              const std::string& session_path,
+                              const LogFanout::Settings& settings)
+{
+    std::string key = settings.Key(session_path);
+    auto it = fanouts.find(key);
+    if (fanouts.end() == it || !it->second->RemoveTarget(target))
+    {
+        return;
+    }
+
+    // The last receiver left; the Logger object must not use it any more
+    Logger::Ptr logger = logger_lookup(session_path);
+    if (logger)
+    {
+        logger->RemoveLogForward(key);
+    }
+    fanouts.erase(it);
+}
+
+
+size_t LogFanoutRegistry::size() const noexcept
+{
+    return fanouts.size();
+}
+
+
+void LogFanoutRegistry::ReportResourceUsage(DBusResourceUsage::Report& report) const
+{
+    for (const auto& f : fanouts)
+    {
+        report.Add("log_fanouts", 1,
+                   sizeof(LogFanout) + DBusResourceUsage::StringBytes(f.first));
+        f.second->ReportResourceUsage(report);
+    }
+}
+
+
+
 //
 //  LoggerProxy class implementation
 //
 LoggerProxy::LoggerProxy(GDBusConnection *dbc,
                          const std::string& creat,
                          std::function<void()> remove_cb,
+                         LogFanoutRegistry& fanouts,
                          const std::string& obj_path,
                          const std::string& target,
                          const std::string& src_path,
-                         const std::string& src_interf,
                          const unsigned int loglvl)
     : DBusObject(obj_path),
       DBusConnectionCreds(dbc),
-      LogSender(dbc, LogGroup::UNDEFINED, src_interf, src_path, nullptr),
       props(this),
-      creator(creat), remove_callback(remove_cb),
-      log_target(target), log_level(loglvl), session_path(src_path)
+      creator(creat), remove_callback(remove_cb), fanouts(fanouts),
+      log_target(target), session_path(src_path)
 {
+    settings.log_level = loglvl;
     props.AddBinding(new PropertyType<unsigned int>(
-            this, "log_level", "readwrite", true, log_level));
+            this, "log_level", "readwrite", true, settings.log_level));
     props.AddBinding(new PropertyType<std::string>(
             this, "target", "read", true, log_target));
     props.AddBinding(new PropertyType<std::string>(
@@ -71,22 +371,45 @@ LoggerProxy::LoggerProxy(GDBusConnection *dbc,
     introspection_xml << "<node name='" << obj_path << "'>"
             << "    <interface name='" << OpenVPN3DBus_interf_log << "'>"
             << "        <method name='Remove'/>"
-            << GetLogIntrospection()
+            << "        <method name='RemoveSession'>"
+            << "            <arg type='o' name='session_path' direction='in'/>"
+            << "        </method>"
+            << "        <method name='SetBatching'>"
+            << "            <arg type='u' name='max_events' direction='in'/>"
+            << "            <arg type='u' name='interval_ms' direction='in'/>"
+            << "        </method>"
+            << "        <method name='SetCompactFormat'>"
+            << "            <arg type='b' name='enable' direction='in'/>"
+            << "        </method>"
+            << "        <signal name='Log'>"
+            << "            <arg type='u' name='group' direction='out'/>"
+            << "            <arg type='u' name='level' direction='out'/>"
+            << "            <arg type='s' name='message' direction='out'/>"
+            << "        </signal>"
+            << "        <signal name='LogBatch'>"
+            << "            <arg type='a(uus)' name='events' direction='out'/>"
+            << "        </signal>"
+            << "        <signal name='LogCompact'>"
+            << "            <arg type='ay' name='events' direction='out'/>"
+            << "        </signal>"
             << props.GetIntrospectionXML()
+            << "        <property type='ao' name='session_paths' access='read'/>"
             << "    </interface>"
             << "</node>";
 
     ParseIntrospectionXML(introspection_xml);
 
-    SetLogLevel(6);
-    AddTargetBusName(target);
-    AddPathFilter(src_path);
+    AddSession(src_path);
     RegisterObject(dbc);
 }
 
 
 LoggerProxy::~LoggerProxy()
 {
+    while (!session_paths.empty())
+    {
+        remove_session(*session_paths.begin());
+    }
     remove_callback();
 }
 
@@ -97,9 +420,24 @@ const std::string LoggerProxy::GetObjectPath() const
 }
 
 
-const std::string LoggerProxy::GetSessionPath() const
+const std::set<std::string>& LoggerProxy::GetSessionPaths() const
+{
+    return session_paths;
+}
+
+
+const std::string& LoggerProxy::GetCreator() const
+{
+    return creator;
+}
+
+
+void LoggerProxy::AddSession(const std::string& path)
 {
-    return session_path;
+    if (session_paths.insert(path).second)
+    {
+        fanouts.Join(log_target, path, settings);
+    }
 }
 
 
@@ -115,7 +453,56 @@ void LoggerProxy::callback_method_call(GDBusConnection *conn,
     {
         check_access(sender);
 
-        if ("Remove" == meth_name)
+        if ("SetBatching" == meth_name)
+        {
+            GLibUtils::checkParams(__func__, params, "(uu)", 2);
+            LogFanout::Settings s = settings;
+            s.batch_max_events = GLibUtils::ExtractValue<uint32_t>(params, 0);
+            uint32_t interval = GLibUtils::ExtractValue<uint32_t>(params, 1);
+            if (s.batch_max_events > 0)
+            {
+                s.batch_interval = (interval > 0 ? interval : 100);
+            }
+            else
+            {
+                s.batch_interval = 0;
+            }
+            change_settings(s);
+            g_dbus_method_invocation_return_value(invoc, NULL);
+            return;
+        }
+        else if ("SetCompactFormat" == meth_name)
+        {
+            GLibUtils::checkParams(__func__, params, "(b)", 1);
+            LogFanout::Settings s = settings;
+            s.compact = GLibUtils::ExtractValue<bool>(params, 0);
+            change_settings(s);
+            g_dbus_method_invocation_return_value(invoc, NULL);
+            return;
+        }
+        else if ("RemoveSession" == meth_name)
+        {
+            GLibUtils::checkParams(__func__, params, "(o)", 1);
+            std::string path = GLibUtils::ExtractValue<std::string>(params, 0);
+            if (session_paths.end() == session_paths.find(path))
+            {
+                std::string errmsg = "Not forwarding events from " + path;
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.log",
+                                                              errmsg.c_str());
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+            remove_session(path);
+            if (session_paths.empty())
+            {
+                RemoveObject(conn);
+                delete this;
+            }
+            g_dbus_method_invocation_return_value(invoc, NULL);
+            return;
+        }
+        else if ("Remove" == meth_name)
         {
             RemoveObject(conn);
             delete this;
@@ -140,6 +527,12 @@ GVariant* LoggerProxy::callback_get_property(GDBusConnection *conn,
     {
         check_access(sender);
 
+        if ("session_paths" == property_name)
+        {
+            std::vector<std::string> paths(session_paths.begin(),
+                                           session_paths.end());
+            return GLibUtils::GVariantFromVector(paths);
+        }
         if (props.Exists(property_name))
         {
             return props.GetValue(property_name);
@@ -165,6 +558,22 @@ GVariantBuilder* LoggerProxy::callback_set_property(GDBusConnection *conn,
     try
     {
         check_access(sender);
+
+        if ("log_level" == property_name)
+        {
+            unsigned int lvl = g_variant_get_uint32(value);
+            if (lvl > 6)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                            "Invalid log level");
+                return nullptr;
+            }
+            LogFanout::Settings s = settings;
+            s.log_level = lvl;
+            change_settings(s);
+            return build_set_property_response(property_name,
+                                               (guint) settings.log_level);
+        }
     }
     catch (DBusCredentialsException& excp)
     {
@@ -186,6 +595,28 @@ void LoggerProxy::check_access(const std::string& sender) const
 }
 
 
+void LoggerProxy::remove_session(const std::string& path)
+{
+    session_paths.erase(path);
+    fanouts.Leave(log_target, path, settings);
+}
+
+
+void LoggerProxy::change_settings(const LogFanout::Settings& new_settings)
+{
+    // Move over to the LogFanout objects used by receivers with the
+    // new settings.  Anything queued is sent using the previous settings
+    // when leaving.
+    for (const auto& path : session_paths)
+    {
+        fanouts.Leave(log_target, path, settings);
+        fanouts.Join(log_target, path, new_settings);
+    }
+    settings = new_settings;
+}
+
+
+
 //
 //  LogServiceManager class implementation
 //
@@ -194,7 +625,15 @@ LogServiceManager::LogServiceManager(GDBusConnection *dbcon,
                                      LogWriter *logwr,
                                      const unsigned int log_level)
         : DBusObject(objpath), DBusConnectionCreds(dbcon),
-          dbuscon(dbcon), logwr(logwr), log_level(log_level)
+          dbuscon(dbcon), logwr(logwr),
+          shards(new LogIngestShards(0, logwr)),
+          log_level(log_level),
+          stats(std::make_shared<LogServiceStats>()),
+          fanouts(dbcon, OpenVPN3DBus_interf_backends,
+                  [self=(LogServiceManager*) this](const std::string& sesspath)
+                  {
+                      return self->lookup_session_logger(sesspath);
+                  })
 {
     // Restrict extended access in this log service from these
     // well-known bus names primarily.
@@ -220,6 +659,11 @@ LogServiceManager::LogServiceManager(GDBusConnection *dbcon,
     << "        <method name='Detach'>"
     << "            <arg type='s' name='interface' direction='in'/>"
     << "        </method>"
+    << "        <method name='OpenSessionLog'>"
+    << "            <arg type='o' name='session_path' direction='in'/>"
+    << "            <arg type='s' name='interface' direction='in'/>"
+    << "            <arg type='s' name='format' direction='out'/>"
+    << "        </method>"
     << "        <method name='GetSubscriberList'>"
     << "            <arg type='a(ssss)' name='subscribers' direction='out'/>"
     << "        </method>"
@@ -235,10 +679,66 @@ LogServiceManager::LogServiceManager(GDBusConnection *dbcon,
     << "        <property name='log_dbus_details' type='b' access='readwrite'/>"
     << "        <property name='log_prefix_logtag' type='b' access='readwrite'/>"
     << "        <property name='timestamp' type='b' access='readwrite'/>"
+    << "        <property name='log_rate_limit' type='u' access='readwrite'/>"
+    << "        <property name='log_rate_burst' type='u' access='readwrite'/>"
     << "        <property name='num_attached' type='u' access='read'/>"
     << "    </interface>"
     << "</node>";
     ParseIntrospectionXML(introspection_xml);
+
+    usage_reporter = DBusResourceUsage::Instance().AddReporter(
+        [this](DBusResourceUsage::Report& report)
+        {
+            report.Add("loggers", loggers.size(),
+                       loggers.size() * sizeof(Logger));
+            report.Add("log_proxies", logproxies.size(),
+                       logproxies.size() * sizeof(LoggerProxy));
+            fanouts.ReportResourceUsage(report);
+            report.Add("log_writer_queue", logwr->GetQueueDepth());
+        });
+}
+
+
+LogServiceManager::~LogServiceManager()
+{
+    DBusResourceUsage::Instance().RemoveReporter(usage_reporter);
+
+    // The signal subscriptions must be removed on the shard they
+    // were made on
+    for (auto& l : loggers)
+    {
+        Logger::Ptr lgr = l.second;
+        l.second.reset();
+        on_logger_shard(lgr, [&lgr]()
+                             {
+                                 lgr.reset();
+                             });
+    }
+    loggers.clear();
+}
+
+
+void LogServiceManager::SetLogRateLimit(const unsigned int rate,
+                                        const unsigned int burst)
+{
+    log_rate_limit = rate;
+    log_rate_burst = burst;
+}
+
+
+void LogServiceManager::SetSessionLogs(const std::string& target)
+{
+    session_logs = target;
+}
+
+
+void LogServiceManager::SetIngestThreads(const unsigned int threads)
+{
+    if (!loggers.empty())
+    {
+        THROW_LOGEXCEPTION("Log senders already attached");
+    }
+    shards.reset(new LogIngestShards(threads, logwr));
 }
 
 
@@ -258,9 +758,21 @@ void LogServiceManager::SetConfigFile(LogServiceConfigFile::Ptr cfgf)
             log_level = configuration->GetIntValue(opt);
             for (const auto& l : loggers)
             {
-                l.second->SetLogLevel(log_level);
+                Logger::Ptr lgr = l.second;
+                on_logger_shard(lgr, [lgr, this]()
+                                     {
+                                         lgr->SetLogLevel(log_level);
+                                     });
             }
         }
+        else if ("log-rate-limit" == opt)
+        {
+            log_rate_limit = configuration->GetIntValue(opt);
+        }
+        else if ("log-rate-burst" == opt)
+        {
+            log_rate_burst = configuration->GetIntValue(opt);
+        }
         if (logwr)
         {
             if ("service-log-dbus-details" == opt)
@@ -296,14 +808,13 @@ void LogServiceManager::callback_method_call(GDBusConnection *conn,
 
     try
     {
-        IdleCheck_UpdateTimestamp();
-
         // Extract the interface to operate on.  All D-Bus method
         // calls expects this information.
         std::string interface;
         if ("GetSubscriberList" != meth_name
             && "ProxyLogEvents" != meth_name
-            && "AssignSession" != meth_name)
+            && "AssignSession" != meth_name
+            && "OpenSessionLog" != meth_name)
         {
             GLibUtils::checkParams(__func__, params, "(s)", 1);
             interface = GLibUtils::ExtractValue<std::string>(params, 0);
@@ -332,8 +843,19 @@ void LogServiceManager::callback_method_call(GDBusConnection *conn,
                 return;
             }
 
-            loggers[tag->hash].reset(new Logger(dbuscon, logwr, tag,
-                                               sender, interface, log_level));
+            // The signals of this log sender are subscribed to and
+            // processed on its shard
+            unsigned int shard = shards->Select(sender);
+            Logger::Ptr lgr;
+            shards->Run(shard, [&]()
+                               {
+                                   lgr.reset(new Logger(dbuscon, logwr, tag,
+                                                        sender, interface,
+                                                        log_level));
+                                   lgr->SetIngestWriter(shards->GetWriter(shard));
+                                   lgr->SetServiceStats(stats);
+                               });
+            loggers[tag->hash] = lgr;
 
             std::stringstream l;
             l << "Attached: " << *tag << "  " << tag->tag;
@@ -360,6 +882,28 @@ void LogServiceManager::callback_method_call(GDBusConnection *conn,
             {
                 LogTag::Ptr tag = LogTag::create(sender, interface);
                 logger_session[sesspath] = tag->hash;
+
+                // Status changes of the session are forwarded as
+                // emitted by the session manager
+                auto lgr = loggers.find(tag->hash);
+                if (loggers.end() != lgr)
+                {
+                    try
+                    {
+                        std::string smgr = GetUniqueBusID(OpenVPN3DBus_name_sessions);
+                        Logger::Ptr l = lgr->second;
+                        on_logger_shard(l, [l, smgr, sesspath]()
+                                           {
+                                               l->SetSessionStatusSource(smgr, sesspath);
+                                           });
+                    }
+                    catch (const DBusException& excp)
+                    {
+                        logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::WARN,
+                                              "Could not look up the session manager: "
+                                              + std::string(excp.GetRawError())));
+                    }
+                }
                 logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::DEBUG,
                                       "Assigned session " + sesspath
                                       + " to " + tag->str()));
@@ -380,6 +924,63 @@ void LogServiceManager::callback_method_call(GDBusConnection *conn,
             }
 
         }
+        else if ("OpenSessionLog" == meth_name)
+        {
+            // Only the VPN client process the session was assigned to
+            // via AssignSession can open its session log
+            GLibUtils::checkParams(__func__, params, "(os)", 2);
+            std::string sesspath = GLibUtils::ExtractValue<std::string>(params, 0);
+            interface = GLibUtils::ExtractValue<std::string>(params, 1);
+
+            LogTag::Ptr tag = LogTag::create(sender, interface);
+            auto ls = logger_session.find(sesspath);
+            if (check_busname_vpn_client(sender).empty()
+                || logger_session.end() == ls || ls->second != tag->hash)
+            {
+                logwr->AddMetaCopy(meta);
+                logwr->Write("OpenSessionLog caller (" + sender + ")"
+                             + " is not the VPN client of " + sesspath);
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.log",
+                                                              "Caller is not the VPN client of the session");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+
+            std::string format;
+            int fd = open_session_log(sesspath, format);
+            if (fd < 0)
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.log",
+                                                              "Session logs are not available");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+
+            GUnixFDList *fdlist = g_unix_fd_list_new();
+            GError *error = nullptr;
+            g_unix_fd_list_append(fdlist, fd, &error);
+            close(fd);
+            if (error)
+            {
+                g_error_free(error);
+                GLibUtils::unref_fdlist(fdlist);
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.log",
+                                                              "Could not pass the session log");
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                return;
+            }
+
+            logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::DEBUG,
+                                  "Opened " + format + " session log for "
+                                  + sesspath));
+            g_dbus_method_invocation_return_value_with_unix_fd_list(invoc,
+                                  g_variant_new("(s)", format.c_str()),
+                                  fdlist);
+            GLibUtils::unref_fdlist(fdlist);
+        }
         else if ("Detach" == meth_name)
         {
             LogTag::Ptr tag = LogTag::create(sender, interface);
@@ -406,21 +1007,28 @@ void LogServiceManager::callback_method_call(GDBusConnection *conn,
             validate_sender(sender, loggers[tag->hash]->GetBusName());
 
             // Do a reverse lookup in logger_session to retrieve
-            // the key to delete from the logger_sesion index
-            auto it = std::find_if(logger_session.begin(),
-                                  logger_session.end(),
-                                  [tag](const auto& e)
-                                  {
-                                      return e.second == tag->hash;
-                                  });
-            if (logger_session.end() != it)
+            // the keys to delete from the logger_sesion index.  A VPN
+            // client process may host several sessions.
+            for (auto it = logger_session.begin(); it != logger_session.end();)
             {
-                logger_session.erase(it->first);
+                if (it->second == tag->hash)
+                {
+                    it = logger_session.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
             }
 
 
             // Unsubscribe from signals from a D-Bus service/client
+            Logger::Ptr lgr = loggers[tag->hash];
             loggers.erase(tag->hash);
+            on_logger_shard(lgr, [&lgr]()
+                                 {
+                                     lgr.reset();
+                                 });
             std::stringstream l;
             l << "Detached: " << *tag << "  " << tag->tag;
 
@@ -503,8 +1111,6 @@ GVariant* LogServiceManager::callback_get_property(GDBusConnection *conn,
 {
     try
     {
-        IdleCheck_UpdateTimestamp();
-
         if ("version" == property_name)
         {
             return g_variant_new_string(package_version());
@@ -547,10 +1153,61 @@ GVariant* LogServiceManager::callback_get_property(GDBusConnection *conn,
         {
             return g_variant_new_boolean(logwr->TimestampEnabled());
         }
+        else if ("log_rate_limit" == property_name)
+        {
+            return g_variant_new_uint32(log_rate_limit);
+        }
+        else if ("log_rate_burst" == property_name)
+        {
+            return g_variant_new_uint32(log_rate_burst);
+        }
         else if ("num_attached" == property_name)
         {
             return g_variant_new_uint32(loggers.size());
         }
+        else if ("events_received" == property_name)
+        {
+            return g_variant_new_uint64(stats->received);
+        }
+        else if ("events_written" == property_name)
+        {
+            return g_variant_new_uint64(stats->written);
+        }
+        else if ("events_dropped" == property_name)
+        {
+            return g_variant_new_uint64(logwr->GetDroppedCount());
+        }
+        else if ("queue_depth" == property_name)
+        {
+            return g_variant_new_uint32(logwr->GetQueueDepth());
+        }
+        else if ("latency_buckets" == property_name)
+        {
+            return GLibUtils::Marshal(LogLatencyHistogram::BucketBounds());
+        }
+        else if ("write_latency" == property_name)
+        {
+            return GLibUtils::Marshal(stats->write_latency.Get());
+        }
+        else if ("queue_latency" == property_name)
+        {
+            return GLibUtils::Marshal(logwr->GetQueueLatency());
+        }
+        else if ("sender_stats" == property_name)
+        {
+            std::vector<std::tuple<std::string, std::string, std::string,
+                                   uint64_t, double>> senders;
+            for (const auto& l : loggers)
+            {
+                LogEventCounter& cnt = l.second->GetEventCounter();
+                senders.push_back(std::make_tuple(std::to_string(l.first),
+                                                  l.second->GetBusName(),
+                                                  l.second->GetInterface(),
+                                                  cnt.GetCount(),
+                                                  cnt.GetRate()));
+            }
+            return GLibUtils::Marshal(senders);
+        }
     }
     catch (...)
     {
@@ -579,7 +1236,6 @@ GVariantBuilder* LogServiceManager::callback_set_property(GDBusConnection *conn,
 
     try
     {
-        IdleCheck_UpdateTimestamp();
         GVariantBuilder *ret = nullptr;
 
         if ("log_level" == property_name)
@@ -596,7 +1252,11 @@ GVariantBuilder* LogServiceManager::callback_set_property(GDBusConnection *conn,
             log_level = new_log_level;
             for (const auto& l : loggers)
             {
-                l.second->SetLogLevel(log_level);
+                Logger::Ptr lgr = l.second;
+                on_logger_shard(lgr, [lgr, this]()
+                                     {
+                                         lgr->SetLogLevel(log_level);
+                                     });
             }
             std::stringstream l;
             l << "Log level changed to " << std::to_string(log_level);
@@ -702,10 +1362,35 @@ GVariantBuilder* LogServiceManager::callback_set_property(GDBusConnection *conn,
             ret = build_set_property_response(property_name,
                                                timestamp);
         }
+        else if ("log_rate_limit" == property_name
+                 || "log_rate_burst" == property_name)
+        {
+            unsigned int newval = g_variant_get_uint32(value);
+            if ("log_rate_limit" == property_name)
+            {
+                log_rate_limit = newval;
+            }
+            else
+            {
+                log_rate_burst = newval;
+            }
+
+            std::stringstream l;
+            l << "Log rate limit changed to " << log_rate_limit
+              << " events/sec, burst " << log_rate_burst << " events. "
+              << "Applies to new VPN sessions";
+            logwr->AddMetaCopy(meta);
+            logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::VERB1,
+                                  l.str()));
+            ret = build_set_property_response(property_name,
+                                               (guint32) newval);
+        }
 
         if (configuration)
         {
             configuration->SetValue("log-level", (int) log_level);
+            configuration->SetValue("log-rate-limit", (int) log_rate_limit);
+            configuration->SetValue("log-rate-burst", (int) log_rate_burst);
             if (logwr)
             {
                 configuration->SetValue("service-log-dbus-details",
@@ -814,6 +1499,60 @@ std::string LogServiceManager::check_busname_vpn_client(const std::string& chk_b
 }
 
 
+int LogServiceManager::open_session_log(const std::string& sesspath,
+                                        std::string& format) const
+{
+    if (session_logs.empty())
+    {
+        return -1;
+    }
+
+#ifdef HAVE_SYSTEMD
+    if ("journald" == session_logs)
+    {
+        int fd = sd_journal_stream_fd("openvpn3-session", LOG_INFO, 1);
+        if (fd < 0)
+        {
+            logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::ERROR,
+                                  "Could not open a journald stream: "
+                                  + std::string(strerror(-fd))));
+            return -1;
+        }
+        format = "journal";
+        return fd;
+    }
+#endif // HAVE_SYSTEMD
+
+    // Session object paths only use [A-Za-z0-9_], but never trust
+    // a path component coming from the bus
+    std::string name = sesspath.substr(sesspath.rfind('/') + 1);
+    name.erase(std::remove_if(name.begin(), name.end(),
+                              [](const char c)
+                              {
+                                  return !isalnum(c) && '_' != c;
+                              }),
+               name.end());
+    if (name.empty())
+    {
+        return -1;
+    }
+
+    std::string fname = session_logs + "/" + name + ".log";
+    int fd = open(fname.c_str(),
+                  O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC | O_NOFOLLOW,
+                  0640);
+    if (fd < 0)
+    {
+        logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::ERROR,
+                              "Could not open session log " + fname + ": "
+                              + std::string(strerror(errno))));
+        return -1;
+    }
+    format = "text";
+    return fd;
+}
+
+
 std::string LogServiceManager::add_log_proxy(GVariant *params, const std::string& sender)
 {
     GLibUtils::checkParams(__func__, params, "(so)", 2);
@@ -835,6 +1574,28 @@ std::string LogServiceManager::add_log_proxy(GVariant *params, const std::string
     }
 
 
+    // A target attaching to more VPN sessions reuses its proxy, which
+    // then filters on all the session paths
+    auto existing = logproxies.find(target);
+    if (logproxies.end() != existing)
+    {
+        LoggerProxy *logprx = existing->second;
+        if (logprx->GetCreator() != sender)
+        {
+            THROW_DBUSEXCEPTION("LogServiceManager",
+                                "Log events to " + target
+                                + " are already forwarded by another caller");
+        }
+        logprx->AddSession(session_path);
+
+        logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::VERB1,
+                              "Added session to log proxy by " + sender
+                              + " - session: " + session_path
+                              + ", target: " + target + ", tag: "
+                              + std::to_string(log_tag)));
+        return logprx->GetObjectPath();
+    }
+
     std::string path = generate_path_uuid(OpenVPN3DBus_rootp_log + "/proxy", 'l');
 
 
@@ -842,18 +1603,18 @@ std::string LogServiceManager::add_log_proxy(GVariant *params, const std::string
                     {
                         self->remove_log_proxy(target);
                     };
+
+    // By default everything the VPN backend sends is forwarded; the
+    // receiver does its own filtering.  The LoggerProxy enables the log
+    // forwarding in the main Logger object for the client session via
+    // the LogFanout it joins.
     LoggerProxy* logprx = new LoggerProxy(GetConnection(),
-                                         sender, rm_callback,
-                                         path, target,
-                                         session_path, OpenVPN3DBus_interf_backends,
-                                         log_level);
+                                         sender, rm_callback, fanouts,
+                                         path, target, session_path, 6);
 
     IdleCheck_RefInc();
     logproxies[target] = logprx;
 
-    // Enable log forwarding in main Logger object for client session
-    loggers[log_tag]->AddLogForward(logprx, target);
-
     logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::VERB1,
                           "Added new log proxy by " + sender
                           + " - session: " + session_path
@@ -862,56 +1623,36 @@ std::string LogServiceManager::add_log_proxy(GVariant *params, const std::string
     return logproxies[target]->GetObjectPath();
 }
 
-void LogServiceManager::remove_log_proxy(const std::string target)
-{
-    // The log forwarding must be removed in the main Logger object.
-    // The Logger objects are indexed by its log tag,
-    // which can be retrieved by the index lookup in logger_session, but
-    // this index is using session path as the key.  The session path is
-    // available in the LoggerProxy::GetSessionPath(), which is indexed
-    // by the log listener's target address.
-    //
-    // In reverse, that means:
-    //
-    //   1.  Get the session_path from LoggerProxy using the _target_ address
-    //       which is this methods only input argument.
-    //   2.  Retrieve the log_tag from the session path
-    //       (using the logger_session index)
-    //   3.  Execute the proper Logger::RemoveLogForward(), based on the
-    //       log_tag
-    //
-    std::string session_path{"(not found)"};
-    size_t log_tag{0};
-    try
-    {
-        session_path = logproxies.at(target)->GetSessionPath();
-        log_tag = logger_session.at(session_path);
-        loggers.at(log_tag)->RemoveLogForward(target);
-#if OPENVPN_DEBUG
-        logwr->Write(LogGroup::LOGGER, LogCategory::DEBUG,
-                     std::string("remove_log_proxy: ")
-                     + "target=" + target + ", "
-                     + "session_path=" + session_path + ", "
-                     + "log_tag=" + std::to_string(log_tag));
-#endif
 
-    }
-    catch (const std::out_of_range&)
+Logger::Ptr LogServiceManager::lookup_session_logger(const std::string& session_path) const
+{
+    // The Logger objects are indexed by its log tag, which can be
+    // retrieved by the index lookup in logger_session, using the
+    // session path as the key.  If the log tag is not found, the VPN
+    // client backend process has already detached itself from the
+    // log service.
+    auto ls = logger_session.find(session_path);
+    if (logger_session.end() == ls)
     {
-        // If the log_tag was not found, the VPN client backend process
-        // has already detached itself from the lgo service.
-        if (log_tag > 0)
-        {
-            logwr->Write(LogGroup::LOGGER, LogCategory::WARN,
-                         std::string("Could not find session/logger for RemoveLogForward() call: ")
-                         + "target=" + target + ", "
-                         + "session_path=" + session_path + ", "
-                         + "log_tag=" + std::to_string(log_tag));
-        }
+        return nullptr;
     }
+    auto l = loggers.find(ls->second);
+    return (loggers.end() != l ? l->second : nullptr);
+}
+
 
-    // With the log forwarding removed in the Logger object, we can
-    // erase the LoggerProxy object.
+void LogServiceManager::on_logger_shard(const Logger::Ptr& lgr,
+                                        std::function<void()> fn)
+{
+    shards->Run(shards->Select(lgr->GetBusName()), std::move(fn));
+}
+
+
+void LogServiceManager::remove_log_proxy(const std::string target)
+{
+    // The LoggerProxy object has already left the LogFanout objects
+    // of each of its VPN sessions before calling this, so only the
+    // index needs to be cleaned up here
     logproxies.erase(target);
     logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::VERB1,
                           "Removed log proxy: " + target));
@@ -939,6 +1680,26 @@ void LogService::SetConfigFile(LogServiceConfigFile::Ptr cfgf)
 }
 
 
+void LogService::SetLogRateLimit(const unsigned int rate,
+                                 const unsigned int burst)
+{
+    log_rate_limit = rate;
+    log_rate_burst = burst;
+}
+
+
+void LogService::SetSessionLogs(const std::string& target)
+{
+    session_logs = target;
+}
+
+
+void LogService::SetIngestThreads(const unsigned int threads)
+{
+    ingest_threads = threads;
+}
+
+
 void LogService::callback_bus_acquired()
 {
     // Once the D-Bus name is registered and acknowledge,
@@ -947,6 +1708,9 @@ void LogService::callback_bus_acquired()
     logmgr.reset(new LogServiceManager(GetConnection(),
                                        OpenVPN3DBus_rootp_log,
                                        logwr, log_level));
+    logmgr->SetLogRateLimit(log_rate_limit, log_rate_burst);
+    logmgr->SetSessionLogs(session_logs);
+    logmgr->SetIngestThreads(ingest_threads);
     if (configuration)
     {
         logmgr->SetConfigFile(configuration);
@@ -966,6 +1730,13 @@ void LogService::callback_name_acquired(GDBusConnection *conn,
 }
 
 
+void LogService::callback_startup_complete(const std::string& timeline)
+{
+    logwr->Write(LogEvent(LogGroup::LOGGER, LogCategory::INFO,
+                          "Start-up completed: " + timeline));
+}
+
+
 void LogService::callback_name_lost(GDBusConnection *conn, std::string busname)
 {
     THROW_DBUSEXCEPTION("LogServiceManager",
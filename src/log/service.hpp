@@ -27,24 +27,209 @@
 #pragma once
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 
 #include "dbus/core.hpp"
 #include "dbus/connection-creds.hpp"
 #include "dbus/object-property.hpp"
+#include "dbus/resource-usage.hpp"
 #include "log/dbus-log.hpp"
+#include "log/ingest-shards.hpp"
+#include "log/log-compact.hpp"
+#include "log/logger.hpp"
+#include "log/logstats.hpp"
 #include "log/logtag.hpp"
 #include "service-configfile.hpp"
 
 
 /**
- *  A LoggerProxy is at its core an extended LogSender class which is
- *  configured at runtime to be called via a Logger object.
- *
- *  A Logger object is created when any service is attaching itself to the
- *  net.openvpn.v3.log service, telling the log service to collect its log
- *  events.
+ *  A LogFanout emits the forwarded Log and StatusChange events of a single
+ *  VPN session.  It is registered as a log forwarder in the Logger object
+ *  of the VPN session and is shared by all receivers of that session using
+ *  the same log level, batching and compact format settings.  Each event
+ *  is filtered, batched and encoded once and then sent to each receiver on
+ *  the destination list.
  *
+ *  The signals are sent with the D-Bus object path and interface of the
+ *  VPN session.  They are not broadcast, as only the receivers granted
+ *  access to the session may see its log events.
+ */
+class LogFanout : public LogSender
+{
+public:
+    using Ptr = std::shared_ptr<LogFanout>;
+
+    /**
+     *  Forwarding settings requested by a receiver
+     */
+    struct Settings
+    {
+        unsigned int log_level = 6;
+        unsigned int batch_max_events = 0;
+        unsigned int batch_interval = 0;
+        bool compact = false;
+
+        /**
+         *  Unique key of the LogFanout to use for a VPN session with
+         *  these settings
+         *
+         * @param session_path  std::string with the D-Bus object path of
+         *                      the VPN session
+         */
+        std::string Key(const std::string& session_path) const;
+    };
+
+
+    /**
+     * @param dbc           GDBusConnection pointer to the current D-Bus
+     *                      connection
+     * @param session_path  std::string of the session path belonging to
+     *                      the VPN session
+     * @param src_interf    std::string of the interface of the
+     *                      Log/StatusChange signals
+     * @param settings      Settings used by all the receivers
+     */
+    LogFanout(GDBusConnection *dbc,
+              const std::string& session_path,
+              const std::string& src_interf,
+              const Settings& settings);
+    ~LogFanout();
+
+
+    /**
+     *  Adds a receiver to the destination list.  Each call must be matched
+     *  by a call to RemoveTarget().
+     *
+     * @param target  std::string with the D-Bus unique bus name of the
+     *                receiver
+     */
+    void AddTarget(const std::string& target);
+
+    /**
+     *  Releases a receiver added by AddTarget()
+     *
+     * @param target  std::string with the D-Bus unique bus name of the
+     *                receiver
+     *
+     * @return Returns true if there are no receivers left
+     */
+    bool RemoveTarget(const std::string& target);
+
+
+    /**
+     *  Forwards a log event to all receivers.  If batching is enabled the
+     *  log event is queued and sent later on together with other queued
+     *  log events in a single LogBatch signal.  With the compact format,
+     *  LogCompact signals are sent instead of Log and LogBatch signals.
+     *
+     * @param logev  LogEvent to forward
+     * @param path   std::string with the D-Bus object path of the sender
+     */
+    void ProxyLog(const LogEvent& logev, const std::string& path = "") override;
+
+    /**
+     *  Forwards a status change event to all receivers.  Queued log
+     *  events are sent first, to preserve the ordering of the events.
+     *
+     * @param status  StatusEvent to forward
+     * @param path    std::string with the D-Bus object path of the sender
+     */
+    void ProxyStatusChange(const StatusEvent& status,
+                           const std::string& path) override;
+
+    /**
+     *  Adds the receivers and the queued log events of this LogFanout to
+     *  a resource usage report
+     *
+     * @param report  DBusResourceUsage::Report to add to
+     */
+    void ReportResourceUsage(DBusResourceUsage::Report& report) const;
+
+
+private:
+    const std::string session_path;
+    const std::string src_interface;
+    const Settings settings;
+    /// Log events may be forwarded from a LogIngestShards thread while
+    /// the receivers are changed and the batch timer runs in the main loop
+    mutable std::mutex mtx;
+    std::map<std::string, unsigned int> targets = {};
+    std::vector<std::string> destinations = {};
+    std::vector<LogEvent> batch = {};
+    guint batch_timer = 0;
+
+    void flush_batch();  ///< Caller must hold mtx
+    void send(const std::string& signal_name, GVariant *params) const;
+    static gboolean batch_timer_cb(gpointer this_ptr);
+};
+
+
+
+/**
+ *  Keeps track of the LogFanout objects of all VPN sessions.  A LogFanout
+ *  is created when the first receiver joins it and is removed from the
+ *  Logger object of the VPN session when the last receiver leaves it.
+ */
+class LogFanoutRegistry
+{
+public:
+    /**
+     *  Used to look up the Logger object of a VPN session.  Returns an
+     *  empty pointer if the VPN session is not known (any more).
+     */
+    using LoggerLookup = std::function<Logger::Ptr(const std::string& session_path)>;
+
+    LogFanoutRegistry(GDBusConnection *dbc,
+                      const std::string& src_interf,
+                      LoggerLookup lookup);
+
+    /**
+     *  Start forwarding the events of a VPN session to a receiver
+     *
+     * @param target        std::string with the D-Bus unique bus name of
+     *                      the receiver
+     * @param session_path  std::string with the D-Bus object path of the
+     *                      VPN session
+     * @param settings      LogFanout::Settings requested by the receiver
+     */
+    void Join(const std::string& target,
+              const std::string& session_path,
+              const LogFanout::Settings& settings);
+
+    /**
+     *  Stop forwarding the events of a VPN session to a receiver.  The
+     *  arguments must be the same as given to Join().
+     */
+    void Leave(const std::string& target,
+               const std::string& session_path,
+               const LogFanout::Settings& settings);
+
+    /**
+     * @return Returns the number of LogFanout objects in use
+     */
+    size_t size() const noexcept;
+
+    /**
+     *  Adds all LogFanout objects to a resource usage report
+     *
+     * @param report  DBusResourceUsage::Report to add to
+     */
+    void ReportResourceUsage(DBusResourceUsage::Report& report) const;
+
+private:
+    GDBusConnection *dbuscon = nullptr;
+    std::string src_interface;
+    LoggerLookup logger_lookup;
+    std::map<std::string, LogFanout::Ptr> fanouts = {};
+};
+
+
+
+/**
  *  The LoggerProxy is used by other applications ("clients") who wants to
  *  see a copy of the log events.  When a D-Bus application calls the
  *  ProxyLogEvents method, a LoggerProxy object is initiated for this client
@@ -53,10 +238,16 @@
  *
  *  A LoggerProxy object can only be configured to forward Log and StatusChange
  *  events from backend VPN client services.
+ *
+ *  All VPN sessions a target attaches to share the same LoggerProxy.  The
+ *  LoggerProxy itself only holds the settings of its receiver; the events
+ *  are sent by the LogFanout objects it has joined, one per VPN session.
+ *  Receivers of the same VPN session using the same settings share the
+ *  LogFanout.  The forwarded signals carry the D-Bus object path of the
+ *  VPN session they belong to.
  */
 class LoggerProxy : public DBusObject,
-                    public DBusConnectionCreds,
-                    public LogSender
+                    public DBusConnectionCreds
 {
 public:
     /**
@@ -66,19 +257,19 @@ public:
      * @param dbc        GDBusConnection pointer to the current D-Bus connection
      * @param creat      std::string of the D-Bus unique bus name requesting this
      * @param remove_cb  std::function callback run when this object is deleted
+     * @param fanouts    LogFanoutRegistry sending the events to the target
      * @param obj_path   std::string with the D-Bus object path of this proxy
-     * @param target     std::string of the target where Log/StatusEvent signals will be sent // FIXME: Isn't this the same as creator?
+     * @param target     std::string of the target where Log/StatusEvent signals will be sent
      * @param src_path   std::string of the session path belonging to the VPN session
-     * @param src_interf std::string of the interface of the Log/StatusChange signals
      * @param loglvl     unsigned int of the initial log level for to forward
      */
     LoggerProxy(GDBusConnection *dbc,
                 const std::string& creat,
                 std::function<void()> remove_cb,
+                LogFanoutRegistry& fanouts,
                 const std::string& obj_path,
                 const std::string& target,
                 const std::string& src_path,
-                const std::string& src_interf,
                 const unsigned int loglvl);
     ~LoggerProxy();
 
@@ -88,9 +279,24 @@ public:
     const std::string GetObjectPath() const;
 
     /**
-     * Retrieve the D-Bus object path of the VPN session this proxy is tied to
+     * Retrieve the D-Bus object paths of the VPN sessions this proxy is
+     * forwarding events from
      */
-    const std::string GetSessionPath() const;
+    const std::set<std::string>& GetSessionPaths() const;
+
+    /**
+     * Retrieve the D-Bus unique bus name of the caller which created
+     * this proxy
+     */
+    const std::string& GetCreator() const;
+
+    /**
+     *  Forward the events of one more VPN session to the same target
+     *
+     * @param session_path  std::string with the D-Bus object path of the
+     *                      VPN session
+     */
+    void AddSession(const std::string& session_path);
 
 
     void callback_method_call(GDBusConnection *conn,
@@ -121,11 +327,15 @@ private:
     PropertyCollection props;
     std::string creator = {};
     std::function<void()> remove_callback;
+    LogFanoutRegistry& fanouts;
     std::string log_target;
-    unsigned int log_level = 6;
+    LogFanout::Settings settings = {};
     std::string session_path = {};
+    std::set<std::string> session_paths = {};
 
     void check_access(const std::string& sender) const;
+    void remove_session(const std::string& path);
+    void change_settings(const LogFanout::Settings& new_settings);
 };
 
 using LoggerProxyList = std::map<std::string, LoggerProxy*>;
@@ -159,7 +369,7 @@ public:
                       LogWriter *logwr,
                       const unsigned int log_level);
 
-    ~LogServiceManager() = default;
+    ~LogServiceManager();
 
 
     /**
@@ -172,6 +382,41 @@ public:
     void SetConfigFile(LogServiceConfigFile::Ptr cfgf);
 
 
+    /**
+     *  Sets the log rate limit VPN backend processes should use.  This is
+     *  not enforced by the log service itself, but read by the backend
+     *  processes via the log_rate_limit and log_rate_burst properties.
+     *
+     * @param rate   Average number of log events per second.  0 disables
+     *               rate limiting.
+     * @param burst  Number of log events allowed in a burst
+     */
+    void SetLogRateLimit(const unsigned int rate, const unsigned int burst);
+
+
+    /**
+     *  Enables the OpenSessionLog method, handing VPN backend processes
+     *  a file descriptor they can write their log events to directly.
+     *
+     * @param target  std::string with a directory where a log file is
+     *                created per session, or "journald" to hand out
+     *                systemd-journald streams.  An empty string disables
+     *                the direct session logs.
+     */
+    void SetSessionLogs(const std::string& target);
+
+
+    /**
+     *  Receives and processes the Log signals of the attached log senders
+     *  on worker threads instead of the main loop, see LogIngestShards.
+     *  Must be called before any log sender has attached.
+     *
+     * @param threads  Number of worker threads.  0 processes everything
+     *                 in the main loop.
+     */
+    void SetIngestThreads(const unsigned int threads);
+
+
     void callback_method_call(GDBusConnection *conn,
                               const std::string sender,
                               const std::string obj_path,
@@ -199,12 +444,19 @@ public:
 private:
     GDBusConnection *dbuscon = nullptr;
     LogWriter *logwr = nullptr;
+    LogIngestShards::Ptr shards;
     std::map<size_t, Logger::Ptr> loggers = {};
     unsigned int log_level;
+    unsigned int log_rate_limit = 0;
+    unsigned int log_rate_burst = 0;
+    std::string session_logs;
+    LogServiceStats::Ptr stats;
     LogServiceConfigFile::Ptr configuration = nullptr;
     std::vector<std::string> allow_list;
     LoggerProxyList logproxies;
     LoggerSessionsList logger_session = {};
+    LogFanoutRegistry fanouts;
+    DBusResourceUsage::ReporterId usage_reporter = 0;
 
     /**
      *  Validate that the sender is on a list of allowed senders.  If the
@@ -218,9 +470,18 @@ private:
 
     std::string check_busname_vpn_client(const std::string& chk_busn) const;
 
+    int open_session_log(const std::string& sesspath, std::string& format) const;
+
     std::string add_log_proxy(GVariant *params, const std::string& sender);
+    Logger::Ptr lookup_session_logger(const std::string& session_path) const;
     void remove_log_proxy(const std::string target);
 
+    /**
+     *  Runs a function on the LogIngestShards shard of a Logger.  Apart
+     *  from adding and removing log forwards, Logger objects are only
+     *  created, changed and deleted on their own shard.
+     */
+    void on_logger_shard(const Logger::Ptr& lgr, std::function<void()> fn);
 };
 
 
@@ -256,6 +517,31 @@ public:
      */
     void SetConfigFile(LogServiceConfigFile::Ptr cfgf);
 
+    /**
+     *  Preserves the --log-rate-limit and --log-rate-burst settings,
+     *  which will be used when creating the D-Bus service object
+     *
+     * @param rate   Average number of log events per second
+     * @param burst  Number of log events allowed in a burst
+     */
+    void SetLogRateLimit(const unsigned int rate, const unsigned int burst);
+
+    /**
+     *  Preserves the --session-logs setting, which will be used when
+     *  creating the D-Bus service object
+     *
+     * @param target  std::string with a directory or "journald"
+     */
+    void SetSessionLogs(const std::string& target);
+
+    /**
+     *  Preserves the --ingest-threads setting, which will be used when
+     *  creating the D-Bus service object
+     *
+     * @param threads  Number of log ingest worker threads
+     */
+    void SetIngestThreads(const unsigned int threads);
+
     /**
      *  This callback is called when the service was successfully registered
      *  on the D-Bus.
@@ -274,6 +560,13 @@ public:
      */
     void callback_name_acquired(GDBusConnection *conn, std::string busname);
 
+    /**
+     *  Logs the start-up timeline of the log service
+     *
+     * @param timeline  std::string with the StartupTiming summary
+     */
+    void callback_startup_complete(const std::string& timeline);
+
 
     /**
      *  This is called each time the well-known bus name is removed from the
@@ -289,5 +582,9 @@ private:
     LogServiceManager::Ptr logmgr;
     LogWriter *logwr;
     unsigned int log_level;
+    unsigned int log_rate_limit = 0;
+    unsigned int log_rate_burst = 0;
+    std::string session_logs;
+    unsigned int ingest_threads = 0;
     LogServiceConfigFile::Ptr configuration = nullptr;
 };
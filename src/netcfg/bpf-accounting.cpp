@@ -0,0 +1,587 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   bpf-accounting.cpp
+ *
+ * @brief  Implementation of NetCfg::BpfAccounting
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/pkt_cls.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "netcfg-exception.hpp"
+#include "rtnl-request.hpp"
+#include "bpf-accounting.hpp"
+
+
+//  Layout of the counter map.  The index of a counter is
+//  (direction * 2 + family) * 16 + protocol * 4 + destination class.
+static const unsigned int n_counters = 64;
+static const char *dir_names[] = {"in", "out"};
+static const char *family_names[] = {"ipv4", "ipv6"};
+static const char *proto_names[] = {"tcp", "udp", "icmp", "other"};
+static const char *class_names[] = {"private", "link-local", "multicast", "global"};
+
+struct counter_value
+{
+    uint64_t bytes;
+    uint64_t packets;
+};
+
+
+//  Priority and handle of the tc filters
+static const uint16_t filter_prio = 49152;
+static const uint32_t filter_handle = 1;
+
+
+static int sys_bpf(const int cmd, union bpf_attr& attr)
+{
+    return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+
+/**
+ *  Builds a BPF program, resolving the forward jumps to labels
+ */
+class BpfProgram
+{
+public:
+    void mov_reg(uint8_t dst, uint8_t src)
+    {
+        emit(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0);
+    }
+
+    void mov_imm(uint8_t dst, int32_t imm)
+    {
+        emit(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm);
+    }
+
+    void alu_imm(uint8_t op, uint8_t dst, int32_t imm)
+    {
+        emit(BPF_ALU64 | op | BPF_K, dst, 0, 0, imm);
+    }
+
+    void alu_reg(uint8_t op, uint8_t dst, uint8_t src)
+    {
+        emit(BPF_ALU64 | op | BPF_X, dst, src, 0, 0);
+    }
+
+    void load(uint8_t size, uint8_t dst, uint8_t src, int16_t off)
+    {
+        emit(BPF_LDX | size | BPF_MEM, dst, src, off, 0);
+    }
+
+    void store(uint8_t size, uint8_t dst, int16_t off, uint8_t src)
+    {
+        emit(BPF_STX | size | BPF_MEM, dst, src, off, 0);
+    }
+
+    void atomic_add64(uint8_t dst, int16_t off, uint8_t src)
+    {
+        emit(BPF_STX | BPF_DW | BPF_ATOMIC, dst, src, off, BPF_ADD);
+    }
+
+    void load_map_fd(uint8_t dst, int fd)
+    {
+        emit(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, fd);
+        emit(0, 0, 0, 0, 0);
+    }
+
+    void jump_imm(uint8_t op, uint8_t dst, int32_t imm, const std::string& label)
+    {
+        fixups.push_back({insns.size(), label});
+        emit(BPF_JMP | op | BPF_K, dst, 0, 0, imm);
+    }
+
+    void jump(const std::string& label)
+    {
+        fixups.push_back({insns.size(), label});
+        emit(BPF_JMP | BPF_JA, 0, 0, 0, 0);
+    }
+
+    void call(int32_t func)
+    {
+        emit(BPF_JMP | BPF_CALL, 0, 0, 0, func);
+    }
+
+    void exit()
+    {
+        emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    }
+
+    void label(const std::string& name)
+    {
+        labels[name] = insns.size();
+    }
+
+
+    /**
+     * @return Returns the instructions, with all jumps resolved
+     */
+    const std::vector<struct bpf_insn>& Finish()
+    {
+        for (const auto& f : fixups)
+        {
+            auto l = labels.find(f.second);
+            if (labels.end() == l)
+            {
+                throw NetCfgException("BPF program label not found: " + f.second);
+            }
+            insns[f.first].off = l->second - f.first - 1;
+        }
+        fixups.clear();
+        return insns;
+    }
+
+
+private:
+    std::vector<struct bpf_insn> insns;
+    std::map<std::string, size_t> labels;
+    std::vector<std::pair<size_t, std::string>> fixups;
+
+    void emit(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+    {
+        struct bpf_insn i = {};
+        i.code = code;
+        i.dst_reg = dst;
+        i.src_reg = src;
+        i.off = off;
+        i.imm = imm;
+        insns.push_back(i);
+    }
+};
+
+
+/**
+ *  Emits the classification of the IP header stored on the stack
+ *  at fp-64, leaving the counter index at fp-4
+ *
+ * @param p       BpfProgram to add the instructions to
+ * @param family  0 for IPv4, 1 for IPv6
+ * @param base    Index of the first counter of the direction and family
+ */
+static void emit_classify(BpfProgram& p, const int family, const int32_t base)
+{
+    const std::string pfx = (0 == family ? "v4_" : "v6_");
+    const int16_t hdr = -64;
+
+    // r0 = bpf_skb_load_bytes_relative(skb, 0, fp-64, hdrlen, BPF_HDR_START_NET)
+    p.mov_reg(BPF_REG_1, BPF_REG_6);
+    p.mov_imm(BPF_REG_2, 0);
+    p.mov_reg(BPF_REG_3, BPF_REG_10);
+    p.alu_imm(BPF_ADD, BPF_REG_3, hdr);
+    p.mov_imm(BPF_REG_4, (0 == family ? 20 : 40));
+    p.mov_imm(BPF_REG_5, BPF_HDR_START_NET);
+    p.call(BPF_FUNC_skb_load_bytes_relative);
+    p.mov_imm(BPF_REG_3, 3);
+    p.mov_imm(BPF_REG_4, 3);
+    p.jump_imm(BPF_JNE, BPF_REG_0, 0, pfx + "index");
+
+    // r3 = protocol class
+    p.load(BPF_B, BPF_REG_2, BPF_REG_10, hdr + (0 == family ? 9 : 6));
+    p.mov_imm(BPF_REG_3, 0);
+    p.jump_imm(BPF_JEQ, BPF_REG_2, IPPROTO_TCP, pfx + "proto_done");
+    p.mov_imm(BPF_REG_3, 1);
+    p.jump_imm(BPF_JEQ, BPF_REG_2, IPPROTO_UDP, pfx + "proto_done");
+    p.mov_imm(BPF_REG_3, 2);
+    p.jump_imm(BPF_JEQ, BPF_REG_2,
+               (0 == family ? int(IPPROTO_ICMP) : int(IPPROTO_ICMPV6)), pfx + "proto_done");
+    p.mov_imm(BPF_REG_3, 3);
+    p.label(pfx + "proto_done");
+
+    // r4 = destination class, from the first two bytes of the address
+    p.load(BPF_B, BPF_REG_2, BPF_REG_10, hdr + (0 == family ? 16 : 24));
+    p.load(BPF_B, BPF_REG_5, BPF_REG_10, hdr + (0 == family ? 17 : 25));
+    p.mov_imm(BPF_REG_4, 0);
+    if (0 == family)
+    {
+        // 10.0.0.0/8, 192.168.0.0/16, 172.16.0.0/12 and 100.64.0.0/10
+        p.jump_imm(BPF_JEQ, BPF_REG_2, 10, pfx + "index");
+        p.mov_reg(BPF_REG_1, BPF_REG_5);
+        p.jump_imm(BPF_JNE, BPF_REG_2, 192, pfx + "not192");
+        p.jump_imm(BPF_JEQ, BPF_REG_1, 168, pfx + "index");
+        p.label(pfx + "not192");
+        p.jump_imm(BPF_JNE, BPF_REG_2, 172, pfx + "not172");
+        p.alu_imm(BPF_AND, BPF_REG_1, 0xf0);
+        p.jump_imm(BPF_JEQ, BPF_REG_1, 16, pfx + "index");
+        p.label(pfx + "not172");
+        p.mov_reg(BPF_REG_1, BPF_REG_5);
+        p.jump_imm(BPF_JNE, BPF_REG_2, 100, pfx + "not100");
+        p.alu_imm(BPF_AND, BPF_REG_1, 0xc0);
+        p.jump_imm(BPF_JEQ, BPF_REG_1, 64, pfx + "index");
+        p.label(pfx + "not100");
+
+        // 169.254.0.0/16
+        p.mov_imm(BPF_REG_4, 1);
+        p.jump_imm(BPF_JNE, BPF_REG_2, 169, pfx + "not169");
+        p.jump_imm(BPF_JEQ, BPF_REG_5, 254, pfx + "index");
+        p.label(pfx + "not169");
+
+        // 224.0.0.0/4 and everything above, including broadcast
+        p.mov_imm(BPF_REG_4, 2);
+        p.jump_imm(BPF_JGE, BPF_REG_2, 224, pfx + "index");
+    }
+    else
+    {
+        // fc00::/7
+        p.mov_reg(BPF_REG_1, BPF_REG_2);
+        p.alu_imm(BPF_AND, BPF_REG_1, 0xfe);
+        p.jump_imm(BPF_JEQ, BPF_REG_1, 0xfc, pfx + "index");
+
+        // fe80::/10
+        p.mov_imm(BPF_REG_4, 1);
+        p.jump_imm(BPF_JNE, BPF_REG_2, 0xfe, pfx + "notfe");
+        p.mov_reg(BPF_REG_1, BPF_REG_5);
+        p.alu_imm(BPF_AND, BPF_REG_1, 0xc0);
+        p.jump_imm(BPF_JEQ, BPF_REG_1, 0x80, pfx + "index");
+        p.label(pfx + "notfe");
+
+        // ff00::/8
+        p.mov_imm(BPF_REG_4, 2);
+        p.jump_imm(BPF_JEQ, BPF_REG_2, 0xff, pfx + "index");
+    }
+    p.mov_imm(BPF_REG_4, 3);
+
+    // *(u32 *)(fp-4) = base + r3 * 4 + r4
+    p.label(pfx + "index");
+    p.alu_imm(BPF_LSH, BPF_REG_3, 2);
+    p.alu_reg(BPF_ADD, BPF_REG_3, BPF_REG_4);
+    p.alu_imm(BPF_ADD, BPF_REG_3, base);
+    p.store(BPF_W, BPF_REG_10, -4, BPF_REG_3);
+    p.jump("count");
+}
+
+
+/**
+ *  Generates the accounting program of one direction
+ *
+ * @param map_fd  File descriptor of the counter map
+ * @param dir     0 for ingress, 1 for egress
+ *
+ * @return Returns the BPF instructions
+ */
+static std::vector<struct bpf_insn> generate_program(const int map_fd,
+                                                     const int dir)
+{
+    BpfProgram p;
+
+    // r6 = skb, r7 = skb->len, r8 = skb->protocol
+    p.mov_reg(BPF_REG_6, BPF_REG_1);
+    p.load(BPF_W, BPF_REG_7, BPF_REG_6, offsetof(struct __sk_buff, len));
+    p.load(BPF_W, BPF_REG_8, BPF_REG_6, offsetof(struct __sk_buff, protocol));
+    p.jump_imm(BPF_JEQ, BPF_REG_8, htons(ETH_P_IP), "ipv4");
+    p.jump_imm(BPF_JEQ, BPF_REG_8, htons(ETH_P_IPV6), "ipv6");
+    p.jump("done");
+
+    p.label("ipv4");
+    emit_classify(p, 0, (dir * 2 + 0) * 16);
+    p.label("ipv6");
+    emit_classify(p, 1, (dir * 2 + 1) * 16);
+
+    // r0 = bpf_map_lookup_elem(map, fp-4); count the packet
+    p.label("count");
+    p.load_map_fd(BPF_REG_1, map_fd);
+    p.mov_reg(BPF_REG_2, BPF_REG_10);
+    p.alu_imm(BPF_ADD, BPF_REG_2, -4);
+    p.call(BPF_FUNC_map_lookup_elem);
+    p.jump_imm(BPF_JEQ, BPF_REG_0, 0, "done");
+    p.mov_imm(BPF_REG_1, 1);
+    p.atomic_add64(BPF_REG_0, offsetof(counter_value, packets), BPF_REG_1);
+    p.atomic_add64(BPF_REG_0, offsetof(counter_value, bytes), BPF_REG_7);
+
+    // Always pass the packet on
+    p.label("done");
+    p.mov_imm(BPF_REG_0, TC_ACT_OK);
+    p.exit();
+
+    return p.Finish();
+}
+
+
+static int load_program(const std::vector<struct bpf_insn>& insns,
+                        const char *name)
+{
+    static const char license[] = "GPL";
+
+    union bpf_attr attr = {};
+    attr.prog_type = BPF_PROG_TYPE_SCHED_CLS;
+    attr.insns = reinterpret_cast<uintptr_t>(insns.data());
+    attr.insn_cnt = insns.size();
+    attr.license = reinterpret_cast<uintptr_t>(license);
+    strncpy(attr.prog_name, name, sizeof(attr.prog_name) - 1);
+
+    int fd = sys_bpf(BPF_PROG_LOAD, attr);
+    if (fd >= 0)
+    {
+        return fd;
+    }
+    std::string err(strerror(errno));
+
+    // Load it once more with the verifier log enabled, to explain why
+    if (EACCES == errno || EINVAL == errno)
+    {
+        std::vector<char> log(65536);
+        attr.log_level = 1;
+        attr.log_buf = reinterpret_cast<uintptr_t>(log.data());
+        attr.log_size = log.size();
+        fd = sys_bpf(BPF_PROG_LOAD, attr);
+        if (fd >= 0)
+        {
+            return fd;
+        }
+        std::string verifier(log.data());
+        while (!verifier.empty() && '\n' == verifier.back())
+        {
+            verifier.pop_back();
+        }
+        size_t nl = verifier.rfind('\n');
+        if (!verifier.empty())
+        {
+            err += " (" + verifier.substr(std::string::npos == nl ? 0 : nl + 1) + ")";
+        }
+    }
+    throw NetCfgException(std::string("Could not load BPF program ")
+                          + name + ": " + err);
+}
+
+
+/**
+ *  Sends a single tc request and waits for the acknowledgement
+ *
+ * @return Returns 0 on success, otherwise the errno value of the failure
+ */
+static int tc_request(const uint16_t type, const uint16_t flags,
+                      const struct tcmsg& tcm, const std::vector<char>& attrs)
+{
+    return NetCfg::Rtnl::Request(type, flags, &tcm, sizeof(tcm), attrs);
+}
+
+
+static void append_attr(std::vector<char>& buf, const unsigned short type,
+                        const void *data, const size_t len)
+{
+    NetCfg::Rtnl::AppendAttr(buf, type, data, len);
+}
+
+
+static struct tcmsg clsact_tcmsg(const unsigned int ifindex)
+{
+    struct tcmsg tcm = {};
+    tcm.tcm_family = AF_UNSPEC;
+    tcm.tcm_ifindex = ifindex;
+    tcm.tcm_parent = TC_H_CLSACT;
+    tcm.tcm_handle = TC_H_MAKE(TC_H_CLSACT, 0);
+    return tcm;
+}
+
+
+static struct tcmsg filter_tcmsg(const unsigned int ifindex, const int dir)
+{
+    struct tcmsg tcm = {};
+    tcm.tcm_family = AF_UNSPEC;
+    tcm.tcm_ifindex = ifindex;
+    tcm.tcm_parent = TC_H_MAKE(TC_H_CLSACT,
+                               (0 == dir ? TC_H_MIN_INGRESS : TC_H_MIN_EGRESS));
+    tcm.tcm_handle = filter_handle;
+    tcm.tcm_info = TC_H_MAKE(filter_prio << 16, htons(ETH_P_ALL));
+    return tcm;
+}
+
+
+
+namespace NetCfg
+{
+    BpfAccounting::BpfAccounting()
+    {
+        union bpf_attr attr = {};
+        attr.map_type = BPF_MAP_TYPE_ARRAY;
+        attr.key_size = sizeof(uint32_t);
+        attr.value_size = sizeof(counter_value);
+        attr.max_entries = n_counters;
+        strncpy(attr.map_name, "ovpn_acct", sizeof(attr.map_name) - 1);
+        map_fd = sys_bpf(BPF_MAP_CREATE, attr);
+        if (map_fd < 0)
+        {
+            throw NetCfgException(std::string("Could not create BPF map: ")
+                                  + strerror(errno));
+        }
+
+        try
+        {
+            prog_fd[0] = load_program(generate_program(map_fd, 0), "ovpn_acct_in");
+            prog_fd[1] = load_program(generate_program(map_fd, 1), "ovpn_acct_out");
+        }
+        catch (...)
+        {
+            if (prog_fd[0] >= 0)
+            {
+                close(prog_fd[0]);
+            }
+            close(map_fd);
+            throw;
+        }
+    }
+
+
+    BpfAccounting::~BpfAccounting()
+    {
+        Detach();
+        for (int fd : prog_fd)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+        if (map_fd >= 0)
+        {
+            close(map_fd);
+        }
+    }
+
+
+    void BpfAccounting::Attach(const unsigned int ifindex)
+    {
+        Detach();
+
+        std::vector<char> attrs;
+        append_attr(attrs, TCA_KIND, "clsact", sizeof("clsact"));
+        int error = tc_request(RTM_NEWQDISC, NLM_F_CREATE | NLM_F_EXCL,
+                               clsact_tcmsg(ifindex), attrs);
+        if (0 != error && EEXIST != error)
+        {
+            throw NetCfgException(std::string("Could not add clsact qdisc: ")
+                                  + strerror(error));
+        }
+        created_qdisc = (0 == error);
+        attached_ifindex = ifindex;
+
+        for (int dir = 0; dir < 2; ++dir)
+        {
+            const std::string name = std::string("ovpn_acct_") + dir_names[dir];
+            uint32_t fd = prog_fd[dir];
+            uint32_t flags = TCA_BPF_FLAG_ACT_DIRECT;
+
+            std::vector<char> opts;
+            append_attr(opts, TCA_BPF_FD, &fd, sizeof(fd));
+            append_attr(opts, TCA_BPF_NAME, name.c_str(), name.size() + 1);
+            append_attr(opts, TCA_BPF_FLAGS, &flags, sizeof(flags));
+
+            attrs.clear();
+            append_attr(attrs, TCA_KIND, "bpf", sizeof("bpf"));
+            append_attr(attrs, TCA_OPTIONS, opts.data(), opts.size());
+            error = tc_request(RTM_NEWTFILTER, NLM_F_CREATE | NLM_F_EXCL,
+                               filter_tcmsg(ifindex, dir), attrs);
+            if (0 != error)
+            {
+                Detach();
+                throw NetCfgException(std::string("Could not add tc BPF filter: ")
+                                      + strerror(error));
+            }
+        }
+    }
+
+
+    void BpfAccounting::Detach()
+    {
+        if (0 == attached_ifindex)
+        {
+            return;
+        }
+
+        std::vector<char> attrs;
+        append_attr(attrs, TCA_KIND, "bpf", sizeof("bpf"));
+        for (int dir = 0; dir < 2; ++dir)
+        {
+            (void) tc_request(RTM_DELTFILTER, 0,
+                              filter_tcmsg(attached_ifindex, dir), attrs);
+        }
+        if (created_qdisc)
+        {
+            (void) tc_request(RTM_DELQDISC, 0,
+                              clsact_tcmsg(attached_ifindex),
+                              std::vector<char>());
+        }
+        attached_ifindex = 0;
+        created_qdisc = false;
+    }
+
+
+    std::vector<TrafficCounter> BpfAccounting::Read() const
+    {
+        std::vector<TrafficCounter> ret;
+        for (uint32_t idx = 0; idx < n_counters; ++idx)
+        {
+            counter_value val = {};
+            union bpf_attr attr = {};
+            attr.map_fd = map_fd;
+            attr.key = reinterpret_cast<uintptr_t>(&idx);
+            attr.value = reinterpret_cast<uintptr_t>(&val);
+            if (sys_bpf(BPF_MAP_LOOKUP_ELEM, attr) < 0)
+            {
+                throw NetCfgException(std::string("Could not read BPF map: ")
+                                      + strerror(errno));
+            }
+            if (0 == val.packets)
+            {
+                continue;
+            }
+
+            TrafficCounter c;
+            c.direction = dir_names[idx / 32];
+            c.family = family_names[(idx / 16) % 2];
+            c.protocol = proto_names[(idx / 4) % 4];
+            c.destination = class_names[idx % 4];
+            c.bytes = val.bytes;
+            c.packets = val.packets;
+            ret.push_back(c);
+        }
+        return ret;
+    }
+
+
+    uint32_t BpfAccounting::TestRun(const Direction dir,
+                                    const std::vector<uint8_t>& packet) const
+    {
+        union bpf_attr attr = {};
+        attr.test.prog_fd = prog_fd[static_cast<int>(dir)];
+        attr.test.data_in = reinterpret_cast<uintptr_t>(packet.data());
+        attr.test.data_size_in = packet.size();
+        attr.test.repeat = 1;
+        if (sys_bpf(BPF_PROG_TEST_RUN, attr) < 0)
+        {
+            throw NetCfgException(std::string("Could not run BPF program: ")
+                                  + strerror(errno));
+        }
+        return attr.test.retval;
+    }
+} // namespace NetCfg
@@ -0,0 +1,139 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   bpf-accounting.hpp
+ *
+ * @brief  Kernel side traffic accounting of a virtual network device,
+ *         using tc BPF programs
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace NetCfg
+{
+    /**
+     *  Traffic counted in one accounting class
+     */
+    struct TrafficCounter
+    {
+        std::string direction;     ///< "in" from the VPN, "out" into the VPN
+        std::string family;        ///< "ipv4" or "ipv6"
+        std::string protocol;      ///< "tcp", "udp", "icmp" or "other"
+        std::string destination;   ///< "private", "link-local", "multicast" or "global"
+        uint64_t bytes = 0;
+        uint64_t packets = 0;
+    };
+
+
+    /**
+     *  Counts the packets and bytes passing a virtual network device,
+     *  per direction, address family, IP protocol and class of the
+     *  destination address.
+     *
+     *  Two small BPF programs are attached to the clsact qdisc of the
+     *  device, one on ingress and one on egress.  They update the
+     *  counters in a BPF array map; nothing is copied to user space
+     *  until Read() is called.  As tc sees the packets of both tun and
+     *  ovpn-dco devices, the counters are the same with and without DCO.
+     *
+     *  The programs are generated directly as BPF instructions and
+     *  loaded with the bpf(2) system call, so no BPF compiler or library
+     *  is needed.  This requires CAP_BPF (or CAP_SYS_ADMIN on older
+     *  kernels) in addition to CAP_NET_ADMIN.
+     *
+     *  Packets with IPv6 extension headers are counted as "other"
+     *  protocols.
+     */
+    class BpfAccounting
+    {
+    public:
+        using Ptr = std::unique_ptr<BpfAccounting>;
+
+        enum class Direction
+        {
+            IN = 0,    ///< tc ingress: traffic received from the VPN
+            OUT = 1    ///< tc egress: traffic sent into the VPN
+        };
+
+
+        /**
+         *  Creates the counter map and loads the programs.  Throws
+         *  NetCfgException on errors, like missing privileges.
+         */
+        BpfAccounting();
+        ~BpfAccounting();
+
+        BpfAccounting(const BpfAccounting&) = delete;
+        BpfAccounting& operator=(const BpfAccounting&) = delete;
+
+
+        /**
+         *  Attaches the programs to a network device.  A clsact qdisc is
+         *  added to the device if it does not have one.  Throws
+         *  NetCfgException on errors.
+         *
+         * @param ifindex  Interface index of the device
+         */
+        void Attach(const unsigned int ifindex);
+
+
+        /**
+         *  Removes the programs from the device again.  Errors are
+         *  ignored, the device may already be gone.
+         */
+        void Detach();
+
+
+        /**
+         *  Retrieves the counters of all the accounting classes which
+         *  have seen traffic
+         *
+         * @return Returns a std::vector of TrafficCounter records
+         */
+        std::vector<TrafficCounter> Read() const;
+
+
+        /**
+         *  Runs a program on a single packet, without attaching it, via
+         *  BPF_PROG_TEST_RUN.  The packet is counted like a real one.
+         *  Used to verify the programs.
+         *
+         * @param dir     Direction of the program to run
+         * @param packet  Ethernet frame with the IP packet
+         *
+         * @return Returns the return code of the program.  Throws
+         *         NetCfgException on errors.
+         */
+        uint32_t TestRun(const Direction dir,
+                         const std::vector<uint8_t>& packet) const;
+
+
+    private:
+        int map_fd = -1;
+        int prog_fd[2] = {-1, -1};
+        unsigned int attached_ifindex = 0;
+        bool created_qdisc = false;
+    };
+} // namespace NetCfg
@@ -29,6 +29,11 @@
 #include "log/core-dbus-logbase.hpp"
 #include <openvpn/common/platform.hpp>
 
+#include <set>
+#include <sstream>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
 // FIXME: This need to be included first because
 //        it breaks if included after tuncli.hpp
 #include "common/utils.hpp"
@@ -36,7 +41,10 @@
 #include "core-tunbuilder.hpp"
 #include <openvpn/tun/linux/client/tuncli.hpp>
 #include "netcfg-device.hpp"
+#include "netcfg-exception.hpp"
 #include "netcfg-signals.hpp"
+#include "netcfg-routeset.hpp"
+#include "netlink-routes.hpp"
 
 #define TUN_CLASS_SETUP TunLinuxSetup::Setup<TUN_LINUX>
 
@@ -47,6 +55,87 @@ namespace openvpn
     {
         TunLinuxSetup::Setup<TUN_LINUX>::Ptr tun;
         ActionList::Ptr remove_cmds;
+        NetCfg::NetlinkRoutes::Ptr tun_routes;
+
+        // State of the established device, used by reuse()
+        int tun_fd = -1;
+        std::string device_settings;
+        NetCfg::RouteSet active_routes;   ///< Installed routes via the VPN
+
+
+        /**
+         * Describes the settings which can only be changed by creating
+         * the device again
+         */
+        static std::string get_device_settings(const NetCfgDevice& netCfgDevice)
+        {
+            std::stringstream r;
+            r << netCfgDevice.device_type << ";" << netCfgDevice.mtu
+              << ";" << netCfgDevice.txqueuelen
+              << ";" << netCfgDevice.remote.address
+              << ";" << netCfgDevice.remote.ipv6
+              << ";" << netCfgDevice.reroute_ipv4
+              << ";" << netCfgDevice.reroute_ipv6
+              << ";" << netCfgDevice.bundle;
+            for (const auto& ip : netCfgDevice.vpnips)
+            {
+                r << ";a:" << ip.address << "/" << ip.prefix
+                  << "," << ip.gateway << "," << ip.ipv6;
+            }
+
+            // The route set is not ordered
+            std::set<std::string> excluded;
+            for (const auto& net : netCfgDevice.networks)
+            {
+                if (net.exclude)
+                {
+                    excluded.insert(net.str());
+                }
+            }
+            for (const auto& x : excluded)
+            {
+                r << ";x:" << x;
+            }
+            return r.str();
+        }
+
+
+        /**
+         * Extracts the routes via the VPN from the configured networks
+         */
+        static NetCfg::RouteSet get_vpn_routes(const NetCfgDevice& netCfgDevice)
+        {
+            NetCfg::RouteSet ret;
+            for (const auto& net : netCfgDevice.networks)
+            {
+                if (!net.exclude)
+                {
+                    ret.Add(net);
+                }
+            }
+            return ret;
+        }
+
+
+        /**
+         * Retrieve the gateway inside the VPN for routes of an address
+         * family.  Routes are sent via the gateway of the VPN IP address
+         * of the same address family, like the core library does.
+         */
+        static std::string get_vpn_gateway(const NetCfgDevice& netCfgDevice,
+                                           const bool ipv6)
+        {
+            std::string gw;
+            for (const auto& ip : netCfgDevice.vpnips)
+            {
+                if (ip.ipv6 == ipv6)
+                {
+                    gw = ip.gateway;
+                }
+            }
+            return gw;
+        }
+
 
         /**
          * Uses Tunbuilder to open a new tun device
@@ -77,6 +166,12 @@ namespace openvpn
          * This create a TunBuilderCapture (OpenVPN3 internal representation)
          * from our internal representation in NetCfgDevice.
          *
+         * Routes via the VPN are not added to the TunBuilderCapture, as
+         * the core library programs them one at a time.  They are
+         * installed in batches by install_tun_routes() instead.  Only
+         * excluded routes, which depend on the current default gateway,
+         * are handled by the core library.
+         *
          * @param netCfgDevice  The object of which the state should be
          *                      represented
          *
@@ -100,7 +195,7 @@ namespace openvpn
             tbc->tun_builder_set_remote_address(netCfgDevice.remote.address,
                                                 netCfgDevice.remote.ipv6);
 
-            // Add routes
+            // Add excluded routes
             for (const auto& net: netCfgDevice.networks)
             {
                 if (net.exclude)
@@ -109,11 +204,55 @@ namespace openvpn
                     tbc->tun_builder_exclude_route(net.address, net.prefix,
                                                    -1, net.ipv6);
                 }
-                else
-                {
-                    tbc->tun_builder_add_route(net.address, net.prefix,
-                                               -1, net.ipv6);
-                }
+            }
+
+            tbc->validate();
+
+            // We ignore tbc.dns_servers and other DNS related items since
+            // that is handled by a differrent service
+            return tbc;
+        }
+
+        /**
+         * Creates the NetlinkRoutes object for the routes via the VPN.
+         * With the policy-route redirect method, these routes live in
+         * the separate policy routing table instead of the main table.
+         * Routes of bundled devices are shared with the other devices
+         * of the bundle as multipath routes.
+         *
+         * @param netCfgDevice  The NetCfgDevice the routes belong to
+         *
+         * @return Returns a new NetCfg::NetlinkRoutes::Ptr
+         */
+        NetCfg::NetlinkRoutes::Ptr new_route_table(const NetCfgDevice& netCfgDevice)
+        {
+            const NetCfgOptions& opts = netCfgDevice.options;
+            uint32_t table = (RedirectMethod::POLICY_ROUTE == opts.redirect_method
+                              ? opts.policy_table : 0);
+            return NetCfg::NetlinkRoutes::Ptr(new NetCfg::NetlinkRoutes(table,
+                                                                        netCfgDevice.bundle));
+        }
+
+
+        /**
+         * Installs all routes via the VPN through the newly established
+         * device, in batched rtnetlink requests over a single socket.
+         *
+         * @param netCfgDevice  The NetCfgDevice the routes belong to
+         * @param iface_name    Name of the established network device
+         */
+        void install_tun_routes(NetCfgDevice& netCfgDevice,
+                                const std::string& iface_name)
+        {
+            std::string gw4 = get_vpn_gateway(netCfgDevice, false);
+            std::string gw6 = get_vpn_gateway(netCfgDevice, true);
+
+            tun_routes = new_route_table(netCfgDevice);
+            active_routes = get_vpn_routes(netCfgDevice);
+            for (const auto& net: active_routes)
+            {
+                tun_routes->AddRoute(net.address, net.prefix, net.ipv6,
+                                     (net.ipv6 ? gw6 : gw4));
             }
 
             if (netCfgDevice.reroute_ipv4 || netCfgDevice.reroute_ipv6)
@@ -125,13 +264,26 @@ namespace openvpn
                     // Add 'def1' style default routes
                     if (netCfgDevice.reroute_ipv4)
                     {
-                        tbc->tun_builder_add_route("0.0.0.0", 1, -1, false);
-                        tbc->tun_builder_add_route("128.0.0.0", 1, -1, false);
+                        tun_routes->AddRoute("0.0.0.0", 1, false, gw4);
+                        tun_routes->AddRoute("128.0.0.0", 1, false, gw4);
                     }
                     if (netCfgDevice.reroute_ipv6)
                     {
-                        tbc->tun_builder_add_route("::", 1, -1, true);
-                        tbc->tun_builder_add_route("8000::", 1, -1, true);
+                        tun_routes->AddRoute("::", 1, true, gw6);
+                        tun_routes->AddRoute("8000::", 1, true, gw6);
+                    }
+                    break;
+
+                case RedirectMethod::POLICY_ROUTE:
+                    // The policy routing table only carries VPN routes,
+                    // a plain default route does not hide any other route
+                    if (netCfgDevice.reroute_ipv4)
+                    {
+                        tun_routes->AddRoute("0.0.0.0", 0, false, gw4);
+                    }
+                    if (netCfgDevice.reroute_ipv6)
+                    {
+                        tun_routes->AddRoute("::", 0, true, gw6);
                     }
                     break;
 
@@ -140,13 +292,135 @@ namespace openvpn
                 }
             }
 
-            tbc->validate();
+            if (0 == tun_routes->size())
+            {
+                return;
+            }
+            for (const auto& err : tun_routes->Install(iface_name))
+            {
+                netCfgDevice.signal.LogError(err);
+            }
+            netCfgDevice.signal.Debug(iface_name,
+                                      "Installed "
+                                      + std::to_string(tun_routes->size())
+                                      + " routes");
+        }
 
-            // We ignore tbc.dns_servers and other DNS related items since
-            // that is handled by a differrent service
-            return tbc;
+
+        /**
+         * Removes and installs only the routes via the VPN which differ
+         * between the installed routes and the networks configured in
+         * the NetCfgDevice.
+         *
+         * @param netCfgDevice  The NetCfgDevice the routes belong to
+         * @param diff          NetCfg::RouteSet::Diff with the changes
+         */
+        void apply_route_diff(NetCfgDevice& netCfgDevice,
+                              const NetCfg::RouteSet::Diff& diff)
+        {
+            if (!tun_routes)
+            {
+                tun_routes = new_route_table(netCfgDevice);
+            }
+            std::string gw4 = get_vpn_gateway(netCfgDevice, false);
+            std::string gw6 = get_vpn_gateway(netCfgDevice, true);
+
+            for (const auto& net : diff.removed)
+            {
+                tun_routes->DeleteRoute(net.address, net.prefix, net.ipv6);
+                active_routes.Remove(net);
+            }
+            for (const auto& net : diff.added)
+            {
+                tun_routes->AddRoute(net.address, net.prefix, net.ipv6,
+                                     (net.ipv6 ? gw6 : gw4));
+                active_routes.Add(net);
+            }
+            for (const auto& err : tun_routes->Install(netCfgDevice.device_name))
+            {
+                netCfgDevice.signal.LogError(err);
+            }
+            netCfgDevice.signal.Debug(netCfgDevice.device_name,
+                                      "Routes updated: "
+                                      + std::to_string(diff.added.size()) + " added, "
+                                      + std::to_string(diff.removed.size()) + " removed");
+
+            for (const auto& net : diff.removed)
+            {
+                NetCfgChangeEvent chg_ev(NetCfgChangeType::ROUTE_REMOVED,
+                                         netCfgDevice.device_name,
+                                         {{"ip_version", (net.ipv6 ? "6" : "4")},
+                                          {"subnet", net.address},
+                                          {"prefix", std::to_string(net.prefix)}});
+                netCfgDevice.signal.NetworkChange(chg_ev);
+            }
+            for (const auto& net : diff.added)
+            {
+                NetCfgChangeEvent chg_ev(NetCfgChangeType::ROUTE_ADDED,
+                                         netCfgDevice.device_name,
+                                         {{"ip_version", (net.ipv6 ? "6" : "4")},
+                                          {"subnet", net.address},
+                                          {"prefix", std::to_string(net.prefix)},
+                                          {"gateway", (net.ipv6 ? gw6 : gw4)}});
+                netCfgDevice.signal.NetworkChange(chg_ev);
+            }
+        }
+
+
+        /**
+         * Removes the routes installed by install_tun_routes()
+         */
+        void remove_tun_routes()
+        {
+            if (!tun_routes)
+            {
+                return;
+            }
+            try
+            {
+                for (const auto& err : tun_routes->Remove())
+                {
+                    OPENVPN_LOG(err);
+                }
+            }
+            catch (const NetCfgException& excp)
+            {
+                OPENVPN_LOG(excp.what());
+            }
+            tun_routes.reset();
+        }
+
+
+        /**
+         * Checks if configuring this device depends on or changes the
+         * routing of other devices.  This is the case when excluded
+         * routes are looked up via the current default route, when
+         * the default route is redirected or when the routes are shared
+         * with the other devices of a bundle.
+         *
+         * @param netCfgDevice  The NetCfgDevice to check
+         *
+         * @return Returns true if the NetCfgRoutingLock must be held
+         *         exclusively while configuring this device
+         */
+        static bool needs_exclusive_routing(const NetCfgDevice& netCfgDevice)
+        {
+            if (netCfgDevice.reroute_ipv4 || netCfgDevice.reroute_ipv6
+                || !netCfgDevice.bundle.empty())
+            {
+                return true;
+            }
+            for (const auto& net: netCfgDevice.networks)
+            {
+                if (net.exclude)
+                {
+                    return true;
+                }
+            }
+            return false;
         }
 
+
     public:
         int establish(NetCfgDevice& netCfgDevice) override
         {
@@ -165,6 +439,11 @@ namespace openvpn
 
             TunBuilderCapture::Ptr tbc = createTunbuilderCapture(netCfgDevice);
 
+            // Devices are established in parallel by the worker threads,
+            // unless this device affects the routing of other devices
+            NetCfgRoutingLock::Guard routing(netCfgDevice.workers->GetRoutingLock(),
+                                             needs_exclusive_routing(netCfgDevice));
+
             //
             // For non-DCO, we currently do not set config.iface_name to
             // open the first available tun device.
@@ -172,7 +451,44 @@ namespace openvpn
             // The config object below is a return value rather than
             // an argument
             //
-            int ret = establish_tun(*tbc, config, nullptr, std::cout);
+            // A tun device prepared by the pool is attached to by name,
+            // instead of waiting for a new device to be registered
+            std::string pooled;
+            if (!config.dco && netCfgDevice.tun_pool
+                && NetCfgDeviceType::TUN == netCfgDevice.device_type)
+            {
+                pooled = netCfgDevice.tun_pool->Take();
+                config.dev_name = pooled;
+            }
+
+            int ret = -1;
+            try
+            {
+                ret = establish_tun(*tbc, config, nullptr, std::cout);
+            }
+            catch (...)
+            {
+                if (!pooled.empty())
+                {
+                    NetCfg::TunPool::Remove(pooled);
+                }
+                throw;
+            }
+
+            // Let the device go away with its last file descriptor again,
+            // like a device created by the Core library
+            if (!pooled.empty())
+            {
+                if (ret < 0)
+                {
+                    NetCfg::TunPool::Remove(pooled);
+                }
+                else if (!NetCfg::TunPool::ReleasePersist(ret))
+                {
+                    netCfgDevice.signal.LogWarn("Could not release the pooled device "
+                                                + pooled);
+                }
+            }
 
 #ifdef ENABLE_OVPNDCO
             if (!netCfgDevice.dco_device)
@@ -183,11 +499,78 @@ namespace openvpn
             netCfgDevice.set_device_name(config.iface_name);
 #endif
 
+            install_tun_routes(netCfgDevice, config.iface_name);
             doEstablishNotifies(netCfgDevice, config);
 
+            // Keep the device open on our side as well, so it is not
+            // removed if the client closes its fd while it reconnects
+            if (!config.dco && ret >= 0)
+            {
+                tun_fd = dup(ret);
+            }
+            device_settings = get_device_settings(netCfgDevice);
+
             return ret;
         }
 
+
+        int reuse(NetCfgDevice& netCfgDevice) override
+        {
+            if (tun_fd < 0
+                || device_settings != get_device_settings(netCfgDevice))
+            {
+                return -1;
+            }
+
+            NetCfg::RouteSet::Diff diff = active_routes.Compare(get_vpn_routes(netCfgDevice));
+            if (!diff.empty())
+            {
+                NetCfgRoutingLock::Guard routing(netCfgDevice.workers->GetRoutingLock(),
+                                                 needs_exclusive_routing(netCfgDevice));
+                apply_route_diff(netCfgDevice, diff);
+            }
+            return dup(tun_fd);
+        }
+
+
+        bool update_routes(NetCfgDevice& netCfgDevice,
+                           const NetCfg::RouteSet::Diff& diff) override
+        {
+            if (!tun)
+            {
+                return false;
+            }
+            for (const auto& net : diff.added)
+            {
+                if (net.exclude)
+                {
+                    return false;
+                }
+            }
+            for (const auto& net : diff.removed)
+            {
+                if (net.exclude)
+                {
+                    return false;
+                }
+            }
+
+            NetCfgRoutingLock::Guard routing(netCfgDevice.workers->GetRoutingLock(),
+                                             needs_exclusive_routing(netCfgDevice));
+            apply_route_diff(netCfgDevice, diff);
+            return true;
+        }
+
+
+        ~CoreTunbuilderImpl()
+        {
+            if (tun_fd >= 0)
+            {
+                close(tun_fd);
+            }
+        }
+
+
         void doEstablishNotifies(const NetCfgDevice& netCfgDevice,
                                  const TUN_CLASS_SETUP::Config& config) const
         {
@@ -246,6 +629,18 @@ namespace openvpn
 
         void teardown(const NetCfgDevice& ncdev, bool disconnect) override
         {
+            NetCfgRoutingLock::Guard routing(ncdev.workers->GetRoutingLock(),
+                                             needs_exclusive_routing(ncdev));
+            remove_tun_routes();
+
+            if (tun_fd >= 0)
+            {
+                close(tun_fd);
+                tun_fd = -1;
+            }
+            device_settings.clear();
+            active_routes.Clear();
+
             if(tun)
             {
                 // the os parameter is not used
@@ -376,6 +771,33 @@ namespace openvpn
     }
 
 
+    void set_device_mtu(const std::string& dev_name, const unsigned int mtu)
+    {
+        struct ifreq ifr = {};
+        if (dev_name.empty() || dev_name.size() >= sizeof(ifr.ifr_name))
+        {
+            throw NetCfgException("Invalid device name '" + dev_name + "'");
+        }
+        dev_name.copy(ifr.ifr_name, sizeof(ifr.ifr_name) - 1);
+        ifr.ifr_mtu = (int) mtu;
+
+        int sd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (sd < 0)
+        {
+            throw NetCfgException(std::string("Could not open socket: ")
+                                  + strerror(errno));
+        }
+        if (ioctl(sd, SIOCSIFMTU, &ifr) < 0)
+        {
+            std::string err(strerror(errno));
+            close(sd);
+            throw NetCfgException("Setting MTU " + std::to_string(mtu)
+                                  + " on " + dev_name + " failed: " + err);
+        }
+        close(sd);
+    }
+
+
     CoreTunbuilder* getCoreBuilderInstance()
     {
         return new CoreTunbuilderImpl();
@@ -31,6 +31,8 @@
 #include <openvpn/common/rc.hpp>
 #include <string>
 
+#include "netcfg-routeset.hpp"
+
 class NetCfgDevice;
 
 namespace openvpn
@@ -39,6 +41,36 @@ namespace openvpn
     {
     public:
         virtual int establish(NetCfgDevice& netCfgDevice) = 0;
+
+        /**
+         * Applies the configuration of netCfgDevice to the device created
+         * by an earlier establish() call, without re-creating it.  This
+         * is only possible if the interface settings (addresses, MTU,
+         * layer, excluded routes, ...) are unchanged.
+         *
+         * @param netCfgDevice  NetCfgDevice with the new configuration
+         *
+         * @return Returns a new fd to the tun device on success, or -1 if
+         *         the device must be torn down and established again
+         */
+        virtual int reuse(NetCfgDevice& netCfgDevice) = 0;
+
+        /**
+         * Installs and removes routes via the VPN on the established
+         * device, without touching the other routes.
+         *
+         * @param netCfgDevice  NetCfgDevice the routes belong to
+         * @param diff          NetCfg::RouteSet::Diff with the networks
+         *                      added to and removed from the device
+         *
+         * @return Returns false if the changes cannot be applied
+         *         to the running device, which is the case when it is
+         *         not established or excluded routes are changed.
+         *         These changes are applied by the next establish().
+         */
+        virtual bool update_routes(NetCfgDevice& netCfgDevice,
+                                   const NetCfg::RouteSet::Diff& diff) = 0;
+
         virtual void teardown(const NetCfgDevice& netCfgDevice, bool disconnect) = 0;
     };
 
@@ -75,6 +107,16 @@ namespace openvpn
                                   pid_t pid);
 
 
+    /**
+     * Changes the MTU of an existing network device.  Throws
+     * NetCfgException on errors.
+     *
+     * @param dev_name  Name of the network device
+     * @param mtu       The new MTU
+     */
+    void set_device_mtu(const std::string& dev_name, const unsigned int mtu);
+
+
     /**
      * Remove all protected sockets that belong to a certain pid
      * @param pid the pid for which the socket protection to remove for
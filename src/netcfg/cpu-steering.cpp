@@ -0,0 +1,397 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   cpu-steering.cpp
+ *
+ * @brief  Spreads the packet processing of a network device over CPUs,
+ *         using Receive Packet Steering (RPS), Receive Flow Steering
+ *         (RFS) and Transmit Packet Steering (XPS)
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/thread-scheduling.hpp"
+#include "netcfg-exception.hpp"
+#include "cpu-steering.hpp"
+
+
+namespace NetCfg
+{
+    static std::string read_line(const std::string& path)
+    {
+        std::ifstream f(path);
+        std::string line;
+        std::getline(f, line);
+        return line;
+    }
+
+
+    static void write_file(const std::string& path, const std::string& value)
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw NetCfgException("Could not open " + path + ": "
+                                  + std::string(strerror(errno)));
+        }
+        ssize_t r = ::write(fd, value.c_str(), value.size());
+        int err = errno;
+        ::close(fd);
+        if (r != (ssize_t) value.size())
+        {
+            throw NetCfgException("Could not write '" + value + "' to "
+                                  + path + ": " + std::string(strerror(err)));
+        }
+    }
+
+
+    /**
+     *  Lists the entries of a directory with a given prefix, in
+     *  numerical order of the rest of their names
+     */
+    static std::vector<std::string> list_dir(const std::string& path,
+                                             const std::string& prefix)
+    {
+        std::vector<std::pair<unsigned long, std::string>> entries;
+        DIR *dir = opendir(path.c_str());
+        if (nullptr == dir)
+        {
+            return {};
+        }
+        while (struct dirent *e = readdir(dir))
+        {
+            std::string name(e->d_name);
+            if (0 != name.compare(0, prefix.size(), prefix))
+            {
+                continue;
+            }
+            std::string num = name.substr(prefix.size());
+            if (num.empty() || num.find_first_not_of("0123456789") != std::string::npos)
+            {
+                continue;
+            }
+            entries.push_back({std::stoul(num), name});
+        }
+        closedir(dir);
+        std::sort(entries.begin(), entries.end());
+
+        std::vector<std::string> ret;
+        for (const auto& e : entries)
+        {
+            ret.push_back(e.second);
+        }
+        return ret;
+    }
+
+
+
+    //
+    //  struct SteeringSettings
+    //
+
+    void SteeringSettings::Merge(const SteeringSettings& other)
+    {
+        if (!other.rps_cpus.empty())
+        {
+            rps_cpus = other.rps_cpus;
+        }
+        if (!other.xps_cpus.empty())
+        {
+            xps_cpus = other.xps_cpus;
+        }
+        if (other.rps_flow_cnt > 0)
+        {
+            rps_flow_cnt = other.rps_flow_cnt;
+        }
+    }
+
+
+    void SteeringSettings::Validate() const
+    {
+        for (const auto& l : {rps_cpus, xps_cpus})
+        {
+            if (!l.empty() && "auto" != l)
+            {
+                CpuSteering::ParseCPUList(l);
+            }
+        }
+    }
+
+
+    std::string SteeringSettings::str() const
+    {
+        std::stringstream s;
+        s << "RPS CPUs: " << (rps_cpus.empty() ? "default" : rps_cpus)
+          << ", XPS CPUs: " << (xps_cpus.empty() ? "default" : xps_cpus)
+          << ", RFS flows: " << (rps_flow_cnt > 0 ? std::to_string(rps_flow_cnt)
+                                                  : "default");
+        return s.str();
+    }
+
+
+
+    //
+    //  class CpuSteering
+    //
+
+    CpuSteering::CpuSteering(const std::string& root)
+        : root(root)
+    {
+    }
+
+
+    std::set<unsigned int> CpuSteering::Apply(const std::string& device,
+                                              const SteeringSettings& settings,
+                                              const std::string& lower_device) const
+    {
+        std::set<unsigned int> rps = ResolveCPUs(settings.rps_cpus, lower_device);
+        std::set<unsigned int> xps = ResolveCPUs(settings.xps_cpus, lower_device);
+
+        const std::string queues = root + "/sys/class/net/" + device + "/queues/";
+        std::vector<std::string> rxq = list_dir(queues, "rx-");
+        if (rxq.empty())
+        {
+            throw NetCfgException("No queues found for device " + device);
+        }
+        for (const auto& q : rxq)
+        {
+            if (!rps.empty())
+            {
+                write_file(queues + q + "/rps_cpus", CPUMask(rps));
+            }
+            if (settings.rps_flow_cnt > 0)
+            {
+                write_file(queues + q + "/rps_flow_cnt",
+                           std::to_string(settings.rps_flow_cnt));
+            }
+        }
+
+        // The kernel only supports XPS on multi-queue devices
+        std::vector<std::string> txq = list_dir(queues, "tx-");
+        if (!xps.empty() && txq.size() > 1)
+        {
+            // Each CPU sends through one queue; with fewer CPUs than
+            // queues, the remaining queues are left alone
+            std::vector<std::set<unsigned int>> map(txq.size());
+            size_t i = 0;
+            for (const auto& cpu : xps)
+            {
+                if (map.empty())
+                {
+                    break;
+                }
+                map[i++ % map.size()].insert(cpu);
+            }
+            for (i = 0; i < txq.size() && !map[i].empty(); ++i)
+            {
+                write_file(queues + txq[i] + "/xps_cpus", CPUMask(map[i]));
+            }
+        }
+        return (!rps.empty() ? rps : xps);
+    }
+
+
+    std::set<unsigned int> CpuSteering::ResolveCPUs(const std::string& spec,
+                                                    const std::string& lower_device) const
+    {
+        if (spec.empty())
+        {
+            return {};
+        }
+
+        std::set<unsigned int> online = OnlineCPUs();
+        if ("auto" == spec)
+        {
+            std::set<unsigned int> ret = online;
+            if (!lower_device.empty())
+            {
+                for (const auto& c : IrqCPUs(lower_device))
+                {
+                    ret.erase(c);
+                }
+            }
+            // On small systems, all CPUs may be handling interrupts
+            return (ret.empty() ? online : ret);
+        }
+
+        std::set<unsigned int> ret = ParseCPUList(spec);
+        for (const auto& c : ret)
+        {
+            if (online.count(c) == 0)
+            {
+                throw NetCfgException("CPU " + std::to_string(c)
+                                      + " is not online");
+            }
+        }
+        return ret;
+    }
+
+
+    std::set<unsigned int> CpuSteering::OnlineCPUs() const
+    {
+        std::string online = read_line(root + "/sys/devices/system/cpu/online");
+        if (online.empty())
+        {
+            throw NetCfgException("Could not read the online CPUs");
+        }
+        return ParseCPUList(online);
+    }
+
+
+    std::set<unsigned int> CpuSteering::IrqCPUs(const std::string& device) const
+    {
+        std::set<std::string> irqs;
+
+        // MSI interrupts of the device; for virtio network devices,
+        // these belong to the parent PCI device
+        const std::string dev = root + "/sys/class/net/" + device + "/device";
+        for (const auto& path : {dev + "/msi_irqs", dev + "/../msi_irqs"})
+        {
+            for (const auto& irq : list_dir(path, ""))
+            {
+                irqs.insert(irq);
+            }
+        }
+
+        // Interrupts named after the interface, like "eth0-TxRx-0"
+        std::ifstream interrupts(root + "/proc/interrupts");
+        std::string line;
+        while (std::getline(interrupts, line))
+        {
+            size_t colon = line.find(':');
+            if (std::string::npos == colon)
+            {
+                continue;
+            }
+            size_t pos = line.find(device, colon);
+            size_t end = pos + device.size();
+            if (std::string::npos == pos
+                || (end < line.size() && isalnum(line[end])))
+            {
+                continue;
+            }
+            std::string irq = line.substr(0, colon);
+            irq.erase(0, irq.find_first_not_of(' '));
+            if (!irq.empty() && irq.find_first_not_of("0123456789") == std::string::npos)
+            {
+                irqs.insert(irq);
+            }
+        }
+
+        std::set<unsigned int> ret;
+        for (const auto& irq : irqs)
+        {
+            const std::string p = root + "/proc/irq/" + irq + "/";
+            std::string cpus = read_line(p + "effective_affinity_list");
+            if (cpus.empty())
+            {
+                cpus = read_line(p + "smp_affinity_list");
+            }
+            if (cpus.empty())
+            {
+                continue;
+            }
+            for (const auto& c : ParseCPUList(cpus))
+            {
+                ret.insert(c);
+            }
+        }
+        return ret;
+    }
+
+
+    bool CpuSteering::RfsEnabled() const
+    {
+        std::string v = read_line(root + "/proc/sys/net/core/rps_sock_flow_entries");
+        return !v.empty() && "0" != v;
+    }
+
+
+    std::string CpuSteering::CPUMask(const std::set<unsigned int>& cpus)
+    {
+        if (cpus.empty())
+        {
+            return "0";
+        }
+        std::vector<uint32_t> words(*cpus.rbegin() / 32 + 1, 0);
+        for (const auto& c : cpus)
+        {
+            words[c / 32] |= (1u << (c % 32));
+        }
+
+        std::string ret;
+        char buf[16];
+        for (auto w = words.rbegin(); w != words.rend(); ++w)
+        {
+            snprintf(buf, sizeof(buf), (ret.empty() ? "%x" : ",%08x"), *w);
+            ret += buf;
+        }
+        return ret;
+    }
+
+
+    std::string CpuSteering::CPUList(const std::set<unsigned int>& cpus)
+    {
+        std::stringstream s;
+        auto it = cpus.begin();
+        while (it != cpus.end())
+        {
+            unsigned int first = *it;
+            unsigned int last = first;
+            while (++it != cpus.end() && *it == last + 1)
+            {
+                last = *it;
+            }
+            s << (s.tellp() > 0 ? "," : "") << first;
+            if (last != first)
+            {
+                s << "-" << last;
+            }
+        }
+        return s.str();
+    }
+
+
+    std::set<unsigned int> CpuSteering::ParseCPUList(const std::string& list)
+    {
+        try
+        {
+            ThreadScheduling sched;
+            sched.SetCPUs(list);
+            return sched.GetCPUs();
+        }
+        catch (const ThreadSchedulingException& excp)
+        {
+            throw NetCfgException(excp.what());
+        }
+    }
+} // namespace NetCfg
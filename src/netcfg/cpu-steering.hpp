@@ -0,0 +1,172 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   cpu-steering.hpp
+ *
+ * @brief  Spreads the packet processing of a network device over CPUs,
+ *         using Receive Packet Steering (RPS), Receive Flow Steering
+ *         (RFS) and Transmit Packet Steering (XPS)
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+
+
+namespace NetCfg
+{
+    /**
+     *  CPU steering settings of a network device.  The CPU lists are
+     *  either a list like "0-3,6", "auto" or empty to keep the kernel
+     *  default.  "auto" uses all online CPUs except those handling the
+     *  interrupts of the interface the VPN traffic leaves through.
+     */
+    struct SteeringSettings
+    {
+        std::string rps_cpus;          ///< CPUs processing received packets
+        std::string xps_cpus;          ///< CPUs mapped to the transmit queues
+        unsigned int rps_flow_cnt = 0; ///< RFS flow table entries per queue
+
+
+        bool empty() const noexcept
+        {
+            return rps_cpus.empty() && xps_cpus.empty() && 0 == rps_flow_cnt;
+        }
+
+
+        /**
+         *  Take over the settings the other object has set, keeping the
+         *  settings of this object which are not set in the other object
+         */
+        void Merge(const SteeringSettings& other);
+
+
+        /**
+         *  Checks the syntax of the CPU lists.  Throws NetCfgException
+         *  if invalid.
+         */
+        void Validate() const;
+
+
+        /**
+         *  Human readable summary of the settings, for log messages
+         */
+        std::string str() const;
+    };
+
+
+
+    /**
+     *  Applies SteeringSettings to the queues of a network device via
+     *  sysfs.  Writing these files requires CAP_NET_ADMIN and, as they
+     *  are owned by root, CAP_DAC_OVERRIDE.
+     */
+    class CpuSteering
+    {
+    public:
+        /**
+         * @param root  Prefix of the /sys and /proc paths, for testing
+         */
+        CpuSteering(const std::string& root = "");
+
+
+        /**
+         *  Configures RPS, RFS and XPS on all queues of a device.  RPS
+         *  and the RFS flow count are set on every receive queue; the
+         *  XPS CPUs are spread over the transmit queues.  Devices
+         *  without XPS support, like single queue tun devices, only get
+         *  RPS and RFS.  Throws NetCfgException on errors.
+         *
+         * @param device        Name of the network device to configure
+         * @param settings      SteeringSettings to apply
+         * @param lower_device  Name of the interface the VPN traffic
+         *                      leaves through, used by "auto".  May be
+         *                      empty.
+         *
+         * @return Returns the CPUs received packets are steered to,
+         *         falling back to the XPS CPUs.  Empty if neither is set.
+         */
+        std::set<unsigned int> Apply(const std::string& device,
+                                     const SteeringSettings& settings,
+                                     const std::string& lower_device) const;
+
+
+        /**
+         *  Resolves a CPU list of the SteeringSettings.  Throws
+         *  NetCfgException on invalid lists or CPUs which are not online.
+         *
+         * @param spec          CPU list or "auto"
+         * @param lower_device  Interface whose interrupt CPUs "auto" avoids
+         *
+         * @return Returns the CPUs; empty if spec is empty
+         */
+        std::set<unsigned int> ResolveCPUs(const std::string& spec,
+                                           const std::string& lower_device) const;
+
+
+        /**
+         * @return Returns the online CPUs of the system
+         */
+        std::set<unsigned int> OnlineCPUs() const;
+
+
+        /**
+         *  Finds the CPUs handling the interrupts of a network interface,
+         *  via the MSI interrupts of its device and the interrupt names
+         *  in /proc/interrupts.
+         *
+         * @param device  Name of the network interface
+         *
+         * @return Returns the CPUs; empty if none were found
+         */
+        std::set<unsigned int> IrqCPUs(const std::string& device) const;
+
+
+        /**
+         * @return Returns true if the system wide RFS flow table is
+         *         enabled, which rps_flow_cnt depends on
+         */
+        bool RfsEnabled() const;
+
+
+        /**
+         *  Formats CPUs as a sysfs CPU mask: hexadecimal, in comma
+         *  separated 32 bit groups with the highest CPUs first
+         */
+        static std::string CPUMask(const std::set<unsigned int>& cpus);
+
+
+        /**
+         *  Formats CPUs as a CPU list, like "0-3,6"
+         */
+        static std::string CPUList(const std::set<unsigned int>& cpus);
+
+
+        /**
+         *  Parses a CPU list, like "0-3,6".  Throws NetCfgException if
+         *  invalid.
+         */
+        static std::set<unsigned int> ParseCPUList(const std::string& list);
+
+
+    private:
+        std::string root;
+    };
+} // namespace NetCfg
@@ -0,0 +1,153 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dco-capability.hpp
+ *
+ * @brief  Cached knowledge of whether data channel offload (DCO) can be
+ *         used on this host
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+/**
+ *  Keeps the result of probing for the ovpn-dco kernel module, and
+ *  the outcome of the latest attempts to enable DCO on a device.
+ *
+ *  The probe result is reused for probe_ttl.  After DCO could not be
+ *  enabled on a device, DCO is reported as unavailable for
+ *  failure_backoff.  New sessions then go straight to the userspace
+ *  data path instead of repeating a device create/destroy cycle which
+ *  is likely to fail again.
+ */
+class DCOCapability
+{
+public:
+    using Ptr = std::shared_ptr<DCOCapability>;
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @param probe            Function checking if the kernel module is
+     *                         available
+     * @param probe_ttl        How long a probe result is reused
+     * @param failure_backoff  How long DCO is reported as unavailable
+     *                         after it failed on a device
+     */
+    DCOCapability(std::function<bool()> probe,
+                  const std::chrono::seconds probe_ttl = std::chrono::seconds(60),
+                  const std::chrono::seconds failure_backoff = std::chrono::seconds(300))
+        : probe(std::move(probe)),
+          probe_ttl(probe_ttl),
+          failure_backoff(failure_backoff)
+    {
+    }
+
+
+    /**
+     *  Check if new sessions should use DCO
+     *
+     * @return Returns true if the kernel module is available and DCO has
+     *         not recently failed on a device
+     */
+    bool Available()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        Clock::time_point now = Clock::now();
+        if (failures > 0 && now < failed_at + failure_backoff)
+        {
+            return false;
+        }
+        if (!probed || now >= probed_at + probe_ttl)
+        {
+            kernel_support = probe();
+            probed = true;
+            probed_at = now;
+        }
+        return kernel_support;
+    }
+
+
+    /**
+     *  Record that DCO could not be enabled on a device
+     *
+     * @param reason  std::string with the error message
+     */
+    void RecordFailure(const std::string& reason)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        ++failures;
+        failed_at = Clock::now();
+        last_failure = reason;
+    }
+
+
+    /**
+     *  Record that DCO was enabled on a device.  This ends the back-off
+     *  period of earlier failures.
+     */
+    void RecordSuccess()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        failures = 0;
+        last_failure.clear();
+    }
+
+
+    /**
+     * @return Returns the error message of the most recent failure since
+     *         the last success, or an empty string
+     */
+    std::string GetLastFailure() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return last_failure;
+    }
+
+
+    /**
+     * @return Returns the number of failures since the last success
+     */
+    unsigned int GetFailureCount() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return failures;
+    }
+
+
+private:
+    mutable std::mutex mtx;
+    std::function<bool()> probe;
+    std::chrono::seconds probe_ttl;
+    std::chrono::seconds failure_backoff;
+
+    bool probed = false;
+    bool kernel_support = false;
+    Clock::time_point probed_at;
+
+    unsigned int failures = 0;
+    Clock::time_point failed_at;
+    std::string last_failure;
+};
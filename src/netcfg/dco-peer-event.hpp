@@ -0,0 +1,124 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dco-peer-event.hpp
+ *
+ * @brief  Decodes the peer notifications the GeNL implementation of the
+ *         OpenVPN 3 Core library passes on from the ovpn-dco kernel module
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+
+namespace NetCfg
+{
+    /**
+     *  A peer deleted notification from the ovpn-dco kernel module.
+     *
+     *  The Core library GeNL read handler gets these in the same buffer
+     *  format as the tunnelled packets: a single byte with the generic
+     *  netlink command, followed by the 32 bit peer ID and the 8 bit
+     *  deletion reason in host byte order.
+     */
+    struct DcoPeerEvent
+    {
+        /// ovpn_del_peer_reason from the linux/ovpn_dco.h uapi header
+        enum class Reason : uint8_t
+        {
+            TEARDOWN = 0,
+            USERSPACE = 1,
+            EXPIRED = 2,
+            TRANSPORT_ERROR = 3,
+            TRANSPORT_DISCONNECT = 4
+        };
+
+        /// OVPN_CMD_DEL_PEER from the linux/ovpn_dco.h uapi header
+        static const uint8_t cmd_del_peer = 3;
+
+        uint32_t peer_id = 0;
+        Reason reason = Reason::TEARDOWN;
+
+
+        /**
+         *  Decode a buffer from the GeNL read handler
+         *
+         * @param data  Pointer to the buffer
+         * @param len   Length of the buffer
+         * @param ev    DcoPeerEvent to fill in
+         *
+         * @return Returns true if the buffer is a peer deleted
+         *         notification, otherwise false and ev is not modified
+         */
+        static bool Parse(const uint8_t *data, const size_t len,
+                          DcoPeerEvent& ev)
+        {
+            if (!data || len < 1 + sizeof(uint32_t) + sizeof(uint8_t)
+                || cmd_del_peer != data[0])
+            {
+                return false;
+            }
+            std::memcpy(&ev.peer_id, data + 1, sizeof(ev.peer_id));
+            ev.reason = static_cast<Reason>(data[1 + sizeof(uint32_t)]);
+            return true;
+        }
+
+
+        /**
+         *  Whether the peer was removed by the kernel module on its own,
+         *  because the keep-alive timeout expired or the transport
+         *  failed.  The backend client only learns about these through
+         *  this notification; the others are a result of its own
+         *  requests.
+         */
+        bool Unsolicited() const
+        {
+            return Reason::EXPIRED == reason
+                   || Reason::TRANSPORT_ERROR == reason
+                   || Reason::TRANSPORT_DISCONNECT == reason;
+        }
+
+
+        /**
+         * @return Returns a short description of the deletion reason
+         */
+        std::string ReasonString() const
+        {
+            switch (reason)
+            {
+            case Reason::TEARDOWN:
+                return "teardown";
+            case Reason::USERSPACE:
+                return "userspace";
+            case Reason::EXPIRED:
+                return "expired";
+            case Reason::TRANSPORT_ERROR:
+                return "transport-error";
+            case Reason::TRANSPORT_DISCONNECT:
+                return "transport-disconnect";
+            }
+            return "unknown";
+        }
+    };
+} // namespace NetCfg
@@ -0,0 +1,349 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dco-peerstats.cpp
+ *
+ * @brief  Implementation of NetCfg::DcoPeerStats
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "netcfg-exception.hpp"
+#include "dco-peerstats.hpp"
+
+
+//  Generic netlink interface of the ovpn-dco kernel module, from
+//  its linux/ovpn_dco.h uapi header.  These are defined here since
+//  older versions of that header lack the OVPN_CMD_GET_PEER command.
+static const char *ovpn_family_name = "ovpn-dco";
+static const uint8_t ovpn_cmd_get_peer = 9;
+static const uint16_t ovpn_attr_ifindex = 1;
+static const uint16_t ovpn_attr_get_peer = 9;
+static const uint16_t ovpn_peer_id = 1;
+static const uint16_t ovpn_vpn_rx_bytes = 7;
+static const uint16_t ovpn_vpn_tx_bytes = 8;
+static const uint16_t ovpn_vpn_rx_packets = 9;
+static const uint16_t ovpn_vpn_tx_packets = 10;
+static const uint16_t ovpn_link_rx_bytes = 11;
+static const uint16_t ovpn_link_tx_bytes = 12;
+static const uint16_t ovpn_link_rx_packets = 13;
+static const uint16_t ovpn_link_tx_packets = 14;
+
+
+static void append_attr(std::vector<char>& buf, const uint16_t type,
+                        const void *data, const size_t len)
+{
+    size_t start = buf.size();
+    buf.resize(start + NLA_ALIGN(NLA_HDRLEN + len));
+    struct nlattr *nla = reinterpret_cast<struct nlattr *>(&buf[start]);
+    nla->nla_type = type;
+    nla->nla_len = NLA_HDRLEN + len;
+    memcpy(&buf[start + NLA_HDRLEN], data, len);
+}
+
+
+/**
+ *  Calls func(type, data, len) for each attribute in a buffer
+ */
+template <typename F>
+static void foreach_attr(const char *data, size_t len, F func)
+{
+    while (len >= NLA_HDRLEN)
+    {
+        const struct nlattr *nla = reinterpret_cast<const struct nlattr *>(data);
+        if (nla->nla_len < NLA_HDRLEN || nla->nla_len > len)
+        {
+            return;
+        }
+        func(nla->nla_type & NLA_TYPE_MASK, data + NLA_HDRLEN,
+             nla->nla_len - NLA_HDRLEN);
+
+        size_t next = NLA_ALIGN(nla->nla_len);
+        if (next >= len)
+        {
+            return;
+        }
+        data += next;
+        len -= next;
+    }
+}
+
+
+static uint64_t get_counter(const char *data, const size_t len)
+{
+    if (sizeof(uint64_t) == len)
+    {
+        uint64_t v;
+        memcpy(&v, data, sizeof(v));
+        return v;
+    }
+    else if (sizeof(uint32_t) == len)
+    {
+        uint32_t v;
+        memcpy(&v, data, sizeof(v));
+        return v;
+    }
+    return 0;
+}
+
+
+static void parse_peer(const char *data, const size_t len,
+                       NetCfg::DcoPeerCounters& peer)
+{
+    foreach_attr(data, len, [&peer](uint16_t type, const char *val, size_t vlen)
+                            {
+                                switch (type)
+                                {
+                                case ovpn_peer_id:
+                                    peer.peer_id = get_counter(val, vlen);
+                                    break;
+                                case ovpn_vpn_rx_bytes:
+                                    peer.vpn_rx_bytes = get_counter(val, vlen);
+                                    break;
+                                case ovpn_vpn_tx_bytes:
+                                    peer.vpn_tx_bytes = get_counter(val, vlen);
+                                    break;
+                                case ovpn_vpn_rx_packets:
+                                    peer.vpn_rx_packets = get_counter(val, vlen);
+                                    break;
+                                case ovpn_vpn_tx_packets:
+                                    peer.vpn_tx_packets = get_counter(val, vlen);
+                                    break;
+                                case ovpn_link_rx_bytes:
+                                    peer.link_rx_bytes = get_counter(val, vlen);
+                                    break;
+                                case ovpn_link_tx_bytes:
+                                    peer.link_tx_bytes = get_counter(val, vlen);
+                                    break;
+                                case ovpn_link_rx_packets:
+                                    peer.link_rx_packets = get_counter(val, vlen);
+                                    break;
+                                case ovpn_link_tx_packets:
+                                    peer.link_tx_packets = get_counter(val, vlen);
+                                    break;
+                                default:
+                                    break;
+                                }
+                            });
+}
+
+
+
+namespace NetCfg
+{
+    DcoPeerStats::DcoPeerStats()
+    {
+        sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+        if (sock < 0)
+        {
+            throw NetCfgException(std::string("Could not open generic netlink socket: ")
+                                  + strerror(errno));
+        }
+
+        struct sockaddr_nl local = {};
+        local.nl_family = AF_NETLINK;
+        if (0 != bind(sock, reinterpret_cast<struct sockaddr *>(&local),
+                      sizeof(local)))
+        {
+            std::string err(strerror(errno));
+            close(sock);
+            throw NetCfgException("Could not bind generic netlink socket: " + err);
+        }
+
+        struct timeval tv = {5, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        try
+        {
+            resolve_family();
+        }
+        catch (...)
+        {
+            close(sock);
+            throw;
+        }
+    }
+
+
+    DcoPeerStats::~DcoPeerStats()
+    {
+        if (sock >= 0)
+        {
+            close(sock);
+        }
+    }
+
+
+    std::vector<DcoPeerCounters> DcoPeerStats::Dump(const unsigned int ifindex)
+    {
+        std::vector<char> attrs;
+        uint32_t idx = ifindex;
+        append_attr(attrs, ovpn_attr_ifindex, &idx, sizeof(idx));
+
+        send_request(attrs, family_id, NLM_F_REQUEST | NLM_F_DUMP,
+                     ovpn_cmd_get_peer);
+
+        std::vector<DcoPeerCounters> peers;
+        receive(seq, &peers);
+        return peers;
+    }
+
+
+    void DcoPeerStats::resolve_family()
+    {
+        std::vector<char> attrs;
+        append_attr(attrs, CTRL_ATTR_FAMILY_NAME, ovpn_family_name,
+                    strlen(ovpn_family_name) + 1);
+
+        send_request(attrs, GENL_ID_CTRL, NLM_F_REQUEST | NLM_F_ACK,
+                     CTRL_CMD_GETFAMILY);
+        receive(seq, nullptr);
+        if (0 == family_id)
+        {
+            throw NetCfgException("The ovpn-dco generic netlink family "
+                                  "is not available");
+        }
+    }
+
+
+    void DcoPeerStats::send_request(std::vector<char>& attrs,
+                                    const uint16_t type,
+                                    const uint16_t flags,
+                                    const uint8_t cmd)
+    {
+        std::vector<char> buf(NLMSG_SPACE(GENL_HDRLEN));
+        buf.insert(buf.end(), attrs.begin(), attrs.end());
+
+        struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+        nh->nlmsg_len = buf.size();
+        nh->nlmsg_type = type;
+        nh->nlmsg_flags = flags;
+        nh->nlmsg_seq = ++seq;
+
+        struct genlmsghdr *gh = static_cast<struct genlmsghdr *>(NLMSG_DATA(nh));
+        gh->cmd = cmd;
+        gh->version = 1;
+
+        struct sockaddr_nl kernel = {};
+        kernel.nl_family = AF_NETLINK;
+
+        ssize_t ret = -1;
+        do
+        {
+            ret = sendto(sock, buf.data(), buf.size(), 0,
+                         reinterpret_cast<struct sockaddr *>(&kernel),
+                         sizeof(kernel));
+        } while (ret < 0 && EINTR == errno);
+
+        if (ret < 0 || (size_t) ret != buf.size())
+        {
+            throw NetCfgException(std::string("Sending generic netlink request failed: ")
+                                  + (ret < 0 ? strerror(errno) : "short write"));
+        }
+    }
+
+
+    void DcoPeerStats::receive(const uint32_t reqseq,
+                               std::vector<DcoPeerCounters>* peers)
+    {
+        std::vector<char> buf(65536);
+
+        while (true)
+        {
+            ssize_t len = recv(sock, buf.data(), buf.size(), 0);
+            if (len < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                throw NetCfgException(std::string("Receiving generic netlink "
+                                                  "response failed: ")
+                                      + strerror(errno));
+            }
+
+            int remain = len;
+            for (struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+                 NLMSG_OK(nh, remain);
+                 nh = NLMSG_NEXT(nh, remain))
+            {
+                if (nh->nlmsg_seq != reqseq)
+                {
+                    // Late responses to an earlier, failed request
+                    continue;
+                }
+
+                if (NLMSG_DONE == nh->nlmsg_type)
+                {
+                    return;
+                }
+                else if (NLMSG_ERROR == nh->nlmsg_type)
+                {
+                    const struct nlmsgerr *err = static_cast<struct nlmsgerr *>(NLMSG_DATA(nh));
+                    if (0 != err->error)
+                    {
+                        throw NetCfgException(std::string("Generic netlink request failed: ")
+                                              + strerror(-err->error));
+                    }
+                    return;
+                }
+
+                const char *data = static_cast<const char *>(NLMSG_DATA(nh)) + GENL_HDRLEN;
+                size_t datalen = NLMSG_PAYLOAD(nh, GENL_HDRLEN);
+
+                if (GENL_ID_CTRL == nh->nlmsg_type)
+                {
+                    foreach_attr(data, datalen,
+                                 [this](uint16_t type, const char *val, size_t vlen)
+                                 {
+                                     if (CTRL_ATTR_FAMILY_ID == type
+                                         && sizeof(uint16_t) == vlen)
+                                     {
+                                         memcpy(&family_id, val, sizeof(family_id));
+                                     }
+                                 });
+                }
+                else if (peers && family_id == nh->nlmsg_type)
+                {
+                    // Each peer is reported in its own message, with
+                    // its attributes nested in OVPN_ATTR_GET_PEER
+                    foreach_attr(data, datalen,
+                                 [peers](uint16_t type, const char *val, size_t vlen)
+                                 {
+                                     if (ovpn_attr_get_peer == type)
+                                     {
+                                         DcoPeerCounters peer;
+                                         parse_peer(val, vlen, peer);
+                                         peers->push_back(peer);
+                                     }
+                                 });
+                }
+            }
+        }
+    }
+} // namespace NetCfg
@@ -0,0 +1,101 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dco-peerstats.hpp
+ *
+ * @brief  Retrieves the per-peer traffic counters from the ovpn-dco
+ *         kernel module
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace NetCfg
+{
+    /**
+     *  Traffic counters of a single ovpn-dco peer, as reported by the
+     *  kernel module.  The vpn_* counters count the tunnelled traffic,
+     *  the link_* counters the encrypted traffic on the transport socket.
+     */
+    struct DcoPeerCounters
+    {
+        uint32_t peer_id = 0;
+        uint64_t vpn_rx_bytes = 0;
+        uint64_t vpn_tx_bytes = 0;
+        uint64_t vpn_rx_packets = 0;
+        uint64_t vpn_tx_packets = 0;
+        uint64_t link_rx_bytes = 0;
+        uint64_t link_tx_bytes = 0;
+        uint64_t link_rx_packets = 0;
+        uint64_t link_tx_packets = 0;
+    };
+
+
+    /**
+     *  Reads the counters of all peers on an ovpn-dco device with a
+     *  single generic netlink dump request.
+     *
+     *  The GeNL implementation in the OpenVPN 3 Core library does not
+     *  provide access to the peer counters, so this uses its own generic
+     *  netlink socket.  The socket and the resolved family ID are kept
+     *  for the lifetime of the object.
+     */
+    class DcoPeerStats
+    {
+    public:
+        using Ptr = std::unique_ptr<DcoPeerStats>;
+
+        /**
+         *  Opens the generic netlink socket and resolves the ovpn-dco
+         *  family.  Throws NetCfgException on errors.
+         */
+        DcoPeerStats();
+        ~DcoPeerStats();
+
+        DcoPeerStats(const DcoPeerStats&) = delete;
+        DcoPeerStats& operator=(const DcoPeerStats&) = delete;
+
+
+        /**
+         *  Retrieve the counters of all peers on a device.  Throws
+         *  NetCfgException on errors.
+         *
+         * @param ifindex  Interface index of the ovpn-dco device
+         *
+         * @return Returns a std::vector with the counters of each peer
+         */
+        std::vector<DcoPeerCounters> Dump(const unsigned int ifindex);
+
+
+    private:
+        int sock = -1;
+        uint16_t family_id = 0;
+        uint32_t seq = 0;
+
+        void resolve_family();
+        void send_request(std::vector<char>& buf, const uint16_t type,
+                          const uint16_t flags, const uint8_t cmd);
+        void receive(const uint32_t reqseq,
+                     std::vector<DcoPeerCounters>* peers);
+    };
+} // namespace NetCfg
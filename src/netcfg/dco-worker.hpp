@@ -0,0 +1,149 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dco-worker.hpp
+ *
+ * @brief  ASIO event loop shared by all the ovpn-dco devices in netcfg
+ */
+
+#pragma once
+#ifdef ENABLE_OVPNDCO
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <openvpn/io/io.hpp>
+#include <openvpn/asio/asiowork.hpp>
+
+#include "common/cpu-usage.hpp"
+
+
+namespace NetCfg
+{
+    /**
+     *  Runs the GeNL sockets and control channel pipes of all the
+     *  ovpn-dco devices in a single thread.  Each device still has its
+     *  own GeNL socket, which is bound to the interface index of the
+     *  device, but they are all served by the same event loop instead
+     *  of one thread per device.
+     *
+     *  Everything a device posts is run in the order it was posted.
+     *  Handlers must never block, as that would hold back all devices.
+     *
+     *  The thread is started when the first device needs it and runs
+     *  until the process exits.
+     */
+    class DcoWorker
+    {
+    public:
+        /**
+         * @return Returns the DcoWorker of this process
+         */
+        static DcoWorker& Instance()
+        {
+            static std::mutex mtx;
+            // Never destroyed; the last device may go away in the
+            // worker thread itself, which can then not be joined
+            static DcoWorker *instance = nullptr;
+
+            std::lock_guard<std::mutex> guard(mtx);
+            if (!instance)
+            {
+                instance = new DcoWorker();
+            }
+            return *instance;
+        }
+
+
+        openvpn_io::io_context& IOContext() noexcept
+        {
+            return io_context;
+        }
+
+
+        /**
+         *  Runs a function in the worker thread and waits until it has
+         *  completed.  Exceptions thrown by the function are rethrown
+         *  here.  Must not be called from the worker thread.
+         *
+         * @param func  Function to run
+         */
+        void RunAndWait(std::function<void()> func)
+        {
+            std::promise<void> done;
+            openvpn_io::post(io_context, [&func, &done]()
+                                         {
+                                             try
+                                             {
+                                                 func();
+                                                 done.set_value();
+                                             }
+                                             catch (...)
+                                             {
+                                                 done.set_exception(std::current_exception());
+                                             }
+                                         });
+            done.get_future().get();
+        }
+
+
+        /**
+         *  Samples the CPU usage of the worker thread.  The thread is
+         *  shared by all the ovpn-dco devices, so this covers the GeNL
+         *  and control channel handling of all of them.  Must not be
+         *  called from the worker thread.
+         *
+         * @return Returns a CpuUsage with the counters of the thread
+         */
+        CpuUsage GetUsage()
+        {
+            CpuUsage usage;
+            RunAndWait([&usage]()
+                       {
+                           usage = CpuUsage::Thread();
+                       });
+            return usage;
+        }
+
+
+        DcoWorker(const DcoWorker&) = delete;
+        DcoWorker& operator=(const DcoWorker&) = delete;
+
+
+    private:
+        openvpn_io::io_context io_context;
+        AsioWork work;
+        std::thread thread;
+
+
+        DcoWorker()
+            : work(io_context),
+              thread([this]()
+                     {
+                         io_context.run();
+                     })
+        {
+        }
+    };
+} // namespace NetCfg
+
+#endif  // ENABLE_OVPNDCO
@@ -0,0 +1,153 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   commit-queue.cpp
+ *
+ * @brief  Coalesces requests to apply DNS resolver settings into
+ *         a single commit, run in a separate thread (implementation)
+ */
+
+#include <iostream>
+
+#include "netcfg/dns/commit-queue.hpp"
+
+
+namespace NetCfg
+{
+namespace DNS
+{
+
+CommitQueue::CommitQueue(CommitFunc commit,
+                         const std::chrono::milliseconds delay)
+    : commit(std::move(commit)), delay(delay)
+{
+    thread = std::thread([this]()
+                         {
+                             run();
+                         });
+}
+
+
+CommitQueue::~CommitQueue()
+{
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+
+void CommitQueue::Request(Callback done)
+{
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (done)
+        {
+            pending.push_back(std::move(done));
+        }
+        requested = true;
+    }
+    cv.notify_all();
+}
+
+
+void CommitQueue::RequestAndWait()
+{
+    std::mutex done_mtx;
+    std::condition_variable done_cv;
+    bool done = false;
+
+    Request([&done_mtx, &done_cv, &done]()
+            {
+                std::lock_guard<std::mutex> guard(done_mtx);
+                done = true;
+                done_cv.notify_all();
+            });
+
+    std::unique_lock<std::mutex> lock(done_mtx);
+    done_cv.wait(lock, [&done]() { return done; });
+}
+
+
+uint64_t CommitQueue::GetCommitCount() const
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    return commits;
+}
+
+
+void CommitQueue::run()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true)
+    {
+        cv.wait(lock, [this]() { return requested || stopping; });
+        if (!requested)
+        {
+            // Stopping, and nothing left to commit
+            return;
+        }
+
+        // Give other devices being set up a chance to get their
+        // settings into the same commit
+        if (!stopping && delay.count() > 0)
+        {
+            cv.wait_for(lock, delay, [this]() { return stopping; });
+        }
+
+        std::vector<Callback> callbacks;
+        callbacks.swap(pending);
+        requested = false;
+        lock.unlock();
+
+        try
+        {
+            commit();
+        }
+        catch (const std::exception& excp)
+        {
+            std::cerr << "DNS resolver commit failed: " << excp.what()
+                      << std::endl;
+        }
+
+        lock.lock();
+        ++commits;
+        lock.unlock();
+
+        for (auto& cb : callbacks)
+        {
+            try
+            {
+                cb();
+            }
+            catch (const std::exception& excp)
+            {
+                std::cerr << "DNS resolver commit callback failed: "
+                          << excp.what() << std::endl;
+            }
+        }
+        lock.lock();
+    }
+}
+
+} // namespace DNS
+} // namespace NetCfg
@@ -0,0 +1,123 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   commit-queue.hpp
+ *
+ * @brief  Coalesces requests to apply DNS resolver settings into
+ *         a single commit, run in a separate thread (declaration)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace NetCfg
+{
+namespace DNS
+{
+    /**
+     *  Applying DNS resolver settings means rewriting resolv.conf or
+     *  several D-Bus calls to systemd-resolved, for all VPN sessions at
+     *  once.  When several devices are established at the same time,
+     *  each of them committing the settings does the same work many
+     *  times over.
+     *
+     *  The CommitQueue runs the commit in its own thread.  Requests
+     *  arriving within the commit delay of the first one, or while a
+     *  commit is running, are handled by a single following commit.
+     *  Each requester is told through its callback when a commit which
+     *  started after its request has completed.
+     */
+    class CommitQueue
+    {
+    public:
+        using Ptr = std::shared_ptr<CommitQueue>;
+        using CommitFunc = std::function<void()>;
+        using Callback = std::function<void()>;
+
+        /**
+         *  Starts the commit thread
+         *
+         * @param commit  Function applying all DNS resolver settings.
+         *                Exceptions thrown by it are logged to std::cerr
+         *                and otherwise ignored.
+         * @param delay   How long to wait for more requests before
+         *                starting a commit
+         */
+        CommitQueue(CommitFunc commit, const std::chrono::milliseconds delay);
+
+        /**
+         *  Runs the pending commit, if any, and stops the commit thread
+         */
+        ~CommitQueue();
+
+        CommitQueue(const CommitQueue&) = delete;
+        CommitQueue& operator=(const CommitQueue&) = delete;
+
+
+        /**
+         *  Request the DNS resolver settings to be applied.  This does
+         *  not block.
+         *
+         * @param done  Callback run in the commit thread when the
+         *              settings have been applied.  May be nullptr.
+         */
+        void Request(Callback done);
+
+
+        /**
+         *  Request the DNS resolver settings to be applied and wait
+         *  until this has happened.  Must not be called while holding
+         *  a lock the commit function takes.
+         */
+        void RequestAndWait();
+
+
+        /**
+         * @return Returns the number of commits run so far
+         */
+        uint64_t GetCommitCount() const;
+
+
+    private:
+        CommitFunc commit;
+        const std::chrono::milliseconds delay;
+
+        mutable std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<Callback> pending;
+        bool requested = false;
+        bool stopping = false;
+        uint64_t commits = 0;
+        std::thread thread;
+
+        void run();
+    };
+
+} // namespace DNS
+} // namespace NetCfg
@@ -0,0 +1,119 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   lazy-resolver-backend.cpp
+ *
+ * @brief  Resolver backend wrapper which sets up the real backend on
+ *         first use (implementation)
+ */
+
+#include <iostream>
+
+#include "netcfg/dns/lazy-resolver-backend.hpp"
+
+
+namespace NetCfg
+{
+namespace DNS
+{
+
+LazyResolverBackend::LazyResolverBackend(const std::string& info,
+                                         const ApplySettingsMode mode,
+                                         Factory factory,
+                                         ResolverBackendInterface::Ptr fallback)
+    : info(info),
+      mode(mode),
+      factory(factory),
+      fallback(fallback)
+{
+}
+
+
+const std::string LazyResolverBackend::GetBackendInfo() const noexcept
+{
+    std::lock_guard<std::mutex> guard(init_mtx);
+    if (initialized)
+    {
+        return (backend ? backend->GetBackendInfo() : info + " (unavailable)");
+    }
+    return info;
+}
+
+
+const ApplySettingsMode LazyResolverBackend::GetApplyMode() const noexcept
+{
+    ResolverBackendInterface *be = get();
+    return (be ? be->GetApplyMode() : mode);
+}
+
+
+void LazyResolverBackend::Apply(const ResolverSettings::Ptr settings)
+{
+    ResolverBackendInterface *be = get();
+    if (be)
+    {
+        be->Apply(settings);
+    }
+}
+
+
+void LazyResolverBackend::Commit(NetCfgSignals *signals)
+{
+    {
+        // Nothing can have been applied before the backend exists
+        std::lock_guard<std::mutex> guard(init_mtx);
+        if (!initialized)
+        {
+            return;
+        }
+    }
+    ResolverBackendInterface *be = get();
+    if (be)
+    {
+        be->Commit(signals);
+    }
+}
+
+
+ResolverBackendInterface *LazyResolverBackend::get() const noexcept
+{
+    std::lock_guard<std::mutex> guard(init_mtx);
+    if (!initialized)
+    {
+        initialized = true;
+        try
+        {
+            backend = factory();
+        }
+        catch (const std::exception& excp)
+        {
+            std::cerr << "*** ERROR *** "<< excp.what() << std::endl;
+        }
+        if (!backend)
+        {
+            backend = fallback;
+        }
+        fallback.reset();
+    }
+    return backend.get();
+}
+
+} // namespace DNS
+} // namespace NetCfg
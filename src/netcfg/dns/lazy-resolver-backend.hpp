@@ -0,0 +1,101 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   lazy-resolver-backend.hpp
+ *
+ * @brief  Resolver backend wrapper which sets up the real backend on
+ *         first use (declaration)
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <openvpn/common/rc.hpp>
+
+#include "netcfg/netcfg-signals.hpp"
+#include "netcfg/dns/resolver-settings.hpp"
+#include "netcfg/dns/resolver-backend-interface.hpp"
+
+using namespace openvpn;
+
+namespace NetCfg
+{
+namespace DNS
+{
+    /**
+     *  Some resolver backends need to talk to other services when they
+     *  are set up, which may activate those services.  This wrapper
+     *  postpones creating such a backend until DNS settings are actually
+     *  applied, so the net.openvpn.v3.netcfg service does not wait for
+     *  them when it starts.
+     */
+    class LazyResolverBackend : public ResolverBackendInterface
+    {
+    public:
+        typedef RCPtr<LazyResolverBackend> Ptr;
+        typedef std::function<ResolverBackendInterface::Ptr()> Factory;
+
+        /**
+         *  Prepares the lazy backend
+         *
+         * @param info      Backend information reported until the real
+         *                  backend has been created
+         * @param mode      ApplySettingsMode reported if no backend
+         *                  could be created
+         * @param factory   Function creating the real backend.  An
+         *                  exception thrown by it is logged.
+         * @param fallback  Backend to use if the factory fails.  May be
+         *                  nullptr, in which case all DNS settings are
+         *                  ignored.
+         */
+        LazyResolverBackend(const std::string& info,
+                            const ApplySettingsMode mode,
+                            Factory factory,
+                            ResolverBackendInterface::Ptr fallback = nullptr);
+        ~LazyResolverBackend() = default;
+
+        const std::string GetBackendInfo() const noexcept override;
+        const ApplySettingsMode GetApplyMode() const noexcept override;
+        void Apply(const ResolverSettings::Ptr settings) override;
+        void Commit(NetCfgSignals *signals) override;
+
+
+    private:
+        const std::string info;
+        const ApplySettingsMode mode;
+        Factory factory;
+        mutable ResolverBackendInterface::Ptr fallback;
+        mutable ResolverBackendInterface::Ptr backend;
+        mutable bool initialized = false;
+        mutable std::mutex init_mtx;
+
+        /**
+         *  Creates the real backend the first time it is needed
+         *
+         * @return  Returns a pointer to the backend to use, or nullptr
+         *          if there is none
+         */
+        ResolverBackendInterface *get() const noexcept;
+    };
+} // namespace DNS
+} // namespace NetCfg
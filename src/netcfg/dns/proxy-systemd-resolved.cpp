@@ -175,18 +175,25 @@ namespace resolved {
     }
 
 
-    void Link::SetDNSServers(const ResolverRecord::List& servers) const
+    static GVariant* build_dns_servers(const ResolverRecord::List& servers)
     {
         GVariantBuilder* b = g_variant_builder_new(G_VARIANT_TYPE("a(iay)"));
         for (const auto& srv : servers)
         {
             g_variant_builder_add_value(b, srv.GetGVariant());
         }
+        return GLibUtils::wrapInTuple(b);
+    }
 
-        GVariant* r = Call("SetDNS", GLibUtils::wrapInTuple(b));
+
+    void Link::SetDNSServers(const ResolverRecord::List& servers) const
+    {
+        GVariant* r = Call("SetDNS", build_dns_servers(servers));
         g_variant_unref(r);
     }
 
+
+
     const std::string Link::GetCurrentDNSServer() const
     {
         GVariant* r = nullptr;
@@ -232,19 +239,25 @@ namespace resolved {
     }
 
 
-    void Link::SetDomains(const SearchDomain::List& doms) const
+    static GVariant* build_domains(const SearchDomain::List& doms)
     {
         GVariantBuilder* b = g_variant_builder_new(G_VARIANT_TYPE("a(sb)"));
         for (const auto& dom : doms)
         {
             g_variant_builder_add_value(b, dom.GetGVariant());
         }
+        return GLibUtils::wrapInTuple(b);
+    }
+
 
-        GVariant* r = Call("SetDomains", GLibUtils::wrapInTuple(b));
+    void Link::SetDomains(const SearchDomain::List& doms) const
+    {
+        GVariant* r = Call("SetDomains", build_domains(doms));
         g_variant_unref(r);
     }
 
 
+
     bool Link::GetDefaultRoute() const
     {
         try
@@ -278,6 +291,7 @@ namespace resolved {
     }
 
 
+
     //
     //  NetCfg::DNS::resolved::Manager
     //
@@ -306,6 +320,25 @@ namespace resolved {
 
 
     Link::Ptr Manager::RetrieveLink(const std::string dev_name)
+    {
+        Link::Ptr ret;
+        ret.reset(new Link(GetConnection(),
+                           GetLink(GetInterfaceIndex(dev_name))));
+        return ret;
+    }
+
+
+    std::string Manager::GetLink(unsigned int if_idx)
+    {
+        GVariant* res = Call("GetLink", g_variant_new("(i)", if_idx));
+        GLibUtils::checkParams("GetLink", res, "(o)", 1);
+        std::string link_path = GLibUtils::ExtractValue<std::string>(res, 0);
+        g_variant_unref(res);
+        return link_path;
+    }
+
+
+    unsigned int Manager::GetInterfaceIndex(const std::string& dev_name)
     {
         unsigned int if_idx = ::if_nametoindex(dev_name.c_str());
         if (0 == if_idx)
@@ -315,20 +348,45 @@ namespace resolved {
                 << std::string(::strerror(errno));
             throw Exception(err.str());
         }
+        return if_idx;
+    }
 
-        Link::Ptr ret;
-        ret.reset(new Link(GetConnection(), GetLink(if_idx)));
-        return ret;
+
+    DBusProxyAsyncCall::Ptr Manager::SetLinkDNSServersAsync(const std::string& link_path,
+                                                            const ResolverRecord::List& servers,
+                                                            DBusProxyAsyncCall::Callback callback) const
+    {
+        return link_call(link_path, "SetDNS", build_dns_servers(servers),
+                         callback);
     }
 
 
-    std::string Manager::GetLink(unsigned int if_idx)
+    DBusProxyAsyncCall::Ptr Manager::SetLinkDomainsAsync(const std::string& link_path,
+                                                         const SearchDomain::List& doms,
+                                                         DBusProxyAsyncCall::Callback callback) const
     {
-        GVariant* res = Call("GetLink", g_variant_new("(i)", if_idx));
-        GLibUtils::checkParams("GetLink", res, "(o)", 1);
-        std::string link_path = GLibUtils::ExtractValue<std::string>(res, 0);
-        g_variant_unref(res);
-        return link_path;
+        return link_call(link_path, "SetDomains", build_domains(doms),
+                         callback);
+    }
+
+
+    DBusProxyAsyncCall::Ptr Manager::RevertLinkAsync(const std::string& link_path,
+                                                     DBusProxyAsyncCall::Callback callback) const
+    {
+        return link_call(link_path, "Revert", nullptr, callback);
+    }
+
+
+    DBusProxyAsyncCall::Ptr Manager::link_call(const std::string& link_path,
+                                               const std::string& method,
+                                               GVariant *params,
+                                               DBusProxyAsyncCall::Callback callback) const
+    {
+        return DBusProxyAsyncCall::Start(GetConnection(),
+                                         "org.freedesktop.resolve1",
+                                         link_path,
+                                         "org.freedesktop.resolve1.Link",
+                                         method, params, callback);
     }
 
 } // namespace resolved
@@ -46,6 +46,11 @@ namespace resolved {
 
         GVariant *GetGVariant() const;
 
+        bool operator==(const ResolverRecord& cmp) const
+        {
+            return family == cmp.family && server == cmp.server;
+        }
+
         unsigned short family;
         std::string server;
     };
@@ -61,6 +66,11 @@ namespace resolved {
 
         GVariant *GetGVariant() const;
 
+        bool operator==(const SearchDomain& cmp) const
+        {
+            return search == cmp.search && routing == cmp.routing;
+        }
+
         std::string search;
         bool routing;
     };
@@ -97,9 +107,11 @@ namespace resolved {
         const std::string GetPath() const;
         const std::vector<std::string> GetDNSServers() const;
         void SetDNSServers(const ResolverRecord::List& servers) const;
+
         const std::string GetCurrentDNSServer() const;
         const SearchDomain::List GetDomains() const;
         void SetDomains(const SearchDomain::List& doms) const;
+
         bool GetDefaultRoute() const;
         void SetDefaultRoute(const bool route) const;
         void Revert() const;
@@ -115,6 +127,67 @@ namespace resolved {
         Link::Ptr RetrieveLink(const std::string dev_name);
 
         std::string GetLink(unsigned int if_idx);
+
+        /**
+         *  Looks up the interface index of a network device.  Throws
+         *  Exception if the device does not exist.
+         *
+         * @param dev_name  std::string with the device name
+         *
+         * @return Returns the interface index
+         */
+        static unsigned int GetInterfaceIndex(const std::string& dev_name);
+
+        /**
+         *  Sets the DNS servers of a link asynchronously.  The call is
+         *  sent directly to the link object, without setting up a Link
+         *  proxy for it.
+         *
+         * @param link_path  std::string with the link object path, as
+         *                   returned by GetLink()
+         * @param servers    ResolverRecord::List of DNS servers to set
+         * @param callback   DBusProxyAsyncCall::Callback called when
+         *                   systemd-resolved has responded
+         *
+         * @return Returns a DBusProxyAsyncCall::Ptr handle for the call
+         */
+        DBusProxyAsyncCall::Ptr SetLinkDNSServersAsync(const std::string& link_path,
+                                                       const ResolverRecord::List& servers,
+                                                       DBusProxyAsyncCall::Callback callback) const;
+
+        /**
+         *  Sets the search domains of a link asynchronously, like
+         *  SetLinkDNSServersAsync()
+         *
+         * @param link_path  std::string with the link object path
+         * @param doms       SearchDomain::List of search domains to set
+         * @param callback   DBusProxyAsyncCall::Callback called when
+         *                   systemd-resolved has responded
+         *
+         * @return Returns a DBusProxyAsyncCall::Ptr handle for the call
+         */
+        DBusProxyAsyncCall::Ptr SetLinkDomainsAsync(const std::string& link_path,
+                                                    const SearchDomain::List& doms,
+                                                    DBusProxyAsyncCall::Callback callback) const;
+
+        /**
+         *  Reverts the DNS settings of a link asynchronously, like
+         *  SetLinkDNSServersAsync()
+         *
+         * @param link_path  std::string with the link object path
+         * @param callback   DBusProxyAsyncCall::Callback called when
+         *                   systemd-resolved has responded
+         *
+         * @return Returns a DBusProxyAsyncCall::Ptr handle for the call
+         */
+        DBusProxyAsyncCall::Ptr RevertLinkAsync(const std::string& link_path,
+                                                DBusProxyAsyncCall::Callback callback) const;
+
+    private:
+        DBusProxyAsyncCall::Ptr link_call(const std::string& link_path,
+                                          const std::string& method,
+                                          GVariant *params,
+                                          DBusProxyAsyncCall::Callback callback) const;
     };
 } // namespace resolved
 } // namespace DNS
@@ -28,13 +28,17 @@
 
 
 #include <algorithm>
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <openvpn/common/rc.hpp>
 
@@ -65,6 +69,7 @@ FileGenerator::~FileGenerator()
 void FileGenerator::SetFilename(const std::string& fname) noexcept
 {
     filename = fname;
+    written = false;
 }
 
 
@@ -88,6 +93,13 @@ const std::string FileGenerator::GetBackupFilename() const noexcept
 
 void FileGenerator::Read()
 {
+    // Whatever Write() put into the file is still in file_contents
+    if (file_unchanged())
+    {
+        return;
+    }
+    written = false;
+
     std::ifstream input(filename);
     file_contents.clear();
     for (std::string line; std::getline(input, line);)
@@ -105,7 +117,7 @@ void FileGenerator::Read()
  *  the same filename, the old backup file is automatically removed.
  *
  */
-void FileGenerator::Write()
+bool FileGenerator::Write()
 {
     if (filename == backup_filename)
     {
@@ -113,7 +125,59 @@ void FileGenerator::Write()
                               "cannot be identical");
     }
 
-    // If we're going to take a backup if the file exists
+    std::string body;
+    for (const auto& line : file_contents)
+    {
+        body += line + "\n";
+    }
+    size_t hash = std::hash<std::string>()(body);
+    if (hash == written_hash && file_unchanged())
+    {
+        return false;
+    }
+
+    // Prepare the new file next to the destination, so it can be
+    // moved into place with a single rename()
+    std::string content;
+    for (const auto& line : generate_header())
+    {
+        content += line + "\n";
+    }
+    content += body;
+
+    std::vector<char> tmpname(filename.begin(), filename.end());
+    const std::string suffix(".XXXXXX");
+    tmpname.insert(tmpname.end(), suffix.begin(), suffix.end());
+    tmpname.push_back('\0');
+    int fd = mkstemp(tmpname.data());
+    if (fd < 0)
+    {
+        throw NetCfgException("Could not create a temporary file for '"
+                              + filename + "': " + strerror(errno));
+    }
+
+    bool success = (0 == fchmod(fd, 0644));
+    for (size_t pos = 0; success && pos < content.size();)
+    {
+        ssize_t r = ::write(fd, content.data() + pos, content.size() - pos);
+        if (r < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        success = (r > 0);
+        pos += (success ? r : 0);
+    }
+    success = success && (0 == fsync(fd));
+    std::string err(success ? "" : strerror(errno));
+    ::close(fd);
+    if (!success)
+    {
+        ::unlink(tmpname.data());
+        throw NetCfgException("Could not write '" + filename + "': " + err);
+    }
+
+    // If we're going to take a backup if the file exists.  A hard link
+    // keeps the original file in place until it is replaced below.
     if (!backup_filename.empty() && !backup_active
         && file_exists(filename))
     {
@@ -121,20 +185,26 @@ void FileGenerator::Write()
         {
             std::remove(backup_filename.c_str());
         }
-        if (0 != std::rename(filename.c_str(), backup_filename.c_str()))
+        if (0 != ::link(filename.c_str(), backup_filename.c_str())
+            && 0 != std::rename(filename.c_str(), backup_filename.c_str()))
         {
+            ::unlink(tmpname.data());
             throw NetCfgException("Could not rename '" + filename +"'"
                                   + " to '" + backup_filename + "'");
         }
         backup_active = true;
     }
 
-    // Open the destination file, generate contents and write to disk
-    std::fstream output(filename, output.out);
-    for (const auto& line : file_contents)
+    if (0 != std::rename(tmpname.data(), filename.c_str()))
     {
-        output << line << std::endl;;
+        err = strerror(errno);
+        ::unlink(tmpname.data());
+        throw NetCfgException("Could not replace '" + filename + "': " + err);
     }
+
+    written_hash = hash;
+    written = (0 == stat(filename.c_str(), &written_stat));
+    return true;
 }
 
 
@@ -157,17 +227,40 @@ void FileGenerator::RestoreBackup()
                               + " is missing");
     }
 
-    if (0 != std::remove(filename.c_str()))
-    {
-        throw NetCfgException("Failed removing '" + filename + "'");
-    }
-
+    // rename() replaces the current file atomically
     if (0 != std::rename(backup_filename.c_str(), filename.c_str()))
     {
         throw NetCfgException("Failed restoring '" + filename + "'"
                               + " from '" + backup_filename + "'");
     }
     backup_active = false;
+    written = false;
+}
+
+
+std::vector<std::string> FileGenerator::generate_header()
+{
+    return {};
+}
+
+
+bool FileGenerator::file_unchanged() noexcept
+{
+    if (!written)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (0 != stat(filename.c_str(), &st))
+    {
+        return false;
+    }
+    return st.st_dev == written_stat.st_dev
+           && st.st_ino == written_stat.st_ino
+           && st.st_size == written_stat.st_size
+           && st.st_mtim.tv_sec == written_stat.st_mtim.tv_sec
+           && st.st_mtim.tv_nsec == written_stat.st_mtim.tv_nsec;
 }
 
 
@@ -199,6 +292,8 @@ ResolvConfFile::ResolvConfFile(const std::string& filename,
 
 ResolvConfFile::~ResolvConfFile()
 {
+    std::lock_guard<std::mutex> guard(change_guard);
+    cancel_update();
     RestoreBackup();
 }
 
@@ -254,6 +349,18 @@ void ResolvConfFile::Apply(const ResolverSettings::Ptr settings)
                                  "", {{"search_domain", e}});
             notification_queue.push_back(ev);
         }
+
+        if (stub)
+        {
+            // The search domains of a session are routed to its own
+            // name servers
+            vpn_routes.push_back({dmns, srvs});
+            if (DNS::Scope::GLOBAL == settings->GetDNSScope())
+            {
+                vpn_global_servers.insert(vpn_global_servers.end(),
+                                          srvs.begin(), srvs.end());
+            }
+        }
     }
     else
     {
@@ -277,8 +384,9 @@ void ResolvConfFile::Apply(const ResolverSettings::Ptr settings)
     }
 
     // Prepare to add a warning to the logs if DNS scope is not GLOBAL
-    // resolv.conf based resolver does not support any other modes
-    dns_scope_non_global = settings->GetDNSScope() != DNS::Scope::GLOBAL;
+    // resolv.conf based resolver does not support any other modes,
+    // unless the stub resolver takes care of the routing
+    dns_scope_non_global = !stub && settings->GetDNSScope() != DNS::Scope::GLOBAL;
 
     ++modified_count;
 }
@@ -289,20 +397,106 @@ void ResolvConfFile::Commit(NetCfgSignals *signal)
     // Add a lock guard here, to avoid potentially multiple calls colliding
     std::lock_guard<std::mutex> guard(change_guard);
 
+    // Each SettingsManager::ApplySettings() call passes the settings of
+    // all VPN sessions, so only the last set is needed for the file
+    // update.  The file is updated once per main loop iteration.
+    pending_name_servers = std::move(vpn_name_servers);
+    pending_search_domains = std::move(vpn_search_domains);
+    pending_modified = modified_count;
+    pending_routes = std::move(vpn_routes);
+    pending_global_servers = std::move(vpn_global_servers);
+    vpn_name_servers.clear();
+    vpn_search_domains.clear();
+    vpn_routes.clear();
+    vpn_global_servers.clear();
+    if (0 == update_id)
+    {
+        update_id = g_idle_add(update_file_idle, this);
+    }
+
+    // Send all NetworkChange events in the notification queue
+    if (signal)
+    {
+        if (dns_scope_non_global)
+        {
+            signal->LogWarn("DNS Scope change ignored. Only global scope supported");
+        }
+
+        for (const auto& ev : notification_queue)
+        {
+            signal->NetworkChange(ev);
+        }
+    }
+    notification_queue.clear();
+
+    modified_count = 0;
+}
+
+
+void ResolvConfFile::Restore()
+{
+    std::lock_guard<std::mutex> guard(change_guard);
+    cancel_update();
+    RestoreBackup();
+}
+
+
+void ResolvConfFile::SetStubResolver(StubResolver::Ptr stub_resolver)
+{
+    std::lock_guard<std::mutex> guard(change_guard);
+    stub = stub_resolver;
+}
+
+
+std::vector<std::string> ResolvConfFile::generate_header()
+{
+    return {"#",
+            "# Generated by OpenVPN 3 Linux (NetCfg::DNS::ResolvConfFile)",
+            "# Last updated: " + GetTimestamp(),
+            "#"};
+}
+
+
+void ResolvConfFile::update_file()
+{
+    std::lock_guard<std::mutex> guard(change_guard);
+    update_id = 0;
+
+    vpn_name_servers = std::move(pending_name_servers);
+    vpn_search_domains = std::move(pending_search_domains);
+    pending_name_servers.clear();
+    pending_search_domains.clear();
+
     // Read and parse the current resolv.conf file
     Read();
     parse();
 
+    std::vector<StubResolver::Route> routes = std::move(pending_routes);
+    std::vector<std::string> global_servers = std::move(pending_global_servers);
+    pending_routes.clear();
+    pending_global_servers.clear();
+
     // Generate the new file and write it to disk
     // if DNS resolver configs from VPN sessions
     // needs to be applied
-    if (modified_count > 0)
+    if (pending_modified > 0)
     {
+        if (stub)
+        {
+            stub->SetRoutes((global_servers.empty() ? sys_name_servers
+                                                    : global_servers),
+                            routes);
+        }
         generate();
         Write();
     }
     else
     {
+        if (stub)
+        {
+            stub->SetRoutes({}, {});
+        }
+
         // If no changes is needed, restore the
         // original resolv.conf file
         RestoreBackup();
@@ -314,30 +508,36 @@ void ResolvConfFile::Commit(NetCfgSignals *signal)
         // parsed system settings
         sys_name_servers.clear();
         sys_search_domains.clear();
+        vpn_name_servers.clear();
+        vpn_search_domains.clear();
     }
+}
 
-    // Send all NetworkChange events in the notification queue
-    if (signal)
-    {
-        if (dns_scope_non_global)
-        {
-            signal->LogWarn("DNS Scope change ignored. Only global scope supported");
-        }
 
-        for (const auto& ev : notification_queue)
-        {
-            signal->NetworkChange(ev);
-        }
+gboolean ResolvConfFile::update_file_idle(gpointer data)
+{
+    ResolvConfFile *self = static_cast<ResolvConfFile *>(data);
+    try
+    {
+        self->update_file();
     }
-    notification_queue.clear();
-
-    modified_count = 0;
+    catch (const NetCfgException& excp)
+    {
+        std::cerr << "** ERROR ** Updating "
+                  << self->GetFilename() << " failed: "
+                  << excp.what() << std::endl;
+    }
+    return G_SOURCE_REMOVE;
 }
 
 
-void ResolvConfFile::Restore()
+void ResolvConfFile::cancel_update()
 {
-    RestoreBackup();
+    if (update_id > 0)
+    {
+        g_source_remove(update_id);
+        update_id = 0;
+    }
 }
 
 #ifdef ENABLE_DEBUG
@@ -474,6 +674,12 @@ void ResolvConfFile::parse()
     //
     for (const auto& srv : rslv_servers)
     {
+        // Our own stub resolver is never a system name server
+        if (stub && srv == stub->GetListenAddress())
+        {
+            continue;
+        }
+
         auto sys = std::find(sys_name_servers.begin(),
                              sys_name_servers.end(),
                              srv);
@@ -519,13 +725,10 @@ void ResolvConfFile::parse()
  */
 void ResolvConfFile::generate()
 {
+    // The comment header is added by generate_header() when writing,
+    // so the timestamp does not make unchanged contents look modified
     file_contents.clear();
 
-    file_contents.push_back("#");
-    file_contents.push_back("# Generated by OpenVPN 3 Linux (NetCfg::DNS::ResolvConfFile)");
-    file_contents.push_back("# Last updated: " + GetTimestamp());
-    file_contents.push_back("#");
-
     //
     //  'search <list-of-domains>' line
     //
@@ -544,9 +747,19 @@ void ResolvConfFile::generate()
     }
 
     //
-    //  'nameserver' lines, first VPN related ones then system
+    //  'nameserver' lines, first VPN related ones then system.  With
+    //  the stub resolver, it is the only name server and forwards the
+    //  queries to the others
     //
-    if (vpn_name_servers.size() > 0)
+    if (stub)
+    {
+        file_contents.push_back("");
+        file_contents.push_back("# OpenVPN stub resolver, forwarding to the "
+                                "VPN and system name servers");
+        file_contents.push_back("nameserver " + stub->GetListenAddress());
+    }
+
+    if (!stub && vpn_name_servers.size() > 0)
     {
         file_contents.push_back("");
         file_contents.push_back("# OpenVPN defined name servers");
@@ -556,7 +769,7 @@ void ResolvConfFile::generate()
         }
     }
 
-    if (sys_name_servers.size() > 0)
+    if (!stub && sys_name_servers.size() > 0)
     {
         file_contents.push_back("");
         file_contents.push_back("# System defined name servers");
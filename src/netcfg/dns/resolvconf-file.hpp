@@ -32,6 +32,9 @@
 #include <mutex>
 #include <string>
 #include <vector>
+#include <sys/stat.h>
+
+#include <glib.h>
 
 #include <openvpn/common/rc.hpp>
 
@@ -40,6 +43,7 @@ using namespace openvpn;
 #include "netcfg/netcfg-signals.hpp"
 #include "netcfg/dns/resolver-settings.hpp"
 #include "netcfg/dns/resolver-backend-interface.hpp"
+#include "netcfg/dns/stub-resolver.hpp"
 
 
 namespace NetCfg
@@ -56,6 +60,10 @@ namespace DNS
      *  implementing this class.  The @generate() and @parse() methods needs
      *  to be implemented for this class to work.
      *
+     *  Files are replaced atomically, via a temporary file which is
+     *  renamed over the original file.  A hash of the contents last
+     *  written is kept, and the file is not rewritten if neither the
+     *  contents nor the file on disk has changed since.
      */
     class FileGenerator
     {
@@ -112,7 +120,9 @@ namespace DNS
 
         /**
          *  Reads the file and saves the contents into the
-         *  protected: files_content variable
+         *  protected: files_content variable.  If the file has not been
+         *  modified since the last Write(), the file is not read again and
+         *  file_contents is left as is.
          */
         void Read();
 
@@ -123,8 +133,10 @@ namespace DNS
          *  anything else is done.  If a backupfile already exists with
          *  the same filename, the old backup file is automatically removed.
          *
+         *  @return Returns true if the file was written, false if the
+         *          file already has this content
          */
-        void Write();
+        bool Write();
 
 
         /**
@@ -134,10 +146,34 @@ namespace DNS
         void RestoreBackup();
 
 
+        /**
+         *  Lines to put on top of the file by @Write(), which are not
+         *  considered when checking if the file contents has changed.
+         *  Intended for comments with timestamps and similar details.
+         *
+         * @return Returns a std::vector<std::string> with the header lines.
+         *         The default implementation returns no lines.
+         */
+        virtual std::vector<std::string> generate_header();
+
+
     private:
         std::string filename = "";
         std::string backup_filename= "";
         bool backup_active = false;
+        bool written = false;        ///< written_hash/written_stat are valid
+        size_t written_hash = 0;     ///< Hash of the contents last written
+        struct stat written_stat;    ///< File status right after the write
+
+
+        /**
+         *  Check if the file is still the one written by @Write(), by
+         *  comparing the inode, size and modification time.
+         *
+         * @return Returns true if the file has not been touched since the
+         *         last @Write()
+         */
+        bool file_unchanged() noexcept;
 
 
         /**
@@ -214,6 +250,10 @@ namespace DNS
          *  Completes the DNS resolver configuration by performing the
          *  changes on the system.
          *
+         *  The file itself is updated from the GLib main loop, so several
+         *  Commit() calls within the same main loop iteration results in
+         *  a single file update with the settings of the last call.
+         *
          *  @param signal  Pointer to a NetCfgSignals object where
          *                 "NetworkChange" signals will be issued
          */
@@ -221,11 +261,25 @@ namespace DNS
 
 
         /**
-         *  Restore the backup resolv.conf file if present
+         *  Restore the backup resolv.conf file if present.  Any file
+         *  update not yet done is discarded.
          */
         void Restore();
 
 
+        /**
+         *  Routes all DNS queries through a local StubResolver.  The
+         *  resolv.conf file then only lists the stub resolver as name
+         *  server, and the stub resolver is given the name servers of
+         *  each VPN session with its search domains as routing domains.
+         *  The DNS scope of each session is respected: only sessions with
+         *  the global scope replace the system name servers.
+         *
+         * @param stub_resolver  StubResolver::Ptr to the stub resolver to use
+         */
+        void SetStubResolver(StubResolver::Ptr stub_resolver);
+
+
 #ifdef ENABLE_DEBUG
         /**
          *  Misc debug methods used by test programs
@@ -239,8 +293,16 @@ namespace DNS
 #endif
 
 
+    protected:
+        std::vector<std::string> generate_header() override;
+
+
     private:
         std::mutex change_guard;
+        guint update_id = 0;         ///< Pending update_file() idle source
+        std::vector<std::string> pending_name_servers;
+        std::vector<std::string> pending_search_domains;
+        unsigned int pending_modified = 0;
         std::vector<std::string> unprocessed_lines;
         std::vector<std::string> vpn_name_servers;
         std::vector<std::string> vpn_name_servers_removed;
@@ -249,6 +311,11 @@ namespace DNS
         std::vector<std::string> sys_name_servers;
         std::vector<std::string> sys_search_domains;
         std::vector<NetCfgChangeEvent> notification_queue;
+        StubResolver::Ptr stub;
+        std::vector<StubResolver::Route> vpn_routes;        ///< Stub resolver only
+        std::vector<std::string> vpn_global_servers;        ///< Stub resolver only
+        std::vector<StubResolver::Route> pending_routes;
+        std::vector<std::string> pending_global_servers;
         bool dns_scope_non_global = false;
         unsigned int modified_count = 0;
 
@@ -268,6 +335,21 @@ namespace DNS
          *  The data to be written to disk will be in the resolv.conf format
          */
         void generate();
+
+
+        /**
+         *  Updates the file with the settings from the last @Commit()
+         *  call.  Called from the GLib main loop.
+         */
+        void update_file();
+
+        static gboolean update_file_idle(gpointer data);
+
+        /**
+         *  Removes the update_file() idle source, if scheduled.  Must be
+         *  called with change_guard held.
+         */
+        void cancel_update();
     };
 } // namespace DNS
 } // namespace NetCfg
@@ -101,6 +101,18 @@ namespace DNS
          *                   resolver changes
          */
         virtual void Commit(NetCfgSignals *signals) = 0;
+
+
+        /**
+         *  Called when a network device has been removed from the host,
+         *  after its resolver settings have been committed for removal.
+         *  Backends caching per-device information must drop it here.
+         *
+         * @param dev_name  std::string with the name of the removed device
+         */
+        virtual void DeviceRemoved(const std::string& dev_name)
+        {
+        }
     };
 }
 }
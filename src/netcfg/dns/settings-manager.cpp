@@ -134,6 +134,12 @@ void SettingsManager::ApplySettings(NetCfgSignals *signal)
 }
 
 
+void SettingsManager::DeviceRemoved(const std::string& dev_name)
+{
+    backend->DeviceRemoved(dev_name);
+}
+
+
 std::vector<std::string> SettingsManager::GetDNSservers() const
 {
     std::vector<std::string> ret;
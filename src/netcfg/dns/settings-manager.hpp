@@ -85,6 +85,14 @@ namespace DNS
              */
             void ApplySettings(NetCfgSignals *signal);
 
+            /**
+             *  Notify the backend about a network device which has been
+             *  removed from the host
+             *
+             * @param dev_name  std::string with the removed device name
+             */
+            void DeviceRemoved(const std::string& dev_name);
+
             /**
              *  Retrieve the full list of all configured DNS servers
              *  for all VPN sessions
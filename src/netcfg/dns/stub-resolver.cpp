@@ -0,0 +1,938 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   stub-resolver.cpp
+ *
+ * @brief  Implementation of NetCfg::DNS::StubResolver
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "netcfg/netcfg-exception.hpp"
+#include "netcfg/dns/stub-resolver.hpp"
+
+
+/// How long to wait for a name server before trying the next one
+static const std::chrono::milliseconds upstream_timeout(2000);
+
+/// Most TCP connections served at the same time
+static const unsigned int max_tcp_clients = 16;
+
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+
+static inline void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = (v >> 16) & 0xff;
+    p[2] = (v >> 8) & 0xff;
+    p[3] = v & 0xff;
+}
+
+
+/**
+ *  Lower cases a domain name and strips the routing domain prefix
+ *  ('~') and leading and trailing dots
+ */
+static std::string normalize_domain(const std::string& domain)
+{
+    std::string ret(domain);
+    std::transform(ret.begin(), ret.end(), ret.begin(), ::tolower);
+    size_t start = ret.find_first_not_of("~.");
+    size_t end = ret.find_last_not_of('.');
+    if (std::string::npos == start || std::string::npos == end)
+    {
+        return "";
+    }
+    return ret.substr(start, end - start + 1);
+}
+
+
+/**
+ *  Skips a possibly compressed domain name in a DNS message
+ *
+ * @return Returns the offset after the name, 0 if the name is malformed
+ */
+static size_t skip_name(const uint8_t *msg, size_t len, size_t off)
+{
+    while (off < len)
+    {
+        uint8_t l = msg[off];
+        if (0xc0 == (l & 0xc0))
+        {
+            return (off + 2 <= len ? off + 2 : 0);
+        }
+        if (l & 0xc0)
+        {
+            return 0;
+        }
+        if (0 == l)
+        {
+            return off + 1;
+        }
+        off += l + 1;
+    }
+    return 0;
+}
+
+
+static bool same_address(const struct sockaddr_storage& a,
+                         const struct sockaddr_storage& b)
+{
+    if (a.ss_family != b.ss_family)
+    {
+        return false;
+    }
+    if (AF_INET == a.ss_family)
+    {
+        const auto *a4 = reinterpret_cast<const struct sockaddr_in *>(&a);
+        const auto *b4 = reinterpret_cast<const struct sockaddr_in *>(&b);
+        return a4->sin_port == b4->sin_port
+               && a4->sin_addr.s_addr == b4->sin_addr.s_addr;
+    }
+    if (AF_INET6 == a.ss_family)
+    {
+        const auto *a6 = reinterpret_cast<const struct sockaddr_in6 *>(&a);
+        const auto *b6 = reinterpret_cast<const struct sockaddr_in6 *>(&b);
+        return a6->sin6_port == b6->sin6_port
+               && 0 == memcmp(&a6->sin6_addr, &b6->sin6_addr,
+                              sizeof(a6->sin6_addr));
+    }
+    return false;
+}
+
+
+/**
+ *  Reads exactly len bytes from a blocking socket
+ */
+static bool read_full(int fd, uint8_t *buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t r = ::recv(fd, buf + done, len - done, 0);
+        if (r < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (r <= 0)
+        {
+            return false;
+        }
+        done += r;
+    }
+    return true;
+}
+
+
+/**
+ *  Writes a DNS message with its TCP length prefix
+ */
+static bool write_tcp_msg(int fd, const uint8_t *msg, size_t len)
+{
+    std::vector<uint8_t> buf(len + 2);
+    put16(buf.data(), len);
+    memcpy(buf.data() + 2, msg, len);
+    size_t done = 0;
+    while (done < buf.size())
+    {
+        ssize_t r = ::send(fd, buf.data() + done, buf.size() - done, MSG_NOSIGNAL);
+        if (r < 0 && EINTR == errno)
+        {
+            continue;
+        }
+        if (r <= 0)
+        {
+            return false;
+        }
+        done += r;
+    }
+    return true;
+}
+
+
+/**
+ *  Reads a DNS message with its TCP length prefix
+ */
+static bool read_tcp_msg(int fd, std::vector<uint8_t>& msg)
+{
+    uint8_t lenbuf[2];
+    if (!read_full(fd, lenbuf, 2))
+    {
+        return false;
+    }
+    msg.resize(get16(lenbuf));
+    return !msg.empty() && read_full(fd, msg.data(), msg.size());
+}
+
+
+static void set_timeouts(int fd, int seconds)
+{
+    struct timeval tv = {seconds, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+
+
+namespace NetCfg
+{
+namespace DNS
+{
+    StubResolver::StubResolver(const std::string& listen_addr,
+                               uint16_t listen_port,
+                               uint16_t upstream_port)
+        : listen_addr(listen_addr),
+          listen_port(listen_port),
+          upstream_port(upstream_port),
+          rng(std::random_device{}())
+    {
+        struct sockaddr_storage addr;
+        socklen_t addr_len = 0;
+        if (!server_address(listen_addr, listen_port, addr, addr_len))
+        {
+            throw NetCfgException("Invalid stub resolver address: " + listen_addr);
+        }
+
+        std::string err;
+        udp_sock = socket(addr.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (udp_sock < 0
+            || 0 != bind(udp_sock, reinterpret_cast<struct sockaddr *>(&addr), addr_len)
+            || 0 != getsockname(udp_sock, reinterpret_cast<struct sockaddr *>(&addr), &addr_len))
+        {
+            err = strerror(errno);
+        }
+        else
+        {
+            // TCP listens on the same port, also when it was picked by
+            // the kernel
+            this->listen_port = ntohs(AF_INET == addr.ss_family
+                                      ? reinterpret_cast<struct sockaddr_in *>(&addr)->sin_port
+                                      : reinterpret_cast<struct sockaddr_in6 *>(&addr)->sin6_port);
+            int on = 1;
+            tcp_sock = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (tcp_sock < 0
+                || 0 != setsockopt(tcp_sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on))
+                || 0 != bind(tcp_sock, reinterpret_cast<struct sockaddr *>(&addr), addr_len)
+                || 0 != listen(tcp_sock, 16)
+                || 0 != pipe2(wakeup, O_CLOEXEC))
+            {
+                err = strerror(errno);
+            }
+        }
+
+        if (!err.empty())
+        {
+            for (int fd : {udp_sock, tcp_sock, wakeup[0], wakeup[1]})
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+            }
+            throw NetCfgException("Could not set up the stub resolver on "
+                                  + listen_addr + ": " + err);
+        }
+
+        worker = std::thread([this]()
+                             {
+                                 run();
+                             });
+    }
+
+
+    StubResolver::~StubResolver()
+    {
+        running = false;
+        // If this fails, the thread notices within its poll timeout
+        ssize_t ret = write(wakeup[1], "x", 1);
+        (void) ret;
+        worker.join();
+
+        // TCP clients give up within their socket timeouts
+        while (tcp_clients > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        for (auto& p : pending)
+        {
+            close_upstream(p.second);
+        }
+        for (int fd : {udp_sock, tcp_sock, wakeup[0], wakeup[1]})
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+
+
+    const std::string& StubResolver::GetListenAddress() const noexcept
+    {
+        return listen_addr;
+    }
+
+
+    uint16_t StubResolver::GetListenPort() const noexcept
+    {
+        return listen_port;
+    }
+
+
+    void StubResolver::SetRoutes(const std::vector<std::string>& defsrvs,
+                                 const std::vector<Route>& new_routes)
+    {
+        std::vector<Route> rts;
+        for (const auto& r : new_routes)
+        {
+            if (r.servers.empty())
+            {
+                continue;
+            }
+            Route n;
+            n.servers = r.servers;
+            for (const auto& d : r.domains)
+            {
+                std::string dom = normalize_domain(d);
+                if (!dom.empty())
+                {
+                    n.domains.push_back(dom);
+                }
+            }
+            if (!n.domains.empty())
+            {
+                rts.push_back(n);
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(mtx);
+        bool changed = (defsrvs != default_servers
+                        || rts.size() != routes.size());
+        for (size_t i = 0; !changed && i < rts.size(); ++i)
+        {
+            changed = (rts[i].domains != routes[i].domains
+                       || rts[i].servers != routes[i].servers);
+        }
+        if (changed)
+        {
+            default_servers = defsrvs;
+            routes = std::move(rts);
+            cache.clear();
+        }
+    }
+
+
+    std::vector<std::string> StubResolver::SelectServers(const std::string& qname) const
+    {
+        std::string name = normalize_domain(qname);
+
+        std::lock_guard<std::mutex> guard(mtx);
+        const Route *best = nullptr;
+        size_t best_len = 0;
+        for (const auto& r : routes)
+        {
+            for (const auto& d : r.domains)
+            {
+                bool match = (name == d
+                              || (name.size() > d.size()
+                                  && '.' == name[name.size() - d.size() - 1]
+                                  && 0 == name.compare(name.size() - d.size(),
+                                                       d.size(), d)));
+                if (match && d.size() > best_len)
+                {
+                    best = &r;
+                    best_len = d.size();
+                }
+            }
+        }
+        return (best ? best->servers : default_servers);
+    }
+
+
+    void StubResolver::FlushCache()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        cache.clear();
+    }
+
+
+    bool StubResolver::ParseQuestion(const uint8_t *msg, size_t len, DNSQuestion& q)
+    {
+        if (len < 12 || 1 != get16(msg + 4))
+        {
+            return false;
+        }
+
+        std::string name;
+        size_t off = 12;
+        while (true)
+        {
+            if (off >= len)
+            {
+                return false;
+            }
+            uint8_t l = msg[off++];
+            if (0 == l)
+            {
+                break;
+            }
+            // Compression is not used in the question of a query
+            if ((l & 0xc0) || off + l > len || name.size() + l > 254)
+            {
+                return false;
+            }
+            if (!name.empty())
+            {
+                name += '.';
+            }
+            name.append(reinterpret_cast<const char *>(msg + off), l);
+            off += l;
+        }
+        if (off + 4 > len)
+        {
+            return false;
+        }
+
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        q.name = name;
+        q.qtype = get16(msg + off);
+        q.qclass = get16(msg + off + 2);
+        q.end = off + 4;
+        return true;
+    }
+
+
+    bool StubResolver::CacheTTL(const uint8_t *msg, size_t len, uint32_t& ttl,
+                                std::vector<size_t>& ttl_offsets)
+    {
+        DNSQuestion q;
+        if (!ParseQuestion(msg, len, q))
+        {
+            return false;
+        }
+
+        // Only complete NOERROR and NXDOMAIN responses are cached
+        uint8_t rcode = msg[3] & 0x0f;
+        if (!(msg[2] & 0x80) || (msg[2] & 0x02) || (0 != rcode && 3 != rcode))
+        {
+            return false;
+        }
+
+        size_t records = get16(msg + 6) + get16(msg + 8) + get16(msg + 10);
+        size_t off = q.end;
+        uint32_t lowest = max_ttl;
+        bool found = false;
+        ttl_offsets.clear();
+        for (size_t i = 0; i < records; ++i)
+        {
+            off = skip_name(msg, len, off);
+            if (0 == off || off + 10 > len)
+            {
+                return false;
+            }
+            uint16_t type = get16(msg + off);
+            uint32_t rr_ttl = get32(msg + off + 4);
+            size_t rdend = off + 10 + get16(msg + off + 8);
+            if (rdend > len)
+            {
+                return false;
+            }
+
+            // The TTL field of an EDNS OPT record carries flags
+            if (41 != type)
+            {
+                // Negative answers are cached for the SOA minimum TTL
+                if (6 == type && rdend >= off + 14)
+                {
+                    rr_ttl = std::min(rr_ttl, get32(msg + rdend - 4));
+                }
+                lowest = std::min(lowest, rr_ttl);
+                ttl_offsets.push_back(off + 4);
+                found = true;
+            }
+            off = rdend;
+        }
+
+        ttl = lowest;
+        return found && ttl > 0;
+    }
+
+
+    void StubResolver::run()
+    {
+        std::vector<uint8_t> buf(65536);
+
+        while (running)
+        {
+            int timeout = 1000;
+            Clock::time_point now = Clock::now();
+            for (const auto& p : pending)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                p.second.deadline - now).count();
+                timeout = std::min(timeout, (left > 0 ? (int) left : 0));
+            }
+
+            // Each upstream query has its own socket
+            std::vector<struct pollfd> pfd = {{udp_sock, POLLIN, 0},
+                                              {tcp_sock, POLLIN, 0},
+                                              {wakeup[0], POLLIN, 0}};
+            std::vector<uint16_t> ids;
+            for (const auto& p : pending)
+            {
+                pfd.push_back({p.second.sock, POLLIN, 0});
+                ids.push_back(p.first);
+            }
+            int r = poll(pfd.data(), pfd.size(), timeout);
+            if (r < 0 && EINTR != errno)
+            {
+                break;
+            }
+
+            if (r > 0 && (pfd[0].revents & POLLIN))
+            {
+                struct sockaddr_storage client;
+                socklen_t client_len = sizeof(client);
+                ssize_t len;
+                while ((len = recvfrom(udp_sock, buf.data(), buf.size(), 0,
+                                       reinterpret_cast<struct sockaddr *>(&client),
+                                       &client_len)) > 0)
+                {
+                    handle_query(buf.data(), len, client, client_len);
+                    client_len = sizeof(client);
+                }
+            }
+
+            if (r > 0 && (pfd[1].revents & POLLIN))
+            {
+                int client = accept4(tcp_sock, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0 && tcp_clients >= max_tcp_clients)
+                {
+                    close(client);
+                }
+                else if (client >= 0)
+                {
+                    ++tcp_clients;
+                    std::thread([this, client]()
+                                {
+                                    handle_tcp(client);
+                                }).detach();
+                }
+            }
+
+            for (size_t i = 3; r > 0 && i < pfd.size(); ++i)
+            {
+                if (!(pfd[i].revents & POLLIN))
+                {
+                    continue;
+                }
+
+                // Handling a response may close the socket, so only one
+                // datagram is read per socket and poll() round
+                auto it = pending.find(ids[i - 3]);
+                if (pending.end() == it || it->second.sock != pfd[i].fd)
+                {
+                    continue;
+                }
+                struct sockaddr_storage from;
+                socklen_t from_len = sizeof(from);
+                ssize_t len = recvfrom(pfd[i].fd, buf.data(), buf.size(), 0,
+                                       reinterpret_cast<struct sockaddr *>(&from),
+                                       &from_len);
+                if (len > 0)
+                {
+                    handle_response(pfd[i].fd, buf.data(), len, from);
+                }
+            }
+
+            expire_pending();
+        }
+    }
+
+
+    void StubResolver::handle_query(const uint8_t *buf, size_t len,
+                                    const struct sockaddr_storage& client,
+                                    socklen_t client_len)
+    {
+        DNSQuestion q;
+        // Only standard queries are served
+        if (!ParseQuestion(buf, len, q) || (buf[2] & 0x80) || (buf[2] & 0x78))
+        {
+            return;
+        }
+
+        std::string key = cache_key(buf, q);
+        std::vector<uint8_t> response;
+        if (cache_lookup(key, buf, q, response))
+        {
+            reply(response, client, client_len);
+            return;
+        }
+
+        Pending p;
+        p.servers = SelectServers(q.name);
+        if (p.servers.empty() || pending.size() >= max_pending)
+        {
+            reply(servfail(buf, q), client, client_len);
+            return;
+        }
+        p.client = client;
+        p.client_len = client_len;
+        p.client_id = get16(buf);
+        p.key = key;
+        p.question = q;
+        p.query.assign(buf, buf + len);
+
+        uint16_t id;
+        do
+        {
+            id = rng() & 0xffff;
+        } while (pending.find(id) != pending.end());
+        put16(p.query.data(), id);
+
+        if (!send_upstream(p))
+        {
+            reply(servfail(buf, q), client, client_len);
+            return;
+        }
+        pending.emplace(id, std::move(p));
+    }
+
+
+    void StubResolver::handle_response(int sock, const uint8_t *buf, size_t len,
+                                       const struct sockaddr_storage& from)
+    {
+        if (len < 12)
+        {
+            return;
+        }
+        auto it = pending.find(get16(buf));
+        if (pending.end() == it)
+        {
+            return;
+        }
+
+        // Ignore anything not looking like the response to our query
+        Pending& p = it->second;
+        DNSQuestion q;
+        if (sock != p.sock
+            || !same_address(from, p.server_addr)
+            || !ParseQuestion(buf, len, q)
+            || q.name != p.question.name
+            || q.qtype != p.question.qtype
+            || q.qclass != p.question.qclass)
+        {
+            return;
+        }
+
+        // SERVFAIL and REFUSED are worth asking the next server
+        uint8_t rcode = buf[3] & 0x0f;
+        if (2 == rcode || 5 == rcode)
+        {
+            ++p.server;
+            if (send_upstream(p))
+            {
+                return;
+            }
+        }
+
+        cache_store(p.key, buf, len);
+        std::vector<uint8_t> response(buf, buf + len);
+        put16(response.data(), p.client_id);
+        reply(response, p.client, p.client_len);
+        close_upstream(p);
+        pending.erase(it);
+    }
+
+
+    bool StubResolver::send_upstream(Pending& p)
+    {
+        // A new socket is used for each server queried.  Its source port
+        // is picked at random by the kernel, so an off-path attacker has
+        // to guess both the port and the query id to spoof a response.
+        // The socket is connected, so only datagrams from the queried
+        // server are received on it.
+        close_upstream(p);
+        for (; p.server < p.servers.size(); ++p.server)
+        {
+            if (!server_address(p.servers[p.server], upstream_port,
+                                p.server_addr, p.server_len))
+            {
+                continue;
+            }
+
+            p.sock = socket(p.server_addr.ss_family,
+                            SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (p.sock < 0)
+            {
+                continue;
+            }
+            if (0 == connect(p.sock,
+                             reinterpret_cast<struct sockaddr *>(&p.server_addr),
+                             p.server_len)
+                && send(p.sock, p.query.data(), p.query.size(), 0)
+                   == (ssize_t) p.query.size())
+            {
+                p.deadline = Clock::now() + upstream_timeout;
+                return true;
+            }
+            close_upstream(p);
+        }
+        return false;
+    }
+
+
+    void StubResolver::close_upstream(Pending& p)
+    {
+        if (p.sock >= 0)
+        {
+            close(p.sock);
+            p.sock = -1;
+        }
+    }
+
+
+    void StubResolver::expire_pending()
+    {
+        Clock::time_point now = Clock::now();
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            Pending& p = it->second;
+            if (now < p.deadline)
+            {
+                ++it;
+                continue;
+            }
+            ++p.server;
+            if (send_upstream(p))
+            {
+                ++it;
+                continue;
+            }
+            reply(servfail(p.query.data(), p.question), p.client, p.client_len);
+            close_upstream(p);
+            it = pending.erase(it);
+        }
+    }
+
+
+    void StubResolver::handle_tcp(int client)
+    {
+        set_timeouts(client, 5);
+        std::vector<uint8_t> query;
+        while (running && read_tcp_msg(client, query))
+        {
+            DNSQuestion q;
+            if (!ParseQuestion(query.data(), query.size(), q))
+            {
+                break;
+            }
+
+            std::vector<uint8_t> response;
+            for (const auto& srv : SelectServers(q.name))
+            {
+                struct sockaddr_storage addr;
+                socklen_t addr_len;
+                if (!server_address(srv, upstream_port, addr, addr_len))
+                {
+                    continue;
+                }
+                int up = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (up < 0)
+                {
+                    continue;
+                }
+                set_timeouts(up, 2);
+                bool ok = (0 == connect(up, reinterpret_cast<struct sockaddr *>(&addr),
+                                        addr_len)
+                           && write_tcp_msg(up, query.data(), query.size())
+                           && read_tcp_msg(up, response));
+                close(up);
+                if (ok)
+                {
+                    break;
+                }
+                response.clear();
+            }
+
+            if (response.empty())
+            {
+                std::vector<uint8_t> sf = servfail(query.data(), q);
+                response.swap(sf);
+            }
+            if (!write_tcp_msg(client, response.data(), response.size()))
+            {
+                break;
+            }
+        }
+        close(client);
+        --tcp_clients;
+    }
+
+
+    bool StubResolver::cache_lookup(const std::string& key, const uint8_t *query,
+                                    const DNSQuestion& q,
+                                    std::vector<uint8_t>& response)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = cache.find(key);
+        if (cache.end() == it)
+        {
+            return false;
+        }
+        Clock::time_point now = Clock::now();
+        if (now >= it->second.expires)
+        {
+            cache.erase(it);
+            return false;
+        }
+
+        response = it->second.response;
+        uint32_t age = std::chrono::duration_cast<std::chrono::seconds>(
+                           now - it->second.stored).count();
+        for (size_t off : it->second.ttl_offsets)
+        {
+            uint32_t ttl = get32(response.data() + off);
+            put32(response.data() + off, (ttl > age ? ttl - age : 0));
+        }
+
+        // Use the id and the spelling of the name from this query
+        memcpy(response.data(), query, 2);
+        memcpy(response.data() + 12, query + 12, q.end - 12);
+        return true;
+    }
+
+
+    void StubResolver::cache_store(const std::string& key, const uint8_t *response,
+                                   size_t len)
+    {
+        CacheEntry e;
+        uint32_t ttl = 0;
+        if (!CacheTTL(response, len, ttl, e.ttl_offsets))
+        {
+            return;
+        }
+        e.response.assign(response, response + len);
+        e.stored = Clock::now();
+        e.expires = e.stored + std::chrono::seconds(ttl);
+
+        std::lock_guard<std::mutex> guard(mtx);
+        if (cache.size() >= max_cache)
+        {
+            for (auto it = cache.begin(); it != cache.end();)
+            {
+                it = (e.stored >= it->second.expires ? cache.erase(it) : std::next(it));
+            }
+        }
+        if (cache.size() >= max_cache)
+        {
+            auto oldest = std::min_element(cache.begin(), cache.end(),
+                                           [](const std::pair<const std::string, CacheEntry>& a,
+                                              const std::pair<const std::string, CacheEntry>& b)
+                                           {
+                                               return a.second.expires < b.second.expires;
+                                           });
+            cache.erase(oldest);
+        }
+        cache[key] = std::move(e);
+    }
+
+
+    void StubResolver::reply(const std::vector<uint8_t>& msg,
+                             const struct sockaddr_storage& client,
+                             socklen_t client_len)
+    {
+        sendto(udp_sock, msg.data(), msg.size(), 0,
+               reinterpret_cast<const struct sockaddr *>(&client), client_len);
+    }
+
+
+    std::vector<uint8_t> StubResolver::servfail(const uint8_t *query,
+                                                const DNSQuestion& q)
+    {
+        std::vector<uint8_t> ret(query, query + q.end);
+        ret[2] = 0x80 | (query[2] & 0x79);   // QR, the opcode and RD
+        ret[3] = 0x80 | 2;                   // RA, SERVFAIL
+        put16(ret.data() + 6, 0);
+        put16(ret.data() + 8, 0);
+        put16(ret.data() + 10, 0);
+        return ret;
+    }
+
+
+    std::string StubResolver::cache_key(const uint8_t *query, const DNSQuestion& q)
+    {
+        // Responses differ with EDNS and the checking disabled bit
+        return q.name + "/" + std::to_string(q.qtype)
+               + "/" + std::to_string(q.qclass)
+               + (get16(query + 10) > 0 ? "/e" : "")
+               + ((query[3] & 0x10) ? "/cd" : "");
+    }
+
+
+    bool StubResolver::server_address(const std::string& server, uint16_t port,
+                                      struct sockaddr_storage& addr,
+                                      socklen_t& addr_len)
+    {
+        struct addrinfo hints = {};
+        hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+        hints.ai_socktype = SOCK_DGRAM;
+
+        struct addrinfo *res = nullptr;
+        if (0 != getaddrinfo(server.c_str(), std::to_string(port).c_str(),
+                             &hints, &res))
+        {
+            return false;
+        }
+        memcpy(&addr, res->ai_addr, res->ai_addrlen);
+        addr_len = res->ai_addrlen;
+        freeaddrinfo(res);
+        return true;
+    }
+} // namespace DNS
+} // namespace NetCfg
@@ -0,0 +1,259 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   stub-resolver.hpp
+ *
+ * @brief  Small caching DNS stub resolver, forwarding queries to the
+ *         name servers of the VPN session responsible for the domain
+ *         being looked up
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+
+
+namespace NetCfg
+{
+namespace DNS
+{
+    /**
+     *  The question of a DNS message
+     */
+    struct DNSQuestion
+    {
+        std::string name;     ///< Query name, lower case without trailing dot
+        uint16_t qtype = 0;   ///< Query type
+        uint16_t qclass = 0;  ///< Query class
+        size_t end = 0;       ///< Offset of the first byte after the question
+    };
+
+
+    /**
+     *  Caching DNS stub resolver used together with the ResolvConfFile
+     *  backend, when there is no systemd-resolved doing split DNS.
+     *
+     *  It listens on a local address, which is put as the only name
+     *  server in resolv.conf.  Queries for names within the routing
+     *  domains of a VPN session are sent to the name servers of that
+     *  session, the longest matching domain wins.  All other queries go
+     *  to the default servers, which are the name servers of VPN sessions
+     *  with the global DNS scope or the original system name servers.
+     *
+     *  UDP responses are cached for the lowest TTL of the records in
+     *  them, negative responses for the SOA minimum TTL.  TCP queries
+     *  are forwarded over TCP without caching.
+     *
+     *  The queries are processed by a separate thread; TCP connections
+     *  get a short lived thread each.
+     */
+    class StubResolver
+    {
+    public:
+        using Ptr = std::shared_ptr<StubResolver>;
+
+        /**
+         *  Name servers responsible for a set of domains
+         */
+        struct Route
+        {
+            std::vector<std::string> domains;
+            std::vector<std::string> servers;
+        };
+
+
+        /**
+         *  Opens the listening sockets and starts the resolver thread.
+         *  Throws NetCfgException on errors.
+         *
+         * @param listen_addr    std::string with the IP address to listen on
+         * @param listen_port    Port to listen on, 0 picks a free port
+         * @param upstream_port  Port of the name servers queries are
+         *                       forwarded to
+         */
+        StubResolver(const std::string& listen_addr,
+                     uint16_t listen_port = 53,
+                     uint16_t upstream_port = 53);
+        ~StubResolver();
+
+        StubResolver(const StubResolver&) = delete;
+        StubResolver& operator=(const StubResolver&) = delete;
+
+
+        /**
+         * @return Returns the IP address the resolver listens on
+         */
+        const std::string& GetListenAddress() const noexcept;
+
+
+        /**
+         * @return Returns the UDP and TCP port the resolver listens on
+         */
+        uint16_t GetListenPort() const noexcept;
+
+
+        /**
+         *  Replaces the name servers queries are forwarded to.  The
+         *  cache is flushed if anything changed.
+         *
+         * @param default_servers  Servers for names not covered by a route
+         * @param routes           Routing domains with their servers
+         */
+        void SetRoutes(const std::vector<std::string>& default_servers,
+                       const std::vector<Route>& routes);
+
+
+        /**
+         *  Finds the name servers responsible for a name
+         *
+         * @param qname  std::string with the name to look up
+         *
+         * @return Returns the servers of the route with the longest
+         *         domain covering the name, or the default servers
+         */
+        std::vector<std::string> SelectServers(const std::string& qname) const;
+
+
+        /**
+         *  Removes all cached responses
+         */
+        void FlushCache();
+
+
+        /**
+         *  Parses the question of a DNS message, which must have exactly
+         *  one question
+         *
+         * @param msg  Pointer to the DNS message
+         * @param len  Length of the message
+         * @param q    DNSQuestion where the result is stored
+         *
+         * @return Returns false if the message is malformed
+         */
+        static bool ParseQuestion(const uint8_t *msg, size_t len, DNSQuestion& q);
+
+
+        /**
+         *  Finds how long a response may be cached, and where the TTL
+         *  fields of the resource records are
+         *
+         * @param msg          Pointer to the DNS response
+         * @param len          Length of the response
+         * @param ttl          The time to cache the response is stored here
+         * @param ttl_offsets  Offsets of all TTL fields are stored here,
+         *                     except the one of an EDNS OPT record
+         *
+         * @return Returns false if the response cannot be cached
+         */
+        static bool CacheTTL(const uint8_t *msg, size_t len, uint32_t& ttl,
+                             std::vector<size_t>& ttl_offsets);
+
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        /// Longest time a response is cached, regardless of its TTL
+        static const uint32_t max_ttl = 3600;
+        /// Most cached responses
+        static const size_t max_cache = 4096;
+        /// Most queries waiting for a response
+        static const size_t max_pending = 1024;
+
+        struct CacheEntry
+        {
+            std::vector<uint8_t> response;
+            std::vector<size_t> ttl_offsets;
+            Clock::time_point stored;
+            Clock::time_point expires;
+        };
+
+        struct Pending
+        {
+            struct sockaddr_storage client;
+            socklen_t client_len;
+            uint16_t client_id;
+            std::string key;
+            DNSQuestion question;
+            std::vector<uint8_t> query;
+            std::vector<std::string> servers;
+            size_t server = 0;           ///< Index of the server queried
+            struct sockaddr_storage server_addr;
+            socklen_t server_len;
+            int sock = -1;               ///< Socket connected to the server
+            Clock::time_point deadline;
+        };
+
+        std::string listen_addr;
+        uint16_t listen_port = 0;
+        const uint16_t upstream_port;
+        int udp_sock = -1;
+        int tcp_sock = -1;
+        int wakeup[2] = {-1, -1};
+        std::atomic<bool> running{true};
+        std::atomic<unsigned int> tcp_clients{0};
+        std::thread worker;
+        std::mt19937 rng;
+
+        mutable std::mutex mtx;   ///< Guards the routes and the cache
+        std::vector<std::string> default_servers;
+        std::vector<Route> routes;
+        std::unordered_map<std::string, CacheEntry> cache;
+
+        std::map<uint16_t, Pending> pending;  ///< By upstream query id
+
+
+        void run();
+        void handle_query(const uint8_t *buf, size_t len,
+                          const struct sockaddr_storage& client,
+                          socklen_t client_len);
+        void handle_response(int sock, const uint8_t *buf, size_t len,
+                             const struct sockaddr_storage& from);
+        bool send_upstream(Pending& p);
+        static void close_upstream(Pending& p);
+        void expire_pending();
+        void handle_tcp(int client);
+
+        bool cache_lookup(const std::string& key, const uint8_t *query,
+                          const DNSQuestion& q, std::vector<uint8_t>& response);
+        void cache_store(const std::string& key, const uint8_t *response,
+                         size_t len);
+
+        void reply(const std::vector<uint8_t>& msg,
+                   const struct sockaddr_storage& client, socklen_t client_len);
+        static std::vector<uint8_t> servfail(const uint8_t *query,
+                                             const DNSQuestion& q);
+        static std::string cache_key(const uint8_t *query, const DNSQuestion& q);
+        static bool server_address(const std::string& server, uint16_t port,
+                                   struct sockaddr_storage& addr,
+                                   socklen_t& addr_len);
+    };
+} // namespace DNS
+} // namespace NetCfg
@@ -46,13 +46,39 @@
 using namespace NetCfg::DNS;
 using namespace NetCfg::DNS::resolved;
 
-SystemdResolved::SystemdResolved(GDBusConnection *dbc)
-    : resolved::Manager(dbc)
+SystemdResolved::SystemdResolved(GDBusConnection *dbc, LogWriter *logwr,
+                                 const unsigned int debounce_ms)
+    : resolved::Manager(dbc),
+      state(std::make_shared<commitState>()),
+      debounce_ms(debounce_ms)
 {
+    log.reset(new NetCfgSignals(dbc, LogGroup::NETCFG,
+                                OpenVPN3DBus_rootp_netcfg, logwr));
 }
 
 
-SystemdResolved::~SystemdResolved() = default;
+SystemdResolved::~SystemdResolved()
+{
+    bool pending = false;
+    {
+        std::lock_guard<std::mutex> guard(state->mtx);
+        if (state->timer_id > 0)
+        {
+            g_source_remove(state->timer_id);
+            state->timer_id = 0;
+        }
+        pending = !state->pending.empty();
+    }
+
+    // Don't lose the last updates, typically reverting the settings
+    // of devices removed during shutdown.  The calls are sent right
+    // away, even if the responses will never be processed.
+    if (pending)
+    {
+        flush();
+    }
+}
+
 
 const std::string SystemdResolved::GetBackendInfo() const noexcept
 {
@@ -69,7 +95,7 @@ const ApplySettingsMode SystemdResolved::GetApplyMode() const noexcept
 void SystemdResolved::Apply(const ResolverSettings::Ptr settings)
 {
     SystemdResolved::updateQueueEntry upd;
-    upd.link = RetrieveLink(settings->GetDeviceName());
+    upd.link_path = get_link_path(settings->GetDeviceName());
     upd.enable = settings->GetEnabled();
 
     if (upd.enable)
@@ -103,43 +129,197 @@ void SystemdResolved::Apply(const ResolverSettings::Ptr settings)
 
 void SystemdResolved::Commit(NetCfgSignals *signal)
 {
+    std::lock_guard<std::mutex> guard(state->mtx);
     for (auto& upd : update_queue)
     {
-        if (upd.disabled)
+        const std::string& path = upd.link_path;
+
+        // Only the last update of a link within the debounce window
+        // will be sent to systemd-resolved
+        state->pending[path] = upd;
+        if (signal)
         {
-            continue;
+            signal->LogVerb2("systemd-resolved: [" + path
+                             + "] Queued DNS " + (upd.enable ? "update" : "revert"));
         }
-        try
+    }
+    update_queue.clear();
+
+    if (0 == state->timer_id && !state->pending.empty())
+    {
+        state->timer_id = g_timeout_add(debounce_ms, flush_timer, this);
+    }
+}
+
+
+void SystemdResolved::DeviceRemoved(const std::string& dev_name)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> guard(links_mtx);
+        for (auto it = links.begin(); it != links.end(); ++it)
+        {
+            if (it->second.device == dev_name)
+            {
+                path = it->second.path;
+                links.erase(it);
+                break;
+            }
+        }
+    }
+    if (path.empty())
+    {
+        return;
+    }
+
+    // A new device with the same interface index gets the same link
+    // path, and must not be compared against the settings of this one.
+    // A revert still pending for the link will record its state again.
+    std::lock_guard<std::mutex> guard(state->mtx);
+    state->committed.erase(path);
+}
+
+
+std::string SystemdResolved::get_link_path(const std::string& dev_name)
+{
+    unsigned int if_idx = GetInterfaceIndex(dev_name);
+    {
+        std::lock_guard<std::mutex> guard(links_mtx);
+        auto it = links.find(if_idx);
+        if (links.end() != it && it->second.device == dev_name)
         {
+            return it->second.path;
+        }
+    }
+
+    // Not cached, or the interface index belonged to a device which
+    // was removed without netcfg knowing about it
+    std::string path = GetLink(if_idx);
+    std::lock_guard<std::mutex> guard(links_mtx);
+    links[if_idx] = {dev_name, path};
+    return path;
+}
+
+
+gboolean SystemdResolved::flush_timer(gpointer data)
+{
+    static_cast<SystemdResolved *>(data)->flush();
+    return G_SOURCE_REMOVE;
+}
+
+
+void SystemdResolved::flush()
+{
+    std::map<std::string, updateQueueEntry> updates;
+    {
+        std::lock_guard<std::mutex> guard(state->mtx);
+        state->timer_id = 0;
+        updates.swap(state->pending);
+    }
+
+    for (auto& it : updates)
+    {
+        const std::string& path = it.first;
+        const updateQueueEntry& upd = it.second;
+
+        // Compare with what was last sent and record the new settings
+        // right away, so later updates are compared against them even
+        // before systemd-resolved has responded.  Failed calls remove
+        // the record again.
+        bool set_dns = false;
+        bool set_domains = false;
+        bool revert = false;
+        {
+            std::lock_guard<std::mutex> guard(state->mtx);
+            auto prev = state->committed.find(path);
+            bool known = (state->committed.end() != prev);
             if (upd.enable)
             {
-                signal->LogVerb2("systemd-resolved: [" + upd.link->GetPath()
-                                 + "] Committing DNS servers");
-                upd.link->SetDNSServers(upd.resolver);
-                signal->LogVerb2("systemd-resolved: [" + upd.link->GetPath()
-                                 + "] Committing DNS search domains");
-                upd.link->SetDomains(upd.search);
+                set_dns = !known || !prev->second.enable
+                          || prev->second.resolver != upd.resolver;
+                set_domains = !known || !prev->second.enable
+                              || prev->second.search != upd.search;
+
+                linkState& st = state->committed[path];
+                st.enable = true;
+                st.resolver = upd.resolver;
+                st.search = upd.search;
             }
             else
             {
-                upd.link->Revert();
+                revert = !known || prev->second.enable;
+                state->committed[path] = linkState();
             }
         }
-        catch (const DBusProxyAccessDeniedException& excp)
-        {
-            signal->LogCritical("systemd-resolved: " + std::string(excp.what()));
-            upd.disabled = true;
-        }
-        catch (const DBusException& excp)
+
+        std::shared_ptr<commitState> st = state;
+        NetCfgSignals::Ptr lg = log;
+        auto done = [st, lg, path](DBusProxyAsyncCall& call)
+                    {
+                        call_done(call, st, lg, path);
+                    };
+        try
         {
-            signal->LogCritical("systemd-resolved: " + std::string(excp.what()));
-            upd.disabled = true;
+            if (set_dns)
+            {
+                log->LogVerb2("systemd-resolved: [" + path
+                              + "] Committing DNS servers");
+                SetLinkDNSServersAsync(path, upd.resolver, done);
+            }
+            if (set_domains)
+            {
+                log->LogVerb2("systemd-resolved: [" + path
+                              + "] Committing DNS search domains");
+                SetLinkDomainsAsync(path, upd.search, done);
+            }
+            if (revert)
+            {
+                log->LogVerb2("systemd-resolved: [" + path
+                              + "] Reverting DNS settings");
+                RevertLinkAsync(path, done);
+            }
+            if (!set_dns && !set_domains && !revert)
+            {
+                log->Debug("systemd-resolved: [" + path
+                           + "] DNS settings unchanged");
+            }
         }
         catch (const std::exception& excp)
         {
-            signal->LogError("systemd-resolved: " + std::string(excp.what()));
-            upd.disabled = true;
+            log->LogError("systemd-resolved: " + std::string(excp.what()));
+            std::lock_guard<std::mutex> guard(state->mtx);
+            state->committed.erase(path);
         }
     }
-    update_queue.clear();
+}
+
+
+void SystemdResolved::call_done(DBusProxyAsyncCall& call,
+                                std::shared_ptr<commitState> state,
+                                NetCfgSignals::Ptr log,
+                                const std::string& path)
+{
+    try
+    {
+        GVariant *r = call.GetResult();
+        g_variant_unref(r);
+        return;
+    }
+    catch (const DBusProxyAccessDeniedException& excp)
+    {
+        log->LogCritical("systemd-resolved: " + std::string(excp.what()));
+    }
+    catch (const DBusException& excp)
+    {
+        log->LogCritical("systemd-resolved: " + std::string(excp.what()));
+    }
+    catch (const std::exception& excp)
+    {
+        log->LogError("systemd-resolved: " + std::string(excp.what()));
+    }
+
+    // The link state is unknown now; the next update must be sent
+    // to systemd-resolved regardless of its content
+    std::lock_guard<std::mutex> guard(state->mtx);
+    state->committed.erase(path);
 }
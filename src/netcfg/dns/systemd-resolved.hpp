@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -34,6 +36,7 @@
 using namespace openvpn;
 
 #include "dbus/core.hpp"
+#include "log/logwriter.hpp"
 
 #include "netcfg/netcfg-signals.hpp"
 #include "netcfg/dns/resolver-settings.hpp"
@@ -61,23 +64,39 @@ namespace DNS
         struct updateQueueEntry
         {
             bool enable;
-            bool disabled = false;
-            resolved::Link::Ptr link;
+            std::string link_path;
             resolved::ResolverRecord::List resolver;
             resolved::SearchDomain::List search;
         };
 
 
+        /// Default time to collect updates before sending them to
+        /// systemd-resolved, in milliseconds
+        static const unsigned int default_debounce_ms = 100;
+
+
         /**
          *  The SystemdResolved class bridges the information passed from
          *  the VPN session through the ResolverBackendInterface and prepares
          *  it to be consumed by the systemd-resolved process.
          *  (org.freedesktop.resolve1 D-Bus service).
          *
-         * @param dbc   GDBusConnection pointer to a valid D-Bus connection to
-         *              use.
+         *  Updates are not sent to systemd-resolved right away by
+         *  @Commit().  All updates committed within the debounce window
+         *  are coalesced per link and sent from the GLib main loop, and
+         *  only settings which differ from what was last sent are
+         *  applied.
+         *
+         * @param dbc          GDBusConnection pointer to a valid D-Bus
+         *                     connection to use.
+         * @param logwr        LogWriter for errors reported by
+         *                     systemd-resolved, may be nullptr
+         * @param debounce_ms  Time window to collect updates in, in
+         *                     milliseconds.  With 0, updates are sent on
+         *                     the next main loop iteration.
          */
-        SystemdResolved(GDBusConnection *dbc);
+        SystemdResolved(GDBusConnection *dbc, LogWriter *logwr = nullptr,
+                        const unsigned int debounce_ms = default_debounce_ms);
         ~SystemdResolved();
 
 
@@ -113,17 +132,83 @@ namespace DNS
         void Apply(const ResolverSettings::Ptr settings) override;
 
         /**
-         *  Completes the DNS resolver configuration by performing the
-         *  changes on the system.
+         *  Completes the DNS resolver configuration by scheduling the
+         *  changes to be sent to systemd-resolved.
          *
          *  @param signal  Pointer to a NetCfgSignals object where
          *                 "NetworkChange" signals will be issued
          */
         void Commit(NetCfgSignals *signal) override;
 
+        /**
+         *  Forgets the cached systemd-resolved link of a removed device.
+         *  The interface index may be reused by a device created later.
+         *
+         * @param dev_name  std::string with the name of the removed device
+         */
+        void DeviceRemoved(const std::string& dev_name) override;
+
 
     private:
+        /**
+         *  A systemd-resolved link object path, cached per interface index
+         */
+        struct cachedLink
+        {
+            std::string device;
+            std::string path;
+        };
+        /**
+         *  The DNS settings last sent to systemd-resolved for a link
+         */
+        struct linkState
+        {
+            bool enable = false;
+            resolved::ResolverRecord::List resolver;
+            resolved::SearchDomain::List search;
+        };
+
+        /**
+         *  State shared with the pending D-Bus calls, which may complete
+         *  after this object has been destroyed
+         */
+        struct commitState
+        {
+            std::mutex mtx;
+            std::map<std::string, updateQueueEntry> pending;
+            std::map<std::string, linkState> committed;
+            guint timer_id = 0;
+        };
+
         std::vector<updateQueueEntry> update_queue;
+        std::mutex links_mtx;
+        std::map<unsigned int, cachedLink> links;
+        std::shared_ptr<commitState> state;
+        NetCfgSignals::Ptr log;
+        const unsigned int debounce_ms;
+
+        /**
+         *  Retrieves the systemd-resolved link object path of a device,
+         *  asking systemd-resolved only if it is not cached already.
+         *
+         * @param dev_name  std::string with the device name
+         *
+         * @return Returns a std::string with the link object path
+         */
+        std::string get_link_path(const std::string& dev_name);
+
+        static gboolean flush_timer(gpointer data);
+
+        /**
+         *  Sends all pending updates to systemd-resolved.  Must be called
+         *  from the GLib main loop.
+         */
+        void flush();
+
+        static void call_done(DBusProxyAsyncCall& call,
+                              std::shared_ptr<commitState> state,
+                              NetCfgSignals::Ptr log,
+                              const std::string& path);
     };
 } // namespace DNS
 } // namespace NetCfg
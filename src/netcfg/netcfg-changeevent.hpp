@@ -49,6 +49,10 @@ struct NetCfgChangeEvent {
                "                <arg type='u' name='type'/>"
                "                <arg type='s' name='device'/>"
                "                <arg type='a{ss}' name='details'/>"
+               "            </signal>"
+               "            <signal name='NetworkChangeBatch'>"
+               "                <arg type='t' name='first_sequence'/>"
+               "                <arg type='a(usa{ss})' name='events'/>"
                "            </signal>";
     }
 
@@ -53,12 +53,44 @@ protected:
                            "Idle-Exit timer", OptionValueType::Int},
             OptionMapEntry{"resolv-conf", "resolv_conf_file", "DNS-resolver",
                            "resolv-conf file", OptionValueType::String},
+            OptionMapEntry{"resolv-conf-stub", "resolv_conf_stub",
+                           "DNS stub resolver address", OptionValueType::String},
             OptionMapEntry{"systemd-resolved", "systemd_resolved", "DNS-resolver",
                            "Systemd-resolved in use", OptionValueType::Present},
             OptionMapEntry{"redirect-method", "redirect_method",
                            "Server route redirection mode", OptionValueType::String},
             OptionMapEntry{"set-somark", "set_somark",
-                           "Netfilter SO_MARK", OptionValueType::String}
+                           "Netfilter SO_MARK", OptionValueType::String},
+            OptionMapEntry{"policy-table", "policy_table",
+                           "Policy routing table", OptionValueType::Int},
+            OptionMapEntry{"worker-threads", "worker_threads",
+                           "Worker threads", OptionValueType::Int},
+            OptionMapEntry{"dns-commit-delay", "dns_commit_delay",
+                           "DNS commit delay", OptionValueType::Int},
+            OptionMapEntry{"remote-cache-ttl", "remote_cache_ttl",
+                           "Remote resolver cache TTL", OptionValueType::Int},
+            OptionMapEntry{"tun-pool", "tun_pool",
+                           "tun device pool size", OptionValueType::Int},
+            OptionMapEntry{"notification-multicast", "notification_multicast",
+                           "NetworkChange multicast", OptionValueType::Present},
+            OptionMapEntry{"traffic-accounting", "traffic_accounting",
+                           "Traffic accounting", OptionValueType::Present},
+            OptionMapEntry{"packet-capture", "packet_capture",
+                           "Packet capture", OptionValueType::Present},
+            OptionMapEntry{"cpu-steering", "cpu_steering",
+                           "CPU steering", OptionValueType::Present},
+            OptionMapEntry{"rps-cpus", "rps_cpus",
+                           "RPS CPUs", OptionValueType::String},
+            OptionMapEntry{"xps-cpus", "xps_cpus",
+                           "XPS CPUs", OptionValueType::String},
+            OptionMapEntry{"rps-flow-cnt", "rps_flow_cnt",
+                           "RFS flow entries", OptionValueType::Int},
+            OptionMapEntry{"qdisc", "qdisc",
+                           "Queueing discipline", OptionValueType::String},
+            OptionMapEntry{"qdisc-bandwidth", "qdisc_bandwidth",
+                           "Upload bandwidth (kbit/s)", OptionValueType::Int},
+            OptionMapEntry{"txqueuelen", "txqueuelen",
+                           "Transmit queue length", OptionValueType::Int}
             };
     }
 };
@@ -22,12 +22,15 @@
 #include "netcfg-dco.hpp"
 #include "netcfg-device.hpp"
 #include "dco-keyconfig.pb.h"
+#include "dco-peer-event.hpp"
 
 #define OPENVPN_EXTERN extern
 #include <openvpn/common/base64.hpp>
 
 #include <openvpn/tun/linux/client/tunmethods.hpp>
 
+#include <cerrno>
+#include <cstring>
 #include <sys/types.h>
 #include <sys/socket.h>
 
@@ -36,6 +39,7 @@ NetCfgDCO::NetCfgDCO(GDBusConnection *dbuscon, const std::string& objpath,
     : DBusObject(objpath + "/dco"),
       signal(dbuscon, LogGroup::NETCFG, objpath, logwr),
       fds{},
+      io_context(NetCfg::DcoWorker::Instance().IOContext()),
       dev_name(dev_name)
 {
     std::stringstream introspect;
@@ -53,6 +57,9 @@ NetCfgDCO::NetCfgDCO(GDBusConnection *dbuscon, const std::string& objpath,
                << "          <arg type='u' direction='in' name='key_slot'/>"
                << "          <arg type='s' direction='in' name='key_config'/>"
                << "        </method>"
+               << "        <method name='NewKeys'>"
+               << "          <arg type='a(uay)' direction='in' name='keys'/>"
+               << "        </method>"
                << "        <method name='SwapKeys'>"
                << "          <arg type='u' direction='in' name='peer_id'/>"
                << "        </method>"
@@ -61,6 +68,16 @@ NetCfgDCO::NetCfgDCO(GDBusConnection *dbuscon, const std::string& objpath,
                << "          <arg type='u' direction='in' name='keepalive_interval'/>"
                << "          <arg type='u' direction='in' name='keepalive_timeout'/>"
                << "        </method>"
+               << "        <method name='GetPeerStats'>"
+               << "          <arg type='a(utttttttt)' direction='out' name='peers'/>"
+               << "        </method>"
+               << "        <method name='GetWorkerUsage'>"
+               << "          <arg type='(ttttt)' direction='out' name='usage'/>"
+               << "        </method>"
+               << "        <signal name='PeerDeleted'>"
+               << "          <arg type='u' name='peer_id'/>"
+               << "          <arg type='s' name='reason'/>"
+               << "        </signal>"
                << "    </interface>"
                << "</node>";
     ParseIntrospectionXML(introspect);
@@ -76,8 +93,21 @@ NetCfgDCO::NetCfgDCO(GDBusConnection *dbuscon, const std::string& objpath,
     }
 
     pipe.reset(new openvpn_io::posix::stream_descriptor(io_context, fds[1]));
-
-    asio_work.reset(new AsioWork(io_context));
+    pipe->non_blocking(true);
+
+    // Prepare the receive buffers for the pipe once, they are reused
+    // for every batch read by read_pipe_batch()
+    pipe_buffers.resize(pipe_batch_size * pipe_packet_size);
+    pipe_iovs.resize(pipe_batch_size);
+    pipe_msgs.resize(pipe_batch_size);
+    for (unsigned int i = 0; i < pipe_batch_size; i++)
+    {
+        pipe_iovs[i].iov_base = &pipe_buffers[i * pipe_packet_size];
+        pipe_iovs[i].iov_len = pipe_packet_size;
+        std::memset(&pipe_msgs[i], 0, sizeof(pipe_msgs[i]));
+        pipe_msgs[i].msg_hdr.msg_iov = &pipe_iovs[i];
+        pipe_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
 
     try
     {
@@ -94,16 +124,9 @@ NetCfgDCO::NetCfgDCO(GDBusConnection *dbuscon, const std::string& objpath,
         throw NetCfgException(err);
     }
 
-    th.reset(new std::thread([self=Ptr(this)]()
-                             {
-                                 self->io_context.run();
-                             }
-                            )
-        );
-
     openvpn_io::post(io_context, [self=Ptr(this)]()
                                  {
-                                         self->queue_read_pipe(nullptr);
+                                         self->queue_read_pipe();
                                          self->genl->register_packet();
                                  }
                      );
@@ -113,61 +136,75 @@ void NetCfgDCO::teardown()
 {
     ::close(fds[0]); // fds[1] will be closed by pipe dctor
 
-    if (genl)
-    {
-        genl->stop();
-    }
-
-    if (pipe)
-    {
-        pipe->close();
-    }
-
-    if (asio_work)
-    {
-        asio_work.reset();
-    }
-
-    io_context.stop();
+    // GeNL and the pipe are only used from the worker thread; once
+    // stopped, no more handlers are queued for this device
+    NetCfg::DcoWorker::Instance().RunAndWait([this]()
+                                             {
+                                                 if (genl)
+                                                 {
+                                                     genl->stop();
+                                                 }
+                                                 if (pipe)
+                                                 {
+                                                     pipe->close();
+                                                 }
+                                             });
 
     std::ostringstream os;
     TunNetlink::iface_del(os, dev_name);
-
-    if (th && th->joinable())
-    {
-        th->join();
-    }
 }
 
-void NetCfgDCO::queue_read_pipe(PacketFrom *pkt)
+void NetCfgDCO::queue_read_pipe()
 {
-    if (!pkt)
-    {
-        pkt = new PacketFrom();
-    }
-    pkt->buf.reset(0, 2048, 0);
-    pipe->async_read_some(pkt->buf.mutable_buffer(),
-        [self=Ptr(this), pkt=PacketFrom::SPtr(pkt)](const openvpn_io::error_code& error, const size_t bytes_recvd) mutable
+    pipe->async_wait(openvpn_io::posix::stream_descriptor::wait_read,
+        [self=Ptr(this)](const openvpn_io::error_code& error)
         {
             if (!error)
             {
-                uint32_t peer_id;
-
-                if (bytes_recvd < sizeof(peer_id)) {
-                    std::stringstream os;
-                    os << "Received message too small on pipe, size=" << bytes_recvd;
-                    self->signal.LogError(os.str());
-                } else {
-                    std::memcpy(&peer_id, pkt->buf.data(), sizeof(peer_id));
-                    self->genl->send_data(peer_id, pkt->buf.data() + sizeof(peer_id),
-                                          bytes_recvd - sizeof(peer_id));
-                }
-                self->queue_read_pipe(pkt.release());
+                self->read_pipe_batch();
+                self->queue_read_pipe();
             }
         }
     );
 }
 
+void NetCfgDCO::read_pipe_batch()
+{
+    int received = 0;
+    do
+    {
+        received = recvmmsg(pipe->native_handle(), pipe_msgs.data(),
+                            pipe_batch_size, MSG_DONTWAIT, nullptr);
+        if (received < 0)
+        {
+            if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+            {
+                signal.LogError("Reading from pipe failed: "
+                                + std::string(strerror(errno)));
+            }
+            return;
+        }
+
+        for (int i = 0; i < received; i++)
+        {
+            const uint8_t *data = static_cast<const uint8_t *>(pipe_iovs[i].iov_base);
+            size_t len = pipe_msgs[i].msg_len;
+            uint32_t peer_id;
+
+            if (len < sizeof(peer_id))
+            {
+                std::stringstream os;
+                os << "Received message too small on pipe, size=" << len;
+                signal.LogError(os.str());
+                continue;
+            }
+            std::memcpy(&peer_id, data, sizeof(peer_id));
+            genl->send_data(peer_id, data + sizeof(peer_id),
+                            len - sizeof(peer_id));
+        }
+    } while (received == (int) pipe_batch_size);
+}
+
 void NetCfgDCO::callback_destructor()
 {
     teardown();
@@ -188,7 +225,34 @@ bool NetCfgDCO::available()
 
 void NetCfgDCO::tun_read_handler(BufferAllocated &buf)
 {
-    pipe->write_some(buf.const_buffer());
+    // A peer removed by the kernel module on its own is reported
+    // with a signal instead of through the pipe, where it could be
+    // dropped or wait behind queued control channel packets
+    NetCfg::DcoPeerEvent ev;
+    if (NetCfg::DcoPeerEvent::Parse(buf.c_data(), buf.size(), ev)
+        && ev.Unsolicited())
+    {
+        try
+        {
+            signal.PeerDeleted(backend_bus_name, GetObjectPath(),
+                               ev.peer_id, ev.ReasonString());
+            signal.LogVerb2("Peer " + std::to_string(ev.peer_id)
+                            + " deleted by ovpn-dco: " + ev.ReasonString());
+            return;
+        }
+        catch (const std::exception& excp)
+        {
+            signal.LogError("Sending PeerDeleted failed: "
+                            + std::string(excp.what()));
+        }
+    }
+
+    openvpn_io::error_code ec;
+    pipe->write_some(buf.const_buffer(), ec);
+    if (ec && openvpn_io::error::would_block != ec)
+    {
+        signal.LogError("Writing to pipe failed: " + ec.message());
+    }
 }
 
 GVariant* NetCfgDCO::callback_get_property(GDBusConnection *conn,
@@ -224,8 +288,6 @@ void NetCfgDCO::callback_method_call(GDBusConnection *conn,
 {
     try
     {
-        IdleCheck_UpdateTimestamp();
-
         GVariant *retval = nullptr;
 
         if ("GetPipeFD" == method_name)
@@ -264,10 +326,24 @@ void NetCfgDCO::callback_method_call(GDBusConnection *conn,
         } else if ("NewKey" == method_name)
         {
             new_key(params);
+        } else if ("NewKeys" == method_name)
+        {
+            new_keys(params);
         } else if ("SwapKeys" == method_name)
         {
             swap_keys(params);
         }
+        else if ("GetPeerStats" == method_name)
+        {
+            retval = get_peer_stats();
+        }
+        else if ("GetWorkerUsage" == method_name)
+        {
+            CpuUsage u = NetCfg::DcoWorker::Instance().GetUsage();
+            retval = g_variant_new("((ttttt))", u.user_usec, u.system_usec,
+                                   u.voluntary_ctxsw, u.involuntary_ctxsw,
+                                   u.runqueue_wait_usec);
+        }
         else if ("SetPeer" == method_name)
         {
             GLibUtils::checkParams(__func__, params, "(uuu)", 3);
@@ -315,15 +391,59 @@ void NetCfgDCO::callback_method_call(GDBusConnection *conn,
     }
 }
 
+struct NetCfgDCO::KeyUpdate
+{
+    unsigned int key_slot;
+    DcoKeyConfig config;
+};
+
+
 void NetCfgDCO::new_key(GVariant* params)
 {
     GLibUtils::checkParams(__func__, params, "(us)", 2);
 
-    int key_slot = g_variant_get_uint32(g_variant_get_child_value(params, 0));
+    auto keys = std::make_shared<std::vector<KeyUpdate>>(1);
+    KeyUpdate& upd = keys->front();
+    upd.key_slot = g_variant_get_uint32(g_variant_get_child_value(params, 0));
+    upd.config.ParseFromString(base64->decode(g_variant_get_string(g_variant_get_child_value(params, 1), 0)));
+
+    submit_keys(keys);
+}
+
+void NetCfgDCO::new_keys(GVariant* params)
+{
+    GLibUtils::checkParams(__func__, params, "(a(uay))", 1);
 
-    DcoKeyConfig dco_kc;
-    dco_kc.ParseFromString(base64->decode(g_variant_get_string(g_variant_get_child_value(params, 1), 0)));
+    auto keys = std::make_shared<std::vector<KeyUpdate>>();
+    GVariantIter *key_iter = nullptr;
+    g_variant_get(params, "(a(uay))", &key_iter);
 
+    guint32 key_slot = 0;
+    GVariant *key_config = nullptr;
+    while (g_variant_iter_next(key_iter, "(u@ay)", &key_slot, &key_config))
+    {
+        gsize len = 0;
+        const void *data = g_variant_get_fixed_array(key_config, &len, 1);
+
+        KeyUpdate upd;
+        upd.key_slot = key_slot;
+        bool valid = upd.config.ParseFromArray(data, len);
+        g_variant_unref(key_config);
+        if (!valid)
+        {
+            g_variant_iter_free(key_iter);
+            throw NetCfgException("Invalid key configuration for key slot "
+                                  + std::to_string(key_slot));
+        }
+        keys->push_back(std::move(upd));
+    }
+    g_variant_iter_free(key_iter);
+
+    submit_keys(keys);
+}
+
+void NetCfgDCO::submit_keys(std::shared_ptr<std::vector<KeyUpdate>> keys)
+{
     auto copyKeyDirection = [](const DcoKeyConfig_KeyDirection& src, KoRekey::KeyDirection& dst)
         {
             dst.cipher_key = reinterpret_cast<const unsigned char*>(src.cipher_key().data());
@@ -331,20 +451,27 @@ void NetCfgDCO::new_key(GVariant* params)
             dst.cipher_key_size = src.cipher_key_size();
         };
 
+    // All keys are installed by the same handler in the worker thread,
+    // instead of waking it up once per key
     openvpn_io::post(io_context, [=, self=Ptr(this)]()
                                  {
-                                     KoRekey::KeyConfig kc;
-                                     std::memset(&kc, 0, sizeof(kc));
-                                     kc.key_id = dco_kc.key_id();
-                                     kc.remote_peer_id = dco_kc.remote_peer_id();
-                                     kc.cipher_alg = dco_kc.cipher_alg();
-
-                                     copyKeyDirection(dco_kc.encrypt(),
-                                                      kc.encrypt);
-                                     copyKeyDirection(dco_kc.decrypt(),
-                                                      kc.decrypt);
-
-                                     self->genl->new_key(key_slot, &kc);
+                                     for (const auto& upd : *keys)
+                                     {
+                                         const DcoKeyConfig& dco_kc = upd.config;
+
+                                         KoRekey::KeyConfig kc;
+                                         std::memset(&kc, 0, sizeof(kc));
+                                         kc.key_id = dco_kc.key_id();
+                                         kc.remote_peer_id = dco_kc.remote_peer_id();
+                                         kc.cipher_alg = dco_kc.cipher_alg();
+
+                                         copyKeyDirection(dco_kc.encrypt(),
+                                                          kc.encrypt);
+                                         copyKeyDirection(dco_kc.decrypt(),
+                                                          kc.decrypt);
+
+                                         self->genl->new_key(upd.key_slot, &kc);
+                                     }
                                  }
         );
 }
@@ -360,4 +487,35 @@ void NetCfgDCO::swap_keys(GVariant *params)
         self->genl->swap_keys(peer_id);
     });
 }
+
+GVariant* NetCfgDCO::get_peer_stats()
+{
+    if (!peerstats)
+    {
+        peerstats.reset(new NetCfg::DcoPeerStats());
+    }
+
+    std::vector<NetCfg::DcoPeerCounters> peers;
+    try
+    {
+        peers = peerstats->Dump(if_nametoindex(dev_name.c_str()));
+    }
+    catch (const NetCfgException&)
+    {
+        // Start over with a fresh socket on the next call
+        peerstats.reset();
+        throw;
+    }
+
+    GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(utttttttt)"));
+    for (const auto& p : peers)
+    {
+        g_variant_builder_add(bld, "(utttttttt)", p.peer_id,
+                              p.vpn_rx_bytes, p.vpn_tx_bytes,
+                              p.vpn_rx_packets, p.vpn_tx_packets,
+                              p.link_rx_bytes, p.link_tx_bytes,
+                              p.link_rx_packets, p.link_tx_packets);
+    }
+    return GLibUtils::wrapInTuple(bld);
+}
 #endif  // ENABLE_OVPNDCO
@@ -20,15 +20,18 @@
 #pragma once
 #ifdef ENABLE_OVPNDCO
 
+#include <vector>
+#include <sys/socket.h>
+
 #include <openvpn/common/rc.hpp>
 #include <openvpn/io/io.hpp>
 #include <openvpn/tun/linux/client/genl.hpp>
 #include <openvpn/buffer/buffer.hpp>
 
-#include <openvpn/asio/asiowork.hpp>
-
 #include "dbus/core.hpp"
 #include "netcfg-signals.hpp"
+#include "dco-peerstats.hpp"
+#include "dco-worker.hpp"
 
 class NetCfgDCO : public DBusObject, public RC<thread_safe_refcount>
 {
@@ -75,31 +78,75 @@ public:
     static bool available();
 
     /**
-     * Called by GeNL in worker thread when there is incoming data or event from kernel
+     * Called by GeNL in the shared DCO worker thread when there is
+     * incoming data or event from kernel.  Packets are dropped if the
+     * backend client does not keep up, as the worker thread must not
+     * block.
      *
      * @param buf
      */
     void tun_read_handler(BufferAllocated& buf);
 
     /**
-     * Deletes ovpn-dco net dev, stops ASIO event loop and GeNL and
-     * waits for worker thread to exit.
+     * Stops GeNL and the pipe in the shared DCO worker thread and
+     * deletes the ovpn-dco net dev.
      */
     void teardown();
 
     void callback_destructor() override;
 
 private:
+    /// A single key update for the kernel module
+    struct KeyUpdate;
+
     void new_key(GVariant *params);
 
+    /**
+     *  Handles the NewKeys D-Bus method, which carries several binary
+     *  DcoKeyConfig objects in a single call
+     */
+    void new_keys(GVariant *params);
+
+    /**
+     *  Hands over a set of key updates to the GeNL worker thread in a
+     *  single operation
+     */
+    void submit_keys(std::shared_ptr<std::vector<KeyUpdate>> keys);
+
     void swap_keys(GVariant *params);
 
-    struct PacketFrom {
-        typedef std::unique_ptr<PacketFrom> SPtr;
-        BufferAllocated buf;
-    };
+    /**
+     *  Retrieves the traffic counters of all peers from the kernel
+     *  module
+     *
+     * @return Returns a GVariant tuple with an a(utttttttt) array of
+     *         the counters of each peer
+     */
+    GVariant* get_peer_stats();
+
+    /**
+     *  Waits for control channel packets from the backend client on
+     *  the pipe
+     */
+    void queue_read_pipe();
+
+    /**
+     *  Reads all pending packets from the pipe, in batches of
+     *  pipe_batch_size packets per recvmmsg() call, and passes them on
+     *  to the kernel module
+     */
+    void read_pipe_batch();
+
+    /// Maximum number of packets read from the pipe in a single call
+    static const unsigned int pipe_batch_size = 32;
 
-    void queue_read_pipe(PacketFrom*);
+    /// Size of each packet buffer, including the peer-id prefix
+    static const size_t pipe_packet_size = 2048;
+
+    // Receive buffers for read_pipe_batch(), allocated once
+    std::vector<uint8_t> pipe_buffers;
+    std::vector<struct iovec> pipe_iovs;
+    std::vector<struct mmsghdr> pipe_msgs;
 
     std::string backend_bus_name;
 
@@ -109,12 +156,10 @@ private:
     std::unique_ptr<openvpn_io::posix::stream_descriptor> pipe;
 
     GeNLImpl::Ptr genl;
-    openvpn_io::io_context io_context;
-
-    // thread where ASIO event loop runs, used by GeNL and pipe
-    std::unique_ptr<std::thread> th;
+    NetCfg::DcoPeerStats::Ptr peerstats;
 
-    std::unique_ptr<AsioWork> asio_work;
+    // ASIO event loop shared by all DCO devices, used by GeNL and pipe
+    openvpn_io::io_context& io_context;
 
     std::string dev_name;
 };
@@ -0,0 +1,328 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-device-store.hpp
+ *
+ * @brief  Record of the virtual network devices configured by netcfg,
+ *         used by a restarted netcfg service to take them over
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <json/json.h>
+
+#include "common/boot-id.hpp"
+#include "netcfg-routeset.hpp"
+
+
+namespace NetCfg
+{
+    /**
+     *  The configuration of a virtual network device, as provided by
+     *  the VPN backend process which owns it
+     */
+    struct DeviceRecord
+    {
+        struct Address
+        {
+            std::string address;
+            unsigned int prefix = 0;
+            std::string gateway;
+            bool ipv6 = false;
+        };
+
+        std::string object_path;
+        std::string device_name;
+        uid_t owner = 0;
+        pid_t owner_pid = 0;
+        unsigned int layer = 0;
+        unsigned int mtu = 0;
+        unsigned int txqueuelen = 0;
+        bool reroute_ipv4 = false;
+        bool reroute_ipv6 = false;
+        std::string bundle;
+        std::vector<Address> addresses;
+        std::vector<RouteEntry> networks;
+        std::string remote;
+        bool remote_ipv6 = false;
+        std::vector<std::string> dns_servers;
+        std::vector<std::string> dns_search;
+        unsigned int dns_scope = 0;
+        bool dco = false;
+
+
+        Json::Value Export() const
+        {
+            Json::Value ret;
+            ret["device_name"] = device_name;
+            ret["owner"] = (Json::UInt) owner;
+            ret["owner_pid"] = (Json::Int) owner_pid;
+            ret["layer"] = layer;
+            ret["mtu"] = mtu;
+            ret["txqueuelen"] = txqueuelen;
+            ret["reroute_ipv4"] = reroute_ipv4;
+            ret["reroute_ipv6"] = reroute_ipv6;
+            ret["bundle"] = bundle;
+            ret["addresses"] = Json::Value(Json::arrayValue);
+            for (const auto& a : addresses)
+            {
+                Json::Value addr;
+                addr["address"] = a.address;
+                addr["prefix"] = a.prefix;
+                addr["gateway"] = a.gateway;
+                addr["ipv6"] = a.ipv6;
+                ret["addresses"].append(addr);
+            }
+            ret["networks"] = Json::Value(Json::arrayValue);
+            for (const auto& n : networks)
+            {
+                Json::Value net;
+                net["address"] = n.address;
+                net["prefix"] = n.prefix;
+                net["ipv6"] = n.ipv6;
+                net["exclude"] = n.exclude;
+                ret["networks"].append(net);
+            }
+            ret["remote"] = remote;
+            ret["remote_ipv6"] = remote_ipv6;
+            ret["dns_servers"] = Json::Value(Json::arrayValue);
+            for (const auto& s : dns_servers)
+            {
+                ret["dns_servers"].append(s);
+            }
+            ret["dns_search"] = Json::Value(Json::arrayValue);
+            for (const auto& d : dns_search)
+            {
+                ret["dns_search"].append(d);
+            }
+            ret["dns_scope"] = dns_scope;
+            ret["dco"] = dco;
+            return ret;
+        }
+
+
+        static DeviceRecord Import(const std::string& path,
+                                   const Json::Value& data)
+        {
+            DeviceRecord r;
+            r.object_path = path;
+            r.device_name = data["device_name"].asString();
+            r.owner = (uid_t) data["owner"].asUInt();
+            r.owner_pid = (pid_t) data["owner_pid"].asInt();
+            r.layer = data["layer"].asUInt();
+            r.mtu = data["mtu"].asUInt();
+            r.txqueuelen = data["txqueuelen"].asUInt();
+            r.reroute_ipv4 = data["reroute_ipv4"].asBool();
+            r.reroute_ipv6 = data["reroute_ipv6"].asBool();
+            r.bundle = data["bundle"].asString();
+            for (const auto& a : data["addresses"])
+            {
+                Address addr;
+                addr.address = a["address"].asString();
+                addr.prefix = a["prefix"].asUInt();
+                addr.gateway = a["gateway"].asString();
+                addr.ipv6 = a["ipv6"].asBool();
+                r.addresses.push_back(addr);
+            }
+            for (const auto& n : data["networks"])
+            {
+                r.networks.emplace_back(n["address"].asString(),
+                                        n["prefix"].asUInt(),
+                                        n["ipv6"].asBool(),
+                                        n["exclude"].asBool());
+            }
+            r.remote = data["remote"].asString();
+            r.remote_ipv6 = data["remote_ipv6"].asBool();
+            for (const auto& s : data["dns_servers"])
+            {
+                r.dns_servers.push_back(s.asString());
+            }
+            for (const auto& d : data["dns_search"])
+            {
+                r.dns_search.push_back(d.asString());
+            }
+            r.dns_scope = data["dns_scope"].asUInt();
+            r.dco = data["dco"].asBool();
+            return r;
+        }
+    };
+
+
+
+    /**
+     *  The VPN backend processes keep their virtual network devices if
+     *  the netcfg service exits unexpectedly; the kernel keeps the
+     *  devices, addresses and routes as long as the backend holds the
+     *  tun device open.  To be able to manage them again, netcfg records
+     *  the configuration of each established device here, which is
+     *  written to a file each time it changes.  A restarted netcfg
+     *  service loads the file and re-creates the D-Bus objects of the
+     *  devices whose backend process and kernel device still exist.
+     *
+     *  The file carries the boot ID of the kernel, so devices recorded
+     *  before the host was rebooted are never taken over.
+     *
+     *  All methods are thread-safe.
+     */
+    class DeviceStore
+    {
+    public:
+        /// Bumped when the file format changes incompatibly
+        static const int Version = 1;
+
+
+        /**
+         * @param boot_id  std::string identifying the current boot of
+         *                 the host, see get_boot_id()
+         */
+        DeviceStore(const std::string& boot_id = get_boot_id())
+            : boot_id(boot_id)
+        {
+        }
+
+
+        /**
+         *  Adds or replaces the record of a device
+         *
+         * @param rec  DeviceRecord to record
+         */
+        void Set(const DeviceRecord& rec)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            records[rec.object_path] = rec;
+        }
+
+
+        /**
+         *  Removes the record of a device
+         *
+         * @param object_path  std::string with the D-Bus path of the device
+         *
+         * @return Returns true if the device was recorded
+         */
+        bool Remove(const std::string& object_path)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            return records.erase(object_path) > 0;
+        }
+
+
+        /**
+         * @return Returns a copy of all the recorded devices
+         */
+        std::vector<DeviceRecord> GetAll() const
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            std::vector<DeviceRecord> ret;
+            for (const auto& r : records)
+            {
+                ret.push_back(r.second);
+            }
+            return ret;
+        }
+
+
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            return records.size();
+        }
+
+
+        /**
+         * @return Returns all the recorded devices as compact JSON
+         */
+        std::string Serialize() const
+        {
+            Json::Value data;
+            data["version"] = Version;
+            data["boot_id"] = boot_id;
+            data["devices"] = Json::Value(Json::objectValue);
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                for (const auto& r : records)
+                {
+                    data["devices"][r.first] = r.second.Export();
+                }
+            }
+
+            Json::StreamWriterBuilder wr;
+            wr["indentation"] = "";
+            return Json::writeString(wr, data);
+        }
+
+
+        /**
+         *  Replaces the recorded devices with the ones in a file written
+         *  from Serialize().  Data from another boot of the host, of
+         *  another format version or which cannot be parsed results in
+         *  an empty store.
+         *
+         * @param content  std::string with the JSON data
+         *
+         * @return Returns the number of devices loaded
+         */
+        size_t Parse(const std::string& content)
+        {
+            Json::Value data;
+            Json::CharReaderBuilder rd;
+            std::string errors;
+            std::istringstream in(content);
+
+            std::lock_guard<std::mutex> guard(mtx);
+            records.clear();
+            if (!Json::parseFromStream(rd, in, &data, &errors)
+                || !data.isObject()
+                || data["version"].asInt() != Version
+                || data["boot_id"].asString() != boot_id
+                || !data["devices"].isObject())
+            {
+                return 0;
+            }
+
+            for (const auto& path : data["devices"].getMemberNames())
+            {
+                const Json::Value& d = data["devices"][path];
+                if (!d.isObject())
+                {
+                    continue;
+                }
+                DeviceRecord r = DeviceRecord::Import(path, d);
+                if (!r.device_name.empty() && r.owner_pid > 0)
+                {
+                    records[path] = r;
+                }
+            }
+            return records.size();
+        }
+
+
+    private:
+        mutable std::mutex mtx;
+        const std::string boot_id;
+        std::map<std::string, DeviceRecord> records;
+    };
+} // namespace NetCfg
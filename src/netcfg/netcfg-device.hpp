@@ -29,6 +29,14 @@
 #pragma once
 
 #include <functional>
+#include <future>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <net/if.h>
 #include <gio/gunixfdlist.h>
 #include <gio/gunixconnection.h>
 
@@ -38,14 +46,27 @@
 #include "dbus/connection-creds.hpp"
 #include "dbus/glibutils.hpp"
 #include "dbus/object-property.hpp"
+#include "dbus/resource-usage.hpp"
 #include "common/lookup.hpp"
+#include "common/numa-topology.hpp"
+#include "bpf-accounting.hpp"
 #include "core-tunbuilder.hpp"
+#include "cpu-steering.hpp"
+#include "netlink-monitor.hpp"
+#include "packet-capture.hpp"
+#include "queue-discipline.hpp"
+#include "tun-pool.hpp"
+#include "netcfg/dns/commit-queue.hpp"
 #include "netcfg/dns/resolver-settings.hpp"
 #include "netcfg/dns/settings-manager.hpp"
 #include "netcfg-options.hpp"
 #include "netcfg-changeevent.hpp"
+#include "netcfg-device-store.hpp"
+#include "netcfg-routeset.hpp"
+#include "dco-capability.hpp"
 #include "netcfg-signals.hpp"
 #include "netcfg-subscriptions.hpp"
+#include "netcfg-workers.hpp"
 
 #ifdef ENABLE_OVPNDCO
 #include "netcfg-dco.hpp"
@@ -152,7 +173,8 @@ public:
                  DNS::SettingsManager::Ptr resolver,
                  NetCfgSubscriptions::Ptr subscriptions,
                  const unsigned int log_level, LogWriter *logwr,
-                 NetCfgOptions options)
+                 NetCfgOptions options,
+                 NetCfgWorkerPool::Ptr workers)
         : DBusObject(objpath),
           DBusCredentials(dbuscon, creator),
           remove_callback(std::move(remove_callback)),
@@ -162,6 +184,8 @@ public:
           signal(dbuscon, LogGroup::NETCFG, objpath, logwr),
           resolver(resolver),
           options(std::move(options)),
+          workers(workers),
+          strand(workers->NewStrand()),
           creatorPid(creator_pid)
     {
         signal.SetLogLevel(log_level);
@@ -177,65 +201,97 @@ public:
         properties.AddBinding(new PropertyType<unsigned int>(this, "txqueuelen", "readwrite", false, txqueuelen));
         properties.AddBinding(new PropertyType<bool>(this, "reroute_ipv4", "readwrite", false, reroute_ipv4));
         properties.AddBinding(new PropertyType<bool>(this, "reroute_ipv6", "readwrite", false, reroute_ipv6));
+        properties.AddBinding(new PropertyType<std::string>(this, "bundle", "readwrite", false, bundle));
+        properties.AddBinding(new PropertyType<std::string>(this, "steering_cpus", "read", false, steering_cpus));
+        properties.AddBinding(new PropertyType<std::string>(this, "egress_numa_node", "read", false, egress_numa_node));
+        properties.AddBinding(new PropertyType<std::string>(this, "qdisc", "read", false, active_qdisc));
 
 
-        std::stringstream introspect;
-        introspect << "<node name='" << objpath << "'>"
-                   << "    <interface name='" << OpenVPN3DBus_interf_netcfg << "'>"
-                   << "        <method name='AddIPAddress'>"
-                   << "            <arg direction='in' type='s' name='ip_address'/>"
-                   << "            <arg direction='in' type='u' name='prefix'/>"
-                   << "            <arg direction='in' type='s' name='gateway'/>"
-                   << "            <arg direction='in' type='b' name='ipv6'/>"
-                   << "        </method>"
-                   << "        <method name='SetRemoteAddress'>"
-                   << "            <arg direction='in' type='s' name='ip_address'/>"
-                   << "            <arg direction='in' type='b' name='ipv6'/>"
-                   << "        </method>"
-                   << "        <method name='AddNetworks'>"
-                   << "            <arg direction='in' type='a(subb)' name='networks'/>"
-                   << "        </method>"
-                   << "        <method name='AddDNS'>"
-                   << "            <arg direction='in' type='as' name='server_list'/>"
-                   << "        </method>"
-                   << "        <method name='AddDNSSearch'>"
-                   << "            <arg direction='in' type='as' name='domains'/>"
-                   << "        </method>"
+        // D-Bus Set calls are replied to once applied in a worker thread
+        EnableAsyncPropertySet();
+
+        // All device objects share the same parsed introspection document
+        ParseIntrospectionXML("NetCfgDevice", [this]()
+            {
+                std::stringstream introspect;
+                introspect << "<node>"
+                           << "    <interface name='" << OpenVPN3DBus_interf_netcfg << "'>"
+                           << "        <method name='AddIPAddress'>"
+                           << "            <arg direction='in' type='s' name='ip_address'/>"
+                           << "            <arg direction='in' type='u' name='prefix'/>"
+                           << "            <arg direction='in' type='s' name='gateway'/>"
+                           << "            <arg direction='in' type='b' name='ipv6'/>"
+                           << "        </method>"
+                           << "        <method name='SetRemoteAddress'>"
+                           << "            <arg direction='in' type='s' name='ip_address'/>"
+                           << "            <arg direction='in' type='b' name='ipv6'/>"
+                           << "        </method>"
+                           << "        <method name='AddNetworks'>"
+                           << "            <arg direction='in' type='a(subb)' name='networks'/>"
+                           << "        </method>"
+                           << "        <method name='RemoveNetworks'>"
+                           << "            <arg direction='in' type='a(subb)' name='networks'/>"
+                           << "        </method>"
+                           << "        <method name='AddDNS'>"
+                           << "            <arg direction='in' type='as' name='server_list'/>"
+                           << "        </method>"
+                           << "        <method name='AddDNSSearch'>"
+                           << "            <arg direction='in' type='as' name='domains'/>"
+                           << "        </method>"
 #ifdef ENABLE_OVPNDCO
-                   << "        <method name='EnableDCO'>"
-                   << "            <arg direction='in' type='s' name='dev_name'/>"
-                   << "            <arg type='o' direction='out' name='dco_device_path'/>"
-                   << "        </method>"
+                           << "        <method name='EnableDCO'>"
+                           << "            <arg direction='in' type='s' name='dev_name'/>"
+                           << "            <arg type='o' direction='out' name='dco_device_path'/>"
+                           << "        </method>"
 #endif
-                   << "        <method name='Establish'/>"
-                                /* Note: Although in non-DCO mode Establish
-                                 * returns a unix_fd, it does not belong in the
-                                 * method signature, since glib/dbus abstraction
-                                 * is paper thin and it is handled almost like
-                                 * in recv/sendmsg as auxiliary data
-                                 */
-                   << "        <method name='Disable'/>"
-                   << "        <method name='Destroy'/>"
-                   << "        <property type='u'  name='log_level' access='readwrite'/>"
-                   << "        <property type='u'  name='owner' access='read'/>"
-                   << "        <property type='au' name='acl' access='read'/>"
-                   << "        <property type='b'  name='active' access='read'/>"
-                   << "        <property type='b'  name='modified' access='read'/>"
-                   << "        <property type='s'  name='dns_scope' access='readwrite'/>"
-                   << "        <property type='as'  name='dns_name_servers' access='read'/>"
-                   << "        <property type='as'  name='dns_search_domains' access='read'/>"
-                   << properties.GetIntrospectionXML()
-                   << signal.GetLogIntrospection()
-                   << NetCfgChangeEvent::IntrospectionXML()
-                   << "    </interface>"
-                   << "</node>";
-        ParseIntrospectionXML(introspect);
+                           << "        <method name='ApplyConfiguration'>"
+                           << "            <arg direction='in' type='a{sv}' name='configuration'/>"
+                           << "        </method>"
+                           << "        <method name='Establish'/>"
+                                        /* Note: Although in non-DCO mode Establish
+                                         * returns a unix_fd, it does not belong in the
+                                         * method signature, since glib/dbus abstraction
+                                         * is paper thin and it is handled almost like
+                                         * in recv/sendmsg as auxiliary data.
+                                         * The same applies to ApplyConfiguration.
+                                         */
+                           << "        <method name='AdjustMTU'>"
+                           << "            <arg direction='in' type='u' name='mtu'/>"
+                           << "        </method>"
+                           << "        <method name='Disable'/>"
+                           << "        <method name='StartCapture'>"
+                           << "            <arg direction='in' type='a{sv}' name='options'/>"
+                           << "        </method>"
+                                        /* Note: The file descriptor the capture
+                                         * is written to is passed as auxiliary
+                                         * data, like the one returned by Establish.
+                                         */
+                           << "        <method name='StopCapture'/>"
+                           << "        <method name='Destroy'/>"
+                           << "        <property type='u'  name='log_level' access='readwrite'/>"
+                           << "        <property type='u'  name='owner' access='read'/>"
+                           << "        <property type='au' name='acl' access='read'/>"
+                           << "        <property type='b'  name='active' access='read'/>"
+                           << "        <property type='b'  name='modified' access='read'/>"
+                           << "        <property type='s'  name='dns_scope' access='readwrite'/>"
+                           << "        <property type='as'  name='dns_name_servers' access='read'/>"
+                           << "        <property type='as'  name='dns_search_domains' access='read'/>"
+                           << "        <property type='a(sssstt)' name='traffic_accounting' access='read'/>"
+                           << properties.GetIntrospectionXML()
+                           << signal.GetLogIntrospection()
+                           << NetCfgChangeEvent::IntrospectionXML()
+                           << "    </interface>"
+                           << "</node>";
+                return introspect.str();
+            });
 
         // Prepare the DNS ResolverSettings object for this interface
         if (resolver)
         {
+            std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
             dnsconfig = resolver->NewResolverSettings();
         }
+        publish_snapshot();
 
         signal.LogVerb2("Network device '" + devname + "' prepared");
     }
@@ -251,6 +307,20 @@ public:
         return device_name;
     }
 
+
+    /**
+     *  Retrieve the device name from outside of the queued device
+     *  operations, which may change it while running in a worker thread.
+     *  This does not wait for a running operation.
+     *
+     * @return Returns a std::string with the device name as of the last
+     *         completed device operation
+     */
+    std::string GetDeviceName() const
+    {
+        return get_snapshot()->device_name;
+    }
+
     /**
      * Return the pid of the process that created this device
      * @return pid of the process that created this object
@@ -261,6 +331,132 @@ public:
     }
 
 
+    /**
+     *  Set the shared DCOCapability object which is updated with the
+     *  outcome of EnableDCO calls on this device
+     *
+     * @param dcocap  DCOCapability::Ptr to use
+     */
+    void SetDCOCapability(DCOCapability::Ptr dcocap)
+    {
+        dco_capability = dcocap;
+    }
+
+
+    /**
+     *  Set the pool of tun devices to take a device from when this
+     *  device is established.  Without it, the Core library creates a
+     *  new tun device.
+     *
+     * @param pool  NetCfg::TunPool::Ptr to use, may be nullptr
+     */
+    void SetTunPool(NetCfg::TunPool::Ptr pool)
+    {
+        tun_pool = pool;
+    }
+
+
+    /**
+     *  Set the DNS::CommitQueue applying the DNS resolver settings.
+     *  Without it, the settings are applied directly by this device.
+     *
+     * @param commits  DNS::CommitQueue::Ptr to use
+     */
+    void SetDNSCommitQueue(DNS::CommitQueue::Ptr commits)
+    {
+        dns_commits = commits;
+    }
+
+
+    /**
+     *  Set the function called each time the configuration of the
+     *  established device changes.  It gets the record a restarted
+     *  netcfg service needs to take over the device, or nullptr once
+     *  the device is no longer established.  This is called from a
+     *  worker thread.
+     *
+     * @param cb  Function to call with the NetCfg::DeviceRecord
+     */
+    void SetStateCallback(std::function<void(const NetCfg::DeviceRecord *)> cb)
+    {
+        state_callback = std::move(cb);
+    }
+
+
+    /**
+     *  Takes over a device established by a previous netcfg service
+     *  process.  The virtual device and its addresses and routes are
+     *  left untouched on the host; they stay in place as long as the
+     *  backend process keeps its file descriptor to the tun device.
+     *  The DNS resolver settings are restored and take effect with the
+     *  next resolver update.
+     *
+     *  Changes to the routes of an adopted device are applied with the
+     *  next Establish call, which creates a new virtual device.
+     *
+     * @param rec  NetCfg::DeviceRecord recorded by the previous process
+     */
+    void Restore(const NetCfg::DeviceRecord& rec)
+    {
+        std::lock_guard<std::mutex> guard(state_mtx);
+        device_name = rec.device_name;
+        device_type = rec.layer;
+        mtu = rec.mtu;
+        txqueuelen = rec.txqueuelen;
+        reroute_ipv4 = rec.reroute_ipv4;
+        reroute_ipv6 = rec.reroute_ipv6;
+        bundle = rec.bundle;
+        for (const auto& a : rec.addresses)
+        {
+            vpnips.emplace_back(VPNAddress(a.address, a.prefix,
+                                           a.gateway, a.ipv6));
+        }
+        for (const auto& n : rec.networks)
+        {
+            networks.Add(n);
+        }
+        remote = IPAddr(rec.remote, rec.remote_ipv6);
+
+        if (resolver && dnsconfig)
+        {
+            std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+            for (const auto& srv : rec.dns_servers)
+            {
+                dnsconfig->AddNameServer(srv);
+            }
+            for (const auto& dom : rec.dns_search)
+            {
+                dnsconfig->AddSearchDomain(dom);
+            }
+            dnsconfig->SetDNSScope(rec.dns_scope > 0 ? DNS::Scope::TUNNEL
+                                                     : DNS::Scope::GLOBAL);
+            dnsconfig->SetDeviceName(device_name);
+            dnsconfig->Enable();
+        }
+        adopted = true;
+        publish_snapshot();
+
+        signal.LogVerb1("Took over established device '" + device_name + "'");
+    }
+
+
+    /**
+     *  Adds the approximate memory use of this device object to a
+     *  resource usage report
+     *
+     * @param report  DBusResourceUsage::Report to add to
+     */
+    void ReportResourceUsage(DBusResourceUsage::Report& report) const
+    {
+        auto snap = get_snapshot();
+        report.Add("devices", 1, sizeof(*this));
+        report.Add("vpn_addresses", snap->vpn_addresses,
+                   snap->vpn_addresses_capacity * sizeof(VPNAddress));
+        report.Add("vpn_networks", snap->vpn_networks,
+                   snap->vpn_networks * sizeof(NetCfg::RouteEntry));
+    }
+
+
 protected:
     void set_device_name(const std::string& devnam) noexcept
     {
@@ -270,6 +466,144 @@ protected:
 
 
 private:
+    /**
+     * @return Returns the device state published after the last device
+     *         operation
+     */
+    std::shared_ptr<const PropertySnapshot> get_snapshot() const
+    {
+        std::lock_guard<std::mutex> guard(snapshot_mtx);
+        return snapshot;
+    }
+
+
+    /**
+     *  Publishes the current device state to be read from the main loop
+     *  and flags the bound properties which changed since the previous
+     *  one.  This must be called with the state lock held, or before any
+     *  device operation has been queued.
+     */
+    void publish_snapshot()
+    {
+        auto snap = std::make_shared<PropertySnapshot>();
+        snap->device_name = device_name;
+        snap->layer = device_type;
+        snap->mtu = mtu;
+        snap->txqueuelen = txqueuelen;
+        snap->reroute_ipv4 = reroute_ipv4;
+        snap->reroute_ipv6 = reroute_ipv6;
+        snap->bundle = bundle;
+        snap->steering_cpus = steering_cpus;
+        snap->egress_numa_node = egress_numa_node;
+        snap->qdisc = active_qdisc;
+        snap->active = active;
+        snap->modified = modified;
+        snap->log_level = signal.GetLogLevel();
+        snap->vpn_addresses = vpnips.size();
+        snap->vpn_addresses_capacity = vpnips.capacity();
+        snap->vpn_networks = networks.size();
+        snap->traffic_acct = traffic_acct.get();
+
+        std::shared_ptr<const PropertySnapshot> prev;
+        {
+            std::lock_guard<std::mutex> guard(snapshot_mtx);
+            prev = snapshot;
+            snapshot = snap;
+        }
+        if (!prev)
+        {
+            return;
+        }
+
+        for (const auto& p : {"device_name", "layer", "mtu", "txqueuelen",
+                              "reroute_ipv4", "reroute_ipv6", "bundle",
+                              "steering_cpus", "egress_numa_node", "qdisc"})
+        {
+            GVariant *before = g_variant_ref_sink(snapshot_value(*prev, p));
+            GVariant *after = g_variant_ref_sink(snapshot_value(*snap, p));
+            if (!g_variant_equal(before, after))
+            {
+                std::string name(p);
+                properties.SetChanged(name, [this, name]()
+                                      {
+                                          return snapshot_value(*get_snapshot(),
+                                                                name);
+                                      });
+            }
+            g_variant_unref(before);
+            g_variant_unref(after);
+        }
+    }
+
+
+    /**
+     *  Retrieve a property value from a published device state
+     *
+     * @param snap  PropertySnapshot to read from
+     * @param name  std::string with the property name
+     *
+     * @return Returns a new GVariant with the value, or nullptr if the
+     *         property is not part of the snapshot
+     */
+    static GVariant *snapshot_value(const PropertySnapshot& snap,
+                                    const std::string& name)
+    {
+        if ("device_name" == name)
+        {
+            return g_variant_new_string(snap.device_name.c_str());
+        }
+        else if ("layer" == name)
+        {
+            return g_variant_new_uint32(snap.layer);
+        }
+        else if ("mtu" == name)
+        {
+            return g_variant_new_uint32(snap.mtu);
+        }
+        else if ("txqueuelen" == name)
+        {
+            return g_variant_new_uint32(snap.txqueuelen);
+        }
+        else if ("reroute_ipv4" == name)
+        {
+            return g_variant_new_boolean(snap.reroute_ipv4);
+        }
+        else if ("reroute_ipv6" == name)
+        {
+            return g_variant_new_boolean(snap.reroute_ipv6);
+        }
+        else if ("bundle" == name)
+        {
+            return g_variant_new_string(snap.bundle.c_str());
+        }
+        else if ("steering_cpus" == name)
+        {
+            return g_variant_new_string(snap.steering_cpus.c_str());
+        }
+        else if ("egress_numa_node" == name)
+        {
+            return g_variant_new_string(snap.egress_numa_node.c_str());
+        }
+        else if ("qdisc" == name)
+        {
+            return g_variant_new_string(snap.qdisc.c_str());
+        }
+        else if ("active" == name)
+        {
+            return g_variant_new_boolean(snap.active);
+        }
+        else if ("modified" == name)
+        {
+            return g_variant_new_boolean(snap.modified);
+        }
+        else if ("log_level" == name)
+        {
+            return g_variant_new_uint32(snap.log_level);
+        }
+        return nullptr;
+    }
+
+
     void addIPAddress(GVariant* params)
     {
         GLibUtils::checkParams(__func__, params, "(susb)", 4);
@@ -300,322 +634,1495 @@ private:
         remote = IPAddr(std::string(ipaddr), ipv6);
     }
 
-    void addNetworks(GVariant* params)
+
+    /**
+     *  Changes the MTU of the established device, without re-creating
+     *  it.  Used by backends discovering the path MTU to the server.
+     *
+     * @param params  GVariant object containing the (u) MTU value
+     */
+    void adjustMTU(GVariant* params)
+    {
+        GLibUtils::checkParams(__func__, params, "(u)", 1);
+        unsigned int new_mtu = GLibUtils::ExtractValue<unsigned int>(params, 0);
+        if (new_mtu < 68 || new_mtu > 65535)
+        {
+            throw NetCfgException("Invalid MTU: " + std::to_string(new_mtu));
+        }
+        if (device_name.empty())
+        {
+            throw NetCfgException("Device is not established");
+        }
+        if (new_mtu == mtu)
+        {
+            return;
+        }
+
+        set_device_mtu(device_name, new_mtu);
+        signal.LogInfo("Changed MTU of " + device_name + " from "
+                       + std::to_string(mtu) + " to "
+                       + std::to_string(new_mtu));
+        mtu = new_mtu;
+    }
+
+    /**
+     *  Parses the a(subb) array of networks used by the AddNetworks and
+     *  RemoveNetworks D-Bus methods
+     *
+     * @param params  GVariant object containing the (a(subb)) array
+     *
+     * @return Returns a std::vector with the networks
+     */
+    std::vector<RouteEntry> parse_networks(GVariant* params)
     {
         GLibUtils::checkParams(__func__, params, "(a(subb))", 1);
-        GVariantIter* network_iter;
-        g_variant_get(params, "(a(subb))", &network_iter);
 
-        GVariant *network = nullptr;
-        while ((network = g_variant_iter_next_value(network_iter)))
+        typedef std::tuple<std::string, uint32_t, bool, bool> NetTuple;
+        GVariant *list = g_variant_get_child_value(params, 0);
+        std::vector<RouteEntry> ret;
+        try
+        {
+            for (const auto& n : GLibUtils::Unmarshal<std::vector<NetTuple>>(list))
+            {
+                check_prefix(std::get<0>(n), std::get<1>(n), std::get<2>(n));
+                ret.emplace_back(RouteEntry(std::get<0>(n), std::get<1>(n),
+                                            std::get<2>(n), std::get<3>(n)));
+            }
+        }
+        catch (...)
+        {
+            g_variant_unref(list);
+            throw;
+        }
+        g_variant_unref(list);
+        return ret;
+    }
+
+
+    /**
+     *  Adds networks to route via or exclude from the VPN.  If the
+     *  device is already established, only the new routes via the VPN
+     *  are installed right away.
+     *
+     * @param params  GVariant object containing the (a(subb)) array
+     */
+    void addNetworks(GVariant* params)
+    {
+        RouteSet::Diff diff;
+        for (const auto& net : parse_networks(params))
         {
-            GLibUtils::checkParams(__func__, network, "(subb)", 4);
+            if (networks.Add(net))
+            {
+                diff.added.push_back(net);
+            }
+        }
 
-            std::string net(g_variant_get_string(g_variant_get_child_value(network, 0), 0));
-            uint32_t prefix = g_variant_get_uint32(g_variant_get_child_value(network, 1));
-            bool ipv6 = g_variant_get_boolean(g_variant_get_child_value(network, 2));
-            bool exclude = g_variant_get_boolean(g_variant_get_child_value(network, 3));
+        signal.LogInfo("Adding " + std::to_string(diff.added.size())
+                       + " networks");
+        if (signal.LogEnabled(LogCategory::DEBUG))
+        {
+            for (const auto& net : diff.added)
+            {
+                signal.Debug(device_name,
+                             "Adding network '" + net.str() + "'"
+                             + " excl: " + (net.exclude ? "yes" : "no")
+                             + " ipv6: " + (net.ipv6 ? "yes" : "no"));
+            }
+        }
+        update_routes(diff);
+    }
 
-            signal.LogInfo(std::string("Adding network '") + net + "/"
-                           + std::to_string(prefix)
-                           + "' excl: " + (exclude ? "yes" : "no")
-                           + " ipv6: " + (ipv6 ? "yes" : "no"));
 
-            networks.emplace_back(Network(std::string(net), prefix,
-                                          ipv6, exclude));
+    /**
+     *  Removes networks previously added.  If the device is already
+     *  established, only the removed routes via the VPN are deleted.
+     *
+     * @param params  GVariant object containing the (a(subb)) array
+     */
+    void removeNetworks(GVariant* params)
+    {
+        RouteSet::Diff diff;
+        for (const auto& net : parse_networks(params))
+        {
+            if (networks.Remove(net))
+            {
+                diff.removed.push_back(net);
+            }
         }
-        g_variant_iter_free(network_iter);
 
+        signal.LogInfo("Removing " + std::to_string(diff.removed.size())
+                       + " networks");
+        update_routes(diff);
     }
 
 
-public:
     /**
-     *  Callback method which is called each time a D-Bus method call occurs
-     *  on this BackendClientObject.
+     *  Applies network changes to an established device
      *
-     * @param conn        D-Bus connection where the method call occurred
-     * @param sender      D-Bus bus name of the sender of the method call
-     * @param obj_path    D-Bus object path of the target object.
-     * @param intf_name   D-Bus interface of the method call
-     * @param method_name D-Bus method name to be executed
-     * @param params      GVariant Glib2 object containing the arguments for
-     *                    the method call
-     * @param invoc       GDBusMethodInvocation where the response/result of
-     *                    the method call will be returned.
+     * @param diff  RouteSet::Diff with the changed networks
      */
-    void callback_method_call(GDBusConnection *conn,
-                              const std::string sender,
-                              const std::string obj_path,
-                              const std::string intf_name,
-                              const std::string method_name,
-                              GVariant *params,
-                              GDBusMethodInvocation *invoc)
+    void update_routes(const RouteSet::Diff& diff)
+    {
+        if (!tunimpl || diff.empty())
+        {
+            return;
+        }
+        if (!tunimpl->update_routes(*this, diff))
+        {
+            signal.LogVerb1("Changes to excluded networks will be applied "
+                            "on the next Establish call");
+        }
+    }
+
+
+    /**
+     *  Replaces the complete tun builder configuration of this device
+     *  with the configuration provided to the ApplyConfiguration D-Bus
+     *  method.
+     *
+     *  All of the configuration is parsed and validated before anything
+     *  is changed.  If anything is invalid, a NetCfgException is thrown
+     *  and the current configuration is left untouched.
+     *
+     *  Supported keys are:  addresses (a(susb)), remote_address (s),
+     *  remote_ipv6 (b), networks (a(subb)), dns_servers (as),
+     *  dns_search (as), layer (u), mtu (u), txqueuelen (u),
+     *  reroute_ipv4 (b), reroute_ipv6 (b), rps_cpus (s), xps_cpus (s),
+     *  rps_flow_cnt (u), qdisc (s) and qdisc_bandwidth (u).  If layer, mtu or
+     *  txqueuelen are not present, the current value is kept; all other
+     *  settings not present are cleared.
+     *
+     * @param params  GVariant object containing the (a{sv}) configuration
+     */
+    void applyConfiguration(GVariant* params)
     {
+        GLibUtils::checkParams(__func__, params, "(a{sv})", 1);
+
+        std::vector<VPNAddress> new_vpnips;
+        RouteSet new_networks;
+        IPAddr new_remote("", false);
+        GVariant *dns_servers = nullptr;
+        GVariant *dns_search = nullptr;
+        unsigned int new_layer = device_type;
+        unsigned int new_mtu = mtu;
+        unsigned int new_txqueuelen = txqueuelen;
+        bool new_reroute_ipv4 = false;
+        bool new_reroute_ipv6 = false;
+        NetCfg::SteeringSettings new_steering;
+        NetCfg::QueueSettings new_queueing;
+
+        GVariantIter *cfg_iter = nullptr;
+        g_variant_get(params, "(a{sv})", &cfg_iter);
         try
         {
-            IdleCheck_UpdateTimestamp();
+            gchar *key = nullptr;
+            GVariant *value = nullptr;
+            while (g_variant_iter_next(cfg_iter, "{sv}", &key, &value))
+            {
+                std::string k(key);
+                g_free(key);
+                try
+                {
+                    if ("addresses" == k)
+                    {
+                        typedef std::tuple<std::string, uint32_t,
+                                           std::string, bool> AddrTuple;
+                        for (const auto& a : GLibUtils::Unmarshal<std::vector<AddrTuple>>(value))
+                        {
+                            check_prefix(std::get<0>(a), std::get<1>(a), std::get<3>(a));
+                            new_vpnips.emplace_back(VPNAddress(std::get<0>(a),
+                                                               std::get<1>(a),
+                                                               std::get<2>(a),
+                                                               std::get<3>(a)));
+                        }
+                    }
+                    else if ("remote_address" == k)
+                    {
+                        new_remote.address = GLibUtils::Unmarshal<std::string>(value);
+                    }
+                    else if ("remote_ipv6" == k)
+                    {
+                        new_remote.ipv6 = GLibUtils::Unmarshal<bool>(value);
+                    }
+                    else if ("networks" == k)
+                    {
+                        typedef std::tuple<std::string, uint32_t,
+                                           bool, bool> NetTuple;
+                        for (const auto& n : GLibUtils::Unmarshal<std::vector<NetTuple>>(value))
+                        {
+                            check_prefix(std::get<0>(n), std::get<1>(n), std::get<2>(n));
+                            new_networks.Add(RouteEntry(std::get<0>(n),
+                                                        std::get<1>(n),
+                                                        std::get<2>(n),
+                                                        std::get<3>(n)));
+                        }
+                    }
+                    else if ("dns_servers" == k || "dns_search" == k)
+                    {
+                        if (!g_variant_is_of_type(value, G_VARIANT_TYPE_STRING_ARRAY))
+                        {
+                            throw NetCfgException("Invalid data type for " + k);
+                        }
+                        if (!resolver || !dnsconfig)
+                        {
+                            throw NetCfgException("No resolver configured");
+                        }
+                        GVariant *&dst = ("dns_servers" == k ? dns_servers : dns_search);
+                        if (dst)
+                        {
+                            g_variant_unref(dst);
+                        }
+                        dst = g_variant_ref_sink(g_variant_new_tuple(&value, 1));
+                    }
+                    else if ("layer" == k)
+                    {
+                        new_layer = GLibUtils::Unmarshal<uint32_t>(value);
+                        if (NetCfgDeviceType::TAP != new_layer
+                            && NetCfgDeviceType::TUN != new_layer)
+                        {
+                            throw NetCfgException("Invalid device layer: "
+                                                  + std::to_string(new_layer));
+                        }
+                    }
+                    else if ("mtu" == k)
+                    {
+                        new_mtu = GLibUtils::Unmarshal<uint32_t>(value);
+                        if (new_mtu < 68 || new_mtu > 65535)
+                        {
+                            throw NetCfgException("Invalid MTU: "
+                                                  + std::to_string(new_mtu));
+                        }
+                    }
+                    else if ("txqueuelen" == k)
+                    {
+                        new_txqueuelen = GLibUtils::Unmarshal<uint32_t>(value);
+                    }
+                    else if ("reroute_ipv4" == k)
+                    {
+                        new_reroute_ipv4 = GLibUtils::Unmarshal<bool>(value);
+                    }
+                    else if ("reroute_ipv6" == k)
+                    {
+                        new_reroute_ipv6 = GLibUtils::Unmarshal<bool>(value);
+                    }
+                    else if ("rps_cpus" == k)
+                    {
+                        new_steering.rps_cpus = GLibUtils::Unmarshal<std::string>(value);
+                    }
+                    else if ("xps_cpus" == k)
+                    {
+                        new_steering.xps_cpus = GLibUtils::Unmarshal<std::string>(value);
+                    }
+                    else if ("rps_flow_cnt" == k)
+                    {
+                        new_steering.rps_flow_cnt = GLibUtils::Unmarshal<uint32_t>(value);
+                    }
+                    else if ("qdisc" == k)
+                    {
+                        new_queueing.qdisc = GLibUtils::Unmarshal<std::string>(value);
+                    }
+                    else if ("qdisc_bandwidth" == k)
+                    {
+                        new_queueing.bandwidth = GLibUtils::Unmarshal<uint32_t>(value);
+                    }
+                    else
+                    {
+                        throw NetCfgException("Unknown configuration key: " + k);
+                    }
+                }
+                catch (...)
+                {
+                    g_variant_unref(value);
+                    throw;
+                }
+                g_variant_unref(value);
+            }
+        }
+        catch (const DBusException& excp)
+        {
+            g_variant_iter_free(cfg_iter);
+            clear_variants({dns_servers, dns_search});
+            throw NetCfgException("Invalid device configuration: "
+                                  + std::string(excp.GetRawError()));
+        }
+        catch (...)
+        {
+            g_variant_iter_free(cfg_iter);
+            clear_variants({dns_servers, dns_search});
+            throw;
+        }
+        g_variant_iter_free(cfg_iter);
+
+        try
+        {
+            new_steering.Validate();
+        }
+        catch (const NetCfgException& excp)
+        {
+            clear_variants({dns_servers, dns_search});
+            throw NetCfgException("Invalid CPU steering: "
+                                  + std::string(excp.what()));
+        }
+        try
+        {
+            new_queueing.Validate();
+        }
+        catch (const NetCfgException& excp)
+        {
+            clear_variants({dns_servers, dns_search});
+            throw NetCfgException("Invalid queueing: "
+                                  + std::string(excp.what()));
+        }
+
+        // Everything is valid, replace the current configuration
+        vpnips = std::move(new_vpnips);
+        networks = std::move(new_networks);
+        remote = new_remote;
+        device_type = new_layer;
+        mtu = new_mtu;
+        txqueuelen = new_txqueuelen;
+        reroute_ipv4 = new_reroute_ipv4;
+        reroute_ipv6 = new_reroute_ipv6;
+        steering = new_steering;
+        queueing = new_queueing;
+
+        if (dnsconfig)
+        {
+            std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+            dnsconfig->ClearNameServers();
+            dnsconfig->ClearSearchDomains();
+            if (dns_servers)
+            {
+                std::string added = dnsconfig->AddNameServers(dns_servers);
+                signal.Debug(device_name, "Added DNS name servers: " + added);
+            }
+            if (dns_search)
+            {
+                dnsconfig->AddSearchDomains(dns_search);
+            }
+            modified = true;
+        }
+        clear_variants({dns_servers, dns_search});
+
+        signal.LogInfo("Applying configuration: "
+                       + std::to_string(vpnips.size()) + " IP addresses, "
+                       + std::to_string(networks.size()) + " networks");
+    }
+
+
+    /**
+     *  Throws a NetCfgException if the prefix length is not valid for
+     *  the address family
+     */
+    static void check_prefix(const std::string& addr,
+                             const unsigned int prefix, const bool ipv6)
+    {
+        if (prefix > (ipv6 ? 128 : 32))
+        {
+            throw NetCfgException("Invalid prefix length for "
+                                  + addr + ": " + std::to_string(prefix));
+        }
+    }
+
+
+    static void clear_variants(std::initializer_list<GVariant *> variants)
+    {
+        for (auto v : variants)
+        {
+            if (v)
+            {
+                g_variant_unref(v);
+            }
+        }
+    }
+
+
+    /**
+     *  Creates the virtual device on the host and applies all the queued
+     *  configuration.  The result is returned via the method invocation;
+     *  a file descriptor to the tun device unless DCO is in use.
+     *
+     * @param conn   D-Bus connection the method call arrived on
+     * @param invoc  GDBusMethodInvocation to return the result to
+     */
+    void establish(GDBusConnection *conn, GDBusMethodInvocation *invoc)
+    {
+        // This should generally be true for DBus 1.3,
+        // double checking here cannot hurt
+        g_assert(g_dbus_connection_get_capabilities(conn) & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING);
+
+        // The virtual device has not yet been created on the host (for
+        // non-DCO case), but all settings which has been queued up
+        // will be activated when this method is called.
+        //
+        // With the DNS commit queue, the DNS settings of the pre mode
+        // backends are applied while the device is being set up.
+        std::future<void> dns_pre_done;
+        try
+        {
+            bool commit = false;
+            {
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+                if (resolver && dnsconfig
+                    && DNS::ApplySettingsMode::MODE_PRE == resolver->GetApplyMode())
+                {
+                    dnsconfig->Enable();
+                    commit = true;
+                    if (!dns_commits)
+                    {
+                        resolver->ApplySettings(&signal);
+                    }
+                }
+            }
+            if (commit && dns_commits)
+            {
+                auto done = std::make_shared<std::promise<void>>();
+                dns_pre_done = done->get_future();
+                dns_commits->Request([done]()
+                                     {
+                                         done->set_value();
+                                     });
+            }
+        }
+        catch (const NetCfgException& excp)
+        {
+            signal.LogCritical("DNS Resolver settings: "
+                               + std::string(excp.what()));
+        }
+
+        int fd = -1 ;
+        try
+        {
+            if (tunimpl)
+            {
+                // Already established; keep the device if only the
+                // routes or DNS settings changed
+                fd = tunimpl->reuse(*this);
+                if (fd < 0)
+                {
+                    capture.reset();
+                    if (traffic_acct)
+                    {
+                        traffic_acct->Detach();
+                    }
+                    tunimpl->teardown(*this, true);
+                    tunimpl.reset();
+                }
+                else
+                {
+                    signal.LogVerb2("Reusing established device '"
+                                    + device_name + "'");
+                }
+            }
+            if (!tunimpl)
+            {
+                // An adopted device is replaced by a new one; the old
+                // one goes away when the backend closes it
+                adopted = false;
+                tunimpl.reset(getCoreBuilderInstance());
+                fd = tunimpl->establish(*this);
+                attach_traffic_accounting();
+            }
+            apply_cpu_steering();
+            apply_queueing();
+            lookup_egress_numa_node();
+        }
+        catch (const NetCfgException& excp)
+        {
+            signal.LogCritical("Failed to setup a TUN interface: "
+                               + std::string(excp.what()));
+
+        }
+
+        bool dns_post_commit = false;
+        try
+        {
+            std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+            if (resolver && dnsconfig)
+            {
+                if (DNS::ApplySettingsMode::MODE_POST == resolver->GetApplyMode())
+                {
+                    dnsconfig->SetDeviceName(device_name);
+                    dnsconfig->Enable();
+                    dns_post_commit = true;
+                    if (!dns_commits)
+                    {
+                        resolver->ApplySettings(&signal);
+                    }
+                }
+
+                std::stringstream details;
+                details << dnsconfig;
+                signal.Debug(device_name,
+                             "Activating DNS/resolver settings: "
+                             + details.str());
+                modified = false;
+            }
+        }
+        catch (const NetCfgException& excp)
+        {
+            signal.LogCritical("DNS Resolver settings: "
+                               + std::string(excp.what()));
+
+        }
+
+        bool dco = false;
+#ifdef ENABLE_OVPNDCO
+        dco = (nullptr != dco_device);
+#endif
+        if (dns_pre_done.valid())
+        {
+            dns_pre_done.wait();
+        }
+        report_state();
+        if (dns_post_commit && dns_commits)
+        {
+            // Reply once the DNS settings are in place, without keeping
+            // this worker thread waiting for it
+            dns_commits->Request([invoc, fd, dco]()
+                                 {
+                                     return_establish_result(invoc, fd, dco);
+                                 });
+            return;
+        }
+        return_establish_result(invoc, fd, dco);
+    }
+
+
+    /**
+     *  Returns the result of the Establish D-Bus method call
+     *
+     * @param invoc  GDBusMethodInvocation to return the result to
+     * @param fd     File descriptor to the tun device, which is closed
+     *               on our side
+     * @param dco    Is DCO in use?  Then no file descriptor is returned.
+     */
+    static void return_establish_result(GDBusMethodInvocation *invoc,
+                                        int fd, bool dco)
+    {
+        if (dco)
+        {
+            // in DCO case don't return anything
+            g_dbus_method_invocation_return_value(invoc, nullptr);
+            return;
+        }
+
+        try
+        {
+            // If DCO is not enabled, the tun device FD is returned
+            prepare_invocation_fd_results(invoc, nullptr, fd);
+        }
+        catch (const NetCfgException& excp)
+        {
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.generic",
+                                                          excp.what());
+            g_dbus_method_invocation_return_gerror(invoc, err);
+            g_error_free(err);
+        }
+    }
+
+
+    /**
+     *  Collects what a restarted netcfg service needs to know to take
+     *  over this device.  Called with the state lock held.
+     *
+     * @return Returns the NetCfg::DeviceRecord of this device
+     */
+    NetCfg::DeviceRecord get_record()
+    {
+        NetCfg::DeviceRecord rec;
+        rec.object_path = GetObjectPath();
+        rec.device_name = device_name;
+        rec.owner = GetOwnerUID();
+        rec.owner_pid = creatorPid;
+        rec.layer = device_type;
+        rec.mtu = mtu;
+        rec.txqueuelen = txqueuelen;
+        rec.reroute_ipv4 = reroute_ipv4;
+        rec.reroute_ipv6 = reroute_ipv6;
+        rec.bundle = bundle;
+        for (const auto& ip : vpnips)
+        {
+            NetCfg::DeviceRecord::Address a;
+            a.address = ip.address;
+            a.prefix = ip.prefix;
+            a.gateway = ip.gateway;
+            a.ipv6 = ip.ipv6;
+            rec.addresses.push_back(a);
+        }
+        rec.networks.assign(networks.begin(), networks.end());
+        rec.remote = remote.address;
+        rec.remote_ipv6 = remote.ipv6;
+        if (dnsconfig)
+        {
+            std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+            rec.dns_servers = dnsconfig->GetNameServers();
+            rec.dns_search = dnsconfig->GetSearchDomains();
+            rec.dns_scope = (DNS::Scope::TUNNEL == dnsconfig->GetDNSScope()
+                             ? 1 : 0);
+        }
+#ifdef ENABLE_OVPNDCO
+        rec.dco = (nullptr != dco_device);
+#endif
+        return rec;
+    }
+
+
+    /**
+     *  Passes the current record of this device to the state callback.
+     *  Called with the state lock held.
+     */
+    void report_state()
+    {
+        if (!state_callback)
+        {
+            return;
+        }
+        if (tunimpl || adopted)
+        {
+            NetCfg::DeviceRecord rec = get_record();
+            state_callback(&rec);
+        }
+        else
+        {
+            state_callback(nullptr);
+        }
+    }
+
+
+    /**
+     *  Applies the DNS resolver settings of all devices and waits until
+     *  this has happened.  Must be called without holding the resolver
+     *  lock.
+     */
+    void commit_dns_settings()
+    {
+        if (dns_commits)
+        {
+            dns_commits->RequestAndWait();
+            return;
+        }
+        std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+        resolver->ApplySettings(&signal);
+    }
+
+
+public:
+    /**
+     *  Callback method which is called each time a D-Bus method call occurs
+     *  on this BackendClientObject.
+     *
+     *  The method call is queued to the worker pool.  All method calls
+     *  to this device are run one at a time, in the order they arrived,
+     *  while other devices are configured in parallel.
+     *
+     * @param conn        D-Bus connection where the method call occurred
+     * @param sender      D-Bus bus name of the sender of the method call
+     * @param obj_path    D-Bus object path of the target object.
+     * @param intf_name   D-Bus interface of the method call
+     * @param method_name D-Bus method name to be executed
+     * @param params      GVariant Glib2 object containing the arguments for
+     *                    the method call
+     * @param invoc       GDBusMethodInvocation where the response/result of
+     *                    the method call will be returned.
+     */
+    void callback_method_call(GDBusConnection *conn,
+                              const std::string sender,
+                              const std::string obj_path,
+                              const std::string intf_name,
+                              const std::string method_name,
+                              GVariant *params,
+                              GDBusMethodInvocation *invoc)
+    {
+        g_variant_ref(params);
+        strand->Post([this, conn, sender, obj_path, method_name,
+                      params, invoc]()
+                     {
+                         std::lock_guard<std::mutex> guard(state_mtx);
+                         NetCfgSignals::Batch batch(signal);
+                         handle_method_call(conn, sender, obj_path,
+                                            method_name, params, invoc);
+                         g_variant_unref(params);
+                         publish_snapshot();
+                     });
+    }
+
+
+    /**
+     *  Tears down the device and removes this object, like the Destroy
+     *  D-Bus method does but without any access checks.  This happens
+     *  once all already queued method calls have completed; the object
+     *  is deleted later on from the main loop.
+     *
+     * @param conn  D-Bus connection this object is registered on
+     */
+    void Destroy(GDBusConnection *conn)
+    {
+        strand->Post([this, conn]()
+                     {
+                         std::lock_guard<std::mutex> guard(state_mtx);
+                         NetCfgSignals::Batch batch(signal);
+                         destroy(conn, nullptr);
+                     });
+    }
+
+
+private:
+    /**
+     *  Runs a D-Bus method call queued by callback_method_call().  This
+     *  is called from a worker thread, with the state lock held.
+     */
+    void handle_method_call(GDBusConnection *conn,
+                            const std::string& sender,
+                            const std::string& obj_path,
+                            const std::string& method_name,
+                            GVariant *params,
+                            GDBusMethodInvocation *invoc)
+    {
+        try
+        {
+            if (destroyed)
+            {
+                throw NetCfgException("Device has been removed");
+            }
+
+            // Only the VPN backend clients are granted access
+            validate_sender(sender);
+
+            GVariant *retval = nullptr;
+
+            if ("AddIPAddress" == method_name)
+            {
+                // Adds a single IPv4 address to the virtual device.  If
+                // broadcast has not been provided, calculate it if needed.
+                addIPAddress(params);
+            }
+            else if ("AddNetworks" == method_name)
+            {
+                // The caller sends an array of networks to apply
+                // It is an array, as this makes everything happen in a
+                // single D-Bus method call and it can on some hosts
+                // be a considerable amount of routes.  This speeds up
+                // the execution
+                //
+                // The variable signature is not completely decided and
+                // must be adopted to what is appropriate
+                addNetworks(params);
+                report_state();
+             }
+            else if ("RemoveNetworks" == method_name)
+            {
+                removeNetworks(params);
+                report_state();
+            }
+            else if ("SetRemoteAddress" == method_name)
+            {
+                setRemoteAddress(params);
+            }
+            else if ("AddDNS" == method_name)
+            {
+                if (!resolver || !dnsconfig)
+                {
+                    throw NetCfgException("No resolver configured");
+                }
+
+                // Adds DNS name servers
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+                std::string added = dnsconfig->AddNameServers(params);
+                signal.Debug(device_name, "Added DNS name servers: " + added);
+                modified = true;
+            }
+            else if ("AddDNSSearch" == method_name)
+            {
+                if (!resolver || !dnsconfig)
+                {
+                    throw NetCfgException("No resolver configured");
+                }
+
+                // Adds DNS search domains
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+                dnsconfig->AddSearchDomains(params);
+                modified = true;
+            }
+#ifdef ENABLE_OVPNDCO
+            else if ("EnableDCO" == method_name)
+            {
+                GLibUtils::checkParams(__func__, params, "(s)", 1);
+                std::string dev_name = GLibUtils::ExtractValue<std::string>(params, 0);
+                set_device_name(dev_name);
+
+                try
+                {
+                    dco_device.reset(new NetCfgDCO(conn,
+                                                   obj_path,
+                                                   dev_name,
+                                                   creatorPid,
+                                                   signal.GetLogWriter()));
+                }
+                catch (const std::exception& excp)
+                {
+                    if (dco_capability)
+                    {
+                        dco_capability->RecordFailure(excp.what());
+                    }
+                    throw;
+                }
+
+                // D-Bus method calls are dispatched in the main context
+                // of the thread registering the object, so this must
+                // happen from the main loop.
+                NetCfgDCO::Ptr dco = dco_device;
+                DCOCapability::Ptr dcocap = dco_capability;
+                run_in_main_loop([dco, dcocap, conn, invoc]()
+                                 {
+                                     try
+                                     {
+                                         dco->RegisterObject(conn);
+                                         if (dcocap)
+                                         {
+                                             dcocap->RecordSuccess();
+                                         }
+                                     }
+                                     catch (const std::exception& excp)
+                                     {
+                                         if (dcocap)
+                                         {
+                                             dcocap->RecordFailure(excp.what());
+                                         }
+                                         std::string errmsg = "Failed executing D-Bus call 'EnableDCO': "
+                                                              + std::string(excp.what());
+                                         GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.generic",
+                                                                                       errmsg.c_str());
+                                         g_dbus_method_invocation_return_gerror(invoc, err);
+                                         g_error_free(err);
+                                         return;
+                                     }
+                                     std::string path = dco->GetObjectPath();
+                                     g_dbus_method_invocation_return_value(invoc,
+                                                                           g_variant_new("(o)", path.c_str()));
+                                 });
+                return;
+            }
+#endif
+            else if ("ApplyConfiguration" == method_name)
+            {
+                // Replaces the complete device configuration and
+                // establishes the device in a single D-Bus call.  The
+                // configuration is only applied if all of it is valid.
+                applyConfiguration(params);
+                establish(conn, invoc);
+                return;
+            }
+            else if ("Establish" == method_name)
+            {
+                establish(conn, invoc);
+                return;
+            }
+            else if ("AdjustMTU" == method_name)
+            {
+                adjustMTU(params);
+                report_state();
+            }
+            else if ("Disable" == method_name)
+            {
+                if (resolver && dnsconfig)
+                {
+                    {
+                        std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+                        std::stringstream details;
+                        details << dnsconfig;
+
+                        signal.Debug(device_name,
+                                     "Disabling DNS/resolver settings: "
+                                     + details.str());
+
+                        dnsconfig->Disable();
+                    }
+                    commit_dns_settings();
+
+                    // We need to clear these settings, as the CoreVPNClient
+                    // will re-add them upon activation again.
+                    std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+                    dnsconfig->ClearNameServers();
+                    dnsconfig->ClearSearchDomains();
+
+                    modified = false;
+                }
+                remove_tun_device();
+                report_state();
+            }
+            else if ("StartCapture" == method_name)
+            {
+                CheckACL_allowRoot(sender);
+                start_capture(sender, params,
+                              GLibUtils::get_fd_from_invocation(invoc));
+            }
+            else if ("StopCapture" == method_name)
+            {
+                CheckACL_allowRoot(sender);
+                if (!capture)
+                {
+                    throw NetCfgException("No packet capture has been started");
+                }
+                capture.reset();
+            }
+            else if ("Destroy" == method_name)
+            {
+                // This should run 'Disable' if this has not happened
+                // and then this object is completely deleted
+
+                CheckOwnerAccess(sender);
+
+                if (signal.LogEnabled(LogCategory::VERB1))
+                {
+                    std::string sender_name = lookup_username(GetUID(sender));
+                    signal.LogVerb1("Device '" + device_name + "' was removed by "
+                                   + sender_name);
+                }
+
+                destroy(conn, invoc);
+                return;
+            }
+            else
+            {
+                throw NetCfgException("Called method " + method_name + " unknown");
+            }
+            g_dbus_method_invocation_return_value(invoc, retval);
+            return;
+        }
+        catch (DBusCredentialsException& excp)
+        {
+            signal.LogCritical(excp.what());
+            excp.SetDBusError(invoc);
+        }
+        catch (const std::exception& excp)
+        {
+            std::string errmsg = "Failed executing D-Bus call '"
+                                  + method_name + "': " + excp.what();
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.generic",
+                                                          errmsg.c_str());
+            g_dbus_method_invocation_return_gerror(invoc, err);
+            g_error_free(err);
+        }
+        catch (...)
+        {
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.unspecified",
+                                                          "Unknown error");
+            g_dbus_method_invocation_return_gerror(invoc, err);
+            g_error_free(err);
+        }
+    }
+
+
+    /**
+     *  Tears down the device and schedules the removal of this object.
+     *  This is called from a worker thread, with the state lock held.
+     *
+     * @param conn   D-Bus connection this object is registered on
+     * @param invoc  GDBusMethodInvocation to reply to once the object
+     *               has been removed from the D-Bus.  May be nullptr.
+     */
+    void destroy(GDBusConnection *conn, GDBusMethodInvocation *invoc)
+    {
+        if (destroyed)
+        {
+            return;
+        }
+        // Operations queued after this one are rejected from now on
+        destroyed = true;
+        teardown();
+        report_state();
+
+        run_in_main_loop([this, conn, invoc]()
+                         {
+#ifdef ENABLE_OVPNDCO
+                             if (dco_device)
+                             {
+                                 dco_device->RemoveObject(conn);
+                                 dco_device.reset();
+                             }
+#endif
+                             RemoveObject(conn);
+                             if (invoc)
+                             {
+                                 g_dbus_method_invocation_return_value(invoc, nullptr);
+                             }
+
+                             // No more method calls can be queued now.
+                             // Delete this object once the already queued
+                             // ones have been rejected.
+                             strand->Post([this]()
+                                          {
+                                              run_in_main_loop([this]()
+                                                               {
+                                                                   delete this;
+                                                               });
+                                          });
+                         });
+    }
+
+
+    /**
+     *  Replies with an error to a D-Bus Set call queued after the device
+     *  was removed.  This is called from a worker thread, with the state
+     *  lock held.
+     *
+     * @return Returns true if the Set call was rejected
+     */
+    bool set_property_rejected(GDBusMethodInvocation *invoc,
+                               const std::string& obj_path,
+                               const std::string& intf_name,
+                               const std::string& property_name)
+    {
+        if (!destroyed)
+        {
+            return false;
+        }
+        DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
+                              intf_name, obj_path, property_name,
+                              "Device has been removed").SetDBusError(invoc);
+        return true;
+    }
+
+
+    /**
+     *  Changes the DNS resolver scope, for a D-Bus Set call of the
+     *  dns_scope property.  This is called from a worker thread, with
+     *  the state lock held, as the resolver lock may be held for a
+     *  while by resolver changes of other devices.
+     */
+    void set_dns_scope(GDBusMethodInvocation *invoc,
+                       const std::string& obj_path,
+                       const std::string& intf_name,
+                       const std::string& property_name,
+                       GVariant *value)
+    {
+        if (set_property_rejected(invoc, obj_path, intf_name, property_name))
+        {
+            return;
+        }
+        try
+        {
+            if (!resolver || !dnsconfig)
+            {
+                throw NetCfgException("No resolver configured");
+            }
+            std::string scope;
+            {
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+                scope = dnsconfig->SetDNSScope(value);
+            }
+            signal.Debug(device_name,
+                         "Changed DNS resolver scope to '" + scope + "'");
+            CompleteSetProperty(invoc, intf_name,
+                                build_set_property_response(property_name, scope));
+        }
+        catch (const NetCfgException& excp)
+        {
+            signal.LogError("Failed changing DNS scope: "
+                            + std::string(excp.what()));
+            DBusPropertyException(G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                  intf_name, obj_path, property_name,
+                                  "Invalid DNS scope data").SetDBusError(invoc);
+        }
+        catch (const DBusException& excp)
+        {
+            DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                  intf_name, obj_path, property_name,
+                                  excp.what()).SetDBusError(invoc);
+        }
+    }
+
+
+    /**
+     *  Runs a function from the GLib main loop.  This is always deferred,
+     *  also when called from the main loop thread itself.
+     *
+     * @param func  Function to run
+     */
+    static void run_in_main_loop(std::function<void()> func)
+    {
+        g_idle_add_full(G_PRIORITY_DEFAULT,
+                        [](gpointer data) -> gboolean
+                        {
+                            try
+                            {
+                                (*static_cast<std::function<void()> *>(data))();
+                            }
+                            catch (const std::exception& excp)
+                            {
+                                std::cerr << "** ERROR ** " << excp.what()
+                                          << std::endl;
+                            }
+                            return G_SOURCE_REMOVE;
+                        },
+                        new std::function<void()>(std::move(func)),
+                        [](gpointer data)
+                        {
+                            delete static_cast<std::function<void()> *>(data);
+                        });
+    }
+
+
+    /**
+     *  Removes the DNS resolver settings and the virtual device from
+     *  the host
+     */
+    void teardown()
+    {
+        if (resolver && dnsconfig)
+        {
+            {
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+                std::stringstream details;
+                details << dnsconfig;
+
+                signal.Debug(device_name,
+                             "Removing DNS/resolver settings: "
+                             + details.str());
+                dnsconfig->PrepareRemoval();
+            }
+            commit_dns_settings();
+            modified = false;
+        }
+
+        remove_tun_device();
+    }
+
+
+    /**
+     *  Attaches the traffic accounting programs to a newly established
+     *  device, if enabled.  Failing to do so does not stop the device
+     *  from being used.
+     */
+    void attach_traffic_accounting()
+    {
+        if (!options.traffic_accounting || device_name.empty())
+        {
+            return;
+        }
+        try
+        {
+            if (!traffic_acct)
+            {
+                traffic_acct.reset(new NetCfg::BpfAccounting());
+            }
+            traffic_acct->Attach(if_nametoindex(device_name.c_str()));
+            signal.LogVerb2("Traffic accounting enabled on '"
+                            + device_name + "'");
+        }
+        catch (const NetCfgException& excp)
+        {
+            signal.LogWarn("Traffic accounting: " + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Looks up the interface the encrypted traffic to the VPN server
+     *  leaves through
+     *
+     * @return Returns the interface name; empty if unknown
+     */
+    std::string egress_interface() const
+    {
+        if (remote.address.empty())
+        {
+            return "";
+        }
+        unsigned int idx = NetCfg::EgressMonitor::RouteInterface(remote.address,
+                                                                 remote.ipv6,
+                                                                 options.so_mark);
+        char name[IF_NAMESIZE] = {};
+        if (idx > 0 && nullptr != if_indextoname(idx, name)
+            && device_name != name)
+        {
+            return name;
+        }
+        return "";
+    }
+
+
+    /**
+     *  Records the NUMA node of the interface the encrypted traffic
+     *  leaves through, so the VPN client can run close to it
+     */
+    void lookup_egress_numa_node()
+    {
+        egress_numa_node.clear();
+        std::string lower = egress_interface();
+        if (!lower.empty())
+        {
+            int node = NumaTopology().DeviceNode(lower);
+            if (node >= 0)
+            {
+                egress_numa_node = std::to_string(node);
+                signal.LogVerb2("Egress interface '" + lower
+                                + "' is on NUMA node " + egress_numa_node);
+            }
+        }
+    }
+
+
+    /**
+     *  Spreads the packet processing of the device over the CPUs given
+     *  by the service defaults and the settings of the VPN session.
+     *  Failing to do so does not stop the device from being used.
+     */
+    void apply_cpu_steering()
+    {
+        steering_cpus.clear();
+        if (!options.cpu_steering)
+        {
+            if (!steering.empty())
+            {
+                signal.LogWarn("CPU steering is not enabled in the "
+                               "net.openvpn.v3.netcfg service, ignoring "
+                               + steering.str());
+            }
+            return;
+        }
+
+        NetCfg::SteeringSettings settings = options.steering;
+        settings.Merge(steering);
+        if (settings.empty() || device_name.empty())
+        {
+            return;
+        }
+
+        // "auto" avoids the CPUs busy with the interrupts of the
+        // interface the encrypted traffic goes through
+        std::string lower = egress_interface();
+
+        try
+        {
+            NetCfg::CpuSteering cpus;
+            steering_cpus = NetCfg::CpuSteering::CPUList(cpus.Apply(device_name,
+                                                                    settings,
+                                                                    lower));
+            if (settings.rps_flow_cnt > 0 && !cpus.RfsEnabled())
+            {
+                signal.LogWarn("rps_flow_cnt has no effect until "
+                               "net.core.rps_sock_flow_entries is set");
+            }
+            signal.LogVerb2("CPU steering on '" + device_name + "': "
+                            + settings.str()
+                            + (steering_cpus.empty() ? ""
+                                                     : ", CPUs " + steering_cpus));
+        }
+        catch (const NetCfgException& excp)
+        {
+            signal.LogWarn("CPU steering: " + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Sets the queueing discipline and transmit queue length of the
+     *  device, from the service defaults and the settings of the VPN
+     *  session.  Failing to do so does not stop the device from being
+     *  used.
+     */
+    void apply_queueing()
+    {
+        NetCfg::QueueSettings settings = options.queueing;
+        settings.Merge(queueing);
+        if (txqueuelen > 0)
+        {
+            settings.txqueuelen = txqueuelen;
+        }
+        if (settings.empty() || device_name.empty())
+        {
+            return;
+        }
 
-            // Only the VPN backend clients are granted access
-            validate_sender(sender);
+        try
+        {
+            NetCfg::QueueDiscipline::Apply(if_nametoindex(device_name.c_str()),
+                                           settings, mtu);
+            active_qdisc = settings.qdisc;
+            signal.LogVerb2("Queueing on '" + device_name + "': "
+                            + settings.str());
+        }
+        catch (const NetCfgException& excp)
+        {
+            active_qdisc.clear();
+            signal.LogWarn("Queueing on '" + device_name + "': "
+                           + std::string(excp.what()));
+        }
+    }
 
-            GVariant *retval = nullptr;
 
-            if ("AddIPAddress" == method_name)
+    /**
+     *  Starts a packet capture on the device, streaming pcapng to the
+     *  file descriptor passed by the caller.  Only one capture may run
+     *  at a time.
+     *
+     * @param sender  D-Bus bus name of the caller
+     * @param params  GVariant with the capture options, see the
+     *                StartCapture D-Bus method
+     * @param fd      File descriptor to write the capture to.  It is
+     *                closed by this method on errors.
+     */
+    void start_capture(const std::string& sender, GVariant *params, int fd)
+    {
+        NetCfg::PacketCapture::Limits limits;
+        std::vector<struct sock_filter> filter;
+        std::vector<std::string> comments;
+        try
+        {
+            if (fd < 0)
             {
-                // Adds a single IPv4 address to the virtual device.  If
-                // broadcast has not been provided, calculate it if needed.
-                addIPAddress(params);
+                throw NetCfgException("No file descriptor to write the capture to");
             }
-            else if ("AddNetworks" == method_name)
-            {
-                // The caller sends an array of networks to apply
-                // It is an array, as this makes everything happen in a
-                // single D-Bus method call and it can on some hosts
-                // be a considerable amount of routes.  This speeds up
-                // the execution
-                //
-                // The variable signature is not completely decided and
-                // must be adopted to what is appropriate
-                addNetworks(params);
-             }
-            else if ("SetRemoteAddress" == method_name)
+            if (!options.packet_capture)
             {
-                setRemoteAddress(params);
+                throw NetCfgException("Packet capture is not enabled in the "
+                                      "net.openvpn.v3.netcfg service");
             }
-            else if ("AddDNS" == method_name)
+            if (capture && capture->Running())
             {
-                if (!resolver || !dnsconfig)
-                {
-                    throw NetCfgException("No resolver configured");
-                }
-
-                // Adds DNS name servers
-                std::string added = dnsconfig->AddNameServers(params);
-                signal.Debug(device_name, "Added DNS name servers: " + added);
-                modified = true;
+                throw NetCfgException("A packet capture is already running "
+                                      "on this device");
             }
-            else if ("AddDNSSearch" == method_name)
+            if ((!tunimpl && !adopted) || device_name.empty())
             {
-                if (!resolver || !dnsconfig)
-                {
-                    throw NetCfgException("No resolver configured");
-                }
-
-                // Adds DNS search domains
-                dnsconfig->AddSearchDomains(params);
-                modified = true;
+                throw NetCfgException("Device is not established");
             }
-#ifdef ENABLE_OVPNDCO
-            else if ("EnableDCO" == method_name)
-            {
-                GLibUtils::checkParams(__func__, params, "(s)", 1);
-                std::string dev_name = GLibUtils::ExtractValue<std::string>(params, 0);
-                set_device_name(dev_name);
-
-                dco_device.reset(new NetCfgDCO(conn,
-                                               obj_path,
-                                               dev_name,
-                                               creatorPid,
-                                               signal.GetLogWriter()));
-
-                dco_device->RegisterObject(conn);
 
-
-                auto path = dco_device->GetObjectPath();
-                retval = g_variant_new("(o)", path.c_str());
-
-            }
-#endif
-            else if ("Establish" == method_name)
+            GLibUtils::checkParams(__func__, params, "(a{sv})", 1);
+            typedef std::tuple<uint16_t, uint8_t, uint8_t, uint32_t> FilterTuple;
+            std::map<std::string, std::string> metadata;
+            GVariantIter *opt_iter = nullptr;
+            g_variant_get(params, "(a{sv})", &opt_iter);
+            gchar *key = nullptr;
+            GVariant *value = nullptr;
+            while (g_variant_iter_next(opt_iter, "{sv}", &key, &value))
             {
-                // This should generally be true for DBus 1.3,
-                // double checking here cannot hurt
-                g_assert(g_dbus_connection_get_capabilities(conn) & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING);
-
-                // The virtual device has not yet been created on the host (for
-                // non-DCO case), but all settings which has been queued up
-                // will be activated when this method is called.
+                std::string k(key);
+                g_free(key);
                 try
                 {
-                    if (resolver && dnsconfig
-                        && DNS::ApplySettingsMode::MODE_PRE == resolver->GetApplyMode())
+                    if ("snaplen" == k)
                     {
-                        dnsconfig->Enable();
-                        resolver->ApplySettings(&signal);
+                        limits.snaplen = GLibUtils::Unmarshal<uint32_t>(value);
                     }
-                }
-                catch (const NetCfgException& excp)
-                {
-                    signal.LogCritical("DNS Resolver settings: "
-                                       + std::string(excp.what()));
-                }
-
-                if (!tunimpl)
-                {
-                    tunimpl.reset(getCoreBuilderInstance());
-                }
-
-                int fd = -1 ;
-                try
-                {
-                    fd = tunimpl->establish(*this);
-                }
-                catch (const NetCfgException& excp)
-                {
-                    signal.LogCritical("Failed to setup a TUN interface: "
-                                       + std::string(excp.what()));
-
-                }
-
-                try
-                {
-                    if (resolver && dnsconfig)
+                    else if ("max_packets" == k)
+                    {
+                        limits.max_packets = GLibUtils::Unmarshal<uint32_t>(value);
+                    }
+                    else if ("max_bytes" == k)
+                    {
+                        limits.max_bytes = GLibUtils::Unmarshal<uint64_t>(value);
+                    }
+                    else if ("duration" == k)
+                    {
+                        limits.duration = GLibUtils::Unmarshal<uint32_t>(value);
+                    }
+                    else if ("rate_limit" == k)
+                    {
+                        limits.rate_limit = GLibUtils::Unmarshal<uint32_t>(value);
+                    }
+                    else if ("filter" == k)
                     {
-                        if (DNS::ApplySettingsMode::MODE_POST == resolver->GetApplyMode())
+                        for (const auto& f : GLibUtils::Unmarshal<std::vector<FilterTuple>>(value))
                         {
-                            dnsconfig->SetDeviceName(device_name);
-                            dnsconfig->Enable();
-                            resolver->ApplySettings(&signal);
+                            filter.push_back({std::get<0>(f), std::get<1>(f),
+                                              std::get<2>(f), std::get<3>(f)});
                         }
-
-                        std::stringstream details;
-                        details << dnsconfig;
-                        signal.Debug(device_name,
-                                     "Activating DNS/resolver settings: "
-                                     + details.str());
-                        modified = false;
+                    }
+                    else if ("metadata" == k)
+                    {
+                        metadata = GLibUtils::Unmarshal<std::map<std::string, std::string>>(value);
+                    }
+                    else
+                    {
+                        throw NetCfgException("Unknown capture option: " + k);
                     }
                 }
-                catch (const NetCfgException& excp)
-                {
-                    signal.LogCritical("DNS Resolver settings: "
-                                       + std::string(excp.what()));
-
-                }
-
-#ifdef ENABLE_OVPNDCO
-                // in DCO case don't return anything
-                if (dco_device)
-                {
-                    g_dbus_method_invocation_return_value(invoc, nullptr);
-                }
-                else
-                {
-                    // If DCO is not enabled, the tun device FD is returned
-                    prepare_invocation_fd_results(invoc, nullptr, fd);
-                }
-                return;
-#else  // Without DCO support compiled in, a FD to the tun device is always returned
-                prepare_invocation_fd_results(invoc, nullptr, fd);
-                return;
-#endif  // ENABLE_OVPNDCO
-            }
-            else if ("Disable" == method_name)
-            {
-                if (resolver && dnsconfig)
-                {
-                    std::stringstream details;
-                    details << dnsconfig;
-
-                    signal.Debug(device_name,
-                                 "Disabling DNS/resolver settings: "
-                                 + details.str());
-
-                    dnsconfig->Disable();
-                    resolver->ApplySettings(&signal);
-
-                    // We need to clear these settings, as the CoreVPNClient
-                    // will re-add them upon activation again.
-                    dnsconfig->ClearNameServers();
-                    dnsconfig->ClearSearchDomains();
-
-                    modified = false;
-                }
-                if (tunimpl)
+                catch (...)
                 {
-                    tunimpl->teardown(*this, true);
-                    tunimpl.reset();
+                    g_variant_unref(value);
+                    g_variant_iter_free(opt_iter);
+                    throw;
                 }
+                g_variant_unref(value);
             }
-            else if ("Destroy" == method_name)
-            {
-                // This should run 'Disable' if this has not happened
-                // and then this object is completely deleted
-
-                CheckOwnerAccess(sender);
-
-                std::string sender_name = lookup_username(GetUID(sender));
-                signal.LogVerb1("Device '" + device_name + "' was removed by "
-                               + sender_name);
-
-                teardown(conn);
-                g_dbus_method_invocation_return_value(invoc, nullptr);
-                delete this;
-                return;
-            }
-            else
+            g_variant_iter_free(opt_iter);
+
+            uid_t uid = GetUID(sender);
+            comments.push_back("device: " + device_name);
+            comments.push_back("netcfg object: " + GetObjectPath());
+            comments.push_back("backend pid: " + std::to_string(creatorPid));
+            comments.push_back("started by: " + lookup_username(uid)
+                               + " (uid " + std::to_string(uid) + ")");
+            for (const auto& m : metadata)
             {
-                throw NetCfgException("Called method " + method_name + " unknown");
+                comments.push_back(m.first + ": " + m.second);
             }
-            g_dbus_method_invocation_return_value(invoc, retval);
-            return;
-        }
-        catch (DBusCredentialsException& excp)
-        {
-            signal.LogCritical(excp.what());
-            excp.SetDBusError(invoc);
-        }
-        catch (const std::exception& excp)
-        {
-            std::string errmsg = "Failed executing D-Bus call '"
-                                  + method_name + "': " + excp.what();
-            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.generic",
-                                                          errmsg.c_str());
-            g_dbus_method_invocation_return_gerror(invoc, err);
-            g_error_free(err);
         }
         catch (...)
         {
-            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.unspecified",
-                                                          "Unknown error");
-            g_dbus_method_invocation_return_gerror(invoc, err);
-            g_error_free(err);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            throw;
         }
+
+        // The PacketCapture owns the file descriptor from here on
+        capture.reset();
+        capture.reset(new NetCfg::PacketCapture(device_name, fd, limits,
+                                                filter, comments));
+        const std::string devname = device_name;
+        capture->Start([this, devname](const std::string& reason,
+                                       uint64_t packets, uint64_t dropped)
+                       {
+                           signal.LogInfo("Packet capture on '" + devname
+                                          + "' ended, " + reason + ": "
+                                          + std::to_string(packets)
+                                          + " packets captured, "
+                                          + std::to_string(dropped)
+                                          + " not captured");
+                       });
+        signal.LogInfo("Packet capture on '" + device_name + "' started by "
+                       + lookup_username(GetUID(sender)));
     }
 
 
-    void teardown(GDBusConnection *conn)
+    /**
+     *  Removes the virtual device from the host and lets the DNS
+     *  resolver backend forget about it
+     */
+    void remove_tun_device()
     {
-        if (resolver && dnsconfig)
+        if (!tunimpl && !adopted)
         {
-            std::stringstream details;
-            details << dnsconfig;
-
-            signal.Debug(device_name,
-                         "Removing DNS/resolver settings: "
-                         + details.str());
-            dnsconfig->PrepareRemoval();
-            resolver->ApplySettings(&signal);
-            modified = false;
+            return;
+        }
+        capture.reset();
+        if (traffic_acct)
+        {
+            traffic_acct->Detach();
         }
-
         if (tunimpl)
         {
             tunimpl->teardown(*this, true);
             tunimpl.reset();
         }
+        // An adopted device is owned by the backend process; it goes
+        // away when the backend closes it
+        adopted = false;
 
-#ifdef ENABLE_OVPNDCO
-        if (dco_device)
+        if (resolver)
         {
-            dco_device->RemoveObject(conn);
-            dco_device.reset();
+            std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
+            resolver->DeviceRemoved(device_name);
         }
-#endif
-        RemoveObject(conn);
     }
 
+
+public:
     /**
      *   Callback which is used each time a NetCfgServiceObject D-Bus property
      *   is being read.
@@ -641,12 +2148,15 @@ public:
     {
         try
         {
-            IdleCheck_UpdateTimestamp();
             validate_sender(sender);
 
-            if ("log_level" == property_name)
+            // Device operations run in worker threads; the values are
+            // read from the state published after the last one.
+            auto snap = get_snapshot();
+            GVariant *value = snapshot_value(*snap, property_name);
+            if (value)
             {
-                return g_variant_new_uint32(signal.GetLogLevel());
+                return value;
             }
             else if ("owner" == property_name)
             {
@@ -656,21 +2166,15 @@ public:
             {
                 return GLibUtils::GVariantFromVector(GetAccessList());
             }
-            else if ("active" == property_name)
-            {
-                return g_variant_new_boolean(active);
-            }
-            else if ("modified" == property_name)
-            {
-                return g_variant_new_boolean(modified);
-            }
             else if ("dns_scope" == property_name)
             {
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
                 return g_variant_new_string(dnsconfig ? dnsconfig->GetDNSScopeStr()
                                                       : "");
             }
             else if ("dns_name_servers" == property_name)
             {
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
                 if (dnsconfig)
                 {
                     return GLibUtils::GVariantFromVector(dnsconfig->GetNameServers());
@@ -682,6 +2186,7 @@ public:
             }
             else if ("dns_search_domains" == property_name)
             {
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
                 if (dnsconfig)
                 {
                     return GLibUtils::GVariantFromVector(dnsconfig->GetSearchDomains());
@@ -691,9 +2196,25 @@ public:
                     return GLibUtils::GVariantFromVector(std::vector<std::string>{});
                 }
             }
-            else if (properties.Exists(property_name))
+            else if ("traffic_accounting" == property_name)
             {
-                return properties.GetValue(property_name);
+                GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(sssstt)"));
+                if (snap->traffic_acct)
+                {
+                    for (const auto& c : snap->traffic_acct->Read())
+                    {
+                        g_variant_builder_add(bld, "(sssstt)",
+                                              c.direction.c_str(),
+                                              c.family.c_str(),
+                                              c.protocol.c_str(),
+                                              c.destination.c_str(),
+                                              (guint64) c.bytes,
+                                              (guint64) c.packets);
+                    }
+                }
+                GVariant *ret = g_variant_builder_end(bld);
+                g_variant_builder_unref(bld);
+                return ret;
             }
         }
         catch (DBusPropertyException&)
@@ -721,9 +2242,30 @@ public:
     }
 
 
+    /**
+     *  D-Bus Set calls are handled by callback_set_property_async(),
+     *  see EnableAsyncPropertySet() in the constructor
+     */
+    GVariantBuilder * callback_set_property(GDBusConnection *conn,
+                                            const std::string sender,
+                                            const std::string obj_path,
+                                            const std::string intf_name,
+                                            const std::string property_name,
+                                            GVariant *value,
+                                            GError **error)
+    {
+        throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                    intf_name, obj_path, property_name,
+                                    "Invalid property");
+    }
+
+
     /**
      *  Callback method which is used each time a NetCfgServiceObject
-     *  property is being modified over the D-Bus.
+     *  property is being modified over the D-Bus.  Changes to the device
+     *  state are queued after the device operations already running in
+     *  a worker thread, instead of waiting for them in the main loop.
+     *  The Set call is replied to once the change has been applied.
      *
      * @param conn           D-Bus connection this event occurred on
      * @param sender         D-Bus bus name of the requester
@@ -731,89 +2273,95 @@ public:
      * @param intf_name      D-Bus interface of the property being accessed
      * @param property_name  The property name being accessed
      * @param value          GVariant object containing the value to be stored
-     * @param error          A GLib2 GError object if an error occurs
-     *
-     * @return Returns a GVariantBuilder object containing the change
-     *         confirmation on success.  On failures, an exception is thrown.
-     *
+     * @param invoc          GDBusMethodInvocation of the Set call
      */
-    GVariantBuilder * callback_set_property(GDBusConnection *conn,
-                                            const std::string sender,
-                                            const std::string obj_path,
-                                            const std::string intf_name,
-                                            const std::string property_name,
-                                            GVariant *value,
-                                            GError **error)
+    void callback_set_property_async(GDBusConnection *conn,
+                                     const std::string sender,
+                                     const std::string obj_path,
+                                     const std::string intf_name,
+                                     const std::string property_name,
+                                     GVariant *value,
+                                     GDBusMethodInvocation *invoc)
     {
         try
         {
-            IdleCheck_UpdateTimestamp();
             validate_sender(sender);
+        }
+        catch (const DBusCredentialsException& excp)
+        {
+            throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+                                        intf_name, obj_path, property_name,
+                                        excp.what());
+        }
 
-            if ("log_level" == property_name)
-            {
-                unsigned int log_level = g_variant_get_uint32(value);
-                if (log_level > 6)
-                {
-                    throw DBusPropertyException(G_IO_ERROR,
-                                                G_IO_ERROR_INVALID_DATA,
-                                                obj_path, intf_name,
-                                                property_name,
-                                                "Invalid log level");
-                }
-                signal.SetLogLevel(log_level);
-                return build_set_property_response(property_name,
-                                                   (guint32) log_level);
-            }
-            else if("dns_scope" == property_name)
-            {
-                if (!resolver || !dnsconfig)
-                {
-                    throw NetCfgException("No resolver configured");
-                }
-                try
-                {
-                    std::string scope = dnsconfig->SetDNSScope(value);
-                    signal.Debug(device_name, "Changed DNS resolver scope to '"
-                                + scope + "'");
-                    return build_set_property_response(property_name, scope);
-                }
-                catch (const NetCfgException& excp)
-                {
-                    signal.LogError("Failed changing DNS scope: "
-                                    + std::string(excp.what()));
-                    throw DBusPropertyException(G_IO_ERROR,
-                                                G_IO_ERROR_INVALID_DATA,
-                                                obj_path, intf_name,
-                                                property_name,
-                                                "Invalid DNS scope data");
-                }
-            }
-            else if (properties.Exists(property_name))
+        if ("log_level" == property_name)
+        {
+            unsigned int log_level = g_variant_get_uint32(value);
+            if (log_level > 6)
             {
-                return properties.SetValue(property_name, value);
+                throw DBusPropertyException(G_IO_ERROR,
+                                            G_IO_ERROR_INVALID_DATA,
+                                            intf_name, obj_path,
+                                            property_name,
+                                            "Invalid log level");
             }
+            strand->Post([this, invoc, obj_path, intf_name, property_name,
+                          log_level]()
+                         {
+                             std::lock_guard<std::mutex> guard(state_mtx);
+                             if (set_property_rejected(invoc, obj_path,
+                                                       intf_name, property_name))
+                             {
+                                 return;
+                             }
+                             signal.SetLogLevel(log_level);
+                             publish_snapshot();
+                             CompleteSetProperty(invoc, intf_name,
+                                                 build_set_property_response(property_name,
+                                                                             (guint32) log_level));
+                         });
         }
-        catch (const NetCfgException& excp)
+        else if ("dns_scope" == property_name)
         {
-            signal.LogError(excp.what());
-            throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                        obj_path, intf_name, property_name,
-                                        excp.what());
+            g_variant_ref(value);
+            strand->Post([this, invoc, obj_path, intf_name, property_name,
+                          value]()
+                         {
+                             std::lock_guard<std::mutex> guard(state_mtx);
+                             set_dns_scope(invoc, obj_path, intf_name,
+                                           property_name, value);
+                             g_variant_unref(value);
+                         });
         }
-        catch (DBusPropertyException&)
+        else if (properties.Exists(property_name))
         {
-            throw;
+            // The Set call sends its own PropertiesChanged signal,
+            // publish_snapshot() must not announce the value once more
+            properties.SetPublished(property_name, value);
+
+            g_variant_ref(value);
+            strand->Post([this, invoc, obj_path, intf_name, property_name,
+                          value]()
+                         {
+                             std::lock_guard<std::mutex> guard(state_mtx);
+                             if (!set_property_rejected(invoc, obj_path,
+                                                        intf_name, property_name))
+                             {
+                                 properties.Assign(property_name, value);
+                                 publish_snapshot();
+                                 GVariantBuilder *ret = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
+                                 g_variant_builder_add(ret, "{sv}", property_name.c_str(), value);
+                                 CompleteSetProperty(invoc, intf_name, ret);
+                             }
+                             g_variant_unref(value);
+                         });
         }
-        catch (DBusException& excp)
+        else
         {
             throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                        obj_path, intf_name, property_name,
-                                        excp.what());
+                                        intf_name, obj_path, property_name,
+                                        "Invalid property");
         }
-        throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                    obj_path, intf_name, property_name,
-                                    "Invalid property");
     }
 
 
@@ -824,7 +2372,7 @@ private:
     PropertyCollection properties;
     unsigned int device_type = NetCfgDeviceType::UNSET;
     std::string device_name;
-    std::vector<Network> networks;
+    NetCfg::RouteSet networks;
     std::vector<VPNAddress> vpnips;
     IPAddr remote;
     unsigned int mtu;
@@ -832,9 +2380,18 @@ private:
 
     bool reroute_ipv4 = false;
     bool reroute_ipv6 = false;
+    std::string bundle;    ///< Devices of a bundle share multipath routes
+    NetCfg::SteeringSettings steering;  ///< CPU steering of the VPN session
+    std::string steering_cpus;  ///< CPUs the device traffic is steered to
+    std::string egress_numa_node;  ///< NUMA node of the egress interface
+    NetCfg::QueueSettings queueing;  ///< Queueing of the VPN session
+    std::string active_qdisc;   ///< qdisc set up by apply_queueing()
 
 
     RCPtr<CoreTunbuilder> tunimpl;
+    bool adopted = false;  ///< Established by a previous netcfg process
+    NetCfg::BpfAccounting::Ptr traffic_acct;  ///< Only with --traffic-accounting
+    std::function<void(const NetCfg::DeviceRecord *)> state_callback;
     NetCfgSignals signal;
     DNS::SettingsManager::Ptr resolver;
     DNS::ResolverSettings::Ptr dnsconfig;
@@ -842,7 +2399,46 @@ private:
     NetCfgOptions options;
     bool active = false;
 
+    NetCfgWorkerPool::Ptr workers;
+    NetCfgWorkerPool::Strand::Ptr strand;
+    mutable std::mutex state_mtx;
+    bool destroyed = false;
+
+    /**
+     *  Device state readable from the main loop while a device operation
+     *  runs in a worker thread.  A new copy is published by
+     *  publish_snapshot() after each operation.
+     */
+    struct PropertySnapshot
+    {
+        std::string device_name;
+        unsigned int layer = NetCfgDeviceType::UNSET;
+        unsigned int mtu = 0;
+        unsigned int txqueuelen = 0;
+        bool reroute_ipv4 = false;
+        bool reroute_ipv6 = false;
+        std::string bundle;
+        std::string steering_cpus;
+        std::string egress_numa_node;
+        std::string qdisc;
+        bool active = false;
+        bool modified = false;
+        unsigned int log_level = 0;
+        size_t vpn_addresses = 0;
+        size_t vpn_addresses_capacity = 0;
+        size_t vpn_networks = 0;
+
+        /// Owned by the device; only its counters are read
+        const NetCfg::BpfAccounting *traffic_acct = nullptr;
+    };
+    std::shared_ptr<const PropertySnapshot> snapshot;
+    mutable std::mutex snapshot_mtx;  ///< Only held while swapping snapshot
+
     pid_t creatorPid;
+    DCOCapability::Ptr dco_capability = nullptr;
+    DNS::CommitQueue::Ptr dns_commits = nullptr;
+    NetCfg::TunPool::Ptr tun_pool = nullptr;
+    NetCfg::PacketCapture::Ptr capture = nullptr;  ///< Logs via signal when done
 
 #ifdef ENABLE_OVPNDCO
     NetCfgDCO::Ptr dco_device = nullptr;
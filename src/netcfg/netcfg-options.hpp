@@ -28,13 +28,17 @@
 
 #include "common/cmdargparser.hpp"
 #include "netcfg/netcfg-configfile.hpp"
+#include "netcfg/cpu-steering.hpp"
+#include "netcfg/queue-discipline.hpp"
+#include "netcfg/netcfg-exception.hpp"
 
 
 enum class RedirectMethod : std::uint8_t
 {
     NONE = 0,    //<  Do not add any additional routes
     HOST_ROUTE,  //<  Add direct route to VPN server
-    BINDTODEV    //<  Bind the UDP/TCP socket to the default gw interface
+    BINDTODEV,   //<  Bind the UDP/TCP socket to the default gw interface
+    POLICY_ROUTE //<  Mark the socket, policy routing rules bypass the VPN
 };
 
 /**
@@ -48,15 +52,74 @@ struct NetCfgOptions
     /** the SO_MARK to use if > 0 */
     int so_mark = -1;
 
+    /** SO_MARK used by the policy-route method if --set-somark is not given */
+    static const int default_policy_mark = 1194;
+
+    /** Routing table the policy-route method installs the VPN routes in */
+    unsigned int policy_table = 1194;
+
+    /**
+     *  Address of the local DNS stub resolver used with the resolv.conf
+     *  integration, empty if disabled
+     */
+    std::string resolv_conf_stub = "";
+
     /** Will signals be broadcast to all users? */
     bool signal_broadcast = false;
 
     /** Configuration file to use, if --state-dir is given */
     std::string config_file = "";
 
+    /** Directory recording the configured devices, if --state-dir is given */
+    std::string state_dir = "";
+
+    /** Number of threads configuring network devices in parallel */
+    unsigned int worker_threads = 4;
+
+    /**
+     *  Milliseconds to wait for more DNS resolver changes before
+     *  applying them in a single commit
+     */
+    unsigned int dns_commit_delay = 20;
+
+    /**
+     *  Seconds the resolved addresses of VPN server host names are
+     *  shared between the backends, 0 disables the remote resolver cache
+     */
+    unsigned int remote_cache_ttl = 60;
+
+    /** Number of tun devices created ahead of use, 0 disables the pool */
+    unsigned int tun_pool = 0;
+
+    /**
+     *  Send NetworkChange signals wanted by all subscribers without a
+     *  destination, instead of once per subscriber
+     */
+    bool notification_multicast = false;
+
+    /** Count the traffic of the VPN devices with tc BPF programs */
+    bool traffic_accounting = false;
+
+    /** Allow bounded packet captures of the VPN devices */
+    bool packet_capture = false;
+
+    /** Allow RPS/XPS CPU steering of the VPN devices */
+    bool cpu_steering = false;
+
+    /** CPU steering defaults, which the VPN sessions may override */
+    NetCfg::SteeringSettings steering;
+
+    /** Queueing defaults of the VPN devices, which the VPN sessions may override */
+    NetCfg::QueueSettings queueing;
+
 
     NetCfgOptions(ParsedArgs::Ptr args, NetCfgConfigFile::Ptr config)
     {
+        if (args->Present("state-dir"))
+        {
+            state_dir = args->GetLastValue("state-dir");
+        }
+
         if (config && args->Present("state-dir"))
         {
             config_file = args->GetLastValue("state-dir") + "/netcfg.json";
@@ -83,6 +146,16 @@ struct NetCfgOptions
                                    excp.what());
         }
 
+        if (args->Present("resolv-conf-stub"))
+        {
+            if (!args->Present("resolv-conf"))
+            {
+                throw CommandArgBaseException("--resolv-conf-stub requires "
+                                              "--resolv-conf");
+            }
+            resolv_conf_stub = args->GetLastValue("resolv-conf-stub");
+        }
+
         if (args->Present("redirect-method"))
         {
             std::string method = args->GetValue("redirect-method", 0);
@@ -98,6 +171,10 @@ struct NetCfgOptions
             {
                 redirect_method = RedirectMethod::BINDTODEV;
             }
+            else if ("policy-route" == method)
+            {
+                redirect_method = RedirectMethod::POLICY_ROUTE;
+            }
             else
             {
                 throw CommandArgBaseException("Invalid argument to --redirect-method: "
@@ -110,7 +187,142 @@ struct NetCfgOptions
             so_mark = std::atoi(args->GetValue("set-somark", 0).c_str());
         }
 
+        if (args->Present("policy-table"))
+        {
+            long table = std::atol(args->GetLastValue("policy-table").c_str());
+            // 0 and 253-255 are the unspec, default, main and local tables
+            if (table < 1 || table > 0x7fffffff || (table >= 253 && table <= 255))
+            {
+                throw CommandArgBaseException("Invalid argument to --policy-table: "
+                                              + args->GetLastValue("policy-table"));
+            }
+            policy_table = (unsigned int) table;
+        }
+
+        if (RedirectMethod::POLICY_ROUTE == redirect_method)
+        {
+            if (0 == so_mark)
+            {
+                throw CommandArgBaseException("--redirect-method policy-route "
+                                              "requires a non-zero --set-somark");
+            }
+            if (so_mark < 0)
+            {
+                so_mark = default_policy_mark;
+            }
+        }
+
+        if (args->Present("worker-threads"))
+        {
+            int threads = std::atoi(args->GetLastValue("worker-threads").c_str());
+            if (threads < 0 || threads > 64)
+            {
+                throw CommandArgBaseException("Invalid argument to --worker-threads: "
+                                              + args->GetLastValue("worker-threads"));
+            }
+            worker_threads = threads;
+        }
+
+        if (args->Present("dns-commit-delay"))
+        {
+            int delay = std::atoi(args->GetLastValue("dns-commit-delay").c_str());
+            if (delay < 0 || delay > 1000)
+            {
+                throw CommandArgBaseException("Invalid argument to --dns-commit-delay: "
+                                              + args->GetLastValue("dns-commit-delay"));
+            }
+            dns_commit_delay = delay;
+        }
+
+        if (args->Present("remote-cache-ttl"))
+        {
+            int ttl = std::atoi(args->GetLastValue("remote-cache-ttl").c_str());
+            if (ttl < 0 || ttl > 3600)
+            {
+                throw CommandArgBaseException("Invalid argument to --remote-cache-ttl: "
+                                              + args->GetLastValue("remote-cache-ttl"));
+            }
+            remote_cache_ttl = ttl;
+        }
+
+        if (args->Present("tun-pool"))
+        {
+            int count = std::atoi(args->GetLastValue("tun-pool").c_str());
+            if (count < 0 || count > 64)
+            {
+                throw CommandArgBaseException("Invalid argument to --tun-pool: "
+                                              + args->GetLastValue("tun-pool"));
+            }
+            tun_pool = count;
+        }
+
+        if (args->Present("rps-cpus"))
+        {
+            steering.rps_cpus = args->GetLastValue("rps-cpus");
+        }
+        if (args->Present("xps-cpus"))
+        {
+            steering.xps_cpus = args->GetLastValue("xps-cpus");
+        }
+        if (args->Present("rps-flow-cnt"))
+        {
+            int cnt = std::atoi(args->GetLastValue("rps-flow-cnt").c_str());
+            if (cnt < 1 || cnt > 1048576)
+            {
+                throw CommandArgBaseException("Invalid argument to --rps-flow-cnt: "
+                                              + args->GetLastValue("rps-flow-cnt"));
+            }
+            steering.rps_flow_cnt = cnt;
+        }
+        try
+        {
+            steering.Validate();
+        }
+        catch (const NetCfgException& excp)
+        {
+            throw CommandArgBaseException("Invalid CPU steering option: "
+                                          + std::string(excp.what()));
+        }
+        cpu_steering = args->Present("cpu-steering") || !steering.empty();
+
+        if (args->Present("qdisc"))
+        {
+            queueing.qdisc = args->GetLastValue("qdisc");
+        }
+        if (args->Present("qdisc-bandwidth"))
+        {
+            int bw = std::atoi(args->GetLastValue("qdisc-bandwidth").c_str());
+            if (bw < 1)
+            {
+                throw CommandArgBaseException("Invalid argument to --qdisc-bandwidth: "
+                                              + args->GetLastValue("qdisc-bandwidth"));
+            }
+            queueing.bandwidth = bw;
+        }
+        if (args->Present("txqueuelen"))
+        {
+            int qlen = std::atoi(args->GetLastValue("txqueuelen").c_str());
+            if (qlen < 1 || qlen > 100000)
+            {
+                throw CommandArgBaseException("Invalid argument to --txqueuelen: "
+                                              + args->GetLastValue("txqueuelen"));
+            }
+            queueing.txqueuelen = qlen;
+        }
+        try
+        {
+            queueing.Validate();
+        }
+        catch (const NetCfgException& excp)
+        {
+            throw CommandArgBaseException("Invalid queueing option: "
+                                          + std::string(excp.what()));
+        }
+
         signal_broadcast = args->Present("signal-broadcast");
+        notification_multicast = args->Present("notification-multicast");
+        traffic_accounting = args->Present("traffic-accounting");
+        packet_capture = args->Present("packet-capture");
     }
 
 
@@ -160,12 +372,46 @@ private:
         case RedirectMethod::HOST_ROUTE:
             s << "host-route";
             break;
+        case RedirectMethod::POLICY_ROUTE:
+            s << "policy-route (table " << std::to_string(o.policy_table) << ")";
+            break;
         }
 
         if (o.so_mark >= 0)
         {
             s << ", so-mark: " << std::to_string(o.so_mark);
         }
+        if (!o.resolv_conf_stub.empty())
+        {
+            s << ", DNS stub resolver: " << o.resolv_conf_stub;
+        }
+        s << ", worker threads: " << std::to_string(o.worker_threads);
+        s << ", DNS commit delay: " << std::to_string(o.dns_commit_delay) << "ms";
+        s << ", remote cache TTL: " << std::to_string(o.remote_cache_ttl) << "s";
+        if (o.tun_pool > 0)
+        {
+            s << ", tun device pool: " << std::to_string(o.tun_pool);
+        }
+        if (o.notification_multicast)
+        {
+            s << ", notification multicast";
+        }
+        if (o.traffic_accounting)
+        {
+            s << ", traffic accounting";
+        }
+        if (o.packet_capture)
+        {
+            s << ", packet capture";
+        }
+        if (o.cpu_steering)
+        {
+            s << ", CPU steering (" << o.steering.str() << ")";
+        }
+        if (!o.queueing.empty())
+        {
+            s << ", queueing (" << o.queueing.str() << ")";
+        }
         return s.str();
     }
 };
@@ -0,0 +1,143 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-routebundle.hpp
+ *
+ * @brief  Next hops of the routes shared by the devices of a bundle
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace NetCfg
+{
+    /**
+     *  Keeps track of which devices of a bundle route a network.
+     *
+     *  The devices of a bundle are the virtual network devices of
+     *  parallel VPN sessions of the same configuration profile.  A
+     *  network routed by more than one of them is installed as a single
+     *  multipath (ECMP) route, with one next hop per device.  Each time
+     *  a device joins or leaves a route, the complete list of next hops
+     *  is needed to replace the route in the kernel.
+     *
+     *  This class is not thread-safe; the caller must serialize the
+     *  changes together with the route requests sent to the kernel.
+     */
+    class RouteBundles
+    {
+    public:
+        /// Upper limit of devices sharing a route
+        static const size_t MaxMembers = 16;
+
+        /**
+         *  A device carrying the traffic of a route
+         */
+        struct Nexthop
+        {
+            unsigned int ifindex;
+            std::string gateway;    ///< Gateway inside the VPN, may be empty
+        };
+
+
+        /**
+         *  Adds a device to a route, or updates its gateway
+         *
+         * @param route    std::string identifying the route, including
+         *                 the bundle and the routing table
+         * @param ifindex  Interface index of the device
+         * @param gateway  std::string with the gateway via the device
+         *
+         * @return Returns false if the route already has MaxMembers
+         *         other devices; the device is not added then
+         */
+        bool Join(const std::string& route, const unsigned int ifindex,
+                  const std::string& gateway)
+        {
+            auto& members = routes[route];
+            if (members.size() >= MaxMembers
+                && members.find(ifindex) == members.end())
+            {
+                return false;
+            }
+            members[ifindex] = gateway;
+            return true;
+        }
+
+
+        /**
+         *  Removes a device from a route
+         *
+         * @param route    std::string identifying the route
+         * @param ifindex  Interface index of the device
+         */
+        void Leave(const std::string& route, const unsigned int ifindex)
+        {
+            auto it = routes.find(route);
+            if (routes.end() == it)
+            {
+                return;
+            }
+            it->second.erase(ifindex);
+            if (it->second.empty())
+            {
+                routes.erase(it);
+            }
+        }
+
+
+        /**
+         * @param route  std::string identifying the route
+         *
+         * @return Returns the next hops of a route, ordered by the
+         *         interface index.  Empty if no device routes it.
+         */
+        std::vector<Nexthop> Nexthops(const std::string& route) const
+        {
+            std::vector<Nexthop> ret;
+            auto it = routes.find(route);
+            if (routes.end() != it)
+            {
+                for (const auto& m : it->second)
+                {
+                    ret.push_back({m.first, m.second});
+                }
+            }
+            return ret;
+        }
+
+
+        /**
+         * @return Returns the number of routes with at least one device
+         */
+        size_t size() const noexcept
+        {
+            return routes.size();
+        }
+
+
+    private:
+        std::map<std::string, std::map<unsigned int, std::string>> routes;
+    };
+} // namespace NetCfg
@@ -0,0 +1,183 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-routeset.hpp
+ *
+ * @brief  Set of networks routed via or excluded from a virtual device
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+
+namespace NetCfg
+{
+    /**
+     *  A single network to route via the VPN, or to exclude from it
+     */
+    struct RouteEntry
+    {
+        RouteEntry(std::string address, unsigned int prefix,
+                   bool ipv6, bool exclude = false)
+            : address(std::move(address)), prefix(prefix),
+              ipv6(ipv6), exclude(exclude)
+        {
+        }
+
+        bool operator==(const RouteEntry& other) const noexcept
+        {
+            return prefix == other.prefix && ipv6 == other.ipv6
+                   && exclude == other.exclude && address == other.address;
+        }
+
+        std::string str() const
+        {
+            return address + "/" + std::to_string(prefix);
+        }
+
+        std::string address;
+        unsigned int prefix;
+        bool ipv6;
+        bool exclude;
+    };
+
+
+    struct RouteEntryHash
+    {
+        size_t operator()(const RouteEntry& r) const noexcept
+        {
+            return std::hash<std::string>()(r.address)
+                   ^ (std::hash<unsigned int>()(r.prefix) << 1)
+                   ^ (r.ipv6 ? 0x5a5a : 0) ^ (r.exclude ? 0xa5a50000 : 0);
+        }
+    };
+
+
+    /**
+     *  Hashed set of RouteEntry objects.  Adding a network already in
+     *  the set does nothing, which makes it cheap to compare two route
+     *  sets and only apply the differences.
+     */
+    class RouteSet
+    {
+    public:
+        using Set = std::unordered_set<RouteEntry, RouteEntryHash>;
+
+        /**
+         *  Changes needed to go from one RouteSet to another
+         */
+        struct Diff
+        {
+            std::vector<RouteEntry> added;
+            std::vector<RouteEntry> removed;
+
+            bool empty() const noexcept
+            {
+                return added.empty() && removed.empty();
+            }
+        };
+
+
+        /**
+         * @return Returns true if the network was not already in the set
+         */
+        bool Add(const RouteEntry& route)
+        {
+            return routes.insert(route).second;
+        }
+
+        /**
+         * @return Returns true if the network was in the set
+         */
+        bool Remove(const RouteEntry& route)
+        {
+            return routes.erase(route) > 0;
+        }
+
+        bool Contains(const RouteEntry& route) const
+        {
+            return routes.find(route) != routes.end();
+        }
+
+        void Clear() noexcept
+        {
+            routes.clear();
+        }
+
+        size_t size() const noexcept
+        {
+            return routes.size();
+        }
+
+        bool empty() const noexcept
+        {
+            return routes.empty();
+        }
+
+        Set::const_iterator begin() const noexcept
+        {
+            return routes.begin();
+        }
+
+        Set::const_iterator end() const noexcept
+        {
+            return routes.end();
+        }
+
+
+        /**
+         *  Finds the networks which must be added and removed to turn
+         *  this set into another set
+         *
+         * @param target  RouteSet with the wanted networks
+         *
+         * @return Returns a Diff with the networks only found in target
+         *         as added and the networks only found in this set as
+         *         removed
+         */
+        Diff Compare(const RouteSet& target) const
+        {
+            Diff diff;
+            for (const auto& r : target.routes)
+            {
+                if (routes.find(r) == routes.end())
+                {
+                    diff.added.push_back(r);
+                }
+            }
+            for (const auto& r : routes)
+            {
+                if (target.routes.find(r) == target.routes.end())
+                {
+                    diff.removed.push_back(r);
+                }
+            }
+            return diff;
+        }
+
+
+    private:
+        Set routes;
+    };
+} // namespace NetCfg
@@ -25,6 +25,10 @@
 
 #pragma once
 
+#include <iostream>
+#include <mutex>
+#include <vector>
+
 #include "dbus/core.hpp"
 #include "log/dbus-log.hpp"
 #include "netcfg-changeevent.hpp"
@@ -36,6 +40,55 @@ class NetCfgSignals : public LogSender,
 public:
     typedef RCPtr<NetCfgSignals> Ptr;
 
+
+    /**
+     *  Collects the NetworkChange events sent while this object exists.
+     *  Subscribers with batched delivery get all of them in a single
+     *  NetworkChangeBatch signal when the last Batch object of the
+     *  NetCfgSignals object goes out of scope.  Other subscribers get
+     *  each event right away, as usual.
+     */
+    class Batch
+    {
+    public:
+        Batch(NetCfgSignals& sig)
+            : sig(sig)
+        {
+            std::lock_guard<std::mutex> guard(sig.batch_mtx);
+            ++sig.batch_depth;
+        }
+
+        ~Batch()
+        {
+            std::vector<NetCfgChangeEvent> events;
+            {
+                std::lock_guard<std::mutex> guard(sig.batch_mtx);
+                if (0 < --sig.batch_depth)
+                {
+                    return;
+                }
+                events.swap(sig.batch_events);
+            }
+            try
+            {
+                sig.send_batch(events);
+            }
+            catch (const std::exception& excp)
+            {
+                // Must not escape the destructor; the subscribers will
+                // see the gap in the sequence numbers
+                std::cerr << "** ERROR ** Sending NetworkChangeBatch failed: "
+                          << excp.what() << std::endl;
+            }
+        }
+
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+
+    private:
+        NetCfgSignals& sig;
+    };
+
     NetCfgSignals(GDBusConnection *conn, LogGroup lgroup,
                   std::string object_path, LogWriter *logwr)
         : LogSender(conn, lgroup, OpenVPN3DBus_interf_netcfg,
@@ -58,12 +111,20 @@ public:
 
     void Debug(std::string msg, bool duplicate_check = false) override
     {
-        Log(LogEvent(log_group, LogCategory::DEBUG, msg));
+        if (!LogEnabled(LogCategory::DEBUG))
+        {
+            return;
+        }
+        Log(LogEvent(log_group, LogCategory::DEBUG, std::move(msg)));
     }
 
 
     void Debug(std::string dev, std::string msg)
     {
+        if (!LogEnabled(LogCategory::DEBUG))
+        {
+            return;
+        }
         std::stringstream m;
         m << "[" << dev << "] " << msg;
         Debug(m.str());
@@ -81,9 +142,34 @@ public:
         GVariant *e = ev.GetGVariant();
         if (subscriptions)
         {
-            Send(subscriptions->GetSubscribersList(ev),
-                 get_interface(), get_object_path(),
-                 "NetworkChange", e);
+            if (subscriptions->HasBatchSubscribers())
+            {
+                std::unique_lock<std::mutex> guard(batch_mtx);
+                if (0 < batch_depth)
+                {
+                    batch_events.push_back(ev);
+                }
+                else
+                {
+                    // Not part of a device operation; deliver it as a
+                    // batch of its own
+                    guard.unlock();
+                    send_batch({ev});
+                }
+            }
+
+            NetCfgSubscriptions::Recipients rcpt = subscriptions->GetRecipients(ev);
+            if (rcpt.multicast)
+            {
+                // Every subscriber wants this one; a single signal
+                // without a destination reaches all of them
+                Send("NetworkChange", e);
+            }
+            else
+            {
+                Send(*rcpt.subscribers, get_interface(), get_object_path(),
+                     "NetworkChange", e);
+            }
         }
         else
         {
@@ -96,7 +182,83 @@ public:
     }
 
 
+    /**
+     *  Tells a single backend process the network path to its VPN
+     *  server has changed, so it can reconnect right away instead of
+     *  waiting for the keep-alive timeout.
+     *
+     *  D-Bus data type: (s), a description of the change
+     *
+     * @param busname  std::string with the unique bus name of the backend
+     * @param reason   std::string describing the change
+     */
+    void EgressChange(const std::string& busname, const std::string& reason) const
+    {
+        Send(std::vector<std::string>{busname}, get_interface(),
+             get_object_path(), "EgressChange",
+             g_variant_new("(s)", reason.c_str()));
+    }
+
+
+    /**
+     *  Tells a backend process the ovpn-dco kernel module removed its
+     *  peer on its own, typically because the keep-alive timeout
+     *  expired.  This is sent straight from the DCO worker thread, so
+     *  it does not queue up behind other work in the main loop.
+     *
+     *  D-Bus data type: (us), the peer ID and the deletion reason
+     *
+     * @param busname  std::string with the bus name of the backend
+     * @param objpath  std::string with the D-Bus path of the DCO object
+     * @param peer_id  Peer ID of the removed peer
+     * @param reason   std::string with the deletion reason
+     */
+    void PeerDeleted(const std::string& busname, const std::string& objpath,
+                     const uint32_t peer_id, const std::string& reason) const
+    {
+        Send(std::vector<std::string>{busname}, get_interface(), objpath,
+             "PeerDeleted", g_variant_new("(us)", peer_id, reason.c_str()));
+    }
+
+
 private:
     const unsigned int default_log_level = 6; // LogCategory::DEBUG
     NetCfgSubscriptions::Ptr subscriptions;
+    mutable std::mutex batch_mtx;
+    unsigned int batch_depth = 0;
+    mutable std::vector<NetCfgChangeEvent> batch_events;
+
+
+    /**
+     *  Sends a NetworkChangeBatch signal to each batched subscriber
+     *  wanting any of these events.
+     *
+     *  D-Bus data type: (ta(usa{ss})), the sequence number of the first
+     *  event followed by the events.
+     */
+    void send_batch(const std::vector<NetCfgChangeEvent>& events) const
+    {
+        if (!subscriptions || events.empty())
+        {
+            return;
+        }
+
+        subscriptions->DeliverBatch(events,
+            [this](const std::string& subscriber,
+                   const std::uint64_t first_seq,
+                   const std::vector<const NetCfgChangeEvent *>& evs)
+            {
+                GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a(usa{ss})"));
+                for (const auto& ev : evs)
+                {
+                    g_variant_builder_add_value(b, ev->GetGVariant());
+                }
+                GVariant *batch = g_variant_new("(ta(usa{ss}))",
+                                                (guint64) first_seq, b);
+                g_variant_builder_unref(b);
+                Send(std::vector<std::string>{subscriber},
+                     get_interface(), get_object_path(),
+                     "NetworkChangeBatch", batch);
+            });
+    }
 };
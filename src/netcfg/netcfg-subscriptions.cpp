@@ -33,28 +33,50 @@
 #include "netcfg-subscriptions.hpp"
 
 
+NetCfgSubscriptions::NetCfgSubscriptions(const bool multicast)
+    : multicast(multicast)
+{
+    rebuild_index();
+}
+
+
 void NetCfgSubscriptions::Subscribe(const std::string& sender, uint32_t filter_flags)
 {
-    if (0 == filter_flags)
+    if (0 == (filter_flags & 65535))
     {
         throw NetCfgException("Subscription filter flag must be > 0");
     }
-    if (65535 < filter_flags)
+    if (0 != (filter_flags & ~(65535 | FLAG_BATCHED)))
     {
         throw NetCfgException("Invalid subscription flag, must be < 65535");
     }
-    subscriptions[sender] = (uint16_t) filter_flags;
+    std::lock_guard<std::mutex> guard(mtx);
+    subscriptions[sender] = filter_flags;
+    if (filter_flags & FLAG_BATCHED)
+    {
+        // Changing the filter of an existing subscription does not
+        // restart the numbering
+        batch_seq.insert(std::make_pair(sender, 1));
+    }
+    else
+    {
+        batch_seq.erase(sender);
+    }
+    rebuild_index();
 }
 
 
 void NetCfgSubscriptions::Unsubscribe(const std::string& subscriber)
 {
+    std::lock_guard<std::mutex> guard(mtx);
     if (subscriptions.find(subscriber) == subscriptions.end())
     {
         throw NetCfgException("Subscription not found for '"
                               + subscriber + "'");
     }
     subscriptions.erase(subscriber);
+    batch_seq.erase(subscriber);
+    rebuild_index();
 }
 
 
@@ -68,6 +90,7 @@ GVariant* NetCfgSubscriptions::List()
                               "(NetCfgSubscriptions::List)");
     }
 
+    std::lock_guard<std::mutex> guard(mtx);
     for (const auto& sub : subscriptions)
     {
         g_variant_builder_add(bld, "(su)",
@@ -76,3 +99,103 @@ GVariant* NetCfgSubscriptions::List()
     }
     return GLibUtils::wrapInTuple(bld);
 }
+
+
+NetCfgSubscriptions::Recipients NetCfgSubscriptions::GetRecipients(const NetCfgChangeEvent& ev) const
+{
+    uint16_t type = (uint16_t) ev.type;
+
+    Recipients ret;
+    std::lock_guard<std::mutex> guard(mtx);
+    if (0 != type && 0 == (type & (type - 1)))
+    {
+        // A single change type bit, which is what events carry
+        ret.subscribers = by_type[__builtin_ctz(type)];
+    }
+    else
+    {
+        auto targets = std::make_shared<std::vector<std::string>>();
+        for (const auto& s : subscriptions)
+        {
+            if ((type & s.second) && !(s.second & FLAG_BATCHED))
+            {
+                targets->push_back(s.first);
+            }
+        }
+        ret.subscribers = targets;
+    }
+    ret.multicast = multicast && ret.subscribers->size() > 1
+                    && ret.subscribers->size() == subscriptions.size();
+    return ret;
+}
+
+
+bool NetCfgSubscriptions::HasBatchSubscribers() const
+{
+    std::lock_guard<std::mutex> guard(mtx);
+    return !batch_seq.empty();
+}
+
+
+void NetCfgSubscriptions::DeliverBatch(const std::vector<NetCfgChangeEvent>& events,
+                                       BatchSender send)
+{
+    struct Delivery
+    {
+        std::string subscriber;
+        uint64_t first_seq;
+        std::vector<const NetCfgChangeEvent *> events;
+    };
+
+    // The sequence numbers are reserved and the signals sent while
+    // holding delivery_mtx, so concurrent batches cannot be sent out
+    // of order.  The subscription list itself is only locked while
+    // picking the events.
+    std::lock_guard<std::mutex> delivery_guard(delivery_mtx);
+    std::vector<Delivery> deliveries;
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        for (auto& seq : batch_seq)
+        {
+            uint32_t filter = subscriptions[seq.first];
+            Delivery d;
+            for (const auto& ev : events)
+            {
+                if ((uint16_t) ev.type & filter)
+                {
+                    d.events.push_back(&ev);
+                }
+            }
+            if (d.events.empty())
+            {
+                continue;
+            }
+            d.subscriber = seq.first;
+            d.first_seq = seq.second;
+            seq.second += d.events.size();
+            deliveries.push_back(std::move(d));
+        }
+    }
+
+    for (const auto& d : deliveries)
+    {
+        send(d.subscriber, d.first_seq, d.events);
+    }
+}
+
+
+void NetCfgSubscriptions::rebuild_index()
+{
+    for (unsigned int bit = 0; bit < type_bits; bit++)
+    {
+        auto list = std::make_shared<std::vector<std::string>>();
+        for (const auto& s : subscriptions)
+        {
+            if ((s.second & (1 << bit)) && !(s.second & FLAG_BATCHED))
+            {
+                list->push_back(s.first);
+            }
+        }
+        by_type[bit] = list;
+    }
+}
@@ -25,13 +25,34 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <openvpn/common/rc.hpp>
 
+#include "netcfg-changeevent.hpp"
+
 
 /**
  *  External utilities can subscribe to NetworkChange signals from the
  *  netcfg service.  These subscriptions are handled in this class.
  *
+ *  NetworkChange signals are sent from the netcfg worker threads, so
+ *  all access to the subscription list is serialized.
+ *
+ *  Subscriptions change rarely compared to how often NetworkChange
+ *  signals are sent.  Each NetCfgChangeType has its own list of
+ *  subscribers, rebuilt on each subscription change, so looking up the
+ *  recipients of a signal does not need to check all subscribers.
+ *
+ *  Subscribers setting FLAG_BATCHED get NetworkChangeBatch signals
+ *  instead, each carrying all the events of a single device operation.
  */
 class NetCfgSubscriptions : public RC<thread_safe_refcount>
 {
@@ -41,11 +62,59 @@ public:
     /**
      *  Contains a list of D-Bus subscribers' unique D-Bus name, mapped against
      *  a filter bit mask built up of bitwise OR of NetCfgChangeType values
+     *  and the subscription flags
+     */
+    typedef std::map<std::string, std::uint32_t> NetCfgNotifSubscriptions;
+
+    /**
+     *  Subscription flag, added to the filter mask.  Events are delivered
+     *  in NetworkChangeBatch signals instead of NetworkChange signals.
+     */
+    static const std::uint32_t FLAG_BATCHED = 1 << 16;
+
+    /**
+     *  Callback sending a batch of events to a single subscriber
+     *
+     *  @param subscriber  std::string with the D-Bus unique bus name
+     *  @param first_seq   Sequence number of the first event in the batch
+     *  @param events      The events this subscriber wants, in order
+     */
+    typedef std::function<void(const std::string& subscriber,
+                               const std::uint64_t first_seq,
+                               const std::vector<const NetCfgChangeEvent *>& events)> BatchSender;
+
+    /**
+     *  Immutable list of subscribers' unique D-Bus names
+     */
+    typedef std::shared_ptr<const std::vector<std::string>> SubscriberList;
+
+
+    /**
+     *  Recipients of a NetworkChange signal
      */
-    typedef std::map<std::string, std::uint16_t> NetCfgNotifSubscriptions;
+    struct Recipients
+    {
+        /// All the subscribers of this change type
+        SubscriberList subscribers;
+
+        /**
+         *  All subscribers want this change type, and multicast mode is
+         *  enabled.  The signal can be sent once without a destination
+         *  instead of once per subscriber.
+         */
+        bool multicast = false;
+    };
 
 
-    NetCfgSubscriptions() = default;
+    /**
+     *  Initialize the subscription manager
+     *
+     * @param multicast  If true, NetworkChange signals all subscribers
+     *                   want are sent without a destination.  Processes
+     *                   not subscribed may then receive these signals
+     *                   as well.
+     */
+    NetCfgSubscriptions(const bool multicast = false);
 
 
     ~NetCfgSubscriptions() = default;
@@ -88,7 +157,7 @@ public:
      * @param filter_flags  uint32_t carrying all the filter flags.  This data
      *                      type is much bigger than the NetCfgChangeType
      *                      (uint16_t).  This is to allow a better overflow
-     *                      check.
+     *                      check and to carry the FLAG_BATCHED flag.
      *
      * @throws Throws NetCfgException with an error message which can be sent
      *         back to the caller.
@@ -127,20 +196,61 @@ public:
      */
     std::vector<std::string> GetSubscribersList(const NetCfgChangeEvent& ev) const
     {
-        // Loop through all subscribers and identify who wants this
-        // notification.
-        std::vector<std::string> targets;
-        for (const auto& s : subscriptions)
-        {
-            if ((uint16_t) ev.type & s.second)
-            {
-                targets.push_back(s.first);
-            }
-        }
-        return targets;
+        return *GetRecipients(ev).subscribers;
     }
 
 
+    /**
+     *  Get the recipients of a NetworkChange signal for a specific
+     *  NetCfgChangeType.  This does not copy the subscriber list.
+     *
+     * @param ev  NetCfgChangeEvent object where to extract the
+     *            NetCfgChangeType from
+     *
+     * @return  Returns a Recipients object
+     */
+    Recipients GetRecipients(const NetCfgChangeEvent& ev) const;
+
+
+    /**
+     * @return Returns true if any subscriber wants batched delivery
+     */
+    bool HasBatchSubscribers() const;
+
+
+    /**
+     *  Delivers a batch of events to all batched subscribers.  Each
+     *  subscriber gets the events matching its filter mask, numbered
+     *  with its own consecutive sequence numbers starting at 1.
+     *
+     *  Batches are delivered one at a time, so each subscriber receives
+     *  them in sequence number order.
+     *
+     * @param events  std::vector of the NetCfgChangeEvents to deliver
+     * @param send    BatchSender sending the signal to one subscriber
+     */
+    void DeliverBatch(const std::vector<NetCfgChangeEvent>& events,
+                      BatchSender send);
+
+
 private:
+    /// Number of NetCfgChangeType bits
+    static const unsigned int type_bits = 16;
+
+    mutable std::mutex mtx;
+    std::mutex delivery_mtx;
+    const bool multicast;
     NetCfgNotifSubscriptions subscriptions;
+    std::array<SubscriberList, type_bits> by_type;
+
+    /// Next sequence number of each batched subscriber
+    std::map<std::string, std::uint64_t> batch_seq;
+
+
+    /**
+     *  Rebuilds the by_type lists of subscribers not using batched
+     *  delivery from the subscriptions map.  Must be called with mtx
+     *  held.
+     */
+    void rebuild_index();
 };
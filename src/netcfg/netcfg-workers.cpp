@@ -0,0 +1,68 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-workers.cpp
+ *
+ * @brief  Implementation of NetCfgRoutingLock
+ */
+
+#include "netcfg-workers.hpp"
+
+
+//
+//  NetCfgRoutingLock
+//
+
+void NetCfgRoutingLock::lock(const bool exclusive)
+{
+    std::unique_lock<std::mutex> lk(mtx);
+    if (exclusive)
+    {
+        ++exclusive_waiting;
+        cv.wait(lk, [this]()
+                    {
+                        return !exclusive_held && 0 == shared_holders;
+                    });
+        --exclusive_waiting;
+        exclusive_held = true;
+    }
+    else
+    {
+        cv.wait(lk, [this]()
+                    {
+                        return !exclusive_held && 0 == exclusive_waiting;
+                    });
+        ++shared_holders;
+    }
+}
+
+
+void NetCfgRoutingLock::unlock(const bool exclusive)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    if (exclusive)
+    {
+        exclusive_held = false;
+    }
+    else
+    {
+        --shared_holders;
+    }
+    cv.notify_all();
+}
@@ -0,0 +1,126 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-workers.hpp
+ *
+ * @brief  Worker thread pool running network device operations outside
+ *         of the GLib main loop, and the routing lock they share
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "common/worker-pool.hpp"
+
+
+/**
+ *  Host wide lock for operations depending on or modifying the routing
+ *  of other network devices.
+ *
+ *  Devices only adding routes through themselves can be configured in
+ *  parallel and take a shared lock.  Adding excluded routes (which
+ *  depends on the current default route) or redirecting the default
+ *  route requires an exclusive lock.  Waiting exclusive lockers are
+ *  preferred over new shared lockers.
+ */
+class NetCfgRoutingLock
+{
+public:
+    /**
+     *  RAII helper holding a NetCfgRoutingLock for its lifetime
+     */
+    class Guard
+    {
+    public:
+        Guard(NetCfgRoutingLock& lock, const bool exclusive)
+            : lock(lock), exclusive(exclusive)
+        {
+            lock.lock(exclusive);
+        }
+
+        ~Guard()
+        {
+            lock.unlock(exclusive);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        NetCfgRoutingLock& lock;
+        const bool exclusive;
+    };
+
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    unsigned int shared_holders = 0;
+    unsigned int exclusive_waiting = 0;
+    bool exclusive_held = false;
+
+    void lock(const bool exclusive);
+    void unlock(const bool exclusive);
+};
+
+
+
+/**
+ *  Thread pool running operations for the netcfg service.  Each network
+ *  device posts its operations to a Strand of its own, so operations on
+ *  different devices may run in parallel.
+ */
+class NetCfgWorkerPool : public WorkerPool
+{
+public:
+    using Ptr = std::shared_ptr<NetCfgWorkerPool>;
+
+    using WorkerPool::WorkerPool;
+
+
+    /**
+     * @return Returns the NetCfgRoutingLock shared by all operations
+     *         run in this pool
+     */
+    NetCfgRoutingLock& GetRoutingLock() noexcept
+    {
+        return routing_lock;
+    }
+
+
+    /**
+     *  Lock serializing all changes to the host DNS resolver
+     *  configuration.  The DNS::SettingsManager and ResolverSettings
+     *  objects are not thread safe.
+     *
+     * @return Returns the std::mutex to hold while accessing them
+     */
+    std::mutex& GetResolverLock() noexcept
+    {
+        return resolver_lock;
+    }
+
+
+private:
+    NetCfgRoutingLock routing_lock;
+    std::mutex resolver_lock;
+};
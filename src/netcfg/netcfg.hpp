@@ -26,22 +26,40 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
 #include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <signal.h>
+#include <net/if.h>
 
 #include <openvpn/common/rc.hpp>
 
 #include "common/lookup.hpp"
+#include "common/utils.hpp"
 #include "dbus/core.hpp"
 #include "dbus/connection-creds.hpp"
 #include "dbus/glibutils.hpp"
+#include "dbus/object-manager.hpp"
 #include "dbus/path.hpp"
+#include "dbus/resource-usage.hpp"
 #include "log/dbus-log.hpp"
 #include "log/logwriter.hpp"
+#include "dns/commit-queue.hpp"
 #include "dns/settings-manager.hpp"
 #include "netcfg-signals.hpp"
 #include "netcfg-subscriptions.hpp"
 #include "netcfg-device.hpp"
+#include "netcfg-device-store.hpp"
+#include "dco-capability.hpp"
 #include "netcfg-options.hpp"
+#include "netcfg-workers.hpp"
+#include "netlink-monitor.hpp"
+#include "netlink-routes.hpp"
+#include "remote-resolver-cache.hpp"
 
 using namespace openvpn;
 using namespace NetCfg;
@@ -64,21 +82,71 @@ public:
      * @param conn               D-Bus connection to use
      * @param default_log_level  Default log level to start with
      * @param logwr              LogWriter object which tackles local logging
+     * @param workers            NetCfgWorkerPool running the device
+     *                           operations
      */
     NetCfgServiceObject(GDBusConnection *conn,
                         const unsigned int default_log_level,
                         DNS::SettingsManager::Ptr resolver,
                         LogWriter *logwr,
-                        NetCfgOptions options)
+                        NetCfgOptions options,
+                        NetCfgWorkerPool::Ptr workers)
         : DBusObject(OpenVPN3DBus_rootp_netcfg),
           DBusConnectionCreds(conn),
           signal(conn, LogGroup::NETCFG, OpenVPN3DBus_rootp_netcfg, logwr),
           resolver(resolver),
           creds(conn),
-          options(std::move(options))
+          options(std::move(options)),
+          workers(workers),
+          dco_capability(std::make_shared<DCOCapability>([]()
+                                                         {
+#ifdef ENABLE_OVPNDCO
+                                                             return NetCfgDCO::available();
+#else
+                                                             return false;
+#endif
+                                                         }))
     {
         signal.SetLogLevel(default_log_level);
 
+        // With worker threads, the DNS resolver settings of devices
+        // established at the same time are applied in a single commit.
+        // Without them, everything must happen in the main loop.
+        if (resolver && this->options.worker_threads > 0)
+        {
+            dns_commits = std::make_shared<DNS::CommitQueue>(
+                [this]()
+                {
+                    try
+                    {
+                        std::lock_guard<std::mutex> dnsguard(this->workers->GetResolverLock());
+                        this->resolver->ApplySettings(&signal);
+                    }
+                    catch (const NetCfgException& excp)
+                    {
+                        signal.LogCritical("DNS Resolver settings: "
+                                           + std::string(excp.what()));
+                    }
+                },
+                std::chrono::milliseconds(this->options.dns_commit_delay));
+        }
+
+        // All socket protections are run one at a time, outside the
+        // main loop; the host routes of all backends are kept in one list
+        protect_strand = this->workers->NewStrand();
+
+        if (this->options.tun_pool > 0)
+        {
+            tun_pool = std::make_shared<NetCfg::TunPool>(this->options.tun_pool);
+        }
+
+        if (this->options.remote_cache_ttl > 0)
+        {
+            std::chrono::seconds ttl(this->options.remote_cache_ttl);
+            remote_cache = std::make_shared<RemoteResolverCache>(
+                ttl, std::min(ttl, std::chrono::seconds(10)));
+        }
+
         std::stringstream introspection_xml;
         introspection_xml << "<node name='" << OpenVPN3DBus_rootp_netcfg << "'>"
                           << "    <interface name='" << OpenVPN3DBus_interf_netcfg << "'>"
@@ -95,11 +163,18 @@ public:
                           << "          <arg type='o' direction='in' name='device_path' />"
                           << "          <arg type='b' direction='out' name='succeded'/>"
                           << "        </method>"
+                          << "        <method name='ResolveRemote'>"
+                          << "          <arg type='s' direction='in' name='host'/>"
+                          << "          <arg type='as' direction='out' name='addresses'/>"
+                          << "        </method>"
                           << "        <method name='DcoAvailable'>"
                           << "          <arg type='b' direction='out' name='available'/>"
                           << "        </method>"
                           << "        <method name='Cleanup'>"
                           << "        </method>"
+                          << "        <signal name='EgressChange'>"
+                          << "          <arg type='s' name='reason'/>"
+                          << "        </signal>"
                           << NetCfgSubscriptions::GenIntrospection("NotificationSubscribe",
                                                                    "NotificationUnsubscribe",
                                                                    "NotificationSubscriberList")
@@ -108,11 +183,59 @@ public:
                           << "    <property type='u' name='global_dns_search' access='read'/>"
                           << "    <property type='u' name='log_level' access='readwrite'/>"
                           << "    <property type='s' name='config_file' access='read'/>"
+                          << "    <property type='b' name='dco_available' access='read'/>"
+                          << "    <property type='s' name='dco_last_failure' access='read'/>"
                           << "    <property type='s' name='version' access='read'/>"
                           << signal.GetLogIntrospection()
                           << "    </interface>"
                           << "</node>";
         ParseIntrospectionXML(introspection_xml);
+
+        // Listing the devices must not delay the backends setting up
+        // their virtual interfaces
+        SetLowPriorityMethod("FetchInterfaceList");
+
+        // The device objects are owned by the openvpn user, which
+        // needs to see all of them
+        objmgr.reset(new DBusObjectManager<NetCfgDevice>(
+                             conn, OpenVPN3DBus_rootp_netcfg,
+                             OpenVPN3DBus_interf_netcfg,
+                             [this]()
+                             {
+                                 std::vector<NetCfgDevice *> ret;
+                                 for (const auto& dev : devices)
+                                 {
+                                     ret.push_back(dev.second);
+                                 }
+                                 return ret;
+                             },
+                             this->options.signal_broadcast, true));
+
+        try
+        {
+            egress_monitor.reset(new NetCfg::EgressMonitor(
+                [this](const std::set<unsigned int>& ifindexes, bool default_route)
+                {
+                    egress_changed(ifindexes, default_route);
+                }));
+        }
+        catch (const NetCfgException& excp)
+        {
+            signal.LogWarn("Network changes will not be detected: "
+                           + std::string(excp.what()));
+        }
+
+        usage_reporter = DBusResourceUsage::Instance().AddReporter(
+            [this](DBusResourceUsage::Report& report)
+            {
+                for (const auto& dev : devices)
+                {
+                    dev.second->ReportResourceUsage(report);
+                }
+                std::lock_guard<std::mutex> guard(egress_mtx);
+                report.Add("egress_watches", egress_watch.size(),
+                           egress_watch.size() * sizeof(EgressWatch));
+            });
         signal.Debug("Network Configuration service object ready");
         if (!resolver)
         {
@@ -123,6 +246,21 @@ public:
 
     ~NetCfgServiceObject() override
     {
+        DBusResourceUsage::Instance().RemoveReporter(usage_reporter);
+
+        // Stops the monitor thread before the rest goes away
+        egress_monitor.reset();
+    }
+
+
+    /**
+     *  Retrieve the org.freedesktop.DBus.ObjectManager implementation
+     *  giving access to all the virtual device objects.  It needs to be
+     *  registered on the D-Bus together with this object.
+     */
+    DBusObjectManager<NetCfgDevice>& GetObjectManager()
+    {
+        return *objmgr;
     }
 
 
@@ -162,8 +300,6 @@ public:
     {
         try
         {
-            IdleCheck_UpdateTimestamp();
-
             // Only the VPN backend clients are granted access
             validate_sender(sender);
 
@@ -203,15 +339,17 @@ public:
             }
             else if ("ProtectSocket" == method_name)
             {
-                retval = protect_socket(GetPID(sender), conn, invoc, params);
+                protect_socket(sender, GetPID(sender), conn, invoc, params);
+                return;
+            }
+            else if ("ResolveRemote" == method_name)
+            {
+                resolve_remote(invoc, params);
+                return;
             }
             else if ("DcoAvailable" == method_name)
             {
-                bool available = false;
-#ifdef ENABLE_OVPNDCO
-                available = NetCfgDCO::available();
-#endif
-                retval = g_variant_new("(b)", available);
+                retval = g_variant_new("(b)", dco_capability->Available());
             }
             else if ("Cleanup" == method_name)
             {
@@ -359,13 +497,17 @@ public:
                                                 dev_name, resolver, subscriptions.get(),
                                                 signal.GetLogLevel(),
                                                 signal.GetLogWriter(),
-                                           options);
-
+                                                options, workers);
+        device->SetDCOCapability(dco_capability);
+        device->SetDNSCommitQueue(dns_commits);
+        device->SetTunPool(tun_pool);
+        watch_device_state(device, dev_path);
 
         IdleCheck_RefInc();
         device->IdleCheck_Register(IdleCheck_Get());
         device->RegisterObject(conn);
         devices[dev_path] = device;
+        objmgr->ObjectAdded(device);
 
         signal.LogInfo(std::string("Virtual device '") + dev_name + "'"
                        + " registered on " + dev_path
@@ -376,6 +518,101 @@ public:
     }
 
 
+    /**
+     *  Re-creates the device objects of the devices established by a
+     *  previous netcfg service process, as recorded in the devices.json
+     *  file in the state directory.  Only devices whose backend process
+     *  is still running and whose virtual device still exists on the
+     *  host are taken over; the host configuration is not changed.
+     *
+     *  Devices using DCO cannot be taken over, as the kernel peer state
+     *  is only reachable via the netlink socket of the previous process.
+     *  These backends need to reconnect.
+     *
+     *  Must be called before the DNS resolver settings are applied the
+     *  first time.
+     *
+     * @param conn  D-Bus connection to register the device objects on
+     */
+    void AdoptDevices(GDBusConnection *conn)
+    {
+        if (options.state_dir.empty())
+        {
+            return;
+        }
+        store_file = options.state_dir + "/devices.json";
+
+        std::ifstream f(store_file);
+        std::stringstream content;
+        content << f.rdbuf();
+        store.Parse(content.str());
+
+        unsigned int adopted = 0;
+        for (const auto& rec : store.GetAll())
+        {
+            std::string reason;
+            if (0 != ::kill(rec.owner_pid, 0) && ESRCH == errno)
+            {
+                reason = "backend process is gone";
+            }
+            else if (rec.dco)
+            {
+                reason = "DCO devices cannot be taken over";
+            }
+            else if (0 == if_nametoindex(rec.device_name.c_str()))
+            {
+                reason = "device does not exist";
+            }
+            else if (devices.find(rec.object_path) != devices.end())
+            {
+                reason = "device object exists";
+            }
+            if (!reason.empty())
+            {
+                signal.LogVerb1("Not taking over device '" + rec.device_name
+                                + "' (owner pid "
+                                + std::to_string(rec.owner_pid) + "): "
+                                + reason);
+                store.Remove(rec.object_path);
+                continue;
+            }
+
+            const std::string& dev_path = rec.object_path;
+            NetCfgDevice *device = new NetCfgDevice(conn,
+                                                    [self = Ptr(this), dev_path]()
+                                                    {
+                                                        self->remove_device_object(dev_path);
+                                                    },
+                                                    rec.owner, rec.owner_pid,
+                                                    dev_path,
+                                                    rec.device_name, resolver,
+                                                    subscriptions.get(),
+                                                    signal.GetLogLevel(),
+                                                    signal.GetLogWriter(),
+                                                    options, workers);
+            device->SetDCOCapability(dco_capability);
+            device->SetDNSCommitQueue(dns_commits);
+            device->SetTunPool(tun_pool);
+            device->Restore(rec);
+            watch_device_state(device, dev_path);
+
+            IdleCheck_RefInc();
+            device->IdleCheck_Register(IdleCheck_Get());
+            device->RegisterObject(conn);
+            devices[dev_path] = device;
+            objmgr->ObjectAdded(device);
+            ++adopted;
+        }
+        write_store();
+
+        if (adopted > 0)
+        {
+            signal.LogInfo("Took over " + std::to_string(adopted)
+                           + " established virtual device(s)");
+        }
+    }
+
+
     /**
      *   Callback which is used each time a NetCfgServiceObject D-Bus property
      *   is being read.
@@ -401,7 +638,6 @@ public:
     {
         try
         {
-            IdleCheck_UpdateTimestamp();
             if ("log_level" == property_name)
             {
                 return g_variant_new_uint32(signal.GetLogLevel());
@@ -418,6 +654,7 @@ public:
                     // instead of an error when reading this property
                     return GLibUtils::GVariantFromVector(std::vector<std::string>{});
                 }
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
                 return GLibUtils::GVariantFromVector(resolver->GetDNSservers());
             }
             else if ("global_dns_search" == property_name)
@@ -428,8 +665,17 @@ public:
                     // instead of an error when reading this property
                     return GLibUtils::GVariantFromVector(std::vector<std::string>{});
                 }
+                std::lock_guard<std::mutex> dnsguard(workers->GetResolverLock());
                 return GLibUtils::GVariantFromVector(resolver->GetSearchDomains());
             }
+            else if ("dco_available" == property_name)
+            {
+                return g_variant_new_boolean(dco_capability->Available());
+            }
+            else if ("dco_last_failure" == property_name)
+            {
+                return g_variant_new_string(dco_capability->GetLastFailure().c_str());
+            }
             else if ("version" == property_name)
             {
                 return g_variant_new_string(package_version());
@@ -471,7 +717,6 @@ public:
     {
         try
         {
-            IdleCheck_UpdateTimestamp();
             validate_sender(sender);
 
             if ("log_level" == property_name)
@@ -511,8 +756,101 @@ private:
     DNS::SettingsManager::Ptr resolver;
     DBusConnectionCreds creds;
     std::map<std::string, NetCfgDevice *> devices;
+    std::unique_ptr<DBusObjectManager<NetCfgDevice>> objmgr;
     NetCfgOptions options;
     NetCfgSubscriptions::Ptr subscriptions;
+    NetCfgWorkerPool::Ptr workers;
+    DCOCapability::Ptr dco_capability;
+    DNS::CommitQueue::Ptr dns_commits;
+    NetCfgWorkerPool::Strand::Ptr protect_strand;
+    RemoteResolverCache::Ptr remote_cache;
+    NetCfg::TunPool::Ptr tun_pool;   ///< Only with --tun-pool
+    NetCfg::DeviceStore store;
+    std::string store_file;
+    std::mutex store_mtx;
+
+    /**
+     *  The path a backend process uses to reach its VPN server, as seen
+     *  when its socket was protected
+     */
+    struct EgressWatch
+    {
+        std::string busname;     ///< Unique bus name of the backend
+        std::string remote;      ///< IP address of the VPN server
+        bool ipv6;
+        std::string tunif;       ///< VPN device of the backend, if any
+        unsigned int ifindex;    ///< Interface used to reach the server
+    };
+    NetCfg::EgressMonitor::Ptr egress_monitor;
+    std::mutex egress_mtx;
+    std::map<pid_t, EgressWatch> egress_watch;
+    std::set<pid_t> egress_stale;  ///< Backends whose host route must be renewed
+    DBusResourceUsage::ReporterId usage_reporter = 0;
+
+
+    /**
+     *  Called by the EgressMonitor thread when default routes or
+     *  interface addresses have changed.  Each backend whose path to
+     *  its VPN server is affected gets an EgressChange signal.
+     *
+     * @param ifindexes      Interfaces where addresses changed
+     * @param default_route  Did a default route change
+     */
+    void egress_changed(const std::set<unsigned int>& ifindexes,
+                        bool default_route)
+    {
+        std::lock_guard<std::mutex> guard(egress_mtx);
+        for (auto& w : egress_watch)
+        {
+            EgressWatch& watch = w.second;
+            std::string reason;
+            if (0 != watch.ifindex && ifindexes.count(watch.ifindex) > 0)
+            {
+                reason = "Addresses changed on " + ifname(watch.ifindex);
+            }
+            else if (default_route)
+            {
+                unsigned int now = NetCfg::EgressMonitor::RouteInterface(watch.remote,
+                                                                         watch.ipv6,
+                                                                         options.so_mark);
+                if (now == 0 || now != watch.ifindex
+                    || (!watch.tunif.empty() && now == if_nametoindex(watch.tunif.c_str())))
+                {
+                    reason = "Route to " + watch.remote + " changed from "
+                             + ifname(watch.ifindex) + " to " + ifname(now);
+                    watch.ifindex = now;
+                }
+            }
+            if (reason.empty())
+            {
+                continue;
+            }
+
+            signal.LogVerb1("Network change for PID " + std::to_string(w.first)
+                            + ": " + reason);
+            egress_stale.insert(w.first);
+            try
+            {
+                signal.EgressChange(watch.busname, reason);
+            }
+            catch (const DBusException& excp)
+            {
+                signal.LogError("Sending EgressChange failed: "
+                                + std::string(excp.what()));
+            }
+        }
+    }
+
+
+    static std::string ifname(unsigned int ifindex)
+    {
+        char name[IF_NAMESIZE] = {};
+        if (0 == ifindex || !if_indextoname(ifindex, name))
+        {
+            return "(none)";
+        }
+        return name;
+    }
 
 
     /**
@@ -552,11 +890,13 @@ private:
             auto tundev = it->second;
             if (tundev->getCreatorPID() == pid)
             {
-                // The teardown method will also call to the erase method which will
-                // then be a noop but doing the erase here gets us a valid next iterator
+                // Deleting the device will also call to the erase method which
+                // will then be a noop but doing the erase here gets us a valid
+                // next iterator.  The device is deleted once its queued
+                // operations have completed.
+                objmgr->ObjectRemoved(tundev);
                 it = devices.erase(it);
-                tundev->teardown(conn);
-                delete tundev;
+                tundev->Destroy(conn);
             }
             else
             {
@@ -564,7 +904,14 @@ private:
                 it++;
             }
         }
-        openvpn::cleanup_protected_sockets(pid);
+        protect_strand->Post([this, pid]()
+                             {
+                                 openvpn::cleanup_protected_sockets(pid);
+
+                                 std::lock_guard<std::mutex> guard(egress_mtx);
+                                 egress_watch.erase(pid);
+                                 egress_stale.erase(pid);
+                             });
     }
 
     /**
@@ -576,26 +923,146 @@ private:
      */
     void remove_device_object(const std::string devpath)
     {
-        devices.erase(devpath);
+        auto dev = devices.find(devpath);
+        if (devices.end() != dev)
+        {
+            objmgr->ObjectRemoved(dev->second);
+            devices.erase(dev);
+        }
+        if (store.Remove(devpath))
+        {
+            write_store();
+        }
+    }
+
+
+    /**
+     *  Records the configuration of a device each time it changes
+     *
+     * @param device    NetCfgDevice to follow
+     * @param dev_path  std::string with the D-Bus path of the device
+     */
+    void watch_device_state(NetCfgDevice *device, const std::string& dev_path)
+    {
+        if (options.state_dir.empty())
+        {
+            return;
+        }
+        device->SetStateCallback([self = Ptr(this), dev_path](const NetCfg::DeviceRecord *rec)
+                                 {
+                                     if (rec)
+                                     {
+                                         self->store.Set(*rec);
+                                     }
+                                     else if (!self->store.Remove(dev_path))
+                                     {
+                                         return;
+                                     }
+                                     self->write_store();
+                                 });
+    }
+
+
+    /**
+     *  Writes the recorded devices to the state directory.  Devices
+     *  report changes from the worker threads, so the writes are
+     *  serialized to keep the latest one on disk.
+     */
+    void write_store()
+    {
+        std::lock_guard<std::mutex> guard(store_mtx);
+        if (store_file.empty())
+        {
+            return;
+        }
+        try
+        {
+            write_file_atomic(store_file, store.Serialize());
+        }
+        catch (const std::exception& excp)
+        {
+            signal.LogError("Could not update the device store: "
+                            + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Resolves the host name of a VPN server for a backend process.
+     *  Cached results are returned immediately; otherwise the name is
+     *  resolved in a separate thread, so a slow DNS server neither holds
+     *  back the main loop nor the device workers.  The invocation is
+     *  completed from that thread.
+     *
+     * @param invoc   GDBusMethodInvocation where the result is returned
+     * @param params  GVariant with the host name to resolve
+     */
+    void resolve_remote(GDBusMethodInvocation *invoc, GVariant *params)
+    {
+        if (!remote_cache)
+        {
+            throw NetCfgException("Remote resolver cache is disabled");
+        }
+
+        gchar *h = nullptr;
+        g_variant_get(params, "(s)", &h);
+        std::string host(h ? h : "");
+        g_free(h);
+        if (host.empty())
+        {
+            throw NetCfgException("Missing host name");
+        }
+
+        auto reply = [](GDBusMethodInvocation *invoc,
+                        const RemoteResolverCache::Result& res)
+                     {
+                         if (res.addresses.empty())
+                         {
+                             std::string errmsg = "Could not resolve remote: " + res.error;
+                             GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.resolve",
+                                                                           errmsg.c_str());
+                             g_dbus_method_invocation_return_gerror(invoc, err);
+                             g_error_free(err);
+                             return;
+                         }
+                         GVariant *addrs = GLibUtils::GVariantFromVector(res.addresses);
+                         g_dbus_method_invocation_return_value(invoc,
+                                                               g_variant_new_tuple(&addrs, 1));
+                     };
+
+        RemoteResolverCache::Result res;
+        if (remote_cache->Cached(host, res))
+        {
+            reply(invoc, res);
+            return;
+        }
+
+        signal.Debug("ResolveRemote('" + host + "')");
+        RemoteResolverCache::Ptr cache = remote_cache;
+        std::thread([cache, host, invoc, reply]()
+                    {
+                        reply(invoc, cache->Lookup(host));
+                    }).detach();
     }
 
 
     /**
      * Reads a unix fd from a connec and protects that socket from being
-     * routed over the VPN
+     * routed over the VPN.  The protection itself is done by the
+     * protect_strand, so adding host routes does not hold back the main
+     * loop; the invocation is completed from there.
      *
+     * @param sender       D-Bus bus name of the backend process
+     * @param creator_pid  PID of the backend process
      * @param conn   GDBusConnection pointer where the request came
      * @param invoc  GDBusMethodInvocation pointer containing the request.
      *               The file descriptor to be protected must come in the
      *               message inside this request.
-     *
-     * @return  Returns a GVariant object with the reply to the caller.
-     *          This will always be a boolean true value on success.  In case
-     *          of errors, a NetCfgException is thrown.
      */
-    GVariant* protect_socket(pid_t creator_pid, GDBusConnection *conn,
-                             GDBusMethodInvocation *invoc,
-                             GVariant *params)
+    void protect_socket(const std::string& sender,
+                        pid_t creator_pid, GDBusConnection *conn,
+                        GDBusMethodInvocation *invoc,
+                        GVariant *params)
     {
         // This should generally be true for DBus 1.3, double checking here cannot hurt
         g_assert(g_dbus_connection_get_capabilities(conn) & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING);
@@ -617,9 +1084,49 @@ private:
         if (it != devices.end())
         {
             const auto& dev = *it->second;
-            tunif = dev.get_device_name();
+            tunif = dev.GetDeviceName();
         }
 
+        protect_strand->Post([this, sender, creator_pid, invoc,
+                              remote, ipv6, tunif, fd]()
+                             {
+                                 try
+                                 {
+                                     protect_socket_run(sender, creator_pid, remote,
+                                                        ipv6, tunif, fd);
+                                     g_dbus_method_invocation_return_value(invoc,
+                                                                           g_variant_new("(b)", true));
+                                 }
+                                 catch (const std::exception& excp)
+                                 {
+                                     signal.LogCritical(excp.what());
+                                     std::string errmsg = "Failed executing D-Bus call 'ProtectSocket': "
+                                                          + std::string(excp.what());
+                                     GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.netcfg.error.generic",
+                                                                                   errmsg.c_str());
+                                     g_dbus_method_invocation_return_gerror(invoc, err);
+                                     g_error_free(err);
+                                 }
+                                 if (fd >= 0)
+                                 {
+                                     close(fd);
+                                 }
+                             });
+    }
+
+
+    /**
+     *  Protects a socket of a backend process, run by the protect_strand.
+     *  See protect_socket() for details.
+     *
+     *  A backend reconnecting to the same server through the same
+     *  interface keeps its host route instead of having it removed and
+     *  added again.
+     */
+    void protect_socket_run(const std::string& sender, pid_t creator_pid,
+                            const std::string& remote, bool ipv6,
+                            const std::string& tunif, int fd)
+    {
         signal.LogInfo(std::string("Socket protect called for socket ")
                            + std::to_string(fd)
                            + ", remote: '" + remote
@@ -642,13 +1149,66 @@ private:
             }
             openvpn::protect_socket_binddev(fd, remote, ipv6);
         }
-        if (options.redirect_method == RedirectMethod::HOST_ROUTE)
+        // With RedirectMethod::POLICY_ROUTE, the SO_MARK set above is
+        // all it takes; the policy routing rules are installed once by
+        // the service and are not touched here
+        if (options.redirect_method == RedirectMethod::HOST_ROUTE
+            && !host_route_in_place(creator_pid, remote, ipv6, tunif))
         {
+            // The bypass route is based on the current default route
+            NetCfgRoutingLock::Guard routing(workers->GetRoutingLock(), true);
             openvpn::cleanup_protected_sockets(creator_pid);
             openvpn::protect_socket_hostroute(tunif, remote, ipv6, creator_pid);
+
+            std::lock_guard<std::mutex> guard(egress_mtx);
+            egress_stale.erase(creator_pid);
+        }
+
+        // Remember the path to the server, to tell the backend when it
+        // changes.  With bind-device, the lookup of a reconnecting
+        // backend can only see its VPN device; that is recorded as no
+        // interface, which any default route change is a change of.
+        unsigned int egress = NetCfg::EgressMonitor::RouteInterface(remote, ipv6,
+                                                                    options.so_mark);
+        if (!tunif.empty() && egress == if_nametoindex(tunif.c_str()))
+        {
+            egress = 0;
+        }
+        {
+            std::lock_guard<std::mutex> guard(egress_mtx);
+            egress_watch[creator_pid] = {sender, remote, ipv6, tunif, egress};
         }
-        close(fd);
-        return g_variant_new("(b)", true);
+    }
+
+
+    /**
+     *  Checks if the host route added for the previous socket of a
+     *  backend still covers a new socket: the same server, the same VPN
+     *  device and the server still reached via the same interface,
+     *  with no network change seen on that path since.
+     *
+     * @return Returns true if the existing host route can be kept
+     */
+    bool host_route_in_place(pid_t creator_pid, const std::string& remote,
+                             bool ipv6, const std::string& tunif)
+    {
+        unsigned int ifindex = 0;
+        {
+            std::lock_guard<std::mutex> guard(egress_mtx);
+            auto w = egress_watch.find(creator_pid);
+            if (w == egress_watch.end()
+                || egress_stale.count(creator_pid) > 0
+                || w->second.remote != remote
+                || w->second.ipv6 != ipv6
+                || w->second.tunif != tunif)
+            {
+                return false;
+            }
+            ifindex = w->second.ifindex;
+        }
+        return 0 != ifindex
+            && ifindex == NetCfg::EgressMonitor::RouteInterface(remote, ipv6,
+                                                                options.so_mark);
     }
 };
 
@@ -710,15 +1270,22 @@ public:
         signal->SetLogLevel(default_log_level);
 
         // Create a new OpenVPN3 client session object
+        workers = std::make_shared<NetCfgWorkerPool>(options.worker_threads,
+                                                     [sig=signal](const std::string& err)
+                                                     {
+                                                         sig->LogCritical(err);
+                                                     });
         srv_obj.reset(new NetCfgServiceObject(GetConnection(),
                                               default_log_level,
                                               resolver,
-                                              logwr, options
+                                              logwr, options,
+                                              workers
                                               ));
         srv_obj->RegisterObject(GetConnection());
+        srv_obj->GetObjectManager().RegisterObject(GetConnection());
         if (!options.signal_broadcast)
         {
-            subscriptions.reset(new NetCfgSubscriptions);
+            subscriptions.reset(new NetCfgSubscriptions(options.notification_multicast));
             srv_obj->ConfigureSubscriptionManager(subscriptions);
         }
         else
@@ -733,6 +1300,24 @@ public:
         // Log which redirect method is in use
         signal->LogVerb1(options.str());
 
+        if (RedirectMethod::POLICY_ROUTE == options.redirect_method)
+        {
+            // Installed once for the lifetime of the service; removed
+            // again when the service object is destroyed
+            policy_rules.reset(new NetCfg::PolicyRules(options.so_mark,
+                                                       options.policy_table));
+        }
+
+        if (nullptr != idle_checker)
+        {
+            srv_obj->IdleCheck_Register(idle_checker);
+        }
+
+        // Devices established before this service was restarted get
+        // their DNS resolver settings applied together with the
+        // initial resolver update below
+        srv_obj->AdoptDevices(GetConnection());
+
         if (resolver)
         {
             signal->LogVerb2(resolver->GetBackendInfo());
@@ -741,11 +1326,6 @@ public:
             // current system settings and initialize the resolver backend
             resolver->ApplySettings(signal.get());
         }
-
-        if (nullptr != idle_checker)
-        {
-            srv_obj->IdleCheck_Register(idle_checker);
-        }
     }
 
 
@@ -764,6 +1344,17 @@ public:
     };
 
 
+    /**
+     *  Logs the start-up timeline of the network configuration service
+     *
+     * @param timeline  std::string with the StartupTiming summary
+     */
+    void callback_startup_complete(const std::string& timeline)
+    {
+        signal->LogInfo("Start-up completed: " + timeline);
+    }
+
+
     /**
      *  This is called each time the well-known bus name is removed from the
      *  D-Bus.  In our case, we just throw an exception and starts shutting
@@ -795,5 +1386,7 @@ private:
     NetCfgSignals::Ptr signal;
     NetCfgSubscriptions::Ptr subscriptions;
     NetCfgServiceObject::Ptr srv_obj;
+    NetCfgWorkerPool::Ptr workers;
+    NetCfg::PolicyRules::Ptr policy_rules;
     NetCfgOptions options;
 };
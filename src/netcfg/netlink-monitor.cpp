@@ -0,0 +1,290 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netlink-monitor.cpp
+ *
+ * @brief  Implementation of NetCfg::EgressMonitor
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "netcfg-exception.hpp"
+#include "netlink-monitor.hpp"
+
+
+using Clock = std::chrono::steady_clock;
+
+
+namespace NetCfg
+{
+    EgressMonitor::EgressMonitor(Callback callback,
+                                 std::chrono::milliseconds settle)
+        : callback(std::move(callback)),
+          settle(settle)
+    {
+        sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                      NETLINK_ROUTE);
+        if (sock < 0)
+        {
+            throw NetCfgException(std::string("Could not open rtnetlink socket: ")
+                                  + strerror(errno));
+        }
+
+        struct sockaddr_nl local = {};
+        local.nl_family = AF_NETLINK;
+        local.nl_groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE
+                          | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+        if (0 != bind(sock, reinterpret_cast<struct sockaddr *>(&local),
+                      sizeof(local))
+            || 0 != pipe2(wakeup, O_CLOEXEC))
+        {
+            std::string err(strerror(errno));
+            close(sock);
+            throw NetCfgException("Could not set up the rtnetlink monitor: " + err);
+        }
+
+        monitor = std::thread([this]()
+                              {
+                                  run();
+                              });
+    }
+
+
+    EgressMonitor::~EgressMonitor()
+    {
+        running = false;
+        // If this fails, the thread notices within its poll timeout
+        ssize_t ret = write(wakeup[1], "x", 1);
+        (void) ret;
+        monitor.join();
+        close(wakeup[0]);
+        close(wakeup[1]);
+        close(sock);
+    }
+
+
+    unsigned int EgressMonitor::RouteInterface(const std::string& remote,
+                                               bool ipv6, int mark)
+    {
+        struct
+        {
+            struct nlmsghdr nh;
+            struct rtmsg rtm;
+            char attrs[RTA_SPACE(16) + RTA_SPACE(4)];
+        } req = {};
+
+        size_t addrlen = (ipv6 ? 16 : 4);
+        unsigned char dst[16];
+        if (1 != inet_pton((ipv6 ? AF_INET6 : AF_INET), remote.c_str(), dst))
+        {
+            return 0;
+        }
+
+        req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+        req.nh.nlmsg_type = RTM_GETROUTE;
+        req.nh.nlmsg_flags = NLM_F_REQUEST;
+        req.nh.nlmsg_seq = 1;
+        req.rtm.rtm_family = (ipv6 ? AF_INET6 : AF_INET);
+        req.rtm.rtm_dst_len = addrlen * 8;
+
+        struct rtattr *rta = reinterpret_cast<struct rtattr *>(
+            reinterpret_cast<char *>(&req) + NLMSG_ALIGN(req.nh.nlmsg_len));
+        rta->rta_type = RTA_DST;
+        rta->rta_len = RTA_LENGTH(addrlen);
+        memcpy(RTA_DATA(rta), dst, addrlen);
+        req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) + RTA_SPACE(addrlen);
+        if (mark >= 0)
+        {
+            rta = reinterpret_cast<struct rtattr *>(
+                reinterpret_cast<char *>(&req) + req.nh.nlmsg_len);
+            rta->rta_type = RTA_MARK;
+            rta->rta_len = RTA_LENGTH(sizeof(uint32_t));
+            uint32_t m = mark;
+            memcpy(RTA_DATA(rta), &m, sizeof(m));
+            req.nh.nlmsg_len += RTA_SPACE(sizeof(uint32_t));
+        }
+
+        int qsock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (qsock < 0)
+        {
+            return 0;
+        }
+        struct timeval tv = {1, 0};
+        setsockopt(qsock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        unsigned int ifindex = 0;
+        std::vector<char> buf(8192);
+        ssize_t len = -1;
+        if (send(qsock, &req, req.nh.nlmsg_len, 0) == (ssize_t) req.nh.nlmsg_len)
+        {
+            do
+            {
+                len = recv(qsock, buf.data(), buf.size(), 0);
+            } while (len < 0 && EINTR == errno);
+        }
+        close(qsock);
+
+        int remain = len;
+        for (struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+             len > 0 && NLMSG_OK(nh, remain);
+             nh = NLMSG_NEXT(nh, remain))
+        {
+            if (RTM_NEWROUTE != nh->nlmsg_type)
+            {
+                continue;
+            }
+            struct rtmsg *rtm = static_cast<struct rtmsg *>(NLMSG_DATA(nh));
+            int attrlen = RTM_PAYLOAD(nh);
+            for (struct rtattr *a = RTM_RTA(rtm); RTA_OK(a, attrlen);
+                 a = RTA_NEXT(a, attrlen))
+            {
+                if (RTA_OIF == a->rta_type)
+                {
+                    ifindex = *static_cast<uint32_t *>(RTA_DATA(a));
+                }
+            }
+        }
+        return ifindex;
+    }
+
+
+    void EgressMonitor::run()
+    {
+        std::vector<char> buf(65536);
+        std::set<unsigned int> ifindexes;
+        bool default_route = false;
+        bool pending = false;
+        Clock::time_point deadline;
+
+        while (running)
+        {
+            int timeout = 1000;
+            if (pending)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                deadline - Clock::now()).count();
+                timeout = (left > 0 ? (int) left : 0);
+            }
+
+            struct pollfd pfd[2] = {{sock, POLLIN, 0}, {wakeup[0], POLLIN, 0}};
+            int r = poll(pfd, 2, timeout);
+            if (r < 0 && EINTR != errno)
+            {
+                break;
+            }
+
+            if (r > 0 && (pfd[0].revents & POLLIN))
+            {
+                ssize_t len;
+                while ((len = recv(sock, buf.data(), buf.size(), 0)) > 0)
+                {
+                    bool was_pending = !ifindexes.empty() || default_route;
+                    parse(buf.data(), len, ifindexes, default_route);
+                    if (!was_pending && (!ifindexes.empty() || default_route))
+                    {
+                        // The settle time starts with the first change
+                        pending = true;
+                        deadline = Clock::now() + settle;
+                    }
+                }
+                if (len < 0 && ENOBUFS == errno)
+                {
+                    // Notifications were lost; assume the worst
+                    default_route = true;
+                    if (!pending)
+                    {
+                        pending = true;
+                        deadline = Clock::now() + settle;
+                    }
+                }
+            }
+
+            if (pending && Clock::now() >= deadline)
+            {
+                std::set<unsigned int> changed;
+                changed.swap(ifindexes);
+                bool defrt = default_route;
+                default_route = false;
+                pending = false;
+                if (running)
+                {
+                    callback(changed, defrt);
+                }
+            }
+        }
+    }
+
+
+    void EgressMonitor::parse(const char *buf, size_t len,
+                              std::set<unsigned int>& ifindexes,
+                              bool& default_route)
+    {
+        int remain = len;
+        for (const struct nlmsghdr *nh = reinterpret_cast<const struct nlmsghdr *>(buf);
+             NLMSG_OK(nh, remain);
+             nh = NLMSG_NEXT(nh, remain))
+        {
+            switch (nh->nlmsg_type)
+            {
+            case RTM_NEWROUTE:
+            case RTM_DELROUTE:
+                {
+                    const struct rtmsg *rtm = static_cast<const struct rtmsg *>(NLMSG_DATA(nh));
+                    // Only default routes in the main table matter; the
+                    // routes via the VPN never replace the default route
+                    // in the main table
+                    if (0 == rtm->rtm_dst_len && RT_TABLE_MAIN == rtm->rtm_table
+                        && RTN_UNICAST == rtm->rtm_type)
+                    {
+                        default_route = true;
+                    }
+                }
+                break;
+
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                {
+                    const struct ifaddrmsg *ifa = static_cast<const struct ifaddrmsg *>(NLMSG_DATA(nh));
+                    // IPv6 link-local addresses come and go with the
+                    // link itself and do not change the path to a server
+                    if (RT_SCOPE_LINK != ifa->ifa_scope)
+                    {
+                        ifindexes.insert(ifa->ifa_index);
+                    }
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+} // namespace NetCfg
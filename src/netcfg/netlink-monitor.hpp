@@ -0,0 +1,110 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netlink-monitor.hpp
+ *
+ * @brief  Watches the default routes and interface addresses of the
+ *         host through rtnetlink, to detect changes of the path used
+ *         to reach the VPN servers
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+
+
+namespace NetCfg
+{
+    /**
+     *  Listens for rtnetlink notifications about default routes in the
+     *  main routing table and about interface addresses.  Bursts of
+     *  notifications, like those of a Wi-Fi roam or a DHCP renewal, are
+     *  collected for a short settle time before being reported in a
+     *  single callback.
+     *
+     *  The notifications are read by a separate thread, which is also
+     *  the thread running the callback.
+     */
+    class EgressMonitor
+    {
+    public:
+        using Ptr = std::unique_ptr<EgressMonitor>;
+
+        /**
+         *  Called after network changes have settled
+         *
+         * @param ifindexes      Indexes of the interfaces where addresses
+         *                       were added or removed
+         * @param default_route  Did a default route change
+         */
+        using Callback = std::function<void(const std::set<unsigned int>& ifindexes,
+                                            bool default_route)>;
+
+        /**
+         *  Opens the rtnetlink socket and starts the monitoring thread.
+         *  Throws NetCfgException on errors.
+         *
+         * @param callback  Callback to report changes to
+         * @param settle    How long to wait for more notifications before
+         *                  reporting them
+         */
+        EgressMonitor(Callback callback,
+                      std::chrono::milliseconds settle = std::chrono::milliseconds(250));
+        ~EgressMonitor();
+
+        EgressMonitor(const EgressMonitor&) = delete;
+        EgressMonitor& operator=(const EgressMonitor&) = delete;
+
+
+        /**
+         *  Looks up which interface the kernel would use to send packets
+         *  to a remote host
+         *
+         * @param remote  std::string with the IP address of the remote
+         * @param ipv6    Is the remote an IPv6 address
+         * @param mark    Firewall mark of the packets, -1 for none
+         *
+         * @return Returns the interface index, or 0 if the remote is not
+         *         reachable or the lookup failed
+         */
+        static unsigned int RouteInterface(const std::string& remote,
+                                           bool ipv6, int mark);
+
+
+    private:
+        Callback callback;
+        const std::chrono::milliseconds settle;
+        int sock = -1;
+        int wakeup[2] = {-1, -1};
+        std::atomic<bool> running{true};
+        std::thread monitor;
+
+        void run();
+        void parse(const char *buf, size_t len,
+                   std::set<unsigned int>& ifindexes, bool& default_route);
+    };
+} // namespace NetCfg
@@ -0,0 +1,613 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netlink-routes.cpp
+ *
+ * @brief  Implementation of NetCfg::NetlinkRoutes
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <linux/fib_rules.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "netcfg-exception.hpp"
+#include "netlink-routes.hpp"
+
+
+/**
+ *  Maximum size of a single batch of netlink requests.  The
+ *  acknowledgements for a full batch must fit into the socket receive
+ *  buffer.
+ */
+static const size_t max_batch_size = 32768;
+
+/**
+ *  Upper bound of the size of a single route request
+ */
+static const size_t max_request_size = NLMSG_SPACE(sizeof(struct rtmsg))
+                                       + 2 * RTA_SPACE(16) + 2 * RTA_SPACE(4)
+                                       + RTA_SPACE(NetCfg::RouteBundles::MaxMembers
+                                                   * (RTNH_ALIGN(sizeof(struct rtnexthop))
+                                                      + RTA_SPACE(16)));
+
+/**
+ *  Next hops of the routes of all device bundles in this process.  The
+ *  lock is held while route requests of bundled devices are prepared
+ *  and sent, so the kernel sees the changes in the same order.
+ */
+static std::mutex bundle_mtx;
+static NetCfg::RouteBundles bundles;
+
+
+static void append_attr(std::vector<char>& buf, const unsigned short type,
+                        const void *data, const size_t len)
+{
+    size_t start = buf.size();
+    buf.resize(start + RTA_SPACE(len));
+    struct rtattr *rta = reinterpret_cast<struct rtattr *>(&buf[start]);
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+}
+
+
+/**
+ *  Opens and binds a rtnetlink socket
+ *
+ * @return Returns the socket.  Throws NetCfgException on errors.
+ */
+static int open_rtnetlink()
+{
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock < 0)
+    {
+        throw NetCfgException(std::string("Could not open rtnetlink socket: ")
+                              + strerror(errno));
+    }
+
+    struct sockaddr_nl local = {};
+    local.nl_family = AF_NETLINK;
+    if (0 != bind(sock, reinterpret_cast<struct sockaddr *>(&local),
+                  sizeof(local)))
+    {
+        std::string err(strerror(errno));
+        close(sock);
+        throw NetCfgException("Could not bind rtnetlink socket: " + err);
+    }
+    return sock;
+}
+
+
+
+namespace NetCfg
+{
+    NetlinkRoutes::NetlinkRoutes(const uint32_t table,
+                                 const std::string& bundle)
+        : table(0 == table ? RT_TABLE_MAIN : table),
+          bundle(bundle)
+    {
+        sock = open_rtnetlink();
+
+        // Best effort tuning; the batch size is small enough to work
+        // with the default buffer sizes as well
+        int bufsize = 1024 * 1024;
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+#ifdef NETLINK_CAP_ACK
+        // Don't echo the complete request in each acknowledgement
+        int cap_ack = 1;
+        setsockopt(sock, SOL_NETLINK, NETLINK_CAP_ACK, &cap_ack, sizeof(cap_ack));
+#endif
+        struct timeval tv = {5, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+
+    NetlinkRoutes::~NetlinkRoutes()
+    {
+        if (sock >= 0)
+        {
+            close(sock);
+        }
+    }
+
+
+    void NetlinkRoutes::AddRoute(const std::string& address,
+                                 const unsigned int prefix,
+                                 const bool ipv6,
+                                 const std::string& gateway)
+    {
+        Route rt = {};
+        rt.address = address;
+        rt.prefix = prefix;
+        rt.ipv6 = ipv6;
+        rt.gateway = gateway;
+
+        int af = (ipv6 ? AF_INET6 : AF_INET);
+        unsigned int addrbits = (ipv6 ? 128 : 32);
+        if (prefix > addrbits || 1 != inet_pton(af, address.c_str(), rt.dst))
+        {
+            throw NetCfgException("Invalid route: " + address + "/"
+                                  + std::to_string(prefix));
+        }
+        if (!gateway.empty() && 1 != inet_pton(af, gateway.c_str(), rt.gw))
+        {
+            throw NetCfgException("Invalid route gateway: " + gateway);
+        }
+
+        // The kernel refuses routes with host bits set
+        for (unsigned int bit = prefix; bit < addrbits; bit++)
+        {
+            rt.dst[bit / 8] &= ~(0x80 >> (bit % 8));
+        }
+        queued.push_back(rt);
+    }
+
+
+    void NetlinkRoutes::DeleteRoute(const std::string& address,
+                                    const unsigned int prefix,
+                                    const bool ipv6)
+    {
+        for (auto it = routes.begin(); it != routes.end(); ++it)
+        {
+            if (it->address == address && it->prefix == prefix
+                && it->ipv6 == ipv6)
+            {
+                deleted.push_back(*it);
+                routes.erase(it);
+                return;
+            }
+        }
+    }
+
+
+    std::vector<std::string> NetlinkRoutes::Install(const std::string& device)
+    {
+        ifindex = if_nametoindex(device.c_str());
+        if (0 == ifindex)
+        {
+            throw NetCfgException("Could not look up network device "
+                                  + device + ": " + strerror(errno));
+        }
+
+        std::vector<std::string> errors;
+        if (!deleted.empty())
+        {
+            errors = process(deleted, false);
+            deleted.clear();
+        }
+        if (!queued.empty())
+        {
+            std::vector<std::string> inst_errors = process(queued, true);
+            errors.insert(errors.end(), inst_errors.begin(), inst_errors.end());
+            routes.insert(routes.end(), queued.begin(), queued.end());
+            queued.clear();
+        }
+        return errors;
+    }
+
+
+    std::vector<std::string> NetlinkRoutes::Remove()
+    {
+        if (0 == ifindex)
+        {
+            return {};
+        }
+        std::vector<std::string> errors = process(routes, false);
+        routes.clear();
+        return errors;
+    }
+
+
+    std::vector<std::string> NetlinkRoutes::process(const std::vector<Route>& list,
+                                                    const bool install)
+    {
+        std::vector<std::string> errors;
+        std::vector<char> buf;
+        buf.reserve(max_batch_size);
+
+        std::unique_lock<std::mutex> bundle_lock(bundle_mtx, std::defer_lock);
+        if (!bundle.empty())
+        {
+            bundle_lock.lock();
+        }
+
+        // Each route gets its own sequence number, in the order of the
+        // list, so acknowledgements can be mapped to routes
+        process_seq = seq + 1;
+        uint32_t first_seq = process_seq;
+        for (const auto& rt : list)
+        {
+            if (buf.size() + max_request_size > max_batch_size)
+            {
+                send_batch(buf);
+                collect_acks(list, first_seq, seq, install, errors);
+                buf.clear();
+                first_seq = seq + 1;
+            }
+            if (bundle.empty())
+            {
+                add_request(buf, rt, install, ++seq, nullptr);
+                continue;
+            }
+
+            // The route is replaced with the next hops of all devices
+            // of the bundle routing it; only removing the last one
+            // deletes it
+            std::string key = bundle_key(rt);
+            if (!install)
+            {
+                bundles.Leave(key, ifindex);
+            }
+            else if (!bundles.Join(key, ifindex, rt.gateway))
+            {
+                errors.push_back("Route " + rt.address + "/"
+                                 + std::to_string(rt.prefix)
+                                 + " is already shared by the maximum number"
+                                 + " of bundled devices");
+            }
+            std::vector<RouteBundles::Nexthop> nexthops = bundles.Nexthops(key);
+            add_request(buf, rt, install, ++seq, &nexthops);
+        }
+        if (!buf.empty())
+        {
+            send_batch(buf);
+            collect_acks(list, first_seq, seq, install, errors);
+        }
+        return errors;
+    }
+
+
+    void NetlinkRoutes::add_request(std::vector<char>& buf, const Route& rt,
+                                    const bool install, const uint32_t reqseq,
+                                    const std::vector<RouteBundles::Nexthop> *nexthops)
+    {
+        // A bundled route still routed by other devices is replaced
+        // instead of removed
+        bool replace = (install || (nexthops && !nexthops->empty()));
+        bool has_gateway = !rt.gateway.empty();
+        if (nexthops)
+        {
+            has_gateway = false;
+            for (const auto& nhop : *nexthops)
+            {
+                has_gateway |= !nhop.gateway.empty();
+            }
+        }
+
+        size_t start = buf.size();
+        buf.resize(start + NLMSG_SPACE(sizeof(struct rtmsg)));
+
+        struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(&buf[start]);
+        nh->nlmsg_type = (replace ? RTM_NEWROUTE : RTM_DELROUTE);
+        nh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+        if (replace)
+        {
+            nh->nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+        }
+        nh->nlmsg_seq = reqseq;
+
+        struct rtmsg *rtm = static_cast<struct rtmsg *>(NLMSG_DATA(nh));
+        rtm->rtm_family = (rt.ipv6 ? AF_INET6 : AF_INET);
+        rtm->rtm_dst_len = rt.prefix;
+        rtm->rtm_table = (table < 256 ? table : RT_TABLE_UNSPEC);
+        rtm->rtm_protocol = RTPROT_BOOT;
+        rtm->rtm_type = RTN_UNICAST;
+        if (!replace)
+        {
+            rtm->rtm_scope = RT_SCOPE_NOWHERE;
+        }
+        else
+        {
+            rtm->rtm_scope = (has_gateway ? RT_SCOPE_UNIVERSE
+                                          : RT_SCOPE_LINK);
+        }
+
+        // Appending attributes may move the buffer, the headers
+        // must not be touched through the pointers above after this
+        int af = (rt.ipv6 ? AF_INET6 : AF_INET);
+        size_t addrlen = (rt.ipv6 ? 16 : 4);
+        append_attr(buf, RTA_DST, rt.dst, addrlen);
+        if (!replace || !nexthops)
+        {
+            if (!rt.gateway.empty())
+            {
+                append_attr(buf, RTA_GATEWAY, rt.gw, addrlen);
+            }
+            uint32_t oif = ifindex;
+            append_attr(buf, RTA_OIF, &oif, sizeof(oif));
+        }
+        else if (1 == nexthops->size())
+        {
+            const RouteBundles::Nexthop& nhop = nexthops->front();
+            uint8_t gw[16] = {};
+            if (!nhop.gateway.empty()
+                && 1 == inet_pton(af, nhop.gateway.c_str(), gw))
+            {
+                append_attr(buf, RTA_GATEWAY, gw, addrlen);
+            }
+            uint32_t oif = nhop.ifindex;
+            append_attr(buf, RTA_OIF, &oif, sizeof(oif));
+        }
+        else
+        {
+            std::vector<char> mp;
+            for (const auto& nhop : *nexthops)
+            {
+                size_t nh_start = mp.size();
+                mp.resize(nh_start + RTNH_ALIGN(sizeof(struct rtnexthop)));
+                uint8_t gw[16] = {};
+                if (!nhop.gateway.empty()
+                    && 1 == inet_pton(af, nhop.gateway.c_str(), gw))
+                {
+                    append_attr(mp, RTA_GATEWAY, gw, addrlen);
+                }
+                struct rtnexthop *rtnh = reinterpret_cast<struct rtnexthop *>(&mp[nh_start]);
+                rtnh->rtnh_len = mp.size() - nh_start;
+                rtnh->rtnh_ifindex = nhop.ifindex;
+            }
+            append_attr(buf, RTA_MULTIPATH, mp.data(), mp.size());
+        }
+        append_attr(buf, RTA_TABLE, &table, sizeof(table));
+
+        nh = reinterpret_cast<struct nlmsghdr *>(&buf[start]);
+        nh->nlmsg_len = buf.size() - start;
+    }
+
+
+    /**
+     *  Identifies a route shared by the devices of the bundle
+     */
+    std::string NetlinkRoutes::bundle_key(const Route& rt) const
+    {
+        char dst[INET6_ADDRSTRLEN] = {};
+        inet_ntop(rt.ipv6 ? AF_INET6 : AF_INET, rt.dst, dst, sizeof(dst));
+        return bundle + "|" + std::to_string(table) + "|"
+               + dst + "/" + std::to_string(rt.prefix);
+    }
+
+
+    void NetlinkRoutes::send_batch(const std::vector<char>& buf)
+    {
+        struct sockaddr_nl kernel = {};
+        kernel.nl_family = AF_NETLINK;
+
+        ssize_t ret = -1;
+        do
+        {
+            ret = sendto(sock, buf.data(), buf.size(), 0,
+                         reinterpret_cast<struct sockaddr *>(&kernel),
+                         sizeof(kernel));
+        } while (ret < 0 && EINTR == errno);
+
+        if (ret < 0 || (size_t) ret != buf.size())
+        {
+            throw NetCfgException(std::string("Sending rtnetlink requests failed: ")
+                                  + (ret < 0 ? strerror(errno) : "short write"));
+        }
+    }
+
+
+    void NetlinkRoutes::collect_acks(const std::vector<Route>& list,
+                                     const uint32_t first_seq,
+                                     const uint32_t last_seq,
+                                     const bool install,
+                                     std::vector<std::string>& errors)
+    {
+        std::vector<char> buf(65536);
+        size_t pending = last_seq - first_seq + 1;
+
+        while (pending > 0)
+        {
+            ssize_t len = recv(sock, buf.data(), buf.size(), 0);
+            if (len < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                throw NetCfgException(std::string("Receiving rtnetlink "
+                                                  "acknowledgements failed: ")
+                                      + strerror(errno));
+            }
+
+            int remain = len;
+            for (struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+                 NLMSG_OK(nh, remain);
+                 nh = NLMSG_NEXT(nh, remain))
+            {
+                if (NLMSG_ERROR != nh->nlmsg_type
+                    || nh->nlmsg_seq < first_seq || nh->nlmsg_seq > last_seq)
+                {
+                    continue;
+                }
+                --pending;
+
+                const struct nlmsgerr *err = static_cast<struct nlmsgerr *>(NLMSG_DATA(nh));
+                int error = -err->error;
+                if (0 == error
+                    || (!install && (ESRCH == error || ENODEV == error)))
+                {
+                    continue;
+                }
+
+                const Route& rt = list[nh->nlmsg_seq - process_seq];
+                errors.push_back(std::string(install ? "Adding" : "Removing")
+                                 + " route " + rt.address + "/"
+                                 + std::to_string(rt.prefix) + " failed: "
+                                 + strerror(error));
+            }
+        }
+    }
+
+
+
+    PolicyRules::PolicyRules(const uint32_t mark, const uint32_t table,
+                             const uint32_t priority)
+        : mark(mark), table(table), priority(priority)
+    {
+        sock = open_rtnetlink();
+        struct timeval tv = {5, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        try
+        {
+            remove_all();
+            for (int family : {AF_INET, AF_INET6})
+            {
+                for (bool bypass : {false, true})
+                {
+                    int error = request(family, true, bypass);
+                    if (0 != error)
+                    {
+                        throw NetCfgException(std::string("Adding ")
+                                              + (AF_INET6 == family ? "IPv6" : "IPv4")
+                                              + " policy routing rule failed: "
+                                              + strerror(error));
+                    }
+                }
+            }
+        }
+        catch (...)
+        {
+            remove_all();
+            close(sock);
+            throw;
+        }
+    }
+
+
+    PolicyRules::~PolicyRules()
+    {
+        remove_all();
+        close(sock);
+    }
+
+
+    void PolicyRules::remove_all()
+    {
+        // Deleting removes the first rule matching the request; repeat
+        // until none is left, in case of duplicates from earlier runs
+        for (int family : {AF_INET, AF_INET6})
+        {
+            for (bool bypass : {false, true})
+            {
+                int attempts = 16;
+                while (attempts-- > 0 && 0 == request(family, false, bypass))
+                {
+                    continue;
+                }
+            }
+        }
+    }
+
+
+    int PolicyRules::request(const int family, const bool add,
+                             const bool bypass)
+    {
+        std::vector<char> buf(NLMSG_SPACE(sizeof(struct fib_rule_hdr)));
+        struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+        nh->nlmsg_type = (add ? RTM_NEWRULE : RTM_DELRULE);
+        nh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+        if (add)
+        {
+            nh->nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+        }
+        nh->nlmsg_seq = ++seq;
+
+        struct fib_rule_hdr *frh = static_cast<struct fib_rule_hdr *>(NLMSG_DATA(nh));
+        frh->family = family;
+        frh->action = FR_ACT_TO_TBL;
+        frh->flags = (bypass ? FIB_RULE_INVERT : 0);
+
+        uint32_t prio = priority;
+        if (!bypass)
+        {
+            // lookup main suppress_prefixlength 0
+            frh->table = RT_TABLE_MAIN;
+            append_attr(buf, FRA_PRIORITY, &prio, sizeof(prio));
+            uint32_t main_table = RT_TABLE_MAIN;
+            append_attr(buf, FRA_TABLE, &main_table, sizeof(main_table));
+            uint32_t suppress = 0;
+            append_attr(buf, FRA_SUPPRESS_PREFIXLEN, &suppress, sizeof(suppress));
+        }
+        else
+        {
+            // not fwmark MARK lookup TABLE
+            ++prio;
+            frh->table = (table < 256 ? table : RT_TABLE_UNSPEC);
+            append_attr(buf, FRA_PRIORITY, &prio, sizeof(prio));
+            append_attr(buf, FRA_TABLE, &table, sizeof(table));
+            append_attr(buf, FRA_FWMARK, &mark, sizeof(mark));
+            uint32_t mask = 0xffffffff;
+            append_attr(buf, FRA_FWMASK, &mask, sizeof(mask));
+        }
+        nh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+        nh->nlmsg_len = buf.size();
+
+        struct sockaddr_nl kernel = {};
+        kernel.nl_family = AF_NETLINK;
+        ssize_t ret = -1;
+        do
+        {
+            ret = sendto(sock, buf.data(), buf.size(), 0,
+                         reinterpret_cast<struct sockaddr *>(&kernel),
+                         sizeof(kernel));
+        } while (ret < 0 && EINTR == errno);
+        if (ret < 0)
+        {
+            return errno;
+        }
+
+        std::vector<char> ack(4096);
+        while (true)
+        {
+            ssize_t len = recv(sock, ack.data(), ack.size(), 0);
+            if (len < 0)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                return errno;
+            }
+            int remain = len;
+            for (struct nlmsghdr *rh = reinterpret_cast<struct nlmsghdr *>(ack.data());
+                 NLMSG_OK(rh, remain);
+                 rh = NLMSG_NEXT(rh, remain))
+            {
+                if (NLMSG_ERROR == rh->nlmsg_type && seq == rh->nlmsg_seq)
+                {
+                    return -static_cast<struct nlmsgerr *>(NLMSG_DATA(rh))->error;
+                }
+            }
+        }
+    }
+} // namespace NetCfg
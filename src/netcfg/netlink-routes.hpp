@@ -0,0 +1,219 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netlink-routes.hpp
+ *
+ * @brief  Batched route programming over a persistent rtnetlink socket
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "netcfg-routebundle.hpp"
+
+
+namespace NetCfg
+{
+    /**
+     *  Installs and removes a set of routes through a single virtual
+     *  network device.
+     *
+     *  Instead of one netlink socket and one round trip per route, all
+     *  route requests are packed into large batches sent over one
+     *  persistent rtnetlink socket.  The kernel acknowledges each
+     *  request; the acknowledgements of a batch are collected before
+     *  the next batch is sent.
+     *
+     *  Devices belonging to the same bundle share their routes.  A
+     *  network routed by several devices of a bundle is installed as a
+     *  multipath route with one next hop per device, so the kernel
+     *  spreads the flows across the devices.  When a device removes its
+     *  routes, the remaining devices keep routing the network.
+     */
+    class NetlinkRoutes
+    {
+    public:
+        using Ptr = std::unique_ptr<NetlinkRoutes>;
+
+        /**
+         *  Opens the rtnetlink socket.  Throws NetCfgException on errors.
+         *
+         * @param table   Routing table to install the routes in.  The
+         *                default, 0, uses the main routing table.
+         * @param bundle  std::string with the name of the bundle of the
+         *                device.  Empty if the device is not part of a
+         *                bundle.
+         */
+        NetlinkRoutes(const uint32_t table = 0,
+                      const std::string& bundle = "");
+        ~NetlinkRoutes();
+
+        NetlinkRoutes(const NetlinkRoutes&) = delete;
+        NetlinkRoutes& operator=(const NetlinkRoutes&) = delete;
+
+
+        /**
+         *  Queue a route to be installed by Install()
+         *
+         * @param address  std::string with the network address
+         * @param prefix   Prefix length of the network
+         * @param ipv6     Is this an IPv6 network
+         * @param gateway  std::string with the gateway inside the VPN.
+         *                 If empty, the route only points at the device.
+         */
+        void AddRoute(const std::string& address, const unsigned int prefix,
+                      const bool ipv6, const std::string& gateway);
+
+
+        /**
+         *  Queue an installed route to be removed by the next Install()
+         *  call.  Routes not installed through this object are ignored.
+         *
+         * @param address  std::string with the network address
+         * @param prefix   Prefix length of the network
+         * @param ipv6     Is this an IPv6 network
+         */
+        void DeleteRoute(const std::string& address, const unsigned int prefix,
+                         const bool ipv6);
+
+
+        /**
+         *  Removes the routes queued by DeleteRoute() and installs the
+         *  routes queued by AddRoute() through the given device.  This
+         *  can be called again later on to apply further changes
+         *  without touching the routes which are already installed.
+         *
+         * @param device  std::string with the name of the network device
+         *
+         * @return Returns a std::vector with a description of each route
+         *         which could not be changed.  Empty on success.
+         */
+        std::vector<std::string> Install(const std::string& device);
+
+
+        /**
+         *  Removes all routes installed by Install().  Routes already gone,
+         *  typically because the device was removed, are not reported as
+         *  errors.
+         *
+         * @return Returns a std::vector with a description of each route
+         *         which could not be removed.
+         */
+        std::vector<std::string> Remove();
+
+
+        /**
+         * @return Returns the number of installed and queued routes
+         */
+        size_t size() const noexcept
+        {
+            return routes.size() + queued.size();
+        }
+
+
+    private:
+        struct Route
+        {
+            std::string address;
+            unsigned int prefix;
+            bool ipv6;
+            std::string gateway;
+            uint8_t dst[16];
+            uint8_t gw[16];
+        };
+
+        int sock = -1;
+        const uint32_t table;
+        const std::string bundle;
+        uint32_t seq = 0;
+        uint32_t process_seq = 0;
+        unsigned int ifindex = 0;
+        std::vector<Route> routes;    ///< Installed routes
+        std::vector<Route> queued;    ///< Routes waiting to be installed
+        std::vector<Route> deleted;   ///< Routes waiting to be removed
+
+        std::vector<std::string> process(const std::vector<Route>& list,
+                                         const bool install);
+        void add_request(std::vector<char>& buf, const Route& rt,
+                         const bool install, const uint32_t reqseq,
+                         const std::vector<RouteBundles::Nexthop> *nexthops);
+        std::string bundle_key(const Route& rt) const;
+        void send_batch(const std::vector<char>& buf);
+        void collect_acks(const std::vector<Route>& list,
+                          const uint32_t first_seq, const uint32_t last_seq,
+                          const bool install, std::vector<std::string>& errors);
+    };
+
+
+
+    /**
+     *  Policy routing rules sending all traffic, except packets carrying
+     *  a specific firewall mark, through a separate routing table holding
+     *  the VPN routes.
+     *
+     *  The rules are installed once for IPv4 and IPv6 and removed again
+     *  when the object is destroyed:
+     *
+     *    pref N:    lookup main suppress_prefixlength 0
+     *    pref N+1:  not fwmark MARK lookup TABLE
+     *
+     *  The first rule keeps more specific routes of the main table, like
+     *  the local networks, preferred over the VPN routes; only the default
+     *  route of the main table is skipped.  Sockets carrying the mark
+     *  never see the VPN routes, so protecting the socket to the VPN
+     *  server only requires setting SO_MARK on it and does not change any
+     *  routing table.
+     */
+    class PolicyRules
+    {
+    public:
+        using Ptr = std::unique_ptr<PolicyRules>;
+
+        /**
+         *  Installs the rules.  Stale rules with the same priorities, left
+         *  behind by an earlier run, are replaced.  Throws NetCfgException
+         *  on errors.
+         *
+         * @param mark      Firewall mark of the sockets bypassing the VPN
+         * @param table     Routing table with the VPN routes
+         * @param priority  Priority of the first rule
+         */
+        PolicyRules(const uint32_t mark, const uint32_t table,
+                    const uint32_t priority = 32000);
+        ~PolicyRules();
+
+        PolicyRules(const PolicyRules&) = delete;
+        PolicyRules& operator=(const PolicyRules&) = delete;
+
+
+    private:
+        int sock = -1;
+        uint32_t seq = 0;
+        const uint32_t mark;
+        const uint32_t table;
+        const uint32_t priority;
+
+        int request(const int family, const bool add, const bool bypass);
+        void remove_all();
+    };
+} // namespace NetCfg
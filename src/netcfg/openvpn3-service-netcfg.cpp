@@ -32,6 +32,7 @@
 #include "common/utils.hpp"
 #include "common/lookup.hpp"
 #include "common/cmdargparser.hpp"
+#include "common/startup-timing.hpp"
 #include "dbus/core.hpp"
 #include "log/dbus-log.hpp"
 #include "log/logwriter.hpp"
@@ -44,6 +45,7 @@
 #include "netcfg-options.hpp"
 #include "netcfg/dns/settings-manager.hpp"
 #include "netcfg/dns/resolvconf-file.hpp"
+#include "netcfg/dns/lazy-resolver-backend.hpp"
 #include "netcfg/dns/systemd-resolved.hpp"
 
 using namespace NetCfg;
@@ -96,6 +98,13 @@ static void apply_capabilities(ParsedArgs::Ptr args,
                          CAP_DAC_OVERRIDE);
         }
 
+        // The DNS stub resolver listens on port 53
+        if (!opts.resolv_conf_stub.empty())
+        {
+            capng_update(CAPNG_ADD, (capng_type_t) (CAPNG_EFFECTIVE|CAPNG_PERMITTED),
+                         CAP_NET_BIND_SERVICE);
+        }
+
         if (RedirectMethod::BINDTODEV ==  opts.redirect_method)
         {
             // We need this to be able to call setsockopt with SO_BINDTODEVICE
@@ -103,6 +112,32 @@ static void apply_capabilities(ParsedArgs::Ptr args,
                          CAP_NET_RAW);
 
         }
+
+        // Loading the traffic accounting BPF programs
+        if (opts.traffic_accounting)
+        {
+#ifdef CAP_BPF
+            capng_update(CAPNG_ADD, (capng_type_t) (CAPNG_EFFECTIVE|CAPNG_PERMITTED),
+                         CAP_BPF);
+#else
+            capng_update(CAPNG_ADD, (capng_type_t) (CAPNG_EFFECTIVE|CAPNG_PERMITTED),
+                         CAP_SYS_ADMIN);
+#endif
+        }
+
+        // The sysfs files of the device queues are owned by root
+        if (opts.cpu_steering && !args->Present("resolv-conf"))
+        {
+            capng_update(CAPNG_ADD, (capng_type_t) (CAPNG_EFFECTIVE|CAPNG_PERMITTED),
+                         CAP_DAC_OVERRIDE);
+        }
+
+        // Opening AF_PACKET sockets for packet captures
+        if (opts.packet_capture)
+        {
+            capng_update(CAPNG_ADD, (capng_type_t) (CAPNG_EFFECTIVE|CAPNG_PERMITTED),
+                         CAP_NET_RAW);
+        }
     }
 #ifdef OPENVPN_DEBUG
     if (!args->Present("run-as-root"))
@@ -167,6 +202,15 @@ int netcfg_main(ParsedArgs::Ptr args)
         {
             logwr.reset(new StreamLogWriter(*logfile));
         }
+
+        // The worker threads log in parallel; the AsyncLogWriter
+        // serializes the writes to the log file
+        if (netcfgopts.worker_threads > 0)
+        {
+            logwr.reset(new AsyncLogWriter(std::move(logwr), 4096,
+                                           std::chrono::milliseconds(0),
+                                           AsyncLogWriter::OverflowPolicy::BLOCK));
+        }
     }
 
     //
@@ -199,9 +243,12 @@ int netcfg_main(ParsedArgs::Ptr args)
         // If we do unicast (!broadcast), attach to the log service
         if (!netcfgopts.signal_broadcast)
         {
-            logservice = LogServiceProxy::AttachInterface(dbus.GetConnection(),
-                                                          OpenVPN3DBus_interf_netcfg);
-            logservice->Attach(OpenVPN3DBus_interf_netcfg + ".core");
+            // Attached from the main loop, so our own bus name is not held
+            // back by the log service being activated
+            LogServiceProxy::AttachInterfaceDeferred(dbus.GetConnection(),
+                                                     {OpenVPN3DBus_interf_netcfg,
+                                                      OpenVPN3DBus_interf_netcfg + ".core"},
+                                                     logservice);
         }
 
         // Initialize logging in the OpenVPN 3 Core library
@@ -228,22 +275,29 @@ int netcfg_main(ParsedArgs::Ptr args)
             // when shutting down.
             resolvconf = new DNS::ResolvConfFile(rsc, rsc + ".ovpn3bak");
             resolver_be = resolvconf;
+
+            if (!netcfgopts.resolv_conf_stub.empty())
+            {
+                resolvconf->SetStubResolver(
+                    std::make_shared<DNS::StubResolver>(netcfgopts.resolv_conf_stub));
+            }
         }
 
         if (args->Present("systemd-resolved"))
         {
-            try
-            {
-                resolver_be = new DNS::SystemdResolved(dbus.GetConnection());
-            }
-            catch (const DNS::resolved::Exception& excp)
-            {
-                std::cerr << "*** ERROR *** "<< excp.what() << std::endl;
-            }
-            catch (const NetCfgException& excp)
-            {
-                std::cerr << "*** ERROR *** "<< excp.what() << std::endl;
-            }
+            // Setting up the systemd-resolved integration requires
+            // polkitd and systemd-resolved to be running.  This is
+            // postponed until DNS settings are applied the first time.
+            GDBusConnection *dbc = dbus.GetConnection();
+            LogWriter *lw = logwr.get();
+            resolver_be = new DNS::LazyResolverBackend(
+                "systemd-resolved DNS configuration backend",
+                DNS::ApplySettingsMode::MODE_POST,
+                [dbc, lw]() -> DNS::ResolverBackendInterface::Ptr
+                {
+                    return new DNS::SystemdResolved(dbc, lw);
+                },
+                resolver_be);
         }
 
         DNS::SettingsManager::Ptr resolvmgr = nullptr;
@@ -251,6 +305,7 @@ int netcfg_main(ParsedArgs::Ptr args)
         {
             resolvmgr = new DNS::SettingsManager(resolver_be);
         }
+        StartupTiming::Instance().Mark("dns_backend_configured");
 
         NetworkCfgService netcfgsrv(dbus.GetConnection(), resolvmgr,
                                     logwr.get(), netcfgopts);
@@ -295,7 +350,6 @@ int netcfg_main(ParsedArgs::Ptr args)
         if (idle_wait_min > 0)
         {
             idle_exit->Disable();
-            idle_exit->Join();
         }
 
         // Explicitly restore the resolv.conf file, if configured
@@ -335,6 +389,8 @@ int netcfg_main(ParsedArgs::Ptr args)
 
 int main(int argc, char **argv)
 {
+    StartupTiming::Instance().Mark("main");
+
     SingleCommand argparser(argv[0], "OpenVPN 3 Network Configuration Manager",
                             netcfg_main);
     argparser.AddVersionOption();
@@ -351,15 +407,63 @@ int main(int argc, char **argv)
                         "0 disables it (Default: 5 minutes)");
     argparser.AddOption("resolv-conf", "FILE", true,
                         "Use file based resolv.conf management, based using FILE");
+    argparser.AddOption("resolv-conf-stub", "ADDRESS", true,
+                        "With --resolv-conf, run a caching split-DNS stub "
+                        "resolver on ADDRESS and point the resolv.conf file at it");
     argparser.AddOption("systemd-resolved", 0,
                         "Use systemd-resolved for configuring DNS resolver settings");
     argparser.AddOption("redirect-method", "METHOD", true,
                         "Method to use if --redirect-gateway is in use for VPN server redirect. "
-                        "Methods: host-route (default), bind-device, none");
+                        "Methods: host-route (default), bind-device, policy-route, none");
     argparser.AddOption("set-somark", "MARK", true,
                         "Set the specified so mark on all VPN sockets.");
+    argparser.AddOption("policy-table", "TABLE", true,
+                        "Routing table used by --redirect-method policy-route "
+                        "(Default: 1194)");
+    argparser.AddOption("worker-threads", "THREADS", true,
+                        "Number of threads configuring network devices in parallel. "
+                        "0 handles all requests in the main loop (Default: 4)");
+    argparser.AddOption("dns-commit-delay", "MSECS", true,
+                        "Milliseconds to wait for DNS changes from other devices "
+                        "before applying them together (Default: 20)");
+    argparser.AddOption("remote-cache-ttl", "SECS", true,
+                        "Seconds to share resolved VPN server addresses between "
+                        "the VPN sessions. 0 disables the cache (Default: 60)");
+    argparser.AddOption("tun-pool", "COUNT", true,
+                        "Number of tun devices to create ahead of the VPN "
+                        "sessions needing them. 0 disables the pool (Default: 0)");
+    argparser.AddOption("notification-multicast", 0,
+                        "Send NetworkChange signals all subscribers want as "
+                        "a single signal to all D-Bus clients");
+    argparser.AddOption("traffic-accounting", 0,
+                        "Count the traffic of the VPN devices per protocol "
+                        "and destination, using tc BPF programs");
+    argparser.AddOption("packet-capture", 0,
+                        "Allow bounded packet captures of the VPN devices "
+                        "via the StartCapture D-Bus method");
+    argparser.AddOption("cpu-steering", 0,
+                        "Allow the VPN sessions to configure RPS/XPS CPU "
+                        "steering of their VPN devices");
+    argparser.AddOption("rps-cpus", 0, "CPULIST", true,
+                        "CPUs processing the packets received on the VPN "
+                        "devices, like 0-3,6 or 'auto' (implies --cpu-steering)");
+    argparser.AddOption("xps-cpus", 0, "CPULIST", true,
+                        "CPUs mapped to the transmit queues of multi-queue "
+                        "VPN devices, like 0-3,6 or 'auto' (implies --cpu-steering)");
+    argparser.AddOption("rps-flow-cnt", 0, "ENTRIES", true,
+                        "Receive Flow Steering table entries per queue of the "
+                        "VPN devices (implies --cpu-steering)");
+    argparser.AddOption("qdisc", 0, "QDISC", true,
+                        "Queueing discipline of the VPN devices, fq_codel or "
+                        "cake, to keep the latency low under upload load");
+    argparser.AddOption("qdisc-bandwidth", 0, "KBITS", true,
+                        "Upload bandwidth hint in kbit/s; cake shapes the "
+                        "VPN devices to it, fq_codel tunes its target delay");
+    argparser.AddOption("txqueuelen", 0, "PACKETS", true,
+                        "Default transmit queue length of the VPN devices");
     argparser.AddOption("state-dir", 0, "DIRECTORY", true,
-                        "Directory where to save the runtime configuration settings");
+                        "Directory where to save the runtime configuration settings "
+                        "and the established devices");
 #if OPENVPN_DEBUG
     argparser.AddOption("disable-capabilities", 0,
                         "Do not restrcit any process capabilties (INSECURE)");
@@ -0,0 +1,456 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   packet-capture.cpp
+ *
+ * @brief  Implementation of NetCfg::PacketCapture
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "netcfg-exception.hpp"
+#include "pcapng.hpp"
+#include "packet-capture.hpp"
+
+
+//  Size of the TPACKET_V3 ring.  Blocks are handed to the capture
+//  thread when full or after block_timeout milliseconds.
+static const unsigned int ring_block_size = 128 * 1024;
+static const unsigned int ring_block_count = 8;
+static const unsigned int ring_frame_size = 2048;
+static const unsigned int block_timeout = 100;
+
+
+static uint64_t realtime_ns()
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+
+namespace NetCfg
+{
+    PacketCapture::Limits PacketCapture::Limits::Bounded() const
+    {
+        Limits ret;
+        ret.snaplen = (0 == snaplen ? 128 : std::min(snaplen, 65535u));
+        ret.max_packets = (0 == max_packets ? 10000 : std::min(max_packets, 1000000u));
+        ret.max_bytes = (0 == max_bytes ? 16 * 1024 * 1024
+                                        : std::min(max_bytes, (uint64_t) 256 * 1024 * 1024));
+        ret.duration = (0 == duration ? 60 : std::min(duration, 3600u));
+        ret.rate_limit = (0 == rate_limit ? 1000 : std::min(rate_limit, 50000u));
+        return ret;
+    }
+
+
+    std::vector<struct sock_filter> PacketCapture::ClampFilter(const std::vector<struct sock_filter>& filter,
+                                                               uint32_t snaplen)
+    {
+        if (filter.empty())
+        {
+            return {BPF_STMT(BPF_RET | BPF_K, snaplen)};
+        }
+        if (filter.size() > BPF_MAXINSNS)
+        {
+            throw NetCfgException("Capture filter is too long");
+        }
+
+        std::vector<struct sock_filter> ret(filter);
+        for (auto& insn : ret)
+        {
+            if (BPF_RET != BPF_CLASS(insn.code))
+            {
+                continue;
+            }
+            if (BPF_K != BPF_RVAL(insn.code))
+            {
+                throw NetCfgException("Capture filters may only return constants");
+            }
+            insn.k = std::min(insn.k, snaplen);
+        }
+        return ret;
+    }
+
+
+    PacketCapture::PacketCapture(const std::string& device_, int fd,
+                                 const Limits& limits_,
+                                 const std::vector<struct sock_filter>& filter,
+                                 const std::vector<std::string>& comments)
+        : device(device_), out_fd(fd), limits(limits_.Bounded())
+    {
+        try
+        {
+            unsigned int ifindex = if_nametoindex(device.c_str());
+            if (0 == ifindex)
+            {
+                throw NetCfgException("Network device " + device + " not found");
+            }
+
+            // Packets are only received once the socket is bound, after
+            // the filter is in place
+            sock = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+            if (sock < 0)
+            {
+                throw NetCfgException(std::string("Could not open packet socket: ")
+                                      + strerror(errno));
+            }
+
+            std::vector<struct sock_filter> prog = ClampFilter(filter, limits.snaplen);
+            struct sock_fprog fprog = {};
+            fprog.len = prog.size();
+            fprog.filter = prog.data();
+            if (0 != setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER,
+                                &fprog, sizeof(fprog)))
+            {
+                throw NetCfgException(std::string("Invalid capture filter: ")
+                                      + strerror(errno));
+            }
+
+            int version = TPACKET_V3;
+            if (0 != setsockopt(sock, SOL_PACKET, PACKET_VERSION,
+                                &version, sizeof(version)))
+            {
+                throw NetCfgException(std::string("TPACKET_V3 not available: ")
+                                      + strerror(errno));
+            }
+
+            struct tpacket_req3 req = {};
+            req.tp_block_size = ring_block_size;
+            req.tp_block_nr = ring_block_count;
+            req.tp_frame_size = ring_frame_size;
+            req.tp_frame_nr = ring_block_size * ring_block_count / ring_frame_size;
+            req.tp_retire_blk_tov = block_timeout;
+            if (0 != setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)))
+            {
+                throw NetCfgException(std::string("Could not set up capture ring: ")
+                                      + strerror(errno));
+            }
+            ring_size = ring_block_size * ring_block_count;
+            ring = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, sock, 0);
+            if (MAP_FAILED == ring)
+            {
+                ring = nullptr;
+                throw NetCfgException(std::string("Could not map capture ring: ")
+                                      + strerror(errno));
+            }
+            block_size = ring_block_size;
+            block_count = ring_block_count;
+
+            struct ifreq ifr = {};
+            strncpy(ifr.ifr_name, device.c_str(), IFNAMSIZ - 1);
+            uint16_t linktype = Pcapng::LINKTYPE_RAW;
+            if (0 == ioctl(sock, SIOCGIFHWADDR, &ifr)
+                && ARPHRD_ETHER == ifr.ifr_hwaddr.sa_family)
+            {
+                linktype = Pcapng::LINKTYPE_ETHERNET;
+            }
+
+            struct sockaddr_ll sll = {};
+            sll.sll_family = AF_PACKET;
+            sll.sll_protocol = htons(ETH_P_ALL);
+            sll.sll_ifindex = ifindex;
+            if (0 != bind(sock, reinterpret_cast<struct sockaddr *>(&sll),
+                          sizeof(sll)))
+            {
+                throw NetCfgException(std::string("Could not bind packet socket: ")
+                                      + strerror(errno));
+            }
+
+            stop_fd = eventfd(0, EFD_CLOEXEC);
+            if (stop_fd < 0)
+            {
+                throw NetCfgException(std::string("Could not create eventfd: ")
+                                      + strerror(errno));
+            }
+
+            // The capture thread must not block in write() while
+            // Stop() is waiting for it
+            int flags = fcntl(out_fd, F_GETFL);
+            if (flags < 0 || 0 != fcntl(out_fd, F_SETFL, flags | O_NONBLOCK))
+            {
+                throw NetCfgException(std::string("Invalid capture file descriptor: ")
+                                      + strerror(errno));
+            }
+
+            if (!write_out(Pcapng::SectionHeader(comments, "openvpn3-service-netcfg")
+                           + Pcapng::InterfaceDescription(linktype, limits.snaplen,
+                                                          device)))
+            {
+                throw NetCfgException(std::string("Could not write the capture: ")
+                                      + strerror(errno));
+            }
+        }
+        catch (...)
+        {
+            cleanup();
+            throw;
+        }
+    }
+
+
+    PacketCapture::~PacketCapture()
+    {
+        Stop();
+        cleanup();
+    }
+
+
+    void PacketCapture::Start(DoneCallback done)
+    {
+        running = true;
+        thread = std::thread([this, done]()
+                             {
+                                 capture_thread(done);
+                             });
+    }
+
+
+    void PacketCapture::Stop()
+    {
+        if (!thread.joinable())
+        {
+            return;
+        }
+        uint64_t one = 1;
+        (void) write(stop_fd, &one, sizeof(one));
+        thread.join();
+    }
+
+
+    void PacketCapture::capture_thread(DoneCallback done)
+    {
+        // Writing to a closed pipe must fail with EPIPE instead of
+        // killing the service
+        sigset_t sigs;
+        sigemptyset(&sigs);
+        sigaddset(&sigs, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+
+        auto deadline = std::chrono::steady_clock::now()
+                        + std::chrono::seconds(limits.duration);
+        uint64_t written = 0;
+        uint64_t packets = 0;
+        uint64_t rate_limited = 0;
+        uint64_t rate_second = 0;
+        uint32_t rate_count = 0;
+        unsigned int blk = 0;
+        std::string reason;
+
+        while (reason.empty())
+        {
+            auto *bd = reinterpret_cast<struct tpacket_block_desc *>(
+                static_cast<uint8_t *>(ring) + blk * block_size);
+            if (0 == (__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE)
+                      & TP_STATUS_USER))
+            {
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline)
+                {
+                    reason = "duration limit reached";
+                    break;
+                }
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+                struct pollfd pfd[2] = {{sock, POLLIN | POLLERR, 0},
+                                        {stop_fd, POLLIN, 0}};
+                if (poll(pfd, 2, std::min<int64_t>(wait.count() + 1, 1000)) < 0
+                    && EINTR != errno)
+                {
+                    reason = std::string("poll failed: ") + strerror(errno);
+                }
+                else if (pfd[1].revents & POLLIN)
+                {
+                    reason = "stopped";
+                }
+                continue;
+            }
+
+            std::string out;
+            auto *pkt = reinterpret_cast<struct tpacket3_hdr *>(
+                reinterpret_cast<uint8_t *>(bd) + bd->hdr.bh1.offset_to_first_pkt);
+            for (uint32_t i = 0; i < bd->hdr.bh1.num_pkts && reason.empty(); ++i)
+            {
+                if (pkt->tp_sec != rate_second)
+                {
+                    rate_second = pkt->tp_sec;
+                    rate_count = 0;
+                }
+                if (rate_count >= limits.rate_limit)
+                {
+                    ++rate_limited;
+                }
+                else
+                {
+                    ++rate_count;
+                    uint32_t caplen = std::min(pkt->tp_snaplen, limits.snaplen);
+                    std::string epb = Pcapng::EnhancedPacket(
+                        (uint64_t) pkt->tp_sec * 1000000000 + pkt->tp_nsec,
+                        reinterpret_cast<uint8_t *>(pkt) + pkt->tp_mac,
+                        caplen, pkt->tp_len);
+                    if (written + out.size() + epb.size() > limits.max_bytes)
+                    {
+                        reason = "size limit reached";
+                        break;
+                    }
+                    out += epb;
+                    if (++packets >= limits.max_packets)
+                    {
+                        reason = "packet limit reached";
+                    }
+                }
+                pkt = reinterpret_cast<struct tpacket3_hdr *>(
+                    reinterpret_cast<uint8_t *>(pkt) + pkt->tp_next_offset);
+            }
+
+            // Hand the block back to the kernel
+            __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                             __ATOMIC_RELEASE);
+            blk = (blk + 1) % block_count;
+
+            if (!out.empty())
+            {
+                if (!write_out(out))
+                {
+                    reason = (0 == errno ? "stopped"
+                                         : std::string("writing the capture failed: ")
+                                           + strerror(errno));
+                    break;
+                }
+                written += out.size();
+            }
+        }
+
+        struct tpacket_stats_v3 stats = {};
+        socklen_t len = sizeof(stats);
+        (void) getsockopt(sock, SOL_PACKET, PACKET_STATISTICS, &stats, &len);
+
+        std::string comment = "Capture ended: " + reason;
+        if (rate_limited > 0)
+        {
+            comment += ", " + std::to_string(rate_limited)
+                       + " packets over the rate limit not captured";
+        }
+        (void) write_out(Pcapng::InterfaceStatistics(realtime_ns(),
+                                                     stats.tp_packets,
+                                                     stats.tp_drops,
+                                                     packets, comment));
+
+        // Release the ring and let the reader see the end of the capture
+        munmap(ring, ring_size);
+        ring = nullptr;
+        close(sock);
+        sock = -1;
+        close(out_fd);
+        out_fd = -1;
+
+        running = false;
+        if (done)
+        {
+            done(reason, packets, stats.tp_drops + rate_limited);
+        }
+    }
+
+
+    /**
+     *  Writes all the data to the output file descriptor
+     *
+     * @return Returns false on errors, with errno set.  errno is 0 if
+     *         the capture was stopped while waiting.
+     */
+    bool PacketCapture::write_out(const std::string& data)
+    {
+        size_t done = 0;
+        while (done < data.size())
+        {
+            ssize_t r = write(out_fd, data.data() + done, data.size() - done);
+            if (r >= 0)
+            {
+                done += r;
+                continue;
+            }
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if (EAGAIN != errno)
+            {
+                return false;
+            }
+
+            struct pollfd pfd[2] = {{out_fd, POLLOUT, 0},
+                                    {stop_fd, POLLIN, 0}};
+            if (poll(pfd, (stop_fd >= 0 ? 2 : 1), 1000) < 0 && EINTR != errno)
+            {
+                return false;
+            }
+            if (pfd[1].revents & POLLIN)
+            {
+                errno = 0;
+                return false;
+            }
+            if (pfd[0].revents & (POLLERR | POLLHUP))
+            {
+                errno = EPIPE;
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    void PacketCapture::cleanup()
+    {
+        if (ring)
+        {
+            munmap(ring, ring_size);
+            ring = nullptr;
+        }
+        for (int *fd : {&sock, &stop_fd, &out_fd})
+        {
+            if (*fd >= 0)
+            {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+} // namespace NetCfg
@@ -0,0 +1,170 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   packet-capture.hpp
+ *
+ * @brief  Bounded packet capture of a virtual network device, written
+ *         as pcapng to a file descriptor
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/filter.h>
+
+
+namespace NetCfg
+{
+    /**
+     *  Captures the packets passing a network device with an AF_PACKET
+     *  socket and a TPACKET_V3 memory mapped ring, and streams them as
+     *  pcapng to a file descriptor from a separate thread.
+     *
+     *  The capture never slows down the data path: the kernel copies at
+     *  most snaplen bytes of each accepted packet into the ring, and if
+     *  the capture thread or the reader of the file descriptor falls
+     *  behind, packets are dropped from the ring.  The capture ends
+     *  when any of the limits is reached, when Stop() is called or when
+     *  writing to the file descriptor fails.
+     */
+    class PacketCapture
+    {
+    public:
+        using Ptr = std::unique_ptr<PacketCapture>;
+
+        /**
+         *  Limits of a capture.  Values above the hard limits are
+         *  reduced to them; 0 selects the default.
+         */
+        struct Limits
+        {
+            uint32_t snaplen = 0;       ///< Bytes kept of each packet
+            uint32_t max_packets = 0;   ///< Packets to capture
+            uint64_t max_bytes = 0;     ///< Size of the pcapng output
+            uint32_t duration = 0;      ///< Seconds to capture
+            uint32_t rate_limit = 0;    ///< Packets per second to capture
+
+
+            /**
+             * @return Returns a copy with the defaults and hard limits
+             *         applied
+             */
+            Limits Bounded() const;
+        };
+
+
+        /**
+         *  Called from the capture thread when the capture has ended
+         *
+         * @param reason   Why the capture ended
+         * @param packets  Number of packets written
+         * @param dropped  Number of packets not written, because of the
+         *                 rate limit or a full ring
+         */
+        using DoneCallback = std::function<void(const std::string& reason,
+                                                uint64_t packets,
+                                                uint64_t dropped)>;
+
+
+        /**
+         *  Prepares the capture of a network device.  The pcapng
+         *  section and interface headers are written to the file
+         *  descriptor right away.  Throws NetCfgException on errors.
+         *
+         * @param device    Name of the network device
+         * @param fd        File descriptor to write the capture to.  It is
+         *                  owned by this object from now on, also on errors.
+         * @param limits    Limits of the capture
+         * @param filter    Classic BPF program selecting the packets, as
+         *                  produced by 'tcpdump -dd'.  Empty captures all
+         *                  packets.
+         * @param comments  Comments describing the capture, added to the
+         *                  pcapng section header
+         */
+        PacketCapture(const std::string& device, int fd, const Limits& limits,
+                      const std::vector<struct sock_filter>& filter,
+                      const std::vector<std::string>& comments);
+        ~PacketCapture();
+
+        PacketCapture(const PacketCapture&) = delete;
+        PacketCapture& operator=(const PacketCapture&) = delete;
+
+
+        /**
+         *  Starts the capture thread
+         *
+         * @param done  DoneCallback called when the capture ends
+         */
+        void Start(DoneCallback done);
+
+
+        /**
+         *  Ends the capture and waits for the capture thread to finish
+         */
+        void Stop();
+
+
+        /**
+         * @return Returns true until the capture has ended
+         */
+        bool Running() const noexcept
+        {
+            return running;
+        }
+
+
+        /**
+         *  Limits the number of bytes the kernel copies of each packet,
+         *  by lowering the accept values of a classic BPF program.
+         *  Throws NetCfgException if the program is invalid.
+         *
+         * @param filter   Classic BPF program; empty accepts all packets
+         * @param snaplen  Maximum number of bytes to keep of each packet
+         *
+         * @return Returns the modified program
+         */
+        static std::vector<struct sock_filter> ClampFilter(const std::vector<struct sock_filter>& filter,
+                                                           uint32_t snaplen);
+
+
+    private:
+        std::string device;
+        int out_fd = -1;
+        Limits limits;
+        int sock = -1;
+        int stop_fd = -1;
+        void *ring = nullptr;
+        size_t ring_size = 0;
+        unsigned int block_size = 0;
+        unsigned int block_count = 0;
+        std::thread thread;
+        std::atomic<bool> running{false};
+
+        void capture_thread(DoneCallback done);
+        bool write_out(const std::string& data);
+        void cleanup();
+    };
+} // namespace NetCfg
@@ -0,0 +1,238 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   pcapng.hpp
+ *
+ * @brief  Builds the blocks of a pcapng capture file
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+/**
+ *  The pcapng blocks needed to write a capture of a single network
+ *  interface.  Each function returns a complete block, in host byte
+ *  order as allowed by the format; the byte order magic in the section
+ *  header tells the readers.
+ *
+ *  See https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-00.html
+ */
+namespace Pcapng
+{
+    /// Link types used in the interface description
+    static const uint16_t LINKTYPE_ETHERNET = 1;
+    static const uint16_t LINKTYPE_RAW = 101;    ///< Raw IPv4/IPv6 packets
+
+    static const uint32_t BLOCK_SHB = 0x0A0D0D0A;
+    static const uint32_t BLOCK_IDB = 0x00000001;
+    static const uint32_t BLOCK_ISB = 0x00000005;
+    static const uint32_t BLOCK_EPB = 0x00000006;
+
+
+    /**
+     *  Incrementally builds a single block, taking care of the padding
+     *  and the two length fields
+     */
+    class Block
+    {
+    public:
+        Block(uint32_t type)
+        {
+            put32(type);
+            put32(0);   // Total length, set by str()
+        }
+
+        void put16(uint16_t v)
+        {
+            append(&v, sizeof(v));
+        }
+
+        void put32(uint32_t v)
+        {
+            append(&v, sizeof(v));
+        }
+
+        void put64(uint64_t v)
+        {
+            append(&v, sizeof(v));
+        }
+
+        /**
+         *  Appends data, padded to 32 bits
+         */
+        void put_padded(const void *data, size_t len)
+        {
+            append(data, len);
+            buf.append((4 - len % 4) % 4, '\0');
+        }
+
+        void option(uint16_t code, const void *data, size_t len)
+        {
+            put16(code);
+            put16(len);
+            put_padded(data, len);
+        }
+
+        void option(uint16_t code, const std::string& value)
+        {
+            option(code, value.data(), value.size());
+        }
+
+        void option64(uint16_t code, uint64_t value)
+        {
+            option(code, &value, sizeof(value));
+        }
+
+        /**
+         * @return Returns the completed block
+         */
+        std::string str()
+        {
+            uint32_t len = buf.size() + 4;
+            std::string ret(buf);
+            ret.append(reinterpret_cast<const char *>(&len), sizeof(len));
+            std::memcpy(&ret[4], &len, sizeof(len));
+            return ret;
+        }
+
+    private:
+        std::string buf;
+
+        void append(const void *data, size_t len)
+        {
+            buf.append(static_cast<const char *>(data), len);
+        }
+    };
+
+
+    /**
+     *  Section Header Block, starting the file
+     *
+     * @param comments  Comments describing the capture, one option each
+     * @param userappl  Name of the application writing the capture
+     * @param os        Operating system the capture was taken on
+     */
+    inline std::string SectionHeader(const std::vector<std::string>& comments,
+                                     const std::string& userappl,
+                                     const std::string& os = "")
+    {
+        Block b(BLOCK_SHB);
+        b.put32(0x1A2B3C4D);            // Byte order magic
+        b.put16(1);                     // Major version
+        b.put16(0);                     // Minor version
+        b.put64(UINT64_MAX);            // Section length unknown
+        for (const auto& c : comments)
+        {
+            b.option(1, c);             // opt_comment
+        }
+        if (!os.empty())
+        {
+            b.option(3, os);            // shb_os
+        }
+        if (!userappl.empty())
+        {
+            b.option(4, userappl);      // shb_userappl
+        }
+        b.put32(0);                     // opt_endofopt
+        return b.str();
+    }
+
+
+    /**
+     *  Interface Description Block.  The timestamps of the packets of
+     *  the interface are in nanoseconds.
+     *
+     * @param linktype  Link type of the packets, like LINKTYPE_RAW
+     * @param snaplen   Maximum number of bytes captured of each packet
+     * @param name      Name of the network interface
+     */
+    inline std::string InterfaceDescription(uint16_t linktype, uint32_t snaplen,
+                                            const std::string& name)
+    {
+        Block b(BLOCK_IDB);
+        b.put16(linktype);
+        b.put16(0);                     // Reserved
+        b.put32(snaplen);
+        if (!name.empty())
+        {
+            b.option(2, name);          // if_name
+        }
+        const uint8_t tsresol = 9;      // 10^-9 seconds
+        b.option(9, &tsresol, 1);       // if_tsresol
+        b.put32(0);
+        return b.str();
+    }
+
+
+    /**
+     *  Enhanced Packet Block of the first interface
+     *
+     * @param ts_ns    Time of the packet, in nanoseconds since the epoch
+     * @param data     Captured bytes of the packet
+     * @param caplen   Number of captured bytes
+     * @param origlen  Length of the packet on the wire
+     */
+    inline std::string EnhancedPacket(uint64_t ts_ns, const void *data,
+                                      uint32_t caplen, uint32_t origlen)
+    {
+        Block b(BLOCK_EPB);
+        b.put32(0);                     // Interface ID
+        b.put32(ts_ns >> 32);
+        b.put32(ts_ns & 0xffffffff);
+        b.put32(caplen);
+        b.put32(origlen);
+        b.put_padded(data, caplen);
+        return b.str();
+    }
+
+
+    /**
+     *  Interface Statistics Block of the first interface, closing the
+     *  capture
+     *
+     * @param ts_ns      Time of the statistics, in nanoseconds since the epoch
+     * @param received   Packets received by the capture
+     * @param dropped    Packets dropped by the capture, before filtering
+     * @param delivered  Packets written to the capture
+     * @param comment    Optional comment, like why the capture ended
+     */
+    inline std::string InterfaceStatistics(uint64_t ts_ns, uint64_t received,
+                                           uint64_t dropped, uint64_t delivered,
+                                           const std::string& comment = "")
+    {
+        Block b(BLOCK_ISB);
+        b.put32(0);
+        b.put32(ts_ns >> 32);
+        b.put32(ts_ns & 0xffffffff);
+        if (!comment.empty())
+        {
+            b.option(1, comment);       // opt_comment
+        }
+        b.option64(4, received);        // isb_ifrecv
+        b.option64(5, dropped);         // isb_ifdrop
+        b.option64(8, delivered);       // isb_usrdeliv
+        b.put32(0);
+        return b.str();
+    }
+} // namespace Pcapng
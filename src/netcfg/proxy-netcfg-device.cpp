@@ -61,6 +61,116 @@ namespace NetCfgProxy
 
 
 
+    //
+    //  class NetCfgProxy::IPAddress
+    //
+
+    IPAddress::IPAddress(std::string ip_address, unsigned int prefix,
+                         std::string gateway, bool ipv6)
+        : address(std::move(ip_address)), prefix(prefix),
+          gateway(std::move(gateway)), ipv6(ipv6)
+    {
+    }
+
+
+
+    /**
+     *  Packs a DeviceConfig into the (a{sv}) argument of the
+     *  ApplyConfiguration D-Bus method
+     */
+    static GVariant* build_device_config(const DeviceConfig& cfg)
+    {
+        GVariantBuilder *addrs = g_variant_builder_new(G_VARIANT_TYPE("a(susb)"));
+        for (const auto& a : cfg.addresses)
+        {
+            g_variant_builder_add(addrs, "(susb)",
+                                  a.address.c_str(), a.prefix,
+                                  a.gateway.c_str(), a.ipv6);
+        }
+
+        GVariantBuilder *nets = g_variant_builder_new(G_VARIANT_TYPE("a(subb)"));
+        for (const auto& net : cfg.networks)
+        {
+            g_variant_builder_add(nets, "(subb)",
+                                  net.address.c_str(), net.prefix,
+                                  net.ipv6, net.exclude);
+        }
+
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(bld, "{sv}", "addresses",
+                              g_variant_builder_end(addrs));
+        g_variant_builder_add(bld, "{sv}", "networks",
+                              g_variant_builder_end(nets));
+        g_variant_builder_unref(addrs);
+        g_variant_builder_unref(nets);
+
+        if (!cfg.remote_address.empty())
+        {
+            g_variant_builder_add(bld, "{sv}", "remote_address",
+                                  g_variant_new_string(cfg.remote_address.c_str()));
+            g_variant_builder_add(bld, "{sv}", "remote_ipv6",
+                                  g_variant_new_boolean(cfg.remote_ipv6));
+        }
+        if (!cfg.dns_servers.empty())
+        {
+            g_variant_builder_add(bld, "{sv}", "dns_servers",
+                                  GLibUtils::GVariantFromVector(cfg.dns_servers));
+        }
+        if (!cfg.dns_search.empty())
+        {
+            g_variant_builder_add(bld, "{sv}", "dns_search",
+                                  GLibUtils::GVariantFromVector(cfg.dns_search));
+        }
+        if (cfg.layer > 0)
+        {
+            g_variant_builder_add(bld, "{sv}", "layer",
+                                  g_variant_new_uint32(cfg.layer));
+        }
+        if (cfg.mtu > 0)
+        {
+            g_variant_builder_add(bld, "{sv}", "mtu",
+                                  g_variant_new_uint32(cfg.mtu));
+        }
+        g_variant_builder_add(bld, "{sv}", "reroute_ipv4",
+                              g_variant_new_boolean(cfg.reroute_ipv4));
+        g_variant_builder_add(bld, "{sv}", "reroute_ipv6",
+                              g_variant_new_boolean(cfg.reroute_ipv6));
+        if (!cfg.rps_cpus.empty())
+        {
+            g_variant_builder_add(bld, "{sv}", "rps_cpus",
+                                  g_variant_new_string(cfg.rps_cpus.c_str()));
+        }
+        if (!cfg.xps_cpus.empty())
+        {
+            g_variant_builder_add(bld, "{sv}", "xps_cpus",
+                                  g_variant_new_string(cfg.xps_cpus.c_str()));
+        }
+        if (cfg.rps_flow_cnt > 0)
+        {
+            g_variant_builder_add(bld, "{sv}", "rps_flow_cnt",
+                                  g_variant_new_uint32(cfg.rps_flow_cnt));
+        }
+        if (!cfg.qdisc.empty())
+        {
+            g_variant_builder_add(bld, "{sv}", "qdisc",
+                                  g_variant_new_string(cfg.qdisc.c_str()));
+        }
+        if (cfg.qdisc_bandwidth > 0)
+        {
+            g_variant_builder_add(bld, "{sv}", "qdisc_bandwidth",
+                                  g_variant_new_uint32(cfg.qdisc_bandwidth));
+        }
+        if (cfg.txqueuelen > 0)
+        {
+            g_variant_builder_add(bld, "{sv}", "txqueuelen",
+                                  g_variant_new_uint32(cfg.txqueuelen));
+        }
+
+        return GLibUtils::wrapInTuple(bld);
+    }
+
+
+
     //
     //  class NetCfgProxy::Device
     //
@@ -124,6 +234,20 @@ namespace NetCfgProxy
     }
 
 
+    void Device::RemoveNetworks(const std::vector<Network> &networks)
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(subb)"));
+        for (const auto& net : networks)
+        {
+            g_variant_builder_add(bld, "(subb)",
+                                  net.address.c_str(), net.prefix,
+                                  net.ipv6, net.exclude);
+        }
+        GVariant *res = Call("RemoveNetworks", GLibUtils::wrapInTuple(bld));
+        g_variant_unref(res);
+    }
+
+
     void Device::AddDNS(const std::vector<std::string>& server_list)
     {
         GVariant *list = GLibUtils::GVariantTupleFromVector(server_list);
@@ -178,6 +302,25 @@ namespace NetCfgProxy
 #endif  // ENABLE_OVPNDCO
 
 
+    int Device::ApplyConfiguration(const DeviceConfig& cfg)
+    {
+        gint fd = -1;
+        GVariant *res = CallGetFD("ApplyConfiguration",
+                                  build_device_config(cfg), fd);
+        g_variant_unref(res);
+        return fd;
+    }
+
+
+#ifdef ENABLE_OVPNDCO
+    void Device::ApplyConfigurationDCO(const DeviceConfig& cfg)
+    {
+        GVariant *res = Call("ApplyConfiguration", build_device_config(cfg));
+        g_variant_unref(res);
+    }
+#endif  // ENABLE_OVPNDCO
+
+
     int Device::Establish()
     {
         gint fd = -1;
@@ -226,6 +369,62 @@ namespace NetCfgProxy
     }
 
 
+    void Device::AdjustMTU(unsigned int mtu)
+    {
+        GVariant *res = Call("AdjustMTU", g_variant_new("(u)", mtu));
+        g_variant_unref(res);
+    }
+
+
+    void Device::StartCapture(int fd, const NetCfg::PacketCapture::Limits& limits,
+                              const std::vector<struct sock_filter>& filter,
+                              const std::map<std::string, std::string>& metadata)
+    {
+        GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(b, "{sv}", "snaplen",
+                              g_variant_new_uint32(limits.snaplen));
+        g_variant_builder_add(b, "{sv}", "max_packets",
+                              g_variant_new_uint32(limits.max_packets));
+        g_variant_builder_add(b, "{sv}", "max_bytes",
+                              g_variant_new_uint64(limits.max_bytes));
+        g_variant_builder_add(b, "{sv}", "duration",
+                              g_variant_new_uint32(limits.duration));
+        g_variant_builder_add(b, "{sv}", "rate_limit",
+                              g_variant_new_uint32(limits.rate_limit));
+
+        GVariantBuilder *fb = g_variant_builder_new(G_VARIANT_TYPE("a(qyyu)"));
+        for (const auto& f : filter)
+        {
+            g_variant_builder_add(fb, "(qyyu)", f.code, f.jt, f.jf, f.k);
+        }
+        g_variant_builder_add(b, "{sv}", "filter",
+                              g_variant_builder_end(fb));
+        g_variant_builder_unref(fb);
+
+        GVariantBuilder *mb = g_variant_builder_new(G_VARIANT_TYPE("a{ss}"));
+        for (const auto& m : metadata)
+        {
+            g_variant_builder_add(mb, "{ss}", m.first.c_str(), m.second.c_str());
+        }
+        g_variant_builder_add(b, "{sv}", "metadata",
+                              g_variant_builder_end(mb));
+        g_variant_builder_unref(mb);
+
+        GVariant *params = g_variant_new("(a{sv})", b);
+        g_variant_builder_unref(b);
+
+        GVariant *res = CallSendFD("StartCapture", params, fd);
+        g_variant_unref(res);
+    }
+
+
+    void Device::StopCapture()
+    {
+        GVariant *res = Call("StopCapture");
+        g_variant_unref(res);
+    }
+
+
     uid_t Device::GetOwner()
     {
         return GetUIntProperty("owner");
@@ -282,6 +481,18 @@ namespace NetCfgProxy
     }
 
 
+    std::string Device::GetSteeringCPUs()
+    {
+        return GetStringProperty("steering_cpus");
+    }
+
+
+    std::string Device::GetEgressNumaNode()
+    {
+        return GetStringProperty("egress_numa_node");
+    }
+
+
     bool Device::GetActive()
     {
         return GetBoolProperty("active");
@@ -329,6 +540,46 @@ namespace NetCfgProxy
         return ret;
     }
 
+
+    std::vector<NetCfg::TrafficCounter> Device::GetTrafficAccounting()
+    {
+        GVariant *res = GetProperty("traffic_accounting");
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("NetCfgProxy::Device",
+                                "GetTrafficAccounting() call failed");
+        }
+        GVariantIter *counters = NULL;
+        g_variant_get(res, "a(sssstt)", &counters);
+
+        std::vector<NetCfg::TrafficCounter> ret;
+        gchar *dir = NULL;
+        gchar *family = NULL;
+        gchar *proto = NULL;
+        gchar *dest = NULL;
+        guint64 bytes = 0;
+        guint64 packets = 0;
+        while (g_variant_iter_next(counters, "(sssstt)", &dir, &family,
+                                   &proto, &dest, &bytes, &packets))
+        {
+            NetCfg::TrafficCounter c;
+            c.direction = dir;
+            c.family = family;
+            c.protocol = proto;
+            c.destination = dest;
+            c.bytes = bytes;
+            c.packets = packets;
+            ret.push_back(c);
+            g_free(dir);
+            g_free(family);
+            g_free(proto);
+            g_free(dest);
+        }
+        g_variant_unref(res);
+        g_variant_iter_free(counters);
+        return ret;
+    }
+
 #ifdef ENABLE_OVPNDCO
     DCO::DCO(GDBusConnection *dbuscon, const std::string& dcopath)
         : DBusProxy(dbuscon,
@@ -357,24 +608,42 @@ namespace NetCfgProxy
 
     void DCO::NewKey(unsigned int key_slot, const KoRekey::KeyConfig* kc_arg)
     {
-        DcoKeyConfig kc;
-
-        kc.set_key_id(kc_arg->key_id);
-        kc.set_remote_peer_id(kc_arg->remote_peer_id);
-        kc.set_cipher_alg(kc_arg->cipher_alg);
+        NewKeys({{key_slot, kc_arg}});
+    }
 
+    void DCO::NewKeys(const std::vector<std::pair<unsigned int,
+                                                  const KoRekey::KeyConfig*>>& keys)
+    {
         auto copyKeyDirection = [](const KoRekey::KeyDirection& src, DcoKeyConfig_KeyDirection* dst) {
             dst->set_cipher_key(src.cipher_key, src.cipher_key_size);
             dst->set_nonce_tail(src.nonce_tail, sizeof(src.nonce_tail));
             dst->set_cipher_key_size(src.cipher_key_size);
         };
 
-        copyKeyDirection(kc_arg->encrypt, kc.mutable_encrypt());
-        copyKeyDirection(kc_arg->decrypt, kc.mutable_decrypt());
-
-        auto str = base64->encode(kc.SerializeAsString());
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(uay)"));
+        for (const auto& key : keys)
+        {
+            const KoRekey::KeyConfig* kc_arg = key.second;
+            DcoKeyConfig kc;
+
+            kc.set_key_id(kc_arg->key_id);
+            kc.set_remote_peer_id(kc_arg->remote_peer_id);
+            kc.set_cipher_alg(kc_arg->cipher_alg);
+
+            copyKeyDirection(kc_arg->encrypt, kc.mutable_encrypt());
+            copyKeyDirection(kc_arg->decrypt, kc.mutable_decrypt());
+
+            // The serialized key config is passed as a binary blob,
+            // avoiding the base64 round trip used by NewKey
+            std::string str = kc.SerializeAsString();
+            g_variant_builder_add(bld, "(u@ay)", key.first,
+                                  g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                            str.data(),
+                                                            str.size(), 1));
+        }
 
-        Call("NewKey", g_variant_new("(us)", key_slot, str.c_str()));
+        GVariant *res = Call("NewKeys", GLibUtils::wrapInTuple(bld));
+        g_variant_unref(res);
     }
 
     void DCO::SwapKeys(unsigned int peer_id)
@@ -383,6 +652,42 @@ namespace NetCfgProxy
         g_variant_unref(res);
     }
 
+    std::vector<DCOPeerStats> DCO::GetPeerStats()
+    {
+        GVariant *res = Call("GetPeerStats");
+        GLibUtils::checkParams(__func__, res, "(a(utttttttt))", 1);
+
+        std::vector<DCOPeerStats> ret;
+        GVariantIter *peers = nullptr;
+        g_variant_get(res, "(a(utttttttt))", &peers);
+
+        DCOPeerStats p;
+        while (g_variant_iter_next(peers, "(utttttttt)", &p.peer_id,
+                                   &p.vpn_rx_bytes, &p.vpn_tx_bytes,
+                                   &p.vpn_rx_packets, &p.vpn_tx_packets,
+                                   &p.link_rx_bytes, &p.link_tx_bytes,
+                                   &p.link_rx_packets, &p.link_tx_packets))
+        {
+            ret.push_back(p);
+        }
+        g_variant_iter_free(peers);
+        g_variant_unref(res);
+        return ret;
+    }
+
+    CpuUsage DCO::GetWorkerUsage()
+    {
+        GVariant *res = Call("GetWorkerUsage");
+        GLibUtils::checkParams(__func__, res, "((ttttt))", 1);
+
+        CpuUsage u;
+        g_variant_get(res, "((ttttt))", &u.user_usec, &u.system_usec,
+                      &u.voluntary_ctxsw, &u.involuntary_ctxsw,
+                      &u.runqueue_wait_usec);
+        g_variant_unref(res);
+        return u;
+    }
+
     void DCO::SetPeer(unsigned int peer_id, int keepalive_interval, int keepalive_timeout)
     {
         GVariant *res = Call("SetPeer",
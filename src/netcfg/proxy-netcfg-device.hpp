@@ -29,11 +29,14 @@
 #pragma once
 #define OPENVPN3_NETCFGPRX_DEVICE
 
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <openvpn/common/rc.hpp>
 
+#include "common/cpu-usage.hpp"
 #include "dbus/core.hpp"
 #include "dbus/proxy.hpp"
 #include "netcfg-device.hpp"
@@ -60,6 +63,46 @@ namespace NetCfgProxy
     };
 
 
+    /**
+     *  Class representing an IPv4 or IPv6 address of the virtual device
+     */
+    class IPAddress {
+    public:
+        IPAddress(std::string ip_address, unsigned int prefix,
+                  std::string gateway, bool ipv6);
+
+        std::string address;
+        unsigned int prefix;
+        std::string gateway;
+        bool ipv6;
+    };
+
+
+    /**
+     *  The complete configuration of a virtual network device, which
+     *  is applied in a single D-Bus call by Device::ApplyConfiguration()
+     */
+    struct DeviceConfig
+    {
+        std::vector<IPAddress> addresses;
+        std::vector<Network> networks;
+        std::string remote_address;
+        bool remote_ipv6 = false;
+        std::vector<std::string> dns_servers;
+        std::vector<std::string> dns_search;
+        unsigned int layer = 0;   ///< 0 keeps the current device layer
+        unsigned int mtu = 0;     ///< 0 keeps the current MTU
+        bool reroute_ipv4 = false;
+        bool reroute_ipv6 = false;
+        std::string rps_cpus;       ///< Empty uses the netcfg service default
+        std::string xps_cpus;       ///< Empty uses the netcfg service default
+        unsigned int rps_flow_cnt = 0;  ///< 0 uses the netcfg service default
+        std::string qdisc;          ///< Empty uses the netcfg service default
+        unsigned int qdisc_bandwidth = 0;  ///< Upload bandwidth hint, kbit/s
+        unsigned int txqueuelen = 0;    ///< 0 keeps the current queue length
+    };
+
+
 
     /**
      *   Class replicating a specific D-Bus network device object
@@ -112,6 +155,15 @@ namespace NetCfgProxy
          */
         void AddNetworks(const std::vector<Network> &networks);
 
+        /**
+         *  Takes a vector of networks previously added with AddNetworks()
+         *  which are to be removed.  On an established device, only
+         *  these routes are changed.
+         *
+         * @param networks
+         */
+        void RemoveNetworks(const std::vector<Network> &networks);
+
         /**
          *  Takes a list of DNS server IP addresses to enlist as
          *  DNS resolvers on the system
@@ -158,6 +210,25 @@ namespace NetCfgProxy
         void EstablishDCO();
 #endif
 
+        /**
+         *  Replaces the complete configuration of this virtual interface
+         *  and establishes it, in a single D-Bus call.  The netcfg service
+         *  validates the whole configuration before applying any of it.
+         *
+         * @param cfg  DeviceConfig with the configuration to apply
+         * @return Tun file descriptor or -1 on error
+         */
+        int ApplyConfiguration(const DeviceConfig& cfg);
+
+#ifdef ENABLE_OVPNDCO
+        /**
+         *  Same as ApplyConfiguration(), for DCO interfaces.
+         *
+         * @param cfg  DeviceConfig with the configuration to apply
+         */
+        void ApplyConfigurationDCO(const DeviceConfig& cfg);
+#endif
+
         /**
          *  Creates and applies a configuration to this virtual interface.
          *
@@ -191,6 +262,35 @@ namespace NetCfgProxy
          */
         void SetMtu(unsigned int mtu);
 
+        /**
+         * Change the MTU of the established device right away, without
+         * re-creating it
+         *
+         * @param mtu  unsigned int containing the new MTU value
+         */
+        void AdjustMTU(unsigned int mtu);
+
+        /**
+         * Start a packet capture of the established device.  Requires
+         * the netcfg service to run with --packet-capture.
+         *
+         * @param fd        File descriptor the pcapng capture is written
+         *                  to.  The caller keeps ownership of it.
+         * @param limits    NetCfg::PacketCapture::Limits of the capture,
+         *                  0 selects the service default
+         * @param filter    Classic BPF program selecting the packets, as
+         *                  produced by 'tcpdump -dd'.  Empty captures all.
+         * @param metadata  Key/values added as comments to the capture
+         */
+        void StartCapture(int fd, const NetCfg::PacketCapture::Limits& limits,
+                          const std::vector<struct sock_filter>& filter,
+                          const std::map<std::string, std::string>& metadata);
+
+        /**
+         * Stop the running packet capture of the device
+         */
+        void StopCapture();
+
         /**
          * Set The Layer of the device
          *
@@ -220,6 +320,20 @@ namespace NetCfgProxy
 
         NetCfgDeviceType GetDeviceType();
         std::string GetDeviceName();
+
+        /**
+         * @return Returns the CPU list, like "0-3,6", the traffic of the
+         *         established device is steered to.  Empty without CPU
+         *         steering.
+         */
+        std::string GetSteeringCPUs();
+
+        /**
+         * @return Returns the NUMA node of the interface the VPN traffic
+         *         leaves through, once the device is established.  Empty
+         *         if it has no node.
+         */
+        std::string GetEgressNumaNode();
         bool GetActive();
 
         std::vector<std::string> GetIPv4Addresses();
@@ -230,10 +344,34 @@ namespace NetCfgProxy
         std::vector<std::string> GetDNS();
         std::vector<std::string> GetDNSSearch();
 
+        /**
+         *  Retrieves the traffic counters of the device.  Empty unless
+         *  the netcfg service runs with --traffic-accounting.
+         *
+         * @return Returns a std::vector of NetCfg::TrafficCounter records
+         */
+        std::vector<NetCfg::TrafficCounter> GetTrafficAccounting();
+
         void SetRemoteAddress(const std::string& remote, bool ipv6);
     };
 
 #ifdef ENABLE_OVPNDCO
+    /**
+     *  Traffic counters of a single peer in the ovpn-dco kernel module
+     */
+    struct DCOPeerStats
+    {
+        uint32_t peer_id = 0;
+        uint64_t vpn_rx_bytes = 0;
+        uint64_t vpn_tx_bytes = 0;
+        uint64_t vpn_rx_packets = 0;
+        uint64_t vpn_tx_packets = 0;
+        uint64_t link_rx_bytes = 0;
+        uint64_t link_tx_bytes = 0;
+        uint64_t link_rx_packets = 0;
+        uint64_t link_tx_packets = 0;
+    };
+
     class DCO : public DBusProxy, public RC<thread_unsafe_refcount>
     {
     public:
@@ -275,6 +413,16 @@ namespace NetCfgProxy
          */
         void NewKey(unsigned int key_slot, const KoRekey::KeyConfig* kc);
 
+        /**
+         * Pass several crypto configurations into the kernel module
+         * using a single D-Bus call.
+         *
+         * @param keys  std::vector of key slot and KeyConfig pairs, see
+         *              NewKey() for details
+         */
+        void NewKeys(const std::vector<std::pair<unsigned int,
+                                                 const KoRekey::KeyConfig*>>& keys);
+
         /**
          * Swaps primary key with secondary key
          *
@@ -282,6 +430,23 @@ namespace NetCfgProxy
          */
         void SwapKeys(unsigned int peer_id);
 
+        /**
+         * Retrieves the traffic counters of all peers from the kernel
+         * module, read in a single request by the netcfg service.
+         *
+         * @return std::vector<DCOPeerStats> with the counters of each peer
+         */
+        std::vector<DCOPeerStats> GetPeerStats();
+
+        /**
+         * Retrieves the CPU usage of the netcfg thread serving the
+         * ovpn-dco devices.  This thread is shared by all the devices
+         * of the netcfg service.
+         *
+         * @return CpuUsage with the counters of the thread
+         */
+        CpuUsage GetWorkerUsage();
+
         /**
          * @brief Sets properties of peer
          *
@@ -155,6 +155,39 @@ namespace NetCfgProxy
         return ret;
     }
 
+    std::vector<std::string> Manager::ResolveRemote(const std::string& host)
+    {
+        try
+        {
+            GVariant *res = Call("ResolveRemote",
+                                 g_variant_new("(s)", host.c_str()));
+            GLibUtils::checkParams(__func__, res, "(as)", 1);
+
+            GVariantIter *addrlist = nullptr;
+            g_variant_get(res, "(as)", &addrlist);
+
+            GVariant *addr = nullptr;
+            std::vector<std::string> addresses;
+            while ((addr = g_variant_iter_next_value(addrlist)))
+            {
+                gsize len;
+                addresses.push_back(std::string(g_variant_get_string(addr, &len)));
+                g_variant_unref(addr);
+            }
+            g_variant_iter_free(addrlist);
+            g_variant_unref(res);
+            return addresses;
+        }
+        catch (NetCfgProxyException&)
+        {
+            throw;
+        }
+        catch (std::exception& excp)
+        {
+            throw NetCfgProxyException("ResolveRemote", excp.what());
+        }
+    }
+
     void Manager::Cleanup()
     {
         if (!CheckObjectExists())
@@ -71,6 +71,7 @@ namespace NetCfgProxy
         std::vector<std::string> FetchInterfaceList();
         bool ProtectSocket(int socket, const std::string& remote, bool ipv6, const std::string& devpath);
         bool DcoAvailable();
+        std::vector<std::string> ResolveRemote(const std::string& host);
         void Cleanup();
 
         void NotificationSubscribe(NetCfgChangeType filter_flags);
@@ -0,0 +1,182 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   queue-discipline.cpp
+ *
+ * @brief  Implementation of NetCfg::QueueDiscipline
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <linux/if_link.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+
+#include "netcfg-exception.hpp"
+#include "rtnl-request.hpp"
+#include "queue-discipline.hpp"
+
+
+namespace NetCfg
+{
+    //
+    //  struct QueueSettings
+    //
+
+    void QueueSettings::Merge(const QueueSettings& other)
+    {
+        if (!other.qdisc.empty())
+        {
+            qdisc = other.qdisc;
+        }
+        if (other.bandwidth > 0)
+        {
+            bandwidth = other.bandwidth;
+        }
+        if (other.txqueuelen > 0)
+        {
+            txqueuelen = other.txqueuelen;
+        }
+    }
+
+
+    void QueueSettings::Validate() const
+    {
+        if (!qdisc.empty() && "fq_codel" != qdisc && "cake" != qdisc)
+        {
+            throw NetCfgException("Unsupported qdisc '" + qdisc
+                                  + "', use fq_codel or cake");
+        }
+    }
+
+
+    std::string QueueSettings::str() const
+    {
+        std::stringstream s;
+        s << "qdisc: " << (qdisc.empty() ? "default" : qdisc)
+          << ", bandwidth: " << (bandwidth > 0 ? std::to_string(bandwidth) + " kbit/s"
+                                               : "unknown")
+          << ", txqueuelen: " << (txqueuelen > 0 ? std::to_string(txqueuelen)
+                                                 : "default");
+        return s.str();
+    }
+
+
+
+    //
+    //  class QueueDiscipline
+    //
+
+    void QueueDiscipline::Apply(const unsigned int ifindex,
+                                const QueueSettings& settings,
+                                const unsigned int mtu)
+    {
+        if (0 == ifindex)
+        {
+            throw NetCfgException("Device not found");
+        }
+
+        if (settings.txqueuelen > 0)
+        {
+            struct ifinfomsg ifi = {};
+            ifi.ifi_family = AF_UNSPEC;
+            ifi.ifi_index = ifindex;
+            uint32_t qlen = settings.txqueuelen;
+
+            std::vector<char> attrs;
+            Rtnl::AppendAttr(attrs, IFLA_TXQLEN, &qlen, sizeof(qlen));
+            int error = Rtnl::Request(RTM_NEWLINK, 0, &ifi, sizeof(ifi), attrs);
+            if (0 != error)
+            {
+                throw NetCfgException(std::string("Could not set txqueuelen: ")
+                                      + strerror(error));
+            }
+        }
+
+        if (settings.qdisc.empty())
+        {
+            return;
+        }
+
+        std::vector<char> opts;
+        if ("cake" == settings.qdisc)
+        {
+            if (settings.bandwidth > 0)
+            {
+                uint64_t rate = (uint64_t) settings.bandwidth * 1000 / 8;
+                Rtnl::AppendAttr(opts, TCA_CAKE_BASE_RATE64, &rate, sizeof(rate));
+            }
+        }
+        else if (settings.bandwidth > 0)
+        {
+            uint32_t target = CodelTarget(settings.bandwidth, mtu);
+            uint32_t interval = CodelInterval(target);
+            Rtnl::AppendAttr(opts, TCA_FQ_CODEL_TARGET, &target, sizeof(target));
+            Rtnl::AppendAttr(opts, TCA_FQ_CODEL_INTERVAL, &interval, sizeof(interval));
+        }
+
+        struct tcmsg tcm = {};
+        tcm.tcm_family = AF_UNSPEC;
+        tcm.tcm_ifindex = ifindex;
+        tcm.tcm_parent = TC_H_ROOT;
+
+        std::vector<char> attrs;
+        Rtnl::AppendAttr(attrs, TCA_KIND, settings.qdisc.c_str(),
+                         settings.qdisc.size() + 1);
+        Rtnl::AppendAttr(attrs, TCA_OPTIONS, opts.data(), opts.size());
+        int error = Rtnl::Request(RTM_NEWQDISC, NLM_F_CREATE | NLM_F_REPLACE,
+                                  &tcm, sizeof(tcm), attrs);
+        if (ENOENT == error)
+        {
+            throw NetCfgException("The " + settings.qdisc + " qdisc is not "
+                                  "available in this kernel");
+        }
+        else if (0 != error)
+        {
+            throw NetCfgException("Could not set the " + settings.qdisc
+                                  + " qdisc: " + strerror(error));
+        }
+    }
+
+
+    uint32_t QueueDiscipline::CodelTarget(const unsigned int bandwidth,
+                                          const unsigned int mtu)
+    {
+        uint64_t target = 5000;
+        if (bandwidth > 0)
+        {
+            // mtu * 8 bits / (bandwidth * 1000 bits/s) seconds, in µs
+            uint64_t packet_time = (uint64_t) mtu * 8 * 1000 / bandwidth;
+            target = std::max(target, packet_time * 3 / 2);
+        }
+        return (uint32_t) std::min(target, (uint64_t) UINT32_MAX / 20);
+    }
+
+
+    uint32_t QueueDiscipline::CodelInterval(const uint32_t target)
+    {
+        return std::max((uint32_t) 100000, target * 20);
+    }
+} // namespace NetCfg
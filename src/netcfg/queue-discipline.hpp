@@ -0,0 +1,123 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   queue-discipline.hpp
+ *
+ * @brief  Configures an active queue management qdisc and the transmit
+ *         queue length of a network device, to keep the latency through
+ *         the VPN low when the upload is saturated
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+namespace NetCfg
+{
+    /**
+     *  Queueing settings of a network device
+     */
+    struct QueueSettings
+    {
+        std::string qdisc;           ///< "fq_codel", "cake" or empty for the kernel default
+        unsigned int bandwidth = 0;  ///< Upload bandwidth hint in kbit/s, 0 if unknown
+        unsigned int txqueuelen = 0; ///< Transmit queue length, 0 keeps the current one
+
+
+        bool empty() const noexcept
+        {
+            return qdisc.empty() && 0 == bandwidth && 0 == txqueuelen;
+        }
+
+
+        /**
+         *  Take over the settings the other object has set, keeping the
+         *  settings of this object which are not set in the other object
+         */
+        void Merge(const QueueSettings& other);
+
+
+        /**
+         *  Checks the qdisc name.  Throws NetCfgException if invalid.
+         */
+        void Validate() const;
+
+
+        /**
+         *  Human readable summary of the settings, for log messages
+         */
+        std::string str() const;
+    };
+
+
+
+    /**
+     *  Applies QueueSettings to a network device via rtnetlink.  This
+     *  requires CAP_NET_ADMIN.
+     *
+     *  With "fq_codel", the bandwidth hint raises the CoDel target and
+     *  interval on slow links, where sending a single full sized packet
+     *  takes longer than the default 5 ms target.  With "cake", the
+     *  device is shaped to the bandwidth hint; set it slightly below the
+     *  real upload bandwidth, so the queue builds up in the VPN device
+     *  and not further down the path.
+     */
+    class QueueDiscipline
+    {
+    public:
+        /**
+         *  Sets the transmit queue length and replaces the root qdisc
+         *  of a device.  Throws NetCfgException on errors.
+         *
+         * @param ifindex   Interface index of the device
+         * @param settings  QueueSettings to apply
+         * @param mtu       MTU of the device, used with the bandwidth hint
+         */
+        static void Apply(const unsigned int ifindex,
+                          const QueueSettings& settings,
+                          const unsigned int mtu);
+
+
+        /**
+         *  Calculates the CoDel target delay for a link: at least 5 ms,
+         *  and at least one and a half times the time it takes to send a
+         *  packet of MTU size
+         *
+         * @param bandwidth  Link bandwidth in kbit/s, 0 if unknown
+         * @param mtu        MTU of the device
+         *
+         * @return Returns the target in microseconds
+         */
+        static uint32_t CodelTarget(const unsigned int bandwidth,
+                                    const unsigned int mtu);
+
+
+        /**
+         *  Calculates the CoDel interval for a target delay: at least
+         *  100 ms, and at least 20 times the target
+         *
+         * @param target  Target delay in microseconds
+         *
+         * @return Returns the interval in microseconds
+         */
+        static uint32_t CodelInterval(const uint32_t target);
+    };
+} // namespace NetCfg
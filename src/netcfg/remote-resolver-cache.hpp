@@ -0,0 +1,299 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   remote-resolver-cache.hpp
+ *
+ * @brief  Host wide cache of the resolved addresses of the VPN remote
+ *         servers, shared by all VPN backend processes
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <netdb.h>
+#include <sys/socket.h>
+
+
+namespace NetCfg
+{
+    /**
+     *  Keeps the addresses of the remote server host names the VPN
+     *  backends connect to.  When many backends reconnect at the same
+     *  time, each host name is only resolved once; concurrent lookups
+     *  of the same name wait for the one already running.
+     *
+     *  Failed lookups are kept for a shorter time, so a name which does
+     *  not resolve is not queried by each backend in turn.
+     *
+     *  The system resolver does not provide the TTL of the records, so
+     *  all entries are kept for the same fixed time.
+     *
+     *  All methods are thread-safe.
+     */
+    class RemoteResolverCache
+    {
+    public:
+        using Ptr = std::shared_ptr<RemoteResolverCache>;
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         *  Result of a lookup
+         */
+        struct Result
+        {
+            /// Numeric IPv4 and IPv6 addresses, in the resolver order
+            std::vector<std::string> addresses;
+
+            /// Error message if the name did not resolve
+            std::string error;
+        };
+
+        /// Resolves a host name, blocking
+        using ResolveFunc = std::function<Result(const std::string& host)>;
+
+
+        /**
+         * @param ttl           How long to keep resolved addresses
+         * @param negative_ttl  How long to keep failed lookups
+         * @param max_entries   Maximum number of host names to keep
+         * @param resolve       ResolveFunc doing the lookups
+         * @param now           Function returning the current time
+         */
+        RemoteResolverCache(std::chrono::seconds ttl,
+                            std::chrono::seconds negative_ttl,
+                            size_t max_entries = 256,
+                            ResolveFunc resolve = SystemResolve,
+                            std::function<Clock::time_point()> now = Clock::now)
+            : ttl(ttl), negative_ttl(negative_ttl),
+              max_entries(max_entries),
+              resolve(std::move(resolve)), now(std::move(now))
+        {
+        }
+
+
+        /**
+         *  Looks up a host name in the cache, without resolving it
+         *
+         * @param host    std::string with the host name
+         * @param result  Result where the cached result is stored
+         *
+         * @return Returns true if a valid result was cached
+         */
+        bool Cached(const std::string& host, Result& result)
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            auto it = entries.find(host);
+            if (it == entries.end() || it->second.expires <= now())
+            {
+                return false;
+            }
+            result = it->second.result;
+            return true;
+        }
+
+
+        /**
+         *  Retrieves the addresses of a host name, resolving it if it
+         *  is not cached.  This blocks while the name is resolved.
+         *
+         * @param host  std::string with the host name
+         *
+         * @return Returns the Result of the lookup
+         */
+        Result Lookup(const std::string& host)
+        {
+            std::shared_ptr<std::promise<Result>> promise;
+            std::shared_future<Result> pending;
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                auto it = entries.find(host);
+                if (it != entries.end() && it->second.expires > now())
+                {
+                    return it->second.result;
+                }
+                auto p = running.find(host);
+                if (p != running.end())
+                {
+                    pending = p->second;
+                }
+                else
+                {
+                    promise = std::make_shared<std::promise<Result>>();
+                    running[host] = promise->get_future().share();
+                }
+            }
+            if (pending.valid())
+            {
+                return pending.get();
+            }
+
+            Result res;
+            try
+            {
+                res = resolve(host);
+            }
+            catch (const std::exception& excp)
+            {
+                res.addresses.clear();
+                res.error = excp.what();
+            }
+            if (res.addresses.empty() && res.error.empty())
+            {
+                res.error = "No addresses found";
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                running.erase(host);
+                const std::chrono::seconds keep = (res.addresses.empty()
+                                                   ? negative_ttl : ttl);
+                if (keep.count() > 0)
+                {
+                    make_room();
+                    entries[host] = Entry{res, now() + keep};
+                }
+            }
+            promise->set_value(res);
+            return res;
+        }
+
+
+        /**
+         *  Forgets all the cached host names, like after the host DNS
+         *  resolver configuration changed
+         */
+        void Flush()
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            entries.clear();
+        }
+
+
+        /**
+         * @return Returns the number of host names cached, including
+         *         expired ones not yet removed
+         */
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            return entries.size();
+        }
+
+
+        /**
+         *  Resolves a host name via the system resolver
+         *
+         * @param host  std::string with the host name
+         *
+         * @return Returns the Result of the lookup
+         */
+        static Result SystemResolve(const std::string& host)
+        {
+            struct addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_DGRAM;
+
+            Result ret;
+            struct addrinfo *res = nullptr;
+            int r = ::getaddrinfo(host.c_str(), nullptr, &hints, &res);
+            if (0 != r)
+            {
+                ret.error = gai_strerror(r);
+                return ret;
+            }
+            for (struct addrinfo *ai = res; ai; ai = ai->ai_next)
+            {
+                char addr[NI_MAXHOST];
+                if (0 == ::getnameinfo(ai->ai_addr, ai->ai_addrlen,
+                                       addr, sizeof(addr), nullptr, 0,
+                                       NI_NUMERICHOST))
+                {
+                    ret.addresses.push_back(addr);
+                }
+            }
+            ::freeaddrinfo(res);
+            return ret;
+        }
+
+
+    private:
+        struct Entry
+        {
+            Result result;
+            Clock::time_point expires;
+        };
+
+        mutable std::mutex mtx;
+        const std::chrono::seconds ttl;
+        const std::chrono::seconds negative_ttl;
+        const size_t max_entries;
+        ResolveFunc resolve;
+        std::function<Clock::time_point()> now;
+        std::map<std::string, Entry> entries;
+        std::map<std::string, std::shared_future<Result>> running;
+
+
+        /**
+         *  Makes room for a new entry, first by removing the expired
+         *  entries, then the one expiring first.  Called with the lock
+         *  held.
+         */
+        void make_room()
+        {
+            if (entries.size() < max_entries)
+            {
+                return;
+            }
+            const Clock::time_point t = now();
+            for (auto it = entries.begin(); it != entries.end(); )
+            {
+                if (it->second.expires <= t)
+                {
+                    it = entries.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            while (!entries.empty() && entries.size() >= max_entries)
+            {
+                auto oldest = entries.begin();
+                for (auto it = entries.begin(); it != entries.end(); ++it)
+                {
+                    if (it->second.expires < oldest->second.expires)
+                    {
+                        oldest = it;
+                    }
+                }
+                entries.erase(oldest);
+            }
+        }
+    };
+} // namespace NetCfg
@@ -0,0 +1,108 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   rtnl-request.cpp
+ *
+ * @brief  Implementation of the single rtnetlink requests
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "rtnl-request.hpp"
+
+
+namespace NetCfg
+{
+    namespace Rtnl
+    {
+        int Request(const uint16_t type, const uint16_t flags,
+                    const void *hdr, const size_t hdr_len,
+                    const std::vector<char>& attrs)
+        {
+            int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+            if (sock < 0)
+            {
+                return errno;
+            }
+
+            std::vector<char> buf(NLMSG_SPACE(hdr_len));
+            buf.insert(buf.end(), attrs.begin(), attrs.end());
+            struct nlmsghdr *nh = reinterpret_cast<struct nlmsghdr *>(buf.data());
+            nh->nlmsg_len = buf.size();
+            nh->nlmsg_type = type;
+            nh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+            nh->nlmsg_seq = 1;
+            memcpy(NLMSG_DATA(nh), hdr, hdr_len);
+
+            struct sockaddr_nl kernel = {};
+            kernel.nl_family = AF_NETLINK;
+            if (sendto(sock, buf.data(), buf.size(), 0,
+                       reinterpret_cast<struct sockaddr *>(&kernel),
+                       sizeof(kernel)) < 0)
+            {
+                int error = errno;
+                close(sock);
+                return error;
+            }
+
+            std::vector<char> resp(8192);
+            int error = EPROTO;
+            while (true)
+            {
+                ssize_t len = recv(sock, resp.data(), resp.size(), 0);
+                if (len < 0)
+                {
+                    if (EINTR == errno)
+                    {
+                        continue;
+                    }
+                    error = errno;
+                    break;
+                }
+                int remain = len;
+                struct nlmsghdr *r = reinterpret_cast<struct nlmsghdr *>(resp.data());
+                if (NLMSG_OK(r, remain) && NLMSG_ERROR == r->nlmsg_type)
+                {
+                    error = -static_cast<struct nlmsgerr *>(NLMSG_DATA(r))->error;
+                    break;
+                }
+            }
+            close(sock);
+            return error;
+        }
+
+
+        void AppendAttr(std::vector<char>& buf, const unsigned short type,
+                        const void *data, const size_t len)
+        {
+            size_t start = buf.size();
+            buf.resize(start + RTA_SPACE(len));
+            struct rtattr *rta = reinterpret_cast<struct rtattr *>(&buf[start]);
+            rta->rta_type = type;
+            rta->rta_len = RTA_LENGTH(len);
+            memcpy(RTA_DATA(rta), data, len);
+        }
+    } // namespace Rtnl
+} // namespace NetCfg
@@ -0,0 +1,69 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   rtnl-request.hpp
+ *
+ * @brief  Single rtnetlink requests, used for the traffic control and
+ *         link settings of the VPN devices
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace NetCfg
+{
+    namespace Rtnl
+    {
+        /**
+         *  Sends a single request over rtnetlink and waits for the
+         *  acknowledgement
+         *
+         * @param type     Netlink message type, like RTM_NEWQDISC
+         * @param flags    Netlink message flags in addition to
+         *                 NLM_F_REQUEST and NLM_F_ACK
+         * @param hdr      The family specific header of the request,
+         *                 like struct tcmsg
+         * @param hdr_len  Size of the header
+         * @param attrs    Attributes following the header
+         *
+         * @return Returns 0 on success, otherwise the errno value of the
+         *         failure
+         */
+        int Request(const uint16_t type, const uint16_t flags,
+                    const void *hdr, const size_t hdr_len,
+                    const std::vector<char>& attrs);
+
+
+        /**
+         *  Appends an attribute to a request.  Nested attributes are
+         *  added by passing the buffer of the inner attributes as data.
+         *
+         * @param buf   Attribute buffer to extend
+         * @param type  Attribute type
+         * @param data  Attribute value
+         * @param len   Size of the value
+         */
+        void AppendAttr(std::vector<char>& buf, const unsigned short type,
+                        const void *data, const size_t len);
+    } // namespace Rtnl
+} // namespace NetCfg
@@ -0,0 +1,259 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   tun-pool.cpp
+ *
+ * @brief  Pool of tun devices created ahead of the VPN sessions needing
+ *         them (implementation)
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <linux/rtnetlink.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "netcfg-exception.hpp"
+#include "rtnl-request.hpp"
+#include "tun-pool.hpp"
+
+
+namespace NetCfg
+{
+    /// Name pattern of the devices waiting in the pool
+    static const char *pool_name_pattern = "ovpn3pool%d";
+
+    /// Name pattern of the devices taken from the pool, as used by the
+    /// kernel for devices created without a name
+    static const char *tun_name_pattern = "tun%d";
+
+    /// Delay before retrying after creating a device failed
+    static const std::chrono::seconds create_retry(10);
+
+
+    static TunPool::Device create_device()
+    {
+        TunPool::Device dev;
+        dev.fd = ::open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+        if (dev.fd < 0)
+        {
+            throw NetCfgException("Could not open /dev/net/tun: "
+                                  + std::string(strerror(errno)));
+        }
+
+        // The same flags as the Core library uses when it attaches
+        struct ifreq ifr = {};
+        ifr.ifr_flags = IFF_TUN | IFF_NO_PI | IFF_ONE_QUEUE;
+        std::strncpy(ifr.ifr_name, pool_name_pattern, IFNAMSIZ - 1);
+        if (::ioctl(dev.fd, TUNSETIFF, &ifr) < 0)
+        {
+            int err = errno;
+            ::close(dev.fd);
+            throw NetCfgException("Could not create tun device: "
+                                  + std::string(strerror(err)));
+        }
+        dev.name = ifr.ifr_name;
+        return dev;
+    }
+
+
+    static std::string activate_device(const TunPool::Device& dev)
+    {
+        unsigned int ifindex = if_nametoindex(dev.name.c_str());
+        if (0 == ifindex)
+        {
+            ::close(dev.fd);
+            throw NetCfgException("Pooled device " + dev.name + " vanished");
+        }
+
+        // Keep the device once its file descriptor is closed, so the
+        // Core library can attach to it
+        if (::ioctl(dev.fd, TUNSETPERSIST, 1) < 0)
+        {
+            int err = errno;
+            ::close(dev.fd);
+            throw NetCfgException("Could not make " + dev.name + " persistent: "
+                                  + std::string(strerror(err)));
+        }
+        ::close(dev.fd);
+
+        struct ifinfomsg ifi = {};
+        ifi.ifi_family = AF_UNSPEC;
+        ifi.ifi_index = ifindex;
+        std::vector<char> attrs;
+        Rtnl::AppendAttr(attrs, IFLA_IFNAME, tun_name_pattern,
+                         std::strlen(tun_name_pattern) + 1);
+        int error = Rtnl::Request(RTM_NEWLINK, 0, &ifi, sizeof(ifi), attrs);
+
+        char name[IF_NAMESIZE] = {};
+        if (0 != error || !if_indextoname(ifindex, name))
+        {
+            TunPool::Remove(dev.name);
+            throw NetCfgException("Could not rename " + dev.name + ": "
+                                  + std::string(strerror(error ? error : errno)));
+        }
+        return name;
+    }
+
+
+    static void discard_device(const TunPool::Device& dev)
+    {
+        // Not persistent; the device goes away with the file descriptor
+        ::close(dev.fd);
+    }
+
+
+    TunPool::Operations TunPool::SystemOperations()
+    {
+        return {create_device, activate_device, discard_device};
+    }
+
+
+    bool TunPool::ReleasePersist(const int fd)
+    {
+        return 0 == ::ioctl(fd, TUNSETPERSIST, 0);
+    }
+
+
+    void TunPool::Remove(const std::string& name)
+    {
+        unsigned int ifindex = if_nametoindex(name.c_str());
+        if (0 == ifindex)
+        {
+            return;
+        }
+        struct ifinfomsg ifi = {};
+        ifi.ifi_family = AF_UNSPEC;
+        ifi.ifi_index = ifindex;
+        Rtnl::Request(RTM_DELLINK, 0, &ifi, sizeof(ifi), {});
+    }
+
+
+    TunPool::TunPool(const unsigned int size, Operations ops)
+        : size(size), ops(std::move(ops))
+    {
+        replenisher = std::thread([this]()
+                                  {
+                                      replenish();
+                                  });
+    }
+
+
+    TunPool::~TunPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        replenisher.join();
+
+        for (const auto& dev : devices)
+        {
+            ops.discard(dev);
+        }
+    }
+
+
+    std::string TunPool::Take()
+    {
+        while (true)
+        {
+            Device dev;
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                if (devices.empty())
+                {
+                    return "";
+                }
+                dev = devices.front();
+                devices.pop_front();
+            }
+            cv.notify_all();
+
+            try
+            {
+                return ops.activate(dev);
+            }
+            catch (const NetCfgException& excp)
+            {
+                // Try the next one; the caller falls back to creating
+                // a new device when the pool runs empty
+                std::cerr << "** WARNING ** tun device pool: "
+                          << excp.what() << std::endl;
+            }
+        }
+    }
+
+
+    size_t TunPool::GetAvailable() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return devices.size();
+    }
+
+
+    void TunPool::replenish()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!stop)
+        {
+            if (devices.size() >= size)
+            {
+                cv.wait(lock);
+                continue;
+            }
+
+            lock.unlock();
+            Device dev;
+            bool created = false;
+            try
+            {
+                dev = ops.create();
+                created = true;
+            }
+            catch (const NetCfgException& excp)
+            {
+                std::cerr << "** ERROR ** tun device pool: "
+                          << excp.what() << std::endl;
+            }
+            lock.lock();
+
+            if (created)
+            {
+                devices.push_back(dev);
+            }
+            else
+            {
+                cv.wait_for(lock, create_retry, [this]()
+                                               {
+                                                   return stop;
+                                               });
+            }
+        }
+    }
+} // namespace NetCfg
@@ -0,0 +1,159 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   tun-pool.hpp
+ *
+ * @brief  Pool of tun devices created ahead of the VPN sessions needing
+ *         them (declaration)
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+namespace NetCfg
+{
+    /**
+     *  Keeps a number of layer 3 tun devices created and down, so the
+     *  Establish call of a VPN session does not have to wait for a new
+     *  network device to be registered.  This matters when many
+     *  sessions reconnect at the same time.
+     *
+     *  Each pooled device is created under a pool name and held by an
+     *  open file descriptor, so the kernel removes it when this process
+     *  exits.  Take() makes a device persistent, releases the file
+     *  descriptor and renames the device with the usual tun%d pattern.
+     *  The OpenVPN 3 Core library then attaches to the device by name
+     *  instead of creating a new one.  Once it has done that, the caller
+     *  must clear the persistent flag again with ReleasePersist(), so
+     *  the device goes away with its last file descriptor just as a
+     *  device created by the Core library does.
+     *
+     *  Taken devices are replaced by a background thread.
+     */
+    class TunPool
+    {
+    public:
+        using Ptr = std::shared_ptr<TunPool>;
+
+        /**
+         *  A pooled device
+         */
+        struct Device
+        {
+            int fd = -1;       ///< File descriptor holding the device
+            std::string name;  ///< Pool name of the device
+        };
+
+        /**
+         *  Device operations, replaceable for testing
+         */
+        struct Operations
+        {
+            /// Creates a device; throws NetCfgException on errors
+            std::function<Device()> create;
+
+            /// Prepares a device for use and returns its new name;
+            /// throws NetCfgException on errors
+            std::function<std::string(const Device&)> activate;
+
+            /// Removes a device which is not used
+            std::function<void(const Device&)> discard;
+        };
+
+
+        /**
+         * @return Returns the Operations on real tun devices
+         */
+        static Operations SystemOperations();
+
+
+        /**
+         *  Clears the persistent flag of a device taken from the pool
+         *
+         * @param fd  File descriptor attached to the device
+         *
+         * @return Returns true on success
+         */
+        static bool ReleasePersist(const int fd);
+
+
+        /**
+         *  Removes a device taken from the pool which could not be used.
+         *  Errors are ignored.
+         *
+         * @param name  Name of the device, as returned by Take()
+         */
+        static void Remove(const std::string& name);
+
+
+        /**
+         *  Starts filling the pool in the background
+         *
+         * @param size  Number of devices to keep ready
+         * @param ops   Operations used to create and use devices
+         */
+        TunPool(const unsigned int size,
+                Operations ops = SystemOperations());
+
+        /**
+         *  Stops the background thread and removes all pooled devices
+         */
+        ~TunPool();
+
+        TunPool(const TunPool&) = delete;
+        TunPool& operator=(const TunPool&) = delete;
+
+
+        /**
+         *  Takes a device from the pool.  Never blocks waiting for a new
+         *  device.
+         *
+         * @return Returns the name of the device, or an empty string if
+         *         no device is ready
+         */
+        std::string Take();
+
+
+        /**
+         * @return Returns the number of devices ready to be taken
+         */
+        size_t GetAvailable() const;
+
+
+    private:
+        const unsigned int size;
+        const Operations ops;
+        mutable std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<Device> devices;
+        bool stop = false;
+        std::thread replenisher;
+
+        void replenish();
+    };
+} // namespace NetCfg
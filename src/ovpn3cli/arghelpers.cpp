@@ -23,73 +23,124 @@
  * @brief  Argument helper functions, used by the shell-completion feature
  *
  */
-
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <sstream>
 
 #include "configmgr/proxy-configmgr.hpp"
 #include "common/cmdargparser.hpp"
 #include "sessionmgr/proxy-sessionmgr.hpp"
+#include "ovpn3cli/completion-cache.hpp"
+
 
 /**
- * Retrieves a list of available configuration paths
+ *  Runs a D-Bus based completion lookup through the per-user
+ *  CompletionCache.  The cached value is used as long as the change
+ *  counter of the service is unchanged.  If the counter cannot be read,
+ *  typically when running against an older service, the lookup is done
+ *  directly.
  *
- * @return std::string with all available paths, each separated by space
+ * @param key      Name of the cached value
+ * @param counter  Function retrieving the change counter of the service
+ * @param lookup   Function doing the lookup
+ *
+ * @return std::string with the completion values
  */
-std::string arghelper_config_paths()
+static std::string cached_lookup(const std::string& key,
+                                 std::function<uint64_t()> counter,
+                                 std::function<std::string()> lookup)
 {
-    OpenVPN3ConfigurationProxy confmgr(G_BUS_TYPE_SYSTEM, OpenVPN3DBus_rootp_configuration);
+    uint64_t cnt = 0;
+    try
+    {
+        cnt = counter();
+    }
+    catch (const DBusException&)
+    {
+        return lookup();
+    }
 
-    std::stringstream res;
-    for (auto& cfg : confmgr.FetchAvailableConfigs())
+    CompletionCache cache(CompletionCache::DefaultDirectory());
+    std::string value;
+    if (cache.Lookup(key, cnt, value))
     {
-        if (cfg.empty())
-        {
-            continue;
-        }
-        res << cfg << " ";
+        return value;
     }
-    return res.str();
+    value = lookup();
+    cache.Store(key, cnt, value);
+    return value;
+}
+
+
+static uint64_t configmgr_change_counter(DBus& conn)
+{
+    OpenVPN3ConfigurationProxy confmgr(conn, OpenVPN3DBus_rootp_configuration);
+    return confmgr.GetUInt64Property("change_counter");
+}
+
+
+static uint64_t sessionmgr_change_counter(DBus& conn)
+{
+    OpenVPN3SessionMgrProxy sessmgr(conn);
+    return sessmgr.GetUInt64Property("change_counter");
 }
 
 
 /**
- * Retrieves a list of all available configuration profile names
+ * Retrieves a list of available configuration paths
  *
- * @return std::string with all available profile names, each separated
- *         by space
+ * @return std::string with all available paths, each separated by space
  */
-std::string arghelper_config_names()
+std::string arghelper_config_paths()
 {
     DBus conn(G_BUS_TYPE_SYSTEM);
     conn.Connect();
-    OpenVPN3ConfigurationProxy confmgr(conn, OpenVPN3DBus_rootp_configuration);
+    return cached_lookup("config-paths",
+                         [&conn]()
+                         {
+                             return configmgr_change_counter(conn);
+                         },
+                         [&conn]()
+                         {
+                             OpenVPN3ConfigurationProxy confmgr(conn, OpenVPN3DBus_rootp_configuration);
+
+                             std::stringstream res;
+                             for (auto& cfg : confmgr.FetchAvailableConfigs())
+                             {
+                                 if (cfg.empty())
+                                 {
+                                     continue;
+                                 }
+                                 res << cfg << " ";
+                             }
+                             return res.str();
+                         });
+}
 
-    std::vector<std::string> cfgnames;
-    for (const auto& cfgp : confmgr.FetchAvailableConfigs())
-    {
-        OpenVPN3ConfigurationProxy cfg(conn, cfgp);
-        std::string cfgname = cfg.GetStringProperty("name");
 
+/**
+ *  Generates a space separated list of unique, non-empty names
+ *
+ * @param names  std::vector<std::string> with the names, in order
+ *
+ * @return std::string with each name followed by a space
+ */
+static std::string unique_names(const std::vector<std::string>& names)
+{
+    std::vector<std::string> uniq;
+    for (const auto& n : names)
+    {
         // Filter out duplicates
-        bool found = false;
-        for (const auto& chk : cfgnames)
+        if (std::find(uniq.begin(), uniq.end(), n) == uniq.end())
         {
-            if (chk == cfgname)
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
-        {
-            cfgnames.push_back(cfgname);
+            uniq.push_back(n);
         }
     }
 
     // Generate the final string which will be returned
     std::stringstream res;
-    for (const auto& n : cfgnames)
+    for (const auto& n : uniq)
     {
         if (n.empty())
         {
@@ -101,6 +152,35 @@ std::string arghelper_config_names()
 }
 
 
+/**
+ * Retrieves a list of all available configuration profile names
+ *
+ * @return std::string with all available profile names, each separated
+ *         by space
+ */
+std::string arghelper_config_names()
+{
+    DBus conn(G_BUS_TYPE_SYSTEM);
+    conn.Connect();
+    return cached_lookup("config-names",
+                         [&conn]()
+                         {
+                             return configmgr_change_counter(conn);
+                         },
+                         [&conn]()
+                         {
+                             OpenVPN3ConfigurationProxy confmgr(conn, OpenVPN3DBus_rootp_configuration);
+
+                             std::vector<std::string> cfgnames;
+                             for (const auto& cfg : confmgr.FetchAvailableConfigsDetailed())
+                             {
+                                 cfgnames.push_back(cfg.name);
+                             }
+                             return unique_names(cfgnames);
+                         });
+}
+
+
 /**
  * Retrieves a list of available configuration paths
  *
@@ -108,35 +188,55 @@ std::string arghelper_config_names()
  */
 std::string arghelper_session_paths()
 {
-    OpenVPN3SessionMgrProxy sessmgr(G_BUS_TYPE_SYSTEM);
+    DBus conn(G_BUS_TYPE_SYSTEM);
+    conn.Connect();
+    return cached_lookup("session-paths",
+                         [&conn]()
+                         {
+                             return sessionmgr_change_counter(conn);
+                         },
+                         [&conn]()
+                         {
+                             OpenVPN3SessionMgrProxy sessmgr(conn);
 
-    std::stringstream res;
-    for (auto& session : sessmgr.FetchAvailableSessionPaths())
-    {
-        if (session.empty())
-        {
-            continue;
-        }
-        res << session << " ";
-    }
-    return res.str();
+                             std::stringstream res;
+                             for (auto& session : sessmgr.FetchAvailableSessionPaths())
+                             {
+                                 if (session.empty())
+                                 {
+                                     continue;
+                                 }
+                                 res << session << " ";
+                             }
+                             return res.str();
+                         });
 }
 
 
 std::string arghelper_managed_interfaces()
 {
-    OpenVPN3SessionMgrProxy sessmgr(G_BUS_TYPE_SYSTEM);
+    DBus conn(G_BUS_TYPE_SYSTEM);
+    conn.Connect();
+    return cached_lookup("managed-interfaces",
+                         [&conn]()
+                         {
+                             return sessionmgr_change_counter(conn);
+                         },
+                         [&conn]()
+                         {
+                             OpenVPN3SessionMgrProxy sessmgr(conn);
 
-    std::stringstream res;
-    for (const auto& dev : sessmgr.FetchManagedInterfaces())
-    {
-        if (dev.empty())
-        {
-            continue;
-        }
-        res << dev << " ";
-    }
-    return res.str();
+                             std::stringstream res;
+                             for (const auto& dev : sessmgr.FetchManagedInterfaces())
+                             {
+                                 if (dev.empty())
+                                 {
+                                     continue;
+                                 }
+                                 res << dev << " ";
+                             }
+                             return res.str();
+                         });
 }
 
 /**
@@ -150,41 +250,23 @@ std::string arghelper_config_names_sessions()
 {
     DBus conn(G_BUS_TYPE_SYSTEM);
     conn.Connect();
-    OpenVPN3SessionMgrProxy sessmgr(conn);
-
-    std::vector<std::string> cfgnames;
-    for (const auto& sesp : sessmgr.FetchAvailableSessionPaths())
-    {
-        OpenVPN3SessionProxy sess(conn, sesp);
-        std::string cfgname = sess.GetStringProperty("config_name");
-
-        // Filter out duplicates
-        bool found = false;
-        for (const auto& chk : cfgnames)
-        {
-            if (chk == cfgname)
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
-        {
-            cfgnames.push_back(cfgname);
-        }
-    }
+    return cached_lookup("session-config-names",
+                         [&conn]()
+                         {
+                             return sessionmgr_change_counter(conn);
+                         },
+                         [&conn]()
+                         {
+                             OpenVPN3SessionMgrProxy sessmgr(conn);
 
-    // Generate the final string which will be returned
-    std::stringstream res;
-    for (const auto& n : cfgnames)
-    {
-        if (n.empty())
-        {
-            continue;
-        }
-        res << n << " ";
-    }
-    return res.str();
+                             std::vector<std::string> cfgnames;
+                             for (const auto& sesp : sessmgr.FetchAvailableSessionPaths())
+                             {
+                                 OpenVPN3SessionProxy sess(conn, sesp);
+                                 cfgnames.push_back(sess.GetStringProperty("config_name"));
+                             }
+                             return unique_names(cfgnames);
+                         });
 }
 
 
@@ -0,0 +1,224 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   batch.cpp
+ *
+ * @brief  Runs several openvpn3 commands read from a file or stdin
+ *         within a single process, sharing one D-Bus connection
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <json/json.h>
+
+#include "dbus/core.hpp"
+#include "dbus/proxy.hpp"
+#include "common/cmdargparser.hpp"
+#include "commands.hpp"
+
+
+/**
+ *  Redirects std::cout and std::cerr into string buffers for as long
+ *  as this object exists
+ */
+class CaptureOutput
+{
+public:
+    CaptureOutput()
+        : orig_out(std::cout.rdbuf(out.rdbuf())),
+          orig_err(std::cerr.rdbuf(err.rdbuf()))
+    {
+    }
+
+    ~CaptureOutput()
+    {
+        std::cout.rdbuf(orig_out);
+        std::cerr.rdbuf(orig_err);
+    }
+
+    std::string GetStdout() const
+    {
+        return out.str();
+    }
+
+    std::string GetStderr() const
+    {
+        return err.str();
+    }
+
+private:
+    std::ostringstream out;
+    std::ostringstream err;
+    std::streambuf *orig_out;
+    std::streambuf *orig_err;
+};
+
+
+/**
+ *  Runs a single line of the batch input
+ *
+ * @param arg0  std::string with the program name
+ * @param line  std::string with the command and its options, split up
+ *              the same way a shell would do it
+ * @param res   Json::Value where the exit code and the output of the
+ *              command is stored
+ */
+static void run_batch_line(const std::string& arg0, const std::string& line,
+                           Json::Value& res)
+{
+    gint cmd_argc = 0;
+    gchar **cmd_argv = nullptr;
+    GError *err = nullptr;
+    if (!g_shell_parse_argv(line.c_str(), &cmd_argc, &cmd_argv, &err))
+    {
+        res["exit_code"] = 1;
+        res["stderr"] = std::string("Invalid command line: ")
+                        + (err ? err->message : "parse error");
+        if (err)
+        {
+            g_error_free(err);
+        }
+        return;
+    }
+
+    if ("batch" == std::string(cmd_argv[0]))
+    {
+        res["exit_code"] = 1;
+        res["stderr"] = "The batch command cannot be used in batch mode";
+        g_strfreev(cmd_argv);
+        return;
+    }
+
+    // The command line parser expects the program name in argv[0]
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(arg0.c_str()));
+    for (gint i = 0; i < cmd_argc; ++i)
+    {
+        argv.push_back(cmd_argv[i]);
+    }
+    argv.push_back(nullptr);
+
+    int ec = 0;
+    std::string out;
+    std::string errout;
+    {
+        CaptureOutput capture;
+        ec = ovpn3cli_process_command_line((int) argv.size() - 1, argv.data());
+        std::cout.flush();
+        std::cerr.flush();
+        out = capture.GetStdout();
+        errout = capture.GetStderr();
+    }
+    g_strfreev(cmd_argv);
+
+    res["exit_code"] = ec;
+    res["stdout"] = out;
+    res["stderr"] = errout;
+}
+
+
+/**
+ *  openvpn3 batch
+ *
+ *  Reads one command per line and runs it.  The result of each command
+ *  is written to stdout as a single line JSON object.
+ *
+ * @param args  ParsedArgs object containing all related options and
+ *              arguments
+ *
+ * @return Returns 0 if all commands succeeded, otherwise 1
+ */
+static int cmd_batch(ParsedArgs::Ptr args)
+{
+    std::ifstream input_file;
+    if (args->Present("file") && "-" != args->GetValue("file", 0))
+    {
+        input_file.open(args->GetValue("file", 0));
+        if (!input_file.is_open())
+        {
+            throw CommandException("batch", "Could not open '"
+                                   + args->GetValue("file", 0) + "'");
+        }
+    }
+    std::istream& input = input_file.is_open() ? input_file : std::cin;
+    bool stop_on_error = args->Present("stop-on-error");
+
+    // All the commands use the same D-Bus connection, which is kept open
+    // for as long as this object exists.  The services are only checked
+    // once per connection, by the first command using each of them.
+    DBus dbuscon(G_BUS_TYPE_SYSTEM);
+    dbuscon.Connect();
+
+    Json::StreamWriterBuilder wr;
+    wr["indentation"] = "";
+
+    int ret = 0;
+    unsigned int lineno = 0;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        ++lineno;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (std::string::npos == start || '#' == line[start])
+        {
+            continue;
+        }
+
+        Json::Value res;
+        res["line"] = lineno;
+        res["command"] = line.substr(start);
+        run_batch_line(args->GetArgv0(), line, res);
+        std::cout << Json::writeString(wr, res) << std::endl;
+
+        if (0 != res["exit_code"].asInt())
+        {
+            ret = 1;
+            if (stop_on_error)
+            {
+                break;
+            }
+        }
+    }
+
+    return ret;
+}
+
+
+/**
+ *  Creates the SingleCommand object for the 'batch' command
+ *
+ * @return  Returns a SingleCommand::Ptr object declaring the command
+ */
+SingleCommand::Ptr prepare_command_batch()
+{
+    SingleCommand::Ptr cmd;
+    cmd.reset(new SingleCommand("batch",
+                                "Run several commands, read from a file "
+                                "or stdin",
+                                cmd_batch));
+    cmd->AddOption("file", 'f', "FILE", true,
+                   "Read the commands from FILE instead of stdin");
+    cmd->AddOption("stop-on-error",
+                   "Stop at the first command which fails");
+
+    return cmd;
+}
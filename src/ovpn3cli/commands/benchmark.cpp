@@ -0,0 +1,808 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   benchmark.cpp
+ *
+ * @brief  Measures the cost of the data channel ciphers, the TLS
+ *         handshake and the tls-crypt/tls-crypt-v2 control channel
+ *         protection with the crypto library OpenVPN 3 is linked with
+ */
+
+#ifdef USE_OPENSSL
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <time.h>
+
+#include <json/json.h>
+
+#include "common/cmdargparser.hpp"
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define TLS_method SSLv23_method
+#endif
+
+
+/**
+ *  Measures the wall clock and process CPU time of a benchmark loop.
+ *  The loop runs until the requested duration has passed.
+ */
+class BenchTimer
+{
+public:
+    BenchTimer(const double duration)
+        : duration(duration),
+          start(std::chrono::steady_clock::now()),
+          start_cpu(cpu_time())
+    {
+    }
+
+
+    /**
+     *  Counts one iteration
+     *
+     * @return Returns true while the loop should continue
+     */
+    bool Next()
+    {
+        // Reading the clock is not free; only check it now and then
+        if (0 != (++iterations % 16))
+        {
+            return true;
+        }
+        return Elapsed() < duration;
+    }
+
+
+    double Elapsed() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                             - start).count();
+    }
+
+
+    double CpuTime() const
+    {
+        return cpu_time() - start_cpu;
+    }
+
+
+    uint64_t Iterations() const noexcept
+    {
+        return iterations;
+    }
+
+
+private:
+    const double duration;
+    const std::chrono::steady_clock::time_point start;
+    const double start_cpu;
+    uint64_t iterations = 0;
+
+    static double cpu_time()
+    {
+        struct timespec ts = {};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+};
+
+
+/**
+ *  Builds the JSON result of a throughput measurement
+ */
+static Json::Value throughput_result(const BenchTimer& timer, const size_t size)
+{
+    double secs = timer.Elapsed();
+    uint64_t bytes = timer.Iterations() * size;
+
+    Json::Value ret;
+    ret["packets"] = (Json::Value::UInt64) timer.Iterations();
+    ret["gbit_per_sec"] = (bytes * 8.0) / secs / 1e9;
+    ret["packets_per_sec"] = timer.Iterations() / secs;
+    ret["cpu_ns_per_byte"] = timer.CpuTime() * 1e9 / bytes;
+    return ret;
+}
+
+
+static std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> ret;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+        {
+            ret.push_back(item);
+        }
+    }
+    return ret;
+}
+
+
+static std::string openssl_error()
+{
+    unsigned long err = ERR_get_error();
+    if (0 == err)
+    {
+        return "(unknown)";
+    }
+    char buf[256];
+    ERR_error_string_n(err, buf, sizeof(buf));
+    ERR_clear_error();
+    return buf;
+}
+
+
+using CipherCtxPtr = std::unique_ptr<EVP_CIPHER_CTX, decltype(&EVP_CIPHER_CTX_free)>;
+using PKeyPtr = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+using X509Ptr = std::unique_ptr<X509, decltype(&X509_free)>;
+using SSLCtxPtr = std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)>;
+
+
+/**
+ *  Measures the encryption and decryption throughput of an AEAD data
+ *  channel cipher, with the same IV and additional data layout as the
+ *  P_DATA_V2 packets
+ *
+ * @param cipher_name  std::string with the cipher name
+ * @param size         Payload size of each packet
+ * @param duration     Seconds to run each direction
+ *
+ * @return Returns a Json::Value with the encrypt and decrypt results
+ */
+static Json::Value bench_cipher(const std::string& cipher_name,
+                                const size_t size, const double duration)
+{
+    const EVP_CIPHER *cipher = EVP_get_cipherbyname(cipher_name.c_str());
+    if (!cipher || !(EVP_CIPHER_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER))
+    {
+        throw CommandException("benchmark",
+                               "Not a supported AEAD cipher: " + cipher_name);
+    }
+
+    CipherCtxPtr ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free);
+    uint8_t key[32];
+    uint8_t iv[12];
+    uint8_t aad[8] = {9 << 3, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t tag[16];
+    RAND_bytes(key, sizeof(key));
+    RAND_bytes(iv, sizeof(iv));
+    std::vector<uint8_t> plain(size, 0x5a);
+    std::vector<uint8_t> enc(size + 16);
+    std::vector<uint8_t> dec(size + 16);
+    int outl = 0;
+    int finl = 0;
+
+    Json::Value ret;
+    {
+        BenchTimer timer(duration);
+        uint32_t pid = 0;
+        do
+        {
+            ++pid;
+            memcpy(iv, &pid, sizeof(pid));
+            memcpy(aad + 4, &pid, sizeof(pid));
+            if (1 != EVP_EncryptInit_ex(ctx.get(), cipher, nullptr, key, iv)
+                || 1 != EVP_EncryptUpdate(ctx.get(), nullptr, &outl, aad, sizeof(aad))
+                || 1 != EVP_EncryptUpdate(ctx.get(), enc.data(), &outl,
+                                          plain.data(), (int) size)
+                || 1 != EVP_EncryptFinal_ex(ctx.get(), enc.data() + outl, &finl)
+                || 1 != EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_AEAD_GET_TAG,
+                                            sizeof(tag), tag))
+            {
+                throw CommandException("benchmark", cipher_name
+                                       + " encryption failed: " + openssl_error());
+            }
+        } while (timer.Next());
+        ret["encrypt"] = throughput_result(timer, size);
+    }
+
+    // Decrypt the last packet over and over; the tag check runs each time
+    {
+        BenchTimer timer(duration);
+        do
+        {
+            if (1 != EVP_DecryptInit_ex(ctx.get(), cipher, nullptr, key, iv)
+                || 1 != EVP_DecryptUpdate(ctx.get(), nullptr, &outl, aad, sizeof(aad))
+                || 1 != EVP_DecryptUpdate(ctx.get(), dec.data(), &outl,
+                                          enc.data(), (int) size)
+                || 1 != EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_AEAD_SET_TAG,
+                                            sizeof(tag), tag)
+                || 1 != EVP_DecryptFinal_ex(ctx.get(), dec.data() + outl, &finl))
+            {
+                throw CommandException("benchmark", cipher_name
+                                       + " decryption failed: " + openssl_error());
+            }
+        } while (timer.Next());
+        ret["decrypt"] = throughput_result(timer, size);
+    }
+    return ret;
+}
+
+
+/**
+ *  Generates a private key of the given type
+ *
+ * @param type  std::string with the key type: rsaBITS, ec-p256, ec-p384,
+ *              ec-p521 or ed25519
+ *
+ * @return Returns the generated key
+ */
+static PKeyPtr generate_key(const std::string& type)
+{
+    int id = EVP_PKEY_RSA;
+    int bits = 0;
+    int curve = 0;
+    if (0 == type.find("rsa"))
+    {
+        bits = std::atoi(type.substr(3).c_str());
+        if (bits < 1024 || bits > 16384)
+        {
+            throw CommandException("benchmark", "Invalid RSA key size: " + type);
+        }
+    }
+    else if ("ec-p256" == type)
+    {
+        id = EVP_PKEY_EC;
+        curve = NID_X9_62_prime256v1;
+    }
+    else if ("ec-p384" == type)
+    {
+        id = EVP_PKEY_EC;
+        curve = NID_secp384r1;
+    }
+    else if ("ec-p521" == type)
+    {
+        id = EVP_PKEY_EC;
+        curve = NID_secp521r1;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    else if ("ed25519" == type)
+    {
+        id = EVP_PKEY_ED25519;
+    }
+#endif
+    else
+    {
+        throw CommandException("benchmark", "Unsupported key type: " + type);
+    }
+
+    EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(id, nullptr);
+    EVP_PKEY *pkey = nullptr;
+    bool ok = (kctx && EVP_PKEY_keygen_init(kctx) > 0
+               && (0 == bits || EVP_PKEY_CTX_set_rsa_keygen_bits(kctx, bits) > 0)
+               && (0 == curve || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, curve) > 0)
+               && EVP_PKEY_keygen(kctx, &pkey) > 0);
+    EVP_PKEY_CTX_free(kctx);
+    if (!ok)
+    {
+        throw CommandException("benchmark", "Could not generate a " + type
+                               + " key: " + openssl_error());
+    }
+    return PKeyPtr(pkey, EVP_PKEY_free);
+}
+
+
+/**
+ *  Creates a self-signed certificate for a key
+ */
+static X509Ptr self_signed_cert(EVP_PKEY *pkey)
+{
+    X509Ptr cert(X509_new(), X509_free);
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert.get()), 3600);
+    X509_set_pubkey(cert.get(), pkey);
+    X509_NAME *name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               (const unsigned char *) "openvpn3-benchmark",
+                               -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+
+    const EVP_MD *md = EVP_sha256();
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    if (EVP_PKEY_ED25519 == EVP_PKEY_id(pkey))
+    {
+        md = nullptr;
+    }
+#endif
+    if (0 == X509_sign(cert.get(), pkey, md))
+    {
+        throw CommandException("benchmark", "Could not sign certificate: "
+                               + openssl_error());
+    }
+    return cert;
+}
+
+
+/**
+ *  Loads a certificate and private key from PEM files
+ */
+static void load_cert_key(const std::string& certfile, const std::string& keyfile,
+                          X509Ptr& cert, PKeyPtr& pkey)
+{
+    FILE *f = fopen(certfile.c_str(), "r");
+    if (!f)
+    {
+        throw CommandException("benchmark", "Could not open " + certfile);
+    }
+    cert.reset(PEM_read_X509(f, nullptr, nullptr, nullptr));
+    fclose(f);
+
+    f = fopen(keyfile.c_str(), "r");
+    if (!f)
+    {
+        throw CommandException("benchmark", "Could not open " + keyfile);
+    }
+    pkey.reset(PEM_read_PrivateKey(f, nullptr, nullptr, nullptr));
+    fclose(f);
+
+    if (!cert || !pkey)
+    {
+        throw CommandException("benchmark", "Could not load certificate or "
+                               "key: " + openssl_error());
+    }
+    if (1 != X509_check_private_key(cert.get(), pkey.get()))
+    {
+        throw CommandException("benchmark", "The key does not match the "
+                               "certificate");
+    }
+}
+
+
+/**
+ *  Measures complete TLS handshakes between an in-memory client and
+ *  server.  Both use the same certificate, which the client verifies,
+ *  so the cost covers both ends of a mutually authenticated handshake
+ *  like OpenVPN does.
+ *
+ * @param cert         Certificate to use
+ * @param pkey         Private key of the certificate
+ * @param tls_version  Highest TLS version to negotiate, "1.2" or "1.3"
+ * @param duration     Seconds to run
+ *
+ * @return Returns a Json::Value with the results
+ */
+static Json::Value bench_handshake(X509 *cert, EVP_PKEY *pkey,
+                                   const std::string& tls_version,
+                                   const double duration)
+{
+    SSLCtxPtr server_ctx(SSL_CTX_new(TLS_method()), SSL_CTX_free);
+    SSLCtxPtr client_ctx(SSL_CTX_new(TLS_method()), SSL_CTX_free);
+    if (!server_ctx || !client_ctx)
+    {
+        throw CommandException("benchmark", "Could not create TLS context: "
+                               + openssl_error());
+    }
+
+    for (SSL_CTX *ctx : {server_ctx.get(), client_ctx.get()})
+    {
+        if (1 != SSL_CTX_use_certificate(ctx, cert)
+            || 1 != SSL_CTX_use_PrivateKey(ctx, pkey))
+        {
+            throw CommandException("benchmark", "Could not use the certificate: "
+                                   + openssl_error());
+        }
+        X509_STORE_add_cert(SSL_CTX_get_cert_store(ctx), cert);
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+                           nullptr);
+        // Each handshake must be a full one
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+        SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_max_proto_version(ctx, ("1.2" == tls_version
+                                            ? TLS1_2_VERSION : 0));
+#endif
+    }
+
+    std::string negotiated;
+    BenchTimer timer(duration);
+    do
+    {
+        SSL *server = SSL_new(server_ctx.get());
+        SSL *client = SSL_new(client_ctx.get());
+        BIO *sbio = nullptr;
+        BIO *cbio = nullptr;
+        BIO_new_bio_pair(&sbio, 0, &cbio, 0);
+        SSL_set_bio(server, sbio, sbio);
+        SSL_set_bio(client, cbio, cbio);
+        SSL_set_accept_state(server);
+        SSL_set_connect_state(client);
+
+        bool server_done = false;
+        bool client_done = false;
+        for (int rounds = 0; rounds < 100 && !(server_done && client_done); ++rounds)
+        {
+            for (auto side : {std::make_pair(client, &client_done),
+                              std::make_pair(server, &server_done)})
+            {
+                if (*side.second)
+                {
+                    continue;
+                }
+                int r = SSL_do_handshake(side.first);
+                if (1 == r)
+                {
+                    *side.second = true;
+                }
+                else if (SSL_ERROR_WANT_READ != SSL_get_error(side.first, r))
+                {
+                    std::string err = openssl_error();
+                    SSL_free(client);
+                    SSL_free(server);
+                    throw CommandException("benchmark", "TLS handshake failed: "
+                                           + err);
+                }
+            }
+        }
+        if (negotiated.empty())
+        {
+            negotiated = SSL_get_version(client);
+        }
+        SSL_free(client);
+        SSL_free(server);
+        if (!(server_done && client_done))
+        {
+            throw CommandException("benchmark", "TLS handshake did not complete");
+        }
+    } while (timer.Next());
+
+    Json::Value ret;
+    ret["protocol"] = negotiated;
+    ret["handshakes"] = (Json::Value::UInt64) timer.Iterations();
+    ret["handshakes_per_sec"] = timer.Iterations() / timer.Elapsed();
+    ret["cpu_ms_per_handshake"] = timer.CpuTime() * 1e3 / timer.Iterations();
+    return ret;
+}
+
+
+/**
+ *  The tls-crypt wrapping of a control channel packet: an HMAC-SHA256
+ *  tag over the header and the plain text, followed by the plain text
+ *  encrypted with AES-256-CTR, using the tag as the IV.  tls-crypt-v2
+ *  wraps the client key the same way, with the server key.
+ */
+class TLSCryptWrap
+{
+public:
+    TLSCryptWrap()
+        : ctx(EVP_CIPHER_CTX_new(), EVP_CIPHER_CTX_free)
+    {
+        RAND_bytes(cipher_key, sizeof(cipher_key));
+        RAND_bytes(hmac_key, sizeof(hmac_key));
+    }
+
+
+    /**
+     * @return Returns the length of the wrapped packet, which is
+     *         written to out
+     */
+    size_t Wrap(const uint8_t *header, const size_t header_len,
+                const uint8_t *in, const size_t len, uint8_t *out)
+    {
+        tag(header, header_len, in, len, out);
+
+        int outl = 0;
+        if (1 != EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_ctr(), nullptr,
+                                    cipher_key, out)
+            || 1 != EVP_EncryptUpdate(ctx.get(), out + 32, &outl, in, (int) len))
+        {
+            throw CommandException("benchmark", "tls-crypt wrap failed: "
+                                   + openssl_error());
+        }
+        return 32 + outl;
+    }
+
+
+    /**
+     * @return Returns the length of the plain text, or -1 if the
+     *         packet is not authentic
+     */
+    ssize_t Unwrap(const uint8_t *header, const size_t header_len,
+                   const uint8_t *in, const size_t len, uint8_t *out)
+    {
+        int outl = 0;
+        if (len < 32
+            || 1 != EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_ctr(), nullptr,
+                                       cipher_key, in)
+            || 1 != EVP_DecryptUpdate(ctx.get(), out, &outl, in + 32, (int) len - 32))
+        {
+            return -1;
+        }
+
+        uint8_t expected[32];
+        tag(header, header_len, out, outl, expected);
+        return (0 == CRYPTO_memcmp(expected, in, sizeof(expected)) ? outl : -1);
+    }
+
+
+private:
+    CipherCtxPtr ctx;
+    uint8_t cipher_key[32];
+    uint8_t hmac_key[32];
+    std::vector<uint8_t> scratch;
+
+
+    /**
+     *  Calculates the HMAC-SHA256 tag of the header and the plain text
+     */
+    void tag(const uint8_t *header, const size_t header_len,
+             const uint8_t *in, const size_t len, uint8_t *out)
+    {
+        scratch.resize(header_len + len);
+        memcpy(scratch.data(), header, header_len);
+        memcpy(scratch.data() + header_len, in, len);
+        unsigned int l = 0;
+        HMAC(EVP_sha256(), hmac_key, sizeof(hmac_key),
+             scratch.data(), scratch.size(), out, &l);
+    }
+};
+
+
+/**
+ *  Measures the cost of wrapping and unwrapping control channel packets
+ *  with tls-crypt, and of the server unwrapping a tls-crypt-v2 client
+ *  key (WKc) for each new client
+ *
+ * @param sizes     Control channel packet sizes to measure
+ * @param duration  Seconds to run each measurement
+ *
+ * @return Returns a Json::Value with the results
+ */
+static Json::Value bench_tls_crypt(const std::vector<size_t>& sizes,
+                                   const double duration)
+{
+    TLSCryptWrap wrap;
+    // opcode + session id + packet id + timestamp
+    uint8_t header[1 + 8 + 4 + 4];
+    RAND_bytes(header, sizeof(header));
+
+    Json::Value ret;
+    for (const auto& size : sizes)
+    {
+        std::vector<uint8_t> plain(size, 0x16);
+        std::vector<uint8_t> wrapped(size + 32);
+        std::vector<uint8_t> unwrapped(size);
+
+        BenchTimer timer(duration);
+        do
+        {
+            size_t l = wrap.Wrap(header, sizeof(header), plain.data(), size,
+                                 wrapped.data());
+            if (wrap.Unwrap(header, sizeof(header), wrapped.data(), l,
+                            unwrapped.data()) < 0)
+            {
+                throw CommandException("benchmark", "tls-crypt unwrap failed");
+            }
+        } while (timer.Next());
+
+        Json::Value r = throughput_result(timer, size);
+        r["packet_size"] = (Json::Value::UInt64) size;
+        r["cpu_us_per_packet"] = timer.CpuTime() * 1e6 / timer.Iterations();
+        ret["tls-crypt"].append(r);
+    }
+
+    // The client key (Kc) is 2048 bits of key material plus metadata
+    std::vector<uint8_t> client_key(256 + 1 + 8);
+    RAND_bytes(client_key.data(), (int) client_key.size());
+    std::vector<uint8_t> wkc(client_key.size() + 32);
+    std::vector<uint8_t> kc(client_key.size());
+    uint8_t wkc_len[2] = {0, 0};
+    TLSCryptWrap server_key;
+    size_t l = server_key.Wrap(wkc_len, sizeof(wkc_len), client_key.data(),
+                               client_key.size(), wkc.data());
+
+    BenchTimer timer(duration);
+    do
+    {
+        if (server_key.Unwrap(wkc_len, sizeof(wkc_len), wkc.data(), l, kc.data()) < 0)
+        {
+            throw CommandException("benchmark", "tls-crypt-v2 unwrap failed");
+        }
+    } while (timer.Next());
+    ret["tls-crypt-v2"]["client_key_unwraps_per_sec"] = timer.Iterations() / timer.Elapsed();
+    ret["tls-crypt-v2"]["cpu_us_per_client_key_unwrap"] = timer.CpuTime() * 1e6
+                                                          / timer.Iterations();
+    return ret;
+}
+
+
+/**
+ *  Runs the crypto and handshake benchmarks
+ *
+ * @param args  ParsedArgs object containing all related options and arguments
+ *
+ * @return Returns the exit code which will be returned to the calling shell
+ */
+static int cmd_benchmark(ParsedArgs::Ptr args)
+{
+    std::vector<std::string> ciphers = {"AES-128-GCM", "AES-256-GCM",
+                                        "CHACHA20-POLY1305"};
+    if (args->Present("ciphers"))
+    {
+        ciphers = split_list(args->GetValue("ciphers", 0));
+    }
+
+    std::vector<size_t> sizes = {64, 512, 1400};
+    if (args->Present("sizes"))
+    {
+        sizes.clear();
+        for (const auto& s : split_list(args->GetValue("sizes", 0)))
+        {
+            int v = std::atoi(s.c_str());
+            if (v < 1 || v > 65535)
+            {
+                throw CommandException("benchmark", "Invalid packet size: " + s);
+            }
+            sizes.push_back(v);
+        }
+    }
+
+    std::vector<std::string> key_types = {"rsa2048", "rsa3072", "ec-p256",
+                                          "ec-p384"};
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    key_types.push_back("ed25519");
+#endif
+    if (args->Present("key-types"))
+    {
+        key_types = split_list(args->GetValue("key-types", 0));
+    }
+
+    double duration = 1.0;
+    if (args->Present("duration"))
+    {
+        duration = std::atof(args->GetValue("duration", 0).c_str());
+        if (duration <= 0)
+        {
+            throw CommandException("benchmark", "Invalid duration");
+        }
+    }
+
+    std::string tls_version = "1.3";
+    if (args->Present("tls-version"))
+    {
+        tls_version = args->GetValue("tls-version", 0);
+        if ("1.2" != tls_version && "1.3" != tls_version)
+        {
+            throw CommandException("benchmark", "--tls-version must be 1.2 or 1.3");
+        }
+    }
+
+    if (args->Present("cert") != args->Present("key"))
+    {
+        throw CommandException("benchmark", "--cert and --key must be used together");
+    }
+
+    std::vector<std::string> tests = {"cipher", "handshake", "tls-crypt"};
+    if (args->Present("tests"))
+    {
+        tests = split_list(args->GetValue("tests", 0));
+    }
+
+    Json::Value report;
+    report["library"] = OpenSSL_version(OPENSSL_VERSION);
+    report["parameters"]["duration"] = duration;
+    report["parameters"]["tls_version"] = tls_version;
+
+    for (const auto& test : tests)
+    {
+        if ("cipher" == test)
+        {
+            for (const auto& cipher : ciphers)
+            {
+                for (const auto& size : sizes)
+                {
+                    Json::Value r = bench_cipher(cipher, size, duration);
+                    r["cipher"] = cipher;
+                    r["packet_size"] = (Json::Value::UInt64) size;
+                    report["cipher"].append(r);
+                }
+            }
+        }
+        else if ("handshake" == test)
+        {
+            for (const auto& type : key_types)
+            {
+                PKeyPtr pkey = generate_key(type);
+                X509Ptr cert = self_signed_cert(pkey.get());
+                Json::Value r = bench_handshake(cert.get(), pkey.get(),
+                                                tls_version, duration);
+                r["key_type"] = type;
+                report["handshake"].append(r);
+            }
+            if (args->Present("cert"))
+            {
+                X509Ptr cert(nullptr, X509_free);
+                PKeyPtr pkey(nullptr, EVP_PKEY_free);
+                load_cert_key(args->GetValue("cert", 0), args->GetValue("key", 0),
+                              cert, pkey);
+                Json::Value r = bench_handshake(cert.get(), pkey.get(),
+                                                tls_version, duration);
+                r["key_type"] = "file";
+                r["cert"] = args->GetValue("cert", 0);
+                report["handshake"].append(r);
+            }
+        }
+        else if ("tls-crypt" == test)
+        {
+            report["control_channel"] = bench_tls_crypt({100, 1250}, duration);
+        }
+        else
+        {
+            throw CommandException("benchmark", "Unknown test: " + test);
+        }
+    }
+
+    std::cout << report << std::endl;
+    return 0;
+}
+
+
+/**
+ *  Creates the SingleCommand object for the 'benchmark' command
+ *
+ * @return  Returns a SingleCommand::Ptr object declaring the command
+ */
+SingleCommand::Ptr prepare_command_benchmark()
+{
+    SingleCommand::Ptr cmd;
+    cmd.reset(new SingleCommand("benchmark",
+                                "Measure the data channel cipher, TLS "
+                                "handshake and tls-crypt performance",
+                                cmd_benchmark));
+    cmd->AddOption("tests", 't', "LIST", true,
+                   "Comma separated list of cipher, handshake and tls-crypt "
+                   "(default: all)");
+    cmd->AddOption("ciphers", 'c', "LIST", true,
+                   "Comma separated list of AEAD data channel ciphers "
+                   "(default: AES-128-GCM,AES-256-GCM,CHACHA20-POLY1305)");
+    cmd->AddOption("sizes", 's', "LIST", true,
+                   "Comma separated list of data channel packet sizes "
+                   "(default: 64,512,1400)");
+    cmd->AddOption("key-types", 'k', "LIST", true,
+                   "Comma separated list of certificate key types to "
+                   "generate: rsaBITS, ec-p256, ec-p384, ec-p521, ed25519");
+    cmd->AddOption("cert", "FILE", true,
+                   "Also measure handshakes with this PEM certificate");
+    cmd->AddOption("key", "FILE", true,
+                   "Private key of the --cert certificate");
+    cmd->AddOption("tls-version", "VERSION", true,
+                   "Highest TLS version to negotiate, 1.2 or 1.3 (default: 1.3)");
+    cmd->AddOption("duration", 'd', "SECONDS", true,
+                   "Time to run each measurement (default: 1)");
+    return cmd;
+}
+#endif // USE_OPENSSL
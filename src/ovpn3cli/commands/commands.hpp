@@ -30,9 +30,20 @@
 
 typedef SingleCommand::Ptr (*PrepareCommand)();
 
+/**
+ *  Runs a complete command line with the commands of the current
+ *  program.  Implemented in ovpn3cli.hpp, together with main().
+ */
+int ovpn3cli_process_command_line(int argc, char **argv);
+
+SingleCommand::Ptr prepare_command_batch();
+
 // Command provided in version.cpp
 SingleCommand::Ptr prepare_command_version();
 
+// Command provided in benchmark.cpp
+SingleCommand::Ptr prepare_command_benchmark();
+
 // Commands provided in config.cpp
 SingleCommand::Ptr prepare_command_config_import();
 SingleCommand::Ptr prepare_command_config_manage();
@@ -55,12 +66,22 @@ SingleCommand::Ptr prepare_command_session_acl();
 SingleCommand::Ptr prepare_command_session_stats();
 SingleCommand::Ptr prepare_command_sessions_list();
 
+// Commands provided in metrics.cpp
+SingleCommand::Ptr prepare_command_metrics_exporter();
+
+// Commands provided in method-stats.cpp
+SingleCommand::Ptr prepare_command_method_stats();
+SingleCommand::Ptr prepare_command_resource_usage();
+
 // Commands provided in netcfg-service.cpp
 SingleCommand::Ptr prepare_command_netcfg_service();
 
 // Commands provided in sessionmgr-service.cpp
 SingleCommand::Ptr prepare_command_sessionmgr_service();
 
+// Commands provided in top.cpp
+SingleCommand::Ptr prepare_command_top();
+
 // Commands provided in variables.cpp
 SingleCommand::Ptr prepare_command_variables();
 
@@ -94,8 +115,11 @@ std::vector<PrepareCommand> command_list_openvpn3 = {
     prepare_command_session_acl,
     prepare_command_session_stats,
     prepare_command_sessions_list,
+    prepare_command_top,
 
     prepare_command_log,
+
+    prepare_command_batch,
 };
 #endif // OVPN3CLI_OPENVPN3
 
@@ -109,6 +133,12 @@ std::vector<PrepareCommand> command_list_openvpn3admin = {
 
     prepare_command_log_service,
     prepare_command_netcfg_service,
+    prepare_command_metrics_exporter,
+    prepare_command_method_stats,
+    prepare_command_resource_usage,
+#ifdef USE_OPENSSL
+    prepare_command_benchmark,
+#endif
 #ifdef HAVE_TINYXML
     prepare_command_sessionmgr_service
 #endif
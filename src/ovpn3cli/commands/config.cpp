@@ -82,27 +82,32 @@ std::string import_config(const std::string filename,
                               ProfileParseLimits::MAX_LINE_SIZE,
                               ProfileParseLimits::MAX_DIRECTIVE_SIZE);
 
-    // Try to find persist-tun, which we will process further once imported
-    bool persist_tun = false;
+    // Parse the profile once here, the same way the Configuration
+    // Manager does it.  The parsed options are passed on, so the
+    // Configuration Manager does not need to parse the profile again.
+    OptionList opts;
     try
     {
-        OptionList opts;
         opts.parse_from_config(pm.profile_content(), &limits);
+        opts.parse_meta_from_config(pm.profile_content(), "OVPN_ACCESS_SERVER",
+                                    &limits);
         opts.update_map();
-
-        Option pt = opts.get("persist-tun");
-        persist_tun = true;
     }
-    catch (...)
+    catch (const std::exception& excp)
     {
-        // We ignore errors here - it means the option is not found
+        throw CommandException("config-import",
+                               "Invalid configuration profile: "
+                               + std::string(excp.what()));
     }
 
-    // Import the configuration fileh
+    // Look for persist-tun, which we will process further once imported
+    bool persist_tun = opts.exists("persist-tun");
+
+    // Import the configuration file
     OpenVPN3ConfigurationProxy conf(G_BUS_TYPE_SYSTEM, OpenVPN3DBus_rootp_configuration);
     conf.Ping();
-    std::string  cfgpath = conf.Import(cfgname, pm.profile_content(),
-                                       single_use, persistent);
+    std::string  cfgpath = conf.ImportParsed(cfgname, opts, pm.profile_content(),
+                                             single_use, persistent);
 
     // If the configuration profile contained --persist-tun,
     // set the related property in the D-Bus configuration object.
@@ -217,13 +222,12 @@ static int cmd_configs_list(ParsedArgs::Ptr args)
     std::cout << std::setw(32+26+18+2) << std::setfill('-') << "-" << std::endl;
 
     bool first = true;
-    for (auto& cfg : confmgr.FetchAvailableConfigs())
+    for (const auto& cfg : confmgr.FetchAvailableConfigsDetailed())
     {
-        if (cfg.empty())
+        if (cfg.path.empty())
         {
             continue;
         }
-        OpenVPN3ConfigurationProxy cprx(G_BUS_TYPE_SYSTEM, cfg);
 
         if (!first)
         {
@@ -231,28 +235,26 @@ static int cmd_configs_list(ParsedArgs::Ptr args)
         }
         first = false;
 
-        std::string name = cprx.GetStringProperty("name");
-        std::string user = lookup_username(cprx.GetUIntProperty("owner"));
+        std::string user = lookup_username(cfg.owner);
 
-        std::time_t imp_tstamp = cprx.GetUInt64Property("import_timestamp");
+        std::time_t imp_tstamp = cfg.import_timestamp;
         std::string imported(std::asctime(std::localtime(&imp_tstamp)));
         imported.erase(imported.find_last_not_of(" \n")+1); // rtrim
 
-        std::time_t last_u_tstamp = cprx.GetUInt64Property("last_used_timestamp");
+        std::time_t last_u_tstamp = cfg.last_used_timestamp;
         std::string last_used;
         if (last_u_tstamp > 0)
         {
             last_used = std::asctime(std::localtime(&last_u_tstamp));
             last_used.erase(last_used.find_last_not_of(" \n")+1);  // rtrim
         }
-        unsigned int used_count = cprx.GetUIntProperty("used_count");
 
-        std::cout << cfg << std::endl;
+        std::cout << cfg.path << std::endl;
         std::cout << imported << std::setw(32 - imported.size()) << std::setfill(' ') << " "
                   << last_used <<  std::setw(26 - last_used.size()) << " "
-                  << std::to_string(used_count)
+                  << std::to_string(cfg.used_count)
                   << std::endl;
-        std::cout << name << std::setw(58 - name.size()) << " " << user
+        std::cout << cfg.name << std::setw(58 - cfg.name.size()) << " " << user
                   << std::endl;
     }
     std::cout << std::setw(32+26+18+2) << std::setfill('-') << "-" << std::endl;
@@ -620,7 +622,8 @@ static int cmd_config_acl(ParsedArgs::Ptr args)
 
     try
     {
-        args->Present({"show", "grant", "revoke", "public-access", "lock-down",
+        args->Present({"show", "grant", "revoke", "grant-group",
+                        "revoke-group", "public-access", "lock-down",
                         "seal", "transfer-owner-session"});
     }
     catch (const OptionNotFound&)
@@ -707,6 +710,72 @@ static int cmd_config_acl(ParsedArgs::Ptr args)
             }
         }
 
+        if (args->Present("grant-group"))
+        {
+            for (auto const& group : args->GetAllValues("grant-group"))
+            {
+                try
+                {
+                    gid_t gid = get_groupid(group);
+                    try
+                    {
+                        conf.AccessGrantGroup(gid);
+                        std::cout << "Granted access to group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                    }
+                    catch (DBusException& e)
+                    {
+                        std::cerr << "Failed granting access to group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                        ret = 3;
+                    }
+                }
+                catch (const LookupException&)
+                {
+                    std::cerr << "** ERROR ** --grant-group " << group
+                              << " does not map to a valid group"
+                              << std::endl;
+                }
+            }
+        }
+
+        if (args->Present("revoke-group"))
+        {
+            for (auto const& group : args->GetAllValues("revoke-group"))
+            {
+                try
+                {
+                    gid_t gid = get_groupid(group);
+                    try
+                    {
+                        conf.AccessRevokeGroup(gid);
+                        std::cout << "Revoked access from group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                    }
+                    catch (DBusException& e)
+                    {
+                        std::cerr << "Failed revoking access from group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                        ret = 3;
+                    }
+                }
+                catch (const LookupException&)
+                {
+                    std::cerr << "** ERROR ** --revoke-group " << group
+                              << " does not map to a valid group"
+                              << std::endl;
+                }
+            }
+        }
+
         if (args->Present("transfer-owner-session"))
         {
             bool v = args->GetBoolValue("transfer-owner-session", 0);
@@ -815,6 +884,21 @@ static int cmd_config_acl(ParsedArgs::Ptr args)
                               << " " << ('(' != user[0] ? user : "(unknown)")
                     << std::endl;
                 }
+
+                std::vector<gid_t> groups = conf.GetGroupAccessList();
+                if (!groups.empty())
+                {
+                    std::cout << " Groups granted access: " << std::to_string(groups.size())
+                              << (1 != groups.size() ? " groups" : " group")
+                              << std::endl;
+                    for (auto const& gid : groups)
+                    {
+                        std::string group = lookup_groupname(gid);
+                        std::cout << "                        - (" << gid << ") "
+                                  << " " << ('(' != group[0] ? group : "(unknown)")
+                                  << std::endl;
+                    }
+                }
             }
         }
         return ret;
@@ -855,6 +939,10 @@ SingleCommand::Ptr prepare_command_config_acl()
                    "Grant this user access to this configuration profile");
     cmd->AddOption("revoke", 'R', "<UID | username>", true,
                    "Revoke this user access from this configuration profile");
+    cmd->AddOption("grant-group", "<GID | group name>", true,
+                   "Grant all members of this group access to this configuration profile");
+    cmd->AddOption("revoke-group", "<GID | group name>", true,
+                   "Revoke this group access from this configuration profile");
     cmd->AddOption("public-access", "<true|false>", true,
                    "Set/unset the public access flag",
                    arghelper_boolean);
@@ -168,6 +168,97 @@ static int manage_config_file(ParsedArgs::Ptr args,
     return 0;
 }
 
+/**
+ *  Prints a latency histogram retrieved from the log service
+ *
+ * @param label    std::string with the title of the histogram
+ * @param bounds   std::vector with the upper bounds of each histogram
+ *                 bucket, in microseconds
+ * @param buckets  std::vector with the number of measurements per bucket
+ */
+static void print_latency_histogram(const std::string& label,
+                                    const std::vector<uint64_t>& bounds,
+                                    const std::vector<uint64_t>& buckets)
+{
+    std::cout << label << std::endl;
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+        std::stringstream b;
+        if (i < bounds.size())
+        {
+            b << "<= " << bounds[i] << " us";
+        }
+        else if (!bounds.empty())
+        {
+            b << " > " << bounds.back() << " us";
+        }
+        std::cout << std::setw(20) << b.str() << ": "
+                  << buckets[i] << std::endl;
+    }
+}
+
+
+/**
+ *  Prints the throughput and latency statistics of the log service
+ *
+ * @param logsrvprx  LogServiceProxy to the log service
+ */
+static void show_statistics(LogServiceProxy& logsrvprx)
+{
+    std::cout << "            Events received: "
+              << logsrvprx.GetEventsReceived() << std::endl;
+    std::cout << "             Events written: "
+              << logsrvprx.GetEventsWritten() << std::endl;
+    std::cout << "             Events dropped: "
+              << logsrvprx.GetEventsDropped() << std::endl;
+    std::cout << "            Log queue depth: "
+              << logsrvprx.GetQueueDepth() << std::endl;
+    std::cout << std::endl;
+
+    std::vector<uint64_t> bounds = logsrvprx.GetLatencyBuckets();
+    print_latency_histogram("Write latency:", bounds,
+                            logsrvprx.GetWriteLatency());
+    std::vector<uint64_t> queue_lat = logsrvprx.GetQueueLatency();
+    if (!queue_lat.empty())
+    {
+        std::cout << std::endl;
+        print_latency_histogram("Log queue latency:", bounds, queue_lat);
+    }
+    std::cout << std::endl;
+
+    LogSenderStats senders = logsrvprx.GetSenderStats();
+    if (senders.empty())
+    {
+        std::cout << "No attached log subscriptions" << std::endl;
+        return;
+    }
+
+    std::cout << "Tag" << std::setw(22) << " "
+              << "Bus name" << std::setw(4) << " "
+              << "Interface" << std::setw(25) << " "
+              << "    Events" << "  "
+              << "Events/sec" << std::endl;
+    std::cout <<  std::setw(100) << std::setfill('-')
+              << "-" << std::endl;
+    std::cout << std::setfill(' ');
+    for (const auto& e : senders)
+    {
+        std::stringstream rate;
+        rate << std::fixed << std::setprecision(1) << e.rate;
+        std::cout << std::left
+                  << std::setw(25) << e.tag
+                  << std::setw(12) << e.busname
+                  << std::setw(34) << e.interface
+                  << std::right
+                  << std::setw(10) << e.events << "  "
+                  << std::setw(10) << rate.str() << std::endl;
+    }
+    std::cout <<  std::setw(100) << std::setfill('-')
+              << "-" << std::endl;
+    std::cout << std::setfill(' ');
+}
+
+
 /**
  *  openvpn3 log-service
  *
@@ -318,6 +409,10 @@ static int cmd_log_service(ParsedArgs::Ptr args)
             std::cout <<  std::setw(120) << std::setfill('-')
                       << "-" << std::endl;
         }
+        else if (args->Present("stats"))
+        {
+            show_statistics(logsrvprx);
+        }
         else
         {
             std::string log_method = logsrvprx.GetLogMethod();
@@ -399,6 +494,8 @@ SingleCommand::Ptr prepare_command_log_service()
                    arghelper_boolean);
     cmd->AddOption("list-subscriptions",
                    "List all subscriptions which has attached to the log service");
+    cmd->AddOption("stats",
+                   "Show log event throughput and latency statistics");
     cmd->AddOption("config-show",
                    "Show the current configuration file used by log-service");
     cmd->AddOption("config-set", 0, "CONFIG-KEY", true,
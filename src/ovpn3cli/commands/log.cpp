@@ -23,11 +23,15 @@
  * @brief  Commands related to receive log entries from various sessions
  */
 
+#include <map>
+#include <set>
+
 #include "dbus/core.hpp"
 #include "common/cmdargparser.hpp"
 #include "common/timestamp.hpp"
 #include "log/dbus-log.hpp"
 #include "log/dbus-logfwd.hpp"
+#include "log/log-archive.hpp"
 #include "log/logevent.hpp"
 #include "log/proxy-log.hpp"
 #include "configmgr/proxy-configmgr.hpp"
@@ -43,11 +47,16 @@ using namespace openvpn;
  *  It will prepend all lines with a timestamp.  If the event contains of
  *  multiple lines, the following lines will be indented.
  *
- * @param logev  The LogEvent object to print
+ * @param logev  The LogEvent object to print.  The timestamp printed is
+ *               the time the LogEvent was created.
+ * @param label  std::string printed after the timestamp, identifying
+ *               the VPN session when attached to several sessions
  */
 
-void print_log_event(const LogEvent& logev)
+void print_log_event(const LogEvent& logev, const std::string& label = "")
 {
+    static TimestampFormatter tsformat;
+
     std::stringstream msg;
     msg << logev;
     std::vector<std::string> lines;
@@ -58,7 +67,8 @@ void print_log_event(const LogEvent& logev)
     }
 
     bool first = true;
-    std::cout << GetTimestamp() << lines[0] << std::endl;
+    std::cout << tsformat.Format(logev.created)
+              << label << lines[0] << std::endl;
     for (const auto& l : lines)
     {
         if (first)
@@ -106,17 +116,32 @@ public:
 
 
 /**
- *  Log and status event handling from VPN sessions
+ *  Log and status event handling from VPN sessions.  A single
+ *  SessionLogger receives the events of all the VPN sessions attached to.
  */
 class SessionLogger : public LogForwardBase<SessionLogger>
 {
 public:
     using Ptr = std::shared_ptr<SessionLogger>;
 
-    SessionLogger(DBus& dbscon, std::string interf,
-                  std::string objpath)
-        : LogForwardBase(dbscon, interf, objpath)
+    // Log events are received in compact batches of up to 64 events,
+    // held back at most 100ms by the log service
+    SessionLogger(DBus& dbscon, std::string interf)
+        : LogForwardBase(dbscon, interf, 64, 100, true)
+    {
+    }
+
+    /**
+     *  Label the events of a VPN session with a name.  Events of sessions
+     *  without a label are printed without one.
+     *
+     * @param session_path  std::string with the D-Bus object path of the
+     *                      VPN session
+     * @param label         std::string with the name to use
+     */
+    void SetLabel(const std::string& session_path, const std::string& label)
     {
+        labels[session_path] = "[" + label + "] ";
     }
 
     void ConsumeLogEvent(const std::string sender,
@@ -124,7 +149,7 @@ public:
                          const std::string object_path,
                          const LogEvent& logev) override
     {
-        print_log_event(logev);
+        print_log_event(logev, get_label(object_path));
     }
 
     void StatusChangeEvent(const std::string sender_name,
@@ -132,7 +157,17 @@ public:
                            const std::string obj_path,
                            const StatusEvent &stev) override
     {
-        std::cout << GetTimestamp() << "[STATUS] " << stev << std::endl;
+        std::cout << GetTimestamp() << get_label(obj_path)
+                  << "[STATUS] " << stev << std::endl;
+    }
+
+private:
+    std::map<std::string, std::string> labels = {};
+
+    std::string get_label(const std::string& session_path) const
+    {
+        auto it = labels.find(session_path);
+        return (labels.end() != it ? it->second : "");
     }
 };
 
@@ -143,10 +178,11 @@ public:
  *
  *  This class implements logic to also wait until the session manager
  *  signals a newly created session when the log attach is tied to a
- *  configuration profile name.  Once the session is found, the SessionLogger
- *  class takes over the log event handling itself.  The LogAttach object
- *  will also stop the logging once the session manager signals the session
- *  has been destroyed.
+ *  configuration profile name or when all sessions are followed.  Each
+ *  session found is added to a single SessionLogger object, which takes
+ *  over the log event handling itself.  The LogAttach object will also
+ *  stop the logging of a session once the session manager signals the
+ *  session has been destroyed.
  *
  */
 class LogAttach : public DBusSignalSubscription
@@ -160,30 +196,55 @@ public:
         mainloop(main_loop), dbus(dbuscon)
     {
         manager.reset(new OpenVPN3SessionMgrProxy(dbuscon));
+        session_log = SessionLogger::create(dbus, OpenVPN3DBus_interf_backends);
         Subscribe("SessionManagerEvent");
+        try
+        {
+            manager->EventSubscribe();
+        }
+        catch (const DBusException&)
+        {
+            // Older session managers broadcast these signals instead
+        }
     }
 
 
     void AttachByPath(const std::string path)
     {
-        session_path = path;
-        setup_session_logger(session_path);
+        attach_session(path, path);
     }
 
 
     void AttachByConfig(const std::string config)
     {
-        config_name = config;
-        lookup_config_name(config_name);
-        setup_session_logger(session_path);
+        std::string path = lookup_config_name(config);
+        if (path.empty())
+        {
+            wait_configs.insert(config);
+            return;
+        }
+        attach_session(path, config);
     }
 
 
     void AttachByInterface(const std::string interf)
     {
         tun_interf = interf;
-        lookup_interface(tun_interf);
-        setup_session_logger(session_path);
+        attach_session(lookup_interface(tun_interf), tun_interf);
+    }
+
+
+    /**
+     *  Attach to all the sessions available to the calling user, including
+     *  sessions started later on
+     */
+    void AttachAllSessions()
+    {
+        all_sessions = true;
+        for (const auto& path : manager->FetchAvailableSessionPaths())
+        {
+            attach_session(path, get_config_name(path));
+        }
     }
 
 
@@ -193,6 +254,28 @@ public:
     }
 
 
+    /**
+     *  Print the most recent log events kept by the VPN backend when
+     *  attaching to the session, before any new log events
+     *
+     * @param events  Number of log events to print
+     */
+    void SetHistory(const unsigned int events)
+    {
+        history_events = events;
+    }
+
+
+    /**
+     *  Prefix each log and status event with the configuration profile
+     *  name or session path of the session it belongs to.
+     */
+    void SetLabelEvents(const bool enable)
+    {
+        label_events = enable;
+    }
+
+
     void callback_signal_handler(GDBusConnection *connection,
                                  const std::string sender_name,
                                  const std::string object_path,
@@ -207,33 +290,58 @@ public:
             switch (ev.type)
             {
             case SessionManager::EventType::SESS_CREATED:
-                if (session_proxy)
+                if (all_sessions)
                 {
-                    // If we already have a running session proxy,
-                    // ignore new sessions
+                    try
+                    {
+                        attach_session(ev.path, get_config_name(ev.path));
+                    }
+                    catch (const std::exception&)
+                    {
+                        // Sessions of other users are not accessible
+                    }
                     return;
                 }
-                if (!config_name.empty())
+                for (auto it = wait_configs.begin(); it != wait_configs.end();)
                 {
-                    lookup_config_name(config_name);
+                    std::string path = lookup_config_name(*it);
+                    if (!path.empty())
+                    {
+                        attach_session(path, *it);
+                        it = wait_configs.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
                 }
-                else if (!tun_interf.empty())
+                if (!tun_interf.empty() && attached.empty())
                 {
-                    lookup_interface(tun_interf);
+                    attach_session(lookup_interface(tun_interf), tun_interf);
                 }
-
-                setup_session_logger(session_path);
                 break;
 
             case SessionManager::EventType::SESS_DESTROYED:
-                if (0 != ev.path.compare(session_path))
+                if (attached.end() == attached.find(ev.path))
                 {
                     // This event is not related to us, ignore it
                     return;
                 }
 
-                std::cout << "Session closed" << std::endl;
-                g_main_loop_quit((GMainLoop *) mainloop);
+                session_log->RemoveSession(ev.path);
+                attached.erase(ev.path);
+                if (label_events)
+                {
+                    std::cout << "Session closed: " << ev.path << std::endl;
+                }
+                else
+                {
+                    std::cout << "Session closed" << std::endl;
+                }
+                if (attached.empty() && wait_configs.empty() && !all_sessions)
+                {
+                    g_main_loop_quit((GMainLoop *) mainloop);
+                }
                 break;
 
             case SessionManager::EventType::UNSET:
@@ -247,17 +355,27 @@ public:
 private:
     GMainLoop *mainloop = nullptr;
     DBus& dbus;
-    std::string session_path{""};
-    std::string config_name{""};
+    std::set<std::string> attached = {};
+    std::set<std::string> wait_configs = {};
     std::string tun_interf{""};
+    bool all_sessions = false;
+    bool label_events = false;
     std::unique_ptr<OpenVPN3SessionMgrProxy> manager = nullptr;
-    std::unique_ptr<OpenVPN3SessionProxy> session_proxy = nullptr;
     SessionLogger::Ptr session_log = {};
     unsigned int log_level = 0;
+    unsigned int history_events = 0;
     bool wait_notification = false;
 
 
-    void lookup_config_name(const std::string cfgname)
+    /**
+     *  Looks up the session started from a configuration profile
+     *
+     * @param cfgname  std::string with the configuration profile name
+     *
+     * @return Returns the session path, or an empty string if no
+     *         session was found
+     */
+    std::string lookup_config_name(const std::string cfgname)
     {
         // We need to try a few times, as the SESS_CREATED event comes
         // quite early and the session object itself might not be registered
@@ -277,8 +395,7 @@ private:
             {
                 // If only a single path is found, that's the one we're
                 // looking for.
-                session_path = paths.at(0);
-                return;
+                return paths.at(0);
             }
             else
             {
@@ -292,10 +409,11 @@ private:
             }
             usleep(10000); // 10ms
         }
+        return "";
     }
 
 
-    void lookup_interface(const std::string interf)
+    std::string lookup_interface(const std::string interf)
     {
         // This method does not have any retry logic as @lookup_config_name()
         // the tun interface name will appear quite late in the connection
@@ -303,7 +421,7 @@ private:
         // The tun device name is first known after a successful connection.
         try
         {
-            session_path = manager->LookupInterface(interf);
+            return manager->LookupInterface(interf);
         }
         catch (const TunInterfaceException& excp)
         {
@@ -316,19 +434,31 @@ private:
     }
 
 
+    std::string get_config_name(const std::string& path)
+    {
+        try
+        {
+            OpenVPN3SessionProxy sess(dbus, path);
+            std::string name = sess.GetStringProperty("config_name");
+            return (!name.empty() ? name : path);
+        }
+        catch (const std::exception&)
+        {
+            return path;
+        }
+    }
+
+
     /**
-     *  Create a new SessionLogger object for processing log and status event
-     *  changes for a running session.
-     *
-     *  The input path is used to ensure a SESS_CREATED SessionManager::Event
-     *  is tied to the VPN session we expect.
+     *  Adds a VPN session to the SessionLogger object processing log and
+     *  status event changes for all sessions attached to.
      *
-     * @param path  std::string of the VPN session to attach to.
+     * @param path   std::string of the VPN session to attach to.
+     * @param label  std::string used to identify the session in the output
      */
-    void setup_session_logger(std::string path)
+    void attach_session(const std::string& path, const std::string& label)
     {
-        if (path.empty()
-            || (0 != session_path.compare(path)))
+        if (path.empty() || attached.end() != attached.find(path))
         {
             return;
         }
@@ -336,12 +466,14 @@ private:
         if (wait_notification)
         {
             std::cout << " Done" << std::endl;
+            wait_notification = false;
         }
 
         // Sanity check before setting up the session logger; does the
-        // session exist?
-        session_proxy.reset(new OpenVPN3SessionProxy(G_BUS_TYPE_SYSTEM, path));
-        if (!session_proxy->CheckObjectExists())
+        // session exist?  A session just announced by the session manager
+        // might need a little while until it is registered.
+        OpenVPN3SessionProxy session_proxy(dbus, path);
+        if (!session_proxy.CheckObjectExists(10, 10000))
         {
             throw CommandException("log",
                                    "Session not found");
@@ -349,12 +481,32 @@ private:
 
         std::cout << "Attaching to session " << path << std::endl;
 
+        if (history_events > 0)
+        {
+            try
+            {
+                std::vector<LogEvent> history = session_proxy.FetchLogHistory(history_events);
+                std::cout << "Log history (" << history.size() << " events):"
+                          << std::endl;
+                for (const auto& ev : history)
+                {
+                    std::cout << "     " << ev << std::endl;
+                }
+                std::cout << "End of log history" << std::endl;
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "** WARNING ** Could not retrieve log history: "
+                          << e.what() << std::endl;
+            }
+        }
+
         // Change the log-level if requested.
         if (log_level > 0)
         {
             try
             {
-                session_proxy->SetLogVerbosity(log_level);
+                session_proxy.SetLogVerbosity(log_level);
             }
             catch (std::exception& e)
             {
@@ -366,14 +518,60 @@ private:
             }
         }
 
-        // Setup the SessionLogger object for the provided session path
-        session_log = SessionLogger::create(dbus, OpenVPN3DBus_interf_backends,
-                                            session_path);
+        // All sessions share the same SessionLogger object, and thereby
+        // the same log proxy in the log service
+        if (label_events)
+        {
+            session_log->SetLabel(path, label);
+        }
+        session_log->AddSession(path);
+        attached.insert(path);
     }
 };
 
 
 
+/**
+ *  Replays log events from a log archive written by the log service
+ *
+ * @param args  ParsedArgs object containing all related options and arguments
+ * @return Returns the exit code which will be returned to the calling shell
+ */
+static int replay_log_archive(ParsedArgs::Ptr args)
+{
+    std::string session_token = "";
+    if (args->Present("session-token"))
+    {
+        session_token = args->GetValue("session-token", 0);
+    }
+
+    uint64_t since_us = 0;
+    if (args->Present("since"))
+    {
+        uint64_t minutes = std::stoul(args->GetValue("since", 0));
+        since_us = (time(0) - (minutes * 60)) * 1000000ULL;
+    }
+
+    try
+    {
+        LogArchiveReader archive(args->GetValue("archive", 0));
+        archive.Replay(session_token, since_us, 0,
+                       [](const LogArchiveReader::Entry& e)
+                       {
+                           LogEvent ev(e.event);
+                           ev.created = std::chrono::system_clock::time_point(
+                                           std::chrono::microseconds(e.timestamp_us));
+                           print_log_event(ev);
+                       });
+    }
+    catch (const LogException& excp)
+    {
+        throw CommandException("log", excp.what());
+    }
+    return 0;
+}
+
+
 /**
  *  openvpn3 log
  *
@@ -386,14 +584,27 @@ private:
  */
 static int cmd_log(ParsedArgs::Ptr args)
 {
+    if (args->Present("archive"))
+    {
+        return replay_log_archive(args);
+    }
+    if (args->Present("session-token") || args->Present("since"))
+    {
+        throw CommandException("log",
+                               "--session-token and --since can only be "
+                               "used together with --archive");
+    }
+
     if (!args->Present("session-path")
         && !args->Present("config")
         && !args->Present("interface")
+        && !args->Present("all-sessions")
         && !args->Present("config-events"))
     {
         throw CommandException("log",
-                               "Either --session-path, --config, --interface "
-                               "or --config-events must be provided");
+                               "Either --session-path, --config, --interface, "
+                               "--all-sessions or --config-events must be "
+                               "provided");
     }
 
     // Prepare the main loop which will listen for Log events and process them
@@ -407,9 +618,8 @@ static int cmd_log(ParsedArgs::Ptr args)
     dbuscon.Connect();
 
     if (args->Present("session-path") || args->Present("config")
-        || args->Present("interface"))
+        || args->Present("interface") || args->Present("all-sessions"))
     {
-        std::string session_path = "";
         logattach.reset(new LogAttach (main_loop, dbuscon));
 
         if (args->Present("log-level"))
@@ -417,17 +627,35 @@ static int cmd_log(ParsedArgs::Ptr args)
             logattach->SetLogLevel(std::stoi(args->GetValue("log-level", 0)));
         }
 
-        if (args->Present("config"))
+        if (args->Present("history"))
+        {
+            logattach->SetHistory(std::stoi(args->GetValue("history", 0)));
+        }
+
+        // The events are labelled with the session they belong to
+        // when more than a single session is attached to
+        std::vector<std::string> paths = args->GetAllValues("session-path");
+        std::vector<std::string> configs = args->GetAllValues("config");
+        std::vector<std::string> interfaces = args->GetAllValues("interface");
+        logattach->SetLabelEvents(args->Present("all-sessions")
+                                  || (paths.size() + configs.size()
+                                      + interfaces.size()) > 1);
+
+        if (args->Present("all-sessions"))
+        {
+            logattach->AttachAllSessions();
+        }
+        for (const auto& cfg : configs)
         {
-            logattach->AttachByConfig(args->GetValue("config", 0));
+            logattach->AttachByConfig(cfg);
         }
-        else if (args->Present("interface"))
+        for (const auto& interf : interfaces)
         {
-            logattach->AttachByInterface(args->GetValue("interface", 0));
+            logattach->AttachByInterface(interf);
         }
-        else
+        for (const auto& path : paths)
         {
-            logattach->AttachByPath(args->GetValue("session-path", 0));
+            logattach->AttachByPath(path);
         }
     }
 
@@ -468,7 +696,8 @@ SingleCommand::Ptr prepare_command_log()
                                 "Receive log events as they occur",
                                 cmd_log));
     cmd->AddOption("session-path", "SESSION-PATH", true,
-                   "Receive log events for a specific session",
+                   "Receive log events for a specific session.  "
+                   "Can be used several times",
                    arghelper_session_paths);
     cmd->AddOption("config", 'c', "CONFIG-NAME", true,
                    "Alternative to --session-path, where configuration "
@@ -478,11 +707,26 @@ SingleCommand::Ptr prepare_command_log()
                    "Alternative to --session-path, where tun interface name "
                    "is used instead",
                    arghelper_managed_interfaces);
+    cmd->AddOption("all-sessions",
+                   "Receive log events for all sessions available, "
+                   "including sessions started later on");
     cmd->AddOption("log-level", "LOG-LEVEL", true,
                    "Set the log verbosity level of messages to be shown (default: 4)",
                    arghelper_log_levels);
     cmd->AddOption("config-events",
                    "Receive log events issued by the configuration manager");
+    cmd->AddOption("history", "EVENTS", true,
+                   "Show the most recent log events of the session, "
+                   "regardless of the log level, before new log events");
+    cmd->AddOption("archive", "DIRECTORY", true,
+                   "Replay log events from a log archive written by the "
+                   "log service");
+    cmd->AddOption("session-token", "TOKEN", true,
+                   "(Only with --archive) Only replay log events for the "
+                   "session with this session token");
+    cmd->AddOption("since", "MINUTES", true,
+                   "(Only with --archive) Only replay log events from the "
+                   "last MINUTES minutes");
 
     return cmd;
 }
@@ -0,0 +1,417 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   method-stats.cpp
+ *
+ * @brief  Commands retrieving the D-Bus method latency statistics and
+ *         the resource usage of the OpenVPN 3 D-Bus services
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "dbus/core.hpp"
+#include "dbus/method-stats.hpp"
+#include "common/cmdargparser.hpp"
+
+
+struct StatsService
+{
+    const char *name;
+    const std::string& busname;
+    const std::string& root_path;
+};
+
+static const std::vector<StatsService> stats_services = {
+    {"backends", OpenVPN3DBus_name_backends, OpenVPN3DBus_rootp_backends},
+    {"configuration", OpenVPN3DBus_name_configuration, OpenVPN3DBus_rootp_configuration},
+    {"log", OpenVPN3DBus_name_log, OpenVPN3DBus_rootp_log},
+    {"netcfg", OpenVPN3DBus_name_netcfg, OpenVPN3DBus_rootp_netcfg},
+    {"sessions", OpenVPN3DBus_name_sessions, OpenVPN3DBus_rootp_sessions}
+};
+
+
+/**
+ *  Estimate a percentile from the histogram buckets.  The upper bound
+ *  of the bucket containing the percentile is reported.
+ *
+ * @param buckets  std::vector with the bucket counters
+ * @param count    Total number of measurements
+ * @param pct      Percentile to estimate, 1-100
+ *
+ * @return Returns a std::string with the estimated duration
+ */
+static std::string estimate_percentile(const std::vector<guint64>& buckets,
+                                       const guint64 count,
+                                       const unsigned int pct)
+{
+    guint64 target = (count * pct + 99) / 100;
+    guint64 seen = 0;
+    for (unsigned int i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+        {
+            if (i == buckets.size() - 1)
+            {
+                return ">" + std::to_string(1ULL << i);
+            }
+            return "<" + std::to_string(1ULL << (i + 1));
+        }
+    }
+    return "-";
+}
+
+
+/**
+ *  Retrieve and print the statistics of a single service
+ *
+ * @param dbcon  DBus connection to use
+ * @param srv    StatsService to query
+ * @param reset  Reset the statistics instead of printing them
+ *
+ * @return Returns false if the service could not be queried
+ */
+static bool process_service(DBus& dbcon, const StatsService& srv,
+                            const bool reset)
+{
+    GVariant *res = nullptr;
+    try
+    {
+        DBusProxy prx(dbcon, srv.busname, OpenVPN3DBus_interf_debug,
+                      srv.root_path);
+        res = prx.Call(reset ? "ResetMethodStats" : "GetMethodStats");
+    }
+    catch (DBusException& excp)
+    {
+        std::cerr << "** " << srv.name << ": " << excp.GetRawError()
+                  << std::endl;
+        return false;
+    }
+
+    if (reset)
+    {
+        if (res)
+        {
+            g_variant_unref(res);
+        }
+        std::cout << "Statistics reset: " << srv.name << std::endl;
+        return true;
+    }
+    if (!res)
+    {
+        return false;
+    }
+
+    GVariantIter *stats = nullptr;
+    g_variant_get(res, "(a(ssstttat))", &stats);
+
+    gchar *intf = nullptr;
+    gchar *kind = nullptr;
+    gchar *member = nullptr;
+    guint64 count = 0;
+    guint64 total = 0;
+    guint64 max = 0;
+    GVariantIter *bkts = nullptr;
+    while (g_variant_iter_next(stats, "(ssstttat)", &intf, &kind, &member,
+                               &count, &total, &max, &bkts))
+    {
+        std::vector<guint64> buckets;
+        guint64 b = 0;
+        while (g_variant_iter_next(bkts, "t", &b))
+        {
+            buckets.push_back(b);
+        }
+        g_variant_iter_free(bkts);
+
+        if (count > 0)
+        {
+            std::stringstream name;
+            name << intf << "." << member;
+            std::cout << std::setw(14) << std::left << srv.name
+                      << std::setw(7) << kind
+                      << std::setw(55) << name.str()
+                      << std::setw(9) << std::right << count
+                      << std::setw(10) << (total / count)
+                      << std::setw(10) << max
+                      << std::setw(10) << estimate_percentile(buckets, count, 50)
+                      << std::setw(10) << estimate_percentile(buckets, count, 99)
+                      << std::endl;
+        }
+        g_free(intf);
+        g_free(kind);
+        g_free(member);
+    }
+    g_variant_iter_free(stats);
+    g_variant_unref(res);
+    return true;
+}
+
+
+/**
+ *  openvpn3-admin method-stats command
+ *
+ *  Lists the latency statistics of the D-Bus requests handled by the
+ *  OpenVPN 3 D-Bus services, or resets them.
+ *
+ * @param args  ParsedArgs object containing all related options and arguments
+ *
+ * @return Returns the exit code which will be returned to the calling shell
+ */
+static int cmd_method_stats(ParsedArgs::Ptr args)
+{
+    std::string only = args->Present("service")
+                       ? args->GetLastValue("service") : "";
+    bool reset = args->Present("reset");
+
+    std::vector<StatsService> query;
+    for (const auto& s : stats_services)
+    {
+        if (only.empty() || only == s.name)
+        {
+            query.push_back(s);
+        }
+    }
+    if (query.empty())
+    {
+        throw CommandException("method-stats",
+                               "Unknown service: " + only);
+    }
+
+    DBus dbcon(G_BUS_TYPE_SYSTEM);
+    dbcon.Connect();
+
+    if (!reset)
+    {
+        std::cout << std::setw(14) << std::left << "Service"
+                  << std::setw(7) << "Kind"
+                  << std::setw(55) << "Method/property"
+                  << std::setw(9) << std::right << "Calls"
+                  << std::setw(10) << "Avg(us)"
+                  << std::setw(10) << "Max(us)"
+                  << std::setw(10) << "p50(us)"
+                  << std::setw(10) << "p99(us)"
+                  << std::endl
+                  << std::setw(125) << std::setfill('-') << "-"
+                  << std::setfill(' ') << std::endl;
+    }
+
+    bool failed = false;
+    for (const auto& s : query)
+    {
+        failed |= !process_service(dbcon, s, reset);
+    }
+
+    if (failed)
+    {
+        std::cerr << "** Some services could not be queried.  Ensure you run "
+                  << "this command as the root or " << OPENVPN_USERNAME
+                  << " user." << std::endl;
+        return 2;
+    }
+    return 0;
+}
+
+
+static std::string arghelper_method_stats_services()
+{
+    std::stringstream r;
+    for (const auto& s : stats_services)
+    {
+        r << s.name << " ";
+    }
+    return r.str();
+}
+
+
+/**
+ *  Creates the SingleCommand object for the 'method-stats' command
+ *
+ * @return  Returns a SingleCommand::Ptr object declaring the command
+ */
+SingleCommand::Ptr prepare_command_method_stats()
+{
+    SingleCommand::Ptr cmd;
+    cmd.reset(new SingleCommand("method-stats",
+                                "Show D-Bus method latency statistics of "
+                                "the OpenVPN 3 services",
+                                cmd_method_stats));
+    cmd->AddOption("service", 's', "NAME", true,
+                   "Only process this service",
+                   arghelper_method_stats_services);
+    cmd->AddOption("reset",
+                   "Reset the statistics instead of showing them");
+
+    return cmd;
+}
+
+
+
+/**
+ *  Retrieve and print the resource usage of a single service
+ *
+ * @param dbcon        DBus connection to use
+ * @param srv          StatsService to query
+ * @param malloc_info  Print the malloc_info(3) XML document as well
+ *
+ * @return Returns false if the service could not be queried
+ */
+static bool process_resource_usage(DBus& dbcon, const StatsService& srv,
+                                   const bool malloc_info)
+{
+    GVariant *res = nullptr;
+    try
+    {
+        DBusProxy prx(dbcon, srv.busname, OpenVPN3DBus_interf_debug,
+                      srv.root_path);
+        res = prx.Call("GetResourceUsage");
+    }
+    catch (DBusException& excp)
+    {
+        std::cerr << "** " << srv.name << ": " << excp.GetRawError()
+                  << std::endl;
+        return false;
+    }
+    if (!res)
+    {
+        return false;
+    }
+
+    GVariantIter *objects = nullptr;
+    GVariantIter *process = nullptr;
+    gchar *mallocinfo = nullptr;
+    g_variant_get(res, "(a(stt)a(st)s)", &objects, &process, &mallocinfo);
+
+    std::cout << "Service: " << srv.name << std::endl;
+
+    gchar *name = nullptr;
+    guint64 count = 0;
+    guint64 bytes = 0;
+    while (g_variant_iter_next(objects, "(stt)", &name, &count, &bytes))
+    {
+        std::cout << "    " << std::setw(28) << std::left << name
+                  << std::setw(12) << std::right << count
+                  << std::setw(14) << bytes
+                  << std::endl;
+        g_free(name);
+    }
+    g_variant_iter_free(objects);
+
+    guint64 value = 0;
+    while (g_variant_iter_next(process, "(st)", &name, &value))
+    {
+        std::cout << "    " << std::setw(28) << std::left << name
+                  << std::setw(26) << std::right << value
+                  << std::endl;
+        g_free(name);
+    }
+    g_variant_iter_free(process);
+
+    if (malloc_info)
+    {
+        std::cout << mallocinfo << std::endl;
+    }
+    std::cout << std::endl;
+    g_free(mallocinfo);
+    g_variant_unref(res);
+    return true;
+}
+
+
+/**
+ *  openvpn3-admin resource-usage command
+ *
+ *  Lists the number of tracked objects and their approximate memory
+ *  use, together with the process memory and file descriptor usage,
+ *  of the OpenVPN 3 D-Bus services.
+ *
+ * @param args  ParsedArgs object containing all related options and arguments
+ *
+ * @return Returns the exit code which will be returned to the calling shell
+ */
+static int cmd_resource_usage(ParsedArgs::Ptr args)
+{
+    std::string only = args->Present("service")
+                       ? args->GetLastValue("service") : "";
+    bool malloc_info = args->Present("malloc-info");
+
+    std::vector<StatsService> query;
+    for (const auto& s : stats_services)
+    {
+        if (only.empty() || only == s.name)
+        {
+            query.push_back(s);
+        }
+    }
+    if (query.empty())
+    {
+        throw CommandException("resource-usage",
+                               "Unknown service: " + only);
+    }
+
+    DBus dbcon(G_BUS_TYPE_SYSTEM);
+    dbcon.Connect();
+
+    std::cout << "    " << std::setw(28) << std::left << "Resource"
+              << std::setw(12) << std::right << "Count"
+              << std::setw(14) << "Bytes"
+              << std::endl
+              << "    " << std::setw(54) << std::setfill('-') << "-"
+              << std::setfill(' ') << std::endl;
+
+    bool failed = false;
+    for (const auto& s : query)
+    {
+        failed |= !process_resource_usage(dbcon, s, malloc_info);
+    }
+
+    if (failed)
+    {
+        std::cerr << "** Some services could not be queried.  Ensure you run "
+                  << "this command as the root or " << OPENVPN_USERNAME
+                  << " user." << std::endl;
+        return 2;
+    }
+    return 0;
+}
+
+
+/**
+ *  Creates the SingleCommand object for the 'resource-usage' command
+ *
+ * @return  Returns a SingleCommand::Ptr object declaring the command
+ */
+SingleCommand::Ptr prepare_command_resource_usage()
+{
+    SingleCommand::Ptr cmd;
+    cmd.reset(new SingleCommand("resource-usage",
+                                "Show memory and resource usage of "
+                                "the OpenVPN 3 services",
+                                cmd_resource_usage));
+    cmd->AddOption("service", 's', "NAME", true,
+                   "Only process this service",
+                   arghelper_method_stats_services);
+    cmd->AddOption("malloc-info",
+                   "Include the heap allocator state of each service");
+
+    return cmd;
+}
@@ -0,0 +1,662 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   metrics.cpp
+ *
+ * @brief  Command exporting OpenVPN 3 Linux metrics in the OpenMetrics
+ *         (Prometheus) text format
+ */
+
+#include <csignal>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <gio/gunixsocketaddress.h>
+#include <glib-unix.h>
+
+#include "dbus/core.hpp"
+#include "dbus/glibutils.hpp"
+#include "common/cmdargparser.hpp"
+#include "common/utils.hpp"
+#include "log/proxy-log.hpp"
+#include "netcfg/netcfg-changeevent.hpp"
+#include "netcfg/proxy-netcfg-mgr.hpp"
+#include "sessionmgr/proxy-sessionmgr.hpp"
+#include "sessionmgr/sessionmgr-events.hpp"
+#include "../arghelpers.hpp"
+
+
+/**
+ *  Escapes a label value according to the OpenMetrics text format
+ *
+ * @param value  std::string with the raw label value
+ * @return Returns the escaped label value
+ */
+static std::string metrics_label(const std::string& value)
+{
+    std::string ret;
+    ret.reserve(value.size());
+    for (const char c : value)
+    {
+        switch (c)
+        {
+        case '\\':
+            ret += "\\\\";
+            break;
+        case '"':
+            ret += "\\\"";
+            break;
+        case '\n':
+            ret += "\\n";
+            break;
+        default:
+            ret += c;
+        }
+    }
+    return ret;
+}
+
+
+
+/**
+ *  Tracks the state and statistics of all VPN sessions, updated from
+ *  the SessionManagerEvent, StatusChange and Statistics signals sent by
+ *  the session manager.  Nothing is polled when metrics are rendered.
+ */
+class SessionMetrics : public DBusSignalSubscription
+{
+public:
+    SessionMetrics(DBus& dbuscon, const uint32_t interval_ms)
+        : DBusSignalSubscription(dbuscon,
+                                 OpenVPN3DBus_name_sessions,
+                                 OpenVPN3DBus_interf_sessions,
+                                 OpenVPN3DBus_rootp_sessions),
+          dbus(dbuscon), stats_interval(interval_ms),
+          manager(dbuscon)
+    {
+        Subscribe("SessionManagerEvent");
+        try
+        {
+            manager.EventSubscribe();
+        }
+        catch (const DBusException&)
+        {
+            // Older session managers broadcast these signals instead
+        }
+
+        // StatusChange and Statistics signals are sent from each of
+        // the session objects; a single subscription covers all of them
+        Subscribe(OpenVPN3DBus_name_sessions, "", "StatusChange");
+        Subscribe(OpenVPN3DBus_name_sessions, "", "Statistics");
+
+        for (const auto& sd : manager.FetchSessionsDetailed())
+        {
+            Session& s = add_session(sd.path);
+            s.config_name = sd.config_name;
+            s.device_name = sd.device_name;
+            s.status = sd.status;
+        }
+    }
+
+
+    ~SessionMetrics()
+    {
+        for (auto& s : sessions)
+        {
+            try
+            {
+                s.second.proxy->StatisticsSubscribe(0);
+            }
+            catch (const DBusException&)
+            {
+                // The session may already be gone
+            }
+        }
+        Cleanup();
+    }
+
+
+    void callback_signal_handler(GDBusConnection *connection,
+                                 const std::string sender_name,
+                                 const std::string object_path,
+                                 const std::string interface_name,
+                                 const std::string signal_name,
+                                 GVariant *parameters) override
+    {
+        try
+        {
+            if ("SessionManagerEvent" == signal_name)
+            {
+                SessionManager::Event ev(parameters);
+                switch (ev.type)
+                {
+                case SessionManager::EventType::SESS_CREATED:
+                    (void) add_session(ev.path);
+                    break;
+
+                case SessionManager::EventType::SESS_DESTROYED:
+                    sessions.erase(ev.path);
+                    break;
+
+                default:
+                    break;
+                }
+            }
+            else if ("StatusChange" == signal_name)
+            {
+                auto s = sessions.find(object_path);
+                if (sessions.end() == s)
+                {
+                    return;
+                }
+                s->second.status = StatusEvent(parameters);
+                ++s->second.status_changes;
+                if (s->second.device_name.empty()
+                    && s->second.status.Check(StatusMajor::CONNECTION,
+                                              StatusMinor::CONN_CONNECTED))
+                {
+                    // The device name is first known once connected
+                    s->second.device_name = s->second.proxy->GetDeviceName();
+                }
+            }
+            else if ("Statistics" == signal_name)
+            {
+                auto s = sessions.find(object_path);
+                if (sessions.end() == s)
+                {
+                    return;
+                }
+                auto sig = GLibUtils::Unmarshal<std::tuple<uint32_t,
+                                                std::vector<uint64_t>>>(parameters);
+                if (std::get<0>(sig) != s->second.layout_id)
+                {
+                    s->second.keys = s->second.proxy->GetConnectionStatsLayout(s->second.layout_id);
+                }
+                s->second.values = std::get<1>(sig);
+            }
+        }
+        catch (const DBusException& excp)
+        {
+            std::cerr << "Failed to process " << signal_name << " from "
+                      << object_path << ": " << excp.GetRawError()
+                      << std::endl;
+        }
+    }
+
+
+    /**
+     *  Writes all session metrics in the OpenMetrics text format
+     *
+     * @param out  std::ostream to write the metrics to
+     */
+    void Render(std::ostream& out) const
+    {
+        out << "# TYPE openvpn3_sessions gauge" << std::endl
+            << "# HELP openvpn3_sessions Number of VPN sessions" << std::endl
+            << "openvpn3_sessions " << sessions.size() << std::endl;
+
+        out << "# TYPE openvpn3_session info" << std::endl
+            << "# HELP openvpn3_session VPN session details" << std::endl;
+        for (const auto& s : sessions)
+        {
+            out << "openvpn3_session_info{session_path=\""
+                << metrics_label(s.first) << "\",config_name=\""
+                << metrics_label(s.second.config_name) << "\",device=\""
+                << metrics_label(s.second.device_name) << "\"} 1"
+                << std::endl;
+        }
+
+        out << "# TYPE openvpn3_session_connected gauge" << std::endl
+            << "# HELP openvpn3_session_connected 1 if the VPN session is "
+            << "connected" << std::endl;
+        for (const auto& s : sessions)
+        {
+            out << "openvpn3_session_connected{session_path=\""
+                << metrics_label(s.first) << "\"} "
+                << (s.second.status.Check(StatusMajor::CONNECTION,
+                                          StatusMinor::CONN_CONNECTED) ? 1 : 0)
+                << std::endl;
+        }
+
+        out << "# TYPE openvpn3_session_status_minor gauge" << std::endl
+            << "# HELP openvpn3_session_status_minor Last StatusMinor code "
+            << "of the VPN session" << std::endl;
+        for (const auto& s : sessions)
+        {
+            out << "openvpn3_session_status_minor{session_path=\""
+                << metrics_label(s.first) << "\",major=\""
+                << (unsigned int) s.second.status.major << "\"} "
+                << (unsigned int) s.second.status.minor << std::endl;
+        }
+
+        out << "# TYPE openvpn3_session_status_changes counter" << std::endl
+            << "# HELP openvpn3_session_status_changes StatusChange signals "
+            << "seen for the VPN session" << std::endl;
+        for (const auto& s : sessions)
+        {
+            out << "openvpn3_session_status_changes_total{session_path=\""
+                << metrics_label(s.first) << "\"} "
+                << s.second.status_changes << std::endl;
+        }
+
+        out << "# TYPE openvpn3_session_statistic counter" << std::endl
+            << "# HELP openvpn3_session_statistic VPN session connection "
+            << "statistics counters" << std::endl;
+        for (const auto& s : sessions)
+        {
+            const Session& sess = s.second;
+            for (size_t i = 0; i < sess.keys.size() && i < sess.values.size(); ++i)
+            {
+                out << "openvpn3_session_statistic_total{session_path=\""
+                    << metrics_label(s.first) << "\",counter=\""
+                    << metrics_label(sess.keys[i]) << "\"} "
+                    << sess.values[i] << std::endl;
+            }
+        }
+    }
+
+
+private:
+    struct Session
+    {
+        OpenVPN3SessionProxy::Ptr proxy;
+        std::string config_name;
+        std::string device_name;
+        StatusEvent status;
+        uint64_t status_changes = 0;
+        uint32_t layout_id = 0;
+        std::vector<std::string> keys;
+        std::vector<uint64_t> values;
+    };
+
+    DBus& dbus;
+    const uint32_t stats_interval;
+    OpenVPN3SessionMgrProxy manager;
+    std::map<std::string, Session> sessions;
+
+
+    Session& add_session(const std::string& path)
+    {
+        Session& s = sessions[path];
+        if (s.proxy)
+        {
+            return s;
+        }
+        s.proxy.reset(new OpenVPN3SessionProxy(dbus, path));
+        try
+        {
+            // The first values arrive with the first Statistics signal
+            s.keys = s.proxy->GetConnectionStatsLayout(s.layout_id);
+            s.proxy->StatisticsSubscribe(stats_interval);
+        }
+        catch (const DBusException& excp)
+        {
+            // Sessions without a registered backend yet will be
+            // picked up again via the StatusChange signals
+            std::cerr << "Could not subscribe to statistics for "
+                      << path << ": " << excp.GetRawError() << std::endl;
+        }
+        return s;
+    }
+};
+
+
+
+/**
+ *  Counts the NetworkChange signals sent by the netcfg service, per
+ *  change type.
+ */
+class NetCfgMetrics : public DBusSignalSubscription
+{
+public:
+    NetCfgMetrics(DBus& dbuscon)
+        : DBusSignalSubscription(dbuscon,
+                                 OpenVPN3DBus_name_netcfg,
+                                 OpenVPN3DBus_interf_netcfg,
+                                 ""),
+          netcfgmgr(dbuscon.GetConnection())
+    {
+        // NetworkChange signals are sent from the device objects
+        Subscribe(OpenVPN3DBus_name_netcfg, "", "NetworkChange");
+        netcfgmgr.NotificationSubscribe((NetCfgChangeType) 0xffff);
+    }
+
+
+    ~NetCfgMetrics()
+    {
+        try
+        {
+            netcfgmgr.NotificationUnsubscribe();
+        }
+        catch (const NetCfgProxyException&)
+        {
+            // The service may already be gone
+        }
+        Cleanup();
+    }
+
+
+    void callback_signal_handler(GDBusConnection *connection,
+                                 const std::string sender_name,
+                                 const std::string object_path,
+                                 const std::string interface_name,
+                                 const std::string signal_name,
+                                 GVariant *parameters) override
+    {
+        if ("NetworkChange" != signal_name)
+        {
+            return;
+        }
+        NetCfgChangeEvent ev(parameters);
+        ++events[NetCfgChangeEvent::TypeStr(ev.type, true)];
+    }
+
+
+    void Render(std::ostream& out) const
+    {
+        out << "# TYPE openvpn3_netcfg_events counter" << std::endl
+            << "# HELP openvpn3_netcfg_events NetworkChange events sent by "
+            << "the netcfg service" << std::endl;
+        for (const auto& e : events)
+        {
+            out << "openvpn3_netcfg_events_total{type=\""
+                << metrics_label(e.first) << "\"} " << e.second << std::endl;
+        }
+    }
+
+
+private:
+    NetCfgProxy::Manager netcfgmgr;
+    std::map<std::string, uint64_t> events;
+};
+
+
+
+/**
+ *  Serves the collected metrics over a unix socket or a TCP port bound
+ *  to localhost.  Plain HTTP GET requests get a HTTP/1.0 response; any
+ *  other client, like socat, gets the bare OpenMetrics text.
+ */
+class MetricsExporter
+{
+public:
+    MetricsExporter(DBus& dbuscon, const uint32_t interval_ms,
+                    const bool with_netcfg)
+        : sessions(dbuscon, interval_ms),
+          logsrv(dbuscon.GetConnection())
+    {
+        if (with_netcfg)
+        {
+            netcfg.reset(new NetCfgMetrics(dbuscon));
+        }
+        service = g_socket_service_new();
+        g_signal_connect(service, "incoming",
+                         G_CALLBACK(incoming_cb), this);
+    }
+
+
+    ~MetricsExporter()
+    {
+        g_socket_service_stop(service);
+        g_socket_listener_close(G_SOCKET_LISTENER(service));
+        g_object_unref(service);
+        if (!unix_path.empty())
+        {
+            ::unlink(unix_path.c_str());
+        }
+    }
+
+
+    void ListenUnix(const std::string& path)
+    {
+        ::unlink(path.c_str());
+        GSocketAddress *addr = g_unix_socket_address_new(path.c_str());
+        listen(addr, path);
+        unix_path = path;
+    }
+
+
+    void ListenLocalhost(const uint16_t port)
+    {
+        GInetAddress *lo = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+        GSocketAddress *addr = g_inet_socket_address_new(lo, port);
+        g_object_unref(lo);
+        listen(addr, "127.0.0.1:" + std::to_string(port));
+    }
+
+
+    void Start()
+    {
+        g_socket_service_start(service);
+    }
+
+
+    /**
+     *  Renders all metrics in the OpenMetrics text format.  Only the log
+     *  service counters are retrieved here, in a single GetAll() call.
+     */
+    std::string Render()
+    {
+        std::stringstream out;
+        sessions.Render(out);
+        if (netcfg)
+        {
+            netcfg->Render(out);
+        }
+        render_logservice(out);
+        out << "# EOF" << std::endl;
+        return out.str();
+    }
+
+
+private:
+    SessionMetrics sessions;
+    std::unique_ptr<NetCfgMetrics> netcfg;
+    LogServiceProxy logsrv;
+    GSocketService *service = nullptr;
+    std::string unix_path;
+
+
+    void listen(GSocketAddress *addr, const std::string& descr)
+    {
+        GError *err = nullptr;
+        gboolean r = g_socket_listener_add_address(G_SOCKET_LISTENER(service),
+                                                   addr,
+                                                   G_SOCKET_TYPE_STREAM,
+                                                   G_SOCKET_PROTOCOL_DEFAULT,
+                                                   nullptr, nullptr, &err);
+        g_object_unref(addr);
+        if (!r)
+        {
+            std::string msg = "Could not listen on " + descr + ": "
+                              + std::string(err ? err->message : "(unknown)");
+            g_clear_error(&err);
+            throw CommandException("metrics-exporter", msg);
+        }
+    }
+
+
+    void render_logservice(std::ostream& out)
+    {
+        try
+        {
+            logsrv.EnablePropertyCache();
+            logsrv.InvalidatePropertyCache();
+            g_variant_unref(logsrv.GetAllProperties());
+
+            out << "# TYPE openvpn3_log_events_received counter" << std::endl
+                << "openvpn3_log_events_received_total "
+                << logsrv.GetEventsReceived() << std::endl
+                << "# TYPE openvpn3_log_events_written counter" << std::endl
+                << "openvpn3_log_events_written_total "
+                << logsrv.GetEventsWritten() << std::endl
+                << "# TYPE openvpn3_log_events_dropped counter" << std::endl
+                << "openvpn3_log_events_dropped_total "
+                << logsrv.GetEventsDropped() << std::endl
+                << "# TYPE openvpn3_log_queue_depth gauge" << std::endl
+                << "openvpn3_log_queue_depth "
+                << logsrv.GetQueueDepth() << std::endl;
+        }
+        catch (const DBusException& excp)
+        {
+            std::cerr << "Failed to retrieve log service counters: "
+                      << excp.GetRawError() << std::endl;
+        }
+    }
+
+
+    static gboolean incoming_cb(GSocketService *svc,
+                                GSocketConnection *conn,
+                                GObject *source,
+                                gpointer this_ptr)
+    {
+        MetricsExporter *self = static_cast<MetricsExporter *>(this_ptr);
+
+        // Don't let a silent client block the main loop for long
+        GSocket *sock = g_socket_connection_get_socket(conn);
+        g_socket_set_timeout(sock, 1);
+
+        char req[1024] = {};
+        gssize len = g_input_stream_read(
+                        g_io_stream_get_input_stream(G_IO_STREAM(conn)),
+                        req, sizeof(req) - 1, nullptr, nullptr);
+        bool http = (len > 4 && 0 == strncmp(req, "GET ", 4));
+
+        std::string body = self->Render();
+        std::stringstream resp;
+        if (http)
+        {
+            resp << "HTTP/1.0 200 OK\r\n"
+                 << "Content-Type: application/openmetrics-text; "
+                 << "version=1.0.0; charset=utf-8\r\n"
+                 << "Content-Length: " << body.size() << "\r\n"
+                 << "\r\n";
+        }
+        resp << body;
+
+        std::string r = resp.str();
+        g_output_stream_write_all(g_io_stream_get_output_stream(G_IO_STREAM(conn)),
+                                  r.c_str(), r.size(), nullptr,
+                                  nullptr, nullptr);
+        g_io_stream_close(G_IO_STREAM(conn), nullptr, nullptr);
+        return TRUE;
+    }
+};
+
+
+
+/**
+ *  openvpn3-admin metrics-exporter command
+ *
+ *  Runs until interrupted, keeping the metrics updated from D-Bus signals
+ *  and serving them to any client connecting to the listening socket.
+ *
+ * @param args  ParsedArgs object containing all related options and arguments
+ * @return Returns the exit code which will be returned to the calling shell
+ */
+static int cmd_metrics_exporter(ParsedArgs::Ptr args)
+{
+    if (!args->Present("unix-socket") && !args->Present("port"))
+    {
+        throw CommandException("metrics-exporter",
+                               "Either --unix-socket or --port is required");
+    }
+
+    uint32_t interval = 5000;
+    if (args->Present("interval"))
+    {
+        interval = std::atoi(args->GetLastValue("interval").c_str());
+        if (0 == interval)
+        {
+            throw CommandException("metrics-exporter",
+                                   "Invalid --interval value");
+        }
+    }
+
+    GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, stop_handler, main_loop);
+    g_unix_signal_add(SIGTERM, stop_handler, main_loop);
+
+    try
+    {
+        DBus dbuscon(G_BUS_TYPE_SYSTEM);
+        dbuscon.Connect();
+
+        MetricsExporter exporter(dbuscon, interval,
+                                 !args->Present("no-netcfg"));
+        if (args->Present("unix-socket"))
+        {
+            exporter.ListenUnix(args->GetLastValue("unix-socket"));
+        }
+        if (args->Present("port"))
+        {
+            int port = std::atoi(args->GetLastValue("port").c_str());
+            if (port < 1 || port > 65535)
+            {
+                throw CommandException("metrics-exporter",
+                                       "Invalid --port value");
+            }
+            exporter.ListenLocalhost(port);
+        }
+        exporter.Start();
+
+        // Runs until SIGINT or SIGTERM is received
+        g_main_loop_run(main_loop);
+    }
+    catch (const DBusException& excp)
+    {
+        g_main_loop_unref(main_loop);
+        throw CommandException("metrics-exporter", excp.GetRawError());
+    }
+    catch (...)
+    {
+        g_main_loop_unref(main_loop);
+        throw;
+    }
+    g_main_loop_unref(main_loop);
+    return 0;
+}
+
+
+/**
+ *  Creates the SingleCommand object for the 'metrics-exporter' command
+ *
+ * @return  Returns a SingleCommand::Ptr object declaring the command
+ */
+SingleCommand::Ptr prepare_command_metrics_exporter()
+{
+    SingleCommand::Ptr cmd;
+    cmd.reset(new SingleCommand("metrics-exporter",
+                                "Serve OpenMetrics/Prometheus metrics of "
+                                "all OpenVPN 3 services (requires root)",
+                                cmd_metrics_exporter));
+    cmd->AddOption("unix-socket", 0, "PATH", true,
+                   "Serve metrics on a unix socket");
+    cmd->AddOption("port", 'p', "PORT", true,
+                   "Serve metrics over HTTP on 127.0.0.1:PORT");
+    cmd->AddOption("interval", 0, "MSECS", true,
+                   "Requested session statistics update interval "
+                   "(default: 5000)");
+    cmd->AddOption("no-netcfg",
+                   "Do not subscribe to netcfg NetworkChange events");
+
+    return cmd;
+}
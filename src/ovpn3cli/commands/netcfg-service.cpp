@@ -96,6 +96,10 @@ int cmd_netcfg_service(ParsedArgs::Ptr args)
                 {
                     std::cout << "        " << e << std::endl;
                 }
+                if (sub.second & NetCfgSubscriptions::FLAG_BATCHED)
+                {
+                    std::cout << "        (batched delivery)" << std::endl;
+                }
                 std::cout << std::endl;
             }
             return 0;
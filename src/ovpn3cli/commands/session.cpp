@@ -23,10 +23,15 @@
  * @brief  Commands to start and manage VPN sessions
  */
 
+#include <chrono>
 #include <csignal>
+#include <deque>
+#include <map>
+#include <memory>
 #include <json/json.h>
 
 #include "dbus/core.hpp"
+#include "dbus/object-handle.hpp"
 #include "common/cmdargparser.hpp"
 #include "common/lookup.hpp"
 #include "common/open-uri.hpp"
@@ -74,13 +79,22 @@ static ConnectionStats fetch_stats(std::string session_path)
 }
 
 
+/**
+ *  Per-second change rates of statistics counters, indexed by the
+ *  statistics key.  Used by session-stats --watch.
+ */
+using StatisticsRates = std::map<std::string, double>;
+
+
 /**
  *  Converts ConnectionStats into a plain-text string
  *
  * @param stats  The ConnectionStats object returned by fetch_stats()
+ * @param rates  Optional StatisticsRates to show next to the counters
  * @return Returns std::string with the statistics pre-formatted as text/plain
  */
-std::string statistics_plain(ConnectionStats& stats)
+std::string statistics_plain(ConnectionStats& stats,
+                             const StatisticsRates& rates = {})
 {
     if (stats.size() < 1)
     {
@@ -95,8 +109,14 @@ std::string statistics_plain(ConnectionStats& stats)
             << sd.key
             << std::setw(20-sd.key.size()) << std::setfill('.') << "."
             << std::setw(12) << std::setfill('.')
-            << sd.value
-            << std::endl;
+            << sd.value;
+        auto r = rates.find(sd.key);
+        if (rates.end() != r)
+        {
+            out << std::setfill(' ') << std::fixed << std::setprecision(1)
+                << std::setw(14) << r->second << "/s";
+        }
+        out << std::endl;
     }
     out << std::endl;
     return out.str();
@@ -108,9 +128,11 @@ std::string statistics_plain(ConnectionStats& stats)
  *  statistics data
  *
  * @param stats  The ConnectionStats object returned by fetch_stats()
+ * @param rates  Optional StatisticsRates, added as a "rates" object
  * @return Returns std::string with the statistics pre-formatted as JSON
  *  */
-static std::string statistics_json(ConnectionStats& stats)
+static std::string statistics_json(ConnectionStats& stats,
+                                   const StatisticsRates& rates = {})
 {
     Json::Value outdata;
 
@@ -118,12 +140,146 @@ static std::string statistics_json(ConnectionStats& stats)
     {
         outdata[sd.key] = (Json::Value::Int64) sd.value;
     }
+    for (const auto& r : rates)
+    {
+        outdata["rates"][r.first] = r.second;
+    }
     std::stringstream res;
     res << outdata;
     res << std::endl;
     return res.str();
 }
 
+/**
+ *  Prints the statistics of a session each time the session manager
+ *  sends a Statistics signal.  This is used by session-stats --watch,
+ *  which avoids polling the session for all the statistics counters.
+ *
+ *  The byte and packet counters are also shown as per-second rates,
+ *  calculated from the previous update and the time between them.
+ */
+class SessionStatsWatch : public DBusSignalSubscription
+{
+public:
+    SessionStatsWatch(DBus& dbuscon, const std::string& session_path,
+                      const bool json)
+        : DBusSignalSubscription(dbuscon,
+                                 OpenVPN3DBus_name_sessions,
+                                 OpenVPN3DBus_interf_sessions,
+                                 session_path),
+          session(dbuscon, session_path),
+          json(json)
+    {
+        if (!session.CheckObjectExists())
+        {
+            throw CommandException("session-stats",
+                                   "Session not found");
+        }
+        keys = session.GetConnectionStatsLayout(layout_id);
+        Subscribe("Statistics");
+    }
+
+
+    ~SessionStatsWatch()
+    {
+        try
+        {
+            session.StatisticsSubscribe(0);
+        }
+        catch (const DBusException&)
+        {
+            // The session may already be gone
+        }
+    }
+
+
+    /**
+     *  Prints the current statistics and subscribes to further updates
+     *
+     * @param interval_ms  Requested update interval, in milliseconds
+     */
+    void Start(const uint32_t interval_ms)
+    {
+        print_stats(session.GetPackedConnectionStats());
+        session.StatisticsSubscribe(interval_ms);
+    }
+
+
+    void callback_signal_handler(GDBusConnection *connection,
+                                 const std::string sender_name,
+                                 const std::string object_path,
+                                 const std::string interface_name,
+                                 const std::string signal_name,
+                                 GVariant *parameters) override
+    {
+        if ("Statistics" != signal_name)
+        {
+            return;
+        }
+
+        try
+        {
+            auto sig = GLibUtils::Unmarshal<std::tuple<uint32_t,
+                                            std::vector<uint64_t>>>(parameters);
+            if (std::get<0>(sig) != layout_id)
+            {
+                keys = session.GetConnectionStatsLayout(layout_id);
+            }
+            print_stats(std::get<1>(sig));
+        }
+        catch (const DBusException& excp)
+        {
+            std::cerr << "Failed to process statistics: "
+                      << excp.GetRawError() << std::endl;
+        }
+    }
+
+
+private:
+    OpenVPN3SessionProxy session;
+    const bool json;
+    uint32_t layout_id = 0;
+    std::vector<std::string> keys = {};
+    std::map<std::string, uint64_t> prev_values = {};
+    std::chrono::steady_clock::time_point prev_time = {};
+
+
+    void print_stats(const std::vector<uint64_t>& values)
+    {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - prev_time).count();
+        bool have_prev = !prev_values.empty() && elapsed > 0;
+
+        ConnectionStats stats;
+        StatisticsRates rates;
+        for (size_t i = 0; i < keys.size() && i < values.size(); ++i)
+        {
+            if (0 < values[i])
+            {
+                stats.push_back(ConnectionStatDetails(keys[i], values[i]));
+            }
+
+            if (keys[i].find("BYTES") == std::string::npos
+                && keys[i].find("PACKETS") == std::string::npos)
+            {
+                continue;
+            }
+            auto p = prev_values.find(keys[i]);
+            if (have_prev && prev_values.end() != p && values[i] >= p->second)
+            {
+                rates[keys[i]] = (values[i] - p->second) / elapsed;
+            }
+            prev_values[keys[i]] = values[i];
+        }
+        prev_time = now;
+
+        std::cout << (json ? statistics_json(stats, rates)
+                           : statistics_plain(stats, rates))
+                  << std::flush;
+    }
+};
+
+
 bool sigint_received = false; /**< Global flag indicating SIGINT event */
 /**
  *  Signal handler called on SIGINT events.  This just sets
@@ -172,6 +328,108 @@ bool start_url_auth(const std::string& url)
 }
 
 
+/**
+ *  Collects the StatusChange signals of a single session while
+ *  @start_session() waits for the connection to be established.  This
+ *  way the wait ends as soon as the session reports a new state,
+ *  instead of polling the session for its last status.
+ */
+class SessionStatusWait : public DBusSignalSubscription
+{
+public:
+    SessionStatusWait(DBus& dbuscon, const std::string& session_path)
+        : DBusSignalSubscription(dbuscon,
+                                 OpenVPN3DBus_name_sessions,
+                                 OpenVPN3DBus_interf_sessions,
+                                 session_path)
+    {
+        Subscribe("StatusChange");
+    }
+
+
+    /**
+     *  Forgets all the status changes not yet retrieved by Next()
+     */
+    void Clear()
+    {
+        events.clear();
+    }
+
+
+    /**
+     *  Retrieves the next status change of the session, waiting for it
+     *  to arrive if needed.  The wait is also interrupted by signals
+     *  like SIGINT.
+     *
+     * @param ev          StatusEvent to store the status change in
+     * @param timeout_ms  Maximum time to wait, in milliseconds
+     *
+     * @return Returns true if a status change was retrieved, otherwise
+     *         false if the wait was interrupted or timed out
+     */
+    bool Next(StatusEvent& ev, const guint timeout_ms)
+    {
+        if (events.empty())
+        {
+            timed_out = false;
+            guint timer = g_timeout_add(timeout_ms, wait_timeout, this);
+            while (events.empty() && !timed_out && !sigint_received)
+            {
+                g_main_context_iteration(NULL, TRUE);
+            }
+            if (!timed_out)
+            {
+                g_source_remove(timer);
+            }
+        }
+
+        if (events.empty())
+        {
+            return false;
+        }
+        ev = events.front();
+        events.pop_front();
+        return true;
+    }
+
+
+    void callback_signal_handler(GDBusConnection *connection,
+                                 const std::string sender_name,
+                                 const std::string object_path,
+                                 const std::string interface_name,
+                                 const std::string signal_name,
+                                 GVariant *parameters) override
+    {
+        if ("StatusChange" != signal_name)
+        {
+            return;
+        }
+        try
+        {
+            events.push_back(StatusEvent(parameters));
+        }
+        catch (const DBusException&)
+        {
+            // Ignore malformed signals; the status is polled instead
+            // if nothing else arrives
+        }
+    }
+
+
+private:
+    std::deque<StatusEvent> events = {};
+    bool timed_out = false;
+
+
+    static gboolean wait_timeout(gpointer this_ptr)
+    {
+        static_cast<SessionStatusWait *>(this_ptr)->timed_out = true;
+        return G_SOURCE_REMOVE;
+    }
+};
+
+
+
 /**
  *  Defines which start modes used by @start_session()
  */
@@ -215,6 +473,18 @@ static void start_session(OpenVPN3SessionProxy::Ptr session,
     sigemptyset(&sact.sa_mask);
     sigaction(SIGINT, &sact, NULL);
 
+    // Subscribe to the status changes of the session before starting it,
+    // so none are missed.  If that is not possible, the status is polled.
+    std::unique_ptr<SessionStatusWait> status_wait;
+    try
+    {
+        status_wait.reset(new SessionStatusWait(*session, session->GetPath()));
+    }
+    catch (const DBusException&)
+    {
+        status_wait.reset();
+    }
+
     // Start or restart the session
     SessionStartMode mode = initial_mode;
     unsigned int loops = 10;
@@ -224,6 +494,10 @@ static void start_session(OpenVPN3SessionProxy::Ptr session,
         try
         {
             session->Ready();  // If not, an exception will be thrown
+            if (status_wait)
+            {
+                status_wait->Clear();
+            }
             switch (mode)
             {
             case SessionStartMode::START:
@@ -253,14 +527,25 @@ static void start_session(OpenVPN3SessionProxy::Ptr session,
 
             // Attempt to connect until the given timeout has been reached.
             // If timeout has been disabled (-1), loop forever.
+            // The status is polled right away, in case the session changed
+            // state before the subscription was in place, and later on
+            // only when no status change has been signalled for a while.
             time_t op_start = time(0);
             StatusEvent s;
+            bool poll_status = true;
             while ((-1 == timeout) || ((op_start + timeout) >= time(0)))
             {
-                usleep(300000);  // sleep 0.3 seconds - avg setup time
                 try
                 {
-                    s = session->GetLastStatus();
+                    if (!poll_status && !status_wait->Next(s, 1000))
+                    {
+                        poll_status = !sigint_received;
+                    }
+                    if (poll_status)
+                    {
+                        s = session->GetLastStatus();
+                        poll_status = !status_wait;
+                    }
                 }
                 catch (DBusException& excp)
                 {
@@ -326,7 +611,10 @@ static void start_session(OpenVPN3SessionProxy::Ptr session,
                     throw SessionException("Session stopped");
                 }
 
-                sleep(1);  // If not yet connected, wait for 1 second
+                if (!status_wait)
+                {
+                    usleep(300000);  // No signals; poll again in 0.3 seconds
+                }
             }
             time_t now = time(0);
             if ((op_start + timeout) <= now)
@@ -342,34 +630,32 @@ static void start_session(OpenVPN3SessionProxy::Ptr session,
         catch (const ReadyException&)
         {
             // If the ReadyException is thrown, it means the backend
-            // needs more from the front-end side
-            for (auto& type_group : session->QueueCheckTypeGroup())
+            // needs more from the front-end side.  Retrieve all the
+            // outstanding requests at once and respond in a single call.
+            std::vector<struct RequiresSlot> reqslots;
+            for (auto& r : session->QueueFetchAll())
             {
-                ClientAttentionType type;
-                ClientAttentionGroup group;
-                std::tie(type, group) = type_group;
+                if (ClientAttentionType::CREDENTIALS != r.type)
+                {
+                    continue;
+                }
 
-                if (ClientAttentionType::CREDENTIALS == type)
+                std::cout << r.user_description << ": ";
+                if (r.hidden_input)
                 {
-                    std::vector<struct RequiresSlot> reqslots;
-                    session->QueueFetchAll(reqslots, type, group);
-                    for (auto& r : reqslots)
-                    {
-                        std::cout << r.user_description << ": ";
-                        if (r.hidden_input)
-                        {
-                            set_console_echo(false);
-                        }
-                        std::getline(std::cin, r.value);
-                        if (r.hidden_input)
-                        {
-                            std::cout << std::endl;
-                            set_console_echo(true);
-
-                        }
-                        session->ProvideResponse(r);
-                    }
+                    set_console_echo(false);
                 }
+                std::getline(std::cin, r.value);
+                if (r.hidden_input)
+                {
+                    std::cout << std::endl;
+                    set_console_echo(true);
+                }
+                reqslots.push_back(r);
+            }
+            if (!reqslots.empty())
+            {
+                session->ProvideResponses(reqslots);
             }
         }
         catch (DBusException& err)
@@ -438,6 +724,43 @@ static int cmd_session_stats(ParsedArgs::Ptr args)
             sesspath = args->GetValue("path", 0);
         }
 
+        if (args->Present("watch"))
+        {
+            uint32_t interval = 1000;
+            if (args->GetValueLen("watch") > 0)
+            {
+                interval = std::atoi(args->GetLastValue("watch").c_str());
+                if (0 == interval)
+                {
+                    throw CommandException("session-stats",
+                                           "Invalid --watch interval");
+                }
+            }
+
+            GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
+            g_unix_signal_add(SIGINT, stop_handler, main_loop);
+            g_unix_signal_add(SIGTERM, stop_handler, main_loop);
+
+            DBus dbuscon(G_BUS_TYPE_SYSTEM);
+            dbuscon.Connect();
+            try
+            {
+                SessionStatsWatch watch(dbuscon, sesspath,
+                                        args->Present("json"));
+                watch.Start(interval);
+
+                // Runs until SIGINT or SIGTERM is received
+                g_main_loop_run(main_loop);
+            }
+            catch (const DBusException& excp)
+            {
+                g_main_loop_unref(main_loop);
+                throw CommandException("session-stats", excp.GetRawError());
+            }
+            g_main_loop_unref(main_loop);
+            return 0;
+        }
+
         ConnectionStats stats = fetch_stats(sesspath);
 
         std::cout << (args->Present("json") ? statistics_json(stats)
@@ -478,6 +801,9 @@ SingleCommand::Ptr prepare_command_session_stats()
                    "instead",
                    arghelper_managed_interfaces);
     cmd->AddOption("json", 'j', "Dump the configuration in JSON format");
+    cmd->AddOption("watch", 'w', "MSECS", false,
+                   "Keep printing updated statistics, at most every "
+                   "MSECS milliseconds (default: 1000)");
 
     return cmd;
 }
@@ -645,6 +971,72 @@ SingleCommand::Ptr prepare_command_session_start()
 
 
 
+/**
+ *  Retrieve the details of all sessions available to the calling user.
+ *
+ *  The details are retrieved in a single FetchSessionsDetailed call.  If
+ *  the session manager does not provide this method, all the properties
+ *  of each session are retrieved with a single GetAll call per session
+ *  instead.
+ *
+ * @param sessmgr  OpenVPN3SessionMgrProxy to the session manager
+ * @return Returns a std::vector<SessionDetails> of all sessions
+ */
+static std::vector<SessionDetails> fetch_sessions(OpenVPN3SessionMgrProxy& sessmgr)
+{
+    try
+    {
+        return sessmgr.FetchSessionsDetailed();
+    }
+    catch (const DBusException&)
+    {
+        // Older session manager; fall back to querying each session
+    }
+
+    GDBusConnection *dbc = sessmgr.GetConnection();
+    std::vector<SessionDetails> ret;
+    for (const auto& sesspath : sessmgr.FetchAvailableSessionPaths())
+    {
+        DBusObjectHandle sess(dbc, OpenVPN3DBus_name_sessions,
+                              sesspath, OpenVPN3DBus_interf_sessions);
+        try
+        {
+            GVariant *props = sess.GetAllProperties();
+            ret.push_back(SessionDetails(sesspath, props));
+            g_variant_unref(props);
+        }
+        catch (const DBusException&)
+        {
+            // The session has not been initialised properly yet
+            GVariant *empty = g_variant_new("a{sv}", nullptr);
+            g_variant_ref_sink(empty);
+            ret.push_back(SessionDetails(sesspath, empty));
+            g_variant_unref(empty);
+        }
+    }
+    return ret;
+}
+
+
+/**
+ *  Formats the session creation timestamp for sessions-list
+ *
+ * @param created  Session creation time, in seconds since epoch.  0 if
+ *                 not available.
+ * @return Returns a std::string with the formatted timestamp
+ */
+static std::string sessions_list_created(const uint64_t created)
+{
+    if (0 == created)
+    {
+        return "(Not available)";
+    }
+    std::time_t t = created;
+    std::string c = std::asctime(std::localtime(&t));
+    return c.substr(0, c.size() - 1);
+}
+
+
 /**
  *  openvpn3 sessions-list command
  *
@@ -653,6 +1045,10 @@ SingleCommand::Ptr prepare_command_session_start()
  *  or sessions tagged with public_access will be listed.  This restriction
  *  is handled by the Session Manager
  *
+ *  All session details are retrieved in one call to the session manager
+ *  and the current configuration profile names in one call to the
+ *  configuration manager, regardless of the number of sessions.
+ *
  * @param args  ParsedArgs object containing all related options and arguments
  * @return Returns the exit code which will be returned to the calling shell
  */
@@ -661,132 +1057,63 @@ static int cmd_sessions_list(ParsedArgs::Ptr args)
     OpenVPN3SessionMgrProxy sessmgr(G_BUS_TYPE_SYSTEM);
     sessmgr.Ping();
 
-    bool first = true;
-    for (auto& sprx : sessmgr.FetchAvailableSessions())
+    std::vector<SessionDetails> sessions = fetch_sessions(sessmgr);
+
+    // Retrieve the current names of all the configuration profiles
+    // available to the user.  Profiles not found here have been
+    // deleted or are not accessible.
+    std::map<std::string, std::string> config_names;
+    if (!sessions.empty())
     {
-        // Retrieve the name of the configuration profile used
-        std::stringstream config_line;
-        bool config_deleted = false;
         try
         {
-            // Retrieve the current configuration profile name from the
-            // configuration manager
-            std::string cfgname_current = "";
-            std::string config_path = sprx->GetStringProperty("config_path");
-            try
-            {
-                OpenVPN3ConfigurationProxy cprx(G_BUS_TYPE_SYSTEM, config_path);
-                if (cprx.CheckObjectExists(10))
-                {
-                    cfgname_current = cprx.GetStringProperty("name");
-                }
-                else
-                {
-                    config_deleted = true;
-                }
-            }
-            catch (...)
+            OpenVPN3ConfigurationProxy cfgmgr(G_BUS_TYPE_SYSTEM,
+                                              OpenVPN3DBus_rootp_configuration);
+            for (const auto& cfg : cfgmgr.FetchAvailableConfigsDetailed())
             {
-                // Failure is okay here, the profile may be deleted.
-                config_deleted = true;
-            }
-
-            // Retrieve the configuration profile name used when starting
-            // the VPN sessions
-            std::string cfgname = sprx->GetStringProperty("config_name");
-            if (!cfgname.empty())
-            {
-                config_line << " Config name: " << cfgname;
-                if (config_deleted)
-                {
-                    config_line << "  (Config not available)";
-                }
-                else if (cfgname_current != cfgname)
-                {
-                    config_line << "  (Current name: "
-                              << cfgname_current << ")";
-                }
-                config_line << std::endl;
+                config_names[cfg.path] = cfg.name;
             }
         }
-        catch (DBusException &excp)
-        {
-            // The session has not been initialised properly yet, so
-            // configuration name is not available
-            config_line << "";
-        }
-
-
-        // Retrieve the session start timestamp
-        std::string created;
-        try
+        catch (const DBusException&)
         {
-            std::time_t sess_created = sprx->GetUInt64Property("session_created");
-            std::string c = std::asctime(std::localtime(&sess_created));
-            created = c.substr(0, c.size() - 1);
-        }
-        catch (DBusException&)
-        {
-            created = "(Not available)";
-        }
-
-        // Retrieve session owner information and VPN backend process PID
-        std::string owner;
-        pid_t be_pid;
-        try
-        {
-            owner = lookup_username(sprx->GetUIntProperty("owner"));
-            be_pid = sprx->GetUIntProperty("backend_pid");
-        }
-        catch (DBusException&)
-        {
-            owner = "(not available)";
-            be_pid = -1;
-        }
-
-        // Retrieve the tun interface name for this session
-        std::string devname;
-        bool dco = false;
-        try
-        {
-            devname = sprx->GetDeviceName();
-#ifdef ENABLE_OVPNDCO
-            dco = sprx->GetDCO();
-#endif
-        }
-        catch (DBusException&)
-        {
-            // The session may not have been started yet; the error
-            // in this case isn't that valuable so we just consider
-            // the device name not set.
-            devname = "(None)";
+            // Failure is okay here; all profiles are reported as
+            // not available
         }
+    }
 
-        // Retrieve the session name set by the VPN backend
-        std::stringstream sessionname_line;
-        try
+    if (args->Present("json"))
+    {
+        Json::Value out(Json::arrayValue);
+        for (const auto& s : sessions)
         {
-            std::string sessname = sprx->GetStringProperty("session_name");
-            if (!sessname.empty())
+            Json::Value sess;
+            sess["path"] = s.path;
+            sess["config_path"] = s.config_path;
+            sess["config_name"] = s.config_name;
+            auto cfg = config_names.find(s.config_path);
+            if (config_names.end() != cfg)
             {
-                sessionname_line << "Session name: " << sessname << std::endl;
+                sess["config_name_current"] = cfg->second;
             }
+            sess["session_name"] = s.session_name;
+            sess["device_name"] = s.device_name;
+            sess["dco"] = s.dco;
+            sess["owner"] = lookup_username(s.owner);
+            sess["owner_uid"] = (Json::Value::UInt) s.owner;
+            sess["backend_pid"] = (Json::Value::UInt) s.backend_pid;
+            sess["session_created"] = (Json::Value::UInt64) s.session_created;
+            sess["status"]["major"] = (Json::Value::UInt) s.status.major;
+            sess["status"]["minor"] = (Json::Value::UInt) s.status.minor;
+            sess["status"]["message"] = s.status.message;
+            out.append(sess);
         }
-        catch (DBusException&)
-        {
-            // Ignore any errors if this property is unavailable
-            sessionname_line << "";
-        }
-
-        StatusEvent status;
-        try
-        {
-            status = sprx->GetLastStatus();
-        }
-        catch (DBusException&)
-        {
-        }
+        std::cout << out << std::endl;
+        return 0;
+    }
 
+    bool first = true;
+    for (const auto& s : sessions)
+    {
         // Output separator lines
         if (first)
         {
@@ -798,28 +1125,54 @@ static int cmd_sessions_list(ParsedArgs::Ptr args)
         }
         first = false;
 
+        std::string created = sessions_list_created(s.session_created);
+        std::string owner = (s.session_created > 0
+                             ? lookup_username(s.owner)
+                             : "(not available)");
+        std::string devname = (s.device_name.empty() ? "(None)"
+                                                     : s.device_name);
+
         // Output session information
-        std::cout << "        Path: " << sprx->GetProxyPath() << std::endl;
+        std::cout << "        Path: " << s.path << std::endl;
         std::cout << "     Created: " << created
                   << std::setw(47 - created.size()) << std::setfill(' ')
                   << " PID: "
-                  << (be_pid > 0 ? std::to_string(be_pid) : "-")
+                  << (s.backend_pid > 0 ? std::to_string(s.backend_pid) : "-")
                   << std::endl;
         std::cout << "       Owner: " << owner
                   << std::setw(47 - owner.size()) << "Device: " << devname
-                  << (dco ? " (DCO)" : "")
+#ifdef ENABLE_OVPNDCO
+                  << (s.dco ? " (DCO)" : "")
+#endif
                   << std::endl;
-        std::cout << config_line.str();
-        std::cout << sessionname_line.str();
+
+        if (!s.config_name.empty())
+        {
+            std::cout << " Config name: " << s.config_name;
+            auto cfg = config_names.find(s.config_path);
+            if (config_names.end() == cfg)
+            {
+                std::cout << "  (Config not available)";
+            }
+            else if (cfg->second != s.config_name)
+            {
+                std::cout << "  (Current name: " << cfg->second << ")";
+            }
+            std::cout << std::endl;
+        }
+        if (!s.session_name.empty())
+        {
+            std::cout << "Session name: " << s.session_name << std::endl;
+        }
 
         std::cout << "      Status: ";
-        if (status.Check(StatusMajor::SESSION, StatusMinor::SESS_AUTH_URL))
+        if (s.status.Check(StatusMajor::SESSION, StatusMinor::SESS_AUTH_URL))
         {
             std::cout << "Web authentication required to connect" << std::endl;
         }
         else
         {
-            std::cout << status << std::endl;
+            std::cout << s.status << std::endl;
         }
     }
 
@@ -850,6 +1203,7 @@ SingleCommand::Ptr prepare_command_sessions_list()
     cmd.reset(new SingleCommand("sessions-list",
                                 "List available VPN sessions",
                                 cmd_sessions_list));
+    cmd->AddOption("json", 'j', "Format the output as JSON");
 
     return cmd;
 }
@@ -927,9 +1281,26 @@ static int cmd_session_manage(ParsedArgs::Ptr args)
                                "cannot be used together");
     }
 
-    // Only --cleanup does NOT depend on --path or --config
+    if (args->Present("all"))
+    {
+        if (mode_disconnect != mode)
+        {
+            throw CommandException("session-manage",
+                                   "--all can only be used with --disconnect");
+        }
+        if (args->Present("path") || args->Present("interface"))
+        {
+            throw CommandException("session-manage",
+                                   "--all cannot be used with --path "
+                                   "or --interface");
+        }
+    }
+
+    // Only --cleanup and --disconnect --all do NOT depend on --path
+    // or --config
     if (!args->Present("path") && !args->Present("config")
-        && !args->Present("interface") && (mode ^ mode_cleanup) > 0)
+        && !args->Present("interface") && (mode ^ mode_cleanup) > 0
+        && !args->Present("all"))
     {
         throw CommandException("session-manage",
                                "Missing required session path or config name");
@@ -946,6 +1317,23 @@ static int cmd_session_manage(ParsedArgs::Ptr args)
 
         OpenVPN3SessionMgrProxy sessmgr(G_BUS_TYPE_SYSTEM);
 
+        if (args->Present("all"))
+        {
+            // All sessions are disconnected in parallel by the session
+            // manager; this returns when all of them are closed
+            std::string cfgname = (args->Present("config")
+                                   ? args->GetValue("config", 0) : "");
+            std::vector<std::string> paths = sessmgr.DisconnectAll(cfgname);
+            for (const auto& p : paths)
+            {
+                std::cout << "Disconnected " << p << std::endl;
+            }
+            size_t c = paths.size();
+            std::cout << std::to_string(c) << " session" << (c != 1 ? "s" : "")
+                      << " disconnected" << std::endl;
+            return 0;
+        }
+
         if (mode_cleanup == mode)
         {
             // Loop through all open sessions and check if they have a valid
@@ -1155,6 +1543,9 @@ SingleCommand::Ptr prepare_command_session_manage()
     cmd->AddOption("resume", 'R', "Resumes a paused VPN session");
     cmd->AddOption("restart", "Disconnect and reconnect a running VPN session");
     cmd->AddOption("disconnect", 'D', "Disconnects a VPN session");
+    cmd->AddOption("all", 0,
+                   "Used with --disconnect; disconnects all sessions at "
+                   "once, or all sessions of --config");
     cmd->AddOption("cleanup", 0, "Clean up stale sessions");
 
     return cmd;
@@ -1348,6 +1739,8 @@ static int cmd_session_acl(ParsedArgs::Ptr args)
     if (!args->Present("show")
         && !args->Present("grant")
         && !args->Present("revoke")
+        && !args->Present("grant-group")
+        && !args->Present("revoke-group")
         && !args->Present("public-access")
         && !args->Present("allow-log-access")
         && !args->Present("lock-down")
@@ -1459,6 +1852,72 @@ static int cmd_session_acl(ParsedArgs::Ptr args)
                 }
             }
         }
+
+        if (args->Present("grant-group"))
+        {
+            for (auto const& group : args->GetAllValues("grant-group"))
+            {
+                try
+                {
+                    gid_t gid = get_groupid(group);
+                    try
+                    {
+                        session.AccessGrantGroup(gid);
+                        std::cout << "Granted access to group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                    }
+                    catch (DBusException& e)
+                    {
+                        std::cerr << "Failed granting access to group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                        ret = 3;
+                    }
+                }
+                catch (const LookupException&)
+                {
+                    std::cerr << "** ERROR ** --grant-group " << group
+                              << " does not map to a valid group"
+                              << std::endl;
+                }
+            }
+        }
+
+        if (args->Present("revoke-group"))
+        {
+            for (auto const& group : args->GetAllValues("revoke-group"))
+            {
+                try
+                {
+                    gid_t gid = get_groupid(group);
+                    try
+                    {
+                        session.AccessRevokeGroup(gid);
+                        std::cout << "Revoked access from group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                    }
+                    catch (DBusException& e)
+                    {
+                        std::cerr << "Failed revoking access from group "
+                                  << lookup_groupname(gid)
+                                  << " (gid " << gid << ")"
+                                  << std::endl;
+                        ret = 3;
+                    }
+                }
+                catch (const LookupException&)
+                {
+                    std::cerr << "** ERROR ** --revoke-group " << group
+                              << " does not map to a valid group"
+                              << std::endl;
+                }
+            }
+        }
         if (args->Present("public-access"))
         {
             std::string ld = args->GetValue("public-access", 0);
@@ -1533,6 +1992,21 @@ static int cmd_session_acl(ParsedArgs::Ptr args)
                               << " " << ('(' != user[0] ? user : "(unknown)")
                     << std::endl;
                 }
+
+                std::vector<gid_t> groups = session.GetGroupAccessList();
+                if (!groups.empty())
+                {
+                    std::cout << "    Groups granted access: " << std::to_string(groups.size())
+                              << (1 != groups.size() ? " groups" : " group")
+                              << std::endl;
+                    for (auto const& gid : groups)
+                    {
+                        std::string group = lookup_groupname(gid);
+                        std::cout << "                           - (" << gid << ") "
+                                  << " " << ('(' != group[0] ? group : "(unknown)")
+                                  << std::endl;
+                    }
+                }
             }
         }
         return ret;
@@ -1581,6 +2055,10 @@ SingleCommand::Ptr prepare_command_session_acl()
                    "Grant this user access to this session");
     cmd->AddOption("revoke", 'R', "<UID | username>", true,
                    "Revoke this user access from this session");
+    cmd->AddOption("grant-group", "<GID | group name>", true,
+                   "Grant all members of this group access to this session");
+    cmd->AddOption("revoke-group", "<GID | group name>", true,
+                   "Revoke this group access from this session");
     cmd->AddOption("public-access", "<true|false>", true,
                    "Set/unset the public access flag",
                    arghelper_boolean);
@@ -0,0 +1,740 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   top.cpp
+ *
+ * @brief  Live table of all VPN sessions available to the user
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <glib-unix.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "dbus/core.hpp"
+#include "dbus/connection-creds.hpp"
+#include "dbus/glibutils.hpp"
+#include "common/cmdargparser.hpp"
+#include "common/utils.hpp"
+#include "log/proxy-log.hpp"
+#include "sessionmgr/proxy-sessionmgr.hpp"
+#include "sessionmgr/sessionmgr-events.hpp"
+#include "sessionmgr/status-board.hpp"
+#include "../top-table.hpp"
+
+
+/**
+ * @return Returns a short status text for the session table
+ */
+static std::string top_status(const StatusMajor major, const StatusMinor minor)
+{
+    if (StatusMajor::UNSET == major || (unsigned) minor >= StatusMinorCount)
+    {
+        return "-";
+    }
+    return StatusMinor_str[(unsigned) minor];
+}
+
+
+
+/**
+ *  Collects the state of all the VPN sessions available to the user.
+ *
+ *  The session list comes from the bulk FetchSessionsDetailed call and
+ *  the SessionManagerEvent signals.  Where the session manager provides
+ *  a status board, the status and byte counters of all the sessions are
+ *  read from it, without any D-Bus calls.  The remaining counters come
+ *  from the Statistics push signal; sessions not providing it are
+ *  polled, all of them once per update.  Log rates come from the log
+ *  service sender statistics, when those are accessible.
+ */
+class SessionTop : public DBusSignalSubscription
+{
+public:
+    SessionTop(DBus& dbuscon, const uint32_t interval_ms)
+        : DBusSignalSubscription(dbuscon,
+                                 OpenVPN3DBus_name_sessions,
+                                 OpenVPN3DBus_interf_sessions,
+                                 OpenVPN3DBus_rootp_sessions),
+          dbus(dbuscon), stats_interval(interval_ms),
+          manager(dbuscon), logsrv(dbuscon.GetConnection()),
+          creds(dbuscon.GetConnection())
+    {
+        Subscribe("SessionManagerEvent");
+        try
+        {
+            manager.EventSubscribe();
+        }
+        catch (const DBusException&)
+        {
+            // Older session managers broadcast these signals instead
+        }
+        Subscribe(OpenVPN3DBus_name_sessions, "", "StatusChange");
+        Subscribe(OpenVPN3DBus_name_sessions, "", "Statistics");
+
+        try
+        {
+            board_fd = manager.GetStatusBoard();
+            board.reset(new SessionManager::StatusBoardReader(board_fd));
+        }
+        catch (const std::exception&)
+        {
+            // Older session manager or no board for this user;
+            // the session manager is queried instead
+            if (board_fd >= 0)
+            {
+                ::close(board_fd);
+                board_fd = -1;
+            }
+        }
+
+        refresh_sessions();
+    }
+
+
+    ~SessionTop()
+    {
+        for (auto& s : sources)
+        {
+            try
+            {
+                if (!s.second.polled)
+                {
+                    s.second.proxy->StatisticsSubscribe(0);
+                }
+            }
+            catch (const DBusException&)
+            {
+                // The session may already be gone
+            }
+        }
+        board.reset();
+        if (board_fd >= 0)
+        {
+            ::close(board_fd);
+        }
+        Cleanup();
+    }
+
+
+    /**
+     *  Updates the values not pushed via signals.  Called once per
+     *  update interval.
+     */
+    void Update()
+    {
+        // The bulk listing brings the details the status board lacks,
+        // like the DCO flag; with a board it is not needed as often
+        if (!board || 0 == (++updates % 10))
+        {
+            refresh_sessions();
+        }
+        if (board)
+        {
+            read_board();
+        }
+        poll_statistics();
+        update_log_rates();
+    }
+
+
+    void callback_signal_handler(GDBusConnection *connection,
+                                 const std::string sender_name,
+                                 const std::string object_path,
+                                 const std::string interface_name,
+                                 const std::string signal_name,
+                                 GVariant *parameters) override
+    {
+        try
+        {
+            if ("SessionManagerEvent" == signal_name)
+            {
+                SessionManager::Event ev(parameters);
+                switch (ev.type)
+                {
+                case SessionManager::EventType::SESS_CREATED:
+                    (void) add_session(ev.path);
+                    break;
+
+                case SessionManager::EventType::SESS_DESTROYED:
+                    sources.erase(ev.path);
+                    table.Remove(ev.path);
+                    break;
+
+                default:
+                    break;
+                }
+            }
+            else if ("StatusChange" == signal_name)
+            {
+                if (!table.Contains(object_path))
+                {
+                    return;
+                }
+                StatusEvent st(parameters);
+                TopTable::Row& row = table.Get(object_path);
+                row.status = top_status(st.major, st.minor);
+                if (row.device.empty()
+                    && st.Check(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTED))
+                {
+                    row.device = sources[object_path].proxy->GetDeviceName();
+                }
+            }
+            else if ("Statistics" == signal_name)
+            {
+                auto s = sources.find(object_path);
+                if (sources.end() == s)
+                {
+                    return;
+                }
+                auto sig = GLibUtils::Unmarshal<std::tuple<uint32_t,
+                                                std::vector<uint64_t>>>(parameters);
+                update_counters(object_path, s->second,
+                                std::get<0>(sig), std::get<1>(sig));
+            }
+        }
+        catch (const DBusException& excp)
+        {
+            // Printing errors would scroll the table; they are shown below it
+            last_error = signal_name + " from " + object_path + ": "
+                         + excp.GetRawError();
+        }
+    }
+
+
+    /**
+     *  Renders the session table
+     *
+     * @param key      TopTable::SortKey to sort by
+     * @param reverse  Reverse the sort order
+     * @param width    Terminal width, 0 if unlimited
+     *
+     * @return Returns a std::string with a summary line and the table
+     */
+    std::string Render(TopTable::SortKey key, bool reverse,
+                       unsigned int width) const
+    {
+        std::stringstream out;
+        std::time_t now = std::time(nullptr);
+        char ts[16] = {};
+        std::strftime(ts, sizeof(ts), "%H:%M:%S", std::localtime(&now));
+        out << "openvpn3 top - " << ts
+            << "  sessions: " << table.size()
+            << "  sort: " << TopTable::SortKeyName(key)
+            << (reverse ? " (reversed)" : "")
+            << "  source: " << (board ? "status board" : "session manager")
+            << std::endl << std::endl
+            << table.Render(key, reverse, width);
+        if (!last_error.empty())
+        {
+            out << std::endl << "Last error: " << last_error << std::endl;
+        }
+        return out.str();
+    }
+
+
+private:
+    struct Source
+    {
+        OpenVPN3SessionProxy::Ptr proxy;
+        pid_t backend_pid = 0;
+        bool polled = false;           ///< No Statistics signal available
+        uint32_t layout_id = 0;
+        std::vector<std::string> keys;
+    };
+
+    DBus& dbus;
+    const uint32_t stats_interval;
+    OpenVPN3SessionMgrProxy manager;
+    LogServiceProxy logsrv;
+    DBusConnectionCreds creds;
+    int board_fd = -1;
+    std::unique_ptr<SessionManager::StatusBoardReader> board;
+    std::map<std::string, Source> sources;
+    std::map<std::string, pid_t> log_sender_pids;
+    bool log_stats_available = true;
+    unsigned int updates = 0;
+    std::string last_error;
+    TopTable table;
+
+
+    static double now_seconds()
+    {
+        using namespace std::chrono;
+        return duration<double>(steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    Source& add_session(const std::string& path)
+    {
+        Source& s = sources[path];
+        table.Get(path);
+        if (s.proxy)
+        {
+            return s;
+        }
+        s.proxy.reset(new OpenVPN3SessionProxy(dbus, path));
+        try
+        {
+            s.keys = s.proxy->GetConnectionStatsLayout(s.layout_id);
+            s.proxy->StatisticsSubscribe(stats_interval);
+        }
+        catch (const DBusException&)
+        {
+            // Older session manager, or the backend has not registered
+            // yet; the counters are polled instead
+            s.polled = true;
+        }
+        return s;
+    }
+
+
+    void refresh_sessions()
+    {
+        std::vector<std::string> paths;
+        for (const auto& sd : manager.FetchSessionsDetailed())
+        {
+            paths.push_back(sd.path);
+            Source& s = add_session(sd.path);
+            s.backend_pid = sd.backend_pid;
+
+            TopTable::Row& row = table.Get(sd.path);
+            row.name = sd.config_name;
+            row.device = sd.device_name;
+            row.dco = sd.dco;
+            row.status = top_status(sd.status.major, sd.status.minor);
+        }
+        table.Retain(paths);
+        for (auto it = sources.begin(); it != sources.end(); )
+        {
+            if (table.Contains(it->first))
+            {
+                ++it;
+            }
+            else
+            {
+                it = sources.erase(it);
+            }
+        }
+    }
+
+
+    void read_board()
+    {
+        const double now = now_seconds();
+        for (const auto& e : board->Read())
+        {
+            if (!table.Contains(e.session_path))
+            {
+                continue;
+            }
+            TopTable::Row& row = table.Get(e.session_path);
+            row.name = e.config_name;
+            row.device = e.device_name;
+            row.status = top_status((StatusMajor) e.status_major,
+                                    (StatusMinor) e.status_minor);
+            TopTable::UpdateBytes(row, now, e.bytes_in, e.bytes_out);
+        }
+    }
+
+
+    void poll_statistics()
+    {
+        for (auto& s : sources)
+        {
+            if (!s.second.polled)
+            {
+                continue;
+            }
+            try
+            {
+                if (s.second.keys.empty())
+                {
+                    s.second.keys = s.second.proxy->GetConnectionStatsLayout(s.second.layout_id);
+                }
+                update_counters(s.first, s.second, s.second.layout_id,
+                                s.second.proxy->GetPackedConnectionStats());
+            }
+            catch (const DBusException&)
+            {
+                // Backend not ready yet; try again on the next update
+            }
+        }
+    }
+
+
+    void update_counters(const std::string& path, Source& src,
+                         const uint32_t layout_id,
+                         const std::vector<uint64_t>& values)
+    {
+        if (layout_id != src.layout_id)
+        {
+            src.keys = src.proxy->GetConnectionStatsLayout(src.layout_id);
+        }
+
+        TopTable::Row& row = table.Get(path);
+        uint64_t bytes_in = 0;
+        uint64_t bytes_out = 0;
+        for (size_t i = 0; i < src.keys.size() && i < values.size(); ++i)
+        {
+            const std::string& k = src.keys[i];
+            if ("BYTES_IN" == k)
+            {
+                bytes_in = values[i];
+            }
+            else if ("BYTES_OUT" == k)
+            {
+                bytes_out = values[i];
+            }
+            else if ("N_RECONNECT" == k)
+            {
+                row.reconnects = values[i];
+            }
+            else if ("PATH_RTT_P50_US" == k && values[i] > 0)
+            {
+                row.rtt_ms = values[i] / 1000.0;
+            }
+        }
+        TopTable::UpdateBytes(row, now_seconds(), bytes_in, bytes_out);
+    }
+
+
+    void update_log_rates()
+    {
+        if (!log_stats_available)
+        {
+            return;
+        }
+
+        LogSenderStats senders;
+        try
+        {
+            senders = logsrv.GetSenderStats();
+        }
+        catch (const DBusException&)
+        {
+            // Not accessible for this user or an older log service
+            log_stats_available = false;
+            return;
+        }
+
+        // Log senders are identified by their unique bus name; the
+        // backends are matched on their PID
+        std::map<pid_t, double> rates;
+        for (const auto& l : senders)
+        {
+            auto p = log_sender_pids.find(l.busname);
+            if (log_sender_pids.end() == p)
+            {
+                pid_t pid = 0;
+                try
+                {
+                    pid = creds.GetPID(l.busname);
+                }
+                catch (const DBusException&)
+                {
+                    // The sender is gone
+                }
+                p = log_sender_pids.insert(std::make_pair(l.busname, pid)).first;
+            }
+            if (p->second > 0)
+            {
+                rates[p->second] += l.rate;
+            }
+        }
+
+        for (const auto& s : sources)
+        {
+            auto r = rates.find(s.second.backend_pid);
+            table.Get(s.first).log_rate = (rates.end() != r ? r->second : 0);
+        }
+    }
+};
+
+
+
+/**
+ *  Puts the terminal into non-canonical mode without echo while the
+ *  object exists, so single key presses can be read
+ */
+class TopTerminal
+{
+public:
+    TopTerminal()
+    {
+        if (::tcgetattr(STDIN_FILENO, &saved) < 0)
+        {
+            return;
+        }
+        struct termios t = saved;
+        t.c_lflag &= ~(ICANON | ECHO);
+        t.c_cc[VMIN] = 1;
+        t.c_cc[VTIME] = 0;
+        active = (::tcsetattr(STDIN_FILENO, TCSANOW, &t) == 0);
+    }
+
+    ~TopTerminal()
+    {
+        if (active)
+        {
+            ::tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+        }
+    }
+
+    static unsigned int Width()
+    {
+        struct winsize ws = {};
+        if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) < 0)
+        {
+            return 0;
+        }
+        return ws.ws_col;
+    }
+
+private:
+    struct termios saved = {};
+    bool active = false;
+};
+
+
+
+/**
+ *  State shared by the timer and keyboard callbacks of the top command
+ */
+struct TopView
+{
+    SessionTop *top = nullptr;
+    GMainLoop *main_loop = nullptr;
+    TopTable::SortKey sort = TopTable::SortKey::RATE;
+    bool reverse = false;
+    bool batch = false;
+    unsigned int iterations = 0;    ///< Updates left, 0 if unlimited
+
+
+    void Draw()
+    {
+        if (batch)
+        {
+            std::cout << top->Render(sort, reverse, 0) << std::endl;
+            return;
+        }
+        // Move to the top left corner and clear the screen
+        std::cout << "\033[H\033[2J"
+                  << top->Render(sort, reverse, TopTerminal::Width())
+                  << std::endl
+                  << "Keys: s - next sort column, r - reverse, q - quit"
+                  << std::flush;
+    }
+
+
+    static gboolean update_cb(gpointer view_ptr)
+    {
+        TopView *v = static_cast<TopView *>(view_ptr);
+        try
+        {
+            v->top->Update();
+        }
+        catch (const DBusException& excp)
+        {
+            std::cerr << "Failed to update: " << excp.GetRawError() << std::endl;
+            g_main_loop_quit(v->main_loop);
+            return G_SOURCE_REMOVE;
+        }
+        v->Draw();
+        if (v->iterations > 0 && 0 == --v->iterations)
+        {
+            g_main_loop_quit(v->main_loop);
+            return G_SOURCE_REMOVE;
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+
+    static gboolean key_cb(gint fd, GIOCondition cond, gpointer view_ptr)
+    {
+        TopView *v = static_cast<TopView *>(view_ptr);
+        char c = 0;
+        if (::read(fd, &c, 1) != 1)
+        {
+            return G_SOURCE_REMOVE;
+        }
+        switch (c)
+        {
+        case 'q':
+        case 'Q':
+            g_main_loop_quit(v->main_loop);
+            return G_SOURCE_REMOVE;
+
+        case 's':
+        {
+            std::vector<std::string> keys = TopTable::SortKeyNames();
+            auto k = std::find(keys.begin(), keys.end(),
+                               TopTable::SortKeyName(v->sort));
+            v->sort = TopTable::ParseSortKey(keys.end() == k || keys.end() == k + 1
+                                             ? keys[0] : *(k + 1));
+            break;
+        }
+
+        case 'r':
+            v->reverse = !v->reverse;
+            break;
+
+        default:
+            return G_SOURCE_CONTINUE;
+        }
+        v->Draw();
+        return G_SOURCE_CONTINUE;
+    }
+};
+
+
+
+/**
+ *  openvpn3 top command
+ *
+ *  Shows a live table of all VPN sessions available to the user, with
+ *  their status, throughput, round-trip time, reconnects and log rate.
+ *
+ * @param args  ParsedArgs object containing all related options and arguments
+ * @return Returns the exit code which will be returned to the calling shell
+ */
+static int cmd_top(ParsedArgs::Ptr args)
+{
+    uint32_t interval = 2000;
+    if (args->Present("interval"))
+    {
+        interval = std::atoi(args->GetLastValue("interval").c_str());
+        if (interval < 100)
+        {
+            throw CommandException("top", "Invalid --interval value");
+        }
+    }
+
+    TopView view;
+    if (args->Present("sort"))
+    {
+        try
+        {
+            view.sort = TopTable::ParseSortKey(args->GetLastValue("sort"));
+        }
+        catch (const std::invalid_argument& excp)
+        {
+            throw CommandException("top", excp.what());
+        }
+    }
+    view.reverse = args->Present("reverse");
+    view.batch = args->Present("batch") || !::isatty(STDOUT_FILENO);
+    if (args->Present("iterations"))
+    {
+        view.iterations = std::atoi(args->GetLastValue("iterations").c_str());
+        if (0 == view.iterations)
+        {
+            throw CommandException("top", "Invalid --iterations value");
+        }
+    }
+
+    GMainLoop *main_loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, stop_handler, main_loop);
+    g_unix_signal_add(SIGTERM, stop_handler, main_loop);
+    view.main_loop = main_loop;
+
+    try
+    {
+        DBus dbuscon(G_BUS_TYPE_SYSTEM);
+        dbuscon.Connect();
+
+        SessionTop top(dbuscon, interval);
+        view.top = &top;
+
+        std::unique_ptr<TopTerminal> term;
+        guint key_src = 0;
+        if (!view.batch && ::isatty(STDIN_FILENO))
+        {
+            term.reset(new TopTerminal());
+            key_src = g_unix_fd_add(STDIN_FILENO, G_IO_IN,
+                                    TopView::key_cb, &view);
+        }
+
+        if (TopView::update_cb(&view))
+        {
+            guint timer = g_timeout_add(interval, TopView::update_cb, &view);
+
+            // Runs until interrupted, 'q' is pressed or all the
+            // requested updates are done
+            g_main_loop_run(main_loop);
+            g_source_remove(timer);
+        }
+        if (key_src > 0)
+        {
+            g_source_remove(key_src);
+        }
+        if (!view.batch)
+        {
+            std::cout << std::endl;
+        }
+    }
+    catch (const DBusException& excp)
+    {
+        g_main_loop_unref(main_loop);
+        throw CommandException("top", excp.GetRawError());
+    }
+    catch (...)
+    {
+        g_main_loop_unref(main_loop);
+        throw;
+    }
+    g_main_loop_unref(main_loop);
+    return 0;
+}
+
+
+/**
+ *  Creates the SingleCommand object for the 'top' command
+ *
+ * @return  Returns a SingleCommand::Ptr object declaring the command
+ */
+SingleCommand::Ptr prepare_command_top()
+{
+    SingleCommand::Ptr cmd;
+    cmd.reset(new SingleCommand("top",
+                                "Live table of all available VPN sessions",
+                                cmd_top));
+    cmd->AddOption("interval", 'i', "MSECS", true,
+                   "Update interval in milliseconds (default: 2000)");
+    cmd->AddOption("sort", 's', "COLUMN", true,
+                   "Sort by rate, in, out, rtt, reconnects, log, name "
+                   "or status (default: rate)");
+    cmd->AddOption("reverse", 'r', "Reverse the sort order");
+    cmd->AddOption("batch", 'b',
+                   "Print each update after the previous one, without "
+                   "clearing the screen or reading keys");
+    cmd->AddOption("iterations", 'n', "COUNT", true,
+                   "Stop after COUNT updates");
+
+    return cmd;
+}
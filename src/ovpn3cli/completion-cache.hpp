@@ -0,0 +1,226 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+/**
+ * @file   completion-cache.hpp
+ *
+ * @brief  Short-lived per-user cache of the shell completion values
+ *         which are looked up over D-Bus
+ */
+
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+
+/**
+ *  Caches the completion values of the argument helpers between the
+ *  shell-completion calls done on each tab press.  Each value is stored
+ *  together with the change counter of the service it was retrieved
+ *  from, and is only used while the counter is unchanged and the value
+ *  is not older than the maximum age.
+ *
+ *  The cache directory must be owned by the calling user and not be
+ *  accessible by anyone else, otherwise the cache is not used.  All
+ *  errors are silently ignored; the caller then looks up the values
+ *  directly.
+ */
+class CompletionCache
+{
+public:
+    /**
+     * @param dir      Directory holding the cache files, created if missing
+     * @param max_age  Maximum age of a cached value, in seconds
+     */
+    CompletionCache(const std::string& dir, const unsigned int max_age = 30)
+        : dir(dir), max_age(max_age)
+    {
+        if (0 != mkdir(dir.c_str(), 0700) && EEXIST != errno)
+        {
+            return;
+        }
+        struct stat st;
+        usable = (0 == lstat(dir.c_str(), &st)
+                  && S_ISDIR(st.st_mode)
+                  && st.st_uid == geteuid()
+                  && 0 == (st.st_mode & 077));
+    }
+
+
+    /**
+     * @return Returns true if the cache directory passed the safety
+     *         checks and is used
+     */
+    bool Usable() const
+    {
+        return usable;
+    }
+
+
+    /**
+     *  Retrieve a cached value
+     *
+     * @param key      Name of the cached value
+     * @param counter  Current change counter of the service providing
+     *                 the value
+     * @param value    std::string receiving the cached value
+     *
+     * @return Returns true if a valid value was found
+     */
+    bool Lookup(const std::string& key, const uint64_t counter,
+                std::string& value) const
+    {
+        if (!usable || !valid_key(key))
+        {
+            return false;
+        }
+
+        int fd = open(filename(key).c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st;
+        std::string content;
+        time_t now = time(nullptr);
+        if (0 == fstat(fd, &st) && S_ISREG(st.st_mode)
+            && st.st_uid == geteuid()
+            && st.st_mtime <= now && now - st.st_mtime <= (time_t) max_age)
+        {
+            char buf[4096];
+            ssize_t r;
+            while ((r = read(fd, buf, sizeof(buf))) > 0)
+            {
+                content.append(buf, r);
+            }
+        }
+        close(fd);
+
+        size_t eol = content.find('\n');
+        if (std::string::npos == eol
+            || content.substr(0, eol) != std::to_string(counter))
+        {
+            return false;
+        }
+        value = content.substr(eol + 1);
+        return true;
+    }
+
+
+    /**
+     *  Store a value in the cache, replacing any earlier value
+     *
+     * @param key      Name of the cached value
+     * @param counter  Change counter of the service the value was
+     *                 retrieved from
+     * @param value    std::string with the value to cache
+     */
+    void Store(const std::string& key, const uint64_t counter,
+               const std::string& value) const
+    {
+        if (!usable || !valid_key(key))
+        {
+            return;
+        }
+
+        std::string fname = filename(key);
+        std::string tmpname = fname + ".XXXXXX";
+        int fd = mkostemp(&tmpname[0], O_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        std::string content = std::to_string(counter) + "\n" + value;
+        const char *p = content.data();
+        size_t remain = content.size();
+        while (remain > 0)
+        {
+            ssize_t r = write(fd, p, remain);
+            if (r < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            if (r <= 0)
+            {
+                break;
+            }
+            p += r;
+            remain -= r;
+        }
+        if (0 != close(fd) || remain > 0
+            || 0 != rename(tmpname.c_str(), fname.c_str()))
+        {
+            unlink(tmpname.c_str());
+        }
+    }
+
+
+    /**
+     * @return Returns the default cache directory of the calling user;
+     *         inside $XDG_RUNTIME_DIR when set, otherwise in /tmp
+     */
+    static std::string DefaultDirectory()
+    {
+        const char *rundir = getenv("XDG_RUNTIME_DIR");
+        if (rundir && '/' == rundir[0])
+        {
+            return std::string(rundir) + "/openvpn3-completion";
+        }
+        return "/tmp/openvpn3-completion-" + std::to_string(geteuid());
+    }
+
+
+private:
+    std::string dir;
+    unsigned int max_age;
+    bool usable = false;
+
+
+    std::string filename(const std::string& key) const
+    {
+        return dir + "/" + key;
+    }
+
+
+    static bool valid_key(const std::string& key)
+    {
+        if (key.empty())
+        {
+            return false;
+        }
+        for (const char c : key)
+        {
+            if (!isalnum(c) && '-' != c && '_' != c)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
@@ -33,21 +33,23 @@
 #include "common/cmdargparser.hpp"
 
 
-int main(int argc, char **argv)
-{
-    Commands cmds(OVPN3CLI_PROGNAME,
-                  OVPN3CLI_PROGDESCR);
+static Commands *ovpn3cli_commands = nullptr;
 
-    // Register commands
-    for (const auto& cmd : OVPN3CLI_COMMANDS_LIST)
-    {
-        cmds.RegisterCommand(cmd());
-    }
 
-    // Parse the command line arguments and execute the commands given
+/**
+ *  Runs a complete command line through the registered commands,
+ *  turning exceptions into error messages and exit codes.
+ *
+ * @param argc  int with the number of arguments in argv
+ * @param argv  char ** with the program name, command and its options
+ *
+ * @return Returns the exit code of the command
+ */
+int ovpn3cli_process_command_line(int argc, char **argv)
+{
     try
     {
-        return cmds.ProcessCommandLine(argc, argv);
+        return ovpn3cli_commands->ProcessCommandLine(argc, argv);
     }
     catch (const DBusProxyAccessDeniedException& e)
     {
@@ -75,3 +77,20 @@ int main(int argc, char **argv)
     std::cerr << "*** EEEK *** This should not have happened" << std::endl;
     return 99;
 }
+
+
+int main(int argc, char **argv)
+{
+    Commands cmds(OVPN3CLI_PROGNAME,
+                  OVPN3CLI_PROGDESCR);
+
+    // Register commands
+    for (const auto& cmd : OVPN3CLI_COMMANDS_LIST)
+    {
+        cmds.RegisterCommand(cmd());
+    }
+
+    // Parse the command line arguments and execute the commands given
+    ovpn3cli_commands = &cmds;
+    return ovpn3cli_process_command_line(argc, argv);
+}
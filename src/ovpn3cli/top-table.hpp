@@ -0,0 +1,435 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   top-table.hpp
+ *
+ * @brief  The sortable session table shown by the openvpn3 top command
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+/**
+ *  Keeps one row per VPN session with its latest state, and computes
+ *  the throughput and log rates from the cumulative counters fed into
+ *  it.  The data sources are handled by the caller.
+ */
+class TopTable
+{
+public:
+    enum class SortKey
+    {
+        NAME,        ///< Configuration profile name
+        STATUS,      ///< Status text
+        RATE,        ///< Bytes in + out per second
+        RATE_IN,     ///< Bytes in per second
+        RATE_OUT,    ///< Bytes out per second
+        RTT,         ///< Round-trip time
+        RECONNECTS,  ///< Number of reconnects
+        LOG_RATE     ///< Log events per second
+    };
+
+
+    struct Row
+    {
+        std::string path;
+        std::string name;            ///< Configuration profile name
+        std::string device;
+        std::string status;
+        bool dco = false;
+        double rate_in = -1;         ///< Bytes per second, -1 if unknown
+        double rate_out = -1;        ///< Bytes per second, -1 if unknown
+        double rtt_ms = -1;          ///< Milliseconds, -1 if unknown
+        int64_t reconnects = -1;     ///< -1 if unknown
+        double log_rate = -1;        ///< Log events per second, -1 if unknown
+
+        // Previous counter values, to compute the rates
+        double bytes_time = -1;
+        uint64_t bytes_in = 0;
+        uint64_t bytes_out = 0;
+    };
+
+
+    /**
+     *  Parses a sort key name, as given to the --sort option
+     *
+     * @param name  std::string with the sort key name
+     *
+     * @return Returns the SortKey
+     * @throws std::invalid_argument if the name is unknown
+     */
+    static SortKey ParseSortKey(const std::string& name)
+    {
+        for (const auto& k : sort_keys())
+        {
+            if (k.first == name)
+            {
+                return k.second;
+            }
+        }
+        throw std::invalid_argument("Unknown sort key: " + name);
+    }
+
+
+    /**
+     * @return Returns all the sort key names, in the order the
+     *         interactive 's' key cycles through them
+     */
+    static std::vector<std::string> SortKeyNames()
+    {
+        std::vector<std::string> ret;
+        for (const auto& k : sort_keys())
+        {
+            ret.push_back(k.first);
+        }
+        return ret;
+    }
+
+
+    /**
+     * @param key  SortKey to name
+     *
+     * @return Returns the name of the sort key, see ParseSortKey()
+     */
+    static std::string SortKeyName(SortKey key)
+    {
+        for (const auto& k : sort_keys())
+        {
+            if (k.second == key)
+            {
+                return k.first;
+            }
+        }
+        return "";
+    }
+
+
+    /**
+     *  Retrieves the row of a session, adding it if needed
+     *
+     * @param path  std::string with the session object path
+     *
+     * @return Returns a reference to the Row
+     */
+    Row& Get(const std::string& path)
+    {
+        Row& r = rows[path];
+        r.path = path;
+        return r;
+    }
+
+
+    /**
+     * @param path  std::string with the session object path
+     *
+     * @return Returns true if the table has a row for the session
+     */
+    bool Contains(const std::string& path) const
+    {
+        return rows.find(path) != rows.end();
+    }
+
+
+    /**
+     *  Removes the row of a session
+     *
+     * @param path  std::string with the session object path
+     */
+    void Remove(const std::string& path)
+    {
+        rows.erase(path);
+    }
+
+
+    /**
+     *  Removes the rows of all sessions not in a list
+     *
+     * @param paths  std::vector with the object paths of the sessions to keep
+     */
+    void Retain(const std::vector<std::string>& paths)
+    {
+        for (auto it = rows.begin(); it != rows.end(); )
+        {
+            if (std::find(paths.begin(), paths.end(), it->first) == paths.end())
+            {
+                it = rows.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+
+    /**
+     * @return Returns the number of rows
+     */
+    size_t size() const noexcept
+    {
+        return rows.size();
+    }
+
+
+    /**
+     *  Updates the throughput rates of a row from the cumulative byte
+     *  counters.  The first update only records the counters.  Counters
+     *  going backwards, like after a backend restart, restart the rate
+     *  computation.
+     *
+     * @param row        Row to update
+     * @param now        Time of the counters, in seconds
+     * @param bytes_in   Cumulative bytes received
+     * @param bytes_out  Cumulative bytes sent
+     */
+    static void UpdateBytes(Row& row, double now,
+                            uint64_t bytes_in, uint64_t bytes_out)
+    {
+        if (row.bytes_time >= 0 && now <= row.bytes_time)
+        {
+            // Same sample seen via another source
+            return;
+        }
+        if (row.bytes_time >= 0
+            && bytes_in >= row.bytes_in && bytes_out >= row.bytes_out)
+        {
+            const double elapsed = now - row.bytes_time;
+            row.rate_in = (bytes_in - row.bytes_in) / elapsed;
+            row.rate_out = (bytes_out - row.bytes_out) / elapsed;
+        }
+        row.bytes_time = now;
+        row.bytes_in = bytes_in;
+        row.bytes_out = bytes_out;
+    }
+
+
+    /**
+     *  Retrieves all rows, sorted.  Numeric columns sort the largest
+     *  values first, text columns in alphabetical order; unknown values
+     *  are always last.
+     *
+     * @param key      SortKey to sort by
+     * @param reverse  Reverse the sort order
+     *
+     * @return Returns a std::vector of all rows
+     */
+    std::vector<Row> Sorted(SortKey key, bool reverse = false) const
+    {
+        std::vector<Row> ret;
+        ret.reserve(rows.size());
+        for (const auto& r : rows)
+        {
+            ret.push_back(r.second);
+        }
+        std::stable_sort(ret.begin(), ret.end(),
+                         [key, reverse](const Row& a, const Row& b)
+                         {
+                             return compare(key, a, b, reverse);
+                         });
+        return ret;
+    }
+
+
+    /**
+     *  Renders the table as text
+     *
+     * @param key      SortKey to sort by
+     * @param reverse  Reverse the sort order
+     * @param width    Terminal width; longer lines are cut.  0 disables
+     *                 cutting the lines.
+     *
+     * @return Returns a std::string with the header and all the rows
+     */
+    std::string Render(SortKey key, bool reverse = false,
+                       unsigned int width = 0) const
+    {
+        std::vector<std::string> lines;
+        std::stringstream hdr;
+        hdr << std::left << std::setw(24) << "SESSION" << " "
+            << std::setw(10) << "DEVICE" << " "
+            << std::setw(22) << "STATUS" << " "
+            << std::setw(3) << "DCO" << " "
+            << std::right << std::setw(10) << "IN/s" << " "
+            << std::setw(10) << "OUT/s" << " "
+            << std::setw(8) << "RTT" << " "
+            << std::setw(6) << "RECONN" << " "
+            << std::setw(7) << "LOG/s";
+        lines.push_back(hdr.str());
+
+        for (const auto& r : Sorted(key, reverse))
+        {
+            std::stringstream l;
+            l << std::left << std::setw(24) << cut(r.name.empty() ? r.path : r.name, 24) << " "
+              << std::setw(10) << cut(r.device.empty() ? "-" : r.device, 10) << " "
+              << std::setw(22) << cut(r.status, 22) << " "
+              << std::setw(3) << (r.dco ? "yes" : "no") << " "
+              << std::right << std::setw(10) << FormatRate(r.rate_in) << " "
+              << std::setw(10) << FormatRate(r.rate_out) << " "
+              << std::setw(8) << format_rtt(r.rtt_ms) << " "
+              << std::setw(6) << (r.reconnects < 0 ? "-" : std::to_string(r.reconnects)) << " "
+              << std::setw(7) << format_log_rate(r.log_rate);
+            lines.push_back(l.str());
+        }
+
+        std::string ret;
+        for (const auto& l : lines)
+        {
+            ret += (width > 0 && l.size() > width ? l.substr(0, width) : l);
+            ret += '\n';
+        }
+        return ret;
+    }
+
+
+    /**
+     *  Formats a byte rate with a binary unit prefix
+     *
+     * @param rate  Bytes per second, negative if unknown
+     *
+     * @return Returns a std::string like "1.5M", or "-" if unknown
+     */
+    static std::string FormatRate(double rate)
+    {
+        if (rate < 0)
+        {
+            return "-";
+        }
+        static const char *units[] = {"B", "K", "M", "G", "T"};
+        unsigned int u = 0;
+        while (rate >= 1024 && u < 4)
+        {
+            rate /= 1024;
+            ++u;
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), (0 == u ? "%.0f%s" : "%.1f%s"),
+                      rate, units[u]);
+        return buf;
+    }
+
+
+private:
+    std::map<std::string, Row> rows;
+
+
+    static const std::vector<std::pair<std::string, SortKey>>& sort_keys()
+    {
+        static const std::vector<std::pair<std::string, SortKey>> keys = {
+            {"rate", SortKey::RATE},
+            {"in", SortKey::RATE_IN},
+            {"out", SortKey::RATE_OUT},
+            {"rtt", SortKey::RTT},
+            {"reconnects", SortKey::RECONNECTS},
+            {"log", SortKey::LOG_RATE},
+            {"name", SortKey::NAME},
+            {"status", SortKey::STATUS}
+        };
+        return keys;
+    }
+
+
+    static double total_rate(const Row& r)
+    {
+        if (r.rate_in < 0 && r.rate_out < 0)
+        {
+            return -1;
+        }
+        return std::max(r.rate_in, 0.0) + std::max(r.rate_out, 0.0);
+    }
+
+
+    /**
+     *  Orders two numeric values, largest first, unknown (negative)
+     *  values last regardless of the reverse flag
+     */
+    static bool compare_num(double a, double b, bool reverse)
+    {
+        if ((a < 0) != (b < 0))
+        {
+            return b < 0;
+        }
+        return (reverse ? a < b : a > b);
+    }
+
+
+    static bool compare(SortKey key, const Row& a, const Row& b, bool reverse)
+    {
+        switch (key)
+        {
+        case SortKey::NAME:
+            return (reverse ? b.name < a.name : a.name < b.name);
+        case SortKey::STATUS:
+            return (reverse ? b.status < a.status : a.status < b.status);
+        case SortKey::RATE:
+            return compare_num(total_rate(a), total_rate(b), reverse);
+        case SortKey::RATE_IN:
+            return compare_num(a.rate_in, b.rate_in, reverse);
+        case SortKey::RATE_OUT:
+            return compare_num(a.rate_out, b.rate_out, reverse);
+        case SortKey::RTT:
+            return compare_num(a.rtt_ms, b.rtt_ms, reverse);
+        case SortKey::RECONNECTS:
+            return compare_num(a.reconnects, b.reconnects, reverse);
+        case SortKey::LOG_RATE:
+            return compare_num(a.log_rate, b.log_rate, reverse);
+        }
+        return false;
+    }
+
+
+    static std::string cut(const std::string& s, size_t len)
+    {
+        return (s.size() > len ? s.substr(0, len - 1) + "~" : s);
+    }
+
+
+    static std::string format_rtt(double ms)
+    {
+        if (ms < 0)
+        {
+            return "-";
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.1fms", ms);
+        return buf;
+    }
+
+
+    static std::string format_log_rate(double rate)
+    {
+        if (rate < 0)
+        {
+            return "-";
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.1f", rate);
+        return buf;
+    }
+};
@@ -0,0 +1,188 @@
+#  OpenVPN 3 Linux client -- Next generation OpenVPN client
+#
+#  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero General Public License as
+#  published by the Free Software Foundation, version 3 of the
+#  License.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero General Public License for more details.
+#
+#  You should have received a copy of the GNU Affero General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+##
+# @file  AsyncBridge.py
+#
+# @brief  Runs the dbus-python GLib main loop in a single helper thread
+#         and provides the results of D-Bus calls and signals to an
+#         asyncio event loop
+#
+
+import asyncio
+import threading
+import dbus
+import dbus.bus
+import dbus.mainloop.glib
+from gi.repository import GLib
+
+
+##
+#  The AsyncBridge object runs a GLib main loop in a separate thread,
+#  which is where all the D-Bus calls are issued and all the D-Bus
+#  signals are received.  The results are handed over to the asyncio
+#  event loop, so asyncio based programs can use the D-Bus services
+#  without blocking and without a thread per request.
+#
+#  The D-Bus connection used with this object must be retrieved via
+#  the SystemBus() method, which attaches it to the GLib main loop.
+#
+class AsyncBridge(object):
+    ##
+    #  Initialize the AsyncBridge object and start the GLib main loop
+    #  thread
+    #
+    #  @param loop   asyncio event loop receiving the results.  If not
+    #                set, the current event loop is used.
+    #
+    def __init__(self, loop=None):
+        self.__loop = loop if loop is not None else asyncio.get_event_loop()
+
+        dbus.mainloop.glib.threads_init()
+        self.__dbusloop = dbus.mainloop.glib.DBusGMainLoop()
+        self.__mainloop = GLib.MainLoop()
+        self.__thread = threading.Thread(target=self.__mainloop.run,
+                                         name='openvpn3-asyncbridge',
+                                         daemon=True)
+        self.__thread.start()
+
+
+    ##
+    #  Retrieve a new connection to the D-Bus system bus, attached to
+    #  the GLib main loop of this object
+    #
+    #  @return Returns a dbus.bus.BusConnection object
+    #
+    def SystemBus(self):
+        return dbus.bus.BusConnection(dbus.bus.BUS_SYSTEM,
+                                      mainloop=self.__dbusloop)
+
+
+    ##
+    #  Retrieve the asyncio event loop used by this object
+    #
+    def GetLoop(self):
+        return self.__loop
+
+
+    ##
+    #  Call a D-Bus method without blocking
+    #
+    #  @param method   A method of a dbus.Interface object
+    #  @param args     Arguments to the D-Bus method
+    #  @param parser   Optional function which is called with the result
+    #                  of the D-Bus method before it is provided to the
+    #                  caller.  This is called in the asyncio event loop.
+    #
+    #  @return Returns an asyncio.Future which completes with the result
+    #          of the D-Bus method, or the dbus.exceptions.DBusException
+    #          raised by it
+    #
+    def Call(self, method, *args, parser=None):
+        fut = self.__loop.create_future()
+
+        def __reply(*ret):
+            if 0 == len(ret):
+                value = None
+            elif 1 == len(ret):
+                value = ret[0]
+            else:
+                value = ret
+            self.__loop.call_soon_threadsafe(self.__set_result,
+                                             fut, value, parser)
+
+        def __error(excp):
+            self.__loop.call_soon_threadsafe(self.__set_exception, fut, excp)
+
+        def __issue():
+            try:
+                method(*args, reply_handler=__reply, error_handler=__error)
+            except Exception as excp:
+                __error(excp)
+            return False
+
+        GLib.idle_add(__issue)
+        return fut
+
+
+    ##
+    #  Subscribe to a D-Bus signal.  The callback function is called in
+    #  the asyncio event loop.
+    #
+    #  @param dbuscon   D-Bus connection retrieved via SystemBus()
+    #  @param cbfnc     Callback function receiving the signal arguments.
+    #                   If the kwargs set path_keyword or similar, those
+    #                   are provided as keyword arguments.
+    #  @param kwargs    Arguments to dbus.bus.BusConnection.add_signal_receiver()
+    #
+    #  @return Returns a subscription object to be passed to
+    #          RemoveSignalReceiver()
+    #
+    def AddSignalReceiver(self, dbuscon, cbfnc, **kwargs):
+        def __dispatch(*args, **cbargs):
+            self.__loop.call_soon_threadsafe(lambda: cbfnc(*args, **cbargs))
+
+        match = {}
+        done = threading.Event()
+
+        def __subscribe():
+            match['match'] = dbuscon.add_signal_receiver(__dispatch, **kwargs)
+            done.set()
+            return False
+
+        GLib.idle_add(__subscribe)
+        done.wait()
+        return match['match']
+
+
+    ##
+    #  Remove a signal subscription done via AddSignalReceiver()
+    #
+    #  @param match   Subscription object returned by AddSignalReceiver()
+    #
+    def RemoveSignalReceiver(self, match):
+        def __unsubscribe():
+            match.remove()
+            return False
+
+        GLib.idle_add(__unsubscribe)
+
+
+    ##
+    #  Stop the GLib main loop thread.  No D-Bus calls or signals will
+    #  be processed after this.
+    #
+    def Stop(self):
+        self.__mainloop.quit()
+        self.__thread.join()
+
+
+    @staticmethod
+    def __set_result(fut, value, parser):
+        if fut.cancelled():
+            return
+        try:
+            fut.set_result(parser(value) if parser is not None else value)
+        except Exception as excp:
+            fut.set_exception(excp)
+
+
+    @staticmethod
+    def __set_exception(fut, excp):
+        if not fut.cancelled():
+            fut.set_exception(excp)
@@ -24,6 +24,7 @@
 #         configuration manager service over D-Bus
 #
 
+import asyncio
 import dbus
 import json
 import time
@@ -273,6 +274,31 @@ class ConfigurationManager(object):
         return Configuration(self.__dbuscon, path)
 
 
+    ##
+    #  Import several configuration profiles in a single call to the
+    #  configuration manager.  A profile which cannot be imported does
+    #  not stop the others from being imported.
+    #
+    #  @param profiles    List of dictionaries, one per profile.  The
+    #                     'name' and 'config' keys are required; the
+    #                     optional keys are 'single_use', 'persistent',
+    #                     'public_access', 'locked_down' (booleans, default
+    #                     False) and 'overrides' (dictionary of override
+    #                     keys and values).
+    #
+    #  @return Returns a list with a (Configuration, error) tuple per
+    #          profile, in the same order as the profiles argument.  On
+    #          success the error is None, otherwise the Configuration is
+    #          None and the error is a string with the reason.
+    #
+    def ImportBulk(self, profiles):
+        self.__ping()
+        res = self.__manager_intf.ImportBulk(_bulk_import_args(profiles))
+        return [(Configuration(self.__dbuscon, path), None) if '' == err
+                else (None, str(err))
+                for (path, err) in res]
+
+
     ##
     #  Retrieve a single Configuration object for a specific configuration path
     #
@@ -299,6 +325,23 @@ class ConfigurationManager(object):
         return ret
 
 
+    ##
+    #  Retrieve the listing details of all available configuration profiles
+    #  in a single call to the configuration manager
+    #
+    #  @return Returns a dictionary where the keys are the D-Bus object paths
+    #          of the configuration profiles.  The values are dictionaries
+    #          with the details, using the configuration property names
+    #          as keys.
+    #
+    def FetchAvailableConfigsDetailed(self):
+        self.__ping()
+        ret = {}
+        for (path, details) in self.__manager_intf.FetchAvailableConfigsDetailed().items():
+            ret[str(path)] = dict(details)
+        return ret
+
+
     ##
     #  Looks up a configuration name to find available D-Bus paths to
     #  configuration objects with the given name.
@@ -344,3 +387,213 @@ class ConfigurationManager(object):
                 delay *= 1.33
             attempts -= 1
         raise RuntimeError("Could not establish contact with the Configuration Manager")
+
+
+##
+#  The AsyncConfiguration object provides the same kind of access to a
+#  single configuration profile as the Configuration object, but all the
+#  D-Bus calls are done via an AsyncBridge object and are awaitable from
+#  an asyncio event loop.
+#
+class AsyncConfiguration(object):
+    ##
+    #  Initialize the AsyncConfiguration object
+    #
+    #  @param bridge   An openvpn3.AsyncBridge object
+    #  @param dbuscon  D-Bus connection object retrieved via the
+    #                  AsyncBridge.SystemBus() method
+    #  @param objpath  D-Bus object path to the configuration profile
+    #
+    def __init__(self, bridge, dbuscon, objpath):
+        self.__bridge = bridge
+        self.__config = dbuscon.get_object('net.openvpn.v3.configuration',
+                                           objpath, introspect=False)
+        self.__config_intf = dbus.Interface(self.__config,
+                                            dbus_interface="net.openvpn.v3.configuration")
+        self.__prop_intf = dbus.Interface(self.__config,
+                                          dbus_interface="org.freedesktop.DBus.Properties")
+        self.__cfg_path = objpath
+
+
+    def GetPath(self):
+        return dbus.ObjectPath(self.__cfg_path)
+
+
+    async def GetConfigName(self):
+        return await self.__bridge.Call(self.__prop_intf.Get,
+                                        'net.openvpn.v3.configuration', 'name',
+                                        parser=str)
+
+
+    async def GetProperty(self, propname):
+        return await self.__bridge.Call(self.__prop_intf.Get,
+                                        'net.openvpn.v3.configuration',
+                                        propname)
+
+
+    ##
+    #  Retrieve all the properties of the configuration profile in a
+    #  single D-Bus call
+    #
+    #  @return Returns a dictionary with the property names as keys
+    #
+    async def GetAllProperties(self):
+        return await self.__bridge.Call(self.__prop_intf.GetAll,
+                                        'net.openvpn.v3.configuration',
+                                        parser=dict)
+
+
+    async def SetProperty(self, propname, propvalue):
+        await self.__bridge.Call(self.__prop_intf.Set,
+                                 'net.openvpn.v3.configuration',
+                                 propname, propvalue)
+
+
+    async def Remove(self):
+        await self.__bridge.Call(self.__config_intf.Remove)
+
+
+    async def Fetch(self):
+        return await self.__bridge.Call(self.__config_intf.Fetch)
+
+
+    async def FetchJSON(self):
+        return await self.__bridge.Call(self.__config_intf.FetchJSON,
+                                        parser=json.loads)
+
+
+##
+#  The AsyncConfigurationManager object provides asyncio based access to
+#  the configuration manager D-Bus service.  All the D-Bus calls are done
+#  via an AsyncBridge object.
+#
+class AsyncConfigurationManager(object):
+    ##
+    #  Initialize the AsyncConfigurationManager object
+    #
+    #  @param bridge   An openvpn3.AsyncBridge object
+    #  @param dbuscon  D-Bus connection object retrieved via the
+    #                  AsyncBridge.SystemBus() method
+    #
+    def __init__(self, bridge, dbuscon):
+        self.__bridge = bridge
+        self.__dbuscon = dbuscon
+
+        self.__manager_object = dbuscon.get_object('net.openvpn.v3.configuration',
+                                                   '/net/openvpn/v3/configuration',
+                                                   introspect=False)
+        self.__manager_intf = dbus.Interface(self.__manager_object,
+                                             dbus_interface='net.openvpn.v3.configuration')
+        self.__prop_intf = dbus.Interface(self.__manager_object,
+                                          dbus_interface="org.freedesktop.DBus.Properties")
+        self.__peer_intf = dbus.Interface(self.__manager_object,
+                                          dbus_interface='org.freedesktop.DBus.Peer')
+        self.__contacted = False
+
+
+    ##
+    #  Import a new configuration profile.  See ConfigurationManager.Import()
+    #  for details about the arguments.
+    #
+    #  @return Returns an AsyncConfiguration object of the imported profile
+    #
+    async def Import(self, cfgname, cfg, single_use, persistent):
+        await self.__ping()
+        path = await self.__bridge.Call(self.__manager_intf.Import,
+                                        cfgname, cfg,
+                                        dbus.Boolean(single_use),
+                                        dbus.Boolean(persistent))
+        return self.Retrieve(path)
+
+
+    ##
+    #  Import several configuration profiles in a single call.  See
+    #  ConfigurationManager.ImportBulk() for details.
+    #
+    async def ImportBulk(self, profiles):
+        await self.__ping()
+        res = await self.__bridge.Call(self.__manager_intf.ImportBulk,
+                                       _bulk_import_args(profiles))
+        return [(self.Retrieve(path), None) if '' == err else (None, str(err))
+                for (path, err) in res]
+
+
+    def Retrieve(self, objpath):
+        return AsyncConfiguration(self.__bridge, self.__dbuscon, objpath)
+
+
+    async def FetchAvailableConfigs(self):
+        await self.__ping()
+        paths = await self.__bridge.Call(self.__manager_intf.FetchAvailableConfigs)
+        return [self.Retrieve(p) for p in paths]
+
+
+    ##
+    #  Retrieve the listing details of all available configuration profiles
+    #  in a single call.  See ConfigurationManager.FetchAvailableConfigsDetailed()
+    #
+    async def FetchAvailableConfigsDetailed(self):
+        def __parse(configs):
+            ret = {}
+            for (path, details) in configs.items():
+                ret[str(path)] = dict(details)
+            return ret
+
+        await self.__ping()
+        return await self.__bridge.Call(self.__manager_intf.FetchAvailableConfigsDetailed,
+                                        parser=__parse)
+
+
+    async def LookupConfigName(self, cfgname):
+        await self.__ping()
+        return await self.__bridge.Call(self.__manager_intf.LookupConfigName,
+                                        cfgname)
+
+
+    ##
+    #  Private method, the asyncio variant of ConfigurationManager.__ping().
+    #  The service is only pinged until it has responded once.
+    #
+    async def __ping(self):
+        if self.__contacted:
+            return
+
+        delay = 0.5
+        attempts = 10
+
+        while attempts > 0:
+            try:
+                await self.__bridge.Call(self.__peer_intf.Ping)
+                await self.__bridge.Call(self.__prop_intf.Get,
+                                         'net.openvpn.v3.configuration', 'version')
+                self.__contacted = True
+                return
+            except dbus.exceptions.DBusException as excp:
+                err = str(excp)
+                if err.find("org.freedesktop.DBus.Error.AccessDenied:") > 0:
+                    raise RuntimeError("Access denied to the Configuration Manager (ping)")
+                await asyncio.sleep(delay)
+                delay *= 1.33
+            attempts -= 1
+        raise RuntimeError("Could not establish contact with the Configuration Manager")
+
+
+##
+#  Internal helper, converts the profile dictionaries given to ImportBulk()
+#  to the D-Bus argument of the ImportBulk method.  Override values which
+#  are not booleans are passed as strings.
+#
+def _bulk_import_args(profiles):
+    ret = dbus.Array(signature='(ssbba{sv}bb)')
+    for p in profiles:
+        ovs = dbus.Dictionary(signature='sv')
+        for (k, v) in p.get('overrides', {}).items():
+            ovs[k] = dbus.Boolean(v) if isinstance(v, bool) else dbus.String(str(v))
+        ret.append(dbus.Struct((p['name'], p['config'],
+                                dbus.Boolean(p.get('single_use', False)),
+                                dbus.Boolean(p.get('persistent', False)),
+                                ovs,
+                                dbus.Boolean(p.get('public_access', False)),
+                                dbus.Boolean(p.get('locked_down', False))),
+                               signature='ssbba{sv}bb'))
+    return ret
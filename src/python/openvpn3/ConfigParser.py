@@ -424,7 +424,13 @@ class ConfigParser():
                        'ipv6', 'dns-setup-disabled', 'dns-sync-lookup',
                        'auth-fail-retry', 'proxy-host', 'proxy-port',
                        'proxy-username', 'proxy-password',
-                       'proxy-auth-cleartext', 'enable-legacy-algorithms']
+                       'proxy-auth-cleartext', 'enable-legacy-algorithms',
+                       'core-cpu-affinity', 'core-nice', 'core-sched-policy',
+                       'reuse-tun-device', 'connect-race',
+                       'path-mtu-discovery', 'path-quality',
+                       'failover-standby', 'shared-resolver',
+                       'power-save', 'flight-recorder',
+                       'log-direct']
         self.__parser.add_argument('--profile-override',
                                    metavar='OVERRIDE-KEY OVERRIDE-VALUE',
                                    action=ConfigParser.OpenVPNoverrideArgs,
@@ -130,6 +130,7 @@ class NetCfgManager(object):
 
         self.__networkchange_cbfnc = None
         self.__subscription = None
+        self.__batch_seq = None
 
 
     def Introspect(self):
@@ -192,14 +193,27 @@ class NetCfgManager(object):
     #  The callback function needs to accept 1 argument which will always be
     #  a NetworkChangeSignal object
     #
-    def SubscribeNetworkChange(self, cbfnc, filter):
+    #  With batched delivery, the events are received in NetworkChangeBatch
+    #  signals and the callback is called once per event.  A RuntimeWarning
+    #  is raised if events have been lost.
+    #
+    def SubscribeNetworkChange(self, cbfnc, filter, batched=False):
         self.__networkchange_cbfnc = cbfnc
         if None == self.__subscription:
-            self.__subscription = self.__dbuscon.add_signal_receiver(self.__networkchange_callback,
-                                                                     'NetworkChange',
-                                                                     'net.openvpn.v3.netcfg',
-                                                                     'net.openvpn.v3.netcfg')
-            self.__manager_intf.NotificationSubscribe(dbus.UInt32(filter.value))
+            flags = filter.value
+            if batched:
+                self.__batch_seq = 1
+                self.__subscription = self.__dbuscon.add_signal_receiver(self.__networkchange_batch_callback,
+                                                                         'NetworkChangeBatch',
+                                                                         'net.openvpn.v3.netcfg',
+                                                                         'net.openvpn.v3.netcfg')
+                flags |= 1 << 16
+            else:
+                self.__subscription = self.__dbuscon.add_signal_receiver(self.__networkchange_callback,
+                                                                         'NetworkChange',
+                                                                         'net.openvpn.v3.netcfg',
+                                                                         'net.openvpn.v3.netcfg')
+            self.__manager_intf.NotificationSubscribe(dbus.UInt32(flags))
 
 
     def UnsubscribeNetworkChange(self):
@@ -210,6 +224,7 @@ class NetCfgManager(object):
         self.__dbuscon.remove_signal_receiver(self.__subscription)
         self.__subscription = None
         self.__networkchange_cbfnc = None
+        self.__batch_seq = None
 
 
     def __networkchange_callback(self, type, device, details):
@@ -218,6 +233,17 @@ class NetCfgManager(object):
         self.__networkchange_cbfnc(NetworkChangeSignal(type, device, details))
 
 
+    def __networkchange_batch_callback(self, first_seq, events):
+        if self.__networkchange_cbfnc is None:
+            return
+        lost = first_seq - self.__batch_seq
+        self.__batch_seq = first_seq + len(events)
+        for (type, device, details) in events:
+            self.__networkchange_cbfnc(NetworkChangeSignal(type, device, details))
+        if lost > 0:
+            raise RuntimeWarning("%i NetworkChange events lost" % lost)
+
+
     ##
     #  Private method, which sends a Ping() call to the main D-Bus
     #  interface for the service.  This is used to wake-up the service
@@ -24,6 +24,7 @@
 #         session manager service over D-Bus
 #
 
+import asyncio
 import dbus
 import time
 from functools import wraps
@@ -254,6 +255,25 @@ class Session(object):
                 "message": status[2]}
 
 
+    ##
+    #  Retrieve the status changes emitted after a given sequence number
+    #
+    #  @param seq   Sequence number of the last status change seen,
+    #               0 retrieves all the status changes kept
+    #
+    #  @return  Returns a tuple of the last sequence number and a list of
+    #           dictionaries of the newer status changes, oldest first
+    #
+    @__delete_check
+    def GetStatusSince(self, seq=0):
+        (last_seq, events) = self.__session_intf.GetStatusSince(dbus.UInt64(seq))
+        return (int(last_seq),
+                [{"seq": int(ev[0]),
+                  "major": StatusMajor(ev[1]),
+                  "minor": StatusMinor(ev[2]),
+                  "message": str(ev[3])} for ev in events])
+
+
     ##
     #  Retrieve session statistics
     #
@@ -522,6 +542,23 @@ class SessionManager(object):
         return Session(self.__dbuscon, path)
 
 
+    ##
+    #  Create a bundle of parallel VPN sessions of the same configuration
+    #  profile.  The routes of the sessions are shared as multipath routes.
+    #
+    #  @param cfgobj      openvpn3.Configuration object to use for the
+    #                     new sessions
+    #  @param count       Number of sessions to create, 2 to 16
+    #
+    #  @return Returns a list of Session objects, one per session
+    #
+    def NewTunnelBundle(self, cfgobj, count):
+        self.__ping()
+        paths = self.__manager_intf.NewTunnelBundle(cfgobj.GetPath(),
+                                                    dbus.UInt32(count))
+        return [Session(self.__dbuscon, p) for p in paths]
+
+
     ##
     #  Retrieve a single Session object for a specific configuration path
     #
@@ -577,9 +614,17 @@ class SessionManager(object):
     #  The callback function needs to accept 1 arguments:
     #    a SessionManagerEvent object
     #
+    #  The session manager only sends these signals to subscribers, for
+    #  the sessions the caller has access to.
+    #
     def SessionManagerCallback(self, cbfnc):
         self.__sessmgr_callback_func = cbfnc
         self.__manager_intf.connect_to_signal('SessionManagerEvent', self.__sessmgr_event_cb_wrapper)
+        try:
+            self.__manager_intf.EventSubscribe()
+        except dbus.exceptions.DBusException:
+            # Older session managers broadcast these signals instead
+            pass
 
 
     ##
@@ -612,3 +657,382 @@ class SessionManager(object):
     #
     def __sessmgr_event_cb_wrapper(self, path, evtype, owner):
         self.__sessmgr_callback_func(SessionManagerEvent(path, evtype, owner))
+
+
+##
+#  The AsyncSession object provides the same kind of access to a single
+#  VPN session as the Session object, but all the D-Bus calls are done
+#  via an AsyncBridge object and are awaitable from an asyncio event loop.
+#
+class AsyncSession(object):
+    ##
+    #  Initialize the AsyncSession object
+    #
+    #  @param bridge   An openvpn3.AsyncBridge object
+    #  @param dbuscon  D-Bus connection object retrieved via the
+    #                  AsyncBridge.SystemBus() method
+    #  @param objpath  D-Bus object path to the VPN session
+    #
+    def __init__(self, bridge, dbuscon, objpath):
+        self.__bridge = bridge
+        self.__dbuscon = dbuscon
+        self.__session_path = objpath
+
+        self.__session = self.__dbuscon.get_object('net.openvpn.v3.sessions',
+                                                   objpath,
+                                                   introspect=False)
+        self.__session_intf = dbus.Interface(self.__session,
+                                             dbus_interface="net.openvpn.v3.sessions")
+        self.__prop_intf = dbus.Interface(self.__session,
+                                          dbus_interface="org.freedesktop.DBus.Properties")
+
+        self.__stats_match = None
+        self.__stats_layout = None
+
+
+    ##
+    #  Returns the D-Bus session object path
+    #
+    def GetPath(self):
+        return dbus.ObjectPath(self.__session_path)
+
+
+    ##
+    #  Retrieve the value of a property in a VPN session object
+    #
+    #  @param propname  String containing the property name to query
+    #
+    async def GetProperty(self, propname):
+        return await self.__bridge.Call(self.__prop_intf.Get,
+                                        'net.openvpn.v3.sessions', propname)
+
+
+    ##
+    #  Retrieve all the properties of the VPN session object in a single
+    #  D-Bus call
+    #
+    #  @return Returns a dictionary with the property names as keys
+    #
+    async def GetAllProperties(self):
+        return await self.__bridge.Call(self.__prop_intf.GetAll,
+                                        'net.openvpn.v3.sessions',
+                                        parser=dict)
+
+
+    ##
+    #  Sets a specific property in the VPN session object
+    #
+    #  @param propname   String containing the property name to modify
+    #  @param propvalue  The new value the property should have
+    #
+    async def SetProperty(self, propname, propvalue):
+        await self.__bridge.Call(self.__prop_intf.Set,
+                                 'net.openvpn.v3.sessions',
+                                 propname, propvalue)
+
+
+    async def Ready(self):
+        await self.__bridge.Call(self.__session_intf.Ready)
+
+
+    async def Connect(self):
+        await self.__bridge.Call(self.__session_intf.Connect)
+
+
+    async def Pause(self, reason='User request'):
+        await self.__bridge.Call(self.__session_intf.Pause, reason)
+
+
+    async def Resume(self):
+        await self.__bridge.Call(self.__session_intf.Resume)
+
+
+    async def Restart(self):
+        await self.__bridge.Call(self.__session_intf.Restart)
+
+
+    async def Disconnect(self):
+        self.StatisticsUnsubscribe()
+        await self.__bridge.Call(self.__session_intf.Disconnect)
+
+
+    ##
+    #  Retrive the session status
+    #
+    #  @return  Returns a dictionary with the major, minor and message keys
+    #
+    async def GetStatus(self):
+        return await self.__bridge.Call(self.__prop_intf.Get,
+                                        'net.openvpn.v3.sessions', 'status',
+                                        parser=_parse_status)
+
+
+    ##
+    #  Retrieve the status changes emitted after a given sequence number.
+    #  See Session.GetStatusSince() for details.
+    #
+    async def GetStatusSince(self, seq=0):
+        def __parse(res):
+            (last_seq, events) = res
+            return (int(last_seq),
+                    [{"seq": int(ev[0]),
+                      "major": StatusMajor(ev[1]),
+                      "minor": StatusMinor(ev[2]),
+                      "message": str(ev[3])} for ev in events])
+
+        return await self.__bridge.Call(self.__session_intf.GetStatusSince,
+                                        dbus.UInt64(seq), parser=__parse)
+
+
+    ##
+    #  Retrieve all the session statistics counters
+    #
+    #  @return Returns a dictionary with the counter names as keys
+    #
+    async def GetStatistics(self):
+        return await self.__bridge.Call(self.__prop_intf.Get,
+                                        'net.openvpn.v3.sessions',
+                                        'statistics', parser=dict)
+
+
+    ##
+    #  Subscribe to the Statistics signal of this session.  Instead of
+    #  polling the statistics property, the session manager pushes the
+    #  counters at most once per interval and only when they changed.
+    #
+    #  The callback function needs to accept 2 arguments:
+    #     (AsyncSession) this session object, (dict) statistics counters
+    #
+    #  @param cbfnc        Callback function, called in the asyncio event loop
+    #  @param interval_ms  Requested signal interval in milliseconds
+    #
+    async def StatisticsSubscribe(self, cbfnc, interval_ms=1000):
+        self.StatisticsUnsubscribe()
+        self.__stats_layout = await self.__get_stats_layout()
+
+        def __stats_signal(layout_id, counters):
+            if self.__stats_layout[0] != layout_id:
+                # The counter names changed, the new key table is needed
+                # before the counters can be interpreted
+                async def __relayout():
+                    self.__stats_layout = await self.__get_stats_layout()
+                    if self.__stats_layout[0] == layout_id:
+                        cbfnc(self, self.__unpack_stats(counters))
+                asyncio.ensure_future(__relayout(),
+                                      loop=self.__bridge.GetLoop())
+                return
+            cbfnc(self, self.__unpack_stats(counters))
+
+        self.__stats_match = self.__bridge.AddSignalReceiver(
+            self.__dbuscon, __stats_signal,
+            signal_name='Statistics',
+            dbus_interface='net.openvpn.v3.sessions',
+            bus_name='net.openvpn.v3.sessions',
+            path=self.__session_path)
+        await self.__bridge.Call(self.__session_intf.StatisticsSubscribe,
+                                 dbus.UInt32(interval_ms))
+
+
+    ##
+    #  Removes the Statistics signal subscription of this session object.
+    #  The session manager removes the subscription on its side when
+    #  this D-Bus connection is closed.
+    #
+    def StatisticsUnsubscribe(self):
+        if self.__stats_match is None:
+            return
+        self.__bridge.RemoveSignalReceiver(self.__stats_match)
+        self.__stats_match = None
+        self.__bridge.Call(self.__session_intf.StatisticsSubscribe,
+                           dbus.UInt32(0))
+
+
+    async def __get_stats_layout(self):
+        (layout_id, names) = await self.__bridge.Call(self.__prop_intf.Get,
+                                                      'net.openvpn.v3.sessions',
+                                                      'statistics_layout')
+        return (int(layout_id), [str(n) for n in names])
+
+
+    def __unpack_stats(self, counters):
+        return dict(zip(self.__stats_layout[1], [int(c) for c in counters]))
+
+
+##
+#  The AsyncSessionManager object provides asyncio based access to the
+#  session manager D-Bus service.  All the D-Bus calls are done via an
+#  AsyncBridge object, which avoids the need for a thread per request
+#  in the calling program.
+#
+class AsyncSessionManager(object):
+    ##
+    #  Initialize the AsyncSessionManager object
+    #
+    #  @param bridge   An openvpn3.AsyncBridge object
+    #  @param dbuscon  D-Bus connection object retrieved via the
+    #                  AsyncBridge.SystemBus() method
+    #
+    def __init__(self, bridge, dbuscon):
+        self.__bridge = bridge
+        self.__dbuscon = dbuscon
+
+        self.__manager_object = dbuscon.get_object('net.openvpn.v3.sessions',
+                                                   '/net/openvpn/v3/sessions',
+                                                   introspect=False)
+        self.__manager_intf = dbus.Interface(self.__manager_object,
+                                             dbus_interface='net.openvpn.v3.sessions')
+        self.__prop_intf = dbus.Interface(self.__manager_object,
+                                          dbus_interface="org.freedesktop.DBus.Properties")
+        self.__peer_intf = dbus.Interface(self.__manager_object,
+                                          dbus_interface='org.freedesktop.DBus.Peer')
+        self.__sessmgr_match = None
+        self.__contacted = False
+
+
+    def GetObjectPath(self):
+        return self.__manager_object.object_path
+
+
+    ##
+    #  Create a new VPN session
+    #
+    #  @param cfgpath   D-Bus object path of the configuration profile
+    #                   to use for this new session
+    #
+    #  @return Returns an AsyncSession object of the new session
+    #
+    async def NewTunnel(self, cfgpath):
+        await self.__ping()
+        path = await self.__bridge.Call(self.__manager_intf.NewTunnel,
+                                        dbus.ObjectPath(cfgpath))
+        return self.Retrieve(path)
+
+
+    ##
+    #  Retrieve a single AsyncSession object for a specific session path
+    #
+    #  @param objpath   D-Bus object path to the VPN session to retrieve
+    #
+    def Retrieve(self, objpath):
+        return AsyncSession(self.__bridge, self.__dbuscon, objpath)
+
+
+    ##
+    #  Retrieve a list of all available VPN sessions
+    #
+    #  @return Returns a list of AsyncSession objects
+    #
+    async def FetchAvailableSessions(self):
+        await self.__ping()
+        paths = await self.__bridge.Call(self.__manager_intf.FetchAvailableSessions)
+        return [self.Retrieve(p) for p in paths]
+
+
+    ##
+    #  Retrieve the listing details of all available VPN sessions in a
+    #  single call to the session manager
+    #
+    #  @return Returns a dictionary where the keys are the D-Bus object paths
+    #          of the sessions.  The values are dictionaries with the details,
+    #          using the session property names as keys.  The 'status' entry,
+    #          when present, is parsed the same way as AsyncSession.GetStatus()
+    #
+    async def FetchSessionsDetailed(self):
+        def __parse(sessions):
+            ret = {}
+            for (path, details) in sessions.items():
+                d = dict(details)
+                if 'status' in d:
+                    d['status'] = _parse_status(d['status'])
+                ret[str(path)] = d
+            return ret
+
+        await self.__ping()
+        return await self.__bridge.Call(self.__manager_intf.FetchSessionsDetailed,
+                                        parser=__parse)
+
+
+    ##
+    #  Looks up a configuration name to find available session objects
+    #  started with the given configuration name
+    #
+    #  @return Returns a list of D-Bus path objects
+    #
+    async def LookupConfigName(self, cfgname):
+        await self.__ping()
+        return await self.__bridge.Call(self.__manager_intf.LookupConfigName,
+                                        cfgname)
+
+
+    ##
+    #  Subscribes to the SessionManagerEvent signals from the session manager.
+    #  The callback function is called in the asyncio event loop with a
+    #  SessionManagerEvent object.  Use None to unsubscribe.
+    #
+    #  The session manager only sends these signals to subscribers, for
+    #  the sessions the caller has access to.
+    #
+    def SessionManagerCallback(self, cbfnc):
+        if self.__sessmgr_match is not None:
+            self.__bridge.RemoveSignalReceiver(self.__sessmgr_match)
+            self.__sessmgr_match = None
+            if cbfnc is None:
+                self.__event_subscribe(self.__manager_intf.EventUnsubscribe)
+        if cbfnc is None:
+            return
+        self.__sessmgr_match = self.__bridge.AddSignalReceiver(
+            self.__dbuscon,
+            lambda path, evtype, owner: cbfnc(SessionManagerEvent(path, evtype, owner)),
+            signal_name='SessionManagerEvent',
+            dbus_interface='net.openvpn.v3.sessions',
+            bus_name='net.openvpn.v3.sessions',
+            path='/net/openvpn/v3/sessions')
+        self.__event_subscribe(self.__manager_intf.EventSubscribe)
+
+
+    ##
+    #  Private method, calls EventSubscribe or EventUnsubscribe without
+    #  waiting for the result.  Older session managers do not have these
+    #  methods, as they broadcast the SessionManagerEvent signals.
+    #
+    def __event_subscribe(self, method):
+        fut = self.__bridge.Call(method)
+        fut.add_done_callback(lambda f: f.exception())
+
+
+    ##
+    #  Private method, the asyncio variant of SessionManager.__ping().
+    #  Once the service has responded, D-Bus activation takes care of
+    #  restarting it if needed, so it is only pinged until then.
+    #
+    async def __ping(self):
+        if self.__contacted:
+            return
+
+        delay = 0.5
+        attempts = 10
+
+        while attempts > 0:
+            try:
+                await self.__bridge.Call(self.__peer_intf.Ping)
+                await self.__bridge.Call(self.__prop_intf.Get,
+                                         'net.openvpn.v3.sessions', 'version')
+                self.__contacted = True
+                return
+            except dbus.exceptions.DBusException as excp:
+                err = str(excp)
+                if err.find("org.freedesktop.DBus.Error.AccessDenied:") > 0:
+                    raise RuntimeError("Access denied to the Session Manager (ping)")
+                await asyncio.sleep(delay)
+                delay *= 1.33
+            attempts -= 1
+        raise RuntimeError("Could not establish contact with the Session Manager")
+
+
+##
+#  Internal helper, parses the status tuple (major, minor, message)
+#
+def _parse_status(status):
+    return {"major": StatusMajor(status[0]),
+            "minor": StatusMinor(status[1]),
+            "message": str(status[2])}
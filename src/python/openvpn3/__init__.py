@@ -32,7 +32,10 @@ __all__ = ['StatusMajor', 'StatusMinor',
 
 # Make all defined constants and classes part if this main module
 from .constants import *
+from .AsyncBridge import AsyncBridge
 from .ConfigParser import ConfigParser
 from .ConfigManager import ConfigurationManager, Configuration
+from .ConfigManager import AsyncConfigurationManager, AsyncConfiguration
 from .NetCfgManager import NetCfgManager, NetCfgDevice, NetworkChangeSignal
 from .SessionManager import SessionManager, SessionManagerEvent, Session
+from .SessionManager import AsyncSessionManager, AsyncSession
@@ -0,0 +1,251 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   config-cache.hpp
+ *
+ * @brief  Keeps the configuration profile details the session manager
+ *         needs when a new session registers, so they do not have to be
+ *         retrieved from the configuration manager with blocking calls
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+
+/**
+ *  The session manager retrieves the details of a configuration profile
+ *  asynchronously when a new session is created, so they are available
+ *  when the backend process registers.  Concurrent sessions for the same
+ *  profile share a single lookup.
+ *
+ *  Entries are invalidated when the configuration manager signals a
+ *  property change of the profile, and they expire after a while, so
+ *  profiles removed without a signal do not stay around.  A lookup
+ *  started before an entry was invalidated does not store its result.
+ *
+ *  All methods are thread-safe.
+ */
+class ConfigCache
+{
+public:
+    using Ptr = std::shared_ptr<ConfigCache>;
+    using Clock = std::chrono::steady_clock;
+
+    /// The configuration profile details used by the session manager
+    struct Info
+    {
+        uid_t owner = 0;
+        bool transfer_owner_session = false;
+    };
+
+
+    /**
+     * @param max_age  How long an entry is kept
+     */
+    ConfigCache(std::chrono::seconds max_age = std::chrono::minutes(5))
+        : max_age(max_age)
+    {
+    }
+
+
+    /**
+     *  Looks up the details of a profile
+     *
+     * @param config_path  D-Bus path of the configuration profile
+     * @param info         Info to fill in
+     * @param now          Current time
+     *
+     * @return Returns true if a valid entry was found
+     */
+    bool Lookup(const std::string& config_path, Info& info,
+                Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = entries.find(config_path);
+        if (entries.end() == it || !it->second.valid)
+        {
+            return false;
+        }
+        if (now - it->second.stored > max_age)
+        {
+            entries.erase(it);
+            return false;
+        }
+        info = it->second.info;
+        return true;
+    }
+
+
+    /**
+     *  Registers a lookup of a profile about to be started
+     *
+     * @param config_path  D-Bus path of the configuration profile
+     * @param generation   Set to the value to pass to Store()
+     * @param now          Current time
+     *
+     * @return Returns false if a valid entry exists or a lookup is
+     *         already pending; no new lookup is needed then
+     */
+    bool StartLookup(const std::string& config_path, uint64_t& generation,
+                     Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        expire(now);
+        Entry& e = entries[config_path];
+        if (e.valid || e.pending)
+        {
+            return false;
+        }
+        e.pending = true;
+        e.generation = ++last_generation;
+        generation = e.generation;
+        return true;
+    }
+
+
+    /**
+     *  Stores the result of a lookup.  The result is dropped if the
+     *  entry was invalidated after the lookup started.
+     *
+     * @param config_path  D-Bus path of the configuration profile
+     * @param generation   Value provided by StartLookup(); use 0 for
+     *                     lookups not started via StartLookup()
+     * @param info         Details of the profile
+     * @param now          Current time
+     */
+    void Store(const std::string& config_path, const uint64_t generation,
+               const Info& info, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = entries.find(config_path);
+        if (0 != generation
+            && (entries.end() == it || generation != it->second.generation))
+        {
+            return;
+        }
+        Entry& e = entries[config_path];
+        e.pending = false;
+        e.valid = true;
+        e.info = info;
+        e.stored = now;
+    }
+
+
+    /**
+     *  Marks a lookup as failed, so the next session starts a new one
+     *
+     * @param config_path  D-Bus path of the configuration profile
+     * @param generation   Value provided by StartLookup()
+     */
+    void LookupFailed(const std::string& config_path, const uint64_t generation)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = entries.find(config_path);
+        if (entries.end() != it && generation == it->second.generation)
+        {
+            entries.erase(it);
+        }
+    }
+
+
+    /**
+     *  Invalidates the entry of a profile, including pending lookups
+     *
+     * @param config_path  D-Bus path of the configuration profile
+     */
+    void Invalidate(const std::string& config_path)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = entries.find(config_path);
+        if (entries.end() != it)
+        {
+            it->second.valid = false;
+            it->second.pending = false;
+            it->second.generation = ++last_generation;
+        }
+    }
+
+
+    /**
+     *  Invalidates all entries, like when the configuration manager
+     *  has restarted
+     */
+    void Clear()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        for (auto& e : entries)
+        {
+            e.second.valid = false;
+            e.second.pending = false;
+            e.second.generation = ++last_generation;
+        }
+    }
+
+
+    /**
+     * @return Returns the number of entries, including invalid ones
+     *         not yet removed
+     */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return entries.size();
+    }
+
+
+private:
+    struct Entry
+    {
+        Info info;
+        Clock::time_point stored;
+        bool valid = false;
+        bool pending = false;
+        uint64_t generation = 0;
+    };
+
+    const std::chrono::seconds max_age;
+    mutable std::mutex mtx;
+    std::map<std::string, Entry> entries;
+    uint64_t last_generation = 0;
+
+
+    void expire(Clock::time_point now)
+    {
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            if (!it->second.pending
+                && (!it->second.valid || now - it->second.stored > max_age))
+            {
+                it = entries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+};
@@ -0,0 +1,242 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   connect-admission.hpp
+ *
+ * @brief  Limits the number of sessions connecting at the same time
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+
+/**
+ *  When many sessions start connecting at the same moment, like after
+ *  the uplink of a site has flapped or the host has woken up, the backend
+ *  starter, configmgr, netcfg and the DNS backend all get flooded at once.
+ *  The session manager lets only a limited number of sessions connect at
+ *  the same time; the others are queued, ordered by their connect
+ *  priority and then by when they were queued.
+ *
+ *  A session holds its slot until its connection is established or has
+ *  failed.  When a slot is released, the next queued session is
+ *  admitted; the caller delays its start by a random jitter, so the
+ *  admitted sessions do not all start in the same instant.
+ *
+ *  With a limit of 0, all sessions are admitted right away; they are
+ *  still counted as in progress.
+ *
+ *  All methods are thread-safe.
+ */
+class ConnectAdmission
+{
+public:
+    using Ptr = std::shared_ptr<ConnectAdmission>;
+
+    /// Function starting the connection of an admitted session
+    using Start = std::function<void()>;
+
+    struct State
+    {
+        unsigned int max_concurrent = 0;
+        unsigned int jitter_ms = 0;
+        unsigned int in_progress = 0;
+        unsigned int queued = 0;
+    };
+
+
+    /**
+     * @param max_concurrent  Maximum number of sessions connecting at the
+     *                        same time; 0 for no limit
+     * @param jitter_ms       Upper limit of the random start delay of
+     *                        queued sessions, in milliseconds
+     */
+    ConnectAdmission(unsigned int max_concurrent = 0,
+                     unsigned int jitter_ms = 0)
+        : max_concurrent(max_concurrent), jitter_ms(jitter_ms),
+          rng(std::random_device{}())
+    {
+    }
+
+
+    /**
+     *  Requests a slot for a session to connect
+     *
+     * @param id        std::string identifying the session
+     * @param priority  Sessions with a higher value are admitted first
+     * @param start     Start function, called by the caller of Release()
+     *                  once the queued session is admitted
+     *
+     * @return Returns true if the session may connect right away, also
+     *         when it already holds a slot.  Returns false if it is
+     *         queued; the start function of an already queued session
+     *         is replaced.
+     */
+    bool Request(const std::string& id, const int priority, Start start)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (in_progress.count(id) > 0)
+        {
+            return true;
+        }
+        auto q = queued.find(id);
+        if (queued.end() != q)
+        {
+            q->second.start = start;
+            return false;
+        }
+        if (0 == max_concurrent || in_progress.size() < max_concurrent)
+        {
+            in_progress.insert(id);
+            return true;
+        }
+        QueueKey key(-priority, ++last_seq, id);
+        order.insert(key);
+        queued[id] = {key, start};
+        return false;
+    }
+
+
+    /**
+     *  Releases the slot of a session, or removes it from the queue.
+     *  Unknown sessions are ignored.
+     *
+     * @param id  std::string identifying the session
+     *
+     * @return Returns the start functions of the sessions admitted from
+     *         the queue, in admission order.  The caller must call them.
+     */
+    std::vector<Start> Release(const std::string& id)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto q = queued.find(id);
+        if (queued.end() != q)
+        {
+            order.erase(q->second.key);
+            queued.erase(q);
+            return {};
+        }
+        in_progress.erase(id);
+        return admit();
+    }
+
+
+    /**
+     *  Changes the limits.  Raising the limit admits queued sessions.
+     *
+     * @return Returns the start functions of the sessions admitted
+     */
+    std::vector<Start> Configure(const unsigned int max,
+                                 const unsigned int jitter)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        max_concurrent = max;
+        jitter_ms = jitter;
+        return admit();
+    }
+
+
+    /**
+     * @return Returns true if the session holds a slot
+     */
+    bool InProgress(const std::string& id) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return in_progress.count(id) > 0;
+    }
+
+
+    /**
+     * @return Returns the random delay to use before starting an
+     *         admitted session, in milliseconds
+     */
+    unsigned int Jitter()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (0 == jitter_ms)
+        {
+            return 0;
+        }
+        return std::uniform_int_distribution<unsigned int>(0, jitter_ms)(rng);
+    }
+
+
+    State GetState() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        State st;
+        st.max_concurrent = max_concurrent;
+        st.jitter_ms = jitter_ms;
+        st.in_progress = in_progress.size();
+        st.queued = queued.size();
+        return st;
+    }
+
+
+private:
+    /// Negated priority, queue sequence number and session id
+    using QueueKey = std::tuple<int, uint64_t, std::string>;
+
+    struct Queued
+    {
+        QueueKey key;
+        Start start;
+    };
+
+    mutable std::mutex mtx;
+    unsigned int max_concurrent;
+    unsigned int jitter_ms;
+    std::mt19937 rng;
+    uint64_t last_seq = 0;
+    std::set<std::string> in_progress;
+    std::set<QueueKey> order;
+    std::map<std::string, Queued> queued;
+
+
+    /**
+     *  Moves queued sessions into the free slots.  Must be called with
+     *  mtx held.
+     */
+    std::vector<Start> admit()
+    {
+        std::vector<Start> ret;
+        while (!order.empty()
+               && (0 == max_concurrent || in_progress.size() < max_concurrent))
+        {
+            const std::string id = std::get<2>(*order.begin());
+            order.erase(order.begin());
+            auto q = queued.find(id);
+            ret.push_back(q->second.start);
+            queued.erase(q);
+            in_progress.insert(id);
+        }
+        return ret;
+    }
+};
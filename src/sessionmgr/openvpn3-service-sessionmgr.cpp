@@ -28,6 +28,7 @@
 #include "log/logwriters/implementations.hpp"
 #include "log/proxy-log.hpp"
 #include "common/cmdargparser.hpp"
+#include "common/startup-timing.hpp"
 
 #include <openvpn/common/base64.hpp>
 
@@ -90,8 +91,11 @@ static int session_manager(ParsedArgs::Ptr args)
     LogServiceProxy::Ptr logsrvprx = nullptr;
     if (!signal_broadcast)
     {
-        logsrvprx = LogServiceProxy::AttachInterface(dbus.GetConnection(),
-                                                     OpenVPN3DBus_interf_sessions);
+        // Attached from the main loop, so our own bus name is not held
+        // back by the log service being activated
+        LogServiceProxy::AttachInterfaceDeferred(dbus.GetConnection(),
+                                                 {OpenVPN3DBus_interf_sessions},
+                                                 logsrvprx);
     }
 
     unsigned int log_level = 3;
@@ -100,6 +104,28 @@ static int session_manager(ParsedArgs::Ptr args)
         log_level = std::atoi(args->GetValue("log-level", 0).c_str());
     }
     sessmgr.SetManagerLogLevel(log_level);
+    sessmgr.EnableBackendPeerLink(args->Present("backend-peer-link"));
+    sessmgr.EnableSleepMonitor(!args->Present("ignore-sleep"));
+    sessmgr.EnableRemoteBackoff(args->Present("remote-backoff"));
+    if (args->Present("max-connects"))
+    {
+        unsigned int jitter = 1000;
+        if (args->Present("connect-jitter"))
+        {
+            jitter = std::atoi(args->GetValue("connect-jitter", 0).c_str());
+        }
+        sessmgr.SetConnectAdmission(std::atoi(args->GetValue("max-connects", 0).c_str()),
+                                    jitter);
+    }
+    if (args->Present("request-limit"))
+    {
+        unsigned int rate = std::atoi(args->GetValue("request-limit", 0).c_str());
+        DBusRequestThrottle::Instance().Configure(rate, rate * 5, 32);
+    }
+    if (args->Present("state-dir"))
+    {
+        sessmgr.SetStateDirectory(args->GetValue("state-dir", 0));
+    }
 
     IdleCheck::Ptr idle_exit;
     if (idle_wait_min > 0)
@@ -132,7 +158,6 @@ static int session_manager(ParsedArgs::Ptr args)
     if (idle_wait_min > 0)
     {
         idle_exit->Disable();
-        idle_exit->Join();
     }
 
     return 0;
@@ -141,6 +166,8 @@ static int session_manager(ParsedArgs::Ptr args)
 
 int main(int argc, char **argv)
 {
+    StartupTiming::Instance().Mark("main");
+
     SingleCommand argparser(argv[0], "OpenVPN 3 Session Manager",
                             session_manager);
     argparser.AddVersionOption();
@@ -152,9 +179,28 @@ int main(int argc, char **argv)
                         "Make the log lines colourful");
     argparser.AddOption("signal-broadcast", 0,
                         "Broadcast all D-Bus signals instead of targeted unicast");
+    argparser.AddOption("backend-peer-link", 0,
+                        "Use private D-Bus connections to the VPN backend processes");
+    argparser.AddOption("ignore-sleep", 0,
+                        "Do not pause VPN sessions when the system goes to sleep");
+    argparser.AddOption("remote-backoff", 0,
+                        "Share the health of the remote servers between "
+                        "the sessions, to back off from failing servers "
+                        "together");
+    argparser.AddOption("max-connects", "COUNT", true,
+                        "Maximum number of sessions connecting at the same "
+                        "time.  0 disables the limit (Default: 0)");
+    argparser.AddOption("connect-jitter", "MSECS", true,
+                        "Random delay of up to MSECS before a queued "
+                        "session connects (Default: 1000)");
+    argparser.AddOption("request-limit", "RATE", true,
+                        "Maximum D-Bus method calls per second and caller. "
+                        "0 disables the limit (Default: 200)");
     argparser.AddOption("idle-exit", "MINUTES", true,
                         "How long to wait before exiting if being idle. "
                         "0 disables it (Default: 3 minutes)");
+    argparser.AddOption("state-dir", 0, "DIRECTORY", true,
+                        "Directory where to record the running sessions");
 
     try
     {
@@ -32,6 +32,7 @@
 #include <memory>
 
 #include "dbus/core.hpp"
+#include "dbus/list-filter-args.hpp"
 #include "dbus/requiresqueue-proxy.hpp"
 #include "client/statistics.hpp"
 #include "client/statusevent.hpp"
@@ -103,7 +104,9 @@ public:
                                  "UserInputQueueGetTypeGroup",
                                  "UserInputQueueFetch",
                                  "UserInputQueueCheck",
-                                 "UserInputProvide")
+                                 "UserInputProvide",
+                                 "UserInputQueueFetchAll",
+                                 "UserInputProvideResponses")
     {
         // Only try to ensure the session manager service is available
         // when accessing the main management object
@@ -128,7 +131,9 @@ public:
                                  "UserInputQueueGetTypeGroup",
                                  "UserInputQueueFetch",
                                  "UserInputQueueCheck",
-                                 "UserInputProvide")
+                                 "UserInputProvide",
+                                 "UserInputQueueFetchAll",
+                                 "UserInputProvideResponses")
     {
         // Only try to ensure the session manager service is available
         // when accessing the main management object
@@ -345,23 +350,70 @@ public:
     ConnectionStats GetConnectionStats()
     {
         GVariant * statsprops = GetProperty("statistics");
-        GVariantIter * stats_ar = nullptr;
-        g_variant_get(statsprops, "a{sx}", &stats_ar);
-
-        ConnectionStats ret;
-        GVariant * r = nullptr;
-        while ((r = g_variant_iter_next_value(stats_ar)))
-        {
-            gchar *key = nullptr;
-            gint64 val;
-            g_variant_get(r, "{sx}", &key, &val);
-            ret.push_back(ConnectionStatDetails(std::string(key), val));
-            g_variant_unref(r);
-            g_free(key);
+        try
+        {
+            ConnectionStats ret = GLibUtils::Unmarshal<ConnectionStats>(statsprops);
+            g_variant_unref(statsprops);
+            return ret;
+        }
+        catch (const DBusException&)
+        {
+            g_variant_unref(statsprops);
+            throw;
         }
-        g_variant_iter_free(stats_ar);
-        g_variant_unref(statsprops);
+    }
 
+
+    /**
+     *  Retrieve the key table used by GetPackedConnectionStats().  This
+     *  key table does not change during the life time of a session.
+     *
+     * @param layout_id  uint32_t where the identifier of the key table
+     *                   is stored.  Key tables with the same identifier
+     *                   are identical.
+     *
+     * @return Returns a std::vector<std::string> of all statistics keys
+     */
+    std::vector<std::string> GetConnectionStatsLayout(uint32_t& layout_id)
+    {
+        GVariant *layout = GetProperty("statistics_layout");
+        try
+        {
+            auto res = GLibUtils::Unmarshal<std::tuple<uint32_t,
+                                            std::vector<std::string>>>(layout);
+            g_variant_unref(layout);
+            layout_id = std::get<0>(res);
+            return std::get<1>(res);
+        }
+        catch (const DBusException&)
+        {
+            g_variant_unref(layout);
+            throw;
+        }
+    }
+
+
+    /**
+     *  Retrieve all connection statistics counters as an array of values,
+     *  in the order given by GetConnectionStatsLayout().  This is a more
+     *  compact alternative to GetConnectionStats().
+     *
+     * @return Returns a std::vector<uint64_t> with all the counter values
+     */
+    std::vector<uint64_t> GetPackedConnectionStats()
+    {
+        GVariant *packed = GetProperty("statistics_packed");
+        if (!g_variant_is_of_type(packed, G_VARIANT_TYPE("at")))
+        {
+            g_variant_unref(packed);
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "Invalid packed statistics data type");
+        }
+        gsize n = 0;
+        const guint64 *values = static_cast<const guint64 *>(
+                        g_variant_get_fixed_array(packed, &n, sizeof(guint64)));
+        std::vector<uint64_t> ret(values, values + n);
+        g_variant_unref(packed);
         return ret;
     }
 
@@ -425,6 +477,40 @@ public:
     }
 
 
+    /**
+     * Grant all members of a group access to this session
+     *
+     * @param gid  gid_t value of the group which will be granted access
+     */
+    void AccessGrantGroup(gid_t gid)
+    {
+        GVariant *res = Call("AccessGrantGroup", g_variant_new("(u)", gid));
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "AccessGrantGroup() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     * Revoke the access from a group for this session
+     *
+     * @param gid  gid_t value of the group which will get access revoked
+     */
+    void AccessRevokeGroup(gid_t gid)
+    {
+        GVariant *res = Call("AccessRevokeGroup", g_variant_new("(u)", gid));
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "AccessRevokeGroup() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
     /**
      *  Enable/Disable the LogEvent forwarding from the client backend
      *
@@ -442,6 +528,185 @@ public:
     }
 
 
+    /**
+     *  Enable the LogEvent forwarding from the client backend, where
+     *  log events are sent in batches as LogBatch signals.  The
+     *  forwarding is disabled by calling LogForward(false).
+     *
+     * @param max_events   Maximum number of log events per LogBatch signal
+     * @param interval_ms  Maximum time, in milliseconds, a log event is
+     *                     held back before it is sent
+     */
+    void LogForwardBatch(const unsigned int max_events,
+                         const unsigned int interval_ms)
+    {
+        GVariant *res = Call("LogForwardBatch",
+                             g_variant_new("(uu)", max_events, interval_ms),
+                             false);
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "LogForwardBatch() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     *  Enable the LogEvent forwarding from the client backend, where
+     *  log events and status changes are sent as LogCompact signals.
+     *  The forwarding is disabled by calling LogForward(false).
+     *
+     *  Older session manager versions do not support this; a
+     *  DBusException is thrown and LogForward() or LogForwardBatch()
+     *  can be used instead.
+     *
+     * @param max_events   Maximum number of log events per LogCompact
+     *                     signal.  0 sends each log event separately.
+     * @param interval_ms  Maximum time, in milliseconds, a log event is
+     *                     held back before it is sent
+     */
+    void LogForwardCompact(const unsigned int max_events,
+                           const unsigned int interval_ms)
+    {
+        GVariant *res = Call("LogForwardCompact",
+                             g_variant_new("(uu)", max_events, interval_ms),
+                             false);
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "LogForwardCompact() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     *  Subscribe to the Statistics signal of this session.  The signal
+     *  carries the same counters as GetPackedConnectionStats() and is
+     *  only sent to subscribers, at most once per interval and only
+     *  when the counters have changed.
+     *
+     * @param interval_ms  Requested signal interval in milliseconds.
+     *                     0 removes the subscription.
+     */
+    void StatisticsSubscribe(uint32_t interval_ms)
+    {
+        GVariant *res = Call("StatisticsSubscribe",
+                             g_variant_new("(u)", interval_ms), false);
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "StatisticsSubscribe() call failed");
+        }
+        g_variant_unref(res);
+    }
+
+
+    /**
+     *  Retrieve the most recent log events kept by the VPN backend of
+     *  this session.  The backend keeps these log events regardless of
+     *  the log verbosity of the session.
+     *
+     * @param max_events  Maximum number of log events to retrieve.  0
+     *                    retrieves all available log events.
+     *
+     * @return Returns a std::vector of LogEvent objects, oldest first
+     */
+    std::vector<LogEvent> FetchLogHistory(const uint32_t max_events)
+    {
+        GVariant *res = Call("FetchLogHistory",
+                             g_variant_new("(u)", max_events));
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "FetchLogHistory() call failed");
+        }
+
+        GVariantIter *events = nullptr;
+        g_variant_get(res, "(aa{sv})", &events);
+
+        GVariant *ev = nullptr;
+        std::vector<LogEvent> ret;
+        while ((ev = g_variant_iter_next_value(events)))
+        {
+            ret.push_back(LogEvent(ev));
+            g_variant_unref(ev);
+        }
+        g_variant_iter_free(events);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
+    /**
+     *  Time series of key statistics counters, see GetStatsHistory()
+     */
+    struct StatsHistory
+    {
+        uint32_t step = 0;                 ///< Seconds between samples, at most
+        std::vector<std::string> keys;     ///< Counter names in each sample
+        std::vector<uint64_t> timestamps;  ///< Unix time of each sample
+        std::vector<uint64_t> values;      ///< keys.size() counters per timestamp
+    };
+
+
+    /**
+     *  Retrieve the key statistics counters the VPN backend of this
+     *  session recorded every second during the last hour.  The counters
+     *  are cumulative.
+     *
+     * @param since  Unix time; only samples taken after it are returned.
+     *               0 retrieves the complete history.
+     * @param step   Seconds between the returned samples; only the last
+     *               sample within each step is returned.
+     *
+     * @return Returns a StatsHistory object
+     */
+    StatsHistory GetStatsHistory(const uint64_t since, const uint32_t step)
+    {
+        GVariant *res = Call("GetStatsHistory",
+                             g_variant_new("(tu)", since, step));
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "GetStatsHistory() call failed");
+        }
+
+        StatsHistory ret;
+        std::tie(ret.step, ret.keys, ret.timestamps, ret.values) =
+            GLibUtils::Unmarshal<std::tuple<uint32_t,
+                                            std::vector<std::string>,
+                                            std::vector<uint64_t>,
+                                            std::vector<uint64_t>>>(res);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
+    /**
+     *  Makes the VPN backend of this session send the log events it
+     *  recorded, but did not send due to the log level, to the log
+     *  service.  Only the log events recorded since the previous dump
+     *  are sent.
+     *
+     * @return Returns the number of log events sent
+     */
+    uint32_t DumpLogHistory()
+    {
+        GVariant *res = Call("DumpLogHistory");
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "DumpLogHistory() call failed");
+        }
+        GLibUtils::checkParams(__func__, res, "(u)", 1);
+        uint32_t ret = GLibUtils::ExtractValue<uint32_t>(res, 0);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
     /**
      *  Retrieve the owner UID of this session object
      *
@@ -484,6 +749,37 @@ public:
     }
 
 
+    /**
+     *  Retrieve the group access control list for this object.  All
+     *  members of these groups are granted access.
+     *
+     * @return Returns an array of gid_t references for each group granted
+     *         access.
+     */
+    std::vector<gid_t> GetGroupAccessList()
+    {
+        GVariant *res = GetProperty("acl_groups");
+        if (NULL == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "GetGroupAccessList() call failed");
+        }
+        GVariantIter *acl = NULL;
+        g_variant_get(res, "au", &acl);
+
+        GVariant *gid = NULL;
+        std::vector<gid_t> ret;
+        while ((gid = g_variant_iter_next_value(acl)))
+        {
+            ret.push_back(g_variant_get_uint32(gid));
+            g_variant_unref(gid);
+        }
+        g_variant_unref(res);
+        g_variant_iter_free(acl);
+        return ret;
+    }
+
+
     /**
      *  Retrieve the network interface name used for this tunnel
      *
@@ -548,6 +844,79 @@ private:
 
 
 
+/**
+ *  Session details as returned by the session manager's
+ *  FetchSessionsDetailed method.  Fields not provided by the session
+ *  manager are left empty or zero; this is typically the case for
+ *  sessions where the backend process has not yet registered.
+ */
+struct SessionDetails
+{
+    SessionDetails(const std::string& p, GVariant *details)
+        : path(p)
+    {
+        GVariantIter iter;
+        g_variant_iter_init(&iter, details);
+        gchar *key = nullptr;
+        GVariant *value = nullptr;
+        while (g_variant_iter_next(&iter, "{sv}", &key, &value))
+        {
+            std::string k(key);
+            if ("config_path" == k)
+            {
+                config_path = std::string(g_variant_get_string(value, nullptr));
+            }
+            else if ("config_name" == k)
+            {
+                config_name = std::string(g_variant_get_string(value, nullptr));
+            }
+            else if ("session_name" == k)
+            {
+                session_name = std::string(g_variant_get_string(value, nullptr));
+            }
+            else if ("device_name" == k)
+            {
+                device_name = std::string(g_variant_get_string(value, nullptr));
+            }
+            else if ("owner" == k)
+            {
+                owner = g_variant_get_uint32(value);
+            }
+            else if ("backend_pid" == k)
+            {
+                backend_pid = g_variant_get_uint32(value);
+            }
+            else if ("session_created" == k)
+            {
+                session_created = g_variant_get_uint64(value);
+            }
+            else if ("dco" == k)
+            {
+                dco = g_variant_get_boolean(value);
+            }
+            else if ("status" == k)
+            {
+                status = StatusEvent(value);
+            }
+            g_variant_unref(value);
+            g_free(key);
+        }
+    }
+
+    std::string path;
+    std::string config_path;
+    std::string config_name;
+    std::string session_name;
+    std::string device_name;
+    uid_t owner = 0;
+    pid_t backend_pid = 0;
+    uint64_t session_created = 0;
+    bool dco = false;
+    StatusEvent status;
+};
+
+
+
 class OpenVPN3SessionMgrProxy : public DBusProxy
 {
 public:
@@ -620,7 +989,42 @@ public:
 
         OpenVPN3SessionProxy::Ptr session;
         session.reset(new OpenVPN3SessionProxy(G_BUS_TYPE_SYSTEM, path));
-        sleep(1);  // Allow session to be established (FIXME: Signals?)
+
+        // Allow session to be established.  The session manager sends a
+        // StatusChange signal once the backend process has registered,
+        // but this is only seen here if the session manager broadcasts
+        // signals.  So also probe the session object, which will not
+        // provide any properties until the registration has completed.
+        DBusSignalWaiter registered(GetConnection(),
+                                    OpenVPN3DBus_name_sessions,
+                                    OpenVPN3DBus_interf_sessions,
+                                    path, "StatusChange", "",
+                                    [](GVariant *params)
+                                    {
+                                        StatusEvent ev(params);
+                                        return ev.Check(StatusMajor::SESSION,
+                                                        StatusMinor::SESS_NEW)
+                                            || ev.Check(StatusMajor::SESSION,
+                                                        StatusMinor::PROC_STOPPED)
+                                            || ev.Check(StatusMajor::SESSION,
+                                                        StatusMinor::PROC_KILLED);
+                                    });
+        for (unsigned int attempts = 20; attempts > 0; --attempts)
+        {
+            try
+            {
+                (void) session->GetUInt64Property("session_created");
+                break;
+            }
+            catch (const DBusException&)
+            {
+                // Not registered yet
+            }
+            if (registered.Wait(250))
+            {
+                break;
+            }
+        }
         return session;
     }
 
@@ -675,6 +1079,84 @@ public:
     }
 
 
+    /**
+     *  Retrieves one page of the session paths available to the calling
+     *  user which match a filter
+     *
+     * @param filter  ListFilter with the criteria, the cursor returned
+     *                with the previous page and the page size
+     *
+     * @return Returns a ListFilter::Page with the session paths; its
+     *         next member is empty on the last page
+     */
+    ListFilter::Page FetchSessionsFiltered(const ListFilter& filter)
+    {
+        GVariant *res = Call("FetchSessionsFiltered", BuildListFilterArgs(filter));
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "Failed to retrieve available sessions");
+        }
+        return ParseListFilterReply(res);
+    }
+
+
+    /**
+     *  Retrieves one page of the virtual network devices of the
+     *  sessions available to the calling user which match a filter
+     *
+     * @param filter  ListFilter with the criteria, the cursor returned
+     *                with the previous page and the page size
+     *
+     * @return Returns a ListFilter::Page with the device names in its
+     *         paths member; its next member is empty on the last page
+     */
+    ListFilter::Page FetchManagedInterfacesFiltered(const ListFilter& filter)
+    {
+        GVariant *res = Call("FetchManagedInterfacesFiltered",
+                             BuildListFilterArgs(filter));
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "Failed to retrieve managed interfaces");
+        }
+        return ParseListFilterReply(res);
+    }
+
+
+    /**
+     *  Retrieve the details of all sessions available to the calling
+     *  user in a single call to the session manager
+     *
+     * @return  std::vector<SessionDetails> of all available sessions
+     */
+    std::vector<SessionDetails> FetchSessionsDetailed()
+    {
+        GVariant *res = Call("FetchSessionsDetailed");
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "Failed to retrieve session details");
+        }
+
+        GVariantIter *sessions = nullptr;
+        g_variant_get(res, "(a{oa{sv}})", &sessions);
+
+        std::vector<SessionDetails> ret;
+        gchar *path = nullptr;
+        GVariant *details = nullptr;
+        while (g_variant_iter_next(sessions, "{o@a{sv}}", &path, &details))
+        {
+            ret.push_back(SessionDetails(path, details));
+            g_variant_unref(details);
+            g_free(path);
+        }
+        g_variant_unref(res);
+        g_variant_iter_free(sessions);
+        return ret;
+    }
+
+
     std::vector<std::string> FetchManagedInterfaces()
     {
         GVariant *res = Call("FetchManagedInterfaces");
@@ -736,6 +1218,91 @@ public:
     }
 
 
+    /**
+     *  Disconnects all sessions the caller may manage at once.  This
+     *  returns when the backend processes of all these sessions have
+     *  exited.
+     *
+     * @param cfgname  std::string with a configuration profile name to
+     *                 only disconnect its sessions; empty for all sessions
+     * @param forced   If true, stop the backend processes abruptly
+     *
+     * @return Returns a std::vector<std::string> with the paths of the
+     *         sessions which were disconnected
+     */
+    std::vector<std::string> DisconnectAll(const std::string& cfgname = "",
+                                           const bool forced = false)
+    {
+        GVariant *res = Call("DisconnectAll",
+                             g_variant_new("(sb)", cfgname.c_str(), forced));
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "Failed to disconnect sessions");
+        }
+        GVariantIter *session_paths = nullptr;
+        g_variant_get(res, "(ao)", &session_paths);
+
+        GVariant *path = nullptr;
+        std::vector<std::string> ret;
+        while ((path = g_variant_iter_next_value(session_paths)))
+        {
+            ret.push_back(GLibUtils::GetVariantValue<std::string>(path));
+            g_variant_unref(path);
+        }
+        g_variant_unref(res);
+        g_variant_iter_free(session_paths);
+        return ret;
+    }
+
+
+    /**
+     *  Retrieves the status board of the caller, a shared memory table
+     *  with the status of all the sessions the caller has access to.
+     *  See SessionManager::StatusBoardReader to read it.
+     *
+     * @return Returns a read-only file descriptor to the status board.
+     *         The caller is responsible for closing it.
+     */
+    int GetStatusBoard()
+    {
+        int fd = -1;
+        GVariant *res = CallGetFD("GetStatusBoard", fd);
+        if (nullptr == res || fd < 0)
+        {
+            if (res)
+            {
+                g_variant_unref(res);
+            }
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "Failed to retrieve the status board");
+        }
+        g_variant_unref(res);
+        return fd;
+    }
+
+
+    /**
+     *  Subscribe to the SessionManagerEvent signals.  The session manager
+     *  only sends these signals to subscribers, and only for the sessions
+     *  the subscriber has access to.  The subscription is removed when
+     *  the caller disconnects from the D-Bus.
+     *
+     * @param subscribe  true to subscribe, false to unsubscribe
+     */
+    void EventSubscribe(bool subscribe = true)
+    {
+        GVariant *res = Call((subscribe ? "EventSubscribe" : "EventUnsubscribe"),
+                             false);
+        if (nullptr == res)
+        {
+            THROW_DBUSEXCEPTION("OpenVPN3SessionProxy",
+                                "SessionManagerEvent subscription failed");
+        }
+        g_variant_unref(res);
+    }
+
+
     /**
      *  Lookup the session path for a specific interface name.
      *
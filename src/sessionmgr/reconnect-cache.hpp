@@ -0,0 +1,177 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   reconnect-cache.hpp
+ *
+ * @brief  Keeps the reconnect state of the last established connection
+ *         of each configuration profile, to be handed to the next backend
+ *         process started for it
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <sys/types.h>
+
+
+/**
+ *  When a VPN backend process dies, everything it learnt while connecting
+ *  is lost: which remote server worked and the auth-token the server
+ *  pushed.  The session manager retrieves this reconnect state from the
+ *  backend each time the connection is established and keeps it here,
+ *  indexed by the owner and the configuration profile.  The next session
+ *  the same user starts with the same profile takes it over, so its
+ *  backend can go straight to the known working server and authenticate
+ *  without asking the user.
+ *
+ *  An entry is handed out only once and expires after a while.  Entries
+ *  of sessions the user disconnected on purpose are removed.
+ *
+ *  All methods are thread-safe.
+ */
+class ReconnectCache
+{
+public:
+    using Ptr = std::shared_ptr<ReconnectCache>;
+    using Clock = std::chrono::steady_clock;
+
+    /// Reconnect state as provided by the backend process
+    using State = std::map<std::string, std::string>;
+
+
+    /**
+     * @param max_age  How long an entry is kept
+     */
+    ReconnectCache(std::chrono::seconds max_age = std::chrono::hours(1))
+        : max_age(max_age)
+    {
+    }
+
+
+    /**
+     *  Stores or replaces the reconnect state of a profile.  An empty
+     *  state removes the entry.
+     *
+     * @param owner        uid of the session owner
+     * @param config_path  D-Bus path of the configuration profile
+     * @param state        State to store
+     * @param now          Current time
+     */
+    void Store(uid_t owner, const std::string& config_path, State state,
+               Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        expire(now);
+        Key key(owner, config_path);
+        if (state.empty())
+        {
+            entries.erase(key);
+            return;
+        }
+        Entry& e = entries[key];
+        e.state = std::move(state);
+        e.stored = now;
+    }
+
+
+    /**
+     *  Takes the reconnect state of a profile out of the cache
+     *
+     * @param owner        uid of the session owner
+     * @param config_path  D-Bus path of the configuration profile
+     * @param now          Current time
+     *
+     * @return Returns the State, which is empty if none or only an
+     *         expired one was found
+     */
+    State Take(uid_t owner, const std::string& config_path,
+               Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        expire(now);
+        auto it = entries.find(Key(owner, config_path));
+        if (entries.end() == it)
+        {
+            return {};
+        }
+        State ret = std::move(it->second.state);
+        entries.erase(it);
+        return ret;
+    }
+
+
+    /**
+     *  Removes the reconnect state of a profile
+     *
+     * @param owner        uid of the session owner
+     * @param config_path  D-Bus path of the configuration profile
+     */
+    void Forget(uid_t owner, const std::string& config_path)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        entries.erase(Key(owner, config_path));
+    }
+
+
+    /**
+     * @return Returns the number of entries, including expired ones
+     *         not yet removed
+     */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return entries.size();
+    }
+
+
+private:
+    using Key = std::pair<uid_t, std::string>;
+
+    struct Entry
+    {
+        State state;
+        Clock::time_point stored;
+    };
+
+    const std::chrono::seconds max_age;
+    mutable std::mutex mtx;
+    std::map<Key, Entry> entries;
+
+
+    void expire(Clock::time_point now)
+    {
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            if (now - it->second.stored > max_age)
+            {
+                it = entries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+};
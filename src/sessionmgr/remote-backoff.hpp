@@ -0,0 +1,234 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   remote-backoff.hpp
+ *
+ * @brief  Keeps the health of the remote servers as seen by all the
+ *         VPN sessions, so they back off from a failing server together
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+
+/**
+ *  Without shared state, each backend process retries a failing server
+ *  on its own, and when the server is back all of them hit it at the
+ *  same time.  The backends report the outcome of each connection
+ *  attempt to a remote to the session manager, which keeps it here.
+ *
+ *  The first failure of a remote starts a backoff period, which doubles
+ *  with each failure up to a maximum.  Failures reported while a remote
+ *  is already backing off are the same outage seen by other sessions and
+ *  do not extend it.  When the backoff period has passed or a session
+ *  managed to connect, the sessions are let through one by one, each
+ *  slot a pace interval after the previous one, so the first attempt
+ *  probes the server before the others follow.
+ *
+ *  Remotes are identified by an opaque string provided by the backends.
+ *
+ *  All methods are thread-safe.
+ */
+class RemoteBackoff
+{
+public:
+    using Ptr = std::shared_ptr<RemoteBackoff>;
+    using Clock = std::chrono::steady_clock;
+
+    /// How long each remote should be held back, indexed by remote
+    using Delays = std::map<std::string, std::chrono::milliseconds>;
+
+    /// Health of a remote, see GetState()
+    struct Info
+    {
+        unsigned int failures = 0;                ///< Consecutive failures
+        std::chrono::milliseconds remaining{0};   ///< Remaining backoff
+    };
+
+
+    /**
+     * @param initial  Backoff period after the first failure
+     * @param maximum  Upper limit of the backoff period
+     * @param pace     Interval between the sessions let through when
+     *                 the backoff period is over
+     * @param max_age  How long a remote is kept after its backoff
+     *                 period is over
+     */
+    RemoteBackoff(std::chrono::milliseconds initial = std::chrono::seconds(5),
+                  std::chrono::milliseconds maximum = std::chrono::minutes(5),
+                  std::chrono::milliseconds pace = std::chrono::milliseconds(200),
+                  std::chrono::seconds max_age = std::chrono::minutes(10))
+        : initial(initial), maximum(maximum), pace(pace), max_age(max_age)
+    {
+    }
+
+
+    /**
+     *  Records a failed connection attempt to a remote
+     *
+     * @param remote  Remote the attempt was made to
+     * @param now     Current time
+     *
+     * @return Returns true if a new backoff period was started, which
+     *         should be sent to the backends
+     */
+    bool Failed(const std::string& remote, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        expire(now);
+        Entry& e = entries[remote];
+        if (e.failures > 0 && now < e.until)
+        {
+            return false;
+        }
+        ++e.failures;
+
+        std::chrono::milliseconds period = initial;
+        for (unsigned int i = 1; i < e.failures && period < maximum; ++i)
+        {
+            period *= 2;
+        }
+        e.until = now + std::min(period, maximum);
+        return true;
+    }
+
+
+    /**
+     *  Records an established connection to a remote
+     *
+     * @param remote  Remote the connection was established to
+     * @param now     Current time
+     *
+     * @return Returns true if this ended the backoff of the remote,
+     *         which should be sent to the backends
+     */
+    bool Succeeded(const std::string& remote, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        expire(now);
+        auto it = entries.find(remote);
+        if (entries.end() == it || 0 == it->second.failures)
+        {
+            return false;
+        }
+        it->second.failures = 0;
+        it->second.until = std::min(it->second.until, now);
+        return true;
+    }
+
+
+    /**
+     *  Calculates how long a session should hold back each remote.  The
+     *  remotes which are backing off or just recovered are included.
+     *
+     * @param slot  Position of the session in the order the sessions are
+     *              let through when the backoff period is over
+     * @param now   Current time
+     *
+     * @return Returns the Delays for the session
+     */
+    Delays Get(unsigned int slot, Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        expire(now);
+        Delays ret;
+        const auto offset = pace * slot;
+        for (const auto& e : entries)
+        {
+            auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(e.second.until - now)
+                         + offset;
+            if (delay.count() > 0)
+            {
+                ret[e.first] = delay;
+            }
+        }
+        return ret;
+    }
+
+
+    /**
+     * @param now  Current time
+     *
+     * @return Returns the Info of all the remotes currently known
+     */
+    std::map<std::string, Info> GetState(Clock::time_point now = Clock::now())
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        expire(now);
+        std::map<std::string, Info> ret;
+        for (const auto& e : entries)
+        {
+            Info& i = ret[e.first];
+            i.failures = e.second.failures;
+            if (e.second.until > now)
+            {
+                i.remaining = std::chrono::duration_cast<std::chrono::milliseconds>(e.second.until - now);
+            }
+        }
+        return ret;
+    }
+
+
+    /**
+     * @return Returns the number of remotes, including expired ones not
+     *         yet removed
+     */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return entries.size();
+    }
+
+
+private:
+    struct Entry
+    {
+        unsigned int failures = 0;
+        Clock::time_point until;
+    };
+
+    const std::chrono::milliseconds initial;
+    const std::chrono::milliseconds maximum;
+    const std::chrono::milliseconds pace;
+    const std::chrono::seconds max_age;
+    mutable std::mutex mtx;
+    std::map<std::string, Entry> entries;
+
+
+    void expire(Clock::time_point now)
+    {
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            if (now - it->second.until > max_age)
+            {
+                it = entries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+};
@@ -0,0 +1,284 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   session-registry.hpp
+ *
+ * @brief  Indexed registry of the session objects in the session manager
+ */
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+/**
+ *  Keeps track of all session objects by their D-Bus object path, with
+ *  secondary indexes on the backend registration token, the
+ *  configuration profile name and the virtual network device name.
+ *
+ *  The configuration name and device name are not known when a session
+ *  is added; they are provided via Update() once the session knows them.
+ *  A device name is only indexed for one session at a time; the last
+ *  session reporting a device name owns it.
+ *
+ *  All methods are thread-safe.  Lookups return copies of the matching
+ *  entries, so the lock is only held while the indexes are accessed.
+ *  The registry does not own the objects.
+ *
+ * @tparam T  Session object class
+ */
+template <class T>
+class SessionRegistry
+{
+public:
+    using Item = std::pair<std::string, T *>;
+    using ItemList = std::vector<Item>;
+
+
+    /**
+     *  Add a new session
+     *
+     * @param path   std::string with the D-Bus object path of the session
+     * @param obj    Pointer to the session object
+     * @param token  std::string with the backend registration token
+     */
+    void Add(const std::string& path, T *obj, const std::string& token)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        Entry& e = sessions[path];
+        e.obj = obj;
+        e.token = token;
+        if (!token.empty())
+        {
+            by_token[token] = path;
+        }
+    }
+
+
+    /**
+     *  Remove a session and all its index entries
+     *
+     * @param path  std::string with the D-Bus object path of the session
+     *
+     * @return Returns the session object pointer, nullptr if not found
+     */
+    T * Remove(const std::string& path)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = sessions.find(path);
+        if (sessions.end() == it)
+        {
+            return nullptr;
+        }
+        T *obj = it->second.obj;
+        by_token.erase(it->second.token);
+        unindex_config_name(path, it->second.config_name);
+        unindex_device_name(path, it->second.device_name);
+        sessions.erase(it);
+        return obj;
+    }
+
+
+    /**
+     *  Update the configuration name and device name indexes of a session
+     *
+     * @param path         std::string with the D-Bus object path
+     * @param config_name  std::string with the configuration profile name,
+     *                     empty if not known
+     * @param device_name  std::string with the device name, empty if the
+     *                     session has no device
+     */
+    void Update(const std::string& path,
+                const std::string& config_name,
+                const std::string& device_name)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = sessions.find(path);
+        if (sessions.end() == it)
+        {
+            return;
+        }
+        Entry& e = it->second;
+
+        if (e.config_name != config_name)
+        {
+            unindex_config_name(path, e.config_name);
+            e.config_name = config_name;
+            if (!config_name.empty())
+            {
+                by_config_name.emplace(config_name, path);
+            }
+        }
+
+        if (e.device_name != device_name)
+        {
+            unindex_device_name(path, e.device_name);
+            e.device_name = device_name;
+        }
+        if (!device_name.empty())
+        {
+            by_device_name[device_name] = path;
+        }
+    }
+
+
+    /**
+     *  Retrieve a session object by its D-Bus object path
+     *
+     * @return Returns the session object pointer, nullptr if not found
+     */
+    T * Get(const std::string& path) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto it = sessions.find(path);
+        return (sessions.end() != it ? it->second.obj : nullptr);
+    }
+
+
+    /**
+     *  Retrieve a session by its backend registration token
+     *
+     * @return Returns the session object pointer, nullptr if not found
+     */
+    T * GetByToken(const std::string& token) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto t = by_token.find(token);
+        if (by_token.end() == t)
+        {
+            return nullptr;
+        }
+        auto it = sessions.find(t->second);
+        return (sessions.end() != it ? it->second.obj : nullptr);
+    }
+
+
+    /**
+     *  Retrieve the session using a device
+     *
+     * @return Returns an Item with the D-Bus object path and the session
+     *         object; the object pointer is nullptr if not found
+     */
+    Item GetByDeviceName(const std::string& device_name) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        auto d = by_device_name.find(device_name);
+        if (by_device_name.end() == d)
+        {
+            return Item("", nullptr);
+        }
+        auto it = sessions.find(d->second);
+        if (sessions.end() == it)
+        {
+            return Item("", nullptr);
+        }
+        return Item(it->first, it->second.obj);
+    }
+
+
+    /**
+     *  Retrieve all sessions started with a configuration profile name
+     */
+    ItemList GetByConfigName(const std::string& config_name) const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        ItemList ret;
+        auto range = by_config_name.equal_range(config_name);
+        for (auto c = range.first; c != range.second; ++c)
+        {
+            auto it = sessions.find(c->second);
+            if (sessions.end() != it)
+            {
+                ret.emplace_back(it->first, it->second.obj);
+            }
+        }
+        return ret;
+    }
+
+
+    /**
+     *  Retrieve all sessions
+     */
+    ItemList GetAll() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        ItemList ret;
+        ret.reserve(sessions.size());
+        for (const auto& s : sessions)
+        {
+            ret.emplace_back(s.first, s.second.obj);
+        }
+        return ret;
+    }
+
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return sessions.size();
+    }
+
+
+private:
+    struct Entry
+    {
+        T *obj = nullptr;
+        std::string token;
+        std::string config_name;
+        std::string device_name;
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Entry> sessions;
+    std::unordered_map<std::string, std::string> by_token;
+    std::unordered_multimap<std::string, std::string> by_config_name;
+    std::unordered_map<std::string, std::string> by_device_name;
+
+
+    void unindex_config_name(const std::string& path,
+                             const std::string& config_name)
+    {
+        auto range = by_config_name.equal_range(config_name);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == path)
+            {
+                by_config_name.erase(it);
+                return;
+            }
+        }
+    }
+
+
+    void unindex_device_name(const std::string& path,
+                             const std::string& device_name)
+    {
+        // Another session may have taken over the device name
+        auto it = by_device_name.find(device_name);
+        if (by_device_name.end() != it && it->second == path)
+        {
+            by_device_name.erase(it);
+        }
+    }
+};
@@ -0,0 +1,283 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   session-store.hpp
+ *
+ * @brief  Compact record of the running sessions, used by a restarted
+ *         session manager to take over the VPN backend processes
+ */
+
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <json/json.h>
+
+#include "common/boot-id.hpp"
+
+
+/**
+ *  The VPN backend processes are independent of the session manager;
+ *  they keep the tunnels up if the session manager exits unexpectedly.
+ *  To be able to manage them again, the session manager records what it
+ *  needs to know about each registered session here and writes it to a
+ *  file each time something changes.  A restarted session manager loads
+ *  the file and takes over the backends which are still running.
+ *
+ *  The file carries the boot ID of the kernel, so sessions recorded
+ *  before the host was rebooted are never taken over; the bus names and
+ *  PIDs of the backends may have been reused.
+ *
+ *  All methods are thread-safe.
+ */
+class SessionStore
+{
+public:
+    /// Bumped when the file format changes incompatibly
+    static const int Version = 1;
+
+    /**
+     *  What is recorded about each session
+     */
+    struct Entry
+    {
+        std::string session_path;
+        std::string backend_busname;
+        std::string backend_path;
+        std::string backend_token;
+        pid_t backend_pid = 0;
+        uid_t owner = 0;
+        std::vector<uid_t> acl;
+        std::vector<gid_t> acl_groups;
+        bool public_access = false;
+        bool restrict_log_access = true;
+        std::string config_path;
+        std::string config_name;
+        std::time_t created = 0;
+        std::string device_name;
+        std::string bundle_id;
+        unsigned int bundle_index = 0;
+        unsigned int bundle_size = 0;
+
+
+        Json::Value Export() const
+        {
+            Json::Value ret;
+            ret["backend_busname"] = backend_busname;
+            ret["backend_path"] = backend_path;
+            ret["backend_token"] = backend_token;
+            ret["backend_pid"] = (Json::Int) backend_pid;
+            ret["owner"] = (Json::UInt) owner;
+            ret["acl"] = Json::Value(Json::arrayValue);
+            for (const auto& uid : acl)
+            {
+                ret["acl"].append((Json::UInt) uid);
+            }
+            ret["acl_groups"] = Json::Value(Json::arrayValue);
+            for (const auto& gid : acl_groups)
+            {
+                ret["acl_groups"].append((Json::UInt) gid);
+            }
+            ret["public_access"] = public_access;
+            ret["restrict_log_access"] = restrict_log_access;
+            ret["config_path"] = config_path;
+            ret["config_name"] = config_name;
+            ret["created"] = (Json::Int64) created;
+            if (!device_name.empty())
+            {
+                ret["device_name"] = device_name;
+            }
+            if (!bundle_id.empty())
+            {
+                ret["bundle_id"] = bundle_id;
+                ret["bundle_index"] = bundle_index;
+                ret["bundle_size"] = bundle_size;
+            }
+            return ret;
+        }
+
+
+        static Entry Import(const std::string& path, const Json::Value& data)
+        {
+            Entry e;
+            e.session_path = path;
+            e.backend_busname = data["backend_busname"].asString();
+            e.backend_path = data["backend_path"].asString();
+            e.backend_token = data["backend_token"].asString();
+            e.backend_pid = (pid_t) data["backend_pid"].asInt();
+            e.owner = (uid_t) data["owner"].asUInt();
+            for (const auto& uid : data["acl"])
+            {
+                e.acl.push_back((uid_t) uid.asUInt());
+            }
+            for (const auto& gid : data["acl_groups"])
+            {
+                e.acl_groups.push_back((gid_t) gid.asUInt());
+            }
+            e.public_access = data["public_access"].asBool();
+            e.restrict_log_access = data.get("restrict_log_access", true).asBool();
+            e.config_path = data["config_path"].asString();
+            e.config_name = data["config_name"].asString();
+            e.created = (std::time_t) data["created"].asInt64();
+            e.device_name = data["device_name"].asString();
+            e.bundle_id = data["bundle_id"].asString();
+            e.bundle_index = data["bundle_index"].asUInt();
+            e.bundle_size = data["bundle_size"].asUInt();
+            return e;
+        }
+    };
+
+
+    /**
+     * @param boot_id  std::string identifying the current boot of the
+     *                 host, see get_boot_id()
+     */
+    SessionStore(const std::string& boot_id = get_boot_id())
+        : boot_id(boot_id)
+    {
+    }
+
+
+    /**
+     *  Adds or replaces the record of a session
+     *
+     * @param entry  Entry to record
+     */
+    void Set(const Entry& entry)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        entries[entry.session_path] = entry;
+    }
+
+
+    /**
+     *  Removes the record of a session
+     *
+     * @param session_path  std::string with the D-Bus path of the session
+     *
+     * @return Returns true if the session was recorded
+     */
+    bool Remove(const std::string& session_path)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return entries.erase(session_path) > 0;
+    }
+
+
+    /**
+     * @return Returns a copy of all the recorded sessions
+     */
+    std::vector<Entry> GetAll() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        std::vector<Entry> ret;
+        for (const auto& e : entries)
+        {
+            ret.push_back(e.second);
+        }
+        return ret;
+    }
+
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return entries.size();
+    }
+
+
+    /**
+     * @return Returns all the recorded sessions as compact JSON
+     */
+    std::string Serialize() const
+    {
+        Json::Value data;
+        data["version"] = Version;
+        data["boot_id"] = boot_id;
+        data["sessions"] = Json::Value(Json::objectValue);
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            for (const auto& e : entries)
+            {
+                data["sessions"][e.first] = e.second.Export();
+            }
+        }
+
+        Json::StreamWriterBuilder wr;
+        wr["indentation"] = "";
+        return Json::writeString(wr, data);
+    }
+
+
+    /**
+     *  Replaces the recorded sessions with the ones in a file written
+     *  from Serialize().  Data from another boot of the host, of another
+     *  format version or which cannot be parsed results in an empty
+     *  store.
+     *
+     * @param content  std::string with the JSON data
+     *
+     * @return Returns the number of sessions loaded
+     */
+    size_t Parse(const std::string& content)
+    {
+        Json::Value data;
+        Json::CharReaderBuilder rd;
+        std::string errors;
+        std::istringstream in(content);
+
+        std::lock_guard<std::mutex> guard(mtx);
+        entries.clear();
+        if (!Json::parseFromStream(rd, in, &data, &errors)
+            || !data.isObject()
+            || data["version"].asInt() != Version
+            || data["boot_id"].asString() != boot_id
+            || !data["sessions"].isObject())
+        {
+            return 0;
+        }
+
+        for (const auto& path : data["sessions"].getMemberNames())
+        {
+            const Json::Value& s = data["sessions"][path];
+            if (!s.isObject())
+            {
+                continue;
+            }
+            Entry e = Entry::Import(path, s);
+            if (!e.backend_busname.empty() && !e.backend_path.empty())
+            {
+                entries[path] = e;
+            }
+        }
+        return entries.size();
+    }
+
+
+private:
+    mutable std::mutex mtx;
+    const std::string boot_id;
+    std::map<std::string, Entry> entries;
+};
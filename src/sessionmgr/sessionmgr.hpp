@@ -33,22 +33,42 @@
 #ifndef OPENVPN3_DBUS_SESSIONMGR_HPP
 #define OPENVPN3_DBUS_SESSIONMGR_HPP
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <cstring>
+#include <deque>
+#include <fstream>
 #include <functional>
 #include <ctime>
+#include <map>
 #include <memory>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
 
 #include <openvpn/common/likely.hpp>
 #include <openvpn/log/logsimple.hpp>
 
+#include "common/connect-timing.hpp"
 #include "common/core-extensions.hpp"
 #include "common/lookup.hpp"
 #include "common/requiresqueue.hpp"
 #include "common/utils.hpp"
 #include "dbus/core.hpp"
 #include "dbus/connection-creds.hpp"
+#include "dbus/object-handle.hpp"
+#include "dbus/object-manager.hpp"
+#include "dbus/object-property.hpp"
 #include "dbus/glibutils.hpp"
+#include "dbus/list-filter-args.hpp"
 #include "dbus/path.hpp"
+#include "dbus/peer-link.hpp"
+#include "dbus/readiness.hpp"
+#include "dbus/resource-usage.hpp"
+#include "dbus/signal-router.hpp"
 #include "log/dbus-log.hpp"
 #include "log/logwriter.hpp"
 #include "log/proxy-log.hpp"
@@ -56,6 +76,14 @@
 #include "configmgr/proxy-configmgr.hpp"
 #include "sessionmgr-exceptions.hpp"
 #include "sessionmgr-events.hpp"
+#include "config-cache.hpp"
+#include "connect-admission.hpp"
+#include "reconnect-cache.hpp"
+#include "remote-backoff.hpp"
+#include "session-registry.hpp"
+#include "session-store.hpp"
+#include "sleep-monitor.hpp"
+#include "status-board.hpp"
 
 using namespace openvpn;
 
@@ -173,8 +201,7 @@ private:
  *  StatusChange signals from a VPN client backend process to any front-end
  *  processes subscribed to these signals.
  */
-class SessionStatusChange : public DBusSignalSubscription,
-                            public DBusSignalProducer
+class SessionStatusChange : public DBusSignalProducer
 {
 public:
     /**
@@ -187,59 +214,70 @@ public:
      *                           signals will not be proxied further.
      * @param interface          D-Bus interface to use for the signal
      *                           subscription
+     * @param backend_path       D-Bus object path of the session in the
+     *                           backend process.  A backend process may
+     *                           host several sessions, each with its own
+     *                           object path.
      * @param session_path       D-Bus path to the session to retrieve
      *                           StatusChange events from and proxy forward as
      */
     SessionStatusChange(GDBusConnection *conn,
                         std::string bus_name,
                         std::string interface,
+                        std::string backend_path,
                         std::string session_path)
-        : DBusSignalSubscription(conn, bus_name, interface,
-                                 OpenVPN3DBus_rootp_backends_session,
-                                 "StatusChange"),
-          DBusSignalProducer(conn, "", OpenVPN3DBus_interf_sessions,
+        : DBusSignalProducer(conn, "", OpenVPN3DBus_interf_sessions,
                              session_path),
           backend_busname(bus_name),
           last_status()
     {
+        // The router only delivers signals where the sender is the
+        // unique bus name of the backend this object belongs to
+        router = DBusSignalRouter::Get(conn);
+        handler_id = router->AddHandler(interface, backend_busname,
+                                        backend_path,
+                                        "StatusChange",
+                                        [this](const DBusSignalEvent& ev)
+                                        {
+                                            ProxyStatus(ev.params);
+                                        });
     }
 
-    /**
-     *  Callback function used by the D-Bus library whenever a signal we are
-     *  subscribed to occurs.
-     *
-     * @param connection       D-Bus connection where the signal happened
-     * @param sender_name      D-Bus bus name of the sender of the signal
-     * @param object_path      D-Bus object path where the signal came from
-     * @param interface_name   D-Bus interface of the signal
-     * @param signal_name      The name of the signal which was sent
-     * @param parameters       Pointer to a GVariant GLib2 object containing
-     *                         the variables and values the signal carries
-     */
-    void callback_signal_handler(GDBusConnection *connection,
-                                 const std::string sender,
-                                 const std::string object_path,
-                                 const std::string interface_name,
-                                 const std::string signal_name,
-                                 GVariant *parameters)
+
+    ~SessionStatusChange()
     {
-        //
-        // Check if this signal matches the session we're managing
-        // Since the sender bus name is the unique bus name,
-        // bus name, backend_busname must contain the unique bus
-        // name as well of the backend this object belongs to.
-        //
-        if (sender != backend_busname)
+        router->RemoveHandler(handler_id);
+        for (const auto& src : extra_sources)
         {
-            // Sender did not match our requirements, ignore it
-            return;
+            src.first->RemoveHandler(src.second);
         }
+    }
 
-        // Signals we proxy further, ignore the rest
-        if (signal_name == "StatusChange")
-        {
-            ProxyStatus(parameters);
-        }
+
+    /**
+     *  Receives StatusChange signals from the backend over an additional
+     *  connection, used for the private peer link to the backend.  Peer
+     *  connections carry no sender, so signals are matched on the
+     *  interface and object path only.
+     *
+     * @param peer_conn     GDBusConnection of the peer link
+     * @param interface     D-Bus interface of the backend signals
+     * @param backend_path  D-Bus object path of the session in the
+     *                      backend process
+     */
+    void AddSignalSource(GDBusConnection *peer_conn,
+                         const std::string& interface,
+                         const std::string& backend_path)
+    {
+        DBusSignalRouter::Ptr r = DBusSignalRouter::Get(peer_conn);
+        DBusSignalRouter::HandlerId id = r->AddHandler(interface, "",
+                                                       backend_path,
+                                                       "StatusChange",
+                                                       [this](const DBusSignalEvent& ev)
+                                                       {
+                                                           ProxyStatus(ev.params);
+                                                       });
+        extra_sources.push_back(std::make_pair(r, id));
     }
 
 
@@ -254,12 +292,77 @@ public:
         {
             last_status = s;
         }
+        ++status_seq;
+        history.push_back(std::make_pair(status_seq, s));
+        if (history.size() > status_history_size)
+        {
+            history.pop_front();
+        }
 
-        // Proxy this mesage via DBusSignalProducer
+        // Proxy this mesage via DBusSignalProducer.  This is the only
+        // emission of the status change; the log service and the
+        // front-ends all receive this one.
         Send("StatusChange", status);
     }
 
 
+    /**
+     *  Retrieve the sequence number of the last status change emitted.
+     *  It is increased by one for each StatusChange signal, starting
+     *  at 1 for the first one.
+     *
+     * @return Returns the sequence number, 0 if no status change has been
+     *         emitted yet
+     */
+    guint64 GetStatusSequence() const noexcept
+    {
+        return status_seq;
+    }
+
+
+    /**
+     *  Retrieve the status changes emitted after a given sequence number.
+     *  Only the last status_history_size status changes are kept; if
+     *  older ones are requested, the returned list starts with the oldest
+     *  status change still available.
+     *
+     * @param seq  Sequence number of the last status change the caller
+     *             has seen.  0 returns all the kept status changes.
+     *
+     * @return Returns a GVariant tuple (ta(tuus)) with the current
+     *         sequence number and an array of the newer status changes,
+     *         each as (sequence, major, minor, message), oldest first.
+     */
+    GVariant * GetStatusSince(const guint64 seq) const
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a(tuus)"));
+        for (const auto& h : history)
+        {
+            if (h.first <= seq)
+            {
+                continue;
+            }
+            g_variant_builder_add(bld, "(tuus)", h.first,
+                                  (guint32) h.second.major,
+                                  (guint32) h.second.minor,
+                                  h.second.message.c_str());
+        }
+        GVariant *ret = g_variant_new("(ta(tuus))", status_seq, bld);
+        g_variant_builder_unref(bld);
+        return ret;
+    }
+
+
+    /**
+     * @return Returns the major status code of the last status change,
+     *         StatusMajor::UNSET if none has been processed yet
+     */
+    StatusMajor GetLastStatusMajor() const noexcept
+    {
+        return last_status.major;
+    }
+
+
     /**
      *  Retrieve the last status message processed
      *
@@ -297,9 +400,27 @@ public:
         return last_status == chk;
     }
 
+
+    /**
+     * @return Returns the number of status changes kept for
+     *         GetStatusSince()
+     */
+    size_t HistorySize() const noexcept
+    {
+        return history.size();
+    }
+
 private:
     std::string backend_busname;
+    DBusSignalRouter::Ptr router;
+    DBusSignalRouter::HandlerId handler_id = 0;
+    std::vector<std::pair<DBusSignalRouter::Ptr, DBusSignalRouter::HandlerId>> extra_sources;
     StatusEvent last_status;
+    guint64 status_seq = 0;
+    std::deque<std::pair<guint64, StatusEvent>> history;
+
+    /// Number of status changes kept for GetStatusSince()
+    static const size_t status_history_size = 64;
 };
 
 
@@ -310,17 +431,47 @@ enum class DCOstatus : unsigned short {
 };
 
 
-class SessionLogProxy : public LogServiceProxy
+/**
+ *  Log forwarding of a single session to a single receiver.  The log
+ *  service is called directly via a DBusObjectHandle on the shared
+ *  connection, as setting up a full LogServiceProxy per forwarding
+ *  request is costly with many sessions.
+ *
+ *  A receiver attached to several sessions shares a single log proxy
+ *  in the log service, so only this session is removed from it when
+ *  the forwarding stops.
+ */
+class SessionLogProxy
 {
 public:
     using Ptr = std::shared_ptr<SessionLogProxy>;
 
     SessionLogProxy(GDBusConnection* dbc,
                     const std::string& target_,
-                    const std::string& session_path)
-        : LogServiceProxy(dbc), target(target_)
+                    const std::string& session_path,
+                    const unsigned int batch_max_events = 0,
+                    const unsigned int batch_interval = 0,
+                    const bool compact = false)
+        : target(target_), session_path(session_path)
     {
-        logproxy = ProxyLogEvents(target, session_path);
+        DBusObjectHandle logsrv(dbc, OpenVPN3DBus_name_log,
+                                OpenVPN3DBus_rootp_log,
+                                OpenVPN3DBus_interf_log);
+        GVariant *res = logsrv.Call("ProxyLogEvents",
+                                    g_variant_new("(so)",
+                                                  target.c_str(),
+                                                  session_path.c_str()));
+        logproxy.reset(new LogProxy(dbc,
+                                    GLibUtils::ExtractValue<std::string>(res, 0)));
+        g_variant_unref(res);
+        if (batch_max_events > 0)
+        {
+            logproxy->SetBatching(batch_max_events, batch_interval);
+        }
+        if (compact)
+        {
+            logproxy->SetCompactFormat(true);
+        }
     }
 
 
@@ -328,7 +479,15 @@ public:
     {
         if (logproxy)
         {
-            logproxy->Remove();
+            try
+            {
+                logproxy->RemoveSession(session_path);
+            }
+            catch (const std::exception&)
+            {
+                // The log proxy is already gone, which happens if
+                // the log service has been restarted
+            }
             logproxy.reset();
         }
     }
@@ -349,6 +508,7 @@ public:
 
 private:
     std::string target = {};
+    std::string session_path = {};
     LogProxy::Ptr logproxy = nullptr;
 };
 
@@ -362,7 +522,6 @@ using SessionLogProxyList = std::map<std::string, SessionLogProxy::Ptr>;
  *  manager is be responsible for maintaining the life cycle of these objects.
  */
 class SessionObject : public DBusObject,
-                      public DBusSignalSubscription,
                       public DBusCredentials,
                       public SessionManagerSignals
 {
@@ -380,6 +539,10 @@ public:
      * @param manager_log_level Default log level, used by the session manager
      * @param logwr    Pointer to LogWriter object; can be nullptr to
      *                 disablefile log.
+     * @param adopt    Pointer to the SessionStore::Entry of a session whose
+     *                 backend process is still running from a previous
+     *                 session manager.  No new backend is started; it is
+     *                 taken over by Adopt() instead.  Can be nullptr.
      *
      */
     SessionObject(GDBusConnection *dbuscon,
@@ -387,9 +550,9 @@ public:
                   uid_t owner,
                   std::string objpath, std::string cfg_path,
                   unsigned int manager_log_level, LogWriter *logwr,
-                  bool signal_broadcast)
+                  bool signal_broadcast,
+                  const SessionStore::Entry *adopt = nullptr)
         : DBusObject(objpath),
-          DBusSignalSubscription(dbuscon, "", OpenVPN3DBus_interf_backends, ""),
           DBusCredentials(dbuscon, owner),
           SessionManagerSignals(dbuscon, objpath, manager_log_level, logwr,
                                 signal_broadcast),
@@ -406,64 +569,131 @@ public:
           registered(false),
           selfdestruct_complete(false)
     {
+        connect_timing.Mark("new_tunnel");
+
         // Only for the initialization of this object, use the manager's
         // log level.  Once the object is registered with a backend, it
         // will switch to the default session log level.
         SetLogLevel(manager_log_level);
-        Subscribe("RegistrationRequest");
 
-        // Register configuration the configuration object
-        std::stringstream introspection_xml;
-        introspection_xml << "<node name='" << objpath << "'>"
-                          << "    <interface name='" << OpenVPN3DBus_interf_sessions << "'>"
-                          << "        <method name='Connect'/>"
-                          << "        <method name='Pause'>"
-                          << "            <arg type='s' name='reason' direction='in'/>"
-                          << "        </method>"
-                          << "        <method name='Resume'/>"
-                          << "        <method name='Restart'/>"
-                          << "        <method name='Disconnect'/>"
-                          << "        <method name='Ready'/>"
-                          << "        <method name='AccessGrant'>"
-                          << "            <arg direction='in' type='u' name='uid'/>"
-                          << "        </method>"
-                          << "        <method name='AccessRevoke'>"
-                          << "            <arg direction='in' type='u' name='uid'/>"
-                          << "        </method>"
-                          << "        <method name='LogForward'>"
-                          << "            <arg direction='in' type='b' name='enable'/>"
-                          << "        </method>"
-                          << RequiresQueue::IntrospectionMethods("UserInputQueueGetTypeGroup",
-                                                                 "UserInputQueueFetch",
-                                                                 "UserInputQueueCheck",
-                                                                 "UserInputProvide")
-                          << "        <signal name='AttentionRequired'>"
-                          << "            <arg type='u' name='type' direction='out'/>"
-                          << "            <arg type='u' name='group' direction='out'/>"
-                          << "            <arg type='s' name='message' direction='out'/>"
-                          << "        </signal>"
-                          << GetStatusChangeIntrospection()
-                          << GetLogIntrospection()
-                          << "        <property type='u' name='owner' access='read'/>"
-                          << "        <property type='t' name='session_created' access='read'/>"
-                          << "        <property type='au' name='acl' access='read'/>"
-                          << "        <property type='b' name='public_access' access='readwrite'/>"
-                          << "        <property type='(uus)' name='status' access='read'/>"
-                          << "        <property type='a{sv}' name='last_log' access='read'/>"
-                          << "        <property type='a{sx}' name='statistics' access='read'/>"
-                          << "        <property type='b' name='dco' access='readwrite'/>"
-                          << "        <property type='s' name='device_path' access='read'/>"
-                          << "        <property type='s' name='device_name' access='read'/>"
-                          << "        <property type='o' name='config_path' access='read'/>"
-                          << "        <property type='s' name='config_name' access='read'/>"
-                          << "        <property type='s' name='session_name' access='read'/>"
-                          << "        <property type='u' name='backend_pid' access='read'/>"
-                          << "        <property type='b' name='restrict_log_access' access='readwrite'/>"
-                          << "        <property type='ao' name='log_forwards' access='read'/>"
-                          << "        <property type='u' name='log_verbosity' access='readwrite'/>"
-                          << "    </interface>"
-                          << "</node>";
-        ParseIntrospectionXML(introspection_xml);
+        // All session objects share the match rule for the backend
+        // signals via the signal router of the connection.  The
+        // RegistrationRequest signal is dispatched by the
+        // SessionManagerObject, based on the backend token.
+        signal_router = DBusSignalRouter::Get(dbuscon);
+
+        // All session objects share the same parsed introspection document
+        ParseIntrospectionXML("SessionObject", [this]()
+            {
+                std::stringstream introspection_xml;
+                introspection_xml << "<node>"
+                                  << "    <interface name='" << OpenVPN3DBus_interf_sessions << "'>"
+                                  << "        <method name='Connect'/>"
+                                  << "        <method name='Pause'>"
+                                  << "            <arg type='s' name='reason' direction='in'/>"
+                                  << "        </method>"
+                                  << "        <method name='Resume'/>"
+                                  << "        <method name='Restart'/>"
+                                  << "        <method name='Disconnect'/>"
+                                  << "        <method name='Ready'/>"
+                                  << "        <method name='AccessGrant'>"
+                                  << "            <arg direction='in' type='u' name='uid'/>"
+                                  << "        </method>"
+                                  << "        <method name='AccessRevoke'>"
+                                  << "            <arg direction='in' type='u' name='uid'/>"
+                                  << "        </method>"
+                                  << "        <method name='AccessGrantGroup'>"
+                                  << "            <arg direction='in' type='u' name='gid'/>"
+                                  << "        </method>"
+                                  << "        <method name='AccessRevokeGroup'>"
+                                  << "            <arg direction='in' type='u' name='gid'/>"
+                                  << "        </method>"
+                                  << "        <method name='LogForward'>"
+                                  << "            <arg direction='in' type='b' name='enable'/>"
+                                  << "        </method>"
+                                  << "        <method name='LogForwardBatch'>"
+                                  << "            <arg direction='in' type='u' name='max_events'/>"
+                                  << "            <arg direction='in' type='u' name='interval_ms'/>"
+                                  << "        </method>"
+                                  << "        <method name='LogForwardCompact'>"
+                                  << "            <arg direction='in' type='u' name='max_events'/>"
+                                  << "            <arg direction='in' type='u' name='interval_ms'/>"
+                                  << "        </method>"
+                                  << "        <method name='StatisticsSubscribe'>"
+                                  << "            <arg direction='in' type='u' name='interval_ms'/>"
+                                  << "        </method>"
+                                  << "        <method name='GetStatusSince'>"
+                                  << "            <arg direction='in' type='t' name='seq'/>"
+                                  << "            <arg direction='out' type='t' name='last_seq'/>"
+                                  << "            <arg direction='out' type='a(tuus)' name='events'/>"
+                                  << "        </method>"
+                                  << "        <method name='FetchLogHistory'>"
+                                  << "            <arg direction='in' type='u' name='max_events'/>"
+                                  << "            <arg direction='out' type='aa{sv}' name='events'/>"
+                                  << "        </method>"
+                                  << "        <method name='GetStatsHistory'>"
+                                  << "            <arg direction='in' type='t' name='since'/>"
+                                  << "            <arg direction='in' type='u' name='step'/>"
+                                  << "            <arg direction='out' type='u' name='step'/>"
+                                  << "            <arg direction='out' type='as' name='keys'/>"
+                                  << "            <arg direction='out' type='at' name='timestamps'/>"
+                                  << "            <arg direction='out' type='at' name='values'/>"
+                                  << "        </method>"
+                                  << "        <method name='DumpLogHistory'>"
+                                  << "            <arg direction='out' type='u' name='events_sent'/>"
+                                  << "        </method>"
+                                  << RequiresQueue::IntrospectionMethods("UserInputQueueGetTypeGroup",
+                                                                         "UserInputQueueFetch",
+                                                                         "UserInputQueueCheck",
+                                                                         "UserInputProvide")
+                                  << RequiresQueue::IntrospectionBatchMethods("UserInputQueueFetchAll",
+                                                                              "UserInputProvideResponses")
+                                  << "        <signal name='AttentionRequired'>"
+                                  << "            <arg type='u' name='type' direction='out'/>"
+                                  << "            <arg type='u' name='group' direction='out'/>"
+                                  << "            <arg type='s' name='message' direction='out'/>"
+                                  << "        </signal>"
+                                  << "        <signal name='Statistics'>"
+                                  << "            <arg type='u' name='layout_id' direction='out'/>"
+                                  << "            <arg type='at' name='counters' direction='out'/>"
+                                  << "        </signal>"
+                                  << GetStatusChangeIntrospection()
+                                  << GetLogIntrospection()
+                                  << "        <property type='u' name='owner' access='read'/>"
+                                  << "        <property type='t' name='session_created' access='read'/>"
+                                  << "        <property type='a{st}' name='connect_timing' access='read'/>"
+                                  << "        <property type='au' name='acl' access='read'/>"
+                                  << "        <property type='au' name='acl_groups' access='read'/>"
+                                  << "        <property type='b' name='public_access' access='readwrite'/>"
+                                  << "        <property type='(uus)' name='status' access='read'/>"
+                                  << "        <property type='t' name='status_seq' access='read'/>"
+                                  << "        <property type='a{sv}' name='last_log' access='read'/>"
+                                  << "        <property type='a{sx}' name='statistics' access='read'/>"
+                                  << "        <property type='(uas)' name='statistics_layout' access='read'/>"
+                                  << "        <property type='at' name='statistics_packed' access='read'/>"
+                                  << "        <property type='a{sv}' name='path_quality' access='read'/>"
+                                  << "        <property type='b' name='dco' access='readwrite'/>"
+                                  << "        <property type='s' name='device_path' access='read'/>"
+                                  << "        <property type='s' name='device_name' access='read'/>"
+                                  << "        <property type='o' name='config_path' access='read'/>"
+                                  << "        <property type='s' name='config_name' access='read'/>"
+                                  << "        <property type='s' name='session_name' access='read'/>"
+                                  << "        <property type='u' name='backend_pid' access='read'/>"
+                                  << "        <property type='s' name='bundle_id' access='read'/>"
+                                  << "        <property type='u' name='connect_priority' access='readwrite'/>"
+                                  << "        <property type='b' name='restrict_log_access' access='readwrite'/>"
+                                  << "        <property type='ao' name='log_forwards' access='read'/>"
+                                  << "        <property type='u' name='log_verbosity' access='readwrite'/>"
+                                  << "    </interface>"
+                                  << "</node>";
+                return introspection_xml.str();
+            });
+
+        if (adopt)
+        {
+            restore_entry(*adopt);
+            return;
+        }
 
         try
         {
@@ -489,7 +719,11 @@ public:
                                             "Failed to extract the result of the "
                                             "StartClient request");
                 }
-                g_variant_get(res_g, "(u)", &backend_pid);
+                // The reply also carries a timing breakdown of the
+                // start request; only the PID is needed here
+                g_variant_get_child(res_g, 0, "u", &backend_pid);
+                g_variant_unref(res_g);
+                connect_timing.Mark("backend_started");
         }
         catch (DBusException& excp)
         {
@@ -509,23 +743,58 @@ public:
         Debug("SessionObject registered on '" + OpenVPN3DBus_interf_sessions + "': "
               + objpath + " [backend_token=" + backend_token + "]");
 
-        std::stringstream msg;
-        msg << "Session starting, configuration path: " << cfg_path
-            << ", owner: " << lookup_username(owner);
-        LogVerb1(msg.str());
+        if (LogEnabled(LogCategory::VERB1))
+        {
+            std::stringstream msg;
+            msg << "Session starting, configuration path: " << cfg_path
+                << ", owner: " << lookup_username(owner);
+            LogVerb1(msg.str());
+        }
     }
 
     ~SessionObject()
     {
+        for (const auto& h : signal_handlers)
+        {
+            signal_router->RemoveHandler(h.second);
+        }
+        for (const auto& h : peer_signal_handlers)
+        {
+            peer_signal_router->RemoveHandler(h);
+        }
+
+        for (const auto& sub : stats_subscribers)
+        {
+            g_bus_unwatch_name(sub.second.watch_id);
+        }
+
         if (sig_statuschg)
         {
             delete sig_statuschg;
         }
 
+        if (0 != be_watch)
+        {
+            g_bus_unwatch_name(be_watch);
+        }
+        if (0 != shutdown_timer)
+        {
+            g_source_remove(shutdown_timer);
+        }
+        release_admission();
+
+        // Backend calls still in flight must not touch this object
+        *object_alive = false;
+        for (auto& inv : shutdown_invocs)
+        {
+            g_dbus_method_invocation_return_value(inv, NULL);
+        }
+
         if (be_proxy)
         {
             delete be_proxy;
         }
+        be_link.reset();
         LogVerb1("Session is closing");
         StatusChange(StatusMajor::SESSION, StatusMinor::SESS_REMOVED);
         remove_callback();
@@ -546,1553 +815,4465 @@ public:
 
 
     /**
-     *  Retrieve the device name used by the this session.
+     *  Collects the properties matched by the filtered listing methods
+     *  of the SessionManagerObject
      *
-     * @return Returns std::string containing the device string.  If the
-     *         connection to the backend process is not established, an
-     *         empty string is returned.
+     * @return Returns a ListFilter::Item for this session
      */
-    std::string GetDeviceName() const
+    ListFilter::Item GetListFilterItem() const
     {
-        if (!be_proxy)
-        {
-            return "";
-        }
-        try
-        {
-            return be_proxy->GetStringProperty("device_name");
-        }
-        catch (const DBusException& excp)
-        {
-            // Ignore errors, just report an empty device name
-            return "";
-        }
+        ListFilter::Item item;
+        item.path = GetObjectPath();
+        item.owner = GetOwnerUID();
+        item.name = config_name;
+        item.status_major = (unsigned int) (sig_statuschg
+                                            ? sig_statuschg->GetLastStatusMajor()
+                                            : StatusMajor::UNSET);
+        item.dco = dco;
+        return item;
     }
 
 
     /**
-     *  Callback method called each time signals we have subscribed to
-     *  occurs.  For the SessionObject, we care about these signals:
+     *  Retrieve the token the VPN client backend process uses to
+     *  identify this session in its RegistrationRequest signal
+     */
+    std::string GetBackendToken() const noexcept
+    {
+        return backend_token;
+    }
+
+
+    /**
+     *  Retrieve the device name last reported by the backend when the
+     *  connection was established, without querying the backend.
      *
-     *    - RegistrationRequest:  which the VPN client backend process
-     *                            sends once it has completed the
-     *                            initialization.
-     *    - StatusChange:         whenever the status changes in the backend
-     *    - AttentionRequired:    whenever the backend process needs
-     *                            information from the front-end user.
+     * @return Returns std::string with the device name, empty if the
+     *         session has not connected yet
+     */
+    std::string GetKnownDeviceName() const
+    {
+        return known_device_name;
+    }
+
+
+    /**
+     *  Set the function to call when the configuration name or the
+     *  known device name of this session changes
      *
-     * @param conn             D-Bus connection where the signal came from
-     * @param sender_name      D-Bus bus name of the sender of the singal
-     * @param object_path      D-Bus object path of the signal
-     * @param interface_name   D-Bus interface of the signal
-     * @param signal_name      The name of the signal itself
-     * @param params           GVariant Glib2 object containing all the
-     *                         variables the signal carries
+     * @param cb  std::function to call
      */
-    void callback_signal_handler(GDBusConnection *conn,
-                                 const std::string sender_name,
-                                 const std::string object_path,
-                                 const std::string interface_name,
-                                 const std::string signal_name,
-                                 GVariant *params)
+    void SetIndexUpdateCallback(std::function<void()> cb)
     {
-        if ((signal_name == "RegistrationRequest")
-            && (interface_name == OpenVPN3DBus_interf_backends))
-        {
-            gchar *busn = nullptr;
-            gchar *sesstoken_c = nullptr;
-            pid_t be_pid;
-            g_variant_get (params, "(ssi)", &busn, &sesstoken_c, &be_pid);
+        index_update_callback = cb;
+    }
 
-            be_conn = conn;
-            be_busname = std::string(busn);
 
-            g_free(busn);
-            std::string sesstoken(sesstoken_c);
-            g_free(sesstoken_c);
-            be_path = std::string(object_path);
+    /**
+     *  Set the function to call when the status or the statistics
+     *  counters of this session change, for the status boards.  The
+     *  function gets true if only the counters changed.
+     *
+     * @param cb  std::function to call, nullptr to stop calling it
+     */
+    void SetStatusBoardCallback(std::function<void(bool)> cb)
+    {
+        status_board_callback = cb;
+    }
 
-            if (std::string(sesstoken) != backend_token)
-            {
-                // This registration request was not for us.
-                // The RegistrationRequest signals is broadcasted which means
-                // any SessionObject still subscribed to this signal will
-                // see this request.
-                //
-                // This can happen if several tunnels are started in parallel
-                // and they issue this signal at approximately the same time
-                // and before the owning SessionObject() have managed to
-                // unsubscribe from the signal
 
-                // Debug("Ignoring RegistrationRequest (token mismatch)  - name=" + be_busname + ", path=" + be_path);
-                return;
-            }
+    /**
+     *  Set how often the backend pushes the statistics counters for
+     *  the status boards, in addition to the Statistics subscribers
+     *
+     * @param interval_ms  Interval in milliseconds, 0 to stop
+     */
+    void SetStatusBoardInterval(const unsigned int interval_ms)
+    {
+        status_board_interval = interval_ms;
+        update_stats_interval();
+    }
 
-            try
-            {
-                Subscribe(sender_name, be_path, "AttentionRequired");
-                Subscribe(sender_name, be_path, "StatusChange");
-                register_backend();
-                backend_pid = be_pid;
-                Unsubscribe("RegistrationRequest");
-                SetLogLevel(default_session_log_level);
-                LogVerb2("Backend VPN client process registered");
-            }
-            catch (DBusException& err)
-            {
-                LogError("Could not register backend process, removing session object");
-                Debug(be_busname, be_path, backend_pid, std::string(err.what()));
-                StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Backend process died");
-                selfdestruct(conn);
-            }
-        }
-        else if ((signal_name == "StatusChange")
-                 && (interface_name == OpenVPN3DBus_interf_backends))
-        {
-            StatusEvent status(params);
 
-            if (StatusMajor::CONNECTION == status.major
-                && StatusMinor::CONN_FAILED == status.minor)
-            {
-                // When the backend client signals connection failure
-                // force it to shutdown and close this session object
-                //
-                // FIXME: Consider if we need to split CONN_FAILED into
-                //        a fatal error (as now) and "Connection failed, but session may resume"
-                //        This link is between here and client/core-client.hpp:173
-                //
-                shutdown(true, (StatusMinor::CONN_FAILED == status.minor));
-            }
-        }
-        else if ((signal_name =="AttentionRequired")
-                 && (interface_name == OpenVPN3DBus_interf_backends))
+    /**
+     *  Retrieve the status board entry of this session
+     *
+     * @return Returns a SessionManager::StatusBoard::Session
+     */
+    SessionManager::StatusBoard::Session GetStatusBoardEntry() const
+    {
+        SessionManager::StatusBoard::Session e{};
+        e.in_use = 1;
+        e.owner = GetOwnerUID();
+        e.backend_pid = backend_pid;
+        e.status_major = (uint32_t) board_status.major;
+        e.status_minor = (uint32_t) board_status.minor;
+        e.updated = board_updated;
+        e.bytes_in = board_counters[0];
+        e.bytes_out = board_counters[1];
+        e.packets_in = board_counters[2];
+        e.packets_out = board_counters[3];
+        SessionManager::StatusBoardCopy(e.session_path, DBusObject::GetObjectPath());
+        SessionManager::StatusBoardCopy(e.config_name, config_name);
+        SessionManager::StatusBoardCopy(e.device_name, known_device_name);
+        return e;
+    }
+
+
+    /**
+     *  Set the function to call when anything recorded in the
+     *  SessionStore::Entry of this session changes, see GetStoreEntry()
+     *
+     * @param cb  std::function to call
+     */
+    void SetStoreUpdateCallback(std::function<void()> cb)
+    {
+        store_update_callback = cb;
+    }
+
+
+    /**
+     *  Calls the store update callback once this session is tied to
+     *  its backend process, see SetStoreUpdateCallback()
+     */
+    void StoreUpdate()
+    {
+        if (registered && store_update_callback)
         {
-                // Proxy this signal directly to the front-end processes
-                // listening
-                Send("AttentionRequired", params);
+            store_update_callback();
         }
     }
 
+
     /**
-     *  Callback method which is called each time a D-Bus method call occurs
-     *  on this SessionObject.
-     *
-     *  In most cases the method call is just proxied to the client backend
-     *  process after an access control check has been performed.  Many of the
-     *  calls can be accessed by the owner or designated user IDs, and the
-     *  most sensitive methods are only accessible to the owner of this
-     *  session.
+     *  Retrieve what a restarted session manager needs to take over
+     *  the VPN client backend process of this session
      *
-     * @param conn       D-Bus connection where the method call occurred
-     * @param sender     D-Bus bus name of the sender of the method call
-     * @param obj_path   D-Bus object path of the target object.
-     * @param intf_name  D-Bus interface of the method call
-     * @param method_name D-Bus method name to be executed
-     * @param params     GVariant Glib2 object containing the arguments for
-     *                   the method call
-     * @param invoc      GDBusMethodInvocation where the response/result of
-     *                   the method call will be returned.
+     * @return Returns a SessionStore::Entry describing this session
      */
-    void callback_method_call(GDBusConnection *conn,
-                              const std::string sender,
-                              const std::string obj_path,
-                              const std::string intf_name,
-                              const std::string method_name,
-                              GVariant *params,
-                              GDBusMethodInvocation *invoc)
+    SessionStore::Entry GetStoreEntry() const
     {
-        bool ping = false;
+        SessionStore::Entry e;
+        e.session_path = DBusObject::GetObjectPath();
+        e.backend_busname = be_busname;
+        e.backend_path = be_path;
+        e.backend_token = backend_token;
+        e.backend_pid = backend_pid;
+        e.owner = GetOwnerUID();
+        e.acl = GetAccessList();
+        e.acl_groups = GetGroupAccessList();
+        e.public_access = GetPublicAccess();
+        e.restrict_log_access = restrict_log_access;
+        e.config_path = config_path;
+        e.config_name = config_name;
+        e.created = session_created;
+        e.device_name = known_device_name;
+        e.bundle_id = bundle_id;
+        e.bundle_index = bundle_index;
+        e.bundle_size = bundle_size;
+        return e;
+    }
+
 
+    /**
+     *  Takes over the VPN client backend process of a session restored
+     *  from the SessionStore.  The backend is already registered to
+     *  this session path, so this sets up what register_backend() does
+     *  for a new backend, without confirming the registration again.
+     *  If the backend does not respond, this object is removed.
+     *
+     * @return Returns true if the backend process was taken over
+     */
+    bool Adopt()
+    {
+        GDBusConnection *conn = signal_router->GetConnection();
         try
         {
-            if (!be_proxy)
-            {
-                THROW_DBUSEXCEPTION("SessionObject", "No backend proxy connection available. Backend died?");
-            }
-            try {
-                ping = ping_backend();
-                if (unlikely(!ping))
-                {
-                    THROW_DBUSEXCEPTION("SessionObject",
-                                        "The response from the backend Ping request was surprising");
-                }
-            }
-            catch (DBusException &dbserr)
+            const std::string sender = GetUniqueBusID(be_busname);
+            add_backend_signal_handler(sender, be_path, "AttentionRequired");
+            add_backend_signal_handler(sender, be_path, "StatusChange");
+            add_backend_signal_handler(sender, be_path, "Statistics");
+            add_backend_signal_handler(sender, be_path, "RemoteStatus");
+            add_backend_signal_handler(sender, be_path, "SessionName");
+            attach_backend();
+            if (remote_backoff)
             {
-                ping = false;
-                THROW_DBUSEXCEPTION("SessionObject",
-                                    "Backend did not respond: "
-                                    + std::string(dbserr.GetRawError()));
+                SendRemoteBackoff(remote_backoff->Get(0));
             }
 
-            if (!registered)
+            // Start from the current backend status; the changes
+            // while no session manager was running are lost
+            GVariant *be_status = be_proxy->GetProperty("status");
+            StatusEvent status(be_status);
+            if (StatusMajor::CONNECTION == status.major)
             {
-                THROW_DBUSEXCEPTION("SessionObject",
-                                    "Session registration not completed");
+                connection_state = status.minor;
             }
+            sig_statuschg->ProxyStatus(be_status);
+            g_variant_unref(be_status);
+
+            // The SessionName signal was sent before the take-over
+            std::shared_ptr<bool> alive = object_alive;
+            be_proxy->GetPropertyAsync("session_name",
+                                       [this, alive](DBusProxyAsyncCall& call)
+                                       {
+                                           if (!*alive || !session_name.empty())
+                                           {
+                                               return;
+                                           }
+                                           try
+                                           {
+                                               GVariant *v = call.GetResult();
+                                               session_name = g_variant_get_string(v, nullptr);
+                                               g_variant_unref(v);
+                                           }
+                                           catch (const DBusException&)
+                                           {
+                                               // Ignore errors in this case; this is informal details
+                                           }
+                                       });
 
-            std::stringstream msg;
-            msg << "Session operation: " << method_name
-                << ", requester:  " << lookup_username(GetUID(sender));
-            Debug(msg.str());
+            registered = true;
+            SetLogLevel(default_session_log_level);
+            LogVerb1("Took over the running VPN backend process, pid "
+                     + std::to_string(backend_pid));
+            return true;
+        }
+        catch (DBusException& err)
+        {
+            LogError("Could not take over backend process, removing session object");
+            Debug(be_busname, be_path, backend_pid, std::string(err.what()));
+            StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Backend process died");
+            selfdestruct(conn);
+            return false;
+        }
+    }
 
-            if ("Connect" == method_name)
+
+    /**
+     *  Set the cache where the reconnect state of the connection is kept
+     *  for the next session of the same user and configuration profile
+     *
+     * @param cache  ReconnectCache::Ptr to the cache of the session manager
+     */
+    void SetReconnectCache(ReconnectCache::Ptr cache)
+    {
+        reconnect_cache = cache;
+    }
+
+
+    /**
+     *  Set the remote health state shared by all sessions, which is
+     *  updated from the RemoteStatus signals of the backend process
+     *
+     * @param backoff  RemoteBackoff::Ptr of the session manager; nullptr
+     *                 if sharing the remote backoff is disabled
+     * @param changed  std::function to call when the backoff state has
+     *                 changed and should be sent to all backends
+     */
+    void SetRemoteBackoff(RemoteBackoff::Ptr backoff, std::function<void()> changed)
+    {
+        remote_backoff = backoff;
+        remote_backoff_changed = changed;
+    }
+
+
+    /**
+     *  Tells the backend process how long to hold back each remote, see
+     *  RemoteBackoff
+     *
+     * @param delays  RemoteBackoff::Delays for this session
+     */
+    void SendRemoteBackoff(const RemoteBackoff::Delays& delays)
+    {
+        if (!remote_backoff || !be_proxy)
+        {
+            return;
+        }
+        GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a{su}"));
+        for (const auto& d : delays)
+        {
+            g_variant_builder_add(b, "{su}", d.first.c_str(),
+                                  (guint32) d.second.count());
+        }
+        std::shared_ptr<bool> alive = object_alive;
+        be_proxy->CallAsync("SetRemoteBackoff", GLibUtils::wrapInTuple(b),
+                            [this, alive](DBusProxyAsyncCall& call)
+                            {
+                                try
+                                {
+                                    GVariant *res = call.GetResult();
+                                    if (res)
+                                    {
+                                        g_variant_unref(res);
+                                    }
+                                }
+                                catch (const DBusException& excp)
+                                {
+                                    if (*alive)
+                                    {
+                                        Debug("Could not update the remote backoff: "
+                                              + std::string(excp.GetRawError()));
+                                    }
+                                }
+                                catch (const DBusProxyAccessDeniedException& excp)
+                                {
+                                    if (*alive)
+                                    {
+                                        Debug("Could not update the remote backoff: "
+                                              + std::string(excp.what()));
+                                    }
+                                }
+                            });
+    }
+
+
+    /**
+     *  Set the cache of configuration profile details, which the session
+     *  manager fills in asynchronously when the session is created
+     *
+     * @param cache  ConfigCache::Ptr to the cache of the session manager
+     */
+    void SetConfigCache(ConfigCache::Ptr cache)
+    {
+        config_cache = cache;
+    }
+
+
+    /**
+     *  Disconnects the session on behalf of the session manager, like
+     *  the Disconnect method of the session object.  This does not wait
+     *  for the backend process to exit; the done callback is called when
+     *  it has, right before this session object is destroyed.
+     *
+     * @param forced  If true, tell the backend process to stop abruptly
+     * @param done    std::function<void()> called when the session is closed
+     */
+    void Disconnect(const bool forced, std::function<void()> done)
+    {
+        LogVerb2("Disconnecting connection");
+        if (reconnect_cache)
+        {
+            reconnect_cache->Forget(GetOwnerUID(), config_path);
+        }
+        shutdown_callbacks.push_back(done);
+        shutdown(forced, true);
+    }
+
+
+    /**
+     *  Pauses the connection because the host is about to go to sleep.
+     *  Only connected sessions, or those trying to (re)connect, are
+     *  paused; they are resumed by ResumeAfterSleep().
+     *
+     * @param done  std::function<void()> called when the backend has
+     *              processed the request; only called if this returns true
+     *
+     * @return Returns true if the session is being paused
+     */
+    bool PauseForSleep(std::function<void()> done)
+    {
+        if (!registered || !be_proxy || shutdown_pending
+            || !(StatusMinor::CONN_CONNECTED == connection_state
+                 || StatusMinor::CONN_CONNECTING == connection_state
+                 || StatusMinor::CONN_RECONNECTING == connection_state))
+        {
+            return false;
+        }
+
+        LogVerb2("Pausing connection, the system is going to sleep");
+        paused_for_sleep = true;
+        std::shared_ptr<bool> alive = object_alive;
+        be_proxy->CallAsync("Pause", g_variant_new("(s)", "System going to sleep"),
+                            [this, alive, done](DBusProxyAsyncCall& call)
+                            {
+                                sleep_call_result(alive, call, "pause");
+                                done();
+                            });
+        return true;
+    }
+
+
+    /**
+     *  Resumes the connection if it was paused by PauseForSleep().
+     *  The backend reconnects right away.
+     */
+    void ResumeAfterSleep()
+    {
+        if (!paused_for_sleep)
+        {
+            return;
+        }
+        paused_for_sleep = false;
+        if (!registered || !be_proxy || shutdown_pending)
+        {
+            return;
+        }
+
+        LogVerb2("Resuming connection, the system has woken up");
+        admitted_backend_call(nullptr, "Resume");
+    }
+
+
+    /**
+     *  Set the connect admission control of the session manager, which
+     *  limits how many sessions connect at the same time
+     *
+     * @param adm  ConnectAdmission::Ptr of the session manager
+     */
+    void SetConnectAdmission(ConnectAdmission::Ptr adm)
+    {
+        connect_admission = adm;
+    }
+
+
+    /**
+     *  Starts the sessions admitted by the connect admission control,
+     *  each after its own random delay
+     *
+     * @param adm     ConnectAdmission the sessions were admitted by
+     * @param starts  Start functions of the admitted sessions
+     */
+    static void StartAdmitted(ConnectAdmission::Ptr adm,
+                              const std::vector<ConnectAdmission::Start>& starts)
+    {
+        for (const auto& start : starts)
+        {
+            g_timeout_add_full(G_PRIORITY_DEFAULT,
+                               adm->Jitter(),
+                               [](gpointer fn) -> gboolean
+                               {
+                                   (*static_cast<ConnectAdmission::Start *>(fn))();
+                                   return G_SOURCE_REMOVE;
+                               },
+                               new ConnectAdmission::Start(start),
+                               [](gpointer fn)
+                               {
+                                   delete static_cast<ConnectAdmission::Start *>(fn);
+                               });
+        }
+    }
+
+
+    /**
+     *  Makes this session part of a bundle of parallel sessions of the
+     *  same configuration profile.  The backend is told about it once it
+     *  has registered.
+     *
+     * @param id     std::string with the unique name of the bundle
+     * @param index  Position of this session in the bundle
+     * @param size   Number of sessions in the bundle
+     */
+    void SetBundle(const std::string& id, const unsigned int index,
+                   const unsigned int size)
+    {
+        bundle_id = id;
+        bundle_index = index;
+        bundle_size = size;
+    }
+
+
+    /**
+     *  Enable a private peer-to-peer D-Bus connection to the backend
+     *  process, used instead of the system bus for the method calls,
+     *  property requests and StatusChange, AttentionRequired and
+     *  Statistics signals between this session and the backend.  If the
+     *  link cannot be set up, the system bus is used.
+     *
+     * @param enable  bool, true to set up the link when the backend
+     *                registers
+     */
+    void EnablePeerLink(bool enable)
+    {
+        peer_link_enabled = enable;
+    }
+
+
+    /**
+     *  Adds the approximate memory use of this session object to a
+     *  resource usage report
+     *
+     * @param report  DBusResourceUsage::Report to add to
+     */
+    void ReportResourceUsage(DBusResourceUsage::Report& report) const
+    {
+        report.Add("sessions", 1,
+                   sizeof(*this) + DBusResourceUsage::StringBytes(config_path)
+                   + DBusResourceUsage::StringBytes(config_name)
+                   + DBusResourceUsage::StringBytes(be_path));
+        report.Add("session_log_proxies", log_proxies.size(),
+                   log_proxies.size() * sizeof(SessionLogProxy));
+        report.Add("stats_subscribers", stats_subscribers.size(),
+                   stats_subscribers.size() * sizeof(StatsSubscriber));
+        if (sig_statuschg)
+        {
+            report.Add("status_history", sig_statuschg->HistorySize(),
+                       sig_statuschg->HistorySize()
+                       * sizeof(std::pair<guint64, StatusEvent>));
+        }
+        report.Add("signal_handlers", signal_handlers.size());
+    }
+
+
+    /**
+     *  Retrieve the device name used by the this session.
+     *
+     * @return Returns std::string containing the device string.  If the
+     *         connection to the backend process is not established, an
+     *         empty string is returned.
+     */
+    std::string GetDeviceName() const
+    {
+        if (!be_proxy)
+        {
+            return "";
+        }
+        try
+        {
+            return be_proxy->GetStringProperty("device_name");
+        }
+        catch (const DBusException& excp)
+        {
+            // Ignore errors, just report an empty device name
+            return "";
+        }
+    }
+
+
+    /**
+     *  Collects the most commonly used details of this session, used by
+     *  the SessionManagerObject FetchSessionsDetailed method.  Only the
+     *  state kept by this object is used; the device name is the one
+     *  seen when the connection was established, the session name the
+     *  one from the SessionName signal and the status the one last seen.
+     *  The backend process is never queried.
+     *
+     * @return Returns a GVariant dictionary (a{sv}) with the session
+     *         details.  The keys match the session object property names.
+     */
+    GVariant * GetSessionDetails() const
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(bld, "{sv}", "config_path",
+                              g_variant_new_string(config_path.c_str()));
+        g_variant_builder_add(bld, "{sv}", "config_name",
+                              g_variant_new_string(config_name.c_str()));
+        g_variant_builder_add(bld, "{sv}", "owner",
+                              g_variant_new_uint32(GetOwnerUID()));
+        g_variant_builder_add(bld, "{sv}", "session_created",
+                              g_variant_new_uint64(session_created));
+        g_variant_builder_add(bld, "{sv}", "dco",
+                              g_variant_new_boolean(dco));
+        if (!bundle_id.empty())
+        {
+            g_variant_builder_add(bld, "{sv}", "bundle_id",
+                                  g_variant_new_string(bundle_id.c_str()));
+        }
+
+        if (registered && be_proxy)
+        {
+            g_variant_builder_add(bld, "{sv}", "backend_pid",
+                                  g_variant_new_uint32(backend_pid));
+            g_variant_builder_add(bld, "{sv}", "device_name",
+                                  g_variant_new_string(known_device_name.c_str()));
+            g_variant_builder_add(bld, "{sv}", "session_name",
+                                  g_variant_new_string(session_name.c_str()));
+
+            GVariant *status = (sig_statuschg
+                                ? sig_statuschg->GetLastStatusChange()
+                                : nullptr);
+            if (status)
             {
-                CheckACL(sender);
+                g_variant_builder_add(bld, "{sv}", "status", status);
+            }
+        }
 
-                if (DCOstatus::MODIFIED == dco_status)
-                {
-                    be_proxy->SetProperty("dco", dco);
-                    dco_status = DCOstatus::LOCKED;
-                }
-                try
-                {
-                    auto verb = (unsigned int)be_proxy->GetUIntProperty("log_level");
-                    SetLogLevel(verb);
-                }
-                catch (const DBusException&)
-                {
-                    LogCritical("Could not retrieve the client backend log level");
-                }
-                be_proxy->Call("Connect");
-                LogVerb2("Starting connection");
+        GVariant *ret = g_variant_builder_end(bld);
+        g_variant_builder_unref(bld);
+        return ret;
+    }
+
+
+    /**
+     *  Callback method called each time signals we have subscribed to
+     *  occurs.  For the SessionObject, we care about these signals:
+     *
+     *    - RegistrationRequest:  which the VPN client backend process
+     *                            sends once it has completed the
+     *                            initialization.
+     *    - StatusChange:         whenever the status changes in the backend
+     *    - AttentionRequired:    whenever the backend process needs
+     *                            information from the front-end user.
+     *    - Statistics:           periodic connection statistics
+     *
+     *  These signals are delivered by the DBusSignalRouter, which only
+     *  calls this for the signals registered by this object via
+     *  add_backend_signal_handler().  The RegistrationRequest signal is
+     *  passed on by the SessionManagerObject.
+     *
+     * @param ev  DBusSignalEvent with the signal details
+     */
+    void callback_signal_handler(const DBusSignalEvent& ev)
+    {
+        GDBusConnection *conn = ev.connection;
+        GVariant *params = ev.params;
+
+        if (0 == strcmp(ev.signal_name, "RegistrationRequest"))
+        {
+            gchar *busn = nullptr;
+            gchar *sesstoken_c = nullptr;
+            pid_t be_pid;
+            g_variant_get (params, "(ssi)", &busn, &sesstoken_c, &be_pid);
+            std::string sesstoken(sesstoken_c);
+            g_free(sesstoken_c);
+
+            if (registered || sesstoken != backend_token)
+            {
+                // This registration request was not for us
+                g_free(busn);
+                return;
             }
-            else if ("Restart" == method_name)
+
+            be_conn = conn;
+            be_busname = std::string(busn);
+            g_free(busn);
+            be_path = std::string(ev.object_path);
+
+            try
             {
-                CheckACL(sender, true);
-                be_proxy->Call("Restart");
-                LogVerb2("Restarting connection");
+                add_backend_signal_handler(ev.sender, be_path, "AttentionRequired");
+                add_backend_signal_handler(ev.sender, be_path, "StatusChange");
+                add_backend_signal_handler(ev.sender, be_path, "Statistics");
+                add_backend_signal_handler(ev.sender, be_path, "RemoteStatus");
+                add_backend_signal_handler(ev.sender, be_path, "SessionName");
+                session_name.clear();
+                register_backend();
+                connect_timing.Mark("session_registered");
+                backend_pid = be_pid;
+                remove_backend_signal_handler("RegistrationRequest");
+                property_changed("backend_pid", [this]()
+                                 {
+                                     return g_variant_new_uint32(backend_pid);
+                                 });
+                property_changed("config_name", [this]()
+                                 {
+                                     return g_variant_new_string(config_name.c_str());
+                                 });
+                SetLogLevel(default_session_log_level);
+                LogVerb2("Backend VPN client process registered");
+                if (index_update_callback)
+                {
+                    index_update_callback();
+                }
+                StoreUpdate();
             }
-            else if ("Pause" == method_name)
+            catch (DBusException& err)
             {
-                CheckACL(sender, true);
-                // FIXME: Should check that params contains only the expected formatting
-                be_proxy->Call("Pause", params);
-                LogVerb2("Pausing connection");
+                LogError("Could not register backend process, removing session object");
+                Debug(be_busname, be_path, backend_pid, std::string(err.what()));
+                StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Backend process died");
+                selfdestruct(conn);
             }
-            else if ("Resume"  == method_name)
+        }
+        else if (0 == strcmp(ev.signal_name, "StatusChange"))
+        {
+            StatusEvent status(params);
+            if (StatusMajor::CONNECTION == status.major)
             {
-                CheckACL(sender, true);
-                be_proxy->Call("Resume");
-                LogVerb2("Resuming connection");
+                connection_state = status.minor;
             }
-            else if ("Disconnect" == method_name)
+            if (connect_attempt_done(status))
             {
-                CheckACL(sender, true);
-                LogVerb2("Disconnecting connection");
-                shutdown(false, true);
+                release_admission();
             }
-            else if ("Ready" == method_name)
+
+            if (StatusMajor::CONNECTION == status.major
+                && StatusMinor::CONN_CONNECTED == status.minor)
             {
-                try
-                {
-                    CheckACL(sender);
-                    be_proxy->Call("Ready");
-                }
-                catch (DBusException& dberr)
+                // The device is ready once the connection is established
+                const std::string devname = GetDeviceName();
+                if (devname != known_device_name)
                 {
-                    GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
-                                                                  dberr.what());
-                    g_dbus_method_invocation_return_gerror(invoc, err);
-                    g_error_free(err);
-                    return;
+                    known_device_name = devname;
+                    if (index_update_callback)
+                    {
+                        index_update_callback();
+                    }
+                    StoreUpdate();
                 }
+                report_connect_timing();
+                store_reconnect_state();
             }
-            else if ("UserInputQueueGetTypeGroup" == method_name)
+            else if (StatusMajor::CONNECTION == status.major
+                     && StatusMinor::CONN_AUTH_FAILED == status.minor
+                     && reconnect_cache)
             {
-                CheckACL(sender);
-                try
-                {
-                    GVariant *res = be_proxy->Call("UserInputQueueGetTypeGroup", params);
-                    g_dbus_method_invocation_return_value(invoc, res);
-                    g_variant_unref(res);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    excp.GenerateDBusError(invoc);
-                }
-                return;
+                // A rejected auth-token must not be offered again
+                reconnect_cache->Forget(GetOwnerUID(), config_path);
+            }
+
+            board_status = status;
+            board_updated = time(nullptr);
+            if (status_board_callback)
+            {
+                status_board_callback(false);
             }
-            else if ("UserInputQueueFetch" == method_name)
+
+            // The values are retrieved after SessionStatusChange has
+            // processed this signal
+            property_changed("status", [this]()
+                             {
+                                 return (sig_statuschg
+                                         ? sig_statuschg->GetLastStatusChange()
+                                         : nullptr);
+                             });
+            property_changed("status_seq", [this]()
+                             {
+                                 return g_variant_new_uint64(sig_statuschg
+                                                             ? sig_statuschg->GetStatusSequence()
+                                                             : 0);
+                             });
+
+            if (StatusMajor::CONNECTION == status.major
+                && StatusMinor::CONN_FAILED == status.minor)
+            {
+                // When the backend client signals connection failure
+                // force it to shutdown and close this session object
+                //
+                // FIXME: Consider if we need to split CONN_FAILED into
+                //        a fatal error (as now) and "Connection failed, but session may resume"
+                //        This link is between here and client/core-client.hpp:173
+                //
+                shutdown(true, (StatusMinor::CONN_FAILED == status.minor));
+            }
+        }
+        else if (0 == strcmp(ev.signal_name, "AttentionRequired"))
+        {
+                // Proxy this signal directly to the front-end processes
+                // listening
+                Send("AttentionRequired", params);
+        }
+        else if (0 == strcmp(ev.signal_name, "Statistics"))
+        {
+            if (status_board_callback && update_board_counters(params))
+            {
+                status_board_callback(true);
+            }
+
+            // The backend emits this signal at the shortest interval
+            // requested; only the subscribers will receive it
+            std::vector<std::string> targets;
+            for (const auto& sub : stats_subscribers)
+            {
+                targets.push_back(sub.first);
+            }
+            if (!targets.empty())
+            {
+                Send(targets, OpenVPN3DBus_interf_sessions,
+                     DBusObject::GetObjectPath(), "Statistics", params);
+            }
+        }
+        else if (0 == strcmp(ev.signal_name, "SessionName"))
+        {
+            gchar *name_c = nullptr;
+            g_variant_get(params, "(s)", &name_c);
+            session_name = std::string(name_c);
+            g_free(name_c);
+            property_changed("session_name", [this]()
+                             {
+                                 return g_variant_new_string(session_name.c_str());
+                             });
+        }
+        else if (0 == strcmp(ev.signal_name, "RemoteStatus"))
+        {
+            gchar *remote_c = nullptr;
+            gboolean reachable = false;
+            g_variant_get(params, "(sb)", &remote_c, &reachable);
+            std::string remote(remote_c);
+            g_free(remote_c);
+            if (!remote_backoff)
+            {
+                return;
+            }
+
+            bool changed = (reachable ? remote_backoff->Succeeded(remote)
+                                      : remote_backoff->Failed(remote));
+            if (changed)
+            {
+                LogVerb2(reachable ? "Remote " + remote + " is reachable again"
+                                   : "Remote " + remote + " failed, other sessions back off");
+                if (remote_backoff_changed)
+                {
+                    remote_backoff_changed();
+                }
+            }
+        }
+    }
+
+    /**
+     *  Callback method which is called each time a D-Bus method call occurs
+     *  on this SessionObject.
+     *
+     *  In most cases the method call is just proxied to the client backend
+     *  process after an access control check has been performed.  Many of the
+     *  calls can be accessed by the owner or designated user IDs, and the
+     *  most sensitive methods are only accessible to the owner of this
+     *  session.
+     *
+     * @param conn       D-Bus connection where the method call occurred
+     * @param sender     D-Bus bus name of the sender of the method call
+     * @param obj_path   D-Bus object path of the target object.
+     * @param intf_name  D-Bus interface of the method call
+     * @param method_name D-Bus method name to be executed
+     * @param params     GVariant Glib2 object containing the arguments for
+     *                   the method call
+     * @param invoc      GDBusMethodInvocation where the response/result of
+     *                   the method call will be returned.
+     */
+    void callback_method_call(GDBusConnection *conn,
+                              const std::string sender,
+                              const std::string obj_path,
+                              const std::string intf_name,
+                              const std::string method_name,
+                              GVariant *params,
+                              GDBusMethodInvocation *invoc)
+    {
+        try
+        {
+            if (!be_proxy)
+            {
+                THROW_DBUSEXCEPTION("SessionObject", "No backend proxy connection available. Backend died?");
+            }
+
+            if (!registered)
+            {
+                THROW_DBUSEXCEPTION("SessionObject",
+                                    "Session registration not completed");
+            }
+
+            // The backend bus name is watched, so a backend process which
+            // has gone away is detected without calling it first
+            if (!backend_alive)
+            {
+                THROW_DBUSEXCEPTION("SessionObject",
+                                    "Backend process is not running");
+            }
+
+            // Resolving the requester may involve slow NSS lookups;
+            // only do it if the message will be used
+            if (LogEnabled(LogCategory::DEBUG))
+            {
+                std::stringstream msg;
+                msg << "Session operation: " << method_name
+                    << ", requester:  " << lookup_username(GetUID(sender));
+                Debug(msg.str());
+            }
+
+            if ("Connect" == method_name)
+            {
+                CheckACL(sender);
+
+                if (DCOstatus::MODIFIED == dco_status)
+                {
+                    be_proxy->SetPropertyAsync("dco", g_variant_new_boolean(dco));
+                    dco_status = DCOstatus::LOCKED;
+                }
+
+                std::shared_ptr<bool> alive = object_alive;
+                be_proxy->GetPropertyAsync("log_level",
+                                           [this, alive](DBusProxyAsyncCall& call)
+                                           {
+                                               if (!*alive)
+                                               {
+                                                   return;
+                                               }
+                                               try
+                                               {
+                                                   GVariant *v = call.GetResult();
+                                                   SetLogLevel(g_variant_get_uint32(v));
+                                                   g_variant_unref(v);
+                                               }
+                                               catch (const DBusException&)
+                                               {
+                                                   LogCritical("Could not retrieve the client backend log level");
+                                               }
+                                           });
+                LogVerb2("Starting connection");
+                admitted_backend_call(invoc, "Connect");
+                return;
+            }
+            else if ("Restart" == method_name)
+            {
+                CheckACL(sender, true);
+                LogVerb2("Restarting connection");
+                admitted_backend_call(invoc, "Restart");
+                return;
+            }
+            else if ("Pause" == method_name)
+            {
+                CheckACL(sender, true);
+                // FIXME: Should check that params contains only the expected formatting
+                backend_call(invoc, "Pause", params, false);
+                LogVerb2("Pausing connection");
+                return;
+            }
+            else if ("Resume"  == method_name)
+            {
+                CheckACL(sender, true);
+                backend_call(invoc, "Resume", nullptr, false);
+                LogVerb2("Resuming connection");
+                return;
+            }
+            else if ("Disconnect" == method_name)
+            {
+                CheckACL(sender, true);
+                LogVerb2("Disconnecting connection");
+
+                // The reconnect state is only kept for sessions which
+                // ended unexpectedly
+                if (reconnect_cache)
+                {
+                    reconnect_cache->Forget(GetOwnerUID(), config_path);
+                }
+
+                // The call is completed once the backend has stopped
+                shutdown(false, true, invoc);
+                return;
+            }
+            else if ("Ready" == method_name)
+            {
+                CheckACL(sender);
+                backend_call(invoc, "Ready", nullptr, false);
+                return;
+            }
+            else if ("UserInputQueueGetTypeGroup" == method_name
+                     || "UserInputQueueFetch" == method_name
+                     || "UserInputQueueCheck" == method_name
+                     || "UserInputQueueFetchAll" == method_name
+                     || "UserInputProvide" == method_name
+                     || "UserInputProvideResponses" == method_name)
+            {
+                CheckACL(sender);
+                backend_call(invoc, method_name, params, true);
+                return;
+            }
+            else if ("AccessGrant" == method_name)
+            {
+                CheckOwnerAccess(sender);
+
+                uid_t uid = -1;
+                g_variant_get(params, "(u)", &uid);
+                GrantAccess(uid);
+                StoreUpdate();
+                g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogInfo("Access granted to UID " + std::to_string(uid));
+                return;
+            }
+            else if ("AccessRevoke" == method_name)
+            {
+                CheckOwnerAccess(sender);
+
+                uid_t uid = -1;
+                g_variant_get(params, "(u)", &uid);
+                RevokeAccess(uid);
+                StoreUpdate();
+                g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogInfo("Access revoked for UID " + std::to_string(uid));
+                return;
+            }
+            else if ("AccessGrantGroup" == method_name)
+            {
+                CheckOwnerAccess(sender);
+
+                gid_t gid = -1;
+                g_variant_get(params, "(u)", &gid);
+                GrantGroupAccess(gid);
+                StoreUpdate();
+                g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogInfo("Access granted to GID " + std::to_string(gid));
+                return;
+            }
+            else if ("AccessRevokeGroup" == method_name)
+            {
+                CheckOwnerAccess(sender);
+
+                gid_t gid = -1;
+                g_variant_get(params, "(u)", &gid);
+                RevokeGroupAccess(gid);
+                StoreUpdate();
+                g_dbus_method_invocation_return_value(invoc, NULL);
+
+                LogInfo("Access revoked for GID " + std::to_string(gid));
+                return;
+            }
+            else if ("LogForward" == method_name
+                     || "LogForwardBatch" == method_name
+                     || "LogForwardCompact" == method_name)
+            {
+                if (restrict_log_access)
+                {
+                    CheckOwnerAccess(sender);
+                }
+                else
+                {
+                    CheckACL(sender);
+                }
+
+                bool enable = false;
+                uint32_t batch_max_events = 0;
+                uint32_t batch_interval = 0;
+                bool compact = ("LogForwardCompact" == method_name);
+                if ("LogForwardBatch" == method_name || compact)
+                {
+                    GLibUtils::checkParams(__func__, params, "(uu)", 2);
+                    batch_max_events = GLibUtils::ExtractValue<uint32_t>(params, 0);
+                    batch_interval = GLibUtils::ExtractValue<uint32_t>(params, 1);
+                    enable = true;
+                }
+                else
+                {
+                    GLibUtils::checkParams(__func__, params, "(b)", 1);
+                    enable = GLibUtils::ExtractValue<bool>(params, 0);
+                }
+
+                if (enable)
+                {
+                    // Any previous forwarding to this receiver must be
+                    // removed first, as the log service shares the log
+                    // proxy between all sessions of the same receiver
+                    log_proxies.erase(sender);
+                    SessionLogProxy::Ptr lp;
+                    lp.reset(new SessionLogProxy(signal_router->GetConnection(),
+                                                 sender,
+                                                 DBusObject::GetObjectPath(),
+                                                 batch_max_events,
+                                                 batch_interval,
+                                                 compact));
+                    log_proxies[sender] = lp;
+                    LogInfo("Added log forwarding to " + sender
+                            + (batch_max_events > 0 ? " (batched)" : "")
+                            + (compact ? " (compact)" : ""));
+                }
+                else
+                {
+                    try
+                    {
+                        log_proxies.at(sender).reset();
+                        log_proxies.erase(sender);
+                    }
+                    catch(const std::exception& e)
+                    {
+                        LogCritical("logproxies.erase(" + sender + ") failed:" + std::string(e.what()));
+                    }
+                    LogInfo("Removed log forwarding from " + sender);
+                }
+                g_dbus_method_invocation_return_value(invoc, NULL);
+                return;
+            }
+            else if ("StatisticsSubscribe" == method_name)
+            {
+                CheckACL(sender);
+
+                GLibUtils::checkParams(__func__, params, "(u)", 1);
+                unsigned int interval = GLibUtils::ExtractValue<uint32_t>(params, 0);
+                if (0 < interval)
+                {
+                    stats_subscribe(sender, interval);
+                    LogVerb2("Statistics subscription from " + sender
+                             + ", interval " + std::to_string(interval) + "ms");
+                }
+                else
+                {
+                    stats_unsubscribe(sender);
+                    LogVerb2("Statistics subscription removed for " + sender);
+                }
+            }
+            else if ("GetStatusSince" == method_name)
+            {
+                CheckACL(sender);
+
+                GLibUtils::checkParams(__func__, params, "(t)", 1);
+                uint64_t seq = GLibUtils::ExtractValue<uint64_t>(params, 0);
+                if (!sig_statuschg)
+                {
+                    THROW_DBUSEXCEPTION("SessionObject",
+                                        "No status changes available");
+                }
+                g_dbus_method_invocation_return_value(invoc,
+                                                      sig_statuschg->GetStatusSince(seq));
+                return;
+            }
+            else if ("FetchLogHistory" == method_name)
+            {
+                if (restrict_log_access)
+                {
+                    CheckOwnerAccess(sender);
+                }
+                else
+                {
+                    CheckACL(sender);
+                }
+
+                GLibUtils::checkParams(__func__, params, "(u)", 1);
+                backend_call(invoc, "FetchLogHistory", params, true);
+                return;
+            }
+            else if ("GetStatsHistory" == method_name)
+            {
+                CheckACL(sender);
+                GLibUtils::checkParams(__func__, params, "(tu)", 2);
+                backend_call(invoc, "GetStatsHistory", params, true);
+                return;
+            }
+            else if ("DumpLogHistory" == method_name)
+            {
+                if (restrict_log_access)
+                {
+                    CheckOwnerAccess(sender);
+                }
+                else
+                {
+                    CheckACL(sender);
+                }
+
+                backend_call(invoc, "DumpLogHistory", nullptr, true);
+                return;
+            }
+            else
+            {
+                std::string errmsg = "No method named" + method_name + " is available";
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
+                                                              errmsg.c_str());
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+                LogWarn(errmsg);
+                return;
+            }
+            g_dbus_method_invocation_return_value(invoc, NULL);
+        }
+        catch (DBusException& dberr)
+        {
+            bool do_selfdestruct = false;
+            std::string errmsg;
+
+            Debug("Exception [callback_method_call("+ method_name + ")]: "
+                  + dberr.GetRawError());
+
+            if (!registered && "Disconnect" == method_name)
+            {
+                //
+                // This is a special case handling.  If a backend VPN client
+                // process has not registered and a front-end wants to
+                // shutdown this session, this needs to be handled specially.
+                //
+                // This can happen if the VPN client process dies before
+                // starting the registration process.  In this case, we
+                // will not have a valid be_proxy object to the backend,
+                // so any kind of attempt to communicate with the (possibly
+                // dead) backend will just completely fail.  So we just aim
+                // for the selfdestruct.
+                //
+                // In regards to the front-end caller, this is also not
+                // strictly an error. The caller wants to get rid of this
+                // lingering session object by calling the Disconnect method.
+                // So we do not return any error, but just ensure this
+                // session is cleaned up properly.
+                //
+                try
+                {
+                    LogCritical("Forced session shutdown before backend registration");
+                    do_selfdestruct = true;
+                }
+                catch (DBusException& dberr)
+                {
+                }
+                StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED,
+                             "Backend process did not complete registration");
+                g_dbus_method_invocation_return_value(invoc, NULL);
+            }
+            else if (!registered)
+            {
+                errmsg = "Backend VPN process is not ready";
+            }
+            else if (!backend_alive)
+            {
+                errmsg = "Backend VPN process has died.  Session is no longer valid.";
+                if (!selfdestruct_complete)
+                {
+                    StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Backend process died");
+                    do_selfdestruct = true;
+                }
+            }
+            else
+            {
+                errmsg = "Failed communicating with VPN backend: "
+                       + std::string(dberr.GetRawError());
+            }
+
+            if (registered && !selfdestruct_complete && !do_selfdestruct)
+            {
+                LogCritical(errmsg);
+            }
+
+            if (!errmsg.empty())
+            {
+                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
+                                                          errmsg.c_str());
+                g_dbus_method_invocation_return_gerror(invoc, err);
+                g_error_free(err);
+            }
+
+            if (do_selfdestruct)
+            {
+                selfdestruct(conn);
+            }
+        }
+        catch (DBusCredentialsException& excp)
+        {
+            LogWarn(excp.what());
+            excp.SetDBusError(invoc);
+        }
+    };
+
+
+    /**
+     *   Callback which is used each time a SessionObject D-Bus property is
+     *   being read.
+     *
+     *   Only the 'owner' is accessible by anyone, otherwise it must either
+     *   be the session owner or UIDs granted access to this session.
+     *
+     * @param conn           D-Bus connection this event occurred on
+     * @param sender         D-Bus bus name of the requester
+     * @param obj_path       D-Bus object path to the object being requested
+     * @param intf_name      D-Bus interface of the property being accessed
+     * @param property_name  The property name being accessed
+     * @param error          A GLib2 GError object if an error occurs
+     *
+     * @return  Returns a GVariant Glib2 object containing the value of the
+     *          requested D-Bus object property.  On errors, NULL must be
+     *          returned and the error must be returned via a GError
+     *          object.
+     */
+    GVariant * callback_get_property(GDBusConnection *conn,
+                                     const std::string sender,
+                                     const std::string obj_path,
+                                     const std::string intf_name,
+                                     const std::string property_name,
+                                     GError **error)
+    {
+        if (!registered)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_PENDING,
+                        "Session not active");
+            return NULL;
+        }
+
+        try
+        {
+            CheckACL_allowRoot(sender);
+        }
+        catch (DBusCredentialsException& excp)
+        {
+            LogWarn(excp.what());
+            excp.SetDBusError(error, G_IO_ERROR, G_IO_ERROR_FAILED);
+            return NULL;
+        }
+        catch (const DBusException& excp)
+        {
+            std::string err(excp.what());
+
+            if (err.find("Could not get UID of name") != std::string::npos)
+            {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                            "Backend service unavailable");
+            }
+            else
+            {
+                LogCritical(excp.what());
+                excp.SetDBusError(error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE);
+            }
+            return NULL;
+        }
+
+
+        GVariant *ret = NULL;
+        if ("owner" == property_name)
+        {
+            ret = GetOwner();
+        }
+        else if ("device_path" == property_name)
+        {
+            try
+            {
+                ret = be_proxy->GetProperty("device_path");
+            }
+            catch (DBusException&)
+            {
+                g_set_error(error,
+                            G_IO_ERROR,
+                            G_IO_ERROR_PENDING,
+                            "Device path not available");
+                return NULL;
+            }
+        }
+        else if ("restrict_log_access" == property_name)
+        {
+            ret = g_variant_new_boolean (restrict_log_access);
+        }
+        else if ("last_log" == property_name)
+        {
+            try
+            {
+                ret = be_proxy->GetProperty("last_log_line");
+            }
+            catch (DBusException&)
+            {
+                ret = GLibUtils::CreateEmptyBuilderFromType("a{sv}");
+            }
+        }
+        else if ("session_created" == property_name)
+        {
+            ret = g_variant_new_uint64(session_created);
+        }
+        else if ("connect_timing" == property_name)
+        {
+            ret = connect_timing.GetRelativeGVariant();
+        }
+        else if ("status" == property_name)
+        {
+            try
+            {
+                if (!be_proxy->CheckObjectExists())
+                {
+                    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                                "Backend object not available");
+                    return NULL;
+                }
+
+                ret = NULL;
+                if (nullptr != sig_statuschg)
+                {
+                    update_last_status();
+                    ret = sig_statuschg->GetLastStatusChange();
+                }
+                if (NULL == ret)
+                {
+                    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY,
+                                "No status changes have been logged yet");
+                }
+            }
+            catch (DBusException& excp)
+            {
+                g_set_error(error, G_DBUS_ERROR, G_IO_ERROR_FAILED,
+                            "Failed retrieving connection status");
+                ret = NULL;
+            }
+        }
+        else if ("status_seq" == property_name)
+        {
+            ret = g_variant_new_uint64(sig_statuschg
+                                       ? sig_statuschg->GetStatusSequence()
+                                       : 0);
+        }
+        else if ("statistics" == property_name)
+        {
+            try
+            {
+                if (!be_proxy->CheckObjectExists())
+                {
+                    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                                "Backend object not available");
+                    return NULL;
+                }
+                ret = be_proxy->GetProperty("statistics");
+            }
+            catch (DBusException& exp)
+            {
+                g_set_error(error, G_DBUS_ERROR, G_IO_ERROR_FAILED,
+                            "Failed retrieving connection statistics");
+                ret = NULL;
+            }
+        }
+        else if ("statistics_layout" == property_name
+                 || "statistics_packed" == property_name
+                 || "path_quality" == property_name)
+        {
+            try
+            {
+                ret = be_proxy->GetProperty(property_name);
+            }
+            catch (DBusException& exp)
+            {
+                g_set_error(error, G_DBUS_ERROR, G_IO_ERROR_FAILED,
+                            "Failed retrieving connection statistics");
+                ret = NULL;
+            }
+        }
+        else if ("device_name" == property_name)
+        {
+            try
+            {
+                ret = be_proxy->GetProperty("device_name");
+            }
+            catch (DBusException&)
+            {
+                g_set_error(error,
+                            G_IO_ERROR,
+                            G_IO_ERROR_PENDING,
+                            "Device path not available");
+                return NULL;
+            }
+        }
+        else if ("config_path" == property_name)
+        {
+            ret = g_variant_new_string (config_path.c_str());
+        }
+        else if ("config_name" == property_name)
+        {
+            ret = g_variant_new_string (config_name.c_str());
+        }
+        else if ("dco" == property_name)
+        {
+            try
+            {
+                ret = be_proxy->GetProperty("dco");
+            }
+            catch (DBusException&)
+            {
+                // If the DCO flag of the backend process could not be
+                // retrieved, return our current setting
+                ret = g_variant_new_boolean(dco);
+            }
+        }
+        else if ("session_name" == property_name)
+        {
+            ret = g_variant_new_string(session_name.c_str());
+        }
+        else if ("backend_pid" == property_name)
+        {
+            ret = g_variant_new_uint32 (backend_pid);
+        }
+        else if ("connect_priority" == property_name)
+        {
+            ret = g_variant_new_uint32(connect_priority);
+        }
+        else if ("bundle_id" == property_name)
+        {
+            ret = g_variant_new_string (bundle_id.c_str());
+        }
+        else if ("log_forwards" == property_name)
+        {
+            std::vector<std::string> paths = {};
+            for (const auto& it : log_proxies)
+            {
+                paths.push_back(it.second->GetLogProxyPath());
+            }
+            ret = GLibUtils::GVariantFromVector(paths);
+        }
+        else if ("log_verbosity" == property_name)
+        {
+            ret = g_variant_new_uint32 (GetLogLevel());
+        }
+        else if ("public_access" == property_name)
+        {
+            ret = g_variant_new_boolean(GetPublicAccess());
+        }
+        else if ("acl" == property_name)
+        {
+            ret = GLibUtils::GVariantFromVector(GetAccessList());
+        }
+        else if ("acl_groups" == property_name)
+        {
+            ret = GLibUtils::GVariantFromVector(GetGroupAccessList());
+        }
+        else
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_FAILED,
+                        "Unknown property");
+        }
+
+        return ret;
+    };
+
+
+    /**
+     *  Callback method which is used each time a SessionObject property
+     *  is being modified over the D-Bus.
+     *
+     * @param conn           D-Bus connection this event occurred on
+     * @param sender         D-Bus bus name of the requester
+     * @param obj_path       D-Bus object path to the object being requested
+     * @param intf_name      D-Bus interface of the property being accessed
+     * @param property_name  The property name being accessed
+     * @param value          GVariant object containing the value to be stored
+     * @param error          A GLib2 GError object if an error occurs
+     *
+     * @return Returns a GVariantBuilder object which will be used by the
+     *         D-Bus library to issue the required PropertiesChanged signal.
+     *         If an error occurres, the DBusPropertyException is thrown.
+     */
+    GVariantBuilder * callback_set_property(GDBusConnection *conn,
+                                            const std::string sender,
+                                            const std::string obj_path,
+                                            const std::string intf_name,
+                                            const std::string property_name,
+                                            GVariant *value,
+                                            GError **error)
+    {
+        /*
+          std::cout << "[SessionObject] set_property(): "
+                  << "sender=" << sender
+                  << ", object_path=" << obj_path
+                  << ", interface=" << intf_name
+                  << ", property=" << property_name
+                  << std::endl;
+        */
+        if (!registered)
+        {
+            g_set_error(error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_PENDING,
+                        "Session not active");
+            return NULL;
+        }
+
+        try
+        {
+            if (!restrict_log_access
+                && "log_verbosity" == property_name)
+            {
+                CheckACL(sender);
+            }
+            else
+            {
+                CheckOwnerAccess(sender);
+            }
+        }
+        catch (DBusCredentialsException& excp)
+        {
+            LogWarn(excp.what());
+            Debug("SetProperty - Object path: " + obj_path
+                  + ", interface=" + intf_name
+                  + ", property_name=" + property_name
+                  + ", sender=" + sender);
+            throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                        obj_path, intf_name, property_name,
+                                        excp.what());
+        }
+
+        try
+        {
+            if (("dco" == property_name) && be_conn)
+            {
+                if (DCOstatus::LOCKED != dco_status)
+                {
+                    dco = g_variant_get_boolean(value);
+                    dco_status = DCOstatus::MODIFIED;
+                    return build_set_property_response(property_name, dco);
+                }
+                else
+                {
+                    throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                obj_path, intf_name,
+                                                property_name,
+                                                "DCO setting cannot be changed now");
+                }
+            }
+            else if ("connect_priority" == property_name)
+            {
+                connect_priority = g_variant_get_uint32(value);
+                return build_set_property_response(property_name,
+                                                   (guint32) connect_priority);
+            }
+            else if (("restrict_log_access" == property_name) && be_conn)
+            {
+                restrict_log_access = g_variant_get_boolean(value);
+                StoreUpdate();
+                return build_set_property_response(property_name,
+                                                   restrict_log_access);
+            }
+            else if (("log_verbosity" == property_name) && be_conn)
+            {
+                unsigned int log_verb = g_variant_get_uint32(value);
+                try
+                {
+                    SetLogLevel(log_verb);
+                }
+                catch (const LogException& excp)
+                {
+                    throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                                obj_path, intf_name,
+                                                property_name,
+                                                excp.what());
+                }
+
+                try
+                {
+                    if (be_proxy)
+                    {
+                        be_proxy->SetProperty("log_level", log_verb);
+                    }
+                }
+                catch (const DBusException& e)
+                {
+                    LogCritical("Could not set the VPN backend log level");
+                    Debug("Backend log-level error: "
+                          + std::string(e.GetRawError()));
+                }
+                return build_set_property_response(property_name,
+                                                   (guint32) log_verb);
+            }
+            else if (("public_access" == property_name) && conn)
+            {
+                bool acl_public = g_variant_get_boolean(value);
+                SetPublicAccess(acl_public);
+                StoreUpdate();
+                LogInfo("Public access set to "
+                         + (acl_public ? std::string("true") :
+                                         std::string("false"))
+                         + " by uid " + std::to_string(GetUID(sender)));
+                return build_set_property_response(property_name, acl_public);
+            }
+        }
+        catch (DBusException& excp)
+        {
+            throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                        obj_path, intf_name, property_name,
+                                        excp.what());
+        }
+        throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                    obj_path, intf_name, property_name,
+                                    "Invalid property");
+    }
+
+
+    /**
+     *  Clean-up function triggered by the D-Bus library when an object
+     *  is removed from the D-Bus
+     */
+    void callback_destructor ()
+    {
+        if( nullptr != sig_statuschg)
+        {
+            delete sig_statuschg;
+            sig_statuschg = nullptr;
+        }
+    };
+
+
+private:
+    DBusSignalRouter::Ptr signal_router;
+    std::map<std::string, DBusSignalRouter::HandlerId> signal_handlers;
+    bool peer_link_enabled = false;
+    DBusPeerLink::Ptr be_link = nullptr;   ///< See open_peer_link()
+    DBusSignalRouter::Ptr peer_signal_router = nullptr;
+    std::vector<DBusSignalRouter::HandlerId> peer_signal_handlers;
+    PropertyCollection properties{this};
+    unsigned int default_session_log_level = 4; // LogCategory::INFO messages
+    std::function<void()> remove_callback;
+    std::function<void()> index_update_callback;
+    std::function<void()> store_update_callback;
+    std::function<void(bool)> status_board_callback;
+    unsigned int status_board_interval = 0;
+    StatusEvent board_status;
+    uint64_t board_updated = 0;
+    uint32_t board_layout_id = 0;
+    std::vector<size_t> board_counter_index;  ///< BYTES_IN, BYTES_OUT, PACKETS_IN, PACKETS_OUT
+    uint64_t board_counters[4] = {};
+    ReconnectCache::Ptr reconnect_cache;
+    ConfigCache::Ptr config_cache;
+    RemoteBackoff::Ptr remote_backoff;
+    std::function<void()> remote_backoff_changed = nullptr;
+    std::string known_device_name;
+    DBusProxy *be_proxy;
+    bool restrict_log_access;
+    SessionLogProxyList log_proxies= {};
+    std::time_t session_created;
+    ConnectTiming connect_timing;
+    bool connect_timing_reported = false;
+    std::string config_path;
+    std::string config_name;
+    std::string bundle_id;             ///< See SetBundle()
+    std::string session_name;          ///< From the SessionName signal
+    unsigned int bundle_index = 0;
+    unsigned int bundle_size = 0;
+    bool dco = false;
+    DCOstatus dco_status = DCOstatus::UNCHANGED;
+    SessionStatusChange *sig_statuschg;
+    std::string backend_token;
+    pid_t backend_pid;
+    GDBusConnection *be_conn;
+    std::string be_busname;
+    std::string be_path;
+    bool registered;
+    bool selfdestruct_complete;
+    std::mutex selfdestruct_guard;
+
+    /// Cleared when this object is destroyed; checked by the completion
+    /// handlers of asynchronous backend calls
+    std::shared_ptr<bool> object_alive = std::make_shared<bool>(true);
+
+    /// Watch of the backend bus name, see backend_vanished()
+    guint be_watch = 0;
+    bool backend_alive = false;
+
+    bool shutdown_pending = false;
+    bool shutdown_forced = false;
+    bool shutdown_selfdestruct = false;
+    guint shutdown_timer = 0;
+    std::vector<GDBusMethodInvocation *> shutdown_invocs = {};
+    std::vector<std::function<void()>> shutdown_callbacks = {};
+
+    /// Last CONNECTION status minor code reported by the backend
+    StatusMinor connection_state = StatusMinor::UNSET;
+    bool paused_for_sleep = false;  ///< See PauseForSleep()
+
+    /// Milliseconds to wait for the backend process to exit on shutdown
+    static const unsigned int shutdown_timeout_ms = 2000;
+
+    ConnectAdmission::Ptr connect_admission;
+    unsigned int connect_priority = 0;  ///< See ConnectAdmission::Request()
+    guint admission_timer = 0;
+
+    /// Seconds a connection attempt may hold its connect admission slot
+    static const unsigned int admission_timeout_s = 60;
+
+    struct StatsSubscriber
+    {
+        unsigned int interval_ms;
+        guint watch_id;
+    };
+    std::map<std::string, StatsSubscriber> stats_subscribers = {};
+    unsigned int stats_interval = 0;
+
+
+    /**
+     *  Adds or updates a subscription to the Statistics signal.  The
+     *  subscription is removed automatically if the subscriber
+     *  disconnects from the D-Bus.
+     *
+     * @param subscriber   Unique bus name of the subscriber
+     * @param interval_ms  Requested signal interval, in milliseconds
+     */
+    void stats_subscribe(const std::string& subscriber,
+                         const unsigned int interval_ms)
+    {
+        auto it = stats_subscribers.find(subscriber);
+        if (stats_subscribers.end() != it)
+        {
+            it->second.interval_ms = interval_ms;
+        }
+        else
+        {
+            guint watch = g_bus_watch_name_on_connection(
+                                signal_router->GetConnection(),
+                                subscriber.c_str(),
+                                G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                nullptr,
+                                stats_subscriber_vanished,
+                                this, nullptr);
+            stats_subscribers[subscriber] = {interval_ms, watch};
+        }
+        update_stats_interval();
+    }
+
+
+    /**
+     *  Removes a subscription to the Statistics signal
+     *
+     * @param subscriber   Unique bus name of the subscriber
+     */
+    void stats_unsubscribe(const std::string& subscriber)
+    {
+        auto it = stats_subscribers.find(subscriber);
+        if (stats_subscribers.end() == it)
+        {
+            return;
+        }
+        g_bus_unwatch_name(it->second.watch_id);
+        stats_subscribers.erase(it);
+        update_stats_interval();
+    }
+
+
+    /**
+     *  Picks the status board counters from a Statistics signal.  The
+     *  counter layout is looked up from the backend the first time a
+     *  layout is seen.
+     *
+     * @param params  GVariant with the Statistics signal parameters
+     *
+     * @return Returns true if the counters were updated
+     */
+    bool update_board_counters(GVariant *params)
+    {
+        guint32 layout_id = 0;
+        GVariant *counters = nullptr;
+        g_variant_get(params, "(u@at)", &layout_id, &counters);
+
+        if (layout_id != board_layout_id && be_proxy)
+        {
+            board_counter_index.clear();
+            GVariant *layout = nullptr;
+            try
+            {
+                layout = be_proxy->GetProperty("statistics_layout");
+                auto res = GLibUtils::Unmarshal<std::tuple<uint32_t,
+                                                std::vector<std::string>>>(layout);
+                const std::vector<std::string>& keys = std::get<1>(res);
+                for (const auto& name : {"BYTES_IN", "BYTES_OUT",
+                                         "PACKETS_IN", "PACKETS_OUT"})
+                {
+                    auto k = std::find(keys.begin(), keys.end(), name);
+                    board_counter_index.push_back(k - keys.begin());
+                }
+                board_layout_id = std::get<0>(res);
+            }
+            catch (const DBusException& excp)
+            {
+                Debug("Could not retrieve the statistics layout: "
+                      + std::string(excp.GetRawError()));
+            }
+            if (layout)
+            {
+                g_variant_unref(layout);
+            }
+        }
+
+        bool updated = false;
+        if (layout_id == board_layout_id && !board_counter_index.empty())
+        {
+            gsize n = 0;
+            const guint64 *values = static_cast<const guint64 *>(
+                    g_variant_get_fixed_array(counters, &n, sizeof(guint64)));
+            for (size_t i = 0; i < 4; ++i)
+            {
+                const size_t idx = board_counter_index[i];
+                board_counters[i] = (idx < n ? values[idx] : 0);
+            }
+            board_updated = time(nullptr);
+            updated = true;
+        }
+        g_variant_unref(counters);
+        return updated;
+    }
+
+
+    /**
+     *  Configures the backend to emit the Statistics signal at the
+     *  shortest interval requested by the current subscribers, or to
+     *  stop emitting it when there are no subscribers left.
+     */
+    void update_stats_interval()
+    {
+        unsigned int interval = status_board_interval;
+        for (const auto& sub : stats_subscribers)
+        {
+            if (0 == interval || sub.second.interval_ms < interval)
+            {
+                interval = sub.second.interval_ms;
+            }
+        }
+        if (interval == stats_interval || !be_proxy)
+        {
+            return;
+        }
+        std::shared_ptr<bool> alive = object_alive;
+        be_proxy->CallAsync("StatisticsInterval",
+                            g_variant_new("(u)", interval),
+                            [this, alive](DBusProxyAsyncCall& call)
+                            {
+                                try
+                                {
+                                    g_variant_unref(call.GetResult());
+                                }
+                                catch (const DBusException& excp)
+                                {
+                                    if (*alive)
+                                    {
+                                        Debug("Failed setting the statistics interval: "
+                                              + std::string(excp.GetRawError()));
+                                    }
+                                }
+                            });
+        stats_interval = interval;
+    }
+
+
+    /**
+     *  Forwards a method call to the VPN client backend without waiting
+     *  for the response.  The D-Bus method call is completed when the
+     *  backend has responded, so a slow backend does not block the
+     *  session manager.
+     *
+     * @param invoc          GDBusMethodInvocation of the call to complete
+     * @param method         std::string with the backend method to call
+     * @param params         GVariant with the method arguments, may be
+     *                       nullptr
+     * @param return_result  If true, the response from the backend is
+     *                       returned to the caller
+     */
+    void backend_call(GDBusMethodInvocation *invoc, const std::string& method,
+                      GVariant *params, const bool return_result)
+    {
+        std::shared_ptr<bool> alive = object_alive;
+        be_proxy->CallAsync(method, params,
+                            [this, alive, invoc, return_result](DBusProxyAsyncCall& call)
+                            {
+                                std::string errmsg;
+                                try
+                                {
+                                    GVariant *res = call.GetResult();
+                                    g_dbus_method_invocation_return_value(invoc,
+                                                                          return_result ? res : NULL);
+                                    g_variant_unref(res);
+                                    return;
+                                }
+                                catch (const DBusException& excp)
+                                {
+                                    errmsg = "Failed communicating with VPN backend: "
+                                             + std::string(excp.GetRawError());
+                                }
+                                catch (const DBusProxyAccessDeniedException& excp)
+                                {
+                                    errmsg = excp.what();
+                                }
+
+                                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
+                                                                              errmsg.c_str());
+                                g_dbus_method_invocation_return_gerror(invoc, err);
+                                g_error_free(err);
+                                if (*alive && backend_alive)
+                                {
+                                    LogCritical(errmsg);
+                                }
+                            });
+    }
+
+
+    /**
+     *  Calls Connect, Restart or Resume in the backend once the connect
+     *  admission control lets this session connect.  If the session is
+     *  queued, the D-Bus caller gets its reply right away and the backend
+     *  is called when the session is admitted.
+     *
+     * @param invoc   GDBusMethodInvocation of the D-Bus caller; can be
+     *                nullptr
+     * @param method  std::string with the backend method to call
+     */
+    void admitted_backend_call(GDBusMethodInvocation *invoc,
+                               const std::string& method)
+    {
+        std::shared_ptr<bool> alive = object_alive;
+        auto start = [this, alive, method]()
+                     {
+                         if (*alive)
+                         {
+                             start_admitted(method);
+                         }
+                     };
+        if (connect_admission
+            && !connect_admission->Request(DBusObject::GetObjectPath(),
+                                           (int) connect_priority, start))
+        {
+            LogInfo("Connection start queued, too many sessions are connecting");
+            if (invoc)
+            {
+                g_dbus_method_invocation_return_value(invoc, NULL);
+            }
+            return;
+        }
+
+        start_admission_timer();
+        if (invoc)
+        {
+            backend_call(invoc, method, nullptr, false);
+        }
+        else
+        {
+            start_admitted(method);
+        }
+    }
+
+
+    /**
+     *  Calls a backend method of a connection attempt admitted by the
+     *  connect admission control, without a D-Bus caller
+     *
+     * @param method  std::string with the backend method to call
+     */
+    void start_admitted(const std::string& method)
+    {
+        if (!registered || !be_proxy || shutdown_pending)
+        {
+            release_admission();
+            return;
+        }
+        start_admission_timer();
+
+        std::string action = method;
+        std::transform(action.begin(), action.end(), action.begin(), ::tolower);
+        std::shared_ptr<bool> alive = object_alive;
+        be_proxy->CallAsync(method, nullptr,
+                            [this, alive, action](DBusProxyAsyncCall& call)
+                            {
+                                sleep_call_result(alive, call, action);
+                            });
+    }
+
+
+    /**
+     *  A connection attempt holding a connect admission slot gives it up
+     *  after admission_timeout_s, so a stuck attempt does not block the
+     *  other sessions
+     */
+    void start_admission_timer()
+    {
+        if (!connect_admission || 0 != admission_timer)
+        {
+            return;
+        }
+        admission_timer = g_timeout_add_seconds(admission_timeout_s,
+                                                admission_timeout,
+                                                this);
+    }
+
+
+    static gboolean admission_timeout(gpointer this_ptr)
+    {
+        SessionObject *self = static_cast<SessionObject *>(this_ptr);
+        self->admission_timer = 0;
+        self->release_admission();
+        return G_SOURCE_REMOVE;
+    }
+
+
+    /**
+     *  Gives up the connect admission slot of this session, or its place
+     *  in the queue, and starts the sessions admitted instead
+     */
+    void release_admission()
+    {
+        if (0 != admission_timer)
+        {
+            g_source_remove(admission_timer);
+            admission_timer = 0;
+        }
+        if (!connect_admission)
+        {
+            return;
+        }
+        StartAdmitted(connect_admission,
+                      connect_admission->Release(DBusObject::GetObjectPath()));
+    }
+
+
+    /**
+     * @return Returns true if the status ends the current connection
+     *         attempt; either the connection is established, has stopped
+     *         or is waiting for the user
+     */
+    static bool connect_attempt_done(const StatusEvent& status)
+    {
+        switch (status.minor)
+        {
+        case StatusMinor::CONN_CONNECTED:
+        case StatusMinor::CONN_DISCONNECTED:
+        case StatusMinor::CONN_FAILED:
+        case StatusMinor::CONN_AUTH_FAILED:
+        case StatusMinor::CONN_PAUSED:
+        case StatusMinor::CONN_DONE:
+        case StatusMinor::CFG_ERROR:
+        case StatusMinor::CFG_REQUIRE_USER:
+        case StatusMinor::SESS_AUTH_USERPASS:
+        case StatusMinor::SESS_AUTH_CHALLENGE:
+        case StatusMinor::SESS_AUTH_URL:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+
+    /**
+     *  Completes the asynchronous backend calls done without a D-Bus
+     *  caller, like by PauseForSleep() and ResumeAfterSleep(); errors
+     *  are only logged.
+     */
+    void sleep_call_result(std::shared_ptr<bool> alive,
+                           DBusProxyAsyncCall& call,
+                           const std::string& action)
+    {
+        try
+        {
+            GVariant *res = call.GetResult();
+            if (res)
+            {
+                g_variant_unref(res);
+            }
+        }
+        catch (const DBusException& excp)
+        {
+            if (*alive && backend_alive)
+            {
+                LogError("Failed to " + action + " the connection: "
+                         + std::string(excp.GetRawError()));
+            }
+        }
+        catch (const DBusProxyAccessDeniedException& excp)
+        {
+            if (*alive && backend_alive)
+            {
+                LogError("Failed to " + action + " the connection: "
+                         + std::string(excp.what()));
+            }
+        }
+    }
+
+
+    /**
+     *  Called when the bus name of the VPN client backend has no owner
+     *  any more, which happens when the backend process exits.
+     */
+    static void backend_vanished(GDBusConnection *conn,
+                                 const gchar *name,
+                                 gpointer this_ptr)
+    {
+        SessionObject *self = static_cast<SessionObject *>(this_ptr);
+        self->backend_alive = false;
+        if (self->shutdown_pending)
+        {
+            self->finish_shutdown();
+        }
+    }
+
+
+    static gboolean shutdown_timeout(gpointer this_ptr)
+    {
+        SessionObject *self = static_cast<SessionObject *>(this_ptr);
+        self->shutdown_timer = 0;
+        self->Debug("VPN backend process did not exit in time");
+        self->finish_shutdown();
+        return G_SOURCE_REMOVE;
+    }
+
+
+    /**
+     *  Called when a Statistics subscriber is no longer on the D-Bus
+     */
+    static void stats_subscriber_vanished(GDBusConnection *conn,
+                                          const gchar *name,
+                                          gpointer this_ptr)
+    {
+        SessionObject *self = static_cast<SessionObject *>(this_ptr);
+        try
+        {
+            self->stats_unsubscribe(name);
+        }
+        catch (DBusException& excp)
+        {
+            self->Debug("Failed removing statistics subscriber: "
+                        + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Restores the state of a session from its SessionStore::Entry,
+     *  for sessions being taken over by Adopt()
+     *
+     * @param e  SessionStore::Entry of the session
+     */
+    void restore_entry(const SessionStore::Entry& e)
+    {
+        be_conn = signal_router->GetConnection();
+        be_busname = e.backend_busname;
+        be_path = e.backend_path;
+        backend_token = e.backend_token;
+        backend_pid = e.backend_pid;
+        session_created = e.created;
+        config_name = e.config_name;
+        known_device_name = e.device_name;
+        restrict_log_access = e.restrict_log_access;
+        SetPublicAccess(e.public_access);
+        for (const auto& uid : e.acl)
+        {
+            GrantAccess(uid);
+        }
+        for (const auto& gid : e.acl_groups)
+        {
+            GrantGroupAccess(gid);
+        }
+        bundle_id = e.bundle_id;
+        bundle_index = e.bundle_index;
+        bundle_size = e.bundle_size;
+
+        // The connect phase happened under the previous session manager
+        connect_timing_reported = true;
+    }
+
+
+    /**
+     *  Flag a property as changed, to be included in the next
+     *  PropertiesChanged signal.  That signal is broadcast, so this is
+     *  skipped when the session manager runs without signal broadcasts.
+     *
+     * @param property_name  std::string with the property name
+     * @param getter         Function returning the current value
+     */
+    void property_changed(const std::string& property_name,
+                          PropertyCollection::ValueGetter getter)
+    {
+        if (GetSignalBroadcast())
+        {
+            properties.SetChanged(property_name, getter);
+        }
+    }
+
+
+    /**
+     *  Merges the connect phase milestones of the backend process with
+     *  the ones recorded by the session manager once the tunnel is up.
+     *  The result is logged and made available in the connect_timing
+     *  property.  This is only done for the first connection; the
+     *  milestones of later reconnects are not tracked.
+     */
+    void report_connect_timing()
+    {
+        if (connect_timing_reported || !be_proxy)
+        {
+            return;
+        }
+        connect_timing_reported = true;
+
+        try
+        {
+            GVariant *be_timing = be_proxy->GetProperty("connect_timing");
+            connect_timing.Merge(be_timing);
+            g_variant_unref(be_timing);
+        }
+        catch (const DBusException& excp)
+        {
+            LogVerb2("Could not retrieve backend connect timing: "
+                     + std::string(excp.GetRawError()));
+        }
+
+        LogInfo("connect_timing: " + connect_timing.str());
+        property_changed("connect_timing", [this]()
+                         {
+                             return connect_timing.GetRelativeGVariant();
+                         });
+    }
+
+
+    /**
+     *  Registers a handler for a signal from the VPN client backend
+     *  process, delivered to callback_signal_handler()
+     *
+     * @param sender       Unique bus name of the backend; empty for any
+     * @param path         D-Bus object path of the signal; empty for any
+     * @param signal_name  Signal name to handle
+     */
+    void add_backend_signal_handler(const std::string& sender,
+                                    const std::string& path,
+                                    const std::string& signal_name)
+    {
+        remove_backend_signal_handler(signal_name);
+        signal_handlers[signal_name] = signal_router->AddHandler(
+                                            OpenVPN3DBus_interf_backends,
+                                            sender, path, signal_name,
+                                            [this](const DBusSignalEvent& ev)
+                                            {
+                                                callback_signal_handler(ev);
+                                            });
+    }
+
+
+    void remove_backend_signal_handler(const std::string& signal_name)
+    {
+        auto h = signal_handlers.find(signal_name);
+        if (signal_handlers.end() != h)
+        {
+            signal_router->RemoveHandler(h->second);
+            signal_handlers.erase(h);
+        }
+    }
+
+
+    /**
+     *  Sets up the communication with the VPN client backend process:
+     *  the proxy for the method calls, the watch of its bus name, the
+     *  forwarding of its StatusChange signals and the peer link if
+     *  enabled.  Used both for new backends and for the ones taken over
+     *  by Adopt().
+     */
+    void attach_backend()
+    {
+        be_proxy = new DBusProxy(G_BUS_TYPE_SYSTEM,
+                                 be_busname,
+                                 OpenVPN3DBus_interf_backends,
+                                 be_path);
+        // Don't try to auto start backend services over D-Bus,
+        // The backend service should exists _before_ we try to
+        // communicate with it.
+        be_proxy->SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
+
+        // The backend sends the RegistrationRequest before it has
+        // acquired its well-known bus name.  Its D-Bus objects are
+        // registered before the bus name is requested, so once the
+        // bus name has an owner the backend is ready to respond.
+        DBusNameOwnerWaiter be_ready(be_conn, be_busname);
+        if (!be_ready.Wait(5000))
+        {
+            THROW_DBUSEXCEPTION("SessionObject",
+                                "VPN backend process did not appear "
+                                "on the bus");
+        }
+        ping_backend();
+
+        backend_alive = true;
+        be_watch = g_bus_watch_name_on_connection(be_conn,
+                                                  be_busname.c_str(),
+                                                  G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                  nullptr,
+                                                  backend_vanished,
+                                                  this, nullptr);
+
+        // Setup signal listeners from the backend process
+        // The SessionStatusChange() handler will use the senders
+        // unique bus name to identify if this is a signal this class
+        // responsible for.
+        //
+        // As the be_busname contains the well-known bus name of the
+        // backend VPN client process, we resolve this to the unique
+        // bus name for this signal handling object.
+        sig_statuschg = new SessionStatusChange(be_conn,
+                                                GetUniqueBusID(be_busname),
+                                                OpenVPN3DBus_interf_backends,
+                                                be_path,
+                                                DBusObject::GetObjectPath());
+
+        if (peer_link_enabled)
+        {
+            open_peer_link();
+        }
+    }
+
+
+    /**
+     *  Ties the VPN client backend process to this SessionObject.  Once that
+     *  is done, it calls the RegistrationConfirmation method in the backend
+     *  process where it confirms the backend token and provides the
+     *  VPN configuration D-Bus object path to the backend.
+     */
+    void register_backend()
+    {
+        try
+        {
+            attach_backend();
+
+            // The ownership transfer information is usually retrieved
+            // from configmgr already, while the backend was starting
+            ConfigCache::Info cfg;
+            if (!config_cache || !config_cache->Lookup(config_path, cfg))
+            {
+                auto cfgprx = OpenVPN3ConfigurationProxy(G_BUS_TYPE_SYSTEM,
+                                                         config_path);
+                cfg.owner = cfgprx.GetOwner();
+                cfg.transfer_owner_session = cfgprx.GetTransferOwnerSession();
+                if (config_cache)
+                {
+                    config_cache->Store(config_path, 0, cfg);
+                }
+            }
+            if (cfg.transfer_owner_session)
+            {
+                uid_t curr_owner = GetOwnerUID();
+                TransferOwnership(cfg.owner);
+                // This is needed for the session starter to be allowed to
+                // complete the connecting phase
+                GrantAccess(curr_owner);
+                restrict_log_access = false;
+            }
+
+            GVariant *res_g = be_proxy->Call("RegistrationConfirmation",
+                                             g_variant_new("(soo)",
+                                                           backend_token.c_str(),
+                                                           DBusObject::GetObjectPath().c_str(),
+                                                           config_path.c_str()));
+            if (nullptr == res_g)
+            {
+                THROW_DBUSEXCEPTION("SessionObject",
+                                    "Failed to extract the result of the "
+                                    "RegistrationConfirmation response");
+            }
+
+            gchar *cfgname_c = nullptr;
+            g_variant_get(res_g, "(s)", &cfgname_c);
+            if (!cfgname_c)
+            {
+                // FIXME: Find a way to gracefully handle failed registration
+                return;
+            }
+            config_name = std::string(cfgname_c);
+            restore_reconnect_state();
+            apply_bundle();
+            if (remote_backoff)
+            {
+                SendRemoteBackoff(remote_backoff->Get(0));
+            }
+            Debug("New session registered: " + DBusObject::GetObjectPath());
+            StatusChange(StatusMajor::SESSION, StatusMinor::SESS_NEW,
+                         "session_path=" + DBusObject::GetObjectPath()
+                         + " backend_busname=" + be_busname
+                         + " backend_path=" + be_path);
+            registered = true;
+        }
+        catch (DBusException& err)
+        {
+            THROW_DBUSEXCEPTION("SessionObject", err.what());
+        }
+    }
+
+
+    /**
+     *  Moves the communication with the backend to a private peer-to-peer
+     *  connection.  One end of a socket pair is passed to the backend over
+     *  the system bus, which registers its session object on the new
+     *  connection.  Once this session listens for the backend signals on
+     *  it, the backend is told to send them over the link as well.
+     *
+     *  The signal handlers on the system bus are kept, so signals still
+     *  arrive if the backend falls back to the system bus.  Failures are
+     *  not fatal; the session continues over the system bus.
+     */
+    void open_peer_link()
+    {
+        DBusPeerLink::Ptr link;
+        DBusProxy *peer_proxy = nullptr;
+        try
+        {
+            int local = -1;
+            int remote = -1;
+            DBusPeerLink::SocketPair(local, remote);
+            try
             {
-                CheckACL(sender);
-                try
-                {
-                    GVariant *res = be_proxy->Call("UserInputQueueFetch", params);
-                    g_dbus_method_invocation_return_value(invoc, res);
-                    g_variant_unref(res);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    excp.GenerateDBusError(invoc);
-                }
-                return;
+                be_proxy->CallSendFD("PeerLinkOpen", nullptr, remote);
             }
-            else if ("UserInputQueueCheck" == method_name)
+            catch (...)
             {
-                CheckACL(sender);
-                GVariant *res = be_proxy->Call("UserInputQueueCheck", params);
-                g_dbus_method_invocation_return_value(invoc, res);
-                g_variant_unref(res);
-                return;
+                close(local);
+                close(remote);
+                throw;
             }
-            else if ("UserInputProvide" == method_name)
+            close(remote);
+            link = DBusPeerLink::Connect(local);
+
+            peer_proxy = new DBusProxy(link->GetConnection(), "",
+                                       OpenVPN3DBus_interf_backends, be_path);
+            peer_proxy->SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
+
+            // The backend registers its object on the link once the
+            // connection has been authenticated on its side
+            if (!peer_proxy->CheckObjectExists(50, 2000))
             {
-                CheckACL(sender);
-                try
-                {
-                    GVariant *res = be_proxy->Call("UserInputProvide", params);
-                    g_dbus_method_invocation_return_value(invoc, res);
-                    g_variant_unref(res);
-                }
-                catch (RequiresQueueException& excp)
-                {
-                    // Convert this exception into an error sent back
-                    // to the requester as a D-Bus error instead.
-                    excp.GenerateDBusError(invoc);
-                }
-                return;
+                THROW_DBUSEXCEPTION("SessionObject",
+                                    "Backend object did not appear on the link");
             }
-            else if ("AccessGrant" == method_name)
-            {
-                CheckOwnerAccess(sender);
 
-                uid_t uid = -1;
-                g_variant_get(params, "(u)", &uid);
-                GrantAccess(uid);
-                g_dbus_method_invocation_return_value(invoc, NULL);
+            peer_signal_router = DBusSignalRouter::Get(link->GetConnection());
+            for (const auto& signame : {"AttentionRequired", "StatusChange",
+                                        "Statistics", "RemoteStatus",
+                                        "SessionName"})
+            {
+                peer_signal_handlers.push_back(peer_signal_router->AddHandler(
+                                                   OpenVPN3DBus_interf_backends,
+                                                   "", be_path, signame,
+                                                   [this](const DBusSignalEvent& ev)
+                                                   {
+                                                       callback_signal_handler(ev);
+                                                   }));
+            }
+            sig_statuschg->AddSignalSource(link->GetConnection(),
+                                           OpenVPN3DBus_interf_backends,
+                                           be_path);
 
-                LogInfo("Access granted to UID " + std::to_string(uid));
-                return;
+            GVariant *r = peer_proxy->Call("PeerLinkActivate");
+            if (r)
+            {
+                g_variant_unref(r);
             }
-            else if ("AccessRevoke" == method_name)
+        }
+        catch (const DBusException& excp)
+        {
+            LogWarn("Could not set up the backend link, using the system bus: "
+                    + std::string(excp.GetRawError()));
+            for (const auto& h : peer_signal_handlers)
             {
-                CheckOwnerAccess(sender);
+                peer_signal_router->RemoveHandler(h);
+            }
+            peer_signal_handlers.clear();
+            peer_signal_router.reset();
+            delete peer_proxy;
+            return;
+        }
 
-                uid_t uid = -1;
-                g_variant_get(params, "(u)", &uid);
-                RevokeAccess(uid);
-                g_dbus_method_invocation_return_value(invoc, NULL);
+        delete be_proxy;
+        be_proxy = peer_proxy;
+        be_link = link;
+        Debug("Using a private link to the backend");
+    }
 
-                LogInfo("Access revoked for UID " + std::to_string(uid));
+
+    /**
+     *  Retrieves the reconnect state of the established connection from
+     *  the backend and keeps it in the reconnect cache
+     */
+    void store_reconnect_state()
+    {
+        if (!reconnect_cache || !be_proxy)
+        {
+            return;
+        }
+        try
+        {
+            GVariant *res = be_proxy->Call("FetchReconnectState");
+            if (!res)
+            {
                 return;
             }
-            else if ("LogForward" == method_name)
+            ReconnectCache::State state;
+            if (g_variant_is_of_type(res, G_VARIANT_TYPE("(a{ss})")))
             {
-                if (restrict_log_access)
-                {
-                    CheckOwnerAccess(sender);
-                }
-                else
+                GVariantIter *it = nullptr;
+                g_variant_get(res, "(a{ss})", &it);
+                gchar *key = nullptr;
+                gchar *value = nullptr;
+                while (g_variant_iter_loop(it, "{ss}", &key, &value))
                 {
-                    CheckACL(sender);
-                }
-
-                GLibUtils::checkParams(__func__, params, "(b)", 1);
-                bool enable = GLibUtils::ExtractValue<bool>(params, 0);
-                if (enable)
-                {
-                    log_proxies[sender].reset(
-                            new SessionLogProxy(DBusSignalSubscription::GetConnection(),
-                                                sender,
-                                                DBusObject::GetObjectPath()));
-                    LogInfo("Added log forwarding to " + sender);
-                }
-                else
-                {
-                    try
-                    {
-                        log_proxies.at(sender).reset();
-                        log_proxies.erase(sender);
-                    }
-                    catch(const std::exception& e)
-                    {
-                        LogCritical("logproxies.erase(" + sender + ") failed:" + std::string(e.what()));
-                    }
-                    LogInfo("Removed log forwarding from " + sender);
+                    state[key] = value;
                 }
-                g_dbus_method_invocation_return_value(invoc, NULL);
-                return;
+                g_variant_iter_free(it);
             }
-            else
+            g_variant_unref(res);
+            reconnect_cache->Store(GetOwnerUID(), config_path, std::move(state));
+        }
+        catch (const DBusException& excp)
+        {
+            Debug("Could not retrieve the reconnect state: "
+                  + std::string(excp.what()));
+        }
+    }
+
+
+    /**
+     *  Hands the reconnect state a previous session of the same user and
+     *  configuration profile left behind to the new backend process
+     */
+    void restore_reconnect_state()
+    {
+        if (!reconnect_cache)
+        {
+            return;
+        }
+        ReconnectCache::State state = reconnect_cache->Take(GetOwnerUID(),
+                                                            config_path);
+        if (state.empty())
+        {
+            return;
+        }
+
+        GVariantBuilder *b = g_variant_builder_new(G_VARIANT_TYPE("a{ss}"));
+        for (const auto& kv : state)
+        {
+            g_variant_builder_add(b, "{ss}", kv.first.c_str(), kv.second.c_str());
+        }
+        try
+        {
+            GVariant *res = be_proxy->Call("SetReconnectState",
+                                           g_variant_new("(a{ss})", b));
+            if (res)
             {
-                std::string errmsg = "No method named" + method_name + " is available";
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
-                                                              errmsg.c_str());
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-                LogWarn(errmsg);
-                return;
+                g_variant_unref(res);
             }
-            g_dbus_method_invocation_return_value(invoc, NULL);
+            LogVerb2("Reusing the reconnect state of an earlier session");
         }
-        catch (DBusException& dberr)
+        catch (const DBusException& excp)
         {
-            bool do_selfdestruct = false;
-            std::string errmsg;
+            Debug("Could not restore the reconnect state: "
+                  + std::string(excp.what()));
+        }
+        g_variant_builder_unref(b);
+    }
 
-            Debug("Exception [callback_method_call("+ method_name + ")]: "
-                  + dberr.GetRawError());
 
-            if (!registered && "Disconnect" == method_name)
+    /**
+     *  Tells the backend process about the bundle this session is part
+     *  of, see SetBundle()
+     */
+    void apply_bundle()
+    {
+        if (bundle_id.empty())
+        {
+            return;
+        }
+        try
+        {
+            GVariant *res = be_proxy->Call("SetBundle",
+                                           g_variant_new("(suu)",
+                                                         bundle_id.c_str(),
+                                                         bundle_index,
+                                                         bundle_size));
+            if (res)
             {
-                //
-                // This is a special case handling.  If a backend VPN client
-                // process has not registered and a front-end wants to
-                // shutdown this session, this needs to be handled specially.
-                //
-                // This can happen if the VPN client process dies before
-                // starting the registration process.  In this case, we
-                // will not have a valid be_proxy object to the backend,
-                // so any kind of attempt to communicate with the (possibly
-                // dead) backend will just completely fail.  So we just aim
-                // for the selfdestruct.
-                //
-                // In regards to the front-end caller, this is also not
-                // strictly an error. The caller wants to get rid of this
-                // lingering session object by calling the Disconnect method.
-                // So we do not return any error, but just ensure this
-                // session is cleaned up properly.
-                //
-                try
-                {
-                    LogCritical("Forced session shutdown before backend registration");
-                    do_selfdestruct = true;
-                }
-                catch (DBusException& dberr)
-                {
-                }
-                StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED,
-                             "Backend process did not complete registration");
-                g_dbus_method_invocation_return_value(invoc, NULL);
+                g_variant_unref(res);
             }
-            else if (!registered)
+        }
+        catch (const DBusException& excp)
+        {
+            LogError("Could not add the session to bundle " + bundle_id
+                     + ": " + std::string(excp.GetRawError()));
+        }
+    }
+
+
+    /**
+     * Simple ping-pong game between this SessionObject and its VPN client
+     * backend.  If the backend does not respond, we treat it as dead and will
+     * start to clean-up this session.
+     *
+     * @return  Returns True if the backend process is alive, otherwise False.
+     */
+    bool ping_backend()
+    {
+        if (nullptr == be_proxy)
+        {
+            THROW_DBUSEXCEPTION("SessionObject",
+                                "No backend proxy connection established, "
+                                "cannot ping backend");
+        }
+
+        GVariant *res_g = NULL;
+        try {
+            // This Ping() is the BackendClientObject responding,
+            // which ensures the VPN client process is initialized
+            res_g = be_proxy->Call("Ping");
+        }
+        catch (DBusException &dbserr)
+        {
+            res_g = NULL;
+            Debug(be_busname, be_path, backend_pid, std::string(dbserr.what()));
+        }
+        if (NULL == res_g)
+        {
+            THROW_DBUSEXCEPTION("SessionObject",
+                                "VPN backend process unavailable, "
+                                "does not respond to internal Ping()");
+        }
+
+        bool ret = false;
+        g_variant_get(res_g, "(b)", &ret);
+        g_variant_unref(res_g);
+        return ret;
+    }
+
+
+    /**
+     * Fetches the last backend status and compares to what we have
+     * registered.  If there is a mismatch, we might have missed a signal -
+     * so register it and send it again.
+     */
+    void update_last_status()
+    {
+        if (!sig_statuschg)
+        {
+            return;
+        }
+
+        try
+        {
+            GVariant *be_status = nullptr;
+            be_status = be_proxy->GetProperty("status");
+            if (!sig_statuschg->CompareStatus(be_status))
             {
-                errmsg = "Backend VPN process is not ready";
+                sig_statuschg->ProxyStatus(be_status);
             }
-            else if (!ping)
+        }
+        catch (DBusException& excp)
+        {
+            // Ignore these failures for now.  It most commonly means
+            // the backend process has closed/shut-down - this is scenario
+            // is handled elsewhere in the call chain.
+
+            // TODO: Consider to set the local status to PROC_KILLED or
+            // something similar.
+        }
+    }
+
+
+    /**
+     *  Initiate a shutdown of the VPN client backend process.  This does
+     *  not wait for the backend process; the shutdown is completed by
+     *  finish_shutdown() once the backend has released its bus name or
+     *  after shutdown_timeout_ms.  Sessions hosted by a backend process
+     *  serving several sessions complete it when the backend replies.
+     *
+     * @param forced             If set to True, it will not do a normal
+     *                           disconnect but tell the backend process
+     *                           to stop more abruptly.
+     * @param selfdestruct_flag  If set to True, this D-Bus session object
+     *                           will be destroyed.  If not, it needs to
+     *                           be removed later on independently.  Used to
+     *                           allow front-ends to retrieve the last sent
+     *                           status message, which can be AUTH_FAILED.
+     * @param invoc              (optional) GDBusMethodInvocation to
+     *                           complete when the shutdown is done
+     */
+    void shutdown(bool forced, bool selfdestruct_flag,
+                  GDBusMethodInvocation *invoc = nullptr)
+    {
+        if (invoc)
+        {
+            shutdown_invocs.push_back(invoc);
+        }
+        if (shutdown_pending)
+        {
+            // Already waiting for the backend to stop
+            shutdown_forced |= forced;
+            shutdown_selfdestruct |= selfdestruct_flag;
+            return;
+        }
+        shutdown_pending = true;
+        shutdown_forced = forced;
+        shutdown_selfdestruct = selfdestruct_flag;
+
+        if (backend_alive && be_proxy)
+        {
+            try
             {
-                try
+                // A backend process hosting several sessions keeps its
+                // bus name when one of them stops; the reply to the
+                // call is then the signal this session is gone.
+                DBusProxyAsyncCall::Callback done = nullptr;
+                if (OpenVPN3DBus_rootp_backends_session != be_path)
                 {
-                    shutdown(true, true); // Ensure the backend client process have stopped
-                }
-                catch (DBusException& dberr)
-                {
-                    // Ignore any errors for now.
-                }
-                errmsg = "Backend VPN process has died.  Session is no longer valid.";
-                if (!selfdestruct_complete)
-                {
-                    StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Backend process died");
-                    do_selfdestruct = true;
+                    std::shared_ptr<bool> alive = object_alive;
+                    done = [this, alive](DBusProxyAsyncCall& call)
+                           {
+                               shutdown_call_result(alive, call);
+                           };
                 }
+                be_proxy->CallAsync(!forced ? "Disconnect" : "ForceShutdown",
+                                    nullptr, done);
+                shutdown_timer = g_timeout_add(shutdown_timeout_ms,
+                                               shutdown_timeout, this);
+                return;
             }
-            else
-            {
-                errmsg = "Failed communicating with VPN backend: "
-                       + std::string(dberr.GetRawError());
-            }
-
-            if (registered && !selfdestruct_complete && !do_selfdestruct)
+            catch (DBusException& excp)
             {
-                LogCritical(errmsg);
+                Debug(excp.what());
+                // FIXME: For now, we just ignore any errors here - the
+                // backend process may not be running
             }
+        }
+        finish_shutdown();
+    }
 
-            if (!errmsg.empty())
-            {
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.sessions.error",
-                                                          errmsg.c_str());
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-            }
 
-            if (do_selfdestruct)
-            {
-                selfdestruct(conn);
-            }
+    /**
+     *  Completes a shutdown of a session hosted by a backend process
+     *  serving several sessions, when the Disconnect or ForceShutdown
+     *  call has returned.  Errors are only logged; the session is gone
+     *  in either case.
+     */
+    void shutdown_call_result(std::shared_ptr<bool> alive,
+                              DBusProxyAsyncCall& call)
+    {
+        if (!*alive)
+        {
+            return;
         }
-        catch (DBusCredentialsException& excp)
+        sleep_call_result(alive, call, "disconnect");
+        if (shutdown_pending)
         {
-            LogWarn(excp.what());
-            excp.SetDBusError(invoc);
+            finish_shutdown();
         }
-    };
+    }
 
 
     /**
-     *   Callback which is used each time a SessionObject D-Bus property is
-     *   being read.
-     *
-     *   Only the 'owner' is accessible by anyone, otherwise it must either
-     *   be the session owner or UIDs granted access to this session.
-     *
-     * @param conn           D-Bus connection this event occurred on
-     * @param sender         D-Bus bus name of the requester
-     * @param obj_path       D-Bus object path to the object being requested
-     * @param intf_name      D-Bus interface of the property being accessed
-     * @param property_name  The property name being accessed
-     * @param error          A GLib2 GError object if an error occurs
-     *
-     * @return  Returns a GVariant Glib2 object containing the value of the
-     *          requested D-Bus object property.  On errors, NULL must be
-     *          returned and the error must be returned via a GError
-     *          object.
+     *  Completes a shutdown started by shutdown(), when the backend
+     *  process has stopped.
      */
-    GVariant * callback_get_property(GDBusConnection *conn,
-                                     const std::string sender,
-                                     const std::string obj_path,
-                                     const std::string intf_name,
-                                     const std::string property_name,
-                                     GError **error)
+    void finish_shutdown()
     {
-        if (!registered)
+        if (0 != shutdown_timer)
         {
-            g_set_error(error,
-                        G_IO_ERROR,
-                        G_IO_ERROR_PENDING,
-                        "Session not active");
-            return NULL;
+            g_source_remove(shutdown_timer);
+            shutdown_timer = 0;
         }
+        shutdown_pending = false;
 
-        try
+        // Remove this session object
+        if (!shutdown_forced)
         {
-            CheckACL_allowRoot(sender);
+            StatusChange(StatusMajor::SESSION, StatusMinor::PROC_STOPPED, "Session closed");
         }
-        catch (DBusCredentialsException& excp)
+        else
         {
-            LogWarn(excp.what());
-            excp.SetDBusError(error, G_IO_ERROR, G_IO_ERROR_FAILED);
-            return NULL;
+            StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Session closed, killed backend client");
         }
-        catch (const DBusException& excp)
+
+        for (auto& inv : shutdown_invocs)
         {
-            std::string err(excp.what());
+            g_dbus_method_invocation_return_value(inv, NULL);
+        }
+        shutdown_invocs.clear();
+        for (auto& cb : shutdown_callbacks)
+        {
+            cb();
+        }
+        shutdown_callbacks.clear();
 
-            if (err.find("Could not get UID of name") != std::string::npos)
-            {
-                g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                            "Backend service unavailable");
-            }
-            else
-            {
-                LogCritical(excp.what());
-                excp.SetDBusError(error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE);
-            }
-            return NULL;
+        if (shutdown_selfdestruct)
+        {
+            selfdestruct(signal_router->GetConnection());
+        }
+    }
+
+
+    /**
+     *  This method is dangerous and should only be used by either the
+     *  SessionObject::shutdown() method or exception handlers in the
+     *  SessionObject.
+     *
+     *  This will initiate deleting this SessionObject from the D-Bus and then
+     *  destroy itself.
+     *
+     * @param conn  D-Bus connection to use when removing this object from
+     *              the D-Bus.
+     */
+    void selfdestruct(GDBusConnection *conn)
+    {
+        // Object may still be available via other threads for a short
+        // while, which can cause havoc if not handled properly.  There
+        // are a few call-chains when the backend client process dies which
+        // may call selfdestruct() a couple of times at the almost the same
+        // time.  So we add a lock here, to ensure only the first
+        // selfdestruct() event is handled.  After this first call have
+        // completed, this object is to be considered dead.
+        //
+        // !! WARNING: ONLY EXCEPTION HANDLERS AND shutdown()  !!
+        // !! WARNING:       MAY CALL THIS FUNCTION!           !!
+        //
+        std::lock_guard<std::mutex> guard(selfdestruct_guard);
+        if (selfdestruct_complete)
+        {
+            return;
+        }
+        RemoveObject(conn);
+        selfdestruct_complete = true;
+
+        delete this;
+    }
+};
+
+
+/**
+ *   A SessionManagerObject is the main entry point when starting new
+ *   VPN tunnels.  It should only exist a single SessionManagerObject during
+ *   the life cycle of the openvpn3-service-sessoinmgr process.
+ */
+class SessionManagerObject : public DBusObject,
+                             public SessionManagerSignals,
+                             public RC<thread_safe_refcount>
+{
+public:
+    typedef RCPtr<SessionManagerObject> Ptr;
+
+    /**
+     *  Constructor initializing the SessionManagerObject to be registered on
+     *  the D-Bus.
+     *
+     * @param dbuscon  D-Bus this object is tied to
+     * @param objpath  D-Bus object path to this object
+     * @param logwr    Pointer to LogWriter object; can be nullptr to
+     *                 disablefile log.
+     *
+     */
+    SessionManagerObject(GDBusConnection *dbuscon, const std::string objpath,
+                         unsigned int manager_log_level, LogWriter *logwr,
+                         bool signal_broadcast)
+        : DBusObject(objpath),
+          SessionManagerSignals(dbuscon, objpath, manager_log_level, logwr,
+                                signal_broadcast),
+          dbuscon(dbuscon),
+          creds(dbuscon)
+    {
+        std::stringstream introspection_xml;
+        introspection_xml << "<node name='" << objpath << "'>"
+                          << "    <interface name='" << OpenVPN3DBus_interf_sessions << "'>"
+                          << "        <method name='NewTunnel'>"
+                          << "          <arg type='o' name='config_path' direction='in'/>"
+                          << "          <arg type='o' name='session_path' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='NewTunnelBundle'>"
+                          << "          <arg type='o' name='config_path' direction='in'/>"
+                          << "          <arg type='u' name='count' direction='in'/>"
+                          << "          <arg type='ao' name='session_paths' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchAvailableSessions'>"
+                          << "          <arg type='ao' name='paths' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchManagedInterfaces'>"
+                          << "          <arg type='as' name='devices' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchSessionsFiltered'>"
+                          << "          <arg type='a{sv}' name='filter' direction='in'/>"
+                          << "          <arg type='s' name='cursor' direction='in'/>"
+                          << "          <arg type='u' name='limit' direction='in'/>"
+                          << "          <arg type='ao' name='paths' direction='out'/>"
+                          << "          <arg type='s' name='next_cursor' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchManagedInterfacesFiltered'>"
+                          << "          <arg type='a{sv}' name='filter' direction='in'/>"
+                          << "          <arg type='s' name='cursor' direction='in'/>"
+                          << "          <arg type='u' name='limit' direction='in'/>"
+                          << "          <arg type='as' name='devices' direction='out'/>"
+                          << "          <arg type='s' name='next_cursor' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='FetchSessionsDetailed'>"
+                          << "          <arg type='a{oa{sv}}' name='sessions' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='LookupConfigName'>"
+                          << "           <arg type='s' name='config_name' direction='in'/>"
+                          << "           <arg type='ao' name='session_paths' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='LookupInterface'>"
+                          << "           <arg type='s' name='device_name' direction='in'/>"
+                          << "           <arg type='o' name='session_path' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='TransferOwnership'>"
+                          << "           <arg type='o' name='path' direction='in'/>"
+                          << "           <arg type='u' name='new_owner_uid' direction='in'/>"
+                          << "        </method>"
+                          << "        <method name='DisconnectAll'>"
+                          << "           <arg type='s' name='config_name' direction='in'/>"
+                          << "           <arg type='b' name='forced' direction='in'/>"
+                          << "           <arg type='ao' name='session_paths' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='GetStatusBoard'>"
+                          << "           <arg type='u' name='version' direction='out'/>"
+                          << "        </method>"
+                          << "        <method name='EventSubscribe'/>"
+                          << "        <method name='EventUnsubscribe'/>"
+                          << "        <property type='s' name='version' access='read'/>"
+                          << "        <property type='t' name='change_counter' access='read'/>"
+                          << "        <property type='a{su}' name='connect_admission' access='read'/>"
+                          << "        <property type='a{s(uu)}' name='remote_backoff' access='read'/>"
+                          << GetLogIntrospection()
+                          << SessionManager::Event::GetIntrospection()
+                          << "    </interface>"
+                          << "</node>";
+        ParseIntrospectionXML(introspection_xml);
+
+        objmgr.reset(new DBusObjectManager<SessionObject>(
+                             dbuscon, objpath, OpenVPN3DBus_interf_sessions,
+                             [this]()
+                             {
+                                 std::vector<SessionObject *> ret;
+                                 for (const auto& item : sessions.GetAll())
+                                 {
+                                     ret.push_back(item.second);
+                                 }
+                                 return ret;
+                             },
+                             signal_broadcast));
+
+        RegisterMethod("NewTunnel",
+                       [this](const MethodCall& call)
+                       {
+                           method_new_tunnel(call);
+                       });
+        RegisterMethod("NewTunnelBundle",
+                       [this](const MethodCall& call)
+                       {
+                           method_new_tunnel_bundle(call);
+                       });
+        RegisterMethod("FetchAvailableSessions",
+                       [this](const MethodCall& call)
+                       {
+                           method_fetch_sessions(call, false);
+                       });
+        RegisterMethod("FetchManagedInterfaces",
+                       [this](const MethodCall& call)
+                       {
+                           method_fetch_sessions(call, true);
+                       });
+        RegisterMethod("FetchSessionsFiltered",
+                       [this](const MethodCall& call)
+                       {
+                           method_fetch_sessions_filtered(call, false);
+                       });
+        RegisterMethod("FetchManagedInterfacesFiltered",
+                       [this](const MethodCall& call)
+                       {
+                           method_fetch_sessions_filtered(call, true);
+                       });
+        RegisterMethod("FetchSessionsDetailed",
+                       [this](const MethodCall& call)
+                       {
+                           method_fetch_sessions_detailed(call);
+                       });
+        RegisterMethod("LookupConfigName",
+                       [this](const MethodCall& call)
+                       {
+                           method_lookup_config_name(call);
+                       });
+        RegisterMethod("LookupInterface",
+                       [this](const MethodCall& call)
+                       {
+                           method_lookup_interface(call);
+                       });
+        RegisterMethod("TransferOwnership",
+                       [this](const MethodCall& call)
+                       {
+                           method_transfer_ownership(call);
+                       });
+        RegisterMethod("DisconnectAll",
+                       [this](const MethodCall& call)
+                       {
+                           method_disconnect_all(call);
+                       });
+        RegisterMethod("GetStatusBoard",
+                       [this](const MethodCall& call)
+                       {
+                           method_get_status_board(call);
+                       });
+        RegisterMethod("EventSubscribe",
+                       [this](const MethodCall& call)
+                       {
+                           method_event_subscribe(call, true);
+                       });
+        RegisterMethod("EventUnsubscribe",
+                       [this](const MethodCall& call)
+                       {
+                           method_event_subscribe(call, false);
+                       });
+
+        // Monitoring and listing calls from front-ends are handled
+        // after pending calls and signals from the VPN backends
+        for (const auto& m : {"FetchAvailableSessions",
+                              "FetchManagedInterfaces",
+                              "FetchSessionsFiltered",
+                              "FetchManagedInterfacesFiltered",
+                              "FetchSessionsDetailed",
+                              "LookupConfigName",
+                              "LookupInterface",
+                              "GetStatusBoard"})
+        {
+            SetLowPriorityMethod(m);
         }
 
+        // All backend registrations are handled here and passed on to
+        // the session object the backend token belongs to
+        signal_router = DBusSignalRouter::Get(dbuscon);
+        registration_handler = signal_router->AddHandler(
+                                     OpenVPN3DBus_interf_backends,
+                                     "", "", "RegistrationRequest",
+                                     [this](const DBusSignalEvent& ev)
+                                     {
+                                         dispatch_registration(ev);
+                                     });
+
+        // Cached configuration profile details are dropped when the
+        // profile changes or the configuration manager goes away
+        config_changed_subscr = g_dbus_connection_signal_subscribe(
+                                     dbuscon,
+                                     OpenVPN3DBus_name_configuration.c_str(),
+                                     "org.freedesktop.DBus.Properties",
+                                     "PropertiesChanged",
+                                     nullptr,
+                                     OpenVPN3DBus_interf_configuration.c_str(),
+                                     G_DBUS_SIGNAL_FLAGS_NONE,
+                                     config_changed,
+                                     this, nullptr);
+        configmgr_watch = g_bus_watch_name_on_connection(
+                                     dbuscon,
+                                     OpenVPN3DBus_name_configuration.c_str(),
+                                     G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                     nullptr,
+                                     configmgr_vanished,
+                                     this, nullptr);
+
+        Debug("SessionManagerObject registered on '" + OpenVPN3DBus_interf_sessions + "': "
+                      + objpath);
+
+        usage_reporter = DBusResourceUsage::Instance().AddReporter(
+            [this](DBusResourceUsage::Report& report)
+            {
+                for (const auto& item : sessions.GetAll())
+                {
+                    item.second->ReportResourceUsage(report);
+                }
+                report.Add("reconnect_cache", reconnect_cache->size());
+                if (remote_backoff)
+                {
+                    report.Add("remote_backoff", remote_backoff->size());
+                }
+            });
+    }
+
+    /**
+     *  Retrieve the org.freedesktop.DBus.ObjectManager implementation
+     *  giving access to all the session objects.  It needs to be
+     *  registered on the D-Bus together with this object.
+     */
+    DBusObjectManager<SessionObject>& GetObjectManager()
+    {
+        return *objmgr;
+    }
+
+
+    /**
+     *  Use private peer-to-peer D-Bus connections to the backend
+     *  processes of new sessions, see SessionObject::EnablePeerLink()
+     *
+     * @param enable  bool, true to enable the peer links
+     */
+    void EnableBackendPeerLink(bool enable)
+    {
+        backend_peer_link = enable;
+    }
+
+
+    /**
+     *  Limits the number of sessions connecting at the same time, see
+     *  ConnectAdmission
+     *
+     * @param max_concurrent  Maximum number of sessions connecting at the
+     *                        same time; 0 for no limit
+     * @param jitter_ms       Upper limit of the random start delay of
+     *                        queued sessions, in milliseconds
+     */
+    void SetConnectAdmission(unsigned int max_concurrent, unsigned int jitter_ms)
+    {
+        SessionObject::StartAdmitted(connect_admission,
+                                     connect_admission->Configure(max_concurrent,
+                                                                  jitter_ms));
+    }
+
+
+    /**
+     *  Share the health of the remote servers between the sessions, so
+     *  they back off from a failing server together, see RemoteBackoff.
+     *  Must be called before any session is added.
+     *
+     * @param enable  bool, true to share the remote backoff state
+     */
+    void EnableRemoteBackoff(bool enable)
+    {
+        remote_backoff = (enable ? std::make_shared<RemoteBackoff>() : nullptr);
+    }
+
 
-        GVariant *ret = NULL;
-        if ("owner" == property_name)
+    /**
+     *  Pause the connected sessions when the host goes to sleep and
+     *  resume them right after it woke up, see SleepMonitor
+     *
+     * @param enable  bool, true to follow the logind sleep events
+     */
+    void EnableSleepMonitor(bool enable)
+    {
+        if (!enable)
         {
-            ret = GetOwner();
+            sleep_monitor.reset();
+            return;
         }
-        else if ("device_path" == property_name)
+        if (sleep_monitor)
         {
-            try
-            {
-                ret = be_proxy->GetProperty("device_path");
-            }
-            catch (DBusException&)
-            {
-                g_set_error(error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_PENDING,
-                            "Device path not available");
-                return NULL;
-            }
+            return;
         }
-        else if ("restrict_log_access" == property_name)
+
+        sleep_monitor.reset(new SleepMonitor(dbuscon,
+                                             [this](std::function<void()> ready)
+                                             {
+                                                 pause_for_sleep(ready);
+                                             },
+                                             [this]()
+                                             {
+                                                 resume_after_sleep();
+                                             }));
+        if (!sleep_monitor->HasInhibitor())
         {
-            ret = g_variant_new_boolean (restrict_log_access);
+            LogWarn("Could not take the logind sleep inhibitor lock; "
+                    "sessions may not be paused before the system sleeps");
         }
-        else if ("last_log" == property_name)
+    }
+
+
+    /**
+     *  Records the running sessions in a file in this directory, so a
+     *  session manager started after this one exited unexpectedly can
+     *  take over the VPN client backend processes still running.  The
+     *  sessions recorded by a previous session manager are taken over
+     *  right away; this must be called once the session manager owns
+     *  its well-known bus name, as the backends only accept calls from
+     *  that bus name.
+     *
+     * @param stdir  std::string with the directory for the session store
+     */
+    void SetStateDirectory(const std::string& stdir)
+    {
+        if (!store_file.empty())
         {
-            try
-            {
-                ret = be_proxy->GetProperty("last_log_line");
-            }
-            catch (DBusException&)
-            {
-                ret = GLibUtils::CreateEmptyBuilderFromType("a{sv}");
-            }
+            THROW_DBUSEXCEPTION("SessionManagerObject",
+                                "State directory already set");
         }
-        else if ("session_created" == property_name)
+        if (0 != mkdir(stdir.c_str(), 0700) && EEXIST != errno)
         {
-            ret = g_variant_new_uint64(session_created);
+            LogError("Could not create the state directory " + stdir
+                     + ": " + std::string(strerror(errno)));
+            return;
         }
-        else if ("status" == property_name)
+        store_file = stdir + "/sessions.json";
+
+        std::ifstream f(store_file);
+        std::stringstream content;
+        content << f.rdbuf();
+        store.Parse(content.str());
+
+        unsigned int adopted = 0;
+        for (const auto& e : store.GetAll())
         {
-            try
+            if (!backend_running(e))
             {
-                if (!be_proxy->CheckObjectExists())
-                {
-                    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
-                                "Backend object not available");
-                    return NULL;
-                }
-
-                ret = NULL;
-                if (nullptr != sig_statuschg)
-                {
-                    update_last_status();
-                    ret = sig_statuschg->GetLastStatusChange();
-                }
-                if (NULL == ret)
-                {
-                    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NO_REPLY,
-                                "No status changes have been logged yet");
-                }
+                store.Remove(e.session_path);
+                continue;
             }
-            catch (DBusException& excp)
+            if (adopt_session(e))
             {
-                g_set_error(error, G_DBUS_ERROR, G_IO_ERROR_FAILED,
-                            "Failed retrieving connection status");
-                ret = NULL;
+                ++adopted;
             }
         }
-        else if ("statistics" == property_name)
+        write_store();
+        if (adopted > 0)
         {
-            try
-            {
-                if (!be_proxy->CheckObjectExists())
-                {
-                    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
-                                "Backend object not available");
-                    return NULL;
-                }
-                ret = be_proxy->GetProperty("statistics");
-            }
-            catch (DBusException& exp)
-            {
-                g_set_error(error, G_DBUS_ERROR, G_IO_ERROR_FAILED,
-                            "Failed retrieving connection statistics");
-                ret = NULL;
-            }
+            LogInfo("Took over " + std::to_string(adopted)
+                    + " running VPN session(s)");
         }
-        else if ("device_name" == property_name)
+    }
+
+
+    ~SessionManagerObject()
+    {
+        sleep_monitor.reset();
+        for (const auto& sub : event_subscribers)
         {
-            try
-            {
-                ret = be_proxy->GetProperty("device_name");
-            }
-            catch (DBusException&)
-            {
-                g_set_error(error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_PENDING,
-                            "Device path not available");
-                return NULL;
-            }
+            g_bus_unwatch_name(sub.second.watch_id);
         }
-        else if ("config_path" == property_name)
+        g_dbus_connection_signal_unsubscribe(dbuscon, config_changed_subscr);
+        g_bus_unwatch_name(configmgr_watch);
+        DBusResourceUsage::Instance().RemoveReporter(usage_reporter);
+        signal_router->RemoveHandler(registration_handler);
+        LogInfo("Shutting down");
+        RemoveObject(dbuscon);
+    }
+
+
+    /**
+     *  Callback which is used each time a SessionManagerObject D-Bus
+     *  property is being read.
+     *
+     *  For the SessionManagerObject, this method will just return NULL
+     *  with an error set in the GError return pointer.  The
+     *  SessionManagerObject does not use properties at all.
+     *
+     * @param conn           D-Bus connection this event occurred on
+     * @param sender         D-Bus bus name of the requester
+     * @param obj_path       D-Bus object path to the object being requested
+     * @param intf_name      D-Bus interface of the property being accessed
+     * @param property_name  The property name being accessed
+     * @param error          A GLib2 GError object if an error occurs
+     *
+     * @return  Returns always NULL, as there are no properties in the
+     *          SessionManagerObject.
+     */
+    GVariant * callback_get_property(GDBusConnection *conn,
+                                     const std::string sender,
+                                     const std::string obj_path,
+                                     const std::string intf_name,
+                                     const std::string property_name,
+                                     GError **error)
+    {
+        GVariant *ret = nullptr;
+
+        if ("version" == property_name)
         {
-            ret = g_variant_new_string (config_path.c_str());
+            ret = g_variant_new_string(package_version());
         }
-        else if ("config_name" == property_name)
+        else if ("change_counter" == property_name)
         {
-            ret = g_variant_new_string (config_name.c_str());
+            ret = g_variant_new_uint64(change_counter);
         }
-        else if ("dco" == property_name)
+        else if ("connect_admission" == property_name)
         {
-            try
-            {
-                ret = be_proxy->GetProperty("dco");
-            }
-            catch (DBusException&)
-            {
-                // If the DCO flag of the backend process could not be
-                // retrieved, return our current setting
-                ret = g_variant_new_boolean(dco);
-            }
+            ConnectAdmission::State st = connect_admission->GetState();
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{su}"));
+            g_variant_builder_add(bld, "{su}", "max_concurrent", st.max_concurrent);
+            g_variant_builder_add(bld, "{su}", "jitter_ms", st.jitter_ms);
+            g_variant_builder_add(bld, "{su}", "in_progress", st.in_progress);
+            g_variant_builder_add(bld, "{su}", "queued", st.queued);
+            ret = g_variant_builder_end(bld);
+            g_variant_builder_unref(bld);
         }
-        else if ("session_name" == property_name)
+        else if ("remote_backoff" == property_name)
         {
-            try
-            {
-                std::string sn(be_proxy->GetStringProperty("session_name"));
-                ret = g_variant_new_string (sn.c_str());
-            }
-            catch (const DBusException& excp)
+            GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{s(uu)}"));
+            if (remote_backoff)
             {
-                // Ignore errors in this case; this is informal details
-                return g_variant_new_string("");
+                for (const auto& r : remote_backoff->GetState())
+                {
+                    g_variant_builder_add(bld, "{s(uu)}", r.first.c_str(),
+                                          r.second.failures,
+                                          (guint32) r.second.remaining.count());
+                }
             }
+            ret = g_variant_builder_end(bld);
+            g_variant_builder_unref(bld);
         }
-        else if ("backend_pid" == property_name)
-        {
-            ret = g_variant_new_uint32 (backend_pid);
-        }
-        else if ("log_forwards" == property_name)
+        else
         {
-            std::vector<std::string> paths = {};
-            for (const auto& it : log_proxies)
-            {
-                paths.push_back(it.second->GetLogProxyPath());
-            }
-            ret = GLibUtils::GVariantFromVector(paths);
+            g_set_error (error,
+                         G_IO_ERROR,
+                         G_IO_ERROR_FAILED,
+                         "Unknown property");
         }
-        else if ("log_verbosity" == property_name)
+        return ret;
+    };
+
+    /**
+     *  Callback method which is used each time a SessionManagerObject
+     *  property is being modified over the D-Bus.
+     *
+     *  This will always fail with an exception, as there exists no properties
+     *  which can be modified in a SessionManagerObject.
+     *
+     * @param conn           D-Bus connection this event occurred on
+     * @param sender         D-Bus bus name of the requester
+     * @param obj_path       D-Bus object path to the object being requested
+     * @param intf_name      D-Bus interface of the property being accessed
+     * @param property_name  The property name being accessed
+     * @param value          GVariant object containing the value to be stored
+     * @param error          A GLib2 GError object if an error occurs
+     *
+     * @return Will always throw an execption as there are no properties to
+     *         modify.
+     */
+    GVariantBuilder * callback_set_property(GDBusConnection *conn,
+                                            const std::string sender,
+                                            const std::string obj_path,
+                                            const std::string intf_name,
+                                            const std::string property_name,
+                                            GVariant *value,
+                                            GError **error)
+    {
+        THROW_DBUSEXCEPTION("SessionManagerObject", "set property not implemented");
+    }
+
+
+private:
+    GDBusConnection *dbuscon;
+    DBusConnectionCreds creds;
+    ObjectPathAllocator sesspaths{OpenVPN3DBus_rootp_sessions, 's'};
+    SessionRegistry<SessionObject> sessions;
+    std::unique_ptr<DBusObjectManager<SessionObject>> objmgr;
+    ReconnectCache::Ptr reconnect_cache = std::make_shared<ReconnectCache>();
+    ConfigCache::Ptr config_cache = std::make_shared<ConfigCache>();
+    ConnectAdmission::Ptr connect_admission = std::make_shared<ConnectAdmission>();
+    RemoteBackoff::Ptr remote_backoff = nullptr;
+    guint config_changed_subscr = 0;
+    guint configmgr_watch = 0;
+    bool backend_peer_link = false;
+    DBusSignalRouter::Ptr signal_router;
+    DBusSignalRouter::HandlerId registration_handler = 0;
+    DBusResourceUsage::ReporterId usage_reporter = 0;
+    SleepMonitor::Ptr sleep_monitor;
+    SessionStore store;
+    std::string store_file;
+    std::map<uid_t, SessionManager::StatusBoard::Ptr> status_boards;
+
+    /**
+     *  Changed each time a session is added or removed, or its
+     *  configuration or device name changes.  Starts at the service start
+     *  time, so a restarted service does not repeat values of an earlier
+     *  instance.
+     */
+    uint64_t change_counter = g_get_real_time();
+
+    struct EventSubscriber
+    {
+        uid_t uid;
+        guint watch_id;
+    };
+    /// SessionManagerEvent subscribers, indexed by unique bus name
+    std::map<std::string, EventSubscriber> event_subscribers;
+
+    /// Upper limit of sessions in a bundle, matching the number of
+    /// next hops netcfg puts into a multipath route
+    static const unsigned int max_bundle_size = 16;
+
+    /// Sessions each status board can hold
+    static const unsigned int status_board_slots = 256;
+
+    /// How often the backends push their counters to the status boards
+    static const unsigned int status_board_interval_ms = 2000;
+
+
+    /**
+     *  Writes the SessionStore file, if a state directory is set
+     */
+    void write_store()
+    {
+        if (store_file.empty())
         {
-            ret = g_variant_new_uint32 (GetLogLevel());
+            return;
         }
-        else if ("public_access" == property_name)
+        try
         {
-            ret = g_variant_new_boolean(GetPublicAccess());
+            write_file_atomic(store_file, store.Serialize());
         }
-        else if ("acl" == property_name)
+        catch (const std::exception& excp)
         {
-            ret = GLibUtils::GVariantFromVector(GetAccessList());
+            LogError("Could not update the session store: "
+                     + std::string(excp.what()));
         }
-        else
+    }
+
+
+    /**
+     *  Checks if the VPN client backend process of a recorded session
+     *  still runs.  The process must own the bus name recorded, and it
+     *  must still have the same PID, in case the bus name was taken
+     *  by a new backend process in the meantime.
+     *
+     * @param e  SessionStore::Entry of the session
+     *
+     * @return Returns true if the backend process can be taken over
+     */
+    bool backend_running(const SessionStore::Entry& e)
+    {
+        try
         {
-            g_set_error(error,
-                        G_IO_ERROR,
-                        G_IO_ERROR_FAILED,
-                        "Unknown property");
+            std::string owner = creds.GetUniqueBusID(e.backend_busname);
+            return creds.GetPID(owner) == e.backend_pid;
         }
-
-        return ret;
-    };
+        catch (const DBusException&)
+        {
+            return false;
+        }
+    }
 
 
     /**
-     *  Callback method which is used each time a SessionObject property
-     *  is being modified over the D-Bus.
+     *  Creates a SessionObject for a recorded session and takes over
+     *  its running backend process
      *
-     * @param conn           D-Bus connection this event occurred on
-     * @param sender         D-Bus bus name of the requester
-     * @param obj_path       D-Bus object path to the object being requested
-     * @param intf_name      D-Bus interface of the property being accessed
-     * @param property_name  The property name being accessed
-     * @param value          GVariant object containing the value to be stored
-     * @param error          A GLib2 GError object if an error occurs
+     * @param e  SessionStore::Entry of the session
      *
-     * @return Returns a GVariantBuilder object which will be used by the
-     *         D-Bus library to issue the required PropertiesChanged signal.
-     *         If an error occurres, the DBusPropertyException is thrown.
+     * @return Returns true if the backend process was taken over
      */
-    GVariantBuilder * callback_set_property(GDBusConnection *conn,
-                                            const std::string sender,
-                                            const std::string obj_path,
-                                            const std::string intf_name,
-                                            const std::string property_name,
-                                            GVariant *value,
-                                            GError **error)
+    bool adopt_session(const SessionStore::Entry& e)
     {
-        /*
-          std::cout << "[SessionObject] set_property(): "
-                  << "sender=" << sender
-                  << ", object_path=" << obj_path
-                  << ", interface=" << intf_name
-                  << ", property=" << property_name
-                  << std::endl;
-        */
-        if (!registered)
+        auto callback = [self=Ptr(this), sesspath=e.session_path]()
+                        {
+                            self->remove_session_object(sesspath);
+                        };
+        SessionObject *session = new SessionObject(dbuscon,
+                                                   callback,
+                                                   e.owner,
+                                                   e.session_path,
+                                                   e.config_path,
+                                                   GetLogLevel(),
+                                                   logwr,
+                                                   GetSignalBroadcast(),
+                                                   &e);
+        add_session(dbuscon, e.session_path, session);
+        sessions.Update(e.session_path, e.config_name, e.device_name);
+        return session->Adopt();
+    }
+
+
+    void remove_session_object(const std::string sesspath)
+    {
+        if (store.Remove(sesspath))
         {
-            g_set_error(error,
-                        G_IO_ERROR,
-                        G_IO_ERROR_PENDING,
-                        "Session not active");
-            return NULL;
+            write_store();
         }
 
-        try
+        SessionObject *session = sessions.Remove(sesspath);
+        if (!session)
         {
-            if (!restrict_log_access
-                && "log_verbosity" == property_name)
-            {
-                CheckACL(sender);
-            }
-            else
-            {
-                CheckOwnerAccess(sender);
-            }
+            return;
         }
-        catch (DBusCredentialsException& excp)
+        ++change_counter;
+        objmgr->ObjectRemoved(session);
+        for (const auto& b : status_boards)
         {
-            LogWarn(excp.what());
-            Debug("SetProperty - Object path: " + obj_path
-                  + ", interface=" + intf_name
-                  + ", property_name=" + property_name
-                  + ", sender=" + sender);
-            throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                        obj_path, intf_name, property_name,
-                                        excp.what());
+            b.second->Remove(sesspath);
         }
+        uid_t owner = session->GetOwnerUID();
 
-        try
+        SessionManager::Event ev{sesspath,
+                                 SessionManager::EventType::SESS_DESTROYED,
+                                 owner};
+        send_event(ev, session);
+    }
+
+
+    /**
+     *  Sends a SessionManagerEvent signal to the subscribers with access
+     *  to the session.  The root user gets the events of all sessions.
+     *  With signal broadcast enabled, the signal is sent to everyone
+     *  instead.
+     *
+     * @param ev       SessionManager::Event to send
+     * @param session  SessionObject the event is about
+     */
+    void send_event(const SessionManager::Event& ev,
+                    const SessionObject *session)
+    {
+        if (GetSignalBroadcast())
         {
-            if (("dco" == property_name) && be_conn)
-            {
-                if (DCOstatus::LOCKED != dco_status)
-                {
-                    dco = g_variant_get_boolean(value);
-                    dco_status = DCOstatus::MODIFIED;
-                    return build_set_property_response(property_name, dco);
-                }
-                else
-                {
-                    throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                                obj_path, intf_name,
-                                                property_name,
-                                                "DCO setting cannot be changed now");
-                }
-            }
-            else if (("restrict_log_access" == property_name) && be_conn)
-            {
-                restrict_log_access = g_variant_get_boolean(value);
-                return build_set_property_response(property_name,
-                                                   restrict_log_access);
-            }
-            else if (("log_verbosity" == property_name) && be_conn)
-            {
-                unsigned int log_verb = g_variant_get_uint32(value);
-                try
-                {
-                    SetLogLevel(log_verb);
-                }
-                catch (const LogException& excp)
-                {
-                    throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                                obj_path, intf_name,
-                                                property_name,
-                                                excp.what());
-                }
+            Broadcast(OpenVPN3DBus_interf_sessions,
+                      OpenVPN3DBus_rootp_sessions,
+                      "SessionManagerEvent",
+                      ev.GetGVariant());
+            return;
+        }
 
-                try
-                {
-                    if (be_proxy)
-                    {
-                        be_proxy->SetProperty("log_level", log_verb);
-                    }
-                }
-                catch (const DBusException& e)
-                {
-                    LogCritical("Could not set the VPN backend log level");
-                    Debug("Backend log-level error: "
-                          + std::string(e.GetRawError()));
-                }
-                return build_set_property_response(property_name,
-                                                   (guint32) log_verb);
-            }
-            else if (("public_access" == property_name) && conn)
+        std::vector<std::string> targets;
+        for (const auto& sub : event_subscribers)
+        {
+            if (0 == sub.second.uid || session->CheckUIDAccess(sub.second.uid))
             {
-                bool acl_public = g_variant_get_boolean(value);
-                SetPublicAccess(acl_public);
-                LogInfo("Public access set to "
-                         + (acl_public ? std::string("true") :
-                                         std::string("false"))
-                         + " by uid " + std::to_string(GetUID(sender)));
-                return build_set_property_response(property_name, acl_public);
+                targets.push_back(sub.first);
             }
         }
-        catch (DBusException& excp)
+        if (!targets.empty())
         {
-            throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                        obj_path, intf_name, property_name,
-                                        excp.what());
+            Send(targets, OpenVPN3DBus_interf_sessions,
+                 OpenVPN3DBus_rootp_sessions, "SessionManagerEvent",
+                 ev.GetGVariant());
         }
-        throw DBusPropertyException(G_IO_ERROR, G_IO_ERROR_FAILED,
-                                    obj_path, intf_name, property_name,
-                                    "Invalid property");
     }
 
 
     /**
-     *  Clean-up function triggered by the D-Bus library when an object
-     *  is removed from the D-Bus
+     *  Called when a SessionManagerEvent subscriber is no longer on the
+     *  D-Bus
      */
-    void callback_destructor ()
+    static void event_subscriber_vanished(GDBusConnection *conn,
+                                          const gchar *name,
+                                          gpointer this_ptr)
     {
-        if( nullptr != sig_statuschg)
+        SessionManagerObject *self = static_cast<SessionManagerObject *>(this_ptr);
+        auto it = self->event_subscribers.find(name);
+        if (self->event_subscribers.end() == it)
         {
-            delete sig_statuschg;
-            sig_statuschg = nullptr;
+            return;
         }
-    };
-
-
-private:
-    unsigned int default_session_log_level = 4; // LogCategory::INFO messages
-    std::function<void()> remove_callback;
-    DBusProxy *be_proxy;
-    bool restrict_log_access;
-    SessionLogProxyList log_proxies= {};
-    std::time_t session_created;
-    std::string config_path;
-    std::string config_name;
-    bool dco = false;
-    DCOstatus dco_status = DCOstatus::UNCHANGED;
-    SessionStatusChange *sig_statuschg;
-    std::string backend_token;
-    pid_t backend_pid;
-    GDBusConnection *be_conn;
-    std::string be_busname;
-    std::string be_path;
-    bool registered;
-    bool selfdestruct_complete;
-    std::mutex selfdestruct_guard;
+        g_bus_unwatch_name(it->second.watch_id);
+        self->event_subscribers.erase(it);
+        self->LogVerb2("SessionManagerEvent subscriber "
+                       + std::string(name) + " disconnected");
+    }
 
 
     /**
-     *  Ties the VPN client backend process to this SessionObject.  Once that
-     *  is done, it calls the RegistrationConfirmation method in the backend
-     *  process where it confirms the backend token and provides the
-     *  VPN configuration D-Bus object path to the backend.
+     *  Called by the SleepMonitor before the host goes to sleep.  All
+     *  connected sessions are paused in parallel; the sleep may continue
+     *  once all the backends have processed the request.
+     *
+     * @param ready  std::function<void()> to call when all are paused
      */
-    void register_backend()
+    void pause_for_sleep(std::function<void()> ready)
     {
-        try
-        {
-            be_proxy = new DBusProxy(G_BUS_TYPE_SYSTEM,
-                                     be_busname,
-                                     OpenVPN3DBus_interf_backends,
-                                     be_path);
-            // Don't try to auto start backend services over D-Bus,
-            // The backend service should exists _before_ we try to
-            // communicate with it.
-            be_proxy->SetGDBusCallFlags(G_DBUS_CALL_FLAGS_NO_AUTO_START);
-
-            unsigned int attempts = 5;
-            while (attempts > 0)
-            {
-                try
-                {
-                    ping_backend();
-                    attempts = 0;
-                }
-                catch (const DBusException& excp)
-                {
-                    --attempts;
-                    if (attempts > 0)
+        auto pending = std::make_shared<size_t>(1);
+        auto done = [pending, ready]()
                     {
-                        // If we didn't manage to get a Ping response
-                        // it might be the backend client process is a bit
-                        // slow to settle.  So we just wait for another
-                        // second and try again
-                        sleep(1);
-                    }
-                    else
-                    {
-                        // This didn't work, so bail out.
-                        throw;
-                    }
-                }
-            }
-
-            // Setup signal listeners from the backend process
-            // The SessionStatusChange() handler will use the senders
-            // unique bus name to identify if this is a signal this class
-            // responsible for.
-            //
-            // As the be_busname contains the well-known bus name of the
-            // backend VPN client process, we resolve this to the unique
-            // bus name for this signal handling object.
-            sig_statuschg = new SessionStatusChange(be_conn,
-                                                    GetUniqueBusID(be_busname),
-                                                    OpenVPN3DBus_interf_backends,
-                                                    DBusObject::GetObjectPath());
-
-            // Retrieve the ACL and ownership transfer information from configmgr
-            auto cfgprx = OpenVPN3ConfigurationProxy(G_BUS_TYPE_SYSTEM,
-                                                         config_path);
-            if (cfgprx.GetTransferOwnerSession())
-            {
-                uid_t curr_owner = GetOwnerUID();
-                TransferOwnership(cfgprx.GetOwner());
-                // This is needed for the session starter to be allowed to
-                // complete the connecting phase
-                GrantAccess(curr_owner);
-                restrict_log_access = false;
-            }
-
-            GVariant *res_g = be_proxy->Call("RegistrationConfirmation",
-                                             g_variant_new("(soo)",
-                                                           backend_token.c_str(),
-                                                           DBusObject::GetObjectPath().c_str(),
-                                                           config_path.c_str()));
-            if (nullptr == res_g)
+                        if (0 == --(*pending))
+                        {
+                            ready();
+                        }
+                    };
+
+        size_t count = 0;
+        for (const auto& item : sessions.GetAll())
+        {
+            ++(*pending);
+            if (item.second->PauseForSleep(done))
             {
-                THROW_DBUSEXCEPTION("SessionObject",
-                                    "Failed to extract the result of the "
-                                    "RegistrationConfirmation response");
+                ++count;
             }
-
-            gchar *cfgname_c = nullptr;
-            g_variant_get(res_g, "(s)", &cfgname_c);
-            if (!cfgname_c)
+            else
             {
-                // FIXME: Find a way to gracefully handle failed registration
-                return;
+                --(*pending);
             }
-            config_name = std::string(cfgname_c);
-            Debug("New session registered: " + DBusObject::GetObjectPath());
-            StatusChange(StatusMajor::SESSION, StatusMinor::SESS_NEW,
-                         "session_path=" + DBusObject::GetObjectPath()
-                         + " backend_busname=" + be_busname
-                         + " backend_path=" + be_path);
-            registered = true;
-        }
-        catch (DBusException& err)
-        {
-            THROW_DBUSEXCEPTION("SessionObject", err.what());
         }
+        LogInfo("System going to sleep, pausing " + std::to_string(count)
+                + " session" + (1 == count ? "" : "s"));
+        done();
     }
 
 
     /**
-     * Simple ping-pong game between this SessionObject and its VPN client
-     * backend.  If the backend does not respond, we treat it as dead and will
-     * start to clean-up this session.
-     *
-     * @return  Returns True if the backend process is alive, otherwise False.
+     *  Called by the SleepMonitor after the host has resumed.  All the
+     *  sessions paused by pause_for_sleep() are resumed in parallel, which
+     *  makes each of them reconnect right away.  Should the network
+     *  not be ready yet, the backend reconnects again as soon as the
+     *  netcfg service reports the path to the server has changed.
      */
-    bool ping_backend()
+    void resume_after_sleep()
     {
-        if (nullptr == be_proxy)
+        LogInfo("System has woken up, resuming paused sessions");
+        for (const auto& item : sessions.GetAll())
         {
-            THROW_DBUSEXCEPTION("SessionObject",
-                                "No backend proxy connection established, "
-                                "cannot ping backend");
-        }
-
-        GVariant *res_g = NULL;
-        try {
-            // This Ping() is the BackendClientObject responding,
-            // which ensures the VPN client process is initialized
-            res_g = be_proxy->Call("Ping");
+            item.second->ResumeAfterSleep();
         }
-        catch (DBusException &dbserr)
+    }
+
+
+    /**
+     *  Sends the changed remote backoff state to all the backends.  Each
+     *  session gets its own slot, so they are let through one after the
+     *  other when a remote recovers.
+     */
+    void send_remote_backoff()
+    {
+        unsigned int slot = 0;
+        for (const auto& item : sessions.GetAll())
         {
-            res_g = NULL;
-            Debug(be_busname, be_path, backend_pid, std::string(dbserr.what()));
+            item.second->SendRemoteBackoff(remote_backoff->Get(slot++));
         }
-        if (NULL == res_g)
+    }
+
+
+    /**
+     *  Passes a RegistrationRequest signal from a VPN client backend
+     *  process to the session object holding the backend token
+     *
+     * @param ev  DBusSignalEvent with the signal details
+     */
+    void dispatch_registration(const DBusSignalEvent& ev)
+    {
+        gchar *sesstoken_c = nullptr;
+        g_variant_get_child(ev.params, 1, "s", &sesstoken_c);
+        std::string sesstoken(sesstoken_c ? sesstoken_c : "");
+        g_free(sesstoken_c);
+
+        SessionObject *session = sessions.GetByToken(sesstoken);
+        if (session)
         {
-            THROW_DBUSEXCEPTION("SessionObject",
-                                "VPN backend process unavailable, "
-                                "does not respond to internal Ping()");
+            session->callback_signal_handler(ev);
         }
+    }
 
-        bool ret = false;
-        g_variant_get(res_g, "(b)", &ret);
-        g_variant_unref(res_g);
-        return ret;
+
+    /**
+     *  Handles the NewTunnel method call; creates a new SessionObject for
+     *  the requested configuration profile.
+     */
+    void method_new_tunnel(const MethodCall& call)
+    {
+        // Retrieve the configuration path for the tunnel
+        // from the request
+        gchar *config_path_s = nullptr;
+        g_variant_get (call.params, "(o)", &config_path_s);
+        auto config_path = std::string(config_path_s);
+        g_free(config_path_s);
+
+        std::string sesspath = new_session(call, config_path)->DBusObject::GetObjectPath();
+
+        // Return the path to the new session object object to the caller
+        // The backend object will remind "hidden" for the end-user
+        g_dbus_method_invocation_return_value(call.invoc, g_variant_new("(o)", sesspath.c_str()));
     }
 
 
     /**
-     * Fetches the last backend status and compares to what we have
-     * registered.  If there is a mismatch, we might have missed a signal -
-     * so register it and send it again.
+     *  Handles the NewTunnelBundle method call; creates a bundle of
+     *  SessionObjects for the same configuration profile.  Each session
+     *  runs its own backend process and virtual network device; the
+     *  routes of the devices are shared as multipath routes by netcfg.
      */
-    void update_last_status()
+    void method_new_tunnel_bundle(const MethodCall& call)
     {
-        if (!sig_statuschg)
+        gchar *config_path_s = nullptr;
+        guint32 count = 0;
+        g_variant_get (call.params, "(ou)", &config_path_s, &count);
+        auto config_path = std::string(config_path_s);
+        g_free(config_path_s);
+
+        if (count < 2 || count > max_bundle_size)
         {
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.bundle",
+                                                          ("A bundle must have 2 to "
+                                                           + std::to_string(max_bundle_size)
+                                                           + " sessions").c_str());
+            g_dbus_method_invocation_return_gerror(call.invoc, err);
+            g_error_free(err);
             return;
         }
 
-        try
+        std::string bundle_id = generate_path_uuid("", 'b');
+        GVariantBuilder *paths = g_variant_builder_new(G_VARIANT_TYPE("ao"));
+        for (guint32 i = 0; i < count; ++i)
         {
-            GVariant *be_status = nullptr;
-            be_status = be_proxy->GetProperty("status");
-            if (!sig_statuschg->CompareStatus(be_status))
-            {
-                sig_statuschg->ProxyStatus(be_status);
-            }
+            SessionObject *session = new_session(call, config_path);
+            session->SetBundle(bundle_id, i, count);
+            g_variant_builder_add(paths, "o", session->DBusObject::GetObjectPath().c_str());
         }
-        catch (DBusException& excp)
-        {
-            // Ignore these failures for now.  It most commonly means
-            // the backend process has closed/shut-down - this is scenario
-            // is handled elsewhere in the call chain.
+        g_dbus_method_invocation_return_value(call.invoc,
+                                              GLibUtils::wrapInTuple(paths));
+    }
 
-            // TODO: Consider to set the local status to PROC_KILLED or
-            // something similar.
-        }
+
+    /**
+     *  Creates a new SessionObject for a configuration profile, which
+     *  starts a new backend process
+     *
+     * @param call         MethodCall of the D-Bus caller, becoming the
+     *                     owner of the session
+     * @param config_path  std::string with the D-Bus path of the profile
+     *
+     * @return Returns a pointer to the new SessionObject
+     */
+    SessionObject * new_session(const MethodCall& call,
+                                const std::string& config_path)
+    {
+        prefetch_config(call.conn, config_path);
+
+        // Create session object, which will proxy calls
+        // from the front-end to the backend
+        std::string sesspath = sesspaths.Allocate().path;
+
+        // Create the new object and register it in D-Bus
+        auto callback = [self=Ptr(this), sesspath]()
+                        {
+                            self->remove_session_object(sesspath);
+                        };
+        SessionObject *session = new SessionObject(call.conn,
+                                                   callback,
+                                                   creds.GetUID(call.sender),
+                                                   sesspath,
+                                                   config_path,
+                                                   GetLogLevel(),
+                                                   logwr,
+                                                   GetSignalBroadcast());
+        add_session(call.conn, sesspath, session);
+        SessionManager::Event ev{sesspath,
+                                 SessionManager::EventType::SESS_CREATED,
+                                 creds.GetUID(call.sender)
+                                 };
+        send_event(ev, session);
+        return session;
     }
 
 
+    /// Context of a pending configuration profile lookup
+    struct ConfigLookup
+    {
+        ConfigCache::Ptr cache;
+        std::string config_path;
+        uint64_t generation;
+    };
+
+
     /**
-     *  Initiate a shutdown of the VPN client backend process.
+     *  Retrieves the configuration profile details needed when the
+     *  backend of a new session registers, without waiting for the
+     *  configuration manager.  Nothing is done if they are cached or
+     *  already being retrieved.
      *
-     * @param forced             If set to True, it will not do a normal
-     *                           disconnect but tell the backend process
-     *                           to stop more abruptly.
-     * @param selfdestruct_flag  If set to True, this D-Bus session object
-     *                           will be destroyed.  If not, it needs to
-     *                           be removed later on independently.  Used to
-     *                           allow front-ends to retrieve the last sent
-     *                           status message, which can be AUTH_FAILED.
+     * @param conn         GDBusConnection to use
+     * @param config_path  std::string with the D-Bus path of the profile
      */
-    void shutdown(bool forced, bool selfdestruct_flag)
+    void prefetch_config(GDBusConnection *conn, const std::string& config_path)
     {
-        try
-        {
-            be_proxy->Call( (!forced ? "Disconnect" : "ForceShutdown"), true );
-            // Wait for child to exit
-            sleep(2); // FIXME: Catch the ProcessChange StatusMinor::PROC_STOPPED signal from backend
-        }
-        catch (DBusException& excp)
+        uint64_t generation = 0;
+        if (!config_cache->StartLookup(config_path, generation))
         {
-            Debug(excp.what());
-            // FIXME: For now, we just ignore any errors here - the
-            // backend process may not be running
+            return;
         }
+        g_dbus_connection_call(conn,
+                               OpenVPN3DBus_name_configuration.c_str(),
+                               config_path.c_str(),
+                               "org.freedesktop.DBus.Properties",
+                               "GetAll",
+                               g_variant_new("(s)",
+                                             OpenVPN3DBus_interf_configuration.c_str()),
+                               G_VARIANT_TYPE("(a{sv})"),
+                               G_DBUS_CALL_FLAGS_NONE,
+                               -1,
+                               nullptr,
+                               prefetch_config_done,
+                               new ConfigLookup{config_cache, config_path, generation});
+    }
 
-        // Remove this session object
-        if (!forced)
+
+    /**
+     *  Completion of the GetAll call made by prefetch_config().  The
+     *  lookup context keeps the cache alive, so this does not depend on
+     *  the SessionManagerObject.
+     */
+    static void prefetch_config_done(GObject *source, GAsyncResult *result,
+                                     gpointer lookup_ptr)
+    {
+        std::unique_ptr<ConfigLookup> lookup(static_cast<ConfigLookup *>(lookup_ptr));
+        GError *err = nullptr;
+        GVariant *res = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                      result, &err);
+        if (nullptr == res)
         {
-            StatusChange(StatusMajor::SESSION, StatusMinor::PROC_STOPPED, "Session closed");
+            g_error_free(err);
+            lookup->cache->LookupFailed(lookup->config_path, lookup->generation);
+            return;
         }
-        else
+
+        GVariant *props = g_variant_get_child_value(res, 0);
+        guint32 owner = 0;
+        gboolean transfer = FALSE;
+        bool found = g_variant_lookup(props, "owner", "u", &owner)
+                     && g_variant_lookup(props, "transfer_owner_session", "b", &transfer);
+        g_variant_unref(props);
+        g_variant_unref(res);
+        if (!found)
         {
-            StatusChange(StatusMajor::SESSION, StatusMinor::PROC_KILLED, "Session closed, killed backend client");
+            lookup->cache->LookupFailed(lookup->config_path, lookup->generation);
+            return;
         }
 
-        if (selfdestruct_flag)
+        ConfigCache::Info info;
+        info.owner = owner;
+        info.transfer_owner_session = transfer;
+        lookup->cache->Store(lookup->config_path, lookup->generation, info);
+    }
+
+
+    /**
+     *  Called on PropertiesChanged signals from configuration profiles
+     */
+    static void config_changed(GDBusConnection *conn,
+                               const gchar *sender,
+                               const gchar *obj_path,
+                               const gchar *intf_name,
+                               const gchar *signal_name,
+                               GVariant *params,
+                               gpointer this_ptr)
+    {
+        SessionManagerObject *self = static_cast<SessionManagerObject *>(this_ptr);
+        self->config_cache->Invalidate(obj_path);
+    }
+
+
+    /**
+     *  Called when the configuration manager is no longer on the D-Bus
+     */
+    static void configmgr_vanished(GDBusConnection *conn,
+                                   const gchar *name,
+                                   gpointer this_ptr)
+    {
+        SessionManagerObject *self = static_cast<SessionManagerObject *>(this_ptr);
+        self->config_cache->Clear();
+    }
+
+
+    /**
+     *  Registers a new SessionObject on the D-Bus and in the session
+     *  registry
+     *
+     * @param conn      GDBusConnection to register the object on
+     * @param sesspath  std::string with the D-Bus path of the session
+     * @param session   The new SessionObject
+     */
+    void add_session(GDBusConnection *conn, const std::string& sesspath,
+                     SessionObject *session)
+    {
+        IdleCheck_RefInc();
+        session->IdleCheck_Register(IdleCheck_Get());
+        session->RegisterObject(conn);
+        sessions.Add(sesspath, session, session->GetBackendToken());
+        ++change_counter;
+        objmgr->ObjectAdded(session);
+        session->SetReconnectCache(reconnect_cache);
+        session->SetConfigCache(config_cache);
+        session->SetConnectAdmission(connect_admission);
+        session->SetRemoteBackoff(remote_backoff,
+                                  [self=Ptr(this)]()
+                                  {
+                                      self->send_remote_backoff();
+                                  });
+        session->EnablePeerLink(backend_peer_link);
+        session->SetIndexUpdateCallback([self=Ptr(this), session, sesspath]()
+                                        {
+                                            self->sessions.Update(sesspath,
+                                                                  session->GetConfigName(),
+                                                                  session->GetKnownDeviceName());
+                                            ++self->change_counter;
+                                        });
+        session->SetStoreUpdateCallback([self=Ptr(this), session]()
+                                        {
+                                            self->store.Set(session->GetStoreEntry());
+                                            self->write_store();
+                                            // Also called when the ACL changes
+                                            self->publish_status(session, false);
+                                        });
+        session->SetStatusBoardCallback([self=Ptr(this), session](bool counters_only)
+                                        {
+                                            self->publish_status(session, counters_only);
+                                        });
+        if (!status_boards.empty())
         {
-            selfdestruct(DBusSignalSubscription::GetConnection());
+            session->SetStatusBoardInterval(status_board_interval_ms);
         }
     }
 
 
     /**
-     *  This method is dangerous and should only be used by either the
-     *  SessionObject::shutdown() method or exception handlers in the
-     *  SessionObject.
+     *  Updates a session on the status boards.  A session is put on the
+     *  board of each user it is accessible to and removed from the other
+     *  boards.
      *
-     *  This will initiate deleting this SessionObject from the D-Bus and then
-     *  destroy itself.
-     *
-     * @param conn  D-Bus connection to use when removing this object from
-     *              the D-Bus.
+     * @param session        SessionObject to publish
+     * @param counters_only  Only the statistics counters have changed;
+     *                       the access to the session is not evaluated
+     *                       again
      */
-    void selfdestruct(GDBusConnection *conn)
+    void publish_status(SessionObject *session, const bool counters_only)
     {
-        // Object may still be available via other threads for a short
-        // while, which can cause havoc if not handled properly.  There
-        // are a few call-chains when the backend client process dies which
-        // may call selfdestruct() a couple of times at the almost the same
-        // time.  So we add a lock here, to ensure only the first
-        // selfdestruct() event is handled.  After this first call have
-        // completed, this object is to be considered dead.
-        //
-        // !! WARNING: ONLY EXCEPTION HANDLERS AND shutdown()  !!
-        // !! WARNING:       MAY CALL THIS FUNCTION!           !!
-        //
-        std::lock_guard<std::mutex> guard(selfdestruct_guard);
-        if (selfdestruct_complete)
+        if (status_boards.empty())
         {
             return;
         }
-        RemoveObject(conn);
-        selfdestruct_complete = true;
-
-        delete this;
+        const SessionManager::StatusBoard::Session entry = session->GetStatusBoardEntry();
+        const std::string path(entry.session_path);
+        for (const auto& b : status_boards)
+        {
+            if (counters_only)
+            {
+                b.second->SetCounters(path, entry);
+            }
+            else if (session->CheckUIDAccess(b.first))
+            {
+                if (!b.second->Set(entry))
+                {
+                    LogWarn("Status board of uid " + std::to_string(b.first)
+                            + " is full, " + path + " is not listed");
+                }
+            }
+            else
+            {
+                b.second->Remove(path);
+            }
+        }
     }
-};
-
 
-/**
- *   A SessionManagerObject is the main entry point when starting new
- *   VPN tunnels.  It should only exist a single SessionManagerObject during
- *   the life cycle of the openvpn3-service-sessoinmgr process.
- */
-class SessionManagerObject : public DBusObject,
-                             public SessionManagerSignals,
-                             public RC<thread_safe_refcount>
-{
-public:
-    typedef RCPtr<SessionManagerObject> Ptr;
 
     /**
-     *  Constructor initializing the SessionManagerObject to be registered on
-     *  the D-Bus.
+     *  Retrieves the status board of a user, creating it on the first
+     *  request of this user.  Once the first board exists, the backends
+     *  push their counters for the boards regularly.
      *
-     * @param dbuscon  D-Bus this object is tied to
-     * @param objpath  D-Bus object path to this object
-     * @param logwr    Pointer to LogWriter object; can be nullptr to
-     *                 disablefile log.
+     * @param uid  uid_t of the user
      *
+     * @return Returns the SessionManager::StatusBoard::Ptr of the user
      */
-    SessionManagerObject(GDBusConnection *dbuscon, const std::string objpath,
-                         unsigned int manager_log_level, LogWriter *logwr,
-                         bool signal_broadcast)
-        : DBusObject(objpath),
-          SessionManagerSignals(dbuscon, objpath, manager_log_level, logwr,
-                                signal_broadcast),
-          dbuscon(dbuscon),
-          creds(dbuscon)
+    SessionManager::StatusBoard::Ptr get_status_board(const uid_t uid)
     {
-        std::stringstream introspection_xml;
-        introspection_xml << "<node name='" << objpath << "'>"
-                          << "    <interface name='" << OpenVPN3DBus_interf_sessions << "'>"
-                          << "        <method name='NewTunnel'>"
-                          << "          <arg type='o' name='config_path' direction='in'/>"
-                          << "          <arg type='o' name='session_path' direction='out'/>"
-                          << "        </method>"
-                          << "        <method name='FetchAvailableSessions'>"
-                          << "          <arg type='ao' name='paths' direction='out'/>"
-                          << "        </method>"
-                          << "        <method name='FetchManagedInterfaces'>"
-                          << "          <arg type='as' name='devices' direction='out'/>"
-                          << "        </method>"
-                          << "        <method name='LookupConfigName'>"
-                          << "           <arg type='s' name='config_name' direction='in'/>"
-                          << "           <arg type='ao' name='session_paths' direction='out'/>"
-                          << "        </method>"
-                          << "        <method name='LookupInterface'>"
-                          << "           <arg type='s' name='device_name' direction='in'/>"
-                          << "           <arg type='o' name='session_path' direction='out'/>"
-                          << "        </method>"
-                          << "        <method name='TransferOwnership'>"
-                          << "           <arg type='o' name='path' direction='in'/>"
-                          << "           <arg type='u' name='new_owner_uid' direction='in'/>"
-                          << "        </method>"
-                          << "        <property type='s' name='version' access='read'/>"
-                          << GetLogIntrospection()
-                          << SessionManager::Event::GetIntrospection()
-                          << "    </interface>"
-                          << "</node>";
-        ParseIntrospectionXML(introspection_xml);
-
-        Debug("SessionManagerObject registered on '" + OpenVPN3DBus_interf_sessions + "': "
-                      + objpath);
-    }
+        auto it = status_boards.find(uid);
+        if (status_boards.end() != it)
+        {
+            return it->second;
+        }
 
-    ~SessionManagerObject()
-    {
-        LogInfo("Shutting down");
-        RemoveObject(dbuscon);
+        const bool first = status_boards.empty();
+        SessionManager::StatusBoard::Ptr board;
+        board.reset(new SessionManager::StatusBoard("openvpn3-status-"
+                                                    + std::to_string(uid),
+                                                    status_board_slots));
+        status_boards[uid] = board;
+        for (const auto& item : sessions.GetAll())
+        {
+            if (item.second->CheckUIDAccess(uid)
+                && !board->Set(item.second->GetStatusBoardEntry()))
+            {
+                LogWarn("Status board of uid " + std::to_string(uid)
+                        + " is full, " + item.first + " is not listed");
+            }
+            if (first)
+            {
+                item.second->SetStatusBoardInterval(status_board_interval_ms);
+            }
+        }
+        LogVerb2("Status board created for uid " + std::to_string(uid));
+        return board;
     }
 
 
     /**
-     *  Callback method called each time a method in the SessionManagerObject
-     *  is called over the D-Bus.
-     *
-     * @param conn       D-Bus connection where the method call occurred
-     * @param sender     D-Bus bus name of the sender of the method call
-     * @param obj_path   D-Bus object path of the target object.
-     * @param intf_name  D-Bus interface of the method call
-     * @param method_name D-Bus method name to be executed
-     * @param params     GVariant Glib2 object containing the arguments for
-     *                   the method call
-     * @param invoc      GDBusMethodInvocation where the response/result of
-     *                   the method call will be returned.
+     *  Handles the GetStatusBoard method call.  Returns a read-only file
+     *  descriptor to the status board of the caller, holding all the
+     *  sessions the caller has access to.  The board is created on the
+     *  first request of a user and kept up to date from then on.
      */
-    void callback_method_call(GDBusConnection *conn,
-                              const std::string sender,
-                              const std::string obj_path,
-                              const std::string intf_name,
-                              const std::string method_name,
-                              GVariant *params,
-                              GDBusMethodInvocation *invoc)
+    void method_get_status_board(const MethodCall& call)
     {
-        // std::cout << "SessionManagerObject::callback_method_call: " << method_name << std::endl;
-        if ("NewTunnel" == method_name)
+        int fd = -1;
+        try
         {
-            IdleCheck_UpdateTimestamp();
-
-            // Retrieve the configuration path for the tunnel
-            // from the request
-            gchar *config_path_s = nullptr;
-            g_variant_get (params, "(o)", &config_path_s);
-            auto config_path = std::string(config_path_s);
-            g_free(config_path_s);
+            fd = get_status_board(creds.GetUID(call.sender))->GetReadOnlyFD();
+        }
+        catch (const std::exception& excp)
+        {
+            LogError("Could not provide a status board: "
+                     + std::string(excp.what()));
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.status-board",
+                                                          "Status board not available");
+            g_dbus_method_invocation_return_gerror(call.invoc, err);
+            g_error_free(err);
+            return;
+        }
 
-            // Create session object, which will proxy calls
-            // from the front-end to the backend
-            std::string sesspath = generate_path_uuid(OpenVPN3DBus_rootp_sessions, 's');
+        GUnixFDList *fdlist = g_unix_fd_list_new();
+        GError *error = nullptr;
+        g_unix_fd_list_append(fdlist, fd, &error);
+        close(fd);
+        if (error)
+        {
+            g_error_free(error);
+            GLibUtils::unref_fdlist(fdlist);
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.status-board",
+                                                          "Could not pass the status board");
+            g_dbus_method_invocation_return_gerror(call.invoc, err);
+            g_error_free(err);
+            return;
+        }
+        g_dbus_method_invocation_return_value_with_unix_fd_list(
+                    call.invoc,
+                    g_variant_new("(u)", SessionManager::StatusBoardLayout::VERSION),
+                    fdlist);
+        GLibUtils::unref_fdlist(fdlist);
+    }
 
-            // Create the new object and register it in D-Bus
-            auto callback = [self=Ptr(this), sesspath]()
-                            {
-                                self->remove_session_object(sesspath);
-                            };
-            SessionObject *session = new SessionObject(conn,
-                                                       callback,
-                                                       creds.GetUID(sender),
-                                                       sesspath,
-                                                       config_path,
-                                                       GetLogLevel(),
-                                                       logwr,
-                                                       GetSignalBroadcast());
-            IdleCheck_RefInc();
-            session->IdleCheck_Register(IdleCheck_Get());
-            session->RegisterObject(conn);
-            session_objects[sesspath] = session;
-            SessionManager::Event ev{sesspath,
-                                     SessionManager::EventType::SESS_CREATED,
-                                     creds.GetUID(sender)
-                                     };
-            Broadcast(OpenVPN3DBus_interf_sessions,
-                      OpenVPN3DBus_rootp_sessions,
-                      "SessionManagerEvent",
-                      ev.GetGVariant());
 
-            // Return the path to the new session object object to the caller
-            // The backend object will remind "hidden" for the end-user
-            g_dbus_method_invocation_return_value(invoc, g_variant_new("(o)", sesspath.c_str()));
+    /**
+     *  Handles the EventSubscribe and EventUnsubscribe method calls.  A
+     *  subscription is removed automatically when the subscriber
+     *  disconnects from the D-Bus.
+     *
+     * @param call       DBusObject::MethodCall with the call details
+     * @param subscribe  true to add a subscription, false to remove it
+     */
+    void method_event_subscribe(const MethodCall& call, const bool subscribe)
+    {
+        auto it = event_subscribers.find(call.sender);
+        if (subscribe && event_subscribers.end() == it)
+        {
+            guint watch = g_bus_watch_name_on_connection(
+                                call.conn,
+                                call.sender,
+                                G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                nullptr,
+                                event_subscriber_vanished,
+                                this, nullptr);
+            event_subscribers[call.sender] = {creds.GetUID(call.sender), watch};
+            LogVerb2("SessionManagerEvent subscription from "
+                     + std::string(call.sender));
         }
-        else if ("FetchAvailableSessions" == method_name
-                || "FetchManagedInterfaces" == method_name)
+        else if (!subscribe && event_subscribers.end() != it)
         {
-            bool ret_iface = ("FetchManagedInterfaces" == method_name);
+            g_bus_unwatch_name(it->second.watch_id);
+            event_subscribers.erase(it);
+            LogVerb2("SessionManagerEvent subscription removed for "
+                     + std::string(call.sender));
+        }
+        g_dbus_method_invocation_return_value(call.invoc, nullptr);
+    }
 
-            // Build up an array of object paths or device list of available
-            // session objects
-            GVariantBuilder *bld;
-            bld = g_variant_builder_new(G_VARIANT_TYPE(ret_iface ? "as" : "ao"));
-            for (auto& item : session_objects)
-            {
-                try {
-                    // We check if the caller is allowed to access this
-                    // session object.  If not, an exception is thrown
-                    // and we will just ignore that exception and continue
-                    item.second->CheckACL(sender);
-                    if (ret_iface)
-                    {
-                        g_variant_builder_add(bld, "s", item.second->GetDeviceName().c_str());
-                    }
-                    else
-                    {
-                        g_variant_builder_add(bld, "o", item.first.c_str());
-                    }
+
+    /**
+     *  Handles the FetchAvailableSessions and FetchManagedInterfaces
+     *  method calls.
+     *
+     * @param call       DBusObject::MethodCall with the call details
+     * @param ret_iface  If true, return device names instead of session
+     *                   object paths
+     */
+    void method_fetch_sessions(const MethodCall& call, const bool ret_iface)
+    {
+        // Build up an array of object paths or device list of available
+        // session objects
+        GVariantBuilder *bld;
+        bld = g_variant_builder_new(G_VARIANT_TYPE(ret_iface ? "as" : "ao"));
+        for (const auto& item : sessions.GetAll())
+        {
+            try {
+                // We check if the caller is allowed to access this
+                // session object.  If not, an exception is thrown
+                // and we will just ignore that exception and continue
+                item.second->CheckACL(call.sender);
+                if (ret_iface)
+                {
+                    g_variant_builder_add(bld, "s", item.second->GetDeviceName().c_str());
                 }
-                catch (DBusCredentialsException& excp)
+                else
                 {
-                    // Ignore credentials exceptions.  It means the
-                    // caller does not have access this session object
+                    g_variant_builder_add(bld, "o", item.first.c_str());
                 }
             }
+            catch (DBusCredentialsException& excp)
+            {
+                // Ignore credentials exceptions.  It means the
+                // caller does not have access this session object
+            }
+        }
 
-            // Wrap up the result into a tuple, which GDBus expects and
-            // put it into the invocation response
-            GVariantBuilder *ret = g_variant_builder_new(G_VARIANT_TYPE_TUPLE);
-            g_variant_builder_add_value(ret, g_variant_builder_end(bld));
-            g_dbus_method_invocation_return_value(invoc,
-                                                  g_variant_builder_end(ret));
+        // Wrap up the result into a tuple, which GDBus expects and
+        // put it into the invocation response
+        GVariantBuilder *ret = g_variant_builder_new(G_VARIANT_TYPE_TUPLE);
+        g_variant_builder_add_value(ret, g_variant_builder_end(bld));
+        g_dbus_method_invocation_return_value(call.invoc,
+                                              g_variant_builder_end(ret));
 
-            // Clean-up
-            g_variant_builder_unref(bld);
-            g_variant_builder_unref(ret);
+        // Clean-up
+        g_variant_builder_unref(bld);
+        g_variant_builder_unref(ret);
+    }
+
+
+    /**
+     *  Handles the FetchSessionsFiltered and FetchManagedInterfacesFiltered
+     *  method calls.  Only the sessions matching the filter are returned,
+     *  one page at a time.
+     *
+     * @param call       DBusObject::MethodCall with the call details
+     * @param ret_iface  If true, return device names instead of session
+     *                   object paths.  Sessions without a device are
+     *                   left out.
+     */
+    void method_fetch_sessions_filtered(const MethodCall& call,
+                                        const bool ret_iface)
+    {
+        ListFilter filter;
+        try
+        {
+            filter = ParseListFilterArgs(call.params);
         }
-        else if ("LookupConfigName" == method_name)
+        catch (const std::invalid_argument& excp)
         {
-            gchar *cfgname_c = nullptr;
-            g_variant_get(params, "(s)", &cfgname_c);
+            ReturnListFilterError(call.invoc, excp);
+            return;
+        }
 
-            if (nullptr == cfgname_c || strlen(cfgname_c) < 1)
+        // The filter is checked first; it is cheaper than the
+        // access check
+        std::map<std::string, std::string> devices;
+        std::vector<std::string> matches;
+        for (const auto& item : sessions.GetAll())
+        {
+            if (!filter.Match(item.second->GetListFilterItem()))
             {
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.name",
-                                                              "Invalid configuration name");
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-                return;
+                continue;
             }
-            std::string cfgname(cfgname_c);
-            g_free(cfgname_c);
-
-            // Build up an array of object paths to sessions with a matching
-            // configuration profile name
-            GVariantBuilder *found_paths = g_variant_builder_new(G_VARIANT_TYPE("ao"));
-            for (const auto& item : session_objects)
+            std::string dev;
+            if (ret_iface)
             {
-                if (item.second->GetConfigName() == cfgname)
+                dev = item.second->GetDeviceName();
+                if (dev.empty())
                 {
-                    try
-                    {
-                        // We check if the caller is allowed to access this
-                        // configuration object.  If not, an exception is thrown
-                        // and we will just ignore that exception and continue
-                        item.second->CheckACL(sender);
-                        g_variant_builder_add(found_paths,
-                                              "o", item.first.c_str());
-                    }
-                    catch (DBusCredentialsException& excp)
-                    {
-                        // Ignore credentials exceptions.  It means the
-                        // caller does not have access this configuration object
-                    }
+                    continue;
                 }
             }
-            g_dbus_method_invocation_return_value(invoc, GLibUtils::wrapInTuple(found_paths));
-            return;
+            try
+            {
+                item.second->CheckACL(call.sender);
+                matches.push_back(item.first);
+                if (ret_iface)
+                {
+                    devices[item.first] = dev;
+                }
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                // Ignore credentials exceptions.  It means the
+                // caller does not have access this session object
+            }
         }
-        else if ("LookupInterface" == method_name)
-        {
-            gchar *iface_c = nullptr;
-            g_variant_get(params, "(s)", &iface_c);
 
-            if (nullptr == iface_c || strlen(iface_c) < 1)
+        // The cursor is always a session object path, also when
+        // returning device names
+        ListFilter::Page page = filter.Select(std::move(matches));
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE(ret_iface ? "as" : "ao"));
+        for (const auto& path : page.paths)
+        {
+            if (ret_iface)
             {
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.iface",
-                                                              "Invalid interface");
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-                return;
+                g_variant_builder_add(bld, "s", devices[path].c_str());
             }
-            std::string iface(iface_c);
-            g_free(iface_c);
-
-            GVariant *ret = nullptr;
-            for (const auto& item : session_objects)
+            else
             {
-                if (item.second->GetDeviceName() == iface)
-                {
-                    ret = g_variant_new("(o)", item.first.c_str());
-                    break;
-                }
+                g_variant_builder_add(bld, "o", path.c_str());
             }
+        }
+        g_dbus_method_invocation_return_value(call.invoc,
+                                              g_variant_new((ret_iface ? "(ass)" : "(aos)"),
+                                                            bld, page.next.c_str()));
+        g_variant_builder_unref(bld);
+    }
+
 
-            if (nullptr == ret)
+    /**
+     *  Handles the FetchSessionsDetailed method call
+     */
+    void method_fetch_sessions_detailed(const MethodCall& call)
+    {
+        GVariantBuilder *bld = g_variant_builder_new(G_VARIANT_TYPE("a{oa{sv}}"));
+        for (const auto& item : sessions.GetAll())
+        {
+            try
             {
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.iface",
-                                                              "Interface not found");
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-                return;
+                // Only include sessions the caller has access to
+                item.second->CheckACL(call.sender);
+                g_variant_builder_add(bld, "{o@a{sv}}", item.first.c_str(),
+                                      item.second->GetSessionDetails());
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                // Ignore credentials exceptions.  It means the
+                // caller does not have access this session object
             }
-            g_dbus_method_invocation_return_value(invoc, ret);
-            return;
         }
-        else if ("TransferOwnership" == method_name)
+        g_dbus_method_invocation_return_value(call.invoc,
+                                              GLibUtils::wrapInTuple(bld));
+    }
+
+
+    /**
+     *  Handles the DisconnectAll method call.  All the sessions the
+     *  caller may manage, optionally only those of a configuration
+     *  profile name, are told to disconnect at the same time.  The call
+     *  is completed once all their backend processes have exited, so
+     *  the time it takes is that of the slowest session instead of the
+     *  sum of all of them.
+     */
+    void method_disconnect_all(const MethodCall& call)
+    {
+        gchar *cfgname_c = nullptr;
+        gboolean forced = false;
+        g_variant_get(call.params, "(sb)", &cfgname_c, &forced);
+        std::string cfgname(cfgname_c ? cfgname_c : "");
+        g_free(cfgname_c);
+
+        // Collect the sessions first; a session without a running
+        // backend is removed from the registry right away when
+        // disconnected
+        SessionRegistry<SessionObject>::ItemList selected;
+        for (const auto& item : (cfgname.empty() ? sessions.GetAll()
+                                                 : sessions.GetByConfigName(cfgname)))
         {
-            // This feature is quite powerful and is restricted to the
-            // root account only.  This is typically used by openvpn3-autoload
-            // when run during boot where the auto-load configuration starts
-            // a new session automatically wants the owner to be someone else
-            // than root.
-            if (0 != creds.GetUID(sender))
+            try
             {
-                GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.acl.denied",
-                                                              "Access Denied");
-                g_dbus_method_invocation_return_gerror(invoc, err);
-                g_error_free(err);
-                return;
+                item.second->CheckACL_allowRoot(call.sender, true);
+                selected.push_back(item);
             }
-            gchar *sesspath = nullptr;
-            uid_t new_uid = 0;
-            g_variant_get(params, "(ou)", &sesspath, &new_uid);
-
-            for (const auto& si : session_objects)
+            catch (DBusCredentialsException& excp)
             {
-                if (si.first == sesspath)
-                {
-                    uid_t cur_owner = si.second->GetOwnerUID();
-                    si.second->TransferOwnership(new_uid);
-                    g_dbus_method_invocation_return_value(invoc, NULL);
-
-                    std::stringstream msg;
-                    msg << "Transfered ownership from " << cur_owner
-                        << " to " << new_uid
-                        << " on session " << sesspath;
-                    LogInfo(msg.str());
-                    return;
-                }
+                // Ignore credentials exceptions.  It means the
+                // caller does not have access this session object
             }
-            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.path",
-                                                          "Invalid session path");
-            g_dbus_method_invocation_return_gerror(invoc, err);
-            g_error_free(err);
+        }
+
+        GVariantBuilder *paths = g_variant_builder_new(G_VARIANT_TYPE("ao"));
+        for (const auto& item : selected)
+        {
+            g_variant_builder_add(paths, "o", item.first.c_str());
+        }
+        GVariant *result = g_variant_ref_sink(GLibUtils::wrapInTuple(paths));
+
+        LogInfo("Disconnecting " + std::to_string(selected.size())
+                + " session" + (1 == selected.size() ? "" : "s")
+                + (cfgname.empty() ? "" : " of '" + cfgname + "'"));
+        if (selected.empty())
+        {
+            g_dbus_method_invocation_return_value(call.invoc, result);
+            g_variant_unref(result);
             return;
         }
-    };
+
+        // The last session to close completes the method call
+        auto pending = std::make_shared<size_t>(selected.size());
+        GDBusMethodInvocation *invoc = call.invoc;
+        auto done = [pending, invoc, result]()
+                    {
+                        if (0 == --(*pending))
+                        {
+                            g_dbus_method_invocation_return_value(invoc, result);
+                            g_variant_unref(result);
+                        }
+                    };
+        for (const auto& item : selected)
+        {
+            item.second->Disconnect(forced, done);
+        }
+    }
 
 
     /**
-     *  Callback which is used each time a SessionManagerObject D-Bus
-     *  property is being read.
-     *
-     *  For the SessionManagerObject, this method will just return NULL
-     *  with an error set in the GError return pointer.  The
-     *  SessionManagerObject does not use properties at all.
-     *
-     * @param conn           D-Bus connection this event occurred on
-     * @param sender         D-Bus bus name of the requester
-     * @param obj_path       D-Bus object path to the object being requested
-     * @param intf_name      D-Bus interface of the property being accessed
-     * @param property_name  The property name being accessed
-     * @param error          A GLib2 GError object if an error occurs
-     *
-     * @return  Returns always NULL, as there are no properties in the
-     *          SessionManagerObject.
+     *  Handles the LookupConfigName method call
      */
-    GVariant * callback_get_property(GDBusConnection *conn,
-                                     const std::string sender,
-                                     const std::string obj_path,
-                                     const std::string intf_name,
-                                     const std::string property_name,
-                                     GError **error)
+    void method_lookup_config_name(const MethodCall& call)
     {
-        IdleCheck_UpdateTimestamp();
-        GVariant *ret = nullptr;
+        gchar *cfgname_c = nullptr;
+        g_variant_get(call.params, "(s)", &cfgname_c);
 
-        if ("version" == property_name)
+        if (nullptr == cfgname_c || strlen(cfgname_c) < 1)
         {
-            ret = g_variant_new_string(package_version());
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.name",
+                                                          "Invalid configuration name");
+            g_dbus_method_invocation_return_gerror(call.invoc, err);
+            g_error_free(err);
+            return;
         }
-        else
+        std::string cfgname(cfgname_c);
+        g_free(cfgname_c);
+
+        // Build up an array of object paths to sessions with a matching
+        // configuration profile name
+        GVariantBuilder *found_paths = g_variant_builder_new(G_VARIANT_TYPE("ao"));
+        for (const auto& session : sessions.GetByConfigName(cfgname))
         {
-            g_set_error (error,
-                         G_IO_ERROR,
-                         G_IO_ERROR_FAILED,
-                         "Unknown property");
+            try
+            {
+                // We check if the caller is allowed to access this
+                // configuration object.  If not, an exception is thrown
+                // and we will just ignore that exception and continue
+                session.second->CheckACL(call.sender);
+                g_variant_builder_add(found_paths,
+                                      "o", session.first.c_str());
+            }
+            catch (DBusCredentialsException& excp)
+            {
+                // Ignore credentials exceptions.  It means the
+                // caller does not have access this configuration object
+            }
         }
-        return ret;
-    };
+        g_dbus_method_invocation_return_value(call.invoc, GLibUtils::wrapInTuple(found_paths));
+    }
+
 
     /**
-     *  Callback method which is used each time a SessionManagerObject
-     *  property is being modified over the D-Bus.
-     *
-     *  This will always fail with an exception, as there exists no properties
-     *  which can be modified in a SessionManagerObject.
-     *
-     * @param conn           D-Bus connection this event occurred on
-     * @param sender         D-Bus bus name of the requester
-     * @param obj_path       D-Bus object path to the object being requested
-     * @param intf_name      D-Bus interface of the property being accessed
-     * @param property_name  The property name being accessed
-     * @param value          GVariant object containing the value to be stored
-     * @param error          A GLib2 GError object if an error occurs
-     *
-     * @return Will always throw an execption as there are no properties to
-     *         modify.
+     *  Handles the LookupInterface method call
      */
-    GVariantBuilder * callback_set_property(GDBusConnection *conn,
-                                            const std::string sender,
-                                            const std::string obj_path,
-                                            const std::string intf_name,
-                                            const std::string property_name,
-                                            GVariant *value,
-                                            GError **error)
+    void method_lookup_interface(const MethodCall& call)
     {
-        THROW_DBUSEXCEPTION("SessionManagerObject", "set property not implemented");
-    }
+        gchar *iface_c = nullptr;
+        g_variant_get(call.params, "(s)", &iface_c);
 
+        if (nullptr == iface_c || strlen(iface_c) < 1)
+        {
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.iface",
+                                                          "Invalid interface");
+            g_dbus_method_invocation_return_gerror(call.invoc, err);
+            g_error_free(err);
+            return;
+        }
+        std::string iface(iface_c);
+        g_free(iface_c);
 
-private:
-    GDBusConnection *dbuscon;
-    DBusConnectionCreds creds;
-    std::map<std::string, SessionObject *> session_objects;
+        GVariant *ret = nullptr;
+        auto found = sessions.GetByDeviceName(iface);
+        if (found.second)
+        {
+            ret = g_variant_new("(o)", found.first.c_str());
+        }
+        else
+        {
+            // The device may not be indexed yet, if the connection is
+            // still being established; ask the backends
+            for (const auto& item : sessions.GetAll())
+            {
+                if (item.second->GetDeviceName() == iface)
+                {
+                    ret = g_variant_new("(o)", item.first.c_str());
+                    break;
+                }
+            }
+        }
 
-    void remove_session_object(const std::string sesspath)
+        if (nullptr == ret)
+        {
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.iface",
+                                                          "Interface not found");
+            g_dbus_method_invocation_return_gerror(call.invoc, err);
+            g_error_free(err);
+            return;
+        }
+        g_dbus_method_invocation_return_value(call.invoc, ret);
+    }
+
+
+    /**
+     *  Handles the TransferOwnership method call
+     */
+    void method_transfer_ownership(const MethodCall& call)
     {
-        uid_t owner = session_objects[sesspath]->GetOwnerUID();
-        session_objects.erase(sesspath);
+        // This feature is quite powerful and is restricted to the
+        // root account only.  This is typically used by openvpn3-autoload
+        // when run during boot where the auto-load configuration starts
+        // a new session automatically wants the owner to be someone else
+        // than root.
+        if (0 != creds.GetUID(call.sender))
+        {
+            GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.acl.denied",
+                                                          "Access Denied");
+            g_dbus_method_invocation_return_gerror(call.invoc, err);
+            g_error_free(err);
+            return;
+        }
+        gchar *sesspath = nullptr;
+        uid_t new_uid = 0;
+        g_variant_get(call.params, "(ou)", &sesspath, &new_uid);
 
-        SessionManager::Event ev{sesspath,
-                                 SessionManager::EventType::SESS_DESTROYED,
-                                 owner};
-        Broadcast(OpenVPN3DBus_interf_sessions,
-                  OpenVPN3DBus_rootp_sessions,
-                  "SessionManagerEvent",
-                  ev.GetGVariant());
+        SessionObject *session = sessions.Get(sesspath);
+        if (session)
+        {
+            uid_t cur_owner = session->GetOwnerUID();
+            session->TransferOwnership(new_uid);
+            session->StoreUpdate();
+            g_dbus_method_invocation_return_value(call.invoc, NULL);
+
+            std::stringstream msg;
+            msg << "Transfered ownership from " << cur_owner
+                << " to " << new_uid
+                << " on session " << sesspath;
+            LogInfo(msg.str());
+            g_free(sesspath);
+            return;
+        }
+        g_free(sesspath);
+        GError *err = g_dbus_error_new_for_dbus_error("net.openvpn.v3.error.path",
+                                                      "Invalid session path");
+        g_dbus_method_invocation_return_gerror(call.invoc, err);
+        g_error_free(err);
     }
 };
 
@@ -2152,6 +5333,62 @@ public:
     }
 
 
+    /**
+     *  Use private peer-to-peer D-Bus connections to the backend
+     *  processes instead of the system bus
+     *
+     * @param enable  bool, true to enable the peer links
+     */
+    void EnableBackendPeerLink(bool enable)
+    {
+        backend_peer_link = enable;
+    }
+
+
+    /**
+     *  Limits the number of sessions connecting at the same time, see
+     *  SessionManagerObject::SetConnectAdmission()
+     */
+    void SetConnectAdmission(unsigned int max_concurrent, unsigned int jitter_ms)
+    {
+        max_connects = max_concurrent;
+        connect_jitter_ms = jitter_ms;
+    }
+
+
+    /**
+     *  Share the remote backoff state between the sessions, see
+     *  SessionManagerObject::EnableRemoteBackoff()
+     */
+    void EnableRemoteBackoff(bool enable)
+    {
+        remote_backoff = enable;
+    }
+
+
+    /**
+     *  Pause and resume the sessions when the host sleeps
+     *
+     * @param enable  bool, true to follow the logind sleep events
+     */
+    void EnableSleepMonitor(bool enable)
+    {
+        sleep_monitor = enable;
+    }
+
+
+    /**
+     *  Sets the directory where the running sessions are recorded,
+     *  see SessionManagerObject::SetStateDirectory()
+     *
+     * @param stdir  std::string with the state directory
+     */
+    void SetStateDirectory(const std::string& stdir)
+    {
+        state_dir = stdir;
+    }
+
+
     /**
      *  This callback is called when the service was successfully registered
      *  on the D-Bus.
@@ -2163,9 +5400,14 @@ public:
         managobj.reset(new SessionManagerObject(GetConnection(), GetRootPath(),
                                                 manager_log_level, logwr,
                                                 signal_broadcast));
+        managobj->EnableBackendPeerLink(backend_peer_link);
+        managobj->EnableSleepMonitor(sleep_monitor);
+        managobj->SetConnectAdmission(max_connects, connect_jitter_ms);
+        managobj->EnableRemoteBackoff(remote_backoff);
 
         // Register this object to on the D-Bus
         managobj->RegisterObject(GetConnection());
+        managobj->GetObjectManager().RegisterObject(GetConnection());
 
         procsig->ProcessChange(StatusMinor::PROC_STARTED);
 
@@ -2180,17 +5422,35 @@ public:
      *  This is called each time the well-known bus name is successfully
      *  acquired on the D-Bus.
      *
-     *  This is not used, as the preparations already happens in
-     *  callback_bus_acquired()
+     *  The sessions of a previous session manager are taken over here,
+     *  as their backend processes only respond to the owner of the
+     *  well-known bus name.
      *
      * @param conn     Connection where this event happened
      * @param busname  A string of the acquired bus name
      */
     void callback_name_acquired(GDBusConnection *conn, std::string busname)
     {
+        if (managobj && !state_dir.empty())
+        {
+            managobj->SetStateDirectory(state_dir);
+            state_dir.clear();
+            StartupTiming::Instance().Mark("sessions_restored");
+        }
     };
 
 
+    /**
+     *  Logs the start-up timeline of the session manager
+     *
+     * @param timeline  std::string with the StartupTiming summary
+     */
+    void callback_startup_complete(const std::string& timeline)
+    {
+        managobj->LogInfo("Start-up completed: " + timeline);
+    }
+
+
     /**
      *  This is called each time the well-known bus name is removed from the
      *  D-Bus.  In our case, we just throw an exception and starts shutting
@@ -2210,6 +5470,12 @@ private:
     unsigned int manager_log_level = 6; // LogCategory::DEBUG
     LogWriter *logwr = nullptr;
     bool signal_broadcast = true;
+    bool backend_peer_link = false;
+    bool sleep_monitor = true;
+    unsigned int max_connects = 0;
+    unsigned int connect_jitter_ms = 1000;
+    bool remote_backoff = false;
+    std::string state_dir;
     SessionManagerObject::Ptr managobj;
     ProcessSignalProducer::Ptr procsig;
 };
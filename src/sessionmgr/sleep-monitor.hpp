@@ -0,0 +1,203 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   sleep-monitor.hpp
+ *
+ * @brief  Follows the suspend and resume events of systemd-logind
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <gio/gunixfdlist.h>
+
+#include "dbus/core.hpp"
+#include "dbus/glibutils.hpp"
+
+
+/**
+ *  Subscribes to the PrepareForSleep signal of systemd-logind, which is
+ *  sent right before the host suspends or hibernates and again when it
+ *  has resumed.
+ *
+ *  To get the time to act before the host goes to sleep, a delay
+ *  inhibitor lock is held while the host is awake.  The lock is released
+ *  once the sleep callback reports it is done, or by logind itself after
+ *  InhibitDelayMaxSec (5 seconds by default).  If the lock cannot be
+ *  taken, the callbacks are still called but the host may be asleep
+ *  before the sleep callback has completed.
+ */
+class SleepMonitor : public DBusSignalSubscription
+{
+public:
+    using Ptr = std::unique_ptr<SleepMonitor>;
+
+    /**
+     *  Called before the host goes to sleep.  The ready function must be
+     *  called when the preparations are done, which may be after the
+     *  callback has returned.
+     */
+    using SleepCallback = std::function<void(std::function<void()> ready)>;
+
+    /// Called after the host has resumed
+    using ResumeCallback = std::function<void()>;
+
+
+    /**
+     *  Subscribes to the logind signal and takes the delay inhibitor
+     *  lock
+     *
+     * @param conn       GDBusConnection to the system bus
+     * @param on_sleep   SleepCallback called before the host sleeps
+     * @param on_resume  ResumeCallback called after the host resumed
+     */
+    SleepMonitor(GDBusConnection *conn, SleepCallback on_sleep,
+                 ResumeCallback on_resume)
+        : DBusSignalSubscription(conn, "org.freedesktop.login1",
+                                 "org.freedesktop.login1.Manager",
+                                 "/org/freedesktop/login1",
+                                 "PrepareForSleep"),
+          conn(conn), on_sleep(on_sleep), on_resume(on_resume)
+    {
+        take_inhibitor();
+    }
+
+
+    ~SleepMonitor()
+    {
+        *alive = false;
+        release_inhibitor();
+        Cleanup();
+    }
+
+
+    /**
+     * @return Returns true if the delay inhibitor lock is held
+     */
+    bool HasInhibitor() const noexcept
+    {
+        return inhibit_fd >= 0;
+    }
+
+
+    void callback_signal_handler(GDBusConnection *connection,
+                                 const std::string sender_name,
+                                 const std::string object_path,
+                                 const std::string interface_name,
+                                 const std::string signal_name,
+                                 GVariant *parameters) override
+    {
+        if ("PrepareForSleep" != signal_name)
+        {
+            return;
+        }
+        gboolean start = FALSE;
+        g_variant_get(parameters, "(b)", &start);
+
+        if (start)
+        {
+            // Only the ready call of the latest sleep may release the
+            // lock taken after the previous resume
+            const unsigned int gen = ++generation;
+            std::shared_ptr<bool> is_alive = alive;
+            on_sleep([this, is_alive, gen]()
+                     {
+                         if (*is_alive && gen == generation)
+                         {
+                             release_inhibitor();
+                         }
+                     });
+        }
+        else
+        {
+            ++generation;
+            take_inhibitor();
+            on_resume();
+        }
+    }
+
+
+private:
+    GDBusConnection *conn = nullptr;
+    SleepCallback on_sleep;
+    ResumeCallback on_resume;
+    int inhibit_fd = -1;
+    unsigned int generation = 0;
+    std::shared_ptr<bool> alive = std::make_shared<bool>(true);
+
+
+    /**
+     *  Asks logind for a delay inhibitor lock on sleep.  The lock is
+     *  held as long as the returned file descriptor is open.  Check
+     *  HasInhibitor() for the result.
+     */
+    void take_inhibitor()
+    {
+        if (inhibit_fd >= 0)
+        {
+            return;
+        }
+
+        GUnixFDList *fdlist = nullptr;
+        GError *err = nullptr;
+        GVariant *res = g_dbus_connection_call_with_unix_fd_list_sync(
+                            conn,
+                            "org.freedesktop.login1",
+                            "/org/freedesktop/login1",
+                            "org.freedesktop.login1.Manager",
+                            "Inhibit",
+                            g_variant_new("(ssss)", "sleep", "OpenVPN 3",
+                                          "Pausing VPN sessions", "delay"),
+                            G_VARIANT_TYPE("(h)"),
+                            G_DBUS_CALL_FLAGS_NONE, -1,
+                            nullptr, &fdlist, nullptr, &err);
+        if (!res)
+        {
+            // Typically when logind is not available, like in containers
+            if (err)
+            {
+                g_error_free(err);
+            }
+            return;
+        }
+
+        gint32 idx = -1;
+        g_variant_get(res, "(h)", &idx);
+        g_variant_unref(res);
+        if (fdlist)
+        {
+            inhibit_fd = g_unix_fd_list_get(fdlist, idx, nullptr);
+            GLibUtils::unref_fdlist(fdlist);
+        }
+    }
+
+
+    void release_inhibitor()
+    {
+        if (inhibit_fd >= 0)
+        {
+            ::close(inhibit_fd);
+            inhibit_fd = -1;
+        }
+    }
+};
@@ -0,0 +1,456 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   status-board.hpp
+ *
+ * @brief  Shared memory table with the status of the VPN sessions,
+ *         which front-ends can read without any D-Bus calls
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common/memfd.hpp"
+
+
+namespace SessionManager
+{
+    /**
+     *  The memory layout of the status board.  A fixed size header is
+     *  followed by slot_count slots, each holding one session.  All
+     *  integers are in host byte order and strings are NUL terminated.
+     *
+     *  Each slot is protected by a sequence lock: the writer increases
+     *  seq to an odd value before changing the slot and to the next even
+     *  value when done.  Readers copy the slot and retry if seq was odd
+     *  or changed while copying.  Readers never block the writer.
+     */
+    namespace StatusBoardLayout
+    {
+        const uint32_t MAGIC = 0x4253564f;  // "OVSB"
+        const uint32_t VERSION = 1;
+
+        struct Header
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t slot_count;
+            uint32_t slot_size;
+        };
+
+        /**
+         *  The status of a session, as found in a slot
+         */
+        struct Session
+        {
+            uint32_t in_use;            ///< 0 if the slot is free
+            uint32_t owner;             ///< UID of the session owner
+            uint32_t backend_pid;       ///< PID of the VPN client process
+            uint32_t status_major;      ///< StatusMajor of the last status
+            uint32_t status_minor;      ///< StatusMinor of the last status
+            uint32_t reserved;
+            uint64_t updated;           ///< Unix time of the last update
+            uint64_t bytes_in;
+            uint64_t bytes_out;
+            uint64_t packets_in;
+            uint64_t packets_out;
+            char session_path[128];
+            char config_name[128];
+            char device_name[32];
+        };
+
+        struct Slot
+        {
+            std::atomic<uint32_t> seq;
+            uint32_t reserved;
+            Session session;
+        };
+
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                      "Lock-free 32-bit atomics are required");
+    } // namespace StatusBoardLayout
+
+
+
+    /**
+     *  Writer side of a status board.  The session manager keeps one
+     *  board per user, holding the sessions this user may access.  The
+     *  board lives in a memfd whose size is sealed, so readers can map
+     *  it safely.  Readers only get a read-only file descriptor, see
+     *  GetReadOnlyFD().
+     *
+     *  Not thread-safe; the session manager only updates the boards from
+     *  its main loop.
+     */
+    class StatusBoard
+    {
+    public:
+        using Ptr = std::shared_ptr<StatusBoard>;
+        using Session = StatusBoardLayout::Session;
+
+        /**
+         * @param name        std::string with the name of the memfd, only
+         *                    used for debugging purposes
+         * @param slot_count  Maximum number of sessions on the board
+         *
+         * @throws MemFDException on errors
+         */
+        StatusBoard(const std::string& name, uint32_t slot_count)
+            : slot_count(slot_count)
+        {
+            size = sizeof(StatusBoardLayout::Header)
+                   + slot_count * sizeof(StatusBoardLayout::Slot);
+            fd = ::memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+            if (fd < 0)
+            {
+                throw MemFDException("Could not create the status board: "
+                                     + std::string(strerror(errno)));
+            }
+            if (::ftruncate(fd, size) < 0
+                || ::fcntl(fd, F_ADD_SEALS,
+                           F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+            {
+                const int err = errno;
+                ::close(fd);
+                throw MemFDException("Could not prepare the status board: "
+                                     + std::string(strerror(err)));
+            }
+            void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+            if (MAP_FAILED == p)
+            {
+                const int err = errno;
+                ::close(fd);
+                throw MemFDException("Could not map the status board: "
+                                     + std::string(strerror(err)));
+            }
+            base = static_cast<uint8_t *>(p);
+
+            // The memfd starts zeroed, so all slots are free
+            auto *hdr = reinterpret_cast<StatusBoardLayout::Header *>(base);
+            hdr->version = StatusBoardLayout::VERSION;
+            hdr->slot_count = slot_count;
+            hdr->slot_size = sizeof(StatusBoardLayout::Slot);
+            std::atomic_thread_fence(std::memory_order_release);
+            hdr->magic = StatusBoardLayout::MAGIC;
+        }
+
+        ~StatusBoard()
+        {
+            ::munmap(base, size);
+            ::close(fd);
+        }
+
+        StatusBoard(const StatusBoard&) = delete;
+        StatusBoard& operator=(const StatusBoard&) = delete;
+
+
+        /**
+         *  Adds or updates the status of a session.  The session is
+         *  identified by its session_path.
+         *
+         * @param s  Session with the complete status of the session
+         *
+         * @return Returns false if the board is full
+         */
+        bool Set(const Session& s)
+        {
+            uint32_t idx = 0;
+            auto it = index.find(s.session_path);
+            if (it != index.end())
+            {
+                idx = it->second;
+            }
+            else if (!find_free(idx))
+            {
+                return false;
+            }
+            write_slot(idx, s);
+            index[s.session_path] = idx;
+            return true;
+        }
+
+
+        /**
+         *  Updates the counters of a session already on the board
+         *
+         * @param session_path  std::string with the session object path
+         * @param s             Session with the new counter values
+         *
+         * @return Returns false if the session is not on this board
+         */
+        bool SetCounters(const std::string& session_path, const Session& s)
+        {
+            auto it = index.find(session_path);
+            if (it == index.end())
+            {
+                return false;
+            }
+            Session upd = slot(it->second)->session;
+            upd.updated = s.updated;
+            upd.bytes_in = s.bytes_in;
+            upd.bytes_out = s.bytes_out;
+            upd.packets_in = s.packets_in;
+            upd.packets_out = s.packets_out;
+            write_slot(it->second, upd);
+            return true;
+        }
+
+
+        /**
+         *  Removes a session from the board
+         *
+         * @param session_path  std::string with the session object path
+         *
+         * @return Returns true if the session was on the board
+         */
+        bool Remove(const std::string& session_path)
+        {
+            auto it = index.find(session_path);
+            if (it == index.end())
+            {
+                return false;
+            }
+            write_slot(it->second, Session{});
+            index.erase(it);
+            return true;
+        }
+
+
+        /**
+         * @param session_path  std::string with the session object path
+         *
+         * @return Returns true if the session is on the board
+         */
+        bool Contains(const std::string& session_path) const
+        {
+            return index.find(session_path) != index.end();
+        }
+
+
+        /**
+         * @return Returns the number of sessions on the board
+         */
+        size_t Count() const noexcept
+        {
+            return index.size();
+        }
+
+
+        /**
+         *  Opens a new read-only file descriptor of the board, which can
+         *  be passed on to a reader.  Readers can not change the board,
+         *  not even by mapping it writable.
+         *
+         * @return Returns the file descriptor.  The caller is responsible
+         *         for closing it.
+         *
+         * @throws MemFDException on errors
+         */
+        int GetReadOnlyFD() const
+        {
+            const std::string p = "/proc/self/fd/" + std::to_string(fd);
+            int ro = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+            if (ro < 0)
+            {
+                throw MemFDException("Could not reopen the status board: "
+                                     + std::string(strerror(errno)));
+            }
+            return ro;
+        }
+
+
+    private:
+        const uint32_t slot_count;
+        size_t size = 0;
+        int fd = -1;
+        uint8_t *base = nullptr;
+        std::map<std::string, uint32_t> index;
+
+
+        StatusBoardLayout::Slot *slot(uint32_t idx) const
+        {
+            return reinterpret_cast<StatusBoardLayout::Slot *>(
+                        base + sizeof(StatusBoardLayout::Header)
+                        + idx * sizeof(StatusBoardLayout::Slot));
+        }
+
+
+        bool find_free(uint32_t& idx) const
+        {
+            for (uint32_t i = 0; i < slot_count; ++i)
+            {
+                if (0 == slot(i)->session.in_use)
+                {
+                    idx = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+
+        void write_slot(uint32_t idx, const Session& s)
+        {
+            StatusBoardLayout::Slot *sl = slot(idx);
+            const uint32_t seq = sl->seq.load(std::memory_order_relaxed);
+            sl->seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&sl->session, &s, sizeof(s));
+            sl->seq.store(seq + 2, std::memory_order_release);
+        }
+    };
+
+
+
+    /**
+     *  Reader side of a status board, as used by front-ends and
+     *  exporters with the file descriptor from GetStatusBoard
+     */
+    class StatusBoardReader
+    {
+    public:
+        using Session = StatusBoardLayout::Session;
+
+        /**
+         * @param fd  File descriptor of the board.  It is not closed.
+         *
+         * @throws MemFDException if this is not a status board
+         */
+        StatusBoardReader(int fd)
+        {
+            struct stat st;
+            if (::fstat(fd, &st) < 0
+                || (size_t) st.st_size < sizeof(StatusBoardLayout::Header))
+            {
+                throw MemFDException("Invalid status board");
+            }
+            size = st.st_size;
+            void *p = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (MAP_FAILED == p)
+            {
+                throw MemFDException("Could not map the status board: "
+                                     + std::string(strerror(errno)));
+            }
+            base = static_cast<const uint8_t *>(p);
+
+            const auto *hdr = reinterpret_cast<const StatusBoardLayout::Header *>(base);
+            if (StatusBoardLayout::MAGIC != hdr->magic
+                || StatusBoardLayout::VERSION != hdr->version
+                || sizeof(StatusBoardLayout::Slot) != hdr->slot_size
+                || size < sizeof(StatusBoardLayout::Header)
+                          + (size_t) hdr->slot_count * hdr->slot_size)
+            {
+                ::munmap(const_cast<uint8_t *>(base), size);
+                throw MemFDException("Unsupported status board format");
+            }
+            slot_count = hdr->slot_count;
+        }
+
+        ~StatusBoardReader()
+        {
+            ::munmap(const_cast<uint8_t *>(base), size);
+        }
+
+        StatusBoardReader(const StatusBoardReader&) = delete;
+        StatusBoardReader& operator=(const StatusBoardReader&) = delete;
+
+
+        /**
+         *  Takes a consistent copy of all the sessions on the board
+         *
+         * @return Returns a std::vector with a Session per session
+         */
+        std::vector<Session> Read() const
+        {
+            std::vector<Session> ret;
+            for (uint32_t i = 0; i < slot_count; ++i)
+            {
+                Session s;
+                read_slot(i, s);
+                if (s.in_use)
+                {
+                    // Never trust the writer to terminate the strings
+                    s.session_path[sizeof(s.session_path) - 1] = '\0';
+                    s.config_name[sizeof(s.config_name) - 1] = '\0';
+                    s.device_name[sizeof(s.device_name) - 1] = '\0';
+                    ret.push_back(s);
+                }
+            }
+            return ret;
+        }
+
+
+    private:
+        size_t size = 0;
+        uint32_t slot_count = 0;
+        const uint8_t *base = nullptr;
+
+
+        void read_slot(uint32_t idx, Session& s) const
+        {
+            const auto *sl = reinterpret_cast<const StatusBoardLayout::Slot *>(
+                                base + sizeof(StatusBoardLayout::Header)
+                                + idx * sizeof(StatusBoardLayout::Slot));
+            while (true)
+            {
+                const uint32_t before = sl->seq.load(std::memory_order_acquire);
+                if (before & 1)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::memcpy(&s, &sl->session, sizeof(s));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sl->seq.load(std::memory_order_relaxed) == before)
+                {
+                    return;
+                }
+            }
+        }
+    };
+
+
+    /**
+     *  Copies a string into a fixed size field of a Session, truncating
+     *  it if needed
+     */
+    template <size_t N>
+    inline void StatusBoardCopy(char (&dest)[N], const std::string& src)
+    {
+        const size_t len = std::min(src.size(), N - 1);
+        std::memcpy(dest, src.data(), len);
+        dest[len] = '\0';
+    }
+} // namespace SessionManager
@@ -0,0 +1,757 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   microbench.cpp
+ *
+ * @brief  Microbenchmarks of the small helper types used on the hot
+ *         paths of the log, status and network configuration signals
+ *
+ *  Usage:  microbench [--filter SUBSTRING] [--min-time SECONDS] [--json]
+ *
+ *  Each benchmark is run with an increasing number of iterations until
+ *  it has run for at least --min-time seconds (default 0.5).  The
+ *  result is reported as nanoseconds and heap allocations per iteration.
+ *  With --json the result is written as a JSON document, which can be
+ *  stored and compared against later runs.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <json/json.h>
+
+#include "dbus/core.hpp"
+#include "client/statusevent.hpp"
+#include "common/configfileparser.hpp"
+#include "common/json-io.hpp"
+#include "log/ansicolours.hpp"
+#include "log/dbus-log.hpp"
+#include "log/logevent.hpp"
+#include "log/logmetadata.hpp"
+#include "log/logtag.hpp"
+#include "log/logwriters/streamwriter.hpp"
+#include "netcfg/netcfg-changeevent.hpp"
+#include "netcfg/dns/resolver-settings.hpp"
+#include "tests/bench/microbench.hpp"
+
+using namespace MicroBench;
+
+
+//
+//  Heap allocation counting
+//
+//  The malloc() family is replaced by wrappers calling the glibc
+//  implementation, so every allocation made via operator new, g_malloc()
+//  and friends is counted.
+//
+extern "C" {
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    Allocations().count.fetch_add(1, std::memory_order_relaxed);
+    Allocations().bytes.fetch_add(size, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+
+void *calloc(size_t nmemb, size_t size)
+{
+    Allocations().count.fetch_add(1, std::memory_order_relaxed);
+    Allocations().bytes.fetch_add(nmemb * size, std::memory_order_relaxed);
+    return __libc_calloc(nmemb, size);
+}
+
+
+void *realloc(void *ptr, size_t size)
+{
+    Allocations().count.fetch_add(1, std::memory_order_relaxed);
+    Allocations().bytes.fetch_add(size, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+} // extern "C"
+
+
+AllocCounters& MicroBench::Allocations()
+{
+    // Constant initialized; safe to use before static constructors run
+    static AllocCounters counters;
+    return counters;
+}
+
+
+
+//
+//  LogEvent
+//
+
+BENCHMARK(LogEvent_construct)
+{
+    while (state.KeepRunning())
+    {
+        LogEvent ev(LogGroup::CLIENT, LogCategory::INFO,
+                    "Connecting to [vpn.example.org]:1194 (203.0.113.10) via UDPv4");
+        DoNotOptimize(ev);
+    }
+}
+
+
+BENCHMARK(LogEvent_GVariantTuple_roundtrip)
+{
+    LogEvent ev(LogGroup::CLIENT, LogCategory::INFO,
+                "Connecting to [vpn.example.org]:1194 (203.0.113.10) via UDPv4");
+    while (state.KeepRunning())
+    {
+        GVariant *v = ev.GetGVariantTuple();
+        LogEvent parsed(v);
+        g_variant_unref(v);
+        DoNotOptimize(parsed);
+    }
+}
+
+
+BENCHMARK(LogEvent_GVariantDict_roundtrip)
+{
+    LogEvent ev(LogGroup::CLIENT, LogCategory::INFO,
+                "Connecting to [vpn.example.org]:1194 (203.0.113.10) via UDPv4");
+    while (state.KeepRunning())
+    {
+        GVariant *v = ev.GetGVariantDict();
+        LogEvent parsed(v);
+        g_variant_unref(v);
+        DoNotOptimize(parsed);
+    }
+}
+
+
+BENCHMARK(LogEvent_stringify)
+{
+    LogEvent ev(LogGroup::CLIENT, LogCategory::INFO,
+                "Connecting to [vpn.example.org]:1194 (203.0.113.10) via UDPv4");
+    while (state.KeepRunning())
+    {
+        std::stringstream s;
+        s << ev;
+        DoNotOptimize(s);
+    }
+}
+
+
+/**
+ *  Exposes the protected LogFilter methods to the benchmarks
+ */
+class BenchLogFilter : public LogFilter
+{
+public:
+    BenchLogFilter(unsigned int lvl)
+        : LogFilter(lvl)
+    {
+    }
+
+    using LogFilter::LogFilterAllow;
+};
+
+
+BENCHMARK(LogFilter_allow)
+{
+    BenchLogFilter filter(4);
+    LogEvent allowed(LogGroup::CLIENT, LogCategory::INFO, "allowed");
+    LogEvent denied(LogGroup::CLIENT, LogCategory::DEBUG, "denied");
+    while (state.KeepRunning())
+    {
+        DoNotOptimize(filter.LogFilterAllow(allowed));
+        DoNotOptimize(filter.LogFilterAllow(denied));
+    }
+}
+
+
+BENCHMARK(LogFilter_allow_excluded_group)
+{
+    BenchLogFilter filter(4);
+    filter.AddExcludeFilter(LogGroup::CLIENT);
+    LogEvent allowed(LogGroup::BACKENDPROC, LogCategory::INFO, "allowed");
+    LogEvent excluded(LogGroup::CLIENT, LogCategory::INFO, "excluded");
+    while (state.KeepRunning())
+    {
+        DoNotOptimize(filter.LogFilterAllow(allowed));
+        DoNotOptimize(filter.LogFilterAllow(excluded));
+    }
+}
+
+
+
+/**
+ *  Writes a ColourStreamWriter line to a stream which is emptied on
+ *  each iteration, so only the formatting is measured
+ */
+static void bench_colour_write(State& state, ColourEngine::ColourMode mode)
+{
+    ANSIColours colours;
+    colours.SetColourMode(mode);
+    std::stringstream out;
+    ColourStreamWriter writer(out, &colours);
+    writer.EnableTimestamp(false);
+    LogEvent ev(LogGroup::CLIENT, LogCategory::DEBUG,
+                "Sending packet to remote, 1420 bytes");
+    while (state.KeepRunning())
+    {
+        writer.Write(ev);
+        out.seekp(0);
+    }
+}
+
+
+BENCHMARK(ColourStreamWriter_by_category)
+{
+    bench_colour_write(state, ColourEngine::ColourMode::BY_CATEGORY);
+}
+
+
+BENCHMARK(ColourStreamWriter_by_group)
+{
+    bench_colour_write(state, ColourEngine::ColourMode::BY_GROUP);
+}
+
+
+
+//
+//  LogMetaData
+//
+
+BENCHMARK(LogMetaData_build)
+{
+    LogTag::Ptr tag = LogTag::create(":1.42", "net.openvpn.v3.backends");
+    while (state.KeepRunning())
+    {
+        LogMetaData::Ptr md = LogMetaData::create();
+        md->AddMeta("logtag", *tag);
+        md->AddMeta("session_token", "c6f2a3d3-38c2-4e3b-bfb0-0b37a8f7d2a1");
+        md->AddMeta("pid", "12345");
+        DoNotOptimize(md);
+    }
+}
+
+
+BENCHMARK(LogMetaData_GetMetaValue)
+{
+    LogTag::Ptr tag = LogTag::create(":1.42", "net.openvpn.v3.backends");
+    LogMetaData::Ptr md = LogMetaData::create();
+    md->AddMeta("logtag", *tag);
+    md->AddMeta("session_token", "c6f2a3d3-38c2-4e3b-bfb0-0b37a8f7d2a1");
+    md->AddMeta("pid", "12345");
+    while (state.KeepRunning())
+    {
+        std::string v = md->GetMetaValue("session_token");
+        DoNotOptimize(v);
+    }
+}
+
+
+BENCHMARK(LogMetaData_stringify)
+{
+    LogTag::Ptr tag = LogTag::create(":1.42", "net.openvpn.v3.backends");
+    LogMetaData::Ptr md = LogMetaData::create();
+    md->AddMeta("logtag", *tag);
+    md->AddMeta("session_token", "c6f2a3d3-38c2-4e3b-bfb0-0b37a8f7d2a1");
+    md->AddMeta("pid", "12345");
+    while (state.KeepRunning())
+    {
+        std::stringstream s;
+        s << *md;
+        DoNotOptimize(s);
+    }
+}
+
+
+BENCHMARK(LogTag_create_interned)
+{
+    while (state.KeepRunning())
+    {
+        LogTag::Ptr tag = LogTag::create(":1.42", "net.openvpn.v3.backends");
+        DoNotOptimize(tag);
+    }
+}
+
+
+
+//
+//  StatusEvent
+//
+
+BENCHMARK(StatusEvent_construct)
+{
+    while (state.KeepRunning())
+    {
+        StatusEvent ev(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTED,
+                       "Connected to vpn.example.org");
+        DoNotOptimize(ev);
+    }
+}
+
+
+BENCHMARK(StatusEvent_GVariantTuple_roundtrip)
+{
+    StatusEvent ev(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTED,
+                   "Connected to vpn.example.org");
+    while (state.KeepRunning())
+    {
+        GVariant *v = ev.GetGVariantTuple();
+        StatusEvent parsed(v);
+        g_variant_unref(v);
+        DoNotOptimize(parsed);
+    }
+}
+
+
+BENCHMARK(StatusEvent_GVariantDict_roundtrip)
+{
+    StatusEvent ev(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTED,
+                   "Connected to vpn.example.org");
+    while (state.KeepRunning())
+    {
+        GVariant *v = ev.GetGVariantDict();
+        StatusEvent parsed(v);
+        g_variant_unref(v);
+        DoNotOptimize(parsed);
+    }
+}
+
+
+BENCHMARK(StatusEvent_stringify)
+{
+    StatusEvent ev(StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTED,
+                   "Connected to vpn.example.org");
+    while (state.KeepRunning())
+    {
+        std::stringstream s;
+        s << ev;
+        DoNotOptimize(s);
+    }
+}
+
+
+
+//
+//  NetCfgChangeEvent
+//
+
+static const NetCfgChangeDetails bench_netcfg_details = {
+    {"ip_address", "10.8.0.2"},
+    {"prefix", "24"},
+    {"ipv6", "false"}
+};
+
+
+BENCHMARK(NetCfgChangeEvent_construct)
+{
+    while (state.KeepRunning())
+    {
+        NetCfgChangeEvent ev(NetCfgChangeType::IPADDR_ADDED, "tun0",
+                             bench_netcfg_details);
+        DoNotOptimize(ev);
+    }
+}
+
+
+BENCHMARK(NetCfgChangeEvent_GVariant_roundtrip)
+{
+    NetCfgChangeEvent ev(NetCfgChangeType::IPADDR_ADDED, "tun0",
+                         bench_netcfg_details);
+    while (state.KeepRunning())
+    {
+        GVariant *v = ev.GetGVariant();
+        NetCfgChangeEvent parsed(v);
+        g_variant_unref(v);
+        DoNotOptimize(parsed);
+    }
+}
+
+
+BENCHMARK(NetCfgChangeEvent_stringify)
+{
+    NetCfgChangeEvent ev(NetCfgChangeType::IPADDR_ADDED, "tun0",
+                         bench_netcfg_details);
+    while (state.KeepRunning())
+    {
+        std::stringstream s;
+        s << ev;
+        DoNotOptimize(s);
+    }
+}
+
+
+BENCHMARK(NetCfgChangeEvent_filter_mask)
+{
+    NetCfgChangeEvent ev(NetCfgChangeType::IPADDR_ADDED, "tun0",
+                         bench_netcfg_details);
+    const uint16_t mask = (uint16_t) NetCfgChangeType::DEVICE_ADDED
+                          | (uint16_t) NetCfgChangeType::IPADDR_ADDED
+                          | (uint16_t) NetCfgChangeType::ROUTE_ADDED;
+    while (state.KeepRunning())
+    {
+        DoNotOptimize((mask & (uint16_t) ev.type) != 0);
+    }
+}
+
+
+BENCHMARK(NetCfgChangeEvent_FilterMaskStr)
+{
+    const uint16_t mask = (uint16_t) NetCfgChangeType::DEVICE_ADDED
+                          | (uint16_t) NetCfgChangeType::IPADDR_ADDED
+                          | (uint16_t) NetCfgChangeType::ROUTE_ADDED;
+    while (state.KeepRunning())
+    {
+        std::string s = NetCfgChangeEvent::FilterMaskStr(mask);
+        DoNotOptimize(s);
+    }
+}
+
+
+
+//
+//  NetCfg::DNS::ResolverSettings
+//
+
+BENCHMARK(ResolverSettings_populate)
+{
+    while (state.KeepRunning())
+    {
+        NetCfg::DNS::ResolverSettings::Ptr rs;
+        rs.reset(new NetCfg::DNS::ResolverSettings(1));
+        rs->AddNameServer("10.8.0.1");
+        rs->AddNameServer("10.8.0.2");
+        rs->AddSearchDomain("example.org");
+        rs->AddSearchDomain("corp.example.org");
+        DoNotOptimize(rs);
+    }
+}
+
+
+BENCHMARK(ResolverSettings_GetNameServers)
+{
+    NetCfg::DNS::ResolverSettings::Ptr rs;
+    rs.reset(new NetCfg::DNS::ResolverSettings(1));
+    rs->AddNameServer("10.8.0.1");
+    rs->AddNameServer("10.8.0.2");
+    while (state.KeepRunning())
+    {
+        std::vector<std::string> ns = rs->GetNameServers();
+        DoNotOptimize(ns);
+    }
+}
+
+
+BENCHMARK(ResolverSettings_stringify)
+{
+    NetCfg::DNS::ResolverSettings::Ptr rs;
+    rs.reset(new NetCfg::DNS::ResolverSettings(1));
+    rs->AddNameServer("10.8.0.1");
+    rs->AddNameServer("10.8.0.2");
+    rs->AddSearchDomain("example.org");
+    rs->AddSearchDomain("corp.example.org");
+    while (state.KeepRunning())
+    {
+        std::stringstream s;
+        s << *rs;
+        DoNotOptimize(s);
+    }
+}
+
+
+
+//
+//  Configuration::File
+//
+
+class BenchConfigFile : public Configuration::File
+{
+protected:
+    Configuration::OptionMap ConfigureMapping() override
+    {
+        using namespace Configuration;
+        return {
+            OptionMapEntry{"log-level", "log_level",
+                           "Log verbosity", OptionValueType::Int},
+            OptionMapEntry{"log-method", "log_method",
+                           "Log destination", OptionValueType::String},
+            OptionMapEntry{"timestamp", "timestamp",
+                           "Add timestamps", OptionValueType::Present},
+            OptionMapEntry{"journald", "journald",
+                           "Use journald", OptionValueType::Present}
+        };
+    }
+};
+
+
+BENCHMARK(ConfigFile_SetValue_GetValue)
+{
+    BenchConfigFile cfg;
+    while (state.KeepRunning())
+    {
+        cfg.SetValue("log-level", "4");
+        std::string v = cfg.GetValue("log-level");
+        DoNotOptimize(v);
+    }
+}
+
+
+BENCHMARK(ConfigFile_Generate)
+{
+    BenchConfigFile cfg;
+    cfg.SetValue("log-level", "4");
+    cfg.SetValue("log-method", "syslog");
+    cfg.SetValue("timestamp", "1");
+    while (state.KeepRunning())
+    {
+        Json::Value data = cfg.Generate();
+        DoNotOptimize(data);
+    }
+}
+
+
+BENCHMARK(ConfigFile_Parse)
+{
+    BenchConfigFile src;
+    src.SetValue("log-level", "4");
+    src.SetValue("log-method", "syslog");
+    src.SetValue("timestamp", "1");
+    Json::Value data = src.Generate();
+    while (state.KeepRunning())
+    {
+        BenchConfigFile cfg;
+        cfg.Parse(data);
+        DoNotOptimize(cfg);
+    }
+}
+
+
+
+//
+//  JSON documents
+//
+
+/**
+ *  A persistent configuration file like document with a larger
+ *  profile, rendered as by the configuration manager
+ */
+static const std::string& bench_json_document()
+{
+    static std::string doc;
+    if (doc.empty())
+    {
+        Json::Value v;
+        v["object_path"] = "/net/openvpn/v3/configuration/bench";
+        v["name"] = "bench.ovpn";
+        v["import_timestamp"] = (Json::Int64) 1665830400;
+        v["persistent"] = true;
+        for (unsigned int i = 0; i < 200; ++i)
+        {
+            Json::Value opt;
+            opt.append("value-" + std::to_string(i));
+            opt.append((Json::Int64) i);
+            v["profile"]["option-" + std::to_string(i)] = opt;
+        }
+        v["profile"]["ca"] = std::string(4096, 'A');
+        doc = JsonIO::Write(v, true);
+    }
+    return doc;
+}
+
+
+BENCHMARK(Json_parse_stream)
+{
+    const std::string& doc = bench_json_document();
+    while (state.KeepRunning())
+    {
+        std::istringstream in(doc);
+        Json::Value v;
+        in >> v;
+        DoNotOptimize(v);
+    }
+}
+
+
+BENCHMARK(JsonIO_Parse)
+{
+    const std::string& doc = bench_json_document();
+    while (state.KeepRunning())
+    {
+        Json::Value v = JsonIO::Parse(doc);
+        DoNotOptimize(v);
+    }
+}
+
+
+BENCHMARK(Json_write_stream)
+{
+    Json::Value v = JsonIO::Parse(bench_json_document());
+    while (state.KeepRunning())
+    {
+        std::stringstream out;
+        out << v;
+        DoNotOptimize(out);
+    }
+}
+
+
+BENCHMARK(JsonIO_Write_compact)
+{
+    Json::Value v = JsonIO::Parse(bench_json_document());
+    while (state.KeepRunning())
+    {
+        std::string out = JsonIO::Write(v, true);
+        DoNotOptimize(out);
+    }
+}
+
+//
+//  Benchmark runner
+//
+
+struct BenchResult
+{
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double bytes_per_op;
+};
+
+
+static BenchResult run_benchmark(const Benchmark& bench, const double min_time)
+{
+    uint64_t iterations = 1;
+    while (true)
+    {
+        State state(iterations);
+        bench.func(state);
+        double elapsed = state.ElapsedNanoSeconds();
+
+        if (elapsed >= min_time * 1e9 || iterations >= (1ULL << 40))
+        {
+            return BenchResult{bench.name, iterations,
+                               elapsed / iterations,
+                               (double) state.allocs / iterations,
+                               (double) state.alloc_bytes / iterations};
+        }
+
+        // Aim a bit above the target, but never grow more than 10x per round
+        double next = (elapsed > 0.0
+                       ? iterations * (min_time * 1e9 * 1.4) / elapsed
+                       : iterations * 10.0);
+        uint64_t n = (uint64_t) next;
+        iterations = std::max(iterations + 1,
+                              std::min(n, iterations * 10));
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    std::string filter;
+    double min_time = 0.5;
+    bool json = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (0 == strcmp(argv[i], "--filter") && (i + 1) < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (0 == strcmp(argv[i], "--min-time") && (i + 1) < argc)
+        {
+            min_time = atof(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "--json"))
+        {
+            json = true;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter SUBSTRING] [--min-time SECONDS] [--json]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    Json::Value report;
+    if (!json)
+    {
+        std::cout << std::setw(42) << std::left << "Benchmark"
+                  << std::setw(12) << std::right << "Iterations"
+                  << std::setw(12) << "ns/op"
+                  << std::setw(12) << "allocs/op"
+                  << std::setw(12) << "bytes/op"
+                  << std::endl
+                  << std::setw(90) << std::setfill('-') << "-"
+                  << std::setfill(' ') << std::endl;
+    }
+
+    for (const auto& bench : Registry())
+    {
+        if (!filter.empty() && std::string::npos == bench.name.find(filter))
+        {
+            continue;
+        }
+
+        BenchResult r = run_benchmark(bench, min_time);
+        if (json)
+        {
+            Json::Value entry;
+            entry["name"] = r.name;
+            entry["iterations"] = (Json::UInt64) r.iterations;
+            entry["ns_per_op"] = r.ns_per_op;
+            entry["allocs_per_op"] = r.allocs_per_op;
+            entry["bytes_per_op"] = r.bytes_per_op;
+            report["benchmarks"].append(entry);
+        }
+        else
+        {
+            std::cout << std::setw(42) << std::left << r.name
+                      << std::setw(12) << std::right << r.iterations
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(12) << r.ns_per_op
+                      << std::setw(12) << r.allocs_per_op
+                      << std::setw(12) << r.bytes_per_op
+                      << std::endl;
+        }
+    }
+
+    if (json)
+    {
+        std::cout << report << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   microbench.hpp
+ *
+ * @brief  Minimal microbenchmark harness, measuring the time and the
+ *         number of heap allocations per iteration of a benchmark
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace MicroBench {
+
+/**
+ *  Heap allocation counters.  These are updated by the malloc() family
+ *  replacements in microbench.cpp, so they cover both C++ allocations
+ *  and GLib allocations.
+ */
+struct AllocCounters
+{
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> bytes{0};
+};
+
+AllocCounters& Allocations();
+
+
+/**
+ *  Passed to each benchmark function.  The benchmark runs the code to
+ *  measure in a loop while KeepRunning() returns true.  Setup code
+ *  placed before the loop is not measured.
+ *
+ *      BENCHMARK(example)
+ *      {
+ *          std::string s("input");
+ *          while (state.KeepRunning())
+ *          {
+ *              DoNotOptimize(s.size());
+ *          }
+ *      }
+ */
+class State
+{
+public:
+    State(const uint64_t iterations)
+        : iterations(iterations)
+    {
+    }
+
+
+    bool KeepRunning()
+    {
+        if (0 == done)
+        {
+            alloc_start = Allocations().count.load(std::memory_order_relaxed);
+            bytes_start = Allocations().bytes.load(std::memory_order_relaxed);
+            start = std::chrono::steady_clock::now();
+        }
+        if (done < iterations)
+        {
+            ++done;
+            return true;
+        }
+        end = std::chrono::steady_clock::now();
+        allocs = Allocations().count.load(std::memory_order_relaxed) - alloc_start;
+        alloc_bytes = Allocations().bytes.load(std::memory_order_relaxed) - bytes_start;
+        return false;
+    }
+
+
+    uint64_t Iterations() const noexcept
+    {
+        return iterations;
+    }
+
+
+    double ElapsedNanoSeconds() const
+    {
+        return std::chrono::duration<double, std::nano>(end - start).count();
+    }
+
+    uint64_t allocs = 0;
+    uint64_t alloc_bytes = 0;
+
+
+private:
+    uint64_t iterations;
+    uint64_t done = 0;
+    uint64_t alloc_start = 0;
+    uint64_t bytes_start = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+
+using BenchFunc = std::function<void(State&)>;
+
+struct Benchmark
+{
+    std::string name;
+    BenchFunc func;
+};
+
+
+inline std::vector<Benchmark>& Registry()
+{
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+
+struct Register
+{
+    Register(const std::string& name, BenchFunc func)
+    {
+        Registry().push_back(Benchmark{name, func});
+    }
+};
+
+
+/**
+ *  Prevents the compiler from optimizing away a computed value
+ */
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace MicroBench
+
+
+#define BENCHMARK(name)                                                 \
+    static void bench_##name(MicroBench::State& state);                 \
+    static MicroBench::Register bench_register_##name(#name, bench_##name); \
+    static void bench_##name(MicroBench::State& state)
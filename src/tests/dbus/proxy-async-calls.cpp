@@ -0,0 +1,132 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   proxy-async-calls.cpp
+ *
+ * @brief  Retrieves a few properties from all available sessions, first
+ *         using the synchronous DBusProxy::GetProperty() and then via
+ *         the pipelined DBusProxy::GetPropertyAsync() API.  Both
+ *         approaches are timed and the results compared.
+ */
+
+#include <iostream>
+#include <chrono>
+
+#include "dbus/core.hpp"
+#include "sessionmgr/proxy-sessionmgr.hpp"
+
+static const std::vector<std::string> properties = {
+    "config_path", "config_name", "session_name", "device_name",
+    "owner", "session_created", "backend_pid"
+};
+
+
+static std::string variant_str(GVariant *v)
+{
+    gchar *s = g_variant_print(v, false);
+    std::string ret(s);
+    g_free(s);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        OpenVPN3SessionMgrProxy sessmgr(G_BUS_TYPE_SYSTEM);
+        auto sessions = sessmgr.FetchAvailableSessions();
+
+        // Serial round trips
+        std::vector<std::string> sync_results;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& s : sessions)
+        {
+            for (const auto& p : properties)
+            {
+                try
+                {
+                    GVariant *v = s->GetProperty(p);
+                    sync_results.push_back(variant_str(v));
+                    g_variant_unref(v);
+                }
+                catch (const DBusException& excp)
+                {
+                    sync_results.push_back("(error)");
+                }
+            }
+        }
+        auto sync_time = std::chrono::steady_clock::now() - start;
+
+        // Pipelined calls
+        std::vector<DBusProxyAsyncCall::Ptr> calls;
+        start = std::chrono::steady_clock::now();
+        for (const auto& s : sessions)
+        {
+            for (const auto& p : properties)
+            {
+                calls.push_back(s->GetPropertyAsync(p));
+            }
+        }
+        std::vector<std::string> async_results;
+        for (const auto& c : calls)
+        {
+            try
+            {
+                GVariant *v = c->GetResult();
+                async_results.push_back(variant_str(v));
+                g_variant_unref(v);
+            }
+            catch (const DBusException& excp)
+            {
+                async_results.push_back("(error)");
+            }
+        }
+        auto async_time = std::chrono::steady_clock::now() - start;
+
+        unsigned int mismatch = 0;
+        for (size_t i = 0; i < sync_results.size(); ++i)
+        {
+            if (sync_results[i] != async_results[i])
+            {
+                std::cout << "Mismatch on " << calls[i]->GetMethod()
+                          << ": '" << sync_results[i] << "' != '"
+                          << async_results[i] << "'" << std::endl;
+                ++mismatch;
+            }
+        }
+
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        std::cout << "Sessions: " << sessions.size()
+                  << ", properties queried: " << calls.size() << std::endl
+                  << "Synchronous calls: "
+                  << duration_cast<microseconds>(sync_time).count() << " µs"
+                  << std::endl
+                  << "Pipelined calls:   "
+                  << duration_cast<microseconds>(async_time).count() << " µs"
+                  << std::endl;
+        return (0 == mismatch ? 0 : 3);
+    }
+    catch (std::exception& err)
+    {
+        std::cout << "** ERROR ** " << err.what() << std::endl;
+        return 2;
+    }
+}
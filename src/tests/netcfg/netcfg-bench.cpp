@@ -0,0 +1,993 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   netcfg-bench.cpp
+ *
+ * @brief  Scale benchmark of the netcfg service device lifecycle.
+ *         Creates, configures (addresses, routes and DNS) and destroys
+ *         a number of virtual interfaces concurrently via the
+ *         net.openvpn.v3.netcfg service and reports the latency
+ *         percentiles, the rtnetlink notifications and the CPU time of
+ *         the netcfg service per phase as JSON.
+ *
+ *         With --netcfg-service, this program moves itself into a new
+ *         network namespace and starts its own netcfg service there.
+ *         This requires root and a private bus reachable via a socket
+ *         path, as abstract unix sockets are bound to the network
+ *         namespace: start a dbus-daemon with the OpenVPN 3 policies on
+ *         a unix:path= address and set DBUS_SYSTEM_BUS_ADDRESS before
+ *         running this program.  Without --netcfg-service the running
+ *         netcfg service is used, which must not run in the network
+ *         namespace of the host unless --host-netns is given.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <json/json.h>
+
+#include "common/cmdargparser.hpp"
+#include "common/utils.hpp"
+#include "dbus/core.hpp"
+#include "netcfg/proxy-netcfg-mgr.hpp"
+#include "netcfg/proxy-netcfg-device.hpp"
+
+
+typedef std::chrono::steady_clock bench_clock;
+
+
+/**
+ *  Collects the latency samples of a single benchmark phase
+ */
+struct PhaseResult
+{
+    PhaseResult(const std::string& name)
+        : name(name)
+    {
+    }
+
+
+    /**
+     *  Merge the samples gathered by another worker into this result
+     */
+    void Merge(const PhaseResult& other)
+    {
+        samples.insert(samples.end(),
+                       other.samples.begin(), other.samples.end());
+        errors += other.errors;
+    }
+
+
+    Json::Value GetJSON()
+    {
+        Json::Value ret;
+        std::sort(samples.begin(), samples.end());
+
+        ret["count"] = (Json::Value::UInt64) samples.size();
+        ret["errors"] = errors;
+        ret["wall_ms"] = wall_ms;
+        ret["throughput_ops"] = (wall_ms > 0
+                                 ? samples.size() * 1000.0 / wall_ms : 0.0);
+        if (samples.empty())
+        {
+            return ret;
+        }
+
+        double sum = 0.0;
+        for (const auto& s : samples)
+        {
+            sum += s;
+        }
+        ret["min_ms"] = samples.front();
+        ret["mean_ms"] = sum / samples.size();
+        ret["p50_ms"] = percentile(50);
+        ret["p90_ms"] = percentile(90);
+        ret["p99_ms"] = percentile(99);
+        ret["max_ms"] = samples.back();
+        return ret;
+    }
+
+
+    std::string name;
+    std::vector<double> samples = {};
+    unsigned int errors = 0;
+    double wall_ms = 0.0;
+
+
+private:
+    double percentile(const unsigned int p) const
+    {
+        // Nearest-rank method, samples must be sorted
+        size_t rank = (p * samples.size() + 99) / 100;
+        return samples[(rank > 0 ? rank - 1 : 0)];
+    }
+};
+
+
+static double elapsed_ms(const bench_clock::time_point& start,
+                         const bench_clock::time_point& end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+/**
+ *  Counts the rtnetlink notifications about links, addresses, routes
+ *  and routing rules in a network namespace.  Every change netcfg does
+ *  to the kernel network configuration results in one notification, so
+ *  this counts the netlink requests the service sends without having to
+ *  instrument it.
+ */
+class NetlinkMonitor
+{
+public:
+    struct Counters
+    {
+        uint64_t link = 0;
+        uint64_t addr = 0;
+        uint64_t route = 0;
+        uint64_t rule = 0;
+        uint64_t overruns = 0;  ///< Receive buffer overflows, counts are low
+
+        Counters operator-(const Counters& o) const
+        {
+            Counters r;
+            r.link = link - o.link;
+            r.addr = addr - o.addr;
+            r.route = route - o.route;
+            r.rule = rule - o.rule;
+            r.overruns = overruns - o.overruns;
+            return r;
+        }
+
+        Json::Value GetJSON() const
+        {
+            Json::Value ret;
+            ret["link"] = (Json::Value::UInt64) link;
+            ret["addr"] = (Json::Value::UInt64) addr;
+            ret["route"] = (Json::Value::UInt64) route;
+            ret["rule"] = (Json::Value::UInt64) rule;
+            ret["total"] = (Json::Value::UInt64) (link + addr + route + rule);
+            ret["overruns"] = (Json::Value::UInt64) overruns;
+            return ret;
+        }
+    };
+
+
+    /**
+     * @param netns_pid  Monitor the network namespace of this process,
+     *                   0 monitors the network namespace of this process
+     */
+    NetlinkMonitor(const pid_t netns_pid)
+    {
+        int orig_ns = -1;
+        if (netns_pid > 0)
+        {
+            orig_ns = enter_netns(netns_pid);
+            if (orig_ns < 0)
+            {
+                return;
+            }
+        }
+
+        fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (fd >= 0)
+        {
+            int rcvbuf = 8 * 1024 * 1024;
+            if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE,
+                           &rcvbuf, sizeof(rcvbuf)) < 0)
+            {
+                setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+            }
+
+            struct sockaddr_nl sa = {};
+            sa.nl_family = AF_NETLINK;
+            sa.nl_groups = RTMGRP_LINK
+                           | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR
+                           | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE
+                           | RTMGRP_IPV4_RULE;
+            if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        if (orig_ns >= 0)
+        {
+            setns(orig_ns, CLONE_NEWNET);
+            close(orig_ns);
+        }
+        if (fd < 0)
+        {
+            return;
+        }
+
+        reader = std::thread([this]()
+        {
+            read_loop();
+        });
+    }
+
+
+    ~NetlinkMonitor()
+    {
+        done = true;
+        if (reader.joinable())
+        {
+            reader.join();
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+
+    /**
+     * @return Returns true if the notifications are counted
+     */
+    bool Available() const
+    {
+        return fd >= 0;
+    }
+
+
+    /**
+     *  Waits until no notifications have arrived for a little while, so
+     *  the notifications caused by the last phase are all counted.
+     *
+     * @return Returns a snapshot of the counters
+     */
+    Counters Settle()
+    {
+        auto deadline = bench_clock::now() + std::chrono::seconds(2);
+        uint64_t seen = received.load();
+        while (bench_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            uint64_t now = received.load();
+            if (now == seen)
+            {
+                break;
+            }
+            seen = now;
+        }
+
+        Counters r;
+        r.link = link;
+        r.addr = addr;
+        r.route = route;
+        r.rule = rule;
+        r.overruns = overruns;
+        return r;
+    }
+
+
+private:
+    int fd = -1;
+    std::thread reader;
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> link{0};
+    std::atomic<uint64_t> addr{0};
+    std::atomic<uint64_t> route{0};
+    std::atomic<uint64_t> rule{0};
+    std::atomic<uint64_t> overruns{0};
+
+
+    /**
+     *  Switches this thread to the network namespace of a process
+     *
+     * @return Returns a file descriptor to the original network
+     *         namespace, or -1 on errors
+     */
+    static int enter_netns(const pid_t pid)
+    {
+        int orig = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+        std::string target_path = "/proc/" + std::to_string(pid) + "/ns/net";
+        int target = open(target_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (orig < 0 || target < 0 || setns(target, CLONE_NEWNET) < 0)
+        {
+            std::cerr << "Cannot enter the network namespace of PID "
+                      << pid << ": " << strerror(errno) << std::endl;
+            if (orig >= 0)
+            {
+                close(orig);
+            }
+            orig = -1;
+        }
+        if (target >= 0)
+        {
+            close(target);
+        }
+        return orig;
+    }
+
+
+    void read_loop()
+    {
+        std::vector<char> buf(64 * 1024);
+        while (!done)
+        {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0)
+            {
+                continue;
+            }
+            ssize_t len = recv(fd, buf.data(), buf.size(), 0);
+            if (len < 0)
+            {
+                if (ENOBUFS == errno)
+                {
+                    ++overruns;
+                }
+                continue;
+            }
+
+            for (struct nlmsghdr *nh = (struct nlmsghdr *) buf.data();
+                 NLMSG_OK(nh, (size_t) len);
+                 nh = NLMSG_NEXT(nh, len))
+            {
+                switch (nh->nlmsg_type)
+                {
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                    ++link;
+                    break;
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                    ++addr;
+                    break;
+                case RTM_NEWROUTE:
+                case RTM_DELROUTE:
+                    ++route;
+                    break;
+                case RTM_NEWRULE:
+                case RTM_DELRULE:
+                    ++rule;
+                    break;
+                default:
+                    continue;
+                }
+                ++received;
+            }
+        }
+    }
+};
+
+
+/**
+ *  CPU time used by a process, from /proc/PID/stat
+ *
+ * @return Returns the user and system CPU time in milliseconds, or 0
+ */
+static uint64_t process_cpu_ms(const pid_t pid)
+{
+    std::ifstream f("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!f || !std::getline(f, line))
+    {
+        return 0;
+    }
+    size_t p = line.rfind(')');
+    if (std::string::npos == p)
+    {
+        return 0;
+    }
+    // utime and stime are the 12th and 13th fields after the process name
+    std::istringstream fields(line.substr(p + 1));
+    std::string field;
+    for (unsigned int i = 0; i < 11 && (fields >> field); ++i)
+    {
+    }
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    long hz = sysconf(_SC_CLK_TCK);
+    if (!(fields >> utime >> stime) || hz <= 0)
+    {
+        return 0;
+    }
+    return (utime + stime) * 1000 / hz;
+}
+
+
+/**
+ *  Checks if a process runs in the same network namespace as another
+ */
+static bool same_netns(const std::string& pid_a, const std::string& pid_b)
+{
+    struct stat a = {};
+    struct stat b = {};
+    if (stat(("/proc/" + pid_a + "/ns/net").c_str(), &a) < 0
+        || stat(("/proc/" + pid_b + "/ns/net").c_str(), &b) < 0)
+    {
+        // Not being able to tell is treated as the same namespace
+        return true;
+    }
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+}
+
+
+/**
+ *  Opens a new, non-shared connection to the system bus.  Each worker
+ *  thread uses its own connection, to avoid serializing all the calls
+ *  through the single shared GDBusConnection of this process.
+ */
+static GDBusConnection * open_connection()
+{
+    GError *error = nullptr;
+    gchar *addr = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SYSTEM,
+                                                  nullptr, &error);
+    GDBusConnection *conn = nullptr;
+    if (addr)
+    {
+        conn = g_dbus_connection_new_for_address_sync(addr,
+                       (GDBusConnectionFlags)
+                       (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                        | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                       nullptr, nullptr, &error);
+        g_free(addr);
+    }
+    if (!conn)
+    {
+        std::string err = (error ? error->message : "Unknown error");
+        if (error)
+        {
+            g_error_free(error);
+        }
+        THROW_DBUSEXCEPTION("netcfg-bench",
+                            "Could not connect to the system bus: " + err);
+    }
+    return conn;
+}
+
+
+static GVariant * bus_call(GDBusConnection *conn, const char *method,
+                           GVariant *params)
+{
+    return g_dbus_connection_call_sync(conn, "org.freedesktop.DBus",
+                                       "/org/freedesktop/DBus",
+                                       "org.freedesktop.DBus", method,
+                                       params, nullptr,
+                                       G_DBUS_CALL_FLAGS_NONE, -1,
+                                       nullptr, nullptr);
+}
+
+
+/**
+ * @return Returns the PID of the netcfg service, or 0 if it is not
+ *         running
+ */
+static pid_t get_netcfg_pid(GDBusConnection *conn)
+{
+    GVariant *r = bus_call(conn, "GetConnectionUnixProcessID",
+                           g_variant_new("(s)",
+                                         OpenVPN3DBus_name_netcfg.c_str()));
+    if (!r)
+    {
+        return 0;
+    }
+    guint32 pid = 0;
+    g_variant_get(r, "(u)", &pid);
+    g_variant_unref(r);
+    return (pid_t) pid;
+}
+
+
+/**
+ *  A netcfg service started by this benchmark, in the network namespace
+ *  of the benchmark.  The DNS configuration is written to a temporary
+ *  resolv.conf file instead of the one of the host.
+ */
+class NetCfgService
+{
+public:
+    NetCfgService(const std::string& binary,
+                  const std::vector<std::string>& extra_args)
+    {
+        char tmpl[] = "/tmp/netcfg-bench.XXXXXX";
+        if (!mkdtemp(tmpl))
+        {
+            throw CommandException("run", "Could not create a temporary "
+                                   "directory: " + std::string(strerror(errno)));
+        }
+        tmpdir = tmpl;
+        resolv_conf = tmpdir + "/resolv.conf";
+        std::ofstream(resolv_conf).close();
+
+        std::vector<std::string> args = {binary,
+                                         "--resolv-conf", resolv_conf,
+                                         "--state-dir", tmpdir};
+        args.insert(args.end(), extra_args.begin(), extra_args.end());
+
+        pid = fork();
+        if (pid < 0)
+        {
+            throw CommandException("run", "fork() failed: "
+                                   + std::string(strerror(errno)));
+        }
+        if (0 == pid)
+        {
+            std::vector<char *> argv;
+            for (auto& a : args)
+            {
+                argv.push_back(const_cast<char *>(a.c_str()));
+            }
+            argv.push_back(nullptr);
+            execv(argv[0], argv.data());
+            std::cerr << "Could not start " << binary << ": "
+                      << strerror(errno) << std::endl;
+            _exit(127);
+        }
+    }
+
+
+    ~NetCfgService()
+    {
+        if (pid > 0)
+        {
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+        }
+        unlink(resolv_conf.c_str());
+        rmdir(tmpdir.c_str());
+    }
+
+
+    /**
+     *  Waits until the service has acquired its bus name
+     */
+    void WaitReady(GDBusConnection *conn, const unsigned int timeout_ms)
+    {
+        auto deadline = bench_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (bench_clock::now() < deadline)
+        {
+            if (waitpid(pid, nullptr, WNOHANG) == pid)
+            {
+                pid = 0;
+                throw CommandException("run", "The netcfg service exited "
+                                       "during start-up");
+            }
+            if (get_netcfg_pid(conn) == pid)
+            {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        throw CommandException("run", "Timeout waiting for the netcfg service");
+    }
+
+
+    pid_t GetPID() const
+    {
+        return pid;
+    }
+
+
+private:
+    pid_t pid = 0;
+    std::string tmpdir;
+    std::string resolv_conf;
+};
+
+
+/**
+ *  Moves this process into a new network namespace with the loopback
+ *  interface up
+ */
+static void enter_new_netns()
+{
+    if (unshare(CLONE_NEWNET) < 0)
+    {
+        throw CommandException("run", "Could not create a network namespace: "
+                               + std::string(strerror(errno)));
+    }
+
+    int sd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct ifreq ifr = {};
+    strncpy(ifr.ifr_name, "lo", IFNAMSIZ - 1);
+    bool up = (sd >= 0 && ioctl(sd, SIOCGIFFLAGS, &ifr) == 0);
+    if (up)
+    {
+        ifr.ifr_flags |= IFF_UP;
+        up = (ioctl(sd, SIOCSIFFLAGS, &ifr) == 0);
+    }
+    if (!up)
+    {
+        std::cerr << "Could not bring up the loopback interface: "
+                  << strerror(errno) << std::endl;
+    }
+    if (sd >= 0)
+    {
+        close(sd);
+    }
+}
+
+
+/**
+ *  Runs a benchmark operation for all the devices, spread across all the
+ *  worker connections.  Each call of the operation is timed individually.
+ *
+ * @param name   Name of the phase, used in the report
+ * @param count  Number of devices to process
+ * @param conns  Worker connections, one thread is started per connection
+ * @param op     Operation to run, called with the worker connection and
+ *               the device index.  Exceptions are counted as errors.
+ *
+ * @return Returns the PhaseResult with all the samples
+ */
+static PhaseResult run_phase(const std::string& name, const unsigned int count,
+                             const std::vector<GDBusConnection *>& conns,
+                             std::function<void(GDBusConnection *, unsigned int)> op)
+{
+    PhaseResult result(name);
+    std::vector<PhaseResult> worker_results(conns.size(), PhaseResult(name));
+    std::vector<std::thread> workers;
+
+    auto start = bench_clock::now();
+    for (unsigned int w = 0; w < conns.size(); ++w)
+    {
+        workers.push_back(std::thread([&, w]()
+        {
+            PhaseResult& res = worker_results[w];
+            for (unsigned int i = w; i < count; i += conns.size())
+            {
+                auto t0 = bench_clock::now();
+                try
+                {
+                    op(conns[w], i);
+                    res.samples.push_back(elapsed_ms(t0, bench_clock::now()));
+                }
+                catch (const std::exception& excp)
+                {
+                    ++res.errors;
+                    std::cerr << name << "[" << i << "]: "
+                              << excp.what() << std::endl;
+                }
+            }
+        }));
+    }
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+    result.wall_ms = elapsed_ms(start, bench_clock::now());
+
+    for (const auto& r : worker_results)
+    {
+        result.Merge(r);
+    }
+    return result;
+}
+
+
+/**
+ *  Formats an IPv4 address from its host byte order value
+ */
+static std::string ipv4_str(const uint32_t addr)
+{
+    struct in_addr a = {};
+    a.s_addr = htonl(addr);
+    char buf[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &a, buf, sizeof(buf));
+    return buf;
+}
+
+
+/**
+ *  The configuration applied to a device.  Each device gets its own
+ *  /30 in 100.64.0.0/10 and its routes are /24 networks in 10.0.0.0/8,
+ *  so no address or route conflicts between the devices.  The DNS
+ *  servers from 198.18.0.0/15 are shared by all devices.  With IPv6,
+ *  the device also gets an address in fd00:6f76::/32 and an IPv6 /48
+ *  route per IPv4 route.
+ */
+static NetCfgProxy::DeviceConfig device_config(const unsigned int idx,
+                                               const unsigned int num_routes,
+                                               const unsigned int num_dns,
+                                               const bool ipv6)
+{
+    using namespace NetCfgProxy;
+
+    DeviceConfig cfg;
+    const uint32_t base = (100u << 24 | 64u << 16) + idx * 4;
+    cfg.addresses.push_back(IPAddress(ipv4_str(base + 1), 30,
+                                      ipv4_str(base + 2), false));
+    if (ipv6)
+    {
+        std::stringstream a;
+        a << "fd00:6f76:" << std::hex << idx << "::1";
+        cfg.addresses.push_back(IPAddress(a.str(), 64, "", true));
+    }
+
+    for (unsigned int r = 0; r < num_routes; ++r)
+    {
+        const uint32_t n = idx * num_routes + r;
+        cfg.networks.push_back(Network(ipv4_str((10u << 24) + n * 256), 24,
+                                       false));
+        if (ipv6)
+        {
+            std::stringstream net;
+            net << "fd00:6f77:" << std::hex << n << "::";
+            cfg.networks.push_back(Network(net.str(), 48, true));
+        }
+    }
+
+    for (unsigned int d = 0; d < num_dns; ++d)
+    {
+        cfg.dns_servers.push_back(ipv4_str((198u << 24 | 18u << 16) + 1 + d));
+    }
+    cfg.dns_search.push_back("dev" + std::to_string(idx) + ".bench.test");
+    cfg.mtu = 1500;
+    return cfg;
+}
+
+
+static unsigned int get_uint_option(ParsedArgs::Ptr args,
+                                    const std::string& opt,
+                                    const unsigned int default_value)
+{
+    if (!args->Present(opt))
+    {
+        return default_value;
+    }
+    return std::atoi(args->GetValue(opt, 0).c_str());
+}
+
+
+int cmd_run(ParsedArgs::Ptr args)
+{
+    const unsigned int num_devices = get_uint_option(args, "devices", 50);
+    const unsigned int concurrency = get_uint_option(args, "concurrency", 4);
+    const unsigned int num_routes = get_uint_option(args, "routes", 10);
+    const unsigned int num_dns = get_uint_option(args, "dns", 1);
+    const bool ipv6 = args->Present("ipv6");
+    if (0 == concurrency)
+    {
+        throw CommandException("run", "--concurrency must be at least 1");
+    }
+    if (num_devices > (1 << 20))
+    {
+        throw CommandException("run", "--devices must not exceed 1048576");
+    }
+    if ((uint64_t) num_devices * num_routes > 65536)
+    {
+        throw CommandException("run", "--devices times --routes must not "
+                                      "exceed 65536");
+    }
+
+    std::unique_ptr<NetCfgService> service;
+    if (args->Present("netcfg-service"))
+    {
+        enter_new_netns();
+        std::vector<std::string> extra;
+        if (args->Present("netcfg-option"))
+        {
+            extra = args->GetAllValues("netcfg-option");
+        }
+        service.reset(new NetCfgService(args->GetValue("netcfg-service", 0),
+                                        extra));
+    }
+
+    std::vector<GDBusConnection *> conns;
+    for (unsigned int i = 0; i < concurrency; ++i)
+    {
+        conns.push_back(open_connection());
+    }
+
+    pid_t netcfg_pid = 0;
+    if (service)
+    {
+        service->WaitReady(conns[0], 10000);
+        netcfg_pid = service->GetPID();
+    }
+    else
+    {
+        netcfg_pid = get_netcfg_pid(conns[0]);
+        if (0 == netcfg_pid)
+        {
+            // Starts the service via D-Bus activation
+            NetCfgProxy::Manager mgr(conns[0]);
+            netcfg_pid = get_netcfg_pid(conns[0]);
+        }
+        if (!args->Present("host-netns")
+            && same_netns(std::to_string(netcfg_pid), "1"))
+        {
+            throw CommandException("run", "The netcfg service runs in the "
+                                   "network namespace of the host; use "
+                                   "--netcfg-service or --host-netns");
+        }
+    }
+
+    // The monitor only needs to enter the namespace of a netcfg service
+    // not started by this program
+    NetlinkMonitor monitor(service ? 0 : netcfg_pid);
+    if (!monitor.Available())
+    {
+        std::cerr << "Netlink notifications are not counted" << std::endl;
+    }
+
+    std::vector<std::string> devpaths(num_devices);
+    std::vector<int> tunfds(num_devices, -1);
+    const std::string name_prefix = "nb" + std::to_string(getpid() % 1000) + "_";
+    Json::Value report;
+
+    auto measure = [&](const std::string& name,
+                       std::function<void(GDBusConnection *, unsigned int)> op)
+    {
+        NetlinkMonitor::Counters nl_before = monitor.Settle();
+        uint64_t cpu_before = process_cpu_ms(netcfg_pid);
+
+        PhaseResult r = run_phase(name, num_devices, conns, op);
+
+        NetlinkMonitor::Counters nl_after = monitor.Settle();
+        Json::Value& res = report["results"][name];
+        res = r.GetJSON();
+        res["netcfg_cpu_ms"] = (Json::Value::UInt64)
+                               (process_cpu_ms(netcfg_pid) - cpu_before);
+        if (monitor.Available())
+        {
+            res["netlink"] = (nl_after - nl_before).GetJSON();
+        }
+        return r.errors;
+    };
+
+    unsigned int errors = 0;
+    errors += measure("create",
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            NetCfgProxy::Manager mgr(conn);
+            devpaths[i] = mgr.CreateVirtualInterface(name_prefix
+                                                     + std::to_string(i));
+        });
+
+    errors += measure("configure",
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            if (devpaths[i].empty())
+            {
+                THROW_DBUSEXCEPTION("netcfg-bench", "No device");
+            }
+            NetCfgProxy::Device dev(conn, devpaths[i]);
+            tunfds[i] = dev.ApplyConfiguration(device_config(i, num_routes,
+                                                             num_dns, ipv6));
+        });
+
+    errors += measure("destroy",
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            if (devpaths[i].empty())
+            {
+                THROW_DBUSEXCEPTION("netcfg-bench", "No device");
+            }
+            NetCfgProxy::Device dev(conn, devpaths[i]);
+            dev.Destroy();
+            devpaths[i].clear();
+        });
+
+    // The tun file descriptors are kept open until the devices are
+    // destroyed, like a VPN client does
+    for (const auto& fd : tunfds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    for (auto& c : conns)
+    {
+        g_dbus_connection_close_sync(c, nullptr, nullptr);
+        g_object_unref(c);
+    }
+    service.reset();
+
+    report["parameters"]["devices"] = num_devices;
+    report["parameters"]["concurrency"] = concurrency;
+    report["parameters"]["routes"] = num_routes;
+    report["parameters"]["dns_servers"] = num_dns;
+    report["parameters"]["ipv6"] = ipv6;
+    report["parameters"]["private_netns"] = args->Present("netcfg-service");
+
+    if (args->Present("output"))
+    {
+        std::ofstream out(args->GetValue("output", 0));
+        out << report << std::endl;
+    }
+    else
+    {
+        std::cout << report << std::endl;
+    }
+    return (0 == errors ? 0 : 2);
+}
+
+
+int main(int argc, char **argv)
+{
+    Commands cmds("OpenVPN 3 netcfg service benchmark",
+                  "Measures the virtual interface lifecycle of the "
+                  "netcfg service at scale");
+
+    SingleCommand::Ptr run;
+    run.reset(new SingleCommand("run", "Runs the benchmark", cmd_run));
+    run->AddOption("devices", 'n', "COUNT", true,
+                   "Number of virtual interfaces to create (default: 50)");
+    run->AddOption("concurrency", 'j', "COUNT", true,
+                   "Number of parallel D-Bus clients (default: 4)");
+    run->AddOption("routes", 'r', "COUNT", true,
+                   "Routes per interface (default: 10)");
+    run->AddOption("dns", 'd', "COUNT", true,
+                   "DNS servers per interface (default: 1)");
+    run->AddOption("ipv6",
+                   "Also configure an IPv6 address and IPv6 routes");
+    run->AddOption("netcfg-service", 's', "BINARY", true,
+                   "Start this netcfg service binary in a new network "
+                   "namespace; requires root and a private bus");
+    run->AddOption("netcfg-option", "ARG", true,
+                   "Extra argument for the started netcfg service, "
+                   "can be used multiple times");
+    run->AddOption("host-netns",
+                   "Allow using a netcfg service running in the network "
+                   "namespace of the host");
+    run->AddOption("output", 'o', "FILE", true,
+                   "Write the JSON report to a file instead of stdout");
+    cmds.RegisterCommand(run);
+
+    try
+    {
+        return cmds.ProcessCommandLine(argc, argv);
+    }
+    catch (CommandException& e)
+    {
+        if (e.gotErrorMessage())
+        {
+            std::cerr << e.getCommand() << ": ** ERROR ** " << e.what() << std::endl;
+        }
+        return 9;
+    }
+    catch (const DBusException& excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
+}
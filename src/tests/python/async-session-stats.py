@@ -0,0 +1,67 @@
+#!/usr/bin/python3
+#
+#  OpenVPN 3 Linux client -- Next generation OpenVPN client
+#
+#  Copyright (C) 2022      OpenVPN Inc. <sales@openvpn.net>
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Affero General Public License as
+#  published by the Free Software Foundation, version 3 of the
+#  License.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU Affero General Public License for more details.
+#
+#  You should have received a copy of the GNU Affero General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+import sys
+import asyncio
+import datetime
+import openvpn3
+
+
+# Simple callback function which is called on each Statistics signal
+def Statistics_handler(session, stats):
+    print('%s %s BYTES_IN=%i BYTES_OUT=%i' % (datetime.datetime.now(),
+                                              session.GetPath(),
+                                              stats.get('BYTES_IN', 0),
+                                              stats.get('BYTES_OUT', 0)))
+
+
+async def main(bridge, interval_ms):
+    bus = bridge.SystemBus()
+    sessmgr = openvpn3.AsyncSessionManager(bridge, bus)
+
+    # List all sessions with a single call to the session manager
+    sessions = await sessmgr.FetchSessionsDetailed()
+    for (path, details) in sessions.items():
+        print('%s: %s' % (path, details.get('config_name')))
+        if 'status' in details:
+            print('    Status: %s' % details['status']['message'])
+
+    # Subscribe to the pushed statistics of all the sessions
+    for path in sessions.keys():
+        await sessmgr.Retrieve(path).StatisticsSubscribe(Statistics_handler,
+                                                         interval_ms)
+
+    # Wait for CTRL-C / SIGINT
+    await asyncio.Event().wait()
+
+
+if __name__ == "__main__":
+    interval = int(sys.argv[1]) if len(sys.argv) > 1 else 2000
+
+    loop = asyncio.get_event_loop()
+    bridge = openvpn3.AsyncBridge(loop)
+    try:
+        loop.run_until_complete(main(bridge, interval))
+    except KeyboardInterrupt:
+        print("Exiting")
+    finally:
+        bridge.Stop()
+
+    sys.exit(0)
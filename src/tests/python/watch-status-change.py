@@ -55,6 +55,12 @@ if __name__ == "__main__":
     # Configure the callback function handling StatusChange signals
     session.StatusChangeCallback(StatusChange_handler)
 
+    # Show the status changes which happened before we started watching
+    (last_seq, events) = session.GetStatusSince(0)
+    for ev in events:
+        print('[%i] (%s, %s) %s' % (ev['seq'], ev['major'], ev['minor'],
+                                    ev['message']))
+
     # Start the main process
     try:
         mainloop.run()
@@ -0,0 +1,952 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   datapath-bench.cpp
+ *
+ * @brief  Loopback throughput benchmark of the userspace data channel.
+ *
+ *         A client and a peer run in this process, each with an
+ *         emulated TUN device (a SOCK_SEQPACKET socket pair, like the
+ *         DummyTunBuilder hands out) and a UDP socket on the loopback
+ *         interface.  Packets written to the client TUN are encrypted
+ *         in the P_DATA_V2 format, sent over UDP, authenticated,
+ *         replay checked and decrypted by the peer and written to the
+ *         peer TUN.  Gbit/s, packets/s and CPU time per byte of the
+ *         delivered payload are reported for each cipher and packet
+ *         size.
+ *
+ *         With --dbus, the backend D-Bus plumbing runs alongside: the
+ *         packet counters are sent as periodic Statistics signals over
+ *         a peer-to-peer D-Bus connection to a receiver unpacking them,
+ *         like the session manager does.
+ *
+ *         The numbers are the upper bound of the userspace data path
+ *         on this host; with DCO, the kernel does this work instead.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <json/json.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include "common/cmdargparser.hpp"
+#include "common/utils.hpp"
+#include "dbus/core.hpp"
+#include "dbus/peer-link.hpp"
+
+
+typedef std::chrono::steady_clock bench_clock;
+
+
+class DataPathException : public std::exception
+{
+public:
+    DataPathException(const std::string& msg)
+        : message(msg)
+    {
+    }
+
+    const char* what() const noexcept
+    {
+        return message.c_str();
+    }
+
+private:
+    std::string message;
+};
+
+
+
+/**
+ *  One direction of an OpenVPN data channel, encrypting or decrypting
+ *  P_DATA_V2 packets.  AEAD ciphers use the packet id as part of the
+ *  IV and authenticate the opcode, peer-id and packet id; CBC ciphers
+ *  carry a random IV and are authenticated with HMAC-SHA256.
+ */
+class DataChannel
+{
+public:
+    /// P_DATA_V2 opcode, key id 0
+    static const uint8_t OpDataV2 = 9 << 3;
+
+    DataChannel(const std::string& name, const std::vector<uint8_t>& key_material)
+        : name(name)
+    {
+        cipher = EVP_get_cipherbyname(name.c_str());
+        if (!cipher)
+        {
+            throw DataPathException("Cipher not supported: " + name);
+        }
+        aead = (EVP_CIPHER_flags(cipher) & EVP_CIPH_FLAG_AEAD_CIPHER);
+        key.assign(key_material.begin(),
+                   key_material.begin() + EVP_CIPHER_key_length(cipher));
+        hmac_key.assign(key_material.begin() + 64, key_material.begin() + 96);
+        implicit_iv.assign(key_material.begin() + 96, key_material.begin() + 104);
+
+        ctx = EVP_CIPHER_CTX_new();
+        if (!ctx)
+        {
+            throw DataPathException("Could not allocate cipher context");
+        }
+    }
+
+    ~DataChannel()
+    {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+
+    DataChannel(const DataChannel&) = delete;
+    DataChannel& operator=(const DataChannel&) = delete;
+
+
+    /**
+     * @return Returns the maximum number of bytes added to a packet
+     */
+    size_t Overhead() const
+    {
+        return (aead ? 4 + 4 + 16 : 4 + 32 + 16 + 4 + 16);
+    }
+
+
+    /**
+     *  Encrypts a TUN packet into a P_DATA_V2 packet
+     *
+     * @param in   Plain text packet
+     * @param len  Length of the plain text packet
+     * @param out  Buffer of at least len + Overhead() bytes
+     *
+     * @return Returns the length of the encrypted packet
+     */
+    size_t Encrypt(const uint8_t *in, const size_t len, uint8_t *out)
+    {
+        uint32_t pid = htonl(++packet_id);
+        out[0] = OpDataV2;
+        out[1] = out[2] = out[3] = 0;   // peer-id 0
+
+        int outl = 0;
+        int finl = 0;
+        if (aead)
+        {
+            uint8_t iv[12];
+            memcpy(iv, &pid, 4);
+            memcpy(iv + 4, implicit_iv.data(), 8);
+            memcpy(out + 4, &pid, 4);
+
+            uint8_t *tag = out + 8;
+            uint8_t *payload = out + 24;
+            if (1 != EVP_EncryptInit_ex(ctx, cipher, nullptr, key.data(), iv)
+                || 1 != EVP_EncryptUpdate(ctx, nullptr, &outl, out, 8)
+                || 1 != EVP_EncryptUpdate(ctx, payload, &outl, in, (int) len)
+                || 1 != EVP_EncryptFinal_ex(ctx, payload + outl, &finl)
+                || 1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, 16, tag))
+            {
+                throw DataPathException(name + ": encryption failed");
+            }
+            return 24 + outl + finl;
+        }
+
+        // opcode+peer-id | HMAC | IV | E(packet-id | payload)
+        uint8_t *iv = out + 4 + 32;
+        uint8_t *payload = iv + 16;
+        RAND_bytes(iv, 16);
+        if (1 != EVP_EncryptInit_ex(ctx, cipher, nullptr, key.data(), iv)
+            || 1 != EVP_EncryptUpdate(ctx, payload, &outl, (uint8_t *) &pid, 4))
+        {
+            throw DataPathException(name + ": encryption failed");
+        }
+        int l = 0;
+        if (1 != EVP_EncryptUpdate(ctx, payload + outl, &l, in, (int) len)
+            || 1 != EVP_EncryptFinal_ex(ctx, payload + outl + l, &finl))
+        {
+            throw DataPathException(name + ": encryption failed");
+        }
+        size_t enc_len = outl + l + finl;
+        unsigned int maclen = 0;
+        HMAC(EVP_sha256(), hmac_key.data(), (int) hmac_key.size(),
+             iv, 16 + enc_len, out + 4, &maclen);
+        return 4 + 32 + 16 + enc_len;
+    }
+
+
+    /**
+     *  Authenticates, replay checks and decrypts a P_DATA_V2 packet
+     *
+     * @param in   Encrypted packet
+     * @param len  Length of the encrypted packet
+     * @param out  Buffer of at least len bytes
+     *
+     * @return Returns the length of the plain text packet, or -1 if the
+     *         packet was rejected
+     */
+    ssize_t Decrypt(const uint8_t *in, const size_t len, uint8_t *out)
+    {
+        if (len < Overhead() || OpDataV2 != in[0])
+        {
+            return -1;
+        }
+
+        int outl = 0;
+        int finl = 0;
+        uint32_t pid = 0;
+        if (aead)
+        {
+            memcpy(&pid, in + 4, 4);
+            uint8_t iv[12];
+            memcpy(iv, &pid, 4);
+            memcpy(iv + 4, implicit_iv.data(), 8);
+
+            if (1 != EVP_DecryptInit_ex(ctx, cipher, nullptr, key.data(), iv)
+                || 1 != EVP_DecryptUpdate(ctx, nullptr, &outl, in, 8)
+                || 1 != EVP_DecryptUpdate(ctx, out, &outl, in + 24, (int) (len - 24))
+                || 1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, 16,
+                                            (void *) (in + 8))
+                || 1 != EVP_DecryptFinal_ex(ctx, out + outl, &finl))
+            {
+                return -1;
+            }
+            return (replay_check(ntohl(pid)) ? outl + finl : -1);
+        }
+
+        const uint8_t *iv = in + 4 + 32;
+        size_t enc_len = len - (4 + 32 + 16);
+        uint8_t mac[32];
+        unsigned int maclen = 0;
+        HMAC(EVP_sha256(), hmac_key.data(), (int) hmac_key.size(),
+             iv, 16 + enc_len, mac, &maclen);
+        if (0 != CRYPTO_memcmp(mac, in + 4, 32))
+        {
+            return -1;
+        }
+        if (1 != EVP_DecryptInit_ex(ctx, cipher, nullptr, key.data(), iv)
+            || 1 != EVP_DecryptUpdate(ctx, out, &outl, iv + 16, (int) enc_len)
+            || 1 != EVP_DecryptFinal_ex(ctx, out + outl, &finl)
+            || outl + finl < 4)
+        {
+            return -1;
+        }
+        memcpy(&pid, out, 4);
+        if (!replay_check(ntohl(pid)))
+        {
+            return -1;
+        }
+        memmove(out, out + 4, outl + finl - 4);
+        return outl + finl - 4;
+    }
+
+
+private:
+    std::string name;
+    const EVP_CIPHER *cipher = nullptr;
+    bool aead = false;
+    std::vector<uint8_t> key;
+    std::vector<uint8_t> hmac_key;
+    std::vector<uint8_t> implicit_iv;
+    EVP_CIPHER_CTX *ctx = nullptr;
+    uint32_t packet_id = 0;
+
+    // Sliding replay window of 64 packets
+    uint32_t highest_id = 0;
+    uint64_t window = 0;
+
+    bool replay_check(const uint32_t id)
+    {
+        if (0 == id)
+        {
+            return false;
+        }
+        if (id > highest_id)
+        {
+            uint32_t shift = id - highest_id;
+            window = (shift < 64 ? (window << shift) | 1 : 1);
+            highest_id = id;
+            return true;
+        }
+        uint32_t diff = highest_id - id;
+        if (diff >= 64 || (window & (1ULL << diff)))
+        {
+            return false;
+        }
+        window |= (1ULL << diff);
+        return true;
+    }
+};
+
+
+
+/**
+ *  Packet counters of one run, updated by the data path threads
+ */
+struct Counters
+{
+    std::atomic<uint64_t> tun_read_packets{0};
+    std::atomic<uint64_t> link_sent_packets{0};
+    std::atomic<uint64_t> link_recv_packets{0};
+    std::atomic<uint64_t> rejected_packets{0};
+    std::atomic<uint64_t> delivered_packets{0};
+    std::atomic<uint64_t> delivered_bytes{0};
+    std::atomic<uint64_t> stats_signals{0};
+
+    GVariant * Pack() const
+    {
+        GVariantBuilder b;
+        g_variant_builder_init(&b, G_VARIANT_TYPE("at"));
+        g_variant_builder_add(&b, "t", (guint64) tun_read_packets.load());
+        g_variant_builder_add(&b, "t", (guint64) link_sent_packets.load());
+        g_variant_builder_add(&b, "t", (guint64) link_recv_packets.load());
+        g_variant_builder_add(&b, "t", (guint64) rejected_packets.load());
+        g_variant_builder_add(&b, "t", (guint64) delivered_packets.load());
+        g_variant_builder_add(&b, "t", (guint64) delivered_bytes.load());
+        return g_variant_builder_end(&b);
+    }
+};
+
+
+
+/**
+ *  The D-Bus plumbing of a backend: a peer-to-peer connection carrying
+ *  the periodic Statistics signal to a receiver unpacking each of them.
+ *  The timer and the receiver run in a separate main loop thread.
+ */
+class StatisticsPlumbing
+{
+public:
+    StatisticsPlumbing(Counters& counters, const unsigned int interval_ms)
+        : counters(counters)
+    {
+        context = g_main_context_new();
+        loop = g_main_loop_new(context, FALSE);
+        loop_thread = std::thread([this]()
+                                  {
+                                      g_main_context_push_thread_default(context);
+                                      g_main_loop_run(loop);
+                                      g_main_context_pop_thread_default(context);
+                                  });
+
+        int local = -1;
+        int remote = -1;
+        DBusPeerLink::SocketPair(local, remote);
+
+        std::promise<DBusPeerLink::Ptr> accepted;
+        auto accepted_f = accepted.get_future();
+        invoke([remote, &accepted]()
+               {
+                   DBusPeerLink::Accept(remote,
+                                        [&accepted](DBusPeerLink::Ptr link,
+                                                    const std::string& error)
+                                        {
+                                            if (!link)
+                                            {
+                                                std::cerr << "** ERROR ** " << error
+                                                          << std::endl;
+                                            }
+                                            accepted.set_value(link);
+                                        });
+               });
+        sender = DBusPeerLink::Connect(local);
+        receiver = accepted_f.get();
+        if (!receiver)
+        {
+            stop_loop();
+            THROW_DBUSEXCEPTION("StatisticsPlumbing",
+                                "Could not set up the peer link");
+        }
+
+        invoke([this, interval_ms]()
+               {
+                   subscription = g_dbus_connection_signal_subscribe(
+                       receiver->GetConnection(), nullptr,
+                       "net.openvpn.v3.backends", "Statistics", nullptr,
+                       nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+                       statistics_received, this, nullptr);
+
+                   GSource *timer = g_timeout_source_new(interval_ms < 100 ? 100 : interval_ms);
+                   g_source_set_callback(timer, send_statistics, this, nullptr);
+                   timer_id = g_source_attach(timer, context);
+                   g_source_unref(timer);
+               });
+    }
+
+    ~StatisticsPlumbing()
+    {
+        invoke([this]()
+               {
+                   g_source_destroy(g_main_context_find_source_by_id(context, timer_id));
+                   g_dbus_connection_signal_unsubscribe(receiver->GetConnection(),
+                                                        subscription);
+               });
+        stop_loop();
+        sender.reset();
+        receiver.reset();
+        g_main_loop_unref(loop);
+        g_main_context_unref(context);
+    }
+
+
+private:
+    Counters& counters;
+    GMainContext *context = nullptr;
+    GMainLoop *loop = nullptr;
+    std::thread loop_thread;
+    DBusPeerLink::Ptr sender;
+    DBusPeerLink::Ptr receiver;
+    guint subscription = 0;
+    guint timer_id = 0;
+    GVariant *last = nullptr;
+
+
+    /**
+     *  Runs a function in the main loop thread and waits for it
+     */
+    void invoke(std::function<void()> fn)
+    {
+        std::promise<void> done;
+        auto done_f = done.get_future();
+        auto *call = new std::pair<std::function<void()>, std::promise<void> *>(fn, &done);
+        g_main_context_invoke(context,
+                              [](gpointer data) -> gboolean
+                              {
+                                  auto *c = static_cast<std::pair<std::function<void()>,
+                                                                  std::promise<void> *> *>(data);
+                                  c->first();
+                                  c->second->set_value();
+                                  delete c;
+                                  return G_SOURCE_REMOVE;
+                              },
+                              call);
+        done_f.get();
+    }
+
+
+    void stop_loop()
+    {
+        g_main_loop_quit(loop);
+        loop_thread.join();
+        if (last)
+        {
+            g_variant_unref(last);
+            last = nullptr;
+        }
+    }
+
+
+    /**
+     *  Timer callback; sends the counters unless they are unchanged,
+     *  like the backend does
+     */
+    static gboolean send_statistics(gpointer this_ptr)
+    {
+        StatisticsPlumbing *self = static_cast<StatisticsPlumbing *>(this_ptr);
+        GVariant *packed = g_variant_ref_sink(self->counters.Pack());
+        if (self->last && g_variant_equal(self->last, packed))
+        {
+            g_variant_unref(packed);
+            return G_SOURCE_CONTINUE;
+        }
+        g_dbus_connection_emit_signal(self->sender->GetConnection(), nullptr,
+                                      "/net/openvpn/v3/backends/session",
+                                      "net.openvpn.v3.backends", "Statistics",
+                                      g_variant_new("(u@at)", 1, packed),
+                                      nullptr);
+        if (self->last)
+        {
+            g_variant_unref(self->last);
+        }
+        self->last = packed;
+        return G_SOURCE_CONTINUE;
+    }
+
+
+    static void statistics_received(GDBusConnection *conn,
+                                    const gchar *sender, const gchar *path,
+                                    const gchar *interface, const gchar *signal,
+                                    GVariant *params, gpointer this_ptr)
+    {
+        StatisticsPlumbing *self = static_cast<StatisticsPlumbing *>(this_ptr);
+        guint32 layout = 0;
+        GVariant *values = nullptr;
+        g_variant_get(params, "(u@at)", &layout, &values);
+        gsize n = 0;
+        (void) g_variant_get_fixed_array(values, &n, sizeof(guint64));
+        g_variant_unref(values);
+        ++self->counters.stats_signals;
+    }
+};
+
+
+
+/**
+ *  The result of one cipher and packet size combination
+ */
+struct RunResult
+{
+    std::string cipher;
+    size_t packet_size = 0;
+    double seconds = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    uint64_t lost = 0;
+    uint64_t rejected = 0;
+    uint64_t stats_signals = 0;
+    double cpu_seconds = 0;
+
+
+    double Gbps() const
+    {
+        return (seconds > 0 ? (bytes * 8.0) / seconds / 1e9 : 0);
+    }
+
+
+    double PacketsPerSecond() const
+    {
+        return (seconds > 0 ? packets / seconds : 0);
+    }
+
+
+    double CpuNsPerByte() const
+    {
+        return (bytes > 0 ? cpu_seconds * 1e9 / bytes : 0);
+    }
+
+
+    Json::Value GetJSON() const
+    {
+        Json::Value ret;
+        ret["cipher"] = cipher;
+        ret["packet_size"] = (Json::Value::UInt64) packet_size;
+        ret["seconds"] = seconds;
+        ret["packets"] = (Json::Value::UInt64) packets;
+        ret["bytes"] = (Json::Value::UInt64) bytes;
+        ret["lost_packets"] = (Json::Value::UInt64) lost;
+        ret["rejected_packets"] = (Json::Value::UInt64) rejected;
+        ret["statistics_signals"] = (Json::Value::UInt64) stats_signals;
+        ret["gbit_per_sec"] = Gbps();
+        ret["packets_per_sec"] = PacketsPerSecond();
+        ret["cpu_ns_per_byte"] = CpuNsPerByte();
+        return ret;
+    }
+};
+
+
+static double cpu_time()
+{
+    struct timespec ts = {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+static int udp_socket(struct sockaddr_in& addr)
+{
+    int sd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sd < 0)
+    {
+        throw DataPathException(std::string("Could not open UDP socket: ")
+                                + strerror(errno));
+    }
+    int bufsize = 4 * 1024 * 1024;
+    ::setsockopt(sd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    ::setsockopt(sd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    struct timeval tv = {0, 100000};
+    ::setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(sd, (struct sockaddr *) &addr, len) < 0
+        || ::getsockname(sd, (struct sockaddr *) &addr, &len) < 0)
+    {
+        ::close(sd);
+        throw DataPathException(std::string("Could not bind UDP socket: ")
+                                + strerror(errno));
+    }
+    return sd;
+}
+
+
+static void tun_pair(int fds[2])
+{
+    if (0 != ::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds))
+    {
+        throw DataPathException(std::string("Could not create TUN socket pair: ")
+                                + strerror(errno));
+    }
+
+    // The timeouts let the threads notice the end of a run
+    struct timeval tv = {0, 100000};
+    for (int i = 0; i < 2; ++i)
+    {
+        ::setsockopt(fds[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ::setsockopt(fds[i], SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+}
+
+
+/**
+ *  Pushes packets through the client and peer data channels for the
+ *  given duration
+ */
+static RunResult run_datapath(const std::string& cipher, const size_t packet_size,
+                              const double duration, const bool with_dbus,
+                              const unsigned int stats_interval)
+{
+    std::vector<uint8_t> key_material(128);
+    RAND_bytes(key_material.data(), (int) key_material.size());
+    DataChannel client_dc(cipher, key_material);
+    DataChannel peer_dc(cipher, key_material);
+
+    int client_tun[2];
+    int peer_tun[2];
+    tun_pair(client_tun);
+    tun_pair(peer_tun);
+    struct sockaddr_in client_addr;
+    struct sockaddr_in peer_addr;
+    int client_udp = udp_socket(client_addr);
+    int peer_udp = udp_socket(peer_addr);
+
+    Counters counters;
+    std::unique_ptr<StatisticsPlumbing> plumbing;
+    if (with_dbus)
+    {
+        plumbing.reset(new StatisticsPlumbing(counters, stats_interval));
+    }
+
+    std::atomic<bool> running{true};
+    std::string error;
+    std::mutex error_mtx;
+    auto fail = [&](const std::string& msg)
+                {
+                    std::lock_guard<std::mutex> lg(error_mtx);
+                    error = msg;
+                    running = false;
+                };
+
+    // Applications writing to the client TUN device
+    std::thread generator([&]()
+                          {
+                              std::vector<uint8_t> pkt(packet_size, 0x5a);
+                              pkt[0] = 0x45;
+                              while (running)
+                              {
+                                  ::send(client_tun[1], pkt.data(), pkt.size(),
+                                         MSG_NOSIGNAL);
+                              }
+                          });
+
+    // Client: TUN -> encrypt -> UDP
+    std::thread client([&]()
+                       {
+                           std::vector<uint8_t> in(packet_size);
+                           std::vector<uint8_t> out(packet_size + client_dc.Overhead());
+                           try
+                           {
+                               while (running)
+                               {
+                                   ssize_t r = ::recv(client_tun[0], in.data(), in.size(), 0);
+                                   if (r <= 0)
+                                   {
+                                       continue;
+                                   }
+                                   ++counters.tun_read_packets;
+                                   size_t l = client_dc.Encrypt(in.data(), r, out.data());
+                                   if (::sendto(client_udp, out.data(), l, 0,
+                                                (struct sockaddr *) &peer_addr,
+                                                sizeof(peer_addr)) > 0)
+                                   {
+                                       ++counters.link_sent_packets;
+                                   }
+                               }
+                           }
+                           catch (const DataPathException& excp)
+                           {
+                               fail(excp.what());
+                           }
+                       });
+
+    // Peer: UDP -> decrypt -> TUN
+    std::thread peer([&]()
+                     {
+                         std::vector<uint8_t> in(packet_size + peer_dc.Overhead() + 64);
+                         std::vector<uint8_t> out(in.size());
+                         while (running)
+                         {
+                             ssize_t r = ::recv(peer_udp, in.data(), in.size(), 0);
+                             if (r <= 0)
+                             {
+                                 continue;
+                             }
+                             ++counters.link_recv_packets;
+                             ssize_t l = peer_dc.Decrypt(in.data(), r, out.data());
+                             if (l < 0)
+                             {
+                                 ++counters.rejected_packets;
+                                 continue;
+                             }
+                             ::send(peer_tun[0], out.data(), l, MSG_NOSIGNAL);
+                         }
+                     });
+
+    // Applications reading from the peer TUN device
+    std::thread sink([&]()
+                     {
+                         std::vector<uint8_t> pkt(packet_size);
+                         while (running)
+                         {
+                             ssize_t r = ::recv(peer_tun[1], pkt.data(), pkt.size(), 0);
+                             if (r > 0)
+                             {
+                                 ++counters.delivered_packets;
+                                 counters.delivered_bytes += r;
+                             }
+                         }
+                     });
+
+    // Warm up before measuring
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    uint64_t start_packets = counters.delivered_packets;
+    uint64_t start_bytes = counters.delivered_bytes;
+    uint64_t start_sent = counters.link_sent_packets;
+    uint64_t start_recv = counters.link_recv_packets;
+    uint64_t start_signals = counters.stats_signals;
+    double start_cpu = cpu_time();
+    auto start = bench_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+
+    RunResult res;
+    res.cipher = cipher;
+    res.packet_size = packet_size;
+    res.seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    res.cpu_seconds = cpu_time() - start_cpu;
+    res.packets = counters.delivered_packets - start_packets;
+    res.bytes = counters.delivered_bytes - start_bytes;
+    uint64_t sent = counters.link_sent_packets - start_sent;
+    uint64_t recvd = counters.link_recv_packets - start_recv;
+    res.lost = (sent > recvd ? sent - recvd : 0);
+    res.stats_signals = counters.stats_signals - start_signals;
+
+    running = false;
+    generator.join();
+    client.join();
+    peer.join();
+    sink.join();
+    plumbing.reset();
+    res.rejected = counters.rejected_packets;
+
+    for (int fd : {client_tun[0], client_tun[1], peer_tun[0], peer_tun[1],
+                   client_udp, peer_udp})
+    {
+        ::close(fd);
+    }
+
+    if (!error.empty())
+    {
+        throw DataPathException(error);
+    }
+    return res;
+}
+
+
+static std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> ret;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+        {
+            ret.push_back(item);
+        }
+    }
+    return ret;
+}
+
+
+int cmd_run(ParsedArgs::Ptr args)
+{
+    std::vector<std::string> ciphers = {"AES-128-GCM", "AES-256-GCM",
+                                        "CHACHA20-POLY1305", "AES-256-CBC"};
+    if (args->Present("ciphers"))
+    {
+        ciphers = split_list(args->GetValue("ciphers", 0));
+    }
+
+    std::vector<size_t> sizes = {64, 512, 1400};
+    if (args->Present("sizes"))
+    {
+        sizes.clear();
+        for (const auto& s : split_list(args->GetValue("sizes", 0)))
+        {
+            int v = std::atoi(s.c_str());
+            if (v < 20 || v > 9000)
+            {
+                throw CommandException("run", "Invalid packet size: " + s);
+            }
+            sizes.push_back(v);
+        }
+    }
+
+    double duration = 2.0;
+    if (args->Present("duration"))
+    {
+        duration = std::atof(args->GetValue("duration", 0).c_str());
+        if (duration <= 0)
+        {
+            throw CommandException("run", "Invalid duration");
+        }
+    }
+
+    unsigned int stats_interval = 1000;
+    if (args->Present("stats-interval"))
+    {
+        stats_interval = std::atoi(args->GetValue("stats-interval", 0).c_str());
+    }
+
+    // Without --dbus only the bare data path is measured, with --dbus
+    // each combination is measured both with and without the plumbing
+    std::vector<bool> dbus_modes = {false};
+    if (args->Present("dbus"))
+    {
+        dbus_modes.push_back(true);
+    }
+    const bool json = args->Present("json");
+
+    Json::Value report;
+    report["parameters"]["duration"] = duration;
+    report["parameters"]["stats_interval"] = stats_interval;
+    report["parameters"]["cpus"] = std::thread::hardware_concurrency();
+
+    unsigned int errors = 0;
+    for (const auto& cipher : ciphers)
+    {
+        for (const auto& size : sizes)
+        {
+            for (bool with_dbus : dbus_modes)
+            {
+                RunResult r;
+                try
+                {
+                    r = run_datapath(cipher, size, duration, with_dbus, stats_interval);
+                }
+                catch (const DataPathException& excp)
+                {
+                    std::cerr << "** ERROR ** " << cipher << "/" << size
+                              << ": " << excp.what() << std::endl;
+                    ++errors;
+                    continue;
+                }
+                errors += (r.rejected > 0 ? 1 : 0);
+
+                Json::Value jr = r.GetJSON();
+                jr["dbus"] = with_dbus;
+                report["results"].append(jr);
+
+                if (!json)
+                {
+                    std::cout << cipher << " " << size << " bytes"
+                              << (with_dbus ? " (D-Bus)" : "") << ": "
+                              << r.Gbps() << " Gbit/s, "
+                              << (uint64_t) r.PacketsPerSecond() << " packets/s, "
+                              << r.CpuNsPerByte() << " CPU ns/byte";
+                    if (r.lost > 0 || r.rejected > 0)
+                    {
+                        std::cout << ", " << r.lost << " lost, "
+                                  << r.rejected << " rejected";
+                    }
+                    std::cout << std::endl;
+                }
+            }
+        }
+    }
+
+    if (args->Present("output"))
+    {
+        std::ofstream out(args->GetValue("output", 0));
+        out << report << std::endl;
+    }
+    else if (json)
+    {
+        std::cout << report << std::endl;
+    }
+    return (0 == errors ? 0 : 2);
+}
+
+
+int main(int argc, char **argv)
+{
+    Commands cmds("OpenVPN 3 data path benchmark",
+                  "Measures the throughput of the userspace data channel "
+                  "over the loopback interface");
+
+    SingleCommand::Ptr run;
+    run.reset(new SingleCommand("run", "Runs the benchmark", cmd_run));
+    run->AddOption("ciphers", 'c', "LIST", true,
+                   "Comma separated list of data channel ciphers "
+                   "(default: AES-128-GCM,AES-256-GCM,CHACHA20-POLY1305,AES-256-CBC)");
+    run->AddOption("sizes", 's', "LIST", true,
+                   "Comma separated list of TUN packet sizes (default: 64,512,1400)");
+    run->AddOption("duration", 'd', "SECONDS", true,
+                   "Measuring time of each combination (default: 2)");
+    run->AddOption("dbus",
+                   "Also measure each combination with the D-Bus "
+                   "Statistics plumbing running");
+    run->AddOption("stats-interval", 'i', "MS", true,
+                   "Statistics signal interval with --dbus, at least 100 "
+                   "(default: 1000)");
+    run->AddOption("json", 'j', "Print the report as JSON");
+    run->AddOption("output", 'o', "FILE", true,
+                   "Write the JSON report to a file");
+    cmds.RegisterCommand(run);
+
+    try
+    {
+        return cmds.ProcessCommandLine(argc, argv);
+    }
+    catch (CommandException& e)
+    {
+        if (e.gotErrorMessage())
+        {
+            std::cerr << e.getCommand() << ": ** ERROR ** " << e.what() << std::endl;
+        }
+        return 9;
+    }
+    catch (const DBusException& excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,593 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dbus-bench.cpp
+ *
+ * @brief  Latency and throughput benchmark of the OpenVPN 3 D-Bus
+ *         service stack.  Measures the configuration Import, NewTunnel,
+ *         Connect, Disconnect, session property reads and Log signal
+ *         delivery and reports p50/p99 latencies and throughput as JSON.
+ *
+ *         The services are reached via the system bus.  To run against
+ *         a private bus, start a dbus-daemon with the OpenVPN 3 service
+ *         files and policies and set DBUS_SYSTEM_BUS_ADDRESS before
+ *         running this program (and the services).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include <json/json.h>
+
+#include "common/cmdargparser.hpp"
+#include "common/utils.hpp"
+#include "dbus/core.hpp"
+#include "configmgr/proxy-configmgr.hpp"
+#include "sessionmgr/proxy-sessionmgr.hpp"
+
+
+typedef std::chrono::steady_clock bench_clock;
+
+
+/**
+ *  Collects the latency samples of a single benchmark phase
+ */
+struct PhaseResult
+{
+    PhaseResult(const std::string& name)
+        : name(name)
+    {
+    }
+
+
+    /**
+     *  Merge the samples gathered by another worker into this result
+     */
+    void Merge(const PhaseResult& other)
+    {
+        samples.insert(samples.end(),
+                       other.samples.begin(), other.samples.end());
+        errors += other.errors;
+    }
+
+
+    Json::Value GetJSON()
+    {
+        Json::Value ret;
+        std::sort(samples.begin(), samples.end());
+
+        ret["count"] = (Json::Value::UInt64) samples.size();
+        ret["errors"] = errors;
+        ret["wall_ms"] = wall_ms;
+        ret["throughput_ops"] = (wall_ms > 0
+                                 ? samples.size() * 1000.0 / wall_ms : 0.0);
+        if (samples.empty())
+        {
+            return ret;
+        }
+
+        double sum = 0.0;
+        for (const auto& s : samples)
+        {
+            sum += s;
+        }
+        ret["min_ms"] = samples.front();
+        ret["mean_ms"] = sum / samples.size();
+        ret["p50_ms"] = percentile(50);
+        ret["p99_ms"] = percentile(99);
+        ret["max_ms"] = samples.back();
+        return ret;
+    }
+
+
+    std::string name;
+    std::vector<double> samples = {};
+    unsigned int errors = 0;
+    double wall_ms = 0.0;
+
+
+private:
+    double percentile(const unsigned int p) const
+    {
+        // Nearest-rank method, samples must be sorted
+        size_t rank = (p * samples.size() + 99) / 100;
+        return samples[(rank > 0 ? rank - 1 : 0)];
+    }
+};
+
+
+static double elapsed_ms(const bench_clock::time_point& start,
+                         const bench_clock::time_point& end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+/**
+ *  Opens a new, non-shared connection to the system bus.  Each worker
+ *  thread uses its own connection, to avoid serializing all the calls
+ *  through the single shared GDBusConnection of this process.
+ */
+static GDBusConnection * open_connection()
+{
+    GError *error = nullptr;
+    gchar *addr = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SYSTEM,
+                                                  nullptr, &error);
+    GDBusConnection *conn = nullptr;
+    if (addr)
+    {
+        conn = g_dbus_connection_new_for_address_sync(addr,
+                       (GDBusConnectionFlags)
+                       (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                        | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                       nullptr, nullptr, &error);
+        g_free(addr);
+    }
+    if (!conn)
+    {
+        std::string err = (error ? error->message : "Unknown error");
+        if (error)
+        {
+            g_error_free(error);
+        }
+        THROW_DBUSEXCEPTION("dbus-bench",
+                            "Could not connect to the system bus: " + err);
+    }
+    return conn;
+}
+
+
+/**
+ *  Runs a benchmark operation for all the items, spread across all the
+ *  worker connections.  Each call of the operation is timed individually.
+ *
+ * @param name   Name of the phase, used in the report
+ * @param count  Number of items to process
+ * @param conns  Worker connections, one thread is started per connection
+ * @param op     Operation to run, called with the worker connection and
+ *               the item index.  Exceptions are counted as errors.
+ *
+ * @return Returns the PhaseResult with all the samples
+ */
+static PhaseResult run_phase(const std::string& name, const unsigned int count,
+                             const std::vector<GDBusConnection *>& conns,
+                             std::function<void(GDBusConnection *, unsigned int)> op)
+{
+    PhaseResult result(name);
+    std::vector<PhaseResult> worker_results(conns.size(), PhaseResult(name));
+    std::vector<std::thread> workers;
+
+    auto start = bench_clock::now();
+    for (unsigned int w = 0; w < conns.size(); ++w)
+    {
+        workers.push_back(std::thread([&, w]()
+        {
+            PhaseResult& res = worker_results[w];
+            for (unsigned int i = w; i < count; i += conns.size())
+            {
+                auto t0 = bench_clock::now();
+                try
+                {
+                    op(conns[w], i);
+                    res.samples.push_back(elapsed_ms(t0, bench_clock::now()));
+                }
+                catch (const std::exception& excp)
+                {
+                    ++res.errors;
+                    std::cerr << name << "[" << i << "]: "
+                              << excp.what() << std::endl;
+                }
+            }
+        }));
+    }
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+    result.wall_ms = elapsed_ms(start, bench_clock::now());
+
+    for (const auto& r : worker_results)
+    {
+        result.Merge(r);
+    }
+    return result;
+}
+
+
+/**
+ *  Waits until a session reports it is connected.  The session manager
+ *  does not broadcast StatusChange signals by default, so the status is
+ *  polled.
+ */
+static void wait_connected(OpenVPN3SessionProxy::Ptr session,
+                           const unsigned int timeout_ms)
+{
+    auto deadline = bench_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (bench_clock::now() < deadline)
+    {
+        StatusEvent st = session->GetLastStatus();
+        if (StatusMajor::CONNECTION == st.major)
+        {
+            if (StatusMinor::CONN_CONNECTED == st.minor)
+            {
+                return;
+            }
+            if (StatusMinor::CONN_FAILED == st.minor
+                || StatusMinor::CONN_AUTH_FAILED == st.minor)
+            {
+                THROW_DBUSEXCEPTION("dbus-bench", "Connection failed");
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    THROW_DBUSEXCEPTION("dbus-bench", "Timeout waiting for connection");
+}
+
+
+/**
+ *  Measures the delivery latency of Log signals between two bus
+ *  connections.  The signals use the same signature as the Log signals
+ *  handled by the log service, but on a benchmark specific interface.
+ */
+static PhaseResult bench_log_signals(GDBusConnection *sender_conn,
+                                     const unsigned int count)
+{
+    PhaseResult result("log_signal");
+    const std::string interf = "net.openvpn.v3.bench";
+    const std::string path = "/net/openvpn/v3/bench/"
+                             + std::to_string(getpid());
+
+    GDBusConnection *recv_conn = open_connection();
+    GMainContext *ctx = g_main_context_new();
+
+    struct Receiver
+    {
+        std::vector<bench_clock::time_point> received;
+        std::atomic<unsigned int> num_received;
+        std::atomic<bool> done;
+    } recv;
+    recv.received.resize(count);
+    recv.num_received = 0;
+    recv.done = false;
+
+    g_main_context_push_thread_default(ctx);
+    guint subscr = g_dbus_connection_signal_subscribe(
+                        recv_conn, nullptr, interf.c_str(), "Log",
+                        path.c_str(), nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+                        [](GDBusConnection *c, const gchar *s, const gchar *p,
+                           const gchar *i, const gchar *sig, GVariant *params,
+                           gpointer data)
+                        {
+                            Receiver *r = static_cast<Receiver *>(data);
+                            guint group = 0, category = 0;
+                            gchar *msg = nullptr;
+                            g_variant_get(params, "(uus)",
+                                          &group, &category, &msg);
+                            unsigned long seq = std::strtoul(msg, nullptr, 10);
+                            g_free(msg);
+                            if (seq < r->received.size())
+                            {
+                                r->received[seq] = bench_clock::now();
+                                ++r->num_received;
+                            }
+                        },
+                        &recv, nullptr);
+    g_main_context_pop_thread_default(ctx);
+
+    // A round-trip to the bus ensures the AddMatch rule of the
+    // subscription above is in place before sending anything
+    GVariant *r = g_dbus_connection_call_sync(recv_conn,
+                                              "org.freedesktop.DBus",
+                                              "/org/freedesktop/DBus",
+                                              "org.freedesktop.DBus",
+                                              "GetId", nullptr, nullptr,
+                                              G_DBUS_CALL_FLAGS_NONE,
+                                              -1, nullptr, nullptr);
+    if (r)
+    {
+        g_variant_unref(r);
+    }
+
+    std::thread receiver([&]()
+    {
+        while (!recv.done)
+        {
+            g_main_context_iteration(ctx, TRUE);
+        }
+    });
+
+    std::vector<bench_clock::time_point> sent(count);
+    auto start = bench_clock::now();
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        std::string msg = std::to_string(i);
+        sent[i] = bench_clock::now();
+        g_dbus_connection_emit_signal(sender_conn, nullptr,
+                                      path.c_str(), interf.c_str(), "Log",
+                                      g_variant_new("(uus)",
+                                                    (guint) LogGroup::CLIENT,
+                                                    (guint) LogCategory::INFO,
+                                                    msg.c_str()),
+                                      nullptr);
+    }
+    g_dbus_connection_flush_sync(sender_conn, nullptr, nullptr);
+
+    // Give the last signals some time to arrive
+    auto deadline = bench_clock::now() + std::chrono::seconds(5);
+    while (recv.num_received < count && bench_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    result.wall_ms = elapsed_ms(start, bench_clock::now());
+
+    recv.done = true;
+    g_main_context_wakeup(ctx);
+    receiver.join();
+    g_dbus_connection_signal_unsubscribe(recv_conn, subscr);
+    while (g_main_context_iteration(ctx, FALSE))
+    {
+    }
+    g_main_context_unref(ctx);
+    g_dbus_connection_close_sync(recv_conn, nullptr, nullptr);
+    g_object_unref(recv_conn);
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (bench_clock::time_point() == recv.received[i])
+        {
+            ++result.errors;
+            continue;
+        }
+        result.samples.push_back(elapsed_ms(sent[i], recv.received[i]));
+    }
+    return result;
+}
+
+
+int cmd_run(ParsedArgs::Ptr args)
+{
+    if (!args->Present("config"))
+    {
+        throw CommandException("run", "Missing --config");
+    }
+
+    const std::string config_file = args->GetValue("config", 0);
+    unsigned int num_sessions = 10;
+    unsigned int concurrency = 1;
+    unsigned int num_reads = 10;
+    unsigned int num_log_signals = 1000;
+    if (args->Present("sessions"))
+    {
+        num_sessions = std::atoi(args->GetValue("sessions", 0).c_str());
+    }
+    if (args->Present("concurrency"))
+    {
+        concurrency = std::atoi(args->GetValue("concurrency", 0).c_str());
+    }
+    if (args->Present("property-reads"))
+    {
+        num_reads = std::atoi(args->GetValue("property-reads", 0).c_str());
+    }
+    if (args->Present("log-signals"))
+    {
+        num_log_signals = std::atoi(args->GetValue("log-signals", 0).c_str());
+    }
+    if (0 == concurrency)
+    {
+        throw CommandException("run", "--concurrency must be at least 1");
+    }
+    const bool do_connect = args->Present("connect");
+
+    std::ifstream cfgfs(config_file);
+    if (!cfgfs)
+    {
+        throw CommandException("run", "Could not read " + config_file);
+    }
+    const std::string config_blob((std::istreambuf_iterator<char>(cfgfs)),
+                                  std::istreambuf_iterator<char>());
+
+    std::vector<GDBusConnection *> conns;
+    for (unsigned int i = 0; i < concurrency; ++i)
+    {
+        conns.push_back(open_connection());
+    }
+
+    std::vector<std::string> cfgpaths(num_sessions);
+    std::vector<OpenVPN3SessionProxy::Ptr> sessions(num_sessions);
+    std::vector<PhaseResult> results;
+    const std::string cfgname_prefix = "dbus-bench_" + std::to_string(getpid());
+
+    results.push_back(run_phase("import", num_sessions, conns,
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            DBus dbus(conn);
+            OpenVPN3ConfigurationProxy cfgmgr(dbus, OpenVPN3DBus_rootp_configuration);
+            cfgpaths[i] = cfgmgr.Import(cfgname_prefix + "_" + std::to_string(i),
+                                        config_blob, false, false);
+        }));
+
+    results.push_back(run_phase("new_tunnel", num_sessions, conns,
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            DBus dbus(conn);
+            OpenVPN3SessionMgrProxy sessmgr(dbus);
+            sessions[i] = sessmgr.NewTunnel(cfgpaths[i]);
+        }));
+
+    results.push_back(run_phase("property_read", num_sessions * num_reads, conns,
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            auto& s = sessions[i % num_sessions];
+            if (!s)
+            {
+                THROW_DBUSEXCEPTION("dbus-bench", "No session");
+            }
+            (void) s->GetUInt64Property("session_created");
+        }));
+
+    results.push_back(run_phase("property_read_backend", num_sessions * num_reads, conns,
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            auto& s = sessions[i % num_sessions];
+            if (!s)
+            {
+                THROW_DBUSEXCEPTION("dbus-bench", "No session");
+            }
+            (void) s->GetPackedConnectionStats();
+        }));
+
+    if (do_connect)
+    {
+        results.push_back(run_phase("connect", num_sessions, conns,
+            [&](GDBusConnection *conn, unsigned int i)
+            {
+                auto& s = sessions[i];
+                if (!s)
+                {
+                    THROW_DBUSEXCEPTION("dbus-bench", "No session");
+                }
+                s->Ready();
+                s->Connect();
+                wait_connected(s, 30000);
+            }));
+    }
+
+    results.push_back(run_phase("disconnect", num_sessions, conns,
+        [&](GDBusConnection *conn, unsigned int i)
+        {
+            auto& s = sessions[i];
+            if (!s)
+            {
+                THROW_DBUSEXCEPTION("dbus-bench", "No session");
+            }
+            s->Disconnect();
+            s.reset();
+        }));
+
+    // Clean-up, not measured
+    for (const auto& p : cfgpaths)
+    {
+        if (p.empty())
+        {
+            continue;
+        }
+        try
+        {
+            OpenVPN3ConfigurationProxy cfg(G_BUS_TYPE_SYSTEM, p);
+            cfg.Remove();
+        }
+        catch (const DBusException& excp)
+        {
+            std::cerr << "Failed removing " << p << ": " << excp.what()
+                      << std::endl;
+        }
+    }
+
+    if (0 < num_log_signals)
+    {
+        results.push_back(bench_log_signals(conns[0], num_log_signals));
+    }
+
+    for (auto& c : conns)
+    {
+        g_dbus_connection_close_sync(c, nullptr, nullptr);
+        g_object_unref(c);
+    }
+
+    Json::Value report;
+    report["parameters"]["sessions"] = num_sessions;
+    report["parameters"]["concurrency"] = concurrency;
+    report["parameters"]["property_reads"] = num_reads;
+    report["parameters"]["log_signals"] = num_log_signals;
+    report["parameters"]["connect"] = do_connect;
+    for (auto& r : results)
+    {
+        report["results"][r.name] = r.GetJSON();
+    }
+
+    if (args->Present("output"))
+    {
+        std::ofstream out(args->GetValue("output", 0));
+        out << report << std::endl;
+    }
+    else
+    {
+        std::cout << report << std::endl;
+    }
+
+    unsigned int errors = 0;
+    for (const auto& r : results)
+    {
+        errors += r.errors;
+    }
+    return (0 == errors ? 0 : 2);
+}
+
+
+int main(int argc, char **argv)
+{
+    Commands cmds("OpenVPN 3 D-Bus service benchmark",
+                  "Measures latency and throughput of the OpenVPN 3 "
+                  "D-Bus services");
+
+    SingleCommand::Ptr run;
+    run.reset(new SingleCommand("run", "Runs the benchmark", cmd_run));
+    run->AddOption("config", 'c', "FILE", true,
+                   "OpenVPN configuration profile to use for the sessions");
+    run->AddOption("sessions", 'n', "COUNT", true,
+                   "Number of sessions to start (default: 10)");
+    run->AddOption("concurrency", 'j', "COUNT", true,
+                   "Number of parallel D-Bus clients (default: 1)");
+    run->AddOption("property-reads", 'r', "COUNT", true,
+                   "Property reads per session and property (default: 10)");
+    run->AddOption("log-signals", 'l', "COUNT", true,
+                   "Number of Log signals to send, 0 disables (default: 1000)");
+    run->AddOption("connect",
+                   "Also measure Connect; requires a reachable server and "
+                   "a profile not requiring user input");
+    run->AddOption("output", 'o', "FILE", true,
+                   "Write the JSON report to a file instead of stdout");
+    cmds.RegisterCommand(run);
+
+    try
+    {
+        return cmds.ProcessCommandLine(argc, argv);
+    }
+    catch (CommandException& e)
+    {
+        if (e.gotErrorMessage())
+        {
+            std::cerr << e.getCommand() << ": ** ERROR ** " << e.what() << std::endl;
+        }
+        return 9;
+    }
+    catch (const DBusException& excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
+}
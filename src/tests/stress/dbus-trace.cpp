@@ -0,0 +1,1155 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dbus-trace.cpp
+ *
+ * @brief  Records the D-Bus traffic of the OpenVPN 3 services to a trace
+ *         file and replays the recorded client calls against the services,
+ *         to benchmark them with a real traffic mix.
+ *
+ *         The 'record' command becomes a bus monitor and writes one JSON
+ *         object per line for each method call, reply, error and signal
+ *         related to the net.openvpn.v3 services, with the time, message
+ *         size, sender and destination.  Message bodies are only recorded
+ *         with --payload, which is required to replay calls with
+ *         arguments.  The arguments of the UserInputProvide calls are
+ *         never recorded.
+ *
+ *         The 'replay' command resends the method calls made by the
+ *         clients of the services, at the recorded timing divided by the
+ *         replay speed.  Calls between the services themselves are not
+ *         replayed; the services make them again while handling the
+ *         replayed calls.  Object paths returned by the services are
+ *         mapped to the paths returned during the replay.  The report
+ *         contains the latency per method, compared to the recorded
+ *         latency, and the CPU time used by each service.
+ *
+ *         Both commands use the system bus.  To replay against a private
+ *         bus, start a dbus-daemon with the OpenVPN 3 service files and
+ *         policies and set DBUS_SYSTEM_BUS_ADDRESS before running the
+ *         services and this program.  Use --skip to leave out calls which
+ *         cannot succeed in the test setup, such as Connect without a
+ *         reachable VPN server.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+#include <glib-unix.h>
+#include <json/json.h>
+
+#include "common/cmdargparser.hpp"
+#include "common/utils.hpp"
+#include "dbus/core.hpp"
+#include "tests/stress/replay-scheduler.hpp"
+
+
+typedef std::chrono::steady_clock trace_clock;
+
+static const std::string service_prefix = "net.openvpn.v3.";
+static const std::string service_path = "/net/openvpn/v3";
+
+
+static bool starts_with(const char *str, const std::string& prefix)
+{
+    return str && 0 == strncmp(str, prefix.c_str(), prefix.size());
+}
+
+
+/**
+ *  Opens a new, non-shared connection to the system bus
+ */
+static GDBusConnection * open_connection()
+{
+    GError *error = nullptr;
+    gchar *addr = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SYSTEM,
+                                                  nullptr, &error);
+    GDBusConnection *conn = nullptr;
+    if (addr)
+    {
+        conn = g_dbus_connection_new_for_address_sync(addr,
+                       (GDBusConnectionFlags)
+                       (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                        | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                       nullptr, nullptr, &error);
+        g_free(addr);
+    }
+    if (!conn)
+    {
+        std::string err = (error ? error->message : "Unknown error");
+        if (error)
+        {
+            g_error_free(error);
+        }
+        THROW_DBUSEXCEPTION("dbus-trace",
+                            "Could not connect to the system bus: " + err);
+    }
+    return conn;
+}
+
+
+/**
+ *  Call a method of the bus daemon
+ *
+ * @return Returns the reply, or nullptr on errors
+ */
+static GVariant * bus_call(GDBusConnection *conn, const char *method,
+                          GVariant *params)
+{
+    return g_dbus_connection_call_sync(conn, "org.freedesktop.DBus",
+                                       "/org/freedesktop/DBus",
+                                       "org.freedesktop.DBus", method,
+                                       params, nullptr,
+                                       G_DBUS_CALL_FLAGS_NONE, -1,
+                                       nullptr, nullptr);
+}
+
+
+/**
+ *  Retrieve the unique names owning the net.openvpn.v3 bus names
+ *
+ * @return Returns a map of well-known bus name to unique bus name
+ */
+static std::map<std::string, std::string> get_service_owners(GDBusConnection *conn)
+{
+    std::map<std::string, std::string> ret;
+    GVariant *r = bus_call(conn, "ListNames", nullptr);
+    if (!r)
+    {
+        return ret;
+    }
+    GVariantIter *names = nullptr;
+    g_variant_get(r, "(as)", &names);
+    const gchar *n = nullptr;
+    while (g_variant_iter_next(names, "&s", &n))
+    {
+        if (!starts_with(n, service_prefix))
+        {
+            continue;
+        }
+        GVariant *o = bus_call(conn, "GetNameOwner", g_variant_new("(s)", n));
+        if (o)
+        {
+            const gchar *owner = nullptr;
+            g_variant_get(o, "(&s)", &owner);
+            ret[n] = owner;
+            g_variant_unref(o);
+        }
+    }
+    g_variant_iter_free(names);
+    g_variant_unref(r);
+    return ret;
+}
+
+
+
+//
+//  record
+//
+
+/**
+ *  Writes the messages received by a bus monitor connection to a trace
+ *  file.  The messages are delivered in the GDBus worker thread.
+ */
+class TraceRecorder
+{
+public:
+    TraceRecorder(const std::string& fname, const bool payload)
+        : out(fname), payload(payload), start(trace_clock::now())
+    {
+        if (!out)
+        {
+            throw CommandException("record", "Could not open " + fname);
+        }
+        wr["indentation"] = "";
+    }
+
+
+    void RecordOwner(const std::string& name, const std::string& owner)
+    {
+        Json::Value ev;
+        ev["t"] = (Json::Value::UInt64) elapsed_usec();
+        ev["type"] = "owner";
+        ev["name"] = name;
+        ev["owner"] = owner;
+        write(ev);
+    }
+
+
+    static GDBusMessage * monitor_filter(GDBusConnection *conn,
+                                         GDBusMessage *msg,
+                                         gboolean incoming,
+                                         gpointer this_ptr)
+    {
+        // Replies and signals addressed to this connection itself, like
+        // the reply to BecomeMonitor, are handled by GDBus as usual
+        if (!incoming
+            || 0 == g_strcmp0(g_dbus_message_get_destination(msg),
+                              g_dbus_connection_get_unique_name(conn)))
+        {
+            return msg;
+        }
+        static_cast<TraceRecorder *>(this_ptr)->record(msg);
+
+        // A monitor must not reply to anything it receives
+        g_object_unref(msg);
+        return nullptr;
+    }
+
+
+    uint64_t GetCount() const
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return count;
+    }
+
+
+private:
+    mutable std::mutex mtx;
+    std::ofstream out;
+    bool payload;
+    trace_clock::time_point start;
+    Json::StreamWriterBuilder wr;
+    uint64_t count = 0;
+
+    /// Calls whose reply is to be recorded, as (sender, serial)
+    std::set<std::pair<std::string, guint32>> pending_calls;
+
+
+    uint64_t elapsed_usec() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                    trace_clock::now() - start).count();
+    }
+
+
+    void write(const Json::Value& ev)
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        out << Json::writeString(wr, ev) << "\n";
+        ++count;
+    }
+
+
+    static std::string str(const char *s)
+    {
+        return (s ? s : "");
+    }
+
+
+    void record(GDBusMessage *msg)
+    {
+        const GDBusMessageType type = g_dbus_message_get_message_type(msg);
+        const gchar *sender = g_dbus_message_get_sender(msg);
+        const gchar *dest = g_dbus_message_get_destination(msg);
+        const gchar *path = g_dbus_message_get_path(msg);
+        const gchar *interf = g_dbus_message_get_interface(msg);
+        const gchar *member = g_dbus_message_get_member(msg);
+        GVariant *body = g_dbus_message_get_body(msg);
+
+        Json::Value ev;
+        switch (type)
+        {
+        case G_DBUS_MESSAGE_TYPE_METHOD_CALL:
+        case G_DBUS_MESSAGE_TYPE_SIGNAL:
+            if (G_DBUS_MESSAGE_TYPE_SIGNAL == type
+                && 0 == g_strcmp0(member, "NameOwnerChanged")
+                && 0 == g_strcmp0(sender, "org.freedesktop.DBus"))
+            {
+                const gchar *name = nullptr;
+                const gchar *new_owner = nullptr;
+                g_variant_get(body, "(&s&s&s)", &name, nullptr, &new_owner);
+                if (starts_with(name, service_prefix))
+                {
+                    RecordOwner(name, new_owner);
+                }
+                return;
+            }
+            if (!starts_with(interf, service_prefix)
+                && !starts_with(path, service_path))
+            {
+                return;
+            }
+            ev["type"] = (G_DBUS_MESSAGE_TYPE_SIGNAL == type ? "signal" : "call");
+            ev["path"] = str(path);
+            ev["interface"] = str(interf);
+            ev["member"] = str(member);
+            ev["serial"] = g_dbus_message_get_serial(msg);
+            if (G_DBUS_MESSAGE_TYPE_METHOD_CALL == type)
+            {
+                if (G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED
+                    & g_dbus_message_get_flags(msg))
+                {
+                    ev["no_reply"] = true;
+                }
+                else
+                {
+                    std::lock_guard<std::mutex> guard(mtx);
+                    pending_calls.insert({str(sender),
+                                          g_dbus_message_get_serial(msg)});
+                }
+            }
+            break;
+
+        case G_DBUS_MESSAGE_TYPE_METHOD_RETURN:
+        case G_DBUS_MESSAGE_TYPE_ERROR:
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                auto it = pending_calls.find({str(dest),
+                                              g_dbus_message_get_reply_serial(msg)});
+                if (pending_calls.end() == it)
+                {
+                    return;
+                }
+                pending_calls.erase(it);
+            }
+            ev["type"] = (G_DBUS_MESSAGE_TYPE_ERROR == type ? "error" : "return");
+            ev["reply_serial"] = g_dbus_message_get_reply_serial(msg);
+            if (G_DBUS_MESSAGE_TYPE_ERROR == type)
+            {
+                ev["error"] = str(g_dbus_message_get_error_name(msg));
+            }
+            break;
+
+        default:
+            return;
+        }
+
+        ev["t"] = (Json::Value::UInt64) elapsed_usec();
+        ev["sender"] = str(sender);
+        ev["dest"] = str(dest);
+        ev["signature"] = str(g_dbus_message_get_signature(msg));
+        gsize size = 0;
+        guchar *blob = g_dbus_message_to_blob(msg, &size,
+                                              G_DBUS_CAPABILITY_FLAGS_NONE,
+                                              nullptr);
+        g_free(blob);
+        ev["size"] = (Json::Value::UInt64) size;
+
+        if (payload && body && 0 != g_strcmp0(member, "UserInputProvide"))
+        {
+            gchar *txt = g_variant_print(body, TRUE);
+            ev["body"] = txt;
+            g_free(txt);
+        }
+        write(ev);
+    }
+};
+
+
+static gboolean stop_handler(gpointer loop)
+{
+    g_main_loop_quit((GMainLoop *) loop);
+    return FALSE;
+}
+
+
+int cmd_record(ParsedArgs::Ptr args)
+{
+    if (!args->Present("output"))
+    {
+        throw CommandException("record", "Missing --output");
+    }
+    unsigned int duration = 0;
+    if (args->Present("duration"))
+    {
+        duration = std::atoi(args->GetValue("duration", 0).c_str());
+    }
+
+    TraceRecorder recorder(args->GetValue("output", 0),
+                           args->Present("payload"));
+    GDBusConnection *conn = open_connection();
+
+    // The services running now; later changes are recorded from the
+    // NameOwnerChanged signals
+    for (const auto& o : get_service_owners(conn))
+    {
+        recorder.RecordOwner(o.first, o.second);
+    }
+
+    g_dbus_connection_add_filter(conn, TraceRecorder::monitor_filter,
+                                 &recorder, nullptr);
+    // No match rules; all messages are received and filtered here, as the
+    // replies of the VPN client processes cannot be matched by name
+    const gchar *rules[] = {nullptr};
+    GError *err = nullptr;
+    GVariant *r = g_dbus_connection_call_sync(conn, "org.freedesktop.DBus",
+                                              "/org/freedesktop/DBus",
+                                              "org.freedesktop.DBus.Monitoring",
+                                              "BecomeMonitor",
+                                              g_variant_new("(^asu)", rules, 0),
+                                              nullptr, G_DBUS_CALL_FLAGS_NONE,
+                                              -1, nullptr, &err);
+    if (!r)
+    {
+        std::string msg = (err ? err->message : "Unknown error");
+        if (err)
+        {
+            g_error_free(err);
+        }
+        g_object_unref(conn);
+        throw CommandException("record", "Could not become a bus monitor: "
+                               + msg);
+    }
+    g_variant_unref(r);
+
+    GMainLoop *main_loop = g_main_loop_new(nullptr, FALSE);
+    g_unix_signal_add(SIGINT, stop_handler, main_loop);
+    g_unix_signal_add(SIGTERM, stop_handler, main_loop);
+    if (duration > 0)
+    {
+        g_timeout_add_seconds(duration, stop_handler, main_loop);
+    }
+    g_main_loop_run(main_loop);
+    g_main_loop_unref(main_loop);
+
+    g_dbus_connection_close_sync(conn, nullptr, nullptr);
+    g_object_unref(conn);
+
+    std::cerr << "Recorded " << recorder.GetCount() << " events" << std::endl;
+    return 0;
+}
+
+
+
+//
+//  replay
+//
+
+/**
+ *  Latency samples of a method
+ */
+struct MethodResult
+{
+    Json::Value GetJSON()
+    {
+        Json::Value ret;
+        ret["count"] = (Json::Value::UInt64) samples.size();
+        ret["errors"] = errors;
+        add_percentiles(ret, "", samples);
+        add_percentiles(ret, "recorded_", recorded);
+        return ret;
+    }
+
+    std::vector<double> samples = {};
+    std::vector<double> recorded = {};
+    unsigned int errors = 0;
+
+
+private:
+    static void add_percentiles(Json::Value& ret, const std::string& prefix,
+                                std::vector<double>& s)
+    {
+        if (s.empty())
+        {
+            return;
+        }
+        std::sort(s.begin(), s.end());
+        ret[prefix + "p50_ms"] = percentile(s, 50);
+        ret[prefix + "p99_ms"] = percentile(s, 99);
+        ret[prefix + "max_ms"] = s.back();
+    }
+
+    static double percentile(const std::vector<double>& s, const unsigned int p)
+    {
+        // Nearest-rank method, samples must be sorted
+        size_t rank = (p * s.size() + 99) / 100;
+        return s[(rank > 0 ? rank - 1 : 0)];
+    }
+};
+
+
+/**
+ *  CPU time used by a process, from /proc/PID/stat
+ *
+ * @return Returns the user and system CPU time in milliseconds, or 0
+ */
+static uint64_t process_cpu_ms(const guint32 pid)
+{
+    std::ifstream f("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!f || !std::getline(f, line))
+    {
+        return 0;
+    }
+    size_t p = line.rfind(')');
+    if (std::string::npos == p)
+    {
+        return 0;
+    }
+    // utime and stime are the 12th and 13th fields after the process name
+    std::istringstream fields(line.substr(p + 1));
+    std::string field;
+    for (unsigned int i = 0; i < 11 && (fields >> field); ++i)
+    {
+    }
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    long hz = sysconf(_SC_CLK_TCK);
+    if (!(fields >> utime >> stime) || hz <= 0)
+    {
+        return 0;
+    }
+    return (utime + stime) * 1000 / hz;
+}
+
+
+static void collect_paths(GVariant *v, std::vector<std::string>& paths)
+{
+    if (g_variant_is_of_type(v, G_VARIANT_TYPE_OBJECT_PATH))
+    {
+        paths.push_back(g_variant_get_string(v, nullptr));
+        return;
+    }
+    if (!g_variant_is_container(v))
+    {
+        return;
+    }
+    for (gsize i = 0; i < g_variant_n_children(v); ++i)
+    {
+        GVariant *c = g_variant_get_child_value(v, i);
+        collect_paths(c, paths);
+        g_variant_unref(c);
+    }
+}
+
+
+/**
+ *  Replace the object paths in a value
+ *
+ * @return Returns a new reference to the resulting value
+ */
+static GVariant * remap_paths(GVariant *v,
+                              const std::map<std::string, std::string>& map)
+{
+    if (g_variant_is_of_type(v, G_VARIANT_TYPE_OBJECT_PATH))
+    {
+        auto it = map.find(g_variant_get_string(v, nullptr));
+        if (map.end() != it)
+        {
+            return g_variant_ref_sink(g_variant_new_object_path(it->second.c_str()));
+        }
+        return g_variant_ref(v);
+    }
+    if (!g_variant_is_container(v))
+    {
+        return g_variant_ref(v);
+    }
+
+    std::vector<GVariant *> children;
+    for (gsize i = 0; i < g_variant_n_children(v); ++i)
+    {
+        GVariant *c = g_variant_get_child_value(v, i);
+        children.push_back(remap_paths(c, map));
+        g_variant_unref(c);
+    }
+
+    GVariant *ret = nullptr;
+    const GVariantType *type = g_variant_get_type(v);
+    if (g_variant_type_is_variant(type))
+    {
+        ret = g_variant_new_variant(children[0]);
+    }
+    else if (g_variant_type_is_dict_entry(type))
+    {
+        ret = g_variant_new_dict_entry(children[0], children[1]);
+    }
+    else if (g_variant_type_is_tuple(type))
+    {
+        ret = g_variant_new_tuple(children.data(), children.size());
+    }
+    else if (g_variant_type_is_maybe(type))
+    {
+        ret = g_variant_new_maybe(g_variant_type_element(type),
+                                  (children.empty() ? nullptr : children[0]));
+    }
+    else
+    {
+        ret = g_variant_new_array(g_variant_type_element(type),
+                                  children.data(), children.size());
+    }
+    for (auto& c : children)
+    {
+        g_variant_unref(c);
+    }
+    return g_variant_ref_sink(ret);
+}
+
+
+/**
+ *  Resends the client calls of a trace file
+ */
+class TraceReplay
+{
+public:
+    struct TraceCall
+    {
+        std::string client;
+        std::string dest;
+        std::string path;
+        std::string interf;
+        std::string member;
+        std::string signature;
+        std::string body;
+        bool no_reply = false;
+        std::string recorded_reply;
+        double recorded_ms = -1.0;
+    };
+
+
+    TraceReplay(const double speed, const std::set<std::string>& skip)
+        : scheduler(speed), skip(skip)
+    {
+    }
+
+
+    ~TraceReplay()
+    {
+        for (auto& c : connections)
+        {
+            g_dbus_connection_close_sync(c.second, nullptr, nullptr);
+            g_object_unref(c.second);
+        }
+    }
+
+
+    /**
+     *  Load the calls to replay from a trace file
+     */
+    void Load(const std::string& fname)
+    {
+        std::ifstream in(fname);
+        if (!in)
+        {
+            throw CommandException("replay", "Could not open " + fname);
+        }
+
+        // Unique bus names which owned a service name, and the name
+        std::map<std::string, std::string> owners;
+        // Recorded calls waiting for a reply, as (client, serial)
+        std::map<std::pair<std::string, guint32>, std::pair<size_t, uint64_t>> waiting;
+
+        Json::CharReaderBuilder rd;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            Json::Value ev;
+            std::string errors;
+            std::istringstream ls(line);
+            if (!Json::parseFromStream(rd, ls, &ev, &errors) || !ev.isObject())
+            {
+                ++skipped["invalid"];
+                continue;
+            }
+            const std::string type = ev["type"].asString();
+            const uint64_t t = ev["t"].asUInt64();
+
+            if ("owner" == type)
+            {
+                if (!ev["owner"].asString().empty())
+                {
+                    owners[ev["owner"].asString()] = ev["name"].asString();
+                }
+            }
+            else if ("call" == type)
+            {
+                add_call(ev, t, owners, waiting);
+            }
+            else if ("return" == type || "error" == type)
+            {
+                auto it = waiting.find({ev["dest"].asString(),
+                                        ev["reply_serial"].asUInt()});
+                if (waiting.end() == it)
+                {
+                    continue;
+                }
+                TraceCall& c = calls[it->second.first];
+                c.recorded_ms = (t - it->second.second) / 1000.0;
+                if ("return" == type)
+                {
+                    c.recorded_reply = ev["body"].asString();
+                }
+                waiting.erase(it);
+            }
+        }
+    }
+
+
+    /**
+     *  Replay the loaded calls and wait for all replies
+     */
+    void Run()
+    {
+        loop = g_main_loop_new(nullptr, FALSE);
+        start = trace_clock::now();
+        schedule();
+        g_main_loop_run(loop);
+        g_main_loop_unref(loop);
+        loop = nullptr;
+        wall_ms = std::chrono::duration<double, std::milli>(trace_clock::now()
+                                                            - start).count();
+    }
+
+
+    Json::Value GetJSON()
+    {
+        Json::Value ret;
+        ret["calls"] = (Json::Value::UInt64) calls.size();
+        ret["wall_ms"] = wall_ms;
+        ret["max_lag_ms"] = max_lag_usec / 1000.0;
+        for (const auto& s : skipped)
+        {
+            ret["skipped"][s.first] = s.second;
+        }
+        for (auto& m : methods)
+        {
+            ret["methods"][m.first] = m.second.GetJSON();
+        }
+        for (const auto& e : error_names)
+        {
+            ret["errors"][e.first] = e.second;
+        }
+        return ret;
+    }
+
+
+    size_t GetCallCount() const
+    {
+        return calls.size();
+    }
+
+
+private:
+    struct PendingReply
+    {
+        TraceReplay *self;
+        size_t idx;
+        trace_clock::time_point sent;
+    };
+
+    ReplayScheduler scheduler;
+    std::set<std::string> skip;
+    std::vector<TraceCall> calls;
+    std::map<std::string, unsigned int> skipped;
+    std::map<std::string, MethodResult> methods;
+    std::map<std::string, unsigned int> error_names;
+    std::map<std::string, std::string> path_map;
+    std::map<std::string, GDBusConnection *> connections;
+    GMainLoop *loop = nullptr;
+    guint timer = 0;
+    trace_clock::time_point start;
+    uint64_t max_lag_usec = 0;
+    double wall_ms = 0.0;
+
+
+    void add_call(const Json::Value& ev, const uint64_t t,
+                  const std::map<std::string, std::string>& owners,
+                  std::map<std::pair<std::string, guint32>, std::pair<size_t, uint64_t>>& waiting)
+    {
+        TraceCall c;
+        c.client = ev["sender"].asString();
+        c.dest = ev["dest"].asString();
+        c.path = ev["path"].asString();
+        c.interf = ev["interface"].asString();
+        c.member = ev["member"].asString();
+        c.signature = ev["signature"].asString();
+        c.body = ev["body"].asString();
+        c.no_reply = ev["no_reply"].asBool();
+
+        // Calls made by the services are repeated by the services
+        if (owners.count(c.client) > 0)
+        {
+            ++skipped["service_internal"];
+            return;
+        }
+        auto o = owners.find(c.dest);
+        if (owners.end() != o)
+        {
+            c.dest = o->second;
+        }
+        if (!starts_with(c.dest.c_str(), service_prefix))
+        {
+            ++skipped["unknown_destination"];
+            return;
+        }
+        // Calls to a specific VPN client process cannot be repeated
+        if (starts_with(c.dest.c_str(), OpenVPN3DBus_name_backends_be))
+        {
+            ++skipped["backend_process"];
+            return;
+        }
+        if (skip.count(c.member) > 0 || skip.count(c.interf + "." + c.member) > 0)
+        {
+            ++skipped["skip_option"];
+            return;
+        }
+        if (c.body.empty() && !c.signature.empty())
+        {
+            ++skipped["no_payload"];
+            return;
+        }
+
+        if (!c.no_reply)
+        {
+            waiting[{c.client, ev["serial"].asUInt()}] = {calls.size(), t};
+        }
+        scheduler.Add(calls.size(), c.client, t);
+        calls.push_back(std::move(c));
+    }
+
+
+    uint64_t elapsed_usec() const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                    trace_clock::now() - start).count();
+    }
+
+
+    GDBusConnection * connection(const std::string& client)
+    {
+        auto it = connections.find(client);
+        if (connections.end() != it)
+        {
+            return it->second;
+        }
+        // One connection per recorded client, so the services see the
+        // same number of peers as when the trace was recorded
+        GDBusConnection *c = open_connection();
+        connections[client] = c;
+        return c;
+    }
+
+
+    void schedule()
+    {
+        if (0 != timer)
+        {
+            g_source_remove(timer);
+            timer = 0;
+        }
+        if (scheduler.Done())
+        {
+            g_main_loop_quit(loop);
+            return;
+        }
+        uint64_t due = scheduler.NextDue(elapsed_usec());
+        if (UINT64_MAX == due)
+        {
+            // Waiting for replies
+            return;
+        }
+        timer = g_timeout_add((due + 999) / 1000, timer_fired, this);
+    }
+
+
+    static gboolean timer_fired(gpointer this_ptr)
+    {
+        TraceReplay *self = static_cast<TraceReplay *>(this_ptr);
+        self->timer = 0;
+        for (const auto& c : self->scheduler.Ready(self->elapsed_usec()))
+        {
+            self->max_lag_usec = std::max(self->max_lag_usec, c.lag_usec);
+            self->send(c.id);
+        }
+        self->schedule();
+        return G_SOURCE_REMOVE;
+    }
+
+
+    void send(const size_t idx)
+    {
+        TraceCall& c = calls[idx];
+        MethodResult& res = methods[c.interf + "." + c.member];
+        if (c.recorded_ms >= 0.0)
+        {
+            res.recorded.push_back(c.recorded_ms);
+        }
+
+        GVariant *params = nullptr;
+        if (!c.body.empty())
+        {
+            GError *err = nullptr;
+            GVariant *parsed = g_variant_parse(nullptr, c.body.c_str(),
+                                               nullptr, nullptr, &err);
+            if (!parsed)
+            {
+                g_error_free(err);
+                ++res.errors;
+                ++error_names["trace.body.invalid"];
+                scheduler.Completed(c.client);
+                return;
+            }
+            params = remap_paths(parsed, path_map);
+            g_variant_unref(parsed);
+        }
+        auto p = path_map.find(c.path);
+        const std::string& path = (path_map.end() != p ? p->second : c.path);
+
+        GDBusConnection *conn = connection(c.client);
+        if (c.no_reply)
+        {
+            GDBusMessage *msg = g_dbus_message_new_method_call(c.dest.c_str(),
+                                                               path.c_str(),
+                                                               c.interf.c_str(),
+                                                               c.member.c_str());
+            g_dbus_message_set_body(msg, params);
+            g_dbus_message_set_flags(msg, G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED);
+            g_dbus_connection_send_message(conn, msg, G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+                                           nullptr, nullptr);
+            g_object_unref(msg);
+            if (params)
+            {
+                g_variant_unref(params);
+            }
+            res.samples.push_back(0.0);
+            scheduler.Completed(c.client);
+            return;
+        }
+
+        PendingReply *pr = new PendingReply{this, idx, trace_clock::now()};
+        g_dbus_connection_call(conn, c.dest.c_str(), path.c_str(),
+                               c.interf.c_str(), c.member.c_str(),
+                               params, nullptr, G_DBUS_CALL_FLAGS_NONE,
+                               -1, nullptr, reply_received, pr);
+        if (params)
+        {
+            g_variant_unref(params);
+        }
+    }
+
+
+    static void reply_received(GObject *source, GAsyncResult *res,
+                               gpointer data)
+    {
+        PendingReply *pr = static_cast<PendingReply *>(data);
+        TraceReplay *self = pr->self;
+        TraceCall& c = self->calls[pr->idx];
+        MethodResult& mres = self->methods[c.interf + "." + c.member];
+
+        GError *err = nullptr;
+        GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source),
+                                                        res, &err);
+        double ms = std::chrono::duration<double, std::milli>(trace_clock::now()
+                                                              - pr->sent).count();
+        if (reply)
+        {
+            mres.samples.push_back(ms);
+            self->map_reply_paths(c, reply);
+            g_variant_unref(reply);
+        }
+        else
+        {
+            ++mres.errors;
+            gchar *name = g_dbus_error_get_remote_error(err);
+            ++self->error_names[(name ? name : err->message)];
+            g_free(name);
+            g_error_free(err);
+        }
+        delete pr;
+
+        self->scheduler.Completed(c.client);
+        self->schedule();
+    }
+
+
+    /**
+     *  Map the object paths of a recorded reply to the ones in the reply
+     *  received now, in the order they appear
+     */
+    void map_reply_paths(const TraceCall& c, GVariant *reply)
+    {
+        if (c.recorded_reply.empty())
+        {
+            return;
+        }
+        GVariant *recorded = g_variant_parse(nullptr, c.recorded_reply.c_str(),
+                                             nullptr, nullptr, nullptr);
+        if (!recorded)
+        {
+            return;
+        }
+        std::vector<std::string> old_paths;
+        std::vector<std::string> new_paths;
+        collect_paths(recorded, old_paths);
+        collect_paths(reply, new_paths);
+        g_variant_unref(recorded);
+        for (size_t i = 0; i < std::min(old_paths.size(), new_paths.size()); ++i)
+        {
+            if (old_paths[i] != new_paths[i])
+            {
+                path_map[old_paths[i]] = new_paths[i];
+            }
+        }
+    }
+};
+
+
+int cmd_replay(ParsedArgs::Ptr args)
+{
+    if (!args->Present("trace"))
+    {
+        throw CommandException("replay", "Missing --trace");
+    }
+    double speed = 1.0;
+    if (args->Present("speed"))
+    {
+        speed = std::atof(args->GetValue("speed", 0).c_str());
+    }
+    if (speed < 1.0 || speed > 50.0)
+    {
+        throw CommandException("replay", "--speed must be between 1 and 50");
+    }
+    std::set<std::string> skip;
+    if (args->Present("skip"))
+    {
+        for (const auto& s : args->GetAllValues("skip"))
+        {
+            skip.insert(s);
+        }
+    }
+
+    TraceReplay replay(speed, skip);
+    replay.Load(args->GetValue("trace", 0));
+    if (0 == replay.GetCallCount())
+    {
+        throw CommandException("replay", "No calls to replay in the trace");
+    }
+
+    GDBusConnection *conn = open_connection();
+    std::map<std::string, std::pair<guint32, uint64_t>> cpu_before;
+    for (const auto& o : get_service_owners(conn))
+    {
+        if (starts_with(o.first.c_str(), OpenVPN3DBus_name_backends_be))
+        {
+            continue;
+        }
+        GVariant *r = bus_call(conn, "GetConnectionUnixProcessID",
+                               g_variant_new("(s)", o.first.c_str()));
+        if (r)
+        {
+            guint32 pid = 0;
+            g_variant_get(r, "(u)", &pid);
+            g_variant_unref(r);
+            cpu_before[o.first] = {pid, process_cpu_ms(pid)};
+        }
+    }
+
+    replay.Run();
+
+    Json::Value report;
+    report["parameters"]["trace"] = args->GetValue("trace", 0);
+    report["parameters"]["speed"] = speed;
+    report["replay"] = replay.GetJSON();
+    const double wall_ms = report["replay"]["wall_ms"].asDouble();
+    for (const auto& c : cpu_before)
+    {
+        // Services started during the replay are not measured; a
+        // restarted service is reported without the CPU time
+        uint64_t cpu_after = process_cpu_ms(c.second.first);
+        Json::Value& s = report["services"][c.first];
+        s["pid"] = c.second.first;
+        if (cpu_after >= c.second.second && cpu_after > 0)
+        {
+            s["cpu_ms"] = (Json::Value::UInt64) (cpu_after - c.second.second);
+            s["cpu_pct"] = (wall_ms > 0
+                            ? (cpu_after - c.second.second) * 100.0 / wall_ms
+                            : 0.0);
+        }
+    }
+    g_dbus_connection_close_sync(conn, nullptr, nullptr);
+    g_object_unref(conn);
+
+    if (args->Present("output"))
+    {
+        std::ofstream out(args->GetValue("output", 0));
+        out << report << std::endl;
+    }
+    else
+    {
+        std::cout << report << std::endl;
+    }
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    Commands cmds("OpenVPN 3 D-Bus trace recorder",
+                  "Records and replays the D-Bus traffic of the "
+                  "OpenVPN 3 services");
+
+    SingleCommand::Ptr record;
+    record.reset(new SingleCommand("record",
+                                   "Records the D-Bus traffic of the services",
+                                   cmd_record));
+    record->AddOption("output", 'o', "FILE", true,
+                      "Trace file to write");
+    record->AddOption("duration", 'd', "SECONDS", true,
+                      "Stop recording after this time (default: until "
+                      "interrupted)");
+    record->AddOption("payload",
+                      "Record the message bodies, required to replay calls "
+                      "with arguments.  The trace then contains the "
+                      "imported configuration profiles.");
+    cmds.RegisterCommand(record);
+
+    SingleCommand::Ptr replay;
+    replay.reset(new SingleCommand("replay",
+                                   "Replays the client calls of a trace",
+                                   cmd_replay));
+    replay->AddOption("trace", 't', "FILE", true,
+                      "Trace file to replay");
+    replay->AddOption("speed", 's', "FACTOR", true,
+                      "Replay speed, from 1 to 50 (default: 1)");
+    replay->AddOption("skip", "METHOD", true,
+                      "Do not replay calls of this method, given as "
+                      "MEMBER or INTERFACE.MEMBER.  Can be used several "
+                      "times.");
+    replay->AddOption("output", 'o', "FILE", true,
+                      "Write the JSON report to a file instead of stdout");
+    cmds.RegisterCommand(replay);
+
+    try
+    {
+        return cmds.ProcessCommandLine(argc, argv);
+    }
+    catch (CommandException& e)
+    {
+        if (e.gotErrorMessage())
+        {
+            std::cerr << e.getCommand() << ": ** ERROR ** " << e.what() << std::endl;
+        }
+        return 9;
+    }
+    catch (const DBusException& excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
+}
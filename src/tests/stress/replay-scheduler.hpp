@@ -0,0 +1,180 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   replay-scheduler.hpp
+ *
+ * @brief  Decides when the recorded D-Bus method calls of a trace are
+ *         sent again during a replay
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/**
+ *  Schedules the replay of recorded method calls.
+ *
+ *  The calls are sent at their recorded time divided by the replay
+ *  speed.  Each recorded client only has one call in progress at a time,
+ *  so a call depending on the result of an earlier call of the same
+ *  client, such as an object path it returned, is not sent before that
+ *  result is available.  A call which is held back is sent late; the
+ *  lag is reported with the call.
+ */
+class ReplayScheduler
+{
+public:
+    struct Call
+    {
+        uint64_t id;        ///< Caller provided identifier of the call
+        uint64_t lag_usec;  ///< How late the call is sent
+    };
+
+
+    /**
+     * @param speed  Replay speed factor, 1.0 replays with the recorded
+     *               timing
+     */
+    ReplayScheduler(const double speed)
+        : speed(speed > 0.0 ? speed : 1.0)
+    {
+    }
+
+
+    /**
+     *  Add a recorded call.  The calls of a client must be added in the
+     *  recorded order.
+     *
+     * @param id      Identifier of the call, returned by Ready()
+     * @param client  Recorded client which made the call
+     * @param t_usec  Recorded time of the call since the start of the
+     *                trace
+     */
+    void Add(const uint64_t id, const std::string& client,
+             const uint64_t t_usec)
+    {
+        queues[client].push_back({id, (uint64_t) (t_usec / speed)});
+        ++pending;
+    }
+
+
+    /**
+     *  Retrieve the calls to send now
+     *
+     * @param elapsed_usec  Time since the start of the replay
+     *
+     * @return Returns the calls to send, in their scheduled order.  Their
+     *         clients are marked as busy until Completed() is called.
+     */
+    std::vector<Call> Ready(const uint64_t elapsed_usec)
+    {
+        std::vector<std::pair<uint64_t, Call>> ready;
+        for (auto& q : queues)
+        {
+            if (q.second.empty() || busy.count(q.first) > 0
+                || q.second.front().due_usec > elapsed_usec)
+            {
+                continue;
+            }
+            const Entry& e = q.second.front();
+            ready.push_back({e.due_usec, {e.id, elapsed_usec - e.due_usec}});
+            busy.insert(q.first);
+            q.second.pop_front();
+            --pending;
+        }
+        std::sort(ready.begin(), ready.end(),
+                  [](const std::pair<uint64_t, Call>& a,
+                     const std::pair<uint64_t, Call>& b)
+                  {
+                      return a.first < b.first;
+                  });
+
+        std::vector<Call> ret;
+        for (const auto& r : ready)
+        {
+            ret.push_back(r.second);
+        }
+        return ret;
+    }
+
+
+    /**
+     *  Mark the call in progress of a client as completed
+     */
+    void Completed(const std::string& client)
+    {
+        busy.erase(client);
+    }
+
+
+    /**
+     *  Time until the next call can be sent
+     *
+     * @param elapsed_usec  Time since the start of the replay
+     *
+     * @return Returns the number of microseconds until the next call is
+     *         due, 0 if a call is due now, or UINT64_MAX if all clients
+     *         with remaining calls have a call in progress or no calls
+     *         remain
+     */
+    uint64_t NextDue(const uint64_t elapsed_usec) const
+    {
+        uint64_t ret = UINT64_MAX;
+        for (const auto& q : queues)
+        {
+            if (q.second.empty() || busy.count(q.first) > 0)
+            {
+                continue;
+            }
+            uint64_t due = q.second.front().due_usec;
+            ret = std::min(ret, (due > elapsed_usec ? due - elapsed_usec : 0));
+        }
+        return ret;
+    }
+
+
+    /**
+     * @return Returns true when all calls have been sent and completed
+     */
+    bool Done() const
+    {
+        return 0 == pending && busy.empty();
+    }
+
+
+private:
+    struct Entry
+    {
+        uint64_t id;
+        uint64_t due_usec;
+    };
+
+    double speed;
+    size_t pending = 0;
+    std::map<std::string, std::deque<Entry>> queues;
+    std::set<std::string> busy;
+};
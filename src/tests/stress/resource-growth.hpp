@@ -0,0 +1,256 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   resource-growth.hpp
+ *
+ * @brief  Detects sustained growth in periodically sampled resource
+ *         counters, such as the memory usage or the number of open file
+ *         descriptors of a service
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/**
+ *  Series of samples of a single resource counter.
+ *
+ *  A counter is considered to grow when, after the warm-up period, the
+ *  smallest value of the last third of the samples is above the largest
+ *  value of the first third and the increase is larger than the
+ *  tolerance.  Counters which only fluctuate or settle at a higher
+ *  level after the warm-up are not reported.
+ */
+class ResourceSeries
+{
+public:
+    struct Analysis
+    {
+        size_t samples = 0;
+        uint64_t first = 0;
+        uint64_t last = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+        double slope_per_hour = 0.0;  ///< Least squares fit, after warm-up
+        bool growing = false;
+    };
+
+
+    /**
+     * @param rel_tolerance  Growth below this fraction of the early level
+     *                       is ignored
+     * @param abs_tolerance  Growth below this absolute value is ignored
+     */
+    ResourceSeries(const double rel_tolerance = 0.10,
+                   const uint64_t abs_tolerance = 0)
+        : rel_tolerance(rel_tolerance), abs_tolerance(abs_tolerance)
+    {
+    }
+
+
+    /**
+     *  Add a sample
+     *
+     * @param t_sec  Seconds since the start of the test
+     * @param value  Sampled value
+     */
+    void Add(const double t_sec, const uint64_t value)
+    {
+        samples.emplace_back(t_sec, value);
+    }
+
+
+    /**
+     *  Discard all samples, used when the sampled process was restarted
+     */
+    void Clear()
+    {
+        samples.clear();
+    }
+
+
+    /**
+     *  Analyse the samples
+     *
+     * @param warmup_sec  Samples taken before this time are only used for
+     *                    the first/min/max values, not for the verdict
+     *
+     * @return Returns an Analysis of the series
+     */
+    Analysis Analyse(const double warmup_sec) const
+    {
+        Analysis r;
+        r.samples = samples.size();
+        if (samples.empty())
+        {
+            return r;
+        }
+        r.first = samples.front().second;
+        r.last = samples.back().second;
+        r.min = r.max = r.first;
+        for (const auto& s : samples)
+        {
+            r.min = std::min(r.min, s.second);
+            r.max = std::max(r.max, s.second);
+        }
+
+        std::vector<std::pair<double, uint64_t>> steady;
+        for (const auto& s : samples)
+        {
+            if (s.first >= warmup_sec)
+            {
+                steady.push_back(s);
+            }
+        }
+        if (steady.size() < 2)
+        {
+            return r;
+        }
+
+        double mean_t = 0.0;
+        double mean_v = 0.0;
+        for (const auto& s : steady)
+        {
+            mean_t += s.first;
+            mean_v += s.second;
+        }
+        mean_t /= steady.size();
+        mean_v /= steady.size();
+        double cov = 0.0;
+        double var = 0.0;
+        for (const auto& s : steady)
+        {
+            cov += (s.first - mean_t) * (s.second - mean_v);
+            var += (s.first - mean_t) * (s.first - mean_t);
+        }
+        if (var > 0.0)
+        {
+            r.slope_per_hour = cov / var * 3600.0;
+        }
+
+        // Needs enough samples to have three non-empty thirds
+        size_t third = steady.size() / 3;
+        if (third < 2)
+        {
+            return r;
+        }
+        uint64_t early_max = 0;
+        for (size_t i = 0; i < third; ++i)
+        {
+            early_max = std::max(early_max, steady[i].second);
+        }
+        uint64_t late_min = UINT64_MAX;
+        for (size_t i = steady.size() - third; i < steady.size(); ++i)
+        {
+            late_min = std::min(late_min, steady[i].second);
+        }
+        uint64_t tolerance = std::max(abs_tolerance,
+                                      (uint64_t) (early_max * rel_tolerance));
+        r.growing = (late_min > early_max
+                     && (late_min - early_max) > tolerance);
+        return r;
+    }
+
+
+private:
+    double rel_tolerance;
+    uint64_t abs_tolerance;
+    std::vector<std::pair<double, uint64_t>> samples;
+};
+
+
+
+/**
+ *  Collection of named ResourceSeries, one per sampled counter of a
+ *  process
+ */
+class ResourceGrowthTracker
+{
+public:
+    /**
+     *  Set the tolerance used by the series of counters with a given
+     *  name prefix.  Series are created with the tolerance of the
+     *  longest matching prefix.
+     */
+    void SetTolerance(const std::string& prefix, const double rel,
+                      const uint64_t abs)
+    {
+        tolerances[prefix] = std::make_pair(rel, abs);
+    }
+
+
+    void Add(const std::string& name, const double t_sec,
+             const uint64_t value)
+    {
+        auto it = series.find(name);
+        if (series.end() == it)
+        {
+            auto tol = tolerance(name);
+            it = series.emplace(name, ResourceSeries(tol.first,
+                                                     tol.second)).first;
+        }
+        it->second.Add(t_sec, value);
+    }
+
+
+    /**
+     *  Discard the samples of all series, used when the sampled process
+     *  was restarted
+     */
+    void Clear()
+    {
+        for (auto& s : series)
+        {
+            s.second.Clear();
+        }
+    }
+
+
+    const std::map<std::string, ResourceSeries>& GetSeries() const
+    {
+        return series;
+    }
+
+
+private:
+    std::map<std::string, std::pair<double, uint64_t>> tolerances;
+    std::map<std::string, ResourceSeries> series;
+
+    std::pair<double, uint64_t> tolerance(const std::string& name) const
+    {
+        std::pair<double, uint64_t> ret(0.10, 0);
+        size_t best = 0;
+        for (const auto& t : tolerances)
+        {
+            if (t.first.size() >= best
+                && 0 == name.compare(0, t.first.size(), t.first))
+            {
+                best = t.first.size();
+                ret = t.second;
+            }
+        }
+        return ret;
+    }
+};
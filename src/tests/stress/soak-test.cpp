@@ -0,0 +1,727 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   soak-test.cpp
+ *
+ * @brief  Long running soak test of the OpenVPN 3 D-Bus service stack.
+ *         Runs concurrent configuration import, session start/reconnect/
+ *         disconnect and log service attach/detach cycles while sampling
+ *         the resource usage of every service.  Fails if a resource keeps
+ *         growing after the warm-up period and reports the samples
+ *         analysis as JSON.
+ *
+ *         Must be run as root or the OpenVPN 3 service user, as the
+ *         net.openvpn.v3.debug interface of the services is used for
+ *         the samples.  The D-Bus match rules of the services are only
+ *         sampled if the bus provides the org.freedesktop.DBus.Debug.Stats
+ *         interface.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include <json/json.h>
+
+#include "common/cmdargparser.hpp"
+#include "common/utils.hpp"
+#include "dbus/core.hpp"
+#include "configmgr/proxy-configmgr.hpp"
+#include "log/proxy-log.hpp"
+#include "sessionmgr/proxy-sessionmgr.hpp"
+#include "tests/stress/resource-growth.hpp"
+
+
+typedef std::chrono::steady_clock soak_clock;
+
+
+/**
+ *  Services sampled during the test
+ */
+struct SoakService
+{
+    const char *name;
+    const std::string& busname;
+    const std::string& root_path;
+};
+
+static const std::vector<SoakService> soak_services = {
+    {"backends", OpenVPN3DBus_name_backends, OpenVPN3DBus_rootp_backends},
+    {"configuration", OpenVPN3DBus_name_configuration, OpenVPN3DBus_rootp_configuration},
+    {"log", OpenVPN3DBus_name_log, OpenVPN3DBus_rootp_log},
+    {"netcfg", OpenVPN3DBus_name_netcfg, OpenVPN3DBus_rootp_netcfg},
+    {"sessions", OpenVPN3DBus_name_sessions, OpenVPN3DBus_rootp_sessions}
+};
+
+/// Process counters from GetResourceUsage which are tracked.  VmHWM only
+/// grows by definition and the malloc counters are covered by VmRSS.
+static const std::vector<std::string> tracked_process_values = {
+    "VmRSS", "Threads", "open_fds", "signal_subscriptions", "signal_handlers"
+};
+
+
+/**
+ *  Counters of the cycles run by the workers
+ */
+struct CycleStats
+{
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> errors{0};
+};
+
+
+/**
+ *  Opens a new, non-shared connection to the system bus, one per
+ *  worker thread
+ */
+static GDBusConnection * open_connection()
+{
+    GError *error = nullptr;
+    gchar *addr = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SYSTEM,
+                                                  nullptr, &error);
+    GDBusConnection *conn = nullptr;
+    if (addr)
+    {
+        conn = g_dbus_connection_new_for_address_sync(addr,
+                       (GDBusConnectionFlags)
+                       (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                        | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                       nullptr, nullptr, &error);
+        g_free(addr);
+    }
+    if (!conn)
+    {
+        std::string err = (error ? error->message : "Unknown error");
+        if (error)
+        {
+            g_error_free(error);
+        }
+        THROW_DBUSEXCEPTION("soak-test",
+                            "Could not connect to the system bus: " + err);
+    }
+    return conn;
+}
+
+
+/**
+ *  Waits until a session reports it is connected.  If wait_change is
+ *  set, it first waits for the session to leave the connected state,
+ *  which is used after a Restart() call.
+ */
+static void wait_connected(OpenVPN3SessionProxy::Ptr session,
+                           const unsigned int timeout_ms,
+                           const bool wait_change = false)
+{
+    auto deadline = soak_clock::now() + std::chrono::milliseconds(timeout_ms);
+    bool changed = !wait_change;
+    auto change_deadline = soak_clock::now() + std::chrono::seconds(2);
+    while (soak_clock::now() < deadline)
+    {
+        StatusEvent st = session->GetLastStatus();
+        bool connected = (StatusMajor::CONNECTION == st.major
+                          && StatusMinor::CONN_CONNECTED == st.minor);
+        if (!changed)
+        {
+            changed = (!connected || soak_clock::now() >= change_deadline);
+        }
+        else if (connected)
+        {
+            return;
+        }
+        if (StatusMajor::CONNECTION == st.major
+            && (StatusMinor::CONN_FAILED == st.minor
+                || StatusMinor::CONN_AUTH_FAILED == st.minor))
+        {
+            THROW_DBUSEXCEPTION("soak-test", "Connection failed");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    THROW_DBUSEXCEPTION("soak-test", "Timeout waiting for connection");
+}
+
+
+/**
+ *  Runs the test cycles of one worker until the stop flag is set
+ */
+class SoakWorker
+{
+public:
+    SoakWorker(const unsigned int id, const std::string& cfgname_prefix,
+               const std::string& config_blob, const bool do_connect,
+               std::map<std::string, CycleStats>& stats)
+        : id(id), cfgname_prefix(cfgname_prefix), config_blob(config_blob),
+          do_connect(do_connect), stats(stats)
+    {
+    }
+
+
+    void Run(const std::atomic<bool>& stop)
+    {
+        GDBusConnection *conn = open_connection();
+        DBus dbus(conn);
+
+        const std::vector<std::pair<std::string, std::function<void()>>> cycles = {
+            {"import", [&]() { cycle_import(dbus); }},
+            {"session", [&]() { cycle_session(dbus); }},
+            {"log_attach", [&]() { cycle_log_attach(conn); }}
+        };
+
+        for (uint64_t i = id; !stop; ++i)
+        {
+            const auto& c = cycles[i % cycles.size()];
+            CycleStats& st = stats.at(c.first);
+            try
+            {
+                c.second();
+                ++st.count;
+            }
+            catch (const std::exception& excp)
+            {
+                ++st.errors;
+                std::cerr << c.first << "[" << id << "]: " << excp.what()
+                          << std::endl;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+        }
+
+        g_dbus_connection_close_sync(conn, nullptr, nullptr);
+        g_object_unref(conn);
+    }
+
+
+private:
+    unsigned int id;
+    const std::string& cfgname_prefix;
+    const std::string& config_blob;
+    bool do_connect;
+    std::map<std::string, CycleStats>& stats;
+    uint64_t serial = 0;
+
+
+    std::string cfgname()
+    {
+        return cfgname_prefix + "_" + std::to_string(id)
+               + "_" + std::to_string(++serial);
+    }
+
+
+    void cycle_import(DBus& dbus)
+    {
+        OpenVPN3ConfigurationProxy cfgmgr(dbus, OpenVPN3DBus_rootp_configuration);
+        std::string path = cfgmgr.Import(cfgname(), config_blob, false, false);
+        OpenVPN3ConfigurationProxy cfg(dbus, path);
+        (void) cfg.GetStringProperty("name");
+        cfg.Remove();
+    }
+
+
+    void cycle_session(DBus& dbus)
+    {
+        OpenVPN3ConfigurationProxy cfgmgr(dbus, OpenVPN3DBus_rootp_configuration);
+        std::string path = cfgmgr.Import(cfgname(), config_blob, false, false);
+        OpenVPN3ConfigurationProxy cfg(dbus, path);
+
+        try
+        {
+            OpenVPN3SessionMgrProxy sessmgr(dbus);
+            OpenVPN3SessionProxy::Ptr session = sessmgr.NewTunnel(path);
+            try
+            {
+                if (do_connect)
+                {
+                    session->Ready();
+                    session->Connect();
+                    wait_connected(session, 30000);
+                    session->Restart();
+                    wait_connected(session, 30000, true);
+                }
+            }
+            catch (...)
+            {
+                disconnect(session);
+                throw;
+            }
+            session->Disconnect();
+        }
+        catch (...)
+        {
+            cfg.Remove();
+            throw;
+        }
+        cfg.Remove();
+    }
+
+
+    static void disconnect(OpenVPN3SessionProxy::Ptr session) noexcept
+    {
+        try
+        {
+            session->Disconnect();
+        }
+        catch (const std::exception&)
+        {
+            // The original error is reported
+        }
+    }
+
+
+    void cycle_log_attach(GDBusConnection *conn)
+    {
+        const std::string interf = "net.openvpn.v3.soak.w"
+                                   + std::to_string(id);
+        LogServiceProxy logsrv(conn);
+        logsrv.Attach(interf);
+        logsrv.Detach(interf);
+    }
+};
+
+
+
+/**
+ *  Samples the resource usage of all the services into one
+ *  ResourceGrowthTracker per service
+ */
+class ServiceSampler
+{
+public:
+    ServiceSampler(GDBusConnection *conn, const double rss_tolerance,
+                   const uint64_t count_tolerance)
+        : dbus(conn), rss_tolerance(rss_tolerance),
+          count_tolerance(count_tolerance)
+    {
+        for (const auto& srv : soak_services)
+        {
+            reset_tracker(srv.name);
+        }
+        reset_tracker("bus");
+    }
+
+
+    void Sample(const double t_sec)
+    {
+        ++samples;
+        for (const auto& srv : soak_services)
+        {
+            sample_service(srv, t_sec);
+        }
+        trackers["bus"].Add("backend_processes", t_sec,
+                            count_backend_processes());
+    }
+
+
+    /**
+     * @return Returns the JSON report of the samples and appends the
+     *         growing resources to the failures list
+     */
+    Json::Value GetJSON(const double warmup_sec, Json::Value& failures) const
+    {
+        Json::Value ret;
+        for (const auto& t : trackers)
+        {
+            Json::Value& srv = ret[t.first];
+            auto info = service_info.find(t.first);
+            if (service_info.end() != info)
+            {
+                srv["pid"] = info->second.pid;
+                srv["restarts"] = info->second.restarts;
+                srv["unavailable_samples"] = info->second.unavailable;
+            }
+            for (const auto& s : t.second.GetSeries())
+            {
+                auto a = s.second.Analyse(warmup_sec);
+                Json::Value& r = srv["resources"][s.first];
+                r["samples"] = (Json::Value::UInt64) a.samples;
+                r["first"] = (Json::Value::UInt64) a.first;
+                r["last"] = (Json::Value::UInt64) a.last;
+                r["min"] = (Json::Value::UInt64) a.min;
+                r["max"] = (Json::Value::UInt64) a.max;
+                r["slope_per_hour"] = a.slope_per_hour;
+                r["growing"] = a.growing;
+                if (a.growing)
+                {
+                    failures.append(t.first + "." + s.first);
+                }
+            }
+        }
+        return ret;
+    }
+
+
+    unsigned int GetSampleCount() const
+    {
+        return samples;
+    }
+
+
+private:
+    struct ServiceInfo
+    {
+        guint32 pid = 0;
+        unsigned int restarts = 0;
+        unsigned int unavailable = 0;
+    };
+
+    DBus dbus;
+    double rss_tolerance;
+    uint64_t count_tolerance;
+    unsigned int samples = 0;
+    std::map<std::string, ResourceGrowthTracker> trackers;
+    std::map<std::string, ServiceInfo> service_info;
+
+
+    void reset_tracker(const std::string& name)
+    {
+        ResourceGrowthTracker& t = trackers[name];
+        t = ResourceGrowthTracker();
+        // Object and signal counters vary with the cycles in progress
+        t.SetTolerance("", 0.0, count_tolerance);
+        t.SetTolerance("VmRSS", rss_tolerance, 0);
+    }
+
+
+    GVariant * bus_call(const std::string& method, GVariant *params,
+                        const char *interf = "org.freedesktop.DBus")
+    {
+        return g_dbus_connection_call_sync(dbus.GetConnection(),
+                                           "org.freedesktop.DBus",
+                                           "/org/freedesktop/DBus",
+                                           interf, method.c_str(), params,
+                                           nullptr, G_DBUS_CALL_FLAGS_NONE,
+                                           -1, nullptr, nullptr);
+    }
+
+
+    void sample_service(const SoakService& srv, const double t_sec)
+    {
+        ServiceInfo& info = service_info[srv.name];
+        ResourceGrowthTracker& tracker = trackers[srv.name];
+
+        // A changed PID means the service was restarted, most likely due
+        // to the idle exit; the earlier samples are then meaningless
+        GVariant *r = bus_call("GetConnectionUnixProcessID",
+                               g_variant_new("(s)", srv.busname.c_str()));
+        if (!r)
+        {
+            ++info.unavailable;
+            return;
+        }
+        guint32 pid = 0;
+        g_variant_get(r, "(u)", &pid);
+        g_variant_unref(r);
+        if (0 != info.pid && pid != info.pid)
+        {
+            ++info.restarts;
+            tracker.Clear();
+        }
+        info.pid = pid;
+
+        GVariant *res = nullptr;
+        try
+        {
+            DBusProxy prx(dbus, srv.busname, OpenVPN3DBus_interf_debug,
+                          srv.root_path);
+            res = prx.Call("GetResourceUsage");
+        }
+        catch (const DBusException&)
+        {
+            ++info.unavailable;
+            return;
+        }
+
+        GVariantIter *objects = nullptr;
+        GVariantIter *process = nullptr;
+        gchar *mallocinfo = nullptr;
+        g_variant_get(res, "(a(stt)a(st)s)", &objects, &process, &mallocinfo);
+
+        gchar *name = nullptr;
+        guint64 count = 0;
+        guint64 bytes = 0;
+        while (g_variant_iter_next(objects, "(stt)", &name, &count, &bytes))
+        {
+            tracker.Add(std::string("objects.") + name, t_sec, count);
+            g_free(name);
+        }
+        g_variant_iter_free(objects);
+
+        guint64 value = 0;
+        while (g_variant_iter_next(process, "(st)", &name, &value))
+        {
+            for (const auto& v : tracked_process_values)
+            {
+                if (v == name)
+                {
+                    tracker.Add(v, t_sec, value);
+                }
+            }
+            g_free(name);
+        }
+        g_variant_iter_free(process);
+        g_free(mallocinfo);
+        g_variant_unref(res);
+
+        r = bus_call("GetConnectionStats",
+                     g_variant_new("(s)", srv.busname.c_str()),
+                     "org.freedesktop.DBus.Debug.Stats");
+        if (r)
+        {
+            GVariant *stats = g_variant_get_child_value(r, 0);
+            guint32 match_rules = 0;
+            if (g_variant_lookup(stats, "MatchRules", "u", &match_rules))
+            {
+                tracker.Add("match_rules", t_sec, match_rules);
+            }
+            g_variant_unref(stats);
+            g_variant_unref(r);
+        }
+    }
+
+
+    /**
+     *  Count the VPN client processes on the bus, which should not
+     *  accumulate as every session cycle ends with a disconnect
+     */
+    uint64_t count_backend_processes()
+    {
+        GVariant *r = bus_call("ListNames", nullptr);
+        if (!r)
+        {
+            return 0;
+        }
+        GVariantIter *names = nullptr;
+        g_variant_get(r, "(as)", &names);
+        uint64_t ret = 0;
+        const gchar *n = nullptr;
+        while (g_variant_iter_next(names, "&s", &n))
+        {
+            if (0 == strncmp(n, OpenVPN3DBus_name_backends_be.c_str(),
+                             OpenVPN3DBus_name_backends_be.size()))
+            {
+                ++ret;
+            }
+        }
+        g_variant_iter_free(names);
+        g_variant_unref(r);
+        return ret;
+    }
+};
+
+
+
+int cmd_run(ParsedArgs::Ptr args)
+{
+    if (!args->Present("config"))
+    {
+        throw CommandException("run", "Missing --config");
+    }
+
+    const std::string config_file = args->GetValue("config", 0);
+    unsigned int duration_min = 240;
+    unsigned int warmup_min = 0;
+    unsigned int concurrency = 4;
+    unsigned int interval_sec = 30;
+    unsigned int rss_tolerance = 10;
+    if (args->Present("duration"))
+    {
+        duration_min = std::atoi(args->GetValue("duration", 0).c_str());
+    }
+    warmup_min = duration_min / 10;
+    if (args->Present("warmup"))
+    {
+        warmup_min = std::atoi(args->GetValue("warmup", 0).c_str());
+    }
+    if (args->Present("concurrency"))
+    {
+        concurrency = std::atoi(args->GetValue("concurrency", 0).c_str());
+    }
+    if (args->Present("sample-interval"))
+    {
+        interval_sec = std::atoi(args->GetValue("sample-interval", 0).c_str());
+    }
+    if (args->Present("rss-tolerance"))
+    {
+        rss_tolerance = std::atoi(args->GetValue("rss-tolerance", 0).c_str());
+    }
+    if (0 == concurrency || 0 == interval_sec || 0 == duration_min)
+    {
+        throw CommandException("run", "--concurrency, --duration and "
+                               "--sample-interval must be at least 1");
+    }
+    if (warmup_min >= duration_min)
+    {
+        throw CommandException("run", "--warmup must be shorter than "
+                               "--duration");
+    }
+    const bool do_connect = args->Present("connect");
+
+    std::ifstream cfgfs(config_file);
+    if (!cfgfs)
+    {
+        throw CommandException("run", "Could not read " + config_file);
+    }
+    const std::string config_blob((std::istreambuf_iterator<char>(cfgfs)),
+                                  std::istreambuf_iterator<char>());
+    const std::string cfgname_prefix = "soak-test_" + std::to_string(getpid());
+
+    std::map<std::string, CycleStats> cycle_stats;
+    cycle_stats["import"];
+    cycle_stats["session"];
+    cycle_stats["log_attach"];
+
+    GDBusConnection *sample_conn = open_connection();
+    // Each counter may vary by the number of cycles in progress
+    ServiceSampler sampler(sample_conn, rss_tolerance / 100.0,
+                           2 * concurrency + 2);
+
+    std::atomic<bool> stop{false};
+    std::vector<std::unique_ptr<SoakWorker>> workers;
+    std::vector<std::thread> threads;
+    for (unsigned int w = 0; w < concurrency; ++w)
+    {
+        workers.emplace_back(new SoakWorker(w, cfgname_prefix, config_blob,
+                                            do_connect, cycle_stats));
+        SoakWorker *wrk = workers.back().get();
+        threads.push_back(std::thread([wrk, &stop]()
+                                      {
+                                          wrk->Run(stop);
+                                      }));
+    }
+
+    auto start = soak_clock::now();
+    auto end = start + std::chrono::minutes(duration_min);
+    auto next = start;
+    while (soak_clock::now() < end)
+    {
+        double t_sec = std::chrono::duration<double>(soak_clock::now()
+                                                     - start).count();
+        sampler.Sample(t_sec);
+        std::cerr << "[" << (unsigned int) (t_sec / 60) << " min] sample "
+                  << sampler.GetSampleCount() << ": import="
+                  << cycle_stats.at("import").count << " session="
+                  << cycle_stats.at("session").count << " log_attach="
+                  << cycle_stats.at("log_attach").count << std::endl;
+
+        next += std::chrono::seconds(interval_sec);
+        std::this_thread::sleep_until(std::min(next, end));
+    }
+
+    stop = true;
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    // A last sample after all cycles have completed
+    sampler.Sample(std::chrono::duration<double>(soak_clock::now()
+                                                 - start).count());
+    g_dbus_connection_close_sync(sample_conn, nullptr, nullptr);
+    g_object_unref(sample_conn);
+
+    Json::Value report;
+    report["parameters"]["duration_min"] = duration_min;
+    report["parameters"]["warmup_min"] = warmup_min;
+    report["parameters"]["concurrency"] = concurrency;
+    report["parameters"]["sample_interval_sec"] = interval_sec;
+    report["parameters"]["rss_tolerance_pct"] = rss_tolerance;
+    report["parameters"]["connect"] = do_connect;
+    uint64_t errors = 0;
+    for (const auto& c : cycle_stats)
+    {
+        report["cycles"][c.first]["count"] = (Json::Value::UInt64) c.second.count;
+        report["cycles"][c.first]["errors"] = (Json::Value::UInt64) c.second.errors;
+        errors += c.second.errors;
+    }
+    report["samples"] = sampler.GetSampleCount();
+    Json::Value failures(Json::arrayValue);
+    report["services"] = sampler.GetJSON(warmup_min * 60.0, failures);
+    report["growing"] = failures;
+    report["passed"] = failures.empty();
+
+    if (args->Present("output"))
+    {
+        std::ofstream out(args->GetValue("output", 0));
+        out << report << std::endl;
+    }
+    else
+    {
+        std::cout << report << std::endl;
+    }
+
+    if (!failures.empty())
+    {
+        return 3;
+    }
+    return (0 == errors ? 0 : 2);
+}
+
+
+int main(int argc, char **argv)
+{
+    Commands cmds("OpenVPN 3 D-Bus service soak test",
+                  "Runs long lasting load on the OpenVPN 3 D-Bus services "
+                  "and reports resources growing over time");
+
+    SingleCommand::Ptr run;
+    run.reset(new SingleCommand("run", "Runs the soak test", cmd_run));
+    run->AddOption("config", 'c', "FILE", true,
+                   "OpenVPN configuration profile to use for the sessions");
+    run->AddOption("duration", 'd', "MINUTES", true,
+                   "How long to run the test (default: 240)");
+    run->AddOption("warmup", 'w', "MINUTES", true,
+                   "Samples ignored for the growth verdict "
+                   "(default: 10% of the duration)");
+    run->AddOption("concurrency", 'j', "COUNT", true,
+                   "Number of parallel D-Bus clients (default: 4)");
+    run->AddOption("sample-interval", 'i', "SECONDS", true,
+                   "Time between the resource samples (default: 30)");
+    run->AddOption("rss-tolerance", "PERCENT", true,
+                   "Ignore VmRSS growth below this percentage (default: 10)");
+    run->AddOption("connect",
+                   "Also connect and reconnect the sessions; requires a "
+                   "reachable server and a profile not requiring user input");
+    run->AddOption("output", 'o', "FILE", true,
+                   "Write the JSON report to a file instead of stdout");
+    cmds.RegisterCommand(run);
+
+    try
+    {
+        return cmds.ProcessCommandLine(argc, argv);
+    }
+    catch (CommandException& e)
+    {
+        if (e.gotErrorMessage())
+        {
+            std::cerr << e.getCommand() << ": ** ERROR ** " << e.what() << std::endl;
+        }
+        return 9;
+    }
+    catch (const DBusException& excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
+}
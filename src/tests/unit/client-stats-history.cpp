@@ -0,0 +1,110 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   client-stats-history.cpp
+ *
+ * @brief  Unit tests for StatsHistory
+ */
+
+#include <gtest/gtest.h>
+
+#include "client/stats-history.hpp"
+
+namespace unittest {
+
+static const std::vector<std::string> layout = {
+    "BYTES_IN", "BYTES_OUT", "PACKETS_IN", "PACKETS_OUT",
+    "NETWORK_RECV_ERROR", "N_RECONNECT", "TUN_WRITE_ERROR", "PQ_RTT_AVG"
+};
+
+
+static void add(StatsHistory& h, uint64_t t, uint64_t v)
+{
+    std::vector<uint64_t> values = {v, 2 * v, 3 * v, 4 * v, 1, 7, 2, 999};
+    h.Add(t, values.data(), values.size());
+}
+
+
+TEST(StatsHistory, picks_counters)
+{
+    StatsHistory h(10);
+    h.SetLayout(layout);
+    add(h, 100, 5);
+
+    StatsHistory::Series s = h.Get(0, 1);
+    ASSERT_EQ(s.timestamps, std::vector<uint64_t>({100}));
+    EXPECT_EQ(s.values, std::vector<uint64_t>({5, 10, 15, 20, 3, 7}));
+    EXPECT_EQ(StatsHistory::Keys().size(), size_t(StatsHistory::N_KEYS));
+}
+
+
+TEST(StatsHistory, ring_wraps)
+{
+    StatsHistory h(5);
+    h.SetLayout(layout);
+    for (uint64_t t = 1; t <= 8; ++t)
+    {
+        add(h, t, t);
+    }
+    EXPECT_EQ(h.size(), 5u);
+
+    StatsHistory::Series s = h.Get(0, 1);
+    EXPECT_EQ(s.timestamps, std::vector<uint64_t>({4, 5, 6, 7, 8}));
+    EXPECT_EQ(s.values[0], 4u);
+
+    s = h.Get(6, 1);
+    EXPECT_EQ(s.timestamps, std::vector<uint64_t>({7, 8}));
+
+    // A sample within the same second replaces the previous one
+    add(h, 8, 80);
+    s = h.Get(7, 1);
+    ASSERT_EQ(s.timestamps.size(), 1u);
+    EXPECT_EQ(s.values[0], 80u);
+}
+
+
+TEST(StatsHistory, downsamples)
+{
+    StatsHistory h(100);
+    h.SetLayout(layout);
+    for (uint64_t t = 100; t < 130; ++t)
+    {
+        add(h, t, t);
+    }
+
+    StatsHistory::Series s = h.Get(0, 10);
+    EXPECT_EQ(s.step, 10u);
+    EXPECT_EQ(s.timestamps, std::vector<uint64_t>({109, 119, 129}));
+    ASSERT_EQ(s.values.size(), 3 * StatsHistory::N_KEYS);
+    EXPECT_EQ(s.values[StatsHistory::N_KEYS], 119u);
+}
+
+
+TEST(StatsHistory, layout_change_clears)
+{
+    StatsHistory h(10);
+    h.SetLayout(layout);
+    add(h, 1, 1);
+    h.SetLayout(layout);
+    EXPECT_EQ(h.size(), 1u);
+    h.SetLayout({"BYTES_IN"});
+    EXPECT_EQ(h.size(), 0u);
+}
+
+} // namespace unittest
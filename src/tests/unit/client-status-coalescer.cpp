@@ -0,0 +1,111 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   client-status-coalescer.cpp
+ *
+ * @brief  Unit tests for StatusCoalescer
+ */
+
+#include <gtest/gtest.h>
+
+#include "client/status-coalescer.hpp"
+
+namespace unittest {
+
+using Status = StatusCoalescer::Status;
+using std::chrono::milliseconds;
+
+static const Status connecting{StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTING, ""};
+static const Status reconnecting{StatusMajor::CONNECTION, StatusMinor::CONN_RECONNECTING, ""};
+static const Status connected{StatusMajor::CONNECTION, StatusMinor::CONN_CONNECTED, ""};
+static const Status failed{StatusMajor::CONNECTION, StatusMinor::CONN_FAILED, "error"};
+
+
+TEST(StatusCoalescer, reconnect_storm)
+{
+    StatusCoalescer sc(milliseconds(100));
+    auto t = StatusCoalescer::Clock::now();
+
+    // The first transient state is sent right away
+    auto r = sc.Add(reconnecting, t);
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0], reconnecting);
+
+    // Later ones within the window are held back; only the last is kept
+    EXPECT_TRUE(sc.Add(connecting, t + milliseconds(10)).empty());
+    EXPECT_TRUE(sc.Add(reconnecting, t + milliseconds(20)).empty());
+    EXPECT_TRUE(sc.Add(connecting, t + milliseconds(30)).empty());
+    EXPECT_TRUE(sc.HasPending());
+    EXPECT_EQ(sc.GetFlushDelay(t + milliseconds(30)), milliseconds(71));
+    EXPECT_TRUE(sc.Flush(t + milliseconds(50)).empty());
+
+    r = sc.Flush(t + milliseconds(100));
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0], connecting);
+    EXPECT_FALSE(sc.HasPending());
+
+    // Important states are never held back and replace a held back one
+    EXPECT_TRUE(sc.Add(reconnecting, t + milliseconds(110)).empty());
+    r = sc.Add(connected, t + milliseconds(120));
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0], connected);
+    EXPECT_FALSE(sc.HasPending());
+    EXPECT_TRUE(sc.Flush(t + milliseconds(500)).empty());
+    EXPECT_EQ(sc.GetCoalesced(), 3u);
+
+    // A quiet period starts a new window
+    r = sc.Add(reconnecting, t + milliseconds(1000));
+    ASSERT_EQ(r.size(), 1u);
+    r = sc.Add(failed, t + milliseconds(1001));
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0], failed);
+}
+
+
+TEST(StatusCoalescer, unchanged_state)
+{
+    StatusCoalescer sc(milliseconds(100));
+    auto t = StatusCoalescer::Clock::now();
+
+    ASSERT_EQ(sc.Add(reconnecting, t).size(), 1u);
+    EXPECT_TRUE(sc.Add(connecting, t + milliseconds(10)).empty());
+    EXPECT_TRUE(sc.Add(reconnecting, t + milliseconds(20)).empty());
+
+    // Subscribers already know the session is reconnecting
+    EXPECT_TRUE(sc.Flush(t + milliseconds(100)).empty());
+    EXPECT_FALSE(sc.HasPending());
+    EXPECT_EQ(sc.GetCoalesced(), 2u);
+}
+
+
+TEST(StatusCoalescer, full_fidelity)
+{
+    StatusCoalescer sc(milliseconds(100));
+    sc.SetFullFidelity(true);
+    auto t = StatusCoalescer::Clock::now();
+
+    EXPECT_EQ(sc.Add(reconnecting, t).size(), 1u);
+    EXPECT_EQ(sc.Add(connecting, t + milliseconds(1)).size(), 1u);
+    EXPECT_EQ(sc.Add(reconnecting, t + milliseconds(2)).size(), 1u);
+    EXPECT_FALSE(sc.HasPending());
+    EXPECT_EQ(sc.GetCoalesced(), 0u);
+}
+
+} // namespace unittest
@@ -0,0 +1,64 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   config-overrides.cpp
+ *
+ * @brief  Unit tests for GetConfigOverride()
+ */
+
+#include <string>
+#include <gtest/gtest.h>
+
+#include "configmgr/overrides.hpp"
+
+namespace unittest {
+
+TEST(ConfigOverrides, lookup_all)
+{
+    for (const auto& vo : configProfileOverrides)
+    {
+        const ValidOverride& found = GetConfigOverride(vo.key);
+        ASSERT_TRUE(found.valid());
+        EXPECT_EQ(found.key, vo.key);
+        EXPECT_EQ(found.type, vo.type);
+    }
+}
+
+
+TEST(ConfigOverrides, ignore_case)
+{
+    EXPECT_FALSE(GetConfigOverride("IPv6").valid());
+    EXPECT_EQ(GetConfigOverride("IPv6", true).key, "ipv6");
+    EXPECT_EQ(GetConfigOverride("Persist-TUN", true).type,
+              OverrideType::boolean);
+}
+
+
+TEST(ConfigOverrides, unknown)
+{
+    EXPECT_FALSE(GetConfigOverride("non-existing-override").valid());
+    EXPECT_FALSE(GetConfigOverride("").valid());
+
+    // Only complete keys matches
+    EXPECT_FALSE(GetConfigOverride("ipv", true).valid());
+    EXPECT_FALSE(GetConfigOverride("ipv6-extra", true).valid());
+}
+
+} // namespace unittest
@@ -0,0 +1,89 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   configmgr-blobstore.cpp
+ *
+ * @brief  Unit test for ProfileBlobStore
+ */
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "configmgr/profile-blobstore.hpp"
+
+namespace unittest {
+
+TEST(ProfileBlobStore, shared_values)
+{
+    ProfileBlobStore store;
+    std::string ca("-----BEGIN CERTIFICATE-----\nMIIB...\n-----END CERTIFICATE-----\n");
+
+    ProfileBlobStore::Blob a = store.Intern(ca);
+    ProfileBlobStore::Blob b = store.Intern(std::string(ca));
+    ProfileBlobStore::Blob c = store.Intern("other value");
+
+    EXPECT_EQ(a.get(), b.get());
+    EXPECT_NE(a.get(), c.get());
+    EXPECT_EQ(*a, ca);
+    EXPECT_EQ(*c, "other value");
+    EXPECT_EQ(store.Size(), 2u);
+}
+
+
+TEST(ProfileBlobStore, release)
+{
+    ProfileBlobStore store;
+    {
+        ProfileBlobStore::Blob a = store.Intern("value");
+        EXPECT_EQ(store.Size(), 1u);
+    }
+    EXPECT_EQ(store.Size(), 0u);
+
+    // A released value is stored again on the next use
+    ProfileBlobStore::Blob a = store.Intern("value");
+    EXPECT_EQ(*a, "value");
+    EXPECT_EQ(store.Size(), 1u);
+}
+
+
+TEST(ProfileBlobStore, many_values)
+{
+    ProfileBlobStore store;
+    std::vector<ProfileBlobStore::Blob> kept;
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        ProfileBlobStore::Blob b = store.Intern("value-" + std::to_string(i));
+        if (0 == i % 2)
+        {
+            kept.push_back(b);
+        }
+    }
+    EXPECT_EQ(store.Size(), 500u);
+
+    for (unsigned int i = 0; i < 500; i++)
+    {
+        EXPECT_EQ(store.Intern("value-" + std::to_string(2 * i)).get(),
+                  kept[i].get());
+    }
+    EXPECT_EQ(store.Size(), 500u);
+}
+
+} // namespace unittest
@@ -0,0 +1,129 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   cpu-usage.cpp
+ *
+ * @brief  Unit test for the CPU time and scheduling counters
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common/cpu-usage.hpp"
+
+namespace unittest {
+
+TEST(CpuUsage, parse_runqueue_wait)
+{
+    EXPECT_EQ(CpuUsage::ParseRunqueueWait("81234567 2500999 42"), 2500u);
+    EXPECT_EQ(CpuUsage::ParseRunqueueWait("81234567 0 42"), 0u);
+    EXPECT_EQ(CpuUsage::ParseRunqueueWait(""), 0u);
+    EXPECT_EQ(CpuUsage::ParseRunqueueWait("garbage"), 0u);
+}
+
+
+TEST(CpuUsage, parse_task_stat)
+{
+    CpuUsage u;
+    EXPECT_TRUE(CpuUsage::ParseTaskStat("4242 (core (x) 1) S 1 4242 4242 0 -1 "
+                                        "4194368 1204 0 0 0 250 75 0 0 20 0",
+                                        100, u));
+    EXPECT_EQ(u.user_usec, 2500000u);
+    EXPECT_EQ(u.system_usec, 750000u);
+
+    CpuUsage v;
+    EXPECT_FALSE(CpuUsage::ParseTaskStat("4242 (core) S 1 4242", 100, v));
+    EXPECT_FALSE(CpuUsage::ParseTaskStat("garbage", 100, v));
+    EXPECT_EQ(v.user_usec, 0u);
+}
+
+
+TEST(CpuUsage, parse_task_status)
+{
+    CpuUsage u;
+    CpuUsage::ParseTaskStatus("Name:\tcore\n"
+                              "State:\tS (sleeping)\n"
+                              "voluntary_ctxt_switches:\t1234\n"
+                              "nonvoluntary_ctxt_switches:\t56\n", u);
+    EXPECT_EQ(u.voluntary_ctxsw, 1234u);
+    EXPECT_EQ(u.involuntary_ctxsw, 56u);
+}
+
+
+TEST(CpuUsage, usec_per_gb)
+{
+    CpuUsage u;
+    u.user_usec = 300000;
+    u.system_usec = 200000;
+    EXPECT_EQ(u.UsecPerGB(0), 0u);
+    EXPECT_EQ(u.UsecPerGB(1024ULL * 1024 * 1024), 500000u);
+    EXPECT_EQ(u.UsecPerGB(4ULL * 1024 * 1024 * 1024), 125000u);
+    EXPECT_EQ(u.UsecPerGB(512ULL * 1024 * 1024), 1000000u);
+}
+
+
+TEST(CpuUsage, stats_layout)
+{
+    auto keys = CpuUsage::GetStatsKeys("DCO_WORKER_");
+    CpuUsage u;
+    ASSERT_EQ(keys.size(), u.GetStatsValues().size());
+    EXPECT_EQ(keys[0], "DCO_WORKER_CPU_USER_USEC");
+    EXPECT_EQ(CpuUsage::GetStatsKeys()[4], "CPU_RUNQ_WAIT_USEC");
+}
+
+
+TEST(CpuUsage, sample)
+{
+    volatile uint64_t x = 0;
+    for (uint64_t i = 0; i < 50000000; ++i)
+    {
+        x = x + i;
+    }
+
+    CpuUsage proc = CpuUsage::Process();
+    CpuUsage thr = CpuUsage::Thread();
+    EXPECT_GT(thr.user_usec + thr.system_usec, 0u);
+    EXPECT_GE(proc.user_usec + proc.system_usec,
+              thr.user_usec + thr.system_usec);
+}
+
+
+TEST(CpuUsage, sample_task)
+{
+    pid_t tid = 0;
+    std::thread t([&tid]()
+                  {
+                      tid = (pid_t) syscall(SYS_gettid);
+                      volatile uint64_t x = 0;
+                      for (uint64_t i = 0; i < 50000000; ++i)
+                      {
+                          x = x + i;
+                      }
+                  });
+    t.join();
+    EXPECT_EQ(CpuUsage::Task(tid).user_usec, 0u);
+
+    CpuUsage self = CpuUsage::Task((pid_t) syscall(SYS_gettid));
+    EXPECT_GT(self.user_usec + self.system_usec, 0u);
+}
+
+} // namespace unittest
@@ -0,0 +1,70 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dbus-path.cpp
+ *
+ * @brief  Unit tests for the ObjectPathAllocator
+ */
+
+#include <set>
+#include <string>
+#include <gtest/gtest.h>
+#include <glib.h>
+
+#include "dbus/path.hpp"
+
+namespace unittest {
+
+TEST(ObjectPathAllocator, format)
+{
+    ObjectPathAllocator alloc("/net/openvpn/v3/test", 's');
+    auto p = alloc.Allocate();
+
+    const std::string prefix = "/net/openvpn/v3/test/";
+    ASSERT_EQ(p.id, 1u);
+    ASSERT_EQ(p.path.size(), prefix.size() + 33);
+    ASSERT_EQ(p.path.substr(0, prefix.size()), prefix);
+    ASSERT_EQ(p.path[prefix.size() + 16], 's');
+    ASSERT_EQ(p.path.substr(prefix.size() + 17), "0000000000000001");
+    ASSERT_TRUE(g_variant_is_object_path(p.path.c_str()));
+}
+
+
+TEST(ObjectPathAllocator, unique)
+{
+    ObjectPathAllocator alloc("/net/openvpn/v3/test", 'x');
+    std::set<std::string> paths;
+    for (unsigned int i = 1; i <= 1000; ++i)
+    {
+        auto p = alloc.Allocate();
+        ASSERT_EQ(p.id, i);
+        ASSERT_TRUE(paths.insert(p.path).second);
+    }
+}
+
+
+TEST(ObjectPathAllocator, instances_differ)
+{
+    ObjectPathAllocator a("/net/openvpn/v3/test", 'x');
+    ObjectPathAllocator b("/net/openvpn/v3/test", 'x');
+    ASSERT_NE(a.Allocate().path, b.Allocate().path);
+}
+
+} // namespace unittest
@@ -0,0 +1,92 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dbus-request-throttle.cpp
+ *
+ * @brief  Unit test for DBusRequestThrottle
+ */
+
+#include <chrono>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "dbus/request-throttle.hpp"
+
+namespace unittest {
+
+using Result = DBusRequestThrottle::Result;
+
+
+TEST(DBusRequestThrottle, rate_limit)
+{
+    DBusRequestThrottle throttle(10, 20, 0);
+    auto now = DBusRequestThrottle::Clock::now();
+    int lookups = 0;
+    auto unprivileged = [&lookups]() { ++lookups; return false; };
+
+    for (int i = 0; i < 20; ++i)
+    {
+        EXPECT_EQ(throttle.Admit(":1.10", unprivileged, now), Result::ALLOWED);
+    }
+    EXPECT_EQ(lookups, 0);
+    EXPECT_EQ(throttle.Admit(":1.10", unprivileged, now), Result::RATE_LIMITED);
+    EXPECT_EQ(throttle.Admit(":1.10", unprivileged, now), Result::RATE_LIMITED);
+    EXPECT_EQ(lookups, 1);
+
+    // Other senders have their own bucket
+    EXPECT_EQ(throttle.Admit(":1.11", unprivileged, now), Result::ALLOWED);
+
+    // 10 calls per second refills one token per 100ms
+    now += std::chrono::milliseconds(100);
+    EXPECT_EQ(throttle.Admit(":1.10", unprivileged, now), Result::ALLOWED);
+    EXPECT_EQ(throttle.Admit(":1.10", unprivileged, now), Result::RATE_LIMITED);
+
+    // A privileged sender is never limited
+    for (int i = 0; i < 50; ++i)
+    {
+        EXPECT_EQ(throttle.Admit(":1.1", []() { return true; }, now),
+                  Result::ALLOWED);
+    }
+
+    // Rate 0 disables the limits
+    throttle.Configure(0, 0, 0);
+    EXPECT_EQ(throttle.Admit(":1.10", unprivileged, now), Result::ALLOWED);
+}
+
+
+TEST(DBusRequestThrottle, pending_limit)
+{
+    DBusRequestThrottle throttle(1000, 1000, 2);
+    auto now = DBusRequestThrottle::Clock::now();
+    auto unprivileged = []() { return false; };
+
+    EXPECT_EQ(throttle.Admit(":1.20", unprivileged, now), Result::ALLOWED);
+    EXPECT_EQ(throttle.Admit(":1.20", unprivileged, now), Result::ALLOWED);
+    EXPECT_EQ(throttle.Admit(":1.20", unprivileged, now), Result::TOO_MANY_PENDING);
+
+    throttle.Done(":1.20");
+    EXPECT_EQ(throttle.Admit(":1.20", unprivileged, now), Result::ALLOWED);
+
+    // Unknown senders are ignored
+    throttle.Done(":1.99");
+    EXPECT_EQ(throttle.size(), 1u);
+}
+
+} // namespace unittest
@@ -0,0 +1,114 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dbus-resource-usage.cpp
+ *
+ * @brief  Unit test for DBusResourceUsage
+ */
+
+#include <map>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "dbus/resource-usage.hpp"
+
+namespace unittest {
+
+TEST(DBusResourceUsage, report_sums_entries)
+{
+    DBusResourceUsage::Report report;
+    report.Add("sessions", 1, 100);
+    report.Add("devices", 2);
+    report.Add("sessions", 1, 50);
+
+    const auto& entries = report.Entries();
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].name, "sessions");
+    EXPECT_EQ(entries[0].count, 2u);
+    EXPECT_EQ(entries[0].bytes, 150u);
+    EXPECT_EQ(entries[1].name, "devices");
+    EXPECT_EQ(entries[1].count, 2u);
+    EXPECT_EQ(entries[1].bytes, 0u);
+}
+
+
+TEST(DBusResourceUsage, reporters)
+{
+    DBusResourceUsage& usage = DBusResourceUsage::Instance();
+    auto first = usage.AddReporter([](DBusResourceUsage::Report& r)
+                                   {
+                                       r.Add("unittest_objects", 3, 30);
+                                   });
+    auto second = usage.AddReporter([](DBusResourceUsage::Report& r)
+                                    {
+                                        r.Add("unittest_objects", 1, 10);
+                                    });
+    EXPECT_NE(first, second);
+
+    auto find = [](const DBusResourceUsage::Report& r)
+                {
+                    for (const auto& e : r.Entries())
+                    {
+                        if ("unittest_objects" == e.name)
+                        {
+                            return e;
+                        }
+                    }
+                    return DBusResourceUsage::Entry{"", 0, 0};
+                };
+
+    DBusResourceUsage::Report report = usage.Collect();
+    EXPECT_EQ(find(report).count, 4u);
+    EXPECT_EQ(find(report).bytes, 40u);
+
+    usage.RemoveReporter(first);
+    report = usage.Collect();
+    EXPECT_EQ(find(report).count, 1u);
+
+    usage.RemoveReporter(second);
+    report = usage.Collect();
+    EXPECT_EQ(find(report).name, "");
+}
+
+
+TEST(DBusResourceUsage, process_stats)
+{
+    std::map<std::string, uint64_t> stats;
+    for (const auto& s : DBusResourceUsage::Instance().GetProcessStats())
+    {
+        stats[s.first] = s.second;
+    }
+    EXPECT_GT(stats["VmRSS"], 0u);
+    EXPECT_GE(stats["Threads"], 1u);
+    EXPECT_GE(stats["open_fds"], 3u);
+    EXPECT_EQ(stats.count("signal_subscriptions"), 1u);
+}
+
+
+TEST(DBusResourceUsage, string_bytes)
+{
+    std::string small("x");
+    std::string large(1000, 'x');
+    EXPECT_GE(DBusResourceUsage::StringBytes(small), sizeof(std::string));
+    EXPECT_GE(DBusResourceUsage::StringBytes(large),
+              sizeof(std::string) + 1000);
+}
+
+} // namespace unittest
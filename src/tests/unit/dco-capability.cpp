@@ -0,0 +1,95 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dco-capability.cpp
+ *
+ * @brief  Unit tests for the DCOCapability cache
+ */
+
+#include <gtest/gtest.h>
+
+#include "netcfg/dco-capability.hpp"
+
+namespace unittest {
+
+TEST(DCOCapability, probe_cached)
+{
+    unsigned int probes = 0;
+    DCOCapability dcocap([&probes]()
+                         {
+                             ++probes;
+                             return true;
+                         });
+    EXPECT_TRUE(dcocap.Available());
+    EXPECT_TRUE(dcocap.Available());
+    EXPECT_TRUE(dcocap.Available());
+    EXPECT_EQ(probes, 1);
+}
+
+
+TEST(DCOCapability, probe_expired)
+{
+    unsigned int probes = 0;
+    DCOCapability dcocap([&probes]()
+                         {
+                             ++probes;
+                             return false;
+                         },
+                         std::chrono::seconds(0));
+    EXPECT_FALSE(dcocap.Available());
+    EXPECT_FALSE(dcocap.Available());
+    EXPECT_EQ(probes, 2);
+}
+
+
+TEST(DCOCapability, failure_backoff)
+{
+    DCOCapability dcocap([]() { return true; });
+    ASSERT_TRUE(dcocap.Available());
+    EXPECT_EQ(dcocap.GetFailureCount(), 0);
+    EXPECT_EQ(dcocap.GetLastFailure(), "");
+
+    dcocap.RecordFailure("Could not create ovpn-dco device");
+    EXPECT_FALSE(dcocap.Available());
+    EXPECT_EQ(dcocap.GetFailureCount(), 1);
+    EXPECT_EQ(dcocap.GetLastFailure(), "Could not create ovpn-dco device");
+
+    dcocap.RecordFailure("Another failure");
+    EXPECT_EQ(dcocap.GetFailureCount(), 2);
+    EXPECT_EQ(dcocap.GetLastFailure(), "Another failure");
+
+    dcocap.RecordSuccess();
+    EXPECT_TRUE(dcocap.Available());
+    EXPECT_EQ(dcocap.GetFailureCount(), 0);
+    EXPECT_EQ(dcocap.GetLastFailure(), "");
+}
+
+
+TEST(DCOCapability, backoff_expired)
+{
+    DCOCapability dcocap([]() { return true; },
+                         std::chrono::seconds(60),
+                         std::chrono::seconds(0));
+    dcocap.RecordFailure("failed");
+    EXPECT_TRUE(dcocap.Available());
+    EXPECT_EQ(dcocap.GetLastFailure(), "failed");
+}
+
+} // namespace unittest
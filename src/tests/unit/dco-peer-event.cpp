@@ -0,0 +1,73 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dco-peer-event.cpp
+ *
+ * @brief  Unit tests for decoding ovpn-dco peer notifications
+ */
+
+#include <gtest/gtest.h>
+
+#include "netcfg/dco-peer-event.hpp"
+
+namespace unittest {
+
+TEST(DcoPeerEvent, parse)
+{
+    uint8_t buf[6] = {NetCfg::DcoPeerEvent::cmd_del_peer};
+    uint32_t peer_id = 7;
+    std::memcpy(buf + 1, &peer_id, sizeof(peer_id));
+    buf[5] = 2;
+
+    NetCfg::DcoPeerEvent ev;
+    ASSERT_TRUE(NetCfg::DcoPeerEvent::Parse(buf, sizeof(buf), ev));
+    EXPECT_EQ(ev.peer_id, 7u);
+    EXPECT_TRUE(ev.Unsolicited());
+    EXPECT_EQ(ev.ReasonString(), "expired");
+
+    buf[5] = 1;
+    ASSERT_TRUE(NetCfg::DcoPeerEvent::Parse(buf, sizeof(buf), ev));
+    EXPECT_FALSE(ev.Unsolicited());
+    EXPECT_EQ(ev.ReasonString(), "userspace");
+
+    buf[5] = 42;
+    ASSERT_TRUE(NetCfg::DcoPeerEvent::Parse(buf, sizeof(buf), ev));
+    EXPECT_FALSE(ev.Unsolicited());
+    EXPECT_EQ(ev.ReasonString(), "unknown");
+}
+
+
+TEST(DcoPeerEvent, not_an_event)
+{
+    NetCfg::DcoPeerEvent ev;
+    ev.peer_id = 99;
+
+    // Truncated notification
+    uint8_t shortbuf[3] = {NetCfg::DcoPeerEvent::cmd_del_peer, 1, 0};
+    EXPECT_FALSE(NetCfg::DcoPeerEvent::Parse(shortbuf, sizeof(shortbuf), ev));
+
+    // A tunnelled packet (OVPN_CMD_PACKET)
+    uint8_t pkt[16] = {8};
+    EXPECT_FALSE(NetCfg::DcoPeerEvent::Parse(pkt, sizeof(pkt), ev));
+    EXPECT_FALSE(NetCfg::DcoPeerEvent::Parse(nullptr, 0, ev));
+    EXPECT_EQ(ev.peer_id, 99u);
+}
+
+} // namespace unittest
@@ -0,0 +1,119 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   dns-commit-queue.cpp
+ *
+ * @brief  Unit test for NetCfg::DNS::CommitQueue
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/dns/commit-queue.hpp"
+
+using namespace NetCfg::DNS;
+
+namespace unittest {
+
+TEST(DNSCommitQueue, request_and_wait)
+{
+    std::atomic<unsigned int> runs{0};
+    CommitQueue q([&runs]() { runs++; }, std::chrono::milliseconds(0));
+
+    q.RequestAndWait();
+    EXPECT_EQ(runs.load(), 1);
+    q.RequestAndWait();
+    EXPECT_EQ(runs.load(), 2);
+}
+
+
+TEST(DNSCommitQueue, coalesced)
+{
+    std::atomic<unsigned int> runs{0};
+    std::atomic<unsigned int> done{0};
+    {
+        CommitQueue q([&runs]() { runs++; }, std::chrono::milliseconds(200));
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i)
+        {
+            threads.emplace_back([&q, &done]()
+                                 {
+                                     q.RequestAndWait();
+                                     done++;
+                                 });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        EXPECT_EQ(done.load(), 8);
+
+        // All requests arrived within the commit delay; a slow thread
+        // start may cause one extra commit
+        EXPECT_GE(runs.load(), 1);
+        EXPECT_LE(runs.load(), 2);
+        EXPECT_EQ(q.GetCommitCount(), runs.load());
+    }
+}
+
+
+TEST(DNSCommitQueue, callbacks_after_commit)
+{
+    std::atomic<bool> committed{false};
+    std::atomic<bool> seen{false};
+    {
+        CommitQueue q([&committed]() { committed = true; },
+                      std::chrono::milliseconds(0));
+        q.Request([&committed, &seen]()
+                  {
+                      seen = committed.load();
+                  });
+        q.Request(nullptr);
+        // The destructor runs the pending commit before stopping
+    }
+    EXPECT_TRUE(committed.load());
+    EXPECT_TRUE(seen.load());
+}
+
+
+TEST(DNSCommitQueue, commit_exception)
+{
+    std::atomic<unsigned int> runs{0};
+    CommitQueue q([&runs]()
+                  {
+                      runs++;
+                      throw std::runtime_error("backend failed");
+                  },
+                  std::chrono::milliseconds(0));
+
+    testing::internal::CaptureStderr();
+    q.RequestAndWait();
+    q.RequestAndWait();
+    std::string err = testing::internal::GetCapturedStderr();
+    EXPECT_EQ(runs.load(), 2);
+    EXPECT_NE(err.find("backend failed"), std::string::npos);
+}
+
+} // namespace unittest
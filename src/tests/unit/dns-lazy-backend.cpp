@@ -0,0 +1,130 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   dns-lazy-backend.cpp
+ *
+ * @brief  Unit test for NetCfg::DNS::LazyResolverBackend
+ */
+
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/dns/lazy-resolver-backend.hpp"
+
+using namespace NetCfg::DNS;
+
+namespace unittest {
+
+class CountingBackend : public ResolverBackendInterface
+{
+public:
+    typedef RCPtr<CountingBackend> Ptr;
+
+    CountingBackend(const ApplySettingsMode mode)
+        : mode(mode)
+    {
+    }
+
+    const std::string GetBackendInfo() const noexcept override
+    {
+        return "CountingBackend";
+    }
+
+    const ApplySettingsMode GetApplyMode() const noexcept override
+    {
+        return mode;
+    }
+
+    void Apply(const ResolverSettings::Ptr settings) override
+    {
+        applied++;
+    }
+
+    void Commit(NetCfgSignals *not_used) override
+    {
+        commits++;
+    }
+
+    unsigned int applied = 0;
+    unsigned int commits = 0;
+
+private:
+    const ApplySettingsMode mode;
+};
+
+
+TEST(LazyResolverBackend, created_on_first_use)
+{
+    unsigned int created = 0;
+    CountingBackend::Ptr real = new CountingBackend(ApplySettingsMode::MODE_POST);
+    LazyResolverBackend::Ptr lazy = new LazyResolverBackend(
+        "lazy", ApplySettingsMode::MODE_POST,
+        [&created, real]() -> ResolverBackendInterface::Ptr
+        {
+            created++;
+            return real;
+        });
+
+    // Neither of these may create the backend
+    EXPECT_EQ(lazy->GetBackendInfo(), "lazy");
+    lazy->Commit(nullptr);
+    EXPECT_EQ(created, 0u);
+    EXPECT_EQ(real->commits, 0u);
+
+    lazy->Apply(new ResolverSettings(0));
+    lazy->Commit(nullptr);
+    lazy->Apply(new ResolverSettings(1));
+    EXPECT_EQ(created, 1u);
+    EXPECT_EQ(real->applied, 2u);
+    EXPECT_EQ(real->commits, 1u);
+    EXPECT_EQ(lazy->GetBackendInfo(), "CountingBackend");
+}
+
+
+TEST(LazyResolverBackend, fallback)
+{
+    CountingBackend::Ptr fallback = new CountingBackend(ApplySettingsMode::MODE_PRE);
+    LazyResolverBackend::Ptr lazy = new LazyResolverBackend(
+        "lazy", ApplySettingsMode::MODE_POST,
+        []() -> ResolverBackendInterface::Ptr
+        {
+            throw std::runtime_error("backend not available");
+        },
+        fallback);
+
+    EXPECT_EQ(lazy->GetApplyMode(), ApplySettingsMode::MODE_PRE);
+    lazy->Apply(new ResolverSettings(0));
+    lazy->Commit(nullptr);
+    EXPECT_EQ(fallback->applied, 1u);
+    EXPECT_EQ(fallback->commits, 1u);
+
+    LazyResolverBackend::Ptr none = new LazyResolverBackend(
+        "lazy", ApplySettingsMode::MODE_POST,
+        []() -> ResolverBackendInterface::Ptr
+        {
+            throw std::runtime_error("backend not available");
+        });
+    EXPECT_EQ(none->GetApplyMode(), ApplySettingsMode::MODE_POST);
+    EXPECT_NO_THROW(none->Apply(new ResolverSettings(0)));
+    EXPECT_EQ(none->GetBackendInfo(), "lazy (unavailable)");
+}
+
+} // namespace unittest
@@ -0,0 +1,181 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dns-resolvconf-file.cpp
+ *
+ * @brief  Unit test for the file handling in NetCfg::DNS::FileGenerator
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/dns/resolvconf-file.hpp"
+
+using namespace NetCfg::DNS;
+
+namespace unittest {
+
+class TestFileGenerator : public FileGenerator
+{
+public:
+    TestFileGenerator(const std::string& fname, const std::string& bakname)
+        : FileGenerator(fname, bakname)
+    {
+    }
+
+    bool WriteLines(const std::vector<std::string>& lines)
+    {
+        file_contents = lines;
+        return Write();
+    }
+
+    std::vector<std::string> ReadLines()
+    {
+        Read();
+        return file_contents;
+    }
+
+    void Restore()
+    {
+        RestoreBackup();
+    }
+
+    unsigned int headers = 0;
+
+protected:
+    std::vector<std::string> generate_header() override
+    {
+        return {"# header " + std::to_string(++headers)};
+    }
+};
+
+
+static std::string read_file(const std::string& fname)
+{
+    std::ifstream f(fname);
+    return std::string(std::istreambuf_iterator<char>(f),
+                       std::istreambuf_iterator<char>());
+}
+
+
+static void write_file(const std::string& fname, const std::string& content)
+{
+    std::ofstream f(fname);
+    f << content;
+}
+
+
+class DNSFileGenerator : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/ovpn3-fg-test.XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir = tmpl;
+        fname = dir + "/resolv.conf";
+        bakname = dir + "/resolv.conf.bak";
+        write_file(fname, "nameserver 192.0.2.1\n");
+    }
+
+    void TearDown() override
+    {
+        std::remove(fname.c_str());
+        std::remove(bakname.c_str());
+        rmdir(dir.c_str());
+    }
+
+    std::string dir;
+    std::string fname;
+    std::string bakname;
+};
+
+
+TEST_F(DNSFileGenerator, skip_unchanged)
+{
+    TestFileGenerator gen(fname, bakname);
+
+    EXPECT_TRUE(gen.WriteLines({"nameserver 192.0.2.10"}));
+    EXPECT_EQ(read_file(fname), "# header 1\nnameserver 192.0.2.10\n");
+
+    // Only the header would differ
+    EXPECT_FALSE(gen.WriteLines({"nameserver 192.0.2.10"}));
+    EXPECT_EQ(read_file(fname), "# header 1\nnameserver 192.0.2.10\n");
+
+    EXPECT_TRUE(gen.WriteLines({"nameserver 192.0.2.11"}));
+    EXPECT_EQ(read_file(fname), "# header 2\nnameserver 192.0.2.11\n");
+}
+
+
+TEST_F(DNSFileGenerator, external_change)
+{
+    TestFileGenerator gen(fname, bakname);
+    EXPECT_TRUE(gen.WriteLines({"nameserver 192.0.2.10"}));
+
+    // The file is not read again while untouched since the write
+    std::vector<std::string> lines = gen.ReadLines();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0], "nameserver 192.0.2.10");
+
+    // Replaced by someone else; same contents must be written again
+    std::string other = fname + ".other";
+    write_file(other, "nameserver 198.51.100.1\n");
+    ASSERT_EQ(std::rename(other.c_str(), fname.c_str()), 0);
+
+    lines = gen.ReadLines();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0], "nameserver 198.51.100.1");
+    EXPECT_TRUE(gen.WriteLines({"nameserver 192.0.2.10"}));
+}
+
+
+TEST_F(DNSFileGenerator, backup_restore)
+{
+    TestFileGenerator gen(fname, bakname);
+    EXPECT_TRUE(gen.WriteLines({"nameserver 192.0.2.10"}));
+    EXPECT_TRUE(gen.WriteLines({"nameserver 192.0.2.11"}));
+
+    // The backup is the file from before the first write
+    EXPECT_EQ(read_file(bakname), "nameserver 192.0.2.1\n");
+
+    gen.Restore();
+    EXPECT_EQ(read_file(fname), "nameserver 192.0.2.1\n");
+    EXPECT_NE(access(bakname.c_str(), F_OK), 0);
+
+    // No temporary files are left behind
+    unsigned int entries = 0;
+    DIR *d = opendir(dir.c_str());
+    ASSERT_NE(d, nullptr);
+    while (struct dirent *e = readdir(d))
+    {
+        std::string n(e->d_name);
+        entries += ("." != n && ".." != n ? 1 : 0);
+    }
+    closedir(d);
+    EXPECT_EQ(entries, 1u);
+}
+
+} // namespace unittest
@@ -0,0 +1,334 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   dns-stub-resolver.cpp
+ *
+ * @brief  Unit test for NetCfg::DNS::StubResolver
+ */
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/dns/stub-resolver.hpp"
+
+using namespace NetCfg::DNS;
+
+namespace unittest {
+
+static std::vector<uint8_t> make_query(uint16_t id, const std::string& name,
+                                       uint16_t qtype = 1)
+{
+    std::vector<uint8_t> q = {(uint8_t) (id >> 8), (uint8_t) id, 0x01, 0x00,
+                              0, 1, 0, 0, 0, 0, 0, 0};
+    size_t start = 0;
+    while (start < name.size())
+    {
+        size_t dot = name.find('.', start);
+        std::string label = name.substr(start, dot - start);
+        q.push_back(label.size());
+        q.insert(q.end(), label.begin(), label.end());
+        start = (std::string::npos == dot ? name.size() : dot + 1);
+    }
+    q.push_back(0);
+    q.insert(q.end(), {(uint8_t) (qtype >> 8), (uint8_t) qtype, 0, 1});
+    return q;
+}
+
+
+/**
+ *  Makes a response with a single A record for the question, using a
+ *  compressed name, and an EDNS OPT record
+ */
+static std::vector<uint8_t> make_response(const std::vector<uint8_t>& query,
+                                          uint32_t ttl, const uint8_t addr[4])
+{
+    std::vector<uint8_t> r(query);
+    r[2] = 0x81;
+    r[3] = 0x80;
+    r[7] = 1;    // ANCOUNT
+    r[11] = 1;   // ARCOUNT
+    r.insert(r.end(), {0xc0, 12, 0, 1, 0, 1,
+                       (uint8_t) (ttl >> 24), (uint8_t) (ttl >> 16),
+                       (uint8_t) (ttl >> 8), (uint8_t) ttl,
+                       0, 4, addr[0], addr[1], addr[2], addr[3]});
+    r.insert(r.end(), {0, 0, 41, 0x10, 0, 0, 0, 0x80, 0, 0, 0});
+    return r;
+}
+
+
+/**
+ *  Minimal name server answering all A queries with the same address
+ */
+class FakeServer
+{
+public:
+    FakeServer(const char *address, uint16_t port, const uint8_t answer[4])
+    {
+        memcpy(addr, answer, 4);
+        sd = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in sa = {};
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        inet_pton(AF_INET, address, &sa.sin_addr);
+        bound = (0 == bind(sd, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)));
+        socklen_t len = sizeof(sa);
+        getsockname(sd, reinterpret_cast<struct sockaddr *>(&sa), &len);
+        this->port = ntohs(sa.sin_port);
+        thr = std::thread([this]()
+                          {
+                              serve();
+                          });
+    }
+
+    ~FakeServer()
+    {
+        running = false;
+        thr.join();
+        close(sd);
+    }
+
+    bool bound = false;
+    uint16_t port = 0;
+    std::atomic<int> queries{0};
+
+    /// Distinct source ports the queries were received from
+    size_t SourcePorts()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        return ports.size();
+    }
+
+private:
+    int sd = -1;
+    uint8_t addr[4];
+    std::atomic<bool> running{true};
+    std::thread thr;
+    std::mutex mtx;
+    std::set<uint16_t> ports;
+
+    void serve()
+    {
+        while (running)
+        {
+            struct pollfd pfd = {sd, POLLIN, 0};
+            if (poll(&pfd, 1, 50) <= 0)
+            {
+                continue;
+            }
+            uint8_t buf[512];
+            struct sockaddr_storage from;
+            socklen_t fromlen = sizeof(from);
+            ssize_t len = recvfrom(sd, buf, sizeof(buf), 0,
+                                   reinterpret_cast<struct sockaddr *>(&from),
+                                   &fromlen);
+            if (len <= 0)
+            {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                ports.insert(ntohs(reinterpret_cast<struct sockaddr_in *>(&from)->sin_port));
+            }
+            ++queries;
+            std::vector<uint8_t> r = make_response(std::vector<uint8_t>(buf, buf + len),
+                                                   300, addr);
+            sendto(sd, r.data(), r.size(), 0,
+                   reinterpret_cast<struct sockaddr *>(&from), fromlen);
+        }
+    }
+};
+
+
+/**
+ *  Sends a query to the stub resolver and waits for the response
+ */
+static std::vector<uint8_t> ask(uint16_t port, const std::vector<uint8_t>& query)
+{
+    int sd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sendto(sd, query.data(), query.size(), 0,
+           reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa));
+
+    std::vector<uint8_t> ret;
+    struct pollfd pfd = {sd, POLLIN, 0};
+    if (poll(&pfd, 1, 3000) > 0)
+    {
+        uint8_t buf[512];
+        ssize_t len = recv(sd, buf, sizeof(buf), 0);
+        if (len > 0)
+        {
+            ret.assign(buf, buf + len);
+        }
+    }
+    close(sd);
+    return ret;
+}
+
+
+TEST(StubResolver, parse_question)
+{
+    std::vector<uint8_t> q = make_query(0x1234, "WWW.Example.ORG", 28);
+    DNSQuestion dq;
+    ASSERT_TRUE(StubResolver::ParseQuestion(q.data(), q.size(), dq));
+    EXPECT_EQ(dq.name, "www.example.org");
+    EXPECT_EQ(dq.qtype, 28);
+    EXPECT_EQ(dq.qclass, 1);
+    EXPECT_EQ(dq.end, q.size());
+
+    // Truncated message
+    EXPECT_FALSE(StubResolver::ParseQuestion(q.data(), q.size() - 3, dq));
+
+    // Compression pointer in the question
+    q[12] = 0xc0;
+    EXPECT_FALSE(StubResolver::ParseQuestion(q.data(), q.size(), dq));
+}
+
+
+TEST(StubResolver, cache_ttl)
+{
+    const uint8_t addr[4] = {192, 0, 2, 1};
+    std::vector<uint8_t> r = make_response(make_query(1, "example.org"), 300, addr);
+    uint32_t ttl = 0;
+    std::vector<size_t> offsets;
+    ASSERT_TRUE(StubResolver::CacheTTL(r.data(), r.size(), ttl, offsets));
+    EXPECT_EQ(ttl, 300u);
+    // The OPT record is not included
+    ASSERT_EQ(offsets.size(), 1u);
+
+    // Very long TTLs are capped
+    r = make_response(make_query(1, "example.org"), 86400, addr);
+    ASSERT_TRUE(StubResolver::CacheTTL(r.data(), r.size(), ttl, offsets));
+    EXPECT_EQ(ttl, 3600u);
+
+    // Truncated responses and SERVFAIL are not cached
+    r[2] |= 0x02;
+    EXPECT_FALSE(StubResolver::CacheTTL(r.data(), r.size(), ttl, offsets));
+    r[2] &= ~0x02;
+    r[3] = 0x82;
+    EXPECT_FALSE(StubResolver::CacheTTL(r.data(), r.size(), ttl, offsets));
+
+    // NXDOMAIN with a SOA record uses the SOA minimum
+    std::vector<uint8_t> nx = make_query(1, "nx.example.org");
+    nx[2] = 0x81;
+    nx[3] = 0x83;
+    nx[9] = 1;   // NSCOUNT
+    nx.insert(nx.end(), {0xc0, 15, 0, 6, 0, 1, 0, 0, 0x0e, 0x10, 0, 24,
+                         0xc0, 15, 0xc0, 15,
+                         0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1,
+                         0, 0, 0, 60});
+    ASSERT_TRUE(StubResolver::CacheTTL(nx.data(), nx.size(), ttl, offsets));
+    EXPECT_EQ(ttl, 60u);
+}
+
+
+TEST(StubResolver, routing)
+{
+    StubResolver stub("127.0.0.1", 0);
+    stub.SetRoutes({"192.0.2.53"},
+                   {{{"~corp.example.", "example.org"}, {"10.8.0.1"}},
+                    {{"lab.corp.example"}, {"10.9.0.1", "10.9.0.2"}},
+                    {{"ignored.example"}, {}}});
+
+    EXPECT_EQ(stub.SelectServers("www.corp.example"),
+              std::vector<std::string>{"10.8.0.1"});
+    EXPECT_EQ(stub.SelectServers("CORP.example."),
+              std::vector<std::string>{"10.8.0.1"});
+    EXPECT_EQ(stub.SelectServers("host.lab.corp.example"),
+              (std::vector<std::string>{"10.9.0.1", "10.9.0.2"}));
+    EXPECT_EQ(stub.SelectServers("notcorp.example"),
+              std::vector<std::string>{"192.0.2.53"});
+    EXPECT_EQ(stub.SelectServers("ignored.example"),
+              std::vector<std::string>{"192.0.2.53"});
+}
+
+
+TEST(StubResolver, forward_and_cache)
+{
+    const uint8_t sys_addr[4] = {192, 0, 2, 1};
+    const uint8_t vpn_addr[4] = {10, 8, 0, 10};
+    FakeServer sys("127.0.0.1", 0, sys_addr);
+    ASSERT_TRUE(sys.bound);
+    FakeServer vpn("127.0.0.2", sys.port, vpn_addr);
+    ASSERT_TRUE(vpn.bound);
+
+    StubResolver stub("127.0.0.1", 0, sys.port);
+    stub.SetRoutes({"127.0.0.1"}, {{{"corp.example"}, {"127.0.0.2"}}});
+
+    std::vector<uint8_t> r = ask(stub.GetListenPort(),
+                                 make_query(0x4242, "www.example.org"));
+    ASSERT_GE(r.size(), 4u);
+    EXPECT_EQ(r[0], 0x42);
+    EXPECT_EQ(r[1], 0x42);
+    EXPECT_EQ(0, memcmp(r.data() + r.size() - 15, sys_addr, 4));
+
+    // Served from the cache, with the new id and the name spelling
+    r = ask(stub.GetListenPort(), make_query(0x1111, "WWW.example.org"));
+    ASSERT_GE(r.size(), 4u);
+    EXPECT_EQ(r[0], 0x11);
+    EXPECT_EQ(r[13], 'W');
+    EXPECT_EQ(sys.queries, 1);
+
+    // Names in the VPN domain go to the VPN name server
+    r = ask(stub.GetListenPort(), make_query(0x2222, "intranet.corp.example"));
+    ASSERT_GE(r.size(), 4u);
+    EXPECT_EQ(0, memcmp(r.data() + r.size() - 15, vpn_addr, 4));
+    EXPECT_EQ(vpn.queries, 1);
+    EXPECT_EQ(sys.queries, 1);
+
+    // Changing the routes flushes the cache
+    stub.SetRoutes({"127.0.0.1"}, {});
+    ask(stub.GetListenPort(), make_query(0x3333, "www.example.org"));
+    EXPECT_EQ(sys.queries, 2);
+}
+
+TEST(StubResolver, source_ports)
+{
+    const uint8_t sys_addr[4] = {192, 0, 2, 1};
+    FakeServer sys("127.0.0.1", 0, sys_addr);
+    ASSERT_TRUE(sys.bound);
+
+    StubResolver stub("127.0.0.1", 0, sys.port);
+    stub.SetRoutes({"127.0.0.1"}, {});
+
+    // Each query is sent from its own socket
+    for (const auto& name : {"a.example.org", "b.example.org", "c.example.org"})
+    {
+        std::vector<uint8_t> r = ask(stub.GetListenPort(), make_query(0x4242, name));
+        ASSERT_GE(r.size(), 4u);
+    }
+    EXPECT_EQ(sys.queries, 3);
+    EXPECT_EQ(sys.SourcePorts(), 3u);
+}
+
+} // namespace unittest
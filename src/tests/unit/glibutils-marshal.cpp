@@ -0,0 +1,132 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   glibutils-marshal.cpp
+ *
+ * @brief  Unit test for the GLibUtils::DBusType based marshalling
+ */
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dbus/core.hpp"
+#include "dbus/glibutils.hpp"
+#include "client/statistics.hpp"
+
+
+namespace unittest {
+
+TEST(GLibUtilsMarshal, signatures)
+{
+    EXPECT_STREQ(GLibUtils::Signature<bool>(), "b");
+    EXPECT_STREQ(GLibUtils::Signature<uint32_t>(), "u");
+    EXPECT_STREQ(GLibUtils::Signature<int64_t>(), "x");
+    EXPECT_STREQ(GLibUtils::Signature<std::string>(), "s");
+    EXPECT_STREQ(GLibUtils::Signature<std::vector<std::string>>(), "as");
+    EXPECT_STREQ((GLibUtils::Signature<std::map<std::string, uint32_t>>()),
+                 "a{su}");
+    EXPECT_STREQ((GLibUtils::Signature<std::tuple<std::string, uint32_t,
+                                                  std::vector<bool>>>()),
+                 "(suab)");
+    EXPECT_STREQ(GLibUtils::Signature<ConnectionStats>(), "a{sx}");
+}
+
+
+TEST(GLibUtilsMarshal, scalar_roundtrip)
+{
+    GVariant *v = g_variant_ref_sink(GLibUtils::Marshal<uint64_t>(1ULL << 40));
+    EXPECT_STREQ(g_variant_get_type_string(v), "t");
+    EXPECT_EQ(GLibUtils::Unmarshal<uint64_t>(v), 1ULL << 40);
+    g_variant_unref(v);
+
+    v = g_variant_ref_sink(GLibUtils::Marshal(std::string("hello")));
+    EXPECT_EQ(GLibUtils::Unmarshal<std::string>(v), "hello");
+    g_variant_unref(v);
+}
+
+
+TEST(GLibUtilsMarshal, container_roundtrip)
+{
+    std::vector<std::string> vec = {"one", "two", "three"};
+    GVariant *v = g_variant_ref_sink(GLibUtils::Marshal(vec));
+    EXPECT_STREQ(g_variant_get_type_string(v), "as");
+    EXPECT_EQ(GLibUtils::Unmarshal<std::vector<std::string>>(v), vec);
+    g_variant_unref(v);
+
+    std::map<std::string, int32_t> map = {{"a", -1}, {"b", 2}};
+    v = g_variant_ref_sink(GLibUtils::Marshal(map));
+    EXPECT_STREQ(g_variant_get_type_string(v), "a{si}");
+    EXPECT_EQ((GLibUtils::Unmarshal<std::map<std::string, int32_t>>(v)), map);
+    g_variant_unref(v);
+
+    std::vector<uint32_t> empty;
+    v = g_variant_ref_sink(GLibUtils::Marshal(empty));
+    EXPECT_STREQ(g_variant_get_type_string(v), "au");
+    EXPECT_EQ(g_variant_n_children(v), 0);
+    g_variant_unref(v);
+}
+
+
+TEST(GLibUtilsMarshal, tuple)
+{
+    GVariant *v = g_variant_ref_sink(GLibUtils::MarshalTuple(std::string("/path"),
+                                                             (uint32_t) 42,
+                                                             true));
+    EXPECT_STREQ(g_variant_get_type_string(v), "(sub)");
+
+    auto t = GLibUtils::Unmarshal<std::tuple<std::string, uint32_t, bool>>(v);
+    EXPECT_EQ(std::get<0>(t), "/path");
+    EXPECT_EQ(std::get<1>(t), 42);
+    EXPECT_EQ(std::get<2>(t), true);
+    g_variant_unref(v);
+}
+
+
+TEST(GLibUtilsMarshal, type_mismatch)
+{
+    GVariant *v = g_variant_ref_sink(GLibUtils::Marshal<uint32_t>(1));
+    EXPECT_THROW(GLibUtils::Unmarshal<std::string>(v), DBusException);
+    EXPECT_THROW(GLibUtils::Unmarshal<std::vector<uint32_t>>(v), DBusException);
+    g_variant_unref(v);
+}
+
+
+TEST(GLibUtilsMarshal, connection_stats)
+{
+    ConnectionStats stats;
+    stats.push_back(ConnectionStatDetails("BYTES_IN", 1234));
+    stats.push_back(ConnectionStatDetails("BYTES_OUT", -1));
+
+    GVariant *v = g_variant_ref_sink(GLibUtils::Marshal(stats));
+    EXPECT_STREQ(g_variant_get_type_string(v), "a{sx}");
+
+    ConnectionStats res = GLibUtils::Unmarshal<ConnectionStats>(v);
+    ASSERT_EQ(res.size(), 2);
+    EXPECT_EQ(res[0].key, "BYTES_IN");
+    EXPECT_EQ(res[0].value, 1234);
+    EXPECT_EQ(res[1].key, "BYTES_OUT");
+    EXPECT_EQ(res[1].value, -1);
+    g_variant_unref(v);
+}
+
+} // namespace unittest
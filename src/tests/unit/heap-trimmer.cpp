@@ -0,0 +1,97 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   heap-trimmer.cpp
+ *
+ * @brief  Unit test for HeapTrimmer
+ */
+
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "client/heap-trimmer.hpp"
+
+namespace unittest {
+
+TEST(HeapTrimmer, idle_trim)
+{
+    using namespace std::chrono;
+
+    HeapTrimmer trimmer;
+    auto t = HeapTrimmer::Clock::now();
+
+    // Nothing is trimmed until enabled
+    EXPECT_FALSE(trimmer.Sample(0, t + hours(1)));
+    EXPECT_EQ(trimmer.Trim(), 0u);
+
+    trimmer.Enable(seconds(60));
+    EXPECT_TRUE(trimmer.IsEnabled());
+    t = HeapTrimmer::Clock::now();
+
+    EXPECT_FALSE(trimmer.Sample(100, t));
+    EXPECT_FALSE(trimmer.Sample(100, t + seconds(59)));
+    EXPECT_TRUE(trimmer.Sample(100, t + seconds(60)));
+
+    // Only once per idle period
+    EXPECT_FALSE(trimmer.Sample(100, t + seconds(600)));
+
+    // New traffic starts a new idle period
+    EXPECT_FALSE(trimmer.Sample(200, t + seconds(601)));
+    EXPECT_FALSE(trimmer.Sample(200, t + seconds(660)));
+    EXPECT_TRUE(trimmer.Sample(200, t + seconds(661)));
+
+    auto values = trimmer.GetStatsValues();
+    ASSERT_EQ(values.size(), HeapTrimmer::GetStatsKeys().size());
+    EXPECT_EQ(values[3], 2u);
+}
+
+
+TEST(HeapTrimmer, heap_usage)
+{
+    HeapTrimmer trimmer;
+    trimmer.Enable(std::chrono::seconds(60));
+
+    // Free a large amount of small allocations below one still in
+    // use, so free() cannot return the memory by shrinking the heap
+    std::vector<void *> blocks;
+    for (int i = 0; i < 20000; ++i)
+    {
+        blocks.push_back(std::malloc(1000));
+    }
+    void *guard = std::malloc(1000);
+    auto before = trimmer.GetStatsValues();
+    for (auto b : blocks)
+    {
+        std::free(b);
+    }
+    EXPECT_GE(before[0], 20000u * 1000);
+    EXPECT_GE(before[2], before[0]);
+
+    uint64_t released = trimmer.Trim();
+    EXPECT_GT(released, 20000u * 1000 / 2);
+    auto after = trimmer.GetStatsValues();
+    EXPECT_LT(after[0], before[0]);
+    EXPECT_EQ(after[3], 1u);
+    EXPECT_EQ(after[4], released);
+    std::free(guard);
+}
+
+} // namespace unittest
@@ -0,0 +1,92 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   idset.cpp
+ *
+ * @brief  Unit test for IdSet, used by the access control lists
+ */
+
+#include <sys/types.h>
+#include <gtest/gtest.h>
+
+#include "common/idset.hpp"
+
+namespace unittest {
+
+TEST(IdSet, small_list)
+{
+    IdSet<uid_t> s;
+    EXPECT_TRUE(s.empty());
+    EXPECT_TRUE(s.Add(1000));
+    EXPECT_TRUE(s.Add(42));
+    EXPECT_FALSE(s.Add(1000));
+    ASSERT_EQ(s.size(), 2u);
+    EXPECT_TRUE(s.Contains(42));
+    EXPECT_FALSE(s.Contains(43));
+
+    EXPECT_TRUE(s.Remove(1000));
+    EXPECT_FALSE(s.Remove(1000));
+    EXPECT_EQ(s.List(), std::vector<uid_t>({42}));
+}
+
+
+TEST(IdSet, large_list)
+{
+    IdSet<uid_t> s;
+    for (uid_t id = 2000; id > 1000; --id)
+    {
+        ASSERT_TRUE(s.Add(id));
+    }
+    ASSERT_EQ(s.size(), 1000u);
+    EXPECT_FALSE(s.Add(1500));
+    EXPECT_TRUE(s.Contains(1001));
+    EXPECT_TRUE(s.Contains(2000));
+    EXPECT_FALSE(s.Contains(1000));
+
+    // The insertion order is kept
+    EXPECT_EQ(s.List().front(), 2000u);
+    EXPECT_EQ(s.List().back(), 1001u);
+
+    // Shrinking back to a small list must keep the look-ups working
+    for (uid_t id = 2000; id > 1004; --id)
+    {
+        ASSERT_TRUE(s.Remove(id));
+    }
+    ASSERT_EQ(s.size(), 4u);
+    EXPECT_FALSE(s.Contains(1500));
+    EXPECT_TRUE(s.Contains(1004));
+    EXPECT_TRUE(s.Add(1500));
+    EXPECT_TRUE(s.Contains(1500));
+}
+
+
+TEST(IdSet, contains_any)
+{
+    IdSet<gid_t> s;
+    EXPECT_FALSE(s.ContainsAny({1, 2, 3}));
+    for (gid_t id = 100; id < 120; ++id)
+    {
+        s.Add(id);
+    }
+    EXPECT_FALSE(s.ContainsAny({}));
+    EXPECT_FALSE(s.ContainsAny({1, 2, 3}));
+    EXPECT_TRUE(s.ContainsAny({1, 119, 3}));
+}
+
+} // namespace unittest
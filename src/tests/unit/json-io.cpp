@@ -0,0 +1,150 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   json-io.cpp
+ *
+ * @brief  Unit tests for the JsonIO helpers
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <unistd.h>
+
+#include "common/json-io.hpp"
+
+namespace unittest {
+
+static Json::Value jsoncpp_parse(const std::string& doc)
+{
+    Json::CharReaderBuilder bld;
+    std::unique_ptr<Json::CharReader> rd(bld.newCharReader());
+    Json::Value ret;
+    std::string err;
+    EXPECT_TRUE(rd->parse(doc.data(), doc.data() + doc.size(), &ret, &err))
+        << err;
+    return ret;
+}
+
+
+static Json::Value sample()
+{
+    Json::Value v;
+    v["name"] = "profile \"quoted\" ✓ \\ \t\x01";
+    v["persistent"] = true;
+    v["locked_down"] = false;
+    v["nothing"] = Json::Value();
+    v["created"] = (Json::Int64) 1665830400;
+    v["big"] = (Json::UInt64) UINT64_MAX;
+    v["negative"] = -42;
+    v["ratio"] = 0.1;
+    v["whole"] = 2.0;
+    v["empty_obj"] = Json::Value(Json::objectValue);
+    v["empty_arr"] = Json::Value(Json::arrayValue);
+    v["profile"]["remote"].append("vpn.example.org");
+    v["profile"]["remote"].append(1194);
+    v["profile"]["ca"].append(std::string(100, 'A') + "\n-----END-----\n");
+    return v;
+}
+
+
+TEST(JsonIO, parse)
+{
+    // Same result as the jsoncpp reader, for both writers
+    Json::Value v = sample();
+    for (bool compact : {false, true})
+    {
+        std::string doc = JsonIO::Write(v, compact);
+        EXPECT_EQ(JsonIO::Parse(doc), jsoncpp_parse(doc));
+    }
+
+    // Escape sequences, numbers and the lenient jsoncpp syntax
+    std::string doc = "// header\n"
+                      "{ \"s\": \"a\\u00e6\\ud83d\\ude00\\/\\\"b\", /* c */\n"
+                      "  \"n\": [0, -0, -9223372036854775808, 9223372036854775807,\n"
+                      "         18446744073709551615, 18446744073709551616,\n"
+                      "         1.5e3, -2E-2],\n"
+                      "  \"trailing\": [1, 2, ], }\n";
+    Json::Value p = JsonIO::Parse(doc);
+    EXPECT_EQ(p, jsoncpp_parse(doc));
+    EXPECT_EQ(p["s"].asString(), "a\xc3\xa6\xf0\x9f\x98\x80/\"b");
+    EXPECT_EQ(p["n"][2].asInt64(), INT64_MIN);
+    EXPECT_EQ(p["n"][4].asUInt64(), UINT64_MAX);
+    EXPECT_TRUE(p["n"][5].isDouble());
+    EXPECT_EQ(p["trailing"].size(), 2u);
+
+    // Documents only jsoncpp accepts are still parsed
+    EXPECT_EQ(JsonIO::Parse("{\"a\": 01} extra")["a"].asInt(), 1);
+
+    EXPECT_THROW(JsonIO::Parse("{\"a\": "), JsonIOException);
+    EXPECT_THROW(JsonIO::Parse("[\"\\ud83d\"]"), JsonIOException);
+    EXPECT_THROW(JsonIO::Parse(""), JsonIOException);
+    EXPECT_THROW(JsonIO::Parse("[2.5e308]"), JsonIOException);
+    EXPECT_THROW(JsonIO::Parse("{\"a\": -1e400}"), JsonIOException);
+}
+
+
+TEST(JsonIO, write)
+{
+    // The compact writer produces the same output as jsoncpp
+    Json::StreamWriterBuilder bld;
+    bld["indentation"] = "";
+    Json::Value v = sample();
+    EXPECT_EQ(JsonIO::Write(v, true), Json::writeString(bld, v));
+    EXPECT_EQ(JsonIO::Write(v, true).find('\n'), std::string::npos);
+
+    bld["indentation"] = "\t";
+    EXPECT_EQ(JsonIO::Write(v), Json::writeString(bld, v));
+
+    // Non-ASCII characters are escaped, invalid UTF-8 is replaced
+    Json::Value u;
+    u["s"] = "\xc3\xa6\xe2\x9c\x93\xf0\x9f\x98\x80\x7f\xc0\x80\xed\xa0\x80\xff\xe2\x9c";
+    EXPECT_EQ(JsonIO::Write(u, true),
+              "{\"s\":\"\\u00e6\\u2713\\ud83d\\ude00\x7f\\ufffd\\ufffd\\ufffd\\ufffd\\ufffd\"}");
+    bld["indentation"] = "";
+    EXPECT_EQ(JsonIO::Write(u, true), Json::writeString(bld, u));
+}
+
+
+TEST(JsonIO, load_file)
+{
+    char fname[] = "/tmp/json-io-test.XXXXXX";
+    int fd = mkstemp(fname);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // Larger than a single read
+    Json::Value v(Json::arrayValue);
+    for (int i = 0; i < 10000; ++i)
+    {
+        v.append("option-" + std::to_string(i));
+    }
+    {
+        std::ofstream f(fname);
+        f << JsonIO::Write(v, true);
+    }
+    EXPECT_EQ(JsonIO::LoadFile(fname), v);
+
+    std::remove(fname);
+    EXPECT_THROW(JsonIO::LoadFile(fname), JsonIOException);
+}
+
+} // namespace unittest
@@ -0,0 +1,78 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   latency-histogram.cpp
+ *
+ * @brief  Unit test for LatencyHistogram
+ */
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "common/latency-histogram.hpp"
+
+namespace unittest {
+
+TEST(LatencyHistogram, bucket_bounds)
+{
+    LatencyHistogram hist({1, 3, 7});
+    ASSERT_EQ(hist.Get().size(), 4u);
+
+    hist.Record(0);
+    hist.Record(1);
+    hist.Record(2);
+    hist.Record(3);
+    hist.Record(7);
+    hist.Record(8);
+    hist.Record(1000);
+
+    std::vector<uint64_t> res = hist.Get();
+    EXPECT_EQ(res[0], 2u);
+    EXPECT_EQ(res[1], 2u);
+    EXPECT_EQ(res[2], 1u);
+    EXPECT_EQ(res[3], 2u);
+}
+
+
+TEST(LatencyHistogram, totals)
+{
+    LatencyHistogram hist({10, 100});
+    EXPECT_EQ(hist.GetCount(), 0u);
+    EXPECT_EQ(hist.GetMaxUsec(), 0u);
+
+    hist.Record(5);
+    hist.Add(std::chrono::microseconds(250));
+    hist.Add(std::chrono::milliseconds(1));
+    EXPECT_EQ(hist.GetCount(), 3u);
+    EXPECT_EQ(hist.GetTotalUsec(), 1255u);
+    EXPECT_EQ(hist.GetMaxUsec(), 1000u);
+
+    hist.Reset();
+    EXPECT_EQ(hist.GetCount(), 0u);
+    EXPECT_EQ(hist.GetTotalUsec(), 0u);
+    EXPECT_EQ(hist.GetMaxUsec(), 0u);
+    for (const auto& b : hist.Get())
+    {
+        EXPECT_EQ(b, 0u);
+    }
+}
+
+} // namespace unittest
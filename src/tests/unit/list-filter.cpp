@@ -0,0 +1,110 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   list-filter.cpp
+ *
+ * @brief  Unit test for the filtering and pagination of ListFilter
+ */
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/list-filter.hpp"
+
+namespace unittest {
+
+static ListFilter::Item item(const std::string& path, uid_t owner,
+                             const std::string& name,
+                             unsigned int status = 0, bool dco = false)
+{
+    ListFilter::Item i;
+    i.path = path;
+    i.owner = owner;
+    i.name = name;
+    i.status_major = status;
+    i.dco = dco;
+    return i;
+}
+
+
+TEST(ListFilter, criteria)
+{
+    ListFilter f;
+    EXPECT_TRUE(f.Match(item("/a", 1000, "work")));
+
+    f.Set("owner", "1000");
+    f.Set("name_prefix", "wo");
+    EXPECT_TRUE(f.Match(item("/a", 1000, "work")));
+    EXPECT_FALSE(f.Match(item("/a", 1001, "work")));
+    EXPECT_FALSE(f.Match(item("/a", 1000, "home")));
+    EXPECT_FALSE(f.Match(item("/a", 1000, "w")));
+
+    f.Set("status_major", "2");
+    f.Set("dco", "true");
+    EXPECT_TRUE(f.Match(item("/a", 1000, "work", 2, true)));
+    EXPECT_FALSE(f.Match(item("/a", 1000, "work", 3, true)));
+    EXPECT_FALSE(f.Match(item("/a", 1000, "work", 2, false)));
+
+    EXPECT_THROW(f.Set("tag", "x"), std::invalid_argument);
+    EXPECT_THROW(f.Set("owner", "-1"), std::invalid_argument);
+    EXPECT_THROW(f.Set("owner", "99999999999"), std::invalid_argument);
+    EXPECT_THROW(f.Set("dco", "yes"), std::invalid_argument);
+}
+
+
+TEST(ListFilter, pages)
+{
+    std::vector<ListFilter::Item> items;
+    for (const auto& p : {"/x5", "/x1", "/x4", "/x2", "/x3"})
+    {
+        items.push_back(item(p, 0, ""));
+    }
+
+    ListFilter f;
+    f.SetLimit(2);
+    std::vector<std::string> seen;
+    do
+    {
+        std::vector<std::string> paths;
+        for (const auto& i : items)
+        {
+            if (f.Match(i))
+            {
+                paths.push_back(i.path);
+            }
+        }
+        ListFilter::Page page = f.Select(paths);
+        ASSERT_LE(page.paths.size(), 2u);
+        seen.insert(seen.end(), page.paths.begin(), page.paths.end());
+        f.cursor = page.next;
+    } while (!f.cursor.empty());
+
+    EXPECT_EQ(seen, std::vector<std::string>({"/x1", "/x2", "/x3", "/x4", "/x5"}));
+
+    f.SetLimit(0);
+    EXPECT_EQ(f.limit, 1000u);
+    f.SetLimit(5000);
+    EXPECT_EQ(f.limit, 1000u);
+}
+
+} // namespace unittest
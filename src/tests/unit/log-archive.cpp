@@ -0,0 +1,132 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-archive.cpp
+ *
+ * @brief  Unit test for ArchiveLogWriter and LogArchiveReader
+ */
+
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "log/logwriter.hpp"
+#include "log/log-archive.hpp"
+#include "log/logwriters/archive.hpp"
+
+namespace unittest {
+
+class LogArchiveTest : public ::testing::Test
+{
+protected:
+    std::string archive_dir;
+
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/openvpn3-unittest-archive-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        archive_dir = tmpl;
+    }
+
+    void TearDown() override
+    {
+        for (const auto& seg : LogArchive::ListSegments(archive_dir))
+        {
+            unlink(LogArchive::SegmentFilename(archive_dir, seg, true).c_str());
+            unlink(LogArchive::SegmentFilename(archive_dir, seg).c_str());
+        }
+        rmdir(archive_dir.c_str());
+    }
+
+
+    void write_events(const unsigned int count)
+    {
+        ArchiveLogWriter w(archive_dir, 65536);
+        LogTag::Ptr tag = LogTag::create("dummysender", "dummyinterface");
+        for (unsigned int i = 0; i < count; i++)
+        {
+            w.AddLogTag("logtag", tag);
+            w.Write(LogEvent(LogGroup::CLIENT, LogCategory::INFO,
+                             (0 == (i % 3) ? "token-A" : "token-B"),
+                             "Log message " + std::to_string(i)));
+        }
+    }
+};
+
+
+TEST_F(LogArchiveTest, replay_all)
+{
+    write_events(5000);
+    EXPECT_GT(LogArchive::ListSegments(archive_dir).size(), 1u);
+
+    LogArchiveReader reader(archive_dir);
+    unsigned int idx = 0;
+    size_t count = reader.Replay("", 0, 0,
+                                 [&idx](const LogArchiveReader::Entry& e)
+                                 {
+                                     EXPECT_EQ(e.event.message,
+                                               "Log message " + std::to_string(idx));
+                                     EXPECT_EQ(e.event.group, LogGroup::CLIENT);
+                                     EXPECT_EQ(e.event.category, LogCategory::INFO);
+                                     ++idx;
+                                 });
+    EXPECT_EQ(count, 5000u);
+}
+
+
+TEST_F(LogArchiveTest, replay_session_token)
+{
+    write_events(5000);
+
+    // The last segment is left without an index by the running writer,
+    // which must be scanned instead
+    ArchiveLogWriter active(archive_dir, 65536);
+    active.Write(LogEvent(LogGroup::CLIENT, LogCategory::INFO,
+                          "token-A", "Active segment"));
+
+    LogArchiveReader reader(archive_dir);
+    std::string last;
+    size_t count = reader.Replay("token-A", 0, 0,
+                                 [&last](const LogArchiveReader::Entry& e)
+                                 {
+                                     EXPECT_EQ(e.event.session_token, "token-A");
+                                     last = e.event.message;
+                                 });
+    EXPECT_EQ(count, 1668u);
+    EXPECT_EQ(last, "Active segment");
+}
+
+
+TEST_F(LogArchiveTest, logtag_hash)
+{
+    write_events(1);
+
+    LogTag::Ptr tag = LogTag::create("dummysender", "dummyinterface");
+    LogArchiveReader reader(archive_dir);
+    reader.Replay("", 0, 0,
+                  [tag](const LogArchiveReader::Entry& e)
+                  {
+                      EXPECT_EQ(e.tag_hash, tag->hash);
+                  });
+}
+
+} // namespace unittest
@@ -0,0 +1,175 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-compact.cpp
+ *
+ * @brief  Unit tests for the LogCompact signal encoding
+ */
+
+#include <gtest/gtest.h>
+
+#include "log/log-compact.hpp"
+
+namespace unittest {
+
+TEST(CompactEvent, roundtrip)
+{
+    CompactEvent::Writer w;
+    w.AddLog(3, 4, "token-1", "First message");
+    w.AddStatus(2, 7, "status message");
+    w.AddLog(5, 6, "", "");
+
+    const std::vector<uint8_t>& buf = w.GetBuffer();
+    ASSERT_EQ(buf.size(), 3 * CompactEvent::HEADER_SIZE
+                          + 7 + 13 + 14);
+
+    CompactEvent::Reader r(buf.data(), buf.size());
+    CompactEvent::Record rec;
+
+    ASSERT_TRUE(r.Next(rec));
+    EXPECT_EQ(rec.type, CompactEvent::Type::LOG);
+    EXPECT_EQ(rec.field1, 3u);
+    EXPECT_EQ(rec.field2, 4u);
+    EXPECT_EQ(rec.Token(), "token-1");
+    EXPECT_EQ(rec.Message(), "First message");
+
+    ASSERT_TRUE(r.Next(rec));
+    EXPECT_EQ(rec.type, CompactEvent::Type::STATUS);
+    EXPECT_EQ(rec.field1, 2u);
+    EXPECT_EQ(rec.field2, 7u);
+    EXPECT_EQ(rec.token_len, 0u);
+    EXPECT_EQ(rec.Message(), "status message");
+
+    ASSERT_TRUE(r.Next(rec));
+    EXPECT_EQ(rec.type, CompactEvent::Type::LOG);
+    EXPECT_EQ(rec.Message(), "");
+
+    EXPECT_FALSE(r.Next(rec));
+    EXPECT_FALSE(r.Failed());
+}
+
+
+TEST(CompactEvent, little_endian_header)
+{
+    CompactEvent::Writer w;
+    w.AddLog(0x01020304, 5, "", "x");
+    const std::vector<uint8_t>& buf = w.GetBuffer();
+    EXPECT_EQ(buf[0], CompactEvent::VERSION);
+    EXPECT_EQ(buf[1], (uint8_t) CompactEvent::Type::LOG);
+    EXPECT_EQ(buf[4], 0x04);
+    EXPECT_EQ(buf[7], 0x01);
+    EXPECT_EQ(buf[8], 5);
+    EXPECT_EQ(buf[16], 1);
+    EXPECT_EQ(buf[20], 'x');
+}
+
+
+TEST(CompactEvent, truncated)
+{
+    CompactEvent::Writer w;
+    w.AddLog(1, 2, "tok", "message");
+    const std::vector<uint8_t>& buf = w.GetBuffer();
+
+    for (size_t len = 1; len < buf.size(); ++len)
+    {
+        CompactEvent::Reader r(buf.data(), len);
+        CompactEvent::Record rec;
+        EXPECT_FALSE(r.Next(rec));
+        EXPECT_TRUE(r.Failed());
+    }
+}
+
+
+TEST(CompactEvent, log_fields)
+{
+    LogFields fields;
+    fields.AddString("server_host", "vpn.example.org");
+    fields.AddUInt("server_port", 1194);
+
+    CompactEvent::Writer w;
+    w.AddLog(3, 4, "token-1", "Connected", fields);
+    w.AddLog(3, 4, "", "No fields", LogFields());
+    w.AddStatus(2, 7, "status message");
+
+    const std::vector<uint8_t>& buf = w.GetBuffer();
+    const size_t flen = fields.Encode().size();
+    ASSERT_EQ(buf.size(), CompactEvent::HEADER_SIZE_FIELDS + 7 + 9 + flen
+                          + CompactEvent::HEADER_SIZE + 9
+                          + CompactEvent::HEADER_SIZE + 14);
+    EXPECT_EQ(buf[0], CompactEvent::VERSION_FIELDS);
+
+    CompactEvent::Reader r(buf.data(), buf.size());
+    CompactEvent::Record rec;
+
+    ASSERT_TRUE(r.Next(rec));
+    EXPECT_EQ(rec.Token(), "token-1");
+    EXPECT_EQ(rec.Message(), "Connected");
+    ASSERT_NE(rec.fields, nullptr);
+    LogFields decoded;
+    ASSERT_TRUE(decoded.Decode(rec.fields, rec.fields_len));
+    EXPECT_TRUE(decoded == fields);
+
+    // Records without fields keep the version 1 format
+    ASSERT_TRUE(r.Next(rec));
+    EXPECT_EQ(rec.Message(), "No fields");
+    EXPECT_EQ(rec.fields, nullptr);
+    EXPECT_EQ(rec.fields_len, 0u);
+
+    ASSERT_TRUE(r.Next(rec));
+    EXPECT_EQ(rec.type, CompactEvent::Type::STATUS);
+    EXPECT_FALSE(r.Next(rec));
+    EXPECT_FALSE(r.Failed());
+
+    // Truncated log fields
+    CompactEvent::Reader truncated(buf.data(),
+                                   CompactEvent::HEADER_SIZE_FIELDS + 7 + 9
+                                   + flen - 1);
+    EXPECT_FALSE(truncated.Next(rec));
+    EXPECT_TRUE(truncated.Failed());
+}
+
+
+TEST(CompactEvent, invalid_header)
+{
+    CompactEvent::Writer w;
+    w.AddLog(1, 2, "", "message");
+    std::vector<uint8_t> buf = w.GetBuffer();
+    CompactEvent::Record rec;
+
+    buf[0] = 3;
+    CompactEvent::Reader bad_version(buf.data(), buf.size());
+    EXPECT_FALSE(bad_version.Next(rec));
+    EXPECT_TRUE(bad_version.Failed());
+
+    buf[0] = CompactEvent::VERSION;
+    buf[1] = 9;
+    CompactEvent::Reader bad_type(buf.data(), buf.size());
+    EXPECT_FALSE(bad_type.Next(rec));
+    EXPECT_TRUE(bad_type.Failed());
+
+    // Message length pointing past the end of the buffer
+    buf[1] = (uint8_t) CompactEvent::Type::LOG;
+    buf[19] = 0xff;
+    CompactEvent::Reader bad_len(buf.data(), buf.size());
+    EXPECT_FALSE(bad_len.Next(rec));
+    EXPECT_TRUE(bad_len.Failed());
+}
+
+} // namespace unittest
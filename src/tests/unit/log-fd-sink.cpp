@@ -0,0 +1,102 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-fd-sink.cpp
+ *
+ * @brief  Unit tests for LogFdSink
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "log/log-fd-sink.hpp"
+
+namespace unittest {
+
+TEST(LogFdSink, render_journal)
+{
+    std::string r = LogFdSink::Render(LogFdSink::Format::JOURNAL,
+                                      LogCategory::WARN, LogGroup::CLIENT,
+                                      "first\nsecond", 0);
+    std::string prefix = "<4>" + LogPrefix(LogGroup::CLIENT, LogCategory::WARN);
+    EXPECT_EQ(r, prefix + "first\n" + prefix + "second\n");
+
+    r = LogFdSink::Render(LogFdSink::Format::JOURNAL, LogCategory::DEBUG,
+                          LogGroup::CLIENT, "trailing\n", 0);
+    EXPECT_EQ(r, "<7>" + LogPrefix(LogGroup::CLIENT, LogCategory::DEBUG)
+                 + "trailing\n");
+}
+
+
+TEST(LogFdSink, render_text)
+{
+    time_t now = 1600000000;
+    char ts[32] = {};
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S ", &tm);
+
+    std::string r = LogFdSink::Render(LogFdSink::Format::TEXT,
+                                      LogCategory::INFO, LogGroup::BACKENDPROC,
+                                      "Connected", now);
+    EXPECT_EQ(r, std::string(ts) + LogPrefix(LogGroup::BACKENDPROC, LogCategory::INFO)
+                 + "Connected\n");
+}
+
+
+TEST(LogFdSink, format_names)
+{
+    EXPECT_EQ(LogFdSink::ParseFormat("journal"), LogFdSink::Format::JOURNAL);
+    EXPECT_EQ(LogFdSink::ParseFormat("text"), LogFdSink::Format::TEXT);
+    EXPECT_EQ(LogFdSink::FormatName(LogFdSink::Format::JOURNAL), "journal");
+    EXPECT_THROW(LogFdSink::ParseFormat("xml"), std::invalid_argument);
+}
+
+
+TEST(LogFdSink, write_and_drop)
+{
+    int p[2];
+    ASSERT_EQ(pipe(p), 0);
+    ASSERT_EQ(fcntl(p[0], F_SETPIPE_SZ, 4096) > 0, true);
+    LogFdSink sink(p[1], LogFdSink::Format::JOURNAL);
+
+    EXPECT_TRUE(sink.Write(LogCategory::INFO, LogGroup::CLIENT, "hello"));
+    char buf[256] = {};
+    ssize_t n = read(p[0], buf, sizeof(buf) - 1);
+    ASSERT_GT(n, 0);
+    EXPECT_EQ(std::string(buf, n),
+              "<6>" + LogPrefix(LogGroup::CLIENT, LogCategory::INFO) + "hello\n");
+
+    // Nobody reads the pipe; once it is full, log events are dropped
+    // instead of blocking the writer
+    std::string big(1000, 'x');
+    unsigned int written = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        if (sink.Write(LogCategory::DEBUG, LogGroup::CLIENT, big))
+        {
+            ++written;
+        }
+    }
+    EXPECT_LT(written, 100u);
+    EXPECT_EQ(sink.Dropped(), 100u - written);
+    close(p[0]);
+}
+
+} // namespace unittest
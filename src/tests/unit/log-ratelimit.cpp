@@ -0,0 +1,79 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-ratelimit.cpp
+ *
+ * @brief  Unit test for LogRateLimiter
+ */
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "log/lograte.hpp"
+
+namespace unittest {
+
+TEST(LogRateLimiter, repeated_events)
+{
+    LogRateLimiter rl(1000, 1000);
+    LogEvent notice;
+    LogEvent ev(LogGroup::CLIENT, LogCategory::INFO, "token", "Flapping");
+
+    EXPECT_TRUE(rl.Allow(ev, notice));
+    EXPECT_TRUE(notice.empty());
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        EXPECT_FALSE(rl.Allow(ev, notice));
+        EXPECT_TRUE(notice.empty());
+    }
+
+    LogEvent other(LogGroup::CLIENT, LogCategory::INFO, "token", "Other");
+    EXPECT_TRUE(rl.Allow(other, notice));
+    ASSERT_FALSE(notice.empty());
+    EXPECT_EQ(notice.message, "Last message repeated 10 times");
+    EXPECT_EQ(notice.session_token, "token");
+}
+
+
+TEST(LogRateLimiter, burst)
+{
+    LogRateLimiter rl(1, 5);
+    LogEvent notice;
+    unsigned int allowed = 0;
+    for (unsigned int i = 0; i < 20; i++)
+    {
+        if (rl.Allow(LogEvent(LogGroup::CLIENT, LogCategory::INFO,
+                              "Message " + std::to_string(i)), notice))
+        {
+            ++allowed;
+        }
+    }
+    EXPECT_EQ(allowed, 5u);
+    EXPECT_TRUE(notice.empty());
+
+    // Critical events are never suppressed, and report what was
+    // suppressed until now
+    EXPECT_TRUE(rl.Allow(LogEvent(LogGroup::CLIENT, LogCategory::CRIT,
+                                  "Critical"), notice));
+    ASSERT_FALSE(notice.empty());
+    EXPECT_EQ(notice.message, "15 log events suppressed by rate limit");
+}
+
+} // namespace unittest
@@ -0,0 +1,80 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   log-stats.cpp
+ *
+ * @brief  Unit test for LogLatencyHistogram and LogEventCounter
+ */
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "log/logstats.hpp"
+
+namespace unittest {
+
+TEST(LogLatencyHistogram, buckets)
+{
+    LogLatencyHistogram hist;
+    std::vector<uint64_t> empty = hist.Get();
+    ASSERT_EQ(empty.size(), LogLatencyHistogram::BucketBounds().size() + 1);
+    for (const auto& b : empty)
+    {
+        EXPECT_EQ(b, 0u);
+    }
+
+    hist.Add(std::chrono::microseconds(5));
+    hist.Add(std::chrono::microseconds(10));
+    hist.Add(std::chrono::microseconds(11));
+    hist.Add(std::chrono::milliseconds(5));
+    hist.Add(std::chrono::seconds(3));
+
+    std::vector<uint64_t> res = hist.Get();
+    EXPECT_EQ(res[0], 2u);
+    EXPECT_EQ(res[1], 1u);
+    EXPECT_EQ(res[2], 0u);
+    EXPECT_EQ(res[3], 1u);
+    EXPECT_EQ(res.back(), 1u);
+}
+
+
+TEST(LogEventCounter, rate)
+{
+    LogEventCounter cnt(std::chrono::milliseconds(50));
+    EXPECT_EQ(cnt.GetCount(), 0u);
+    EXPECT_EQ(cnt.GetRate(), 0.0);
+
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        cnt.Add();
+    }
+    EXPECT_EQ(cnt.GetCount(), 10u);
+
+    // The rate is only updated when the measurement window is completed
+    EXPECT_EQ(cnt.GetRate(), 0.0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    double rate = cnt.GetRate();
+    EXPECT_GT(rate, 0.0);
+    EXPECT_LE(rate, 10 / 0.05);
+    EXPECT_EQ(cnt.GetCount(), 10u);
+}
+
+} // namespace unittest
@@ -0,0 +1,124 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logfields.cpp
+ *
+ * @brief  Unit test for the typed log event fields
+ */
+
+#include <gtest/gtest.h>
+
+#include "log/logfields.hpp"
+
+namespace unittest {
+
+TEST(LogFields, encode_decode)
+{
+    LogFields f;
+    f.AddString("server_host", "vpn.example.org");
+    f.AddUInt("bytes_in", 12345678901234ULL);
+    f.AddInt("offset", -42);
+    f.AddDouble("duration", 1.5);
+    f.AddString("empty", "");
+    ASSERT_EQ(f.size(), 5u);
+
+    std::vector<uint8_t> buf = f.Encode();
+    LogFields d;
+    ASSERT_TRUE(d.Decode(buf.data(), buf.size()));
+    EXPECT_TRUE(d == f);
+
+    auto it = d.begin();
+    EXPECT_EQ(it->name, "server_host");
+    EXPECT_EQ(it->type, LogFields::Type::STRING);
+    EXPECT_EQ(it->GetValue(), "vpn.example.org");
+    EXPECT_EQ(d.Find("bytes_in")->GetUInt(), 12345678901234ULL);
+    EXPECT_EQ(d.Find("offset")->GetInt(), -42);
+    EXPECT_EQ(d.Find("offset")->GetValue(), "-42");
+    EXPECT_EQ(d.Find("duration")->GetDouble(), 1.5);
+    EXPECT_EQ(d.Find("duration")->GetValue(), "1.5");
+    EXPECT_EQ(d.Find("missing"), nullptr);
+
+    // No fields at all
+    EXPECT_TRUE(d.Decode(buf.data(), 0));
+    EXPECT_TRUE(d.empty());
+    LogFields none;
+    buf = none.Encode();
+    ASSERT_EQ(buf.size(), 1u);
+    EXPECT_TRUE(d.Decode(buf.data(), buf.size()));
+    EXPECT_TRUE(d.empty());
+}
+
+
+TEST(LogFields, names)
+{
+    EXPECT_TRUE(LogFields::ValidName("a"));
+    EXPECT_TRUE(LogFields::ValidName("vpn_ip4"));
+    EXPECT_TRUE(LogFields::ValidName(std::string(32, 'x')));
+    EXPECT_FALSE(LogFields::ValidName(""));
+    EXPECT_FALSE(LogFields::ValidName(std::string(33, 'x')));
+    EXPECT_FALSE(LogFields::ValidName("_hidden"));
+    EXPECT_FALSE(LogFields::ValidName("4bytes"));
+    EXPECT_FALSE(LogFields::ValidName("Upper"));
+    EXPECT_FALSE(LogFields::ValidName("with space"));
+    EXPECT_FALSE(LogFields::ValidName("a=b"));
+
+    LogFields f;
+    EXPECT_THROW(f.AddString("Bad", "x"), LogFieldsException);
+    f.AddUInt("count", 1);
+    EXPECT_THROW(f.AddUInt("count", 2), LogFieldsException);
+    EXPECT_EQ(f.size(), 1u);
+}
+
+
+TEST(LogFields, invalid_input)
+{
+    LogFields f;
+    f.AddString("reason", "some reason");
+    f.AddUInt("count", 7);
+    const std::vector<uint8_t> buf = f.Encode();
+
+    // A truncated buffer is only valid when it ends between two fields
+    const size_t first_end = 1 + 2 + 6 + 4 + 11;
+    for (size_t len = 2; len < buf.size(); ++len)
+    {
+        LogFields d;
+        EXPECT_EQ(d.Decode(buf.data(), len), first_end == len) << "length " << len;
+        EXPECT_EQ(d.size(), (first_end == len ? 1u : 0u));
+    }
+
+    LogFields d;
+    std::vector<uint8_t> bad = buf;
+    bad[0] = 2;
+    EXPECT_FALSE(d.Decode(bad.data(), bad.size()));
+
+    bad = buf;
+    bad[1] = 9;
+    EXPECT_FALSE(d.Decode(bad.data(), bad.size()));
+
+    bad = buf;
+    bad[3] = 'R';
+    EXPECT_FALSE(d.Decode(bad.data(), bad.size()));
+
+    // Duplicated field names
+    bad = buf;
+    bad.insert(bad.end(), buf.begin() + 1, buf.end());
+    EXPECT_FALSE(d.Decode(bad.data(), bad.size()));
+}
+
+} // namespace unittest
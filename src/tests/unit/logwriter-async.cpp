@@ -0,0 +1,146 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logwriter-async.cpp
+ *
+ * @brief  Unit test for AsyncLogWriter
+ */
+
+#include <string>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "log/logwriter.hpp"
+#include "log/logwriters/implementations.hpp"
+
+namespace unittest {
+
+static LogWriter::Ptr create_async(std::ostream& dest, size_t queue_size,
+                                   AsyncLogWriter::OverflowPolicy policy)
+{
+    LogWriter::Ptr be(new StreamLogWriter(dest));
+    be->EnableTimestamp(false);
+    return LogWriter::Ptr(new AsyncLogWriter(std::move(be), queue_size,
+                                             std::chrono::milliseconds(1000),
+                                             policy));
+}
+
+
+TEST(AsyncLogWriter, write_order)
+{
+    std::stringstream out;
+    LogWriter::Ptr w = create_async(out, 16,
+                                    AsyncLogWriter::OverflowPolicy::BLOCK);
+
+    std::stringstream expect;
+    for (int i = 0; i < 1000; i++)
+    {
+        w->Write("line " + std::to_string(i));
+        expect << " line " << std::to_string(i) << "\n";
+    }
+    w->Flush();
+    EXPECT_EQ(out.str(), expect.str());
+}
+
+
+TEST(AsyncLogWriter, metadata)
+{
+    std::stringstream out;
+    LogWriter::Ptr w = create_async(out, 16,
+                                    AsyncLogWriter::OverflowPolicy::BLOCK);
+    w->EnableLogMeta(true);
+    w->AddMeta("meta_label", "meta_value");
+    w->Write("first line");
+    w->Write("second line");
+    w->Flush();
+    EXPECT_EQ(out.str(), " meta_label=meta_value\n"
+                         " first line\n"
+                         " second line\n");
+}
+
+
+TEST(AsyncLogWriter, drop_overflow)
+{
+    std::stringstream out;
+    AsyncLogWriter *w = new AsyncLogWriter(LogWriter::Ptr(new StreamLogWriter(out)),
+                                           1, std::chrono::milliseconds(0),
+                                           AsyncLogWriter::OverflowPolicy::DROP);
+    LogWriter::Ptr wptr(w);
+    for (int i = 0; i < 10000; i++)
+    {
+        w->Write("line " + std::to_string(i));
+    }
+    w->Flush();
+
+    // Every log line which did not make it must have been counted
+    size_t written = 0;
+    std::string line;
+    while (std::getline(out, line))
+    {
+        if (std::string::npos != line.find(" line "))
+        {
+            ++written;
+        }
+    }
+    EXPECT_EQ(written + w->GetDroppedCount(), 10000u);
+}
+
+
+TEST(AsyncLogWriter, producers)
+{
+    std::stringstream out;
+    AsyncLogWriter *w = new AsyncLogWriter(LogWriter::Ptr(new StreamLogWriter(out)),
+                                           16, std::chrono::milliseconds(1000),
+                                           AsyncLogWriter::OverflowPolicy::BLOCK);
+    LogWriter::Ptr wptr(w);
+    w->EnableTimestamp(false);
+    w->EnableLogMeta(true);
+    LogWriter::Ptr p1 = w->NewProducer();
+    LogWriter::Ptr p2 = w->NewProducer();
+
+    // The meta data of each producer is only used by its own Write()
+    p1->AddMeta("producer", "1");
+    p2->AddMeta("producer", "2");
+    w->Write("main line");
+    p2->Write("second line");
+    p1->Write("first line");
+    p1->Write("third line");
+    p1->Flush();
+    EXPECT_EQ(out.str(), " main line\n"
+                         " producer=2\n"
+                         " second line\n"
+                         " producer=1\n"
+                         " first line\n"
+                         " third line\n");
+    EXPECT_EQ(p2->GetLogWriterInfo(), w->GetLogWriterInfo());
+}
+
+
+TEST(AsyncLogWriter, parse_overflow_policy)
+{
+    EXPECT_EQ(AsyncLogWriter::ParseOverflowPolicy("drop"),
+              AsyncLogWriter::OverflowPolicy::DROP);
+    EXPECT_EQ(AsyncLogWriter::ParseOverflowPolicy("block"),
+              AsyncLogWriter::OverflowPolicy::BLOCK);
+    EXPECT_THROW(AsyncLogWriter::ParseOverflowPolicy("invalid"),
+                 LogException);
+}
+
+} // namespace unittest
@@ -0,0 +1,101 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logwriter-colour.cpp
+ *
+ * @brief  Unit test for ColourStreamWriter and ANSIColours
+ */
+
+
+#include <string>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "log/ansicolours.hpp"
+#include "log/logwriter.hpp"
+#include "log/logwriters/implementations.hpp"
+
+namespace unittest {
+
+TEST(ANSIColours, lookup)
+{
+    ANSIColours colours;
+    EXPECT_EQ(colours.Reset(), "\033[0m");
+    EXPECT_EQ(colours.ColourByCategory(LogCategory::ERROR), "\033[0m\033[1;31m");
+    EXPECT_EQ(colours.ColourByCategory(LogCategory::CRIT), "\033[0m\033[1;37m\033[41m");
+    EXPECT_EQ(colours.ColourByCategory(LogCategory::VERB1), "");
+    EXPECT_EQ(colours.ColourByGroup(LogGroup::CLIENT), "\033[0m\033[1;33m");
+    EXPECT_EQ(colours.ColourByGroup(LogGroup::MASTERPROC), "");
+
+    // Out of range values are not coloured
+    EXPECT_EQ(colours.ColourByCategory((LogCategory) 42), "");
+    EXPECT_EQ(colours.ColourByGroup((LogGroup) 42), "");
+
+    // The same prepared string is returned on each call
+    EXPECT_EQ(&colours.ColourByGroup(LogGroup::NETCFG),
+              &colours.ColourByGroup(LogGroup::NETCFG));
+}
+
+
+TEST(ColourStreamWriter, by_category)
+{
+    ANSIColours colours;
+    std::stringstream out;
+    ColourStreamWriter w(out, &colours);
+    w.EnableTimestamp(false);
+
+    w.Write(LogGroup::CLIENT, LogCategory::WARN, "warning");
+    w.Write(LogEvent(LogGroup::NETCFG, LogCategory::VERB1, "verb1"));
+    EXPECT_EQ(out.str(), " \033[0m\033[1;33mClient WARNING: warning\033[0m\n"
+                         " Network Configuration VERB1: verb1\033[0m\n");
+}
+
+
+TEST(ColourStreamWriter, by_group)
+{
+    ANSIColours colours;
+    colours.SetColourMode(ColourEngine::ColourMode::BY_GROUP);
+    std::stringstream out;
+    ColourStreamWriter w(out, &colours);
+    w.EnableTimestamp(false);
+
+    // The prefix of log events above INFO uses the category colour
+    w.Write(LogGroup::CLIENT, LogCategory::INFO, "info");
+    w.Write(LogGroup::CLIENT, LogCategory::ERROR, "error");
+    EXPECT_EQ(out.str(), " \033[0m\033[1;33mClient INFO: \033[0m\033[1;33minfo\033[0m\n"
+                         " \033[0m\033[1;31mClient -- ERROR --: \033[0m\033[1;33merror\033[0m\n");
+}
+
+
+TEST(ColourStreamWriter, no_colours)
+{
+    std::stringstream out;
+    ColourStreamWriter w(out, nullptr);
+    w.EnableTimestamp(false);
+
+    w.AddMeta("sender", ":1.42");
+    w.Write(LogGroup::SESSIONMGR, LogCategory::INFO, "plain");
+    w.Write((LogGroup) 42, LogCategory::INFO, "unknown group");
+    EXPECT_EQ(out.str(), " sender=:1.42\n"
+                         " Session Manager INFO: plain\n"
+                         " [group:42] INFO: unknown group\n");
+}
+
+} // namespace unittest
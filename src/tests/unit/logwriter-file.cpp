@@ -0,0 +1,192 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logwriter-file.cpp
+ *
+ * @brief  Unit test for FileLogWriter
+ */
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "log/logwriter.hpp"
+#include "log/logwriters/implementations.hpp"
+
+namespace unittest {
+
+class FileLogWriterTest : public ::testing::Test
+{
+protected:
+    std::string dir;
+    std::string logfile;
+
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/ovpn3-logwriter-file-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(tmpl));
+        dir = tmpl;
+        logfile = dir + "/test.log";
+    }
+
+    void TearDown() override
+    {
+        for (unsigned int i = 0; i < 5; ++i)
+        {
+            std::string f = (0 == i ? logfile
+                                    : FileLogWriter::RotatedFilename(logfile, i, false));
+            unlink(f.c_str());
+            unlink((f + ".moved").c_str());
+            unlink((f + ".lz4").c_str());
+        }
+        rmdir(dir.c_str());
+    }
+
+    static std::string read_file(const std::string& fname)
+    {
+        std::ifstream f(fname);
+        std::stringstream s;
+        s << f.rdbuf();
+        return s.str();
+    }
+
+    static bool exists(const std::string& fname)
+    {
+        return 0 == access(fname.c_str(), F_OK);
+    }
+};
+
+
+TEST_F(FileLogWriterTest, buffered)
+{
+    FileLogWriter w(logfile, FileLogWriter::Rotation(), 4096,
+                    std::chrono::milliseconds(60000));
+    w.EnableTimestamp(false);
+    w.EnableAutoFlush(false);
+
+    w.Write("first line");
+    w.Write(LogGroup::LOGGER, LogCategory::INFO, "second line");
+    EXPECT_EQ(read_file(logfile), "");
+
+    w.Flush();
+    EXPECT_EQ(read_file(logfile), " first line\n"
+                                  " Logger INFO: second line\n");
+
+    // A full buffer is written out without flushing
+    for (int i = 0; i < 1000; ++i)
+    {
+        w.Write("line " + std::to_string(i));
+    }
+    EXPECT_GT(read_file(logfile).size(), 4096u);
+}
+
+
+TEST_F(FileLogWriterTest, autoflush_and_append)
+{
+    {
+        std::ofstream f(logfile);
+        f << "existing\n";
+    }
+    FileLogWriter w(logfile, FileLogWriter::Rotation());
+    w.EnableTimestamp(false);
+    w.Write("appended");
+    EXPECT_EQ(read_file(logfile), "existing\n appended\n");
+}
+
+
+TEST_F(FileLogWriterTest, rotate_by_size)
+{
+    FileLogWriter::Rotation rot;
+    rot.max_size = 100;
+    rot.keep = 2;
+    FileLogWriter w(logfile, rot);
+    w.EnableTimestamp(false);
+
+    // Each line is 50 bytes, including the leading space and newline
+    const std::string line(48, 'x');
+    for (int i = 0; i < 7; ++i)
+    {
+        w.Write(line);
+    }
+    w.Flush();
+
+    EXPECT_EQ(read_file(logfile).size(), 50u);
+    EXPECT_EQ(read_file(FileLogWriter::RotatedFilename(logfile, 1, false)).size(), 100u);
+    EXPECT_EQ(read_file(FileLogWriter::RotatedFilename(logfile, 2, false)).size(), 100u);
+    EXPECT_FALSE(exists(FileLogWriter::RotatedFilename(logfile, 3, false)));
+}
+
+
+#ifdef HAVE_LZ4
+TEST_F(FileLogWriterTest, rotate_compressed)
+{
+    FileLogWriter::Rotation rot;
+    rot.max_size = 100;
+    rot.keep = 2;
+    rot.compress = true;
+    FileLogWriter w(logfile, rot);
+    w.EnableTimestamp(false);
+
+    const std::string line(48, 'x');
+    for (int i = 0; i < 5; ++i)
+    {
+        w.Write(line);
+    }
+    w.Flush();
+
+    EXPECT_EQ(read_file(logfile).size(), 50u);
+    EXPECT_FALSE(exists(FileLogWriter::RotatedFilename(logfile, 1, false)));
+    for (unsigned int i = 1; i <= 2; ++i)
+    {
+        // LZ4 frame magic number, little endian
+        std::string c = read_file(FileLogWriter::RotatedFilename(logfile, i, true));
+        ASSERT_GT(c.size(), 4u);
+        EXPECT_EQ(c.substr(0, 4), std::string("\x04\x22\x4d\x18"));
+        EXPECT_LT(c.size(), 100u);
+    }
+}
+#endif
+
+
+TEST_F(FileLogWriterTest, reopen)
+{
+    FileLogWriter w(logfile, FileLogWriter::Rotation(), 4096);
+    w.EnableTimestamp(false);
+    w.EnableAutoFlush(false);
+    w.Write("before");
+
+    // Buffered data goes to the old file, as an external log rotation
+    // tool would expect
+    ASSERT_EQ(0, rename(logfile.c_str(), (logfile + ".moved").c_str()));
+    w.Reopen();
+    w.Write("after");
+    w.Flush();
+
+    EXPECT_EQ(read_file(logfile + ".moved"), " before\n");
+    EXPECT_EQ(read_file(logfile), " after\n");
+}
+
+} // namespace unittest
@@ -0,0 +1,131 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logwriter-multi.cpp
+ *
+ * @brief  Unit test for MultiLogWriter and LogWriterSpec
+ */
+
+#include <string>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "log/logwriter.hpp"
+#include "log/logwriters/implementations.hpp"
+
+namespace unittest {
+
+TEST(LogWriterSpec, parse_list)
+{
+    std::vector<LogWriterSpec> l = LogWriterSpec::ParseList(
+        "journald ; archive:/var/log/openvpn3,level=6;"
+        "file:/tmp/o3.log,level=2,groups=client+netcfg");
+    ASSERT_EQ(l.size(), 3u);
+
+    EXPECT_EQ(l[0].method, "journald");
+    EXPECT_EQ(l[0].target, "");
+    EXPECT_EQ(l[0].filter.log_level, 6u);
+    EXPECT_TRUE(l[0].filter.groups.empty());
+
+    EXPECT_EQ(l[1].method, "archive");
+    EXPECT_EQ(l[1].target, "/var/log/openvpn3");
+
+    EXPECT_EQ(l[2].method, "file");
+    EXPECT_EQ(l[2].target, "/tmp/o3.log");
+    EXPECT_EQ(l[2].filter.log_level, 2u);
+    ASSERT_EQ(l[2].filter.groups.size(), 2u);
+    EXPECT_EQ(l[2].filter.groups[0], LogGroup::CLIENT);
+    EXPECT_EQ(l[2].filter.groups[1], LogGroup::NETCFG);
+}
+
+
+TEST(LogWriterSpec, parse_errors)
+{
+    EXPECT_THROW(LogWriterSpec::ParseList(""), LogException);
+    EXPECT_THROW(LogWriterSpec::ParseList("carrier-pigeon"), LogException);
+    EXPECT_THROW(LogWriterSpec::ParseList("file"), LogException);
+    EXPECT_THROW(LogWriterSpec::ParseList("syslog:/dev/log"), LogException);
+    EXPECT_THROW(LogWriterSpec::ParseList("syslog,level=7"), LogException);
+    EXPECT_THROW(LogWriterSpec::ParseList("syslog,level=x"), LogException);
+    EXPECT_THROW(LogWriterSpec::ParseList("syslog,groups=client+nothing"), LogException);
+    EXPECT_THROW(LogWriterSpec::ParseList("syslog,colour"), LogException);
+}
+
+
+TEST(MultiLogWriter, filters)
+{
+    std::stringstream all_out;
+    std::stringstream warn_out;
+    std::stringstream client_out;
+
+    MultiLogWriter multi;
+    LogWriterFilter f;
+    multi.AddWriter(LogWriter::Ptr(new StreamLogWriter(all_out)), f);
+    f.log_level = 2;
+    multi.AddWriter(LogWriter::Ptr(new StreamLogWriter(warn_out)), f);
+    f.log_level = 6;
+    f.groups = {LogGroup::CLIENT};
+    multi.AddWriter(LogWriter::Ptr(new StreamLogWriter(client_out)), f);
+    multi.EnableTimestamp(false);
+    ASSERT_EQ(multi.size(), 3u);
+
+    multi.Write(LogEvent(LogGroup::CLIENT, LogCategory::DEBUG, "client debug"));
+    multi.Write(LogEvent(LogGroup::NETCFG, LogCategory::WARN, "netcfg warning"));
+    multi.Write(LogGroup::SESSIONMGR, LogCategory::INFO, "sessionmgr info");
+    multi.Write("service message");
+
+    EXPECT_EQ(all_out.str(), " Client DEBUG: client debug\n"
+                             " Network Configuration WARNING: netcfg warning\n"
+                             " Session Manager INFO: sessionmgr info\n"
+                             " service message\n");
+    EXPECT_EQ(warn_out.str(), " Network Configuration WARNING: netcfg warning\n");
+    EXPECT_EQ(client_out.str(), " Client DEBUG: client debug\n"
+                                " service message\n");
+}
+
+
+TEST(MultiLogWriter, metadata_and_settings)
+{
+    std::stringstream first;
+    std::stringstream second;
+
+    MultiLogWriter multi;
+    multi.AddWriter(LogWriter::Ptr(new StreamLogWriter(first)), LogWriterFilter());
+    multi.AddWriter(LogWriter::Ptr(new StreamLogWriter(second)), LogWriterFilter());
+    multi.EnableTimestamp(false);
+
+    multi.AddMeta("sender", ":1.42");
+    multi.Write("with meta");
+    multi.Write("without meta");
+
+    // Settings changed on the MultiLogWriter apply to all destinations
+    multi.EnableLogMeta(false);
+    multi.AddMeta("sender", ":1.42");
+    multi.Write("meta disabled");
+
+    const std::string expect = " sender=:1.42\n"
+                               " with meta\n"
+                               " without meta\n"
+                               " meta disabled\n";
+    EXPECT_EQ(first.str(), expect);
+    EXPECT_EQ(second.str(), expect);
+}
+
+} // namespace unittest
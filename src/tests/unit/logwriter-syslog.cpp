@@ -0,0 +1,212 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   logwriter-syslog.cpp
+ *
+ * @brief  Unit test for SyslogSocketWriter
+ */
+
+
+#include <string>
+#include <vector>
+#include <regex>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "log/logwriter.hpp"
+#include "log/logwriters/implementations.hpp"
+
+namespace unittest {
+
+/**
+ *  Provides a local datagram socket acting as the syslog service
+ */
+class SyslogSocketWriterTest : public ::testing::Test
+{
+protected:
+    std::string dir;
+    std::string sockpath;
+    int fd = -1;
+
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/ovpn3-logwriter-syslog-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(tmpl));
+        dir = tmpl;
+        sockpath = dir + "/log";
+        bind_socket();
+    }
+
+    void TearDown() override
+    {
+        close(fd);
+        unlink(sockpath.c_str());
+        rmdir(dir.c_str());
+    }
+
+    void bind_socket()
+    {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, sockpath.c_str(), sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+        ASSERT_NE(-1, fd);
+        ASSERT_EQ(0, bind(fd, (struct sockaddr *) &addr, sizeof(addr)));
+    }
+
+    /**
+     *  Retrieves all the messages received so far
+     */
+    std::vector<std::string> receive()
+    {
+        std::vector<std::string> ret;
+        char buf[4096];
+        ssize_t r;
+        while ((r = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) >= 0)
+        {
+            ret.push_back(std::string(buf, r));
+        }
+        return ret;
+    }
+};
+
+
+TEST_F(SyslogSocketWriterTest, format)
+{
+    SyslogSocketWriter w("/usr/sbin/openvpn3-service-logger", LOG_LOCAL3,
+                         sockpath);
+    w.Write(LogGroup::CLIENT, LogCategory::ERROR, "connection failed");
+    w.AddMeta("sender", ":1.42");
+    w.AddMeta("path", "/net/openvpn/v3/sessions/a\"b]c");
+    w.Write(LogGroup::NETCFG, LogCategory::DEBUG, "with meta");
+    w.Write("service message");
+
+    std::vector<std::string> msgs = receive();
+    ASSERT_EQ(msgs.size(), 3u);
+
+    const std::string head = R"(1 \d{4}-\d\d-\d\dT\d\d:\d\d:\d\d\.\d{6}Z \S+ )"
+                             R"(openvpn3-service-logger \d+ )";
+    // LOG_LOCAL3 is 19 << 3, LOG_ERR 3 and LOG_DEBUG 7
+    EXPECT_TRUE(std::regex_match(msgs[0], std::regex(
+        "<155>" + head + "client - connection failed"))) << msgs[0];
+    EXPECT_TRUE(std::regex_match(msgs[1], std::regex(
+        "<159>" + head + R"(netcfg \[openvpn3@32473 sender=":1\.42" )"
+        R"(path="/net/openvpn/v3/sessions/a\\"b\\\]c"\] with meta)"))) << msgs[1];
+    EXPECT_TRUE(std::regex_match(msgs[2], std::regex(
+        "<158>" + head + "- - service message"))) << msgs[2];
+}
+
+
+TEST_F(SyslogSocketWriterTest, sd_id_truncated)
+{
+    // Only the name part is truncated, "-fields" and "@pen" are kept
+    SyslogSocketWriter w("logger", LOG_DAEMON, sockpath, 1,
+                         "openvpn3-linux-client-pipeline@32473");
+    w.AddMeta("sender", ":1.42");
+    LogEvent ev(LogGroup::CLIENT, LogCategory::INFO, "with fields");
+    ev.fields.AddString("server_host", "vpn.example.org");
+    w.Write(ev);
+
+    std::vector<std::string> msgs = receive();
+    ASSERT_EQ(msgs.size(), 1u);
+    EXPECT_NE(std::string::npos,
+              msgs[0].find("[openvpn3-linux-client-pipe@32473 sender=")) << msgs[0];
+    EXPECT_NE(std::string::npos,
+              msgs[0].find("][openvpn3-linux-clie-fields@32473 server_host=")) << msgs[0];
+}
+
+
+TEST_F(SyslogSocketWriterTest, batching)
+{
+    SyslogSocketWriter w("logger", LOG_DAEMON, sockpath, 2);
+    w.EnableAutoFlush(false);
+
+    w.Write("first");
+    EXPECT_TRUE(receive().empty());
+
+    // A full batch is sent without flushing
+    w.Write("second");
+    EXPECT_EQ(receive().size(), 2u);
+
+    w.Write("third");
+    EXPECT_TRUE(receive().empty());
+    w.Flush();
+    std::vector<std::string> msgs = receive();
+    ASSERT_EQ(msgs.size(), 1u);
+    EXPECT_NE(msgs[0].find(" - - third"), std::string::npos);
+}
+
+
+TEST_F(SyslogSocketWriterTest, reconnect)
+{
+    SyslogSocketWriter w("logger", LOG_DAEMON, sockpath);
+
+    // The syslog service is restarted, creating a new socket
+    close(fd);
+    unlink(sockpath.c_str());
+    bind_socket();
+
+    w.Write("after restart");
+    EXPECT_EQ(receive().size(), 1u);
+}
+
+
+TEST(SyslogSocketWriter, udp)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_NE(-1, fd);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(fd, (struct sockaddr *) &addr, sizeof(addr)));
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(0, getsockname(fd, (struct sockaddr *) &addr, &len));
+
+    SyslogSocketWriter w("logger", LOG_DAEMON,
+                         "127.0.0.1:" + std::to_string(ntohs(addr.sin_port)));
+    EXPECT_EQ(w.GetLogWriterInfo(),
+              "syslog:127.0.0.1:" + std::to_string(ntohs(addr.sin_port)));
+    w.Write(LogGroup::LOGGER, LogCategory::WARN, "over udp");
+
+    char buf[1024];
+    ssize_t r = recv(fd, buf, sizeof(buf), 0);
+    close(fd);
+    ASSERT_GT(r, 0);
+    std::string msg(buf, r);
+    EXPECT_EQ(msg.substr(0, 6), "<28>1 ");
+    EXPECT_NE(msg.find(" logger - over udp"), std::string::npos);
+}
+
+
+TEST(SyslogSocketWriter, errors)
+{
+    EXPECT_THROW(SyslogSocketWriter("logger", LOG_DAEMON,
+                                    "/nonexistent/ovpn3-syslog"),
+                 SyslogException);
+    EXPECT_THROW(SyslogSocketWriter("logger", LOG_DAEMON, "[::1"),
+                 SyslogException);
+}
+
+} // namespace unittest
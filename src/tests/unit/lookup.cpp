@@ -24,6 +24,7 @@
  *
  */
 
+#include <algorithm>
 #include <iostream>
 #include <gtest/gtest.h>
 
@@ -95,4 +96,45 @@ TEST(lookup, nobody_groupname)
         }
     }
 }
+
+TEST(lookup, gid_0)
+{
+    ASSERT_EQ(lookup_groupname(0), "root");
+    ASSERT_EQ(get_groupid("0"), 0);
+    ASSERT_EQ(get_groupid("root"), 0);
+    EXPECT_THROW(get_groupid("nonexisting_group"), LookupException);
+}
+
+TEST(lookup, user_groups)
+{
+    std::vector<gid_t> groups = lookup_user_groups(0);
+    ASSERT_FALSE(groups.empty());
+    EXPECT_TRUE(std::is_sorted(groups.begin(), groups.end()));
+    EXPECT_EQ(groups[0], 0);
+
+    // Cached results must be identical
+    EXPECT_EQ(lookup_user_groups(0), groups);
+}
+
+TEST(lookup, cached_results)
+{
+    lookup_cache_flush();
+    ASSERT_EQ(lookup_username(0), "root");
+    ASSERT_EQ(lookup_username(0), "root");
+    ASSERT_EQ(lookup_uid("root"), 0);
+    ASSERT_EQ(lookup_uid("root"), 0);
+
+    // Failed lookups are cached as well, and must still fail
+    EXPECT_THROW(lookup_uid("nonexiting_user"), LookupException);
+    EXPECT_THROW(lookup_uid("nonexiting_user"), LookupException);
+}
+
+TEST(lookup, cache_disabled)
+{
+    lookup_cache_set_ttl(0);
+    ASSERT_EQ(lookup_username(0), "root");
+    ASSERT_EQ(lookup_uid("root"), 0);
+    EXPECT_THROW(lookup_uid("nonexiting_user"), LookupException);
+    lookup_cache_set_ttl(LOOKUP_CACHE_DEFAULT_TTL);
+}
 } // namespace unittest
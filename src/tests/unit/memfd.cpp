@@ -0,0 +1,95 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   memfd.cpp
+ *
+ * @brief  Unit tests for the sealed memfd helpers
+ */
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "common/memfd.hpp"
+
+namespace unittest {
+
+TEST(MemFD, string_roundtrip)
+{
+    std::string data = "remote vpn.example.org\n<ca>\n";
+    data += std::string(200000, 'x');
+    data += "\n</ca>\n";
+
+    int fd = MemFD::CreateSealed("unittest", data);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(MemFD::ReadSealed(fd, data.size()), data);
+
+    // Reading does not depend on the file position
+    EXPECT_EQ(MemFD::ReadSealed(fd, data.size()), data);
+    close(fd);
+}
+
+
+TEST(MemFD, stream_writer)
+{
+    int fd = MemFD::CreateSealed("unittest", [](std::ostream& os)
+                                             {
+                                                 for (int i = 0; i < 10000; ++i)
+                                                 {
+                                                     os << i << "\n";
+                                                 }
+                                             });
+    std::string expect;
+    for (int i = 0; i < 10000; ++i)
+    {
+        expect += std::to_string(i) + "\n";
+    }
+    EXPECT_EQ(MemFD::ReadSealed(fd, 1024*1024), expect);
+    close(fd);
+}
+
+
+TEST(MemFD, sealed)
+{
+    int fd = MemFD::CreateSealed("unittest", std::string("data"));
+    EXPECT_LT(write(fd, "more", 4), 0);
+    EXPECT_LT(ftruncate(fd, 0), 0);
+    EXPECT_EQ(MemFD::ReadSealed(fd, 4), "data");
+    close(fd);
+}
+
+
+TEST(MemFD, size_limit)
+{
+    int fd = MemFD::CreateSealed("unittest", std::string(100, 'a'));
+    EXPECT_THROW(MemFD::ReadSealed(fd, 99), MemFDException);
+    close(fd);
+}
+
+
+TEST(MemFD, not_sealed)
+{
+    int p[2];
+    ASSERT_EQ(pipe(p), 0);
+    EXPECT_THROW(MemFD::ReadSealed(p[0], 100), MemFDException);
+    close(p[0]);
+    close(p[1]);
+}
+
+} // namespace unittest
@@ -0,0 +1,96 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   mpsc-queue.cpp
+ *
+ * @brief  Unit tests for the MPSCQueue
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/mpsc-queue.hpp"
+
+namespace unittest {
+
+TEST(MPSCQueue, order)
+{
+    MPSCQueue<std::string> q;
+    ASSERT_TRUE(q.empty());
+    EXPECT_TRUE(q.Push("first"));
+    EXPECT_FALSE(q.Push("second"));
+    EXPECT_FALSE(q.Push("third"));
+    ASSERT_FALSE(q.empty());
+
+    std::vector<std::string> items = q.PopAll();
+    ASSERT_EQ(items.size(), 3);
+    EXPECT_EQ(items[0], "first");
+    EXPECT_EQ(items[1], "second");
+    EXPECT_EQ(items[2], "third");
+    EXPECT_TRUE(q.empty());
+    EXPECT_TRUE(q.PopAll().empty());
+
+    // Empty again, so the next push starts a new batch
+    EXPECT_TRUE(q.Push("fourth"));
+}
+
+
+TEST(MPSCQueue, multiple_producers)
+{
+    const unsigned int producers = 4;
+    const unsigned int per_producer = 10000;
+    MPSCQueue<std::pair<unsigned int, unsigned int>> q;
+
+    std::vector<std::thread> threads;
+    for (unsigned int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&q, p, per_producer]()
+                             {
+                                 for (unsigned int i = 0; i < per_producer; ++i)
+                                 {
+                                     q.Push(std::make_pair(p, i));
+                                 }
+                             });
+    }
+
+    // Consume while the producers run; the items of each producer
+    // must arrive in order and none may be lost
+    std::vector<unsigned int> next(producers, 0);
+    unsigned int received = 0;
+    while (received < producers * per_producer)
+    {
+        for (const auto& item : q.PopAll())
+        {
+            ASSERT_EQ(item.second, next[item.first]);
+            ++next[item.first];
+            ++received;
+        }
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    EXPECT_TRUE(q.empty());
+}
+
+} // namespace unittest
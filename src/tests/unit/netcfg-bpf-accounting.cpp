@@ -0,0 +1,197 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-bpf-accounting.cpp
+ *
+ * @brief  Unit test for NetCfg::BpfAccounting.  Loading BPF programs
+ *         requires privileges, the tests are skipped without them.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-exception.hpp"
+#include "netcfg/bpf-accounting.hpp"
+
+namespace unittest {
+
+using NetCfg::BpfAccounting;
+using NetCfg::TrafficCounter;
+
+
+static std::unique_ptr<BpfAccounting> load()
+{
+    try
+    {
+        return std::unique_ptr<BpfAccounting>(new BpfAccounting());
+    }
+    catch (const NetCfgException& excp)
+    {
+        std::cout << "BpfAccounting: " << excp.what() << std::endl;
+        return nullptr;
+    }
+}
+
+
+static std::vector<uint8_t> ipv4_packet(uint8_t proto,
+                                        uint8_t d0, uint8_t d1,
+                                        size_t len = 60)
+{
+    std::vector<uint8_t> pkt(14 + len, 0);
+    pkt[12] = 0x08;
+    pkt[13] = 0x00;
+    pkt[14] = 0x45;
+    pkt[16] = len >> 8;
+    pkt[17] = len & 0xff;
+    pkt[22] = 64;
+    pkt[23] = proto;
+    pkt[26] = 10;
+    pkt[29] = 1;
+    pkt[30] = d0;
+    pkt[31] = d1;
+    pkt[33] = 1;
+    return pkt;
+}
+
+
+static std::vector<uint8_t> ipv6_packet(uint8_t next, uint8_t d0, uint8_t d1,
+                                        size_t len = 80)
+{
+    std::vector<uint8_t> pkt(14 + len, 0);
+    pkt[12] = 0x86;
+    pkt[13] = 0xdd;
+    pkt[14] = 0x60;
+    pkt[18] = (len - 40) >> 8;
+    pkt[19] = (len - 40) & 0xff;
+    pkt[20] = next;
+    pkt[21] = 64;
+    pkt[38] = d0;
+    pkt[39] = d1;
+    pkt[53] = 1;
+    return pkt;
+}
+
+
+static const TrafficCounter *find(const std::vector<TrafficCounter>& list,
+                                  const std::string& dir,
+                                  const std::string& family,
+                                  const std::string& proto,
+                                  const std::string& dest)
+{
+    for (const auto& c : list)
+    {
+        if (c.direction == dir && c.family == family
+            && c.protocol == proto && c.destination == dest)
+        {
+            return &c;
+        }
+    }
+    return nullptr;
+}
+
+
+TEST(BpfAccounting, ipv4_classes)
+{
+    auto acct = load();
+    if (!acct)
+    {
+        GTEST_SKIP() << "BPF programs could not be loaded";
+    }
+
+    EXPECT_EQ(acct->TestRun(BpfAccounting::Direction::OUT,
+                            ipv4_packet(6, 10, 8)), 0u);
+    acct->TestRun(BpfAccounting::Direction::OUT, ipv4_packet(6, 172, 20));
+    acct->TestRun(BpfAccounting::Direction::OUT, ipv4_packet(17, 192, 168));
+    acct->TestRun(BpfAccounting::Direction::OUT, ipv4_packet(17, 172, 32));
+    acct->TestRun(BpfAccounting::Direction::OUT, ipv4_packet(17, 100, 100));
+    acct->TestRun(BpfAccounting::Direction::IN, ipv4_packet(1, 169, 254));
+    acct->TestRun(BpfAccounting::Direction::IN, ipv4_packet(17, 239, 255));
+    acct->TestRun(BpfAccounting::Direction::IN, ipv4_packet(47, 8, 8, 100));
+
+    auto res = acct->Read();
+    ASSERT_EQ(res.size(), 6u);
+
+    const TrafficCounter *c = find(res, "out", "ipv4", "tcp", "private");
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(c->packets, 2u);
+    EXPECT_EQ(c->bytes, 2u * 74);
+
+    c = find(res, "out", "ipv4", "udp", "private");
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(c->packets, 2u);
+
+    c = find(res, "out", "ipv4", "udp", "global");
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(c->packets, 1u);
+
+    EXPECT_NE(find(res, "in", "ipv4", "icmp", "link-local"), nullptr);
+    EXPECT_NE(find(res, "in", "ipv4", "udp", "multicast"), nullptr);
+
+    c = find(res, "in", "ipv4", "other", "global");
+    ASSERT_NE(c, nullptr);
+    EXPECT_EQ(c->bytes, 114u);
+}
+
+
+TEST(BpfAccounting, ipv6_classes)
+{
+    auto acct = load();
+    if (!acct)
+    {
+        GTEST_SKIP() << "BPF programs could not be loaded";
+    }
+
+    acct->TestRun(BpfAccounting::Direction::IN, ipv6_packet(6, 0xfd, 0x00));
+    acct->TestRun(BpfAccounting::Direction::IN, ipv6_packet(58, 0xfe, 0x80));
+    acct->TestRun(BpfAccounting::Direction::IN, ipv6_packet(58, 0xfe, 0xc0));
+    acct->TestRun(BpfAccounting::Direction::OUT, ipv6_packet(17, 0xff, 0x02));
+    acct->TestRun(BpfAccounting::Direction::OUT, ipv6_packet(17, 0x20, 0x01));
+
+    auto res = acct->Read();
+    ASSERT_EQ(res.size(), 5u);
+    EXPECT_NE(find(res, "in", "ipv6", "tcp", "private"), nullptr);
+    EXPECT_NE(find(res, "in", "ipv6", "icmp", "link-local"), nullptr);
+    EXPECT_NE(find(res, "in", "ipv6", "icmp", "global"), nullptr);
+    EXPECT_NE(find(res, "out", "ipv6", "udp", "multicast"), nullptr);
+    EXPECT_NE(find(res, "out", "ipv6", "udp", "global"), nullptr);
+}
+
+
+TEST(BpfAccounting, non_ip)
+{
+    auto acct = load();
+    if (!acct)
+    {
+        GTEST_SKIP() << "BPF programs could not be loaded";
+    }
+
+    std::vector<uint8_t> arp(60, 0);
+    arp[12] = 0x08;
+    arp[13] = 0x06;
+    EXPECT_EQ(acct->TestRun(BpfAccounting::Direction::IN, arp), 0u);
+    EXPECT_EQ(acct->TestRun(BpfAccounting::Direction::OUT, arp), 0u);
+    EXPECT_TRUE(acct->Read().empty());
+}
+
+} // namespace unittest
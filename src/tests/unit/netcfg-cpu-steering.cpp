@@ -0,0 +1,190 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-cpu-steering.cpp
+ *
+ * @brief  Unit test for NetCfg::CpuSteering, using a fake sysfs and
+ *         procfs tree in a temporary directory
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-exception.hpp"
+#include "netcfg/cpu-steering.hpp"
+
+namespace unittest {
+
+using NetCfg::CpuSteering;
+using NetCfg::SteeringSettings;
+
+
+class CpuSteeringTest : public ::testing::Test
+{
+protected:
+    std::string root;
+
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/netcfg-cpu-steering-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        root = tmpl;
+
+        write("/sys/devices/system/cpu/online", "0-7\n");
+        write("/proc/sys/net/core/rps_sock_flow_entries", "0\n");
+        for (const auto& q : {"rx-0", "rx-1", "tx-0", "tx-1"})
+        {
+            write(std::string("/sys/class/net/tun0/queues/") + q + "/"
+                  + ('r' == q[0] ? "rps_cpus" : "xps_cpus"), "0\n");
+        }
+        write("/sys/class/net/tun0/queues/rx-0/rps_flow_cnt", "0\n");
+        write("/sys/class/net/tun0/queues/rx-1/rps_flow_cnt", "0\n");
+
+        // eth0 has an MSI interrupt on CPU 1 and a named one on 2-3
+        write("/sys/class/net/eth0/device/msi_irqs/40", "msix\n");
+        write("/proc/irq/40/effective_affinity_list", "1\n");
+        write("/proc/irq/41/smp_affinity_list", "2-3\n");
+        write("/proc/irq/42/smp_affinity_list", "4\n");
+        write("/proc/interrupts",
+              "           CPU0       CPU1\n"
+              " 41:          1          0  PCI-MSI  eth0-TxRx-0\n"
+              " 42:          1          0  PCI-MSI  eth01-TxRx-0\n");
+    }
+
+    void TearDown() override
+    {
+        std::string cmd = "rm -rf '" + root + "'";
+        ASSERT_EQ(system(cmd.c_str()), 0);
+    }
+
+    void write(const std::string& path, const std::string& content)
+    {
+        std::string full = root + path;
+        for (size_t p = full.find('/', root.size() + 1);
+             p != std::string::npos; p = full.find('/', p + 1))
+        {
+            mkdir(full.substr(0, p).c_str(), 0755);
+        }
+        std::ofstream(full) << content;
+    }
+
+    std::string read(const std::string& path)
+    {
+        std::ifstream f(root + path);
+        std::string line;
+        std::getline(f, line);
+        return line;
+    }
+};
+
+
+TEST(CpuSteeringFormat, masks_and_lists)
+{
+    EXPECT_EQ(CpuSteering::CPUMask({}), "0");
+    EXPECT_EQ(CpuSteering::CPUMask({0, 1, 2, 3}), "f");
+    EXPECT_EQ(CpuSteering::CPUMask({31}), "80000000");
+    EXPECT_EQ(CpuSteering::CPUMask({0, 33}), "2,00000001");
+    EXPECT_EQ(CpuSteering::CPUMask({64}), "1,00000000,00000000");
+
+    EXPECT_EQ(CpuSteering::CPUList({}), "");
+    EXPECT_EQ(CpuSteering::CPUList({3}), "3");
+    EXPECT_EQ(CpuSteering::CPUList({0, 1, 2, 3, 6, 8, 9}), "0-3,6,8-9");
+
+    EXPECT_EQ(CpuSteering::ParseCPUList("0-2,5"),
+              std::set<unsigned int>({0, 1, 2, 5}));
+    EXPECT_THROW(CpuSteering::ParseCPUList("2-1"), NetCfgException);
+}
+
+
+TEST(CpuSteeringFormat, settings)
+{
+    SteeringSettings global;
+    EXPECT_TRUE(global.empty());
+    global.rps_cpus = "auto";
+    global.rps_flow_cnt = 256;
+
+    SteeringSettings profile;
+    profile.rps_cpus = "4-7";
+    profile.xps_cpus = "4-7";
+    global.Merge(profile);
+    EXPECT_EQ(global.rps_cpus, "4-7");
+    EXPECT_EQ(global.xps_cpus, "4-7");
+    EXPECT_EQ(global.rps_flow_cnt, 256u);
+    EXPECT_NO_THROW(global.Validate());
+
+    global.xps_cpus = "x";
+    EXPECT_THROW(global.Validate(), NetCfgException);
+}
+
+
+TEST_F(CpuSteeringTest, irq_cpus)
+{
+    CpuSteering s(root);
+    EXPECT_EQ(s.OnlineCPUs(), std::set<unsigned int>({0, 1, 2, 3, 4, 5, 6, 7}));
+    EXPECT_EQ(s.IrqCPUs("eth0"), std::set<unsigned int>({1, 2, 3}));
+    EXPECT_TRUE(s.IrqCPUs("eth9").empty());
+
+    EXPECT_EQ(s.ResolveCPUs("auto", "eth0"),
+              std::set<unsigned int>({0, 4, 5, 6, 7}));
+    EXPECT_EQ(s.ResolveCPUs("auto", ""),
+              std::set<unsigned int>({0, 1, 2, 3, 4, 5, 6, 7}));
+    EXPECT_TRUE(s.ResolveCPUs("", "eth0").empty());
+    EXPECT_THROW(s.ResolveCPUs("6-9", ""), NetCfgException);
+
+    EXPECT_FALSE(s.RfsEnabled());
+    write("/proc/sys/net/core/rps_sock_flow_entries", "32768\n");
+    EXPECT_TRUE(s.RfsEnabled());
+}
+
+
+TEST_F(CpuSteeringTest, apply)
+{
+    CpuSteering s(root);
+    SteeringSettings settings;
+    settings.rps_cpus = "auto";
+    settings.xps_cpus = "4-6";
+    settings.rps_flow_cnt = 2048;
+
+    auto cpus = s.Apply("tun0", settings, "eth0");
+    EXPECT_EQ(cpus, std::set<unsigned int>({0, 4, 5, 6, 7}));
+    EXPECT_EQ(read("/sys/class/net/tun0/queues/rx-0/rps_cpus"), "f1");
+    EXPECT_EQ(read("/sys/class/net/tun0/queues/rx-1/rps_cpus"), "f1");
+    EXPECT_EQ(read("/sys/class/net/tun0/queues/rx-1/rps_flow_cnt"), "2048");
+    EXPECT_EQ(read("/sys/class/net/tun0/queues/tx-0/xps_cpus"), "50");
+    EXPECT_EQ(read("/sys/class/net/tun0/queues/tx-1/xps_cpus"), "20");
+
+    // Only XPS; the kernel defaults of RPS are kept
+    write("/sys/class/net/tun0/queues/rx-0/rps_cpus", "0\n");
+    SteeringSettings xps;
+    xps.xps_cpus = "1";
+    EXPECT_EQ(s.Apply("tun0", xps, ""), std::set<unsigned int>({1}));
+    EXPECT_EQ(read("/sys/class/net/tun0/queues/rx-0/rps_cpus"), "0");
+    EXPECT_EQ(read("/sys/class/net/tun0/queues/tx-0/xps_cpus"), "2");
+
+    EXPECT_THROW(s.Apply("tun9", settings, ""), NetCfgException);
+}
+
+} // namespace unittest
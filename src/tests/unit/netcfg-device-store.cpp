@@ -0,0 +1,143 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-device-store.cpp
+ *
+ * @brief  Unit tests for NetCfg::DeviceStore
+ */
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-device-store.hpp"
+
+namespace unittest {
+
+using namespace NetCfg;
+
+static DeviceRecord make_record(const std::string& path)
+{
+    DeviceRecord r;
+    r.object_path = path;
+    r.device_name = "tun0";
+    r.owner = 990;
+    r.owner_pid = 4321;
+    r.layer = 3;
+    r.mtu = 1500;
+    r.txqueuelen = 100;
+    r.reroute_ipv4 = true;
+    r.bundle = "tun0";
+
+    DeviceRecord::Address a;
+    a.address = "10.8.0.2";
+    a.prefix = 24;
+    a.gateway = "10.8.0.1";
+    r.addresses.push_back(a);
+    a.address = "fd00::2";
+    a.prefix = 64;
+    a.gateway = "";
+    a.ipv6 = true;
+    r.addresses.push_back(a);
+
+    r.networks.emplace_back("192.168.10.0", 24, false);
+    r.networks.emplace_back("192.168.10.5", 32, false, true);
+    r.remote = "2001:db8::1";
+    r.remote_ipv6 = true;
+    r.dns_servers = {"10.8.0.1"};
+    r.dns_search = {"example.org", "example.net"};
+    r.dns_scope = 1;
+    return r;
+}
+
+
+TEST(DeviceStore, roundtrip)
+{
+    DeviceStore store("boot-1");
+    store.Set(make_record("/net/openvpn/v3/netcfg/4321_tun0"));
+    std::string data = store.Serialize();
+    EXPECT_EQ(data.find('\n'), std::string::npos);
+
+    DeviceStore loaded("boot-1");
+    ASSERT_EQ(loaded.Parse(data), 1u);
+    DeviceRecord r = loaded.GetAll()[0];
+    DeviceRecord exp = make_record("/net/openvpn/v3/netcfg/4321_tun0");
+    EXPECT_EQ(r.object_path, exp.object_path);
+    EXPECT_EQ(r.device_name, exp.device_name);
+    EXPECT_EQ(r.owner, exp.owner);
+    EXPECT_EQ(r.owner_pid, exp.owner_pid);
+    EXPECT_EQ(r.layer, exp.layer);
+    EXPECT_EQ(r.mtu, exp.mtu);
+    EXPECT_EQ(r.txqueuelen, exp.txqueuelen);
+    EXPECT_TRUE(r.reroute_ipv4);
+    EXPECT_FALSE(r.reroute_ipv6);
+    EXPECT_EQ(r.bundle, exp.bundle);
+    ASSERT_EQ(r.addresses.size(), 2u);
+    EXPECT_EQ(r.addresses[0].address, "10.8.0.2");
+    EXPECT_EQ(r.addresses[0].prefix, 24u);
+    EXPECT_EQ(r.addresses[0].gateway, "10.8.0.1");
+    EXPECT_FALSE(r.addresses[0].ipv6);
+    EXPECT_TRUE(r.addresses[1].ipv6);
+    EXPECT_EQ(r.networks, exp.networks);
+    EXPECT_EQ(r.remote, exp.remote);
+    EXPECT_TRUE(r.remote_ipv6);
+    EXPECT_EQ(r.dns_servers, exp.dns_servers);
+    EXPECT_EQ(r.dns_search, exp.dns_search);
+    EXPECT_EQ(r.dns_scope, 1u);
+    EXPECT_FALSE(r.dco);
+}
+
+
+TEST(DeviceStore, set_and_remove)
+{
+    DeviceStore store("boot-1");
+    DeviceRecord r = make_record("/d1");
+    store.Set(r);
+    r.mtu = 1400;
+    store.Set(r);
+    EXPECT_EQ(store.size(), 1u);
+    EXPECT_EQ(store.GetAll()[0].mtu, 1400u);
+
+    EXPECT_TRUE(store.Remove("/d1"));
+    EXPECT_FALSE(store.Remove("/d1"));
+    EXPECT_EQ(store.size(), 0u);
+}
+
+
+TEST(DeviceStore, rejects_stale_data)
+{
+    DeviceStore store("boot-1");
+    store.Set(make_record("/d1"));
+    std::string data = store.Serialize();
+
+    // Devices recorded before a reboot are not taken over
+    DeviceStore other_boot("boot-2");
+    EXPECT_EQ(other_boot.Parse(data), 0u);
+
+    DeviceStore loaded("boot-1");
+    loaded.Set(make_record("/d9"));
+    EXPECT_EQ(loaded.Parse("{ not json"), 0u);
+    EXPECT_EQ(loaded.size(), 0u);
+
+    // Records without a device name or owner process are skipped
+    std::string incomplete = "{\"version\":1,\"boot_id\":\"boot-1\","
+                             "\"devices\":{\"/d1\":{\"owner_pid\":12},"
+                             "\"/d2\":{\"device_name\":\"tun1\"}}}";
+    EXPECT_EQ(loaded.Parse(incomplete), 0u);
+}
+
+} // namespace unittest
@@ -0,0 +1,195 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-packet-capture.cpp
+ *
+ * @brief  Unit test for the pcapng blocks and the limits of
+ *         NetCfg::PacketCapture
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-exception.hpp"
+#include "netcfg/pcapng.hpp"
+#include "netcfg/packet-capture.hpp"
+
+namespace unittest {
+
+using NetCfg::PacketCapture;
+
+
+static uint32_t get32(const std::string& b, size_t off)
+{
+    uint32_t v = 0;
+    std::memcpy(&v, b.data() + off, sizeof(v));
+    return v;
+}
+
+
+static uint16_t get16(const std::string& b, size_t off)
+{
+    uint16_t v = 0;
+    std::memcpy(&v, b.data() + off, sizeof(v));
+    return v;
+}
+
+
+/**
+ *  Checks the framing of a block and returns its options, as
+ *  code/value pairs.  The options start at body_len bytes after the
+ *  block header.
+ */
+static std::vector<std::pair<uint16_t, std::string>> parse_block(const std::string& b,
+                                                                  uint32_t type,
+                                                                  size_t body_len)
+{
+    EXPECT_EQ(get32(b, 0), type);
+    EXPECT_EQ(b.size() % 4, 0u);
+    EXPECT_EQ(get32(b, 4), b.size());
+    EXPECT_EQ(get32(b, b.size() - 4), b.size());
+
+    std::vector<std::pair<uint16_t, std::string>> opts;
+    size_t off = 8 + body_len;
+    while (off + 4 <= b.size() - 4)
+    {
+        uint16_t code = get16(b, off);
+        uint16_t len = get16(b, off + 2);
+        if (0 == code)
+        {
+            break;
+        }
+        opts.push_back({code, b.substr(off + 4, len)});
+        off += 4 + len + (4 - len % 4) % 4;
+    }
+    return opts;
+}
+
+
+TEST(Pcapng, section_header)
+{
+    std::string shb = Pcapng::SectionHeader({"session: /net/openvpn/v3/sessions/1", "x"},
+                                            "test");
+    auto opts = parse_block(shb, Pcapng::BLOCK_SHB, 16);
+    EXPECT_EQ(get32(shb, 8), 0x1A2B3C4Du);
+    EXPECT_EQ(get16(shb, 12), 1);
+    ASSERT_EQ(opts.size(), 3u);
+    EXPECT_EQ(opts[0].first, 1);
+    EXPECT_EQ(opts[0].second, "session: /net/openvpn/v3/sessions/1");
+    EXPECT_EQ(opts[1].second, "x");
+    EXPECT_EQ(opts[2].first, 4);
+    EXPECT_EQ(opts[2].second, "test");
+}
+
+
+TEST(Pcapng, interface_and_packets)
+{
+    std::string idb = Pcapng::InterfaceDescription(Pcapng::LINKTYPE_RAW, 96, "tun0");
+    auto opts = parse_block(idb, Pcapng::BLOCK_IDB, 8);
+    EXPECT_EQ(get16(idb, 8), Pcapng::LINKTYPE_RAW);
+    EXPECT_EQ(get32(idb, 12), 96u);
+    ASSERT_EQ(opts.size(), 2u);
+    EXPECT_EQ(opts[0].second, "tun0");
+    EXPECT_EQ(opts[1].first, 9);
+    EXPECT_EQ(opts[1].second, std::string(1, 9));
+
+    const char data[] = "abcde";
+    uint64_t ts = 1650000000123456789ULL;
+    std::string epb = Pcapng::EnhancedPacket(ts, data, 5, 1400);
+    parse_block(epb, Pcapng::BLOCK_EPB, 20 + 8);
+    EXPECT_EQ(epb.size(), 8 + 20 + 8 + 4u);
+    EXPECT_EQ(((uint64_t) get32(epb, 12) << 32) | get32(epb, 16), ts);
+    EXPECT_EQ(get32(epb, 20), 5u);
+    EXPECT_EQ(get32(epb, 24), 1400u);
+    EXPECT_EQ(epb.substr(28, 5), "abcde");
+
+    std::string isb = Pcapng::InterfaceStatistics(ts, 10, 2, 7, "done");
+    opts = parse_block(isb, Pcapng::BLOCK_ISB, 12);
+    ASSERT_EQ(opts.size(), 4u);
+    EXPECT_EQ(opts[0].second, "done");
+    uint64_t v = 0;
+    std::memcpy(&v, opts[2].second.data(), sizeof(v));
+    EXPECT_EQ(opts[2].first, 5);
+    EXPECT_EQ(v, 2u);
+}
+
+
+TEST(PacketCapture, clamp_filter)
+{
+    auto all = PacketCapture::ClampFilter({}, 64);
+    ASSERT_EQ(all.size(), 1u);
+    EXPECT_EQ(all[0].code, BPF_RET | BPF_K);
+    EXPECT_EQ(all[0].k, 64u);
+
+    // tcpdump -dd udp
+    std::vector<struct sock_filter> udp = {
+        {0x28, 0, 0, 0x0000000c}, {0x15, 0, 5, 0x000086dd},
+        {0x30, 0, 0, 0x00000014}, {0x15, 6, 0, 0x00000011},
+        {0x15, 0, 6, 0x0000002c}, {0x30, 0, 0, 0x00000036},
+        {0x15, 3, 4, 0x00000011}, {0x15, 0, 3, 0x00000800},
+        {0x30, 0, 0, 0x00000017}, {0x15, 0, 1, 0x00000011},
+        {0x6, 0, 0, 0x00040000}, {0x6, 0, 0, 0x00000000}
+    };
+    auto clamped = PacketCapture::ClampFilter(udp, 128);
+    ASSERT_EQ(clamped.size(), udp.size());
+    EXPECT_EQ(clamped[10].k, 128u);
+    EXPECT_EQ(clamped[11].k, 0u);
+    EXPECT_EQ(clamped[3].k, udp[3].k);
+
+    std::vector<struct sock_filter> ret_a = {BPF_STMT(BPF_RET | BPF_A, 0)};
+    EXPECT_THROW(PacketCapture::ClampFilter(ret_a, 128), NetCfgException);
+}
+
+
+TEST(PacketCapture, limits)
+{
+    PacketCapture::Limits l;
+    auto d = l.Bounded();
+    EXPECT_EQ(d.snaplen, 128u);
+    EXPECT_EQ(d.max_packets, 10000u);
+    EXPECT_EQ(d.duration, 60u);
+    EXPECT_EQ(d.rate_limit, 1000u);
+
+    l.snaplen = 100000;
+    l.max_bytes = UINT64_MAX;
+    l.duration = 5;
+    auto b = l.Bounded();
+    EXPECT_EQ(b.snaplen, 65535u);
+    EXPECT_EQ(b.max_bytes, 256u * 1024 * 1024);
+    EXPECT_EQ(b.duration, 5u);
+}
+
+
+TEST(PacketCapture, missing_device)
+{
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    EXPECT_THROW(PacketCapture("no-such-dev0", fds[1], PacketCapture::Limits(),
+                               {}, {}),
+                 NetCfgException);
+    close(fds[0]);
+}
+
+} // namespace unittest
@@ -0,0 +1,75 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-queue-discipline.cpp
+ *
+ * @brief  Unit test for NetCfg::QueueSettings and the CoDel parameters
+ *         of NetCfg::QueueDiscipline
+ */
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-exception.hpp"
+#include "netcfg/queue-discipline.hpp"
+
+namespace unittest {
+
+using NetCfg::QueueDiscipline;
+using NetCfg::QueueSettings;
+
+
+TEST(QueueSettings, merge_and_validate)
+{
+    QueueSettings global;
+    EXPECT_TRUE(global.empty());
+    global.qdisc = "fq_codel";
+    global.txqueuelen = 1000;
+
+    QueueSettings profile;
+    profile.qdisc = "cake";
+    profile.bandwidth = 20000;
+    global.Merge(profile);
+    EXPECT_EQ(global.qdisc, "cake");
+    EXPECT_EQ(global.bandwidth, 20000u);
+    EXPECT_EQ(global.txqueuelen, 1000u);
+    EXPECT_NO_THROW(global.Validate());
+    EXPECT_EQ(global.str(), "qdisc: cake, bandwidth: 20000 kbit/s, txqueuelen: 1000");
+
+    global.qdisc = "pfifo";
+    EXPECT_THROW(global.Validate(), NetCfgException);
+}
+
+
+TEST(QueueDiscipline, codel_parameters)
+{
+    // Fast links keep the fq_codel defaults
+    EXPECT_EQ(QueueDiscipline::CodelTarget(0, 1500), 5000u);
+    EXPECT_EQ(QueueDiscipline::CodelTarget(100000, 1500), 5000u);
+    EXPECT_EQ(QueueDiscipline::CodelInterval(5000), 100000u);
+
+    // 1 Mbit/s: a 1500 byte packet takes 12 ms
+    EXPECT_EQ(QueueDiscipline::CodelTarget(1000, 1500), 18000u);
+    EXPECT_EQ(QueueDiscipline::CodelInterval(18000), 360000u);
+
+    EXPECT_EQ(QueueDiscipline::CodelTarget(1, 65535), UINT32_MAX / 20);
+}
+
+} // namespace unittest
@@ -0,0 +1,177 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-remote-resolver-cache.cpp
+ *
+ * @brief  Unit tests for NetCfg::RemoteResolverCache
+ */
+
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "netcfg/remote-resolver-cache.hpp"
+
+namespace unittest {
+
+using namespace NetCfg;
+using Cache = RemoteResolverCache;
+
+
+/**
+ *  Fake resolver counting its lookups; names starting with "bad" fail
+ */
+struct FakeResolver
+{
+    std::atomic<unsigned int> calls{0};
+
+    Cache::ResolveFunc Func()
+    {
+        return [this](const std::string& host)
+               {
+                   ++calls;
+                   Cache::Result res;
+                   if (0 == host.compare(0, 3, "bad"))
+                   {
+                       res.error = "Name or service not known";
+                   }
+                   else
+                   {
+                       res.addresses = {"192.0.2.1", "2001:db8::1"};
+                   }
+                   return res;
+               };
+    }
+};
+
+
+TEST(RemoteResolverCache, caches_until_expiry)
+{
+    FakeResolver fake;
+    Cache::Clock::time_point t = Cache::Clock::now();
+    Cache cache(std::chrono::seconds(60), std::chrono::seconds(10), 16,
+                fake.Func(), [&t]() { return t; });
+
+    Cache::Result r = cache.Lookup("vpn.example.org");
+    EXPECT_EQ(r.addresses, std::vector<std::string>({"192.0.2.1", "2001:db8::1"}));
+    EXPECT_TRUE(r.error.empty());
+    cache.Lookup("vpn.example.org");
+    EXPECT_EQ(fake.calls, 1u);
+
+    Cache::Result cached;
+    EXPECT_TRUE(cache.Cached("vpn.example.org", cached));
+    EXPECT_EQ(cached.addresses.size(), 2u);
+    EXPECT_FALSE(cache.Cached("other.example.org", cached));
+
+    t += std::chrono::seconds(61);
+    EXPECT_FALSE(cache.Cached("vpn.example.org", cached));
+    cache.Lookup("vpn.example.org");
+    EXPECT_EQ(fake.calls, 2u);
+
+    cache.Flush();
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+
+TEST(RemoteResolverCache, negative_caching)
+{
+    FakeResolver fake;
+    Cache::Clock::time_point t = Cache::Clock::now();
+    Cache cache(std::chrono::seconds(60), std::chrono::seconds(10), 16,
+                fake.Func(), [&t]() { return t; });
+
+    Cache::Result r = cache.Lookup("bad.example.org");
+    EXPECT_TRUE(r.addresses.empty());
+    EXPECT_EQ(r.error, "Name or service not known");
+    cache.Lookup("bad.example.org");
+    EXPECT_EQ(fake.calls, 1u);
+
+    t += std::chrono::seconds(11);
+    cache.Lookup("bad.example.org");
+    EXPECT_EQ(fake.calls, 2u);
+}
+
+
+TEST(RemoteResolverCache, evicts_oldest)
+{
+    FakeResolver fake;
+    Cache::Clock::time_point t = Cache::Clock::now();
+    Cache cache(std::chrono::seconds(60), std::chrono::seconds(10), 2,
+                fake.Func(), [&t]() { return t; });
+
+    cache.Lookup("a.example.org");
+    t += std::chrono::seconds(1);
+    cache.Lookup("b.example.org");
+    t += std::chrono::seconds(1);
+    cache.Lookup("c.example.org");
+    EXPECT_EQ(cache.size(), 2u);
+
+    Cache::Result r;
+    EXPECT_FALSE(cache.Cached("a.example.org", r));
+    EXPECT_TRUE(cache.Cached("b.example.org", r));
+    EXPECT_TRUE(cache.Cached("c.example.org", r));
+}
+
+
+TEST(RemoteResolverCache, concurrent_lookups_resolve_once)
+{
+    std::atomic<unsigned int> calls{0};
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    Cache cache(std::chrono::seconds(60), std::chrono::seconds(10), 16,
+                [&](const std::string&)
+                {
+                    ++calls;
+                    released.wait();
+                    Cache::Result res;
+                    res.addresses = {"198.51.100.7"};
+                    return res;
+                });
+
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> ok{0};
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&]()
+                             {
+                                 if (cache.Lookup("vpn.example.org").addresses.size() == 1)
+                                 {
+                                     ++ok;
+                                 }
+                             });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release.set_value();
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_EQ(calls, 1u);
+    EXPECT_EQ(ok, 8u);
+}
+
+
+TEST(RemoteResolverCache, numeric_address)
+{
+    Cache::Result r = Cache::SystemResolve("192.0.2.10");
+    ASSERT_EQ(r.addresses.size(), 1u);
+    EXPECT_EQ(r.addresses[0], "192.0.2.10");
+}
+
+} // namespace unittest
@@ -0,0 +1,76 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-routebundle.cpp
+ *
+ * @brief  Unit tests for NetCfg::RouteBundles
+ */
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-routebundle.hpp"
+
+namespace unittest {
+
+using namespace NetCfg;
+
+TEST(RouteBundles, join_leave)
+{
+    RouteBundles rb;
+    EXPECT_TRUE(rb.Join("b|254|10.0.0.0/8", 12, "10.8.0.1"));
+    EXPECT_TRUE(rb.Join("b|254|10.0.0.0/8", 7, "10.9.0.1"));
+    EXPECT_TRUE(rb.Join("b|254|fd00::/8", 7, ""));
+    EXPECT_EQ(rb.size(), 2u);
+
+    // Next hops are ordered by the interface index
+    auto nh = rb.Nexthops("b|254|10.0.0.0/8");
+    ASSERT_EQ(nh.size(), 2u);
+    EXPECT_EQ(nh[0].ifindex, 7u);
+    EXPECT_EQ(nh[0].gateway, "10.9.0.1");
+    EXPECT_EQ(nh[1].ifindex, 12u);
+
+    // Joining again only updates the gateway
+    EXPECT_TRUE(rb.Join("b|254|10.0.0.0/8", 12, "10.8.0.5"));
+    nh = rb.Nexthops("b|254|10.0.0.0/8");
+    ASSERT_EQ(nh.size(), 2u);
+    EXPECT_EQ(nh[1].gateway, "10.8.0.5");
+
+    rb.Leave("b|254|10.0.0.0/8", 7);
+    rb.Leave("b|254|10.0.0.0/8", 99);
+    EXPECT_EQ(rb.Nexthops("b|254|10.0.0.0/8").size(), 1u);
+    rb.Leave("b|254|10.0.0.0/8", 12);
+    EXPECT_TRUE(rb.Nexthops("b|254|10.0.0.0/8").empty());
+    EXPECT_EQ(rb.size(), 1u);
+}
+
+
+TEST(RouteBundles, max_members)
+{
+    RouteBundles rb;
+    const size_t max = RouteBundles::MaxMembers;
+    for (unsigned int i = 1; i <= max; ++i)
+    {
+        EXPECT_TRUE(rb.Join("r", i, ""));
+    }
+    EXPECT_FALSE(rb.Join("r", 1000, ""));
+    EXPECT_TRUE(rb.Join("r", 1, "10.0.0.1"));
+    EXPECT_EQ(rb.Nexthops("r").size(), max);
+}
+
+} // namespace unittest
@@ -0,0 +1,105 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-routeset.cpp
+ *
+ * @brief  Unit tests for NetCfg::RouteSet
+ */
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-routeset.hpp"
+
+namespace unittest {
+
+using namespace NetCfg;
+
+TEST(RouteSet, add_remove)
+{
+    RouteSet rs;
+    EXPECT_TRUE(rs.empty());
+    EXPECT_TRUE(rs.Add(RouteEntry("10.0.0.0", 8, false)));
+    EXPECT_FALSE(rs.Add(RouteEntry("10.0.0.0", 8, false)));
+    EXPECT_TRUE(rs.Add(RouteEntry("10.0.0.0", 16, false)));
+    EXPECT_TRUE(rs.Add(RouteEntry("10.0.0.0", 8, false, true)));
+    EXPECT_TRUE(rs.Add(RouteEntry("fd00::", 8, true)));
+    EXPECT_EQ(rs.size(), 4);
+
+    EXPECT_TRUE(rs.Contains(RouteEntry("10.0.0.0", 16, false)));
+    EXPECT_FALSE(rs.Contains(RouteEntry("10.0.0.0", 16, true)));
+
+    EXPECT_TRUE(rs.Remove(RouteEntry("10.0.0.0", 8, false, true)));
+    EXPECT_FALSE(rs.Remove(RouteEntry("10.0.0.0", 8, false, true)));
+    EXPECT_EQ(rs.size(), 3);
+    EXPECT_TRUE(rs.Contains(RouteEntry("10.0.0.0", 8, false)));
+
+    rs.Clear();
+    EXPECT_TRUE(rs.empty());
+}
+
+
+TEST(RouteSet, compare)
+{
+    RouteSet current;
+    current.Add(RouteEntry("10.0.0.0", 8, false));
+    current.Add(RouteEntry("192.168.1.0", 24, false));
+    current.Add(RouteEntry("fd00::", 8, true));
+
+    RouteSet target;
+    target.Add(RouteEntry("10.0.0.0", 8, false));
+    target.Add(RouteEntry("192.168.2.0", 24, false));
+    target.Add(RouteEntry("fd00::", 8, true));
+
+    RouteSet::Diff diff = current.Compare(target);
+    ASSERT_EQ(diff.added.size(), 1);
+    ASSERT_EQ(diff.removed.size(), 1);
+    EXPECT_EQ(diff.added[0].str(), "192.168.2.0/24");
+    EXPECT_EQ(diff.removed[0].str(), "192.168.1.0/24");
+
+    EXPECT_TRUE(current.Compare(current).empty());
+
+    diff = RouteSet().Compare(target);
+    EXPECT_EQ(diff.added.size(), 3);
+    EXPECT_TRUE(diff.removed.empty());
+}
+
+
+TEST(RouteSet, large_set)
+{
+    RouteSet current;
+    RouteSet target;
+    for (unsigned int i = 0; i < 5000; ++i)
+    {
+        std::string net = "10." + std::to_string(i / 256) + "."
+                          + std::to_string(i % 256) + ".0";
+        current.Add(RouteEntry(net, 24, false));
+        if (i % 10)
+        {
+            target.Add(RouteEntry(net, 24, false));
+        }
+    }
+    target.Add(RouteEntry("172.16.0.0", 12, false));
+
+    RouteSet::Diff diff = current.Compare(target);
+    EXPECT_EQ(diff.added.size(), 1);
+    EXPECT_EQ(diff.removed.size(), 500);
+}
+
+} // namespace unittest
@@ -0,0 +1,136 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-tun-pool.cpp
+ *
+ * @brief  Unit tests for NetCfg::TunPool, using fake devices
+ */
+
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-exception.hpp"
+#include "netcfg/tun-pool.hpp"
+
+namespace unittest {
+
+using namespace NetCfg;
+
+/**
+ *  Fake device operations, recording which devices exist
+ */
+struct FakeDevices
+{
+    std::mutex mtx;
+    int next = 0;
+    std::set<int> pooled;
+    std::set<int> discarded;
+    std::atomic<bool> fail_create{false};
+    std::atomic<unsigned int> create_calls{0};
+
+    TunPool::Operations Ops()
+    {
+        return {
+            [this]()
+            {
+                ++create_calls;
+                if (fail_create)
+                {
+                    throw NetCfgException("create failed");
+                }
+                std::lock_guard<std::mutex> guard(mtx);
+                TunPool::Device d;
+                d.fd = next++;
+                d.name = "pool" + std::to_string(d.fd);
+                pooled.insert(d.fd);
+                return d;
+            },
+            [this](const TunPool::Device& d)
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                pooled.erase(d.fd);
+                return "tun" + std::to_string(d.fd);
+            },
+            [this](const TunPool::Device& d)
+            {
+                std::lock_guard<std::mutex> guard(mtx);
+                pooled.erase(d.fd);
+                discarded.insert(d.fd);
+            }
+        };
+    }
+};
+
+
+static bool wait_available(const TunPool& pool, const size_t count)
+{
+    for (int i = 0; i < 500; ++i)
+    {
+        if (pool.GetAvailable() == count)
+        {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return false;
+}
+
+
+TEST(TunPool, take_and_replenish)
+{
+    FakeDevices fake;
+    {
+        TunPool pool(3, fake.Ops());
+        ASSERT_TRUE(wait_available(pool, 3));
+
+        EXPECT_EQ(pool.Take(), "tun0");
+        EXPECT_EQ(pool.Take(), "tun1");
+
+        // Taken devices are replaced
+        ASSERT_TRUE(wait_available(pool, 3));
+        EXPECT_EQ(pool.Take(), "tun2");
+        ASSERT_TRUE(wait_available(pool, 3));
+        EXPECT_EQ(fake.create_calls, 6u);
+    }
+
+    // The devices left in the pool are removed with it
+    EXPECT_TRUE(fake.pooled.empty());
+    EXPECT_EQ(fake.discarded, (std::set<int>{3, 4, 5}));
+}
+
+
+TEST(TunPool, create_failure)
+{
+    FakeDevices fake;
+    fake.fail_create = true;
+    TunPool pool(2, fake.Ops());
+
+    // Failures are retried later, not in a tight loop
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(fake.create_calls, 1u);
+    EXPECT_EQ(pool.GetAvailable(), 0u);
+    EXPECT_EQ(pool.Take(), "");
+}
+
+} // namespace unittest
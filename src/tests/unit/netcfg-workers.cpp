@@ -0,0 +1,153 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   netcfg-workers.cpp
+ *
+ * @brief  Unit test for NetCfgWorkerPool and NetCfgRoutingLock
+ */
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "netcfg/netcfg-workers.hpp"
+
+namespace unittest {
+
+TEST(NetCfgWorkerPool, strand_order)
+{
+    std::vector<unsigned int> res_a;
+    std::vector<unsigned int> res_b;
+    {
+        NetCfgWorkerPool pool(4);
+        ASSERT_EQ(pool.GetThreadCount(), 4u);
+
+        NetCfgWorkerPool::Strand::Ptr a = pool.NewStrand();
+        NetCfgWorkerPool::Strand::Ptr b = pool.NewStrand();
+        for (unsigned int i = 0; i < 100; i++)
+        {
+            a->Post([&res_a, i]() { res_a.push_back(i); });
+            b->Post([&res_b, i]() { res_b.push_back(i); });
+        }
+        // The destructor completes all queued operations
+    }
+
+    ASSERT_EQ(res_a.size(), 100u);
+    ASSERT_EQ(res_b.size(), 100u);
+    for (unsigned int i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(res_a[i], i);
+        EXPECT_EQ(res_b[i], i);
+    }
+}
+
+
+TEST(NetCfgWorkerPool, parallel_strands)
+{
+    NetCfgWorkerPool pool(2);
+    NetCfgWorkerPool::Strand::Ptr a = pool.NewStrand();
+    NetCfgWorkerPool::Strand::Ptr b = pool.NewStrand();
+
+    // The operation on 'a' can only complete if the operation
+    // on 'b' runs at the same time
+    std::atomic<bool> a_started{false};
+    std::atomic<bool> b_done{false};
+    a->Post([&]()
+            {
+                a_started = true;
+                while (!b_done)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            });
+    b->Post([&]()
+            {
+                while (!a_started)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                b_done = true;
+            });
+
+    auto start = std::chrono::steady_clock::now();
+    while (!b_done && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(b_done);
+    b_done = true;
+}
+
+
+TEST(NetCfgWorkerPool, no_threads)
+{
+    NetCfgWorkerPool pool(0);
+    NetCfgWorkerPool::Strand::Ptr s = pool.NewStrand();
+
+    std::thread::id caller = std::this_thread::get_id();
+    bool run = false;
+    s->Post([&]()
+            {
+                run = (std::this_thread::get_id() == caller);
+            });
+    EXPECT_TRUE(run);
+
+    // Exceptions must not escape Post()
+    EXPECT_NO_THROW(s->Post([]() { throw std::runtime_error("test"); }));
+}
+
+
+TEST(NetCfgRoutingLock, exclusive)
+{
+    NetCfgRoutingLock lock;
+    std::atomic<unsigned int> active{0};
+    std::atomic<bool> overlap{false};
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&, i]()
+                             {
+                                 bool excl = (0 == i % 2);
+                                 for (unsigned int n = 0; n < 50; n++)
+                                 {
+                                     NetCfgRoutingLock::Guard guard(lock, excl);
+                                     unsigned int cur = ++active;
+                                     if (excl && cur > 1)
+                                     {
+                                         overlap = true;
+                                     }
+                                     std::this_thread::yield();
+                                     --active;
+                                 }
+                             });
+    }
+    for (auto& th : threads)
+    {
+        th.join();
+    }
+    EXPECT_FALSE(overlap);
+    EXPECT_EQ(active, 0u);
+}
+
+} // namespace unittest
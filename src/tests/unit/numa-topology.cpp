@@ -0,0 +1,101 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   numa-topology.cpp
+ *
+ * @brief  Unit test for NumaTopology, using a fake sysfs tree in a
+ *         temporary directory
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "common/numa-topology.hpp"
+#include "common/thread-scheduling.hpp"
+
+namespace unittest {
+
+class NumaTopologyTest : public ::testing::Test
+{
+protected:
+    std::string root;
+
+    void SetUp() override
+    {
+        char tmpl[] = "/tmp/numa-topology-XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        root = tmpl;
+
+        write("/sys/devices/system/node/online", "0-1\n");
+        write("/sys/devices/system/node/node0/cpulist", "0-7,16-23\n");
+        write("/sys/devices/system/node/node1/cpulist", "8-15,24-31\n");
+        write("/sys/class/net/eth0/device/numa_node", "1\n");
+        write("/sys/class/net/eth1/device/numa_node", "-1\n");
+    }
+
+    void TearDown() override
+    {
+        std::string cmd = "rm -rf '" + root + "'";
+        ASSERT_EQ(system(cmd.c_str()), 0);
+    }
+
+    void write(const std::string& path, const std::string& content)
+    {
+        std::string full = root + path;
+        for (size_t p = full.find('/', root.size() + 1);
+             p != std::string::npos; p = full.find('/', p + 1))
+        {
+            mkdir(full.substr(0, p).c_str(), 0755);
+        }
+        std::ofstream(full) << content;
+    }
+};
+
+
+TEST_F(NumaTopologyTest, nodes)
+{
+    NumaTopology numa(root);
+    EXPECT_EQ(numa.Nodes(), std::set<unsigned int>({0, 1}));
+    EXPECT_EQ(numa.NodeCPUs(1).size(), 16u);
+    EXPECT_EQ(*numa.NodeCPUs(1).begin(), 8u);
+    EXPECT_TRUE(numa.NodeCPUs(2).empty());
+
+    EXPECT_EQ(numa.DeviceNode("eth0"), 1);
+    EXPECT_EQ(numa.DeviceNode("eth1"), -1);
+    EXPECT_EQ(numa.DeviceNode("tun0"), -1);
+}
+
+
+TEST(NumaTopology, parse_node)
+{
+    EXPECT_EQ(NumaTopology::ParseNode("auto"), -1);
+    EXPECT_EQ(NumaTopology::ParseNode("3"), 3);
+    EXPECT_THROW(NumaTopology::ParseNode("-1"), ThreadSchedulingException);
+    EXPECT_THROW(NumaTopology::ParseNode(""), ThreadSchedulingException);
+    EXPECT_THROW(NumaTopology::ParseNode("node1"), ThreadSchedulingException);
+}
+
+} // namespace unittest
@@ -0,0 +1,78 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   ovpn3cli-completion-cache.cpp
+ *
+ * @brief  Unit tests for CompletionCache
+ */
+
+#include <gtest/gtest.h>
+
+#include <utime.h>
+
+#include "ovpn3cli/completion-cache.hpp"
+
+namespace unittest {
+
+TEST(CompletionCache, lookup)
+{
+    char tmpl[] = "/tmp/completion-cache-test.XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    const std::string dir = std::string(tmpl) + "/cache";
+
+    CompletionCache cache(dir, 30);
+    ASSERT_TRUE(cache.Usable());
+
+    std::string v;
+    EXPECT_FALSE(cache.Lookup("config-names", 7, v));
+
+    cache.Store("config-names", 7, "vpn1 vpn2 ");
+    EXPECT_TRUE(cache.Lookup("config-names", 7, v));
+    EXPECT_EQ(v, "vpn1 vpn2 ");
+
+    // A changed counter invalidates the value
+    EXPECT_FALSE(cache.Lookup("config-names", 8, v));
+    cache.Store("config-names", 8, "");
+    EXPECT_TRUE(cache.Lookup("config-names", 8, v));
+    EXPECT_EQ(v, "");
+
+    // So does the age of the value
+    const std::string fname = dir + "/config-names";
+    struct utimbuf old = {time(nullptr) - 60, time(nullptr) - 60};
+    ASSERT_EQ(utime(fname.c_str(), &old), 0);
+    EXPECT_FALSE(cache.Lookup("config-names", 8, v));
+
+    // Keys must not escape the cache directory
+    cache.Store("../escape", 1, "x");
+    EXPECT_FALSE(cache.Lookup("../escape", 1, v));
+    EXPECT_NE(access((std::string(tmpl) + "/escape").c_str(), F_OK), 0);
+
+    // A directory others can access is not used
+    ASSERT_EQ(chmod(dir.c_str(), 0755), 0);
+    CompletionCache open_cache(dir, 30);
+    EXPECT_FALSE(open_cache.Usable());
+    open_cache.Store("session-paths", 1, "/x");
+    EXPECT_FALSE(open_cache.Lookup("session-paths", 1, v));
+
+    unlink(fname.c_str());
+    rmdir(dir.c_str());
+    rmdir(tmpl);
+}
+
+} // namespace unittest
@@ -0,0 +1,109 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   ovpn3cli-top-table.cpp
+ *
+ * @brief  Unit tests for TopTable
+ */
+
+#include <gtest/gtest.h>
+
+#include "ovpn3cli/top-table.hpp"
+
+namespace unittest {
+
+TEST(TopTable, rates)
+{
+    TopTable t;
+    TopTable::Row& r = t.Get("/s/1");
+    TopTable::UpdateBytes(r, 10.0, 1000, 2000);
+    EXPECT_LT(r.rate_in, 0);
+
+    TopTable::UpdateBytes(r, 12.0, 3000, 2000);
+    EXPECT_DOUBLE_EQ(r.rate_in, 1000.0);
+    EXPECT_DOUBLE_EQ(r.rate_out, 0.0);
+
+    // The same sample from another source is ignored
+    TopTable::UpdateBytes(r, 12.0, 3000, 2000);
+    EXPECT_DOUBLE_EQ(r.rate_in, 1000.0);
+
+    // Counters restarting keeps the previous rate
+    TopTable::UpdateBytes(r, 13.0, 10, 10);
+    EXPECT_DOUBLE_EQ(r.rate_in, 1000.0);
+    TopTable::UpdateBytes(r, 14.0, 20, 10);
+    EXPECT_DOUBLE_EQ(r.rate_in, 10.0);
+}
+
+
+TEST(TopTable, sorting)
+{
+    TopTable t;
+    t.Get("/s/a").name = "alpha";
+    t.Get("/s/b").name = "bravo";
+    t.Get("/s/c").name = "charlie";
+    t.Get("/s/a").rate_in = 10;
+    t.Get("/s/b").rate_in = 500;
+    t.Get("/s/a").reconnects = 3;
+    t.Get("/s/c").reconnects = 7;
+
+    auto rows = t.Sorted(TopTable::SortKey::RATE);
+    ASSERT_EQ(rows.size(), 3u);
+    EXPECT_EQ(rows[0].name, "bravo");
+    EXPECT_EQ(rows[1].name, "alpha");
+    EXPECT_EQ(rows[2].name, "charlie");   // Unknown rate
+
+    rows = t.Sorted(TopTable::SortKey::RATE, true);
+    EXPECT_EQ(rows[0].name, "alpha");
+    EXPECT_EQ(rows[2].name, "charlie");   // Unknown is still last
+
+    rows = t.Sorted(TopTable::SortKey::RECONNECTS);
+    EXPECT_EQ(rows[0].name, "charlie");
+
+    rows = t.Sorted(TopTable::ParseSortKey("name"), true);
+    EXPECT_EQ(rows[0].name, "charlie");
+    EXPECT_THROW(TopTable::ParseSortKey("bogus"), std::invalid_argument);
+    EXPECT_EQ(TopTable::SortKeyName(TopTable::SortKey::RTT), "rtt");
+}
+
+
+TEST(TopTable, retain_and_render)
+{
+    TopTable t;
+    t.Get("/s/a").name = "alpha";
+    t.Get("/s/b").name = "bravo";
+    t.Retain({"/s/b", "/s/x"});
+    EXPECT_EQ(t.size(), 1u);
+    EXPECT_TRUE(t.Contains("/s/b"));
+    EXPECT_FALSE(t.Contains("/s/x"));
+
+    t.Get("/s/b").rate_out = 1536;
+    std::string out = t.Render(TopTable::SortKey::NAME);
+    EXPECT_EQ(0u, out.find("SESSION"));
+    EXPECT_NE(std::string::npos, out.find("bravo"));
+    EXPECT_NE(std::string::npos, out.find("1.5K"));
+
+    out = t.Render(TopTable::SortKey::NAME, false, 20);
+    EXPECT_EQ(out.find('\n'), 20u);
+
+    EXPECT_EQ(TopTable::FormatRate(-1), "-");
+    EXPECT_EQ(TopTable::FormatRate(512), "512B");
+    EXPECT_EQ(TopTable::FormatRate(3 * 1024 * 1024), "3.0M");
+}
+
+} // namespace unittest
@@ -0,0 +1,82 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   path-mtu.cpp
+ *
+ * @brief  Unit tests for PathMTU
+ */
+
+#include <gtest/gtest.h>
+
+#include "client/path-mtu.hpp"
+
+namespace unittest {
+
+TEST(PathMTU, calculate)
+{
+    PathMTU::Result r = PathMTU::Calculate(1500, false, 0);
+    EXPECT_EQ(r.path_mtu, 1500u);
+    EXPECT_EQ(r.tun_mtu, 1500u - 28 - PathMTU::DataChannelOverhead);
+    EXPECT_EQ(r.mssfix, r.tun_mtu - 40);
+
+    // IPv6 transport headers are 20 bytes larger
+    PathMTU::Result r6 = PathMTU::Calculate(1500, true, 0);
+    EXPECT_EQ(r6.tun_mtu, r.tun_mtu - 20);
+}
+
+
+TEST(PathMTU, calculate_limits)
+{
+    // Never above the MTU the server asked for
+    EXPECT_EQ(PathMTU::Calculate(9000, false, 1500).tun_mtu, 1500u);
+
+    // Never below the minimum, regardless of the path
+    EXPECT_EQ(PathMTU::Calculate(600, false, 0).tun_mtu, PathMTU::MinTunnelMTU);
+    EXPECT_EQ(PathMTU::Calculate(68, true, 1500).tun_mtu, PathMTU::MinTunnelMTU);
+}
+
+
+TEST(PathMTU, probe_loopback)
+{
+    bool protected_called = false;
+    unsigned int mtu = PathMTU::Probe("127.0.0.1", false,
+                                      [&protected_called](int sd)
+                                      {
+                                          EXPECT_GE(sd, 0);
+                                          protected_called = true;
+                                      },
+                                      std::chrono::milliseconds(10), 2);
+    EXPECT_TRUE(protected_called);
+    EXPECT_GE(mtu, 1500u);
+}
+
+
+TEST(PathMTU, probe_errors)
+{
+    EXPECT_THROW(PathMTU::Probe("not-an-address", false), PathMTUException);
+    EXPECT_THROW(PathMTU::Probe("127.0.0.1", true), PathMTUException);
+    EXPECT_THROW(PathMTU::Probe("127.0.0.1", false,
+                                [](int)
+                                {
+                                    throw PathMTUException("protect failed");
+                                }),
+                 PathMTUException);
+}
+
+} // namespace unittest
@@ -0,0 +1,146 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   path-quality.cpp
+ *
+ * @brief  Unit tests for PathQuality and PingSocket
+ */
+
+#include <gtest/gtest.h>
+
+#include "client/path-quality.hpp"
+
+namespace unittest {
+
+using us = std::chrono::microseconds;
+
+
+TEST(PathQuality, empty)
+{
+    PathQuality pq;
+    PathQuality::Summary s = pq.GetSummary();
+    EXPECT_EQ(s.samples, 0u);
+    EXPECT_EQ(s.p50, 0u);
+    EXPECT_EQ(s.p99, 0u);
+    EXPECT_EQ(s.loss_ppm, 0u);
+
+    const size_t buckets = PathQuality::Buckets;
+    EXPECT_EQ(pq.GetHistogram().size(), buckets);
+    EXPECT_EQ(pq.GetStatsValues().size(), PathQuality::GetStatsKeys().size());
+}
+
+
+TEST(PathQuality, percentiles)
+{
+    PathQuality pq;
+    // 90 probes around 10ms, 9 around 50ms and one at 200ms
+    for (int i = 0; i < 90; ++i)
+    {
+        pq.AddSample(us(10000 + i));
+    }
+    for (int i = 0; i < 9; ++i)
+    {
+        pq.AddSample(us(50000));
+    }
+    pq.AddSample(us(200000));
+
+    PathQuality::Summary s = pq.GetSummary();
+    EXPECT_EQ(s.samples, 100u);
+    EXPECT_EQ(s.min, 10000u);
+    EXPECT_EQ(s.max, 200000u);
+
+    // The estimates stay within the power of two bucket of the sample
+    EXPECT_GE(s.p50, 8192u);
+    EXPECT_LT(s.p50, 16384u);
+    EXPECT_LT(s.p90, 16384u);
+    EXPECT_GE(s.p99, 32768u);
+    EXPECT_LT(s.p99, 65536u);
+    EXPECT_LE(s.p50, s.p90);
+    EXPECT_LE(s.p90, s.p99);
+
+    uint64_t total = 0;
+    for (auto c : pq.GetHistogram())
+    {
+        total += c;
+    }
+    EXPECT_EQ(total, 100u);
+}
+
+
+TEST(PathQuality, jitter_and_loss)
+{
+    PathQuality pq;
+    for (int i = 0; i < 200; ++i)
+    {
+        pq.AddSample(us(20000));
+    }
+    EXPECT_EQ(pq.GetSummary().jitter, 0u);
+
+    // Alternating between 10ms and 30ms converges towards 20ms jitter
+    for (int i = 0; i < 200; ++i)
+    {
+        pq.AddSample(us(i % 2 ? 30000 : 10000));
+    }
+    PathQuality::Summary s = pq.GetSummary();
+    EXPECT_GT(s.jitter, 19000u);
+    EXPECT_LE(s.jitter, 20000u);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        pq.AddLoss();
+    }
+    s = pq.GetSummary();
+    EXPECT_EQ(s.lost, 100u);
+    EXPECT_EQ(s.loss_ppm, 200000u);
+
+    pq.Reset();
+    s = pq.GetSummary();
+    EXPECT_EQ(s.samples, 0u);
+    EXPECT_EQ(s.lost, 0u);
+    EXPECT_EQ(s.jitter, 0u);
+}
+
+
+TEST(PingSocket, errors)
+{
+    EXPECT_THROW(PingSocket("not-an-address", false), PathQualityException);
+    EXPECT_THROW(PingSocket("127.0.0.1", true), PathQualityException);
+}
+
+
+TEST(PingSocket, probe_loopback)
+{
+    std::unique_ptr<PingSocket> ping;
+    try
+    {
+        ping.reset(new PingSocket("127.0.0.1", false));
+    }
+    catch (const PathQualityException&)
+    {
+        // ICMP sockets are not allowed for this group by the
+        // net.ipv4.ping_group_range sysctl; nothing to test
+        return;
+    }
+
+    std::chrono::microseconds rtt = ping->Probe(std::chrono::milliseconds(1000));
+    EXPECT_GE(rtt.count(), 0);
+    EXPECT_LT(rtt.count(), 1000000);
+}
+
+} // namespace unittest
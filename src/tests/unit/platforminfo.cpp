@@ -60,3 +60,25 @@ TEST(PlatformInfo, uname)
     ASSERT_TRUE(s.str().find("generic:") == 0)
         << "PlatformInfo uname() failed";
 }
+
+
+TEST(PlatformInfo, uname_str)
+{
+    ASSERT_TRUE(PlatformInfo::UnameStr().find("generic:") == 0)
+        << "PlatformInfo::UnameStr() failed";
+}
+
+
+TEST(PlatformInfo, cached)
+{
+    PlatformInfo::SetCached("test:platform/1.0");
+
+    std::string platform;
+    ASSERT_TRUE(PlatformInfo::TryGetCached(platform));
+    EXPECT_EQ(platform, "test:platform/1.0");
+    EXPECT_EQ(PlatformInfo::GetCached(0), "test:platform/1.0");
+
+    // A lookup after SetCached() must not replace the value
+    PlatformInfo::StartLookup(nullptr);
+    EXPECT_EQ(PlatformInfo::GetCached(100), "test:platform/1.0");
+}
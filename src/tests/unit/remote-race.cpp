@@ -0,0 +1,204 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   remote-race.cpp
+ *
+ * @brief  Unit tests for RemoteRace, using servers on the loopback
+ *         interface
+ */
+
+#include <thread>
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "client/remote-race.hpp"
+
+namespace unittest {
+
+/**
+ *  Opens a socket bound to a random loopback port
+ */
+static int open_local(int type, std::string& port)
+{
+    int sd = socket(AF_INET, type, 0);
+    struct sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sd, (struct sockaddr *) &sa, sizeof(sa));
+    socklen_t len = sizeof(sa);
+    getsockname(sd, (struct sockaddr *) &sa, &len);
+    port = std::to_string(ntohs(sa.sin_port));
+    return sd;
+}
+
+
+TEST(RemoteRace, tcp_first_answering)
+{
+    std::string closed_port;
+    close(open_local(SOCK_STREAM, closed_port));
+
+    std::string open_port;
+    int listener = open_local(SOCK_STREAM, open_port);
+    ASSERT_EQ(listen(listener, 4), 0);
+
+    std::vector<RaceRemote> remotes = {
+        {"127.0.0.1", closed_port, "tcp"},
+        {"127.0.0.1", open_port, "tcp-client"}
+    };
+    RemoteRace::Selection sel = RemoteRace::Race(remotes,
+                                                 std::chrono::milliseconds(2000),
+                                                 true);
+    EXPECT_EQ(sel.index, 1);
+    EXPECT_EQ(sel.address, "127.0.0.1");
+    close(listener);
+}
+
+
+TEST(RemoteRace, udp_probe)
+{
+    std::string port;
+    int sd = open_local(SOCK_DGRAM, port);
+    std::thread server([sd]()
+                       {
+                           unsigned char buf[64];
+                           struct sockaddr_in from = {};
+                           socklen_t len = sizeof(from);
+                           ssize_t r = recvfrom(sd, buf, sizeof(buf), 0,
+                                                (struct sockaddr *) &from, &len);
+                           if (r == 14 && buf[0] == (7 << 3))
+                           {
+                               buf[0] = (8 << 3);
+                               sendto(sd, buf, r, 0,
+                                      (struct sockaddr *) &from, len);
+                           }
+                       });
+
+    std::vector<RaceRemote> remotes = {{"127.0.0.1", port, "udp"}};
+
+    // UDP remotes are not probed if the server would drop the probe
+    RemoteRace::Selection sel = RemoteRace::Race(remotes,
+                                                 std::chrono::milliseconds(200),
+                                                 false);
+    EXPECT_EQ(sel.index, -1);
+
+    sel = RemoteRace::Race(remotes, std::chrono::milliseconds(2000), true);
+    EXPECT_EQ(sel.index, 0);
+    server.join();
+    close(sd);
+}
+
+
+TEST(RemoteRace, next_selection)
+{
+    std::string closed_port;
+    close(open_local(SOCK_STREAM, closed_port));
+    std::string open_port;
+    int listener = open_local(SOCK_STREAM, open_port);
+    ASSERT_EQ(listen(listener, 8), 0);
+
+    std::vector<RaceRemote> remotes = {
+        {"127.0.0.1", closed_port, "tcp"},
+        {"127.0.0.1", closed_port, "tcp"},
+        {"127.0.0.1", open_port, "tcp"},
+        {"127.0.0.1", closed_port, "tcp"}
+    };
+    RemoteRace race(remotes, 2, std::chrono::milliseconds(1000), true);
+
+    // The first window has no answering remote, the second one has
+    RemoteRace::Selection sel = race.Next();
+    EXPECT_EQ(sel.index, 2);
+    EXPECT_FALSE(sel.address.empty());
+
+    // After a connection, the same remote is tried first ...
+    race.Connected();
+    sel = race.Next();
+    EXPECT_EQ(sel.index, 2);
+
+    // ... and if that fails, the race continues from the next remote
+    sel = race.Next();
+    EXPECT_EQ(sel.index, 2);
+    close(listener);
+
+    // Nothing answers; the remotes are handed out in order
+    sel = race.Next();
+    EXPECT_TRUE(sel.address.empty());
+    EXPECT_GE(sel.index, 0);
+}
+
+
+
+TEST(RemoteRace, standby_failover)
+{
+    std::string closed_port;
+    close(open_local(SOCK_STREAM, closed_port));
+    std::string open_port;
+    int listener = open_local(SOCK_STREAM, open_port);
+    ASSERT_EQ(listen(listener, 8), 0);
+
+    std::vector<RaceRemote> remotes = {
+        {"127.0.0.1", open_port, "tcp"},
+        {"127.0.0.1", closed_port, "tcp"},
+        {"127.0.0.1", open_port, "tcp"}
+    };
+    RemoteRace race(remotes, 1, std::chrono::milliseconds(1000), true);
+    race.EnableStandby(std::chrono::milliseconds(50));
+    EXPECT_EQ(race.Next().index, 0);
+    race.Connected();
+
+    // The remote after the connected one does not answer, so the
+    // following one becomes the standby
+    for (int i = 0; i < 100 && race.GetStandby().index < 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(race.GetStandby().index, 2);
+
+    // On failure, the standby is used right away
+    RemoteRace::Selection sel = race.Next();
+    EXPECT_EQ(sel.index, 2);
+    EXPECT_EQ(sel.address, "127.0.0.1");
+    EXPECT_EQ(race.GetStandby().index, -1);
+    close(listener);
+}
+
+
+TEST(RemoteRace, prefer_without_race)
+{
+    std::vector<RaceRemote> remotes = {
+        {"192.0.2.1", "1194", "udp"},
+        {"192.0.2.2", "1194", "udp"},
+        {"192.0.2.3", "1194", "udp"}
+    };
+    RemoteRace race(remotes, 0, std::chrono::milliseconds(1000), true);
+    race.Prefer(1);
+
+    // The preferred remote comes first, then the rest in profile order
+    // without any probing
+    EXPECT_EQ(race.Next().index, 1);
+    EXPECT_EQ(race.Next().index, 2);
+    RemoteRace::Selection sel = race.Next();
+    EXPECT_EQ(sel.index, 0);
+    EXPECT_TRUE(sel.address.empty());
+}
+
+} // namespace unittest
@@ -0,0 +1,69 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   replay-scheduler.cpp
+ *
+ * @brief  Unit test for the call scheduling of the D-Bus trace replay
+ */
+
+#include <gtest/gtest.h>
+
+#include "tests/stress/replay-scheduler.hpp"
+
+namespace unittest {
+
+TEST(ReplayScheduler, speed_and_ordering)
+{
+    ReplayScheduler sched(10.0);
+    sched.Add(1, ":1.10", 1000000);
+    sched.Add(2, ":1.11", 500000);
+    sched.Add(3, ":1.10", 2000000);
+
+    EXPECT_FALSE(sched.Done());
+    EXPECT_EQ(sched.NextDue(0), 50000u);
+    EXPECT_TRUE(sched.Ready(49999).empty());
+
+    // Both first calls are due, in the recorded order
+    auto r = sched.Ready(120000);
+    ASSERT_EQ(r.size(), 2u);
+    EXPECT_EQ(r[0].id, 2u);
+    EXPECT_EQ(r[0].lag_usec, 70000u);
+    EXPECT_EQ(r[1].id, 1u);
+    EXPECT_EQ(r[1].lag_usec, 20000u);
+
+    // :1.10 has a call in progress, so its next call is held back
+    EXPECT_EQ(sched.NextDue(250000), UINT64_MAX);
+    EXPECT_TRUE(sched.Ready(250000).empty());
+
+    sched.Completed(":1.10");
+    EXPECT_EQ(sched.NextDue(150000), 50000u);
+    EXPECT_EQ(sched.NextDue(250000), 0u);
+    r = sched.Ready(250000);
+    ASSERT_EQ(r.size(), 1u);
+    EXPECT_EQ(r[0].id, 3u);
+    EXPECT_EQ(r[0].lag_usec, 50000u);
+
+    EXPECT_FALSE(sched.Done());
+    sched.Completed(":1.10");
+    sched.Completed(":1.11");
+    EXPECT_TRUE(sched.Done());
+    EXPECT_EQ(sched.NextDue(300000), UINT64_MAX);
+}
+
+} // namespace unittest
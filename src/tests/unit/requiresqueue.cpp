@@ -0,0 +1,96 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   requiresqueue.cpp
+ *
+ * @brief  Unit test for the batched RequiresQueue operations
+ */
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/requiresqueue.hpp"
+
+namespace unittest {
+
+static RequiresSlot response(unsigned int id, const std::string& value)
+{
+    RequiresSlot r;
+    r.type = ClientAttentionType::CREDENTIALS;
+    r.group = ClientAttentionGroup::USER_PASSWORD;
+    r.id = id;
+    r.value = value;
+    return r;
+}
+
+
+TEST(RequiresQueue, fetch_all_update_entries)
+{
+    RequiresQueue queue;
+    queue.RequireAdd(ClientAttentionType::CREDENTIALS,
+                     ClientAttentionGroup::USER_PASSWORD,
+                     "username", "Auth Username", false);
+    queue.RequireAdd(ClientAttentionType::CREDENTIALS,
+                     ClientAttentionGroup::USER_PASSWORD,
+                     "password", "Auth Password", true);
+
+    std::vector<RequiresSlot> pending = queue.QueueFetchAll();
+    ASSERT_EQ(pending.size(), 2u);
+    EXPECT_EQ(pending[0].name, "username");
+    EXPECT_EQ(pending[1].name, "password");
+    EXPECT_TRUE(pending[1].hidden_input);
+
+    queue.UpdateEntries({response(pending[0].id, "user"),
+                         response(pending[1].id, "secret")});
+    EXPECT_TRUE(queue.QueueAllDone());
+    EXPECT_TRUE(queue.QueueFetchAll().empty());
+    EXPECT_EQ(queue.GetResponse(ClientAttentionType::CREDENTIALS,
+                                ClientAttentionGroup::USER_PASSWORD,
+                                "password"),
+              "secret");
+}
+
+
+TEST(RequiresQueue, update_entries_atomic)
+{
+    RequiresQueue queue;
+    unsigned int id = queue.RequireAdd(ClientAttentionType::CREDENTIALS,
+                                       ClientAttentionGroup::USER_PASSWORD,
+                                       "username", "Auth Username", false);
+
+    // An unknown slot ID must reject the whole batch
+    EXPECT_THROW(queue.UpdateEntries({response(id, "user"),
+                                      response(id + 10, "bogus")}),
+                 RequiresQueueException);
+    EXPECT_EQ(queue.QueueFetchAll().size(), 1u);
+
+    // So does providing the same slot twice
+    EXPECT_THROW(queue.UpdateEntries({response(id, "user"),
+                                      response(id, "user")}),
+                 RequiresQueueException);
+    EXPECT_FALSE(queue.QueueAllDone());
+
+    queue.UpdateEntries({response(id, "user")});
+    EXPECT_THROW(queue.UpdateEntries({response(id, "again")}),
+                 RequiresQueueException);
+}
+
+} // namespace unittest
@@ -0,0 +1,73 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   resource-control.cpp
+ *
+ * @brief  Unit test for ResourceControl
+ */
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "common/resource-control.hpp"
+
+namespace unittest {
+
+TEST(ResourceControl, parse_size)
+{
+    EXPECT_EQ(ResourceControl::ParseSize("4096"), 4096u);
+    EXPECT_EQ(ResourceControl::ParseSize("64K"), 64u * 1024);
+    EXPECT_EQ(ResourceControl::ParseSize("512M"), 512u * 1024 * 1024);
+    EXPECT_EQ(ResourceControl::ParseSize("2G"), 2ull << 30);
+    EXPECT_EQ(ResourceControl::ParseSize("1T"), 1ull << 40);
+
+    for (const auto& invalid : {"", "0", "M", "12X", "1.5G", "-1",
+                                "99999999999999999999", "20000000T"})
+    {
+        EXPECT_THROW(ResourceControl::ParseSize(invalid), ResourceControlException)
+            << "'" << invalid << "'";
+    }
+}
+
+
+TEST(ResourceControl, settings)
+{
+    ResourceControl global;
+    EXPECT_TRUE(global.empty());
+    EXPECT_EQ(global.str(), "defaults");
+    global.SetCPUWeight("100");
+    global.SetMemoryMax("1G");
+
+    ResourceControl profile;
+    profile.SetCPUWeight("500");
+    profile.SetIOWeight("50");
+    EXPECT_THROW(profile.SetCPUWeight("0"), ResourceControlException);
+    EXPECT_THROW(profile.SetIOWeight("10001"), ResourceControlException);
+    EXPECT_THROW(profile.SetCPUWeight("high"), ResourceControlException);
+
+    global.Merge(profile);
+    EXPECT_EQ(global.GetCPUWeight(), 500u);
+    EXPECT_EQ(global.GetIOWeight(), 50u);
+    EXPECT_EQ(global.GetMemoryHigh(), 0u);
+    EXPECT_EQ(global.GetMemoryMax(), 1ull << 30);
+    EXPECT_EQ(global.str(), "CPUWeight=500, IOWeight=50, MemoryMax=1073741824");
+}
+
+} // namespace unittest
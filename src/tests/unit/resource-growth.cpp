@@ -0,0 +1,101 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   resource-growth.cpp
+ *
+ * @brief  Unit test for the growth detection of the soak test
+ */
+
+#include <gtest/gtest.h>
+
+#include "tests/stress/resource-growth.hpp"
+
+namespace unittest {
+
+TEST(ResourceGrowth, series)
+{
+    // Grows slowly and steadily after a warm-up spike
+    ResourceSeries leak(0.05, 0);
+    // Settles at a higher level after the warm-up
+    ResourceSeries plateau(0.05, 0);
+    // Fluctuates around a constant level
+    ResourceSeries noise(0.05, 0);
+    for (unsigned int t = 0; t < 120; ++t)
+    {
+        leak.Add(t * 60, (t < 10 ? 5000 : 1000 + t * 20));
+        plateau.Add(t * 60, (t < 10 ? 100 + t * 50 : 600));
+        noise.Add(t * 60, 1000 + (t % 7) * 30);
+    }
+
+    auto r = leak.Analyse(600);
+    EXPECT_TRUE(r.growing);
+    EXPECT_EQ(r.samples, 120u);
+    EXPECT_EQ(r.max, 5000u);
+    EXPECT_NEAR(r.slope_per_hour, 1200.0, 0.1);
+
+    r = plateau.Analyse(600);
+    EXPECT_FALSE(r.growing);
+    EXPECT_EQ(r.first, 100u);
+    EXPECT_EQ(r.last, 600u);
+
+    EXPECT_FALSE(noise.Analyse(600).growing);
+
+    // Growth within the tolerance is ignored
+    ResourceSeries small(0.10, 0);
+    for (unsigned int t = 0; t < 60; ++t)
+    {
+        small.Add(t, 1000 + t);
+    }
+    EXPECT_FALSE(small.Analyse(0).growing);
+
+    // Too few samples after the warm-up for a verdict
+    EXPECT_FALSE(leak.Analyse(115 * 60).growing);
+
+    leak.Clear();
+    EXPECT_EQ(leak.Analyse(0).samples, 0u);
+}
+
+
+TEST(ResourceGrowth, tracker)
+{
+    ResourceGrowthTracker tracker;
+    tracker.SetTolerance("", 0.5, 0);
+    tracker.SetTolerance("objects.", 0.0, 2);
+
+    for (unsigned int t = 0; t < 30; ++t)
+    {
+        tracker.Add("VmRSS", t, 1000 + t * 10);
+        tracker.Add("open_fds", t, 10 + t);
+        tracker.Add("objects.sessions", t, 10 + t / 3);
+        tracker.Add("objects.configs", t, 10 + t % 4);
+    }
+
+    const auto& series = tracker.GetSeries();
+    ASSERT_EQ(series.size(), 4u);
+    EXPECT_FALSE(series.at("VmRSS").Analyse(0).growing);
+    EXPECT_TRUE(series.at("open_fds").Analyse(0).growing);
+    EXPECT_TRUE(series.at("objects.sessions").Analyse(0).growing);
+    EXPECT_FALSE(series.at("objects.configs").Analyse(0).growing);
+
+    tracker.Clear();
+    EXPECT_EQ(series.at("VmRSS").Analyse(0).samples, 0u);
+    EXPECT_EQ(series.at("objects.sessions").Analyse(0).samples, 0u);
+}
+
+} // namespace unittest
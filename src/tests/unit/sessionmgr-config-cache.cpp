@@ -0,0 +1,104 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   sessionmgr-config-cache.cpp
+ *
+ * @brief  Unit tests for ConfigCache
+ */
+
+#include <gtest/gtest.h>
+
+#include "sessionmgr/config-cache.hpp"
+
+namespace unittest {
+
+TEST(ConfigCache, lookup_once)
+{
+    ConfigCache cache;
+    ConfigCache::Info info;
+    EXPECT_FALSE(cache.Lookup("/cfg/1", info));
+
+    uint64_t gen = 0;
+    ASSERT_TRUE(cache.StartLookup("/cfg/1", gen));
+    EXPECT_NE(gen, 0u);
+
+    // A second session for the same profile shares the pending lookup
+    uint64_t gen2 = 0;
+    EXPECT_FALSE(cache.StartLookup("/cfg/1", gen2));
+    EXPECT_FALSE(cache.Lookup("/cfg/1", info));
+
+    ConfigCache::Info res;
+    res.owner = 1000;
+    res.transfer_owner_session = true;
+    cache.Store("/cfg/1", gen, res);
+    ASSERT_TRUE(cache.Lookup("/cfg/1", info));
+    EXPECT_EQ(info.owner, 1000u);
+    EXPECT_TRUE(info.transfer_owner_session);
+    EXPECT_FALSE(cache.StartLookup("/cfg/1", gen2));
+}
+
+
+TEST(ConfigCache, invalidate)
+{
+    ConfigCache cache;
+    ConfigCache::Info res;
+    res.owner = 1000;
+
+    // A result of a lookup started before the change is dropped
+    uint64_t gen = 0;
+    ASSERT_TRUE(cache.StartLookup("/cfg/1", gen));
+    cache.Invalidate("/cfg/1");
+    cache.Store("/cfg/1", gen, res);
+    ConfigCache::Info info;
+    EXPECT_FALSE(cache.Lookup("/cfg/1", info));
+
+    ASSERT_TRUE(cache.StartLookup("/cfg/1", gen));
+    cache.Store("/cfg/1", gen, res);
+    EXPECT_TRUE(cache.Lookup("/cfg/1", info));
+    cache.Invalidate("/cfg/1");
+    EXPECT_FALSE(cache.Lookup("/cfg/1", info));
+
+    // Results of blocking lookups are stored right away
+    cache.Store("/cfg/2", 0, res);
+    EXPECT_TRUE(cache.Lookup("/cfg/2", info));
+    cache.Clear();
+    EXPECT_FALSE(cache.Lookup("/cfg/2", info));
+
+    // A failed lookup can be retried
+    ASSERT_TRUE(cache.StartLookup("/cfg/3", gen));
+    cache.LookupFailed("/cfg/3", gen);
+    EXPECT_TRUE(cache.StartLookup("/cfg/3", gen));
+}
+
+
+TEST(ConfigCache, expiry)
+{
+    ConfigCache cache(std::chrono::seconds(60));
+    auto now = ConfigCache::Clock::now();
+    ConfigCache::Info res;
+    cache.Store("/cfg/1", 0, res, now);
+
+    ConfigCache::Info info;
+    EXPECT_TRUE(cache.Lookup("/cfg/1", info, now + std::chrono::seconds(30)));
+    EXPECT_FALSE(cache.Lookup("/cfg/1", info, now + std::chrono::seconds(61)));
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+} // namespace unittest
@@ -0,0 +1,108 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   sessionmgr-connect-admission.cpp
+ *
+ * @brief  Unit tests for ConnectAdmission
+ */
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "sessionmgr/connect-admission.hpp"
+
+namespace unittest {
+
+TEST(ConnectAdmission, unlimited)
+{
+    ConnectAdmission adm;
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(adm.Request("/s/" + std::to_string(i), 0, nullptr));
+    }
+    EXPECT_EQ(adm.GetState().in_progress, 10u);
+    EXPECT_EQ(adm.GetState().queued, 0u);
+    EXPECT_TRUE(adm.Release("/s/1").empty());
+    EXPECT_EQ(adm.GetState().in_progress, 9u);
+    EXPECT_EQ(adm.Jitter(), 0u);
+}
+
+
+TEST(ConnectAdmission, queue_order)
+{
+    ConnectAdmission adm(2, 500);
+    std::vector<std::string> started;
+    auto start = [&started](const std::string& id)
+                 {
+                     return [&started, id]()
+                            {
+                                started.push_back(id);
+                            };
+                 };
+
+    EXPECT_TRUE(adm.Request("a", 0, start("a")));
+    EXPECT_TRUE(adm.Request("b", 0, start("b")));
+    EXPECT_FALSE(adm.Request("c", 0, start("c")));
+    EXPECT_FALSE(adm.Request("d", 5, start("d")));
+    EXPECT_FALSE(adm.Request("e", 0, start("e")));
+    EXPECT_FALSE(adm.Request("f", 0, start("f")));
+
+    // A session holding a slot keeps it; a queued one stays queued
+    EXPECT_TRUE(adm.Request("a", 0, start("a")));
+    EXPECT_FALSE(adm.Request("c", 0, start("c")));
+
+    auto st = adm.GetState();
+    EXPECT_EQ(st.max_concurrent, 2u);
+    EXPECT_EQ(st.in_progress, 2u);
+    EXPECT_EQ(st.queued, 4u);
+
+    // Higher priority first, then in queue order
+    for (auto& s : adm.Release("a"))
+    {
+        s();
+    }
+    for (auto& s : adm.Release("b"))
+    {
+        s();
+    }
+    EXPECT_EQ(started, std::vector<std::string>({"d", "c"}));
+    EXPECT_TRUE(adm.InProgress("d"));
+
+    // Leaving the queue does not admit anyone
+    EXPECT_TRUE(adm.Release("e").empty());
+    EXPECT_EQ(adm.GetState().queued, 1u);
+
+    // Raising the limit admits the rest
+    for (auto& s : adm.Configure(4, 500))
+    {
+        s();
+    }
+    EXPECT_EQ(started, std::vector<std::string>({"d", "c", "f"}));
+    EXPECT_EQ(adm.GetState().queued, 0u);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_LE(adm.Jitter(), 500u);
+    }
+}
+
+} // namespace unittest
@@ -0,0 +1,84 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   sessionmgr-reconnect-cache.cpp
+ *
+ * @brief  Unit tests for ReconnectCache
+ */
+
+#include <gtest/gtest.h>
+
+#include "sessionmgr/reconnect-cache.hpp"
+
+namespace unittest {
+
+TEST(ReconnectCache, take_once)
+{
+    ReconnectCache cache;
+    cache.Store(1000, "/cfg/1", {{"remote_host", "vpn1.example.org"},
+                                 {"auth_token", "token"}});
+    ASSERT_EQ(cache.size(), 1u);
+
+    // Another user or profile does not get it
+    EXPECT_TRUE(cache.Take(1001, "/cfg/1").empty());
+    EXPECT_TRUE(cache.Take(1000, "/cfg/2").empty());
+
+    ReconnectCache::State st = cache.Take(1000, "/cfg/1");
+    EXPECT_EQ(st["remote_host"], "vpn1.example.org");
+    EXPECT_EQ(st["auth_token"], "token");
+    EXPECT_TRUE(cache.Take(1000, "/cfg/1").empty());
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+
+TEST(ReconnectCache, replace_and_forget)
+{
+    ReconnectCache cache;
+    cache.Store(1000, "/cfg/1", {{"remote_host", "vpn1.example.org"}});
+    cache.Store(1000, "/cfg/1", {{"remote_host", "vpn2.example.org"}});
+    cache.Store(1000, "/cfg/2", {{"remote_host", "vpn3.example.org"}});
+    EXPECT_EQ(cache.size(), 2u);
+
+    cache.Forget(1000, "/cfg/2");
+    EXPECT_TRUE(cache.Take(1000, "/cfg/2").empty());
+
+    // An empty state removes the entry
+    cache.Store(1000, "/cfg/3", {{"remote_host", "vpn4.example.org"}});
+    cache.Store(1000, "/cfg/3", {});
+    EXPECT_TRUE(cache.Take(1000, "/cfg/3").empty());
+
+    EXPECT_EQ(cache.Take(1000, "/cfg/1")["remote_host"], "vpn2.example.org");
+}
+
+
+TEST(ReconnectCache, expiry)
+{
+    ReconnectCache cache(std::chrono::seconds(60));
+    auto t0 = ReconnectCache::Clock::now();
+    cache.Store(1000, "/cfg/1", {{"remote_host", "vpn1.example.org"}}, t0);
+    cache.Store(1000, "/cfg/2", {{"remote_host", "vpn2.example.org"}},
+                t0 + std::chrono::seconds(30));
+
+    EXPECT_TRUE(cache.Take(1000, "/cfg/1", t0 + std::chrono::seconds(61)).empty());
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_FALSE(cache.Take(1000, "/cfg/2", t0 + std::chrono::seconds(61)).empty());
+}
+
+} // namespace unittest
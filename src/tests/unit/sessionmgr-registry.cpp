@@ -0,0 +1,112 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   sessionmgr-registry.cpp
+ *
+ * @brief  Unit tests for the SessionRegistry indexes
+ */
+
+#include <gtest/gtest.h>
+
+#include "sessionmgr/session-registry.hpp"
+
+namespace unittest {
+
+struct DummySession
+{
+    int id;
+};
+
+
+TEST(SessionRegistry, add_remove)
+{
+    SessionRegistry<DummySession> reg;
+    DummySession s1{1};
+    DummySession s2{2};
+
+    reg.Add("/s1", &s1, "token1");
+    reg.Add("/s2", &s2, "token2");
+    ASSERT_EQ(reg.size(), 2u);
+    ASSERT_EQ(reg.Get("/s1"), &s1);
+    ASSERT_EQ(reg.GetByToken("token2"), &s2);
+    ASSERT_EQ(reg.GetByToken("token3"), nullptr);
+
+    ASSERT_EQ(reg.Remove("/s1"), &s1);
+    ASSERT_EQ(reg.Remove("/s1"), nullptr);
+    ASSERT_EQ(reg.Get("/s1"), nullptr);
+    ASSERT_EQ(reg.GetByToken("token1"), nullptr);
+    ASSERT_EQ(reg.GetAll().size(), 1u);
+}
+
+
+TEST(SessionRegistry, config_name_index)
+{
+    SessionRegistry<DummySession> reg;
+    DummySession s1{1};
+    DummySession s2{2};
+    reg.Add("/s1", &s1, "t1");
+    reg.Add("/s2", &s2, "t2");
+
+    // Not indexed until the name is known
+    ASSERT_TRUE(reg.GetByConfigName("profile").empty());
+
+    reg.Update("/s1", "profile", "");
+    reg.Update("/s2", "profile", "");
+    ASSERT_EQ(reg.GetByConfigName("profile").size(), 2u);
+
+    reg.Update("/s2", "other", "");
+    auto found = reg.GetByConfigName("profile");
+    ASSERT_EQ(found.size(), 1u);
+    ASSERT_EQ(found[0].first, "/s1");
+    ASSERT_EQ(found[0].second, &s1);
+
+    reg.Remove("/s1");
+    ASSERT_TRUE(reg.GetByConfigName("profile").empty());
+    ASSERT_EQ(reg.GetByConfigName("other").size(), 1u);
+}
+
+
+TEST(SessionRegistry, device_name_index)
+{
+    SessionRegistry<DummySession> reg;
+    DummySession s1{1};
+    DummySession s2{2};
+    reg.Add("/s1", &s1, "t1");
+    reg.Add("/s2", &s2, "t2");
+
+    ASSERT_EQ(reg.GetByDeviceName("tun0").second, nullptr);
+
+    reg.Update("/s1", "p", "tun0");
+    ASSERT_EQ(reg.GetByDeviceName("tun0").first, "/s1");
+
+    // A newer session taking over the device name owns it
+    reg.Update("/s2", "p", "tun0");
+    ASSERT_EQ(reg.GetByDeviceName("tun0").second, &s2);
+
+    // Removing the older session must not drop the newer index entry
+    reg.Remove("/s1");
+    ASSERT_EQ(reg.GetByDeviceName("tun0").second, &s2);
+
+    reg.Update("/s2", "p", "tun1");
+    ASSERT_EQ(reg.GetByDeviceName("tun0").second, nullptr);
+    ASSERT_EQ(reg.GetByDeviceName("tun1").second, &s2);
+}
+
+} // namespace unittest
@@ -0,0 +1,96 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   sessionmgr-remote-backoff.cpp
+ *
+ * @brief  Unit tests for RemoteBackoff
+ */
+
+#include <gtest/gtest.h>
+
+#include "sessionmgr/remote-backoff.hpp"
+
+namespace unittest {
+
+using namespace std::chrono;
+using Clock = RemoteBackoff::Clock;
+
+
+TEST(RemoteBackoff, shared_failures)
+{
+    RemoteBackoff b(seconds(5), seconds(30), milliseconds(100));
+    const Clock::time_point t0 = Clock::now();
+    const std::string r = "vpn.example.org:1194/udp";
+
+    EXPECT_TRUE(b.Get(0, t0).empty());
+    EXPECT_TRUE(b.Failed(r, t0));
+
+    // The other sessions seeing the same outage do not extend it
+    EXPECT_FALSE(b.Failed(r, t0 + seconds(1)));
+    EXPECT_FALSE(b.Failed(r, t0 + seconds(2)));
+    EXPECT_EQ(b.GetState(t0)[r].failures, 1u);
+
+    RemoteBackoff::Delays d = b.Get(0, t0 + seconds(1));
+    EXPECT_EQ(d[r], seconds(4));
+    d = b.Get(3, t0 + seconds(1));
+    EXPECT_EQ(d[r], milliseconds(4300));
+
+    // The probe after the backoff fails; the period doubles up to
+    // the maximum
+    EXPECT_TRUE(b.Failed(r, t0 + seconds(5)));
+    EXPECT_EQ(b.GetState(t0 + seconds(5))[r].remaining, seconds(10));
+    EXPECT_TRUE(b.Failed(r, t0 + seconds(15)));
+    EXPECT_TRUE(b.Failed(r, t0 + seconds(35)));
+    EXPECT_TRUE(b.Failed(r, t0 + seconds(65)));
+    EXPECT_EQ(b.GetState(t0 + seconds(65))[r].failures, 5u);
+    EXPECT_EQ(b.GetState(t0 + seconds(65))[r].remaining, seconds(30));
+    EXPECT_TRUE(b.Get(0, t0 + seconds(65)).count("other:1194/udp") == 0);
+}
+
+
+TEST(RemoteBackoff, paced_recovery)
+{
+    RemoteBackoff b(seconds(60), minutes(5), milliseconds(200), seconds(60));
+    const Clock::time_point t0 = Clock::now();
+    const std::string r = "vpn.example.org:443/tcp";
+
+    EXPECT_FALSE(b.Succeeded(r, t0));
+    EXPECT_TRUE(b.Failed(r, t0));
+
+    // A session got through before the backoff period ended; the
+    // others are let through one by one, right away
+    EXPECT_TRUE(b.Succeeded(r, t0 + seconds(10)));
+    EXPECT_FALSE(b.Succeeded(r, t0 + seconds(11)));
+    EXPECT_EQ(b.GetState(t0 + seconds(10))[r].failures, 0u);
+    EXPECT_TRUE(b.Get(0, t0 + seconds(10)).empty());
+    EXPECT_EQ(b.Get(1, t0 + seconds(10))[r], milliseconds(200));
+    EXPECT_EQ(b.Get(5, t0 + seconds(10))[r], milliseconds(1000));
+    EXPECT_TRUE(b.Get(5, t0 + seconds(12)).empty());
+
+    // A new failure starts over with the initial period
+    EXPECT_TRUE(b.Failed(r, t0 + seconds(20)));
+    EXPECT_EQ(b.GetState(t0 + seconds(20))[r].remaining, seconds(60));
+
+    // Entries are dropped a while after their backoff period
+    EXPECT_EQ(b.size(), 1u);
+    EXPECT_TRUE(b.GetState(t0 + seconds(200)).empty());
+    EXPECT_EQ(b.size(), 0u);
+}
+
+} // namespace unittest
@@ -0,0 +1,129 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   sessionmgr-session-store.cpp
+ *
+ * @brief  Unit tests for SessionStore
+ */
+
+#include <gtest/gtest.h>
+
+#include "sessionmgr/session-store.hpp"
+
+namespace unittest {
+
+static SessionStore::Entry make_entry(const std::string& path)
+{
+    SessionStore::Entry e;
+    e.session_path = path;
+    e.backend_busname = "net.openvpn.v3.backends.be1234";
+    e.backend_path = "/net/openvpn/v3/backends/session";
+    e.backend_token = "t0123";
+    e.backend_pid = 1234;
+    e.owner = 1000;
+    e.acl = {1001, 1002};
+    e.acl_groups = {100};
+    e.public_access = false;
+    e.restrict_log_access = false;
+    e.config_path = "/net/openvpn/v3/configuration/c1";
+    e.config_name = "office";
+    e.created = 1650000000;
+    e.device_name = "tun0";
+    return e;
+}
+
+
+TEST(SessionStore, roundtrip)
+{
+    SessionStore store("boot-1");
+    store.Set(make_entry("/net/openvpn/v3/sessions/s1"));
+    SessionStore::Entry e2 = make_entry("/net/openvpn/v3/sessions/s2");
+    e2.bundle_id = "b1";
+    e2.bundle_index = 1;
+    e2.bundle_size = 2;
+    store.Set(e2);
+    std::string data = store.Serialize();
+    EXPECT_EQ(data.find('\n'), std::string::npos);
+
+    SessionStore loaded("boot-1");
+    ASSERT_EQ(loaded.Parse(data), 2u);
+    std::vector<SessionStore::Entry> all = loaded.GetAll();
+    const SessionStore::Entry& e = all[0];
+    EXPECT_EQ(e.session_path, "/net/openvpn/v3/sessions/s1");
+    EXPECT_EQ(e.backend_busname, "net.openvpn.v3.backends.be1234");
+    EXPECT_EQ(e.backend_path, "/net/openvpn/v3/backends/session");
+    EXPECT_EQ(e.backend_token, "t0123");
+    EXPECT_EQ(e.backend_pid, 1234);
+    EXPECT_EQ(e.owner, 1000u);
+    EXPECT_EQ(e.acl, std::vector<uid_t>({1001, 1002}));
+    EXPECT_EQ(e.acl_groups, std::vector<gid_t>({100}));
+    EXPECT_FALSE(e.public_access);
+    EXPECT_FALSE(e.restrict_log_access);
+    EXPECT_EQ(e.config_path, "/net/openvpn/v3/configuration/c1");
+    EXPECT_EQ(e.config_name, "office");
+    EXPECT_EQ(e.created, 1650000000);
+    EXPECT_EQ(e.device_name, "tun0");
+    EXPECT_TRUE(e.bundle_id.empty());
+
+    EXPECT_EQ(all[1].bundle_id, "b1");
+    EXPECT_EQ(all[1].bundle_index, 1u);
+    EXPECT_EQ(all[1].bundle_size, 2u);
+}
+
+
+TEST(SessionStore, set_and_remove)
+{
+    SessionStore store("boot-1");
+    SessionStore::Entry e = make_entry("/s1");
+    store.Set(e);
+    e.acl = {};
+    store.Set(e);
+    EXPECT_EQ(store.size(), 1u);
+    EXPECT_TRUE(store.GetAll()[0].acl.empty());
+
+    EXPECT_TRUE(store.Remove("/s1"));
+    EXPECT_FALSE(store.Remove("/s1"));
+    EXPECT_EQ(store.size(), 0u);
+}
+
+
+TEST(SessionStore, rejects_stale_data)
+{
+    SessionStore store("boot-1");
+    store.Set(make_entry("/s1"));
+    std::string data = store.Serialize();
+
+    // Sessions recorded before a reboot are not taken over
+    SessionStore other_boot("boot-2");
+    EXPECT_EQ(other_boot.Parse(data), 0u);
+
+    // Loading replaces whatever was recorded
+    SessionStore loaded("boot-1");
+    loaded.Set(make_entry("/s9"));
+    EXPECT_EQ(loaded.Parse("{ not json"), 0u);
+    EXPECT_EQ(loaded.size(), 0u);
+    EXPECT_EQ(loaded.Parse(""), 0u);
+
+    // Entries without a backend are skipped
+    std::string nobackend = "{\"version\":1,\"boot_id\":\"boot-1\","
+                            "\"sessions\":{\"/s1\":{\"owner\":1000}}}";
+    EXPECT_EQ(loaded.Parse(nobackend), 0u);
+}
+
+} // namespace unittest
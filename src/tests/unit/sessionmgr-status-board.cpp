@@ -0,0 +1,156 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   sessionmgr-status-board.cpp
+ *
+ * @brief  Unit tests for SessionManager::StatusBoard
+ */
+
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+#include "sessionmgr/status-board.hpp"
+
+namespace unittest {
+
+using namespace SessionManager;
+
+
+static StatusBoard::Session make_session(const std::string& path,
+                                         uint64_t counter)
+{
+    StatusBoard::Session s{};
+    s.in_use = 1;
+    s.owner = 1000;
+    s.backend_pid = 4321;
+    s.status_major = 2;
+    s.status_minor = 7;
+    s.updated = 1600000000;
+    s.bytes_in = counter;
+    s.bytes_out = counter;
+    s.packets_in = counter;
+    s.packets_out = counter;
+    StatusBoardCopy(s.session_path, path);
+    StatusBoardCopy(s.config_name, "office");
+    StatusBoardCopy(s.device_name, "tun0");
+    return s;
+}
+
+
+TEST(StatusBoard, set_update_remove)
+{
+    StatusBoard board("unittest", 4);
+    EXPECT_TRUE(board.Set(make_session("/s1", 1)));
+    EXPECT_TRUE(board.Set(make_session("/s2", 2)));
+    EXPECT_TRUE(board.Set(make_session("/s1", 3)));
+    EXPECT_EQ(board.Count(), 2u);
+
+    int fd = board.GetReadOnlyFD();
+    ASSERT_GE(fd, 0);
+    StatusBoardReader reader(fd);
+    std::vector<StatusBoard::Session> sessions = reader.Read();
+    ASSERT_EQ(sessions.size(), 2u);
+    EXPECT_STREQ(sessions[0].session_path, "/s1");
+    EXPECT_EQ(sessions[0].bytes_in, 3u);
+    EXPECT_STREQ(sessions[0].config_name, "office");
+    EXPECT_STREQ(sessions[0].device_name, "tun0");
+    EXPECT_EQ(sessions[1].owner, 1000u);
+
+    StatusBoard::Session c{};
+    c.updated = 1600000010;
+    c.bytes_in = 100;
+    EXPECT_TRUE(board.SetCounters("/s2", c));
+    EXPECT_FALSE(board.SetCounters("/s9", c));
+    sessions = reader.Read();
+    EXPECT_EQ(sessions[1].bytes_in, 100u);
+    EXPECT_EQ(sessions[1].status_minor, 7u);
+    EXPECT_STREQ(sessions[1].config_name, "office");
+
+    EXPECT_TRUE(board.Remove("/s1"));
+    EXPECT_FALSE(board.Remove("/s1"));
+    sessions = reader.Read();
+    ASSERT_EQ(sessions.size(), 1u);
+    EXPECT_STREQ(sessions[0].session_path, "/s2");
+    close(fd);
+}
+
+
+TEST(StatusBoard, full_and_truncated)
+{
+    StatusBoard board("unittest", 1);
+    EXPECT_TRUE(board.Set(make_session("/s1", 1)));
+    EXPECT_FALSE(board.Set(make_session("/s2", 1)));
+    board.Remove("/s1");
+    EXPECT_TRUE(board.Set(make_session("/s2", 1)));
+
+    StatusBoard::Session s = make_session("/s3", 1);
+    StatusBoardCopy(s.device_name, std::string(100, 'd'));
+    EXPECT_EQ(std::string(s.device_name).size(), sizeof(s.device_name) - 1);
+}
+
+
+TEST(StatusBoard, readers_cannot_write)
+{
+    StatusBoard board("unittest", 2);
+    int fd = board.GetReadOnlyFD();
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(write(fd, "x", 1), -1);
+    void *p = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    EXPECT_EQ(p, MAP_FAILED);
+    close(fd);
+}
+
+
+TEST(StatusBoard, consistent_snapshots)
+{
+    StatusBoard board("unittest", 2);
+    board.Set(make_session("/s1", 0));
+    int fd = board.GetReadOnlyFD();
+    StatusBoardReader reader(fd);
+
+    std::atomic<bool> done{false};
+    std::atomic<unsigned int> torn{0};
+    std::thread rd([&]()
+                   {
+                       while (!done)
+                       {
+                           for (const auto& s : reader.Read())
+                           {
+                               if (s.bytes_in != s.bytes_out
+                                   || s.bytes_in != s.packets_in
+                                   || s.bytes_in != s.packets_out)
+                               {
+                                   ++torn;
+                               }
+                           }
+                       }
+                   });
+    for (uint64_t i = 1; i < 200000; ++i)
+    {
+        board.Set(make_session("/s1", i));
+    }
+    done = true;
+    rd.join();
+    EXPECT_EQ(torn, 0u);
+    close(fd);
+}
+
+} // namespace unittest
@@ -0,0 +1,137 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   socket-buffers.cpp
+ *
+ * @brief  Unit test for SocketBuffers, using UDP sockets on the
+ *         loopback interface
+ */
+
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "client/socket-buffers.hpp"
+
+namespace unittest {
+
+static unsigned int get_buf(int fd, int opt)
+{
+    int v = 0;
+    socklen_t len = sizeof(v);
+    getsockopt(fd, SOL_SOCKET, opt, &v, &len);
+    return v;
+}
+
+
+TEST(SocketBuffers, next_size)
+{
+    SocketBuffers::Limits l;
+    l.min = 64 * 1024;
+    l.max = 1024 * 1024;
+
+    EXPECT_EQ(SocketBuffers::NextSize(16 * 1024, true, l), 64u * 1024);
+    EXPECT_EQ(SocketBuffers::NextSize(200 * 1024, true, l), 400u * 1024);
+    EXPECT_EQ(SocketBuffers::NextSize(800 * 1024, true, l), 1024u * 1024);
+    EXPECT_EQ(SocketBuffers::NextSize(2048 * 1024, true, l), 2048u * 1024);
+
+    EXPECT_EQ(SocketBuffers::NextSize(400 * 1024, false, l), 200u * 1024);
+    EXPECT_EQ(SocketBuffers::NextSize(100 * 1024, false, l), 64u * 1024);
+    EXPECT_EQ(SocketBuffers::NextSize(16 * 1024, false, l), 16u * 1024);
+}
+
+
+TEST(SocketBuffers, grow_on_drops)
+{
+    // A receiver on the loopback interface with the smallest
+    // possible receive buffer, which a burst of packets overflows
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(rx, 0);
+    ASSERT_GE(tx, 0);
+    int zero = 0;
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &zero, sizeof(zero));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+    ASSERT_EQ(bind(rx, (struct sockaddr *) &addr, sizeof(addr)), 0);
+    ASSERT_EQ(getsockname(rx, (struct sockaddr *) &addr, &alen), 0);
+    unsigned int start = get_buf(rx, SO_RCVBUF);
+
+    SocketBuffers sb;
+    SocketBuffers::Limits l;
+    l.min = 4 * 1024;
+    l.max = 8 * start;
+    sb.Attach(rx);
+
+    // Nothing is done or reported before Enable()
+    EXPECT_EQ(sb.Sample(), "");
+    EXPECT_EQ(sb.GetStatsValues(), std::vector<uint64_t>(5));
+    EXPECT_EQ(SocketBuffers::GetStatsKeys().size(), 5u);
+
+    sb.Enable(l);
+    EXPECT_EQ(sb.Sample(), "");
+    EXPECT_EQ(sb.GetStatsValues()[0], start);
+
+    std::string payload(1000, 'x');
+    for (int i = 0; i < 200; ++i)
+    {
+        sendto(tx, payload.data(), payload.size(), MSG_DONTWAIT,
+               (struct sockaddr *) &addr, sizeof(addr));
+    }
+    std::string log = sb.Sample();
+    EXPECT_NE(log.find("receive buffer"), std::string::npos) << log;
+
+    auto v = sb.GetStatsValues();
+    EXPECT_GT(v[2], 0u);
+    EXPECT_EQ(v[3], 1u);
+    EXPECT_EQ(v[0], get_buf(rx, SO_RCVBUF));
+    EXPECT_GT(v[0], start);
+    EXPECT_LE(v[0], l.max);
+
+    // A closed socket, whose descriptor number gets reused by another
+    // socket, is no longer touched
+    close(rx);
+    int other = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_EQ(other, rx);
+    setsockopt(other, SOL_SOCKET, SO_RCVBUF, &zero, sizeof(zero));
+    unsigned int other_size = get_buf(other, SO_RCVBUF);
+    for (unsigned int i = 0; i < SocketBuffers::ShrinkAfter + 1; ++i)
+    {
+        EXPECT_EQ(sb.Sample(), "");
+    }
+    EXPECT_EQ(get_buf(other, SO_RCVBUF), other_size);
+
+    // Stream sockets are not watched
+    int stream = socket(AF_INET, SOCK_STREAM, 0);
+    sb.Attach(stream);
+    EXPECT_EQ(sb.Sample(), "");
+
+    close(stream);
+    close(other);
+    close(tx);
+}
+
+} // namespace unittest
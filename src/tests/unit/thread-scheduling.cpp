@@ -0,0 +1,144 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//  Copyright (C) 2022         David Sommerseth <davids@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file   thread-scheduling.cpp
+ *
+ * @brief  Unit tests for the ThreadScheduling settings parser
+ */
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <sys/prctl.h>
+
+#include "common/thread-scheduling.hpp"
+
+namespace unittest {
+
+TEST(ThreadScheduling, cpu_list)
+{
+    ThreadScheduling ts;
+    ASSERT_TRUE(ts.empty());
+    EXPECT_EQ(ts.str(), "default");
+
+    ts.SetCPUs("2");
+    EXPECT_EQ(ts.GetCPUs(), std::set<unsigned int>({2}));
+
+    ts.SetCPUs("0-3,6");
+    EXPECT_EQ(ts.GetCPUs(), std::set<unsigned int>({0, 1, 2, 3, 6}));
+    EXPECT_EQ(ts.str(), "cpus=0,1,2,3,6");
+    EXPECT_FALSE(ts.empty());
+
+    EXPECT_THROW(ts.SetCPUs(""), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetCPUs("3-1"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetCPUs("a"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetCPUs("1,,2"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetCPUs("100000"), ThreadSchedulingException);
+}
+
+
+TEST(ThreadScheduling, nice_and_policy)
+{
+    ThreadScheduling ts;
+    ts.SetNice("-5");
+    ts.SetPolicy("batch");
+    EXPECT_EQ(ts.str(), "nice=-5 policy=batch");
+
+    ts.SetPolicy("fifo");
+    EXPECT_EQ(ts.str(), "nice=-5 policy=fifo:1");
+    ts.SetPolicy("rr:10");
+    EXPECT_EQ(ts.str(), "nice=-5 policy=rr:10");
+
+    EXPECT_THROW(ts.SetNice("20"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetNice("-21"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetNice("x"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetPolicy("deadline"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetPolicy("batch:5"), ThreadSchedulingException);
+    EXPECT_THROW(ts.SetPolicy("fifo:1000"), ThreadSchedulingException);
+}
+
+
+TEST(ThreadScheduling, merge)
+{
+    ThreadScheduling service;
+    service.SetCPUs("0-1");
+    service.SetNice("5");
+
+    ThreadScheduling profile;
+    profile.SetCPUs("3");
+    service.Merge(profile);
+    EXPECT_EQ(service.str(), "cpus=3 nice=5");
+}
+
+
+TEST(ThreadScheduling, apply)
+{
+    // Raising the nice value and using the batch policy is always
+    // permitted
+    ThreadScheduling ts;
+    ts.SetNice("10");
+    ts.SetPolicy("batch");
+
+    std::vector<std::string> errors;
+    std::thread t([&ts, &errors]()
+                  {
+                      errors = ts.ApplyToCurrentThread();
+                  });
+    t.join();
+    EXPECT_TRUE(errors.empty());
+}
+
+
+TEST(ThreadScheduling, timer_slack)
+{
+    ThreadScheduling ts;
+    ts.SetTimerSlack(std::chrono::milliseconds(50));
+    EXPECT_FALSE(ts.empty());
+    EXPECT_EQ(ts.str(), "timer-slack=50000us");
+
+    EXPECT_THROW(ts.SetTimerSlack(std::chrono::microseconds(0)),
+                 ThreadSchedulingException);
+    EXPECT_THROW(ts.SetTimerSlack(std::chrono::seconds(11)),
+                 ThreadSchedulingException);
+
+    ThreadScheduling service;
+    service.SetNice("5");
+    service.Merge(ts);
+    EXPECT_EQ(service.str(), "nice=5 timer-slack=50000us");
+
+    // Threads created afterwards inherit the timer slack
+    std::vector<std::string> errors;
+    int inherited = -1;
+    std::thread t([&ts, &errors, &inherited]()
+                  {
+                      errors = ts.ApplyToCurrentThread();
+                      std::thread child([&inherited]()
+                                        {
+                                            inherited = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+                                        });
+                      child.join();
+                  });
+    t.join();
+    EXPECT_TRUE(errors.empty());
+    EXPECT_EQ(inherited, 50000000);
+}
+
+} // namespace unittest
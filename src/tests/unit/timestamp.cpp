@@ -24,6 +24,8 @@
  */
 
 #include <time.h>
+#include <chrono>
+#include <stdexcept>
 #include <gtest/gtest.h>
 #include "common/timestamp.hpp"
 
@@ -52,4 +54,51 @@ TEST(common, GetTimestamp)
     std::string cmp(buf);
     ASSERT_EQ(tstamp, cmp) << "Mismatch between C and C++ implementation";
 }
+
+
+TEST(common, TimestampFormatter)
+{
+    char buf[200];
+    auto now = std::chrono::system_clock::now();
+    time_t t = std::chrono::system_clock::to_time_t(now);
+    struct tm *tmp = localtime(&t);
+    ASSERT_GT(strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", tmp), 0)
+        << "strftime() failed";
+    std::string cmp(buf);
+
+    auto tp = std::chrono::system_clock::from_time_t(t);
+    TimestampFormatter tsf;
+    ASSERT_EQ(tsf.Format(tp), cmp + " ");
+    ASSERT_EQ(tsf.Format(tp), GetTimestamp(t));
+
+    tsf.SetPrecision(TimestampFormatter::Precision::MILLISECONDS);
+    ASSERT_EQ(tsf.Format(tp + std::chrono::microseconds(7890)),
+              cmp + ".007 ");
+
+    tsf.SetPrecision(TimestampFormatter::Precision::MICROSECONDS);
+    ASSERT_EQ(tsf.Format(tp + std::chrono::microseconds(123456)),
+              cmp + ".123456 ");
+    ASSERT_EQ(tsf.Format(tp + std::chrono::microseconds(42)),
+              cmp + ".000042 ");
+
+    // Crossing into the next second must render the new second
+    time_t t2 = t + 1;
+    ASSERT_GT(strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S",
+                       localtime(&t2)), 0);
+    ASSERT_EQ(tsf.Format(tp + std::chrono::microseconds(1000001)),
+              std::string(buf) + ".000001 ");
+}
+
+
+TEST(common, TimestampFormatter_ParsePrecision)
+{
+    ASSERT_EQ(TimestampFormatter::ParsePrecision("s"),
+              TimestampFormatter::Precision::SECONDS);
+    ASSERT_EQ(TimestampFormatter::ParsePrecision("ms"),
+              TimestampFormatter::Precision::MILLISECONDS);
+    ASSERT_EQ(TimestampFormatter::ParsePrecision("us"),
+              TimestampFormatter::Precision::MICROSECONDS);
+    ASSERT_THROW(TimestampFormatter::ParsePrecision("ns"),
+                 std::invalid_argument);
+}
 }
@@ -0,0 +1,115 @@
+//  OpenVPN 3 Linux client -- Next generation OpenVPN client
+//
+//  Copyright (C) 2022         OpenVPN Inc. <sales@openvpn.net>
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Affero General Public License as
+//  published by the Free Software Foundation, version 3 of the
+//  License.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Affero General Public License for more details.
+//
+//  You should have received a copy of the GNU Affero General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file   worker-pool.cpp
+ *
+ * @brief  Unit test for WorkerPool
+ */
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/worker-pool.hpp"
+
+namespace unittest {
+
+TEST(WorkerPool, runs_all_tasks)
+{
+    std::mutex mtx;
+    std::set<unsigned int> done;
+    std::vector<std::string> errors;
+    {
+        WorkerPool pool(3, [&mtx, &errors](const std::string& err)
+                           {
+                               std::lock_guard<std::mutex> lg(mtx);
+                               errors.push_back(err);
+                           });
+        ASSERT_EQ(pool.GetThreadCount(), 3u);
+        for (unsigned int i = 0; i < 100; i++)
+        {
+            pool.Post([&mtx, &done, i]()
+                      {
+                          std::lock_guard<std::mutex> lg(mtx);
+                          done.insert(i);
+                      });
+        }
+        // Exceptions do not stop the worker threads
+        pool.Post([]() { throw std::runtime_error("parse failed"); });
+        // The destructor completes all queued tasks
+    }
+    EXPECT_EQ(done.size(), 100u);
+    ASSERT_EQ(errors.size(), 1u);
+    EXPECT_NE(errors[0].find("parse failed"), std::string::npos);
+}
+
+
+TEST(WorkerPool, parallel_tasks)
+{
+    WorkerPool pool(2);
+
+    // The first task can only complete if the second one runs at
+    // the same time
+    std::atomic<bool> first_started{false};
+    std::atomic<bool> second_done{false};
+    pool.Post([&]()
+              {
+                  first_started = true;
+                  while (!second_done)
+                  {
+                      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                  }
+              });
+    pool.Post([&]()
+              {
+                  while (!first_started)
+                  {
+                      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                  }
+                  second_done = true;
+              });
+
+    auto start = std::chrono::steady_clock::now();
+    while (!second_done && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(second_done);
+    second_done = true;
+}
+
+
+TEST(WorkerPool, inline_without_threads)
+{
+    WorkerPool pool(0);
+    std::thread::id ran_in;
+    pool.Post([&ran_in]() { ran_in = std::this_thread::get_id(); });
+    EXPECT_EQ(ran_in, std::this_thread::get_id());
+    EXPECT_EQ(pool.GetPending(), 0u);
+}
+
+} // namespace unittest